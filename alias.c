@@ -270,14 +270,9 @@ static bool string_is_address(const char *str, const char *u, const char *d)
  */
 struct Address *mutt_alias_lookup(const char *s)
 {
-  struct Alias *a = NULL;
+  struct Alias *a = mutt_hash_find(AliasNames, s);
 
-  TAILQ_FOREACH(a, &Aliases, entries)
-  {
-    if (mutt_str_strcasecmp(s, a->name) == 0)
-      return a->addr;
-  }
-  return NULL;
+  return a ? a->addr : NULL;
 }
 
 /**
@@ -465,6 +460,7 @@ retry_name:
   }
 
   mutt_alias_add_reverse(new);
+  mutt_alias_add_name(new);
 
   TAILQ_INSERT_TAIL(&Aliases, new, entries);
 
@@ -520,6 +516,147 @@ fseek_err:
   mutt_file_fclose(&rc);
 }
 
+/**
+ * struct AliasIndexEntry - An Alias in the completion index
+ */
+struct AliasIndexEntry
+{
+  struct Alias *alias; /**< Alias */
+  size_t pos;          /**< Position of the Alias in the list */
+};
+
+static struct AliasIndexEntry *AliasIndex = NULL; ///< Aliases, sorted by name
+static size_t AliasIndexLen = 0;                   ///< Number of entries in AliasIndex
+
+/**
+ * alias_index_cmp - Compare two Aliases by name - Implements ::sort_t
+ */
+static int alias_index_cmp(const void *a, const void *b)
+{
+  const struct AliasIndexEntry *x = a;
+  const struct AliasIndexEntry *y = b;
+
+  return mutt_str_strcmp(x->alias->name, y->alias->name);
+}
+
+/**
+ * alias_index_pos_cmp - Compare two Aliases by list position - Implements ::sort_t
+ */
+static int alias_index_pos_cmp(const void *a, const void *b)
+{
+  const struct AliasIndexEntry *x = a;
+  const struct AliasIndexEntry *y = b;
+
+  return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+/**
+ * alias_index_invalidate - Throw away the completion index
+ *
+ * The index will be rebuilt the next time it's needed.
+ */
+static void alias_index_invalidate(void)
+{
+  FREE(&AliasIndex);
+  AliasIndexLen = 0;
+}
+
+/**
+ * alias_index_get - Get the Aliases, sorted by name
+ * @param[out] len Number of entries
+ * @retval ptr Array of Aliases
+ *
+ * The sorted index is built on demand and kept until an Alias is added or
+ * deleted.
+ */
+static struct AliasIndexEntry *alias_index_get(size_t *len)
+{
+  if (!AliasIndex && !TAILQ_EMPTY(&Aliases))
+  {
+    struct Alias *a = NULL;
+    size_t count = 0;
+
+    TAILQ_FOREACH(a, &Aliases, entries)
+    {
+      count++;
+    }
+
+    AliasIndex = mutt_mem_calloc(count, sizeof(struct AliasIndexEntry));
+    TAILQ_FOREACH(a, &Aliases, entries)
+    {
+      if (!a->name)
+        continue;
+      AliasIndex[AliasIndexLen].alias = a;
+      AliasIndex[AliasIndexLen].pos = AliasIndexLen;
+      AliasIndexLen++;
+    }
+    qsort(AliasIndex, AliasIndexLen, sizeof(struct AliasIndexEntry), alias_index_cmp);
+  }
+
+  *len = AliasIndexLen;
+  return AliasIndex;
+}
+
+/**
+ * alias_index_prefix - Find the Aliases whose names start with a prefix
+ * @param[in]  prefix Prefix to match (case-sensitive)
+ * @param[out] first  Index of the first match
+ * @retval num Number of matches
+ */
+static size_t alias_index_prefix(const char *prefix, size_t *first)
+{
+  size_t len = 0;
+  struct AliasIndexEntry *idx = alias_index_get(&len);
+  const size_t plen = mutt_str_strlen(prefix);
+  size_t lo = 0, hi = len;
+
+  /* lower bound: first name >= prefix */
+  while (lo < hi)
+  {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (mutt_str_strcmp(idx[mid].alias->name, prefix) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  *first = lo;
+  for (hi = lo; (hi < len) && (strncmp(idx[hi].alias->name, prefix, plen) == 0); hi++)
+    ;
+
+  return hi - lo;
+}
+
+/**
+ * mutt_alias_add_name - Add a name lookup for an Alias
+ * @param t Alias to use
+ */
+void mutt_alias_add_name(struct Alias *t)
+{
+  if (!t || !t->name)
+    return;
+
+  mutt_hash_insert(AliasNames, t->name, t);
+  alias_index_invalidate();
+}
+
+/**
+ * mutt_alias_delete_name - Remove a name lookup for an Alias
+ * @param t Alias to use
+ */
+void mutt_alias_delete_name(struct Alias *t)
+{
+  if (!t || !t->name)
+    return;
+
+  /* Only remove the entry if it belongs to this Alias */
+  if (mutt_hash_find(AliasNames, t->name) == t)
+  {
+    mutt_hash_delete(AliasNames, t->name, t);
+    alias_index_invalidate();
+  }
+}
+
 /**
  * mutt_alias_reverse_lookup - Does the user have an alias for the given address
  * @param a Address to lookup
@@ -595,23 +732,19 @@ int mutt_alias_complete(char *buf, size_t buflen)
 
   if (buf[0] != 0) /* avoid empty string as strstr argument */
   {
-    TAILQ_FOREACH(a, &Aliases, entries)
+    size_t first = 0;
+    const size_t num = alias_index_prefix(buf, &first);
+
+    if (num > 0)
     {
-      if (a->name && strncmp(a->name, buf, strlen(buf)) == 0)
-      {
-        if (!bestname[0]) /* init */
-        {
-          mutt_str_strfcpy(bestname, a->name,
-                           MIN(mutt_str_strlen(a->name) + 1, sizeof(bestname)));
-        }
-        else
-        {
-          int i;
-          for (i = 0; a->name[i] && (a->name[i] == bestname[i]); i++)
-            ;
-          bestname[i] = '\0';
-        }
-      }
+      /* The names are sorted, so the longest common prefix of all the
+       * matches is the common prefix of the first and last ones. */
+      const char *lo = AliasIndex[first].alias->name;
+      const char *hi = AliasIndex[first + num - 1].alias->name;
+      size_t i;
+      for (i = 0; lo[i] && (lo[i] == hi[i]) && (i < sizeof(bestname) - 1); i++)
+        bestname[i] = lo[i];
+      bestname[i] = '\0';
     }
 
     if (bestname[0] != 0)
@@ -623,16 +756,18 @@ int mutt_alias_complete(char *buf, size_t buflen)
         return 1;
       }
 
-      /* build alias list and show it */
-      TAILQ_FOREACH(a, &Aliases, entries)
+      /* build alias list, in the original order, and show it */
+      struct AliasIndexEntry *matches =
+          mutt_mem_malloc(num * sizeof(struct AliasIndexEntry));
+      memcpy(matches, AliasIndex + first, num * sizeof(struct AliasIndexEntry));
+      qsort(matches, num, sizeof(struct AliasIndexEntry), alias_index_pos_cmp);
+      for (size_t j = 0; j < num; j++)
       {
-        if (a->name && strncmp(a->name, buf, strlen(buf)) == 0)
-        {
-          tmp = mutt_mem_calloc(1, sizeof(struct Alias));
-          memcpy(tmp, a, sizeof(struct Alias));
-          TAILQ_INSERT_TAIL(&a_list, tmp, entries);
-        }
+        tmp = mutt_mem_calloc(1, sizeof(struct Alias));
+        memcpy(tmp, matches[j].alias, sizeof(struct Alias));
+        TAILQ_INSERT_TAIL(&a_list, tmp, entries);
       }
+      FREE(&matches);
     }
   }
 
@@ -734,6 +869,7 @@ void mutt_alias_free(struct Alias **p)
     return;
 
   mutt_alias_delete_reverse(*p);
+  mutt_alias_delete_name(*p);
   FREE(&(*p)->name);
   mutt_addr_free(&(*p)->addr);
   FREE(p);
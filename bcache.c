@@ -27,8 +27,13 @@
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include "mutt/mutt.h"
 #include "email/lib.h"
 #include "bcache.h"
@@ -36,7 +41,14 @@
 #include "muttlib.h"
 
 /* These Config Variables are only used in bcache.c */
-char *MessageCachedir; ///< Config: (imap/pop) Directory for the message cache
+bool MessageCacheCompress; ///< Config: (imap/pop) Compress the messages in the cache
+short MessageCacheMaxAge;  ///< Config: (imap/pop) Days after which unused messages are removed from the cache
+long MessageCacheMaxSize;  ///< Config: (imap/pop) Maximum size of the message cache, in bytes
+char *MessageCachedir;     ///< Config: (imap/pop) Directory for the message cache
+
+#define BCACHE_INDEX ".index"     ///< Name of the index file in $message_cachedir
+#define BCACHE_SCAN_INTERVAL 3600 ///< Seconds between checks for expired messages
+#define BCACHE_SHARDS 256         ///< Number of subdirectories for each mailbox
 
 /**
  * struct BodyCache - Local cache of email bodies
@@ -47,6 +59,20 @@ struct BodyCache
   size_t pathlen;
 };
 
+/**
+ * struct BcacheEntry - A message in the Body Cache index
+ */
+struct BcacheEntry
+{
+  char *path;  ///< Full path of the cached message
+  time_t used; ///< When the message was last stored or read
+  long size;   ///< Size of the message on disk
+};
+
+static char *IndexDir = NULL;   ///< $message_cachedir that IndexTotal belongs to
+static long IndexTotal = -1;    ///< Bytes used by the cache, -1 if unknown
+static time_t IndexScanned = 0; ///< When the index was last scanned
+
 /**
  * bcache_path - Create the cache path for a given account/mailbox
  * @param account Account info
@@ -94,27 +120,472 @@ static int bcache_path(struct ConnAccount *account, const char *mailbox, char *d
 }
 
 /**
- * mutt_bcache_move - Change the id of a message in the cache
+ * bcache_index_path - Get the path of the Body Cache index
+ * @param buf    Buffer for the path
+ * @param buflen Length of the buffer
+ * @retval true The cache has limits and the index should be kept
+ *
+ * The index only exists if $message_cache_max_size or $message_cache_max_age
+ * is set.  If $message_cachedir has changed, the totals are forgotten.
+ */
+static bool bcache_index_path(char *buf, size_t buflen)
+{
+  if (!MessageCachedir || !*MessageCachedir ||
+      ((MessageCacheMaxSize <= 0) && (MessageCacheMaxAge <= 0)))
+  {
+    return false;
+  }
+
+  if (mutt_str_strcmp(IndexDir, MessageCachedir) != 0)
+  {
+    mutt_str_replace(&IndexDir, MessageCachedir);
+    IndexTotal = -1;
+    IndexScanned = 0;
+  }
+
+  snprintf(buf, buflen, "%s/%s", MessageCachedir, BCACHE_INDEX);
+  return true;
+}
+
+/**
+ * bcache_index_add - Record a use of a message in the Body Cache index
+ * @param path Full path of the cached message
+ * @param size Size of the message on disk, -1 if it has been deleted
+ *
+ * The index is a log: one line per store, read or delete.  The last line
+ * for each message wins.  It's compacted whenever it's scanned.
+ */
+static void bcache_index_add(const char *path, long size)
+{
+  char idx[PATH_MAX];
+
+  if (!bcache_index_path(idx, sizeof(idx)))
+    return;
+
+  FILE *fp = mutt_file_fopen(idx, "a");
+  if (!fp)
+    return;
+
+  fprintf(fp, "%ld %ld %s\n", (long) time(NULL), size, path);
+  mutt_file_fclose(&fp);
+}
+
+/**
+ * bcache_entry_cmp - Compare two Body Cache entries by age - Implements ::sort_t
+ */
+static int bcache_entry_cmp(const void *a, const void *b)
+{
+  const struct BcacheEntry *ea = *(struct BcacheEntry const *const *) a;
+  const struct BcacheEntry *eb = *(struct BcacheEntry const *const *) b;
+
+  if (ea->used != eb->used)
+    return (ea->used < eb->used) ? -1 : 1;
+  return mutt_str_strcmp(ea->path, eb->path);
+}
+
+/**
+ * bcache_entry_free - Free a Body Cache entry - Implements ::hash_destructor_t
+ */
+static void bcache_entry_free(int type, void *obj, intptr_t data)
+{
+  struct BcacheEntry *entry = obj;
+
+  FREE(&entry->path);
+  FREE(&entry);
+}
+
+/**
+ * bcache_index_scan - Enforce the limits of the Body Cache
+ *
+ * Read the index, then delete the messages that haven't been used for
+ * $message_cache_max_age days.  If the cache is still larger than
+ * $message_cache_max_size, the least recently used messages are deleted until
+ * it's down to 90% of the limit, so this doesn't run on every download.
+ *
+ * Finally, the index is rewritten with one line per message.
+ */
+static void bcache_index_scan(void)
+{
+  char idx[PATH_MAX];
+  char tmp[PATH_MAX];
+
+  if (!bcache_index_path(idx, sizeof(idx)))
+    return;
+
+  const time_t now = time(NULL);
+  IndexScanned = now;
+  IndexTotal = 0;
+
+  FILE *fp = mutt_file_fopen(idx, "r");
+  if (!fp)
+    return;
+
+  struct Hash *entries = mutt_hash_create(1024, 0);
+  mutt_hash_set_destructor(entries, bcache_entry_free, 0);
+  size_t count = 0;
+
+  char *line = NULL;
+  size_t linelen = 0;
+  while ((line = mutt_file_read_line(line, &linelen, fp, NULL, 0)))
+  {
+    char *end = NULL;
+    const long used = strtol(line, &end, 10);
+    if (*end != ' ')
+      continue;
+    const long size = strtol(end + 1, &end, 10);
+    if ((*end != ' ') || (end[1] != '/'))
+      continue;
+
+    const char *path = end + 1;
+    struct BcacheEntry *entry = mutt_hash_find(entries, path);
+    if (size < 0)
+    {
+      if (entry)
+      {
+        mutt_hash_delete(entries, path, entry);
+        count--;
+      }
+      continue;
+    }
+    if (!entry)
+    {
+      entry = mutt_mem_calloc(1, sizeof(*entry));
+      entry->path = mutt_str_strdup(path);
+      mutt_hash_insert(entries, entry->path, entry);
+      count++;
+    }
+    entry->used = used;
+    entry->size = size;
+  }
+  FREE(&line);
+  mutt_file_fclose(&fp);
+
+  struct BcacheEntry **list = mutt_mem_calloc(MAX(count, 1), sizeof(*list));
+  struct HashWalkState state = { 0 };
+  struct HashElem *he = NULL;
+  size_t n = 0;
+  long total = 0;
+  while ((n < count) && (he = mutt_hash_walk(entries, &state)))
+  {
+    list[n++] = he->data;
+    total += ((struct BcacheEntry *) he->data)->size;
+  }
+  qsort(list, n, sizeof(*list), bcache_entry_cmp);
+
+  const time_t expired = (MessageCacheMaxAge > 0) ? now - MessageCacheMaxAge * 86400 : 0;
+  const long target = (MessageCacheMaxSize > 0) ? MessageCacheMaxSize / 10 * 9 : 0;
+  const bool shrink = (MessageCacheMaxSize > 0) && (total > MessageCacheMaxSize);
+  size_t first = 0;
+  for (; first < n; first++)
+  {
+    struct BcacheEntry *entry = list[first];
+    if ((entry->used >= expired) && (!shrink || (total <= target)))
+      break;
+
+    /* it may already have been removed by hand */
+    if ((unlink(entry->path) < 0) && (errno != ENOENT))
+      break;
+    total -= entry->size;
+  }
+  mutt_debug(2, "bcache: removed %zu of %zu messages, %ld bytes left\n", first, n, total);
+
+  /* a new index, oldest first */
+  snprintf(tmp, sizeof(tmp), "%s.tmp", idx);
+  fp = mutt_file_fopen(tmp, "w");
+  if (fp)
+  {
+    for (size_t i = first; i < n; i++)
+      fprintf(fp, "%ld %ld %s\n", (long) list[i]->used, list[i]->size, list[i]->path);
+    if ((mutt_file_fclose(&fp) != 0) || (rename(tmp, idx) < 0))
+      unlink(tmp);
+  }
+
+  FREE(&list);
+  mutt_hash_destroy(&entries);
+  IndexTotal = total;
+}
+
+/**
+ * bcache_index_store - Record a new message in the Body Cache index
+ * @param path Full path of the cached message
+ *
+ * If this takes the cache over its limits, old messages are removed.
+ */
+static void bcache_index_store(const char *path)
+{
+  char idx[PATH_MAX];
+  struct stat st;
+
+  if (!bcache_index_path(idx, sizeof(idx)) || (stat(path, &st) < 0))
+    return;
+
+  bcache_index_add(path, st.st_size);
+  if (IndexTotal >= 0)
+    IndexTotal += st.st_size;
+
+  if ((IndexTotal < 0) ||
+      ((MessageCacheMaxSize > 0) && (IndexTotal > MessageCacheMaxSize)) ||
+      ((MessageCacheMaxAge > 0) && (time(NULL) > IndexScanned + BCACHE_SCAN_INTERVAL)))
+  {
+    bcache_index_scan();
+  }
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * bcache_compress - Compress a message for the Body Cache
+ * @param src Path of the uncompressed message
+ * @param dst Path for the gzip file
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int bcache_compress(const char *src, const char *dst)
+{
+  char buf[HUGE_STRING];
+  size_t n;
+  int rc = 0;
+
+  FILE *fp = mutt_file_fopen(src, "r");
+  if (!fp)
+    return -1;
+
+  gzFile gz = gzopen(dst, "wb");
+  if (!gz)
+  {
+    mutt_file_fclose(&fp);
+    return -1;
+  }
+
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+  {
+    if (gzwrite(gz, buf, n) != (int) n)
+    {
+      rc = -1;
+      break;
+    }
+  }
+  if (ferror(fp))
+    rc = -1;
+  if (gzclose(gz) != Z_OK)
+    rc = -1;
+  mutt_file_fclose(&fp);
+
+  if (rc != 0)
+    unlink(dst);
+  return rc;
+}
+
+/**
+ * bcache_decompress - Decompress a message from the Body Cache
+ * @param path Path of the gzip file
+ * @retval ptr  Temporary file holding the message
+ * @retval NULL Failure
+ */
+static FILE *bcache_decompress(const char *path)
+{
+  char buf[HUGE_STRING];
+  int n;
+
+  gzFile gz = gzopen(path, "rb");
+  if (!gz)
+    return NULL;
+
+  FILE *fp = mutt_file_mkstemp();
+  if (!fp)
+  {
+    gzclose(gz);
+    return NULL;
+  }
+
+  while ((n = gzread(gz, buf, sizeof(buf))) > 0)
+  {
+    if (fwrite(buf, 1, n, fp) != (size_t) n)
+    {
+      n = -1;
+      break;
+    }
+  }
+  gzclose(gz);
+
+  if ((n < 0) || (fflush(fp) != 0))
+  {
+    mutt_debug(1, "bcache: can't decompress '%s'\n", path);
+    mutt_file_fclose(&fp);
+    return NULL;
+  }
+
+  rewind(fp);
+  return fp;
+}
+#endif
+
+/**
+ * bcache_shard - Pick the subdirectory for a message
+ * @param id Per-mailbox unique identifier for the message
+ * @retval num Shard, 0 to #BCACHE_SHARDS - 1
+ *
+ * This is a FNV-1a hash, so that the layout is the same on every machine.
+ */
+static unsigned int bcache_shard(const char *id)
+{
+  unsigned int hash = 2166136261U;
+
+  for (; *id; id++)
+    hash = (hash ^ (unsigned char) *id) * 16777619U;
+
+  return hash % BCACHE_SHARDS;
+}
+
+/**
+ * bcache_file - Get the path of a message in the Body Cache
  * @param bcache Body cache
  * @param id     Per-mailbox unique identifier for the message
- * @param newid  New id for the message
+ * @param suffix Suffix for a temporary file, e.g. ".tmp", or ""
+ * @param buf    Buffer for the path
+ * @param buflen Length of the buffer
+ * @retval  0 Success
+ * @retval -1 Path is too long
+ *
+ * A mailbox's messages are spread over subdirectories, ".00" to ".ff", so
+ * that no directory gets too big.  The dot keeps them apart from the
+ * directories of any child mailboxes.
  */
-static int mutt_bcache_move(struct BodyCache *bcache, const char *id, const char *newid)
+static int bcache_file(struct BodyCache *bcache, const char *id,
+                       const char *suffix, char *buf, size_t buflen)
 {
-  char path[PATH_MAX];
-  char newpath[PATH_MAX];
+  const int len = snprintf(buf, buflen, "%s.%02x/%s%s", bcache->path,
+                           bcache_shard(id), id, suffix);
+
+  return ((len < 0) || ((size_t) len >= buflen)) ? -1 : 0;
+}
 
-  if (!bcache || !id || !*id || !newid || !*newid)
+/**
+ * bcache_mkdir - Create the directory for a message in the Body Cache
+ * @param bcache Body cache
+ * @param id     Per-mailbox unique identifier for the message
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int bcache_mkdir(struct BodyCache *bcache, const char *id)
+{
+  char dir[PATH_MAX];
+  struct stat sb;
+
+  snprintf(dir, sizeof(dir), "%s.%02x", bcache->path, bcache_shard(id));
+
+  if (stat(dir, &sb) == 0)
+  {
+    if (!S_ISDIR(sb.st_mode))
+    {
+      mutt_error(_("Message cache isn't a directory: %s"), dir);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (mutt_file_mkdir(dir, S_IRWXU | S_IRWXG | S_IRWXO) < 0)
+  {
+    mutt_error(_("Can't create %s %s"), dir, strerror(errno));
     return -1;
+  }
 
-  snprintf(path, sizeof(path), "%s%s", bcache->path, id);
-  snprintf(newpath, sizeof(newpath), "%s%s", bcache->path, newid);
+  return 0;
+}
 
+/**
+ * bcache_move - Rename a file in the Body Cache
+ * @param path    Current path of the file
+ * @param newpath New path for the file
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int bcache_move(const char *path, const char *newpath)
+{
   mutt_debug(3, "bcache: mv: '%s' '%s'\n", path, newpath);
 
   return rename(path, newpath);
 }
 
+#ifdef HAVE_ZLIB
+/**
+ * bcache_commit_compressed - Compress a temporary file into the Body Cache
+ * @param tmp  Path of the temporary file
+ * @param path Path for the message
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * The temporary file is unlinked, but the caller may still be reading it.
+ */
+static int bcache_commit_compressed(const char *tmp, const char *path)
+{
+  char zpath[PATH_MAX];
+
+  snprintf(zpath, sizeof(zpath), "%s.gz.tmp", path);
+
+  if (bcache_compress(tmp, zpath) < 0)
+    return -1;
+
+  if (bcache_move(zpath, path) < 0)
+  {
+    unlink(zpath);
+    return -1;
+  }
+
+  unlink(tmp);
+  return 0;
+}
+#endif
+
+/**
+ * bcache_migrate - Move messages into the Body Cache's subdirectories
+ * @param bcache Body cache
+ *
+ * Messages used to be stored directly in the mailbox's directory.  Any that
+ * are left there are moved into place.  Temporary files and a POP header
+ * cache, which may share the directory, are left alone.
+ */
+static void bcache_migrate(struct BodyCache *bcache)
+{
+  char path[PATH_MAX];
+  char newpath[PATH_MAX];
+  struct stat st;
+  int moved = 0;
+
+  DIR *d = opendir(bcache->path);
+  if (!d)
+    return;
+
+  struct dirent *de = NULL;
+  while ((de = readdir(d)))
+  {
+    const size_t len = mutt_str_strlen(de->d_name);
+    if ((de->d_name[0] == '.') || strstr(de->d_name, ".hcache") ||
+        ((len > 4) && (strcmp(de->d_name + len - 4, ".tmp") == 0)))
+    {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "%s%s", bcache->path, de->d_name);
+    if ((stat(path, &st) < 0) || !S_ISREG(st.st_mode))
+      continue;
+
+    if ((bcache_file(bcache, de->d_name, "", newpath, sizeof(newpath)) < 0) ||
+        (bcache_mkdir(bcache, de->d_name) < 0) || (rename(path, newpath) < 0))
+    {
+      continue;
+    }
+
+    bcache_index_add(path, -1);
+    bcache_index_add(newpath, st.st_size);
+    moved++;
+  }
+  closedir(d);
+
+  if (moved > 0)
+    mutt_debug(1, "bcache: moved %d messages into subdirectories of '%s'\n",
+               moved, bcache->path);
+}
+
 /**
  * mutt_bcache_open - Open an Email-Body Cache
  * @param account current mailbox' account (required)
@@ -137,6 +608,8 @@ struct BodyCache *mutt_bcache_open(struct ConnAccount *account, const char *mail
     goto bail;
   bcache->pathlen = mutt_str_strlen(bcache->path);
 
+  bcache_migrate(bcache);
+
   return bcache;
 
 bail:
@@ -173,13 +646,30 @@ FILE *mutt_bcache_get(struct BodyCache *bcache, const char *id)
   if (!id || !*id || !bcache)
     return NULL;
 
-  path[0] = '\0';
-  mutt_str_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  mutt_str_strncat(path, sizeof(path), id, mutt_str_strlen(id));
+  if (bcache_file(bcache, id, "", path, sizeof(path)) < 0)
+    return NULL;
 
   fp = mutt_file_fopen(path, "r");
 
   mutt_debug(3, "bcache: get: '%s': %s\n", path, fp ? "yes" : "no");
+  if (!fp)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fileno(fp), &st) == 0)
+    bcache_index_add(path, st.st_size);
+
+  /* compressed by $message_cache_compress */
+  const int c1 = fgetc(fp);
+  const int c2 = fgetc(fp);
+  rewind(fp);
+  if ((c1 == 0x1f) && (c2 == 0x8b))
+  {
+    mutt_file_fclose(&fp);
+#ifdef HAVE_ZLIB
+    fp = bcache_decompress(path);
+#endif
+  }
 
   return fp;
 }
@@ -197,33 +687,18 @@ FILE *mutt_bcache_get(struct BodyCache *bcache, const char *id)
 FILE *mutt_bcache_put(struct BodyCache *bcache, const char *id)
 {
   char path[PATH_MAX];
-  struct stat sb;
 
   if (!id || !*id || !bcache)
     return NULL;
 
-  if (snprintf(path, sizeof(path), "%s%s%s", bcache->path, id, ".tmp") >= sizeof(path))
+  if (bcache_file(bcache, id, ".tmp", path, sizeof(path)) < 0)
   {
     mutt_error(_("Path too long: %s%s%s"), bcache->path, id, ".tmp");
     return NULL;
   }
 
-  if (stat(bcache->path, &sb) == 0)
-  {
-    if (!S_ISDIR(sb.st_mode))
-    {
-      mutt_error(_("Message cache isn't a directory: %s"), bcache->path);
-      return NULL;
-    }
-  }
-  else
-  {
-    if (mutt_file_mkdir(bcache->path, S_IRWXU | S_IRWXG | S_IRWXO) < 0)
-    {
-      mutt_error(_("Can't create %s %s"), bcache->path, strerror(errno));
-      return NULL;
-    }
-  }
+  if (bcache_mkdir(bcache, id) < 0)
+    return NULL;
 
   mutt_debug(3, "bcache: put: '%s'\n", path);
 
@@ -239,11 +714,30 @@ FILE *mutt_bcache_put(struct BodyCache *bcache, const char *id)
  */
 int mutt_bcache_commit(struct BodyCache *bcache, const char *id)
 {
-  char tmpid[PATH_MAX];
+  char tmp[PATH_MAX];
+  char path[PATH_MAX];
 
-  snprintf(tmpid, sizeof(tmpid), "%s.tmp", id);
+  if (!id || !*id || !bcache)
+    return -1;
 
-  return mutt_bcache_move(bcache, tmpid, id);
+  if ((bcache_file(bcache, id, ".tmp", tmp, sizeof(tmp)) < 0) ||
+      (bcache_file(bcache, id, "", path, sizeof(path)) < 0))
+  {
+    return -1;
+  }
+
+  int rc = -1;
+#ifdef HAVE_ZLIB
+  if (MessageCacheCompress)
+    rc = bcache_commit_compressed(tmp, path);
+#endif
+  if (rc < 0)
+    rc = bcache_move(tmp, path);
+  if (rc < 0)
+    return -1;
+
+  bcache_index_store(path);
+  return 0;
 }
 
 /**
@@ -260,13 +754,22 @@ int mutt_bcache_del(struct BodyCache *bcache, const char *id)
   if (!id || !*id || !bcache)
     return -1;
 
-  path[0] = '\0';
-  mutt_str_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  mutt_str_strncat(path, sizeof(path), id, mutt_str_strlen(id));
+  if (bcache_file(bcache, id, "", path, sizeof(path)) < 0)
+    return -1;
 
   mutt_debug(3, "bcache: del: '%s'\n", path);
 
-  return unlink(path);
+  struct stat st;
+  const bool known = (stat(path, &st) == 0);
+
+  const int rc = unlink(path);
+  if ((rc == 0) && known)
+  {
+    bcache_index_add(path, -1);
+    if (IndexTotal >= st.st_size)
+      IndexTotal -= st.st_size;
+  }
+  return rc;
 }
 
 /**
@@ -285,9 +788,8 @@ int mutt_bcache_exists(struct BodyCache *bcache, const char *id)
   if (!id || !*id || !bcache)
     return -1;
 
-  path[0] = '\0';
-  mutt_str_strncat(path, sizeof(path), bcache->path, bcache->pathlen);
-  mutt_str_strncat(path, sizeof(path), id, mutt_str_strlen(id));
+  if (bcache_file(bcache, id, "", path, sizeof(path)) < 0)
+    return -1;
 
   if (stat(path, &st) < 0)
     rc = -1;
@@ -299,6 +801,51 @@ int mutt_bcache_exists(struct BodyCache *bcache, const char *id)
   return rc;
 }
 
+/**
+ * bcache_list_dir - Find matching entries in one directory of the Body Cache
+ * @param bcache  Body Cache from mutt_bcache_open()
+ * @param dir     Directory to search
+ * @param want_id Callback function called for each match
+ * @param data    Data to pass to the callback function
+ * @param count   Number of items found so far
+ * @retval  1 The callback stopped the listing
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int bcache_list_dir(struct BodyCache *bcache, const char *dir,
+                           bcache_list_t *want_id, void *data, int *count)
+{
+  struct dirent *de = NULL;
+  int rc = 0;
+
+  DIR *d = opendir(dir);
+  if (!d)
+    return -1;
+
+  mutt_debug(3, "bcache: list: dir: '%s'\n", dir);
+
+  while ((de = readdir(d)))
+  {
+    /* this also skips the shards at the top level */
+    if (de->d_name[0] == '.')
+      continue;
+
+    mutt_debug(3, "bcache: list: dir: '%s', id :'%s'\n", dir, de->d_name);
+
+    if (want_id && want_id(de->d_name, bcache, data) != 0)
+    {
+      rc = 1;
+      break;
+    }
+
+    (*count)++;
+  }
+
+  if (closedir(d) < 0)
+    rc = -1;
+  return rc;
+}
+
 /**
  * mutt_bcache_list - Find matching entries in the Body Cache
  * @param bcache Body Cache from mutt_bcache_open()
@@ -320,39 +867,28 @@ int mutt_bcache_exists(struct BodyCache *bcache, const char *id)
  */
 int mutt_bcache_list(struct BodyCache *bcache, bcache_list_t *want_id, void *data)
 {
-  DIR *d = NULL;
-  struct dirent *de = NULL;
+  char dir[PATH_MAX];
+  int count = 0;
   int rc = -1;
 
-  if (!bcache || !(d = opendir(bcache->path)))
+  if (!bcache)
     goto out;
 
-  rc = 0;
+  /* messages that haven't been migrated */
+  rc = bcache_list_dir(bcache, bcache->path, want_id, data, &count);
 
-  mutt_debug(3, "bcache: list: dir: '%s'\n", bcache->path);
-
-  while ((de = readdir(d)))
+  for (int i = 0; (rc == 0) && (i < BCACHE_SHARDS); i++)
   {
-    if ((mutt_str_strncmp(de->d_name, ".", 1) == 0) ||
-        (mutt_str_strncmp(de->d_name, "..", 2) == 0))
-    {
-      continue;
-    }
-
-    mutt_debug(3, "bcache: list: dir: '%s', id :'%s'\n", bcache->path, de->d_name);
-
-    if (want_id && want_id(de->d_name, bcache, data) != 0)
-      goto out;
-
-    rc++;
+    snprintf(dir, sizeof(dir), "%s.%02x", bcache->path, i);
+    const int rc_dir = bcache_list_dir(bcache, dir, want_id, data, &count);
+    if ((rc_dir > 0) || ((rc_dir < 0) && (errno != ENOENT)))
+      rc = rc_dir;
   }
 
+  if (rc >= 0)
+    rc = count;
+
 out:
-  if (d)
-  {
-    if (closedir(d) < 0)
-      rc = -1;
-  }
   mutt_debug(3, "bcache: list: did %d entries\n", rc);
   return rc;
 }
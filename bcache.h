@@ -24,12 +24,16 @@
 #ifndef MUTT_BCACHE_H
 #define MUTT_BCACHE_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
 struct ConnAccount;
 struct BodyCache;
 
 /* These Config Variables are only used in bcache.c */
+extern bool  MessageCacheCompress;
+extern short MessageCacheMaxAge;
+extern long  MessageCacheMaxSize;
 extern char *MessageCachedir;
 
 /**
@@ -0,0 +1,492 @@
+/**
+ * @file
+ * Time mailbox operations without the user interface
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page bench Time mailbox operations without the user interface
+ *
+ * `neomutt -P script` reads a script of mailbox operations, runs them one at a
+ * time and prints how long each one took, e.g.
+ *
+ * ```
+ * open ~/Mail/inbox
+ * sort threads
+ * limit ~f foo
+ * tag ~A
+ * sync
+ * close
+ * ```
+ *
+ * Any line that isn't one of the operations below is run as a config command,
+ * e.g. `set hcache_backend=lmdb`.  Blank lines and comments are ignored.
+ * Questions, e.g. `$delete`, get their default answer.
+ *
+ * | Operation            | Action                                      |
+ * | :------------------- | :------------------------------------------ |
+ * | `check`              | Check the mailbox for new mail              |
+ * | `close`              | Close the mailbox, saving any changes       |
+ * | `delete <pattern>`   | Delete the matching messages                |
+ * | `limit <pattern>`    | Limit the view to the matching messages     |
+ * | `open [-r] <folder>` | Open a mailbox (`-r` for read-only)         |
+ * | `sort <method>`      | Set `$sort` and resort the mailbox          |
+ * | `sync`               | Save the changes to the mailbox             |
+ * | `tag <pattern>`      | Tag the matching messages                   |
+ * | `undelete <pattern>` | Undelete the matching messages              |
+ * | `untag <pattern>`    | Untag the matching messages                 |
+ *
+ * The report has one row per line of the script: its elapsed time, the peak
+ * memory use of NeoMutt so far, and the number of messages in the mailbox, and
+ * visible in the view.
+ */
+
+#include "config.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+#include "mutt/mutt.h"
+#include "config/lib.h"
+#include "mutt.h"
+#include "bench.h"
+#include "context.h"
+#include "globals.h"
+#include "hook.h"
+#include "mailbox.h"
+#include "mutt_thread.h"
+#include "muttlib.h"
+#include "mx.h"
+#include "options.h"
+#include "pattern.h"
+#include "sort.h"
+
+/**
+ * typedef bench_op_t - Run one operation of a benchmark script
+ * @param args Arguments of the operation
+ * @param err  Buffer for error messages
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+typedef int bench_op_t(char *args, struct Buffer *err);
+
+/**
+ * struct BenchOp - An operation of a benchmark script
+ */
+struct BenchOp
+{
+  const char *name; ///< Name of the operation, e.g. "open"
+  bench_op_t *func; ///< Function to run it
+};
+
+/**
+ * bench_need_context - Check that a mailbox is open
+ * @param err Buffer for error messages
+ * @retval true A mailbox is open
+ */
+static bool bench_need_context(struct Buffer *err)
+{
+  if (Context)
+    return true;
+
+  mutt_buffer_printf(err, _("No mailbox is open"));
+  return false;
+}
+
+/**
+ * bench_pattern - Apply a pattern to the mailbox
+ * @param op   Operation, e.g. MUTT_TAG
+ * @param args Pattern
+ * @param err  Buffer for error messages
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int bench_pattern(int op, char *args, struct Buffer *err)
+{
+  if (!bench_need_context(err))
+    return -1;
+
+  if (!*args)
+  {
+    mutt_buffer_printf(err, _("No pattern given"));
+    return -1;
+  }
+
+  if (mutt_pattern_apply(op, args) != 0)
+    return -1;
+
+  if ((op == MUTT_LIMIT) && Context->mailbox->msg_count && ((Sort & SORT_MASK) == SORT_THREADS))
+    mutt_draw_tree(Context);
+
+  return 0;
+}
+
+/**
+ * bench_check - Check the mailbox for new mail - Implements ::bench_op_t
+ */
+static int bench_check(char *args, struct Buffer *err)
+{
+  if (!bench_need_context(err))
+    return -1;
+
+  if (mx_mbox_check(Context, NULL) < 0)
+    return -1;
+
+  if (OptNeedResort)
+    mutt_sort_headers(Context, false);
+
+  return 0;
+}
+
+/**
+ * bench_close - Close the mailbox - Implements ::bench_op_t
+ */
+static int bench_close(char *args, struct Buffer *err)
+{
+  if (!bench_need_context(err))
+    return -1;
+
+  if (mx_mbox_close(&Context, NULL) != 0)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * bench_delete - Delete the matching messages - Implements ::bench_op_t
+ */
+static int bench_delete(char *args, struct Buffer *err)
+{
+  return bench_pattern(MUTT_DELETE, args, err);
+}
+
+/**
+ * bench_limit - Limit the view to the matching messages - Implements ::bench_op_t
+ */
+static int bench_limit(char *args, struct Buffer *err)
+{
+  return bench_pattern(MUTT_LIMIT, args, err);
+}
+
+/**
+ * bench_open - Open a mailbox - Implements ::bench_op_t
+ */
+static int bench_open(char *args, struct Buffer *err)
+{
+  int flags = 0;
+
+  if (Context)
+  {
+    mutt_buffer_printf(err, _("A mailbox is already open"));
+    return -1;
+  }
+
+  if (mutt_str_strncmp(args, "-r", 2) == 0)
+  {
+    flags |= MUTT_READONLY;
+    args += 2;
+    SKIPWS(args);
+  }
+
+  if (!*args)
+  {
+    mutt_buffer_printf(err, _("No mailbox given"));
+    return -1;
+  }
+
+  char folder[PATH_MAX];
+  mutt_str_strfcpy(folder, args, sizeof(folder));
+  mutt_expand_path(folder, sizeof(folder));
+  mutt_str_replace(&CurrentFolder, folder);
+
+  mutt_folder_hook(folder);
+  Context = mx_mbox_open(folder, flags);
+  if (!Context)
+  {
+    mutt_buffer_printf(err, _("Unable to open mailbox %s"), folder);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * bench_sort - Set the sort order and resort the mailbox - Implements ::bench_op_t
+ */
+static int bench_sort(char *args, struct Buffer *err)
+{
+  if (!bench_need_context(err))
+    return -1;
+
+  int rc = cs_str_string_set(Config, "sort", args, err);
+  if (CSR_RESULT(rc) != CSR_SUCCESS)
+    return -1;
+
+  mutt_sort_headers(Context, false);
+  return 0;
+}
+
+/**
+ * bench_sync - Save the changes to the mailbox - Implements ::bench_op_t
+ */
+static int bench_sync(char *args, struct Buffer *err)
+{
+  if (!bench_need_context(err))
+    return -1;
+
+  if (mx_mbox_sync(Context, NULL) < 0)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * bench_tag - Tag the matching messages - Implements ::bench_op_t
+ */
+static int bench_tag(char *args, struct Buffer *err)
+{
+  return bench_pattern(MUTT_TAG, args, err);
+}
+
+/**
+ * bench_undelete - Undelete the matching messages - Implements ::bench_op_t
+ */
+static int bench_undelete(char *args, struct Buffer *err)
+{
+  return bench_pattern(MUTT_UNDELETE, args, err);
+}
+
+/**
+ * bench_untag - Untag the matching messages - Implements ::bench_op_t
+ */
+static int bench_untag(char *args, struct Buffer *err)
+{
+  return bench_pattern(MUTT_UNTAG, args, err);
+}
+
+// clang-format off
+/**
+ * BenchOps - Operations of a benchmark script
+ */
+static const struct BenchOp BenchOps[] = {
+  { "check",    bench_check },
+  { "close",    bench_close },
+  { "delete",   bench_delete },
+  { "limit",    bench_limit },
+  { "open",     bench_open },
+  { "sort",     bench_sort },
+  { "sync",     bench_sync },
+  { "tag",      bench_tag },
+  { "undelete", bench_undelete },
+  { "untag",    bench_untag },
+  { NULL,       NULL },
+};
+// clang-format on
+
+/**
+ * bench_find_op - Find the operation of a script line
+ * @param[in]  line Line of the script
+ * @param[out] args Arguments of the operation
+ * @retval ptr Operation
+ * @retval NULL The line is a config command
+ */
+static const struct BenchOp *bench_find_op(char *line, char **args)
+{
+  for (int i = 0; BenchOps[i].name; i++)
+  {
+    size_t len = mutt_str_strlen(BenchOps[i].name);
+    if ((mutt_str_strncmp(line, BenchOps[i].name, len) == 0) &&
+        ((line[len] == '\0') || isspace((unsigned char) line[len])))
+    {
+      char *p = line + len;
+      SKIPWS(p);
+      *args = p;
+      return &BenchOps[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * bench_elapsed - Get the time since a start time
+ * @param start Start time
+ * @retval num Milliseconds
+ */
+static double bench_elapsed(const struct timeval *start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return ((now.tv_sec - start->tv_sec) * 1000.0) + ((now.tv_usec - start->tv_usec) / 1000.0);
+}
+
+/**
+ * bench_peak_rss - Get NeoMutt's peak memory use
+ * @retval num Peak resident set size, in kilobytes
+ */
+static long bench_peak_rss(void)
+{
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024;
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+/**
+ * bench_log - Keep the progress messages out of the report - Implements ::log_dispatcher_t
+ *
+ * Errors and warnings are shown on the terminal, as usual.  Messages and debug
+ * output only go to the log file.
+ */
+static int bench_log(time_t stamp, const char *file, int line,
+                     const char *function, int level, ...)
+{
+  char buf[LONG_STRING];
+
+  va_list ap;
+  va_start(ap, level);
+  const char *fmt = va_arg(ap, const char *);
+  int ret = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  if (level >= LL_MESSAGE)
+    log_disp_file(stamp, file, line, function, level, "%s", buf);
+  else
+    log_disp_terminal(stamp, file, line, function, level, "%s", buf);
+
+  return ret;
+}
+
+/**
+ * bench_report - Print the results of one line of the script
+ * @param line    Line of the script
+ * @param elapsed Time taken, in milliseconds
+ */
+static void bench_report(const char *line, double elapsed)
+{
+  int msgs = Context ? Context->mailbox->msg_count : 0;
+  int visible = Context ? Context->mailbox->vcount : 0;
+
+  printf("%-40.40s %12.3f %12ld %9d %9d\n", line, elapsed, bench_peak_rss(), msgs, visible);
+  fflush(stdout);
+}
+
+/**
+ * mutt_bench_run - Run a benchmark script
+ * @param script Path to the script, or "-" for stdin
+ * @retval 0 Success
+ * @retval 1 Error
+ *
+ * The script is stopped at the first operation that fails.  Any open mailbox
+ * is closed at the end.
+ */
+int mutt_bench_run(const char *script)
+{
+  FILE *fp = NULL;
+  if (mutt_str_strcmp(script, "-") == 0)
+    fp = stdin;
+  else
+    fp = mutt_file_fopen(script, "r");
+
+  if (!fp)
+  {
+    mutt_perror(script);
+    return 1;
+  }
+
+  int rc = 0;
+  int lineno = 0;
+  size_t buflen = 0;
+  char *line = NULL;
+  struct Buffer token = { 0 };
+  struct Buffer *err = mutt_buffer_alloc(STRING);
+  struct timeval total;
+
+  /* There's nobody to answer any questions */
+  OptNoPrompt = true;
+  log_dispatcher_t old_logger = MuttLogger;
+  MuttLogger = bench_log;
+
+  printf("%-40s %12s %12s %9s %9s\n", "operation", "time_ms", "peak_rss_kb",
+         "messages", "visible");
+  gettimeofday(&total, NULL);
+
+  while ((line = mutt_file_read_line(line, &buflen, fp, &lineno, MUTT_CONT)))
+  {
+    char *p = line;
+    SKIPWS(p);
+    if ((*p == '\0') || (*p == '#'))
+      continue;
+
+    mutt_str_remove_trailing_ws(p);
+
+    char *args = NULL;
+    const struct BenchOp *op = bench_find_op(p, &args);
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    mutt_buffer_reset(err);
+
+    int r;
+    if (op)
+      r = op->func(args, err);
+    else
+      r = mutt_parse_rc_line(p, &token, err);
+
+    double elapsed = bench_elapsed(&start);
+
+    if (r != 0)
+    {
+      if (mutt_buffer_is_empty(err))
+        mutt_buffer_printf(err, _("Operation failed"));
+      mutt_error(_("Error in %s, line %d: %s"), script, lineno, err->data);
+      rc = 1;
+      break;
+    }
+
+    bench_report(p, elapsed);
+  }
+
+  mx_mbox_close(&Context, NULL);
+  if (Context)
+    mutt_context_free(&Context);
+
+  if (rc == 0)
+    bench_report("total", bench_elapsed(&total));
+
+  MuttLogger = old_logger;
+  OptNoPrompt = false;
+
+  FREE(&line);
+  FREE(&token.data);
+  mutt_buffer_free(&err);
+  if (fp != stdin)
+    mutt_file_fclose(&fp);
+
+  return rc;
+}
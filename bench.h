@@ -0,0 +1,28 @@
+/**
+ * @file
+ * Time mailbox operations without the user interface
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_BENCH_H
+#define MUTT_BENCH_H
+
+int mutt_bench_run(const char *script);
+
+#endif /* MUTT_BENCH_H */
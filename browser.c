@@ -741,8 +741,10 @@ static void add_folder(struct Menu *menu, struct BrowserState *state,
   if (state->entrylen == state->entrymax)
   {
     /* need to allocate more space */
-    mutt_mem_realloc(&state->entry, sizeof(struct FolderFile) * (state->entrymax += 256));
-    memset(&state->entry[state->entrylen], 0, sizeof(struct FolderFile) * 256);
+    state->entrymax *= 2;
+    mutt_mem_realloc(&state->entry, sizeof(struct FolderFile) * state->entrymax);
+    memset(&state->entry[state->entrylen], 0,
+           sizeof(struct FolderFile) * (state->entrymax - state->entrylen));
     if (menu)
       menu->data = state->entry;
   }
@@ -900,20 +902,13 @@ static int examine_directory(struct Menu *menu, struct BrowserState *state,
       else if (!S_ISREG(s.st_mode))
         continue;
 
-      struct MailboxNode *np = NULL;
-      STAILQ_FOREACH(np, &AllMailboxes, entries)
+      struct Mailbox *m = mutt_find_mailbox_path(buffer);
+      if (m && Context && (mutt_str_strcmp(m->realpath, Context->mailbox->realpath) == 0))
       {
-        if (mutt_str_strcmp(buffer, np->m->path) != 0)
-          break;
-      }
-
-      if (np && Context &&
-          (mutt_str_strcmp(np->m->realpath, Context->mailbox->realpath) == 0))
-      {
-        np->m->msg_count = Context->mailbox->msg_count;
-        np->m->msg_unread = Context->mailbox->msg_unread;
+        m->msg_count = Context->mailbox->msg_count;
+        m->msg_unread = Context->mailbox->msg_unread;
       }
-      add_folder(menu, state, de->d_name, NULL, &s, np ? np->m : NULL, NULL);
+      add_folder(menu, state, de->d_name, NULL, &s, m, NULL);
     }
     closedir(dp);
   }
@@ -2078,6 +2073,8 @@ void mutt_select_file(char *file, size_t filelen, int flags, char ***files, int
 #ifdef USE_IMAP
         else if (imap_path_probe(LastDir, NULL) == MUTT_IMAP)
         {
+          if (i == OP_CHECK_NEW)
+            imap_list_cache_flush(LastDir);
           init_state(&state, NULL);
           state.imap_browse = true;
           imap_browse(LastDir, &state);
@@ -49,6 +49,8 @@ struct ColorLineHead ColorHdrList = STAILQ_HEAD_INITIALIZER(ColorHdrList);
 struct ColorLineHead ColorIndexAuthorList = STAILQ_HEAD_INITIALIZER(ColorIndexAuthorList);
 struct ColorLineHead ColorIndexFlagsList = STAILQ_HEAD_INITIALIZER(ColorIndexFlagsList);
 struct ColorLineHead ColorIndexList = STAILQ_HEAD_INITIALIZER(ColorIndexList);
+short ColorIndexMemoStatic;  ///< Slots for results that only depend on the email, see mutt_pattern_memo()
+short ColorIndexMemoDynamic; ///< Slots for the other results of ColorIndexList
 struct ColorLineHead ColorIndexSubjectList = STAILQ_HEAD_INITIALIZER(ColorIndexSubjectList);
 struct ColorLineHead ColorIndexTagList = STAILQ_HEAD_INITIALIZER(ColorIndexTagList);
 struct ColorLineHead ColorStatusList = STAILQ_HEAD_INITIALIZER(ColorStatusList);
@@ -185,6 +187,33 @@ static void free_color_line(struct ColorLine *tmp, bool free_colors)
   FREE(&tmp);
 }
 
+/**
+ * reset_index_colors - Make the index recalculate the colours of the emails
+ *
+ * The subpatterns of the index colour rules are numbered again, so the emails'
+ * results of the old rules are dropped, see mutt_set_header_color().
+ */
+static void reset_index_colors(void)
+{
+  struct ColorLine *np = NULL;
+  struct Hash *slots = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+
+  ColorIndexMemoStatic = 0;
+  ColorIndexMemoDynamic = 0;
+  STAILQ_FOREACH(np, &ColorIndexList, entries)
+  {
+    mutt_pattern_memo(np->color_pattern, slots, &ColorIndexMemoStatic,
+                      &ColorIndexMemoDynamic);
+  }
+  mutt_hash_destroy(&slots);
+
+  for (int i = 0; Context && i < Context->mailbox->msg_count; i++)
+  {
+    Context->mailbox->hdrs[i]->pair_valid = false;
+    FREE(&Context->mailbox->hdrs[i]->pair_memo);
+  }
+}
+
 /**
  * ci_start_color - Set up the default colours
  */
@@ -656,8 +685,7 @@ static int parse_uncolor(struct Buffer *buf, struct Buffer *s, unsigned long dat
   {
     mutt_menu_set_redraw_full(MENU_MAIN);
     /* force re-caching of index colors */
-    for (int i = 0; Context && i < Context->mailbox->msg_count; i++)
-      Context->mailbox->hdrs[i]->pair = 0;
+    reset_index_colors();
   }
   return 0;
 }
@@ -786,10 +814,7 @@ static int add_pattern(struct ColorLineHead *top, const char *s, bool sensitive,
 
   /* force re-caching of index colors */
   if (is_index)
-  {
-    for (int i = 0; Context && i < Context->mailbox->msg_count; i++)
-      Context->mailbox->hdrs[i]->pair = 0;
-  }
+    reset_index_colors();
 
   return 0;
 }
@@ -1123,6 +1148,9 @@ static int parse_color(struct Buffer *buf, struct Buffer *s, struct Buffer *err,
     ColorDefs[object] = fgbgattr_to_color(fg, bg, attr);
     if (object > MT_COLOR_INDEX_AUTHOR)
       mutt_menu_set_redraw_full(MENU_MAIN);
+    /* emails matching no index pattern use the normal colour */
+    if (object == MT_COLOR_NORMAL)
+      reset_index_colors();
   }
 
   return r;
@@ -23,7 +23,9 @@
 
 #include "config.h"
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -41,6 +43,7 @@
 #include "filter.h"
 #include "format_flags.h"
 #include "globals.h"
+#include "handler.h"
 #include "hdrline.h"
 #include "hook.h"
 #include "keymap.h"
@@ -83,6 +86,78 @@ static const char *ExtPagerProgress = "all";
 /** The folder the user last saved to.  Used by ci_save_message() */
 static char LastSaveFolder[PATH_MAX] = "";
 
+/**
+ * stream_message - Decode a message for the pager in the background
+ * @param msg     Message to decode
+ * @param e       Email
+ * @param cmflags Flags, see mutt_copy_message_fp()
+ * @param chflags Flags, see mutt_copy_header()
+ * @param fpout   File the pager will display
+ * @param ps      Stream to set up
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * The message is decoded by a child process, which writes it to a pipe.  The
+ * pager appends it to fpout while it's being displayed.
+ */
+static int stream_message(struct Message *msg, struct Email *e, int cmflags,
+                          int chflags, FILE *fpout, struct PagerStream *ps)
+{
+  int fds[2];
+
+  if (pipe(fds) < 0)
+    return -1;
+
+  /* the decoder's autoview results are kept for next time */
+  mutt_autoview_cache_init();
+
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  if (pid == 0)
+  {
+    /* keep away from the terminal, the pager is using it */
+    setsid();
+    int fd = open("/dev/null", O_RDWR);
+    if (fd >= 0)
+    {
+      dup2(fd, 0);
+      dup2(fd, 1);
+      dup2(fd, 2);
+      if (fd > 2)
+        close(fd);
+    }
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    close(fds[0]);
+
+    int rc = -1;
+    char obuf[LONG_STRING];
+    FILE *fp = fdopen(fds[1], "w");
+    if (fp)
+    {
+      /* small writes, so the pager can show the start of the message soon */
+      setvbuf(fp, obuf, _IOFBF, sizeof(obuf));
+      rc = mutt_copy_message_fp(fp, msg->fp, e, cmflags, chflags);
+      if ((fclose(fp) != 0) || ferror(msg->fp))
+        rc = -1;
+    }
+    _exit((rc < 0) ? 1 : 0);
+  }
+
+  close(fds[1]);
+  memset(ps, 0, sizeof(*ps));
+  ps->pid = pid;
+  ps->fd = fds[0];
+  ps->fp = fpout;
+  return 0;
+}
+
 /**
  * mutt_display_message - Display a message in the pager
  * @param cur Header of current message
@@ -99,11 +174,16 @@ int mutt_display_message(struct Email *cur)
   FILE *fpout = NULL;
   FILE *fpfilterout = NULL;
   pid_t filterpid = -1;
+  struct PagerStream stream = { 0 };
+  bool streaming = false;
   int res;
 
   snprintf(buf, sizeof(buf), "%s/%s", TYPE(cur->content), cur->content->subtype);
 
+  /* the message might be fetched partially, because it's only displayed */
+  OptPartialFetch = true;
   mutt_parse_mime_message(Context, cur);
+  OptPartialFetch = false;
   mutt_message_hook(Context, cur, MUTT_MESSAGE_HOOK);
 
   /* see if crypto is needed for this message.  if so, we should exit curses */
@@ -185,9 +265,31 @@ int mutt_display_message(struct Email *cur)
   if (Context->mailbox->magic == MUTT_NOTMUCH)
     chflags |= CH_VIRTUAL;
 #endif
-  res = mutt_copy_message_ctx(fpout, Context, cur, cmflags, chflags);
+  /* crypto updates the email while it's decoded, so it can't go in the background */
+  if (builtin && PagerStream && !fpfilterout && !((WithCrypto != 0) && cur->security) &&
+      cur->content)
+  {
+    OptPartialFetch = true;
+    struct Message *msg = mx_msg_open(Context, cur->msgno);
+    OptPartialFetch = false;
+    if (msg)
+    {
+      /* the decoder has its own copy of the message's file */
+      streaming = (stream_message(msg, cur, cmflags, chflags, fpout, &stream) == 0);
+      mx_msg_close(Context, &msg);
+    }
+  }
+
+  if (streaming)
+    res = 0;
+  else
+  {
+    OptPartialFetch = true;
+    res = mutt_copy_message_ctx(fpout, Context, cur, cmflags, chflags);
+    OptPartialFetch = false;
+  }
 
-  if ((mutt_file_fclose(&fpout) != 0 && errno != EPIPE) || res < 0)
+  if ((!streaming && (mutt_file_fclose(&fpout) != 0) && (errno != EPIPE)) || (res < 0))
   {
     mutt_error(_("Could not copy message"));
     if (fpfilterout)
@@ -212,7 +314,7 @@ int mutt_display_message(struct Email *cur)
 
     /* Remove color cache for this message, in case there
        are color patterns for both ~g and ~V */
-    cur->pair = 0;
+    cur->pair_valid = false;
   }
 
   if (builtin)
@@ -242,11 +344,22 @@ int mutt_display_message(struct Email *cur)
         mutt_message(_("PGP signature could NOT be verified"));
     }
 
+#ifdef USE_IMAP
+    /* read the next messages while this one is shown */
+    if (Context && (Context->mailbox->magic == MUTT_IMAP))
+      imap_prefetch(Context, cur);
+#endif
+
     struct Pager info = { 0 };
     /* Invoke the builtin pager */
     info.email = cur;
     info.ctx = Context;
+    if (streaming)
+      info.stream = &stream;
     rc = mutt_pager(NULL, tempfile, MUTT_PAGER_MESSAGE, &info);
+
+    if (streaming)
+      mutt_file_fclose(&fpout);
   }
   else
   {
@@ -825,6 +938,18 @@ static void set_copy_flags(struct Email *e, bool decode, bool decrypt,
   }
 }
 
+/**
+ * delete_saved - Delete a message that has been saved elsewhere
+ * @param e Email
+ */
+static void delete_saved(struct Email *e)
+{
+  mutt_set_flag(Context, e, MUTT_DELETE, 1);
+  mutt_set_flag(Context, e, MUTT_PURGE, 1);
+  if (DeleteUntag)
+    mutt_set_flag(Context, e, MUTT_TAG, 0);
+}
+
 /**
  * mutt_save_message_ctx - Save a message to a given mailbox
  * @param e       Header of message
@@ -851,12 +976,7 @@ int mutt_save_message_ctx(struct Email *e, bool delete, bool decode,
     return rc;
 
   if (delete)
-  {
-    mutt_set_flag(Context, e, MUTT_DELETE, 1);
-    mutt_set_flag(Context, e, MUTT_PURGE, 1);
-    if (DeleteUntag)
-      mutt_set_flag(Context, e, MUTT_TAG, 0);
-  }
+    delete_saved(e);
 
   return 0;
 }
@@ -987,7 +1107,7 @@ int mutt_save_message(struct Email *e, bool delete, bool decode, bool decrypt)
   }
 #endif
 
-  savectx = mx_mbox_open(buf, MUTT_APPEND);
+  savectx = mx_mbox_open(buf, e ? MUTT_APPEND : (MUTT_APPEND | MUTT_BULK));
   if (savectx)
   {
 #ifdef USE_COMPRESSED
@@ -1034,7 +1154,8 @@ int mutt_save_message(struct Email *e, bool delete, bool decode, bool decrypt)
           continue;
 
         mutt_message_hook(Context, Context->mailbox->hdrs[i], MUTT_MESSAGE_HOOK);
-        rc = mutt_save_message_ctx(Context->mailbox->hdrs[i], delete, decode, decrypt, savectx);
+        /* Only delete the originals once the copies are on disk */
+        rc = mutt_save_message_ctx(Context->mailbox->hdrs[i], false, decode, decrypt, savectx);
         if (rc != 0)
           break;
 #ifdef USE_COMPRESSED
@@ -1053,11 +1174,22 @@ int mutt_save_message(struct Email *e, bool delete, bool decode, bool decrypt)
       if (Context->mailbox->magic == MUTT_NOTMUCH)
         nm_longrun_done(Context->mailbox);
 #endif
+      if (rc == 0)
+        rc = mx_mbox_flush(savectx);
       if (rc != 0)
       {
         mx_mbox_close(&savectx, NULL);
         return -1;
       }
+
+      if (delete)
+      {
+        for (int i = 0; i < Context->mailbox->msg_count; i++)
+        {
+          if (message_is_tagged(Context, i))
+            delete_saved(Context->mailbox->hdrs[i]);
+        }
+      }
     }
 
     const bool need_mailbox_cleanup = ((savectx->mailbox->magic == MUTT_MBOX) ||
@@ -30,6 +30,9 @@
  * Any references to compressed files also apply to encrypted files.
  * - mailbox->path     == plaintext file
  * - mailbox->realpath == compressed file
+ *
+ * If $$compress_stream is set, a mailbox that will only be read may instead be
+ * decompressed as it is read.  Then, both paths name the compressed file.
  */
 
 #include "config.h"
@@ -42,12 +45,14 @@
 #include "mutt/mutt.h"
 #include "config/lib.h"
 #include "compress.h"
+#include "compress_stream.h"
 #include "context.h"
 #include "curs_lib.h"
 #include "format_flags.h"
 #include "globals.h"
 #include "hook.h"
 #include "mailbox.h"
+#include "mbox/mbox.h"
 #include "mutt_curses.h"
 #include "muttlib.h"
 #include "mx.h"
@@ -55,6 +60,9 @@
 
 struct Email;
 
+/* These Config Variables are only used in compress.c */
+bool CompressStream; ///< Config: Read compressed mailboxes without unpacking them
+
 /**
  * struct CompressInfo - Private data for compress
  *
@@ -69,6 +77,7 @@ struct CompressInfo
   const struct MxOps *child_ops; /**< callbacks of de-compressed file */
   bool locked;                   /**< if realpath is locked */
   FILE *lockfp;                  /**< fp used for locking */
+  bool stream;                   /**< decompressed while it's read */
 };
 
 /**
@@ -483,6 +492,57 @@ int mutt_comp_valid_command(const char *cmd)
   return strstr(cmd, "%f") && strstr(cmd, "%t");
 }
 
+/**
+ * open_stream - Read a compressed mailbox without unpacking it
+ * @param ctx Mailbox
+ * @retval  0 Success
+ * @retval -1 Error
+ * @retval -2 The file can't be streamed, the open-hook must be used
+ *
+ * Only mbox and MMDF mailboxes can be read like this.
+ */
+static int open_stream(struct Context *ctx)
+{
+  struct Mailbox *mailbox = ctx->mailbox;
+  struct CompressInfo *ci = mailbox->compress_info;
+
+  FILE *fp = mutt_comp_stream_open(mailbox->path);
+  if (!fp)
+    return -2;
+
+  char buf[8] = { 0 };
+  if (fread(buf, 1, 5, fp) != 5)
+    memset(buf, 0, sizeof(buf));
+
+  if (mutt_str_strncmp(buf, "From ", 5) == 0)
+    mailbox->magic = MUTT_MBOX;
+  else if (mutt_str_strncmp(buf, MMDF_SEP, 5) == 0)
+    mailbox->magic = MUTT_MMDF;
+  else
+  {
+    mutt_debug(1, "%s isn't an mbox or MMDF mailbox\n", mailbox->path);
+    mutt_file_fclose(&fp);
+    return -2;
+  }
+  fseeko(fp, 0, SEEK_SET);
+
+  ci->child_ops = mx_get_ops(mailbox->magic);
+  ci->stream = true;
+  mutt_str_strfcpy(mailbox->realpath, mailbox->path, sizeof(mailbox->realpath));
+  store_size(mailbox);
+
+  if (!lock_realpath(mailbox, false))
+  {
+    mutt_error(_("Unable to lock mailbox"));
+    mutt_file_fclose(&fp);
+    return -1;
+  }
+
+  int rc = mbox_open_stream(ctx, fp);
+  unlock_realpath(mailbox);
+  return rc;
+}
+
 /**
  * comp_mbox_open - Implements MxOps::mbox_open()
  *
@@ -504,6 +564,19 @@ static int comp_mbox_open(struct Context *ctx)
   if (!ci->close || (access(ctx->mailbox->path, W_OK) != 0))
     ctx->mailbox->readonly = true;
 
+  if (CompressStream && ctx->mailbox->readonly)
+  {
+    int rc = open_stream(ctx);
+    if (rc == 0)
+      return 0;
+    if (rc == -1)
+    {
+      free_compress_info(ctx->mailbox);
+      return -1;
+    }
+    ctx->mailbox->magic = MUTT_COMPRESSED;
+  }
+
   if (setup_paths(ctx->mailbox) != 0)
     goto cmo_fail;
   store_size(ctx->mailbox);
@@ -655,6 +728,14 @@ static int comp_mbox_check(struct Context *ctx, int *index_hint)
   if (size == ci->size)
     return 0;
 
+  if (ci->stream)
+  {
+    /* the stream has read part of the old file, and will read the new one */
+    mutt_message(_("%s has changed, reopen it to see the changes"), ctx->mailbox->path);
+    ci->size = size;
+    return 0;
+  }
+
   if (!lock_realpath(ctx->mailbox, false))
   {
     mutt_error(_("Unable to lock mailbox"));
@@ -749,7 +830,11 @@ static int comp_mbox_close(struct Context *ctx)
   ops->mbox_close(ctx);
 
   /* sync has already been called, so we only need to delete some files */
-  if (!ctx->append)
+  if (ci->stream)
+  {
+    /* there's no temporary file */
+  }
+  else if (!ctx->append)
   {
     /* If the file was removed, remove the compressed folder too */
     if ((access(ctx->mailbox->path, F_OK) != 0) && !SaveEmpty)
@@ -795,6 +880,29 @@ static int comp_mbox_close(struct Context *ctx)
   return 0;
 }
 
+/**
+ * comp_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int comp_mbox_flush(struct Context *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  struct CompressInfo *ci = ctx->mailbox->compress_info;
+  if (!ci)
+    return -1;
+
+  const struct MxOps *ops = ci->child_ops;
+  if (!ops)
+    return -1;
+
+  if (!ops->mbox_flush)
+    return 0;
+
+  /* Delegate */
+  return ops->mbox_flush(ctx);
+}
+
 /**
  * comp_msg_open - Implements MxOps::msg_open()
  */
@@ -1024,11 +1132,14 @@ struct MxOps mx_comp_ops = {
   .mbox_check       = comp_mbox_check,
   .mbox_sync        = comp_mbox_sync,
   .mbox_close       = comp_mbox_close,
+  .mbox_flush       = comp_mbox_flush,
   .msg_open         = comp_msg_open,
   .msg_open_new     = comp_msg_open_new,
   .msg_commit       = comp_msg_commit,
   .msg_close        = comp_msg_close,
   .msg_padding_size = comp_msg_padding_size,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = comp_tags_edit,
   .tags_commit      = comp_tags_commit,
   .path_probe       = comp_path_probe,
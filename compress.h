@@ -29,6 +29,9 @@
 
 struct Context;
 
+/* These Config Variables are only used in compress.c */
+extern bool CompressStream;
+
 bool mutt_comp_can_append(struct Mailbox *mailbox);
 bool mutt_comp_can_read(const char *path);
 int mutt_comp_valid_command(const char *cmd);
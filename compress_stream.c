@@ -0,0 +1,657 @@
+/**
+ * @file
+ * Read compressed mailboxes without unpacking them
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page compress_stream Read compressed mailboxes without unpacking them
+ *
+ * A gzip or zstd file is decompressed on the fly, behind a normal stdio
+ * stream, so that the mbox code can read it like any other file.
+ *
+ * Seeking is what makes this work.  While the file is decompressed, restart
+ * points are recorded about every #CS_SPAN bytes of output.  A seek backwards
+ * resumes decompression from the nearest point before the target, so no
+ * message is more than #CS_SPAN bytes of work away.  The most recent output is
+ * also kept, so that the short seeks backwards that the mbox parser makes are
+ * free.
+ *
+ * A gzip point can be anywhere: it holds the state of the bit stream, and the
+ * 32KiB window the following data refers to.  A zstd frame can't be entered in
+ * the middle, so zstd points are frame boundaries.  A file compressed as a
+ * single zstd frame can only be restarted from the beginning.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "mutt/mutt.h"
+#include "compress_stream.h"
+#if defined(HAVE_FOPENCOOKIE) && (defined(HAVE_ZLIB) || defined(HAVE_ZSTD))
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define CS_CHUNK 65536               ///< Bytes of compressed data read at once
+#define CS_WINDOW 32768              ///< Size of the deflate window
+#define CS_SPAN (4 * 1024 * 1024)    ///< Output between restart points
+#define CS_HISTORY (1024 * 1024)     ///< Recent output kept for seeking back
+
+/**
+ * enum CompStreamType - Compression formats that can be streamed
+ */
+enum CompStreamType
+{
+  CS_GZIP, ///< gzip, RFC1952
+  CS_ZSTD, ///< Zstandard, RFC8478
+};
+
+/**
+ * struct CompStreamPoint - A place where decompression can resume
+ */
+struct CompStreamPoint
+{
+  LOFF_T out;            ///< Offset in the decompressed data
+  LOFF_T in;             ///< Offset in the compressed file
+  int bits;              ///< gzip: bits of the byte before `in` still to be used
+  unsigned char *window; ///< gzip: the data before `out`
+};
+
+/**
+ * struct CompStream - State of a decompressing stream
+ */
+struct CompStream
+{
+  FILE *fp;                 ///< Compressed file
+  enum CompStreamType type; ///< Compression format
+  bool eof;                 ///< Decompressor has reached the end
+  bool error;               ///< Decompressor has failed
+  LOFF_T pos;               ///< Offset the decompressor has reached
+  LOFF_T rpos;              ///< Offset the reader has reached, <= pos
+  LOFF_T size;              ///< Size of the decompressed data, or -1
+
+  unsigned char in[CS_CHUNK]; ///< Compressed data
+  size_t in_len;              ///< Bytes in `in`
+  size_t in_used;             ///< Bytes of `in` that have been consumed
+  LOFF_T in_pos;              ///< Offset in the file of the end of `in`
+
+  unsigned char *hist; ///< Ring of the most recent output
+  size_t hist_head;    ///< Where the next byte goes in the ring
+  size_t hist_len;     ///< Bytes in the ring
+
+  struct CompStreamPoint *points; ///< Restart points, by offset
+  size_t num_points;              ///< Number of restart points
+  size_t max_points;              ///< Size of the array
+
+#ifdef HAVE_ZLIB
+  z_stream zs; ///< gzip decompressor
+  bool raw;    ///< Decompressing a raw deflate stream, after a restart
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *zds; ///< zstd decompressor
+#endif
+};
+
+/**
+ * cs_hist_add - Remember some output
+ * @param cs  Stream
+ * @param buf Data
+ * @param len Length of the data
+ */
+static void cs_hist_add(struct CompStream *cs, const unsigned char *buf, size_t len)
+{
+  if (len >= CS_HISTORY)
+  {
+    buf += len - CS_HISTORY;
+    len = CS_HISTORY;
+  }
+
+  const size_t first = MIN(len, CS_HISTORY - cs->hist_head);
+  memcpy(cs->hist + cs->hist_head, buf, first);
+  memcpy(cs->hist, buf + first, len - first);
+  cs->hist_head = (cs->hist_head + len) % CS_HISTORY;
+  cs->hist_len = MIN(cs->hist_len + len, CS_HISTORY);
+}
+
+/**
+ * cs_hist_copy - Copy recent output that precedes the decompressor
+ * @param cs   Stream
+ * @param back How far before cs->pos to start, <= cs->hist_len
+ * @param buf  Buffer for the data
+ * @param len  Bytes to copy, <= back
+ */
+static void cs_hist_copy(struct CompStream *cs, size_t back, unsigned char *buf, size_t len)
+{
+  size_t start = (cs->hist_head + CS_HISTORY - back) % CS_HISTORY;
+  const size_t first = MIN(len, CS_HISTORY - start);
+  memcpy(buf, cs->hist + start, first);
+  memcpy(buf + first, cs->hist, len - first);
+}
+
+/**
+ * cs_fill - Make sure there's compressed data to decode
+ * @param cs Stream
+ * @retval num Bytes available
+ */
+static size_t cs_fill(struct CompStream *cs)
+{
+  if (cs->in_used < cs->in_len)
+    return cs->in_len - cs->in_used;
+
+  cs->in_len = fread(cs->in, 1, sizeof(cs->in), cs->fp);
+  cs->in_used = 0;
+  cs->in_pos += cs->in_len;
+  if (ferror(cs->fp))
+    cs->error = true;
+  return cs->in_len;
+}
+
+/**
+ * cs_add_point - Record a restart point at the current position
+ * @param cs   Stream
+ * @param in   Offset in the compressed file
+ * @param bits gzip: bits left over from the byte before `in`
+ */
+static void cs_add_point(struct CompStream *cs, LOFF_T in, int bits)
+{
+  if (cs->num_points == cs->max_points)
+  {
+    cs->max_points += 64;
+    mutt_mem_realloc(&cs->points, cs->max_points * sizeof(struct CompStreamPoint));
+  }
+
+  struct CompStreamPoint *p = &cs->points[cs->num_points++];
+  p->out = cs->pos;
+  p->in = in;
+  p->bits = bits;
+  p->window = NULL;
+  if (cs->type == CS_GZIP)
+  {
+    /* the window may reach back before the start of the member, which is
+     * harmless: deflate never refers to it */
+    p->window = mutt_mem_calloc(1, CS_WINDOW);
+    const size_t len = MIN(cs->hist_len, CS_WINDOW);
+    cs_hist_copy(cs, len, p->window + CS_WINDOW - len, len);
+  }
+}
+
+/**
+ * cs_want_point - Is it time for a new restart point?
+ * @param cs Stream
+ * @retval true The last point is more than #CS_SPAN bytes back
+ */
+static bool cs_want_point(struct CompStream *cs)
+{
+  const LOFF_T last = cs->num_points ? cs->points[cs->num_points - 1].out : 0;
+  return (cs->pos - last) >= CS_SPAN;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * cs_gzip_next_member - Prepare for another gzip member
+ * @param cs Stream
+ * @retval true Another member follows
+ */
+static bool cs_gzip_next_member(struct CompStream *cs)
+{
+  if (cs->raw)
+  {
+    /* after a restart, the member's trailer isn't consumed by zlib */
+    for (int skip = 8; skip > 0;)
+    {
+      if (cs_fill(cs) == 0)
+        return false;
+      const size_t n = MIN((size_t) skip, cs->in_len - cs->in_used);
+      cs->in_used += n;
+      skip -= n;
+    }
+    cs->raw = false;
+    inflateReset2(&cs->zs, 31);
+  }
+  else
+    inflateReset(&cs->zs);
+
+  /* anything but another gzip header is ignored, like gzip -d does */
+  if ((cs_fill(cs) == 0) || (cs->in[cs->in_used] != 0x1f))
+    return false;
+
+  return true;
+}
+
+/**
+ * cs_gzip_decode - Decompress some gzip data
+ * @param cs  Stream
+ * @param buf Buffer for the output
+ * @param len Size of the buffer
+ * @retval num Bytes of output, 0 at the end
+ */
+static size_t cs_gzip_decode(struct CompStream *cs, unsigned char *buf, size_t len)
+{
+  cs->zs.next_out = buf;
+  cs->zs.avail_out = len;
+
+  while ((cs->zs.avail_out > 0) && !cs->eof && !cs->error)
+  {
+    if (cs_fill(cs) == 0)
+    {
+      /* truncated file */
+      cs->eof = true;
+      break;
+    }
+
+    unsigned char *out = cs->zs.next_out;
+    cs->zs.next_in = cs->in + cs->in_used;
+    cs->zs.avail_in = cs->in_len - cs->in_used;
+
+    int rc = inflate(&cs->zs, Z_BLOCK);
+    cs->in_used = cs->in_len - cs->zs.avail_in;
+
+    const size_t n = cs->zs.next_out - out;
+    cs_hist_add(cs, out, n);
+    cs->pos += n;
+
+    if (rc == Z_STREAM_END)
+    {
+      if (!cs_gzip_next_member(cs))
+        cs->eof = true;
+    }
+    else if ((rc != Z_OK) && (rc != Z_BUF_ERROR))
+    {
+      mutt_debug(1, "inflate failed: %d\n", rc);
+      cs->error = true;
+    }
+    else if ((cs->zs.data_type & 128) && !(cs->zs.data_type & 64) && cs_want_point(cs))
+    {
+      /* at the end of a deflate block, but not the last one */
+      cs_add_point(cs, cs->in_pos - (cs->in_len - cs->in_used), cs->zs.data_type & 7);
+    }
+  }
+
+  return len - cs->zs.avail_out;
+}
+
+/**
+ * cs_gzip_restart - Resume gzip decompression at a restart point
+ * @param cs Stream
+ * @param p  Restart point, NULL for the start of the file
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int cs_gzip_restart(struct CompStream *cs, struct CompStreamPoint *p)
+{
+  if (!p)
+  {
+    cs->raw = false;
+    return (inflateReset2(&cs->zs, 31) == Z_OK) ? 0 : -1;
+  }
+
+  cs->raw = true;
+  if (inflateReset2(&cs->zs, -15) != Z_OK)
+    return -1;
+
+  if (p->bits)
+  {
+    int c = fgetc(cs->fp);
+    if (c == EOF)
+      return -1;
+    cs->in_pos++;
+    inflatePrime(&cs->zs, p->bits, c >> (8 - p->bits));
+  }
+
+  return (inflateSetDictionary(&cs->zs, p->window, CS_WINDOW) == Z_OK) ? 0 : -1;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * cs_zstd_decode - Decompress some zstd data
+ * @param cs  Stream
+ * @param buf Buffer for the output
+ * @param len Size of the buffer
+ * @retval num Bytes of output, 0 at the end
+ */
+static size_t cs_zstd_decode(struct CompStream *cs, unsigned char *buf, size_t len)
+{
+  ZSTD_outBuffer out = { buf, len, 0 };
+
+  while ((out.pos < out.size) && !cs->eof && !cs->error)
+  {
+    if (cs_fill(cs) == 0)
+    {
+      cs->eof = true;
+      break;
+    }
+
+    ZSTD_inBuffer in = { cs->in, cs->in_len, cs->in_used };
+    const size_t before = out.pos;
+    size_t rc = ZSTD_decompressStream(cs->zds, &out, &in);
+    cs->in_used = in.pos;
+
+    const size_t n = out.pos - before;
+    cs_hist_add(cs, buf + before, n);
+    cs->pos += n;
+
+    if (ZSTD_isError(rc))
+    {
+      mutt_debug(1, "ZSTD_decompressStream failed: %s\n", ZSTD_getErrorName(rc));
+      cs->error = true;
+    }
+    else if ((rc == 0) && cs_want_point(cs))
+    {
+      /* a frame has ended */
+      cs_add_point(cs, cs->in_pos - (cs->in_len - cs->in_used), 0);
+    }
+  }
+
+  return out.pos;
+}
+#endif
+
+/**
+ * cs_decode - Decompress some more data
+ * @param cs  Stream
+ * @param buf Buffer for the output
+ * @param len Size of the buffer
+ * @retval num Bytes of output, 0 at the end or on error
+ */
+static size_t cs_decode(struct CompStream *cs, unsigned char *buf, size_t len)
+{
+  size_t n = 0;
+#ifdef HAVE_ZLIB
+  if (cs->type == CS_GZIP)
+    n = cs_gzip_decode(cs, buf, len);
+#endif
+#ifdef HAVE_ZSTD
+  if (cs->type == CS_ZSTD)
+    n = cs_zstd_decode(cs, buf, len);
+#endif
+
+  if (cs->eof && !cs->error)
+    cs->size = cs->pos;
+  return n;
+}
+
+/**
+ * cs_restart - Go back to a restart point
+ * @param cs     Stream
+ * @param target Offset that is wanted
+ * @retval  0 Success, cs->pos <= target
+ * @retval -1 Error
+ */
+static int cs_restart(struct CompStream *cs, LOFF_T target)
+{
+  struct CompStreamPoint *p = NULL;
+  for (size_t i = 0; (i < cs->num_points) && (cs->points[i].out <= target); i++)
+    p = &cs->points[i];
+
+  const LOFF_T in = p ? p->in - (p->bits ? 1 : 0) : 0;
+  if (fseeko(cs->fp, in, SEEK_SET) != 0)
+    return -1;
+
+  cs->in_len = 0;
+  cs->in_used = 0;
+  cs->in_pos = in;
+  cs->eof = false;
+  cs->error = false;
+  cs->pos = p ? p->out : 0;
+  cs->hist_head = 0;
+  cs->hist_len = 0;
+
+  int rc = 0;
+#ifdef HAVE_ZLIB
+  if (cs->type == CS_GZIP)
+  {
+    rc = cs_gzip_restart(cs, p);
+    if (p)
+      cs_hist_add(cs, p->window, CS_WINDOW);
+  }
+#endif
+#ifdef HAVE_ZSTD
+  if (cs->type == CS_ZSTD)
+    rc = ZSTD_isError(ZSTD_initDStream(cs->zds)) ? -1 : 0;
+#endif
+
+  mutt_debug(3, "restart at " OFF_T_FMT " for " OFF_T_FMT "\n", cs->pos, target);
+  return rc;
+}
+
+/**
+ * cs_skip - Decompress and discard data until an offset
+ * @param cs     Stream
+ * @param target Offset to stop at
+ */
+static void cs_skip(struct CompStream *cs, LOFF_T target)
+{
+  unsigned char buf[CS_CHUNK];
+
+  while ((cs->pos < target) && !cs->eof && !cs->error)
+  {
+    size_t len = sizeof(buf);
+    if (target - cs->pos < (LOFF_T) len)
+      len = target - cs->pos;
+    cs_decode(cs, buf, len);
+  }
+}
+
+/**
+ * cs_read - Read from a decompressing stream - Implements cookie_read_function_t
+ */
+static ssize_t cs_read(void *cookie, char *buf, size_t size)
+{
+  struct CompStream *cs = cookie;
+  size_t done = 0;
+
+  while (done < size)
+  {
+    if (cs->rpos < cs->pos)
+    {
+      /* replay recent output */
+      const size_t back = cs->pos - cs->rpos;
+      const size_t n = MIN(back, size - done);
+      cs_hist_copy(cs, back, (unsigned char *) buf + done, n);
+      cs->rpos += n;
+      done += n;
+      continue;
+    }
+
+    const size_t n = cs_decode(cs, (unsigned char *) buf + done, size - done);
+    cs->rpos = cs->pos;
+    done += n;
+    if (n == 0)
+      break;
+  }
+
+  if ((done == 0) && cs->error)
+  {
+    errno = EIO;
+    return -1;
+  }
+  return done;
+}
+
+/**
+ * cs_seek - Move within a decompressing stream - Implements cookie_seek_function_t
+ */
+static int cs_seek(void *cookie, off64_t *offset, int whence)
+{
+  struct CompStream *cs = cookie;
+  LOFF_T target;
+
+  switch (whence)
+  {
+    case SEEK_SET:
+      target = *offset;
+      break;
+    case SEEK_CUR:
+      target = cs->rpos + *offset;
+      break;
+    case SEEK_END:
+      if (cs->size < 0)
+        cs_skip(cs, LLONG_MAX);
+      if (cs->size < 0)
+      {
+        errno = EIO;
+        return -1;
+      }
+      target = cs->size + *offset;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  if (target < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if ((target < cs->pos - (LOFF_T) cs->hist_len) && (cs_restart(cs, target) != 0))
+  {
+    cs->error = true;
+    errno = EIO;
+    return -1;
+  }
+
+  /* beyond the end is allowed, reads will return nothing */
+  cs_skip(cs, target);
+  cs->rpos = MIN(target, cs->pos);
+  *offset = target;
+  return 0;
+}
+
+/**
+ * cs_close - Free a decompressing stream - Implements cookie_close_function_t
+ */
+static int cs_close(void *cookie)
+{
+  struct CompStream *cs = cookie;
+
+#ifdef HAVE_ZLIB
+  if (cs->type == CS_GZIP)
+    inflateEnd(&cs->zs);
+#endif
+#ifdef HAVE_ZSTD
+  if (cs->type == CS_ZSTD)
+    ZSTD_freeDStream(cs->zds);
+#endif
+
+  for (size_t i = 0; i < cs->num_points; i++)
+    FREE(&cs->points[i].window);
+  FREE(&cs->points);
+  FREE(&cs->hist);
+  mutt_file_fclose(&cs->fp);
+  FREE(&cs);
+  return 0;
+}
+
+/**
+ * mutt_comp_stream_open - Open a compressed file for reading
+ * @param path Path of the file
+ * @retval ptr  Stream of the decompressed data
+ * @retval NULL The file isn't in a format that can be streamed
+ *
+ * The stream can only be read, but it can seek anywhere.  Seeking to the end
+ * decompresses the whole file, to find out its size.
+ */
+FILE *mutt_comp_stream_open(const char *path)
+{
+  unsigned char magic[4];
+  enum CompStreamType type;
+
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return NULL;
+
+  if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic))
+    goto fail;
+#ifdef HAVE_ZLIB
+  if ((magic[0] == 0x1f) && (magic[1] == 0x8b))
+    type = CS_GZIP;
+  else
+#endif
+#ifdef HAVE_ZSTD
+  if ((magic[0] == 0x28) && (magic[1] == 0xb5) && (magic[2] == 0x2f) && (magic[3] == 0xfd))
+    type = CS_ZSTD;
+  else
+#endif
+    goto fail;
+
+  if (fseeko(fp, 0, SEEK_SET) != 0)
+    goto fail;
+
+  struct CompStream *cs = mutt_mem_calloc(1, sizeof(struct CompStream));
+  cs->fp = fp;
+  cs->type = type;
+  cs->size = -1;
+  cs->hist = mutt_mem_malloc(CS_HISTORY);
+
+#ifdef HAVE_ZLIB
+  if ((type == CS_GZIP) && (inflateInit2(&cs->zs, 31) != Z_OK))
+  {
+    cs->type = CS_ZSTD; /* nothing to free */
+    cs_close(cs);
+    return NULL;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  if (type == CS_ZSTD)
+  {
+    cs->zds = ZSTD_createDStream();
+    if (!cs->zds || ZSTD_isError(ZSTD_initDStream(cs->zds)))
+    {
+      cs_close(cs);
+      return NULL;
+    }
+  }
+#endif
+
+  cookie_io_functions_t funcs = { cs_read, NULL, cs_seek, cs_close };
+  FILE *stream = fopencookie(cs, "r", funcs);
+  if (!stream)
+    cs_close(cs);
+  return stream;
+
+fail:
+  mutt_file_fclose(&fp);
+  return NULL;
+}
+
+#else
+
+/**
+ * mutt_comp_stream_open - Open a compressed file for reading
+ * @param path Path of the file
+ * @retval NULL NeoMutt was built without support for this
+ */
+FILE *mutt_comp_stream_open(const char *path)
+{
+  return NULL;
+}
+
+#endif
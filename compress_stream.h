@@ -0,0 +1,30 @@
+/**
+ * @file
+ * Read compressed mailboxes without unpacking them
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_COMPRESS_STREAM_H
+#define MUTT_COMPRESS_STREAM_H
+
+#include <stdio.h>
+
+FILE *mutt_comp_stream_open(const char *path);
+
+#endif /* MUTT_COMPRESS_STREAM_H */
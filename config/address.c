@@ -74,6 +74,12 @@ static int address_string_set(const struct ConfigSet *cs, void *var, struct Conf
 
   if (var)
   {
+    if (mutt_addr_cmp_strict(addr, *(struct Address **) var))
+    {
+      address_destroy(cs, &addr, cdef);
+      return CSR_SUCCESS | CSR_SUC_NO_CHANGE;
+    }
+
     if (cdef->validator)
     {
       rc = cdef->validator(cs, cdef, (intptr_t) addr, err);
@@ -167,6 +173,9 @@ static int address_native_set(const struct ConfigSet *cs, void *var,
 
   int rc;
 
+  if (mutt_addr_cmp_strict((struct Address *) value, *(struct Address **) var))
+    return CSR_SUCCESS | CSR_SUC_NO_CHANGE;
+
   if (cdef->validator)
   {
     rc = cdef->validator(cs, cdef, value, err);
@@ -274,7 +283,5 @@ void address_free(struct Address **addr)
   if (!addr || !*addr)
     return; /* LCOV_EXCL_LINE */
 
-  FREE(&(*addr)->personal);
-  FREE(&(*addr)->mailbox);
-  FREE(addr);
+  mutt_addr_free(addr);
 }
@@ -44,6 +44,27 @@ struct ConfigSetType RegisteredTypes[18] = {
   { NULL, NULL, NULL, NULL, NULL, NULL, NULL },
 };
 
+/**
+ * struct ConfigNotify - A notification held back during a batch
+ */
+struct ConfigNotify
+{
+  struct HashElem *he;  ///< Config item that changed
+  const char *name;     ///< Name of the config item
+  enum ConfigEvent ev;  ///< Latest event for the item
+};
+
+/**
+ * struct ConfigBatch - Notifications held back during a batch of changes
+ */
+struct ConfigBatch
+{
+  int depth;                  ///< Nesting level of cs_batch_begin()
+  struct ConfigNotify *items; ///< Config items changed, in order
+  size_t num;                 ///< Number of items
+  size_t max;                 ///< Size of the items array
+};
+
 /**
  * destroy - Callback function for the Hash Table - Implements ::hash_destructor_t
  * @param type Object type, e.g. #DT_STRING
@@ -180,6 +201,9 @@ void cs_free(struct ConfigSet **cs)
     return; /* LCOV_EXCL_LINE */
 
   mutt_hash_destroy(&(*cs)->hash);
+  if ((*cs)->batch)
+    FREE(&(*cs)->batch->items);
+  FREE(&(*cs)->batch);
   FREE(cs);
 }
 
@@ -370,6 +394,46 @@ void cs_remove_listener(struct ConfigSet *cs, cs_listener fn)
   mutt_debug(1, "Listener wasn't registered\n");
 }
 
+/**
+ * cs_batch_begin - Hold back the notifications of changes
+ * @param cs Config items
+ *
+ * Until the matching cs_batch_end(), the listeners aren't told about changes.
+ * Then they're told once for each config item that changed, however often it
+ * was set.  Batches may be nested.
+ */
+void cs_batch_begin(struct ConfigSet *cs)
+{
+  if (!cs)
+    return; /* LCOV_EXCL_LINE */
+
+  if (!cs->batch)
+    cs->batch = mutt_mem_calloc(1, sizeof(*cs->batch));
+  cs->batch->depth++;
+}
+
+/**
+ * cs_batch_end - Send the notifications held back by cs_batch_begin()
+ * @param cs Config items
+ */
+void cs_batch_end(struct ConfigSet *cs)
+{
+  if (!cs || !cs->batch || (cs->batch->depth == 0))
+    return; /* LCOV_EXCL_LINE */
+
+  struct ConfigBatch *batch = cs->batch;
+  if (--batch->depth > 0)
+    return;
+
+  /* Listeners may change other config items, which are notified directly */
+  for (size_t i = 0; i < batch->num; i++)
+  {
+    struct ConfigNotify *cn = &batch->items[i];
+    cs_notify_listeners(cs, cn->he, cn->name, cn->ev);
+  }
+  batch->num = 0;
+}
+
 /**
  * cs_notify_listeners - Notify all listeners of an event
  * @param cs   Config items
@@ -383,6 +447,27 @@ void cs_notify_listeners(const struct ConfigSet *cs, struct HashElem *he,
   if (!cs || !he || !name)
     return; /* LCOV_EXCL_LINE */
 
+  struct ConfigBatch *batch = cs->batch;
+  if (batch && (batch->depth > 0))
+  {
+    for (size_t i = 0; i < batch->num; i++)
+    {
+      if (batch->items[i].he == he)
+      {
+        batch->items[i].ev = ev;
+        return;
+      }
+    }
+
+    if (batch->num == batch->max)
+    {
+      batch->max += 32;
+      mutt_mem_realloc(&batch->items, batch->max * sizeof(*batch->items));
+    }
+    batch->items[batch->num++] = (struct ConfigNotify){ he, name, ev };
+    return;
+  }
+
   for (size_t i = 0; i < mutt_array_size(cs->listeners); i++)
   {
     if (!cs->listeners[i])
@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 struct Buffer;
+struct ConfigBatch;
 struct ConfigSet;
 struct HashElem;
 struct ConfigDef;
@@ -196,6 +197,7 @@ struct ConfigSet
   struct Hash *hash;              /**< HashTable storing the config itesm */
   struct ConfigSetType types[18]; /**< All the defined config types */
   cs_listener listeners[8];       /**< Listeners for notifications of changes to config items */
+  struct ConfigBatch *batch;      /**< Notifications held back by cs_batch_begin() */
 };
 
 struct ConfigSet *cs_create(size_t size);
@@ -210,6 +212,8 @@ bool             cs_register_variables(const struct ConfigSet *cs, struct Config
 struct HashElem *cs_inherit_variable(const struct ConfigSet *cs, struct HashElem *parent, const char *name);
 
 void cs_add_listener(struct ConfigSet *cs, cs_listener fn);
+void cs_batch_begin(struct ConfigSet *cs);
+void cs_batch_end(struct ConfigSet *cs);
 void cs_remove_listener(struct ConfigSet *cs, cs_listener fn);
 void cs_notify_listeners(const struct ConfigSet *cs, struct HashElem *he, const char *name, enum ConfigEvent ev);
 
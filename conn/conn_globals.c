@@ -31,6 +31,7 @@
 #include <stdio.h>
 
 short ConnectTimeout = 0; ///< Config: Timeout for making network connections (-1 to wait indefinitely)
+long SocketBufferSize = 0; ///< Config: Size of the read and write buffers of a network connection
 
 #ifdef USE_SSL
 const char *CertificateFile = NULL; ///< Config: File containing trusted certificates
@@ -27,6 +27,7 @@
 
 /* These variables are backing for config items */
 extern short ConnectTimeout;
+extern long SocketBufferSize;
 
 #ifdef USE_SSL
 extern const char *CertificateFile;
@@ -38,12 +38,18 @@ struct Connection
   unsigned int ssf; /**< security strength factor, in bits */
   void *data; /** mostly Mailbox ptr, else NNTP Server */
 
-  char inbuf[LONG_STRING];
+  char *inbuf;         /**< Data read from the server */
+  size_t inbuf_size;   /**< Size of the inbuf */
   int bufpos;
 
   int fd;
   int available;
 
+  char *outbuf;        /**< Data waiting to be sent, see mutt_socket_cork() */
+  size_t outbuf_size;  /**< Size of the outbuf */
+  size_t outbuf_len;   /**< Amount of data waiting in the outbuf */
+  bool corked;         /**< Writes are held in the outbuf */
+
   TAILQ_ENTRY(Connection) entries;
 
   void *sockdata;
@@ -89,6 +89,87 @@ static int socket_preconnect(void)
   return 0;
 }
 
+/**
+ * socket_send - Write all the data to a socket
+ * @param conn Connection to a server
+ * @param buf  Buffer with data to write
+ * @param len  Length of data to write
+ * @retval >0 Number of bytes written
+ * @retval -1 Error, the socket has been closed
+ */
+static int socket_send(struct Connection *conn, const char *buf, int len)
+{
+  int sent = 0;
+
+  while (sent < len)
+  {
+    const int rc = conn->conn_write(conn, buf + sent, len - sent);
+    if (rc < 0)
+    {
+      mutt_debug(1, "error writing (%s), closing socket\n", strerror(errno));
+      mutt_socket_close(conn);
+
+      return -1;
+    }
+
+    if (rc < len - sent)
+      mutt_debug(3, "short write (%d of %d bytes)\n", rc, len - sent);
+
+    sent += rc;
+  }
+
+  return sent;
+}
+
+/**
+ * socket_flush_out - Send the data waiting in the output buffer
+ * @param conn Connection to a server
+ * @retval  0 Success
+ * @retval -1 Error, the socket has been closed
+ */
+static int socket_flush_out(struct Connection *conn)
+{
+  const size_t len = conn->outbuf_len;
+  if ((len == 0) || (conn->fd < 0))
+    return 0;
+
+  /* empty the buffer first, a failed write closes the socket */
+  conn->outbuf_len = 0;
+  return (socket_send(conn, conn->outbuf, len) < 0) ? -1 : 0;
+}
+
+/**
+ * socket_fill - Refill the read buffer of a socket
+ * @param conn Connection to a server
+ * @retval  0 Success, there's data in the buffer
+ * @retval -1 Error, the socket has been closed
+ */
+static int socket_fill(struct Connection *conn)
+{
+  if (conn->fd < 0)
+  {
+    mutt_debug(1, "attempt to read from closed connection.\n");
+    return -1;
+  }
+
+  if (socket_flush_out(conn) < 0)
+    return -1;
+
+  conn->available = conn->conn_read(conn, conn->inbuf, conn->inbuf_size);
+  conn->bufpos = 0;
+  if (conn->available == 0)
+  {
+    mutt_error(_("Connection to %s closed"), conn->account.host);
+  }
+  if (conn->available <= 0)
+  {
+    conn->available = 0;
+    mutt_socket_close(conn);
+    return -1;
+  }
+  return 0;
+}
+
 /**
  * mutt_socket_open - Simple wrapper
  * @param conn Connection to a server
@@ -123,10 +204,16 @@ int mutt_socket_close(struct Connection *conn)
   if (conn->fd < 0)
     mutt_debug(1, "Attempt to close closed connection.\n");
   else
-    rc = conn->conn_close(conn);
+  {
+    socket_flush_out(conn);
+    if (conn->fd >= 0)
+      rc = conn->conn_close(conn);
+  }
 
   conn->fd = -1;
   conn->ssf = 0;
+  conn->outbuf_len = 0;
+  conn->corked = false;
 
   return rc;
 }
@@ -168,8 +255,6 @@ int mutt_socket_write(struct Connection *conn, const char *buf, size_t len)
  */
 int mutt_socket_write_d(struct Connection *conn, const char *buf, int len, int dbg)
 {
-  int sent = 0;
-
   mutt_debug(dbg, "%d> %s", conn->fd, buf);
 
   if (conn->fd < 0)
@@ -178,24 +263,53 @@ int mutt_socket_write_d(struct Connection *conn, const char *buf, int len, int d
     return -1;
   }
 
-  while (sent < len)
+  if (conn->corked)
   {
-    const int rc = conn->conn_write(conn, buf + sent, len - sent);
-    if (rc < 0)
+    if ((conn->outbuf_len + len) > conn->outbuf_size)
     {
-      mutt_debug(1, "error writing (%s), closing socket\n", strerror(errno));
-      mutt_socket_close(conn);
-
-      return -1;
+      if (socket_flush_out(conn) < 0)
+        return -1;
+    }
+    if (len < conn->outbuf_size)
+    {
+      memcpy(conn->outbuf + conn->outbuf_len, buf, len);
+      conn->outbuf_len += len;
+      return len;
     }
+  }
 
-    if (rc < len - sent)
-      mutt_debug(3, "short write (%d of %d bytes)\n", rc, len - sent);
+  return socket_send(conn, buf, len);
+}
 
-    sent += rc;
+/**
+ * mutt_socket_cork - Hold back the writes to a socket
+ * @param conn Connection to a server
+ *
+ * Until mutt_socket_flush() is called, mutt_socket_write_d() collects the
+ * data and sends it in large blocks.  Anything that's held back is also sent
+ * before the socket is read, polled or closed, so a reply can't be waited for
+ * forever.
+ */
+void mutt_socket_cork(struct Connection *conn)
+{
+  if (!conn->outbuf)
+  {
+    conn->outbuf_size = MAX(SocketBufferSize, LONG_STRING);
+    conn->outbuf = mutt_mem_malloc(conn->outbuf_size);
   }
+  conn->corked = true;
+}
 
-  return sent;
+/**
+ * mutt_socket_flush - Send the writes held back by mutt_socket_cork()
+ * @param conn Connection to a server
+ * @retval  0 Success
+ * @retval -1 Error, the socket has been closed
+ */
+int mutt_socket_flush(struct Connection *conn)
+{
+  conn->corked = false;
+  return socket_flush_out(conn);
 }
 
 /**
@@ -211,6 +325,9 @@ int mutt_socket_poll(struct Connection *conn, time_t wait_secs)
   if (conn->bufpos < conn->available)
     return conn->available - conn->bufpos;
 
+  if (socket_flush_out(conn) < 0)
+    return -1;
+
   if (conn->conn_poll)
     return conn->conn_poll(conn, wait_secs);
 
@@ -226,29 +343,76 @@ int mutt_socket_poll(struct Connection *conn, time_t wait_secs)
  */
 int mutt_socket_readchar(struct Connection *conn, char *c)
 {
+  if ((conn->bufpos >= conn->available) && (socket_fill(conn) < 0))
+    return -1;
+
+  *c = conn->inbuf[conn->bufpos];
+  conn->bufpos++;
+  return 1;
+}
+
+/**
+ * mutt_socket_readbuf - Read a block of data from a socket
+ * @param conn Connection to a server
+ * @param buf  Buffer to store the data
+ * @param len  Number of bytes to read
+ * @retval >0 Success, number of bytes read, at most len
+ * @retval -1 Error
+ *
+ * Like mutt_socket_readchar(), but returns as much as is available, up to
+ * len.  What's left of the read buffer is used first.  Large reads go
+ * straight into buf, rather than being copied through the read buffer.
+ */
+int mutt_socket_readbuf(struct Connection *conn, char *buf, size_t len)
+{
+  if (len == 0)
+    return 0;
+
   if (conn->bufpos >= conn->available)
   {
-    if (conn->fd >= 0)
-      conn->available = conn->conn_read(conn, conn->inbuf, sizeof(conn->inbuf));
-    else
+    if (conn->fd < 0)
     {
       mutt_debug(1, "attempt to read from closed connection.\n");
       return -1;
     }
-    conn->bufpos = 0;
-    if (conn->available == 0)
+
+    if (socket_flush_out(conn) < 0)
+      return -1;
+
+    int n;
+    if (len >= conn->inbuf_size)
+    {
+      n = conn->conn_read(conn, buf, len);
+      conn->bufpos = 0;
+      conn->available = 0;
+    }
+    else
+    {
+      n = conn->conn_read(conn, conn->inbuf, conn->inbuf_size);
+      conn->bufpos = 0;
+      conn->available = n;
+    }
+
+    if (n == 0)
     {
       mutt_error(_("Connection to %s closed"), conn->account.host);
     }
-    if (conn->available <= 0)
+    if (n <= 0)
     {
+      conn->available = 0;
       mutt_socket_close(conn);
       return -1;
     }
+    if (len >= conn->inbuf_size)
+      return n;
   }
-  *c = conn->inbuf[conn->bufpos];
-  conn->bufpos++;
-  return 1;
+
+  size_t n = conn->available - conn->bufpos;
+  if (n > len)
+    n = len;
+  memcpy(buf, conn->inbuf + conn->bufpos, n);
+  conn->bufpos += n;
+  return n;
 }
 
 /**
@@ -262,20 +426,29 @@ int mutt_socket_readchar(struct Connection *conn, char *c)
  */
 int mutt_socket_readln_d(char *buf, size_t buflen, struct Connection *conn, int dbg)
 {
-  char ch;
-  int i;
+  size_t i = 0;
+  bool eol = false;
 
-  for (i = 0; i < buflen - 1; i++)
+  /* copy the line out of the read buffer, a whole slice at a time */
+  while (!eol && (i < (buflen - 1)))
   {
-    if (mutt_socket_readchar(conn, &ch) != 1)
+    if ((conn->bufpos >= conn->available) && (socket_fill(conn) < 0))
     {
       buf[i] = '\0';
       return -1;
     }
 
-    if (ch == '\n')
-      break;
-    buf[i] = ch;
+    const char *start = conn->inbuf + conn->bufpos;
+    size_t n = MIN(conn->available - conn->bufpos, buflen - 1 - i);
+    const char *nl = memchr(start, '\n', n);
+    if (nl)
+    {
+      n = nl - start;
+      eol = true;
+    }
+    memcpy(buf + i, start, n);
+    i += n;
+    conn->bufpos += n + (eol ? 1 : 0);
   }
 
   /* strip \r from \r\n termination */
@@ -298,6 +471,8 @@ struct Connection *mutt_socket_new(enum ConnectionType type)
 {
   struct Connection *conn = mutt_mem_calloc(1, sizeof(struct Connection));
   conn->fd = -1;
+  conn->inbuf_size = MAX(SocketBufferSize, LONG_STRING);
+  conn->inbuf = mutt_mem_malloc(conn->inbuf_size);
 
   if (type == MUTT_CONNECTION_TUNNEL)
   {
@@ -308,7 +483,10 @@ struct Connection *mutt_socket_new(enum ConnectionType type)
     int ret = mutt_ssl_socket_setup(conn);
 
     if (ret < 0)
+    {
+      FREE(&conn->inbuf);
       FREE(&conn);
+    }
   }
   else
   {
@@ -337,6 +515,8 @@ void mutt_socket_free(struct Connection *conn)
     if (np == conn)
     {
       TAILQ_REMOVE(&Connections, np, entries);
+      FREE(&np->inbuf);
+      FREE(&np->outbuf);
       FREE(&np);
       return;
     }
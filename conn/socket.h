@@ -54,10 +54,13 @@ void mutt_socket_free(struct Connection *conn);
 
 int mutt_socket_open(struct Connection *conn);
 int mutt_socket_close(struct Connection *conn);
+void mutt_socket_cork(struct Connection *conn);
+int mutt_socket_flush(struct Connection *conn);
 int mutt_socket_read(struct Connection *conn, char *buf, size_t len);
 int mutt_socket_write(struct Connection *conn, const char *buf, size_t len);
 int mutt_socket_poll(struct Connection *conn, time_t wait_secs);
 int mutt_socket_readchar(struct Connection *conn, char *c);
+int mutt_socket_readbuf(struct Connection *conn, char *buf, size_t len);
 int mutt_socket_readln_d(char *buf, size_t buflen, struct Connection *conn, int dbg);
 int mutt_socket_write_d(struct Connection *conn, const char *buf, int len, int dbg);
 
@@ -95,6 +95,10 @@ static int SkipModeExDataIndex = -1;
  * open up another connection to the same server in this session */
 static STACK_OF(X509) *SslSessionCerts = NULL;
 
+/* TLS sessions of this run, keyed by ssl_session_key().  Resuming one saves
+ * the full handshake when reconnecting to the same server. */
+static struct Hash *SslSessions = NULL;
+
 static int ssl_socket_close(struct Connection *conn);
 
 /**
@@ -1145,6 +1149,98 @@ static int ssl_verify_callback(int preverify_ok, X509_STORE_CTX *ctx)
   return true;
 }
 
+/**
+ * ssl_session_free - Free a cached TLS session - Implements ::hash_destructor_t
+ */
+static void ssl_session_free(int type, void *obj, intptr_t data)
+{
+  SSL_SESSION_free(obj);
+}
+
+/**
+ * ssl_session_key - Generate the cache key for a Connection's TLS session
+ * @param conn   Connection to a server
+ * @param buf    Buffer for the key
+ * @param buflen Length of the buffer
+ *
+ * The client certificate is part of the key, so that changing
+ * $ssl_client_cert forces a full handshake.
+ */
+static void ssl_session_key(struct Connection *conn, char *buf, size_t buflen)
+{
+  snprintf(buf, buflen, "%d:%s@%s:%u:%s", conn->account.type, conn->account.user,
+           conn->account.host, conn->account.port, NONULL(SslClientCert));
+}
+
+/**
+ * ssl_session_save - Remember a Connection's TLS session for reuse
+ * @param conn    Connection to a server
+ * @param ssldata SSL socket data
+ *
+ * This is called when the connection closes, so that any session tickets
+ * sent by a TLSv1.3 server after the handshake are included.
+ */
+static void ssl_session_save(struct Connection *conn, struct SslSockData *ssldata)
+{
+  SSL_SESSION *sess = SSL_get1_session(ssldata->ssl);
+  if (!sess)
+    return;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  if (!SSL_SESSION_is_resumable(sess))
+  {
+    SSL_SESSION_free(sess);
+    return;
+  }
+#endif
+
+  if (!SslSessions)
+  {
+    SslSessions = mutt_hash_create(8, MUTT_HASH_STRDUP_KEYS);
+    mutt_hash_set_destructor(SslSessions, ssl_session_free, 0);
+  }
+
+  char key[LONG_STRING];
+  ssl_session_key(conn, key, sizeof(key));
+  mutt_hash_delete(SslSessions, key, NULL);
+  mutt_hash_insert(SslSessions, key, sess);
+}
+
+/**
+ * ssl_session_forget - Drop a Connection's cached TLS session
+ * @param conn Connection to a server
+ */
+static void ssl_session_forget(struct Connection *conn)
+{
+  if (!SslSessions)
+    return;
+
+  char key[LONG_STRING];
+  ssl_session_key(conn, key, sizeof(key));
+  mutt_hash_delete(SslSessions, key, NULL);
+}
+
+/**
+ * ssl_session_restore - Offer a cached TLS session to the server
+ * @param conn    Connection to a server
+ * @param ssldata SSL socket data
+ *
+ * Sessions are only kept in memory: writing the secrets to disk to resume
+ * across runs isn't worth the exposure.  Early data (0-RTT) isn't used
+ * because it can be replayed.
+ */
+static void ssl_session_restore(struct Connection *conn, struct SslSockData *ssldata)
+{
+  if (!SslSessions)
+    return;
+
+  char key[LONG_STRING];
+  ssl_session_key(conn, key, sizeof(key));
+  SSL_SESSION *sess = mutt_hash_find(SslSessions, key);
+  if (sess && !SSL_set_session(ssldata->ssl, sess))
+    mutt_debug(1, "failed to set the cached TLS session\n");
+}
+
 /**
  * ssl_negotiate - Attempt to negotiate SSL over the wire
  * @param conn    Connection to a server
@@ -1197,6 +1293,8 @@ static int ssl_negotiate(struct Connection *conn, struct SslSockData *ssldata)
     mutt_error(_("Warning: unable to set TLS SNI host name"));
   }
 
+  ssl_session_restore(conn, ssldata);
+
   ERR_clear_error();
 
   err = SSL_connect(ssldata->ssl);
@@ -1215,10 +1313,14 @@ static int ssl_negotiate(struct Connection *conn, struct SslSockData *ssldata)
     }
 
     mutt_error(_("SSL failed: %s"), errmsg);
+    ssl_session_forget(conn);
 
     return -1;
   }
 
+  if (SSL_session_reused(ssldata->ssl))
+    mutt_debug(2, "resumed TLS session with %s\n", conn->account.host);
+
   return 0;
 }
 
@@ -1384,7 +1486,10 @@ static int ssl_socket_close(struct Connection *conn)
   if (data)
   {
     if (data->isopen)
+    {
+      ssl_session_save(conn, data);
       SSL_shutdown(data->ssl);
+    }
 
     /* hold onto this for the life of neomutt, in case we want to reconnect.
      * The purist in me wants a mutt_exit hook. */
@@ -64,6 +64,10 @@
 
 #define CERT_SEP "-----BEGIN"
 
+/* TLS sessions of this run, keyed by tls_session_key().  Resuming one saves
+ * the full handshake when reconnecting to the same server. */
+static struct Hash *TlsSessions = NULL;
+
 static int tls_socket_close(struct Connection *conn);
 
 /**
@@ -996,6 +1000,106 @@ static int tls_set_priority(struct TlsSockData *data)
 }
 #endif
 
+/**
+ * tls_session_free - Free a cached TLS session - Implements ::hash_destructor_t
+ */
+static void tls_session_free(int type, void *obj, intptr_t data)
+{
+  gnutls_datum_t *sess = obj;
+  gnutls_free(sess->data);
+  FREE(&sess);
+}
+
+/**
+ * tls_session_key - Generate the cache key for a Connection's TLS session
+ * @param conn   Connection to a server
+ * @param buf    Buffer for the key
+ * @param buflen Length of the buffer
+ *
+ * The client certificate is part of the key, so that changing
+ * $ssl_client_cert forces a full handshake.
+ */
+static void tls_session_key(struct Connection *conn, char *buf, size_t buflen)
+{
+  snprintf(buf, buflen, "%d:%s@%s:%u:%s", conn->account.type, conn->account.user,
+           conn->account.host, conn->account.port, NONULL(SslClientCert));
+}
+
+/**
+ * tls_session_save - Remember a Connection's TLS session for reuse
+ * @param conn Connection to a server
+ *
+ * This is called when the connection closes, so that any session tickets
+ * sent by a TLSv1.3 server after the handshake are included.
+ */
+static void tls_session_save(struct Connection *conn)
+{
+  struct TlsSockData *data = conn->sockdata;
+
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+  /* a TLSv1.3 session can only be resumed if the server sent a ticket */
+  if ((gnutls_protocol_get_version(data->state) == GNUTLS_TLS1_3) &&
+      !(gnutls_session_get_flags(data->state) & GNUTLS_SFLAGS_SESSION_TICKET))
+  {
+    return;
+  }
+#endif
+
+  gnutls_datum_t *sess = mutt_mem_calloc(1, sizeof(gnutls_datum_t));
+  if (gnutls_session_get_data2(data->state, sess) < 0)
+  {
+    FREE(&sess);
+    return;
+  }
+
+  if (!TlsSessions)
+  {
+    TlsSessions = mutt_hash_create(8, MUTT_HASH_STRDUP_KEYS);
+    mutt_hash_set_destructor(TlsSessions, tls_session_free, 0);
+  }
+
+  char key[LONG_STRING];
+  tls_session_key(conn, key, sizeof(key));
+  mutt_hash_delete(TlsSessions, key, NULL);
+  mutt_hash_insert(TlsSessions, key, sess);
+}
+
+/**
+ * tls_session_forget - Drop a Connection's cached TLS session
+ * @param conn Connection to a server
+ */
+static void tls_session_forget(struct Connection *conn)
+{
+  if (!TlsSessions)
+    return;
+
+  char key[LONG_STRING];
+  tls_session_key(conn, key, sizeof(key));
+  mutt_hash_delete(TlsSessions, key, NULL);
+}
+
+/**
+ * tls_session_restore - Offer a cached TLS session to the server
+ * @param conn Connection to a server
+ *
+ * Sessions are only kept in memory: writing the secrets to disk to resume
+ * across runs isn't worth the exposure.  Early data (0-RTT) isn't used
+ * because it can be replayed.
+ */
+static void tls_session_restore(struct Connection *conn)
+{
+  struct TlsSockData *data = conn->sockdata;
+
+  if (!TlsSessions)
+    return;
+
+  char key[LONG_STRING];
+  tls_session_key(conn, key, sizeof(key));
+  gnutls_datum_t *sess = mutt_hash_find(TlsSessions, key);
+  if (sess && (gnutls_session_set_data(data->state, sess->data, sess->size) < 0))
+    mutt_debug(1, "failed to set the cached TLS session\n");
+}
+
 /**
  * tls_negotiate - Negotiate TLS connection
  * @param conn Connection to a server
@@ -1069,6 +1173,8 @@ static int tls_negotiate(struct Connection *conn)
 
   gnutls_credentials_set(data->state, GNUTLS_CRD_CERTIFICATE, data->xcred);
 
+  tls_session_restore(conn);
+
   err = gnutls_handshake(data->state);
 
   while (err == GNUTLS_E_AGAIN)
@@ -1086,9 +1192,13 @@ static int tls_negotiate(struct Connection *conn)
     {
       mutt_error("gnutls_handshake: %s", gnutls_strerror(err));
     }
+    tls_session_forget(conn);
     goto fail;
   }
 
+  if (gnutls_session_is_resumed(data->state))
+    mutt_debug(2, "resumed TLS session with %s\n", conn->account.host);
+
   if (tls_check_certificate(conn) == 0)
     goto fail;
 
@@ -1209,6 +1319,7 @@ static int tls_socket_close(struct Connection *conn)
      * responding close_notify alert before closing the read side of the
      * connection.
      */
+    tls_session_save(conn);
     gnutls_bye(data->state, GNUTLS_SHUT_WR);
 
     gnutls_certificate_free_credentials(data->xcred);
@@ -0,0 +1,296 @@
+/**
+ * @file
+ * Zlib compression of network traffic
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page conn_zstrm Zlib compression of network traffic
+ *
+ * Stack a raw deflate stream (RFC1951) on top of an existing connection, as
+ * used by IMAP COMPRESS=DEFLATE (RFC4978).
+ *
+ * This uses the same method as the SASL layer: the Connection's methods and
+ * sockdata are replaced with wrappers, which swap the old sockdata back in
+ * while they call the underlying functions.
+ */
+
+#include "config.h"
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "mutt/mutt.h"
+#include "zstrm.h"
+#include "connection.h"
+
+#define ZSTRM_BUFSIZE 8192
+
+/**
+ * struct ZstrmDirection - A stream of data being (de-)compressed
+ */
+struct ZstrmDirection
+{
+  z_stream z;              ///< zlib's state
+  char buf[ZSTRM_BUFSIZE]; ///< Data to or from the underlying connection
+  bool conn_eof;           ///< The underlying connection has closed
+  bool stream_eof;         ///< The compressed stream has ended
+  bool pending;            ///< inflate() may have more output
+};
+
+/**
+ * struct ZstrmSockData - Compression state of a connection
+ */
+struct ZstrmSockData
+{
+  struct ZstrmDirection read;  ///< Data from the server
+  struct ZstrmDirection write; ///< Data to the server
+
+  /* underlying socket data */
+  void *sockdata;
+  int (*next_open) (struct Connection *conn);
+  int (*next_close)(struct Connection *conn);
+  int (*next_read) (struct Connection *conn, char *buf, size_t len);
+  int (*next_write)(struct Connection *conn, const char *buf, size_t count);
+  int (*next_poll) (struct Connection *conn, time_t wait_secs);
+};
+
+/**
+ * zstrm_open - Empty wrapper for the underlying open function - Implements Connection::conn_open()
+ *
+ * The compression is only set up on a connection that's already open.
+ */
+static int zstrm_open(struct Connection *conn)
+{
+  struct ZstrmSockData *zdata = conn->sockdata;
+
+  conn->sockdata = zdata->sockdata;
+  const int rc = zdata->next_open(conn);
+  conn->sockdata = zdata;
+
+  return rc;
+}
+
+/**
+ * zstrm_close - Close a compressed connection - Implements Connection::conn_close()
+ *
+ * Releases the zlib state and restores the connection's underlying methods
+ * before closing it.
+ */
+static int zstrm_close(struct Connection *conn)
+{
+  struct ZstrmSockData *zdata = conn->sockdata;
+
+  mutt_debug(3, "read %lu->%lu (%.1fx), wrote %lu<-%lu (%.1fx)\n",
+             zdata->read.z.total_in, zdata->read.z.total_out,
+             (double) zdata->read.z.total_out / MAX(zdata->read.z.total_in, 1),
+             zdata->write.z.total_in, zdata->write.z.total_out,
+             (double) zdata->write.z.total_in / MAX(zdata->write.z.total_out, 1));
+
+  conn->sockdata = zdata->sockdata;
+  conn->conn_open = zdata->next_open;
+  conn->conn_read = zdata->next_read;
+  conn->conn_write = zdata->next_write;
+  conn->conn_poll = zdata->next_poll;
+  conn->conn_close = zdata->next_close;
+
+  inflateEnd(&zdata->read.z);
+  deflateEnd(&zdata->write.z);
+  FREE(&zdata);
+
+  return conn->conn_close(conn);
+}
+
+/**
+ * zstrm_read - Read compressed data from a connection - Implements Connection::conn_read()
+ */
+static int zstrm_read(struct Connection *conn, char *buf, size_t len)
+{
+  struct ZstrmSockData *zdata = conn->sockdata;
+  struct ZstrmDirection *zr = &zdata->read;
+
+  while (true)
+  {
+    if (zr->stream_eof)
+      return 0;
+
+    /* inflate() may still hold output from the last input */
+    if ((zr->z.avail_in > 0) || zr->pending)
+    {
+      zr->z.next_out = (Bytef *) buf;
+      zr->z.avail_out = len;
+      const int zrc = inflate(&zr->z, Z_SYNC_FLUSH);
+      const int n = len - zr->z.avail_out;
+      zr->pending = (zr->z.avail_out == 0);
+
+      if (zrc == Z_STREAM_END)
+      {
+        zr->stream_eof = true;
+        return n;
+      }
+      if ((zrc != Z_OK) && (zrc != Z_BUF_ERROR))
+      {
+        mutt_debug(1, "inflate failed: %d, %s\n", zrc, NONULL(zr->z.msg));
+        return -1;
+      }
+      if (n > 0)
+        return n;
+    }
+
+    if (zr->conn_eof)
+      return 0;
+
+    /* inflate() needs more input */
+    conn->sockdata = zdata->sockdata;
+    const int rc = zdata->next_read(conn, zr->buf, sizeof(zr->buf));
+    conn->sockdata = zdata;
+    if (rc < 0)
+      return rc;
+    if (rc == 0)
+    {
+      zr->conn_eof = true;
+      continue;
+    }
+
+    zr->z.next_in = (Bytef *) zr->buf;
+    zr->z.avail_in = rc;
+  }
+}
+
+/**
+ * zstrm_write - Write compressed data to a connection - Implements Connection::conn_write()
+ *
+ * Each write is flushed, so that the server sees a whole command.
+ */
+static int zstrm_write(struct Connection *conn, const char *buf, size_t count)
+{
+  struct ZstrmSockData *zdata = conn->sockdata;
+  struct ZstrmDirection *zw = &zdata->write;
+  int rc = count;
+
+  zw->z.next_in = (Bytef *) buf;
+  zw->z.avail_in = count;
+
+  conn->sockdata = zdata->sockdata;
+  do
+  {
+    zw->z.next_out = (Bytef *) zw->buf;
+    zw->z.avail_out = sizeof(zw->buf);
+    const int zrc = deflate(&zw->z, Z_SYNC_FLUSH);
+    if ((zrc != Z_OK) && (zrc != Z_BUF_ERROR))
+    {
+      mutt_debug(1, "deflate failed: %d, %s\n", zrc, NONULL(zw->z.msg));
+      rc = -1;
+      break;
+    }
+
+    const size_t len = sizeof(zw->buf) - zw->z.avail_out;
+    for (size_t sent = 0; sent < len;)
+    {
+      const int n = zdata->next_write(conn, zw->buf + sent, len - sent);
+      if (n <= 0)
+      {
+        rc = -1;
+        goto out;
+      }
+      sent += n;
+    }
+  } while ((zw->z.avail_in > 0) || (zw->z.avail_out == 0));
+
+out:
+  conn->sockdata = zdata;
+  return rc;
+}
+
+/**
+ * zstrm_poll - Check a compressed connection for data - Implements Connection::conn_poll()
+ */
+static int zstrm_poll(struct Connection *conn, time_t wait_secs)
+{
+  struct ZstrmSockData *zdata = conn->sockdata;
+
+  /* data that has already arrived may still be waiting to be inflated */
+  if ((zdata->read.z.avail_in > 0) || zdata->read.pending ||
+      zdata->read.stream_eof || zdata->read.conn_eof)
+    return 1;
+
+  conn->sockdata = zdata->sockdata;
+  const int rc = zdata->next_poll(conn, wait_secs);
+  conn->sockdata = zdata;
+
+  return rc;
+}
+
+/**
+ * mutt_zstrm_wrap_conn - Wrap a compression layer around a Connection
+ * @param conn Connection to a server
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * Everything sent or received on the connection after this, is compressed.
+ * Anything left in the connection's read buffer has already been compressed
+ * by the server, so it's fed to the decompressor first.
+ */
+int mutt_zstrm_wrap_conn(struct Connection *conn)
+{
+  struct ZstrmSockData *zdata = mutt_mem_calloc(1, sizeof(struct ZstrmSockData));
+
+  /* raw deflate streams, without a zlib header */
+  if (inflateInit2(&zdata->read.z, -15) != Z_OK)
+  {
+    FREE(&zdata);
+    return -1;
+  }
+  if (deflateInit2(&zdata->write.z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    inflateEnd(&zdata->read.z);
+    FREE(&zdata);
+    return -1;
+  }
+
+  if (conn->bufpos < conn->available)
+  {
+    const size_t len = MIN(conn->available - conn->bufpos, sizeof(zdata->read.buf));
+    memcpy(zdata->read.buf, conn->inbuf + conn->bufpos, len);
+    zdata->read.z.next_in = (Bytef *) zdata->read.buf;
+    zdata->read.z.avail_in = len;
+    zdata->read.pending = true;
+    conn->bufpos = 0;
+    conn->available = 0;
+  }
+
+  /* preserve old functions */
+  zdata->sockdata = conn->sockdata;
+  zdata->next_open = conn->conn_open;
+  zdata->next_read = conn->conn_read;
+  zdata->next_write = conn->conn_write;
+  zdata->next_poll = conn->conn_poll;
+  zdata->next_close = conn->conn_close;
+
+  /* and set up new functions */
+  conn->sockdata = zdata;
+  conn->conn_open = zstrm_open;
+  conn->conn_read = zstrm_read;
+  conn->conn_write = zstrm_write;
+  conn->conn_poll = zstrm_poll;
+  conn->conn_close = zstrm_close;
+
+  return 0;
+}
@@ -0,0 +1,53 @@
+ unsigned char cc_version[] = {
+  0x63, 0x63, 0x20, 0x28, 0x44, 0x65, 0x62, 0x69, 0x61, 0x6e, 0x20, 0x31, 
+  0x32, 0x2e, 0x32, 0x2e, 0x30, 0x2d, 0x31, 0x34, 0x2b, 0x64, 0x65, 0x62, 
+  0x31, 0x32, 0x75, 0x31, 0x29, 0x20, 0x31, 0x32, 0x2e, 0x32, 0x2e, 0x30, 
+  0x0a, 0x43, 0x6f, 0x70, 0x79, 0x72, 0x69, 0x67, 0x68, 0x74, 0x20, 0x28, 
+  0x43, 0x29, 0x20, 0x32, 0x30, 0x32, 0x32, 0x20, 0x46, 0x72, 0x65, 0x65, 
+  0x20, 0x53, 0x6f, 0x66, 0x74, 0x77, 0x61, 0x72, 0x65, 0x20, 0x46, 0x6f, 
+  0x75, 0x6e, 0x64, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2c, 0x20, 0x49, 0x6e, 
+  0x63, 0x2e, 0x0a, 0x54, 0x68, 0x69, 0x73, 0x20, 0x69, 0x73, 0x20, 0x66, 
+  0x72, 0x65, 0x65, 0x20, 0x73, 0x6f, 0x66, 0x74, 0x77, 0x61, 0x72, 0x65, 
+  0x3b, 0x20, 0x73, 0x65, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x73, 0x6f, 
+  0x75, 0x72, 0x63, 0x65, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x63, 0x6f, 0x70, 
+  0x79, 0x69, 0x6e, 0x67, 0x20, 0x63, 0x6f, 0x6e, 0x64, 0x69, 0x74, 0x69, 
+  0x6f, 0x6e, 0x73, 0x2e, 0x20, 0x20, 0x54, 0x68, 0x65, 0x72, 0x65, 0x20, 
+  0x69, 0x73, 0x20, 0x4e, 0x4f, 0x0a, 0x77, 0x61, 0x72, 0x72, 0x61, 0x6e, 
+  0x74, 0x79, 0x3b, 0x20, 0x6e, 0x6f, 0x74, 0x20, 0x65, 0x76, 0x65, 0x6e, 
+  0x20, 0x66, 0x6f, 0x72, 0x20, 0x4d, 0x45, 0x52, 0x43, 0x48, 0x41, 0x4e, 
+  0x54, 0x41, 0x42, 0x49, 0x4c, 0x49, 0x54, 0x59, 0x20, 0x6f, 0x72, 0x20, 
+  0x46, 0x49, 0x54, 0x4e, 0x45, 0x53, 0x53, 0x20, 0x46, 0x4f, 0x52, 0x20, 
+  0x41, 0x20, 0x50, 0x41, 0x52, 0x54, 0x49, 0x43, 0x55, 0x4c, 0x41, 0x52, 
+  0x20, 0x50, 0x55, 0x52, 0x50, 0x4f, 0x53, 0x45, 0x2e, 0x0a, 0x00
+};
+ unsigned char cc_cflags[] = {
+  0x2d, 0x67, 0x20, 0x2d, 0x4f, 0x32, 0x20, 0x2d, 0x73, 0x74, 0x64, 0x3d, 
+  0x63, 0x39, 0x39, 0x20, 0x2d, 0x44, 0x5f, 0x41, 0x4c, 0x4c, 0x5f, 0x53, 
+  0x4f, 0x55, 0x52, 0x43, 0x45, 0x3d, 0x31, 0x20, 0x2d, 0x44, 0x5f, 0x47, 
+  0x4e, 0x55, 0x5f, 0x53, 0x4f, 0x55, 0x52, 0x43, 0x45, 0x3d, 0x31, 0x20, 
+  0x2d, 0x44, 0x5f, 0x5f, 0x45, 0x58, 0x54, 0x45, 0x4e, 0x53, 0x49, 0x4f, 
+  0x4e, 0x53, 0x5f, 0x5f, 0x20, 0x2d, 0x44, 0x4e, 0x43, 0x55, 0x52, 0x53, 
+  0x45, 0x53, 0x5f, 0x57, 0x49, 0x44, 0x45, 0x43, 0x48, 0x41, 0x52, 0x20, 
+  0x20, 0x2d, 0x49, 0x2f, 0x75, 0x73, 0x72, 0x2f, 0x69, 0x6e, 0x63, 0x6c, 
+  0x75, 0x64, 0x65, 0x20, 0x2d, 0x49, 0x2f, 0x74, 0x6d, 0x70, 0x2f, 0x67, 
+  0x64, 0x62, 0x6d, 0x2f, 0x69, 0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 
+  0x2d, 0x49, 0x2f, 0x74, 0x6d, 0x70, 0x2f, 0x6c, 0x7a, 0x34, 0x2f, 0x69, 
+  0x6e, 0x63, 0x6c, 0x75, 0x64, 0x65, 0x20, 0x2d, 0x49, 0x2f, 0x74, 0x6d, 
+  0x70, 0x2f, 0x7a, 0x73, 0x74, 0x64, 0x2f, 0x69, 0x6e, 0x63, 0x6c, 0x75, 
+  0x64, 0x65, 0x00
+};
+ unsigned char configure_options[] = {
+  0x2d, 0x2d, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x2d, 0x6e, 0x6c, 
+  0x73, 0x20, 0x2d, 0x2d, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x2d, 
+  0x64, 0x6f, 0x63, 0x20, 0x2d, 0x2d, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 
+  0x65, 0x2d, 0x69, 0x64, 0x6e, 0x20, 0x2d, 0x2d, 0x73, 0x73, 0x6c, 0x20, 
+  0x2d, 0x2d, 0x67, 0x64, 0x62, 0x6d, 0x20, 0x2d, 0x2d, 0x77, 0x69, 0x74, 
+  0x68, 0x2d, 0x67, 0x64, 0x62, 0x6d, 0x3d, 0x2f, 0x74, 0x6d, 0x70, 0x2f, 
+  0x67, 0x64, 0x62, 0x6d, 0x20, 0x2d, 0x2d, 0x6c, 0x7a, 0x34, 0x20, 0x2d, 
+  0x2d, 0x77, 0x69, 0x74, 0x68, 0x2d, 0x6c, 0x7a, 0x34, 0x3d, 0x2f, 0x74, 
+  0x6d, 0x70, 0x2f, 0x6c, 0x7a, 0x34, 0x20, 0x2d, 0x2d, 0x7a, 0x73, 0x74, 
+  0x64, 0x20, 0x2d, 0x2d, 0x77, 0x69, 0x74, 0x68, 0x2d, 0x7a, 0x73, 0x74, 
+  0x64, 0x3d, 0x2f, 0x74, 0x6d, 0x70, 0x2f, 0x7a, 0x73, 0x74, 0x64, 0x20, 
+  0x2d, 0x2d, 0x7a, 0x6c, 0x69, 0x62, 0x00
+};
+
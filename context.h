@@ -39,6 +39,7 @@ struct Context
   struct Email *last_tag;  /**< last tagged msg. used to link threads */
   struct MuttThread *tree;  /**< top of thread tree */
   struct Hash *thread_hash; /**< hash table for threading */
+  struct ThreadArena *thread_arena; /**< storage for the thread nodes */
   int tagged;               /**< how many messages are tagged? */
   int new;                  /**< how many new messages? */
   int deleted;              /**< how many deleted messages */
@@ -50,6 +51,7 @@ struct Context
   bool append : 1;    /**< mailbox is opened in append mode */
   bool collapsed : 1; /**< are all threads collapsed? */
   bool peekonly : 1;  /**< just taking a glance, revert atime */
+  bool bulk : 1;      /**< appending many messages, see mx_mbox_flush() */
 
   struct Mailbox *mailbox;
 };
@@ -0,0 +1,520 @@
+/**
+ * @file
+ * Header cache benchmark
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hcache_bench Header cache benchmark
+ *
+ * Time the header cache, without the user interface.
+ *
+ * A corpus of emails is either read from a maildir, or generated.  For every
+ * backend, the emails are serialised (mutt_hcache_dump()), stored, fetched
+ * and restored again (mutt_hcache_restore()).  Throughput, latencies and the
+ * size of the database are reported as JSON on stdout.
+ */
+
+#include "config.h"
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "mutt/mutt.h"
+#include "email/lib.h"
+#include "hcache/hcache.h"
+#include "hcache/serialize.h"
+
+/* libhcache needs these from NeoMutt proper */
+char *HeaderCachePagesize = "16384";
+bool HeaderCacheCompress = true;
+
+/**
+ * mutt_encode_path - Convert a path into the user's preferred character set
+ * @param buf    Buffer for the result
+ * @param buflen Length of the buffer
+ * @param src    Path to convert (OPTIONAL)
+ *
+ * The benchmark only uses plain ASCII paths, so they're simply copied.
+ */
+void mutt_encode_path(char *buf, size_t buflen, const char *src)
+{
+  if (buf != src)
+    mutt_str_strfcpy(buf, src, buflen);
+}
+
+/**
+ * struct BenchCorpus - The emails to run the benchmark on
+ */
+struct BenchCorpus
+{
+  struct Email **emails; ///< Emails
+  char **keys;           ///< Header cache key of each Email
+  int count;             ///< Number of emails
+  int max;               ///< Size of the arrays
+};
+
+/**
+ * struct BenchPhase - The results of timing one operation
+ */
+struct BenchPhase
+{
+  const char *name; ///< Name of the operation, e.g. "store"
+  double *usec;     ///< Latency of each call, in microseconds
+  int count;        ///< Number of calls
+  double total;     ///< Total time taken, in microseconds
+};
+
+static int Printed = 0; ///< Number of results written so far
+
+/**
+ * now_usec - Get the current time
+ * @retval num Microseconds since the epoch
+ */
+static double now_usec(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000000.0) + tv.tv_usec;
+}
+
+/**
+ * corpus_add - Add an Email to the corpus
+ * @param c   Corpus
+ * @param e   Email
+ * @param key Header cache key
+ */
+static void corpus_add(struct BenchCorpus *c, struct Email *e, const char *key)
+{
+  if (c->count == c->max)
+  {
+    c->max = c->max ? (c->max * 2) : 1024;
+    mutt_mem_realloc(&c->emails, c->max * sizeof(struct Email *));
+    mutt_mem_realloc(&c->keys, c->max * sizeof(char *));
+  }
+
+  c->emails[c->count] = e;
+  c->keys[c->count] = mutt_str_strdup(key);
+  c->count++;
+}
+
+/**
+ * corpus_read_dir - Read the emails from one maildir subdirectory
+ * @param c    Corpus
+ * @param dir  Directory, e.g. "Maildir/cur"
+ * @param max  Maximum number of emails in the corpus, 0 for no limit
+ */
+static void corpus_read_dir(struct BenchCorpus *c, const char *dir, int max)
+{
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+
+  char path[PATH_MAX];
+  struct dirent *de = NULL;
+  while ((de = readdir(d)) && ((max == 0) || (c->count < max)))
+  {
+    if (de->d_name[0] == '.')
+      continue;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+      continue;
+
+    struct Email *e = mutt_email_new();
+    e->env = mutt_rfc822_read_header(fp, e, false, false);
+    mutt_file_fclose(&fp);
+
+    corpus_add(c, e, de->d_name);
+  }
+
+  closedir(d);
+}
+
+/**
+ * corpus_generate - Create some synthetic emails
+ * @param c     Corpus
+ * @param count Number of emails to create
+ */
+static void corpus_generate(struct BenchCorpus *c, int count)
+{
+  char buf[LONG_STRING];
+
+  for (int i = 0; i < count; i++)
+  {
+    struct Email *e = mutt_email_new();
+    e->env = mutt_env_new();
+    e->content = mutt_body_new();
+
+    snprintf(buf, sizeof(buf), "User %d <user%d@example.com>", i % 97, i % 97);
+    e->env->from = mutt_addr_parse_list(NULL, buf);
+    e->env->to = mutt_addr_parse_list(NULL, "List <list@example.org>");
+    snprintf(buf, sizeof(buf), "Re: Discussion of topic number %d", i / 10);
+    e->env->subject = mutt_str_strdup(buf);
+    e->env->real_subj = e->env->subject + 4;
+    snprintf(buf, sizeof(buf), "<%d.%d@example.com>", i, i % 97);
+    e->env->message_id = mutt_str_strdup(buf);
+    if (i % 10)
+    {
+      snprintf(buf, sizeof(buf), "<%d.%d@example.com>", i - 1, (i - 1) % 97);
+      mutt_list_insert_tail(&e->env->references, mutt_str_strdup(buf));
+    }
+
+    e->content->type = TYPE_TEXT;
+    e->content->subtype = mutt_str_strdup("plain");
+    e->content->encoding = ENC_8BIT;
+    e->content->length = 1000 + (i % 5000);
+    struct Parameter *np = mutt_param_new();
+    np->attribute = mutt_str_strdup("charset");
+    np->value = mutt_str_strdup("utf-8");
+    TAILQ_INSERT_TAIL(&e->content->parameter, np, entries);
+
+    e->date_sent = 1500000000 + (i * 60);
+    e->received = e->date_sent + 5;
+    e->lines = 20 + (i % 200);
+
+    snprintf(buf, sizeof(buf), "msg%d", i);
+    corpus_add(c, e, buf);
+  }
+}
+
+/**
+ * corpus_free - Free the corpus
+ * @param c Corpus
+ */
+static void corpus_free(struct BenchCorpus *c)
+{
+  for (int i = 0; i < c->count; i++)
+  {
+    mutt_email_free(&c->emails[i]);
+    FREE(&c->keys[i]);
+  }
+  FREE(&c->emails);
+  FREE(&c->keys);
+}
+
+/**
+ * cmp_double - Compare two doubles - Implements ::sort_t
+ */
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * phase_init - Prepare to time an operation
+ * @param p     Phase
+ * @param name  Name of the operation
+ * @param count Number of calls that will be made
+ */
+static void phase_init(struct BenchPhase *p, const char *name, int count)
+{
+  p->name = name;
+  p->usec = mutt_mem_calloc(count ? count : 1, sizeof(double));
+  p->count = 0;
+  p->total = 0;
+}
+
+/**
+ * phase_print - Write the results of an operation as JSON
+ * @param p    Phase
+ * @param last true if this is the last phase of the backend
+ */
+static void phase_print(struct BenchPhase *p, bool last)
+{
+  double p50 = 0, p99 = 0;
+  if (p->count > 0)
+  {
+    qsort(p->usec, p->count, sizeof(double), cmp_double);
+    p50 = p->usec[p->count / 2];
+    p99 = p->usec[MIN(p->count - 1, (p->count * 99) / 100)];
+  }
+
+  printf("        \"%s\": { \"ops\": %d, \"ops_per_sec\": %.0f, "
+         "\"p50_us\": %.2f, \"p99_us\": %.2f }%s\n",
+         p->name, p->count, (p->total > 0) ? (p->count * 1e6 / p->total) : 0,
+         p50, p99, last ? "" : ",");
+
+  FREE(&p->usec);
+}
+
+/**
+ * file_size - Get the size of a database
+ * @param path  Database path
+ * @param compr Compression method, may be NULL
+ * @retval num Size in bytes
+ */
+static long long file_size(const char *path, const char *compr)
+{
+  char buf[PATH_MAX];
+  struct stat sb;
+
+  if (compr && *compr)
+    snprintf(buf, sizeof(buf), "%s-%s", path, compr);
+  else
+    mutt_str_strfcpy(buf, path, sizeof(buf));
+
+  if (stat(buf, &sb) != 0)
+    return -1;
+  return sb.st_size;
+}
+
+/**
+ * remove_db - Delete a database and its lock files
+ * @param path  Database path
+ * @param compr Compression method, may be NULL
+ */
+static void remove_db(const char *path, const char *compr)
+{
+  char buf[PATH_MAX];
+
+  if (compr && *compr)
+    snprintf(buf, sizeof(buf), "%s-%s", path, compr);
+  else
+    mutt_str_strfcpy(buf, path, sizeof(buf));
+
+  unlink(buf);
+  mutt_str_strcat(buf, sizeof(buf), "-lock");
+  unlink(buf);
+}
+
+/**
+ * bench_backend - Run the benchmark against one backend
+ * @param backend Name of the backend
+ * @param dir     Directory for the database
+ * @param c       Corpus
+ * @retval true Success
+ */
+static bool bench_backend(const char *backend, const char *dir, struct BenchCorpus *c)
+{
+  char path[PATH_MAX];
+  struct BenchPhase dump, store, fetch, restore;
+  void **blobs = mutt_mem_calloc(c->count ? c->count : 1, sizeof(void *));
+  int *lens = mutt_mem_calloc(c->count ? c->count : 1, sizeof(int));
+  double t0, t1;
+  bool rc = false;
+
+  HeaderCacheBackend = (char *) backend;
+  snprintf(path, sizeof(path), "%s/hcache-bench-%s", dir, backend);
+  remove_db(path, HeaderCacheCompressMethod);
+
+  header_cache_t *hc = mutt_hcache_open(path, "bench", NULL);
+  if (!hc)
+  {
+    fprintf(stderr, "can't open %s\n", path);
+    goto done;
+  }
+
+  phase_init(&dump, "dump", c->count);
+  for (int i = 0; i < c->count; i++)
+  {
+    t0 = now_usec();
+    blobs[i] = mutt_hcache_dump(hc, c->emails[i], &lens[i], 0);
+    t1 = now_usec();
+    dump.usec[dump.count++] = t1 - t0;
+    dump.total += t1 - t0;
+  }
+
+  phase_init(&store, "store", c->count);
+  t0 = now_usec();
+  mutt_hcache_begin(hc);
+  for (int i = 0; i < c->count; i++)
+  {
+    double s = now_usec();
+    mutt_hcache_store_raw(hc, c->keys[i], mutt_str_strlen(c->keys[i]), blobs[i], lens[i]);
+    store.usec[store.count++] = now_usec() - s;
+  }
+  mutt_hcache_commit(hc);
+  store.total = now_usec() - t0;
+
+  mutt_hcache_close(hc);
+  mutt_hcache_close_all();
+
+  hc = mutt_hcache_open(path, "bench", NULL);
+  if (!hc)
+  {
+    fprintf(stderr, "can't reopen %s\n", path);
+    FREE(&dump.usec);
+    FREE(&store.usec);
+    goto done;
+  }
+
+  phase_init(&fetch, "fetch", c->count);
+  phase_init(&restore, "restore", c->count);
+  int missing = 0;
+  for (int i = 0; i < c->count; i++)
+  {
+    t0 = now_usec();
+    void *data = mutt_hcache_fetch(hc, c->keys[i], mutt_str_strlen(c->keys[i]));
+    t1 = now_usec();
+    fetch.usec[fetch.count++] = t1 - t0;
+    fetch.total += t1 - t0;
+    if (!data)
+    {
+      missing++;
+      continue;
+    }
+
+    t0 = now_usec();
+    struct Email *e = mutt_hcache_restore(data);
+    t1 = now_usec();
+    restore.usec[restore.count++] = t1 - t0;
+    restore.total += t1 - t0;
+
+    mutt_email_free(&e);
+    mutt_hcache_free(hc, &data);
+  }
+
+  mutt_hcache_close(hc);
+  mutt_hcache_close_all();
+
+  printf("%s    {\n", Printed++ ? ",\n" : "");
+  printf("      \"backend\": \"%s\",\n", backend);
+  printf("      \"compression\": \"%s\",\n",
+         HeaderCacheCompressMethod ? HeaderCacheCompressMethod : "none");
+  printf("      \"file_size\": %lld,\n", file_size(path, HeaderCacheCompressMethod));
+  printf("      \"missing\": %d,\n", missing);
+  printf("      \"phases\": {\n");
+  phase_print(&dump, false);
+  phase_print(&store, false);
+  phase_print(&fetch, false);
+  phase_print(&restore, true);
+  printf("      }\n");
+  printf("    }");
+  rc = true;
+
+done:
+  for (int i = 0; i < c->count; i++)
+    FREE(&blobs[i]);
+  FREE(&blobs);
+  FREE(&lens);
+  return rc;
+}
+
+/**
+ * usage - Display the command line options
+ */
+static void usage(void)
+{
+  puts("usage: hcache-bench [-b backends] [-c method] [-l level] [-d dir]\n"
+       "                    [-m maildir] [-n count]\n"
+       "\n"
+       "  -b  Comma-separated list of backends (default: all)\n"
+       "  -c  Compression method (default: none)\n"
+       "  -l  Compression level\n"
+       "  -d  Directory for the databases (default: .)\n"
+       "  -m  Read the emails from a maildir\n"
+       "  -n  Number of emails (default: 10000, or all of the maildir)");
+}
+
+/**
+ * main - Run the header cache benchmark
+ */
+int main(int argc, char *argv[])
+{
+  const char *dir = ".";
+  const char *maildir = NULL;
+  char *backends = NULL;
+  int count = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:c:d:l:m:n:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b':
+        mutt_str_replace(&backends, optarg);
+        break;
+      case 'c':
+        if (!mutt_hcache_is_valid_compression(optarg))
+        {
+          fprintf(stderr, "unknown compression method: %s\n", optarg);
+          return 1;
+        }
+        HeaderCacheCompressMethod = optarg;
+        break;
+      case 'd':
+        dir = optarg;
+        break;
+      case 'l':
+        HeaderCacheCompressLevel = atoi(optarg);
+        break;
+      case 'm':
+        maildir = optarg;
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      default:
+        usage();
+        return (opt == 'h') ? 0 : 1;
+    }
+  }
+
+  if (!backends)
+    backends = (char *) mutt_hcache_backend_list();
+
+  struct BenchCorpus corpus = { 0 };
+  if (maildir)
+  {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cur", maildir);
+    corpus_read_dir(&corpus, path, count);
+    snprintf(path, sizeof(path), "%s/new", maildir);
+    corpus_read_dir(&corpus, path, count);
+  }
+  else
+    corpus_generate(&corpus, count ? count : 10000);
+
+  int n = 0;
+  char *names[32];
+  for (char *tok = strtok(backends, ", "); tok && (n < mutt_array_size(names));
+       tok = strtok(NULL, ", "))
+  {
+    if (!mutt_hcache_is_valid_backend(tok))
+    {
+      fprintf(stderr, "unknown backend: %s\n", tok);
+      continue;
+    }
+    names[n++] = tok;
+  }
+
+  printf("{\n");
+  printf("  \"emails\": %d,\n", corpus.count);
+  printf("  \"results\": [\n");
+  int rc = 0;
+  for (int i = 0; i < n; i++)
+    if (!bench_backend(names[i], dir, &corpus))
+      rc = 1;
+  printf("\n  ]\n");
+  printf("}\n");
+
+  corpus_free(&corpus);
+  FREE(&backends);
+  return rc;
+}
@@ -0,0 +1,691 @@
+/**
+ * @file
+ * Library benchmark
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page lib_bench Library benchmark
+ *
+ * Time the hot functions of libmutt and libemail, without the user interface.
+ *
+ * A corpus of emails is either read from a maildir, or generated.  Each
+ * benchmark runs one function over the whole corpus, e.g. parsing every
+ * header, or every address list.  Throughput and latencies are reported as
+ * JSON on stdout.
+ */
+
+#include "config.h"
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mutt/mutt.h"
+#include "email/lib.h"
+
+/**
+ * struct BenchCorpus - The emails to run the benchmark on
+ */
+struct BenchCorpus
+{
+  char **texts;  ///< Header of each email, up to and including the blank line
+  size_t *lens;  ///< Length of each text
+  int count;     ///< Number of emails
+  int max;       ///< Size of the arrays
+};
+
+/**
+ * struct BenchStrings - Header fields collected from the corpus
+ */
+struct BenchStrings
+{
+  char **strs; ///< Strings
+  int count;   ///< Number of strings
+  int max;     ///< Size of the array
+};
+
+/**
+ * struct BenchPhase - The results of timing one function
+ */
+struct BenchPhase
+{
+  const char *name; ///< Name of the function, e.g. "rfc2047_decode"
+  double *usec;     ///< Latency of each call, in microseconds
+  int count;        ///< Number of calls
+  int max;          ///< Size of the latency array
+  double total;     ///< Total time taken, in microseconds
+};
+
+static int Printed = 0; ///< Number of results written so far
+
+/**
+ * now_usec - Get the current time
+ * @retval num Microseconds, from an arbitrary starting point
+ */
+static double now_usec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec * 1000000.0) + (ts.tv_nsec / 1000.0);
+}
+
+/**
+ * corpus_add - Add an email to the corpus
+ * @param c    Corpus
+ * @param text Text of the email
+ * @param len  Length of the text
+ *
+ * Only the header is kept.
+ */
+static void corpus_add(struct BenchCorpus *c, const char *text, size_t len)
+{
+  if (c->count == c->max)
+  {
+    c->max = c->max ? (c->max * 2) : 1024;
+    mutt_mem_realloc(&c->texts, c->max * sizeof(char *));
+    mutt_mem_realloc(&c->lens, c->max * sizeof(size_t));
+  }
+
+  for (size_t i = 0; i + 1 < len; i++)
+  {
+    if ((text[i] == '\n') && ((text[i + 1] == '\n') ||
+                              ((text[i + 1] == '\r') && (i + 2 < len) && (text[i + 2] == '\n'))))
+    {
+      len = i + ((text[i + 1] == '\r') ? 3 : 2);
+      break;
+    }
+  }
+
+  c->texts[c->count] = mutt_str_substr_dup(text, text + len);
+  c->lens[c->count] = len;
+  c->count++;
+}
+
+/**
+ * corpus_read_dir - Read the emails from one maildir subdirectory
+ * @param c    Corpus
+ * @param dir  Directory, e.g. "Maildir/cur"
+ * @param max  Maximum number of emails in the corpus, 0 for no limit
+ */
+static void corpus_read_dir(struct BenchCorpus *c, const char *dir, int max)
+{
+  DIR *d = opendir(dir);
+  if (!d)
+    return;
+
+  char path[PATH_MAX];
+  char *buf = mutt_mem_malloc(HUGE_STRING);
+  struct dirent *de = NULL;
+  while ((de = readdir(d)) && ((max == 0) || (c->count < max)))
+  {
+    if (de->d_name[0] == '.')
+      continue;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+      continue;
+
+    size_t len = fread(buf, 1, HUGE_STRING, fp);
+    mutt_file_fclose(&fp);
+    corpus_add(c, buf, len);
+  }
+
+  FREE(&buf);
+  closedir(d);
+}
+
+/**
+ * corpus_generate - Create some synthetic emails
+ * @param c     Corpus
+ * @param count Number of emails to create
+ *
+ * The emails have the mix of headers that a mailing list folder usually has:
+ * several recipients, encoded subjects and long References.
+ */
+static void corpus_generate(struct BenchCorpus *c, int count)
+{
+  static const char *days[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+  static const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+  struct Buffer *buf = mutt_buffer_alloc(HUGE_STRING);
+
+  for (int i = 0; i < count; i++)
+  {
+    mutt_buffer_reset(buf);
+    mutt_buffer_add_printf(buf, "Return-Path: <user%d@example.com>\n", i % 97);
+    mutt_buffer_add_printf(buf, "Received: from mx%d.example.com (mx%d.example.com [192.0.2.%d])\n"
+                                "\tby mail.example.org with ESMTPS id %08x\n"
+                                "\tfor <list@example.org>; %s, %d %s 2018 %02d:%02d:%02d +0000\n",
+                           i % 7, i % 7, i % 250, i, days[i % 7], 1 + (i % 28),
+                           months[i % 12], i % 24, i % 60, (i * 7) % 60);
+    mutt_buffer_add_printf(buf, "Date: %s, %d %s 2018 %02d:%02d:%02d %+05d\n",
+                           days[i % 7], 1 + (i % 28), months[i % 12], i % 24,
+                           (i * 3) % 60, (i * 7) % 60, ((i % 5) - 2) * 100);
+    if (i % 3)
+      mutt_buffer_add_printf(buf, "From: User %d <user%d@example.com>\n", i % 97, i % 97);
+    else
+      mutt_buffer_add_printf(buf, "From: =?UTF-8?Q?J=C3=BCrgen_M=C3=BCller_%d?= <user%d@example.com>\n",
+                             i % 97, i % 97);
+    mutt_buffer_add_printf(buf, "To: Discussion List <list@example.org>, \"Other, Person\" <other%d@example.net>\n",
+                           i % 13);
+    mutt_buffer_add_printf(buf, "Cc: user%d@example.com, \"Third Person\" <third@example.com>,\n"
+                                " Fourth <fourth@example.com>\n",
+                           (i + 1) % 97);
+    if (i % 4)
+      mutt_buffer_add_printf(buf, "Subject: Re: Discussion of topic number %d\n", i / 10);
+    else
+      mutt_buffer_add_printf(buf, "Subject: =?UTF-8?B?UmU6IETDvHNrw7xzc2lvbg==?= of topic number %d\n",
+                             i / 10);
+    mutt_buffer_add_printf(buf, "Message-ID: <%d.%d@example.com>\n", i, i % 97);
+    if (i % 10)
+    {
+      mutt_buffer_addstr(buf, "References:");
+      for (int j = i - (i % 10); j < i; j++)
+        mutt_buffer_add_printf(buf, " <%d.%d@example.com>\n", j, j % 97);
+      mutt_buffer_add_printf(buf, "In-Reply-To: <%d.%d@example.com>\n", i - 1, (i - 1) % 97);
+    }
+    mutt_buffer_addstr(buf, "List-Id: Discussion List <list.example.org>\n");
+    mutt_buffer_addstr(buf, "MIME-Version: 1.0\n");
+    mutt_buffer_addstr(buf, "Content-Type: text/plain; charset=utf-8; format=flowed\n");
+    mutt_buffer_addstr(buf, "Content-Transfer-Encoding: 8bit\n");
+    mutt_buffer_addstr(buf, "\n");
+
+    corpus_add(c, buf->data, buf->dptr - buf->data);
+  }
+
+  mutt_buffer_free(&buf);
+}
+
+/**
+ * corpus_free - Free the corpus
+ * @param c Corpus
+ */
+static void corpus_free(struct BenchCorpus *c)
+{
+  for (int i = 0; i < c->count; i++)
+    FREE(&c->texts[i]);
+  FREE(&c->texts);
+  FREE(&c->lens);
+}
+
+/**
+ * strings_add - Add a string to a list
+ * @param s   List of strings
+ * @param str String to add
+ */
+static void strings_add(struct BenchStrings *s, char *str)
+{
+  if (s->count == s->max)
+  {
+    s->max = s->max ? (s->max * 2) : 1024;
+    mutt_mem_realloc(&s->strs, s->max * sizeof(char *));
+  }
+  s->strs[s->count++] = str;
+}
+
+/**
+ * strings_free - Free a list of strings
+ * @param s List of strings
+ */
+static void strings_free(struct BenchStrings *s)
+{
+  for (int i = 0; i < s->count; i++)
+    FREE(&s->strs[i]);
+  FREE(&s->strs);
+}
+
+/**
+ * strings_collect - Collect the values of some header fields from the corpus
+ * @param c     Corpus
+ * @param names Header field names, NULL-terminated
+ * @param s     List for the (unfolded) values
+ */
+static void strings_collect(struct BenchCorpus *c, const char **names, struct BenchStrings *s)
+{
+  for (int i = 0; i < c->count; i++)
+  {
+    const char *p = c->texts[i];
+    const char *end = p + c->lens[i];
+    while (p < end)
+    {
+      const char *eol = memchr(p, '\n', end - p);
+      if (!eol)
+        eol = end;
+
+      const char *colon = NULL;
+      for (int j = 0; names[j]; j++)
+      {
+        size_t nlen = strlen(names[j]);
+        if ((mutt_str_strncasecmp(p, names[j], nlen) == 0) && (p[nlen] == ':'))
+        {
+          colon = p + nlen + 1;
+          break;
+        }
+      }
+
+      if (colon)
+      {
+        /* Unfold the continuation lines */
+        struct Buffer *buf = mutt_buffer_new();
+        const char *v = colon;
+        while (true)
+        {
+          SKIPWS(v);
+          const char *vend = eol;
+          if ((vend > v) && (vend[-1] == '\r'))
+            vend--;
+          if (!mutt_buffer_is_empty(buf))
+            mutt_buffer_addch(buf, ' ');
+          mutt_buffer_add(buf, v, vend - v);
+          if ((eol + 1 >= end) || ((eol[1] != ' ') && (eol[1] != '\t')))
+            break;
+          v = eol + 1;
+          eol = memchr(v, '\n', end - v);
+          if (!eol)
+            eol = end;
+        }
+        strings_add(s, mutt_str_strdup(buf->data ? buf->data : ""));
+        mutt_buffer_free(&buf);
+      }
+
+      p = eol + 1;
+    }
+  }
+}
+
+/**
+ * cmp_double - Compare two doubles - Implements ::sort_t
+ */
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * phase_init - Prepare to time a function
+ * @param p     Phase
+ * @param name  Name of the function
+ * @param count Number of calls that will be made
+ */
+static void phase_init(struct BenchPhase *p, const char *name, int count)
+{
+  p->name = name;
+  p->max = count ? count : 1;
+  p->usec = mutt_mem_calloc(p->max, sizeof(double));
+  p->count = 0;
+  p->total = 0;
+}
+
+/**
+ * phase_add - Record the time taken by one call
+ * @param p  Phase
+ * @param t0 Start time, from now_usec()
+ * @param t1 End time, from now_usec()
+ */
+static void phase_add(struct BenchPhase *p, double t0, double t1)
+{
+  if (p->count < p->max)
+    p->usec[p->count++] = t1 - t0;
+  p->total += t1 - t0;
+}
+
+/**
+ * phase_print - Write the results of a function as JSON
+ * @param p Phase
+ */
+static void phase_print(struct BenchPhase *p)
+{
+  double p50 = 0, p99 = 0;
+  if (p->count > 0)
+  {
+    qsort(p->usec, p->count, sizeof(double), cmp_double);
+    p50 = p->usec[p->count / 2];
+    p99 = p->usec[MIN(p->count - 1, (p->count * 99) / 100)];
+  }
+
+  printf("%s    { \"name\": \"%s\", \"ops\": %d, \"ops_per_sec\": %.0f, "
+         "\"total_ms\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f }",
+         Printed++ ? ",\n" : "", p->name, p->count,
+         (p->total > 0) ? (p->count * 1e6 / p->total) : 0, p->total / 1000, p50, p99);
+
+  FREE(&p->usec);
+}
+
+/**
+ * bench_read_header - Time mutt_rfc822_read_header()
+ * @param c Corpus
+ *
+ * The corpus is written to a temporary file, so the stdio calls are included.
+ */
+static void bench_read_header(struct BenchCorpus *c)
+{
+  struct BenchPhase p;
+  FILE *fp = tmpfile();
+  if (!fp)
+    return;
+
+  LOFF_T *offsets = mutt_mem_calloc(c->count ? c->count : 1, sizeof(LOFF_T));
+  for (int i = 0; i < c->count; i++)
+  {
+    offsets[i] = ftello(fp);
+    fwrite(c->texts[i], 1, c->lens[i], fp);
+  }
+  fflush(fp);
+
+  phase_init(&p, "rfc822_read_header", c->count);
+  for (int i = 0; i < c->count; i++)
+  {
+    struct Email *e = mutt_email_new();
+    e->offset = offsets[i];
+    fseeko(fp, offsets[i], SEEK_SET);
+    double t0 = now_usec();
+    e->env = mutt_rfc822_read_header(fp, e, false, false);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+    mutt_email_free(&e);
+  }
+  phase_print(&p);
+
+  phase_init(&p, "rfc822_read_header_mem", c->count);
+  for (int i = 0; i < c->count; i++)
+  {
+    struct Email *e = mutt_email_new();
+    double t0 = now_usec();
+    e->env = mutt_rfc822_read_header_mem(c->texts[i], c->lens[i], e, false, false);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+    mutt_email_free(&e);
+  }
+  phase_print(&p);
+
+  FREE(&offsets);
+  mutt_file_fclose(&fp);
+}
+
+/**
+ * bench_addr_parse - Time mutt_addr_parse_list()
+ * @param c Corpus
+ */
+static void bench_addr_parse(struct BenchCorpus *c)
+{
+  static const char *names[] = { "From", "To", "Cc", "Reply-To", NULL };
+  struct BenchStrings s = { 0 };
+  struct BenchPhase p;
+
+  strings_collect(c, names, &s);
+  phase_init(&p, "addr_parse_list", s.count);
+  for (int i = 0; i < s.count; i++)
+  {
+    double t0 = now_usec();
+    struct Address *a = mutt_addr_parse_list(NULL, s.strs[i]);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+    mutt_addr_free(&a);
+  }
+  phase_print(&p);
+  strings_free(&s);
+}
+
+/**
+ * bench_rfc2047_decode - Time rfc2047_decode()
+ * @param c Corpus
+ */
+static void bench_rfc2047_decode(struct BenchCorpus *c)
+{
+  static const char *names[] = { "Subject", "From", NULL };
+  struct BenchStrings s = { 0 };
+  struct BenchPhase p;
+
+  strings_collect(c, names, &s);
+  phase_init(&p, "rfc2047_decode", s.count);
+  for (int i = 0; i < s.count; i++)
+  {
+    char *str = mutt_str_strdup(s.strs[i]);
+    double t0 = now_usec();
+    rfc2047_decode(&str);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+    FREE(&str);
+  }
+  phase_print(&p);
+  strings_free(&s);
+}
+
+/**
+ * bench_parse_date - Time mutt_date_parse_date()
+ * @param c Corpus
+ */
+static void bench_parse_date(struct BenchCorpus *c)
+{
+  static const char *names[] = { "Date", NULL };
+  struct BenchStrings s = { 0 };
+  struct BenchPhase p;
+
+  strings_collect(c, names, &s);
+  phase_init(&p, "date_parse_date", s.count);
+  for (int i = 0; i < s.count; i++)
+  {
+    double t0 = now_usec();
+    mutt_date_parse_date(s.strs[i], NULL);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+  }
+  phase_print(&p);
+  strings_free(&s);
+}
+
+/**
+ * bench_b64_decode - Time mutt_b64_decode()
+ * @param c Corpus
+ *
+ * Each header of the corpus is encoded, then decoded again.
+ */
+static void bench_b64_decode(struct BenchCorpus *c)
+{
+  struct BenchPhase p;
+  char *out = NULL;
+  size_t outlen = 0;
+
+  phase_init(&p, "b64_decode", c->count);
+  for (int i = 0; i < c->count; i++)
+  {
+    size_t len = ((c->lens[i] + 2) / 3) * 4 + 1;
+    if (len > outlen)
+    {
+      outlen = len;
+      mutt_mem_realloc(&out, outlen);
+    }
+    mutt_b64_encode(c->texts[i], c->lens[i], out, outlen);
+
+    char *dec = mutt_mem_malloc(c->lens[i] + 1);
+    double t0 = now_usec();
+    mutt_b64_decode(out, dec, c->lens[i] + 1);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+    FREE(&dec);
+  }
+  phase_print(&p);
+  FREE(&out);
+}
+
+/**
+ * bench_hash - Time mutt_hash_insert() and mutt_hash_find()
+ * @param c Corpus
+ *
+ * The Message-IDs are used as keys, like the Context's id_hash.
+ */
+static void bench_hash(struct BenchCorpus *c)
+{
+  static const char *names[] = { "Message-ID", NULL };
+  struct BenchStrings s = { 0 };
+  struct BenchPhase p;
+
+  strings_collect(c, names, &s);
+  struct Hash *hash = mutt_hash_create(s.count, 0);
+
+  phase_init(&p, "hash_insert", s.count);
+  for (int i = 0; i < s.count; i++)
+  {
+    double t0 = now_usec();
+    mutt_hash_insert(hash, s.strs[i], s.strs[i]);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+  }
+  phase_print(&p);
+
+  phase_init(&p, "hash_find", s.count);
+  for (int i = 0; i < s.count; i++)
+  {
+    double t0 = now_usec();
+    mutt_hash_find(hash, s.strs[i]);
+    double t1 = now_usec();
+    phase_add(&p, t0, t1);
+  }
+  phase_print(&p);
+
+  mutt_hash_destroy(&hash);
+  strings_free(&s);
+}
+
+/**
+ * cmp_date_sent - Compare the sent dates of two Emails - Implements ::sort_t
+ */
+static int cmp_date_sent(const void *a, const void *b)
+{
+  const struct Email *ea = *(struct Email const *const *) a;
+  const struct Email *eb = *(struct Email const *const *) b;
+  if (ea->date_sent != eb->date_sent)
+    return (ea->date_sent > eb->date_sent) ? 1 : -1;
+  return ea->index - eb->index;
+}
+
+/**
+ * bench_sort - Time sorting the Emails by date
+ * @param c Corpus
+ *
+ * mutt_sort_headers() needs a Context and NeoMutt's config, so this times the
+ * qsort() that it does for `$sort=date`, with the same tie-breaker.
+ */
+static void bench_sort(struct BenchCorpus *c)
+{
+  struct BenchPhase p;
+  struct Email **emails = mutt_mem_calloc(c->count ? c->count : 1, sizeof(struct Email *));
+
+  for (int i = 0; i < c->count; i++)
+  {
+    emails[i] = mutt_email_new();
+    emails[i]->env = mutt_rfc822_read_header_mem(c->texts[i], c->lens[i],
+                                                  emails[i], false, false);
+    emails[i]->index = c->count - i;
+  }
+
+  phase_init(&p, "sort_date", 1);
+  double t0 = now_usec();
+  qsort(emails, c->count, sizeof(struct Email *), cmp_date_sent);
+  double t1 = now_usec();
+  phase_add(&p, t0, t1);
+  phase_print(&p);
+
+  for (int i = 0; i < c->count; i++)
+    mutt_email_free(&emails[i]);
+  FREE(&emails);
+}
+
+/**
+ * usage - Display the command line options
+ */
+static void usage(void)
+{
+  puts("usage: lib-bench [-m maildir] [-n count] [-r repeat]\n"
+       "\n"
+       "  -m  Read the emails from a maildir\n"
+       "  -n  Number of emails (default: 10000, or all of the maildir)\n"
+       "  -r  Number of times to run each benchmark (default: 1)");
+}
+
+/**
+ * main - Run the library benchmark
+ */
+int main(int argc, char *argv[])
+{
+  const char *maildir = NULL;
+  int count = 0;
+  int repeat = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "m:n:r:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'm':
+        maildir = optarg;
+        break;
+      case 'n':
+        count = atoi(optarg);
+        break;
+      case 'r':
+        repeat = MAX(atoi(optarg), 1);
+        break;
+      default:
+        usage();
+        return (opt == 'h') ? 0 : 1;
+    }
+  }
+
+  Charset = "utf-8";
+
+  struct BenchCorpus corpus = { 0 };
+  if (maildir)
+  {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cur", maildir);
+    corpus_read_dir(&corpus, path, count);
+    snprintf(path, sizeof(path), "%s/new", maildir);
+    corpus_read_dir(&corpus, path, count);
+  }
+  else
+    corpus_generate(&corpus, count ? count : 10000);
+
+  printf("{\n");
+  printf("  \"emails\": %d,\n", corpus.count);
+  printf("  \"source\": \"%s\",\n", maildir ? "maildir" : "generated");
+  printf("  \"results\": [\n");
+  for (int i = 0; i < repeat; i++)
+  {
+    bench_read_header(&corpus);
+    bench_addr_parse(&corpus);
+    bench_rfc2047_decode(&corpus);
+    bench_parse_date(&corpus);
+    bench_b64_decode(&corpus);
+    bench_hash(&corpus);
+    bench_sort(&corpus);
+  }
+  printf("\n  ]\n");
+  printf("}\n");
+
+  corpus_free(&corpus);
+  return 0;
+}
@@ -53,6 +53,81 @@
 
 static int address_header_decode(char **h);
 static int copy_delete_attach(struct Body *b, FILE *fpin, FILE *fpout, char *date);
+static int copy_message(FILE *fpout, FILE *fpin, const struct MuttFileMap *map,
+                        struct Email *e, int flags, int chflags);
+
+/**
+ * struct HdrReader - Read the lines of a header in blocks
+ *
+ * Each line is returned whole, however long.  Like a loop of fgets() while
+ * ftello() < off_end, a line that starts before the end is read to its end.
+ */
+struct HdrReader
+{
+  FILE *fp;       ///< File to read
+  LOFF_T offset;  ///< Offset of data[0] in the file
+  LOFF_T off_end; ///< No lines start at, or after, this offset
+  char *data;     ///< Data read so far
+  size_t len;     ///< Length of the data
+  size_t size;    ///< Size of the buffer
+  size_t pos;     ///< Start of the next line
+  char saved;     ///< Character overwritten by the NUL after the last line
+  bool eof;       ///< Nothing more can be read
+};
+
+/**
+ * hdr_reader_next - Get the next line of a header
+ * @param r Reader
+ * @retval ptr  Line, including its newline, terminated by a NUL
+ * @retval NULL No more lines
+ *
+ * The line is only valid until the next call.
+ */
+static char *hdr_reader_next(struct HdrReader *r)
+{
+  if (r->data && (r->pos < r->len))
+    r->data[r->pos] = r->saved;
+
+  if (r->offset + (LOFF_T) r->pos >= r->off_end)
+    return NULL;
+
+  char *nl = NULL;
+  size_t scanned = r->pos;
+  while (!(nl = memchr(r->data + scanned, '\n', r->len - scanned)) && !r->eof)
+  {
+    scanned = r->len;
+    if (r->size - r->len < 1024)
+    {
+      r->size = MAX(r->size * 2, 8192);
+      mutt_mem_realloc(&r->data, r->size);
+    }
+    size_t n = fread(r->data + r->len, 1, r->size - r->len - 1, r->fp);
+    if (n == 0)
+      r->eof = true;
+    r->len += n;
+  }
+
+  if (r->pos == r->len)
+    return NULL;
+
+  char *line = r->data + r->pos;
+  r->pos = nl ? (nl - r->data + 1) : r->len;
+  r->saved = r->data[r->pos];
+  r->data[r->pos] = '\0';
+  return line;
+}
+
+/**
+ * hdr_reader_finish - Leave the file just after the last line returned
+ * @param r Reader
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int hdr_reader_finish(struct HdrReader *r)
+{
+  FREE(&r->data);
+  return fseeko(r->fp, r->offset + r->pos, SEEK_SET);
+}
 
 /**
  * mutt_copy_hdr - Copy header from one file to another
@@ -75,14 +150,13 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
   bool from = false;
   bool this_is_from = false;
   bool ignore = false;
-  char buf[LONG_STRING]; /* should be long enough to get most fields in one pass */
-  char *nl = NULL;
+  char *buf = NULL;
   char **headers = NULL;
   int hdr_count;
   int x;
   char *this_one = NULL;
   size_t this_one_len = 0;
-  int error;
+  int error = false;
 
   if (off_start < 0)
     return -1;
@@ -91,23 +165,22 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
     if (fseeko(in, off_start, SEEK_SET) < 0)
       return -1;
 
-  buf[0] = '\n';
-  buf[1] = '\0';
+  struct HdrReader r = { 0 };
+  r.fp = in;
+  r.offset = off_start;
+  r.off_end = off_end;
 
   if ((flags & (CH_REORDER | CH_WEED | CH_MIME | CH_DECODE | CH_PREFIX | CH_WEED_DELIVERED)) == 0)
   {
-    /* Without these flags to complicate things
-     * we can do a more efficient line to line copying
-     */
-    while (ftello(in) < off_end)
-    {
-      nl = strchr(buf, '\n');
-
-      if (!fgets(buf, sizeof(buf), in))
-        break;
+    /* Without these flags to complicate things we can copy the runs of
+     * lines that are kept in one go. */
+    size_t run = 0;
+    size_t run_len = 0;
 
+    while ((buf = hdr_reader_next(&r)))
+    {
       /* Is it the beginning of a header? */
-      if (nl && buf[0] != ' ' && buf[0] != '\t')
+      if (buf[0] != ' ' && buf[0] != '\t')
       {
         ignore = true;
         if (!from && (mutt_str_strncmp("From ", buf, 5) == 0))
@@ -144,15 +217,28 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
         ignore = false;
       }
 
-      if (!ignore && fputs(buf, out) == EOF)
-        return -1;
+      if (ignore)
+      {
+        if (run_len && (fwrite(r.data + run, 1, run_len, out) != run_len))
+          error = true;
+        run_len = 0;
+        continue;
+      }
+
+      if (run_len == 0)
+        run = buf - r.data;
+      run_len += (r.data + r.pos) - buf;
     }
+    if (run_len && (fwrite(r.data + run, 1, run_len, out) != run_len))
+      error = true;
+
+    if ((hdr_reader_finish(&r) != 0) || error)
+      return -1;
     return 0;
   }
 
   hdr_count = 1;
   x = 0;
-  error = false;
 
   /* We are going to read and collect the headers in an array
    * so we are able to do re-ordering.
@@ -173,16 +259,10 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
   headers = mutt_mem_calloc(hdr_count, sizeof(char *));
 
   /* Read all the headers into the array */
-  while (ftello(in) < off_end)
+  while ((buf = hdr_reader_next(&r)))
   {
-    nl = strchr(buf, '\n');
-
-    /* Read a line */
-    if (!fgets(buf, sizeof(buf), in))
-      break;
-
     /* Is it the beginning of a header? */
-    if (nl && buf[0] != ' ' && buf[0] != '\t')
+    if (buf[0] != ' ' && buf[0] != '\t')
     {
       /* Do we have anything pending? */
       if (this_one)
@@ -300,7 +380,8 @@ int mutt_copy_hdr(FILE *in, FILE *out, LOFF_T off_start, LOFF_T off_end,
         this_one_len += blen;
       }
     }
-  } /* while (ftello (in) < off_end) */
+  } /* while (hdr_reader_next(&r)) */
+  hdr_reader_finish(&r);
 
   /* Do we have anything pending?  -- XXX, same code as in above in the loop. */
   if (this_one)
@@ -578,6 +659,23 @@ static int count_delete_lines(FILE *fp, struct Body *b, LOFF_T *length, size_t d
  * * #MUTT_CM_CHARCONV   perform character set conversion
  */
 int mutt_copy_message_fp(FILE *fpout, FILE *fpin, struct Email *e, int flags, int chflags)
+{
+  return copy_message(fpout, fpin, NULL, e, flags, chflags);
+}
+
+/**
+ * copy_message - Copy a message, which may be mapped into memory
+ * @param fpout   Where to write output
+ * @param fpin    Where to get input
+ * @param map     fpin in memory, may be NULL
+ * @param e       Header of message being copied
+ * @param flags   See mutt_copy_message_fp()
+ * @param chflags Flags to mutt_copy_header()
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int copy_message(FILE *fpout, FILE *fpin, const struct MuttFileMap *map,
+                        struct Email *e, int flags, int chflags)
 {
   struct Body *body = e->content;
   char prefix[SHORT_STRING];
@@ -681,6 +779,7 @@ int mutt_copy_message_fp(FILE *fpout, FILE *fpin, struct Email *e, int flags, in
     struct State s = { 0 };
     s.fpin = fpin;
     s.fpout = fpout;
+    s.map = map;
     if (flags & MUTT_CM_PREFIX)
       s.prefix = prefix;
     if (flags & MUTT_CM_DISPLAY)
@@ -743,7 +842,29 @@ int mutt_copy_message_fp(FILE *fpout, FILE *fpin, struct Email *e, int flags, in
   {
     if (fseeko(fpin, body->offset, SEEK_SET) < 0)
       return -1;
-    if (flags & MUTT_CM_PREFIX)
+
+    const char *data = mutt_file_map_range(map, fpin, body->offset, body->length);
+    if (data && (flags & MUTT_CM_PREFIX))
+    {
+      const char *end = data + body->length;
+
+      fputs(prefix, fpout);
+      while (data < end)
+      {
+        const char *nl = memchr(data, '\n', end - data);
+        const size_t n = nl ? (nl - data + 1) : (end - data);
+        fwrite(data, 1, n, fpout);
+        if (nl)
+          fputs(prefix, fpout);
+        data += n;
+      }
+    }
+    else if (data)
+    {
+      if (fwrite(data, 1, body->length, fpout) != body->length)
+        return -1;
+    }
+    else if (flags & MUTT_CM_PREFIX)
     {
       int c;
       size_t bytes = body->length;
@@ -793,7 +914,7 @@ int mutt_copy_message_ctx(FILE *fpout, struct Context *src, struct Email *e,
     return -1;
   if (!e->content)
     return -1;
-  int r = mutt_copy_message_fp(fpout, msg->fp, e, flags, chflags);
+  int r = copy_message(fpout, msg->fp, &msg->map, e, flags, chflags);
   if ((r == 0) && (ferror(fpout) || feof(fpout)))
   {
     mutt_debug(1, "failed to detect EOF!\n");
@@ -807,6 +928,7 @@ int mutt_copy_message_ctx(FILE *fpout, struct Context *src, struct Email *e,
  * append_message - appends a copy of the given message to a mailbox
  * @param dest    destination mailbox
  * @param fpin    where to get input
+ * @param map     fpin in memory, may be NULL
  * @param src     source mailbox
  * @param e     message being copied
  * @param flags   mutt_open_copy_message() flags
@@ -814,8 +936,8 @@ int mutt_copy_message_ctx(FILE *fpout, struct Context *src, struct Email *e,
  * @retval  0 Success
  * @retval -1 Error
  */
-static int append_message(struct Context *dest, FILE *fpin, struct Context *src,
-                          struct Email *e, int flags, int chflags)
+static int append_message(struct Context *dest, FILE *fpin, const struct MuttFileMap *map,
+                          struct Context *src, struct Email *e, int flags, int chflags)
 {
   char buf[STRING];
   struct Message *msg = NULL;
@@ -832,7 +954,7 @@ static int append_message(struct Context *dest, FILE *fpin, struct Context *src,
   if (dest->mailbox->magic == MUTT_MBOX || dest->mailbox->magic == MUTT_MMDF)
     chflags |= CH_FROM | CH_FORCE_FROM;
   chflags |= (dest->mailbox->magic == MUTT_MAILDIR ? CH_NOSTATUS : CH_UPDATE);
-  r = mutt_copy_message_fp(msg->fp, fpin, e, flags, chflags);
+  r = copy_message(msg->fp, fpin, map, e, flags, chflags);
   if (mx_msg_commit(dest, msg) != 0)
     r = -1;
 
@@ -862,7 +984,7 @@ int mutt_append_message(struct Context *dest, struct Context *src,
   struct Message *msg = mx_msg_open(src, e->msgno);
   if (!msg)
     return -1;
-  int r = append_message(dest, msg->fp, src, e, cmflags, chflags);
+  int r = append_message(dest, msg->fp, &msg->map, src, e, cmflags, chflags);
   mx_msg_close(src, &msg);
   return r;
 }
@@ -161,6 +161,78 @@ static int mutt_monitor_getch(void)
 }
 #endif /* USE_INOTIFY */
 
+/**
+ * getch_key - Read a key, polling the filesystem monitor
+ * @retval num Character pressed
+ * @retval ERR Timeout
+ */
+static int getch_key(void)
+{
+#ifdef USE_INOTIFY
+  return mutt_monitor_getch();
+#else
+  return getch();
+#endif
+}
+
+/**
+ * getch_tasks - Read a key, running the completions of background tasks
+ * @param[out] completed Set to true if any completions were run
+ * @retval num Character pressed
+ * @retval ERR Timeout
+ *
+ * While background tasks are outstanding, wait in short slices and run the
+ * completions between them.  The total wait respects the caller's timeout.
+ */
+static int getch_tasks(bool *completed)
+{
+  const int delay = MuttGetchTimeout;
+  int waited = 0;
+  int ch = ERR;
+
+  if (mutt_task_dispatch() > 0)
+    *completed = true;
+
+  while (mutt_task_pending() > 0)
+  {
+    int slice = 100;
+    if ((delay >= 0) && ((delay - waited) < slice))
+      slice = delay - waited;
+
+    mutt_getch_timeout(slice);
+    ch = getch_key();
+    mutt_getch_timeout(delay);
+
+    if (mutt_task_dispatch() > 0)
+      *completed = true;
+
+#ifdef USE_INOTIFY
+    if ((ch != ERR) || SigInt || MonitorFilesChanged)
+#else
+    if ((ch != ERR) || SigInt)
+#endif
+      return ch;
+
+    waited += slice;
+    if ((delay >= 0) && (waited >= delay))
+      return ERR;
+  }
+
+  /* Let a waiting menu show what the completions did */
+  if (*completed && (delay >= 0))
+    return ERR;
+
+  if ((delay >= 0) && (waited > 0))
+  {
+    mutt_getch_timeout(delay - waited);
+    ch = getch_key();
+    mutt_getch_timeout(delay);
+    return ch;
+  }
+
+  return getch_key();
+}
+
 /**
  * mutt_getch - Read a character from the input buffer
  * @retval obj Event to process
@@ -170,6 +242,10 @@ static int mutt_monitor_getch(void)
  * 2. MacroEvents buffer
  * 3. Keyboard
  *
+ * While waiting, the completions of background tasks are run, see
+ * mutt_task_submit().  If any are run and a timeout has been set, this returns
+ * early, so the menu can redraw.
+ *
  * This function can return:
  * - Error `{ -1, OP_NULL }`
  * - Timeout `{ -2, OP_NULL }`
@@ -179,6 +255,7 @@ struct Event mutt_getch(void)
   int ch;
   struct Event err = { -1, OP_NULL }, ret;
   struct Event timeout = { -2, OP_NULL };
+  bool completed = false;
 
   if (UngetCount)
     return UngetKeyEvents[--UngetCount];
@@ -194,11 +271,7 @@ struct Event mutt_getch(void)
   ch = KEY_RESIZE;
   while (ch == KEY_RESIZE)
 #endif /* KEY_RESIZE */
-#ifdef USE_INOTIFY
-    ch = mutt_monitor_getch();
-#else
-  ch = getch();
-#endif /* USE_INOTIFY */
+    ch = getch_tasks(&completed);
   mutt_sig_allow_interrupt(0);
 
   if (SigInt)
@@ -232,6 +305,40 @@ struct Event mutt_getch(void)
   return ch == ctrl('G') ? err : ret;
 }
 
+/**
+ * mutt_lock_wait - Wait for a locked file, watching the keyboard - Implements ::lock_wait_t
+ *
+ * The completions of background tasks are run while waiting.  Pressing a key,
+ * or Ctrl-C, gives up on the lock.  The key is kept for the menu, so the
+ * keystroke isn't lost.
+ */
+bool mutt_lock_wait(int delay)
+{
+  const int old_timeout = MuttGetchTimeout;
+
+  SigInt = 0;
+  mutt_refresh();
+  mutt_sig_allow_interrupt(1);
+  mutt_getch_timeout(delay);
+  int ch = getch_key();
+  mutt_getch_timeout(old_timeout);
+  mutt_sig_allow_interrupt(0);
+  mutt_task_dispatch();
+
+  if (SigInt)
+  {
+    SigInt = 0;
+    return true;
+  }
+
+  if (ch == ERR)
+    return false;
+
+  if (ch != ctrl('G'))
+    mutt_unget_event(ch, 0);
+  return true;
+}
+
 /**
  * mutt_get_field_full - Ask the user for a string
  * @param[in]  field    Prompt
@@ -923,8 +1030,28 @@ void mutt_simple_format(char *buf, size_t buflen, int min_width, int max_width,
   memset(&mbstate2, 0, sizeof(mbstate2));
   buflen--;
   char *p = buf;
-  for (; n && (k = mbrtowc(&wc, s, n, &mbstate1)); s += k, n -= k)
+  for (; n; s += k, n -= k)
   {
+    /* printable ASCII is copied as it is, one column per byte */
+    if (!escaped && mbsinit(&mbstate1) && mbsinit(&mbstate2))
+    {
+      k = mutt_mb_ascii_len(s, n);
+      if (k > 0)
+      {
+        size_t c = MIN(k, buflen);
+        c = MIN(c, (size_t) MAX(max_width, 0));
+        memcpy(p, s, c);
+        p += c;
+        buflen -= c;
+        min_width -= c;
+        max_width -= c;
+        continue;
+      }
+    }
+
+    k = mbrtowc(&wc, s, n, &mbstate1);
+    if (k == 0)
+      break;
     if (k == (size_t)(-1) || k == (size_t)(-2))
     {
       if (k == (size_t)(-1) && errno == EILSEQ)
@@ -1137,8 +1264,25 @@ size_t mutt_wstr_trunc(const char *src, size_t maxlen, size_t maxwid, size_t *wi
   n = mutt_str_strlen(src);
 
   memset(&mbstate, 0, sizeof(mbstate));
-  for (w = 0; n && (cl = mbrtowc(&wc, src, n, &mbstate)); src += cl, n -= cl)
+  for (w = 0; n; src += cl, n -= cl)
   {
+    /* printable ASCII is one byte and one column per character */
+    if (mbsinit(&mbstate))
+    {
+      cl = mutt_mb_ascii_len(src, n);
+      cl = MIN(cl, maxlen - l);
+      cl = MIN(cl, maxwid - w);
+      if (cl > 0)
+      {
+        l += cl;
+        w += cl;
+        continue;
+      }
+    }
+
+    cl = mbrtowc(&wc, src, n, &mbstate);
+    if (cl == 0)
+      break;
     if (cl == (size_t)(-1) || cl == (size_t)(-2))
     {
       if (cl == (size_t)(-1))
@@ -1187,12 +1331,25 @@ int mutt_strwidth(const char *s)
   n = mutt_str_strlen(s);
 
   memset(&mbstate, 0, sizeof(mbstate));
-  for (w = 0; n && (k = mbrtowc(&wc, s, n, &mbstate)); s += k, n -= k)
+  for (w = 0; n; s += k, n -= k)
   {
+    /* printable ASCII is one column per byte */
+    if (mbsinit(&mbstate))
+    {
+      k = mutt_mb_ascii_len(s, n);
+      if (k > 0)
+      {
+        w += k;
+        continue;
+      }
+    }
+
+    k = mbrtowc(&wc, s, n, &mbstate);
+    if (k == 0)
+      break;
     if (*s == MUTT_SPECIAL_INDEX)
     {
-      s += 2; /* skip the index coloring sequence */
-      k = 0;
+      k = MIN(2, n); /* skip the index coloring sequence */
       continue;
     }
 
@@ -64,6 +64,7 @@
 #include "recvattach.h"
 #include "score.h"
 #include "send.h"
+#include "smtp.h"
 #include "sort.h"
 #include "status.h"
 #include "terminal.h"
@@ -168,6 +169,27 @@ static const char *NoVisible = N_("No visible messages");
 #define CAN_COLLAPSE(header)                                                   \
   ((CollapseUnread || !UNREAD(header)) && (CollapseFlagged || !FLAGGED(header)))
 
+#define INDEX_ROW_CACHE 256 ///< Number of formatted rows of the index to keep
+
+/**
+ * struct IndexRow - A formatted row of the index
+ */
+struct IndexRow
+{
+  struct Email *email;   ///< Email displayed
+  int line;              ///< Line of the index
+  enum FormatFlag flags; ///< Flags it was formatted with
+  int cols;              ///< Width of the index
+  unsigned int gen;      ///< IndexRowGen when it was formatted
+  char *str;             ///< Formatted row
+};
+
+/* Rows are only reused while the user is moving around the index: anything
+ * else may have changed an email, the config or the colours. */
+static struct IndexRow IndexRows[INDEX_ROW_CACHE];
+static unsigned int IndexRowGen = 1;
+static struct Menu *IndexRowMenu = NULL; ///< Menu whose rows are cached
+
 /**
  * collapse_all - Collapse/uncollapse all threads
  * @param menu   current menu
@@ -482,8 +504,12 @@ static void update_index_unthreaded(struct Context *ctx, int check, int oldcount
     }
   }
 
-  /* if the mailbox was reopened, need to rethread from scratch */
-  mutt_sort_headers(ctx, (check == MUTT_REOPENED));
+  /* new mail that sorts after the old emails is just added to the end */
+  if ((check == MUTT_REOPENED) || !mutt_sort_append(ctx, oldcount))
+  {
+    /* if the mailbox was reopened, need to rethread from scratch */
+    mutt_sort_headers(ctx, (check == MUTT_REOPENED));
+  }
 }
 
 /**
@@ -499,6 +525,8 @@ void update_index(struct Menu *menu, struct Context *ctx, int check, int oldcoun
   if (!menu || !ctx)
     return;
 
+  const int current = menu->current;
+
   /* take note of the current message */
   if (oldcount)
   {
@@ -516,8 +544,15 @@ void update_index(struct Menu *menu, struct Context *ctx, int check, int oldcoun
   menu->current = -1;
   if (oldcount)
   {
+    /* the message is usually where it was, so try there before searching */
+    if ((current >= 0) && (current < ctx->mailbox->vcount) &&
+        (ctx->mailbox->hdrs[ctx->mailbox->v2r[current]]->index == menu->oldcurrent))
+    {
+      menu->current = current;
+    }
+
     /* restore the current message to the message it was pointing to */
-    for (int i = 0; i < ctx->mailbox->vcount; i++)
+    for (int i = 0; (menu->current < 0) && (i < ctx->mailbox->vcount); i++)
     {
       if (ctx->mailbox->hdrs[ctx->mailbox->v2r[i]]->index == menu->oldcurrent)
       {
@@ -652,9 +687,15 @@ void index_make_entry(char *buf, size_t buflen, struct Menu *menu, int line)
   if (!e)
     return;
 
+  /* the mailbox may have been opened without all its headers */
+  mx_msg_load_header(Context, e);
+
   enum FormatFlag flag = MUTT_FORMAT_MAKEPRINT | MUTT_FORMAT_ARROWCURSOR | MUTT_FORMAT_INDEX;
   struct MuttThread *tmp = NULL;
 
+  if ((Sort & SORT_MASK) == SORT_THREADS)
+    mutt_draw_thread(e);
+
   if ((Sort & SORT_MASK) == SORT_THREADS && e->tree)
   {
     flag |= MUTT_FORMAT_TREE; /* display the thread tree */
@@ -709,7 +750,60 @@ void index_make_entry(char *buf, size_t buflen, struct Menu *menu, int line)
     }
   }
 
+  struct IndexRow *row = NULL;
+  if (menu == IndexRowMenu)
+  {
+    row = &IndexRows[line % INDEX_ROW_CACHE];
+    if (row->str && (row->gen == IndexRowGen) && (row->email == e) &&
+        (row->line == line) && (row->flags == flag) && (row->cols == MuttIndexWindow->cols))
+    {
+      mutt_str_strfcpy(buf, row->str, buflen);
+      return;
+    }
+  }
+
   mutt_make_string_flags(buf, buflen, NONULL(IndexFormat), Context, e, flag);
+
+  if (row)
+  {
+    mutt_str_replace(&row->str, buf);
+    row->email = e;
+    row->line = line;
+    row->flags = flag;
+    row->cols = MuttIndexWindow->cols;
+    row->gen = IndexRowGen;
+  }
+}
+
+/**
+ * is_motion_op - Does an operation only move around the index?
+ * @param op Operation, e.g. OP_NEXT_PAGE
+ * @retval true The emails and their display are unchanged
+ */
+static bool is_motion_op(int op)
+{
+  switch (op)
+  {
+    case OP_BOTTOM_PAGE:
+    case OP_CURRENT_BOTTOM:
+    case OP_CURRENT_MIDDLE:
+    case OP_CURRENT_TOP:
+    case OP_FIRST_ENTRY:
+    case OP_HALF_DOWN:
+    case OP_HALF_UP:
+    case OP_LAST_ENTRY:
+    case OP_MIDDLE_PAGE:
+    case OP_NEXT_ENTRY:
+    case OP_NEXT_LINE:
+    case OP_NEXT_PAGE:
+    case OP_PREV_ENTRY:
+    case OP_PREV_LINE:
+    case OP_PREV_PAGE:
+    case OP_TOP_PAGE:
+      return true;
+    default:
+      return false;
+  }
 }
 
 /**
@@ -722,7 +816,7 @@ int index_color(int line)
 
   struct Email *e = Context->mailbox->hdrs[Context->mailbox->v2r[line]];
 
-  if (e && e->pair)
+  if (e && e->pair_valid)
     return e->pair;
 
   mutt_set_header_color(Context, e);
@@ -982,6 +1076,9 @@ int mutt_index_menu(void)
   menu->menu_custom_redraw = index_custom_redraw;
   mutt_menu_push_current(menu);
 
+  struct Menu *old_row_menu = IndexRowMenu;
+  IndexRowMenu = menu;
+
   if (!attach_msg)
   {
     /* force the mailbox check after we enter the folder */
@@ -999,6 +1096,10 @@ int mutt_index_menu(void)
 
   while (true)
   {
+    /* the formatted rows survive moving around, but nothing else */
+    if (!is_motion_op(op))
+      IndexRowGen++;
+
     /* Clear the tag prefix unless we just started it.  Don't clear
      * the prefix on a timeout (op==-2), but do clear on an abort (op==-1)
      */
@@ -1038,7 +1139,30 @@ int mutt_index_menu(void)
                        CURHDR->index :
                        0;
 
+#ifdef USE_NOTMUCH
+      /* show the next part of a vfolder that's still loading */
+      if (nm_load_more(Context) > 0)
+      {
+        bool q = Context->mailbox->quiet;
+        Context->mailbox->quiet = true;
+        update_index(menu, Context, MUTT_NEW_MAIL, oldcount, index_hint);
+        Context->mailbox->quiet = q;
+
+        menu->redraw = REDRAW_FULL;
+        menu->max = Context->mailbox->vcount;
+        oldcount = Context->mailbox->msg_count;
+        index_hint = (Context->mailbox->vcount && menu->current >= 0 &&
+                      menu->current < Context->mailbox->vcount) ?
+                         CURHDR->index :
+                         0;
+
+        OptSearchInvalid = true;
+      }
+#endif
+
       check = mx_mbox_check(Context, &index_hint);
+      if (check != 0)
+        IndexRowGen++;
       if (check < 0)
       {
         if (!Context->mailbox || Context->mailbox->path[0] == '\0')
@@ -1123,12 +1247,19 @@ int mutt_index_menu(void)
         do_mailbox_notify = true;
     }
 
+#ifdef USE_SMTP
+    /* report any messages delivered in the background */
+    mutt_smtp_check_background();
+#endif
+
     if (op >= 0)
       mutt_curs_set(0);
 
     if (menu->menu == MENU_MAIN)
     {
+      mutt_trace_begin("index_redraw", NULL);
       index_custom_redraw(menu);
+      mutt_trace_end("index_redraw");
 
       /* give visual indication that the next command is a tag- command */
       if (tag)
@@ -1173,7 +1304,11 @@ int mutt_index_menu(void)
       /* either user abort or timeout */
       if (op < 0)
       {
-        mutt_timeout_hook();
+#ifdef USE_NOTMUCH
+        /* not a real timeout, just the next part of a vfolder to load */
+        if (!Context || !nm_is_loading(Context->mailbox))
+#endif
+          mutt_timeout_hook();
         if (tag)
           mutt_window_clearline(MuttMessageWindow, 0);
         continue;
@@ -1707,9 +1842,11 @@ int mutt_index_menu(void)
         CHECK_VISIBLE;
         if (tag && !AutoTag)
         {
+          mutt_flag_batch_begin(Context);
           for (j = 0; j < Context->mailbox->msg_count; j++)
             if (message_is_visible(Context, j))
               mutt_set_flag(Context, Context->mailbox->hdrs[j], MUTT_TAG, 0);
+          mutt_flag_batch_end();
           menu->redraw |= REDRAW_STATUS | REDRAW_INDEX;
         }
         else
@@ -1991,7 +2128,7 @@ int mutt_index_menu(void)
 
 #ifdef USE_NOTMUCH
           if (Context->mailbox->magic == MUTT_NOTMUCH)
-            nm_longrun_init(Context->mailbox, true);
+            nm_tags_bulk_begin(Context->mailbox);
 #endif
           for (px = 0, j = 0; j < Context->mailbox->msg_count; j++)
           {
@@ -2015,7 +2152,7 @@ int mutt_index_menu(void)
           }
 #ifdef USE_NOTMUCH
           if (Context->mailbox->magic == MUTT_NOTMUCH)
-            nm_longrun_done(Context->mailbox);
+            nm_tags_bulk_end(Context->mailbox);
 #endif
           menu->redraw = REDRAW_STATUS | REDRAW_INDEX;
         }
@@ -2287,6 +2424,7 @@ int mutt_index_menu(void)
         menu->menu = MENU_MAIN;
 
         op = mutt_display_message(CURHDR);
+        IndexRowGen++; /* the pager may have changed anything */
         if (op < 0)
         {
           OptNeedResort = false;
@@ -2671,6 +2809,7 @@ int mutt_index_menu(void)
 
         if (tag)
         {
+          mutt_flag_batch_begin(Context);
           for (j = 0; j < Context->mailbox->msg_count; j++)
           {
             if (message_is_tagged(Context, j))
@@ -2679,6 +2818,7 @@ int mutt_index_menu(void)
                             !Context->mailbox->hdrs[j]->flagged);
             }
           }
+          mutt_flag_batch_end();
 
           menu->redraw |= REDRAW_INDEX;
         }
@@ -2712,6 +2852,7 @@ int mutt_index_menu(void)
 
         if (tag)
         {
+          mutt_flag_batch_begin(Context);
           for (j = 0; j < Context->mailbox->msg_count; j++)
           {
             if (!message_is_tagged(Context, j))
@@ -2722,6 +2863,7 @@ int mutt_index_menu(void)
             else
               mutt_set_flag(Context, Context->mailbox->hdrs[j], MUTT_READ, 1);
           }
+          mutt_flag_batch_end();
           menu->redraw |= REDRAW_STATUS | REDRAW_INDEX;
         }
         else
@@ -3503,6 +3645,8 @@ int mutt_index_menu(void)
       break;
   }
 
+  IndexRowGen++;
+  IndexRowMenu = old_row_menu;
   mutt_menu_pop_current(menu);
   mutt_menu_destroy(&menu);
   return close;
@@ -3512,24 +3656,58 @@ int mutt_index_menu(void)
  * mutt_set_header_color - Select a colour for a message
  * @param ctx    Mailbox
  * @param curhdr Header of message
+ *
+ * Subpatterns shared by several rules are only tested once.  The results of
+ * those that only depend on the email are kept in Email.pair_memo, so after a
+ * flag changes, only the flag tests need to be run again.
  */
 void mutt_set_header_color(struct Context *ctx, struct Email *curhdr)
 {
   struct ColorLine *color = NULL;
   struct PatternCache cache = { 0 };
+  unsigned char memo[256];
+  unsigned char scratch[256];
+  const size_t num_static = ColorIndexMemoStatic + 1;
+  const size_t num_dynamic = ColorIndexMemoDynamic + 1;
 
   if (!curhdr)
     return;
 
+  if (ctx)
+    mx_msg_load_header(ctx, curhdr);
+
+  /* Reading a message while testing it drops Email.pair_memo; then the
+   * results are stale and aren't kept. */
+  if (ctx && (num_static > 1))
+  {
+    if (!curhdr->pair_memo)
+      curhdr->pair_memo = mutt_mem_calloc(num_static, 1);
+    cache.memo = (num_static > sizeof(memo)) ? mutt_mem_malloc(num_static) : memo;
+    memcpy(cache.memo, curhdr->pair_memo, num_static);
+  }
+  if (num_dynamic > 1)
+  {
+    cache.scratch = (num_dynamic > sizeof(scratch)) ? mutt_mem_malloc(num_dynamic) : scratch;
+    memset(cache.scratch, 0, num_dynamic);
+  }
+
+  curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
   STAILQ_FOREACH(color, &ColorIndexList, entries)
   {
     if (mutt_pattern_exec(color->color_pattern, MUTT_MATCH_FULL_ADDRESS, ctx, curhdr, &cache))
     {
       curhdr->pair = color->pair;
-      return;
+      break;
     }
   }
-  curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
+  curhdr->pair_valid = true;
+
+  if (cache.memo && curhdr->pair_memo)
+    memcpy(curhdr->pair_memo, cache.memo, num_static);
+  if (cache.memo != memo)
+    FREE(&cache.memo);
+  if (cache.scratch != scratch)
+    FREE(&cache.scratch);
 }
 
 /**
@@ -3565,3 +3743,39 @@ bool mutt_reply_listener(const struct ConfigSet *cs, struct HashElem *he,
   OptResortInit = true; /* trigger a redraw of the index */
   return true;
 }
+
+/**
+ * mutt_tags_listener - Listen for config changes to "hidden_tags" - Implements ::cs_listener()
+ */
+bool mutt_tags_listener(const struct ConfigSet *cs, struct HashElem *he,
+                        const char *name, enum ConfigEvent ev)
+{
+  if (mutt_str_strcmp(name, "hidden_tags") != 0)
+    return true;
+
+  driver_tags_invalidate();
+  mutt_menu_set_redraw_full(MENU_MAIN);
+  return true;
+}
+
+/**
+ * mutt_hdrshare_listener - Listen for config changes that affect parsing - Implements ::cs_listener()
+ */
+bool mutt_hdrshare_listener(const struct ConfigSet *cs, struct HashElem *he,
+                            const char *name, enum ConfigEvent ev)
+{
+  static const char *const names[] = { "assumed_charset", "charset",
+                                        "header_share_size", "mark_old",
+                                        "reply_regex",       "rfc2047_parameters",
+                                        "spam_separator",    NULL };
+
+  for (size_t i = 0; names[i]; i++)
+  {
+    if (mutt_str_strcmp(name, names[i]) == 0)
+    {
+      mutt_hdrshare_flush();
+      break;
+    }
+  }
+  return true;
+}
@@ -28,7 +28,11 @@
  */
 
 #include "config.h"
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "mutt/mutt.h"
@@ -64,6 +68,89 @@ const char *const AddressErrors[] = {
   "bad route in <>", "bad address in <>",      "bad address spec",
 };
 
+/**
+ * MailboxStrings - Mailbox strings shared between Addresses
+ *
+ * The same senders and recipients turn up in many emails, so Addresses with
+ * identical mailboxes share one copy.  The key is the string itself and the
+ * data is the number of Addresses using it.
+ */
+static struct Hash *MailboxStrings = NULL;
+
+#ifdef USE_THREADS
+/* Headers may be parsed by several threads at once */
+static pthread_mutex_t MailboxLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * mailbox_share - Swap a mailbox string for a shared copy
+ * @param mailbox String to share, may be NULL
+ * @retval ptr Shared copy of the string
+ *
+ * The function takes ownership of the string.  If an identical one is already
+ * in use, it's freed and the existing one is returned.
+ */
+static char *mailbox_share(char *mailbox)
+{
+  if (!mailbox)
+    return NULL;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&MailboxLock);
+#endif
+  if (!MailboxStrings)
+    MailboxStrings = mutt_hash_create(1024, 0);
+
+  struct HashElem *he = mutt_hash_find_elem(MailboxStrings, mailbox);
+  if (he)
+  {
+    he->data = (void *) ((intptr_t) he->data + 1);
+    FREE(&mailbox);
+    mailbox = (char *) he->key.strkey;
+  }
+  else
+    mutt_hash_insert(MailboxStrings, mailbox, (void *) (intptr_t) 1);
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&MailboxLock);
+#endif
+
+  return mailbox;
+}
+
+/**
+ * mailbox_release - Free a mailbox string
+ * @param mailbox String to free
+ *
+ * A shared string is only freed once the last Address stops using it.
+ * Strings that aren't shared are simply freed.
+ */
+static void mailbox_release(char **mailbox)
+{
+  if (!mailbox || !*mailbox)
+    return;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&MailboxLock);
+#endif
+  struct HashElem *he = MailboxStrings ? mutt_hash_find_elem(MailboxStrings, *mailbox) : NULL;
+  if (he && (he->key.strkey == *mailbox))
+  {
+    he->data = (void *) ((intptr_t) he->data - 1);
+    if (he->data)
+      *mailbox = NULL;
+    else
+    {
+      mutt_hash_delete(MailboxStrings, *mailbox, NULL);
+      FREE(mailbox);
+    }
+  }
+  else
+    FREE(mailbox);
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&MailboxLock);
+#endif
+}
+
 /**
  * free_address - Free a single Address
  * @param a Address to free
@@ -75,7 +162,7 @@ static void free_address(struct Address **a)
   if (!a || !*a)
     return;
   FREE(&(*a)->personal);
-  FREE(&(*a)->mailbox);
+  mailbox_release(&(*a)->mailbox);
   FREE(a);
 }
 
@@ -273,7 +360,7 @@ static const char *parse_address(const char *s, char *token, size_t *tokenlen,
   }
 
   terminate_string(token, *tokenlen, tokenmax);
-  addr->mailbox = mutt_str_strdup(token);
+  addr->mailbox = mailbox_share(mutt_str_strdup(token));
 
   if (*commentlen && !addr->personal)
   {
@@ -392,6 +479,110 @@ static void add_addrspec(struct Address **top, struct Address **last, const char
   *last = cur;
 }
 
+/**
+ * skip_atoms - Skip the characters of an unquoted word or dot-atom
+ * @param s String to parse
+ * @retval ptr First character that isn't part of the word
+ */
+static const char *skip_atoms(const char *s)
+{
+  while (*s && !mutt_str_is_email_wsp(*s) && ((*s == '.') || !is_special(*s)))
+    s++;
+  return s;
+}
+
+/**
+ * skip_simple_mailbox - Skip a plain user@domain
+ * @param s String to parse
+ * @retval ptr  First character after the domain
+ * @retval NULL Not a plain user@domain
+ */
+static const char *skip_simple_mailbox(const char *s)
+{
+  const char *p = skip_atoms(s);
+  if ((p == s) || (*p != '@'))
+    return NULL;
+  const char *q = skip_atoms(p + 1);
+  if ((q == p + 1) || ((q - s) >= SHORT_STRING))
+    return NULL;
+  return q;
+}
+
+/**
+ * parse_simple - Parse the common forms of an address quickly
+ * @param[in]  s    String to parse, at the start of an address
+ * @param[out] addr New Address
+ * @retval ptr  First character after the address
+ * @retval NULL The address needs the full parser
+ *
+ * These forms are recognised, if nothing but a comma follows them:
+ * - user@domain
+ * - Some Name <user@domain>
+ * - "Some Name" <user@domain>
+ *
+ * The result is the same as the full parser's.
+ */
+static const char *parse_simple(const char *s, struct Address **addr)
+{
+  char personal[STRING];
+  size_t plen = 0;
+  const char *p = skip_simple_mailbox(s);
+
+  if (p)
+  {
+    const char *end = mutt_str_skip_email_wsp(p);
+    if (*end && (*end != ','))
+      return NULL;
+    *addr = mutt_addr_new();
+    (*addr)->mailbox = mailbox_share(mutt_str_substr_dup(s, p));
+    return p;
+  }
+
+  p = s;
+  if (*p == '"')
+  {
+    const char *q = p + 1;
+    while (*q && (*q != '"') && (*q != '\\'))
+      q++;
+    plen = q - (p + 1);
+    if ((*q != '"') || (plen >= sizeof(personal)))
+      return NULL;
+    memcpy(personal, p + 1, plen);
+    p = mutt_str_skip_email_wsp(q + 1);
+  }
+  else
+  {
+    /* words separated by whitespace, which becomes a single space */
+    while (*p != '<')
+    {
+      const char *q = skip_atoms(p);
+      if ((q == p) || (plen + (q - p) + 1 >= sizeof(personal)))
+        return NULL;
+      if (plen != 0)
+        personal[plen++] = ' ';
+      memcpy(personal + plen, p, q - p);
+      plen += q - p;
+      p = mutt_str_skip_email_wsp(q);
+    }
+  }
+
+  if (*p != '<')
+    return NULL;
+  const char *mbox = p + 1;
+  p = skip_simple_mailbox(mbox);
+  if (!p || (*p != '>'))
+    return NULL;
+  const char *end = mutt_str_skip_email_wsp(p + 1);
+  if (*end && (*end != ','))
+    return NULL;
+
+  *addr = mutt_addr_new();
+  if (plen != 0)
+    (*addr)->personal = mutt_str_substr_dup(personal, personal + plen);
+  (*addr)->mailbox = mailbox_share(mutt_str_substr_dup(mbox, p));
+  return p + 1;
+}
+
 /**
  * mutt_addr_new - Create a new Address
  * @retval ptr Newly allocated Address
@@ -481,7 +672,17 @@ struct Address *mutt_addr_parse_list(struct Address *top, const char *s)
   s = mutt_str_skip_email_wsp(s);
   while (*s)
   {
-    if (*s == ',')
+    /* most addresses don't need the full parser */
+    if ((phraselen == 0) && (commentlen == 0) && (ps = parse_simple(s, &cur)))
+    {
+      if (last)
+        last->next = cur;
+      else
+        top = cur;
+      last = cur;
+      s = ps;
+    }
+    else if (*s == ',')
     {
       if (phraselen != 0)
       {
@@ -665,8 +866,8 @@ void mutt_addr_qualify(struct Address *addr, const char *host)
     {
       char *p = mutt_mem_malloc(mutt_str_strlen(addr->mailbox) + mutt_str_strlen(host) + 2);
       sprintf(p, "%s@%s", addr->mailbox, host);
-      FREE(&addr->mailbox);
-      addr->mailbox = p;
+      mailbox_release(&addr->mailbox);
+      addr->mailbox = mailbox_share(p);
     }
   }
 }
@@ -714,8 +915,8 @@ struct Address *mutt_addr_copy(struct Address *addr)
   struct Address *p = mutt_addr_new();
 
   p->personal = mutt_str_strdup(addr->personal);
-  p->mailbox = mutt_str_strdup(addr->mailbox);
   p->group = addr->group;
+  mutt_addr_set_mailbox(p, mutt_str_strdup(addr->mailbox));
   p->is_intl = addr->is_intl;
   p->intl_checked = addr->intl_checked;
   return p;
@@ -839,7 +1040,7 @@ bool mutt_addr_cmp_strict(const struct Address *a, const struct Address *b)
 {
   while (a && b)
   {
-    if ((mutt_str_strcmp(a->mailbox, b->mailbox) != 0) ||
+    if (((a->mailbox != b->mailbox) && (mutt_str_strcmp(a->mailbox, b->mailbox) != 0)) ||
         (mutt_str_strcmp(a->personal, b->personal) != 0))
     {
       return false;
@@ -884,6 +1085,8 @@ bool mutt_addr_cmp(struct Address *a, struct Address *b)
 {
   if (!a->mailbox || !b->mailbox)
     return false;
+  if (a->mailbox == b->mailbox)
+    return true;
   if (mutt_str_strcasecmp(a->mailbox, b->mailbox) != 0)
     return false;
   return true;
@@ -949,6 +1152,20 @@ int mutt_addr_mbox_to_udomain(const char *mbox, char **user, char **domain)
   return 0;
 }
 
+/**
+ * mutt_addr_set_mailbox - Set the mailbox of an Address
+ * @param a       Address to modify
+ * @param mailbox Email address, may be NULL
+ *
+ * The Address takes ownership of the string.  Identical mailboxes are shared
+ * between Addresses, except for group names, which are rewritten in place.
+ */
+void mutt_addr_set_mailbox(struct Address *a, char *mailbox)
+{
+  mailbox_release(&a->mailbox);
+  a->mailbox = a->group ? mailbox : mailbox_share(mailbox);
+}
+
 /**
  * mutt_addr_set_intl - Mark an Address as having IDN components
  * @param a            Address to modify
@@ -956,8 +1173,7 @@ int mutt_addr_mbox_to_udomain(const char *mbox, char **user, char **domain)
  */
 void mutt_addr_set_intl(struct Address *a, char *intl_mailbox)
 {
-  FREE(&a->mailbox);
-  a->mailbox = intl_mailbox;
+  mutt_addr_set_mailbox(a, intl_mailbox);
   a->intl_checked = true;
   a->is_intl = true;
 }
@@ -969,8 +1185,7 @@ void mutt_addr_set_intl(struct Address *a, char *intl_mailbox)
  */
 void mutt_addr_set_local(struct Address *a, char *local_mailbox)
 {
-  FREE(&a->mailbox);
-  a->mailbox = local_mailbox;
+  mutt_addr_set_mailbox(a, local_mailbox);
   a->intl_checked = true;
   a->is_intl = false;
 }
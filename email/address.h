@@ -78,6 +78,7 @@ int             mutt_addr_remove_from_list(struct Address **a, const char *mailb
 bool            mutt_addr_search(struct Address *a, struct Address *lst);
 void            mutt_addr_set_intl(struct Address *a, char *intl_mailbox);
 void            mutt_addr_set_local(struct Address *a, char *local_mailbox);
+void            mutt_addr_set_mailbox(struct Address *a, char *mailbox);
 bool            mutt_addr_valid_msgid(const char *msgid);
 size_t          mutt_addr_write(char *buf, size_t buflen, struct Address *addr, bool display);
 void            mutt_addr_write_single(char *buf, size_t buflen, struct Address *addr, bool display);
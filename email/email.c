@@ -47,13 +47,14 @@ void mutt_email_free(struct Email **e)
   FREE(&(*e)->maildir_flags);
   FREE(&(*e)->tree);
   FREE(&(*e)->path);
+  FREE(&(*e)->pair_memo);
 #ifdef MIXMASTER
   mutt_list_free(&(*e)->chain);
 #endif
   driver_tags_free(&(*e)->tags);
   if ((*e)->data && (*e)->free_data)
     (*e)->free_data(&(*e)->data);
-  FREE(e);
+  mutt_mem_free_tag(MEM_TAG_EMAIL, e, sizeof(struct Email));
 }
 
 /**
@@ -62,11 +63,10 @@ void mutt_email_free(struct Email **e)
  */
 struct Email *mutt_email_new(void)
 {
-  struct Email *e = mutt_mem_calloc(1, sizeof(struct Email));
+  struct Email *e = mutt_mem_calloc_tag(MEM_TAG_EMAIL, 1, sizeof(struct Email));
 #ifdef MIXMASTER
   STAILQ_INIT(&e->chain);
 #endif
-  STAILQ_INIT(&e->tags);
   return e;
 }
 
@@ -71,32 +71,45 @@ struct Email
   /* tells whether the attachment count is valid */
   bool attach_valid : 1;
 
+  /* tells whether the index color is valid */
+  bool pair_valid : 1;
+
+  /* only the flags are known, see mx_msg_load_header() */
+  bool header_pending : 1;
+
   /* the following are used to support collapsing threads  */
   bool collapsed : 1; /**< is this message part of a collapsed thread? */
   bool limited : 1;   /**< is this message in a limited view?  */
-  size_t num_hidden;  /**< number of hidden messages in this view */
 
+  /* The fields the index, sorting and limiting look at for every email are
+   * kept together, at the start of the structure */
+  int index;          /**< the absolute (unsorted) message number */
+  int msgno;          /**< number displayed to the user */
+  int virtual;        /**< virtual message number */
+  int score;
+  int pair;           /**< color-pair to use when displaying in the index */
+  unsigned char *pair_memo; /**< results of the colour rules, see mutt_set_header_color() */
   short recipient;    /**< user_is_recipient()'s return value, cached */
 
-  int pair;           /**< color-pair to use when displaying in the index */
+  /* Number of qualifying attachments in message, if attach_valid */
+  short attach_total;
 
   time_t date_sent;   /**< time when the message was sent (UTC) */
   time_t received;    /**< time when the message was placed in the mailbox */
-  LOFF_T offset;      /**< where in the stream does this message begin? */
-  int lines;          /**< how many lines in the body of this message? */
-  int index;          /**< the absolute (unsorted) message number */
-  int msgno;          /**< number displayed to the user */
-  int virtual;        /**< virtual message number */
-  int score;
   struct Envelope *env;      /**< envelope information */
   struct Body *content;      /**< list of MIME parts */
-  char *path;
 
   char *tree; /**< character string to print thread tree */
   struct MuttThread *thread;
+  size_t num_hidden;  /**< number of hidden messages in this view */
 
-  /* Number of qualifying attachments in message, if attach_valid */
-  short attach_total;
+  LOFF_T offset;      /**< where in the stream does this message begin? */
+  int lines;          /**< how many lines in the body of this message? */
+  int score_raw;           /**< score before it's limited to zero */
+  int score_rules;         /**< score rules applied, negative if an exact one matched */
+  unsigned int score_gen;  /**< generation of the score rules applied */
+  unsigned int attach_rules; /**< digest of the rules attach_total was counted with */
+  char *path;
 
 #ifdef MIXMASTER
   struct ListHead chain;
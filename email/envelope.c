@@ -39,7 +39,7 @@
  */
 struct Envelope *mutt_env_new(void)
 {
-  struct Envelope *e = mutt_mem_calloc(1, sizeof(struct Envelope));
+  struct Envelope *e = mutt_mem_calloc_tag(MEM_TAG_ENVELOPE, 1, sizeof(struct Envelope));
   STAILQ_INIT(&e->references);
   STAILQ_INIT(&e->in_reply_to);
   STAILQ_INIT(&e->userhdrs);
@@ -84,7 +84,7 @@ void mutt_env_free(struct Envelope **p)
   mutt_list_free(&(*p)->references);
   mutt_list_free(&(*p)->in_reply_to);
   mutt_list_free(&(*p)->userhdrs);
-  FREE(p);
+  mutt_mem_free_tag(MEM_TAG_ENVELOPE, p, sizeof(struct Envelope));
 }
 
 /**
@@ -113,6 +113,9 @@ void mutt_env_merge(struct Envelope *base, struct Envelope **extra)
     STAILQ_SWAP(&base->h, &((*extra))->h, ListNode);                           \
   }
 
+  if (!base->to || !base->cc)
+    base->list_valid = false;
+
   MOVE_ELEM(return_path);
   MOVE_ELEM(from);
   MOVE_ELEM(to);
@@ -157,6 +160,76 @@ void mutt_env_merge(struct Envelope *base, struct Envelope **extra)
   mutt_env_free(extra);
 }
 
+/**
+ * copy_stailq - Copy a list of strings
+ * @param dst List to append to
+ * @param src List to copy
+ */
+static void copy_stailq(struct ListHead *dst, const struct ListHead *src)
+{
+  struct ListNode *np = NULL;
+  STAILQ_FOREACH(np, src, entries)
+  {
+    mutt_list_insert_tail(dst, mutt_str_strdup(np->data));
+  }
+}
+
+/**
+ * mutt_env_copy - Make a deep copy of an Envelope
+ * @param env Envelope to copy
+ * @retval ptr New Envelope
+ *
+ * Caller should free the Envelope using mutt_env_free().
+ */
+struct Envelope *mutt_env_copy(struct Envelope *env)
+{
+  struct Envelope *copy = mutt_env_new();
+  if (!env)
+    return copy;
+
+  copy->return_path = mutt_addr_copy_list(env->return_path, false);
+  copy->from = mutt_addr_copy_list(env->from, false);
+  copy->to = mutt_addr_copy_list(env->to, false);
+  copy->cc = mutt_addr_copy_list(env->cc, false);
+  copy->bcc = mutt_addr_copy_list(env->bcc, false);
+  copy->sender = mutt_addr_copy_list(env->sender, false);
+  copy->reply_to = mutt_addr_copy_list(env->reply_to, false);
+  copy->mail_followup_to = mutt_addr_copy_list(env->mail_followup_to, false);
+  copy->x_original_to = mutt_addr_copy_list(env->x_original_to, false);
+
+  copy->list_post = mutt_str_strdup(env->list_post);
+  copy->subject = mutt_str_strdup(env->subject);
+  /* real_subj is an offset to subject */
+  if (env->real_subj && copy->subject)
+    copy->real_subj = copy->subject + (env->real_subj - env->subject);
+  copy->disp_subj = mutt_str_strdup(env->disp_subj);
+  copy->message_id = mutt_str_strdup(env->message_id);
+  copy->supersedes = mutt_str_strdup(env->supersedes);
+  copy->date = mutt_str_strdup(env->date);
+  copy->x_label = mutt_str_strdup(env->x_label);
+  copy->organization = mutt_str_strdup(env->organization);
+#ifdef USE_NNTP
+  copy->newsgroups = mutt_str_strdup(env->newsgroups);
+  copy->xref = mutt_str_strdup(env->xref);
+  copy->followup_to = mutt_str_strdup(env->followup_to);
+  copy->x_comment_to = mutt_str_strdup(env->x_comment_to);
+#endif
+
+  if (env->spam)
+    copy->spam = mutt_buffer_from(NONULL(env->spam->data));
+
+  copy_stailq(&copy->references, &env->references);
+  copy_stailq(&copy->in_reply_to, &env->in_reply_to);
+  copy_stailq(&copy->userhdrs, &env->userhdrs);
+
+  copy->list_pos = env->list_pos;
+  copy->irt_changed = env->irt_changed;
+  copy->refs_changed = env->refs_changed;
+  copy->list_valid = env->list_valid;
+
+  return copy;
+}
+
 /**
  * mutt_env_cmp_strict - Strictly compare two Envelopes
  * @param e1 First Envelope
@@ -60,11 +60,15 @@ struct Envelope
   struct ListHead in_reply_to; /**< in-reply-to header content */
   struct ListHead userhdrs;    /**< user defined headers */
 
+  short list_pos;        /**< position of the first subscribed list in To, then Cc (cache) */
+
   bool irt_changed : 1;  /**< In-Reply-To changed to link/break threads */
   bool refs_changed : 1; /**< References changed to break thread */
+  bool list_valid : 1;   /**< list_pos is valid */
 };
 
 bool             mutt_env_cmp_strict(const struct Envelope *e1, const struct Envelope *e2);
+struct Envelope *mutt_env_copy(struct Envelope *env);
 void             mutt_env_free(struct Envelope **p);
 void             mutt_env_merge(struct Envelope *base, struct Envelope **extra);
 struct Envelope *mutt_env_new(void);
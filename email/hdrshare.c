@@ -0,0 +1,369 @@
+/**
+ * @file
+ * Parsed headers shared between mailboxes
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page email_hdrshare Parsed headers shared between mailboxes
+ *
+ * The same email often turns up in several mailboxes: an IMAP label and "All
+ * Mail", a notmuch vfolder and the Maildir it searches, an article crossposted
+ * to several newsgroups.  Each mailbox used to parse its own copy of the
+ * header.
+ *
+ * The results of recent parses are kept here, keyed by a digest of the header
+ * text, so an identical header is copied instead of parsed again.  Entries are
+ * reference counted, so one can be copied outside the lock while another
+ * thread evicts it.  The least recently used entries are dropped once there
+ * are more than $header_share_size of them.
+ *
+ * The parse depends on some config, e.g. $reply_regex and $assumed_charset.
+ * mutt_hdrshare_flush() must be called when it changes.
+ */
+
+#include "config.h"
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "mutt/mutt.h"
+#include "hdrshare.h"
+#include "body.h"
+#include "email.h"
+#include "envelope.h"
+#include "parameter.h"
+#include "parse.h"
+
+/* These Config Variables are only used in email/hdrshare.c */
+short HeaderShareSize; ///< Config: Number of parsed headers kept for other mailboxes
+
+/**
+ * struct HdrShare - The parsed header of an email
+ *
+ * The parts are only read, never changed, once the entry is in the table.
+ */
+struct HdrShare
+{
+  char key[33];            ///< MD5 of the header text, in hex
+  struct Envelope *env;    ///< Parsed envelope
+  struct Body *content;    ///< Content-* headers
+  LOFF_T body_pos;         ///< Offset of the body from the start of the header
+  time_t date_sent;        ///< Email.date_sent
+  time_t received;         ///< Email.received
+  int lines;               ///< Email.lines
+  unsigned int zhours : 5; ///< Email.zhours
+  unsigned int zminutes : 6; ///< Email.zminutes
+  bool zoccident : 1;      ///< Email.zoccident
+  bool mime : 1;           ///< Email.mime
+  bool expired : 1;        ///< Email.expired
+  bool read : 1;           ///< Email.read, from a Status header
+  bool old : 1;            ///< Email.old, from a Status header
+  bool flagged : 1;        ///< Email.flagged, from an X-Status header
+  bool replied : 1;        ///< Email.replied, from an X-Status header
+  bool deleted : 1;        ///< Email.deleted, from an X-Status header
+  bool dead : 1;           ///< Evicted, free it when the last user is done
+  int refs;                ///< Number of users copying it
+  TAILQ_ENTRY(HdrShare) entries; ///< Linked list, most recently used first
+};
+TAILQ_HEAD(HdrShareList, HdrShare);
+
+static struct Hash *HdrShareTable = NULL; ///< Key -> HdrShare
+static struct HdrShareList HdrShareLru = TAILQ_HEAD_INITIALIZER(HdrShareLru);
+
+#ifdef USE_THREADS
+/* Headers may be parsed by several threads at once */
+static pthread_mutex_t HdrShareLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * copy_content - Copy the parts of a Body that the header parse sets
+ * @param b Body to copy
+ * @retval ptr New Body
+ */
+static struct Body *copy_content(const struct Body *b)
+{
+  struct Body *c = mutt_body_new();
+
+  c->type = b->type;
+  c->subtype = mutt_str_strdup(b->subtype);
+  c->xtype = mutt_str_strdup(b->xtype);
+  c->language = mutt_str_strdup(b->language);
+  c->description = mutt_str_strdup(b->description);
+  c->form_name = mutt_str_strdup(b->form_name);
+  c->filename = mutt_str_strdup(b->filename);
+  c->d_filename = mutt_str_strdup(b->d_filename);
+  c->charset = mutt_str_strdup(b->charset);
+  c->encoding = b->encoding;
+  c->disposition = b->disposition;
+  c->use_disp = b->use_disp;
+  c->length = b->length;
+
+  struct Parameter *np = NULL;
+  TAILQ_FOREACH(np, &b->parameter, entries)
+  {
+    struct Parameter *p = mutt_param_new();
+    p->attribute = mutt_str_strdup(np->attribute);
+    p->value = mutt_str_strdup(np->value);
+    TAILQ_INSERT_TAIL(&c->parameter, p, entries);
+  }
+
+  return c;
+}
+
+/**
+ * share_free - Free a HdrShare
+ * @param hs HdrShare to free
+ */
+static void share_free(struct HdrShare **hs)
+{
+  if (!hs || !*hs)
+    return;
+
+  mutt_env_free(&(*hs)->env);
+  mutt_body_free(&(*hs)->content);
+  FREE(hs);
+}
+
+/**
+ * share_evict - Take a HdrShare out of the table
+ * @param hs HdrShare to remove
+ *
+ * The lock must be held.  The entry is freed now, or by share_release() if
+ * it's still being copied.
+ */
+static void share_evict(struct HdrShare *hs)
+{
+  mutt_hash_delete(HdrShareTable, hs->key, hs);
+  TAILQ_REMOVE(&HdrShareLru, hs, entries);
+  if (hs->refs > 0)
+    hs->dead = true;
+  else
+    share_free(&hs);
+}
+
+/**
+ * share_find - Find the parsed header for a key
+ * @param key Digest of the header text
+ * @retval ptr  HdrShare, release it with share_release()
+ * @retval NULL No match
+ */
+static struct HdrShare *share_find(const char *key)
+{
+  struct HdrShare *hs = NULL;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&HdrShareLock);
+#endif
+  if (HdrShareTable)
+    hs = mutt_hash_find(HdrShareTable, key);
+  if (hs)
+  {
+    hs->refs++;
+    TAILQ_REMOVE(&HdrShareLru, hs, entries);
+    TAILQ_INSERT_HEAD(&HdrShareLru, hs, entries);
+  }
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&HdrShareLock);
+#endif
+
+  return hs;
+}
+
+/**
+ * share_release - Stop using a HdrShare
+ * @param hs HdrShare from share_find()
+ */
+static void share_release(struct HdrShare *hs)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&HdrShareLock);
+#endif
+  hs->refs--;
+  if (hs->dead && (hs->refs == 0))
+    share_free(&hs);
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&HdrShareLock);
+#endif
+}
+
+/**
+ * share_add - Keep a parsed header
+ * @param key Digest of the header text
+ * @param env Envelope that was parsed
+ * @param e   Email that was parsed
+ */
+static void share_add(const char *key, struct Envelope *env, const struct Email *e)
+{
+  struct HdrShare *hs = mutt_mem_calloc(1, sizeof(struct HdrShare));
+
+  mutt_str_strfcpy(hs->key, key, sizeof(hs->key));
+  hs->env = mutt_env_copy(env);
+  hs->content = copy_content(e->content);
+  hs->body_pos = e->content->offset - e->offset;
+  hs->date_sent = e->date_sent;
+  hs->received = e->received;
+  hs->lines = e->lines;
+  hs->zhours = e->zhours;
+  hs->zminutes = e->zminutes;
+  hs->zoccident = e->zoccident;
+  hs->mime = e->mime;
+  hs->expired = e->expired;
+  hs->read = e->read;
+  hs->old = e->old;
+  hs->flagged = e->flagged;
+  hs->replied = e->replied;
+  hs->deleted = e->deleted;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&HdrShareLock);
+#endif
+  if (!HdrShareTable)
+    HdrShareTable = mutt_hash_create(1024, 0);
+
+  /* another thread may have parsed the same header */
+  if (mutt_hash_find(HdrShareTable, hs->key))
+    share_free(&hs);
+  else
+  {
+    mutt_hash_insert(HdrShareTable, hs->key, hs);
+    TAILQ_INSERT_HEAD(&HdrShareLru, hs, entries);
+  }
+
+  while (HdrShareTable->count > (size_t) MAX(HeaderShareSize, 0))
+    share_evict(TAILQ_LAST(&HdrShareLru, HdrShareList));
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&HdrShareLock);
+#endif
+}
+
+/**
+ * share_apply - Fill in an Email from a parsed header
+ * @param hs HdrShare to copy
+ * @param e  Email to fill in
+ * @retval ptr New Envelope
+ */
+static struct Envelope *share_apply(const struct HdrShare *hs, struct Email *e)
+{
+  e->content = copy_content(hs->content);
+  e->content->hdr_offset = e->offset;
+  e->content->offset = e->offset + hs->body_pos;
+  e->date_sent = hs->date_sent;
+  e->received = hs->received;
+  e->lines = hs->lines;
+  e->zhours = hs->zhours;
+  e->zminutes = hs->zminutes;
+  e->zoccident = hs->zoccident;
+  e->mime = hs->mime;
+  e->expired = hs->expired;
+  e->read = hs->read;
+  e->old = hs->old;
+  e->flagged = hs->flagged;
+  e->replied = hs->replied;
+  e->deleted = hs->deleted;
+
+  return mutt_env_copy(hs->env);
+}
+
+/**
+ * share_key - Work out the key of a header
+ * @param buf Text of the message, starting with its header
+ * @param len Length of the text
+ * @param e   Email being parsed
+ * @param key Buffer for the key, at least 33 bytes
+ *
+ * Only the text up to the first blank line can affect the parse.  The
+ * received time is included, because it's the fallback for a missing Date.
+ */
+static void share_key(const char *buf, size_t len, const struct Email *e, char *key)
+{
+  struct Md5Ctx ctx;
+  unsigned char digest[16];
+
+  for (size_t i = 0; (i + 1) < len; i++)
+  {
+    if (buf[i] != '\n')
+      continue;
+    if ((buf[i + 1] == '\n') || ((buf[i + 1] == '\r') && ((i + 2) < len) && (buf[i + 2] == '\n')))
+    {
+      len = i + 1;
+      break;
+    }
+  }
+
+  mutt_md5_init_ctx(&ctx);
+  mutt_md5_process_bytes(&e->received, sizeof(e->received), &ctx);
+  mutt_md5_process_bytes(buf, len, &ctx);
+  mutt_md5_finish_ctx(&ctx, digest);
+  mutt_md5_toascii(digest, key);
+}
+
+/**
+ * mutt_hdrshare_read_header - Parse an RFC822 header, reusing an earlier parse
+ * @param buf Text of the message, starting with its header
+ * @param len Length of the text
+ * @param e   Email to fill in
+ * @retval ptr Newly allocated envelope structure
+ *
+ * Like mutt_rfc822_read_header_mem(), without user headers.  If the same
+ * header has been parsed recently, by any mailbox, the result is copied.
+ *
+ * Caller should free the Envelope using mutt_env_free().
+ */
+struct Envelope *mutt_hdrshare_read_header(const char *buf, size_t len, struct Email *e)
+{
+  if (!e || e->content || (HeaderShareSize <= 0))
+    return mutt_rfc822_read_header_mem(buf, len, e, false, false);
+
+  char key[33];
+  share_key(buf, len, e, key);
+
+  struct HdrShare *hs = share_find(key);
+  if (hs)
+  {
+    struct Envelope *env = share_apply(hs, e);
+    share_release(hs);
+    return env;
+  }
+
+  struct Envelope *env = mutt_rfc822_read_header_mem(buf, len, e, false, false);
+  share_add(key, env, e);
+  return env;
+}
+
+/**
+ * mutt_hdrshare_flush - Forget all the parsed headers
+ */
+void mutt_hdrshare_flush(void)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&HdrShareLock);
+#endif
+  struct HdrShare *hs = NULL, *tmp = NULL;
+  TAILQ_FOREACH_SAFE(hs, &HdrShareLru, entries, tmp)
+  {
+    share_evict(hs);
+  }
+  mutt_hash_destroy(&HdrShareTable);
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&HdrShareLock);
+#endif
+}
@@ -0,0 +1,37 @@
+/**
+ * @file
+ * Parsed headers shared between mailboxes
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_EMAIL_HDRSHARE_H
+#define MUTT_EMAIL_HDRSHARE_H
+
+#include <stddef.h>
+
+struct Email;
+struct Envelope;
+
+/* These Config Variables are only used in email/hdrshare.c */
+extern short HeaderShareSize;
+
+void             mutt_hdrshare_flush(void);
+struct Envelope *mutt_hdrshare_read_header(const char *buf, size_t len, struct Email *e);
+
+#endif /* MUTT_EMAIL_HDRSHARE_H */
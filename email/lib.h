@@ -34,6 +34,7 @@
  * | email/envelope.c       | @subpage email_envelope  |
  * | email/from.c           | @subpage email_from      |
  * | email/email.c          | @subpage email_email     |
+ * | email/hdrshare.c       | @subpage email_hdrshare  |
  * | email/idna.c           | @subpage email_idna      |
  * | email/mime.c           | @subpage email_mime      |
  * | email/parameter.c      | @subpage email_parameter |
@@ -56,6 +57,7 @@
 #include "email_globals.h"
 #include "envelope.h"
 #include "from.h"
+#include "hdrshare.h"
 #include "idna2.h"
 #include "mime.h"
 #include "parameter.h"
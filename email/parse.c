@@ -235,16 +235,158 @@ static void parse_content_language(char *s, struct Body *ct)
   ct->language = mutt_str_strdup(s);
 }
 
+/**
+ * struct IgnoreNode - One character of a header prefix
+ */
+struct IgnoreNode
+{
+  unsigned char ch; ///< Lower-case character
+  bool end;         ///< A prefix ends here
+  int child;        ///< First node of the next character, or -1
+  int next;         ///< Next sibling node, or -1
+};
+
+/**
+ * struct IgnoreTrie - Case-insensitive prefix matcher for a list of headers
+ *
+ * This matches the same strings as mutt_list_match(), but walks each header
+ * name once, rather than comparing it against every member of the list.
+ */
+struct IgnoreTrie
+{
+  struct IgnoreNode *nodes; ///< Node 0 is the root
+  int num;                  ///< Number of nodes in use
+  int size;                 ///< Number of nodes allocated
+  bool all;                 ///< The list contains "*"
+};
+
+static struct IgnoreTrie IgnoreMatch;   ///< Compiled #Ignore
+static struct IgnoreTrie UnIgnoreMatch; ///< Compiled #UnIgnore
+
+/**
+ * trie_new_node - Add a node to a trie
+ * @param t  Trie
+ * @param ch Character
+ * @retval num Index of the new node
+ */
+static int trie_new_node(struct IgnoreTrie *t, unsigned char ch)
+{
+  if (t->num == t->size)
+  {
+    t->size = t->size ? (t->size * 2) : 64;
+    mutt_mem_realloc(&t->nodes, t->size * sizeof(struct IgnoreNode));
+  }
+
+  struct IgnoreNode *n = &t->nodes[t->num];
+  n->ch = ch;
+  n->end = false;
+  n->child = -1;
+  n->next = -1;
+  return t->num++;
+}
+
+/**
+ * trie_compile - Build a trie from a list of header prefixes
+ * @param t Trie to fill
+ * @param h List of prefixes
+ */
+static void trie_compile(struct IgnoreTrie *t, struct ListHead *h)
+{
+  t->num = 0;
+  t->all = false;
+  trie_new_node(t, '\0');
+
+  struct ListNode *np = NULL;
+  STAILQ_FOREACH(np, h, entries)
+  {
+    if (*np->data == '*')
+    {
+      t->all = true;
+      continue;
+    }
+
+    int cur = 0;
+    for (const unsigned char *p = (const unsigned char *) np->data; *p; p++)
+    {
+      const unsigned char ch = tolower(*p);
+      int i;
+      for (i = t->nodes[cur].child; (i != -1) && (t->nodes[i].ch != ch);
+           i = t->nodes[i].next)
+        ;
+      if (i == -1)
+      {
+        i = trie_new_node(t, ch);
+        t->nodes[i].next = t->nodes[cur].child;
+        t->nodes[cur].child = i;
+      }
+      cur = i;
+    }
+    t->nodes[cur].end = true;
+  }
+}
+
+/**
+ * trie_match - Does a string start with any of the prefixes in a trie
+ * @param t Trie
+ * @param s String to check
+ * @retval true String matches
+ */
+static bool trie_match(const struct IgnoreTrie *t, const char *s)
+{
+  if (t->all)
+    return true;
+  if (t->num == 0)
+    return false;
+
+  int cur = 0;
+  for (const unsigned char *p = (const unsigned char *) s;; p++)
+  {
+    if (t->nodes[cur].end)
+      return true;
+    if (!*p)
+      return false;
+
+    const unsigned char ch = tolower(*p);
+    for (cur = t->nodes[cur].child; (cur != -1) && (t->nodes[cur].ch != ch);
+         cur = t->nodes[cur].next)
+      ;
+    if (cur == -1)
+      return false;
+  }
+}
+
+/**
+ * mutt_ignore_compile - Rebuild the matchers for the ignore lists
+ *
+ * This must be called whenever #Ignore or #UnIgnore changes.
+ */
+void mutt_ignore_compile(void)
+{
+  trie_compile(&IgnoreMatch, &Ignore);
+  trie_compile(&UnIgnoreMatch, &UnIgnore);
+}
+
+/**
+ * mutt_ignore_free - Free the matchers for the ignore lists
+ */
+void mutt_ignore_free(void)
+{
+  FREE(&IgnoreMatch.nodes);
+  FREE(&UnIgnoreMatch.nodes);
+  memset(&IgnoreMatch, 0, sizeof(IgnoreMatch));
+  memset(&UnIgnoreMatch, 0, sizeof(UnIgnoreMatch));
+}
+
 /**
  * mutt_matches_ignore - Does the string match the ignore list
  * @param s String to check
  * @retval true If string matches
  *
- * Checks Ignore and UnIgnore using mutt_list_match
+ * Checks the compiled Ignore and UnIgnore lists, see mutt_ignore_compile().
  */
 bool mutt_matches_ignore(const char *s)
 {
-  return mutt_list_match(s, &Ignore) && !mutt_list_match(s, &UnIgnore);
+  return trie_match(&IgnoreMatch, s) && !trie_match(&UnIgnoreMatch, s);
 }
 
 /**
@@ -948,118 +1090,277 @@ char *mutt_rfc822_read_line(FILE *f, char *line, size_t *linelen)
 }
 
 /**
- * mutt_rfc822_read_header - parses an RFC822 header
- * @param f         Stream to read from
- * @param e         Header structure of current message (optional)
- * @param user_hdrs If set, store user headers
- *                  Used for recall-message and postpone modes
- * @param weed      If this parameter is set and the user has activated the
- *                  $weed option, honor the header weed list for user headers.
- *                  Used for recall-message
- * @retval ptr Newly allocated envelope structure
+ * read_line_mem - Read a header line from memory
+ * @param[in]     buf     Header text
+ * @param[in]     len     Length of the header text
+ * @param[in,out] pos     Offset of the line, moved past it
+ * @param[in]     line    Buffer containing the result
+ * @param[in,out] linelen Length of buffer
+ * @retval ptr Line
  *
- * Caller should free the Envelope using mutt_env_free().
+ * Like mutt_rfc822_read_line(), but the line boundaries are found with
+ * memchr() rather than by reading a character at a time.  The result is the
+ * same, including the empty line, returned at the end of the header or of
+ * the text.
  */
-struct Envelope *mutt_rfc822_read_header(FILE *f, struct Email *e, bool user_hdrs, bool weed)
+static char *read_line_mem(const char *buf, size_t len, size_t *pos, char *line, size_t *linelen)
 {
-  struct Envelope *env = mutt_env_new();
-  char *line = mutt_mem_malloc(LONG_STRING);
-  char *p = NULL;
-  LOFF_T loc;
-  size_t linelen = LONG_STRING;
-  char buf[LONG_STRING + 1];
+  size_t offset = 0;
+  size_t i = *pos;
 
-  if (e)
+  while (true)
   {
-    if (!e->content)
+    if ((i >= len) || (ISSPACE(buf[i]) && !offset)) /* end of text or headers */
+    {
+      /* like fgets(), the line that ended the header has been read */
+      const char *nl = (i < len) ? memchr(buf + i, '\n', len - i) : NULL;
+      *pos = nl ? (nl - buf) + 1 : len;
+      *line = 0;
+      return line;
+    }
+
+    const char *nl = memchr(buf + i, '\n', len - i);
+    if (!nl)
+    {
+      /* an unterminated last line is dropped, as fgets() would */
+      *pos = len;
+      *line = 0;
+      return line;
+    }
+
+    const size_t n = (nl - buf) + 1 - i;
+    if (*linelen < (offset + n + STRING))
     {
-      e->content = mutt_body_new();
+      /* grow the buffer */
+      *linelen = offset + n + STRING;
+      mutt_mem_realloc(&line, *linelen);
+    }
+    memcpy(line + offset, buf + i, n);
+    line[offset + n] = '\0';
+    i += n;
 
-      /* set the defaults from RFC1521 */
-      e->content->type = TYPE_TEXT;
-      e->content->subtype = mutt_str_strdup("plain");
-      e->content->encoding = ENC_7BIT;
-      e->content->length = -1;
+    /* a NUL stops the line, as it does for fgets() and strlen() */
+    char *p = line + offset + mutt_str_strlen(line + offset) - 1;
+    if (p < line + offset)
+    {
+      *pos = i;
+      return line;
+    }
 
-      /* RFC2183 says this is arbitrary */
-      e->content->disposition = DISP_INLINE;
+    if (*p != '\n')
+    {
+      offset = p + 1 - line;
+      continue;
     }
-  }
 
-  while ((loc = ftello(f)) != -1)
-  {
-    line = mutt_rfc822_read_line(f, line, &linelen);
-    if (*line == '\0')
-      break;
-    p = strpbrk(line, ": \t");
-    if (!p || (*p != ':'))
+    /* we did get a full line. remove trailing space */
+    while (ISSPACE(*p))
+      *p-- = 0;
+
+    /* check to see if the next line is a continuation line */
+    if ((i >= len) || ((buf[i] != ' ') && (buf[i] != '\t')))
     {
-      char return_path[LONG_STRING];
-      time_t t;
+      *pos = i;
+      return line; /* next line is a separate header field or EOH */
+    }
 
-      /* some bogus MTAs will quote the original "From " line */
-      if (mutt_str_strncmp(">From ", line, 6) == 0)
-        continue; /* just ignore */
-      else if (is_from(line, return_path, sizeof(return_path), &t))
-      {
-        /* MH sometimes has the From_ line in the middle of the header! */
-        if (e && !e->received)
-          e->received = t - mutt_date_local_tz(t);
-        continue;
-      }
+    /* eat tabs and spaces from the beginning of the continuation line */
+    while ((i < len) && ((buf[i] == ' ') || (buf[i] == '\t')))
+      i++;
+    *++p = ' '; /* string is still terminated because we removed
+                   at least one whitespace char above */
+    offset = p + 1 - line;
+  }
+  /* not reached */
+}
 
-      fseeko(f, loc, SEEK_SET);
-      break; /* end of header */
+/**
+ * header_init - Set up an Email for parsing its header
+ * @param e Email (OPTIONAL)
+ */
+static void header_init(struct Email *e)
+{
+  if (!e || e->content)
+    return;
+
+  e->content = mutt_body_new();
+
+  /* set the defaults from RFC1521 */
+  e->content->type = TYPE_TEXT;
+  e->content->subtype = mutt_str_strdup("plain");
+  e->content->encoding = ENC_7BIT;
+  e->content->length = -1;
+
+  /* RFC2183 says this is arbitrary */
+  e->content->disposition = DISP_INLINE;
+}
+
+/**
+ * header_parse_line - Parse one line of an RFC822 header
+ * @param env       Envelope to fill in
+ * @param e         Email (OPTIONAL)
+ * @param line      Header line, will be modified
+ * @param user_hdrs If set, store user headers
+ * @param weed      If set, honor the header weed list for user headers
+ * @retval true  The line is part of the header
+ * @retval false The line isn't a header field, the header has ended
+ */
+static bool header_parse_line(struct Envelope *env, struct Email *e, char *line,
+                              bool user_hdrs, bool weed)
+{
+  char buf[LONG_STRING + 1];
+
+  char *p = strpbrk(line, ": \t");
+  if (!p || (*p != ':'))
+  {
+    char return_path[LONG_STRING];
+    time_t t;
+
+    /* some bogus MTAs will quote the original "From " line */
+    if (mutt_str_strncmp(">From ", line, 6) == 0)
+      return true; /* just ignore */
+    else if (is_from(line, return_path, sizeof(return_path), &t))
+    {
+      /* MH sometimes has the From_ line in the middle of the header! */
+      if (e && !e->received)
+        e->received = t - mutt_date_local_tz(t);
+      return true;
     }
 
-    *buf = '\0';
+    return false; /* end of header */
+  }
+
+  *buf = '\0';
 
-    if (mutt_replacelist_match(&SpamList, buf, sizeof(buf), line))
+  if (mutt_replacelist_match(&SpamList, buf, sizeof(buf), line))
+  {
+    if (!mutt_regexlist_match(&NoSpamList, line))
     {
-      if (!mutt_regexlist_match(&NoSpamList, line))
+      /* if spam tag already exists, figure out how to amend it */
+      if (env->spam && *buf)
       {
-        /* if spam tag already exists, figure out how to amend it */
-        if (env->spam && *buf)
+        /* If SpamSeparator defined, append with separator */
+        if (SpamSeparator)
         {
-          /* If SpamSeparator defined, append with separator */
-          if (SpamSeparator)
-          {
-            mutt_buffer_addstr(env->spam, SpamSeparator);
-            mutt_buffer_addstr(env->spam, buf);
-          }
-
-          /* else overwrite */
-          else
-          {
-            env->spam->dptr = env->spam->data;
-            *env->spam->dptr = '\0';
-            mutt_buffer_addstr(env->spam, buf);
-          }
+          mutt_buffer_addstr(env->spam, SpamSeparator);
+          mutt_buffer_addstr(env->spam, buf);
         }
 
-        /* spam tag is new, and match expr is non-empty; copy */
-        else if (!env->spam && *buf)
+        /* else overwrite */
+        else
         {
-          env->spam = mutt_buffer_from(buf);
+          env->spam->dptr = env->spam->data;
+          *env->spam->dptr = '\0';
+          mutt_buffer_addstr(env->spam, buf);
         }
+      }
 
-        /* match expr is empty; plug in null string if no existing tag */
-        else if (!env->spam)
-        {
-          env->spam = mutt_buffer_from("");
-        }
+      /* spam tag is new, and match expr is non-empty; copy */
+      else if (!env->spam && *buf)
+      {
+        env->spam = mutt_buffer_from(buf);
+      }
 
-        if (env->spam && env->spam->data)
-          mutt_debug(5, "spam = %s\n", env->spam->data);
+      /* match expr is empty; plug in null string if no existing tag */
+      else if (!env->spam)
+      {
+        env->spam = mutt_buffer_from("");
       }
+
+      if (env->spam && env->spam->data)
+        mutt_debug(5, "spam = %s\n", env->spam->data);
     }
+  }
 
-    *p = 0;
-    p = mutt_str_skip_email_wsp(p + 1);
-    if (!*p)
-      continue; /* skip empty header fields */
+  *p = 0;
+  p = mutt_str_skip_email_wsp(p + 1);
+  if (!*p)
+    return true; /* skip empty header fields */
+
+  mutt_rfc822_parse_line(env, e, line, p, user_hdrs, weed, true);
+  return true;
+}
+
+/**
+ * header_finish - Tidy up an Envelope after parsing its header
+ * @param env Envelope
+ * @param e   Email
+ */
+static void header_finish(struct Envelope *env, struct Email *e)
+{
+  /* do RFC2047 decoding */
+  rfc2047_decode_addrlist(env->from);
+  rfc2047_decode_addrlist(env->to);
+  rfc2047_decode_addrlist(env->cc);
+  rfc2047_decode_addrlist(env->bcc);
+  rfc2047_decode_addrlist(env->reply_to);
+  rfc2047_decode_addrlist(env->mail_followup_to);
+  rfc2047_decode_addrlist(env->return_path);
+  rfc2047_decode_addrlist(env->sender);
+  rfc2047_decode_addrlist(env->x_original_to);
+
+  if (env->subject)
+  {
+    regmatch_t pmatch[1];
+
+    rfc2047_decode(&env->subject);
+
+    if (ReplyRegex && ReplyRegex->regex &&
+        (regexec(ReplyRegex->regex, env->subject, 1, pmatch, 0) == 0))
+    {
+      env->real_subj = env->subject + pmatch[0].rm_eo;
+    }
+    else
+      env->real_subj = env->subject;
+  }
+
+  if (e->received < 0)
+  {
+    mutt_debug(1, "resetting invalid received time to 0\n");
+    e->received = 0;
+  }
+
+  /* check for missing or invalid date */
+  if (e->date_sent <= 0)
+  {
+    mutt_debug(1, "no date found, using received time from msg separator\n");
+    e->date_sent = e->received;
+  }
+}
+
+/**
+ * mutt_rfc822_read_header - parses an RFC822 header
+ * @param f         Stream to read from
+ * @param e         Header structure of current message (optional)
+ * @param user_hdrs If set, store user headers
+ *                  Used for recall-message and postpone modes
+ * @param weed      If this parameter is set and the user has activated the
+ *                  $weed option, honor the header weed list for user headers.
+ *                  Used for recall-message
+ * @retval ptr Newly allocated envelope structure
+ *
+ * Caller should free the Envelope using mutt_env_free().
+ */
+struct Envelope *mutt_rfc822_read_header(FILE *f, struct Email *e, bool user_hdrs, bool weed)
+{
+  struct Envelope *env = mutt_env_new();
+  char *line = mutt_mem_malloc(LONG_STRING);
+  LOFF_T loc;
+  size_t linelen = LONG_STRING;
+
+  mutt_trace_begin("read_header", NULL);
+  header_init(e);
 
-    mutt_rfc822_parse_line(env, e, line, p, user_hdrs, weed, true);
+  while ((loc = ftello(f)) != -1)
+  {
+    line = mutt_rfc822_read_line(f, line, &linelen);
+    if (*line == '\0')
+      break;
+    if (!header_parse_line(env, e, line, user_hdrs, weed))
+    {
+      fseeko(f, loc, SEEK_SET);
+      break; /* end of header */
+    }
   }
 
   FREE(&line);
@@ -1068,45 +1369,59 @@ struct Envelope *mutt_rfc822_read_header(FILE *f, struct Email *e, bool user_hdr
   {
     e->content->hdr_offset = e->offset;
     e->content->offset = ftello(f);
+    header_finish(env, e);
+  }
 
-    /* do RFC2047 decoding */
-    rfc2047_decode_addrlist(env->from);
-    rfc2047_decode_addrlist(env->to);
-    rfc2047_decode_addrlist(env->cc);
-    rfc2047_decode_addrlist(env->bcc);
-    rfc2047_decode_addrlist(env->reply_to);
-    rfc2047_decode_addrlist(env->mail_followup_to);
-    rfc2047_decode_addrlist(env->return_path);
-    rfc2047_decode_addrlist(env->sender);
-    rfc2047_decode_addrlist(env->x_original_to);
-
-    if (env->subject)
-    {
-      regmatch_t pmatch[1];
+  mutt_trace_end("read_header");
+  return env;
+}
 
-      rfc2047_decode(&env->subject);
+/**
+ * mutt_rfc822_read_header_mem - Parse an RFC822 header in memory
+ * @param buf       Text of the message, starting with its header
+ * @param len       Length of the text
+ * @param e         Header structure of current message (optional)
+ * @param user_hdrs If set, store user headers
+ * @param weed      If set, honor the header weed list for user headers
+ * @retval ptr Newly allocated envelope structure
+ *
+ * Like mutt_rfc822_read_header(), but without the stdio calls for every line.
+ * The text is taken to start at e->offset in the message's file, which sets the
+ * offset of the body.  The text doesn't have to be NUL-terminated, or to go
+ * beyond the blank line after the header.
+ *
+ * Caller should free the Envelope using mutt_env_free().
+ */
+struct Envelope *mutt_rfc822_read_header_mem(const char *buf, size_t len, struct Email *e,
+                                             bool user_hdrs, bool weed)
+{
+  struct Envelope *env = mutt_env_new();
+  char *line = mutt_mem_malloc(LONG_STRING);
+  size_t linelen = LONG_STRING;
+  size_t pos = 0;
 
-      if (ReplyRegex && ReplyRegex->regex &&
-          (regexec(ReplyRegex->regex, env->subject, 1, pmatch, 0) == 0))
-      {
-        env->real_subj = env->subject + pmatch[0].rm_eo;
-      }
-      else
-        env->real_subj = env->subject;
-    }
+  header_init(e);
 
-    if (e->received < 0)
+  while (pos < len)
+  {
+    const size_t loc = pos;
+    line = read_line_mem(buf, len, &pos, line, &linelen);
+    if (*line == '\0')
+      break;
+    if (!header_parse_line(env, e, line, user_hdrs, weed))
     {
-      mutt_debug(1, "resetting invalid received time to 0\n");
-      e->received = 0;
+      pos = loc;
+      break; /* end of header */
     }
+  }
 
-    /* check for missing or invalid date */
-    if (e->date_sent <= 0)
-    {
-      mutt_debug(1, "no date found, using received time from msg separator\n");
-      e->date_sent = e->received;
-    }
+  FREE(&line);
+
+  if (e)
+  {
+    e->content->hdr_offset = e->offset;
+    e->content->offset = e->offset + pos;
+    header_finish(env, e);
   }
 
   return env;
@@ -33,6 +33,8 @@ struct Email;
 int              mutt_check_encoding(const char *c);
 int              mutt_check_mime_type(const char *s);
 char *           mutt_extract_message_id(const char *s, const char **saveptr);
+void             mutt_ignore_compile(void);
+void             mutt_ignore_free(void);
 bool             mutt_is_message_type(int type, const char *subtype);
 bool             mutt_matches_ignore(const char *s);
 void             mutt_parse_content_type(char *s, struct Body *ct);
@@ -42,6 +44,7 @@ struct Body *    mutt_read_mime_header(FILE *fp, bool digest);
 int              mutt_rfc822_parse_line(struct Envelope *env, struct Email *e, char *line, char *p, bool user_hdrs, bool weed, bool do_2047);
 struct Body *    mutt_rfc822_parse_message(FILE *fp, struct Body *parent);
 struct Envelope *mutt_rfc822_read_header(FILE *f, struct Email *e, bool user_hdrs, bool weed);
+struct Envelope *mutt_rfc822_read_header_mem(const char *buf, size_t len, struct Email *e, bool user_hdrs, bool weed);
 char *           mutt_rfc822_read_line(FILE *f, char *line, size_t *linelen);
 
 #endif /* MUTT_EMAIL_PARSE_H */
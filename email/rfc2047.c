@@ -32,6 +32,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <iconv.h>
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 #include <regex.h>
 #include <stdbool.h>
 #include <string.h>
@@ -124,6 +127,25 @@ static size_t q_encoder(char *str, const char *buf, size_t buflen, const char *t
   return str - s0;
 }
 
+static struct Regex *EncodedWordRegex = NULL; ///< Matches an RFC2047 encoded word
+
+/**
+ * encoded_word_regex_compile - Compile the regex used by parse_encoded_word()
+ */
+static void encoded_word_regex_compile(void)
+{
+  EncodedWordRegex = mutt_regex_compile("=\\?"
+                                        "([^][()<>@,;:\\\"/?. =]+)" /* charset */
+                                        "\\?"
+                                        "([qQbB])" /* encoding */
+                                        "\\?"
+                                        "([^?]+)" /* encoded text - we accept whitespace
+                                                     as some mailers do that, see #1189. */
+                                        "\\?=",
+                                        REG_EXTENDED);
+  assert(EncodedWordRegex && "Something is wrong with your RE engine.");
+}
+
 /**
  * parse_encoded_word - Parse a string and report RFC2047 elements
  * @param[in]  str        String to parse
@@ -138,23 +160,18 @@ static size_t q_encoder(char *str, const char *buf, size_t buflen, const char *t
 static char *parse_encoded_word(char *str, enum ContentEncoding *enc, char **charset,
                                 size_t *charsetlen, char **text, size_t *textlen)
 {
-  static struct Regex *re = NULL;
   regmatch_t match[4];
   size_t nmatch = 4;
 
-  if (!re)
-  {
-    re = mutt_regex_compile("=\\?"
-                            "([^][()<>@,;:\\\"/?. =]+)" /* charset */
-                            "\\?"
-                            "([qQbB])" /* encoding */
-                            "\\?"
-                            "([^?]+)" /* encoded text - we accept whitespace
-                                         as some mailers do that, see #1189. */
-                            "\\?=",
-                            REG_EXTENDED);
-    assert(re && "Something is wrong with your RE engine.");
-  }
+#ifdef USE_THREADS
+  /* Headers may be decoded by several threads at once */
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, encoded_word_regex_compile);
+#else
+  if (!EncodedWordRegex)
+    encoded_word_regex_compile();
+#endif
+  struct Regex *re = EncodedWordRegex;
 
   int rc = regexec(re->regex, str, nmatch, match, 0);
   if (rc != 0)
@@ -204,7 +221,7 @@ static size_t try_block(const char *d, size_t dlen, const char *fromcode,
 
   if (fromcode)
   {
-    iconv_t cd = mutt_ch_iconv_open(tocode, fromcode, 0);
+    iconv_t cd = mutt_ch_iconv_get(tocode, fromcode, 0);
     assert(cd != (iconv_t)(-1));
     ib = d;
     ibl = dlen;
@@ -214,11 +231,9 @@ static size_t try_block(const char *d, size_t dlen, const char *fromcode,
         iconv(cd, NULL, NULL, &ob, &obl) == (size_t)(-1))
     {
       assert(errno == E2BIG);
-      iconv_close(cd);
       assert(ib > d);
       return (ib - d == dlen) ? dlen : ib - d + 1;
     }
-    iconv_close(cd);
   }
   else
   {
@@ -284,7 +299,7 @@ static size_t encode_block(char *str, char *buf, size_t buflen, const char *from
     return (*encoder)(str, buf, buflen, tocode);
   }
 
-  const iconv_t cd = mutt_ch_iconv_open(tocode, fromcode, 0);
+  const iconv_t cd = mutt_ch_iconv_get(tocode, fromcode, 0);
   assert(cd != (iconv_t)(-1));
   const char *ib = buf;
   size_t ibl = buflen;
@@ -294,7 +309,6 @@ static size_t encode_block(char *str, char *buf, size_t buflen, const char *from
   const size_t n1 = iconv(cd, (ICONV_CONST char **) &ib, &ibl, &ob, &obl);
   const size_t n2 = iconv(cd, NULL, NULL, &ob, &obl);
   assert(n1 != (size_t)(-1) && n2 != (size_t)(-1));
-  iconv_close(cd);
   return (*encoder)(str, tmp, ob - tmp, tocode);
 }
 
@@ -342,73 +356,92 @@ static size_t choose_block(char *d, size_t dlen, int col, const char *fromcode,
  * @param[in]  charset    Charset to use for the conversion
  * @param[in]  charsetlen Length of the charset parameter
  *
- * The buffer buf is reinitialized at the end of this function.
+ * The buffer buf is emptied at the end of this function, ready to be reused.
  */
 static void finalize_chunk(struct Buffer *res, struct Buffer *buf, char *charset, size_t charsetlen)
 {
   char end = charset[charsetlen];
   charset[charsetlen] = '\0';
+  const char *data = buf->data;
   mutt_ch_convert_string(&buf->data, charset, Charset, MUTT_ICONV_HOOK_FROM);
   charset[charsetlen] = end;
-  mutt_mb_filter_unprintable(&buf->data);
-  mutt_buffer_addstr(res, buf->data);
-  FREE(&buf->data);
-  mutt_buffer_init(buf);
+  /* the conversion may have replaced the string */
+  if (buf->data != data)
+    buf->dsize = mutt_str_strlen(buf->data) + 1;
+  mutt_mb_add_printable(res, buf->data);
+  buf->dptr = buf->data;
+  *buf->dptr = '\0';
 }
 
 /**
  * decode_word - Decode an RFC2047-encoded string
+ * @param buf Buffer for the result, the decoded text is appended
  * @param s   String to decode
  * @param len Length of the string
  * @param enc Encoding type
- * @retval ptr Decoded string
+ * @retval true  Success
+ * @retval false The string couldn't be decoded
  *
- * @note The caller must free the returned string
+ * Text after a decoded NUL character is ignored.
  */
-static char *decode_word(const char *s, size_t len, enum ContentEncoding enc)
+static bool decode_word(struct Buffer *buf, const char *s, size_t len, enum ContentEncoding enc)
 {
   const char *it = s;
   const char *end = s + len;
 
   if (enc == ENC_QUOTED_PRINTABLE)
   {
-    struct Buffer buf = { 0 };
-    for (; it < end; ++it)
+    while (it < end)
     {
+      /* copy the plain characters in one go */
+      const char *plain = it;
+      while ((it < end) && (*it != '_') && (*it != '='))
+        it++;
+      if (it > plain)
+        mutt_buffer_add(buf, plain, it - plain);
+      if (it == end)
+        break;
+
       if (*it == '_')
       {
-        mutt_buffer_addch(&buf, ' ');
+        mutt_buffer_addch(buf, ' ');
       }
       else if ((*it == '=') && (!(it[1] & ~127) && hexval(it[1]) != -1) &&
                (!(it[2] & ~127) && hexval(it[2]) != -1))
       {
-        mutt_buffer_addch(&buf, (hexval(it[1]) << 4) | hexval(it[2]));
+        const char c = (hexval(it[1]) << 4) | hexval(it[2]);
+        if (c == '\0')
+          break;
+        mutt_buffer_addch(buf, c);
         it += 2;
       }
       else
       {
-        mutt_buffer_addch(&buf, *it);
+        mutt_buffer_addch(buf, *it);
       }
+      it++;
     }
-    mutt_buffer_addch(&buf, '\0');
-    return buf.data;
+    /* make sure there's a string, even if it's empty */
+    mutt_buffer_add(buf, "", 0);
+    return true;
   }
   else if (enc == ENC_BASE64)
   {
     const int olen = 3 * len / 4 + 1;
-    char *out = mutt_mem_malloc(olen);
-    int dlen = mutt_b64_decode(it, out, olen);
+    mutt_buffer_increase_size(buf, (buf->dptr - buf->data) + olen + 1);
+    int dlen = mutt_b64_decode(it, buf->dptr, olen);
     if (dlen == -1)
     {
-      FREE(&out);
-      return NULL;
+      *buf->dptr = '\0';
+      return false;
     }
-    out[dlen] = '\0';
-    return out;
+    buf->dptr[dlen] = '\0';
+    buf->dptr += strlen(buf->dptr);
+    return true;
   }
 
   assert(0); /* The enc parameter has an invalid value */
-  return NULL;
+  return false;
 }
 
 /**
@@ -651,6 +684,14 @@ void rfc2047_decode(char **pd)
   if (!pd || !*pd)
     return;
 
+  /* Nothing is encoded, the header only needs the assumed charset */
+  if (!strstr(*pd, "=?"))
+  {
+    if (AssumedCharset && *AssumedCharset)
+      mutt_ch_convert_nonmime_string(pd);
+    return;
+  }
+
   struct Buffer buf = { 0 }; /* Output buffer                          */
   char *s = *pd;             /* Read pointer                           */
   char *beg = NULL;          /* Begin of encoded word                  */
@@ -665,6 +706,7 @@ void rfc2047_decode(char **pd)
    * See https://github.com/neomutt/neomutt/issues/1015
    */
   struct Buffer prev = { 0 }; /* Previously decoded word                */
+  bool prev_pending = false;  /* Is there text in prev to be added?     */
   char *prev_charset = NULL;  /* Previously used charset                */
   size_t prev_charsetlen = 0; /* Length of the previously used charset  */
 
@@ -684,9 +726,10 @@ void rfc2047_decode(char **pd)
       }
 
       /* If we have some previously decoded text, add it now */
-      if (prev.data)
+      if (prev_pending)
       {
         finalize_chunk(&buf, &prev, prev_charset, prev_charsetlen);
+        prev_pending = false;
       }
 
       /* Add non-encoded part */
@@ -709,21 +752,23 @@ void rfc2047_decode(char **pd)
     {
       /* Some encoded text was found */
       text[textlen] = '\0';
-      char *decoded = decode_word(text, textlen, enc);
-      if (!decoded)
-      {
-        return;
-      }
-      if (prev.data && ((prev_charsetlen != charsetlen) ||
-                        (strncmp(prev_charset, charset, charsetlen) != 0)))
+      if (prev_pending && ((prev_charsetlen != charsetlen) ||
+                           (strncmp(prev_charset, charset, charsetlen) != 0)))
       {
         /* Different charset, convert the previous chunk and add it to the
          * final result */
         finalize_chunk(&buf, &prev, prev_charset, prev_charsetlen);
+        prev_pending = false;
       }
 
-      mutt_buffer_addstr(&prev, decoded);
-      FREE(&decoded);
+      /* decode straight into the chunk */
+      if (!decode_word(&prev, text, textlen, enc))
+      {
+        FREE(&prev.data);
+        FREE(&buf.data);
+        return;
+      }
+      prev_pending = true;
       prev_charset = charset;
       prev_charsetlen = charsetlen;
       s = text + textlen + 2; /* Skip final ?= */
@@ -731,10 +776,11 @@ void rfc2047_decode(char **pd)
   }
 
   /* Save the last chunk */
-  if (prev.data)
+  if (prev_pending)
   {
     finalize_chunk(&buf, &prev, prev_charset, prev_charsetlen);
   }
+  FREE(&prev.data);
 
   mutt_buffer_addch(&buf, '\0');
   FREE(pd);
@@ -29,6 +29,7 @@
 #include "config.h"
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include "mutt/mutt.h"
 #include "tags.h"
@@ -38,6 +39,89 @@ char *HiddenTags; ///< Config: Tags that shouldn't be displayed on screen
 
 struct Hash *TagTransforms; /**< Lookup table of alternative tag names */
 
+/**
+ * struct Tag - A tag name, shared by all the emails that have it
+ */
+struct Tag
+{
+  char *name;              ///< Name of the tag
+  const char *transformed; ///< Symbol to display instead, from TagTransforms
+  bool hidden;             ///< Tag is in $hidden_tags
+  unsigned int gen;        ///< Generation of transformed and hidden
+};
+
+static struct Tag **Tags = NULL;     ///< All the tags, by id
+static size_t TagsNum = 0;           ///< Number of tags
+static size_t TagsMax = 0;           ///< Size of the Tags array
+static struct Hash *TagNames = NULL; ///< Tag name -> Tag id + 1
+static unsigned int TagGen = 1;      ///< Bumped when the tag config changes
+
+/**
+ * tag_is_hidden - Is a tag listed in $hidden_tags?
+ * @param name Tag name
+ * @retval true The tag shouldn't be displayed
+ */
+static bool tag_is_hidden(const char *name)
+{
+  if (!HiddenTags)
+    return false;
+
+  char *p = strstr(HiddenTags, name);
+  size_t xsz = p ? mutt_str_strlen(name) : 0;
+
+  return p && ((p == HiddenTags) || (*(p - 1) == ',') || (*(p - 1) == ' ')) &&
+         ((*(p + xsz) == '\0') || (*(p + xsz) == ',') || (*(p + xsz) == ' '));
+}
+
+/**
+ * tag_intern - Get the id of a tag name
+ * @param name Tag name
+ * @retval num Id of the tag
+ *
+ * Each name is only stored once, however many emails have it.
+ */
+static unsigned int tag_intern(const char *name)
+{
+  if (!TagNames)
+    TagNames = mutt_hash_create(64, 0);
+
+  uintptr_t id = (uintptr_t) mutt_hash_find(TagNames, name);
+  if (id > 0)
+    return id - 1;
+
+  if (TagsNum == TagsMax)
+  {
+    TagsMax = MAX(TagsMax * 2, 16);
+    mutt_mem_realloc(&Tags, TagsMax * sizeof(struct Tag *));
+  }
+
+  struct Tag *tag = mutt_mem_calloc(1, sizeof(struct Tag));
+  tag->name = mutt_str_strdup(name);
+  Tags[TagsNum] = tag;
+  mutt_hash_insert(TagNames, tag->name, (void *) (uintptr_t)(TagsNum + 1));
+
+  return TagsNum++;
+}
+
+/**
+ * tag_get - Get a tag by id
+ * @param id Id of the tag, from tag_intern()
+ * @retval ptr Tag, with its transformation and visibility up to date
+ */
+static struct Tag *tag_get(unsigned int id)
+{
+  struct Tag *tag = Tags[id];
+
+  if (tag->gen != TagGen)
+  {
+    tag->transformed = mutt_hash_find(TagTransforms, tag->name);
+    tag->hidden = tag_is_hidden(tag->name);
+    tag->gen = TagGen;
+  }
+
+  return tag;
+}
+
 /**
  * driver_tags_getter - Get transformed tags
  * @param head             List of tags
@@ -55,17 +139,17 @@ static char *driver_tags_getter(struct TagHead *head, bool show_hidden,
     return NULL;
 
   char *tags = NULL;
-  struct TagNode *np = NULL;
-  STAILQ_FOREACH(np, head, entries)
+  for (size_t i = 0; i < head->num; i++)
   {
-    if (filter && mutt_str_strcmp(np->name, filter) != 0)
+    struct Tag *tag = tag_get(head->ids[i]);
+    if (filter && mutt_str_strcmp(tag->name, filter) != 0)
       continue;
-    if (show_hidden || !np->hidden)
+    if (show_hidden || !tag->hidden)
     {
-      if (show_transformed && np->transformed)
-        mutt_str_append_item(&tags, np->transformed, ' ');
+      if (show_transformed && tag->transformed)
+        mutt_str_append_item(&tags, tag->transformed, ' ');
       else
-        mutt_str_append_item(&tags, np->name, ' ');
+        mutt_str_append_item(&tags, tag->name, ' ');
     }
   }
   return tags;
@@ -80,28 +164,9 @@ static char *driver_tags_getter(struct TagHead *head, bool show_hidden,
  */
 static void driver_tags_add(struct TagHead *head, char *new_tag)
 {
-  char *new_tag_transformed = mutt_hash_find(TagTransforms, new_tag);
-
-  struct TagNode *np = mutt_mem_calloc(1, sizeof(struct TagNode));
-  np->name = mutt_str_strdup(new_tag);
-  np->hidden = false;
-  if (new_tag_transformed)
-    np->transformed = mutt_str_strdup(new_tag_transformed);
-
-  /* filter out hidden tags */
-  if (HiddenTags)
-  {
-    char *p = strstr(HiddenTags, new_tag);
-    size_t xsz = p ? mutt_str_strlen(new_tag) : 0;
-
-    if (p && ((p == HiddenTags) || (*(p - 1) == ',') || (*(p - 1) == ' ')) &&
-        ((*(p + xsz) == '\0') || (*(p + xsz) == ',') || (*(p + xsz) == ' ')))
-    {
-      np->hidden = true;
-    }
-  }
-
-  STAILQ_INSERT_TAIL(head, np, entries);
+  mutt_mem_realloc(&head->ids, (head->num + 1) * sizeof(unsigned int));
+  head->ids[head->num++] = tag_intern(new_tag);
+  head->gen = 0;
 }
 
 /**
@@ -115,16 +180,34 @@ void driver_tags_free(struct TagHead *head)
   if (!head)
     return;
 
-  struct TagNode *np = STAILQ_FIRST(head), *next = NULL;
-  while (np)
+  FREE(&head->ids);
+  FREE(&head->transformed);
+  head->num = 0;
+  head->gen = 0;
+}
+
+/**
+ * driver_tags_display - Get the transformed tags, for display
+ * @param[in] head List of tags
+ * @retval ptr  String list of tags, owned by the list
+ * @retval NULL There are no visible tags
+ *
+ * This is driver_tags_get_transformed(), but the string is cached until the
+ * tags, $hidden_tags or the tag transforms change.  It mustn't be freed.
+ */
+const char *driver_tags_display(struct TagHead *head)
+{
+  if (!head)
+    return NULL;
+
+  if (head->gen != TagGen)
   {
-    next = STAILQ_NEXT(np, entries);
-    FREE(&np->name);
-    FREE(&np->transformed);
-    FREE(&np);
-    np = next;
+    FREE(&head->transformed);
+    head->transformed = driver_tags_getter(head, false, true, NULL);
+    head->gen = TagGen;
   }
-  STAILQ_INIT(head);
+
+  return head->transformed;
 }
 
 /**
@@ -137,7 +220,7 @@ void driver_tags_free(struct TagHead *head)
  */
 char *driver_tags_get_transformed(struct TagHead *head)
 {
-  return driver_tags_getter(head, false, true, NULL);
+  return mutt_str_strdup(driver_tags_display(head));
 }
 
 /**
@@ -186,9 +269,10 @@ char *driver_tags_get_transformed_for(char *name, struct TagHead *head)
  * @retval false No changes are made
  * @retval true  Tags are updated
  *
- * Free current tags structures and replace it by new tags
+ * Free current tags structures and replace it by new tags.  The string isn't
+ * changed, or kept.
  */
-bool driver_tags_replace(struct TagHead *head, char *tags)
+bool driver_tags_replace(struct TagHead *head, const char *tags)
 {
   if (!head)
     return false;
@@ -197,10 +281,41 @@ bool driver_tags_replace(struct TagHead *head, char *tags)
 
   if (tags)
   {
+    char *copy = mutt_str_strdup(tags);
+    char *p = copy;
     char *tag = NULL;
-    while ((tag = strsep(&tags, " ")))
+    while ((tag = strsep(&p, " ")))
       driver_tags_add(head, tag);
-    FREE(&tags);
+    FREE(&copy);
   }
   return true;
 }
+
+/**
+ * driver_tags_invalidate - Forget the cached tag strings
+ *
+ * This must be called when $hidden_tags or the tag transforms change.
+ */
+void driver_tags_invalidate(void)
+{
+  if (++TagGen == 0)
+    TagGen = 1;
+}
+
+/**
+ * driver_tags_cleanup - Free the tag names
+ *
+ * No email may have any tags when this is called.
+ */
+void driver_tags_cleanup(void)
+{
+  mutt_hash_destroy(&TagNames);
+  for (size_t i = 0; i < TagsNum; i++)
+  {
+    FREE(&Tags[i]->name);
+    FREE(&Tags[i]);
+  }
+  FREE(&Tags);
+  TagsNum = 0;
+  TagsMax = 0;
+}
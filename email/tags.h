@@ -32,25 +32,28 @@ extern char *HiddenTags;
 extern struct Hash *TagTransforms;
 
 /**
- * struct TagNode - LinkedList Tag Element
+ * struct TagHead - The tags of an email
  *
- * Keep a linked list of header tags and their transformed values.
- * Textual tags can be transformed to symbols to save space.
+ * Tag names are shared by all the emails, so each email only keeps a list of
+ * ids.  Textual tags can be transformed to symbols to save space; the
+ * transformed string is cached, because it's drawn in the index.
  */
-struct TagNode
+struct TagHead
 {
-  char *name;
-  char *transformed;
-  bool hidden;
-  STAILQ_ENTRY(TagNode) entries;
+  unsigned int *ids;   ///< Tags, in the order they were added
+  size_t num;          ///< Number of tags
+  char *transformed;   ///< Cached driver_tags_get_transformed() string
+  unsigned int gen;    ///< Generation of the cache, 0 if it's empty
 };
-STAILQ_HEAD(TagHead, TagNode);
 
-void  driver_tags_free(struct TagHead *head);
-char *driver_tags_get(struct TagHead *head);
-char *driver_tags_get_transformed(struct TagHead *head);
-char *driver_tags_get_transformed_for(char *name, struct TagHead *head);
-char *driver_tags_get_with_hidden(struct TagHead *head);
-bool  driver_tags_replace(struct TagHead *head, char *tags);
+void        driver_tags_cleanup(void);
+void        driver_tags_free(struct TagHead *head);
+char *      driver_tags_get(struct TagHead *head);
+char *      driver_tags_get_transformed(struct TagHead *head);
+char *      driver_tags_get_transformed_for(char *name, struct TagHead *head);
+char *      driver_tags_get_with_hidden(struct TagHead *head);
+const char *driver_tags_display(struct TagHead *head);
+void        driver_tags_invalidate(void);
+bool        driver_tags_replace(struct TagHead *head, const char *tags);
 
 #endif /* MUTT_EMAIL_TAGS_H */
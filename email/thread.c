@@ -100,14 +100,6 @@ void insert_message(struct MuttThread **new, struct MuttThread *newparent,
   *new = cur;
 }
 
-/**
- * thread_hash_destructor - Hash Destructor callback - Implements ::hash_destructor_t
- */
-void thread_hash_destructor(int type, void *obj, intptr_t data)
-{
-  FREE(&obj);
-}
-
 /**
  * find_virtual - Find an email with a Virtual message number
  * @param cur     Thread to search
@@ -41,6 +41,7 @@ struct MuttThread
   bool deep : 1;
   unsigned int subtree_visible : 2;
   bool next_subtree_visible : 1;
+  bool drawn : 1;
   struct MuttThread *parent;
   struct MuttThread *child;
   struct MuttThread *next;
@@ -54,7 +55,6 @@ struct Email *find_virtual(struct MuttThread *cur, int reverse);
 void           insert_message(struct MuttThread **new, struct MuttThread *newparent, struct MuttThread *cur);
 bool           is_descendant(struct MuttThread *a, struct MuttThread *b);
 void           mutt_break_thread(struct Email *e);
-void           thread_hash_destructor(int type, void *obj, intptr_t data);
 void           unlink_message(struct MuttThread **old, struct MuttThread *cur);
 
 #endif /* MUTT_EMAIL_THREAD_H */
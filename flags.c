@@ -35,7 +35,6 @@
 #include "mutt.h"
 #include "context.h"
 #include "curs_lib.h"
-#include "curs_main.h"
 #include "globals.h"
 #include "mailbox.h"
 #include "menu.h"
@@ -45,6 +44,49 @@
 #include "protos.h"
 #include "sort.h"
 
+static struct Context *BatchCtx = NULL; /**< Mailbox of the open batch, see mutt_flag_batch_begin() */
+static int BatchDepth = 0;              /**< Nesting level of mutt_flag_batch_begin() */
+static int BatchChanged = 0;            /**< Emails changed since the batch began */
+
+/**
+ * mutt_flag_batch_begin - Start changing the flags of many emails
+ * @param ctx Mailbox Context
+ *
+ * Until mutt_flag_batch_end() is called, mutt_set_flag() only updates the
+ * emails and the counters.  The screen updates are collected and made once,
+ * at the end.  Batches may be nested; only the outermost one counts.
+ */
+void mutt_flag_batch_begin(struct Context *ctx)
+{
+  if (BatchDepth++ > 0)
+    return;
+
+  BatchCtx = ctx;
+  BatchChanged = 0;
+}
+
+/**
+ * mutt_flag_batch_end - Finish changing the flags of many emails
+ * @retval num Number of emails changed in the batch
+ */
+int mutt_flag_batch_end(void)
+{
+  if ((BatchDepth == 0) || (--BatchDepth > 0))
+    return BatchChanged;
+
+  if (BatchChanged > 0)
+  {
+#ifdef USE_SIDEBAR
+    mutt_menu_set_current_redraw(REDRAW_SIDEBAR | REDRAW_STATUS);
+#else
+    mutt_menu_set_current_redraw(REDRAW_STATUS);
+#endif
+  }
+
+  BatchCtx = NULL;
+  return BatchChanged;
+}
+
 /**
  * mutt_set_flag_update - Set a flag on an email
  * @param ctx     Mailbox Context
@@ -330,9 +372,13 @@ void mutt_set_flag_update(struct Context *ctx, struct Email *e, int flag, bool b
 
   if (update)
   {
-    mutt_set_header_color(ctx, e);
+    /* the colour is recalculated when the email is next drawn */
+    e->pair_valid = false;
+    if ((BatchDepth > 0) && (ctx == BatchCtx))
+      BatchChanged++;
 #ifdef USE_SIDEBAR
-    mutt_menu_set_current_redraw(REDRAW_SIDEBAR);
+    else
+      mutt_menu_set_current_redraw(REDRAW_SIDEBAR);
 #endif
   }
 
@@ -354,9 +400,11 @@ void mutt_set_flag_update(struct Context *ctx, struct Email *e, int flag, bool b
  */
 void mutt_tag_set_flag(int flag, int bf)
 {
+  mutt_flag_batch_begin(Context);
   for (int i = 0; i < Context->mailbox->msg_count; i++)
     if (message_is_tagged(Context, i))
       mutt_set_flag(Context, Context->mailbox->hdrs[i], flag, bf);
+  mutt_flag_batch_end();
 }
 
 /**
@@ -383,6 +431,8 @@ int mutt_thread_set_flag(struct Email *e, int flag, int bf, int subthread)
       cur = cur->parent;
   start = cur;
 
+  mutt_flag_batch_begin(Context);
+
   if (cur->message && cur != e->thread)
     mutt_set_flag(Context, cur->message, flag, bf);
 
@@ -414,6 +464,7 @@ done:
   cur = e->thread;
   if (cur->message)
     mutt_set_flag(Context, cur->message, flag, bf);
+  mutt_flag_batch_end();
   return 0;
 }
 
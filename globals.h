@@ -55,6 +55,7 @@ WHERE char *LastFolder;
 
 extern const char *GitVer;
 
+WHERE struct Hash *AliasNames;
 WHERE struct Hash *Groups;
 WHERE struct Hash *ReverseAliases;
 WHERE struct Hash *TagFormats;
@@ -154,6 +155,7 @@ WHERE short ReadInc;                       ///< Config: Update the progress bar
 WHERE short SleepTime;                     ///< Config: Time to pause after certain info messages
 WHERE short Timeout;                       ///< Config: Time to wait for user input in menus
 WHERE short Wrap;                          ///< Config: Width to wrap text in the pager
+WHERE short WorkerThreads;                 ///< Config: Number of threads to use for CPU-heavy work
 WHERE short WriteInc;                      ///< Config: Update the progress bar after this many records written (0 to disable)
 
 #ifdef USE_SIDEBAR
@@ -66,6 +66,7 @@ static void group_remove(struct Group *g)
     return;
   mutt_hash_delete(Groups, g->name, g);
   mutt_addr_free(&g->as);
+  mutt_hash_destroy(&g->as_hash);
   mutt_regexlist_free(&g->rs);
   FREE(&g->name);
   FREE(&g);
@@ -151,6 +152,15 @@ static void group_add_addrlist(struct Group *g, struct Address *a)
   q = mutt_addr_copy_list(a, false);
   q = mutt_remove_xrefs(g->as, q);
   *p = q;
+
+  for (; q; q = q->next)
+  {
+    if (!q->mailbox)
+      continue;
+    if (!g->as_hash)
+      g->as_hash = mutt_hash_create(32, MUTT_HASH_STRCASECMP | MUTT_HASH_STRDUP_KEYS);
+    mutt_hash_insert(g->as_hash, q->mailbox, g);
+  }
 }
 
 /**
@@ -170,7 +180,11 @@ static int group_remove_addrlist(struct Group *g, struct Address *a)
     return -1;
 
   for (p = a; p; p = p->next)
+  {
     mutt_addr_remove_from_list(&g->as, p->mailbox);
+    if (p->mailbox)
+      mutt_hash_delete(g->as_hash, p->mailbox, NULL);
+  }
 
   return 0;
 }
@@ -285,11 +299,8 @@ bool mutt_group_match(struct Group *g, const char *s)
   if (!g || !s)
     return false;
 
-  if (mutt_regexlist_match(&g->rs, s))
+  if (g->as_hash && mutt_hash_find(g->as_hash, s))
     return true;
-  for (struct Address *ap = g->as; ap; ap = ap->next)
-    if (ap->mailbox && (mutt_str_strcasecmp(s, ap->mailbox) == 0))
-      return true;
 
-  return false;
+  return mutt_regexlist_match(&g->rs, s);
 }
@@ -28,6 +28,7 @@
 
 struct Address;
 struct Buffer;
+struct Hash;
 
 #define MUTT_GROUP   0
 #define MUTT_UNGROUP 1
@@ -38,6 +39,7 @@ struct Buffer;
 struct Group
 {
   struct Address *as;
+  struct Hash *as_hash; /**< Mailboxes of the Addresses in as */
   struct RegexList rs;
   char *name;
 };
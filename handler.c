@@ -21,8 +21,14 @@
  */
 
 #include "config.h"
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 #include <stddef.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <iconv.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -151,6 +157,26 @@ static void convert_to_state(iconv_t cd, char *bufi, size_t *l, struct State *s)
   *l = ibl;
 }
 
+/**
+ * state_map - Find the next bytes of the input in memory
+ * @param[in]  s   State to work with
+ * @param[in]  len Number of bytes
+ * @param[out] pos Current position of the input
+ * @retval ptr  The len bytes at pos
+ * @retval NULL The input isn't mapped, read it with stdio
+ *
+ * Once the bytes have been used, the caller moves the input past them.
+ */
+static const char *state_map(struct State *s, size_t len, LOFF_T *pos)
+{
+  if (!s->map)
+    return NULL;
+  *pos = ftello(s->fpin);
+  if (*pos < 0)
+    return NULL;
+  return mutt_file_map_range(s->map, s->fpin, *pos, len);
+}
+
 /**
  * decode_xbit - Decode xbit-encoded text
  * @param s      State to work with
@@ -160,9 +186,18 @@ static void convert_to_state(iconv_t cd, char *bufi, size_t *l, struct State *s)
  */
 static void decode_xbit(struct State *s, long len, bool istext, iconv_t cd)
 {
+  LOFF_T pos = 0;
+  const char *src = (len > 0) ? state_map(s, len, &pos) : NULL;
+
   if (!istext)
   {
-    mutt_file_copy_bytes(s->fpin, s->fpout, len);
+    if (src)
+    {
+      fwrite(src, 1, len, s->fpout);
+      fseeko(s->fpin, pos + len, SEEK_SET);
+    }
+    else
+      mutt_file_copy_bytes(s->fpin, s->fpout, len);
     return;
   }
 
@@ -171,7 +206,24 @@ static void decode_xbit(struct State *s, long len, bool istext, iconv_t cd)
   int c;
   char bufi[BUFI_SIZE];
   size_t l = 0;
-  while ((c = fgetc(s->fpin)) != EOF && len--)
+
+  if (src)
+  {
+    for (long i = 0; i < len; i++)
+    {
+      c = src[i];
+      if ((c == '\r') && (i + 1 < len) && (src[i + 1] == '\n'))
+        c = src[++i];
+
+      bufi[l++] = c;
+      if (l == sizeof(bufi))
+        convert_to_state(cd, bufi, &l, s);
+    }
+    fseeko(s->fpin, pos + len, SEEK_SET);
+    len = 0;
+  }
+
+  while ((len > 0) && (c = fgetc(s->fpin)) != EOF && len--)
   {
     if ((c == '\r') && len)
     {
@@ -240,6 +292,17 @@ static void qp_decode_line(char *dest, char *src, size_t *l, int last)
 
   for (d = dest, s = src; *s;)
   {
+    /* copy the plain characters in one go */
+    const size_t plain = strcspn(s, "=");
+    if (plain > 0)
+    {
+      memcpy(d, s, plain);
+      d += plain;
+      s += plain;
+      kind = -1;
+      continue;
+    }
+
     switch ((kind = qp_decode_triple(s, &c)))
     {
       case 0:
@@ -306,6 +369,10 @@ static void decode_quoted(struct State *s, long len, bool istext, iconv_t cd)
   if (istext)
     state_set_prefix(s);
 
+  LOFF_T pos = 0;
+  const char *src = (len > 0) ? state_map(s, len, &pos) : NULL;
+  const char *src_start = src;
+
   while (len > 0)
   {
     /* It's ok to use a fixed size buffer for input, even if the line turns
@@ -314,11 +381,27 @@ static void decode_quoted(struct State *s, long len, bool istext, iconv_t cd)
      * lines are at most 76 characters, but we should be liberal about what
      * we accept.
      */
-    if (!fgets(line, MIN((ssize_t) sizeof(line), len + 1), s->fpin))
-      break;
+    size_t linelen;
+    if (src)
+    {
+      linelen = MIN(sizeof(line) - 1, (size_t) len);
+      const char *nl = memchr(src, '\n', linelen);
+      if (nl)
+        linelen = nl - src + 1;
+      memcpy(line, src, linelen);
+      line[linelen] = '\0';
+      src += linelen;
+      len -= linelen;
+      linelen = strlen(line);
+    }
+    else
+    {
+      if (!fgets(line, MIN((ssize_t) sizeof(line), len + 1), s->fpin))
+        break;
 
-    size_t linelen = strlen(line);
-    len -= linelen;
+      linelen = strlen(line);
+      len -= linelen;
+    }
 
     /* inspect the last character we read so we can tell if we got the
      * entire line.
@@ -339,6 +422,9 @@ static void decode_quoted(struct State *s, long len, bool istext, iconv_t cd)
     convert_to_state(cd, decline, &l, s);
   }
 
+  if (src_start)
+    fseeko(s->fpin, pos + (src - src_start), SEEK_SET);
+
   convert_to_state(cd, 0, 0, s);
   state_reset_prefix(s);
 }
@@ -515,13 +601,587 @@ static bool is_autoview(struct Body *b)
   return false;
 }
 
+#define AUTOVIEW_CACHE_SIZE 64
+#define AUTOVIEW_CACHE_MAX_DATA (1024 * 1024)
+#define AUTOVIEW_MAX_JOBS 4
+
+/* The output of autoview commands is kept in a private directory, so that it
+ * can be shared with the process that decodes a message for the pager.  Each
+ * file is named after the MD5 of its key and holds the key (the type, the
+ * mailcap command and the input), followed by the stdout and stderr. */
+static char AutoviewCacheDir[PATH_MAX] = "";
+static pid_t AutoviewCacheOwner = 0;
+
+#ifdef USE_THREADS
+/* Bodies may be searched, and so autoviewed, by several threads at once */
+static pthread_mutex_t AutoviewCacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define AUTOVIEW_LOCAL __thread
+#else
+#define AUTOVIEW_LOCAL
+#endif
+
+/**
+ * struct AutoviewJob - An autoview command running in the background
+ */
+struct AutoviewJob
+{
+  FILE *before;            ///< Output of the handlers before this job, or NULL
+  pid_t pid;               ///< Converter process
+  FILE *fpin;              ///< Piped input of the converter, or NULL
+  char tempfile[PATH_MAX]; ///< Input file to remove, if not piped
+  FILE *fpout;             ///< Temporary file for the converter's stdout
+  FILE *fperr;             ///< Temporary file for the converter's stderr
+  char *command;           ///< Expanded command, for the stderr banner
+  char *prefix;            ///< State prefix to use for the output
+  int flags;               ///< State flags to use for the output
+  char *key;               ///< Cache key, or NULL
+  size_t keylen;           ///< Length of key
+};
+
+/**
+ * struct AutoviewQueue - Autoview commands running while a message is rendered
+ *
+ * While a multipart is being rendered, autoview commands are started and
+ * left running.  The output of the handlers that follow goes to a temporary
+ * file, until the commands before it have finished and their output has been
+ * written, in order, to the real destination.
+ */
+struct AutoviewQueue
+{
+  struct State *state;                       ///< State the handlers are writing to
+  FILE *fpout;                               ///< Real destination of the output
+  FILE *cur;                                 ///< Where the handlers are writing now
+  struct AutoviewJob jobs[AUTOVIEW_MAX_JOBS]; ///< Commands still to be collected
+  int num;                                   ///< Number of jobs
+};
+
+static AUTOVIEW_LOCAL struct AutoviewQueue *AutoviewPending = NULL;
+
+/**
+ * autoview_read - Read the rest of a file into memory
+ * @param[in]  fp  File to read
+ * @param[out] len Number of bytes read
+ * @retval ptr Data, to be freed (may be NULL if empty)
+ */
+static char *autoview_read(FILE *fp, size_t *len)
+{
+  char *data = NULL;
+  size_t size = 0;
+
+  *len = 0;
+  while (true)
+  {
+    if (size - *len < 4096)
+    {
+      size = size ? (size * 2) : 8192;
+      mutt_mem_realloc(&data, size);
+    }
+    size_t n = fread(data + *len, 1, size - *len, fp);
+    if (n == 0)
+      break;
+    *len += n;
+  }
+
+  return data;
+}
+
+/**
+ * autoview_put_lines - Write text to the State, prefixing each line
+ * @param data Text to write
+ * @param len  Length of text
+ * @param s    State to write to
+ */
+static void autoview_put_lines(const char *data, size_t len, struct State *s)
+{
+  if (!s->prefix)
+  {
+    fwrite(data, 1, len, s->fpout);
+    return;
+  }
+
+  while (len > 0)
+  {
+    const char *nl = memchr(data, '\n', len);
+    const size_t n = nl ? (nl - data + 1) : len;
+    state_puts(s->prefix, s);
+    fwrite(data, 1, n, s->fpout);
+    data += n;
+    len -= n;
+  }
+}
+
+/**
+ * autoview_output - Write the output of an autoview command
+ * @param s       State to write to
+ * @param command Command that was run
+ * @param out     Its stdout
+ * @param outlen  Length of out
+ * @param err     Its stderr
+ * @param errlen  Length of err
+ */
+static void autoview_output(struct State *s, const char *command, const char *out,
+                            size_t outlen, const char *err, size_t errlen)
+{
+  autoview_put_lines(out, outlen, s);
+
+  if (errlen == 0)
+    return;
+
+  if (s->flags & MUTT_DISPLAY)
+  {
+    state_mark_attach(s);
+    state_printf(s, _("[-- Autoview stderr of %s --]\n"), command);
+  }
+  autoview_put_lines(err, errlen, s);
+}
+
+/**
+ * autoview_cache_key - Read the input of an autoview command into a cache key
+ * @param[in]  type    MIME type of the part
+ * @param[in]  command Mailcap command, before expansion
+ * @param[in]  fp      File positioned at the input
+ * @param[in]  length  Length of the input
+ * @param[out] keylen  Length of the key
+ * @retval ptr  Key, ending with the input, to be freed
+ * @retval NULL Too large to cache, or an error.  fp is left unchanged.
+ */
+static char *autoview_cache_key(const char *type, const char *command, FILE *fp,
+                                LOFF_T length, size_t *keylen)
+{
+  if ((length < 0) || (length > AUTOVIEW_CACHE_MAX_DATA))
+    return NULL;
+
+  const size_t tlen = strlen(type) + 1;
+  const size_t clen = strlen(command) + 1;
+  const LOFF_T pos = ftello(fp);
+
+  char *key = mutt_mem_malloc(tlen + clen + length + 1);
+  memcpy(key, type, tlen);
+  memcpy(key + tlen, command, clen);
+  if (fread(key + tlen + clen, 1, length, fp) != (size_t) length)
+  {
+    fseeko(fp, pos, SEEK_SET);
+    FREE(&key);
+    return NULL;
+  }
+
+  *keylen = tlen + clen + length;
+  return key;
+}
+
+/**
+ * autoview_cache_dir - Get the directory of the autoview cache
+ * @retval ptr  Directory, created if necessary
+ * @retval NULL The cache can't be used
+ */
+static const char *autoview_cache_dir(void)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&AutoviewCacheLock);
+#endif
+  if (AutoviewCacheDir[0] == '\0')
+  {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/neomutt-autoview-XXXXXX", NONULL(Tmpdir));
+    if (mkdtemp(dir))
+    {
+      mutt_str_strfcpy(AutoviewCacheDir, dir, sizeof(AutoviewCacheDir));
+      AutoviewCacheOwner = getpid();
+    }
+    else
+      mutt_debug(1, "can't create %s: %s\n", dir, strerror(errno));
+  }
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&AutoviewCacheLock);
+#endif
+
+  return (AutoviewCacheDir[0] != '\0') ? AutoviewCacheDir : NULL;
+}
+
+/**
+ * autoview_cache_path - Get the file of a cache entry
+ * @param buf    Buffer for the path
+ * @param buflen Length of buffer
+ * @param key    Cache key, see autoview_cache_key()
+ * @param keylen Length of key
+ * @retval true Success
+ */
+static bool autoview_cache_path(char *buf, size_t buflen, const char *key, size_t keylen)
+{
+  const char *dir = autoview_cache_dir();
+  if (!dir)
+    return false;
+
+  unsigned char digest[16];
+  char hex[33];
+  mutt_md5_bytes(key, keylen, digest);
+  mutt_md5_toascii(digest, hex);
+  snprintf(buf, buflen, "%s/%s", dir, hex);
+  return true;
+}
+
+/**
+ * autoview_cache_fetch - Find the remembered output of an autoview command
+ * @param[in]  key    Cache key, see autoview_cache_key()
+ * @param[in]  keylen Length of key
+ * @param[out] out    Stdout, to be freed
+ * @param[out] outlen Length of out
+ * @param[out] err    Stderr, to be freed
+ * @param[out] errlen Length of err
+ * @retval true The output was found
+ */
+static bool autoview_cache_fetch(const char *key, size_t keylen, char **out,
+                                 size_t *outlen, char **err, size_t *errlen)
+{
+  char path[PATH_MAX];
+  if (!autoview_cache_path(path, sizeof(path), key, keylen))
+    return false;
+
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return false;
+
+  bool found = false;
+  size_t klen = 0;
+  char *stored = NULL;
+  if ((fscanf(fp, "%zu %zu %zu\n", &klen, outlen, errlen) == 3) &&
+      (klen == keylen) && (*outlen + *errlen <= AUTOVIEW_CACHE_MAX_DATA))
+  {
+    stored = mutt_mem_malloc(keylen + 1);
+    *out = mutt_mem_malloc(*outlen + 1);
+    *err = mutt_mem_malloc(*errlen + 1);
+    found = (fread(stored, 1, keylen, fp) == keylen) &&
+            (memcmp(stored, key, keylen) == 0) &&
+            (fread(*out, 1, *outlen, fp) == *outlen) &&
+            (fread(*err, 1, *errlen, fp) == *errlen);
+    FREE(&stored);
+    if (!found)
+    {
+      FREE(out);
+      FREE(err);
+    }
+  }
+  mutt_file_fclose(&fp);
+
+  return found;
+}
+
+/**
+ * autoview_cache_trim - Forget the oldest entries of the autoview cache
+ * @param dir Cache directory
+ */
+static void autoview_cache_trim(const char *dir)
+{
+  while (true)
+  {
+    DIR *dp = opendir(dir);
+    if (!dp)
+      return;
+
+    char oldest[PATH_MAX] = "";
+    time_t oldest_mtime = 0;
+    int count = 0;
+    struct dirent *de = NULL;
+    while ((de = readdir(dp)))
+    {
+      char path[PATH_MAX];
+      struct stat st;
+
+      if ((de->d_name[0] == '.') || strchr(de->d_name, '.'))
+        continue;
+      snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+      if (stat(path, &st) != 0)
+        continue;
+      count++;
+      if (!oldest[0] || (st.st_mtime < oldest_mtime))
+      {
+        mutt_str_strfcpy(oldest, path, sizeof(oldest));
+        oldest_mtime = st.st_mtime;
+      }
+    }
+    closedir(dp);
+
+    if ((count <= AUTOVIEW_CACHE_SIZE) || (unlink(oldest) != 0))
+      return;
+  }
+}
+
+/**
+ * autoview_cache_store - Remember the output of an autoview command
+ * @param key    Cache key, see autoview_cache_key() (it will be freed)
+ * @param keylen Length of key
+ * @param out    Its stdout
+ * @param outlen Length of out
+ * @param err    Its stderr
+ * @param errlen Length of err
+ */
+static void autoview_cache_store(char *key, size_t keylen, const char *out,
+                                 size_t outlen, const char *err, size_t errlen)
+{
+  char path[PATH_MAX];
+  char tmp[PATH_MAX];
+
+  if (!key || (outlen + errlen > AUTOVIEW_CACHE_MAX_DATA) ||
+      !autoview_cache_path(path, sizeof(path), key, keylen))
+  {
+    FREE(&key);
+    return;
+  }
+
+  /* Write a new entry under another name, so it's never seen half-written */
+  snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int) getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  FILE *fp = (fd < 0) ? NULL : fdopen(fd, "w");
+  if (!fp)
+  {
+    if (fd >= 0)
+      close(fd);
+    unlink(tmp);
+    FREE(&key);
+    return;
+  }
+
+  fprintf(fp, "%zu %zu %zu\n", keylen, outlen, errlen);
+  bool ok = (fwrite(key, 1, keylen, fp) == keylen) &&
+            (fwrite(out, 1, outlen, fp) == outlen) &&
+            (fwrite(err, 1, errlen, fp) == errlen);
+  if ((mutt_file_fclose(&fp) != 0) || !ok || (rename(tmp, path) != 0))
+    unlink(tmp);
+  else
+    autoview_cache_trim(AutoviewCacheDir);
+
+  FREE(&key);
+}
+
+/**
+ * mutt_autoview_cache_init - Prepare the autoview cache
+ *
+ * This must be called before forking a process that decodes messages, so that
+ * the cache is shared with it.
+ */
+void mutt_autoview_cache_init(void)
+{
+  autoview_cache_dir();
+}
+
+/**
+ * mutt_autoview_cache_free - Delete the autoview cache
+ */
+void mutt_autoview_cache_free(void)
+{
+  if ((AutoviewCacheDir[0] != '\0') && (AutoviewCacheOwner == getpid()))
+    mutt_file_rmtree(AutoviewCacheDir);
+  AutoviewCacheDir[0] = '\0';
+}
+
+/**
+ * autoview_collect - Write the output of an autoview command and remember it
+ * @param s       State to write to
+ * @param command Command that was run
+ * @param fpout   Converter's stdout
+ * @param fperr   Converter's stderr
+ * @param key     Cache key, or NULL (it will be freed)
+ * @param keylen  Length of key
+ */
+static void autoview_collect(struct State *s, const char *command, FILE *fpout,
+                             FILE *fperr, char *key, size_t keylen)
+{
+  size_t outlen = 0;
+  size_t errlen = 0;
+  char *out = autoview_read(fpout, &outlen);
+  char *err = autoview_read(fperr, &errlen);
+
+  autoview_output(s, command, out, outlen, err, errlen);
+  autoview_cache_store(key, keylen, out, outlen, err, errlen);
+
+  FREE(&out);
+  FREE(&err);
+}
+
+/**
+ * autoview_pass - Pass on the output of an autoview command as it arrives
+ * @param[in]     fp      Pipe to read
+ * @param[in]     s       State to write to
+ * @param[in]     command Command, to introduce its stderr; NULL for stdout
+ * @param[out]    data    Copy of the output, to be freed
+ * @param[out]    len     Length of data
+ * @param[in,out] keep    Keep a copy, cleared if it gets too big for the cache
+ */
+static void autoview_pass(FILE *fp, struct State *s, const char *command,
+                          char **data, size_t *len, bool *keep)
+{
+  char buf[LONG_STRING];
+  size_t size = 0;
+
+  *len = 0;
+  while (fgets(buf, sizeof(buf), fp))
+  {
+    if (command && (*len == 0) && (s->flags & MUTT_DISPLAY))
+    {
+      state_mark_attach(s);
+      state_printf(s, _("[-- Autoview stderr of %s --]\n"), command);
+    }
+
+    /* pass on each line as it arrives, the pager may be showing the
+     * message already */
+    const size_t n = strlen(buf);
+    autoview_put_lines(buf, n, s);
+
+    /* the length is also needed to spot the first line of stderr */
+    if (*keep && (*len + n > AUTOVIEW_CACHE_MAX_DATA))
+    {
+      *keep = false;
+      FREE(data);
+    }
+    if (*keep)
+    {
+      if (*len + n + 1 > size)
+      {
+        size = MAX(size * 2, *len + n + 1);
+        mutt_mem_realloc(data, size);
+      }
+      memcpy(*data + *len, buf, n);
+    }
+    *len += n;
+  }
+}
+
+/**
+ * autoview_job_finish - Wait for the oldest autoview command and write its output
+ * @param q Queue of commands
+ */
+static void autoview_job_finish(struct AutoviewQueue *q)
+{
+  struct AutoviewJob *job = &q->jobs[0];
+
+  if (job->before)
+  {
+    rewind(job->before);
+    mutt_file_copy_stream(job->before, q->fpout);
+    mutt_file_fclose(&job->before);
+  }
+
+  struct State s = { 0 };
+  s.fpout = q->fpout;
+  s.prefix = job->prefix;
+  s.flags = job->flags;
+
+  /* The output goes to files, so the converter can be left to finish */
+  mutt_wait_filter(job->pid);
+  rewind(job->fpout);
+  rewind(job->fperr);
+  autoview_collect(&s, job->command, job->fpout, job->fperr, job->key, job->keylen);
+
+  mutt_file_fclose(&job->fpout);
+  mutt_file_fclose(&job->fperr);
+  if (job->fpin)
+    mutt_file_fclose(&job->fpin);
+  else
+    mutt_file_unlink(job->tempfile);
+  FREE(&job->command);
+  FREE(&job->prefix);
+
+  q->num--;
+  memmove(&q->jobs[0], &q->jobs[1], q->num * sizeof(struct AutoviewJob));
+}
+
+/**
+ * autoview_queue_finish - Write the output of all the autoview commands
+ * @param q Queue of commands
+ *
+ * The handlers' State is pointed back at the real destination.
+ */
+static void autoview_queue_finish(struct AutoviewQueue *q)
+{
+  while (q->num > 0)
+    autoview_job_finish(q);
+
+  if (q->cur != q->fpout)
+  {
+    rewind(q->cur);
+    mutt_file_copy_stream(q->cur, q->fpout);
+    mutt_file_fclose(&q->cur);
+  }
+  q->state->fpout = q->fpout;
+
+  if (q->state->flags & MUTT_DISPLAY)
+    mutt_clear_error();
+}
+
+/**
+ * autoview_start - Start an autoview command in the background
+ * @param a       Body of the part
+ * @param s       State to work with
+ * @param command Expanded command
+ * @param fpin    Piped input, or NULL if the command reads tempfile
+ * @param tempfile Input file, if not piped
+ * @param key     Cache key, or NULL (the job takes it, on success)
+ * @param keylen  Length of key
+ * @retval true The command was started and will be collected later
+ *
+ * This is only possible while a multipart is being rendered, see
+ * #AutoviewQueue.
+ */
+static bool autoview_start(struct Body *a, struct State *s, const char *command,
+                           FILE *fpin, const char *tempfile, char *key, size_t keylen)
+{
+  struct AutoviewQueue *q = AutoviewPending;
+  if (!q || (q->state != s) || (s->fpout != q->cur))
+    return false;
+
+  if (q->num == AUTOVIEW_MAX_JOBS)
+    autoview_job_finish(q);
+
+  FILE *fpout = mutt_file_mkstemp();
+  FILE *fperr = mutt_file_mkstemp();
+  FILE *next = mutt_file_mkstemp();
+  pid_t pid = -1;
+  if (fpout && fperr && next)
+  {
+    pid = mutt_create_filter_fd(command, NULL, NULL, NULL, fpin ? fileno(fpin) : -1,
+                                fileno(fpout), fileno(fperr));
+  }
+  if (pid < 0)
+  {
+    mutt_file_fclose(&fpout);
+    mutt_file_fclose(&fperr);
+    mutt_file_fclose(&next);
+    return false;
+  }
+
+  mutt_debug(3, "started autoview of %s/%s in the background: %s\n", TYPE(a),
+             NONULL(a->subtype), command);
+
+  struct AutoviewJob *job = &q->jobs[q->num++];
+  memset(job, 0, sizeof(*job));
+  job->before = (q->cur == q->fpout) ? NULL : q->cur;
+  job->pid = pid;
+  job->fpin = fpin;
+  if (!fpin)
+    mutt_str_strfcpy(job->tempfile, tempfile, sizeof(job->tempfile));
+  job->fpout = fpout;
+  job->fperr = fperr;
+  job->command = mutt_str_strdup(command);
+  job->prefix = mutt_str_strdup(s->prefix);
+  job->flags = s->flags;
+  job->key = key;
+  job->keylen = keylen;
+
+  q->cur = next;
+  s->fpout = next;
+  return true;
+}
+
 /**
  * autoview_handler - Handler for autoviewable attachments - Implements ::handler_t
+ *
+ * The output of the mailcap command is remembered, so viewing the same part
+ * again doesn't run it again.  Inside a multipart, the command is left running
+ * while the following parts are rendered, see #AutoviewQueue.
  */
 static int autoview_handler(struct Body *a, struct State *s)
 {
   struct Rfc1524MailcapEntry *entry = rfc1524_new_entry();
-  char buffer[LONG_STRING];
   char type[STRING];
   char command[HUGE_STRING];
   char tempfile[PATH_MAX] = "";
@@ -552,32 +1212,63 @@ static int autoview_handler(struct Body *a, struct State *s)
     {
       state_mark_attach(s);
       state_printf(s, _("[-- Autoview using %s --]\n"), command);
-      mutt_message(_("Invoking autoview command: %s"), command);
     }
 
+    size_t keylen = 0;
+    char *key = autoview_cache_key(type, entry->command, s->fpin, a->length, &keylen);
+    if (key)
+    {
+      char *out = NULL, *err = NULL;
+      size_t outlen = 0, errlen = 0;
+      if (autoview_cache_fetch(key, keylen, &out, &outlen, &err, &errlen))
+      {
+        mutt_debug(3, "reusing the output of: %s\n", command);
+        autoview_output(s, command, out, outlen, err, errlen);
+        FREE(&out);
+        FREE(&err);
+        FREE(&key);
+        rfc1524_free_entry(&entry);
+        return 0;
+      }
+    }
+
+    if (s->flags & MUTT_DISPLAY)
+      mutt_message(_("Invoking autoview command: %s"), command);
+
     fpin = mutt_file_fopen(tempfile, "w+");
     if (!fpin)
     {
       mutt_perror("fopen");
+      FREE(&key);
       rfc1524_free_entry(&entry);
       return -1;
     }
 
-    mutt_file_copy_bytes(s->fpin, fpin, a->length);
+    if (key)
+      fwrite(key + keylen - a->length, 1, a->length, fpin);
+    else
+      mutt_file_copy_bytes(s->fpin, fpin, a->length);
 
     if (!piped)
-    {
       mutt_file_fclose(&fpin);
-      thepid = mutt_create_filter(command, NULL, &fpout, &fperr);
-    }
     else
     {
       unlink(tempfile);
       fflush(fpin);
       rewind(fpin);
-      thepid = mutt_create_filter_fd(command, NULL, &fpout, &fperr, fileno(fpin), -1, -1);
     }
 
+    if (autoview_start(a, s, command, fpin, tempfile, key, keylen))
+    {
+      rfc1524_free_entry(&entry);
+      return 0;
+    }
+
+    if (!piped)
+      thepid = mutt_create_filter(command, NULL, &fpout, &fperr);
+    else
+      thepid = mutt_create_filter_fd(command, NULL, &fpout, &fperr, fileno(fpin), -1, -1);
+
     if (thepid < 0)
     {
       mutt_perror(_("Can't create filter"));
@@ -586,63 +1277,35 @@ static int autoview_handler(struct Body *a, struct State *s)
         state_mark_attach(s);
         state_printf(s, _("[-- Can't run %s. --]\n"), command);
       }
+      FREE(&key);
       rc = -1;
-      goto bail;
-    }
-
-    if (s->prefix)
-    {
-      while (fgets(buffer, sizeof(buffer), fpout))
-      {
-        state_puts(s->prefix, s);
-        state_puts(buffer, s);
-      }
-      /* check for data on stderr */
-      if (fgets(buffer, sizeof(buffer), fperr))
-      {
-        if (s->flags & MUTT_DISPLAY)
-        {
-          state_mark_attach(s);
-          state_printf(s, _("[-- Autoview stderr of %s --]\n"), command);
-        }
-
-        state_puts(s->prefix, s);
-        state_puts(buffer, s);
-        while (fgets(buffer, sizeof(buffer), fperr))
-        {
-          state_puts(s->prefix, s);
-          state_puts(buffer, s);
-        }
-      }
     }
     else
     {
-      mutt_file_copy_stream(fpout, s->fpout);
-      /* Check for stderr messages */
-      if (fgets(buffer, sizeof(buffer), fperr))
-      {
-        if (s->flags & MUTT_DISPLAY)
-        {
-          state_mark_attach(s);
-          state_printf(s, _("[-- Autoview stderr of %s --]\n"), command);
-        }
+      bool keep = (key != NULL);
+      char *out = NULL, *err = NULL;
+      size_t outlen = 0, errlen = 0;
+
+      autoview_pass(fpout, s, NULL, &out, &outlen, &keep);
+      autoview_pass(fperr, s, command, &err, &errlen, &keep);
+      if (keep)
+        autoview_cache_store(key, keylen, out, outlen, err, errlen);
+      else
+        FREE(&key);
+      FREE(&out);
+      FREE(&err);
 
-        state_puts(buffer, s);
-        mutt_file_copy_stream(fperr, s->fpout);
-      }
+      mutt_file_fclose(&fpout);
+      mutt_file_fclose(&fperr);
+      mutt_wait_filter(thepid);
     }
 
-  bail:
-    mutt_file_fclose(&fpout);
-    mutt_file_fclose(&fperr);
-
-    mutt_wait_filter(thepid);
     if (piped)
       mutt_file_fclose(&fpin);
     else
       mutt_file_unlink(tempfile);
 
-    if (s->flags & MUTT_DISPLAY)
+    if ((s->flags & MUTT_DISPLAY) && !AutoviewPending)
       mutt_clear_error();
   }
   rfc1524_free_entry(&entry);
@@ -1202,6 +1865,16 @@ static int multipart_handler(struct Body *a, struct State *s)
   else
     b = a;
 
+  /* Let the autoview commands of the parts run side by side */
+  struct AutoviewQueue q = { 0 };
+  if (!AutoviewPending)
+  {
+    q.state = s;
+    q.fpout = s->fpout;
+    q.cur = s->fpout;
+    AutoviewPending = &q;
+  }
+
   for (p = b->parts, count = 1; p; p = p->next, count++)
   {
     if (s->flags & MUTT_DISPLAY)
@@ -1242,6 +1915,12 @@ static int multipart_handler(struct Body *a, struct State *s)
     }
   }
 
+  if (AutoviewPending == &q)
+  {
+    autoview_queue_finish(&q);
+    AutoviewPending = NULL;
+  }
+
   if ((a->encoding == ENC_BASE64) || (a->encoding == ENC_QUOTED_PRINTABLE) ||
       (a->encoding == ENC_UUENCODED))
   {
@@ -1431,55 +2110,93 @@ static int malformed_pgp_encrypted_handler(struct Body *b, struct State *s)
  */
 void mutt_decode_base64(struct State *s, size_t len, bool istext, iconv_t cd)
 {
-  char buf[5];
-  int ch, i;
+  unsigned char inbuf[BUFO_SIZE];
+  unsigned char buf[4];
+  int i = 0;
   char bufi[BUFI_SIZE];
   size_t l = 0;
-
-  buf[4] = '\0';
+  bool done = false;
 
   if (istext)
     state_set_prefix(s);
 
-  while (len > 0)
+  /* a mapped input is decoded in one go */
+  LOFF_T pos = 0;
+  const unsigned char *src = (const unsigned char *) ((len > 0) ? state_map(s, len, &pos) : NULL);
+  if (src)
+    fseeko(s->fpin, pos + len, SEEK_SET);
+
+  while ((len > 0) && !done)
   {
-    for (i = 0; (i < 4) && (len > 0); len--)
+    const unsigned char *in = src;
+    size_t n = len;
+    if (!in)
     {
-      ch = fgetc(s->fpin);
-      if (ch == EOF)
+      in = inbuf;
+      n = fread(inbuf, 1, MIN(len, sizeof(inbuf)), s->fpin);
+      if (n == 0)
         break;
-      if ((ch >= 0) && (ch < 128) && (base64val(ch) != -1 || ch == '='))
-        buf[i++] = ch;
     }
-    if (i != 4)
+    len -= n;
+
+    for (size_t j = 0; (j < n) && !done; j++)
     {
-      /* "i" may be zero if there is trailing whitespace, which is not an error */
-      if (i != 0)
-        mutt_debug(2, "didn't get a multiple of 4 chars.\n");
-      break;
-    }
+      /* fast path: four base64 characters in a row */
+      if ((i == 0) && (j + 4 <= n) &&
+          !((in[j] | in[j + 1] | in[j + 2] | in[j + 3]) & 0x80))
+      {
+        const int c1 = base64val(in[j]);
+        const int c2 = base64val(in[j + 1]);
+        const int c3 = base64val(in[j + 2]);
+        const int c4 = base64val(in[j + 3]);
+        if ((c1 | c2 | c3 | c4) >= 0)
+        {
+          bufi[l++] = (c1 << 2) | (c2 >> 4);
+          bufi[l++] = ((c2 & 0xf) << 4) | (c3 >> 2);
+          bufi[l++] = ((c3 & 0x3) << 6) | c4;
+          j += 3;
+          if ((l + 8) >= sizeof(bufi))
+            convert_to_state(cd, bufi, &l, s);
+          continue;
+        }
+      }
 
-    const int c1 = base64val(buf[0]);
-    const int c2 = base64val(buf[1]);
-    ch = (c1 << 2) | (c2 >> 4);
-    bufi[l++] = ch;
+      const unsigned char ch = in[j];
+      if ((ch < 128) && ((base64val(ch) != -1) || (ch == '=')))
+        buf[i++] = ch;
+      if (i != 4)
+        continue;
+      i = 0;
 
-    if (buf[2] == '=')
-      break;
-    const int c3 = base64val(buf[2]);
-    ch = ((c2 & 0xf) << 4) | (c3 >> 2);
-    bufi[l++] = ch;
+      const int c1 = base64val(buf[0]);
+      const int c2 = base64val(buf[1]);
+      bufi[l++] = (c1 << 2) | (c2 >> 4);
 
-    if (buf[3] == '=')
-      break;
-    const int c4 = base64val(buf[3]);
-    ch = ((c3 & 0x3) << 6) | c4;
-    bufi[l++] = ch;
+      if (buf[2] == '=')
+      {
+        done = true;
+        break;
+      }
+      const int c3 = base64val(buf[2]);
+      bufi[l++] = ((c2 & 0xf) << 4) | (c3 >> 2);
 
-    if ((l + 8) >= sizeof(bufi))
-      convert_to_state(cd, bufi, &l, s);
+      if (buf[3] == '=')
+      {
+        done = true;
+        break;
+      }
+      const int c4 = base64val(buf[3]);
+      bufi[l++] = ((c3 & 0x3) << 6) | c4;
+
+      if ((l + 8) >= sizeof(bufi))
+        convert_to_state(cd, bufi, &l, s);
+    }
   }
 
+  /* "i" may be zero if there is trailing whitespace, which is not an error */
+  if (!done && (i != 0))
+    mutt_debug(2, "didn't get a multiple of 4 chars.\n");
+
   convert_to_state(cd, bufi, &l, s);
   convert_to_state(cd, 0, 0, s);
 
@@ -38,6 +38,8 @@ extern char *PreferredLanguages;
 extern bool  ReflowText;
 extern char *ShowMultipartAlternative;
 
+void mutt_autoview_cache_free(void);
+void mutt_autoview_cache_init(void);
 int  mutt_body_handler(struct Body *b, struct State *s);
 bool mutt_can_decode(struct Body *a);
 void mutt_decode_attachment(struct Body *b, struct State *s);
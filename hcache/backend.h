@@ -28,6 +28,10 @@
 
 #include <stdlib.h>
 
+/* Flags for HcacheOps::open() */
+#define HCACHE_OPEN_READONLY (1 << 0) ///< Only read from the database, share it with other readers
+#define HCACHE_OPEN_NOWAIT   (1 << 1) ///< Fail, rather than wait, if the database is locked
+
 /**
  * struct HcacheOps - Header Cache API
  */
@@ -39,26 +43,32 @@ struct HcacheOps
   const char *name;
   /**
    * open - backend-specific routing to open the header cache database
-   * @param path The path to the database file
+   * @param path  The path to the database file
+   * @param flags Flags, e.g. #HCACHE_OPEN_READONLY
    * @retval ptr  Success, backend-specific context
    * @retval NULL Otherwise
    *
    * The open function has the purpose of opening a backend-specific
    * connection to the database file specified by the path parameter. Backends
    * MUST return non-NULL specific context information on success. This will be
-   * stored in the ctx member of the header_cache_t structure and passed on to
+   * kept by the header cache multiplexor and passed on to
    * all other backend-specific functions (see below).
+   *
+   * With #HCACHE_OPEN_READONLY, the database mustn't be created and other
+   * readers mustn't be locked out.  With #HCACHE_OPEN_NOWAIT, the open fails
+   * immediately if another process holds a conflicting lock.
    */
-  void *(*open)(const char *path);
+  void *(*open)(const char *path, int flags);
   /**
    * fetch - backend-specific routine to fetch a message's headers
    * @param ctx    The backend-specific context retrieved via open()
    * @param key    A message identification string
    * @param keylen The length of the string pointed to by key
+   * @param dlen   Length of the fetched data
    * @retval ptr  Success, message's headers
    * @retval NULL Otherwise
    */
-  void *(*fetch)(void *ctx, const char *key, size_t keylen);
+  void *(*fetch)(void *ctx, const char *key, size_t keylen, size_t *dlen);
   /**
    * free - backend-specific routine to free fetched data
    * @param ctx The backend-specific context retrieved via open()
@@ -85,6 +95,24 @@ struct HcacheOps
    * @retval num Error, a backend-specific error code
    */
   int (*delete)(void *ctx, const char *key, size_t keylen);
+  /**
+   * begin - backend-specific routine to start a batch of writes
+   * @param ctx The backend-specific context retrieved via open()
+   * @retval 0   Success
+   * @retval num Error, a backend-specific error code
+   *
+   * All store() and delete() calls up to the matching commit() may be grouped
+   * into a single transaction.  Backends without transactions MAY implement
+   * this as a no-op.
+   */
+  int (*begin)(void *ctx);
+  /**
+   * commit - backend-specific routine to finish a batch of writes
+   * @param ctx The backend-specific context retrieved via open()
+   * @retval 0   Success
+   * @retval num Error, a backend-specific error code
+   */
+  int (*commit)(void *ctx);
   /**
    * close - backend-specific routine to close a context
    * @param ctx The backend-specific context retrieved via open()
@@ -109,6 +137,8 @@ struct HcacheOps
     .free    = hcache_##_name##_free,                                          \
     .store   = hcache_##_name##_store,                                         \
     .delete  = hcache_##_name##_delete,                                        \
+    .begin   = hcache_##_name##_begin,                                         \
+    .commit  = hcache_##_name##_commit,                                        \
     .close   = hcache_##_name##_close,                                         \
     .backend = hcache_##_name##_backend,                                       \
   };
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -50,6 +51,7 @@ struct HcacheDbCtx
   DB_ENV *env;
   DB *db;
   int fd;
+  bool readonly;
   char lockfile[PATH_MAX];
 };
 
@@ -83,33 +85,74 @@ static void dbt_empty_init(DBT *dbt)
   dbt->flags = 0;
 }
 
+/**
+ * lock_file - Open and lock the lock file
+ * @param lockfile Path to the lock file
+ * @param excl     If true, take an exclusive lock
+ * @param wait     If true, wait for the lock
+ * @retval >=0 File descriptor of the locked file
+ * @retval -1  Error, or the lock is held by someone else
+ *
+ * A writer unlinks the lock file when it's finished.  Anyone who was waiting
+ * for the lock then holds it on a file nobody else can see, so check that the
+ * lock is on the file that's still there, and try again if it isn't.
+ */
+static int lock_file(const char *lockfile, bool excl, bool wait)
+{
+  struct stat lsb, fsb;
+
+  while (true)
+  {
+    int fd = open(lockfile, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+      return -1;
+
+    /* The lock is held by someone else, so leave the lock file alone */
+    if (mutt_file_lock(fd, excl, wait))
+    {
+      close(fd);
+      return -1;
+    }
+
+    if ((fstat(fd, &fsb) == 0) && (stat(lockfile, &lsb) == 0) &&
+        (fsb.st_dev == lsb.st_dev) && (fsb.st_ino == lsb.st_ino))
+    {
+      return fd;
+    }
+
+    mutt_file_unlock(fd);
+    close(fd);
+    if (!wait)
+      return -1;
+  }
+}
+
 /**
  * hcache_bdb_open - Implements HcacheOps::open()
  */
-static void *hcache_bdb_open(const char *path)
+static void *hcache_bdb_open(const char *path, int flags)
 {
   struct stat sb;
   int ret;
-  u_int32_t createflags = DB_CREATE;
+  bool readonly = (flags & HCACHE_OPEN_READONLY);
+  u_int32_t createflags = readonly ? DB_RDONLY : DB_CREATE;
   int pagesize;
 
   struct HcacheDbCtx *ctx = mutt_mem_malloc(sizeof(struct HcacheDbCtx));
+  ctx->readonly = readonly;
 
   if (mutt_str_atoi(HeaderCachePagesize, &pagesize) < 0 || pagesize <= 0)
     pagesize = 16384;
 
   snprintf(ctx->lockfile, sizeof(ctx->lockfile), "%s-lock-hack", path);
 
-  ctx->fd = open(ctx->lockfile, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+  ctx->fd = lock_file(ctx->lockfile, !readonly, !(flags & HCACHE_OPEN_NOWAIT));
   if (ctx->fd < 0)
   {
     FREE(&ctx);
     return NULL;
   }
 
-  if (mutt_file_lock(ctx->fd, true, true))
-    goto fail_close;
-
   ret = db_env_create(&ctx->env, 0);
   if (ret)
     goto fail_unlock;
@@ -123,7 +166,7 @@ static void *hcache_bdb_open(const char *path)
   if (ret)
     goto fail_env;
 
-  if (stat(path, &sb) != 0 && errno == ENOENT)
+  if (!readonly && (stat(path, &sb) != 0) && (errno == ENOENT))
   {
     createflags |= DB_EXCL;
     ctx->db->set_pagesize(ctx->db, pagesize);
@@ -140,10 +183,10 @@ fail_db:
 fail_env:
   ctx->env->close(ctx->env, 0);
 fail_unlock:
+  if (!readonly)
+    unlink(ctx->lockfile);
   mutt_file_unlock(ctx->fd);
-fail_close:
   close(ctx->fd);
-  unlink(ctx->lockfile);
   FREE(&ctx);
 
   return NULL;
@@ -152,7 +195,7 @@ fail_close:
 /**
  * hcache_bdb_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   DBT dkey;
   DBT data;
@@ -168,6 +211,7 @@ static void *hcache_bdb_fetch(void *vctx, const char *key, size_t keylen)
 
   ctx->db->get(ctx->db, NULL, &dkey, &data, 0);
 
+  *dlen = data.size;
   return data.data;
 }
 
@@ -218,6 +262,24 @@ static int hcache_bdb_delete(void *vctx, const char *key, size_t keylen)
   return ctx->db->del(ctx->db, NULL, &dkey, 0);
 }
 
+/**
+ * hcache_bdb_begin - Implements HcacheOps::begin()
+ */
+static int hcache_bdb_begin(void *vctx)
+{
+  /* The environment is opened without DB_INIT_TXN, so there is nothing to
+   * start.  Writes go to the memory pool and are flushed on close. */
+  return 0;
+}
+
+/**
+ * hcache_bdb_commit - Implements HcacheOps::commit()
+ */
+static int hcache_bdb_commit(void *vctx)
+{
+  return 0;
+}
+
 /**
  * hcache_bdb_close - Implements HcacheOps::close()
  */
@@ -230,9 +292,12 @@ static void hcache_bdb_close(void **vctx)
 
   ctx->db->close(ctx->db, 0);
   ctx->env->close(ctx->env, 0);
+  /* Unlink the file before the lock is released, so that nobody can lock it
+   * and believe it's still in use; anyone waiting on it will try again */
+  if (!ctx->readonly)
+    unlink(ctx->lockfile);
   mutt_file_unlock(ctx->fd);
   close(ctx->fd);
-  unlink(ctx->lockfile);
   FREE(vctx);
 }
 
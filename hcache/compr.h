@@ -0,0 +1,69 @@
+/**
+ * @file
+ * API for the header cache compression
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_HCACHE_COMPR_H
+#define MUTT_HCACHE_COMPR_H
+
+#include <stdlib.h>
+
+/**
+ * struct ComprOps - Header cache compression API
+ */
+struct ComprOps
+{
+  /**
+   * name - Compression name
+   */
+  const char *name;
+  /**
+   * compress - compress header cache data
+   * @param data  Data to be compressed
+   * @param dlen  Length of the data
+   * @param clen  Length of the compressed data
+   * @param level Compression level, clamped to the method's range
+   * @retval ptr  Success, newly allocated compressed data
+   * @retval NULL Otherwise
+   *
+   * The returned buffer must be free'd by the caller.
+   */
+  void *(*compress)(const void *data, size_t dlen, size_t *clen, short level);
+  /**
+   * decompress - decompress header cache data
+   * @param cdata Data to be decompressed
+   * @param clen  Length of the compressed data
+   * @param dlen  Length of the original data
+   * @retval ptr  Success, newly allocated buffer of exactly @a dlen bytes
+   * @retval NULL Otherwise, e.g. corrupt data
+   *
+   * The returned buffer must be free'd by the caller.
+   */
+  void *(*decompress)(const void *cdata, size_t clen, size_t dlen);
+};
+
+#define COMPR_OPS(_name)                                                       \
+  const struct ComprOps compr_##_name##_ops = {                                \
+    .name       = #_name,                                                      \
+    .compress   = compr_##_name##_compress,                                    \
+    .decompress = compr_##_name##_decompress,                                  \
+  };
+
+#endif /* MUTT_HCACHE_COMPR_H */
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * LZ4 header cache compression
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_lz4 LZ4
+ *
+ * Use LZ4 to compress header cache records.  This is very fast, but the
+ * compression ratio is modest.
+ */
+
+#include "config.h"
+#include <lz4.h>
+#include <stddef.h>
+#include "mutt/mutt.h"
+#include "compr.h"
+
+#define MIN_COMP_LEVEL 1  ///< Minimum compression level for lz4
+#define MAX_COMP_LEVEL 12 ///< Maximum compression level for lz4
+
+/**
+ * compr_lz4_compress - Implements ComprOps::compress()
+ *
+ * The level is used as LZ4's acceleration factor, inverted so that, as with
+ * the other methods, a higher level means better compression.
+ */
+static void *compr_lz4_compress(const void *data, size_t dlen, size_t *clen, short level)
+{
+  if (dlen > LZ4_MAX_INPUT_SIZE)
+    return NULL;
+
+  if (level < MIN_COMP_LEVEL)
+    level = MIN_COMP_LEVEL;
+  else if (level > MAX_COMP_LEVEL)
+    level = MAX_COMP_LEVEL;
+
+  int bound = LZ4_compressBound(dlen);
+  char *cdata = mutt_mem_malloc(bound);
+
+  int rc = LZ4_compress_fast(data, cdata, dlen, bound, MAX_COMP_LEVEL + 1 - level);
+  if (rc <= 0)
+  {
+    FREE(&cdata);
+    return NULL;
+  }
+
+  *clen = rc;
+  return cdata;
+}
+
+/**
+ * compr_lz4_decompress - Implements ComprOps::decompress()
+ */
+static void *compr_lz4_decompress(const void *cdata, size_t clen, size_t dlen)
+{
+  if ((clen > LZ4_MAX_INPUT_SIZE) || (dlen > LZ4_MAX_INPUT_SIZE))
+    return NULL;
+
+  char *data = mutt_mem_malloc(dlen ? dlen : 1);
+
+  int rc = LZ4_decompress_safe(cdata, data, clen, dlen);
+  if ((rc < 0) || ((size_t) rc != dlen))
+  {
+    FREE(&data);
+    return NULL;
+  }
+
+  return data;
+}
+
+COMPR_OPS(lz4)
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * zlib header cache compression
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_zlib zlib
+ *
+ * Use zlib to compress header cache records.
+ */
+
+#include "config.h"
+#include <stddef.h>
+#include <zlib.h>
+#include "mutt/mutt.h"
+#include "compr.h"
+
+#define MIN_COMP_LEVEL 1 ///< Minimum compression level for zlib
+#define MAX_COMP_LEVEL 9 ///< Maximum compression level for zlib
+
+/**
+ * compr_zlib_compress - Implements ComprOps::compress()
+ */
+static void *compr_zlib_compress(const void *data, size_t dlen, size_t *clen, short level)
+{
+  if (level < MIN_COMP_LEVEL)
+    level = MIN_COMP_LEVEL;
+  else if (level > MAX_COMP_LEVEL)
+    level = MAX_COMP_LEVEL;
+
+  uLongf len = compressBound(dlen);
+  Bytef *cdata = mutt_mem_malloc(len);
+
+  int rc = compress2(cdata, &len, data, dlen, level);
+  if (rc != Z_OK)
+  {
+    FREE(&cdata);
+    return NULL;
+  }
+
+  *clen = len;
+  return cdata;
+}
+
+/**
+ * compr_zlib_decompress - Implements ComprOps::decompress()
+ */
+static void *compr_zlib_decompress(const void *cdata, size_t clen, size_t dlen)
+{
+  uLongf len = dlen;
+  Bytef *data = mutt_mem_malloc(dlen ? dlen : 1);
+
+  int rc = uncompress(data, &len, cdata, clen);
+  if ((rc != Z_OK) || (len != dlen))
+  {
+    FREE(&data);
+    return NULL;
+  }
+
+  return data;
+}
+
+COMPR_OPS(zlib)
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * Zstandard header cache compression
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page hc_compr_zstd Zstandard
+ *
+ * Use Zstandard to compress header cache records.
+ */
+
+#include "config.h"
+#include <stddef.h>
+#include <zstd.h>
+#include "mutt/mutt.h"
+#include "compr.h"
+
+#define MIN_COMP_LEVEL 1  ///< Minimum compression level for zstd
+#define MAX_COMP_LEVEL 22 ///< Maximum compression level for zstd
+
+/**
+ * compr_zstd_compress - Implements ComprOps::compress()
+ */
+static void *compr_zstd_compress(const void *data, size_t dlen, size_t *clen, short level)
+{
+  if (level < MIN_COMP_LEVEL)
+    level = MIN_COMP_LEVEL;
+  else if (level > MAX_COMP_LEVEL)
+    level = MAX_COMP_LEVEL;
+
+  size_t bound = ZSTD_compressBound(dlen);
+  void *cdata = mutt_mem_malloc(bound);
+
+  size_t rc = ZSTD_compress(cdata, bound, data, dlen, level);
+  if (ZSTD_isError(rc))
+  {
+    mutt_debug(2, "ZSTD_compress: %s\n", ZSTD_getErrorName(rc));
+    FREE(&cdata);
+    return NULL;
+  }
+
+  *clen = rc;
+  return cdata;
+}
+
+/**
+ * compr_zstd_decompress - Implements ComprOps::decompress()
+ */
+static void *compr_zstd_decompress(const void *cdata, size_t clen, size_t dlen)
+{
+  void *data = mutt_mem_malloc(dlen ? dlen : 1);
+
+  size_t rc = ZSTD_decompress(data, dlen, cdata, clen);
+  if (ZSTD_isError(rc) || (rc != dlen))
+  {
+    FREE(&data);
+    return NULL;
+  }
+
+  return data;
+}
+
+COMPR_OPS(zstd)
@@ -39,15 +39,19 @@
 /**
  * hcache_gdbm_open - Implements HcacheOps::open()
  */
-static void *hcache_gdbm_open(const char *path)
+static void *hcache_gdbm_open(const char *path, int flags)
 {
   int pagesize;
 
   if (mutt_str_atoi(HeaderCachePagesize, &pagesize) < 0 || pagesize <= 0)
     pagesize = 16384;
 
+  /* GDBM never waits for a lock, a locked database just fails to open */
+  if (flags & HCACHE_OPEN_READONLY)
+    return gdbm_open((char *) path, pagesize, GDBM_READER, 00600, NULL);
+
   GDBM_FILE db = gdbm_open((char *) path, pagesize, GDBM_WRCREAT, 00600, NULL);
-  if (db)
+  if (db || (flags & HCACHE_OPEN_NOWAIT))
     return db;
 
   /* if rw failed try ro */
@@ -57,7 +61,7 @@ static void *hcache_gdbm_open(const char *path)
 /**
  * hcache_gdbm_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
   datum dkey;
   datum data;
@@ -70,6 +74,7 @@ static void *hcache_gdbm_fetch(void *ctx, const char *key, size_t keylen)
   dkey.dptr = (char *) key;
   dkey.dsize = keylen;
   data = gdbm_fetch(db, dkey);
+  *dlen = data.dsize;
   return data.dptr;
 }
 
@@ -121,6 +126,24 @@ static int hcache_gdbm_delete(void *ctx, const char *key, size_t keylen)
   return gdbm_delete(db, dkey);
 }
 
+/**
+ * hcache_gdbm_begin - Implements HcacheOps::begin()
+ */
+static int hcache_gdbm_begin(void *ctx)
+{
+  /* GDBM has no transactions and the database isn't opened with GDBM_SYNC,
+   * so individual writes are already cheap */
+  return 0;
+}
+
+/**
+ * hcache_gdbm_commit - Implements HcacheOps::commit()
+ */
+static int hcache_gdbm_commit(void *ctx)
+{
+  return 0;
+}
+
 /**
  * hcache_gdbm_close - Implements HcacheOps::close()
  */
@@ -42,23 +42,37 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include "mutt/mutt.h"
 #include "backend.h"
+#include "compr.h"
 #include "hcache.h"
-#include "hcache/hcversion.h"
 
 /* These Config Variables are only used in hcache/hcache.c */
 char *HeaderCacheBackend; ///< Config: (hcache) Header cache backend to use
+short HeaderCacheCompressLevel; ///< Config: (hcache) Level of compression for method
+char *HeaderCacheCompressMethod; ///< Config: (hcache) Enable generic hcache database compression
+bool HeaderCachePerAccount; ///< Config: (hcache) Use one database for all the folders of an account
+bool HeaderCacheShared; ///< Config: (hcache) Share the databases with other NeoMutt processes
 
 static unsigned int hcachever = 0x0;
 
+/* Maximum number of writes grouped into one backend transaction */
+#define HCACHE_BATCH_SIZE 1000
+
+/* Shared databases: writes kept while the database is busy, before giving up */
+#define HCACHE_QUEUE_MAX (10 * HCACHE_BATCH_SIZE)
+/* Shared databases: attempts to flush the writes when a database is closed */
+#define HCACHE_FLUSH_ATTEMPTS 10
+
 #define HCACHE_BACKEND(name) extern const struct HcacheOps hcache_##name##_ops;
 HCACHE_BACKEND(bdb)
 HCACHE_BACKEND(gdbm)
@@ -68,8 +82,57 @@ HCACHE_BACKEND(qdbm)
 HCACHE_BACKEND(tokyocabinet)
 #undef HCACHE_BACKEND
 
+#define COMPR_BACKEND(name) extern const struct ComprOps compr_##name##_ops;
+COMPR_BACKEND(lz4)
+COMPR_BACKEND(zlib)
+COMPR_BACKEND(zstd)
+#undef COMPR_BACKEND
+
 #define hcache_get_ops() hcache_get_backend_ops(HeaderCacheBackend)
 
+/* Largest record the decompressor will allocate room for */
+#define HCACHE_MAX_RECORD (16 * 1024 * 1024)
+
+/**
+ * struct HcacheDb - An open backend database
+ *
+ * Handles to the same database share a single backend context.  A database
+ * holding many folders is kept open once its last handle has been closed, so
+ * changing folder doesn't have to open it again.
+ *
+ * A concurrent database (see $header_cache_shared) may be used by other
+ * processes at the same time.  The backend is only opened read-only, without
+ * waiting for locks, and is reopened when another process changes the file.
+ * Writes are queued and flushed in a single short transaction.
+ */
+struct HcacheDb
+{
+  char *path;                  ///< Full pathname of the database
+  const struct HcacheOps *ops; ///< Backend that opened the database
+  void *ctx;                   ///< Backend-specific context
+  int refcount;                ///< Number of handles using the database
+  int batches;                 ///< Number of handles with a batch of writes open
+  bool persistent;             ///< Keep the database open while unused
+  bool concurrent;             ///< Other processes may use the database
+  struct stat sb;              ///< State of the file when ctx was opened
+  struct Hash *queue;          ///< Writes waiting to be flushed, see hcache_db_flush()
+  unsigned int queued;         ///< Number of writes in the queue
+  struct HcacheDb *next;       ///< Linked list
+};
+
+/**
+ * struct HcacheWrite - A write queued for a concurrent database
+ */
+struct HcacheWrite
+{
+  void *data;  ///< Record to store, NULL to delete the key
+  size_t dlen; ///< Length of the record
+};
+
+static struct HcacheDb *OpenDatabases = NULL; ///< Databases currently open
+
+static struct HcacheStats HcacheTotals; ///< Usage counters for the whole session
+
 /**
  * hcache_ops - Backend implementations
  *
@@ -98,6 +161,41 @@ const struct HcacheOps *hcache_ops[] = {
   NULL,
 };
 
+/**
+ * compr_ops - Compression methods
+ */
+const struct ComprOps *compr_ops[] = {
+#ifdef HAVE_LZ4
+  &compr_lz4_ops,
+#endif
+#ifdef HAVE_ZLIB
+  &compr_zlib_ops,
+#endif
+#ifdef HAVE_ZSTD
+  &compr_zstd_ops,
+#endif
+  NULL,
+};
+
+/**
+ * compr_get_ops - Get the API functions for a compression method
+ * @param compr Name of the method
+ * @retval ptr  Set of function pointers
+ * @retval NULL No compression, or unknown method
+ */
+static const struct ComprOps *compr_get_ops(const char *compr)
+{
+  if (!compr || !*compr)
+    return NULL;
+
+  const struct ComprOps **ops = compr_ops;
+  for (; *ops; ++ops)
+    if (strcmp(compr, (*ops)->name) == 0)
+      break;
+
+  return *ops;
+}
+
 /**
  * hcache_get_backend_ops - Get the API functions for an hcache backend
  * @param backend Name of the backend
@@ -119,6 +217,111 @@ static const struct HcacheOps *hcache_get_backend_ops(const char *backend)
   return *ops;
 }
 
+/**
+ * stats_bucket - Get the latency histogram bucket for an operation
+ * @param start Time the operation started
+ * @retval num Index into a histogram
+ */
+static int stats_bucket(const struct timeval *start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  long usec = (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_usec - start->tv_usec);
+  int bucket = 0;
+  while ((usec > 0) && (bucket < (HCACHE_HIST_BUCKETS - 1)))
+  {
+    usec >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+/**
+ * stats_fetch - Count a fetch from the backend
+ * @param hc    Header cache handle
+ * @param start Time the fetch started
+ * @param len   Number of bytes fetched
+ */
+static void stats_fetch(header_cache_t *hc, const struct timeval *start, size_t len)
+{
+  int bucket = stats_bucket(start);
+
+  hc->stats.bytes_read += len;
+  hc->stats.fetch_hist[bucket]++;
+  HcacheTotals.bytes_read += len;
+  HcacheTotals.fetch_hist[bucket]++;
+}
+
+/**
+ * stats_store - Count a store to the backend
+ * @param hc    Header cache handle
+ * @param start Time the store started
+ * @param len   Number of bytes stored
+ */
+static void stats_store(header_cache_t *hc, const struct timeval *start, size_t len)
+{
+  int bucket = stats_bucket(start);
+
+  hc->stats.stores++;
+  hc->stats.bytes_written += len;
+  hc->stats.store_hist[bucket]++;
+  HcacheTotals.stores++;
+  HcacheTotals.bytes_written += len;
+  HcacheTotals.store_hist[bucket]++;
+}
+
+/**
+ * stats_hist_format - Describe a latency histogram
+ * @param hist   Histogram
+ * @param buf    Buffer for the result
+ * @param buflen Length of the buffer
+ *
+ * Only the non-empty buckets are listed, e.g. "<8us:12 <16us:3"
+ */
+static void stats_hist_format(const unsigned long *hist, char *buf, size_t buflen)
+{
+  size_t len = 0;
+  buf[0] = '\0';
+
+  for (int i = 0; (i < HCACHE_HIST_BUCKETS) && (len < buflen); i++)
+  {
+    if (hist[i] == 0)
+      continue;
+
+    len += snprintf(buf + len, buflen - len, "%s%s%luus:%lu", len ? " " : "",
+                    (i == (HCACHE_HIST_BUCKETS - 1)) ? ">=" : "<",
+                    (i == (HCACHE_HIST_BUCKETS - 1)) ? (1UL << (i - 1)) : (1UL << i),
+                    hist[i]);
+  }
+}
+
+/**
+ * stats_log - Write the usage counters of a handle to the log
+ * @param hc Header cache handle
+ */
+static void stats_log(const header_cache_t *hc)
+{
+  char buf[LONG_STRING];
+
+  if ((hc->stats.hits + hc->stats.misses + hc->stats.crc_mismatches +
+       hc->stats.stores) == 0)
+  {
+    return;
+  }
+
+  mutt_hcache_stats_format(&hc->stats, buf, sizeof(buf));
+  mutt_debug(1, "%s (%s): %s\n", hc->folder, hc->db->ops->name, buf);
+
+  stats_hist_format(hc->stats.fetch_hist, buf, sizeof(buf));
+  if (buf[0])
+    mutt_debug(2, "fetch latency: %s\n", buf);
+  stats_hist_format(hc->stats.store_hist, buf, sizeof(buf));
+  if (buf[0])
+    mutt_debug(2, "store latency: %s\n", buf);
+}
+
 /**
  * crc_matches - Is the CRC number correct?
  * @param d   Binary blob to read CRC from
@@ -166,6 +369,8 @@ static bool create_hcache_dir(const char *path)
  * @param path   Base directory, from $header_cache
  * @param folder Mailbox name (including protocol)
  * @param namer  Callback to generate database filename - Implements ::hcache_namer_t
+ * @param compr  Compression method, may be NULL
+ * @param shared Set to true if the database holds every folder
  * @retval ptr Full pathname to the database (to be generated)
  *             (path must be freed by the caller)
  *
@@ -175,22 +380,28 @@ static bool create_hcache_dir(const char *path)
  * * BASE:   Base directory (@a path)
  * * FOLDER: Mailbox name (@a folder)
  * * NAME:   Create by @a namer, or md5sum of @a folder
- * * SUFFIX: Character set (if ICONV isn't being used)
+ * * SUFFIX: Compression method, if any
  *
  * This function will create any parent directories needed, so the caller just
  * needs to create the database file.
  *
  * If @a path exists and is a directory, it is used.
  * If @a path has a trailing '/' it is assumed to be a directory.
- * If ICONV isn't being used, then a suffix is added to the path, e.g. '-utf-8'.
+ * If records are compressed, a suffix is added to the path, e.g. '-zstd', so
+ * that compressed and uncompressed records are never mixed.
  * Otherwise @a path is assumed to be a file.
  */
-static const char *hcache_per_folder(const char *path, const char *folder, hcache_namer_t namer)
+static const char *hcache_per_folder(const char *path, const char *folder,
+                                     hcache_namer_t namer,
+                                     const struct ComprOps *compr, bool *shared)
 {
   static char hcpath[PATH_MAX];
   char suffix[32] = "";
   struct stat sb;
 
+  if (compr)
+    snprintf(suffix, sizeof(suffix), "-%s", compr->name);
+
   int plen = mutt_str_strlen(path);
   int rc = stat(path, &sb);
   int slash = (path[plen - 1] == '/');
@@ -198,6 +409,7 @@ static const char *hcache_per_folder(const char *path, const char *folder, hcach
   if (((rc == 0) && !S_ISDIR(sb.st_mode)) || ((rc == -1) && !slash))
   {
     /* An existing file or a non-existing path not ending with a slash */
+    *shared = true;
     snprintf(hcpath, sizeof(hcpath), "%s%s", path, suffix);
     mutt_encode_path(hcpath, sizeof(hcpath), hcpath);
     return hcpath;
@@ -213,6 +425,8 @@ static const char *hcache_per_folder(const char *path, const char *folder, hcach
       plen++;
 
     rc = namer(folder, hcpath + plen, sizeof(hcpath) - plen);
+    if (rc >= 0)
+      mutt_str_strcat(hcpath, sizeof(hcpath), suffix);
   }
   else
   {
@@ -233,6 +447,402 @@ static const char *hcache_per_folder(const char *path, const char *folder, hcach
   return hcpath;
 }
 
+/**
+ * hcache_account - Get the account part of a remote folder name
+ * @param folder Mailbox name, e.g. "imaps:user@host/INBOX"
+ * @param buf    Buffer for the result, e.g. "imaps:user@host"
+ * @param buflen Length of the buffer
+ * @retval true  The folder is remote and @a buf has been filled
+ * @retval false The folder is local
+ */
+static bool hcache_account(const char *folder, char *buf, size_t buflen)
+{
+  if (url_check_scheme(folder) == U_UNKNOWN)
+    return false;
+
+  const char *p = strchr(folder, ':') + 1;
+  while (*p == '/')
+    p++;
+  p = strchr(p, '/');
+
+  size_t len = p ? (size_t)(p - folder) : mutt_str_strlen(folder);
+  mutt_str_strfcpy(buf, folder, MIN(len + 1, buflen));
+  return true;
+}
+
+/**
+ * hcache_db_path - Get the pathname of the database holding a folder
+ * @param[in]  path        Base directory, from $header_cache
+ * @param[in]  folder      Canonical mailbox name
+ * @param[in]  namer       Callback to generate database filename
+ * @param[in]  compr       Compression method, may be NULL
+ * @param[out] shared      Set to true if the database holds many folders
+ * @param[out] per_account Set to true if the database holds a whole account
+ * @retval ptr Full pathname to the database
+ */
+static const char *hcache_db_path(const char *path, const char *folder,
+                                  hcache_namer_t namer, const struct ComprOps *compr,
+                                  bool *shared, bool *per_account)
+{
+  char account[PATH_MAX];
+  *per_account = HeaderCachePerAccount && hcache_account(folder, account, sizeof(account));
+  *shared = *per_account;
+
+  return hcache_per_folder(path, *per_account ? account : folder, namer, compr, shared);
+}
+
+/**
+ * hcache_db_open - Open a database, or share one that's already open
+ * @param ops        Backend to use
+ * @param path       Full pathname of the database
+ * @param persistent Keep the database open after the last handle is closed
+ * @retval ptr  Database
+ * @retval NULL Error
+ */
+static struct HcacheDb *hcache_db_open(const struct HcacheOps *ops,
+                                       const char *path, bool persistent)
+{
+  struct HcacheDb *db = NULL;
+  for (db = OpenDatabases; db; db = db->next)
+  {
+    if ((db->ops == ops) && (mutt_str_strcmp(db->path, path) == 0))
+    {
+      db->refcount++;
+      db->persistent |= persistent;
+      return db;
+    }
+  }
+
+  /* A concurrent database is opened when it's first read or written */
+  void *ctx = NULL;
+  if (!HeaderCacheShared)
+  {
+    ctx = ops->open(path, 0);
+    if (!ctx)
+    {
+      /* remove a possibly incompatible version */
+      if (unlink(path) == 0)
+        ctx = ops->open(path, 0);
+      if (!ctx)
+        return NULL;
+    }
+  }
+
+  db = mutt_mem_calloc(1, sizeof(struct HcacheDb));
+  db->path = mutt_str_strdup(path);
+  db->ops = ops;
+  db->ctx = ctx;
+  db->refcount = 1;
+  db->persistent = persistent;
+  db->concurrent = HeaderCacheShared;
+  db->next = OpenDatabases;
+  OpenDatabases = db;
+
+  return db;
+}
+
+/**
+ * hcache_write_free - Free a queued write - Implements ::hash_destructor_t
+ */
+static void hcache_write_free(int type, void *obj, intptr_t data)
+{
+  struct HcacheWrite *w = obj;
+  mutt_mem_free_tag(MEM_TAG_HCACHE, &w->data, w->dlen);
+  mutt_mem_free_tag(MEM_TAG_HCACHE, &w, sizeof(struct HcacheWrite));
+}
+
+/**
+ * hcache_db_drop - Close the backend of a concurrent database
+ * @param db Database
+ *
+ * This releases the backend's locks, so that other processes can write.
+ */
+static void hcache_db_drop(struct HcacheDb *db)
+{
+  if (!db->concurrent || !db->ctx)
+    return;
+
+  db->ops->close(&db->ctx);
+  db->ctx = NULL;
+}
+
+/**
+ * hcache_db_reader - Get an up to date backend context for reading
+ * @param db Database
+ * @retval ptr  Backend context
+ * @retval NULL The database doesn't exist, or is locked by a writer
+ *
+ * If another process has changed the database since it was opened, it is
+ * reopened, so that the new records are seen.
+ */
+static void *hcache_db_reader(struct HcacheDb *db)
+{
+  struct stat sb;
+  if (stat(db->path, &sb) != 0)
+  {
+    hcache_db_drop(db);
+    return NULL;
+  }
+
+  bool changed = (sb.st_ino != db->sb.st_ino) || (sb.st_size != db->sb.st_size) ||
+                 (sb.st_mtime != db->sb.st_mtime);
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  changed |= (sb.st_mtim.tv_nsec != db->sb.st_mtim.tv_nsec);
+#endif
+
+  if (db->ctx && !changed)
+    return db->ctx;
+
+  hcache_db_drop(db);
+  db->ctx = db->ops->open(db->path, HCACHE_OPEN_READONLY | HCACHE_OPEN_NOWAIT);
+  if (db->ctx)
+    db->sb = sb;
+  else
+    mutt_debug(5, "can't read %s, it may be busy\n", db->path);
+
+  return db->ctx;
+}
+
+/**
+ * hcache_db_flush - Write the queue of a concurrent database
+ * @param db Database
+ * @retval  0 Success, or nothing to do
+ * @retval -1 The database is busy, the writes are still queued
+ *
+ * The queued writes are made in a single transaction.  The backend is then
+ * closed, so that the write lock is held as briefly as possible.
+ */
+static int hcache_db_flush(struct HcacheDb *db)
+{
+  if (!db->concurrent || (db->queued == 0))
+    return 0;
+
+  /* Our own read lock would keep us from writing */
+  hcache_db_drop(db);
+
+  void *ctx = db->ops->open(db->path, HCACHE_OPEN_NOWAIT);
+  if (!ctx)
+  {
+    mutt_debug(3, "%s is busy, %u writes queued\n", db->path, db->queued);
+    if (db->queued < HCACHE_QUEUE_MAX)
+      return -1;
+
+    mutt_debug(1, "%s is still busy, discarding %u writes\n", db->path, db->queued);
+    mutt_hash_destroy(&db->queue);
+    db->queued = 0;
+    return -1;
+  }
+
+  mutt_debug(3, "flushing %u writes to %s\n", db->queued, db->path);
+  db->ops->begin(ctx);
+
+  struct HashWalkState state = { 0 };
+  struct HashElem *he = NULL;
+  while ((he = mutt_hash_walk(db->queue, &state)))
+  {
+    struct HcacheWrite *w = he->data;
+    if (w->data)
+      db->ops->store(ctx, he->key.strkey, mutt_str_strlen(he->key.strkey), w->data, w->dlen);
+    else
+      db->ops->delete (ctx, he->key.strkey, mutt_str_strlen(he->key.strkey));
+  }
+
+  db->ops->commit(ctx);
+  db->ops->close(&ctx);
+
+  mutt_hash_destroy(&db->queue);
+  db->queued = 0;
+  return 0;
+}
+
+/**
+ * hcache_db_queue - Queue a write to a concurrent database
+ * @param db   Database
+ * @param key  Full key of the record
+ * @param data Record, NULL to delete the key
+ * @param dlen Length of the record
+ */
+static void hcache_db_queue(struct HcacheDb *db, const char *key, void *data, size_t dlen)
+{
+  if (!db->queue)
+  {
+    db->queue = mutt_hash_create(HCACHE_BATCH_SIZE, MUTT_HASH_STRDUP_KEYS);
+    mutt_hash_set_destructor(db->queue, hcache_write_free, 0);
+  }
+
+  struct HcacheWrite *w = mutt_mem_calloc_tag(MEM_TAG_HCACHE, 1, sizeof(struct HcacheWrite));
+  if (data)
+  {
+    w->data = mutt_mem_malloc_tag(MEM_TAG_HCACHE, dlen);
+    memcpy(w->data, data, dlen);
+    w->dlen = dlen;
+  }
+
+  struct HashElem *he = mutt_hash_find_elem(db->queue, key);
+  if (he)
+  {
+    hcache_write_free(0, he->data, 0);
+    he->data = w;
+    return;
+  }
+
+  mutt_hash_insert(db->queue, key, w);
+  db->queued++;
+}
+
+/**
+ * hcache_db_fetch - Fetch a record from a database
+ * @param[in]  db     Database
+ * @param[in]  key    Full key of the record
+ * @param[in]  keylen Length of the key
+ * @param[out] dlen   Length of the record
+ * @retval ptr  Record, free it with hcache_db_data_free()
+ * @retval NULL Not found
+ */
+static void *hcache_db_fetch(struct HcacheDb *db, const char *key, size_t keylen, size_t *dlen)
+{
+  if (!db->concurrent)
+    return db->ops->fetch(db->ctx, key, keylen, dlen);
+
+  /* Our own writes, that haven't been flushed yet */
+  struct HcacheWrite *w = db->queue ? mutt_hash_find(db->queue, key) : NULL;
+  if (w)
+  {
+    if (!w->data)
+      return NULL;
+    void *copy = mutt_mem_malloc(w->dlen);
+    memcpy(copy, w->data, w->dlen);
+    *dlen = w->dlen;
+    return copy;
+  }
+
+  void *ctx = hcache_db_reader(db);
+  if (!ctx)
+    return NULL;
+
+  /* The backend may be reopened at any time, so don't keep its data */
+  void *data = db->ops->fetch(ctx, key, keylen, dlen);
+  if (!data)
+    return NULL;
+
+  void *copy = mutt_mem_malloc(*dlen);
+  memcpy(copy, data, *dlen);
+  db->ops->free(ctx, &data);
+  return copy;
+}
+
+/**
+ * hcache_db_data_free - Free a record fetched by hcache_db_fetch()
+ * @param db   Database
+ * @param data Record to free
+ */
+static void hcache_db_data_free(struct HcacheDb *db, void **data)
+{
+  if (db->concurrent)
+    FREE(data);
+  else
+    db->ops->free(db->ctx, data);
+}
+
+/**
+ * hcache_db_store - Store a record in a database
+ * @param db     Database
+ * @param key    Full key of the record
+ * @param keylen Length of the key
+ * @param data   Record
+ * @param dlen   Length of the record
+ * @retval 0   Success
+ * @retval num Backend-specific error code
+ */
+static int hcache_db_store(struct HcacheDb *db, const char *key, size_t keylen,
+                           void *data, size_t dlen)
+{
+  if (!db->concurrent)
+    return db->ops->store(db->ctx, key, keylen, data, dlen);
+
+  hcache_db_queue(db, key, data, dlen);
+  return 0;
+}
+
+/**
+ * hcache_db_delete - Delete a record from a database
+ * @param db     Database
+ * @param key    Full key of the record
+ * @param keylen Length of the key
+ * @retval 0   Success
+ * @retval num Backend-specific error code
+ */
+static int hcache_db_delete(struct HcacheDb *db, const char *key, size_t keylen)
+{
+  if (!db->concurrent)
+    return db->ops->delete (db->ctx, key, keylen);
+
+  hcache_db_queue(db, key, NULL, 0);
+  return 0;
+}
+
+/**
+ * hcache_db_free - Close a database and forget about it
+ * @param db Database
+ */
+static void hcache_db_free(struct HcacheDb *db)
+{
+  struct HcacheDb **np = &OpenDatabases;
+  while (*np && (*np != db))
+    np = &(*np)->next;
+  if (*np)
+    *np = db->next;
+
+  /* Give the other processes a moment to finish with the database */
+  for (int i = 0; (hcache_db_flush(db) != 0) && db->queue && (i < HCACHE_FLUSH_ATTEMPTS); i++)
+  {
+    struct timespec wait = { 0, 100000000 }; /* 0.1s */
+    nanosleep(&wait, NULL);
+  }
+  if (db->queued > 0)
+    mutt_debug(1, "%s is busy, discarding %u writes\n", db->path, db->queued);
+
+  /* Most backends abort an open transaction when they're closed */
+  if (db->ctx && (db->batches > 0))
+    db->ops->commit(db->ctx);
+  if (db->ctx)
+    db->ops->close(&db->ctx);
+  mutt_hash_destroy(&db->queue);
+  FREE(&db->path);
+  FREE(&db);
+}
+
+/**
+ * hcache_db_release - Stop using a database
+ * @param db Database
+ *
+ * A persistent database stays open, but any pending writes are committed, so
+ * nothing is lost if NeoMutt is killed.
+ */
+static void hcache_db_release(struct HcacheDb *db)
+{
+  if (--db->refcount > 0)
+    return;
+
+  if (!db->persistent)
+  {
+    hcache_db_free(db);
+    return;
+  }
+
+  if (db->concurrent)
+  {
+    /* Don't lock out the other processes while we're not using it */
+    hcache_db_flush(db);
+    hcache_db_drop(db);
+    return;
+  }
+
+  /* Flush any writes made outside a batch */
+  if (db->ops->begin(db->ctx) == 0)
+    db->ops->commit(db->ctx);
+}
+
 /**
  * get_foldername - Where should the cache be stored?
  * @param folder Path to be canonicalised
@@ -269,11 +879,11 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
     } digest;
     struct Md5Ctx ctx;
 
-    hcachever = HCACHEVER;
+    hcachever = HCACHE_FORMAT;
 
     mutt_md5_init_ctx(&ctx);
 
-    /* Seed with the compiled-in header structure hash */
+    /* Seed with the record format */
     mutt_md5_process_bytes(&hcachever, sizeof(hcachever), &ctx);
 
     /* Mix in user's spam list */
@@ -298,6 +908,7 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
 
   hc->folder = get_foldername(folder);
   hc->crc = hcachever;
+  hc->compr = compr_get_ops(HeaderCacheCompressMethod);
 
   if (!path || path[0] == '\0')
   {
@@ -306,25 +917,66 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
     return NULL;
   }
 
-  path = hcache_per_folder(path, hc->folder, namer);
+  bool shared = false;
+  bool per_account = false;
+  path = hcache_db_path(path, hc->folder, namer, hc->compr, &shared, &per_account);
 
-  hc->ctx = ops->open(path);
-  if (hc->ctx)
-    return hc;
-  else
+  mutt_trace_begin("hcache_open", path);
+  hc->db = hcache_db_open(ops, path, shared);
+  mutt_trace_end("hcache_open");
+  if (!hc->db)
   {
-    /* remove a possibly incompatible version */
-    if (unlink(path) == 0)
-    {
-      hc->ctx = ops->open(path);
-      if (hc->ctx)
-        return hc;
-    }
     FREE(&hc->folder);
     FREE(&hc);
-
     return NULL;
   }
+
+  /* Keep the keys of one folder from running into those of another,
+   * e.g. article "12" of "comp.lang" and article "2" of "comp.lang1" */
+  if (per_account)
+    mutt_str_append_item(&hc->folder, "", '|');
+
+  return hc;
+}
+
+/**
+ * mutt_hcache_prefetch - Ask the kernel to read a folder's database
+ */
+void mutt_hcache_prefetch(const char *path, const char *folder, hcache_namer_t namer)
+{
+  if (!path || (path[0] == '\0') || !folder)
+    return;
+
+  bool shared = false;
+  bool per_account = false;
+  char *canon = get_foldername(folder);
+  path = hcache_db_path(path, canon, namer, compr_get_ops(HeaderCacheCompressMethod),
+                        &shared, &per_account);
+  FREE(&canon);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  mutt_debug(3, "%s\n", path);
+#ifdef POSIX_FADV_WILLNEED
+  /* Asynchronous readahead, it doesn't block us */
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+  close(fd);
+}
+
+/**
+ * mutt_hcache_close_all - Close every database kept open between handles
+ */
+void mutt_hcache_close_all(void)
+{
+  while (OpenDatabases)
+  {
+    if (OpenDatabases->refcount > 0)
+      mutt_debug(1, "%s is still in use\n", OpenDatabases->path);
+    hcache_db_free(OpenDatabases);
+  }
 }
 
 /**
@@ -336,28 +988,112 @@ void mutt_hcache_close(header_cache_t *hc)
   if (!hc || !ops)
     return;
 
-  ops->close(&hc->ctx);
+  if (hc->batch)
+    mutt_hcache_commit(hc);
+
+  stats_log(hc);
+  hcache_db_release(hc->db);
   FREE(&hc->folder);
   FREE(&hc);
 }
 
+/**
+ * batch_account - Count a write against the current batch
+ * @param hc  Header cache handle
+ * @param ops Backend operations
+ *
+ * Once #HCACHE_BATCH_SIZE writes have been made, the backend transaction is
+ * committed and a new one started.  This keeps the size of each transaction
+ * bounded, while avoiding a commit per message.
+ *
+ * The writes to a concurrent database are always queued, so they're counted
+ * even outside a batch.
+ */
+static void batch_account(header_cache_t *hc, const struct HcacheOps *ops)
+{
+  if (!hc->batch && !hc->db->concurrent)
+    return;
+
+  if (++hc->pending < HCACHE_BATCH_SIZE)
+    return;
+
+  mutt_debug(3, "committing %u records\n", hc->pending);
+  hc->pending = 0;
+  if (hc->db->concurrent)
+  {
+    hcache_db_flush(hc->db);
+    return;
+  }
+
+  ops->commit(hc->db->ctx);
+  ops->begin(hc->db->ctx);
+}
+
+/**
+ * hcache_upgrade - Rewrite an old record in the current format
+ * @param hc     Header cache handle
+ * @param key    A message identification string
+ * @param keylen The length of the string pointed to by key
+ * @param data   Old record, will be freed
+ * @retval ptr The record, in the current format
+ *
+ * The record keeps its original validity data, e.g. the IMAP UIDVALIDITY.
+ */
+static void *hcache_upgrade(header_cache_t *hc, const char *key, size_t keylen, void *data)
+{
+  struct Email *e = mutt_hcache_restore(data);
+
+  int dlen = 0;
+  unsigned char *upgraded = mutt_hcache_dump(hc, e, &dlen, 0);
+  memcpy(upgraded, data, sizeof(union Validate));
+  mutt_email_free(&e);
+
+  mutt_debug(3, "upgrading %s%s\n", hc->folder, key);
+  int rc = mutt_hcache_store_raw(hc, key, keylen, upgraded, dlen);
+  FREE(&upgraded);
+
+  if (rc != 0)
+    return data;
+
+  mutt_hcache_free(hc, &data);
+  return mutt_hcache_fetch_raw(hc, key, keylen);
+}
+
 /**
  * mutt_hcache_fetch - Multiplexor for HcacheOps::fetch
  */
 void *mutt_hcache_fetch(header_cache_t *hc, const char *key, size_t keylen)
 {
+  mutt_trace_begin("hcache_fetch", NULL);
   void *data = mutt_hcache_fetch_raw(hc, key, keylen);
+  mutt_trace_end("hcache_fetch");
   if (!data)
   {
+    if (hc)
+    {
+      hc->stats.misses++;
+      HcacheTotals.misses++;
+    }
     return NULL;
   }
 
-  if (!crc_matches(data, hc->crc))
+  unsigned int version = 0;
+  if (crc_matches(data, hc->crc))
+    version = mutt_hcache_record_version(data);
+
+  if ((version == 0) || (version > HCACHE_RECORD_VERSION))
   {
+    hc->stats.crc_mismatches++;
+    HcacheTotals.crc_mismatches++;
     mutt_hcache_free(hc, &data);
     return NULL;
   }
 
+  if (version < HCACHE_RECORD_VERSION)
+    data = hcache_upgrade(hc, key, keylen, data);
+
+  hc->stats.hits++;
+  HcacheTotals.hits++;
   return data;
 }
 
@@ -377,7 +1113,36 @@ void *mutt_hcache_fetch_raw(header_cache_t *hc, const char *key, size_t keylen)
 
   keylen = snprintf(path, sizeof(path), "%s%s", hc->folder, key);
 
-  return ops->fetch(hc->ctx, path, keylen);
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  size_t dlen = 0;
+  void *data = hcache_db_fetch(hc->db, path, keylen, &dlen);
+  if (!data || !hc->compr)
+  {
+    stats_fetch(hc, &start, data ? dlen : 0);
+    return data;
+  }
+
+  /* A compressed record is prefixed with the length of the original */
+  void *blob = NULL;
+  unsigned int ulen = 0;
+  if (dlen > sizeof(ulen))
+  {
+    memcpy(&ulen, data, sizeof(ulen));
+    if (ulen <= HCACHE_MAX_RECORD)
+    {
+      blob = hc->compr->decompress((char *) data + sizeof(ulen),
+                                   dlen - sizeof(ulen), ulen);
+    }
+  }
+
+  if (!blob)
+    mutt_debug(1, "can't decompress cache entry: %s\n", path);
+
+  hcache_db_data_free(hc->db, &data);
+  stats_fetch(hc, &start, dlen);
+  return blob;
 }
 
 /**
@@ -390,7 +1155,11 @@ void mutt_hcache_free(header_cache_t *hc, void **data)
   if (!hc || !ops)
     return;
 
-  ops->free(hc->ctx, data);
+  /* Decompressed data belongs to us, not the backend */
+  if (hc->compr)
+    FREE(data);
+  else
+    hcache_db_data_free(hc->db, data);
 }
 
 /**
@@ -435,7 +1204,40 @@ int mutt_hcache_store_raw(header_cache_t *hc, const char *key, size_t keylen,
 
   keylen = snprintf(path, sizeof(path), "%s%s", hc->folder, key);
 
-  return ops->store(hc->ctx, path, keylen, data, dlen);
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  if (!hc->compr)
+  {
+    int rc = hcache_db_store(hc->db, path, keylen, data, dlen);
+    if (rc == 0)
+    {
+      stats_store(hc, &start, dlen);
+      batch_account(hc, ops);
+    }
+    return rc;
+  }
+
+  size_t clen = 0;
+  void *cdata = hc->compr->compress(data, dlen, &clen, HeaderCacheCompressLevel);
+  if (!cdata)
+    return -1;
+
+  unsigned int ulen = dlen;
+  char *record = mutt_mem_malloc(sizeof(ulen) + clen);
+  memcpy(record, &ulen, sizeof(ulen));
+  memcpy(record + sizeof(ulen), cdata, clen);
+  FREE(&cdata);
+
+  int rc = hcache_db_store(hc->db, path, keylen, record, sizeof(ulen) + clen);
+  if (rc == 0)
+  {
+    stats_store(hc, &start, sizeof(ulen) + clen);
+    batch_account(hc, ops);
+  }
+
+  FREE(&record);
+  return rc;
 }
 
 /**
@@ -451,7 +1253,95 @@ int mutt_hcache_delete(header_cache_t *hc, const char *key, size_t keylen)
 
   keylen = snprintf(path, sizeof(path), "%s%s", hc->folder, key);
 
-  return ops->delete (hc->ctx, path, keylen);
+  int rc = hcache_db_delete(hc->db, path, keylen);
+  if (rc == 0)
+    batch_account(hc, ops);
+
+  return rc;
+}
+
+/**
+ * mutt_hcache_begin - Multiplexor for HcacheOps::begin
+ */
+int mutt_hcache_begin(header_cache_t *hc)
+{
+  const struct HcacheOps *ops = hcache_get_ops();
+
+  if (!hc || !ops)
+    return -1;
+
+  if (hc->batch)
+    return 0;
+
+  /* Writes to a concurrent database are queued anyway.  Handles sharing a
+   * database share its transaction too: Kyoto and Tokyo Cabinet wait for
+   * the running transaction to end before starting another one, even in
+   * the same thread. */
+  int rc = 0;
+  if (!hc->db->concurrent && (hc->db->batches == 0))
+    rc = ops->begin(hc->db->ctx);
+  if (rc == 0)
+  {
+    if (!hc->db->concurrent)
+      hc->db->batches++;
+    hc->batch = true;
+    hc->pending = 0;
+  }
+
+  return rc;
+}
+
+/**
+ * mutt_hcache_commit - Multiplexor for HcacheOps::commit
+ */
+int mutt_hcache_commit(header_cache_t *hc)
+{
+  const struct HcacheOps *ops = hcache_get_ops();
+
+  if (!hc || !ops || !hc->batch)
+    return -1;
+
+  hc->batch = false;
+  hc->pending = 0;
+
+  if (!hc->db->concurrent)
+  {
+    /* The transaction ends with the last batch on the database */
+    if (--hc->db->batches > 0)
+      return 0;
+    return ops->commit(hc->db->ctx);
+  }
+
+  int rc = hcache_db_flush(hc->db);
+  hcache_db_drop(hc->db);
+  return rc;
+}
+
+/**
+ * mutt_hcache_stats - Get the usage counters for this session
+ * @retval ptr Counters, totalled over every handle
+ */
+const struct HcacheStats *mutt_hcache_stats(void)
+{
+  return &HcacheTotals;
+}
+
+/**
+ * mutt_hcache_stats_format - Describe a set of usage counters
+ * @param st     Counters
+ * @param buf    Buffer for the result
+ * @param buflen Length of the buffer
+ */
+void mutt_hcache_stats_format(const struct HcacheStats *st, char *buf, size_t buflen)
+{
+  unsigned long lookups = st->hits + st->misses + st->crc_mismatches;
+
+  snprintf(buf, buflen,
+           "%lu hits, %lu misses, %lu crc mismatches (%lu%% hit rate), "
+           "%lu stores, %zu bytes read, %zu bytes written",
+           st->hits, st->misses, st->crc_mismatches,
+           lookups ? (st->hits * 100 / lookups) : 0, st->stores,
+           st->bytes_read, st->bytes_written);
 }
 
 /**
@@ -487,3 +1377,37 @@ bool mutt_hcache_is_valid_backend(const char *s)
 {
   return hcache_get_backend_ops(s);
 }
+
+/**
+ * mutt_hcache_compress_list - Get a list of compression method names
+ * @retval ptr Comma-space-separated list of names
+ *
+ * The caller should free the string.
+ */
+const char *mutt_hcache_compress_list(void)
+{
+  char tmp[STRING] = { 0 };
+  const struct ComprOps **ops = compr_ops;
+  size_t len = 0;
+
+  for (; *ops; ++ops)
+  {
+    if (len != 0)
+    {
+      len += snprintf(tmp + len, STRING - len, ", ");
+    }
+    len += snprintf(tmp + len, STRING - len, "%s", (*ops)->name);
+  }
+
+  return mutt_str_strdup(tmp);
+}
+
+/**
+ * mutt_hcache_is_valid_compression - Is this a valid compression method name?
+ * @param s Name to check
+ * @retval true If valid
+ */
+bool mutt_hcache_is_valid_compression(const char *s)
+{
+  return compr_get_ops(s);
+}
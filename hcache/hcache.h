@@ -52,7 +52,30 @@
 #include <stddef.h>
 #include <sys/time.h>
 
+struct ComprOps;
 struct Email;
+struct HcacheDb;
+
+/* Number of buckets in an HcacheStats latency histogram */
+#define HCACHE_HIST_BUCKETS 16
+
+/**
+ * struct HcacheStats - Header cache usage counters
+ *
+ * Bucket n of a latency histogram counts the operations which took less than
+ * 2^n microseconds.  The last bucket also counts anything slower.
+ */
+struct HcacheStats
+{
+  unsigned long hits;           ///< Valid records found
+  unsigned long misses;         ///< Records not found
+  unsigned long crc_mismatches; ///< Records found, but written by a different version
+  unsigned long stores;         ///< Records written
+  size_t bytes_read;            ///< Bytes fetched from the backend
+  size_t bytes_written;         ///< Bytes handed to the backend
+  unsigned long fetch_hist[HCACHE_HIST_BUCKETS]; ///< Fetch latency histogram
+  unsigned long store_hist[HCACHE_HIST_BUCKETS]; ///< Store latency histogram
+};
 
 /**
  * struct EmailCache - header cache structure
@@ -66,7 +89,11 @@ struct EmailCache
 {
   char *folder;
   unsigned int crc;
-  void *ctx;
+  const struct ComprOps *compr; ///< Compression method, or NULL if none
+  bool batch;           ///< A batch of writes has been started
+  unsigned int pending; ///< Writes made since the batch was last committed
+  struct HcacheDb *db;  ///< Backend database, possibly shared with other handles
+  struct HcacheStats stats; ///< Usage counters for this handle
 };
 
 typedef struct EmailCache header_cache_t;
@@ -90,6 +117,10 @@ union Validate {
 
 /* These Config Variables are only used in hcache/hcache.c */
 extern char *HeaderCacheBackend;
+extern short HeaderCacheCompressLevel;
+extern char *HeaderCacheCompressMethod;
+extern bool HeaderCachePerAccount;
+extern bool HeaderCacheShared;
 
 /**
  * mutt_hcache_open - open the connection to the header cache
@@ -108,6 +139,26 @@ header_cache_t *mutt_hcache_open(const char *path, const char *folder, hcache_na
  */
 void mutt_hcache_close(header_cache_t *hc);
 
+/**
+ * mutt_hcache_close_all - close every database kept open between handles
+ *
+ * This must be called before exiting, so that the backends can write any
+ * buffered data to disk.
+ */
+void mutt_hcache_close_all(void);
+
+/**
+ * mutt_hcache_prefetch - warm up the database of a folder
+ * @param path   Location of the header cache (often as specified by the user)
+ * @param folder Name of the folder containing the messages
+ * @param namer  Optional (might be NULL) client-specific function to form the
+ *               final name of the hcache database file.
+ *
+ * The database file is read into the page cache in the background, so that
+ * opening the folder later doesn't have to wait for the disk.
+ */
+void mutt_hcache_prefetch(const char *path, const char *folder, hcache_namer_t namer);
+
 /**
  * mutt_hcache_fetch - fetch and validate a  message's header from the cache
  * @param hc     Pointer to the header_cache_t structure got by mutt_hcache_open
@@ -192,6 +243,39 @@ int mutt_hcache_store_raw(header_cache_t *hc, const char *key, size_t keylen,
  */
 int mutt_hcache_delete(header_cache_t *hc, const char *key, size_t keylen);
 
+/**
+ * mutt_hcache_begin - start a batch of writes
+ * @param hc Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @retval 0   Success
+ * @retval num Generic or backend-specific error code otherwise
+ *
+ * Until mutt_hcache_commit() or mutt_hcache_close() is called, stores and
+ * deletes are grouped into a small number of backend transactions.
+ */
+int mutt_hcache_begin(header_cache_t *hc);
+
+/**
+ * mutt_hcache_commit - finish a batch of writes
+ * @param hc Pointer to the header_cache_t structure got by mutt_hcache_open
+ * @retval 0   Success
+ * @retval num Generic or backend-specific error code otherwise
+ */
+int mutt_hcache_commit(header_cache_t *hc);
+
+/**
+ * mutt_hcache_stats - get the usage counters for this session
+ * @retval ptr Counters, totalled over every handle
+ */
+const struct HcacheStats *mutt_hcache_stats(void);
+
+/**
+ * mutt_hcache_stats_format - describe a set of usage counters
+ * @param st     Counters
+ * @param buf    Buffer for the result
+ * @param buflen Length of the buffer
+ */
+void mutt_hcache_stats_format(const struct HcacheStats *st, char *buf, size_t buflen);
+
 /**
  * mutt_hcache_backend_list - get a list of backend identification strings
  * @retval ptr Comma separated string describing the compiled-in backends
@@ -208,4 +292,20 @@ const char *mutt_hcache_backend_list(void);
  */
 bool mutt_hcache_is_valid_backend(const char *s);
 
+/**
+ * mutt_hcache_compress_list - get a list of compression method names
+ * @retval ptr Comma separated string describing the compiled-in methods
+ *
+ * @note The returned string must be free'd by the caller
+ */
+const char *mutt_hcache_compress_list(void);
+
+/**
+ * mutt_hcache_is_valid_compression - Is the string a valid compression method
+ * @param s String identifying a compression method
+ * @retval true  s is recognized as a valid method
+ * @retval false otherwise
+ */
+bool mutt_hcache_is_valid_compression(const char *s);
+
 #endif /* MUTT_HCACHE_HCACHE_H */
@@ -32,6 +32,7 @@
 #include "config.h"
 #include <kclangc.h>
 #include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include "mutt/mutt.h"
 #include "backend.h"
@@ -40,10 +41,14 @@
 /**
  * hcache_kyotocabinet_open - Implements HcacheOps::open()
  */
-static void *hcache_kyotocabinet_open(const char *path)
+static void *hcache_kyotocabinet_open(const char *path, int flags)
 {
   char kcdbpath[PATH_MAX];
   int printfresult;
+  uint32_t mode = (flags & HCACHE_OPEN_READONLY) ? KCOREADER : (KCOWRITER | KCOCREATE);
+
+  if (flags & HCACHE_OPEN_NOWAIT)
+    mode |= KCOTRYLOCK;
 
   printfresult = snprintf(kcdbpath, sizeof(kcdbpath), "%s#type=kct#opts=%s#rcomp=lex",
                           path, HeaderCacheCompress ? "lc" : "l");
@@ -56,7 +61,7 @@ static void *hcache_kyotocabinet_open(const char *path)
   if (!db)
     return NULL;
 
-  if (kcdbopen(db, kcdbpath, KCOWRITER | KCOCREATE))
+  if (kcdbopen(db, kcdbpath, mode))
     return db;
   else
   {
@@ -70,15 +75,13 @@ static void *hcache_kyotocabinet_open(const char *path)
 /**
  * hcache_kyotocabinet_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_kyotocabinet_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
-  size_t sp;
-
   if (!ctx)
     return NULL;
 
   KCDB *db = ctx;
-  return kcdbget(db, key, keylen, &sp);
+  return kcdbget(db, key, keylen, dlen);
 }
 
 /**
@@ -125,6 +128,40 @@ static int hcache_kyotocabinet_delete(void *ctx, const char *key, size_t keylen)
   return 0;
 }
 
+/**
+ * hcache_kyotocabinet_begin - Implements HcacheOps::begin()
+ */
+static int hcache_kyotocabinet_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbbegintran(db, false))
+  {
+    int ecode = kcdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
+/**
+ * hcache_kyotocabinet_commit - Implements HcacheOps::commit()
+ */
+static int hcache_kyotocabinet_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  KCDB *db = ctx;
+  if (!kcdbendtran(db, true))
+  {
+    int ecode = kcdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
 /**
  * hcache_kyotocabinet_close - Implements HcacheOps::close()
  */
@@ -32,6 +32,7 @@
 #include "config.h"
 #include <stddef.h>
 #include <lmdb.h>
+#include <stdbool.h>
 #include "mutt/mutt.h"
 #include "backend.h"
 
@@ -118,9 +119,12 @@ static int mdb_get_w_txn(struct HcacheLmdbCtx *ctx)
 /**
  * hcache_lmdb_open - Implements HcacheOps::open()
  */
-static void *hcache_lmdb_open(const char *path)
+static void *hcache_lmdb_open(const char *path, int flags)
 {
   int rc;
+  /* Readers never block in LMDB, and writers queue for a short transaction,
+   * so there is nothing to do for HCACHE_OPEN_NOWAIT */
+  bool readonly = (flags & HCACHE_OPEN_READONLY);
 
   struct HcacheLmdbCtx *ctx = mutt_mem_calloc(1, sizeof(struct HcacheLmdbCtx));
 
@@ -134,7 +138,7 @@ static void *hcache_lmdb_open(const char *path)
 
   mdb_env_set_mapsize(ctx->env, LMDB_DB_SIZE);
 
-  rc = mdb_env_open(ctx->env, path, MDB_NOSUBDIR, 0644);
+  rc = mdb_env_open(ctx->env, path, MDB_NOSUBDIR | (readonly ? MDB_RDONLY : 0), 0644);
   if (rc != MDB_SUCCESS)
   {
     mutt_debug(2, "mdb_env_open: %s\n", mdb_strerror(rc));
@@ -148,7 +152,7 @@ static void *hcache_lmdb_open(const char *path)
     goto fail_env;
   }
 
-  rc = mdb_dbi_open(ctx->txn, NULL, MDB_CREATE, &ctx->db);
+  rc = mdb_dbi_open(ctx->txn, NULL, readonly ? 0 : MDB_CREATE, &ctx->db);
   if (rc != MDB_SUCCESS)
   {
     mutt_debug(2, "mdb_dbi_open: %s\n", mdb_strerror(rc));
@@ -173,7 +177,7 @@ fail_env:
 /**
  * hcache_lmdb_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
+static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen, size_t *dlen)
 {
   MDB_val dkey;
   MDB_val data;
@@ -206,6 +210,7 @@ static void *hcache_lmdb_fetch(void *vctx, const char *key, size_t keylen)
     return NULL;
   }
 
+  *dlen = data.mv_size;
   return data.mv_data;
 }
 
@@ -285,6 +290,40 @@ static int hcache_lmdb_delete(void *vctx, const char *key, size_t keylen)
   return rc;
 }
 
+/**
+ * hcache_lmdb_begin - Implements HcacheOps::begin()
+ */
+static int hcache_lmdb_begin(void *vctx)
+{
+  if (!vctx)
+    return -1;
+
+  return mdb_get_w_txn(vctx);
+}
+
+/**
+ * hcache_lmdb_commit - Implements HcacheOps::commit()
+ */
+static int hcache_lmdb_commit(void *vctx)
+{
+  if (!vctx)
+    return -1;
+
+  struct HcacheLmdbCtx *ctx = vctx;
+
+  if (!ctx->txn || (ctx->txn_mode != TXN_WRITE))
+    return MDB_SUCCESS;
+
+  int rc = mdb_txn_commit(ctx->txn);
+  if (rc != MDB_SUCCESS)
+    mutt_debug(2, "mdb_txn_commit: %s\n", mdb_strerror(rc));
+
+  /* The transaction handle is freed, even if the commit failed */
+  ctx->txn_mode = TXN_UNINITIALIZED;
+  ctx->txn = NULL;
+  return rc;
+}
+
 /**
  * hcache_lmdb_close - Implements HcacheOps::close()
  */
@@ -27,6 +27,21 @@
  * @page hc_serial Email-object serialiser
  *
  * Email-object serialiser
+ *
+ * A record starts with a fixed-size header: the #Validate data and the hcache
+ * CRC, so that they can be checked without decoding the rest.  Everything
+ * after that is compact: counts, lengths and small numbers are stored as
+ * variable-length integers (7 bits per byte, least significant first) and
+ * repeated Address lists within an Envelope are stored only once.
+ *
+ * Every field is written explicitly, so the records don't depend on the
+ * layout of the structs in memory, or on the build options.
+ *
+ * The header is followed by the record's version, #HCACHE_RECORD_VERSION.
+ * When a field is added, bump the version and only read the field from
+ * records that have it; older records stay readable and are upgraded when
+ * they're fetched.  Only a change that makes old records unreadable should
+ * bump #HCACHE_FORMAT, which discards the whole cache.
  */
 
 #include "config.h"
@@ -38,6 +53,7 @@
 #include "mutt/mutt.h"
 #include "email/lib.h"
 #include "hcache.h"
+#include "serialize.h"
 
 /**
  * lazy_malloc - Allocate some memory
@@ -88,6 +104,102 @@ unsigned char *serial_dump_int(unsigned int i, unsigned char *d, int *off)
   return d;
 }
 
+/**
+ * serial_dump_uint - Pack a variable-length integer into a binary blob
+ * @param i   Integer to save
+ * @param d   Binary blob to add to
+ * @param off Offset into the blob
+ * @retval ptr End of the newly packed binary
+ *
+ * Small numbers, e.g. lengths and counts, take a single byte.
+ */
+unsigned char *serial_dump_uint(unsigned int i, unsigned char *d, int *off)
+{
+  lazy_realloc(&d, *off + 5);
+
+  do
+  {
+    unsigned char byte = i & 0x7f;
+    i >>= 7;
+    if (i)
+      byte |= 0x80;
+    d[(*off)++] = byte;
+  } while (i);
+
+  return d;
+}
+
+/**
+ * serial_restore_uint - Unpack a variable-length integer from a binary blob
+ * @param i   Integer to write to
+ * @param d   Binary blob to read from
+ * @param off Offset into the blob
+ */
+void serial_restore_uint(unsigned int *i, const unsigned char *d, int *off)
+{
+  unsigned int value = 0;
+  unsigned char byte;
+  int shift = 0;
+
+  do
+  {
+    byte = d[(*off)++];
+    value |= (unsigned int) (byte & 0x7f) << shift;
+    shift += 7;
+  } while ((byte & 0x80) && (shift < 35));
+
+  *i = value;
+}
+
+/**
+ * serial_dump_long - Pack a signed variable-length integer into a binary blob
+ * @param i   Integer to save
+ * @param d   Binary blob to add to
+ * @param off Offset into the blob
+ * @retval ptr End of the newly packed binary
+ *
+ * The number is zigzag-encoded, so that small negative numbers are small too.
+ */
+unsigned char *serial_dump_long(long long i, unsigned char *d, int *off)
+{
+  unsigned long long z = ((unsigned long long) i << 1) ^ (unsigned long long) (i >> 63);
+
+  lazy_realloc(&d, *off + 10);
+
+  do
+  {
+    unsigned char byte = z & 0x7f;
+    z >>= 7;
+    if (z)
+      byte |= 0x80;
+    d[(*off)++] = byte;
+  } while (z);
+
+  return d;
+}
+
+/**
+ * serial_restore_long - Unpack a signed variable-length integer from a binary blob
+ * @param i   Integer to write to
+ * @param d   Binary blob to read from
+ * @param off Offset into the blob
+ */
+void serial_restore_long(long long *i, const unsigned char *d, int *off)
+{
+  unsigned long long z = 0;
+  unsigned char byte;
+  int shift = 0;
+
+  do
+  {
+    byte = d[(*off)++];
+    z |= (unsigned long long) (byte & 0x7f) << shift;
+    shift += 7;
+  } while ((byte & 0x80) && (shift < 70));
+
+  *i = (long long) (z >> 1) ^ -(long long) (z & 1);
+}
+
 /**
  * serial_restore_int - Unpack an integer from a binary blob
  * @param i   Integer to write to
@@ -117,7 +229,7 @@ unsigned char *serial_dump_char_size(char *c, unsigned char *d, int *off,
   if (!c)
   {
     size = 0;
-    d = serial_dump_int(size, d, off);
+    d = serial_dump_uint(size, d, off);
     return d;
   }
 
@@ -130,7 +242,7 @@ unsigned char *serial_dump_char_size(char *c, unsigned char *d, int *off,
     }
   }
 
-  d = serial_dump_int(size, d, off);
+  d = serial_dump_uint(size, d, off);
   lazy_realloc(&d, *off + size);
   memcpy(d + *off, p, size);
   *off += size;
@@ -164,7 +276,7 @@ unsigned char *serial_dump_char(char *c, unsigned char *d, int *off, bool conver
 void serial_restore_char(char **c, const unsigned char *d, int *off, bool convert)
 {
   unsigned int size;
-  serial_restore_int(&size, d, off);
+  serial_restore_uint(&size, d, off);
 
   if (size == 0)
   {
@@ -172,22 +284,23 @@ void serial_restore_char(char **c, const unsigned char *d, int *off, bool conver
     return;
   }
 
+  /* Examine the string in place, so that the common case costs exactly one
+   * allocation and one copy */
+  const char *src = (const char *) d + *off;
+  *off += size;
+
   *c = mutt_mem_malloc(size);
-  memcpy(*c, d + *off, size);
-  if (convert && !mutt_str_is_ascii(*c, size))
+  memcpy(*c, src, size);
+
+  if (!convert || mutt_str_is_ascii(src, size))
+    return;
+
+  if (mutt_ch_convert_string(c, "utf-8", Charset, 0) != 0)
   {
-    char *tmp = mutt_str_strdup(*c);
-    if (mutt_ch_convert_string(&tmp, "utf-8", Charset, 0) == 0)
-    {
-      FREE(c);
-      *c = tmp;
-    }
-    else
-    {
-      FREE(&tmp);
-    }
+    /* Keep the unconverted string, rather than a partial conversion */
+    mutt_mem_realloc(c, size);
+    memcpy(*c, src, size);
   }
-  *off += size;
 }
 
 /**
@@ -201,21 +314,20 @@ void serial_restore_char(char **c, const unsigned char *d, int *off, bool conver
 unsigned char *serial_dump_address(struct Address *a, unsigned char *d, int *off, bool convert)
 {
   unsigned int counter = 0;
-  unsigned int start_off = *off;
 
-  d = serial_dump_int(0xdeadbeef, d, off);
+  for (struct Address *np = a; np; np = np->next)
+    counter++;
+
+  d = serial_dump_uint(counter, d, off);
 
   while (a)
   {
     d = serial_dump_char(a->personal, d, off, convert);
     d = serial_dump_char(a->mailbox, d, off, false);
-    d = serial_dump_int(a->group, d, off);
+    d = serial_dump_uint(a->group, d, off);
     a = a->next;
-    counter++;
   }
 
-  memcpy(d + start_off, &counter, sizeof(int));
-
   return d;
 }
 
@@ -231,15 +343,17 @@ void serial_restore_address(struct Address **a, const unsigned char *d, int *off
   unsigned int counter = 0;
   unsigned int g = 0;
 
-  serial_restore_int(&counter, d, off);
+  serial_restore_uint(&counter, d, off);
 
   while (counter)
   {
     *a = mutt_addr_new();
+    char *mailbox = NULL;
     serial_restore_char(&(*a)->personal, d, off, convert);
-    serial_restore_char(&(*a)->mailbox, d, off, false);
-    serial_restore_int(&g, d, off);
+    serial_restore_char(&mailbox, d, off, false);
+    serial_restore_uint(&g, d, off);
     (*a)->group = g ? true : false;
+    mutt_addr_set_mailbox(*a, mailbox);
     a = &(*a)->next;
     counter--;
   }
@@ -258,18 +372,19 @@ void serial_restore_address(struct Address **a, const unsigned char *d, int *off
 unsigned char *serial_dump_stailq(struct ListHead *l, unsigned char *d, int *off, bool convert)
 {
   unsigned int counter = 0;
-  unsigned int start_off = *off;
-
-  d = serial_dump_int(0xdeadbeef, d, off);
 
   struct ListNode *np = NULL;
   STAILQ_FOREACH(np, l, entries)
   {
-    d = serial_dump_char(np->data, d, off, convert);
     counter++;
   }
 
-  memcpy(d + start_off, &counter, sizeof(int));
+  d = serial_dump_uint(counter, d, off);
+
+  STAILQ_FOREACH(np, l, entries)
+  {
+    d = serial_dump_char(np->data, d, off, convert);
+  }
 
   return d;
 }
@@ -285,7 +400,7 @@ void serial_restore_stailq(struct ListHead *l, const unsigned char *d, int *off,
 {
   unsigned int counter;
 
-  serial_restore_int(&counter, d, off);
+  serial_restore_uint(&counter, d, off);
 
   struct ListNode *np = NULL;
   while (counter)
@@ -308,16 +423,16 @@ unsigned char *serial_dump_buffer(struct Buffer *b, unsigned char *d, int *off,
 {
   if (!b)
   {
-    d = serial_dump_int(0, d, off);
+    d = serial_dump_uint(0, d, off);
     return d;
   }
   else
-    d = serial_dump_int(1, d, off);
+    d = serial_dump_uint(1, d, off);
 
   d = serial_dump_char_size(b->data, d, off, b->dsize + 1, convert);
-  d = serial_dump_int(b->dptr - b->data, d, off);
-  d = serial_dump_int(b->dsize, d, off);
-  d = serial_dump_int(b->destroy, d, off);
+  d = serial_dump_uint(b->dptr - b->data, d, off);
+  d = serial_dump_uint(b->dsize, d, off);
+  d = serial_dump_uint(b->destroy, d, off);
 
   return d;
 }
@@ -333,7 +448,7 @@ void serial_restore_buffer(struct Buffer **b, const unsigned char *d, int *off,
 {
   unsigned int used;
   unsigned int offset;
-  serial_restore_int(&used, d, off);
+  serial_restore_uint(&used, d, off);
   if (!used)
   {
     return;
@@ -342,11 +457,11 @@ void serial_restore_buffer(struct Buffer **b, const unsigned char *d, int *off,
   *b = mutt_mem_malloc(sizeof(struct Buffer));
 
   serial_restore_char(&(*b)->data, d, off, convert);
-  serial_restore_int(&offset, d, off);
+  serial_restore_uint(&offset, d, off);
   (*b)->dptr = (*b)->data + offset;
-  serial_restore_int(&used, d, off);
+  serial_restore_uint(&used, d, off);
   (*b)->dsize = used;
-  serial_restore_int(&used, d, off);
+  serial_restore_uint(&used, d, off);
   (*b)->destroy = used;
 }
 
@@ -362,19 +477,20 @@ unsigned char *serial_dump_parameter(struct ParameterList *p, unsigned char *d,
                                      int *off, bool convert)
 {
   unsigned int counter = 0;
-  unsigned int start_off = *off;
-
-  d = serial_dump_int(0xdeadbeef, d, off);
 
   struct Parameter *np = NULL;
   TAILQ_FOREACH(np, p, entries)
   {
-    d = serial_dump_char(np->attribute, d, off, false);
-    d = serial_dump_char(np->value, d, off, convert);
     counter++;
   }
 
-  memcpy(d + start_off, &counter, sizeof(int));
+  d = serial_dump_uint(counter, d, off);
+
+  TAILQ_FOREACH(np, p, entries)
+  {
+    d = serial_dump_char(np->attribute, d, off, false);
+    d = serial_dump_char(np->value, d, off, convert);
+  }
 
   return d;
 }
@@ -391,7 +507,7 @@ void serial_restore_parameter(struct ParameterList *p, const unsigned char *d,
 {
   unsigned int counter;
 
-  serial_restore_int(&counter, d, off);
+  serial_restore_uint(&counter, d, off);
 
   struct Parameter *np = NULL;
   while (counter)
@@ -414,31 +530,33 @@ void serial_restore_parameter(struct ParameterList *p, const unsigned char *d,
  */
 unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool convert)
 {
-  struct Body nb;
-
-  memcpy(&nb, c, sizeof(struct Body));
-
-  /* some fields are not safe to cache */
-  nb.content = NULL;
-  nb.charset = NULL;
-  nb.next = NULL;
-  nb.parts = NULL;
-  nb.email = NULL;
-  nb.aptr = NULL;
-
-  lazy_realloc(&d, *off + sizeof(struct Body));
-  memcpy(d + *off, &nb, sizeof(struct Body));
-  *off += sizeof(struct Body);
-
-  d = serial_dump_char(nb.xtype, d, off, false);
-  d = serial_dump_char(nb.subtype, d, off, false);
-
-  d = serial_dump_parameter(&nb.parameter, d, off, convert);
-
-  d = serial_dump_char(nb.description, d, off, convert);
-  d = serial_dump_char(nb.form_name, d, off, convert);
-  d = serial_dump_char(nb.filename, d, off, convert);
-  d = serial_dump_char(nb.d_filename, d, off, convert);
+  /* The pointers to other parts, and the menu data, are not cached */
+  unsigned int flags = (c->use_disp << 0) | (c->unlink << 1) | (c->tagged << 2) |
+                       (c->deleted << 3) | (c->noconv << 4) |
+                       (c->force_charset << 5) | (c->is_signed_data << 6) |
+                       (c->goodsig << 7) | (c->warnsig << 8) | (c->badsig << 9) |
+                       (c->collapsed << 10) | (c->attach_qualifies << 11);
+
+  d = serial_dump_uint(flags, d, off);
+  d = serial_dump_uint(c->type, d, off);
+  d = serial_dump_uint(c->encoding, d, off);
+  d = serial_dump_uint(c->disposition, d, off);
+  d = serial_dump_long(c->hdr_offset, d, off);
+  d = serial_dump_long(c->offset, d, off);
+  d = serial_dump_long(c->length, d, off);
+  d = serial_dump_long(c->attach_count, d, off);
+  d = serial_dump_long(c->stamp, d, off);
+
+  d = serial_dump_char(c->xtype, d, off, false);
+  d = serial_dump_char(c->subtype, d, off, false);
+  d = serial_dump_char(c->language, d, off, false);
+
+  d = serial_dump_parameter(&c->parameter, d, off, convert);
+
+  d = serial_dump_char(c->description, d, off, convert);
+  d = serial_dump_char(c->form_name, d, off, convert);
+  d = serial_dump_char(c->filename, d, off, convert);
+  d = serial_dump_char(c->d_filename, d, off, convert);
 
   return d;
 }
@@ -452,11 +570,43 @@ unsigned char *serial_dump_body(struct Body *c, unsigned char *d, int *off, bool
  */
 void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool convert)
 {
-  memcpy(c, d + *off, sizeof(struct Body));
-  *off += sizeof(struct Body);
+  unsigned int flags, num;
+  long long big;
+
+  serial_restore_uint(&flags, d, off);
+  c->use_disp = flags & (1 << 0);
+  c->unlink = flags & (1 << 1);
+  c->tagged = flags & (1 << 2);
+  c->deleted = flags & (1 << 3);
+  c->noconv = flags & (1 << 4);
+  c->force_charset = flags & (1 << 5);
+  c->is_signed_data = flags & (1 << 6);
+  c->goodsig = flags & (1 << 7);
+  c->warnsig = flags & (1 << 8);
+  c->badsig = flags & (1 << 9);
+  c->collapsed = flags & (1 << 10);
+  c->attach_qualifies = flags & (1 << 11);
+
+  serial_restore_uint(&num, d, off);
+  c->type = num;
+  serial_restore_uint(&num, d, off);
+  c->encoding = num;
+  serial_restore_uint(&num, d, off);
+  c->disposition = num;
+  serial_restore_long(&big, d, off);
+  c->hdr_offset = big;
+  serial_restore_long(&big, d, off);
+  c->offset = big;
+  serial_restore_long(&big, d, off);
+  c->length = big;
+  serial_restore_long(&big, d, off);
+  c->attach_count = big;
+  serial_restore_long(&big, d, off);
+  c->stamp = big;
 
   serial_restore_char(&c->xtype, d, off, false);
   serial_restore_char(&c->subtype, d, off, false);
+  serial_restore_char(&c->language, d, off, false);
 
   TAILQ_INIT(&c->parameter);
   serial_restore_parameter(&c->parameter, d, off, convert);
@@ -467,6 +617,26 @@ void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool
   serial_restore_char(&c->d_filename, d, off, convert);
 }
 
+/**
+ * address_list_equal - Are two Address lists identical?
+ * @param a First Address list
+ * @param b Second Address list
+ * @retval true The lists would be serialised identically
+ */
+static bool address_list_equal(const struct Address *a, const struct Address *b)
+{
+  for (; a && b; a = a->next, b = b->next)
+  {
+    if ((a->group != b->group) || (mutt_str_strcmp(a->mailbox, b->mailbox) != 0) ||
+        (mutt_str_strcmp(a->personal, b->personal) != 0))
+    {
+      return false;
+    }
+  }
+
+  return !a && !b;
+}
+
 /**
  * serial_dump_envelope - Pack an Envelope into a binary blob
  * @param e       Envelope to pack
@@ -477,22 +647,37 @@ void serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool
  */
 unsigned char *serial_dump_envelope(struct Envelope *e, unsigned char *d, int *off, bool convert)
 {
-  d = serial_dump_address(e->return_path, d, off, convert);
-  d = serial_dump_address(e->from, d, off, convert);
-  d = serial_dump_address(e->to, d, off, convert);
-  d = serial_dump_address(e->cc, d, off, convert);
-  d = serial_dump_address(e->bcc, d, off, convert);
-  d = serial_dump_address(e->sender, d, off, convert);
-  d = serial_dump_address(e->reply_to, d, off, convert);
-  d = serial_dump_address(e->mail_followup_to, d, off, convert);
+  struct Address *lists[] = {
+    e->return_path, e->from,     e->to,       e->cc,
+    e->bcc,         e->sender,   e->reply_to, e->mail_followup_to,
+  };
+
+  for (size_t i = 0; i < mutt_array_size(lists); i++)
+  {
+    /* 0 means a list follows; n means "the same as list n-1" */
+    unsigned int ref = 0;
+    for (size_t j = 0; lists[i] && (j < i); j++)
+    {
+      if (address_list_equal(lists[i], lists[j]))
+      {
+        ref = j + 1;
+        break;
+      }
+    }
+
+    d = serial_dump_uint(ref, d, off);
+    if (ref == 0)
+      d = serial_dump_address(lists[i], d, off, convert);
+  }
 
   d = serial_dump_char(e->list_post, d, off, convert);
   d = serial_dump_char(e->subject, d, off, convert);
 
+  /* 0 means no real_subj, otherwise it's the offset + 1 */
   if (e->real_subj)
-    d = serial_dump_int(e->real_subj - e->subject, d, off);
+    d = serial_dump_uint(e->real_subj - e->subject + 1, d, off);
   else
-    d = serial_dump_int(-1, d, off);
+    d = serial_dump_uint(0, d, off);
 
   d = serial_dump_char(e->message_id, d, off, false);
   d = serial_dump_char(e->supersedes, d, off, false);
@@ -509,6 +694,10 @@ unsigned char *serial_dump_envelope(struct Envelope *e, unsigned char *d, int *o
   d = serial_dump_char(e->xref, d, off, false);
   d = serial_dump_char(e->followup_to, d, off, false);
   d = serial_dump_char(e->x_comment_to, d, off, convert);
+#else
+  /* keep the record readable by builds with NNTP */
+  for (int i = 0; i < 3; i++)
+    d = serial_dump_char(NULL, d, off, false);
 #endif
 
   return d;
@@ -523,23 +712,29 @@ unsigned char *serial_dump_envelope(struct Envelope *e, unsigned char *d, int *o
  */
 void serial_restore_envelope(struct Envelope *e, const unsigned char *d, int *off, bool convert)
 {
-  int real_subj_off;
+  unsigned int real_subj_off;
+  unsigned int ref;
 
-  serial_restore_address(&e->return_path, d, off, convert);
-  serial_restore_address(&e->from, d, off, convert);
-  serial_restore_address(&e->to, d, off, convert);
-  serial_restore_address(&e->cc, d, off, convert);
-  serial_restore_address(&e->bcc, d, off, convert);
-  serial_restore_address(&e->sender, d, off, convert);
-  serial_restore_address(&e->reply_to, d, off, convert);
-  serial_restore_address(&e->mail_followup_to, d, off, convert);
+  struct Address **lists[] = {
+    &e->return_path, &e->from,     &e->to,       &e->cc,
+    &e->bcc,         &e->sender,   &e->reply_to, &e->mail_followup_to,
+  };
+
+  for (size_t i = 0; i < mutt_array_size(lists); i++)
+  {
+    serial_restore_uint(&ref, d, off);
+    if ((ref > 0) && (ref <= i))
+      *lists[i] = mutt_addr_copy_list(*lists[ref - 1], false);
+    else
+      serial_restore_address(lists[i], d, off, convert);
+  }
 
   serial_restore_char(&e->list_post, d, off, convert);
   serial_restore_char(&e->subject, d, off, convert);
-  serial_restore_int((unsigned int *) (&real_subj_off), d, off);
+  serial_restore_uint(&real_subj_off, d, off);
 
-  if (real_subj_off >= 0)
-    e->real_subj = e->subject + real_subj_off;
+  if (real_subj_off > 0)
+    e->real_subj = e->subject + real_subj_off - 1;
   else
     e->real_subj = NULL;
 
@@ -558,9 +753,130 @@ void serial_restore_envelope(struct Envelope *e, const unsigned char *d, int *of
   serial_restore_char(&e->xref, d, off, false);
   serial_restore_char(&e->followup_to, d, off, false);
   serial_restore_char(&e->x_comment_to, d, off, convert);
+#else
+  for (int i = 0; i < 3; i++)
+  {
+    char *skip = NULL;
+    serial_restore_char(&skip, d, off, false);
+    FREE(&skip);
+  }
+#endif
+}
+
+/**
+ * serial_dump_email - Pack the fields of an Email into a binary blob
+ * @param e   Email to pack
+ * @param d   Binary blob to add to
+ * @param off Offset into the blob
+ * @retval ptr End of the newly packed binary
+ *
+ * The Envelope and Body are packed separately.  Flags that only make sense
+ * while the mailbox is open, e.g. tagged, aren't cached.
+ */
+static unsigned char *serial_dump_email(const struct Email *e, unsigned char *d, int *off)
+{
+  unsigned int flags = (e->mime << 0) | (e->flagged << 1) | (e->deleted << 2) |
+                       (e->purge << 3) | (e->quasi_deleted << 4) |
+                       (e->attach_del << 5) | (e->old << 6) | (e->read << 7) |
+                       (e->expired << 8) | (e->superseded << 9) |
+                       (e->replied << 10) | (e->subject_changed << 11) |
+                       (e->display_subject << 12) | (e->active << 13) |
+                       (e->trash << 14) | (e->xlabel_changed << 15) |
+                       (e->zoccident << 16);
+
+  d = serial_dump_uint(flags, d, off);
+  d = serial_dump_uint(e->security, d, off);
+  d = serial_dump_uint(e->zhours, d, off);
+  d = serial_dump_uint(e->zminutes, d, off);
+  d = serial_dump_long(e->date_sent, d, off);
+  d = serial_dump_long(e->received, d, off);
+  d = serial_dump_long(e->offset, d, off);
+  d = serial_dump_long(e->lines, d, off);
+  d = serial_dump_long(e->index, d, off);
+  d = serial_dump_long(e->msgno, d, off);
+  d = serial_dump_long(e->virtual, d, off);
+  d = serial_dump_long(e->score, d, off);
+#ifdef USE_POP
+  d = serial_dump_long(e->refno, d, off);
+#else
+  d = serial_dump_long(0, d, off);
+#endif
+
+  return d;
+}
+
+/**
+ * serial_restore_email - Unpack the fields of an Email from a binary blob
+ * @param e   Store the unpacked fields here
+ * @param d   Binary blob to read from
+ * @param off Offset into the blob
+ */
+static void serial_restore_email(struct Email *e, const unsigned char *d, int *off)
+{
+  unsigned int flags, num;
+  long long big;
+
+  serial_restore_uint(&flags, d, off);
+  e->mime = flags & (1 << 0);
+  e->flagged = flags & (1 << 1);
+  e->deleted = flags & (1 << 2);
+  e->purge = flags & (1 << 3);
+  e->quasi_deleted = flags & (1 << 4);
+  e->attach_del = flags & (1 << 5);
+  e->old = flags & (1 << 6);
+  e->read = flags & (1 << 7);
+  e->expired = flags & (1 << 8);
+  e->superseded = flags & (1 << 9);
+  e->replied = flags & (1 << 10);
+  e->subject_changed = flags & (1 << 11);
+  e->display_subject = flags & (1 << 12);
+  e->active = flags & (1 << 13);
+  e->trash = flags & (1 << 14);
+  e->xlabel_changed = flags & (1 << 15);
+  e->zoccident = flags & (1 << 16);
+
+  serial_restore_uint(&num, d, off);
+  e->security = num;
+  serial_restore_uint(&num, d, off);
+  e->zhours = num;
+  serial_restore_uint(&num, d, off);
+  e->zminutes = num;
+  serial_restore_long(&big, d, off);
+  e->date_sent = big;
+  serial_restore_long(&big, d, off);
+  e->received = big;
+  serial_restore_long(&big, d, off);
+  e->offset = big;
+  serial_restore_long(&big, d, off);
+  e->lines = big;
+  serial_restore_long(&big, d, off);
+  e->index = big;
+  serial_restore_long(&big, d, off);
+  e->msgno = big;
+  serial_restore_long(&big, d, off);
+  e->virtual = big;
+  serial_restore_long(&big, d, off);
+  e->score = big;
+  serial_restore_long(&big, d, off);
+#ifdef USE_POP
+  e->refno = big;
 #endif
 }
 
+/**
+ * mutt_hcache_record_version - Get the version of a record
+ * @param d Binary blob
+ * @retval num Version, see #HCACHE_RECORD_VERSION
+ */
+unsigned int mutt_hcache_record_version(const unsigned char *d)
+{
+  int off = sizeof(union Validate) + sizeof(unsigned int);
+  unsigned int version;
+
+  serial_restore_uint(&version, d, &off);
+  return version;
+}
+
 /**
  * mutt_hcache_dump - Serialise a Header object
  * @param hc          Header cache handle
@@ -574,7 +890,6 @@ void serial_restore_envelope(struct Envelope *e, const unsigned char *d, int *of
  */
 void *mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsigned int uidvalidity)
 {
-  struct Email nh;
   bool convert = !CharsetIsUtf8;
 
   *off = 0;
@@ -591,38 +906,16 @@ void *mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsi
   *off += sizeof(union Validate);
 
   d = serial_dump_int(hc->crc, d, off);
+  d = serial_dump_uint(HCACHE_RECORD_VERSION, d, off);
 
-  lazy_realloc(&d, *off + sizeof(struct Email));
-  memcpy(&nh, e, sizeof(struct Email));
-
-  /* some fields are not safe to cache */
-  nh.tagged = false;
-  nh.changed = false;
-  nh.threaded = false;
-  nh.recip_valid = false;
-  nh.searched = false;
-  nh.matched = false;
-  nh.collapsed = false;
-  nh.limited = false;
-  nh.num_hidden = 0;
-  nh.recipient = 0;
-  nh.pair = 0;
-  nh.attach_valid = false;
-  nh.path = NULL;
-  nh.tree = NULL;
-  nh.thread = NULL;
-  STAILQ_INIT(&nh.tags);
-#ifdef MIXMASTER
-  STAILQ_INIT(&nh.chain);
-#endif
-  nh.data = NULL;
-
-  memcpy(d + *off, &nh, sizeof(struct Email));
-  *off += sizeof(struct Email);
+  d = serial_dump_email(e, d, off);
+  d = serial_dump_envelope(e->env, d, off, convert);
+  d = serial_dump_body(e->content, d, off, convert);
+  d = serial_dump_char(e->maildir_flags, d, off, convert);
 
-  d = serial_dump_envelope(nh.env, d, off, convert);
-  d = serial_dump_body(nh.content, d, off, convert);
-  d = serial_dump_char(nh.maildir_flags, d, off, convert);
+  /* version 2: the attachment count, if it's known */
+  d = serial_dump_uint(e->attach_valid ? e->attach_rules : 0, d, off);
+  d = serial_dump_uint(e->attach_total, d, off);
 
   return d;
 }
@@ -644,13 +937,10 @@ struct Email *mutt_hcache_restore(const unsigned char *d)
   /* skip crc */
   off += sizeof(unsigned int);
 
-  memcpy(e, d + off, sizeof(struct Email));
-  off += sizeof(struct Email);
+  unsigned int version;
+  serial_restore_uint(&version, d, &off);
 
-  STAILQ_INIT(&e->tags);
-#ifdef MIXMASTER
-  STAILQ_INIT(&e->chain);
-#endif
+  serial_restore_email(e, d, &off);
 
   e->env = mutt_env_new();
   serial_restore_envelope(e->env, d, &off, convert);
@@ -660,5 +950,15 @@ struct Email *mutt_hcache_restore(const unsigned char *d)
 
   serial_restore_char(&e->maildir_flags, d, &off, convert);
 
+  if (version >= 2)
+  {
+    unsigned int num;
+    serial_restore_uint(&e->attach_rules, d, &off);
+    serial_restore_uint(&num, d, &off);
+    e->attach_total = num;
+    /* mutt_count_body_parts() checks the rules it was counted with */
+    e->attach_valid = (e->attach_rules != 0);
+  }
+
   return e;
 }
@@ -30,6 +30,14 @@
 #include <sys/types.h>
 #include "hcache.h"
 
+/* Version of the records written by mutt_hcache_dump().  Older records can
+ * still be read, and are upgraded when they're fetched. */
+#define HCACHE_RECORD_VERSION 2
+
+/* Records written with a different format can't be read, at all.  Changing
+ * this discards every header cache. */
+#define HCACHE_FORMAT 4
+
 struct Address;
 struct Body;
 struct Buffer;
@@ -45,8 +53,10 @@ unsigned char *serial_dump_char(char *c, unsigned char *d, int *off, bool conver
 unsigned char *serial_dump_char_size(char *c, unsigned char *d, int *off, ssize_t size, bool convert);
 unsigned char *serial_dump_envelope(struct Envelope *e, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_int(unsigned int i, unsigned char *d, int *off);
+unsigned char *serial_dump_long(long long i, unsigned char *d, int *off);
 unsigned char *serial_dump_parameter(struct ParameterList *p, unsigned char *d, int *off, bool convert);
 unsigned char *serial_dump_stailq(struct ListHead *l, unsigned char *d, int *off, bool convert);
+unsigned char *serial_dump_uint(unsigned int i, unsigned char *d, int *off);
 
 void           serial_restore_address(struct Address **a, const unsigned char *d, int *off, bool convert);
 void           serial_restore_body(struct Body *c, const unsigned char *d, int *off, bool convert);
@@ -54,10 +64,13 @@ void           serial_restore_buffer(struct Buffer **b, const unsigned char *d,
 void           serial_restore_char(char **c, const unsigned char *d, int *off, bool convert);
 void           serial_restore_envelope(struct Envelope *e, const unsigned char *d, int *off, bool convert);
 void           serial_restore_int(unsigned int *i, const unsigned char *d, int *off);
+void           serial_restore_long(long long *i, const unsigned char *d, int *off);
 void           serial_restore_parameter(struct ParameterList *p, const unsigned char *d, int *off, bool convert);
 void           serial_restore_stailq(struct ListHead *l, const unsigned char *d, int *off, bool convert);
+void           serial_restore_uint(unsigned int *i, const unsigned char *d, int *off);
 
 void *        mutt_hcache_dump(header_cache_t *hc, const struct Email *e, int *off, unsigned int uidvalidity);
 struct Email *mutt_hcache_restore(const unsigned char *d);
+unsigned int  mutt_hcache_record_version(const unsigned char *d);
 
 #endif /* MUTT_HCACHE_SERIALIZE_H */
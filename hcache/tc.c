@@ -40,14 +40,19 @@
 /**
  * hcache_tokyocabinet_open - Implements HcacheOps::open()
  */
-static void *hcache_tokyocabinet_open(const char *path)
+static void *hcache_tokyocabinet_open(const char *path, int flags)
 {
+  int omode = (flags & HCACHE_OPEN_READONLY) ? BDBOREADER : (BDBOWRITER | BDBOCREAT);
+
+  if (flags & HCACHE_OPEN_NOWAIT)
+    omode |= BDBOLCKNB;
+
   TCBDB *db = tcbdbnew();
   if (!db)
     return NULL;
   if (HeaderCacheCompress)
     tcbdbtune(db, 0, 0, 0, -1, -1, BDBTDEFLATE);
-  if (tcbdbopen(db, path, BDBOWRITER | BDBOCREAT))
+  if (tcbdbopen(db, path, omode))
     return db;
   else
   {
@@ -62,15 +67,17 @@ static void *hcache_tokyocabinet_open(const char *path)
 /**
  * hcache_tokyocabinet_fetch - Implements HcacheOps::fetch()
  */
-static void *hcache_tokyocabinet_fetch(void *ctx, const char *key, size_t keylen)
+static void *hcache_tokyocabinet_fetch(void *ctx, const char *key, size_t keylen, size_t *dlen)
 {
-  int sp;
+  int sp = 0;
 
   if (!ctx)
     return NULL;
 
   TCBDB *db = ctx;
-  return tcbdbget(db, key, keylen, &sp);
+  void *data = tcbdbget(db, key, keylen, &sp);
+  *dlen = sp;
+  return data;
 }
 
 /**
@@ -116,6 +123,40 @@ static int hcache_tokyocabinet_delete(void *ctx, const char *key, size_t keylen)
   return 0;
 }
 
+/**
+ * hcache_tokyocabinet_begin - Implements HcacheOps::begin()
+ */
+static int hcache_tokyocabinet_begin(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  TCBDB *db = ctx;
+  if (!tcbdbtranbegin(db))
+  {
+    int ecode = tcbdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
+/**
+ * hcache_tokyocabinet_commit - Implements HcacheOps::commit()
+ */
+static int hcache_tokyocabinet_commit(void *ctx)
+{
+  if (!ctx)
+    return -1;
+
+  TCBDB *db = ctx;
+  if (!tcbdbtrancommit(db))
+  {
+    int ecode = tcbdbecode(db);
+    return ecode ? ecode : -1;
+  }
+  return 0;
+}
+
 /**
  * hcache_tokyocabinet_close - Implements HcacheOps::close()
  */
@@ -23,6 +23,9 @@
  */
 
 #include "config.h"
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 #include <locale.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -71,6 +74,59 @@ enum FlagChars
   FlagCharZEmpty
 };
 
+/* Flags stored in ListCache */
+#define LIST_MAIL_KNOWN (1 << 0) /**< LIST_MAIL is valid */
+#define LIST_MAIL       (1 << 1) /**< Address is a mailing list */
+#define LIST_SUB_KNOWN  (1 << 2) /**< LIST_SUB is valid */
+#define LIST_SUB        (1 << 3) /**< Address is a subscribed mailing list */
+
+#define LIST_CACHE_MAX 8192 /**< Forget the cached results beyond this many addresses */
+
+/* The results of matching addresses against the (un)lists and (un)subscribe
+ * regexes, keyed by mailbox.  The regexes are all case-insensitive. */
+static struct Hash *ListCache = NULL;
+
+#ifdef USE_THREADS
+/* ~l and ~u may be tested by several threads at once */
+static pthread_mutex_t ListCacheLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * list_cache_get - Get the cached (un)lists/(un)subscribe results for a mailbox
+ * @param mailbox Mailbox to look up
+ * @retval ptr HashElem whose data holds the LIST_* flags
+ *
+ * The lock must be held while the HashElem is used.
+ */
+static struct HashElem *list_cache_get(const char *mailbox)
+{
+  if (ListCache && (ListCache->count >= LIST_CACHE_MAX))
+    mutt_hash_destroy(&ListCache);
+  if (!ListCache)
+    ListCache = mutt_hash_create(1024, MUTT_HASH_STRCASECMP | MUTT_HASH_STRDUP_KEYS);
+
+  struct HashElem *he = mutt_hash_find_elem(ListCache, mailbox);
+  if (!he)
+    he = mutt_hash_insert(ListCache, mailbox, NULL);
+  return he;
+}
+
+/**
+ * mutt_list_cache_flush - Forget the cached mailing list matches
+ *
+ * Called when the (un)lists or (un)subscribe commands change the lists.
+ */
+void mutt_list_cache_flush(void)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&ListCacheLock);
+#endif
+  mutt_hash_destroy(&ListCache);
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&ListCacheLock);
+#endif
+}
+
 /**
  * mutt_is_mail_list - Is this the email address of a mailing list?
  * @param addr Address to test
@@ -78,9 +134,29 @@ enum FlagChars
  */
 bool mutt_is_mail_list(struct Address *addr)
 {
-  if (!mutt_regexlist_match(&UnMailLists, addr->mailbox))
-    return mutt_regexlist_match(&MailLists, addr->mailbox);
-  return false;
+  if (!addr->mailbox)
+    return false;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&ListCacheLock);
+#endif
+  struct HashElem *he = list_cache_get(addr->mailbox);
+  intptr_t flags = (intptr_t) he->data;
+  if (!(flags & LIST_MAIL_KNOWN))
+  {
+    flags |= LIST_MAIL_KNOWN;
+    if (!mutt_regexlist_match(&UnMailLists, addr->mailbox) &&
+        mutt_regexlist_match(&MailLists, addr->mailbox))
+    {
+      flags |= LIST_MAIL;
+    }
+    he->data = (void *) flags;
+  }
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&ListCacheLock);
+#endif
+
+  return flags & LIST_MAIL;
 }
 
 /**
@@ -90,61 +166,87 @@ bool mutt_is_mail_list(struct Address *addr)
  */
 bool mutt_is_subscribed_list(struct Address *addr)
 {
-  if (!mutt_regexlist_match(&UnMailLists, addr->mailbox) &&
-      !mutt_regexlist_match(&UnSubscribedLists, addr->mailbox))
+  if (!addr->mailbox)
+    return false;
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&ListCacheLock);
+#endif
+  struct HashElem *he = list_cache_get(addr->mailbox);
+  intptr_t flags = (intptr_t) he->data;
+  if (!(flags & LIST_SUB_KNOWN))
   {
-    return mutt_regexlist_match(&SubscribedLists, addr->mailbox);
+    flags |= LIST_SUB_KNOWN;
+    if (!mutt_regexlist_match(&UnMailLists, addr->mailbox) &&
+        !mutt_regexlist_match(&UnSubscribedLists, addr->mailbox) &&
+        mutt_regexlist_match(&SubscribedLists, addr->mailbox))
+    {
+      flags |= LIST_SUB;
+    }
+    he->data = (void *) flags;
   }
-  return false;
+#ifdef USE_THREADS
+  pthread_mutex_unlock(&ListCacheLock);
+#endif
+
+  return flags & LIST_SUB;
 }
 
 /**
- * check_for_mailing_list - Search list of addresses for a mailing list
- * @param addr    List of addreses to search
- * @param pfx     Prefix string
- * @param buf     Buffer to store results
- * @param buflen  Buffer length
- * @retval 1 Mailing list found
- * @retval 0 No list found
+ * subscribed_list - Find the first subscribed mailing list in To, then Cc
+ * @param[in]  env Envelope of the email
+ * @param[out] cc  Set to true if the list is in Cc, may be NULL
+ * @retval ptr  Address of the mailing list
+ * @retval NULL No subscribed list found
  *
- * Search for a mailing list in the list of addresses pointed to by addr.
- * If one is found, print pfx and the name of the list into buf.
+ * The position of the list is cached in the Envelope, so redrawing the index
+ * doesn't match the $subscribe regexes again.  The cache is cleared when the
+ * lists change.
  */
-static bool check_for_mailing_list(struct Address *addr, const char *pfx, char *buf, int buflen)
+static struct Address *subscribed_list(struct Envelope *env, bool *cc)
 {
-  for (; addr; addr = addr->next)
+  struct Address *a = NULL;
+  int pos;
+
+  if (!env->list_valid)
   {
-    if (mutt_is_subscribed_list(addr))
+    env->list_pos = 0;
+    pos = 1;
+    for (a = env->to; a && !env->list_pos; a = a->next, pos++)
+      if (mutt_is_subscribed_list(a))
+        env->list_pos = pos;
+    for (a = env->cc; a && !env->list_pos; a = a->next, pos++)
+      if (mutt_is_subscribed_list(a))
+        env->list_pos = pos;
+    env->list_valid = true;
+  }
+
+  if (env->list_pos == 0)
+    return NULL;
+
+  pos = 1;
+  for (a = env->to; a; a = a->next, pos++)
+  {
+    if (pos == env->list_pos)
     {
-      if (pfx && buf && buflen)
-        snprintf(buf, buflen, "%s%s", pfx, mutt_get_name(addr));
-      return true;
+      if (cc)
+        *cc = false;
+      return a;
     }
   }
-  return false;
-}
-
-/**
- * check_for_mailing_list_addr - Check an address list for a mailing list
- * @param addr   Address list
- * @param buf    Buffer for the result
- * @param buflen Length of buffer
- * @retval true Mailing list found
- *
- * If one is found, print the address of the list into buf.
- */
-static bool check_for_mailing_list_addr(struct Address *addr, char *buf, int buflen)
-{
-  for (; addr; addr = addr->next)
+  for (a = env->cc; a; a = a->next, pos++)
   {
-    if (mutt_is_subscribed_list(addr))
+    if (pos == env->list_pos)
     {
-      if (buf && buflen)
-        snprintf(buf, buflen, "%s", addr->mailbox);
-      return true;
+      if (cc)
+        *cc = true;
+      return a;
     }
   }
-  return false;
+
+  /* the addresses have changed under us */
+  env->list_valid = false;
+  return subscribed_list(env, cc);
 }
 
 /**
@@ -294,10 +396,14 @@ static void make_from(struct Envelope *env, char *buf, size_t buflen,
 
   if (do_lists || me)
   {
-    if (check_for_mailing_list(env->to, make_from_prefix(DISP_TO), buf, buflen))
-      return;
-    if (check_for_mailing_list(env->cc, make_from_prefix(DISP_CC), buf, buflen))
+    bool cc = false;
+    struct Address *list = subscribed_list(env, &cc);
+    if (list)
+    {
+      snprintf(buf, buflen, "%s%s", make_from_prefix(cc ? DISP_CC : DISP_TO),
+               mutt_get_name(list));
       return;
+    }
   }
 
   if (me && env->to)
@@ -345,10 +451,12 @@ static void make_from_addr(struct Envelope *hdr, char *buf, size_t buflen, bool
 
   if (do_lists || me)
   {
-    if (check_for_mailing_list_addr(hdr->to, buf, buflen))
-      return;
-    if (check_for_mailing_list_addr(hdr->cc, buf, buflen))
+    struct Address *list = subscribed_list(hdr, NULL);
+    if (list)
+    {
+      snprintf(buf, buflen, "%s", list->mailbox);
       return;
+    }
   }
 
   if (me && hdr->to)
@@ -407,9 +515,7 @@ static int user_is_recipient(struct Email *e)
     }
     else if (user_in_addr(env->cc))
       e->recipient = 3;
-    else if (check_for_mailing_list(env->to, NULL, NULL, 0))
-      e->recipient = 5;
-    else if (check_for_mailing_list(env->cc, NULL, NULL, 0))
+    else if (subscribed_list(env, NULL))
       e->recipient = 5;
     else if (user_in_addr(env->reply_to))
       e->recipient = 6;
@@ -866,17 +972,18 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
       break;
 
     case 'g':
-      tags = driver_tags_get_transformed(&e->tags);
+    {
+      const char *disp = driver_tags_display(&e->tags);
       if (!optional)
       {
         colorlen = add_index_color(buf, buflen, flags, MT_COLOR_INDEX_TAGS);
-        mutt_format_s(buf + colorlen, buflen - colorlen, prec, NONULL(tags));
+        mutt_format_s(buf + colorlen, buflen - colorlen, prec, NONULL(disp));
         add_index_color(buf + colorlen, buflen - colorlen, flags, MT_COLOR_INDEX);
       }
-      else if (!tags)
+      else if (!disp)
         optional = 0;
-      FREE(&tags);
       break;
+    }
 
     case 'G':
     {
@@ -934,25 +1041,24 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
       break;
 
     case 'J':
-      tags = driver_tags_get_transformed(&e->tags);
-      if (tags)
+    {
+      const char *disp = driver_tags_display(&e->tags);
+      if (disp)
       {
         i = 1; /* reduce reuse recycle */
         if (flags & MUTT_FORMAT_TREE)
         {
-          char *parent_tags = NULL;
+          const char *parent_tags = NULL;
           if (e->thread->prev && e->thread->prev->message)
           {
-            parent_tags = driver_tags_get_transformed(&e->thread->prev->message->tags);
+            parent_tags = driver_tags_display(&e->thread->prev->message->tags);
           }
           if (!parent_tags && e->thread->parent && e->thread->parent->message)
           {
-            parent_tags =
-                driver_tags_get_transformed(&e->thread->parent->message->tags);
+            parent_tags = driver_tags_display(&e->thread->parent->message->tags);
           }
-          if (parent_tags && mutt_str_strcasecmp(tags, parent_tags) == 0)
+          if (parent_tags && mutt_str_strcasecmp(disp, parent_tags) == 0)
             i = 0;
-          FREE(&parent_tags);
         }
       }
       else
@@ -963,12 +1069,12 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
 
       colorlen = add_index_color(buf, buflen, flags, MT_COLOR_INDEX_TAGS);
       if (i)
-        mutt_format_s(buf + colorlen, buflen - colorlen, prec, tags);
+        mutt_format_s(buf + colorlen, buflen - colorlen, prec, disp);
       else
         mutt_format_s(buf + colorlen, buflen - colorlen, prec, "");
       add_index_color(buf + colorlen, buflen - colorlen, flags, MT_COLOR_INDEX);
-      FREE(&tags);
       break;
+    }
 
     case 'l':
       if (!optional)
@@ -990,8 +1096,7 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
         mutt_format_s(buf + colorlen, buflen - colorlen, prec, tmp);
         add_index_color(buf + colorlen, buflen - colorlen, flags, MT_COLOR_INDEX);
       }
-      else if (!check_for_mailing_list(e->env->to, NULL, NULL, 0) &&
-               !check_for_mailing_list(e->env->cc, NULL, NULL, 0))
+      else if (!subscribed_list(e->env, NULL))
       {
         optional = 0;
       }
@@ -1060,8 +1165,7 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
           *p = 0;
         mutt_format_s(buf, buflen, prec, tmp);
       }
-      else if (!check_for_mailing_list_addr(e->env->to, NULL, 0) &&
-               !check_for_mailing_list_addr(e->env->cc, NULL, 0))
+      else if (!subscribed_list(e->env, NULL))
       {
         optional = 0;
       }
@@ -1149,9 +1253,13 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
       break;
 
     case 't':
+    {
+      bool cc = false;
+      struct Address *list = subscribed_list(e->env, &cc);
       tmp[0] = 0;
-      if (!check_for_mailing_list(e->env->to, "To ", tmp, sizeof(tmp)) &&
-          !check_for_mailing_list(e->env->cc, "Cc ", tmp, sizeof(tmp)))
+      if (list)
+        snprintf(tmp, sizeof(tmp), "%s%s", cc ? "Cc " : "To ", mutt_get_name(list));
+      else
       {
         if (e->env->to)
           snprintf(tmp, sizeof(tmp), "To %s", mutt_get_name(e->env->to));
@@ -1160,6 +1268,7 @@ static const char *index_format_str(char *buf, size_t buflen, size_t col, int co
       }
       mutt_format_s(buf, buflen, prec, tmp);
       break;
+    }
 
     case 'T':
       snprintf(fmt, sizeof(fmt), "%%%ss", prec);
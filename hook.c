@@ -68,7 +68,87 @@ struct Hook
 };
 static TAILQ_HEAD(, Hook) Hooks = TAILQ_HEAD_INITIALIZER(Hooks);
 
+/**
+ * struct HookList - The Hooks of a single type, in the order they were defined
+ */
+struct HookList
+{
+  struct Hook **hooks; /**< Hooks of this type */
+  size_t num;          /**< Number of Hooks in the list */
+  size_t max;          /**< Size of the hooks array */
+};
+
+#define HOOK_TYPES 18 /**< Number of hook types, excluding #MUTT_GLOBAL_HOOK */
+
+/* One list per hook type, indexed by the type's bit number */
+static struct HookList HooksByType[HOOK_TYPES];
+
 static int current_hook_type = 0;
+static struct Context *current_hook_ctx = NULL;
+static struct Email *current_hook_email = NULL;
+
+/**
+ * hook_list - Get the list of Hooks of one type
+ * @param type Hook type, e.g. #MUTT_FOLDER_HOOK
+ * @retval ptr List of Hooks
+ *
+ * If type has several bits set, the lowest one is used.
+ */
+static struct HookList *hook_list(int type)
+{
+  int i = 0;
+
+  type &= ~MUTT_GLOBAL_HOOK;
+  while ((i < (HOOK_TYPES - 1)) && !(type & (1 << i)))
+    i++;
+
+  return &HooksByType[i];
+}
+
+/**
+ * hook_list_add - Add a Hook to the lists of all its types
+ * @param h Hook to add
+ */
+static void hook_list_add(struct Hook *h)
+{
+  for (int i = 0; i < HOOK_TYPES; i++)
+  {
+    if (!(h->type & (1 << i)))
+      continue;
+
+    struct HookList *hl = &HooksByType[i];
+    if (hl->num == hl->max)
+    {
+      hl->max = hl->max ? (hl->max * 2) : 16;
+      mutt_mem_realloc(&hl->hooks, hl->max * sizeof(struct Hook *));
+    }
+    hl->hooks[hl->num++] = h;
+  }
+}
+
+/**
+ * hook_list_remove - Remove Hooks from the lists of their types
+ * @param type Hook type to remove, e.g. #MUTT_SEND_HOOK
+ *
+ * If 0 is passed, all the lists will be emptied.
+ */
+static void hook_list_remove(int type)
+{
+  for (int i = 0; i < HOOK_TYPES; i++)
+  {
+    if (type && !(type & (1 << i)))
+      continue;
+
+    struct HookList *hl = &HooksByType[i];
+    size_t num = 0;
+    for (size_t j = 0; j < hl->num; j++)
+    {
+      if (type && (hl->hooks[j]->type != type))
+        hl->hooks[num++] = hl->hooks[j];
+    }
+    hl->num = num;
+  }
+}
 
 /**
  * mutt_parse_hook - Parse the 'hook' family of commands - Implements ::command_t
@@ -187,9 +267,9 @@ int mutt_parse_hook(struct Buffer *buf, struct Buffer *s, unsigned long data,
   }
 
   /* check to make sure that a matching hook doesn't already exist */
-  TAILQ_FOREACH(ptr, &Hooks, entries)
+  if (data & MUTT_GLOBAL_HOOK)
   {
-    if (data & MUTT_GLOBAL_HOOK)
+    TAILQ_FOREACH(ptr, &Hooks, entries)
     {
       /* Ignore duplicate global hooks */
       if (mutt_str_strcmp(ptr->command, command.data) == 0)
@@ -198,8 +278,15 @@ int mutt_parse_hook(struct Buffer *buf, struct Buffer *s, unsigned long data,
         return 0;
       }
     }
-    else if (ptr->type == data &&
-             ptr->regex.not == not&&(mutt_str_strcmp(pattern.data, ptr->regex.pattern) == 0))
+  }
+
+  /* Only the hooks of the same type can match */
+  struct HookList *hl = hook_list(data);
+  for (size_t i = 0; (~data & MUTT_GLOBAL_HOOK) && (i < hl->num); i++)
+  {
+    ptr = hl->hooks[i];
+    if (ptr->type == data &&
+        ptr->regex.not == not&&(mutt_str_strcmp(pattern.data, ptr->regex.pattern) == 0))
     {
       if (data & (MUTT_FOLDER_HOOK | MUTT_SEND_HOOK | MUTT_SEND2_HOOK | MUTT_MESSAGE_HOOK |
                   MUTT_ACCOUNT_HOOK | MUTT_REPLY_HOOK | MUTT_CRYPT_HOOK |
@@ -270,6 +357,7 @@ int mutt_parse_hook(struct Buffer *buf, struct Buffer *s, unsigned long data,
   ptr->regex.regex = rx;
   ptr->regex.not = not;
   TAILQ_INSERT_TAIL(&Hooks, ptr, entries);
+  hook_list_add(ptr);
   return 0;
 
 error:
@@ -306,6 +394,7 @@ void mutt_delete_hooks(int type)
   struct Hook *h = NULL;
   struct Hook *tmp = NULL;
 
+  hook_list_remove(type);
   TAILQ_FOREACH_SAFE(h, &Hooks, entries, tmp)
   {
     if (type == 0 || type == h->type)
@@ -376,8 +465,11 @@ void mutt_folder_hook(const char *path)
   err.dsize = STRING;
   err.data = mutt_mem_malloc(err.dsize);
   mutt_buffer_init(&token);
-  TAILQ_FOREACH(tmp, &Hooks, entries)
+  cs_batch_begin(Config);
+  struct HookList *hl = hook_list(MUTT_FOLDER_HOOK);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    tmp = hl->hooks[i];
     if (!tmp->command)
       continue;
 
@@ -388,15 +480,12 @@ void mutt_folder_hook(const char *path)
         if (mutt_parse_rc_line(tmp->command, &token, &err) == -1)
         {
           mutt_error("%s", err.data);
-          FREE(&token.data);
-          current_hook_type = 0;
-          FREE(&err.data);
-
-          return;
+          break;
         }
       }
     }
   }
+  cs_batch_end(Config);
   FREE(&token.data);
   FREE(&err.data);
 
@@ -413,10 +502,11 @@ void mutt_folder_hook(const char *path)
  */
 char *mutt_find_hook(int type, const char *pat)
 {
-  struct Hook *tmp = NULL;
+  struct HookList *hl = hook_list(type);
 
-  TAILQ_FOREACH(tmp, &Hooks, entries)
+  for (size_t i = 0; i < hl->num; i++)
   {
+    struct Hook *tmp = hl->hooks[i];
     if (tmp->type & type)
     {
       if (regexec(tmp->regex.regex, pat, 0, NULL, 0) == 0)
@@ -437,15 +527,22 @@ void mutt_message_hook(struct Context *ctx, struct Email *e, int type)
   struct Buffer err, token;
   struct Hook *hook = NULL;
   struct PatternCache cache = { 0 };
+  struct Context *prev_ctx = current_hook_ctx;
+  struct Email *prev_email = current_hook_email;
 
   current_hook_type = type;
+  current_hook_ctx = ctx;
+  current_hook_email = e;
 
   mutt_buffer_init(&err);
   err.dsize = STRING;
   err.data = mutt_mem_malloc(err.dsize);
   mutt_buffer_init(&token);
-  TAILQ_FOREACH(hook, &Hooks, entries)
+  cs_batch_begin(Config);
+  struct HookList *hl = hook_list(type);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    hook = hl->hooks[i];
     if (!hook->command)
       continue;
 
@@ -456,12 +553,8 @@ void mutt_message_hook(struct Context *ctx, struct Email *e, int type)
       {
         if (mutt_parse_rc_line(hook->command, &token, &err) == -1)
         {
-          FREE(&token.data);
           mutt_error("%s", err.data);
-          current_hook_type = 0;
-          FREE(&err.data);
-
-          return;
+          break;
         }
         /* Executing arbitrary commands could affect the pattern results,
          * so the cache has to be wiped */
@@ -469,10 +562,26 @@ void mutt_message_hook(struct Context *ctx, struct Email *e, int type)
       }
     }
   }
+  cs_batch_end(Config);
   FREE(&token.data);
   FREE(&err.data);
 
   current_hook_type = 0;
+  current_hook_ctx = prev_ctx;
+  current_hook_email = prev_email;
+}
+
+/**
+ * mutt_hook_email - Get the Email a message hook is running for
+ * @param[out] ctx Mailbox of the Email (OPTIONAL)
+ * @retval ptr  Email being processed by mutt_message_hook()
+ * @retval NULL No message hook is running
+ */
+struct Email *mutt_hook_email(struct Context **ctx)
+{
+  if (ctx)
+    *ctx = current_hook_ctx;
+  return current_hook_email;
 }
 
 /**
@@ -492,8 +601,10 @@ static int addr_hook(char *path, size_t pathlen, int type, struct Context *ctx,
   struct PatternCache cache = { 0 };
 
   /* determine if a matching hook exists */
-  TAILQ_FOREACH(hook, &Hooks, entries)
+  struct HookList *hl = hook_list(type);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    hook = hl->hooks[i];
     if (!hook->command)
       continue;
 
@@ -579,10 +690,11 @@ void mutt_select_fcc(char *path, size_t pathlen, struct Email *e)
  */
 static void list_hook(struct ListHead *matches, const char *match, int hook)
 {
-  struct Hook *tmp = NULL;
+  struct HookList *hl = hook_list(hook);
 
-  TAILQ_FOREACH(tmp, &Hooks, entries)
+  for (size_t i = 0; i < hl->num; i++)
   {
+    struct Hook *tmp = hl->hooks[i];
     if ((tmp->type & hook) && ((match && regexec(tmp->regex.regex, match, 0, NULL, 0) == 0) ^
                                tmp->regex.not))
     {
@@ -627,8 +739,10 @@ void mutt_account_hook(const char *url)
   err.data = mutt_mem_malloc(err.dsize);
   mutt_buffer_init(&token);
 
-  TAILQ_FOREACH(hook, &Hooks, entries)
+  struct HookList *hl = hook_list(MUTT_ACCOUNT_HOOK);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    hook = hl->hooks[i];
     if (!(hook->command && (hook->type & MUTT_ACCOUNT_HOOK)))
       continue;
 
@@ -673,8 +787,10 @@ void mutt_timeout_hook(void)
   err.dsize = sizeof(buf);
   mutt_buffer_init(&token);
 
-  TAILQ_FOREACH(hook, &Hooks, entries)
+  struct HookList *hl = hook_list(MUTT_TIMEOUT_HOOK);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    hook = hl->hooks[i];
     if (!(hook->command && (hook->type & MUTT_TIMEOUT_HOOK)))
       continue;
 
@@ -708,8 +824,10 @@ void mutt_startup_shutdown_hook(int type)
   err.dsize = sizeof(buf);
   mutt_buffer_init(&token);
 
-  TAILQ_FOREACH(hook, &Hooks, entries)
+  struct HookList *hl = hook_list(type);
+  for (size_t i = 0; i < hl->num; i++)
   {
+    hook = hl->hooks[i];
     if (!(hook->command && (hook->type & type)))
       continue;
 
@@ -46,6 +46,147 @@
 #include "mutt_logging.h"
 #include "muttlib.h"
 
+/* These Config Variables are only used in imap/browse.c */
+short ImapListCacheTimeout; ///< Config: (imap) Seconds to keep the folder lists
+
+/**
+ * struct ImapListReply - A cached reply to a LIST or LSUB command
+ */
+struct ImapListReply
+{
+  char *cmd;             ///< Command, e.g. 'LIST "" "INBOX/%"'
+  struct ImapList *list; ///< Mailboxes in the reply
+  int count;             ///< Number of mailboxes
+  time_t fetched;        ///< When the command was sent
+  STAILQ_ENTRY(ImapListReply) entries;
+};
+
+/**
+ * reply_free - Free a cached LIST reply
+ * @param reply Reply to free
+ */
+static void reply_free(struct ImapListReply **reply)
+{
+  if (!reply || !*reply)
+    return;
+
+  for (int i = 0; i < (*reply)->count; i++)
+    FREE(&(*reply)->list[i].name);
+  FREE(&(*reply)->list);
+  FREE(&(*reply)->cmd);
+  FREE(reply);
+}
+
+/**
+ * imap_list_cache_clear - Forget the cached folder lists of an account
+ * @param adata Imap Account data
+ */
+void imap_list_cache_clear(struct ImapAccountData *adata)
+{
+  struct ImapListReply *reply = NULL;
+  while ((reply = STAILQ_FIRST(&adata->lists)))
+  {
+    STAILQ_REMOVE_HEAD(&adata->lists, entries);
+    reply_free(&reply);
+  }
+}
+
+/**
+ * imap_list_cache_flush - Forget the cached folder lists of a server
+ * @param path Path of any mailbox on the server
+ *
+ * The next time the browser is opened, it will ask the server again.
+ */
+void imap_list_cache_flush(const char *path)
+{
+  struct ImapMbox mx;
+
+  if (imap_parse_path(path, &mx) != 0)
+    return;
+
+  struct ImapAccountData *adata = imap_conn_find(&mx.account, MUTT_IMAP_CONN_NONEW);
+  if (adata)
+    imap_list_cache_clear(adata);
+
+  FREE(&mx.mbox);
+}
+
+/**
+ * browse_list - Get the reply to a LIST or LSUB command
+ * @param adata Imap Account data
+ * @param cmd   Command, e.g. 'LIST "" "%"'
+ * @retval ptr  Reply, owned by the cache, valid until the next call
+ * @retval NULL Failure
+ *
+ * With $imap_list_cache_timeout, the replies are kept on the account and
+ * reused until they expire, or a mailbox is created, renamed, deleted or
+ * (un)subscribed.
+ */
+static struct ImapListReply *browse_list(struct ImapAccountData *adata, const char *cmd)
+{
+  struct ImapListReply *reply = NULL;
+  STAILQ_FOREACH(reply, &adata->lists, entries)
+  {
+    if (mutt_str_strcmp(reply->cmd, cmd) == 0)
+      break;
+  }
+
+  if (reply)
+  {
+    if (time(NULL) < (reply->fetched + ImapListCacheTimeout))
+    {
+      mutt_debug(3, "using the cached reply to %s\n", cmd);
+      return reply;
+    }
+    STAILQ_REMOVE(&adata->lists, reply, ImapListReply, entries);
+    reply_free(&reply);
+  }
+
+  struct ImapList list;
+  int max = 0;
+  int rc;
+
+  reply = mutt_mem_calloc(1, sizeof(struct ImapListReply));
+  reply->fetched = time(NULL);
+
+  imap_cmd_start(adata, cmd);
+  adata->cmdtype = IMAP_CT_LIST;
+  adata->cmddata = &list;
+  do
+  {
+    list.name = NULL;
+    rc = imap_cmd_step(adata);
+
+    if (rc == IMAP_CMD_CONTINUE && list.name)
+    {
+      if (reply->count == max)
+      {
+        max += 256;
+        mutt_mem_realloc(&reply->list, max * sizeof(struct ImapList));
+      }
+      reply->list[reply->count] = list;
+      reply->list[reply->count].name = mutt_str_strdup(list.name);
+      reply->count++;
+    }
+  } while (rc == IMAP_CMD_CONTINUE);
+  adata->cmddata = NULL;
+
+  if (rc != IMAP_CMD_OK)
+  {
+    reply_free(&reply);
+    return NULL;
+  }
+
+  /* without a cache, only keep the reply until the next command */
+  if (ImapListCacheTimeout == 0)
+    imap_list_cache_clear(adata);
+
+  reply->cmd = mutt_str_strdup(cmd);
+  STAILQ_INSERT_TAIL(&adata->lists, reply, entries);
+
+  return reply;
+}
+
 /**
  * add_folder - Format and add an IMAP folder to the browser
  * @param delim       Path delimiter
@@ -145,9 +286,7 @@ static void add_folder(char delim, char *folder, bool noselect, bool noinferiors
 static int browse_add_list_result(struct ImapAccountData *adata, const char *cmd,
                                   struct BrowserState *state, bool isparent)
 {
-  struct ImapList list;
   struct ImapMbox mx;
-  int rc;
 
   if (imap_parse_path(state->folder, &mx))
   {
@@ -155,28 +294,22 @@ static int browse_add_list_result(struct ImapAccountData *adata, const char *cmd
     return -1;
   }
 
-  imap_cmd_start(adata, cmd);
-  adata->cmdtype = IMAP_CT_LIST;
-  adata->cmddata = &list;
-  do
+  struct ImapListReply *reply = browse_list(adata, cmd);
+  for (int i = 0; reply && (i < reply->count); i++)
   {
-    list.name = NULL;
-    rc = imap_cmd_step(adata);
+    struct ImapList *list = &reply->list[i];
 
-    if (rc == IMAP_CMD_CONTINUE && list.name)
+    /* prune current folder from output */
+    if (isparent || (mutt_str_strncmp(list->name, mx.mbox, strlen(list->name)) != 0))
     {
       /* Let a parent folder never be selectable for navigation */
-      if (isparent)
-        list.noselect = true;
-      /* prune current folder from output */
-      if (isparent || (mutt_str_strncmp(list.name, mx.mbox, strlen(list.name)) != 0))
-        add_folder(list.delim, list.name, list.noselect, list.noinferiors, state, isparent);
+      add_folder(list->delim, list->name, isparent || list->noselect,
+                 list->noinferiors, state, isparent);
     }
-  } while (rc == IMAP_CMD_CONTINUE);
-  adata->cmddata = NULL;
+  }
 
   FREE(&mx.mbox);
-  return (rc == IMAP_CMD_OK) ? 0 : -1;
+  return reply ? 0 : -1;
 }
 
 /**
@@ -232,31 +365,24 @@ int imap_browse(char *path, struct BrowserState *state)
 
   if (n)
   {
-    int rc;
     mutt_debug(3, "mbox: %s\n", mbox);
 
     /* if our target exists and has inferiors, enter it if we
      * aren't already going to */
     imap_munge_mbox_name(adata, munged_mbox, sizeof(munged_mbox), mbox);
     snprintf(buf, sizeof(buf), "%s \"\" %s", list_cmd, munged_mbox);
-    imap_cmd_start(adata, buf);
-    adata->cmdtype = IMAP_CT_LIST;
-    adata->cmddata = &list;
-    do
+    struct ImapListReply *reply = browse_list(adata, buf);
+    list.delim = adata->delim;
+    for (int i = 0; reply && (i < reply->count); i++)
     {
-      list.name = 0;
-      rc = imap_cmd_step(adata);
-      if (rc == IMAP_CMD_CONTINUE && list.name)
+      list = reply->list[i];
+      if (!list.noinferiors && list.name[0] &&
+          (imap_mxcmp(list.name, mbox) == 0) && n < sizeof(mbox) - 1)
       {
-        if (!list.noinferiors && list.name[0] &&
-            (imap_mxcmp(list.name, mbox) == 0) && n < sizeof(mbox) - 1)
-        {
-          mbox[n++] = list.delim;
-          mbox[n] = '\0';
-        }
+        mbox[n++] = list.delim;
+        mbox[n] = '\0';
       }
-    } while (rc == IMAP_CMD_CONTINUE);
-    adata->cmddata = NULL;
+    }
 
     /* if we're descending a folder, mark it as current in browser_state */
     if (mbox[n - 1] == list.delim)
@@ -72,8 +72,9 @@ static const char *const Capabilities[] = {
   "AUTH=GSSAPI", "AUTH=ANONYMOUS", "AUTH=OAUTHBEARER",
   "STARTTLS",    "LOGINDISABLED",  "IDLE",
   "SASL-IR",     "ENABLE",         "CONDSTORE",
-  "QRESYNC",     "X-GM-EXT-1",     "X-GM-EXT1",
-  NULL,
+  "QRESYNC",     "COMPRESS=DEFLATE", "MOVE",
+  "SORT",        "THREAD=REFERENCES", "X-GM-EXT-1",
+  "X-GM-EXT1",   NULL,
 };
 
 /**
@@ -232,6 +233,149 @@ static int cmd_status(const char *s)
   return IMAP_CMD_BAD;
 }
 
+/**
+ * struct MsnExpunge - Expunges not yet applied to the msn_index
+ *
+ * A burst of EXPUNGE or VANISHED responses only marks the slots of the
+ * msn_index as dead.  The index is compacted once the burst is over, see
+ * imap_msn_compact().  Until then, a Fenwick tree counting the live slots maps
+ * the server's MSNs to slots.
+ */
+struct MsnExpunge
+{
+  unsigned int size;  ///< Number of slots in use when the burst started
+  unsigned int *tree; ///< Fenwick tree of live slots, indexed from 1
+  bool *dead;         ///< Slots that have been expunged
+};
+
+/**
+ * msn_slots - Get the number of slots of the msn_index in use
+ * @param adata Imap Account data
+ * @retval num Number of slots
+ */
+static unsigned int msn_slots(struct ImapAccountData *adata)
+{
+  return adata->msn_expunged ? adata->msn_expunged->size : adata->max_msn;
+}
+
+/**
+ * msn_find - Find the slot of the msn_index holding an MSN
+ * @param adata Imap Account data
+ * @param msn   Message Sequence Number, 1 to max_msn
+ * @retval num Slot
+ */
+static unsigned int msn_find(struct ImapAccountData *adata, unsigned int msn)
+{
+  struct MsnExpunge *mx = adata->msn_expunged;
+  if (!mx)
+    return msn - 1;
+
+  unsigned int step = 1;
+  while ((step << 1) <= mx->size)
+    step <<= 1;
+
+  /* find the last slot with fewer than msn live slots up to it */
+  unsigned int pos = 0;
+  for (; step; step >>= 1)
+  {
+    if (((pos + step) <= mx->size) && (mx->tree[pos + step] < msn))
+    {
+      pos += step;
+      msn -= mx->tree[pos];
+    }
+  }
+
+  return pos;
+}
+
+/**
+ * msn_kill - Mark a slot of the msn_index as expunged
+ * @param adata Imap Account data
+ * @param slot  Slot to remove
+ *
+ * The MSNs above it go down by one.
+ */
+static void msn_kill(struct ImapAccountData *adata, unsigned int slot)
+{
+  struct MsnExpunge *mx = adata->msn_expunged;
+  if (!mx)
+  {
+    mx = mutt_mem_calloc(1, sizeof(struct MsnExpunge));
+    mx->size = adata->max_msn;
+    mx->tree = mutt_mem_calloc(mx->size + 1, sizeof(unsigned int));
+    mx->dead = mutt_mem_calloc(mx->size, sizeof(bool));
+    /* every slot is live */
+    for (unsigned int i = 1; i <= mx->size; i++)
+    {
+      mx->tree[i]++;
+      const unsigned int parent = i + (i & -i);
+      if (parent <= mx->size)
+        mx->tree[parent] += mx->tree[i];
+    }
+    adata->msn_expunged = mx;
+  }
+
+  if (mx->dead[slot])
+    return;
+
+  mx->dead[slot] = true;
+  for (unsigned int i = slot + 1; i <= mx->size; i += (i & -i))
+    mx->tree[i]--;
+
+  adata->msn_index[slot] = NULL;
+  adata->max_msn--;
+}
+
+/**
+ * imap_msn_compact - Apply a burst of expunges to the msn_index
+ * @param adata Imap Account data
+ *
+ * Remove the dead slots and renumber the remaining messages, in one pass.
+ */
+void imap_msn_compact(struct ImapAccountData *adata)
+{
+  struct MsnExpunge *mx = adata->msn_expunged;
+  if (!mx)
+    return;
+
+  unsigned int msn = 0;
+  for (unsigned int i = 0; i < mx->size; i++)
+  {
+    if (mx->dead[i])
+      continue;
+
+    struct Email *e = adata->msn_index[i];
+    if (e)
+      IMAP_EDATA(e)->msn = msn + 1;
+    adata->msn_index[msn++] = e;
+  }
+  for (unsigned int i = msn; i < mx->size; i++)
+    adata->msn_index[i] = NULL;
+
+  mutt_debug(2, "removed %u expunged messages\n", mx->size - msn);
+
+  FREE(&mx->tree);
+  FREE(&mx->dead);
+  FREE(&adata->msn_expunged);
+}
+
+/**
+ * cmd_is_expunge - Is this response part of a burst of expunges?
+ * @param s Response from the server
+ * @retval true It's an EXPUNGE or VANISHED response
+ */
+static bool cmd_is_expunge(const char *s)
+{
+  if (mutt_str_strncmp(s, "* ", 2) != 0)
+    return false;
+
+  s = imap_next_word((char *) s);
+  if (isdigit((unsigned char) *s))
+    return (mutt_str_strncasecmp("EXPUNGE", imap_next_word((char *) s), 7) == 0);
+
+  return (mutt_str_strncasecmp("VANISHED", s, 8) == 0);
+}
+
 /**
  * cmd_parse_expunge - Parse expunge command
  * @param adata Imap Account data
@@ -250,7 +394,8 @@ static void cmd_parse_expunge(struct ImapAccountData *adata, const char *s)
   if (mutt_str_atoui(s, &exp_msn) < 0 || exp_msn < 1 || exp_msn > adata->max_msn)
     return;
 
-  e = adata->msn_index[exp_msn - 1];
+  const unsigned int slot = msn_find(adata, exp_msn);
+  e = adata->msn_index[slot];
   if (e)
   {
     /* imap_expunge_mailbox() will rewrite e->index.
@@ -260,17 +405,8 @@ static void cmd_parse_expunge(struct ImapAccountData *adata, const char *s)
     IMAP_EDATA(e)->msn = 0;
   }
 
-  /* decrement seqno of those above. */
-  for (unsigned int cur = exp_msn; cur < adata->max_msn; cur++)
-  {
-    e = adata->msn_index[cur];
-    if (e)
-      IMAP_EDATA(e)->msn--;
-    adata->msn_index[cur - 1] = e;
-  }
-
-  adata->msn_index[adata->max_msn - 1] = NULL;
-  adata->max_msn--;
+  /* the seqno of those above is decremented by imap_msn_compact() */
+  msn_kill(adata, slot);
 
   adata->reopen |= IMAP_EXPUNGE_PENDING;
 }
@@ -329,7 +465,8 @@ static void cmd_parse_vanished(struct ImapAccountData *adata, char *s)
     e->index = INT_MAX;
     IMAP_EDATA(e)->msn = 0;
 
-    if ((exp_msn < 1) || (exp_msn > adata->max_msn))
+    /* until the burst is over, msn is still the slot in the msn_index */
+    if ((exp_msn < 1) || (exp_msn > msn_slots(adata)))
     {
       mutt_debug(1, "VANISHED: msn for UID %u is incorrect.\n", uid);
       continue;
@@ -340,22 +477,11 @@ static void cmd_parse_vanished(struct ImapAccountData *adata, char *s)
       continue;
     }
 
-    adata->msn_index[exp_msn - 1] = NULL;
-
-    if (!earlier)
-    {
-      /* decrement seqno of those above. */
-      for (unsigned int cur = exp_msn; cur < adata->max_msn; cur++)
-      {
-        e = adata->msn_index[cur];
-        if (e)
-          IMAP_EDATA(e)->msn--;
-        adata->msn_index[cur - 1] = e;
-      }
-
-      adata->msn_index[adata->max_msn - 1] = NULL;
-      adata->max_msn--;
-    }
+    /* the seqno of those above is decremented by imap_msn_compact() */
+    if (earlier)
+      adata->msn_index[exp_msn - 1] = NULL;
+    else
+      msn_kill(adata, exp_msn - 1);
   }
 
   if (rc < 0)
@@ -483,6 +609,12 @@ static void cmd_parse_fetch(struct ImapAccountData *adata, char *s)
         return;
       }
     }
+    else if ((mutt_str_strncasecmp("BODY[] ", s, 7) == 0) && IMAP_EDATA(e)->prefetch)
+    {
+      if (imap_prefetch_store(adata, e, s + 7) < 0)
+        adata->status = IMAP_FATAL;
+      return;
+    }
     else if (*s == ')')
       break; /* end of request */
     else if (*s)
@@ -521,6 +653,7 @@ static void cmd_parse_capability(struct ImapAccountData *adata, char *s)
     *bracket = '\0';
   FREE(&adata->capstr);
   adata->capstr = mutt_str_strdup(s);
+  adata->caps_seen = true;
 
   memset(adata->capabilities, 0, sizeof(adata->capabilities));
 
@@ -539,6 +672,19 @@ static void cmd_parse_capability(struct ImapAccountData *adata, char *s)
   }
 }
 
+/**
+ * imap_cmd_set_capabilities - Set the capabilities of a server
+ * @param adata  Imap Account data
+ * @param capstr Capabilities, as listed by a CAPABILITY response
+ */
+void imap_cmd_set_capabilities(struct ImapAccountData *adata, const char *capstr)
+{
+  char *s = NULL;
+  safe_asprintf(&s, "CAPABILITY %s", capstr);
+  cmd_parse_capability(adata, s);
+  FREE(&s);
+}
+
 /**
  * cmd_parse_list - Parse a server LIST command (list mailboxes)
  * @param adata Imap Account data
@@ -758,6 +904,24 @@ static void cmd_parse_search(struct ImapAccountData *adata, const char *s)
   }
 }
 
+/**
+ * cmd_parse_sort - Store a SORT or THREAD response for later use
+ * @param adata Imap Account data
+ * @param s     Command string with the results
+ */
+static void cmd_parse_sort(struct ImapAccountData *adata, const char *s)
+{
+  mutt_debug(2, "Handling SORT/THREAD\n");
+
+  if (!adata->cmddata || (adata->cmdtype != IMAP_CT_SORT))
+    return;
+
+  struct Buffer *reply = adata->cmddata;
+  s = imap_next_word((char *) s);
+  mutt_buffer_addch(reply, ' ');
+  mutt_buffer_addstr(reply, s);
+}
+
 /**
  * cmd_parse_status - Parse status from server
  * @param adata Imap Account data
@@ -1030,6 +1194,11 @@ static int cmd_handle_untagged(struct ImapAccountData *adata)
     cmd_parse_myrights(adata, s);
   else if (mutt_str_strncasecmp("SEARCH", s, 6) == 0)
     cmd_parse_search(adata, s);
+  else if ((mutt_str_strncasecmp("SORT", s, 4) == 0) ||
+           (mutt_str_strncasecmp("THREAD", s, 6) == 0))
+  {
+    cmd_parse_sort(adata, s);
+  }
   else if (mutt_str_strncasecmp("STATUS", s, 6) == 0)
     cmd_parse_status(adata, s);
   else if (mutt_str_strncasecmp("ENABLED", s, 7) == 0)
@@ -1137,6 +1306,10 @@ int imap_cmd_step(struct ImapAccountData *adata)
 
   adata->lastread = time(NULL);
 
+  /* a burst of expunges is over */
+  if (adata->msn_expunged && !cmd_is_expunge(adata->buf))
+    imap_msn_compact(adata);
+
   /* handle untagged messages. The caller still gets its shot afterwards. */
   if (((mutt_str_strncmp(adata->buf, "* ", 2) == 0) ||
        (mutt_str_strncmp(imap_next_word(adata->buf), "OK [", 4) == 0)) &&
@@ -1190,12 +1363,60 @@ int imap_cmd_step(struct ImapAccountData *adata)
   else
   {
     mutt_debug(3, "IMAP queue drained\n");
+    adata->background = false;
     imap_cmd_finish(adata);
   }
 
   return rc;
 }
 
+/**
+ * imap_cmd_pending - Are any commands waiting for an answer?
+ * @param adata Imap Account data
+ * @retval true At least one command hasn't been answered
+ */
+bool imap_cmd_pending(struct ImapAccountData *adata)
+{
+  for (int c = adata->lastcmd; c != adata->nextcmd; c = (c + 1) % adata->cmdslots)
+  {
+    if (adata->cmds[c].state == IMAP_CMD_NEW)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * imap_cmd_collect - Read the answers that have already arrived
+ * @param adata Imap Account data
+ * @retval >=0 Number of lines read
+ * @retval  -1 Error
+ *
+ * Unlike imap_exec(), this never waits for the server.  It picks up the
+ * answers to commands sent in the background (see ImapAccountData::background)
+ * and the changes reported while IDLE.  The answers are handled just as if
+ * imap_exec() had waited for them.
+ */
+int imap_cmd_collect(struct ImapAccountData *adata)
+{
+  int count = 0;
+
+  if ((adata->state != IMAP_IDLE) && !adata->background)
+    return 0;
+
+  while ((adata->state == IMAP_IDLE) || imap_cmd_pending(adata))
+  {
+    const int rc = mutt_socket_poll(adata->conn, 0);
+    if (rc == 0)
+      break;
+    if ((rc < 0) || (imap_cmd_step(adata) == IMAP_CMD_BAD))
+      return -1;
+    count++;
+  }
+
+  return count;
+}
+
 /**
  * imap_code - Was the command successful
  * @param s IMAP command status
@@ -1272,9 +1493,11 @@ int imap_exec(struct ImapAccountData *adata, const char *cmdstr, int flags)
   if (flags & IMAP_CMD_QUEUE)
     return 0;
 
+  mutt_trace_begin_cmd("imap_exec", cmdstr);
   if ((flags & IMAP_CMD_POLL) && (ImapPollTimeout > 0) &&
       (mutt_socket_poll(adata->conn, ImapPollTimeout)) == 0)
   {
+    mutt_trace_end("imap_exec");
     mutt_error(_("Connection to %s timed out"), adata->conn->account.host);
     cmd_handle_fatal(adata);
     return -1;
@@ -1286,6 +1509,7 @@ int imap_exec(struct ImapAccountData *adata, const char *cmdstr, int flags)
     rc = imap_cmd_step(adata);
   while (rc == IMAP_CMD_CONTINUE);
   mutt_sig_allow_interrupt(0);
+  mutt_trace_end("imap_exec");
 
   if (rc == IMAP_CMD_NO && (flags & IMAP_CMD_FAIL_OK))
     return -2;
@@ -1313,6 +1537,8 @@ int imap_exec(struct ImapAccountData *adata, const char *cmdstr, int flags)
  */
 void imap_cmd_finish(struct ImapAccountData *adata)
 {
+  imap_msn_compact(adata);
+
   if (adata->status == IMAP_FATAL)
   {
     cmd_handle_fatal(adata);
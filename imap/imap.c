@@ -29,6 +29,7 @@
  */
 
 #include "config.h"
+#include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -54,6 +55,7 @@
 #include "mutt_logging.h"
 #include "mutt_socket.h"
 #include "muttlib.h"
+#include "mutt_thread.h"
 #include "mx.h"
 #include "pattern.h"
 #include "progress.h"
@@ -66,7 +68,11 @@
 #endif
 
 /* These Config Variables are only used in imap/imap.c */
+bool ImapDeflate; ///< Config: (imap) Compress network traffic
 bool ImapIdle; ///< Config: (imap) Use the IMAP IDLE extension to check for new mail
+short ImapIdleConnections; ///< Config: (imap) Number of mailboxes to watch with IDLE
+bool ImapPollConnection; ///< Config: (imap) Check mailboxes over a separate connection
+bool ImapServerSort; ///< Config: (imap) Let the server sort and thread the mailbox
 
 /**
  * check_capabilities - Make sure we can log in to this server
@@ -675,6 +681,7 @@ int imap_create_mailbox(struct ImapAccountData *adata, char *mailbox)
     return -1;
   }
 
+  imap_list_cache_clear(adata);
   return 0;
 }
 
@@ -700,6 +707,8 @@ int imap_rename_mailbox(struct ImapAccountData *adata, struct ImapMbox *mx, cons
 
   if (imap_exec(adata, mutt_b2s(b), 0) != 0)
     rc = -1;
+  else
+    imap_list_cache_clear(adata);
 
   mutt_buffer_pool_release(&b);
 
@@ -738,6 +747,7 @@ int imap_delete_mailbox(struct Mailbox *mailbox, struct ImapMbox *mx)
   if (imap_exec(adata, buf, 0) != 0)
     return -1;
 
+  imap_list_cache_clear(adata);
   return 0;
 }
 
@@ -764,23 +774,25 @@ void imap_logout_all(void)
 }
 
 /**
- * imap_read_literal - Read bytes bytes from server into file
- * @param fp    File handle for email file
+ * read_literal - Read a literal from the server
  * @param adata Imap Account data
  * @param bytes Number of bytes to read
  * @param pbar  Progress bar
+ * @param fp    File to write the literal to, or NULL
+ * @param dest  Buffer to append the literal to, or NULL
  * @retval  0 Success
  * @retval -1 Failure
  *
- * Not explicitly buffered, relies on FILE buffering.
+ * The literal is read in blocks, rather than a character at a time.
  *
  * @note Strips `\r` from `\r\n`.
  *       Apparently even literals use `\r\n`-terminated strings ?!
  */
-int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
-                      unsigned long bytes, struct Progress *pbar)
+static int read_literal(struct ImapAccountData *adata, unsigned long bytes,
+                        struct Progress *pbar, FILE *fp, struct Buffer *dest)
 {
-  char c;
+  char in[HUGE_STRING];
+  char out[HUGE_STRING + 1];
   bool r = false;
   struct Buffer *buf = NULL;
 
@@ -789,9 +801,11 @@ int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
 
   mutt_debug(2, "reading %ld bytes\n", bytes);
 
-  for (unsigned long pos = 0; pos < bytes; pos++)
+  for (unsigned long pos = 0; pos < bytes;)
   {
-    if (mutt_socket_readchar(adata->conn, &c) != 1)
+    const size_t want = MIN(bytes - pos, sizeof(in));
+    const int n = mutt_socket_readbuf(adata->conn, in, want);
+    if (n <= 0)
     {
       mutt_debug(1, "error during read, %ld bytes read\n", pos);
       adata->status = IMAP_FATAL;
@@ -800,23 +814,34 @@ int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
       return -1;
     }
 
-    if (r && c != '\n')
-      fputc('\r', fp);
-
-    if (c == '\r')
+    size_t len = 0;
+    for (int i = 0; i < n; i++)
     {
-      r = true;
-      continue;
+      const char c = in[i];
+      if (r && (c != '\n'))
+        out[len++] = '\r';
+
+      if (c == '\r')
+      {
+        r = true;
+        continue;
+      }
+      else
+        r = false;
+
+      out[len++] = c;
     }
-    else
-      r = false;
 
-    fputc(c, fp);
+    if (fp)
+      fwrite(out, 1, len, fp);
+    if (dest)
+      mutt_buffer_add(dest, out, len);
 
-    if (pbar && !(pos % 1024))
+    pos += n;
+    if (pbar)
       mutt_progress_update(pbar, pos, -1);
     if (DebugLevel >= IMAP_LOG_LTRL)
-      mutt_buffer_addch(buf, c);
+      mutt_buffer_add(buf, out, len);
   }
 
   if (DebugLevel >= IMAP_LOG_LTRL)
@@ -827,6 +852,143 @@ int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
   return 0;
 }
 
+/**
+ * imap_compress - Compress the connection, if the server supports it
+ * @param adata Imap Account data
+ *
+ * RFC4978 COMPRESS=DEFLATE.  It must be negotiated after authentication, so
+ * that the server's full capabilities are known.  If the server refuses, the
+ * connection carries on uncompressed.
+ */
+void imap_compress(struct ImapAccountData *adata)
+{
+#ifdef HAVE_ZLIB
+  if (!ImapDeflate || !mutt_bit_isset(adata->capabilities, COMPRESS_DEFLATE))
+    return;
+
+  if (imap_exec(adata, "COMPRESS DEFLATE", IMAP_CMD_FAIL_OK) != 0)
+  {
+    mutt_debug(2, "server refused COMPRESS DEFLATE\n");
+    return;
+  }
+
+  if (mutt_zstrm_wrap_conn(adata->conn) != 0)
+  {
+    /* the server is already compressing, so the connection is unusable */
+    adata->status = IMAP_FATAL;
+    return;
+  }
+  mutt_debug(2, "compressing the connection to %s\n", adata->conn->account.host);
+#endif
+}
+
+/**
+ * imap_extra_open - Open another connection to an account
+ * @param adata Imap Account data of an authenticated connection
+ * @retval ptr  Connection, authenticated but with no mailbox selected
+ * @retval NULL Error
+ *
+ * The connection isn't in the list of connections, so it's private to the
+ * caller, who must close it with imap_extra_close().  It never tries to
+ * reconnect by itself.
+ */
+struct ImapAccountData *imap_extra_open(struct ImapAccountData *adata)
+{
+  struct Connection *conn = mutt_conn_new(&adata->conn->account);
+  if (!conn)
+    return NULL;
+
+  /* keep it out of imap_conn_find()'s way */
+  TAILQ_REMOVE(mutt_socket_head(), conn, entries);
+
+  struct ImapAccountData *edata = imap_adata_new();
+  conn->data = edata;
+  edata->conn = conn;
+  /* if it fails, don't go looking for another connection */
+  edata->recovering = true;
+
+  if (imap_open_connection(edata) != 0)
+    goto fail;
+  if (edata->state == IMAP_CONNECTED)
+  {
+    if (imap_authenticate(edata) != IMAP_AUTH_SUCCESS)
+      goto fail;
+    edata->state = IMAP_AUTHENTICATED;
+  }
+
+  /* servers often only advertise compression after login */
+  if (mutt_bit_isset(adata->capabilities, COMPRESS_DEFLATE))
+    mutt_bit_set(edata->capabilities, COMPRESS_DEFLATE);
+  imap_compress(edata);
+  if (edata->status == IMAP_FATAL)
+    goto fail;
+  edata->delim = adata->delim;
+
+  return edata;
+
+fail:
+  imap_extra_close(&edata);
+  return NULL;
+}
+
+/**
+ * imap_extra_close - Close a connection opened by imap_extra_open()
+ * @param edata Imap Account data of the connection
+ *
+ * Nothing is waited for.  Any commands still in flight are abandoned.
+ */
+void imap_extra_close(struct ImapAccountData **edata)
+{
+  if (!edata || !*edata)
+    return;
+
+  struct Connection *conn = (*edata)->conn;
+  if ((*edata)->state != IMAP_DISCONNECTED)
+  {
+    (*edata)->status = IMAP_BYE;
+    imap_cmd_start(*edata, "LOGOUT");
+  }
+  imap_close_connection(*edata);
+  imap_adata_free(edata);
+  /* not in the list of connections, so mutt_socket_free() won't do */
+  FREE(&conn);
+}
+
+/**
+ * imap_read_literal - Read bytes bytes from server into file
+ * @param fp    File handle for email file
+ * @param adata Imap Account data
+ * @param bytes Number of bytes to read
+ * @param pbar  Progress bar
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * @note Strips `\r` from `\r\n`.
+ */
+int imap_read_literal(FILE *fp, struct ImapAccountData *adata,
+                      unsigned long bytes, struct Progress *pbar)
+{
+  return read_literal(adata, bytes, pbar, fp, NULL);
+}
+
+/**
+ * imap_read_literal_buf - Read bytes bytes from server into a Buffer
+ * @param buf   Buffer to append the literal to
+ * @param adata Imap Account data
+ * @param bytes Number of bytes to read
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Used for small literals, e.g. headers, which can be parsed in memory.
+ *
+ * @note Strips `\r` from `\r\n`.
+ */
+int imap_read_literal_buf(struct Buffer *buf, struct ImapAccountData *adata,
+                          unsigned long bytes)
+{
+  return read_literal(adata, bytes, NULL, NULL, buf);
+}
+
 /**
  * imap_expunge_mailbox - Purge messages from the server
  * @param adata Imap Account data
@@ -902,6 +1064,9 @@ void imap_expunge_mailbox(struct ImapAccountData *adata)
   }
 
 #ifdef USE_HCACHE
+  /* keep the next QRESYNC in step with the cache */
+  if (adata->qresync)
+    imap_hcache_store_uid_seqset(adata);
   imap_hcache_close(adata);
 #endif
 
@@ -970,10 +1135,13 @@ struct ImapAccountData *imap_conn_find(const struct ConnAccount *account, int fl
     imap_open_connection(adata);
   if (adata->state == IMAP_CONNECTED)
   {
+    adata->caps_seen = false;
     if (imap_authenticate(adata) == IMAP_AUTH_SUCCESS)
     {
       adata->state = IMAP_AUTHENTICATED;
-      FREE(&adata->capstr);
+      /* many servers send their new capabilities with the LOGIN response */
+      if (!adata->caps_seen)
+        FREE(&adata->capstr);
       new = true;
       if (adata->conn->ssf)
         mutt_debug(2, "Communication encrypted at %d bits\n", adata->conn->ssf);
@@ -983,8 +1151,14 @@ struct ImapAccountData *imap_conn_find(const struct ConnAccount *account, int fl
   }
   if (new && adata->state == IMAP_AUTHENTICATED)
   {
+    bool cached = false;
+#ifdef USE_HCACHE
+    cached = imap_hcache_server_fetch(adata);
+#endif
+
     /* capabilities may have changed */
-    imap_exec(adata, "CAPABILITY", IMAP_CMD_QUEUE);
+    if (!adata->caps_seen)
+      imap_exec(adata, "CAPABILITY", IMAP_CMD_QUEUE);
 
     /* enable RFC6855, if the server supports that */
     if (mutt_bit_isset(adata->capabilities, ENABLE))
@@ -999,12 +1173,22 @@ struct ImapAccountData *imap_conn_find(const struct ConnAccount *account, int fl
         imap_exec(adata, "ENABLE QRESYNC", IMAP_CMD_QUEUE);
     }
 
-    /* get root delimiter, '/' as default */
-    adata->delim = '/';
-    imap_exec(adata, "LIST \"\" \"\"", IMAP_CMD_QUEUE);
+    /* If the server is the same as last time, its delimiter is already known
+     * and the ENABLEs can go out with the next command, e.g. SELECT. */
+    if (!cached)
+    {
+      /* get root delimiter, '/' as default */
+      adata->delim = '/';
+      imap_exec(adata, "LIST \"\" \"\"", IMAP_CMD_QUEUE);
+
+      /* we may need the root delimiter before we open a mailbox */
+      imap_exec(adata, NULL, IMAP_CMD_FAIL_OK);
+#ifdef USE_HCACHE
+      imap_hcache_server_store(adata);
+#endif
+    }
 
-    /* we may need the root delimiter before we open a mailbox */
-    imap_exec(adata, NULL, IMAP_CMD_FAIL_OK);
+    imap_compress(adata);
   }
 
   if (adata->state < IMAP_AUTHENTICATED)
@@ -1034,6 +1218,8 @@ int imap_open_connection(struct ImapAccountData *adata)
     return -1;
   }
 
+  mutt_str_replace(&adata->greeting, adata->buf);
+
   if (mutt_str_strncasecmp("* OK", adata->buf, 4) == 0)
   {
     if ((mutt_str_strncasecmp("* OK [CAPABILITY", adata->buf, 16) != 0) &&
@@ -1249,34 +1435,23 @@ out:
 }
 
 /**
- * imap_sync_message_for_copy - Update server to reflect the flags of a single message
- * @param[in]  adata        Imap Account data
- * @param[in]  e            Email
- * @param[in]  cmd          Buffer for the command string
- * @param[out] err_continue Did the user force a continue?
- * @retval  0 Success
- * @retval -1 Failure
- *
- * Update the IMAP server to reflect the flags for a single message before
- * performing a "UID COPY".
+ * make_flags_cmd - Build the STORE command to sync the flags of a message
+ * @param adata Imap Account data
+ * @param e     Email
+ * @param cmd   Buffer for the command string
+ * @retval true  The command sets or clears some flags
+ * @retval false There are no flags we're allowed to change
  *
  * @note This does not sync the "deleted" flag state, because it is not
  *       desirable to propagate that flag into the copy.
  */
-int imap_sync_message_for_copy(struct ImapAccountData *adata, struct Email *e,
-                               struct Buffer *cmd, int *err_continue)
+static bool make_flags_cmd(struct ImapAccountData *adata, struct Email *e,
+                           struct Buffer *cmd)
 {
   char flags[LONG_STRING];
   char *tags = NULL;
   char uid[11];
 
-  if (!compare_flags_for_copy(e))
-  {
-    if (e->deleted == IMAP_EDATA(e)->deleted)
-      e->changed = false;
-    return 0;
-  }
-
   snprintf(uid, sizeof(uid), "%u", IMAP_EDATA(e)->uid);
   cmd->dptr = cmd->data;
   mutt_buffer_addstr(cmd, "UID STORE ");
@@ -1333,12 +1508,56 @@ int imap_sync_message_for_copy(struct ImapAccountData *adata, struct Email *e,
   mutt_buffer_addstr(cmd, flags);
   mutt_buffer_addstr(cmd, ")");
 
+  /* after all this it's still possible to have no flags, if you
+   * have no ACL rights */
+  return *flags;
+}
+
+/**
+ * flags_synced - Record that the server has the message's flags
+ * @param e Email
+ */
+static void flags_synced(struct Email *e)
+{
+  FREE(&IMAP_EDATA(e)->flags_remote);
+  IMAP_EDATA(e)->flags_remote = driver_tags_get_with_hidden(&e->tags);
+
+  e->active = true;
+  if (e->deleted == IMAP_EDATA(e)->deleted)
+    e->changed = false;
+}
+
+/**
+ * imap_sync_message_for_copy - Update server to reflect the flags of a single message
+ * @param[in]  adata        Imap Account data
+ * @param[in]  e            Email
+ * @param[in]  cmd          Buffer for the command string
+ * @param[out] err_continue Did the user force a continue?
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Update the IMAP server to reflect the flags for a single message before
+ * performing a "UID COPY".
+ *
+ * @note This does not sync the "deleted" flag state, because it is not
+ *       desirable to propagate that flag into the copy.
+ */
+int imap_sync_message_for_copy(struct ImapAccountData *adata, struct Email *e,
+                               struct Buffer *cmd, int *err_continue)
+{
+  if (!compare_flags_for_copy(e))
+  {
+    if (e->deleted == IMAP_EDATA(e)->deleted)
+      e->changed = false;
+    return 0;
+  }
+
+  const bool store = make_flags_cmd(adata, e, cmd);
+
   /* dumb hack for bad UW-IMAP 4.7 servers spurious FLAGS updates */
   e->active = false;
 
-  /* after all this it's still possible to have no flags, if you
-   * have no ACL rights */
-  if (*flags && (imap_exec(adata, cmd->data, 0) != 0) && err_continue &&
+  if (store && (imap_exec(adata, cmd->data, 0) != 0) && err_continue &&
       (*err_continue != MUTT_YES))
   {
     *err_continue = imap_continue("imap_sync_message: STORE failed", adata->buf);
@@ -1350,16 +1569,90 @@ int imap_sync_message_for_copy(struct ImapAccountData *adata, struct Email *e,
   }
 
   /* server have now the updated flags */
-  FREE(&IMAP_EDATA(e)->flags_remote);
-  IMAP_EDATA(e)->flags_remote = driver_tags_get_with_hidden(&e->tags);
-
-  e->active = true;
-  if (e->deleted == IMAP_EDATA(e)->deleted)
-    e->changed = false;
+  flags_synced(e);
 
   return 0;
 }
 
+/**
+ * imap_sync_msgset_for_copy - Update server to reflect the flags of several messages
+ * @param[in]  adata        Imap Account data
+ * @param[in]  flag         Messages to sync, #MUTT_TAG or #MUTT_TRASH
+ * @param[out] err_continue Did the user force a continue?
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Like imap_sync_message_for_copy(), for every changed message matching flag.
+ * The STORE commands are pipelined and their results checked together, so
+ * syncing many messages costs one round trip, not one each.
+ */
+int imap_sync_msgset_for_copy(struct ImapAccountData *adata, int flag, int *err_continue)
+{
+  struct Mailbox *mailbox = adata->ctx->mailbox;
+  struct Email **queued = NULL;
+  int count = 0;
+  int rc = 0;
+
+  for (int i = 0; i < mailbox->msg_count; i++)
+  {
+    struct Email *e = mailbox->hdrs[i];
+
+    if (!e->active || !e->changed)
+      continue;
+    if ((flag == MUTT_TAG) && !e->tagged)
+      continue;
+    if ((flag == MUTT_TRASH) && (!e->deleted || e->purge))
+      continue;
+
+    if (!compare_flags_for_copy(e))
+    {
+      if (e->deleted == IMAP_EDATA(e)->deleted)
+        e->changed = false;
+      continue;
+    }
+
+    if (!queued)
+      queued = mutt_mem_calloc(mailbox->msg_count, sizeof(struct Email *));
+
+    struct Buffer *cmd = mutt_buffer_pool_get();
+    const bool store = make_flags_cmd(adata, e, cmd);
+    if (store && (imap_exec(adata, cmd->data, IMAP_CMD_QUEUE) < 0))
+    {
+      mutt_buffer_pool_release(&cmd);
+      rc = -1;
+      break;
+    }
+    mutt_buffer_pool_release(&cmd);
+
+    /* dumb hack for bad UW-IMAP 4.7 servers spurious FLAGS updates */
+    e->active = false;
+    queued[count++] = e;
+  }
+
+  if ((rc == 0) && (count > 0))
+  {
+    mutt_debug(2, "syncing flags of %d messages\n", count);
+    if ((imap_exec(adata, NULL, 0) != 0) && err_continue && (*err_continue != MUTT_YES))
+    {
+      *err_continue = imap_continue("imap_sync_message: STORE failed", adata->buf);
+      if (*err_continue != MUTT_YES)
+        rc = -1;
+    }
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    /* server have now the updated flags */
+    if (rc == 0)
+      flags_synced(queued[i]);
+    else
+      queued[i]->active = true;
+  }
+
+  FREE(&queued);
+  return rc;
+}
+
 /**
  * imap_check_mailbox - use the NOOP or IDLE command to poll for new mail
  * @param mailbox Mailbox
@@ -1411,11 +1704,22 @@ int imap_check(struct ImapAccountData *adata, bool force)
       mutt_bit_unset(adata->capabilities, IDLE);
     }
   }
+  /* the answer to a NOOP sent by an earlier check */
+  else if (imap_cmd_collect(adata) < 0)
+    return -1;
 
-  if ((force || (adata->state != IMAP_IDLE && time(NULL) >= adata->lastread + Timeout)) &&
-      imap_exec(adata, "NOOP", IMAP_CMD_POLL) != 0)
+  if (force)
   {
-    return -1;
+    if (imap_exec(adata, "NOOP", IMAP_CMD_POLL) != 0)
+      return -1;
+  }
+  /* don't make the user wait for the answer, the next check collects it */
+  else if ((adata->state != IMAP_IDLE) && (time(NULL) >= adata->lastread + Timeout) &&
+           !imap_cmd_pending(adata))
+  {
+    if (imap_cmd_start(adata, "NOOP") < 0)
+      return -1;
+    adata->background = true;
   }
 
   /* We call this even when we haven't run NOOP in case we have pending
@@ -1435,51 +1739,452 @@ int imap_check(struct ImapAccountData *adata, bool force)
 }
 
 /**
- * imap_mailbox_check - Check for new mail in subscribed folders
- * @param check_stats Check for message stats too
- * @retval num Number of mailboxes with new mail
- * @retval 0   Failure
+ * poll_conn - Get the connection for checking an account's mailboxes
+ * @param adata Imap Account data
+ * @retval ptr  Connection for STATUS commands
+ * @retval NULL Use the account's own connection
  *
- * Given a list of mailboxes rather than called once for each so that it can
- * batch the commands and save on round trips.
+ * The connection is opened when it's first needed, and again if it's lost.
+ * If the server won't accept it, the account isn't asked again.
  */
-int imap_mailbox_check(bool check_stats)
+static struct ImapAccountData *poll_conn(struct ImapAccountData *adata)
 {
-  struct ImapAccountData *adata = NULL;
-  struct ImapAccountData *lastdata = NULL;
-  char name[LONG_STRING];
-  char command[LONG_STRING * 2];
-  char munged[LONG_STRING];
-  int mbcount = 0;
+  if (!ImapPollConnection || adata->poll_failed)
+    return NULL;
 
-  struct MailboxNode *np = NULL;
-  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  if (adata->poll && (adata->poll->state == IMAP_DISCONNECTED))
+    imap_extra_close(&adata->poll);
+
+  if (!adata->poll)
   {
-    /* Init newly-added mailboxes */
-    if (np->m->magic == MUTT_UNKNOWN)
+    adata->poll = imap_extra_open(adata);
+    if (!adata->poll)
     {
-      if (imap_path_probe(np->m->path, NULL) == MUTT_IMAP)
-        np->m->magic = MUTT_IMAP;
+      mutt_debug(1, "can't open a connection to check mailboxes on %s\n",
+                 adata->conn->account.host);
+      adata->poll_failed = true;
     }
+  }
 
-    if (np->m->magic != MUTT_IMAP)
-      continue;
+  return adata->poll;
+}
 
-    if (get_mailbox(np->m->path, &adata, name, sizeof(name)) < 0)
-    {
-      np->m->has_new = false;
-      continue;
-    }
+/**
+ * poll_idle - Has the server answered all the STATUS commands?
+ * @param pdata Imap Account data of the checking connection
+ * @retval true No commands are outstanding, or waiting to be sent
+ */
+static bool poll_idle(struct ImapAccountData *pdata)
+{
+  return (pdata->lastcmd == pdata->nextcmd);
+}
 
-    /* Don't issue STATUS on the selected mailbox, it will be NOOPed or
-     * IDLEd elsewhere.
-     * adata->mailbox may be NULL for connections other than the current
-     * mailbox's, and shouldn't expand to INBOX in that case. #3216. */
-    if (adata->mbox_name && (imap_mxcmp(name, adata->mbox_name) == 0))
-    {
-      np->m->has_new = false;
-      continue;
-    }
+/**
+ * poll_reserve - Make room in the command queue of a checking connection
+ * @param pdata Imap Account data of the checking connection
+ * @param count Number of commands to queue
+ *
+ * A full queue would be flushed, waiting for the server, so the queue is
+ * made big enough to hold a STATUS for every mailbox.
+ */
+static void poll_reserve(struct ImapAccountData *pdata, int count)
+{
+  if (pdata->cmdslots >= (count + 2))
+    return;
+
+  FREE(&pdata->cmds);
+  pdata->cmdslots = count + 2;
+  pdata->cmds = mutt_mem_calloc(pdata->cmdslots, sizeof(*pdata->cmds));
+  pdata->nextcmd = 0;
+  pdata->lastcmd = 0;
+}
+
+/**
+ * idle_find - Find the connection watching a mailbox
+ * @param adata Imap Account data
+ * @param name  Mailbox name
+ * @retval ptr  Watching connection
+ * @retval NULL The mailbox isn't being watched
+ */
+static struct ImapIdler *idle_find(struct ImapAccountData *adata, const char *name)
+{
+  for (int i = 0; i < adata->num_idlers; i++)
+  {
+    if (adata->idlers[i].adata && (imap_mxcmp(adata->idlers[i].name, name) == 0))
+      return &adata->idlers[i];
+  }
+
+  return NULL;
+}
+
+/**
+ * idle_parse - Look for changes in a line from a watching connection
+ * @param idler Watching connection
+ */
+static void idle_parse(struct ImapIdler *idler)
+{
+  char *s = idler->adata->buf;
+  unsigned int count = 0;
+
+  if ((s[0] != '*') || !mutt_str_atoui(imap_next_word(s), &count))
+    return;
+
+  s = imap_next_word(imap_next_word(s));
+  if (mutt_str_strncasecmp("EXISTS", s, 6) == 0)
+  {
+    if (count != idler->exists)
+      idler->changed = true;
+    idler->exists = count;
+  }
+  else if (mutt_str_strncasecmp("EXPUNGE", s, 7) == 0)
+  {
+    idler->changed = true;
+    if (idler->exists > 0)
+      idler->exists--;
+  }
+}
+
+/**
+ * idle_enter - Start waiting for changes on a watching connection
+ * @param idler Watching connection
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int idle_enter(struct ImapIdler *idler)
+{
+  if (imap_cmd_start(idler->adata, "IDLE") < 0)
+    return -1;
+
+  int rc;
+  while ((rc = imap_cmd_step(idler->adata)) == IMAP_CMD_CONTINUE)
+    idle_parse(idler);
+  if (rc != IMAP_CMD_RESPOND)
+    return -1;
+
+  idler->since = time(NULL);
+  return 0;
+}
+
+/**
+ * idle_leave - Stop waiting for changes on a watching connection
+ * @param idler Watching connection
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int idle_leave(struct ImapIdler *idler)
+{
+  if (mutt_socket_send(idler->adata->conn, "DONE\r\n") < 0)
+    return -1;
+
+  int rc;
+  while ((rc = imap_cmd_step(idler->adata)) == IMAP_CMD_CONTINUE)
+    idle_parse(idler);
+
+  return (rc == IMAP_CMD_OK) ? 0 : -1;
+}
+
+/**
+ * idle_open - Start watching a mailbox
+ * @param adata Imap Account data
+ * @param idler Watching connection to set up
+ * @param name  Mailbox name
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * The mailbox is EXAMINEd, but the connection's state is left alone, so that
+ * the server's replies aren't mistaken for changes to the selected mailbox.
+ */
+static int idle_open(struct ImapAccountData *adata, struct ImapIdler *idler,
+                     const char *name)
+{
+  idler->name = mutt_str_strdup(name);
+  idler->adata = imap_extra_open(adata);
+  if (!idler->adata)
+    return -1;
+
+  char buf[LONG_STRING];
+  char *cmd = NULL;
+  imap_munge_mbox_name(idler->adata, buf, sizeof(buf), name);
+  safe_asprintf(&cmd, "EXAMINE %s", buf);
+  int rc = imap_cmd_start(idler->adata, cmd);
+  FREE(&cmd);
+  if (rc < 0)
+    return -1;
+
+  while ((rc = imap_cmd_step(idler->adata)) == IMAP_CMD_CONTINUE)
+    idle_parse(idler);
+  if (rc != IMAP_CMD_OK)
+    return -1;
+
+  /* the mailbox has just been checked */
+  idler->changed = false;
+
+  return idle_enter(idler);
+}
+
+/**
+ * idle_update - Match the watching connections to the list of mailboxes
+ * @param adata Imap Account data
+ *
+ * Watch the first $imap_idle_connections mailboxes of the account, other than
+ * the selected one.
+ */
+static void idle_update(struct ImapAccountData *adata)
+{
+  struct ListHead wanted = STAILQ_HEAD_INITIALIZER(wanted);
+  char name[LONG_STRING];
+  int count = 0;
+
+  if (ImapIdle && mutt_bit_isset(adata->capabilities, IDLE) &&
+      (adata->state >= IMAP_AUTHENTICATED))
+  {
+    struct MailboxNode *np = NULL;
+    STAILQ_FOREACH(np, &AllMailboxes, entries)
+    {
+      if (count >= ImapIdleConnections)
+        break;
+
+      struct ImapMbox mx;
+      if ((np->m->magic != MUTT_IMAP) || (imap_parse_path(np->m->path, &mx) != 0))
+        continue;
+
+      if (imap_account_match(&adata->conn->account, &mx.account))
+      {
+        imap_fix_path(adata, mx.mbox, name, sizeof(name));
+        if (!*name)
+          mutt_str_strfcpy(name, "INBOX", sizeof(name));
+        if (!adata->mbox_name || (imap_mxcmp(name, adata->mbox_name) != 0))
+        {
+          mutt_list_insert_tail(&wanted, mutt_str_strdup(name));
+          count++;
+        }
+      }
+      FREE(&mx.mbox);
+    }
+  }
+
+  /* stop watching mailboxes that have been dropped, or opened */
+  for (int i = 0; i < adata->num_idlers;)
+  {
+    struct ImapIdler *idler = &adata->idlers[i];
+    if (idler->adata && mutt_list_find(&wanted, idler->name))
+    {
+      i++;
+      continue;
+    }
+
+    imap_extra_close(&idler->adata);
+    FREE(&idler->name);
+    adata->idlers[i] = adata->idlers[--adata->num_idlers];
+  }
+
+  if ((count > adata->num_idlers) && !adata->idle_failed)
+  {
+    mutt_mem_realloc(&adata->idlers, count * sizeof(struct ImapIdler));
+
+    struct ListNode *np = NULL;
+    STAILQ_FOREACH(np, &wanted, entries)
+    {
+      if (idle_find(adata, np->data))
+        continue;
+
+      struct ImapIdler *idler = &adata->idlers[adata->num_idlers];
+      memset(idler, 0, sizeof(*idler));
+      if (idle_open(adata, idler, np->data) < 0)
+      {
+        mutt_debug(1, "can't watch %s on %s\n", np->data, adata->conn->account.host);
+        imap_extra_close(&idler->adata);
+        FREE(&idler->name);
+        adata->idle_failed = true;
+        break;
+      }
+      adata->num_idlers++;
+    }
+  }
+
+  mutt_list_free(&wanted);
+}
+
+/**
+ * idle_service - Collect the changes reported by the watching connections
+ * @param adata Imap Account data
+ * @retval true A mailbox has changed, and its STATUS has been fetched
+ *
+ * The changes are read without waiting.  A changed mailbox gets one STATUS on
+ * the main connection, to bring its counts up to date.
+ */
+static bool idle_service(struct ImapAccountData *adata)
+{
+  char command[LONG_STRING * 2];
+  char munged[LONG_STRING];
+  bool queued = false;
+
+  for (int i = 0; i < adata->num_idlers; i++)
+  {
+    struct ImapIdler *idler = &adata->idlers[i];
+    if (!idler->adata)
+      continue;
+
+    while (mutt_socket_poll(idler->adata->conn, 0) > 0)
+    {
+      if (imap_cmd_step(idler->adata) != IMAP_CMD_CONTINUE)
+      {
+        mutt_debug(1, "lost the connection watching %s\n", idler->name);
+        imap_extra_close(&idler->adata);
+        /* fall back to STATUS */
+        idler->changed = false;
+        break;
+      }
+      idle_parse(idler);
+    }
+
+    /* servers drop connections that IDLE for too long */
+    if (idler->adata && ImapKeepalive && (time(NULL) >= (idler->since + ImapKeepalive)) &&
+        ((idle_leave(idler) < 0) || (idle_enter(idler) < 0)))
+    {
+      imap_extra_close(&idler->adata);
+    }
+
+    if (!idler->changed)
+      continue;
+
+    idler->changed = false;
+    imap_munge_mbox_name(adata, munged, sizeof(munged), idler->name);
+    snprintf(command, sizeof(command),
+             "STATUS %s (UIDNEXT UIDVALIDITY UNSEEN RECENT MESSAGES)", munged);
+    if (imap_exec(adata, command, IMAP_CMD_QUEUE | IMAP_CMD_POLL) < 0)
+      mutt_debug(1, "Error queueing command\n");
+    else
+      queued = true;
+  }
+
+  if (queued && (imap_exec(adata, NULL, IMAP_CMD_FAIL_OK | IMAP_CMD_POLL) < 0))
+  {
+    mutt_debug(1, "Error checking watched mailboxes\n");
+    return false;
+  }
+
+  return queued;
+}
+
+/**
+ * imap_mailbox_poll - Collect the results of a background mailbox check
+ * @retval >=0 Number of mailboxes with new mail, a check has just finished
+ * @retval  -1 No new results
+ *
+ * Read the STATUS replies that have already arrived on the checking
+ * connections (see $imap_poll_connection), without waiting for any more.
+ * Also pick up the changes reported by the watching connections (see
+ * $imap_idle_connections).
+ */
+int imap_mailbox_poll(void)
+{
+  bool finished = false;
+
+  struct ConnectionList *head = mutt_socket_head();
+  struct Connection *conn = NULL;
+  TAILQ_FOREACH(conn, head, entries)
+  {
+    if ((conn->account.type != MUTT_ACCT_TYPE_IMAP) || !conn->data)
+      continue;
+
+    if (idle_service(conn->data))
+      finished = true;
+
+    struct ImapAccountData *pdata = ((struct ImapAccountData *) conn->data)->poll;
+    if (!pdata || (pdata->state == IMAP_DISCONNECTED) || poll_idle(pdata) ||
+        (pdata->cmdbuf->dptr != pdata->cmdbuf->data))
+    {
+      continue;
+    }
+
+    while (mutt_socket_poll(pdata->conn, 0) > 0)
+    {
+      if (imap_cmd_step(pdata) != IMAP_CMD_CONTINUE)
+      {
+        finished = true;
+        break;
+      }
+    }
+  }
+
+  if (!finished)
+    return -1;
+
+  int count = 0;
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    if ((np->m->magic == MUTT_IMAP) && np->m->has_new)
+      count++;
+  }
+
+  return count;
+}
+
+/**
+ * imap_mailbox_check - Check for new mail in subscribed folders
+ * @param check_stats Check for message stats too
+ * @retval num Number of mailboxes with new mail
+ * @retval 0   Failure
+ *
+ * Given a list of mailboxes rather than called once for each so that it can
+ * batch the commands and save on round trips.
+ *
+ * With $imap_poll_connection, the commands are sent over a separate
+ * connection and not waited for.  The mailboxes are updated as the replies
+ * arrive, see imap_mailbox_poll().
+ *
+ * With $imap_idle_connections, the first few mailboxes of each server are
+ * watched with IDLE instead.
+ */
+int imap_mailbox_check(bool check_stats)
+{
+  struct ImapAccountData *adata = NULL;
+  struct ImapAccountData *lastdata = NULL;
+  char name[LONG_STRING];
+  char command[LONG_STRING * 2];
+  char munged[LONG_STRING];
+  int mbcount = 0;
+
+  /* pick up the replies to an earlier check */
+  imap_mailbox_poll();
+
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+    mbcount++;
+
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    /* Init newly-added mailboxes */
+    if (np->m->magic == MUTT_UNKNOWN)
+    {
+      if (imap_path_probe(np->m->path, NULL) == MUTT_IMAP)
+        np->m->magic = MUTT_IMAP;
+    }
+
+    if (np->m->magic != MUTT_IMAP)
+      continue;
+
+    if (get_mailbox(np->m->path, &adata, name, sizeof(name)) < 0)
+    {
+      np->m->has_new = false;
+      continue;
+    }
+
+    /* Don't issue STATUS on the selected mailbox, it will be NOOPed or
+     * IDLEd elsewhere.
+     * adata->mailbox may be NULL for connections other than the current
+     * mailbox's, and shouldn't expand to INBOX in that case. #3216. */
+    if (adata->mbox_name && (imap_mxcmp(name, adata->mbox_name) == 0))
+    {
+      np->m->has_new = false;
+      continue;
+    }
+
+    /* the server reports changes on the watching connection */
+    if (idle_find(adata, name))
+      continue;
 
     if (!mutt_bit_isset(adata->capabilities, IMAP4REV1) &&
         !mutt_bit_isset(adata->capabilities, STATUS))
@@ -1488,6 +2193,23 @@ int imap_mailbox_check(bool check_stats)
       continue;
     }
 
+    struct ImapAccountData *pdata = poll_conn(adata);
+    if (pdata)
+    {
+      if (poll_idle(pdata))
+        poll_reserve(pdata, mbcount);
+      /* the replies to the last check haven't all arrived */
+      else if (pdata->cmdbuf->dptr == pdata->cmdbuf->data)
+        continue;
+
+      imap_munge_mbox_name(adata, munged, sizeof(munged), name);
+      snprintf(command, sizeof(command), "STATUS %s (UIDNEXT UIDVALIDITY UNSEEN RECENT%s)",
+               munged, check_stats ? " MESSAGES" : "");
+      if (imap_exec(pdata, command, IMAP_CMD_QUEUE) < 0)
+        mutt_debug(1, "Error queueing command\n");
+      continue;
+    }
+
     if (lastdata && adata != lastdata)
     {
       /* Send commands to previous server. Sorting the mailbox list
@@ -1526,7 +2248,26 @@ int imap_mailbox_check(bool check_stats)
     return 0;
   }
 
+  /* start watching mailboxes, and send the STATUS commands queued on the
+   * checking connections */
+  struct ConnectionList *head = mutt_socket_head();
+  struct Connection *conn = NULL;
+  TAILQ_FOREACH(conn, head, entries)
+  {
+    if ((conn->account.type != MUTT_ACCT_TYPE_IMAP) || !conn->data)
+      continue;
+
+    adata = conn->data;
+    idle_update(adata);
+    if (adata->poll && (adata->poll->cmdbuf->dptr != adata->poll->cmdbuf->data) &&
+        (imap_cmd_start(adata->poll, NULL) < 0))
+    {
+      mutt_debug(1, "Error sending STATUS to %s\n", conn->account.host);
+    }
+  }
+
   /* collect results */
+  mbcount = 0;
   STAILQ_FOREACH(np, &AllMailboxes, entries)
   {
     if ((np->m->magic == MUTT_IMAP) && np->m->has_new)
@@ -1715,6 +2456,269 @@ int imap_search(struct Mailbox *mailbox, const struct Pattern *pat)
   return 0;
 }
 
+/**
+ * imap_sort_key - Get the SORT key for a sort method
+ * @param method Sort method, e.g. #SORT_DATE
+ * @retval ptr  Sort key, e.g. "DATE"
+ * @retval NULL The server can't sort this way
+ *
+ * Only the keys that order the emails the same way as NeoMutt are used.  The
+ * server's FROM and TO, for example, sort by mailbox rather than by name.
+ */
+static const char *imap_sort_key(short method)
+{
+  switch (method & SORT_MASK)
+  {
+    case SORT_DATE:
+      return "DATE";
+    case SORT_RECEIVED:
+      return "ARRIVAL";
+    case SORT_SIZE:
+      return "SIZE";
+    case SORT_SUBJECT:
+      return "SUBJECT";
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * imap_sort_adata - Can the server sort this mailbox?
+ * @param mailbox Mailbox
+ * @param cap     Capability needed, e.g. #SORT
+ * @retval ptr  Imap Account data
+ * @retval NULL Sort the mailbox locally
+ */
+static struct ImapAccountData *imap_sort_adata(struct Mailbox *mailbox, enum ImapCaps cap)
+{
+  if (!ImapServerSort)
+    return NULL;
+
+  struct ImapAccountData *adata = imap_get_adata(mailbox);
+  if (!adata || (adata->state < IMAP_SELECTED) || !adata->ctx ||
+      (adata->ctx->mailbox != mailbox) || !mutt_bit_isset(adata->capabilities, cap))
+  {
+    return NULL;
+  }
+
+  return adata;
+}
+
+/**
+ * imap_sort_exec - Run a SORT or THREAD command
+ * @param adata Imap Account data
+ * @param cmd   Command to run
+ * @param reply Buffer for the untagged replies
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int imap_sort_exec(struct ImapAccountData *adata, const char *cmd, struct Buffer *reply)
+{
+  adata->cmdtype = IMAP_CT_SORT;
+  adata->cmddata = reply;
+  int rc = imap_exec(adata, cmd, IMAP_CMD_FAIL_OK);
+  adata->cmddata = NULL;
+  adata->cmdtype = IMAP_CT_NONE;
+
+  if (rc < 0)
+  {
+    mutt_debug(1, "%s failed, sorting locally\n", cmd);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * imap_sort_mailbox - Ask the server to sort a mailbox
+ * @param mailbox  Mailbox
+ * @param sort     Sort method, e.g. #SORT_DATE
+ * @param sort_aux Secondary sort method
+ * @retval  0 Success, Mailbox::hdrs is in the new order
+ * @retval -1 The mailbox must be sorted locally
+ *
+ * This uses the SORT extension (RFC5256), if $imap_server_sort is set.
+ * Emails that sort the same are left in the server's order.
+ */
+int imap_sort_mailbox(struct Mailbox *mailbox, short sort, short sort_aux)
+{
+  struct ImapAccountData *adata = imap_sort_adata(mailbox, SORT);
+  if (!adata)
+    return -1;
+
+  const char *key = imap_sort_key(sort);
+  const char *aux = NULL;
+  if ((sort_aux & SORT_MASK) != SORT_ORDER)
+    aux = imap_sort_key(sort_aux);
+  if (!key || (((sort_aux & SORT_MASK) != SORT_ORDER) && !aux))
+    return -1;
+  if ((sort_aux & SORT_MASK) == (sort & SORT_MASK))
+    aux = NULL;
+
+  /* NeoMutt reverses the whole comparison, including the secondary one */
+  const bool reverse = (sort & SORT_REVERSE);
+  const bool reverse_aux = ((sort_aux & SORT_REVERSE) != 0) != reverse;
+
+  char cmd[STRING];
+  snprintf(cmd, sizeof(cmd), "UID SORT (%s%s%s%s%s) UTF-8 ALL",
+           reverse ? "REVERSE " : "", key, aux ? " " : "",
+           (aux && reverse_aux) ? "REVERSE " : "", NONULL(aux));
+
+  struct Buffer *reply = mutt_buffer_pool_get();
+  struct Email **order = NULL;
+  bool *seen = NULL;
+  int rc = -1;
+
+  if ((imap_sort_exec(adata, cmd, reply) < 0) || !reply->data)
+    goto done;
+
+  order = mutt_mem_calloc(mailbox->msg_count, sizeof(struct Email *));
+  seen = mutt_mem_calloc(mailbox->msg_count, sizeof(bool));
+  int count = 0;
+  unsigned int uid;
+
+  for (const char *s = imap_next_word(reply->data); *s; s = imap_next_word((char *) s))
+  {
+    if (mutt_str_atoui(s, &uid) < 0)
+      continue;
+    struct Email *e = mutt_hash_int_find(adata->uid_hash, uid);
+    /* ignore new mail that hasn't been fetched yet */
+    if (!e || (e->index < 0) || (e->index >= mailbox->msg_count) || seen[e->index])
+      continue;
+    seen[e->index] = true;
+    order[count++] = e;
+  }
+
+  if (count != mailbox->msg_count)
+  {
+    mutt_debug(1, "SORT returned %d of %d emails, sorting locally\n", count,
+               mailbox->msg_count);
+    goto done;
+  }
+
+  memcpy(mailbox->hdrs, order, count * sizeof(struct Email *));
+  mutt_debug(2, "server sorted %d emails\n", count);
+  rc = 0;
+
+done:
+  FREE(&seen);
+  FREE(&order);
+  mutt_buffer_pool_release(&reply);
+  return rc;
+}
+
+/**
+ * imap_thread_mailbox - Ask the server to thread a mailbox
+ * @param[in]  mailbox Mailbox
+ * @param[out] nodes   Thread tree, in depth-first order
+ * @retval num Number of nodes
+ * @retval -1  The mailbox must be threaded locally
+ *
+ * This uses THREAD=REFERENCES (RFC5256), if $imap_server_sort is set.  Every
+ * email appears in exactly one node.  A message the server groups emails under
+ * without giving it, is a node without an email.
+ */
+int imap_thread_mailbox(struct Mailbox *mailbox, struct ThreadNode **nodes)
+{
+  struct ImapAccountData *adata = imap_sort_adata(mailbox, THREAD_REFERENCES);
+  if (!adata || !nodes)
+    return -1;
+
+  struct Buffer *reply = mutt_buffer_pool_get();
+  bool *seen = NULL;
+  int *stack = NULL;
+  int num = 0, max = 0, depth = 0, count = 0;
+  bool ok = false;
+
+  if ((imap_sort_exec(adata, "UID THREAD REFERENCES UTF-8 ALL", reply) < 0) ||
+      !reply->data)
+  {
+    goto done;
+  }
+
+  seen = mutt_mem_calloc(mailbox->msg_count, sizeof(bool));
+  /* no list can be nested deeper than the reply is long */
+  stack = mutt_mem_calloc(mutt_str_strlen(reply->data) + 1, sizeof(int));
+  int cur = -1; /* node the next message is attached to */
+
+  for (const char *s = reply->data; *s;)
+  {
+    if (*s == ' ')
+    {
+      s++;
+    }
+    else if (*s == '(')
+    {
+      stack[depth++] = cur;
+      s++;
+      /* a list that starts with a list groups its members under a missing message */
+      if (*s == '(')
+      {
+        if (num == max)
+        {
+          max = max ? (max * 2) : 256;
+          mutt_mem_realloc(nodes, max * sizeof(struct ThreadNode));
+        }
+        (*nodes)[num].parent = cur;
+        (*nodes)[num].email = NULL;
+        cur = num++;
+      }
+    }
+    else if (*s == ')')
+    {
+      if (depth == 0)
+        goto done;
+      cur = stack[--depth];
+      s++;
+    }
+    else if (isdigit((unsigned char) *s))
+    {
+      char *end = NULL;
+      unsigned int uid = strtoul(s, &end, 10);
+      s = end;
+      struct Email *e = mutt_hash_int_find(adata->uid_hash, uid);
+      if (e && ((e->index < 0) || (e->index >= mailbox->msg_count) || seen[e->index]))
+        goto done;
+      if (e)
+      {
+        seen[e->index] = true;
+        count++;
+      }
+      if (num == max)
+      {
+        max = max ? (max * 2) : 256;
+        mutt_mem_realloc(nodes, max * sizeof(struct ThreadNode));
+      }
+      /* new mail that hasn't been fetched yet is treated as missing */
+      (*nodes)[num].parent = cur;
+      (*nodes)[num].email = e;
+      cur = num++;
+    }
+    else
+    {
+      goto done;
+    }
+  }
+
+  ok = (depth == 0) && (count == mailbox->msg_count);
+  if (!ok)
+  {
+    mutt_debug(1, "THREAD returned %d of %d emails, threading locally\n",
+               count, mailbox->msg_count);
+  }
+
+done:
+  FREE(&stack);
+  FREE(&seen);
+  mutt_buffer_pool_release(&reply);
+  if (!ok)
+  {
+    FREE(nodes);
+    return -1;
+  }
+  mutt_debug(2, "server threaded %d emails in %d nodes\n", count, num);
+  return num;
+}
+
 /**
  * imap_subscribe - Subscribe to a mailbox
  * @param path      Mailbox path
@@ -1769,6 +2773,7 @@ int imap_subscribe(char *path, bool subscribe)
   if (imap_exec(adata, buf, 0) < 0)
     goto fail;
 
+  imap_list_cache_clear(adata);
   imap_unmunge_mbox_name(adata, mx.mbox);
   if (subscribe)
     mutt_message(_("Subscribed to %s"), mx.mbox);
@@ -1897,7 +2902,6 @@ int imap_fast_trash(struct Mailbox *mailbox, char *dest)
   int rc;
   struct ImapMbox mx;
   bool triedcreate = false;
-  struct Buffer *sync_cmd = NULL;
   int err_continue = MUTT_NO;
 
   struct ImapAccountData *adata = imap_get_adata(mailbox);
@@ -1920,19 +2924,11 @@ int imap_fast_trash(struct Mailbox *mailbox, char *dest)
     mutt_str_strfcpy(mbox, "INBOX", sizeof(mbox));
   imap_munge_mbox_name(adata, mmbox, sizeof(mmbox), mbox);
 
-  sync_cmd = mutt_buffer_new();
-  for (int i = 0; i < mailbox->msg_count; i++)
+  rc = imap_sync_msgset_for_copy(adata, MUTT_TRASH, &err_continue);
+  if (rc < 0)
   {
-    if (mailbox->hdrs[i]->active && mailbox->hdrs[i]->changed &&
-        mailbox->hdrs[i]->deleted && !mailbox->hdrs[i]->purge)
-    {
-      rc = imap_sync_message_for_copy(adata, mailbox->hdrs[i], sync_cmd, &err_continue);
-      if (rc < 0)
-      {
-        mutt_debug(1, "could not sync\n");
-        goto out;
-      }
-    }
+    mutt_debug(1, "could not sync\n");
+    goto out;
   }
 
   /* loop in case of TRYCREATE */
@@ -1990,7 +2986,6 @@ int imap_fast_trash(struct Mailbox *mailbox, char *dest)
   rc = 0;
 
 out:
-  mutt_buffer_free(&sync_cmd);
   FREE(&mx.mbox);
 
   return (rc < 0) ? -1 : rc;
@@ -2250,6 +3245,8 @@ static int imap_mbox_open(struct Context *ctx)
   memset(adata->ctx->mailbox->rights, 0, sizeof(adata->ctx->mailbox->rights));
   adata->new_mail_count = 0;
   adata->max_msn = 0;
+  adata->header_last = 0;
+  adata->header_window = 0;
 
   mutt_message(_("Selecting %s..."), adata->mbox_name);
   imap_munge_mbox_name(adata, buf, sizeof(buf), adata->mbox_name);
@@ -2554,6 +3551,7 @@ static int imap_mbox_close(struct Context *ctx)
     adata->ctx = NULL;
 
     mutt_hash_destroy(&adata->uid_hash);
+    imap_msn_compact(adata);
     FREE(&adata->msn_index);
     adata->msn_index_size = 0;
     adata->max_msn = 0;
@@ -2837,11 +3835,14 @@ struct MxOps mx_imap_ops = {
   .mbox_check       = imap_mbox_check,
   .mbox_sync        = NULL, /* imap syncing is handled by imap_sync_mailbox */
   .mbox_close       = imap_mbox_close,
+  .mbox_flush       = NULL,
   .msg_open         = imap_msg_open,
   .msg_open_new     = imap_msg_open_new,
   .msg_commit       = imap_msg_commit,
   .msg_close        = imap_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = imap_msg_load_header,
+  .msg_save_hcache  = imap_msg_save_hcache,
   .tags_edit        = imap_tags_edit,
   .tags_commit      = imap_tags_commit,
   .path_probe       = imap_path_probe,
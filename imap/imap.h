@@ -57,15 +57,28 @@ struct BrowserState;
 struct Context;
 struct Email;
 struct Pattern;
+struct ThreadNode;
 
 /* These Config Variables are only used in imap/auth.c */
 extern char *ImapAuthenticators;
 
+/* These Config Variables are only used in imap/browse.c */
+extern short ImapListCacheTimeout;
+
 /* These Config Variables are only used in imap/imap.c */
+extern bool ImapDeflate;
 extern bool ImapIdle;
+extern short ImapIdleConnections;
+extern bool ImapPollConnection;
+extern bool ImapServerSort;
 
 /* These Config Variables are only used in imap/message.c */
+extern short ImapFetchChunkSize;
+extern short ImapFetchConnections;
 extern char *ImapHeaders;
+extern bool ImapLazyHeaders;
+extern long ImapPartialFetch;
+extern short ImapPrefetch;
 
 /* These Config Variables are only used in imap/command.c */
 extern bool ImapServernoise;
@@ -89,8 +102,11 @@ int imap_check_mailbox(struct Mailbox *mailbox, bool force);
 int imap_delete_mailbox(struct Mailbox *mailbox, struct ImapMbox *mx);
 int imap_sync_mailbox(struct Context *ctx, bool expunge);
 int imap_mailbox_check(bool check_stats);
+int imap_mailbox_poll(void);
 int imap_status(const char *path, bool queue);
 int imap_search(struct Mailbox *mailbox, const struct Pattern *pat);
+int imap_sort_mailbox(struct Mailbox *mailbox, short sort, short sort_aux);
+int imap_thread_mailbox(struct Mailbox *mailbox, struct ThreadNode **nodes);
 int imap_subscribe(char *path, bool subscribe);
 int imap_complete(char *buf, size_t buflen, char *path);
 int imap_fast_trash(struct Mailbox *mailbox, char *dest);
@@ -102,9 +118,11 @@ extern struct MxOps mx_imap_ops;
 int imap_browse(char *path, struct BrowserState *state);
 int imap_mailbox_create(const char *folder);
 int imap_mailbox_rename(const char *mailbox);
+void imap_list_cache_flush(const char *path);
 
 /* message.c */
 int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool delete);
+void imap_prefetch(struct Context *ctx, struct Email *cur);
 
 /* socket.c */
 void imap_logout_all(void);
@@ -116,8 +134,12 @@ void imap_pretty_mailbox(char *path, const char *folder);
 
 int imap_wait_keepalive(pid_t pid);
 void imap_keepalive(void);
+int imap_collect(void);
 
 void imap_get_parent_path(const char *path, char *buf, size_t buflen);
 void imap_clean_path(char *path, size_t plen);
+#ifdef USE_HCACHE
+void imap_hcache_prefetch(const char *path);
+#endif
 
 #endif /* MUTT_IMAP_IMAP_H */
@@ -36,9 +36,11 @@ struct ConnAccount;
 struct Context;
 struct Email;
 struct ImapEmailData;
+struct ImapListReply;
 struct ImapMbox;
 struct Mailbox;
 struct Message;
+struct MsnExpunge;
 struct Progress;
 
 /* -- symbols -- */
@@ -61,6 +63,12 @@ struct Progress;
 /* number of entries in the hash table */
 #define IMAP_CACHE_LEN 10
 
+/* number of MSNs in each header cache record of the UID Sequence Set */
+#define IMAP_SEQSET_CHUNK 1024
+
+/* seconds to trust the cached capabilities of a server */
+#define IMAP_SERVER_CACHE_AGE (24 * 60 * 60)
+
 #define SEQLEN 5
 /* maximum length of command lines before they must be split (for
  * lazy servers) */
@@ -138,6 +146,10 @@ enum ImapCaps
   ENABLE,                /**< RFC5161 */
   CONDSTORE,             /**< RFC7162 */
   QRESYNC,               /**< RFC7162 */
+  COMPRESS_DEFLATE,      /**< RFC4978: COMPRESS=DEFLATE */
+  MOVE,                  /**< RFC6851: MOVE */
+  SORT,                  /**< RFC5256: SORT */
+  THREAD_REFERENCES,     /**< RFC5256: THREAD=REFERENCES */
   X_GM_EXT1,             /**< https://developers.google.com/gmail/imap/imap-extensions */
   X_GM_ALT1 = X_GM_EXT1, /**< Alternative capability string */
 
@@ -155,6 +167,7 @@ struct ImapCache
 {
   unsigned int uid;
   char *path;
+  bool partial; /**< Only the beginning of the message is cached */
 };
 
 /**
@@ -192,6 +205,18 @@ struct ImapCommand
   int state;            ///< Command state, e.g. #IMAP_CMD_NEW
 };
 
+/**
+ * struct ImapIdler - A connection watching a mailbox with IDLE
+ */
+struct ImapIdler
+{
+  struct ImapAccountData *adata; ///< Connection, see imap_extra_open()
+  char *name;                    ///< Mailbox being watched
+  unsigned int exists;           ///< Number of messages the server last reported
+  time_t since;                  ///< When IDLE was last started
+  bool changed;                  ///< The mailbox needs a new STATUS
+};
+
 /**
  * enum ImapCommandType - IMAP command type
  */
@@ -199,7 +224,8 @@ enum ImapCommandType
 {
   IMAP_CT_NONE = 0,
   IMAP_CT_LIST,
-  IMAP_CT_STATUS
+  IMAP_CT_STATUS,
+  IMAP_CT_SORT, ///< SORT or THREAD, the reply is appended to a Buffer
 };
 
 /**
@@ -223,6 +249,8 @@ struct ImapAccountData
    * it's just no fun to get the same information twice */
   char *capstr;
   unsigned char capabilities[(CAPMAX + 7) / 8];
+  bool caps_seen; ///< CAPABILITY was parsed since this was cleared
+  char *greeting; ///< The server's greeting, see imap_hcache_server_fetch()
   unsigned int seqno; ///< tag sequence number, e.g. 'a0001'
   time_t lastread; /**< last time we read a command for the server */
   char *buf;
@@ -242,10 +270,20 @@ struct ImapAccountData
   int nextcmd;
   int lastcmd;
   struct Buffer *cmdbuf;
+  bool background; ///< Commands were sent without waiting, see imap_cmd_collect()
 
   /* cache ImapStatus of visited mailboxes */
   struct ListHead mboxcache;
 
+  /* cache replies to LIST and LSUB, see $imap_list_cache_timeout */
+  STAILQ_HEAD(ImapListReplyHead, ImapListReply) lists;
+
+  struct ImapAccountData *poll; ///< Connection for checking other mailboxes
+  bool poll_failed;             ///< The server refused the checking connection
+  struct ImapIdler *idlers;     ///< Connections watching other mailboxes
+  int num_idlers;               ///< Number of idlers
+  bool idle_failed;             ///< The server refused a watching connection
+
   /* The following data is all specific to the currently SELECTED mbox */
   char delim;
   struct Context *ctx;
@@ -261,10 +299,27 @@ struct ImapAccountData
   struct Email **msn_index;   /**< look up headers by (MSN-1) */
   size_t msn_index_size;       /**< allocation size */
   unsigned int max_msn;        /**< the largest MSN fetched so far */
+  struct MsnExpunge *msn_expunged; /**< expunges not yet applied to the msn_index */
   struct BodyCache *bcache;
 
+  /* header downloads, tuned as they run */
+  unsigned int fetch_chunk; ///< Headers to ask for in each FETCH
+  unsigned int fetch_depth; ///< FETCH commands to keep in flight
+  unsigned int fetch_rtt;   ///< Smoothed round-trip time, in ms
+  unsigned int fetch_rate;  ///< Smoothed speed, in headers per second
+
+  /* headers read on demand, see $imap_lazy_headers */
+  int header_last;            ///< Index position of the last email read on demand
+  unsigned int header_window; ///< Number of headers read with it
+
   /* all folder flags - system AND custom flags */
   struct ListHead flags;
+
+  /* mailbox names converted by imap_utf_encode() and imap_utf_decode() */
+  struct Hash *utf_encode_cache; ///< Local name to server name
+  struct Hash *utf_decode_cache; ///< Server name to local name
+  char *utf_cache_charset;       ///< $charset when the caches were filled
+  bool utf_cache_unicode;        ///< ImapAccountData::unicode when they were filled
 #ifdef USE_HCACHE
   header_cache_t *hcache;
 #endif
@@ -297,10 +352,15 @@ int imap_exec_msgset(struct ImapAccountData *adata, const char *pre, const char
 int imap_open_connection(struct ImapAccountData *adata);
 void imap_close_connection(struct ImapAccountData *adata);
 struct ImapAccountData *imap_conn_find(const struct ConnAccount *account, int flags);
+void imap_compress(struct ImapAccountData *adata);
+struct ImapAccountData *imap_extra_open(struct ImapAccountData *adata);
+void imap_extra_close(struct ImapAccountData **edata);
 int imap_read_literal(FILE *fp, struct ImapAccountData *adata, unsigned long bytes, struct Progress *pbar);
+int imap_read_literal_buf(struct Buffer *buf, struct ImapAccountData *adata, unsigned long bytes);
 void imap_expunge_mailbox(struct ImapAccountData *adata);
 void imap_logout(struct ImapAccountData **adata);
 int imap_sync_message_for_copy(struct ImapAccountData *adata, struct Email *e, struct Buffer *cmd, int *err_continue);
+int imap_sync_msgset_for_copy(struct ImapAccountData *adata, int flag, int *err_continue);
 bool imap_has_flag(struct ListHead *flag_list, const char *flag);
 
 /* auth.c */
@@ -310,10 +370,14 @@ int imap_authenticate(struct ImapAccountData *adata);
 int imap_cmd_start(struct ImapAccountData *adata, const char *cmdstr);
 int imap_cmd_step(struct ImapAccountData *adata);
 void imap_cmd_finish(struct ImapAccountData *adata);
+void imap_msn_compact(struct ImapAccountData *adata);
+bool imap_cmd_pending(struct ImapAccountData *adata);
+int imap_cmd_collect(struct ImapAccountData *adata);
 bool imap_code(const char *s);
 const char *imap_cmd_trailer(struct ImapAccountData *adata);
 int imap_exec(struct ImapAccountData *adata, const char *cmdstr, int flags);
 int imap_cmd_idle(struct ImapAccountData *adata);
+void imap_cmd_set_capabilities(struct ImapAccountData *adata, const char *capstr);
 
 /* message.c */
 void imap_free_emaildata(void **data);
@@ -321,12 +385,18 @@ int imap_read_headers(struct ImapAccountData *adata, unsigned int msn_begin, uns
 char *imap_set_flags(struct ImapAccountData *adata, struct Email *e, char *s, int *server_changes);
 int imap_cache_del(struct ImapAccountData *adata, struct Email *e);
 int imap_cache_clean(struct ImapAccountData *adata);
+int imap_prefetch_store(struct ImapAccountData *adata, struct Email *e, const char *s);
 int imap_append_message(struct Context *ctx, struct Message *msg);
 
 int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno);
+int imap_msg_load_header(struct Context *ctx, struct Email *e);
+int imap_msg_save_hcache(struct Context *ctx, struct Email *e);
 int imap_msg_close(struct Context *ctx, struct Message *msg);
 int imap_msg_commit(struct Context *ctx, struct Message *msg);
 
+/* browse.c */
+void imap_list_cache_clear(struct ImapAccountData *adata);
+
 /* util.c */
 struct ImapAccountData *imap_get_adata(struct Mailbox *m);
 #ifdef USE_HCACHE
@@ -338,6 +408,8 @@ int imap_hcache_del(struct ImapAccountData *adata, unsigned int uid);
 int imap_hcache_store_uid_seqset(struct ImapAccountData *adata);
 int imap_hcache_clear_uid_seqset(struct ImapAccountData *adata);
 char *imap_hcache_get_uid_seqset(struct ImapAccountData *adata);
+bool imap_hcache_server_fetch(struct ImapAccountData *adata);
+void imap_hcache_server_store(struct ImapAccountData *adata);
 #endif
 
 int imap_continue(const char *msg, const char *resp);
@@ -362,6 +434,7 @@ bool imap_account_match(const struct ConnAccount *a1, const struct ConnAccount *
 void imap_get_parent(const char *mbox, char delim, char *buf, size_t buflen);
 
 /* utf7.c */
+void imap_utf_cache_free(struct ImapAccountData *adata);
 void imap_utf_encode(struct ImapAccountData *adata, char **s);
 void imap_utf_decode(struct ImapAccountData *adata, char **s);
 void imap_allow_reopen(struct Context *ctx);
@@ -29,10 +29,14 @@
 
 #include "config.h"
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include "imap_private.h"
 #include "mutt/mutt.h"
@@ -41,6 +45,7 @@
 #include "conn/conn.h"
 #include "mutt.h"
 #include "message.h"
+#include "auth.h"
 #include "bcache.h"
 #include "context.h"
 #include "curs_lib.h"
@@ -53,6 +58,8 @@
 #include "mutt_socket.h"
 #include "muttlib.h"
 #include "mx.h"
+#include "ncrypt/ncrypt.h"
+#include "options.h"
 #include "progress.h"
 #include "protos.h"
 #ifdef USE_HCACHE
@@ -65,7 +72,67 @@
 struct BodyCache;
 
 /* These Config Variables are only used in imap/message.c */
+short ImapFetchChunkSize; ///< Config: (imap) Number of headers to ask for in each FETCH
+short ImapFetchConnections; ///< Config: (imap) Number of connections to download headers with
+long ImapPartialFetch; ///< Config: (imap) Only fetch the beginning of large messages for display
+short ImapPrefetch; ///< Config: (imap) Number of unread messages to read ahead into the message cache
 char *ImapHeaders; ///< Config: (imap) Additional email headers to download when getting index
+bool ImapLazyHeaders; ///< Config: (imap) Only download the headers of the emails being displayed
+
+#define IMAP_FETCH_CHUNK_MIN 64     ///< Fewest headers to ask for in a FETCH
+#define IMAP_FETCH_CHUNK_START 512  ///< Headers to ask for before anything is measured
+#define IMAP_FETCH_CHUNK_MAX 16384  ///< Most headers to ask for in a FETCH
+#define IMAP_FETCH_CHUNK_MS 500     ///< Time the server should spend answering a FETCH
+#define IMAP_FETCH_PARALLEL_MIN 4096 ///< Fewest headers worth opening more connections for
+#define IMAP_FETCH_LOGIN_RTTS 4      ///< Round trips to connect, log in and EXAMINE
+#define IMAP_HEADER_WINDOW 64        ///< Headers to fetch around an email that's displayed
+
+/**
+ * struct ImapFetchChunk - A FETCH of headers that the server hasn't finished
+ */
+struct ImapFetchChunk
+{
+  char seq[SEQLEN + 1]; ///< Command tag
+  unsigned int count;   ///< Number of headers asked for
+  long sent;            ///< When the command was sent, in ms
+};
+
+/**
+ * struct ImapFetchLane - The FETCH commands in flight on one connection
+ */
+struct ImapFetchLane
+{
+  struct ImapAccountData *adata; ///< Connection
+  struct ImapFetchChunk *chunks; ///< Ring of the commands in flight
+  unsigned int head;             ///< Oldest command in the ring
+  unsigned int inflight;         ///< Number of commands in the ring
+  unsigned int headers;          ///< Number of headers they ask for
+  long idle_sent;                ///< When a command was sent to an idle server
+  long last_done;                ///< When the last command finished
+  long unread_until;             ///< When the connection was last left unread
+};
+
+/**
+ * struct ImapFetchPipe - FETCH commands for a range of headers
+ *
+ * The range is split into chunks, and several are kept in flight, so that the
+ * server always has work while the replies travel back.
+ *
+ * The first lane is the mailbox's own connection.  With
+ * $$imap_fetch_connections, there are more, and each takes the next chunk of
+ * the range when it has room.
+ */
+struct ImapFetchPipe
+{
+  const char *hdrreq;           ///< Header fields to ask for
+  unsigned int msn_next;        ///< First MSN that hasn't been asked for
+  unsigned int msn_end;         ///< Last MSN wanted
+  struct ImapFetchLane *lanes;  ///< Connections
+  int num_lanes;                ///< Number of connections
+  int cur;                      ///< Connection that was read from last
+  struct pollfd *fds;           ///< For waiting on the connections
+  bool lost;                    ///< A connection failed, so headers may be missing
+};
 
 /**
  * new_emaildata - Create a new ImapEmailData
@@ -376,25 +443,23 @@ static int msg_parse_fetch(struct ImapHeader *h, char *s)
 
 /**
  * msg_fetch_header - import IMAP FETCH response into an ImapHeader
- * @param mailbox Mailbox
+ * @param adata   Imap Account data of the connection
  * @param h       ImapHeader
  * @param buf     Server string containing FETCH response
- * @param fp      Connection to server
+ * @param hdr     Buffer for the header literal, or NULL to ignore it
  * @retval  0 Success
  * @retval -1 String is not a fetch response
  * @retval -2 String is a corrupt fetch response
  *
  * Expects string beginning with * n FETCH.
  */
-static int msg_fetch_header(struct Mailbox *mailbox, struct ImapHeader *h,
-                            char *buf, FILE *fp)
+static int msg_fetch_header(struct ImapAccountData *adata, struct ImapHeader *h,
+                            char *buf, struct Buffer *hdr)
 {
   unsigned int bytes;
   int rc = -1; /* default now is that string isn't FETCH response */
   int parse_rc;
 
-  struct ImapAccountData *adata = imap_get_adata(mailbox);
-
   if (buf[0] != '*')
     return rc;
 
@@ -419,12 +484,13 @@ static int msg_fetch_header(struct Mailbox *mailbox, struct ImapHeader *h,
   parse_rc = msg_parse_fetch(h, buf);
   if (!parse_rc)
     return 0;
-  if (parse_rc != -2 || !fp)
+  if (parse_rc != -2 || !hdr)
     return rc;
 
   if (imap_get_literal_count(buf, &bytes) == 0)
   {
-    imap_read_literal(fp, adata, bytes, NULL);
+    if (imap_read_literal_buf(hdr, adata, bytes) < 0)
+      return rc;
 
     /* we may have other fields of the FETCH _after_ the literal
      * (eg Domino puts FLAGS here). Nothing wrong with that, either.
@@ -535,67 +601,79 @@ static void imap_alloc_uid_hash(struct ImapAccountData *adata, unsigned int msn_
     adata->uid_hash = mutt_hash_int_create(MAX(6 * msn_count / 5, 30), 0);
 }
 
+/**
+ * seqset_add - Add a range of MSNs to a sequence set
+ * @param b     Buffer for the set
+ * @param first First MSN
+ * @param last  Last MSN
+ */
+static void seqset_add(struct Buffer *b, unsigned int first, unsigned int last)
+{
+  if (b->dptr != b->data)
+    mutt_buffer_addch(b, ',');
+
+  if (first == last)
+    mutt_buffer_add_printf(b, "%u", first);
+  else
+    mutt_buffer_add_printf(b, "%u:%u", first, last);
+}
+
 /**
  * imap_fetch_msn_seqset - Generate a sequence set
- * @param b         Buffer for the result
- * @param adata Imap Account data
- * @param msn_begin First Message Sequence number
- * @param msn_end   Last Message Sequence number
+ * @param[in]  b         Buffer for the result
+ * @param[in]  adata     Imap Account data
+ * @param[in]  msn_begin First Message Sequence number
+ * @param[in]  msn_end   Last Message Sequence number
+ * @param[in]  max       Most messages to include
+ * @param[out] msn_next  First MSN that wasn't considered
+ * @retval num Number of messages in the set
  *
- * Generates a more complicated sequence set after using the header cache,
- * in case there are missing MSNs in the middle.
+ * Lists the MSNs in the range that don't have a header yet, e.g. because
+ * they're missing from the header cache.
  *
  * There is a suggested limit of 1000 bytes for an IMAP client request.
- * Ideally, we would generate multiple requests if the number of ranges
- * is too big, but for now just abort to using the whole range.
+ * If there are many holes, the set is cut short and the rest of the range is
+ * left for another request.
  */
-static void imap_fetch_msn_seqset(struct Buffer *b, struct ImapAccountData *adata,
-                                  unsigned int msn_begin, unsigned int msn_end)
+static unsigned int imap_fetch_msn_seqset(struct Buffer *b, struct ImapAccountData *adata,
+                                          unsigned int msn_begin, unsigned int msn_end,
+                                          unsigned int max, unsigned int *msn_next)
 {
-  int chunks = 0;
-  int state = 0; /* 1: single msn, 2: range of msn */
+  unsigned int count = 0;
   unsigned int range_begin = 0;
   unsigned int range_end = 0;
+  unsigned int msn;
 
-  for (unsigned int msn = msn_begin; msn <= (msn_end + 1); msn++)
+  for (msn = msn_begin; (msn <= msn_end) && (count < max); msn++)
   {
-    if ((msn <= msn_end) && !adata->msn_index[msn - 1])
+    if (adata->msn_index[msn - 1])
+      continue;
+
+    if (range_end && (msn == range_end + 1))
     {
-      switch (state)
-      {
-        case 1: /* single: convert to a range */
-          state = 2;
-        /* fallthrough */
-        case 2: /* extend range ending */
-          range_end = msn;
-          break;
-        default:
-          state = 1;
-          range_begin = msn;
-          break;
-      }
+      range_end = msn;
+      count++;
+      continue;
     }
-    else if (state)
+
+    if (range_end)
     {
-      if (chunks++)
-        mutt_buffer_addch(b, ',');
-      if (chunks == 150)
+      seqset_add(b, range_begin, range_end);
+      range_end = 0;
+      if ((b->dptr - b->data) > 500)
         break;
-
-      if (state == 1)
-        mutt_buffer_add_printf(b, "%u", range_begin);
-      else if (state == 2)
-        mutt_buffer_add_printf(b, "%u:%u", range_begin, range_end);
-      state = 0;
     }
-  }
 
-  /* Too big.  Just query the whole range then. */
-  if ((chunks == 150) || (mutt_str_strlen(b->data) > 500))
-  {
-    b->dptr = b->data;
-    mutt_buffer_add_printf(b, "%u:%u", msn_begin, msn_end);
+    range_begin = msn;
+    range_end = msn;
+    count++;
   }
+
+  if (range_end)
+    seqset_add(b, range_begin, range_end);
+
+  *msn_next = msn;
+  return count;
 }
 
 /**
@@ -694,7 +772,7 @@ static int read_headers_normal_eval_cache(struct ImapAccountData *adata,
       if (rc != IMAP_CMD_CONTINUE)
         break;
 
-      mfhrc = msg_fetch_header(ctx->mailbox, &h, adata->buf, NULL);
+      mfhrc = msg_fetch_header(adata, &h, adata->buf, NULL);
       if (mfhrc < 0)
         continue;
 
@@ -749,9 +827,7 @@ static int read_headers_normal_eval_cache(struct ImapAccountData *adata,
 
         /*  mailbox->hdrs[msgno]->received is restored from mutt_hcache_restore */
         ctx->mailbox->hdrs[idx]->data = h.data;
-        STAILQ_INIT(&ctx->mailbox->hdrs[idx]->tags);
-        driver_tags_replace(&ctx->mailbox->hdrs[idx]->tags,
-                            mutt_str_strdup(h.data->flags_remote));
+        driver_tags_replace(&ctx->mailbox->hdrs[idx]->tags, h.data->flags_remote);
 
         ctx->mailbox->msg_count++;
         ctx->mailbox->size += ctx->mailbox->hdrs[idx]->content->length;
@@ -919,6 +995,7 @@ static int read_headers_condstore_qresync_updates(struct ImapAccountData *adata,
     imap_hcache_close(adata);
     imap_expunge_mailbox(adata);
     adata->hcache = imap_hcache_open(adata, NULL);
+    mutt_hcache_begin(adata->hcache);
     adata->reopen &= ~IMAP_EXPUNGE_PENDING;
   }
 
@@ -927,35 +1004,433 @@ static int read_headers_condstore_qresync_updates(struct ImapAccountData *adata,
 #endif /* USE_HCACHE */
 
 /**
- * read_headers_fetch_new - Retrieve new messages from the server
- * @param[in]  adata            Imap Account data
- * @param[in]  msn_begin        First Message Sequence number
- * @param[in]  msn_end          Last Message Sequence number
- * @param[in]  evalhc           if true, check the Header Cache
- * @param[out] maxuid           Highest UID seen
- * @param[in]  initial_download true, if this is the first opening of the mailbox
+ * fetch_now - Get the time, for measuring FETCHes
+ * @retval num Milliseconds since the epoch
+ */
+static long fetch_now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/**
+ * fetch_max_depth - How many FETCHes may be in flight
+ * @param adata Imap Account data
+ * @retval num Most commands, at least 1
+ *
+ * The command queue was sized by $imap_pipeline_depth when the connection
+ * was made.  One slot is left for other commands.
+ */
+static unsigned int fetch_max_depth(struct ImapAccountData *adata)
+{
+  return (adata->cmdslots > 3) ? adata->cmdslots - 2 : 1;
+}
+
+/**
+ * fetch_adapt - Tune the size and number of FETCHes
+ * @param adata Imap Account data
+ * @param count Number of headers received
+ * @param ms    Time the server took to send them
+ *
+ * A chunk is sized so that the server answers it in about
+ * #IMAP_FETCH_CHUNK_MS.  Slow servers get smaller chunks, so they aren't kept
+ * busy by one long command.  Enough chunks are kept in flight to cover the
+ * round trip, so that a distant server doesn't sit idle waiting for the next
+ * command.
+ */
+static void fetch_adapt(struct ImapAccountData *adata, unsigned int count, long ms)
+{
+  /* small chunks, e.g. the last of a range, are too noisy to learn from */
+  if (count >= IMAP_FETCH_CHUNK_MIN)
+  {
+    unsigned int rate = (unsigned long long) count * 1000 / MAX(ms, 1);
+    rate = MAX(rate, 1);
+    if (adata->fetch_rate)
+      adata->fetch_rate = (3 * (unsigned long long) adata->fetch_rate + rate) / 4;
+    else
+      adata->fetch_rate = rate;
+
+    if (ImapFetchChunkSize > 0)
+      adata->fetch_chunk = ImapFetchChunkSize;
+    else
+    {
+      /* grow gently, but shrink at once */
+      unsigned int chunk = (unsigned long long) adata->fetch_rate * IMAP_FETCH_CHUNK_MS / 1000;
+      chunk = MIN(chunk, 2 * adata->fetch_chunk);
+      adata->fetch_chunk = MAX(MIN(chunk, IMAP_FETCH_CHUNK_MAX), IMAP_FETCH_CHUNK_MIN);
+    }
+  }
+
+  if (adata->fetch_rate)
+  {
+    const unsigned int chunk_ms =
+        MAX((unsigned long long) adata->fetch_chunk * 1000 / adata->fetch_rate, 1);
+    const unsigned int depth = 1 + (adata->fetch_rtt + chunk_ms - 1) / chunk_ms;
+    adata->fetch_depth = MIN(depth, fetch_max_depth(adata));
+  }
+
+  mutt_debug(3, "chunk %u, depth %u, rtt %ums, %u headers/s\n", adata->fetch_chunk,
+             adata->fetch_depth, adata->fetch_rtt, adata->fetch_rate);
+}
+
+/**
+ * fetch_lane_fill - Send FETCHes until a connection's pipeline is full
+ * @param pipe FETCH pipeline
+ * @param lane Connection to send on
  * @retval  0 Success
  * @retval -1 Error
  */
-static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int msn_begin,
-                                  unsigned int msn_end, bool evalhc,
-                                  unsigned int *maxuid, bool initial_download)
+static int fetch_lane_fill(struct ImapFetchPipe *pipe, struct ImapFetchLane *lane)
+{
+  struct ImapAccountData *adata = lane->adata;
+
+  if (!adata->fetch_chunk)
+  {
+    /* nothing is known about the server yet, so fill the pipeline */
+    adata->fetch_chunk = (ImapFetchChunkSize > 0) ? ImapFetchChunkSize : IMAP_FETCH_CHUNK_START;
+    adata->fetch_depth = fetch_max_depth(adata);
+  }
+  else if (ImapFetchChunkSize > 0)
+    adata->fetch_chunk = ImapFetchChunkSize;
+
+  /* The commands in flight may be smaller than a chunk, e.g. while the chunk
+   * is growing, so count the headers, rather than the commands */
+  const unsigned int depth = MIN(MAX(adata->fetch_depth, 1), fetch_max_depth(adata));
+  const unsigned int want = adata->fetch_chunk * depth;
+  const bool idle = (lane->inflight == 0);
+  int queued = 0;
+
+  while ((lane->headers < want) && (lane->inflight < fetch_max_depth(adata)) &&
+         (pipe->msn_next <= pipe->msn_end))
+  {
+    /* near the end, split what's left so that the connections finish together */
+    unsigned int max = adata->fetch_chunk;
+    if (pipe->num_lanes > 1)
+    {
+      const unsigned int share = (pipe->msn_end - pipe->msn_next + 1) / (2 * pipe->num_lanes);
+      max = MIN(max, MAX(share, IMAP_FETCH_CHUNK_MIN));
+    }
+
+    struct Buffer *b = mutt_buffer_new();
+    unsigned int count = imap_fetch_msn_seqset(b, pipe->lanes[0].adata, pipe->msn_next,
+                                               pipe->msn_end, max, &pipe->msn_next);
+    if (count == 0)
+    {
+      mutt_buffer_free(&b);
+      break;
+    }
+
+    char *cmd = NULL;
+    safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE%s%s)",
+                  b->data, *pipe->hdrreq ? " " : "", pipe->hdrreq);
+    int rc = imap_exec(adata, cmd, IMAP_CMD_QUEUE);
+    FREE(&cmd);
+    mutt_buffer_free(&b);
+    if (rc < 0)
+      return -1;
+
+    const int last = (adata->nextcmd + adata->cmdslots - 1) % adata->cmdslots;
+    struct ImapFetchChunk *chunk =
+        &lane->chunks[(lane->head + lane->inflight) % adata->cmdslots];
+    mutt_str_strfcpy(chunk->seq, adata->cmds[last].seq, sizeof(chunk->seq));
+    chunk->count = count;
+    lane->inflight++;
+    lane->headers += count;
+    queued++;
+  }
+
+  if (queued == 0)
+    return 0;
+
+  if (imap_cmd_start(adata, NULL) < 0)
+    return -1;
+
+  const long now = fetch_now();
+  for (unsigned int i = lane->inflight - queued; i < lane->inflight; i++)
+    lane->chunks[(lane->head + i) % adata->cmdslots].sent = now;
+  if (idle)
+  {
+    lane->idle_sent = now;
+    lane->last_done = now;
+  }
+
+  return 0;
+}
+
+/**
+ * fetch_lane_reply - Handle a reply on a connection of the FETCH pipeline
+ * @param lane Connection that replied
+ * @retval  1 The oldest FETCH has finished
+ * @retval  0 Some other reply
+ * @retval -1 The oldest FETCH has failed
+ */
+static int fetch_lane_reply(struct ImapFetchLane *lane)
+{
+  struct ImapAccountData *adata = lane->adata;
+  const long now = fetch_now();
+
+  if (lane->idle_sent)
+  {
+    /* the first reply after a quiet spell measures the round trip */
+    const unsigned int rtt = now - lane->idle_sent;
+    if (adata->fetch_rtt)
+      adata->fetch_rtt = (3 * adata->fetch_rtt + rtt) / 4;
+    else
+      adata->fetch_rtt = rtt;
+    lane->idle_sent = 0;
+  }
+
+  if (lane->inflight == 0)
+    return 0;
+
+  struct ImapFetchChunk *chunk = &lane->chunks[lane->head];
+  if (mutt_str_strncmp(adata->buf, chunk->seq, SEQLEN) != 0)
+    return 0;
+
+  lane->head = (lane->head + 1) % adata->cmdslots;
+  lane->inflight--;
+  lane->headers -= chunk->count;
+
+  if (!imap_code(adata->buf))
+    return -1;
+
+  /* the server started on this chunk once it had arrived and the previous
+   * one was done.  Replies that queued up while nobody was reading can't be
+   * timed. */
+  if (chunk->sent >= lane->unread_until)
+    fetch_adapt(adata, chunk->count,
+                now - MAX(chunk->sent + (long) adata->fetch_rtt, lane->last_done));
+  lane->last_done = now;
+  return 1;
+}
+
+/**
+ * fetch_lane_open - Open another connection for downloading headers
+ * @param adata   Imap Account data of the mailbox
+ * @param msn_end Number of messages the mailbox should have
+ * @retval ptr  Connection, authenticated, with the mailbox open read-only
+ * @retval NULL Error
+ *
+ * The connection is only used for FETCHes of the mailbox's headers, which
+ * are parsed by read_headers_fetch_new().  It stays out of the
+ * #IMAP_SELECTED state, so the usual handlers ignore its untagged replies.
+ *
+ * Messages are asked for by MSN, so the connection must see the same
+ * mailbox: the same UIDVALIDITY, and the same number of messages.
+ */
+static struct ImapAccountData *fetch_lane_open(struct ImapAccountData *adata,
+                                               unsigned int msn_end)
+{
+  struct ImapAccountData *ldata = imap_extra_open(adata);
+  if (!ldata)
+    return NULL;
+
+  char buf[LONG_STRING];
+  char *cmd = NULL;
+  imap_munge_mbox_name(ldata, buf, sizeof(buf), adata->mbox_name);
+  safe_asprintf(&cmd, "EXAMINE %s", buf);
+  int rc = imap_cmd_start(ldata, cmd);
+  FREE(&cmd);
+  if (rc < 0)
+    goto fail;
+
+  unsigned int exists = 0;
+  unsigned int uid_validity = 0;
+  while ((rc = imap_cmd_step(ldata)) == IMAP_CMD_CONTINUE)
+  {
+    char *pc = imap_next_word(ldata->buf);
+    if (mutt_str_strncasecmp("OK [UIDVALIDITY", pc, 15) == 0)
+      mutt_str_atoui(imap_next_word(pc + 3), &uid_validity);
+    else if (mutt_str_strncasecmp("EXISTS", imap_next_word(pc), 6) == 0)
+      mutt_str_atoui(pc, &exists);
+  }
+
+  if ((rc != IMAP_CMD_OK) || (uid_validity != adata->uid_validity) || (exists != msn_end))
+  {
+    mutt_debug(1, "mailbox differs on the extra connection: %u messages, "
+                  "uidvalidity %u\n",
+               exists, uid_validity);
+    goto fail;
+  }
+
+  return ldata;
+
+fail:
+  imap_extra_close(&ldata);
+  return NULL;
+}
+
+/**
+ * fetch_lanes_close - Close the extra connections of a FETCH pipeline
+ * @param pipe FETCH pipeline
+ *
+ * Nothing is waited for.  Any FETCHes still in flight are abandoned.
+ */
+static void fetch_lanes_close(struct ImapFetchPipe *pipe)
+{
+  for (int i = 1; i < pipe->num_lanes; i++)
+  {
+    FREE(&pipe->lanes[i].chunks);
+    imap_extra_close(&pipe->lanes[i].adata);
+  }
+  pipe->num_lanes = 1;
+  FREE(&pipe->fds);
+}
+
+/**
+ * fetch_lanes_open - Open the extra connections of a FETCH pipeline
+ * @param pipe    FETCH pipeline
+ * @param lanes   Number of connections wanted, including the first
+ * @param msn_end Number of messages in the mailbox
+ *
+ * The first lane should already be busy, so that the server has work while
+ * the others log in.  If a connection can't be made, the download goes on
+ * with fewer.
+ */
+static void fetch_lanes_open(struct ImapFetchPipe *pipe, int lanes, unsigned int msn_end)
+{
+  struct ImapAccountData *adata = pipe->lanes[0].adata;
+
+  for (int i = 1; i < lanes; i++)
+  {
+    struct ImapAccountData *ldata = fetch_lane_open(adata, msn_end);
+    if (!ldata)
+      break;
+
+    /* start from what the first connection has learnt */
+    ldata->fetch_chunk = adata->fetch_chunk;
+    ldata->fetch_depth = adata->fetch_depth;
+    ldata->fetch_rtt = adata->fetch_rtt;
+    ldata->fetch_rate = adata->fetch_rate;
+
+    mutt_mem_realloc(&pipe->lanes, (pipe->num_lanes + 1) * sizeof(struct ImapFetchLane));
+    struct ImapFetchLane *lane = &pipe->lanes[pipe->num_lanes++];
+    memset(lane, 0, sizeof(*lane));
+    lane->adata = ldata;
+    lane->chunks = mutt_mem_calloc(ldata->cmdslots, sizeof(struct ImapFetchChunk));
+
+    if (fetch_lane_fill(pipe, lane) < 0)
+      break;
+  }
+
+  /* nothing was read while the connections were logging in */
+  const long now = fetch_now();
+  for (int i = 0; i < pipe->num_lanes; i++)
+    pipe->lanes[i].unread_until = now;
+  pipe->fds = mutt_mem_calloc(pipe->num_lanes, sizeof(struct pollfd));
+  mutt_debug(2, "downloading headers on %d connections\n", pipe->num_lanes);
+}
+
+/**
+ * fetch_lane_ready - Wait for a connection of the FETCH pipeline to reply
+ * @param pipe FETCH pipeline
+ * @retval ptr  Connection with a reply to read
+ * @retval NULL No FETCHes are in flight
+ */
+static struct ImapFetchLane *fetch_lane_ready(struct ImapFetchPipe *pipe)
+{
+  struct pollfd *fds = pipe->fds;
+
+  while (true)
+  {
+    int busy = 0;
+    struct ImapFetchLane *last = NULL;
+
+    /* stay with the last connection while it has data, then take turns */
+    for (int i = 0; i < pipe->num_lanes; i++)
+    {
+      const int n = (pipe->cur + i) % pipe->num_lanes;
+      struct ImapFetchLane *lane = &pipe->lanes[n];
+      if (!lane->adata || (lane->inflight == 0))
+        continue;
+
+      last = lane;
+      if (fds)
+      {
+        fds[busy].fd = lane->adata->conn->fd;
+        fds[busy].events = POLLIN;
+      }
+      busy++;
+
+      if (mutt_socket_poll(lane->adata->conn, 0) != 0)
+      {
+        pipe->cur = n;
+        return lane;
+      }
+    }
+
+    /* a single connection can simply block */
+    if ((busy < 2) || !fds)
+      return last;
+
+    if ((poll(fds, busy, -1) < 0) && (errno != EINTR))
+      return last;
+  }
+}
+
+/**
+ * fetch_lane_step - Read a reply from the FETCH pipeline
+ * @param[in]  pipe FETCH pipeline
+ * @param[out] adata Connection the reply is in
+ * @retval #IMAP_CMD_CONTINUE adata->buf has a reply
+ * @retval #IMAP_CMD_OK       All the FETCHes have finished
+ * @retval <0                 The first connection has failed
+ *
+ * A finished FETCH is replaced with the next chunk of the range.  If an extra
+ * connection fails, it's closed, and pipe->lost is set.
+ */
+static int fetch_lane_step(struct ImapFetchPipe *pipe, struct ImapAccountData **adata)
+{
+  while (true)
+  {
+    struct ImapFetchLane *lane = fetch_lane_ready(pipe);
+    if (!lane)
+      return IMAP_CMD_OK;
+
+    *adata = lane->adata;
+    int rc = imap_cmd_step(lane->adata);
+    if ((rc == IMAP_CMD_CONTINUE) || (rc == IMAP_CMD_OK))
+    {
+      const int lrc = fetch_lane_reply(lane);
+      if (lrc < 0)
+        rc = IMAP_CMD_NO;
+      else if ((lrc > 0) && (fetch_lane_fill(pipe, lane) < 0))
+        rc = IMAP_CMD_BAD;
+    }
+
+    if ((rc == IMAP_CMD_CONTINUE) || (rc == IMAP_CMD_OK))
+      return IMAP_CMD_CONTINUE;
+
+    if (lane == &pipe->lanes[0])
+      return rc;
+
+    mutt_debug(1, "extra connection failed: %s\n", lane->adata->buf);
+    struct ImapAccountData *ldata = lane->adata;
+    struct Connection *conn = ldata->conn;
+    imap_close_connection(ldata);
+    imap_adata_free(&ldata);
+    mutt_socket_free(conn);
+    lane->adata = NULL;
+    lane->inflight = 0;
+    pipe->lost = true;
+  }
+}
+
+/**
+ * header_request - Get the FETCH item for the headers NeoMutt reads
+ * @param adata Imap Account data
+ * @retval ptr  FETCH item, e.g. "BODY.PEEK[HEADER.FIELDS (...)]", to be freed
+ * @retval NULL The server is too old to fetch headers from
+ */
+static char *header_request(struct ImapAccountData *adata)
 {
-  int rc, mfhrc = 0, retval = -1;
-  unsigned int fetch_msn_end = 0;
-  struct Progress progress;
   char *hdrreq = NULL;
-  char tempfile[_POSIX_PATH_MAX];
-  FILE *fp = NULL;
-  struct ImapHeader h;
   static const char *const want_headers =
       "DATE FROM SUBJECT TO CC MESSAGE-ID REFERENCES CONTENT-TYPE "
       "CONTENT-DESCRIPTION IN-REPLY-TO REPLY-TO LINES LIST-POST X-LABEL "
       "X-ORIGINAL-TO";
 
-  struct Context *ctx = adata->ctx;
-  int idx = ctx->mailbox->msg_count;
-
   if (mutt_bit_isset(adata->capabilities, IMAP4REV1))
   {
     safe_asprintf(&hdrreq, "BODY.PEEK[HEADER.FIELDS (%s%s%s)]", want_headers,
@@ -966,7 +1441,40 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
     safe_asprintf(&hdrreq, "RFC822.HEADER.LINES (%s%s%s)", want_headers,
                   ImapHeaders ? " " : "", NONULL(ImapHeaders));
   }
-  else
+
+  return hdrreq;
+}
+
+/**
+ * read_headers_fetch_new - Retrieve new messages from the server
+ * @param[in]  adata            Imap Account data
+ * @param[in]  msn_begin        First Message Sequence number
+ * @param[in]  msn_end          Last Message Sequence number
+ * @param[out] maxuid           Highest UID seen
+ * @param[in]  initial_download true, if this is the first opening of the mailbox
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int msn_begin,
+                                  unsigned int msn_end, unsigned int *maxuid,
+                                  bool initial_download)
+{
+  int rc, mfhrc = 0, retval = -1;
+  unsigned int fetch_msn_end = 0;
+  struct Progress progress;
+  char *hdrreq = NULL;
+  struct Buffer *hdr = NULL;
+  struct ImapHeader h;
+  struct ImapFetchPipe pipe = { 0 };
+
+  struct Context *ctx = adata->ctx;
+  int idx = ctx->mailbox->msg_count;
+
+  /* the headers can be read later, so only ask for the flags */
+  const bool lazy = ImapLazyHeaders;
+
+  hdrreq = header_request(adata);
+  if (!hdrreq)
   { /* Unable to fetch headers for lower versions */
     mutt_error(_("Unable to fetch headers from this IMAP server version"));
     goto bail;
@@ -974,46 +1482,55 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
 
   /* instead of downloading all headers and then parsing them, we parse them
    * as they come in. */
-  mutt_mktemp(tempfile, sizeof(tempfile));
-  fp = mutt_file_fopen(tempfile, "w+");
-  if (!fp)
-  {
-    mutt_error(_("Could not create temporary file %s"), tempfile);
-    goto bail;
-  }
-  unlink(tempfile);
+  hdr = mutt_buffer_alloc(HUGE_STRING);
 
   mutt_progress_init(&progress, _("Fetching message headers..."),
                      MUTT_PROGRESS_MSG, ReadInc, msn_end);
 
+  pipe.hdrreq = lazy ? "" : hdrreq;
+  pipe.lanes = mutt_mem_calloc(1, sizeof(struct ImapFetchLane));
+  pipe.lanes[0].adata = adata;
+  pipe.lanes[0].chunks = mutt_mem_calloc(adata->cmdslots, sizeof(struct ImapFetchChunk));
+  pipe.num_lanes = 1;
+
+  int msgno = msn_begin;
+  bool parallel = (ImapFetchConnections > 1) && !(Tunnel && *Tunnel) &&
+                  ((msn_end - msn_begin) >= IMAP_FETCH_PARALLEL_MIN);
   while ((msn_begin <= msn_end) && (fetch_msn_end < msn_end))
   {
-    struct Buffer *b = mutt_buffer_new();
-    if (evalhc)
-    {
-      /* In case there are holes in the header cache. */
-      evalhc = false;
-      imap_fetch_msn_seqset(b, adata, msn_begin, msn_end);
-    }
-    else
-      mutt_buffer_add_printf(b, "%u:%u", msn_begin, msn_end);
-
-    fetch_msn_end = msn_end;
-    char *cmd = NULL;
-    safe_asprintf(&cmd, "FETCH %s (UID FLAGS INTERNALDATE RFC822.SIZE %s)", b->data, hdrreq);
-    imap_cmd_start(adata, cmd);
-    FREE(&cmd);
-    mutt_buffer_free(&b);
+    pipe.msn_next = msn_begin;
+    pipe.msn_end = msn_end;
+    if (fetch_lane_fill(&pipe, &pipe.lanes[0]) < 0)
+      goto bail;
+    fetch_msn_end = pipe.msn_next - 1;
 
+    struct ImapAccountData *ldata = adata;
     rc = IMAP_CMD_CONTINUE;
-    for (int msgno = msn_begin; rc == IMAP_CMD_CONTINUE; msgno++)
+    for (; rc == IMAP_CMD_CONTINUE; msgno++)
     {
       if (initial_download && SigInt && query_abort_header_download(adata))
         goto bail;
 
       mutt_progress_update(&progress, msgno, -1);
 
-      rewind(fp);
+      /* once the first connection has measured the server, open as many
+       * others as save more time than it takes to log them in */
+      if (parallel && adata->fetch_rate && adata->fetch_rtt)
+      {
+        parallel = false;
+        const unsigned long long left_ms =
+            (unsigned long long) (pipe.msn_end - pipe.msn_next + 1) * 1000 / adata->fetch_rate;
+        const unsigned long long login_ms = IMAP_FETCH_LOGIN_RTTS * adata->fetch_rtt;
+        int lanes = 1;
+        while ((lanes < ImapFetchConnections) &&
+               ((left_ms / lanes - left_ms / (lanes + 1)) > login_ms))
+        {
+          lanes++;
+        }
+        if (lanes > 1)
+          fetch_lanes_open(&pipe, lanes, msn_end);
+      }
+
       memset(&h, 0, sizeof(h));
       h.data = new_emaildata();
 
@@ -1023,23 +1540,22 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
        */
       do
       {
-        rc = imap_cmd_step(adata);
+        rc = fetch_lane_step(&pipe, &ldata);
+        fetch_msn_end = pipe.msn_next - 1;
         if (rc != IMAP_CMD_CONTINUE)
           break;
 
-        mfhrc = msg_fetch_header(ctx->mailbox, &h, adata->buf, fp);
+        mutt_buffer_reset(hdr);
+        mfhrc = msg_fetch_header(ldata, &h, ldata->buf, hdr);
         if (mfhrc < 0)
           continue;
 
-        if (!ftello(fp))
+        if (!lazy && (hdr->dptr == hdr->data))
         {
           mutt_debug(2, "ignoring fetch response with no body\n");
           continue;
         }
 
-        /* make sure we don't get remnants from older larger message headers */
-        fputs("\n\n", fp);
-
         if ((h.data->msn < 1) || (h.data->msn > fetch_msn_end))
         {
           mutt_debug(1, "skipping FETCH response for unknown message number %d\n",
@@ -1073,25 +1589,36 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
         ctx->mailbox->hdrs[idx]->replied = h.data->replied;
         ctx->mailbox->hdrs[idx]->received = h.received;
         ctx->mailbox->hdrs[idx]->data = (void *) (h.data);
-        STAILQ_INIT(&ctx->mailbox->hdrs[idx]->tags);
-        driver_tags_replace(&ctx->mailbox->hdrs[idx]->tags,
-                            mutt_str_strdup(h.data->flags_remote));
+        driver_tags_replace(&ctx->mailbox->hdrs[idx]->tags, h.data->flags_remote);
 
         if (*maxuid < h.data->uid)
           *maxuid = h.data->uid;
 
-        rewind(fp);
-        /* NOTE: if Date: header is missing, mutt_rfc822_read_header depends
-         *   on h.received being set */
-        ctx->mailbox->hdrs[idx]->env =
-            mutt_rfc822_read_header(fp, ctx->mailbox->hdrs[idx], false, false);
-        /* content built as a side-effect of mutt_rfc822_read_header */
-        ctx->mailbox->hdrs[idx]->content->length = h.content_length;
-        ctx->mailbox->size += h.content_length;
+        if (lazy)
+        {
+          /* Only the flags are known, for now, see imap_msg_load_header() */
+          ctx->mailbox->hdrs[idx]->env = mutt_env_new();
+          ctx->mailbox->hdrs[idx]->content = mutt_body_new();
+          ctx->mailbox->hdrs[idx]->content->length = h.content_length;
+          ctx->mailbox->hdrs[idx]->date_sent = h.received;
+          ctx->mailbox->hdrs[idx]->header_pending = true;
+          h.data->lazy = true;
+        }
+        else
+        {
+          /* NOTE: if Date: header is missing, the parse depends on h.received
+           *   being set.  The header is parsed straight from memory, and
+           *   another mailbox may have parsed it already. */
+          ctx->mailbox->hdrs[idx]->env = mutt_hdrshare_read_header(
+              hdr->data, hdr->dptr - hdr->data, ctx->mailbox->hdrs[idx]);
+          /* content built as a side-effect of the parse */
+          ctx->mailbox->hdrs[idx]->content->length = h.content_length;
+          ctx->mailbox->size += h.content_length;
 
 #ifdef USE_HCACHE
-        imap_hcache_put(adata, ctx->mailbox->hdrs[idx]);
+          imap_hcache_put(adata, ctx->mailbox->hdrs[idx]);
 #endif /* USE_HCACHE */
+        }
 
         ctx->mailbox->msg_count++;
 
@@ -1105,6 +1632,16 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
         goto bail;
     }
 
+    /* the extra connections are only for the first download */
+    fetch_lanes_close(&pipe);
+    if (pipe.lost)
+    {
+      /* fetch whatever the failed connections didn't deliver */
+      pipe.lost = false;
+      fetch_msn_end = msn_begin - 1;
+      continue;
+    }
+
     /* In case we get new mail while fetching the headers.
      *
      * Note: The RFC says we shouldn't get any EXPUNGE responses in the
@@ -1128,7 +1665,11 @@ static int read_headers_fetch_new(struct ImapAccountData *adata, unsigned int ms
   retval = 0;
 
 bail:
-  mutt_file_fclose(&fp);
+  fetch_lanes_close(&pipe);
+  if (pipe.lanes)
+    FREE(&pipe.lanes[0].chunks);
+  FREE(&pipe.lanes);
+  mutt_buffer_free(&hdr);
   FREE(&hdrreq);
 
   return retval;
@@ -1183,6 +1724,7 @@ int imap_read_headers(struct ImapAccountData *adata, unsigned int msn_begin,
 
 #ifdef USE_HCACHE
   adata->hcache = imap_hcache_open(adata, NULL);
+  mutt_hcache_begin(adata->hcache);
 
   if (adata->hcache && initial_download)
   {
@@ -1264,7 +1806,7 @@ int imap_read_headers(struct ImapAccountData *adata, unsigned int msn_begin,
   }
 #endif /* USE_HCACHE */
 
-  if (read_headers_fetch_new(adata, msn_begin, msn_end, evalhc, &maxuid, initial_download) < 0)
+  if (read_headers_fetch_new(adata, msn_begin, msn_end, &maxuid, initial_download) < 0)
     goto bail;
 
   if (maxuid && (status = imap_mboxcache_get(adata, adata->mbox_name, 0)) &&
@@ -1307,6 +1849,9 @@ int imap_read_headers(struct ImapAccountData *adata, unsigned int msn_begin,
     else
       imap_hcache_clear_uid_seqset(adata);
   }
+  /* new mail: keep the next QRESYNC in step with the cache */
+  else if (adata->qresync)
+    imap_hcache_store_uid_seqset(adata);
 #endif /* USE_HCACHE */
 
   if (ctx->mailbox->msg_count > oldmsgcount)
@@ -1474,6 +2019,9 @@ fail:
  * @retval -1 Error
  * @retval  0 Success
  * @retval  1 Non-fatal error - try fetch/append
+ *
+ * If the server supports MOVE (RFC6851), messages that are to be deleted are
+ * moved instead, so they don't need to be flagged and expunged afterwards.
  */
 int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool delete)
 {
@@ -1487,6 +2035,9 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
   int triedcreate = 0;
 
   struct ImapAccountData *adata = imap_get_adata(ctx->mailbox);
+  /* RFC6851: move the messages in one step, rather than copy, flag and expunge */
+  const bool move = delete && mutt_bit_isset(adata->capabilities, MOVE) &&
+                    mutt_bit_isset(ctx->mailbox->rights, MUTT_ACL_DELETE);
 
   if (imap_parse_path(dest, &mx))
   {
@@ -1534,20 +2085,17 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
           mutt_debug(3, "#2 Message contains attachments to be deleted\n");
           return 1;
         }
+      }
 
-        if (ctx->mailbox->hdrs[i]->active && ctx->mailbox->hdrs[i]->changed)
-        {
-          rc = imap_sync_message_for_copy(adata, ctx->mailbox->hdrs[i],
-                                          &sync_cmd, &err_continue);
-          if (rc < 0)
-          {
-            mutt_debug(1, "#1 could not sync\n");
-            goto out;
-          }
-        }
+      rc = imap_sync_msgset_for_copy(adata, MUTT_TAG, &err_continue);
+      if (rc < 0)
+      {
+        mutt_debug(1, "#1 could not sync\n");
+        goto out;
       }
 
-      rc = imap_exec_msgset(adata, "UID COPY", mmbox, MUTT_TAG, false, false);
+      rc = imap_exec_msgset(adata, move ? "UID MOVE" : "UID COPY", mmbox,
+                            MUTT_TAG, false, false);
       if (!rc)
       {
         mutt_debug(1, "No messages tagged\n");
@@ -1559,6 +2107,11 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
         mutt_debug(1, "#1 could not queue copy\n");
         goto out;
       }
+      else if (move)
+      {
+        mutt_message(ngettext("Moving %d message to %s...", "Moving %d messages to %s...", rc),
+                     rc, mbox);
+      }
       else
       {
         mutt_message(ngettext("Copying %d message to %s...", "Copying %d messages to %s...", rc),
@@ -1567,8 +2120,16 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
     }
     else
     {
-      mutt_message(_("Copying message %d to %s..."), e->index + 1, mbox);
-      mutt_buffer_add_printf(&cmd, "UID COPY %u %s", IMAP_EDATA(e)->uid, mmbox);
+      if (move)
+      {
+        mutt_message(_("Moving message %d to %s..."), e->index + 1, mbox);
+        mutt_buffer_add_printf(&cmd, "UID MOVE %u %s", IMAP_EDATA(e)->uid, mmbox);
+      }
+      else
+      {
+        mutt_message(_("Copying message %d to %s..."), e->index + 1, mbox);
+        mutt_buffer_add_printf(&cmd, "UID COPY %u %s", IMAP_EDATA(e)->uid, mmbox);
+      }
 
       if (e->active && e->changed)
       {
@@ -1588,7 +2149,18 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
     }
 
     /* let's get it on */
-    rc = imap_exec(adata, NULL, IMAP_CMD_FAIL_OK);
+    if (move)
+    {
+      /* The server expunges the moved messages, but the caller still holds
+       * pointers to them, so leave the EXPUNGEs for the next mailbox check. */
+      const bool reopen = (adata->reopen & IMAP_REOPEN_ALLOW);
+      imap_disallow_reopen(ctx);
+      rc = imap_exec(adata, NULL, IMAP_CMD_FAIL_OK);
+      if (reopen)
+        imap_allow_reopen(ctx);
+    }
+    else
+      rc = imap_exec(adata, NULL, IMAP_CMD_FAIL_OK);
     if (rc == -2)
     {
       if (triedcreate)
@@ -1619,7 +2191,7 @@ int imap_copy_messages(struct Context *ctx, struct Email *e, char *dest, bool de
   }
 
   /* cleanup */
-  if (delete)
+  if (delete && !move)
   {
     if (!e)
     {
@@ -1686,6 +2258,111 @@ int imap_cache_clean(struct ImapAccountData *adata)
   return 0;
 }
 
+/**
+ * imap_prefetch_store - Store a message body that was read ahead
+ * @param adata Imap Account data
+ * @param e     Email
+ * @param s     Literal count of the body, e.g. "{1234}"
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * This is called by the FETCH handler, so the answer to imap_prefetch() can
+ * arrive while any other command is running.  The trailing line of the FETCH
+ * is read, too.
+ */
+int imap_prefetch_store(struct ImapAccountData *adata, struct Email *e, const char *s)
+{
+  unsigned int bytes;
+
+  IMAP_EDATA(e)->prefetch = false;
+
+  if (imap_get_literal_count(s, &bytes) < 0)
+    return -1;
+
+  /* the literal must be read, even if it can't be kept */
+  FILE *fp = msg_cache_put(adata, e);
+  const int rc = imap_read_literal(fp, adata, bytes, NULL);
+  if (fp)
+  {
+    if ((mutt_file_fclose(&fp) == 0) && (rc == 0))
+      msg_cache_commit(adata, e);
+  }
+  if (rc < 0)
+    return -1;
+
+  mutt_debug(2, "read ahead UID %u, %u bytes\n", IMAP_EDATA(e)->uid, bytes);
+
+  /* pick up trailing line */
+  if (imap_cmd_step(adata) != IMAP_CMD_CONTINUE)
+    return -1;
+
+  return 0;
+}
+
+/**
+ * imap_prefetch - Read the following messages into the message cache
+ * @param ctx Mailbox
+ * @param cur Email being displayed
+ *
+ * Up to $imap_prefetch unread messages after cur, in the order of the index,
+ * are asked for in the background.  The answer is picked up by imap_collect()
+ * while NeoMutt waits for a key, or by any other command.
+ */
+void imap_prefetch(struct Context *ctx, struct Email *cur)
+{
+  char id[64];
+
+  if (!ctx || !cur || (ImapPrefetch <= 0) || !MessageCachedir || !*MessageCachedir)
+    return;
+
+  struct Mailbox *m = ctx->mailbox;
+  struct ImapAccountData *adata = imap_get_adata(m);
+  if (!adata || (adata->ctx != ctx) || (adata->state < IMAP_SELECTED) ||
+      !mutt_bit_isset(adata->capabilities, IMAP4REV1))
+  {
+    return;
+  }
+
+  /* only one read-ahead at a time */
+  if ((adata->state != IMAP_IDLE) && imap_cmd_pending(adata))
+    return;
+
+  adata->bcache = msg_cache_open(adata);
+  if (!adata->bcache)
+    return;
+
+  struct Buffer *cmd = mutt_buffer_pool_get();
+  mutt_buffer_addstr(cmd, "UID FETCH ");
+  int count = 0;
+
+  for (int v = cur->virtual + 1; (v >= 1) && (v < m->vcount) && (count < ImapPrefetch); v++)
+  {
+    struct Email *e = m->hdrs[m->v2r[v]];
+    if (!e || e->read || e->deleted || !e->active || IMAP_EDATA(e)->prefetch)
+      continue;
+    if ((ImapPartialFetch > 0) && (e->content->length > ImapPartialFetch))
+      continue;
+
+    snprintf(id, sizeof(id), "%u-%u", adata->uid_validity, IMAP_EDATA(e)->uid);
+    if (mutt_bcache_exists(adata->bcache, id) == 0)
+      continue;
+
+    mutt_buffer_add_printf(cmd, "%s%u", (count == 0) ? "" : ",", IMAP_EDATA(e)->uid);
+    IMAP_EDATA(e)->prefetch = true;
+    count++;
+  }
+
+  if (count > 0)
+  {
+    mutt_buffer_addstr(cmd, " (BODY.PEEK[])");
+    mutt_debug(2, "reading ahead %d messages\n", count);
+    if (imap_cmd_start(adata, cmd->data) == 0)
+      adata->background = true;
+  }
+
+  mutt_buffer_pool_release(&cmd);
+}
+
 /**
  * imap_free_emaildata - free ImapHeader structure
  * @param data Header data to free
@@ -1741,7 +2418,7 @@ char *imap_set_flags(struct ImapAccountData *adata, struct Email *e, char *s, in
     return NULL;
 
   /* Update tags system */
-  driver_tags_replace(&e->tags, mutt_str_strdup(edata->flags_remote));
+  driver_tags_replace(&e->tags, edata->flags_remote);
 
   /* YAUH (yet another ugly hack): temporarily set context to
    * read-write even if it's read-only, so *server* updates of
@@ -1774,6 +2451,279 @@ char *imap_set_flags(struct ImapAccountData *adata, struct Email *e, char *s, in
   return s;
 }
 
+/**
+ * lazy_window - Pick the emails to read the headers of
+ * @param[in]  ctx   Mailbox
+ * @param[in]  e     Email that's needed
+ * @param[out] list  Emails to read, e first, to be freed
+ * @retval num Number of emails in the list
+ *
+ * The emails around e, in the order of the index, are read with it, mostly
+ * in the direction the index is moving.  While the requests keep coming from
+ * next to the last window, i.e. while scrolling or reading every header, the
+ * window doubles each time.
+ */
+static int lazy_window(struct Context *ctx, struct Email *e, struct Email ***list)
+{
+  struct Mailbox *m = ctx->mailbox;
+  struct ImapAccountData *adata = imap_get_adata(m);
+
+  /* follow the index, if the email is in it, otherwise the mailbox order */
+  const bool visible = (e->virtual >= 0) && (e->virtual < m->vcount) &&
+                       (m->hdrs[m->v2r[e->virtual]] == e);
+  const int count = visible ? m->vcount : m->msg_count;
+  const int pos = visible ? e->virtual : e->msgno;
+
+  *list = mutt_mem_calloc(1, sizeof(struct Email *));
+  (*list)[0] = e;
+  if (!visible && ((pos < 0) || (pos >= count) || (m->hdrs[pos] != e)))
+    return 1;
+
+  const int dist = pos - adata->header_last;
+  if (adata->header_window && (abs(dist) <= (int) adata->header_window))
+    adata->header_window = MIN(adata->header_window * 2, IMAP_FETCH_CHUNK_MAX);
+  else
+    adata->header_window = IMAP_HEADER_WINDOW;
+  adata->header_last = pos;
+
+  const int window = adata->header_window;
+  const int step = (dist >= 0) ? 1 : -1;
+  mutt_mem_realloc(list, (window + 1) * sizeof(struct Email *));
+  int num = 1;
+
+  /* a quarter behind, the rest ahead; don't look too far for gaps */
+  for (int pass = 0; pass < 2; pass++)
+  {
+    const int dir = pass ? step : -step;
+    const int want = pass ? window : (window / 4);
+    for (int i = pos + dir, seen = 0;
+         (i >= 0) && (i < count) && (num < want) && (seen < (2 * window)); i += dir, seen++)
+    {
+      struct Email *cur = m->hdrs[visible ? m->v2r[i] : i];
+      if (cur && cur->active && cur->data && IMAP_EDATA(cur)->lazy)
+        (*list)[num++] = cur;
+    }
+  }
+
+  return num;
+}
+
+/**
+ * lazy_parse - Read the headers of an email that only had its flags
+ * @param e              Email
+ * @param hdr            Header fields from the server
+ * @param content_length Size of the rest of the email
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int lazy_parse(struct Email *e, struct Buffer *hdr, long content_length)
+{
+#ifdef USE_FMEMOPEN
+  FILE *fp = fmemopen(hdr->data, hdr->dptr - hdr->data, "r");
+#else
+  FILE *fp = mutt_file_mkstemp();
+  if (fp)
+  {
+    fwrite(hdr->data, 1, hdr->dptr - hdr->data, fp);
+    rewind(fp);
+  }
+#endif
+  if (!fp)
+  {
+    mutt_perror(_("Error opening 'memory stream'"));
+    return -1;
+  }
+
+  /* the flags may have been changed since the mailbox was opened, keep them
+   * rather than take any from the headers */
+  const struct Email saved = *e;
+
+  mutt_env_free(&e->env);
+  mutt_body_free(&e->content);
+  e->env = mutt_rfc822_read_header(fp, e, false, false);
+  mutt_file_fclose(&fp);
+  e->content->length = content_length;
+
+  e->read = saved.read;
+  e->old = saved.old;
+  e->flagged = saved.flagged;
+  e->replied = saved.replied;
+  e->deleted = saved.deleted;
+  e->changed = saved.changed;
+  e->index = saved.index;
+
+  IMAP_EDATA(e)->lazy = false;
+  return 0;
+}
+
+/**
+ * imap_msg_load_header - Implements MxOps::msg_load_header()
+ *
+ * Read the headers of an email that was added with only its flags, because
+ * of $imap_lazy_headers.  The headers of the pending emails around it are read
+ * at the same time, see lazy_window().
+ */
+int imap_msg_load_header(struct Context *ctx, struct Email *e)
+{
+  struct ImapAccountData *adata = imap_get_adata(ctx->mailbox);
+  if (!adata || (adata->ctx != ctx) || !e->data)
+    return -1;
+
+  /* it came with an earlier window */
+  if (!IMAP_EDATA(e)->lazy)
+    return 0;
+
+  if (adata->state < IMAP_SELECTED)
+    return -1;
+
+  char *hdrreq = header_request(adata);
+  if (!hdrreq)
+    return -1;
+
+  struct Email **list = NULL;
+  const int num = lazy_window(ctx, e, &list);
+
+  struct Buffer *set = mutt_buffer_pool_get();
+  unsigned int first = 0, last = 0;
+  int asked = 0;
+  for (int i = 0; i < num; i++)
+  {
+    /* the set must fit in a command, see imap_fetch_msn_seqset() */
+    if ((set->dptr - set->data) > 500)
+      break;
+
+    const unsigned int uid = IMAP_EDATA(list[i])->uid;
+    asked++;
+    if (last && (uid == last + 1))
+    {
+      last = uid;
+      continue;
+    }
+    if (last)
+      seqset_add(set, first, last);
+    first = uid;
+    last = uid;
+  }
+  seqset_add(set, first, last);
+  FREE(&list);
+
+  char *cmd = NULL;
+  safe_asprintf(&cmd, "UID FETCH %s (UID RFC822.SIZE %s)", set->data, hdrreq);
+  mutt_buffer_pool_release(&set);
+  FREE(&hdrreq);
+
+  mutt_debug(2, "reading %d headers for UID %u\n", asked, IMAP_EDATA(e)->uid);
+
+  /* a read-ahead may be using the connection */
+  while (imap_cmd_pending(adata))
+  {
+    if (imap_cmd_step(adata) == IMAP_CMD_BAD)
+      break;
+  }
+
+  struct Buffer *hdr = mutt_buffer_alloc(HUGE_STRING);
+#ifdef USE_HCACHE
+  const bool hc_close = !adata->hcache;
+  if (hc_close)
+    adata->hcache = imap_hcache_open(adata, NULL);
+#endif
+
+  int rc = imap_cmd_start(adata, cmd);
+  FREE(&cmd);
+  if (rc < 0)
+    goto done;
+
+  struct ImapHeader h;
+  do
+  {
+    rc = imap_cmd_step(adata);
+    if (rc != IMAP_CMD_CONTINUE)
+      break;
+
+    memset(&h, 0, sizeof(h));
+    h.data = new_emaildata();
+    mutt_buffer_reset(hdr);
+    const int mfhrc = msg_fetch_header(adata, &h, adata->buf, hdr);
+    const unsigned int uid = h.data->uid;
+    imap_free_emaildata((void **) &h.data);
+    if ((mfhrc < 0) || (hdr->dptr == hdr->data))
+      continue;
+
+    struct Email *cur = mutt_hash_int_find(adata->uid_hash, uid);
+    if (!cur || !cur->data || !IMAP_EDATA(cur)->lazy)
+      continue;
+
+    if (lazy_parse(cur, hdr, h.content_length) < 0)
+      continue;
+#ifdef USE_HCACHE
+    imap_hcache_put(adata, cur);
+#endif
+  } while (rc == IMAP_CMD_CONTINUE);
+
+done:
+#ifdef USE_HCACHE
+  if (hc_close)
+    imap_hcache_close(adata);
+#endif
+  mutt_buffer_free(&hdr);
+
+  if ((rc != IMAP_CMD_OK) || IMAP_EDATA(e)->lazy)
+  {
+    mutt_debug(1, "couldn't read the headers of UID %u\n", IMAP_EDATA(e)->uid);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * imap_msg_save_hcache - Implements MxOps::msg_save_hcache()
+ */
+int imap_msg_save_hcache(struct Context *ctx, struct Email *e)
+{
+  int rc = -1;
+#ifdef USE_HCACHE
+  struct ImapAccountData *adata = imap_get_adata(ctx->mailbox);
+  if (!adata || (adata->ctx != ctx) || !e->data)
+    return -1;
+
+  const bool hc_close = !adata->hcache;
+  if (hc_close)
+    adata->hcache = imap_hcache_open(adata, NULL);
+  rc = imap_hcache_put(adata, e);
+  if (hc_close)
+    imap_hcache_close(adata);
+#endif
+  return rc;
+}
+
+/**
+ * partial_fetch_ok - Can the message be displayed from a partial fetch?
+ * @param b Body of the message
+ * @retval true The beginning of the message is enough to display it
+ *
+ * Signatures can't be checked, nor messages decrypted, without all the data.
+ */
+static bool partial_fetch_ok(struct Body *b)
+{
+  if ((b->type == TYPE_MULTIPART) &&
+      ((mutt_str_strcasecmp(b->subtype, "signed") == 0) ||
+       (mutt_str_strcasecmp(b->subtype, "encrypted") == 0)))
+  {
+    return false;
+  }
+
+  if ((b->type == TYPE_APPLICATION) &&
+      ((mutt_str_strcasecmp(b->subtype, "pkcs7-mime") == 0) ||
+       (mutt_str_strcasecmp(b->subtype, "x-pkcs7-mime") == 0) ||
+       (mutt_str_strcasecmp(b->subtype, "pgp") == 0)))
+  {
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * imap_msg_open - Implements MxOps::msg_open()
  */
@@ -1800,11 +2750,25 @@ int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno)
   struct ImapAccountData *adata = imap_get_adata(ctx->mailbox);
   struct Email *e = ctx->mailbox->hdrs[msgno];
 
+  /* only the beginning of a large message is needed to display it */
+  const bool partial = OptPartialFetch && (ImapPartialFetch > 0) &&
+                       (e->content->length > ImapPartialFetch) &&
+                       mutt_bit_isset(adata->capabilities, IMAP4REV1) &&
+                       partial_fetch_ok(e->content);
+
+  /* a read-ahead may already be bringing it in */
+  while (IMAP_EDATA(e)->prefetch && imap_cmd_pending(adata))
+  {
+    if (imap_cmd_step(adata) == IMAP_CMD_BAD)
+      break;
+  }
+  IMAP_EDATA(e)->prefetch = false;
+
   msg->fp = msg_cache_get(adata, e);
   if (msg->fp)
   {
     if (IMAP_EDATA(e)->parsed)
-      return 0;
+      goto done;
     else
       goto parsemsg;
   }
@@ -1817,8 +2781,13 @@ int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno)
   if (cache->path)
   {
     /* don't treat cache errors as fatal, just fall back. */
-    if (cache->uid == IMAP_EDATA(e)->uid && (msg->fp = fopen(cache->path, "r")))
-      return 0;
+    if ((cache->uid == IMAP_EDATA(e)->uid) && (partial || !cache->partial) &&
+        (msg->fp = fopen(cache->path, "r")))
+    {
+      if (cache->partial)
+        IMAP_EDATA(e)->partial = true;
+      goto done;
+    }
     else
     {
       unlink(cache->path);
@@ -1832,10 +2801,13 @@ int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno)
   if (output_progress)
     mutt_message(_("Fetching message..."));
 
-  msg->fp = msg_cache_put(adata, e);
+  /* a partial copy only goes in the temporary cache */
+  if (!partial)
+    msg->fp = msg_cache_put(adata, e);
   if (!msg->fp)
   {
     cache->uid = IMAP_EDATA(e)->uid;
+    cache->partial = partial;
     mutt_mktemp(path, sizeof(path));
     cache->path = mutt_str_strdup(path);
     msg->fp = mutt_file_fopen(path, "w+");
@@ -1851,10 +2823,18 @@ int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno)
    * command handler */
   e->active = false;
 
-  snprintf(buf, sizeof(buf), "UID FETCH %u %s", IMAP_EDATA(e)->uid,
-           (mutt_bit_isset(adata->capabilities, IMAP4REV1) ?
-                (ImapPeek ? "BODY.PEEK[]" : "BODY[]") :
-                "RFC822"));
+  if (partial)
+  {
+    snprintf(buf, sizeof(buf), "UID FETCH %u %s<0.%ld>", IMAP_EDATA(e)->uid,
+             ImapPeek ? "BODY.PEEK[]" : "BODY[]", ImapPartialFetch);
+  }
+  else
+  {
+    snprintf(buf, sizeof(buf), "UID FETCH %u %s", IMAP_EDATA(e)->uid,
+             (mutt_bit_isset(adata->capabilities, IMAP4REV1) ?
+                  (ImapPeek ? "BODY.PEEK[]" : "BODY[]") :
+                  "RFC822"));
+  }
 
   imap_cmd_start(adata, buf);
   do
@@ -1942,6 +2922,26 @@ int imap_msg_open(struct Context *ctx, struct Message *msg, int msgno)
   if (!fetched || !imap_code(adata->buf))
     goto bail;
 
+  if (partial)
+  {
+    /* The size and line count of the message stay those from the server.
+     * The copy isn't marked as parsed, so a full fetch will redo this. */
+    rewind(msg->fp);
+    read = e->read;
+    newenv = mutt_rfc822_read_header(msg->fp, e, false, false);
+    mutt_env_merge(e->env, &newenv);
+    if (read != e->read)
+    {
+      e->read = read;
+      mutt_set_flag(ctx, e, MUTT_NEW, read);
+    }
+    rewind(msg->fp);
+    IMAP_EDATA(e)->partial = true;
+
+    mutt_message(_("Fetched the first %ld bytes of the message"), ImapPartialFetch);
+    return 0;
+  }
+
   msg_cache_commit(adata, e);
 
 parsemsg:
@@ -1988,6 +2988,22 @@ parsemsg:
     goto parsemsg;
   }
 
+done:
+  /* the MIME parts were parsed from the beginning of the message only */
+  if (!partial && IMAP_EDATA(e)->partial)
+  {
+    IMAP_EDATA(e)->partial = false;
+    if (e->content->parts)
+    {
+      mutt_body_free(&e->content->parts);
+      mutt_parse_part(msg->fp, e->content);
+      if (WithCrypto)
+        e->security = crypt_query(e->content);
+      e->attach_valid = false;
+      rewind(msg->fp);
+    }
+  }
+
   return 0;
 
 bail:
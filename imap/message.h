@@ -43,6 +43,9 @@ struct ImapEmailData
   bool replied : 1;
 
   bool parsed : 1;
+  bool partial : 1; /**< MIME parts were parsed from a partial fetch */
+  bool prefetch : 1; /**< The body has been asked for by imap_prefetch() */
+  bool lazy : 1;     /**< Only the flags have been fetched, see imap_msg_load_header() */
 
   unsigned int uid; /**< 32-bit Message UID */
   unsigned int msn; /**< Message Sequence Number */
@@ -28,6 +28,7 @@
 
 #include "config.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include "imap_private.h"
 #include "mutt/mutt.h"
@@ -309,16 +310,105 @@ bail:
   return NULL;
 }
 
+/* Each cache is forgotten once it holds this many names */
+#define IMAP_UTF_CACHE_MAX 4096
+
+/**
+ * utf_cache_free_name - Free a cached mailbox name - Implements ::hash_destructor_t
+ */
+static void utf_cache_free_name(int type, void *obj, intptr_t data)
+{
+  FREE(&obj);
+}
+
+/**
+ * utf_is_plain - Is a mailbox name the same in every encoding
+ * @param s Mailbox name
+ * @retval true The name needs no conversion
+ *
+ * Printable ASCII, other than the '&' that starts a modified UTF-7 sequence,
+ * is the same in the local charset, UTF-8 and modified UTF-7.
+ */
+static bool utf_is_plain(const char *s)
+{
+  for (const unsigned char *p = (const unsigned char *) s; *p; p++)
+    if ((*p < 0x20) || (*p > 0x7e) || (*p == '&'))
+      return false;
+  return true;
+}
+
+/**
+ * utf_cache_check - Get the name caches ready for use
+ * @param adata Imap Account data
+ *
+ * The converted names depend on $charset and on whether the server accepts
+ * UTF-8, so the caches are emptied if either changes.
+ */
+static void utf_cache_check(struct ImapAccountData *adata)
+{
+  if (adata->utf_encode_cache && (adata->utf_cache_unicode == adata->unicode) &&
+      (mutt_str_strcmp(adata->utf_cache_charset, Charset) == 0) &&
+      (adata->utf_encode_cache->count < IMAP_UTF_CACHE_MAX) &&
+      (adata->utf_decode_cache->count < IMAP_UTF_CACHE_MAX))
+  {
+    return;
+  }
+
+  imap_utf_cache_free(adata);
+  adata->utf_encode_cache = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+  mutt_hash_set_destructor(adata->utf_encode_cache, utf_cache_free_name, 0);
+  adata->utf_decode_cache = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+  mutt_hash_set_destructor(adata->utf_decode_cache, utf_cache_free_name, 0);
+  adata->utf_cache_charset = mutt_str_strdup(Charset);
+  adata->utf_cache_unicode = adata->unicode;
+}
+
+/**
+ * utf_cache_add - Remember a converted mailbox name
+ * @param cache Cache to add to
+ * @param from  Original name
+ * @param to    Converted name
+ */
+static void utf_cache_add(struct Hash *cache, const char *from, const char *to)
+{
+  if (!from || !to || mutt_hash_find(cache, from))
+    return;
+  mutt_hash_insert(cache, from, mutt_str_strdup(to));
+}
+
+/**
+ * imap_utf_cache_free - Forget the converted mailbox names of an account
+ * @param adata Imap Account data
+ */
+void imap_utf_cache_free(struct ImapAccountData *adata)
+{
+  mutt_hash_destroy(&adata->utf_encode_cache);
+  mutt_hash_destroy(&adata->utf_decode_cache);
+  FREE(&adata->utf_cache_charset);
+}
+
 /**
  * imap_utf_encode - Encode email from local charset to UTF-8
  * @param adata Imap Account data
  * @param s     Email to convert
+ *
+ * The result is cached on the account, and the reverse conversion with it.
  */
 void imap_utf_encode(struct ImapAccountData *adata, char **s)
 {
-  if (!Charset || !s)
+  if (!Charset || !s || !*s || utf_is_plain(*s))
     return;
 
+  utf_cache_check(adata);
+  const char *cached = mutt_hash_find(adata->utf_encode_cache, *s);
+  if (cached)
+  {
+    mutt_str_replace(s, cached);
+    return;
+  }
+
+  char *orig = mutt_str_strdup(*s);
+  bool converted = false;
   char *t = mutt_str_strdup(*s);
   if (t && (mutt_ch_convert_string(&t, Charset, "utf-8", 0) == 0))
   {
@@ -327,20 +417,36 @@ void imap_utf_encode(struct ImapAccountData *adata, char **s)
       *s = mutt_str_strdup(t);
     else
       *s = utf8_to_utf7(t, strlen(t), NULL, 0);
+    converted = true;
   }
   FREE(&t);
+
+  utf_cache_add(adata->utf_encode_cache, orig, *s);
+  if (converted)
+    utf_cache_add(adata->utf_decode_cache, *s, orig);
+  FREE(&orig);
 }
 
 /**
  * imap_utf_decode - Decode email from UTF-8 to local charset
  * @param[in]  adata Imap Account data
  * @param[out] s     Email to convert
+ *
+ * The result is cached on the account, and the reverse conversion with it.
  */
 void imap_utf_decode(struct ImapAccountData *adata, char **s)
 {
-  if (!Charset)
+  if (!Charset || !*s || utf_is_plain(*s))
     return;
 
+  utf_cache_check(adata);
+  const char *cached = mutt_hash_find(adata->utf_decode_cache, *s);
+  if (cached)
+  {
+    mutt_str_replace(s, cached);
+    return;
+  }
+
   char *t = NULL;
 
   if (adata->unicode)
@@ -350,9 +456,14 @@ void imap_utf_decode(struct ImapAccountData *adata, char **s)
 
   if (t && mutt_ch_convert_string(&t, "utf-8", Charset, 0) == 0)
   {
+    utf_cache_add(adata->utf_decode_cache, *s, t);
+    utf_cache_add(adata->utf_encode_cache, t, *s);
     FREE(s);
     *s = t;
   }
   else
+  {
+    utf_cache_add(adata->utf_decode_cache, *s, *s);
     FREE(&t);
+  }
 }
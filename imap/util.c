@@ -223,22 +223,25 @@ void imap_clean_path(char *path, size_t plen)
 #ifdef USE_HCACHE
 /**
  * imap_msn_index_to_uid_seqset - Convert MSN index of UIDs to Seqset
- * @param b     Buffer for the result
- * @param adata Imap Account data
+ * @param b         Buffer for the result
+ * @param adata     Imap Account data
+ * @param msn_begin First MSN to convert
+ * @param msn_end   Last MSN to convert
  *
  * Generates a seqseq of the UIDs in msn_index to persist in the header cache.
  * Empty spots are stored as 0.
  */
-static void imap_msn_index_to_uid_seqset(struct Buffer *b, struct ImapAccountData *adata)
+static void imap_msn_index_to_uid_seqset(struct Buffer *b, struct ImapAccountData *adata,
+                                         unsigned int msn_begin, unsigned int msn_end)
 {
   int first = 1, state = 0;
   unsigned int cur_uid = 0, last_uid = 0;
   unsigned int range_begin = 0, range_end = 0;
 
-  for (unsigned int msn = 1; msn <= adata->max_msn + 1; msn++)
+  for (unsigned int msn = msn_begin; msn <= msn_end + 1; msn++)
   {
     bool match = false;
-    if (msn <= adata->max_msn)
+    if (msn <= msn_end)
     {
       struct Email *cur_header = adata->msn_index[msn - 1];
       cur_uid = cur_header ? IMAP_EDATA(cur_header)->uid : 0;
@@ -289,6 +292,32 @@ static int imap_hcache_namer(const char *path, char *dest, size_t dlen)
   return snprintf(dest, dlen, "%s.hcache", path);
 }
 
+/**
+ * imap_hcache_folder - Get the name of a mailbox in the header cache
+ * @param adata  Imap Account data
+ * @param mbox   Mailbox, as generated by imap_cachepath()
+ * @param buf    Buffer for the result
+ * @param buflen Length of the buffer
+ * @retval  0 Success
+ * @retval -1 The name would escape the cache directory
+ */
+static int imap_hcache_folder(struct ImapAccountData *adata, char *mbox,
+                              char *buf, size_t buflen)
+{
+  struct Url url;
+
+  if (strstr(mbox, "/../") || (strcmp(mbox, "..") == 0) || (strncmp(mbox, "../", 3) == 0))
+    return -1;
+  size_t len = strlen(mbox);
+  if ((len > 3) && (strcmp(mbox + len - 3, "/..") == 0))
+    return -1;
+
+  mutt_account_tourl(&adata->conn->account, &url);
+  url.path = mbox;
+  url_tostring(&url, buf, buflen, U_PATH);
+  return 0;
+}
+
 /**
  * imap_hcache_open - Open a header cache
  * @param adata Imap Account data
@@ -299,7 +328,6 @@ static int imap_hcache_namer(const char *path, char *dest, size_t dlen)
 header_cache_t *imap_hcache_open(struct ImapAccountData *adata, const char *path)
 {
   struct ImapMbox mx;
-  struct Url url;
   char cachepath[PATH_MAX];
   char mbox[PATH_MAX];
 
@@ -314,19 +342,120 @@ header_cache_t *imap_hcache_open(struct ImapAccountData *adata, const char *path
     FREE(&mx.mbox);
   }
 
-  if (strstr(mbox, "/../") || (strcmp(mbox, "..") == 0) || (strncmp(mbox, "../", 3) == 0))
-    return NULL;
-  size_t len = strlen(mbox);
-  if ((len > 3) && (strcmp(mbox + len - 3, "/..") == 0))
+  if (imap_hcache_folder(adata, mbox, cachepath, sizeof(cachepath)) < 0)
     return NULL;
 
-  mutt_account_tourl(&adata->conn->account, &url);
-  url.path = mbox;
-  url_tostring(&url, cachepath, sizeof(cachepath), U_PATH);
-
   return mutt_hcache_open(HeaderCache, cachepath, imap_hcache_namer);
 }
 
+/**
+ * imap_hcache_prefetch - Warm up the header cache of a mailbox
+ * @param path Path of the mailbox, e.g. imaps://host/INBOX
+ *
+ * Only mailboxes on servers we're already connected to are considered.
+ */
+void imap_hcache_prefetch(const char *path)
+{
+  struct ImapMbox mx;
+  char cachepath[PATH_MAX];
+  char mbox[PATH_MAX];
+
+  if (!HeaderCache || (imap_parse_path(path, &mx) < 0))
+    return;
+
+  struct ImapAccountData *adata = imap_conn_find(&mx.account, MUTT_IMAP_CONN_NONEW);
+  if (adata)
+  {
+    imap_cachepath(adata, mx.mbox, mbox, sizeof(mbox));
+    if (imap_hcache_folder(adata, mbox, cachepath, sizeof(cachepath)) == 0)
+      mutt_hcache_prefetch(HeaderCache, cachepath, imap_hcache_namer);
+  }
+
+  FREE(&mx.mbox);
+}
+
+/**
+ * imap_hcache_server_fetch - Recall what a server told us the last time
+ * @param adata Imap Account data, just authenticated
+ * @retval true The server's greeting matched
+ *
+ * The capabilities, root delimiter and UTF-8 mode of the last login to the
+ * account are kept in its header cache, keyed by the server's greeting.  If
+ * the greeting hasn't changed, they're restored, which saves asking for them
+ * again.  They're trusted for #IMAP_SERVER_CACHE_AGE seconds.
+ *
+ * Capabilities that came with the LOGIN response are newer, so they are kept.
+ */
+bool imap_hcache_server_fetch(struct ImapAccountData *adata)
+{
+  if (!adata->greeting)
+    return false;
+
+  header_cache_t *hc = imap_hcache_open(adata, "");
+  if (!hc)
+    return false;
+
+  bool rc = false;
+  char *rec = mutt_hcache_fetch_raw(hc, "/SERVER", 7);
+  if (rec)
+  {
+    long stored = 0;
+    int delim = 0;
+    int unicode = 0;
+    int n = 0;
+    const time_t now = time(NULL);
+    char *greeting = NULL;
+    char *caps = NULL;
+
+    if ((sscanf(rec, "%ld %d %d\n%n", &stored, &delim, &unicode, &n) == 3) && (n > 0))
+    {
+      greeting = rec + n;
+      caps = strchr(greeting, '\n');
+    }
+    if (caps && (stored <= now) && ((now - stored) < IMAP_SERVER_CACHE_AGE))
+    {
+      *caps++ = '\0';
+      if (*caps && (mutt_str_strcmp(greeting, adata->greeting) == 0))
+      {
+        if (!adata->caps_seen)
+          imap_cmd_set_capabilities(adata, caps);
+        adata->delim = delim;
+        adata->unicode = unicode;
+        mutt_debug(2, "using the cached capabilities of %s\n", adata->conn->account.host);
+        rc = true;
+      }
+    }
+    mutt_hcache_free(hc, (void **) &rec);
+  }
+
+  mutt_hcache_close(hc);
+  return rc;
+}
+
+/**
+ * imap_hcache_server_store - Remember what a server told us
+ * @param adata Imap Account data, with its capabilities and delimiter known
+ *
+ * See imap_hcache_server_fetch()
+ */
+void imap_hcache_server_store(struct ImapAccountData *adata)
+{
+  if (!adata->greeting || !adata->capstr || (adata->status == IMAP_FATAL))
+    return;
+
+  header_cache_t *hc = imap_hcache_open(adata, "");
+  if (!hc)
+    return;
+
+  char *rec = NULL;
+  int len = safe_asprintf(&rec, "%ld %d %d\n%s\n%s", (long) time(NULL),
+                          adata->delim, adata->unicode, adata->greeting, adata->capstr);
+  if (len > 0)
+    mutt_hcache_store_raw(hc, "/SERVER", 7, rec, len + 1);
+  FREE(&rec);
+  mutt_hcache_close(hc);
+}
+
 /**
  * imap_hcache_close - Close the header cache
  * @param adata Imap Account data
@@ -381,7 +510,8 @@ int imap_hcache_put(struct ImapAccountData *adata, struct Email *e)
 {
   char key[16];
 
-  if (!adata->hcache)
+  /* an email without its headers would hide them next time */
+  if (!adata->hcache || IMAP_EDATA(e)->lazy)
     return -1;
 
   sprintf(key, "/%u", IMAP_EDATA(e)->uid);
@@ -411,24 +541,73 @@ int imap_hcache_del(struct ImapAccountData *adata, unsigned int uid)
  * @param adata Imap Account data
  * @retval  0 Success
  * @retval -1 Error
+ *
+ * The set is stored in records of #IMAP_SEQSET_CHUNK MSNs, "/UIDSEQSET/0",
+ * "/UIDSEQSET/1", etc., counted by "/UIDSEQSETS".  Only the records that have
+ * changed are written, so new mail or a few expunges near the end of a big
+ * mailbox are cheap to save.
  */
 int imap_hcache_store_uid_seqset(struct ImapAccountData *adata)
 {
   if (!adata->hcache)
     return -1;
 
+  char key[32];
+  unsigned int old_chunks = 0;
+  unsigned int *pchunks = mutt_hcache_fetch_raw(adata->hcache, "/UIDSEQSETS", 11);
+  const bool upgrade = !pchunks;
+  if (pchunks)
+  {
+    old_chunks = *pchunks;
+    mutt_hcache_free(adata->hcache, (void **) &pchunks);
+  }
+
+  unsigned int chunks = (adata->max_msn + IMAP_SEQSET_CHUNK - 1) / IMAP_SEQSET_CHUNK;
   struct Buffer *b = mutt_buffer_new();
-  /* The seqset is likely large.  Preallocate to reduce reallocs */
   mutt_buffer_increase_size(b, HUGE_STRING);
-  imap_msn_index_to_uid_seqset(b, adata);
+  unsigned int changed = 0;
+  int rc = 0;
 
-  size_t seqset_size = b->dptr - b->data;
-  if (seqset_size == 0)
-    b->data[0] = '\0';
+  for (unsigned int i = 0; i < chunks; i++)
+  {
+    const unsigned int msn_begin = (i * IMAP_SEQSET_CHUNK) + 1;
+    mutt_buffer_reset(b);
+    imap_msn_index_to_uid_seqset(b, adata, msn_begin,
+                                 MIN(msn_begin + IMAP_SEQSET_CHUNK - 1, adata->max_msn));
+
+    snprintf(key, sizeof(key), "/UIDSEQSET/%u", i);
+    char *old = mutt_hcache_fetch_raw(adata->hcache, key, imap_hcache_keylen(key));
+    const bool same = old && (mutt_str_strcmp(old, b->data) == 0);
+    mutt_hcache_free(adata->hcache, (void **) &old);
+    if (same)
+      continue;
 
-  int rc = mutt_hcache_store_raw(adata->hcache, "/UIDSEQSET", 10, b->data, seqset_size + 1);
-  mutt_debug(5, "Stored /UIDSEQSET %s\n", b->data);
+    if (mutt_hcache_store_raw(adata->hcache, key, imap_hcache_keylen(key), b->data,
+                              (b->dptr - b->data) + 1) != 0)
+    {
+      rc = -1;
+    }
+    changed++;
+  }
   mutt_buffer_free(&b);
+
+  for (unsigned int i = chunks; i < old_chunks; i++)
+  {
+    snprintf(key, sizeof(key), "/UIDSEQSET/%u", i);
+    mutt_hcache_delete(adata->hcache, key, imap_hcache_keylen(key));
+  }
+
+  if ((upgrade || (chunks != old_chunks)) &&
+      (mutt_hcache_store_raw(adata->hcache, "/UIDSEQSETS", 11, &chunks, sizeof(chunks)) != 0))
+  {
+    rc = -1;
+  }
+
+  /* the whole set used to be stored in one record */
+  if (upgrade)
+    mutt_hcache_delete(adata->hcache, "/UIDSEQSET", 10);
+
+  mutt_debug(3, "Stored /UIDSEQSET, %u of %u records changed\n", changed, chunks);
   return rc;
 }
 
@@ -443,6 +622,19 @@ int imap_hcache_clear_uid_seqset(struct ImapAccountData *adata)
   if (!adata->hcache)
     return -1;
 
+  unsigned int *pchunks = mutt_hcache_fetch_raw(adata->hcache, "/UIDSEQSETS", 11);
+  if (pchunks)
+  {
+    char key[32];
+    for (unsigned int i = 0; i < *pchunks; i++)
+    {
+      snprintf(key, sizeof(key), "/UIDSEQSET/%u", i);
+      mutt_hcache_delete(adata->hcache, key, imap_hcache_keylen(key));
+    }
+    mutt_hcache_free(adata->hcache, (void **) &pchunks);
+    mutt_hcache_delete(adata->hcache, "/UIDSEQSETS", 11);
+  }
+
   return mutt_hcache_delete(adata->hcache, "/UIDSEQSET", 10);
 }
 
@@ -457,10 +649,46 @@ char *imap_hcache_get_uid_seqset(struct ImapAccountData *adata)
   if (!adata->hcache)
     return NULL;
 
-  char *hc_seqset = mutt_hcache_fetch_raw(adata->hcache, "/UIDSEQSET", 10);
-  char *seqset = mutt_str_strdup(hc_seqset);
-  mutt_hcache_free(adata->hcache, (void **) &hc_seqset);
-  mutt_debug(5, "Retrieved /UIDSEQSET %s\n", NONULL(seqset));
+  unsigned int *pchunks = mutt_hcache_fetch_raw(adata->hcache, "/UIDSEQSETS", 11);
+  if (!pchunks)
+  {
+    char *hc_seqset = mutt_hcache_fetch_raw(adata->hcache, "/UIDSEQSET", 10);
+    char *seqset = mutt_str_strdup(hc_seqset);
+    mutt_hcache_free(adata->hcache, (void **) &hc_seqset);
+    mutt_debug(5, "Retrieved /UIDSEQSET %s\n", NONULL(seqset));
+    return seqset;
+  }
+
+  const unsigned int chunks = *pchunks;
+  mutt_hcache_free(adata->hcache, (void **) &pchunks);
+
+  struct Buffer *b = mutt_buffer_new();
+  mutt_buffer_increase_size(b, HUGE_STRING);
+  char key[32];
+
+  for (unsigned int i = 0; i < chunks; i++)
+  {
+    snprintf(key, sizeof(key), "/UIDSEQSET/%u", i);
+    char *hc_seqset = mutt_hcache_fetch_raw(adata->hcache, key, imap_hcache_keylen(key));
+    if (!hc_seqset)
+    {
+      mutt_debug(1, "/UIDSEQSET record %u of %u is missing\n", i, chunks);
+      mutt_buffer_free(&b);
+      return NULL;
+    }
+
+    if (*hc_seqset)
+    {
+      if (b->dptr != b->data)
+        mutt_buffer_addch(b, ',');
+      mutt_buffer_addstr(b, hc_seqset);
+    }
+    mutt_hcache_free(adata->hcache, (void **) &hc_seqset);
+  }
+
+  char *seqset = mutt_str_strdup(b->data ? b->data : "");
+  mutt_buffer_free(&b);
+  mutt_debug(5, "Retrieved /UIDSEQSET %s\n", seqset);
 
   return seqset;
 }
@@ -724,6 +952,7 @@ struct ImapAccountData *imap_adata_new(void)
 
   STAILQ_INIT(&adata->flags);
   STAILQ_INIT(&adata->mboxcache);
+  STAILQ_INIT(&adata->lists);
 
   return adata;
 }
@@ -737,8 +966,18 @@ void imap_adata_free(struct ImapAccountData **adata)
   if (!adata)
     return;
 
+  imap_extra_close(&(*adata)->poll);
+  imap_list_cache_clear(*adata);
+  for (int i = 0; i < (*adata)->num_idlers; i++)
+  {
+    imap_extra_close(&(*adata)->idlers[i].adata);
+    FREE(&(*adata)->idlers[i].name);
+  }
+  FREE(&(*adata)->idlers);
   FREE(&(*adata)->capstr);
+  FREE(&(*adata)->greeting);
   mutt_list_free(&(*adata)->flags);
+  imap_utf_cache_free(*adata);
   imap_mboxcache_free(*adata);
   mutt_buffer_free(&(*adata)->cmdbuf);
   FREE(&(*adata)->buf);
@@ -1053,14 +1292,53 @@ void imap_keepalive(void)
     if (conn->account.type == MUTT_ACCT_TYPE_IMAP)
     {
       adata = conn->data;
-      if (adata->state >= IMAP_AUTHENTICATED && now >= adata->lastread + ImapKeepalive)
-      {
-        imap_check(adata, true);
-      }
+      if ((adata->state < IMAP_AUTHENTICATED) || (now < adata->lastread + ImapKeepalive))
+        continue;
+
+      /* an IDLE is ended by the NOOP, anything else is still being waited for */
+      if ((adata->state != IMAP_IDLE) && imap_cmd_pending(adata))
+        continue;
+
+      /* the answer is picked up by imap_collect() */
+      if (imap_cmd_start(adata, "NOOP") == 0)
+        adata->background = true;
     }
   }
 }
 
+/**
+ * imap_collect - Read the answers to commands sent in the background
+ * @retval >0 Some answers, or changes to the mailbox, have arrived
+ * @retval  0 Still waiting for answers
+ * @retval -1 There's nothing to wait for
+ *
+ * This never waits for the server, so it can be called while waiting for a
+ * key.  See imap_cmd_collect().
+ */
+int imap_collect(void)
+{
+  struct Connection *conn = NULL;
+  struct ImapAccountData *adata = NULL;
+  int rc = -1;
+
+  TAILQ_FOREACH(conn, mutt_socket_head(), entries)
+  {
+    if ((conn->account.type != MUTT_ACCT_TYPE_IMAP) || !conn->data)
+      continue;
+
+    adata = conn->data;
+    if ((adata->state != IMAP_IDLE) && !adata->background)
+      continue;
+
+    if (rc < 0)
+      rc = 0;
+    if (imap_cmd_collect(adata) != 0)
+      rc = 1;
+  }
+
+  return rc;
+}
+
 /**
  * imap_wait_keepalive - Wait for a process to change state
  * @param pid Process ID to listen to
@@ -41,13 +41,16 @@
 #include "init.h"
 #include "alias.h"
 #include "context.h"
+#include "curs_lib.h"
 #include "filter.h"
 #include "group.h"
 #include "hcache/hcache.h"
 #include "keymap.h"
 #include "menu.h"
 #include "mutt_curses.h"
+#include "mutt_parse.h"
 #include "mutt_window.h"
+#include "muttlib.h"
 #include "mx.h"
 #include "myvar.h"
 #include "ncrypt/ncrypt.h"
@@ -89,6 +92,29 @@ static int MatchesListsize = MAX(NUMVARS, NUMCOMMANDS) + 10;
 static char **nm_tags;
 #endif
 
+/**
+ * find_command - Look up a Command by its name
+ * @param name Name of the command
+ * @retval ptr  Matching Command
+ * @retval NULL No such command
+ *
+ * Every line of config and every hook is dispatched with this, so the
+ * Commands are indexed by name the first time it's used.
+ */
+static const struct Command *find_command(const char *name)
+{
+  static struct Hash *index = NULL;
+
+  if (!index)
+  {
+    index = mutt_hash_create(NUMCOMMANDS, 0);
+    for (int i = 0; Commands[i].name; i++)
+      mutt_hash_insert(index, Commands[i].name, (void *) &Commands[i]);
+  }
+
+  return name ? mutt_hash_find(index, name) : NULL;
+}
+
 /**
  * enum GroupState - Type of email address group
  */
@@ -136,11 +162,34 @@ static void alternates_clean(void)
     Context->mailbox->hdrs[i]->recip_valid = false;
 }
 
+/**
+ * lists_clean - Clear the cached mailing lists of all emails
+ *
+ * Called when the mailing lists change.
+ */
+static void lists_clean(void)
+{
+  mutt_list_cache_flush();
+
+  if (!Context)
+    return;
+
+  for (int i = 0; i < Context->mailbox->msg_count; i++)
+  {
+    struct Email *e = Context->mailbox->hdrs[i];
+    e->recip_valid = false;
+    if (e->env)
+      e->env->list_valid = false;
+  }
+}
+
 /**
  * attachments_clean - always wise to do what someone else did before
  */
 static void attachments_clean(void)
 {
+  mutt_attach_rules_changed();
+
   if (!Context)
     return;
 
@@ -802,6 +851,8 @@ static int source_rc(const char *rcfile_path, struct Buffer *err)
     return -1;
   }
 
+  /* tell the listeners about the changed variables once, at the end */
+  cs_batch_begin(Config);
   mutt_buffer_init(&token);
   while ((linebuf = mutt_file_read_line(linebuf, &buflen, f, &line, MUTT_CONT)))
   {
@@ -847,6 +898,7 @@ static int source_rc(const char *rcfile_path, struct Buffer *err)
   }
   FREE(&token.data);
   FREE(&linebuf);
+  cs_batch_end(Config);
   mutt_file_fclose(&f);
   if (pid != -1)
     mutt_wait_filter(pid);
@@ -902,17 +954,14 @@ static int parse_alias(struct Buffer *buf, struct Buffer *s, unsigned long data,
     return -1;
 
   /* check to see if an alias with this name already exists */
-  TAILQ_FOREACH(tmp, &Aliases, entries)
-  {
-    if (mutt_str_strcasecmp(tmp->name, buf->data) == 0)
-      break;
-  }
+  tmp = mutt_hash_find(AliasNames, buf->data);
 
   if (!tmp)
   {
     /* create a new alias */
     tmp = mutt_mem_calloc(1, sizeof(struct Alias));
     tmp->name = mutt_str_strdup(buf->data);
+    mutt_alias_add_name(tmp);
     TAILQ_INSERT_TAIL(&Aliases, tmp, entries);
     /* give the main addressbook code a chance */
     if (CurrentMenu == MENU_ALIAS)
@@ -1228,14 +1277,7 @@ static int parse_ifdef(struct Buffer *buf, struct Buffer *s, unsigned long data,
   /* or a command? */
   if (!res)
   {
-    for (int i = 0; Commands[i].name; i++)
-    {
-      if (mutt_str_strcmp(buf->data, Commands[i].name) == 0)
-      {
-        res = true;
-        break;
-      }
-    }
+    res = !!find_command(buf->data);
   }
 
   /* or a my_ var? */
@@ -1280,6 +1322,8 @@ static int parse_ignore(struct Buffer *buf, struct Buffer *s,
     add_to_stailq(&Ignore, buf->data);
   } while (MoreArgs(s));
 
+  mutt_ignore_compile();
+
   return 0;
 }
 
@@ -1291,6 +1335,8 @@ static int parse_lists(struct Buffer *buf, struct Buffer *s, unsigned long data,
 {
   struct GroupContext *gc = NULL;
 
+  lists_clean();
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -1315,6 +1361,62 @@ bail:
   return -1;
 }
 
+/**
+ * dump_memory_stats - Write the memory use of each category
+ * @param fp File to write to
+ */
+static void dump_memory_stats(FILE *fp)
+{
+  struct MemStats st;
+  struct MemStats total = { 0 };
+
+  fprintf(fp, "%-12s %14s %10s %14s\n", "category", "bytes", "objects", "peak");
+  for (int i = 0; i < MEM_TAG_MAX; i++)
+  {
+    mutt_mem_stats(i, &st);
+    fprintf(fp, "%-12s %14zu %10zu %14zu\n", mutt_mem_tag_name(i), st.bytes,
+            st.objects, st.peak);
+    total.bytes += st.bytes;
+    total.objects += st.objects;
+  }
+  fprintf(fp, "%-12s %14zu %10zu\n", "total", total.bytes, total.objects);
+}
+
+/**
+ * parse_memory_stats - Parse the 'memory-stats' command - Implements ::command_t
+ *
+ * Show how much memory each category of object is using.
+ */
+static int parse_memory_stats(struct Buffer *buf, struct Buffer *s,
+                              unsigned long data, struct Buffer *err)
+{
+  if (MoreArgs(s))
+  {
+    mutt_buffer_printf(err, _("%s: too many arguments"), "memory-stats");
+    return -1;
+  }
+
+  if (OptNoCurses)
+  {
+    dump_memory_stats(stdout);
+    return 0;
+  }
+
+  char tempfile[PATH_MAX];
+  mutt_mktemp(tempfile, sizeof(tempfile));
+  FILE *fp = mutt_file_fopen(tempfile, "w");
+  if (!fp)
+  {
+    mutt_buffer_printf(err, _("Could not create temporary file %s"), tempfile);
+    return -1;
+  }
+
+  dump_memory_stats(fp);
+  mutt_file_fclose(&fp);
+  mutt_do_pager("memory-stats", tempfile, 0, NULL);
+  return 0;
+}
+
 /**
  * parse_my_hdr - Parse the 'my_hdr' command - Implements ::command_t
  */
@@ -1875,6 +1977,9 @@ static int parse_spam_list(struct Buffer *buf, struct Buffer *s,
   /* Extract the first token, a regex */
   mutt_extract_token(buf, s, 0);
 
+  /* the spam lists are applied when a header is parsed */
+  mutt_hdrshare_flush();
+
   /* data should be either MUTT_SPAM or MUTT_NOSPAM. MUTT_SPAM is for spam commands. */
   if (data == MUTT_SPAM)
   {
@@ -1967,6 +2072,8 @@ static int parse_subscribe(struct Buffer *buf, struct Buffer *s,
 {
   struct GroupContext *gc = NULL;
 
+  lists_clean();
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -2119,6 +2226,7 @@ static int parse_tag_transforms(struct Buffer *buf, struct Buffer *s,
     }
 
     mutt_hash_insert(TagTransforms, tag, transform);
+    driver_tags_invalidate();
   }
   return 0;
 }
@@ -2151,21 +2259,18 @@ static int parse_unalias(struct Buffer *buf, struct Buffer *s,
     }
     else
     {
-      TAILQ_FOREACH(a, &Aliases, entries)
+      a = mutt_hash_find(AliasNames, buf->data);
+      if (a)
       {
-        if (mutt_str_strcasecmp(buf->data, a->name) == 0)
+        if (CurrentMenu == MENU_ALIAS)
         {
-          if (CurrentMenu == MENU_ALIAS)
-          {
-            a->del = true;
-            mutt_menu_set_current_redraw_full();
-          }
-          else
-          {
-            TAILQ_REMOVE(&Aliases, a, entries);
-            mutt_alias_free(&a);
-          }
-          break;
+          a->del = true;
+          mutt_menu_set_current_redraw_full();
+        }
+        else
+        {
+          TAILQ_REMOVE(&Aliases, a, entries);
+          mutt_alias_free(&a);
         }
       }
     }
@@ -2259,6 +2364,8 @@ static int parse_unignore(struct Buffer *buf, struct Buffer *s,
     remove_from_stailq(&Ignore, buf->data);
   } while (MoreArgs(s));
 
+  mutt_ignore_compile();
+
   return 0;
 }
 
@@ -2268,6 +2375,8 @@ static int parse_unignore(struct Buffer *buf, struct Buffer *s,
 static int parse_unlists(struct Buffer *buf, struct Buffer *s,
                          unsigned long data, struct Buffer *err)
 {
+  lists_clean();
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -2362,6 +2471,8 @@ static int parse_unsubjectrx_list(struct Buffer *buf, struct Buffer *s,
 static int parse_unsubscribe(struct Buffer *buf, struct Buffer *s,
                              unsigned long data, struct Buffer *err)
 {
+  lists_clean();
+
   do
   {
     mutt_extract_token(buf, s, 0);
@@ -2436,10 +2547,7 @@ static int parse_unsubscribe_from(struct Buffer *buf, struct Buffer *s,
  */
 const struct Command *mutt_command_get(const char *s)
 {
-  for (int i = 0; Commands[i].name; i++)
-    if (mutt_str_strcmp(s, Commands[i].name) == 0)
-      return &Commands[i];
-  return NULL;
+  return find_command(s);
 }
 #endif
 
@@ -2773,6 +2881,8 @@ void mutt_free_opts(void)
 {
   mutt_list_free(&MuttrcStack);
 
+  mutt_hdrshare_flush();
+
   FREE(&Matches);
 
   mutt_aliaslist_free(&Aliases);
@@ -2784,11 +2894,16 @@ void mutt_free_opts(void)
   mutt_regexlist_free(&UnAlternates);
   mutt_regexlist_free(&UnMailLists);
   mutt_regexlist_free(&UnSubscribedLists);
+  mutt_list_cache_flush();
 
+  mutt_hash_destroy(&AliasNames);
   mutt_hash_destroy(&Groups);
   mutt_hash_destroy(&ReverseAliases);
   mutt_hash_destroy(&TagFormats);
   mutt_hash_destroy(&TagTransforms);
+  driver_tags_cleanup();
+  mx_path_probe_cache_free();
+  mutt_ignore_free();
 
   /* Lists of strings */
   mutt_list_free(&AlternativeOrderList);
@@ -2862,6 +2977,7 @@ int mutt_init(bool skip_sys_rc, struct ListHead *commands)
   err.data = mutt_mem_malloc(err.dsize);
   err.dptr = err.data;
 
+  AliasNames = mutt_hash_create(1031, MUTT_HASH_STRCASECMP);
   Groups = mutt_hash_create(1031, 0);
   /* reverse alias keys need to be strdup'ed because of idna conversions */
   ReverseAliases = mutt_hash_create(
@@ -3114,7 +3230,7 @@ int mutt_init(bool skip_sys_rc, struct ListHead *commands)
  */
 int mutt_parse_rc_line(/* const */ char *line, struct Buffer *token, struct Buffer *err)
 {
-  int i, r = 0;
+  int r = 0;
   struct Buffer expn;
 
   if (!line || !*line)
@@ -3138,24 +3254,20 @@ int mutt_parse_rc_line(/* const */ char *line, struct Buffer *token, struct Buff
       continue;
     }
     mutt_extract_token(token, &expn, 0);
-    for (i = 0; Commands[i].name; i++)
-    {
-      if (mutt_str_strcmp(token->data, Commands[i].name) == 0)
-      {
-        r = Commands[i].func(token, &expn, Commands[i].data, err);
-        if (r != 0)
-        {              /* -1 Error, +1 Finish */
-          goto finish; /* Propagate return code */
-        }
-        break; /* Continue with next command */
-      }
-    }
-    if (!Commands[i].name)
+    const struct Command *cmd = find_command(token->data);
+    if (!cmd)
     {
       mutt_buffer_printf(err, _("%s: unknown command"), NONULL(token->data));
       r = -1;
       break; /* Ignore the rest of the line */
     }
+
+    r = cmd->func(token, &expn, cmd->data, err);
+    if (r != 0)
+    {              /* -1 Error, +1 Finish */
+      goto finish; /* Propagate return code */
+    }
+    /* Continue with next command */
   }
 finish:
   if (expn.destroy)
@@ -3229,6 +3341,8 @@ int query_quadoption(int opt, const char *prompt)
       return opt;
 
     default:
+      if (OptNoPrompt)
+        return (opt == MUTT_ASKYES) ? MUTT_YES : MUTT_NO;
       opt = mutt_yesorno(prompt, (opt == MUTT_ASKYES));
       mutt_window_clearline(MuttMessageWindow, 0);
       return opt;
@@ -3737,6 +3851,26 @@ int hcache_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef,
   mutt_buffer_printf(err, _("Invalid value for option %s: %s"), cdef->name, str);
   return CSR_ERR_INVALID;
 }
+
+#ifdef USE_HCACHE_COMPRESSION
+/**
+ * compress_validator - Validate the "header_cache_compress_method" config variable - Implements ::cs_validator()
+ */
+int compress_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef,
+                       intptr_t value, struct Buffer *err)
+{
+  if (value == 0)
+    return CSR_SUCCESS;
+
+  const char *str = (const char *) value;
+
+  if (mutt_hcache_is_valid_compression(str))
+    return CSR_SUCCESS;
+
+  mutt_buffer_printf(err, _("Invalid value for option %s: %s"), cdef->name, str);
+  return CSR_ERR_INVALID;
+}
+#endif
 #endif
 
 /**
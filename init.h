@@ -40,6 +40,7 @@
 #include "color.h"
 #include "commands.h"
 #include "compose.h"
+#include "compress.h"
 #include "curs_lib.h"
 #include "curs_main.h"
 #include "edit.h"
@@ -53,6 +54,7 @@
 #include "mailbox.h"
 #include "maildir/maildir.h"
 #include "main.h"
+#include "mbox/mbox.h"
 #include "menu.h"
 #include "mutt_account.h"
 #include "mutt_commands.h"
@@ -115,6 +117,7 @@ enum MuttSetCommand
 bool IgnoreLinearWhiteSpace = false;
 
 int charset_validator  (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
+int compress_validator (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int hcache_validator   (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int multipart_validator(const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
 int pager_validator    (const struct ConfigSet *cs, const struct ConfigDef *cdef, intptr_t value, struct Buffer *err);
@@ -534,6 +537,23 @@ struct ConfigDef MuttVars[] = {
   ** See the text describing the $$status_format option for more
   ** information on how to set $$compose_format.
   */
+  { "compress_stream",  DT_BOOL, R_NONE, &CompressStream, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, a compressed mailbox (see ``$open-hook'') that NeoMutt
+  ** won't write to is decompressed while it's read, instead of being unpacked
+  ** into a temporary file first.  This is faster, and needs no disk space,
+  ** but it only works for gzip and zstd files that contain an mbox or MMDF
+  ** mailbox.  Other files are still unpacked with the ``$open-hook''.
+  ** .pp
+  ** A mailbox is read-only if it has no ``$close-hook'', if the file isn't
+  ** writable, or if it was opened with \fC<change-folder-readonly>\fP.
+  ** .pp
+  ** Opening the mailbox decompresses the whole file once, to find its size.
+  ** Moving to a message may decompress up to 4MiB of data before it.  A
+  ** zstd file can only be entered at the start of a frame, so it should be
+  ** compressed in several frames, e.g. with \fCpzstd\fP.
+  */
   { "config_charset",   DT_STRING,  R_NONE, &ConfigCharset, 0, charset_validator },
   /*
   ** .pp
@@ -1231,6 +1251,27 @@ struct ConfigDef MuttVars[] = {
   ** cached folders.
   */
 #endif /* HAVE_QDBM */
+#ifdef USE_HCACHE_COMPRESSION
+  { "header_cache_compress_level", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &HeaderCacheCompressLevel, 1 },
+  /*
+  ** .pp
+  ** When NeoMutt is compiled with lz4, zlib or zstd, this option can be used
+  ** to set the compression level used by $$header_cache_compress_method.
+  ** Higher numbers compress better, but are slower.  Out-of-range values
+  ** are clamped to the method's own range.
+  */
+  { "header_cache_compress_method", DT_STRING, R_NONE, &HeaderCacheCompressMethod, 0, compress_validator },
+  /*
+  ** .pp
+  ** When NeoMutt is compiled with lz4, zlib or zstd, header cache records
+  ** can be compressed before they are handed to the backend.  This works
+  ** with every backend, including lmdb, gdbm and bdb.
+  ** .pp
+  ** Setting this changes the name of the cache files, so existing records
+  ** are never read with the wrong method.  Leave it unset to disable
+  ** compression.
+  */
+#endif /* USE_HCACHE_COMPRESSION */
 #if defined(HAVE_GDBM) || defined(HAVE_BDB)
   { "header_cache_pagesize", DT_STRING, R_NONE, &HeaderCachePagesize, IP "16384" },
   /*
@@ -1241,6 +1282,58 @@ struct ConfigDef MuttVars[] = {
   ** or less optimal for most use cases.
   */
 #endif /* HAVE_GDBM || HAVE_BDB */
+  { "header_cache_per_account", DT_BOOL, R_NONE, &HeaderCachePerAccount, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, and the header cache is kept in a directory (see
+  ** $$header_cache and $$news_cache_dir), NeoMutt keeps a single header
+  ** cache database for each IMAP, POP or NNTP account,
+  ** rather than one per folder.  The database is opened once and kept open,
+  ** so changing folder is cheaper and fewer file descriptors are used.
+  ** .pp
+  ** Local folders, such as Maildir and MH, still get a database each.
+  */
+  { "header_cache_prefetch", DT_BOOL, R_NONE, &HeaderCachePrefetch, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt uses idle time (see $$timeout) to warm up the
+  ** header cache of the folders in the ``$mailboxes'' list, one at a time.
+  ** Folders with new mail are warmed up first.  The database is read ahead
+  ** by the operating system in the background, so that changing to the
+  ** folder later doesn't have to wait for the disk.
+  ** .pp
+  ** Only Maildir, MH and IMAP folders are warmed up.  IMAP folders are only
+  ** considered if NeoMutt is already connected to their server.
+  */
+  { "header_cache_shared", DT_BOOL, R_NONE, &HeaderCacheShared, false },
+  /*
+  ** .pp
+  ** Set this if several copies of NeoMutt use the same header cache at the
+  ** same time, e.g. to read the same account in different terminals.
+  ** .pp
+  ** NeoMutt then never waits for another process to release the database.
+  ** Reads don't lock out other readers and, if the database is being
+  ** written, a record is simply treated as missing.  Writes are collected
+  ** and made in one short transaction, at the end of each batch, or when
+  ** the folder is closed.  If the database is busy, they are tried again
+  ** later.  Records written by the other processes are seen without
+  ** reopening the folder.
+  ** .pp
+  ** This option takes effect when the header cache of a folder is opened.
+  */
+  { "header_cache_threads", DT_BOOL, R_NONE, &HeaderCacheThreads, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, and $$header_cache is set, NeoMutt saves the threads of
+  ** Maildir, MH, mbox and MMDF folders in the header cache.  The next time the
+  ** folder is threaded from scratch, e.g. when it's opened, the threads are
+  ** restored instead of being worked out again from the headers.
+  ** .pp
+  ** The saved threads are only used if none of the headers that threading
+  ** looks at have changed, and neither have $$strict_threads,
+  ** $$duplicate_threads, $$thread_received or $$sort_re.  They are sorted
+  ** using the current $$sort_aux.
+  */
 #endif /* USE_HCACHE */
   { "header_color_partial", DT_BOOL, R_PAGER_FLOW, &HeaderColorPartial, false },
   /*
@@ -1253,6 +1346,19 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** See ``$color'' for more details.
   */
+  { "header_share_size", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &HeaderShareSize, 1000 },
+  /*
+  ** .pp
+  ** The same email is often found in several mailboxes, e.g. an IMAP label
+  ** and the ``All Mail'' folder, or a notmuch virtual folder and the Maildir
+  ** it searches.  NeoMutt remembers the headers it has parsed recently, from
+  ** any mailbox, and copies the result when it meets an identical header
+  ** again, instead of parsing it again.  This variable sets how many parsed
+  ** headers are kept.  A value of zero turns this off.
+  ** .pp
+  ** This is used for Maildir, MH, notmuch, IMAP and NNTP headers that aren't
+  ** in the header cache.
+  */
   { "help",             DT_BOOL, R_REFLOW, &Help, true },
   /*
   ** .pp
@@ -1434,6 +1540,16 @@ struct ConfigDef MuttVars[] = {
   ** those, and displays worse performance when enabled.  Your
   ** mileage may vary.
   */
+  { "imap_deflate",             DT_BOOL, R_NONE, &ImapDeflate, true },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt will use the COMPRESS=DEFLATE extension (RFC
+  ** 4978) if advertised by the server.  All the traffic on the connection is
+  ** compressed, which can make downloading headers and messages several times
+  ** faster on a slow link.
+  ** .pp
+  ** This has no effect if NeoMutt was built without zlib.
+  */
   { "imap_delim_chars",         DT_STRING, R_NONE, &ImapDelimChars, IP "/." },
   /*
   ** .pp
@@ -1441,6 +1557,34 @@ struct ConfigDef MuttVars[] = {
   ** as folder separators for displaying IMAP paths. In particular it
   ** helps in using the ``='' shortcut for your \fIfolder\fP variable.
   */
+  { "imap_fetch_chunk_size", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapFetchChunkSize, 0 },
+  /*
+  ** .pp
+  ** Controls how many message headers NeoMutt asks for in each \fCFETCH\fP
+  ** command, when it downloads the headers of a mailbox.  Several commands
+  ** are sent at once, up to $$imap_pipeline_depth, so that the server is
+  ** kept busy while the replies travel back.
+  ** .pp
+  ** When this is 0, NeoMutt measures the round-trip time and the speed of
+  ** the server, and adapts both the size and the number of commands in
+  ** flight.  A slow server is given smaller commands, and a distant one is
+  ** given more of them.
+  */
+  { "imap_fetch_connections", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapFetchConnections, 1 },
+  /*
+  ** .pp
+  ** Controls how many connections NeoMutt uses to download the headers of a
+  ** large mailbox, e.g. the first time it's opened.  When this is more than
+  ** 1, NeoMutt logs in again, opens the mailbox read-only, and shares the
+  ** headers out between the connections.  Only as many are opened as are
+  ** worth the time it takes to log them in, and they're closed as soon as the
+  ** headers have arrived.
+  ** .pp
+  ** This can make the download several times faster, but servers limit the
+  ** number of connections a user may have.  If an extra connection can't be
+  ** made, or it fails, NeoMutt carries on with the others.  It isn't used
+  ** with $$tunnel.
+  */
   { "imap_headers",     DT_STRING, R_INDEX, &ImapHeaders, 0 },
   /*
   ** .pp
@@ -1464,6 +1608,17 @@ struct ConfigDef MuttVars[] = {
   ** to NeoMutt's implementation. If your connection seems to freeze
   ** up periodically, try unsetting this.
   */
+  { "imap_idle_connections",    DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapIdleConnections, 0 },
+  /*
+  ** .pp
+  ** When this is non-zero and $$imap_idle is \fIset\fP, NeoMutt opens up to
+  ** this many extra connections to each IMAP server and uses them to IDLE on
+  ** the first mailboxes of that server in the ``$mailboxes'' list (other than the
+  ** one that's open).  The server tells NeoMutt about changes to these
+  ** mailboxes as they happen, and they're no longer checked with STATUS.
+  ** .pp
+  ** Many servers limit the number of connections a user may have open.
+  */
   { "imap_keepalive",           DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &ImapKeepalive, 300 },
   /*
   ** .pp
@@ -1475,6 +1630,28 @@ struct ConfigDef MuttVars[] = {
   ** violated every now and then. Reduce this number if you find yourself
   ** getting disconnected from your IMAP server due to inactivity.
   */
+  { "imap_lazy_headers",        DT_BOOL, R_NONE, &ImapLazyHeaders, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt only downloads the flags, sizes and dates of the
+  ** IMAP messages that aren't in the header cache, so a large folder opens
+  ** quickly.  The headers of a message are fetched when it's displayed in the
+  ** index, together with those of the messages around it.  While the index is
+  ** scrolled, more headers are fetched ahead each time.
+  ** .pp
+  ** If the server can sort and thread the folder, see $$imap_server_sort,
+  ** the headers aren't needed to sort it.  Otherwise, and for searching or
+  ** limiting, the remaining headers are fetched first.
+  */
+  { "imap_list_cache_timeout",  DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapListCacheTimeout, 0 },
+  /*
+  ** .pp
+  ** When this is non-zero, the IMAP folder browser remembers the folder lists
+  ** it gets from the server, for this many seconds.  Browsing the same folder
+  ** again within that time doesn't need to ask the server.  The lists are
+  ** fetched again after a mailbox is created, renamed, deleted or
+  ** (un)subscribed, and by the \fC<check-new>\fP function of the browser.
+  */
   { "imap_list_subscribed",     DT_BOOL, R_NONE, &ImapListSubscribed, false },
   /*
   ** .pp
@@ -1497,6 +1674,18 @@ struct ConfigDef MuttVars[] = {
   ** run on every connection attempt that uses the OAUTHBEARER authentication
   ** mechanism.
   */
+  { "imap_partial_fetch", DT_LONG|DT_NOT_NEGATIVE, R_NONE, &ImapPartialFetch, 0 },
+  /*
+  ** .pp
+  ** When displaying a message larger than this many bytes, NeoMutt only
+  ** downloads its first $$imap_partial_fetch bytes, which is usually enough
+  ** to show the text of a message with large attachments.  The rest of the
+  ** message is fetched when it's needed, e.g. when viewing its attachments,
+  ** replying to it or saving it.
+  ** .pp
+  ** Signed and encrypted messages are always downloaded whole.  A value of
+  ** 0 disables partial fetching.
+  */
   { "imap_pass",        DT_STRING,  R_NONE|F_SENSITIVE, &ImapPass, 0 },
   /*
   ** .pp
@@ -1536,6 +1725,18 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** \fBNote:\fP Changes to this variable have no effect on open connections.
   */
+  { "imap_poll_connection", DT_BOOL, R_NONE, &ImapPollConnection, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt checks the $$mailboxes on each IMAP server over a
+  ** second connection to it.  The STATUS commands for all the mailboxes are
+  ** sent together and NeoMutt doesn't wait for the replies, so checking many
+  ** mailboxes doesn't hold up the user interface.  The new mail counts are
+  ** updated as the replies arrive.
+  ** .pp
+  ** The connection is only made to servers that NeoMutt is already logged
+  ** in to.  If a server refuses it, its mailboxes are checked the usual way.
+  */
   { "imap_poll_timeout", DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &ImapPollTimeout, 15 },
   /*
   ** .pp
@@ -1544,6 +1745,17 @@ struct ConfigDef MuttVars[] = {
   ** for new mail, before timing out and closing the connection.  Set
   ** to 0 to disable timing out.
   */
+  { "imap_prefetch", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &ImapPrefetch, 0 },
+  /*
+  ** .pp
+  ** When a message is displayed, NeoMutt asks the server for up to this many
+  ** of the unread messages that follow it in the index, and stores them in
+  ** the $$message_cachedir.  They arrive while you read, so moving on to the
+  ** next message doesn't have to wait for the network.
+  ** .pp
+  ** Messages larger than $$imap_partial_fetch aren't read ahead.  This has
+  ** no effect unless $$message_cachedir is set.  A value of 0 disables it.
+  */
   { "imap_qresync",  DT_BOOL, R_NONE, &ImapQResync, 0 },
   /*
   ** .pp
@@ -1555,6 +1767,18 @@ struct ConfigDef MuttVars[] = {
   ** strange behavior, such as duplicate or missing messages please
   ** file a bug report to let us know.
   */
+  { "imap_server_sort",         DT_BOOL, R_NONE, &ImapServerSort, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt asks the IMAP server to sort and thread the
+  ** mailbox, if it supports the SORT and THREAD=REFERENCES extensions
+  ** (RFC5256).  Only sorting by date, date-received, size and subject is
+  ** done by the server; the other methods are done locally.
+  ** .pp
+  ** The server's threads replace NeoMutt's, so $$strict_threads and
+  ** $$duplicate_threads have no effect.  Emails that sort the same may be
+  ** in a different order.
+  */
   { "imap_servernoise",         DT_BOOL, R_NONE, &ImapServernoise, true },
   /*
   ** .pp
@@ -1740,6 +1964,17 @@ struct ConfigDef MuttVars[] = {
   ** from your spool mailbox to your $$mbox mailbox, or as a result of
   ** a ``$mbox-hook'' command.
   */
+  { "lock_timeout",     DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &LockTimeout, 5 },
+  /*
+  ** .pp
+  ** How many seconds NeoMutt waits for a mailbox that's locked by another
+  ** program, such as the MDA, before giving up.  The waits start at a few
+  ** milliseconds and back off, so a lock that's released quickly costs
+  ** little.  While the file is still growing, NeoMutt keeps waiting.
+  ** .pp
+  ** Pressing a key, or Ctrl-C, stops waiting.  A mailbox that can't be
+  ** locked for reading is opened read-only.
+  */
   { "mail_check",       DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &MailCheck, 5 },
   /*
   ** .pp
@@ -1807,13 +2042,67 @@ struct ConfigDef MuttVars[] = {
   ** to scan all cur messages.
   */
 #ifdef USE_HCACHE
+  { "maildir_header_cache_snapshot", DT_BOOL, R_NONE, &MaildirHeaderCacheSnapshot, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, together with $$maildir_header_cache_verify, NeoMutt
+  ** remembers which message files (by inode) were in each directory of a
+  ** Maildir or MH folder the last time it was read.  When the folder is opened
+  ** again, only the files that weren't there before are checked with
+  ** \fCstat(2)\fP, so an unchanged folder is verified without touching its
+  ** messages.
+  ** .pp
+  ** Programs that replace a message by writing a new file are still noticed.
+  ** A program that rewrites a message in place, keeping its inode, isn't.
+  */
   { "maildir_header_cache_verify", DT_BOOL, R_NONE, &MaildirHeaderCacheVerify, true },
   /*
   ** .pp
   ** Check for Maildir unaware programs other than NeoMutt having modified maildir
   ** files when the header cache is in use.  This incurs one \fCstat(2)\fP per
   ** message every time the folder is opened (which can be very slow for NFS
-  ** folders).
+  ** folders), unless $$maildir_header_cache_snapshot is set.
+  */
+#endif
+  { "maildir_lazy_headers", DT_BOOL, R_NONE, &MaildirLazyHeaders, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, and $$sort is ``unsorted'', Maildir and MH messages that
+  ** aren't in the header cache are added to the index by filename alone, so a
+  ** large folder opens at once.  The headers of a message are read when it's
+  ** displayed in the index.
+  ** .pp
+  ** Anything that needs every message, like sorting, searching or limiting,
+  ** reads the remaining headers first.  Until then, the size of the mailbox
+  ** only counts the messages whose headers have been read.
+  */
+  { "maildir_readahead", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &MaildirReadahead, 16 },
+  /*
+  ** .pp
+  ** When the headers of Maildir or MH messages have to be read from disk,
+  ** NeoMutt opens this many messages ahead of the one it's parsing and asks
+  ** the kernel to start reading them.  On cold caches and network
+  ** filesystems, this lets the reads overlap instead of waiting for each
+  ** message in turn.  A value of 0 or 1 reads one message at a time.
+  ** .pp
+  ** This isn't used when $$worker_threads is greater than 1.
+  */
+#ifdef USE_HCACHE
+  { "maildir_search_index", DT_BOOL, R_NONE, &MaildirSearchIndex, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt keeps an index of the text of Maildir and MH
+  ** messages in the header cache.  Body and header searches (``~b'', ``~B''
+  ** and ``~h'') for a plain string use it to skip the messages that can't
+  ** contain the string, without reading them.  The unfolded header lines of
+  ** each message are kept too, so any ``~h'' search, including a regular
+  ** expression, is answered from the index.
+  ** .pp
+  ** A message is indexed the first time it's searched, so the first search
+  ** of a folder is a little slower.  The index of a message is updated when
+  ** its file changes and is deleted when it's expunged.  Encrypted messages
+  ** aren't indexed.  A body search with a regular expression can only skip
+  ** messages if the expression contains some plain text.
   */
 #endif
   { "maildir_trash", DT_BOOL, R_NONE, &MaildirTrash, false },
@@ -1863,6 +2152,34 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** Also see the $$move variable.
   */
+#ifdef USE_HCACHE
+  { "mbox_header_cache", DT_BOOL, R_NONE, &MboxHeaderCache, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt stores the headers and positions of the messages
+  ** of an mbox folder in the $$header_cache.  When the folder is opened again,
+  ** only the mail that was appended since is read from the file.
+  ** .pp
+  ** The message counts used by $$mail_check_stats are kept there too, so an
+  ** mbox folder that has only grown is counted from where the last check
+  ** stopped.
+  ** .pp
+  ** The cache is thrown away whenever NeoMutt rewrites the folder.  Another
+  ** program that changes the start or the end of the cached part of the file
+  ** is noticed, but one that edits a message in the middle of the file without
+  ** changing its length isn't.
+  */
+#endif
+  { "mbox_mmap",        DT_BOOL, R_NONE, &MboxMmap, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt maps mbox and MMDF folders into memory while
+  ** reading them.  The bodies of the messages are then scanned for the next
+  ** message separator in place, instead of being read line by line, which
+  ** makes opening folders with large messages faster.
+  ** .pp
+  ** If the folder can't be mapped, it's read normally.
+  */
   { "mbox_type",        DT_MAGIC,R_NONE, &MboxType, MUTT_MBOX },
   /*
   ** .pp
@@ -1901,6 +2218,35 @@ struct ConfigDef MuttVars[] = {
   ** every once in a while, since it can be a little slow
   ** (especially for large folders).
   */
+  { "message_cache_compress", DT_BOOL, R_NONE, &MessageCacheCompress, false },
+  /*
+  ** .pp
+  ** If \fIset\fP, messages are compressed with gzip as they're added to the
+  ** message cache.  Mail is mostly text, so this often halves the space it
+  ** takes, at the cost of decompressing a message each time it's read.
+  ** .pp
+  ** The cache may hold a mixture of compressed and uncompressed messages.
+  ** This has no effect if NeoMutt was built without zlib.
+  */
+  { "message_cache_max_age", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &MessageCacheMaxAge, 0 },
+  /*
+  ** .pp
+  ** Messages in the $$message_cachedir that haven't been read for this many
+  ** days are removed.  A value of 0 keeps them forever.
+  ** .pp
+  ** Also see the $$message_cache_max_size variable.
+  */
+  { "message_cache_max_size", DT_LONG|DT_NOT_NEGATIVE, R_NONE, &MessageCacheMaxSize, 0 },
+  /*
+  ** .pp
+  ** The maximum size, in bytes, of the $$message_cachedir.  When the cache
+  ** grows larger than this, the least recently read messages are removed
+  ** until it's back under 90% of the limit.  A value of 0 means no limit.
+  ** .pp
+  ** To track usage, NeoMutt keeps an index file, \fC.index\fP, in the cache
+  ** directory while this or $$message_cache_max_age is set.  Messages which
+  ** were cached before then are only counted once they've been read again.
+  */
   { "message_cachedir", DT_PATH,        R_NONE, &MessageCachedir, 0 },
   /*
   ** .pp
@@ -1912,7 +2258,12 @@ struct ConfigDef MuttVars[] = {
   ** remote message only once and can perform regular expression searches
   ** as fast as for local folders.
   ** .pp
-  ** Also see the $$message_cache_clean variable.
+  ** The \fC<fetch-mail>\fP function also records here which messages it has
+  ** saved to $$spoolfile, so that an interrupted fetch carries on where it
+  ** stopped, and messages left on the server aren't saved twice.
+  ** .pp
+  ** Also see the $$message_cache_clean, $$message_cache_max_size and
+  ** $$message_cache_max_age variables.
   */
 #endif
   { "message_format",   DT_STRING|DT_NOT_EMPTY,  R_NONE, &MessageFormat, IP "%s" },
@@ -1922,6 +2273,17 @@ struct ConfigDef MuttVars[] = {
   ** attachments of type \fCmessage/rfc822\fP.  For a full listing of defined
   ** \fCprintf(3)\fP-like sequences see the section on $$index_format.
   */
+  { "message_mmap",     DT_BOOL, R_NONE, &MessageMmap, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt maps the messages of local folders (mbox, MMDF,
+  ** MH and Maildir) into memory while it displays, searches or copies them.
+  ** The message is then decoded or copied straight from memory, rather than
+  ** being read through a stream.
+  ** .pp
+  ** A folder mustn't be truncated by another program while one of its
+  ** messages is mapped.  If a message can't be mapped, it's read normally.
+  */
   { "meta_key",         DT_BOOL, R_NONE, &MetaKey, false },
   /*
   ** .pp
@@ -2139,6 +2501,16 @@ struct ConfigDef MuttVars[] = {
   ** The messages tagged with these tags are excluded and not loaded
   ** from notmuch DB to NeoMutt unless specified explicitly.
   */
+  { "nm_load_chunk", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &NmLoadChunk, 1000 },
+  /*
+  ** .pp
+  ** When a vfolder of type ``messages'' is opened, only this many results of
+  ** its query are read before the index is shown.  The rest are read
+  ** between keystrokes, this many at a time, while you read.  Set it to 0 to
+  ** read all the results before showing the index.
+  ** .pp
+  ** Also see $$nm_db_limit.
+  */
   { "nm_open_timeout", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &NmOpenTimeout, 5 },
   /*
   ** .pp
@@ -2308,6 +2680,16 @@ struct ConfigDef MuttVars[] = {
   ** when you are at the end of a message and invoke the \fC<next-page>\fP
   ** function.
   */
+  { "pager_stream",     DT_BOOL, R_NONE, &PagerStream, true },
+  /*
+  ** .pp
+  ** When \fIset\fP, the internal-pager shows a message as soon as the first
+  ** screenful has been decoded.  The rest of the message, e.g. the output of
+  ** an ``auto_view'' command, is decoded in the background.
+  ** .pp
+  ** Encrypted and signed messages, and messages shown through a
+  ** $$display_filter, are always decoded completely first.
+  */
   { "pgp_auto_decode", DT_BOOL, R_NONE, &PgpAutoDecode, false },
   /*
   ** .pp
@@ -2532,6 +2914,21 @@ struct ConfigDef MuttVars[] = {
   ** possible \fCprintf(3)\fP-like sequences.
   ** (PGP only)
   */
+  { "pgp_keyring_cache", DT_BOOL, R_NONE, &PgpKeyringCache, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt lists the whole keyring once, with
+  ** $$pgp_list_pubring_command or $$pgp_list_secring_command, and keeps the
+  ** parsed keys in memory.  Later key lookups, e.g. for each recipient of an
+  ** encrypted message, use the copy instead of running the command again.
+  ** The keyring is listed again when the GnuPG keyrings or the trust
+  ** database change.
+  ** .pp
+  ** This speeds up sending to many recipients, but the first lookup is slower
+  ** with a large keyring.  The files are looked for in \fC$$$GNUPGHOME\fP,
+  ** or \fC~/.gnupg\fP, so changes to other keyrings aren't noticed.
+  ** (PGP only)
+  */
   { "pgp_list_pubring_command", DT_COMMAND, R_NONE, &PgpListPubringCommand, 0 },
   /*
   ** .pp
@@ -2940,6 +3337,14 @@ struct ConfigDef MuttVars[] = {
   ** Those who use the \fCenscript\fP(1) program's mail-printing mode will
   ** most likely want to \fIset\fP this option.
   */
+  { "progress_rate",    DT_BOOL, R_NONE, &ProgressRate, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, progress updates also show how fast the work is going
+  ** and, if the total is known, an estimate of the time left.
+  ** .pp
+  ** Also see $$time_inc.
+  */
   { "prompt_after",     DT_BOOL, R_NONE, &PromptAfter, true },
   /*
   ** .pp
@@ -2948,6 +3353,25 @@ struct ConfigDef MuttVars[] = {
   ** than returning to the index menu.  If \fIunset\fP, NeoMutt will return to the
   ** index menu when the external pager exits.
   */
+  { "query_cache_prefix", DT_BOOL, R_NONE, &QueryCachePrefix, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, and $$query_cache_ttl is non-zero, a query that starts
+  ** with the string of a cached query doesn't run $$query_command.  Instead,
+  ** the cached results are filtered, keeping those whose address, name or
+  ** extra information contain the new string (ignoring case).
+  ** .pp
+  ** Only set this if a longer query never finds anything that a shorter one
+  ** misses, e.g. if your address book doesn't limit the number of results.
+  */
+  { "query_cache_ttl",  DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &QueryCacheTtl, 0 },
+  /*
+  ** .pp
+  ** The number of seconds to remember the results of a $$query_command.
+  ** Repeating a query within this time, e.g. when completing an address
+  ** again, reuses the results instead of running the command.  Results are
+  ** only kept if the command succeeds.  A value of 0 disables the cache.
+  */
   { "query_command", DT_COMMAND, R_NONE, &QueryCommand, 0 },
   /*
   ** .pp
@@ -2979,6 +3403,14 @@ struct ConfigDef MuttVars[] = {
   ** .pp
   ** * = can be optionally printed if nonzero, see the $$status_format documentation.
   */
+  { "query_stream",     DT_BOOL, R_NONE, &QueryStream, true },
+  /*
+  ** .pp
+  ** When \fIset\fP, the ``query'' menu is shown as soon as the first results
+  ** of the $$query_command arrive.  The rest are added while the command
+  ** runs.  Address completion only waits for a second result, before
+  ** showing the menu.  Leaving the menu stops the command.
+  */
   { "quit",             DT_QUAD, R_NONE, &Quit, MUTT_YES },
   /*
   ** .pp
@@ -3852,6 +4284,33 @@ struct ConfigDef MuttVars[] = {
   ** set smtp_authenticators="digest-md5:cram-md5"
   ** .te
   */
+  { "smtp_background", DT_BOOL, R_NONE, &SmtpBackground, false },
+  /*
+  ** .pp
+  ** When \fIset\fP, NeoMutt hands each message to a background process for
+  ** delivery by SMTP, and returns to the menu straight away.  The result is
+  ** shown in the message line when the delivery finishes.  If it fails, the
+  ** message is kept in $$tmpdir and its name is given with the error.
+  ** .pp
+  ** The password is asked for before the message is handed over, but the
+  ** background process can't ask any other questions, e.g. whether to
+  ** accept an unknown certificate: connect to the server once with this
+  ** option \fIunset\fP if that's needed.  In batch mode, messages are always
+  ** delivered before NeoMutt exits.  See $$smtp_url to configure NeoMutt to
+  ** send mail via SMTP.
+  */
+  { "smtp_idle_timeout", DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &SmtpIdleTimeout, 0 },
+  /*
+  ** .pp
+  ** If set to a value greater than zero, NeoMutt keeps the connection to the
+  ** SMTP server open for this many seconds after sending a message.  Sending
+  ** another message in that time reuses the connection, saving the greeting,
+  ** TLS negotiation and authentication.  A value of zero (the default) closes
+  ** the connection after each message.
+  ** .pp
+  ** If the server has closed the connection in the meantime, NeoMutt
+  ** reconnects.  See $$smtp_url to configure NeoMutt to send mail via SMTP.
+  */
   { "smtp_oauth_refresh_command", DT_STRING, R_NONE, &SmtpOauthRefreshCmd, 0 },
   /*
   ** .pp
@@ -3885,6 +4344,15 @@ struct ConfigDef MuttVars[] = {
   ** variable.
   */
 #endif /* USE_SMTP */
+  { "socket_buffer_size", DT_LONG|DT_NOT_NEGATIVE, R_NONE, &SocketBufferSize, 65536 },
+  /*
+  ** .pp
+  ** The size, in bytes, of the buffers NeoMutt uses to read from and
+  ** write to a network connection (for IMAP, POP, NNTP or SMTP).  Larger
+  ** buffers mean fewer system calls when a lot of data is transferred.
+  ** Values smaller than 1024 are treated as 1024.  A change only affects
+  ** connections that are opened afterwards.
+  */
   { "sort",             DT_SORT, R_INDEX|R_RESORT, &Sort, SORT_DATE, pager_validator },
   /*
   ** .pp
@@ -4163,6 +4631,7 @@ struct ConfigDef MuttVars[] = {
   ** .dt %f  .dd The full pathname of the current mailbox
   ** .dt %F  .dd Number of flagged messages *
   ** .dt %h  .dd Local hostname
+  ** .dt %H  .dd Header cache hit rate (percent) for this session *
   ** .dt %l  .dd Size (in bytes) of the current mailbox *
   ** .dt %L  .dd Size (in bytes) of the messages shown
   **             (i.e., which match the current limit) *
@@ -4288,7 +4757,7 @@ struct ConfigDef MuttVars[] = {
   ** When \fIset\fP, the internal-pager will pad blank lines to the bottom of the
   ** screen with a tilde (``~'').
   */
-  { "time_inc",         DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &TimeInc, 0 },
+  { "time_inc",         DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &TimeInc, 100 },
   /*
   ** .pp
   ** Along with $$read_inc, $$write_inc, and $$net_inc, this
@@ -4297,6 +4766,10 @@ struct ConfigDef MuttVars[] = {
   ** apart. This can improve throughput on systems with slow terminals,
   ** or when running NeoMutt on a remote system.
   ** .pp
+  ** If $$time_inc is non-zero, an update is also shown when a second has
+  ** passed without one, so that slow transfers keep moving.  A value of 0
+  ** disables the time-based checks.
+  ** .pp
   ** Also see the ``$tuning'' section of the manual for performance considerations.
   */
   { "timeout",          DT_NUMBER|DT_NOT_NEGATIVE,  R_NONE, &Timeout, 600 },
@@ -4338,6 +4811,25 @@ struct ConfigDef MuttVars[] = {
   ** .dt 7 .dd R .dd Your address appears in the ``Reply-To:'' header field but none of the above applies.
   ** .de
   */
+#ifdef USE_TRACE
+  { "trace_file",       DT_PATH, R_NONE, &TraceFile, 0 },
+  /*
+  ** .pp
+  ** If set, NeoMutt records the time taken by slow operations, such as
+  ** opening a mailbox, reading the header cache, sorting, threading,
+  ** drawing the screen and network round trips, and writes it to this file.
+  ** Counters, such as the number of messages read, are recorded too.
+  ** .pp
+  ** The file is in the Chrome Trace Event format.  It can be loaded into
+  ** \fCchrome://tracing\fP or \fChttps://ui.perfetto.dev\fP.  Unsetting the
+  ** variable finishes the file.
+  ** .pp
+  ** Only the first word of network commands is recorded, but the
+  ** mailbox paths are saved too.
+  ** .pp
+  ** This option is only available if NeoMutt was configured with \fC--trace\fP.
+  */
+#endif
   { "trash",            DT_PATH|DT_MAILBOX, R_NONE, &Trash, 0 },
   /*
   ** .pp
@@ -4529,6 +5021,23 @@ struct ConfigDef MuttVars[] = {
   ** When \fIset\fP, searches will wrap around the first (or last) item. When
   ** \fIunset\fP, incremental searches will not wrap.
   */
+  { "worker_threads",   DT_NUMBER|DT_NOT_NEGATIVE, R_NONE, &WorkerThreads, 0 },
+  /*
+  ** .pp
+  ** The number of threads NeoMutt may use for CPU-heavy work.  Currently,
+  ** this is used to parse the headers of Maildir and MH messages that
+  ** aren't in the header cache, and to match the messages of a Maildir or MH
+  ** folder against a pattern that reads them (e.g. ``~b'') when limiting,
+  ** tagging or deleting, if $$thorough_search is unset.  The Maildir and MH
+  ** $$mailboxes are also checked for new mail in parallel, and up to this
+  ** many PGP key listings are run at once when looking up the keys of several
+  ** recipients without GPGME (see $$crypt_opportunistic_encrypt).  A value of
+  ** 0 or 1 keeps all the work in a single thread.
+  ** .pp
+  ** A number close to the number of CPU cores is a good choice for very
+  ** large folders.  This has no effect if NeoMutt was built without
+  ** thread support.
+  */
   { "write_bcc",        DT_BOOL, R_NONE, &WriteBcc, true },
   /*
   ** .pp
@@ -4606,6 +5115,7 @@ static int parse_group           (struct Buffer *buf, struct Buffer *s, unsigned
 static int parse_ifdef           (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 static int parse_ignore          (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 static int parse_lists           (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
+static int parse_memory_stats    (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 static int parse_my_hdr          (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
 #ifdef USE_SIDEBAR
 static int parse_path_list       (struct Buffer *buf, struct Buffer *s, unsigned long data, struct Buffer *err);
@@ -4683,6 +5193,7 @@ const struct Command Commands[] = {
   { "mailboxes",           mutt_parse_mailboxes,   0 },
   { "mailto_allow",        parse_stailq,           UL &MailToAllow },
   { "mbox-hook",           mutt_parse_hook,        MUTT_MBOX_HOOK },
+  { "memory-stats",        parse_memory_stats,     0 },
   { "message-hook",        mutt_parse_hook,        MUTT_MESSAGE_HOOK },
   { "mime_lookup",         parse_stailq,           UL &MimeLookupList },
   { "mono",                mutt_parse_mono,        0 },
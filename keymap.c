@@ -40,12 +40,21 @@
 #include "ncrypt/ncrypt.h"
 #include "opcodes.h"
 #include "options.h"
+#include "pager.h"
+#include "query.h"
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
 #ifdef USE_INOTIFY
 #include "monitor.h"
 #endif
+#ifdef USE_HCACHE
+#include "mailbox.h"
+#endif
+#ifdef USE_NOTMUCH
+#include "context.h"
+#include "notmuch/mutt_notmuch.h"
+#endif
 
 /**
  * Menus - Menu name lookup table
@@ -139,6 +148,127 @@ int LastKey; /**< contains the last key the user pressed */
 
 struct Keymap *Keymaps[MENU_MAX];
 
+/**
+ * struct KeymapNode - A key in the compiled key bindings of a Menu
+ */
+struct KeymapNode
+{
+  keycode_t key;                /**< Key pressed to get here */
+  short num_children;           /**< Number of children */
+  struct Keymap *map;           /**< Binding ending with this key, or NULL */
+  struct KeymapNode *children;  /**< Following keys, sorted */
+};
+
+/**
+ * struct KeymapIndex - The compiled key bindings of a Menu
+ *
+ * Built from Keymaps[menu] when needed, and thrown away when it changes.
+ */
+struct KeymapIndex
+{
+  struct KeymapNode root;       /**< Tree of key sequences */
+  struct Keymap *funcs[OP_MAX]; /**< First binding of each function */
+};
+
+static struct KeymapIndex *KeymapIndexes[MENU_MAX];
+
+/**
+ * km_node_free - Free the children of a KeymapNode
+ * @param node Node
+ */
+static void km_node_free(struct KeymapNode *node)
+{
+  for (int i = 0; i < node->num_children; i++)
+    km_node_free(&node->children[i]);
+  FREE(&node->children);
+  node->num_children = 0;
+}
+
+/**
+ * km_node_find - Find the child of a KeymapNode for a key
+ * @param[in]  node Node
+ * @param[in]  key  Key
+ * @param[out] pos  Position of the child, or where it would be inserted
+ * @retval ptr  Child node
+ * @retval NULL No binding continues with this key
+ */
+static struct KeymapNode *km_node_find(struct KeymapNode *node, int key, int *pos)
+{
+  int lo = 0, hi = node->num_children;
+
+  while (lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if (node->children[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (pos)
+    *pos = lo;
+  if ((lo < node->num_children) && (node->children[lo].key == key))
+    return &node->children[lo];
+  return NULL;
+}
+
+/**
+ * km_index_free - Forget the compiled key bindings of a Menu
+ * @param menu Menu id, e.g. #MENU_PAGER
+ */
+static void km_index_free(int menu)
+{
+  if (!KeymapIndexes[menu])
+    return;
+
+  km_node_free(&KeymapIndexes[menu]->root);
+  FREE(&KeymapIndexes[menu]);
+}
+
+/**
+ * km_index - Get the compiled key bindings of a Menu
+ * @param menu Menu id, e.g. #MENU_PAGER
+ * @retval ptr Compiled key bindings
+ */
+static struct KeymapIndex *km_index(int menu)
+{
+  if (KeymapIndexes[menu])
+    return KeymapIndexes[menu];
+
+  struct KeymapIndex *ki = mutt_mem_calloc(1, sizeof(struct KeymapIndex));
+
+  for (struct Keymap *map = Keymaps[menu]; map; map = map->next)
+  {
+    if ((map->op >= 0) && (map->op < OP_MAX) && !ki->funcs[map->op])
+      ki->funcs[map->op] = map;
+
+    struct KeymapNode *node = &ki->root;
+    for (int i = 0; i < map->len; i++)
+    {
+      int pos = 0;
+      struct KeymapNode *child = km_node_find(node, map->keys[i], &pos);
+      if (!child)
+      {
+        mutt_mem_realloc(&node->children, (node->num_children + 1) * sizeof(struct KeymapNode));
+        memmove(&node->children[pos + 1], &node->children[pos],
+                (node->num_children - pos) * sizeof(struct KeymapNode));
+        node->num_children++;
+        child = &node->children[pos];
+        memset(child, 0, sizeof(*child));
+        child->key = map->keys[i];
+      }
+      node = child;
+    }
+
+    /* the list is ordered, so the first binding of a sequence wins */
+    if (!node->map)
+      node->map = map;
+  }
+
+  KeymapIndexes[menu] = ki;
+  return ki;
+}
+
 /**
  * alloc_keys - Allocate space for a sequence of keys
  * @param len  Number of keys
@@ -371,6 +501,7 @@ static int km_bind_err(const char *s, int menu, int op, char *macro, char *desc,
     Keymaps[menu] = map;
   }
 
+  km_index_free(menu);
   return retval;
 }
 
@@ -555,6 +686,45 @@ static int retry_generic(int menu, keycode_t *keys, int keyslen, int lastkey)
   return OP_NULL;
 }
 
+#ifdef USE_IMAP
+/**
+ * km_collect - Wait for a key while answers arrive from IMAP servers
+ * @param[out]    ev   Key that was pressed
+ * @param[in,out] secs Seconds left to wait
+ * @retval true A key was pressed, or something arrived (ev->ch is -2)
+ *
+ * This only waits while commands sent in the background are unanswered.
+ */
+static bool km_collect(struct Event *ev, int *secs)
+{
+  int collected = -1;
+
+  while ((*secs > 1) && ((collected = imap_collect()) == 0))
+  {
+    mutt_getch_timeout(1000);
+    *ev = mutt_getch();
+    mutt_getch_timeout(-1);
+#ifdef USE_INOTIFY
+    if (ev->ch != -2 || SigWinch || MonitorFilesChanged)
+#else
+    if (ev->ch != -2 || SigWinch)
+#endif
+      return true;
+    (*secs)--;
+  }
+
+  /* let the menu show what's arrived */
+  if (collected > 0)
+  {
+    ev->ch = -2;
+    ev->op = 0;
+    return true;
+  }
+
+  return false;
+}
+#endif
+
 /**
  * km_dokey - Determine what a keypress should do
  * @param menu Menu ID, e.g. #MENU_EDITOR
@@ -566,17 +736,31 @@ static int retry_generic(int menu, keycode_t *keys, int keyslen, int lastkey)
 int km_dokey(int menu)
 {
   struct Event tmp;
-  struct Keymap *map = Keymaps[menu];
+  keycode_t keys[MAX_SEQ];
   int pos = 0;
   int n = 0;
 
-  if (!map)
+  if (!Keymaps[menu])
     return retry_generic(menu, NULL, 0, 0);
 
+  struct KeymapNode *node = &km_index(menu)->root;
+
   while (true)
   {
     int i = Timeout > 0 ? Timeout : 60;
+    /* don't wait for a key while the pager has more of a message to show,
+     * unless it's the rest of a key sequence */
+    if ((menu == MENU_PAGER) && (pos == 0) && mutt_pager_is_loading())
+      i = 0;
+    /* nor while the query menu is waiting for more results */
+    if ((menu == MENU_QUERY) && (pos == 0) && mutt_query_is_loading())
+      i = 0;
+
 #ifdef USE_IMAP
+    /* e.g. a read-ahead that was started before the wait */
+    if (km_collect(&tmp, &i))
+      goto gotkey;
+
     /* keepalive may need to run more frequently than Timeout allows */
     if (ImapKeepalive)
     {
@@ -604,12 +788,28 @@ int km_dokey(int menu)
         }
       }
     }
+
+    /* answers to commands sent in the background arrive while waiting */
+    if (km_collect(&tmp, &i))
+      goto gotkey;
+#endif
+
+#ifdef USE_NOTMUCH
+    /* don't wait for a key while the index has more of a vfolder to show */
+    if ((menu == MENU_MAIN) && Context && nm_is_loading(Context->mailbox))
+      i = 0;
 #endif
 
     mutt_getch_timeout(i * 1000);
     tmp = mutt_getch();
     mutt_getch_timeout(-1);
 
+#ifdef USE_HCACHE
+    /* use the idle time to get the next mailbox ready */
+    if (tmp.ch == -2 && !SigWinch && (i > 0))
+      mutt_mailbox_prefetch();
+#endif
+
 #ifdef USE_IMAP
   gotkey:
 #endif
@@ -666,17 +866,13 @@ int km_dokey(int menu)
     }
 
     /* Nope. Business as usual */
-    while (LastKey > map->keys[pos])
-    {
-      if (pos > map->eq || !map->next)
-        return retry_generic(menu, map->keys, pos, LastKey);
-      map = map->next;
-    }
+    node = km_node_find(node, LastKey, NULL);
+    if (!node || (pos >= MAX_SEQ))
+      return retry_generic(menu, keys, pos, LastKey);
 
-    if (LastKey != map->keys[pos])
-      return retry_generic(menu, map->keys, pos, LastKey);
-
-    if (++pos == map->len)
+    keys[pos++] = LastKey;
+    struct Keymap *map = node->map;
+    if (map)
     {
       if (map->op != OP_MACRO)
         return map->op;
@@ -695,7 +891,7 @@ int km_dokey(int menu)
       }
 
       generic_tokenize_push_string(map->macro, mutt_push_macro_event);
-      map = Keymaps[menu];
+      node = &km_index(menu)->root;
       pos = 0;
     }
   }
@@ -791,12 +987,10 @@ int km_expand_key(char *s, size_t len, struct Keymap *map)
  */
 struct Keymap *km_find_func(int menu, int func)
 {
-  struct Keymap *map = Keymaps[menu];
+  if ((func < 0) || (func >= OP_MAX) || !Keymaps[menu])
+    return NULL;
 
-  for (; map; map = map->next)
-    if (map->op == func)
-      break;
-  return map;
+  return km_index(menu)->funcs[func];
 }
 
 #ifdef NCURSES_VERSION
@@ -1440,5 +1634,6 @@ void mutt_free_keys(void)
     }
 
     Keymaps[i] = NULL;
+    km_index_free(i);
   }
 }
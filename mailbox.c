@@ -62,34 +62,80 @@
 #ifdef USE_INOTIFY
 #include "monitor.h"
 #endif
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 /* These Config Variables are only used in mailbox.c */
 short MailCheck; ///< Config: Number of seconds before NeoMutt checks for new mail
 bool MailCheckStats;          ///< Config: Periodically check for new mail
 short MailCheckStatsInterval; ///< Config: How often to check for new mail
 bool MaildirCheckCur; ///< Config: Check both 'new' and 'cur' directories for new mail
+#ifdef USE_HCACHE
+bool HeaderCachePrefetch; ///< Config: (hcache) Warm up the header cache of mailboxes while idle
+#endif
 
 static time_t MailboxTime = 0; /**< last time we started checking for mail */
 static time_t MailboxStatsTime = 0; /**< last time we check performed mail_check_stats */
 static short MailboxCount = 0;  /**< how many boxes with new mail */
 static short MailboxNotify = 0; /**< # of unnotified new boxes */
+#ifdef USE_IMAP
+static short MailboxCountImap = 0; /**< how many of MailboxCount are IMAP boxes */
+#endif
 
 struct MailboxList AllMailboxes = STAILQ_HEAD_INITIALIZER(AllMailboxes);
 
+/**
+ * MailboxPaths - Index of AllMailboxes by their real paths
+ *
+ * It's used to skip duplicates in the 'mailboxes' command and is rebuilt when
+ * a mailbox is removed.
+ */
+static struct Hash *MailboxPaths = NULL;
+
+/**
+ * MailboxNames - Index of AllMailboxes by their paths
+ *
+ * It's built on demand and thrown away when a mailbox is added or removed.
+ */
+static struct Hash *MailboxNames = NULL;
+
+/**
+ * find_mailbox_node - Find a mailbox in AllMailboxes by its real path
+ * @param realpath Real path of the mailbox
+ * @retval ptr  Matching MailboxNode
+ * @retval NULL No mailbox has this path
+ */
+static struct MailboxNode *find_mailbox_node(const char *realpath)
+{
+  if (!MailboxPaths)
+  {
+    MailboxPaths = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+    struct MailboxNode *np = NULL;
+    STAILQ_FOREACH(np, &AllMailboxes, entries)
+    {
+      mutt_hash_insert(MailboxPaths, np->m->realpath, np);
+    }
+  }
+
+  struct MailboxNode *np = mutt_hash_find(MailboxPaths, realpath);
+  if (np && (mutt_str_strcmp(realpath, np->m->realpath) != 0))
+    return NULL;
+  return np;
+}
+
 /**
  * get_mailbox_description - Find a mailbox's description given a path.
- * @param path Path to the mailbox
+ * @param path     Path to the mailbox
+ * @param realpath Real path of the mailbox
  * @retval ptr Description
  * @retval NULL No mailbox matching path
  */
-static char *get_mailbox_description(const char *path)
+static char *get_mailbox_description(const char *path, const char *realpath)
 {
-  struct MailboxNode *np = NULL;
-  STAILQ_FOREACH(np, &AllMailboxes, entries)
-  {
-    if (np->m->desc && (strcmp(np->m->path, path) == 0))
-      return np->m->desc;
-  }
+  struct MailboxNode *np = find_mailbox_node(realpath);
+  if (np && np->m->desc && (strcmp(np->m->path, path) == 0))
+    return np->m->desc;
   return NULL;
 }
 
@@ -107,7 +153,7 @@ struct Mailbox *mailbox_new(const char *path)
   char *r = realpath(path, rp);
   mutt_str_strfcpy(mailbox->realpath, r ? rp : path, sizeof(mailbox->realpath));
   mailbox->magic = MUTT_UNKNOWN;
-  mailbox->desc = get_mailbox_description(mailbox->path);
+  mailbox->desc = get_mailbox_description(mailbox->path, mailbox->realpath);
 
   return mailbox;
 }
@@ -131,13 +177,18 @@ void mailbox_free(struct Mailbox **mailbox)
  * mailbox_maildir_check_dir - Check for new mail / mail counts
  * @param mailbox     Mailbox to check
  * @param dir_name    Path to mailbox
+ * @param cache       Saved counts for the dir
  * @param check_new   if true, check for new mail
  * @param check_stats if true, count total, new, and flagged messages
  * @retval 1 if the dir has new mail
  *
  * Checks the specified maildir subdir (cur or new) for new mail or mail counts.
+ *
+ * Every message that is added, removed or has its flags changed alters the
+ * directory, so the counts are reused as long as its mtime is unchanged.
  */
 static int mailbox_maildir_check_dir(struct Mailbox *mailbox, const char *dir_name,
+                                     struct MailboxDirStats *cache,
                                      bool check_new, bool check_stats)
 {
   DIR *dirp = NULL;
@@ -145,31 +196,53 @@ static int mailbox_maildir_check_dir(struct Mailbox *mailbox, const char *dir_na
   char *p = NULL;
   int rc = 0;
   struct stat sb;
+  struct stat msg_sb;
+  bool have_sb = false;
+  time_t scanned = 0;
+  int msg_count = 0;
+  int msg_unread = 0;
+  int msg_flagged = 0;
 
   struct Buffer *path = mutt_buffer_pool_get();
   struct Buffer *msgpath = mutt_buffer_pool_get();
   mutt_buffer_printf(path, "%s/%s", mailbox->path, dir_name);
 
+  if (check_stats || (check_new && MailCheckRecent))
+    have_sb = (stat(mutt_b2s(path), &sb) == 0);
+
   /* when $mail_check_recent is set, if the new/ directory hasn't been modified since
    * the user last exited the mailbox, then we know there is no recent mail.
    */
   if (check_new && MailCheckRecent)
   {
-    if (stat(mutt_b2s(path), &sb) == 0 &&
-        mutt_stat_timespec_compare(&sb, MUTT_STAT_MTIME, &mailbox->last_visited) < 0)
+    if (have_sb && mutt_stat_timespec_compare(&sb, MUTT_STAT_MTIME, &mailbox->last_visited) < 0)
     {
       rc = 0;
       check_new = false;
     }
   }
 
+  if (check_stats && have_sb && cache->valid &&
+      (mutt_stat_timespec_compare(&sb, MUTT_STAT_MTIME, &cache->mtime) == 0))
+  {
+    mailbox->msg_count += cache->msg_count;
+    mailbox->msg_unread += cache->msg_unread;
+    mailbox->msg_flagged += cache->msg_flagged;
+    check_stats = false;
+    /* Nothing unread, so nothing new */
+    if (cache->msg_unread == 0)
+      check_new = false;
+  }
+
   if (!(check_new || check_stats))
     goto cleanup;
 
+  scanned = time(NULL);
   dirp = opendir(mutt_b2s(path));
   if (!dirp)
   {
     mailbox->magic = MUTT_UNKNOWN;
+    cache->valid = false;
     rc = 0;
     goto cleanup;
   }
@@ -185,22 +258,22 @@ static int mailbox_maildir_check_dir(struct Mailbox *mailbox, const char *dir_na
 
     if (check_stats)
     {
-      mailbox->msg_count++;
+      msg_count++;
       if (p && strchr(p + 3, 'F'))
-        mailbox->msg_flagged++;
+        msg_flagged++;
     }
     if (!p || !strchr(p + 3, 'S'))
     {
       if (check_stats)
-        mailbox->msg_unread++;
+        msg_unread++;
       if (check_new)
       {
         if (MailCheckRecent)
         {
           mutt_buffer_printf(msgpath, "%s/%s", mutt_b2s(path), de->d_name);
           /* ensure this message was received since leaving this mailbox */
-          if (stat(mutt_b2s(msgpath), &sb) == 0 &&
-              (mutt_stat_timespec_compare(&sb, MUTT_STAT_CTIME, &mailbox->last_visited) <= 0))
+          if (stat(mutt_b2s(msgpath), &msg_sb) == 0 &&
+              (mutt_stat_timespec_compare(&msg_sb, MUTT_STAT_CTIME, &mailbox->last_visited) <= 0))
           {
             continue;
           }
@@ -216,6 +289,22 @@ static int mailbox_maildir_check_dir(struct Mailbox *mailbox, const char *dir_na
 
   closedir(dirp);
 
+  if (check_stats)
+  {
+    mailbox->msg_count += msg_count;
+    mailbox->msg_unread += msg_unread;
+    mailbox->msg_flagged += msg_flagged;
+
+    /* A change made in the same second as the scan can't be told apart by
+     * the mtime, so count the dir again next time. */
+    cache->msg_count = msg_count;
+    cache->msg_unread = msg_unread;
+    cache->msg_flagged = msg_flagged;
+    cache->valid = have_sb && (sb.st_mtime < scanned);
+    if (have_sb)
+      mutt_get_stat_timespec(&cache->mtime, &sb, MUTT_STAT_MTIME);
+  }
+
 cleanup:
   mutt_buffer_pool_release(&path);
   mutt_buffer_pool_release(&msgpath);
@@ -241,11 +330,13 @@ static int mailbox_maildir_check(struct Mailbox *mailbox, bool check_stats)
     mailbox->msg_flagged = 0;
   }
 
-  rc = mailbox_maildir_check_dir(mailbox, "new", check_new, check_stats);
+  rc = mailbox_maildir_check_dir(mailbox, "new", &mailbox->dir_stats[0],
+                                 check_new, check_stats);
 
   check_new = !rc && MaildirCheckCur;
   if (check_new || check_stats)
-    if (mailbox_maildir_check_dir(mailbox, "cur", check_new, check_stats))
+    if (mailbox_maildir_check_dir(mailbox, "cur", &mailbox->dir_stats[1],
+                                  check_new, check_stats))
       rc = 1;
 
   return rc;
@@ -295,6 +386,13 @@ static int mailbox_mbox_check(struct Mailbox *mailbox, struct stat *sb, bool che
   if (check_stats &&
       (mutt_stat_timespec_compare(sb, MUTT_STAT_MTIME, &mailbox->stats_last_checked) > 0))
   {
+#ifdef USE_HCACHE
+    if (mbox_summary_check(mailbox, sb) == 0)
+    {
+      mutt_get_stat_timespec(&mailbox->stats_last_checked, sb, MUTT_STAT_MTIME);
+      return rc;
+    }
+#endif
     struct Context *ctx =
         mx_mbox_open(mailbox->path, MUTT_READONLY | MUTT_QUIET | MUTT_NOSORT | MUTT_PEEK);
     if (ctx)
@@ -311,20 +409,42 @@ static int mailbox_mbox_check(struct Mailbox *mailbox, struct stat *sb, bool che
 }
 
 /**
- * mailbox_check - Check a mailbox for new mail
- * @param m           Mailbox to check
- * @param ctx_sb      stat() info for the current mailbox (Context)
- * @param check_stats If true, also count the total, new and flagged messages
+ * struct MailboxCheckJob - The state of one Mailbox during a check
+ *
+ * The local folders that need reading are polled in parallel, so the
+ * effects on the global counters are kept here until all the work is done.
+ */
+struct MailboxCheckJob
+{
+  struct Mailbox *m;   ///< Mailbox being checked
+  struct stat sb;      ///< stat() info for the Mailbox
+  bool check_stats;    ///< Also count the total, new and flagged messages
+  bool new_mail;       ///< The Mailbox has new mail
+#ifdef USE_SIDEBAR
+  short orig_new;      ///< Mailbox::has_new before the check
+  int orig_count;      ///< Mailbox::msg_count before the check
+  int orig_unread;     ///< Mailbox::msg_unread before the check
+  int orig_flagged;    ///< Mailbox::msg_flagged before the check
+#endif
+};
+
+/**
+ * mailbox_check_prepare - Decide whether a Mailbox needs polling
+ * @param job    Check to prepare
+ * @param ctx_sb stat() info for the current mailbox (Context)
+ * @retval  1 The Mailbox should be polled
+ * @retval  0 The Mailbox is the current folder, or isn't local
+ * @retval -1 The Mailbox doesn't exist
  */
-static void mailbox_check(struct Mailbox *m, struct stat *ctx_sb, bool check_stats)
+static int mailbox_check_prepare(struct MailboxCheckJob *job, struct stat *ctx_sb)
 {
-  struct stat sb = { 0 };
+  struct Mailbox *m = job->m;
 
 #ifdef USE_SIDEBAR
-  short orig_new = m->has_new;
-  int orig_count = m->msg_count;
-  int orig_unread = m->msg_unread;
-  int orig_flagged = m->msg_flagged;
+  job->orig_new = m->has_new;
+  job->orig_count = m->msg_count;
+  job->orig_unread = m->msg_unread;
+  job->orig_flagged = m->msg_flagged;
 #endif
 
   if (m->magic != MUTT_IMAP)
@@ -351,7 +471,7 @@ static void mailbox_check(struct Mailbox *m, struct stat *ctx_sb, bool check_sta
     }
     else
 #endif
-        if (stat(m->path, &sb) != 0 || (S_ISREG(sb.st_mode) && sb.st_size == 0) ||
+        if (stat(m->path, &job->sb) != 0 || (S_ISREG(job->sb.st_mode) && job->sb.st_size == 0) ||
             ((m->magic == MUTT_UNKNOWN) && (m->magic = mx_path_probe(m->path, NULL)) <= 0))
     {
       /* if the mailbox still doesn't exist, set the newly created flag to be
@@ -359,7 +479,7 @@ static void mailbox_check(struct Mailbox *m, struct stat *ctx_sb, bool check_sta
       m->newly_created = true;
       m->magic = MUTT_UNKNOWN;
       m->size = 0;
-      return;
+      return -1;
     }
   }
 
@@ -374,47 +494,82 @@ static void mailbox_check(struct Mailbox *m, struct stat *ctx_sb, bool check_sta
 #endif
         m->magic == MUTT_POP) ?
            (mutt_str_strcmp(m->path, Context->mailbox->path) != 0) :
-           (sb.st_dev != ctx_sb->st_dev || sb.st_ino != ctx_sb->st_ino)))
+           (job->sb.st_dev != ctx_sb->st_dev || job->sb.st_ino != ctx_sb->st_ino)))
   {
-    switch (m->magic)
-    {
-      case MUTT_MBOX:
-      case MUTT_MMDF:
-        if (mailbox_mbox_check(m, &sb, check_stats) > 0)
-          MailboxCount++;
-        break;
-
-      case MUTT_MAILDIR:
-        if (mailbox_maildir_check(m, check_stats) > 0)
-          MailboxCount++;
-        break;
-
-      case MUTT_MH:
-        if (mh_mailbox(m, check_stats))
-          MailboxCount++;
-        break;
+    return 1;
+  }
+
+  if (CheckMboxSize && Context && (Context->mailbox->path[0] != '\0'))
+    m->size = (off_t) job->sb.st_size; /* update the size of current folder */
+
+  return 0;
+}
+
+/**
+ * mailbox_check_poll - Look for new mail in a Mailbox
+ * @param job Check to perform
+ *
+ * Only the Mailbox in the job is changed, so Maildir and MH checks may be run
+ * by any thread.  The mbox check may open the folder, so it must not.
+ */
+static void mailbox_check_poll(struct MailboxCheckJob *job)
+{
+  struct Mailbox *m = job->m;
+
+  switch (m->magic)
+  {
+    case MUTT_MBOX:
+    case MUTT_MMDF:
+      job->new_mail = (mailbox_mbox_check(m, &job->sb, job->check_stats) > 0);
+      break;
+
+    case MUTT_MAILDIR:
+      job->new_mail = (mailbox_maildir_check(m, job->check_stats) > 0);
+      break;
+
+    case MUTT_MH:
+      job->new_mail = mh_mailbox(m, job->check_stats);
+      break;
 #ifdef USE_NOTMUCH
-      case MUTT_NOTMUCH:
-        m->msg_count = 0;
-        m->msg_unread = 0;
-        m->msg_flagged = 0;
-        nm_nonctx_get_count(m->path, &m->msg_count, &m->msg_unread);
-        if (m->msg_unread > 0)
-        {
-          MailboxCount++;
-          m->has_new = true;
-        }
-        break;
+    case MUTT_NOTMUCH:
+      m->msg_count = 0;
+      m->msg_unread = 0;
+      m->msg_flagged = 0;
+      nm_nonctx_get_count(m->path, &m->msg_count, &m->msg_unread);
+      if (m->msg_unread > 0)
+      {
+        job->new_mail = true;
+        m->has_new = true;
+      }
+      break;
 #endif
-      default:; /* do nothing */
-    }
+    default:; /* do nothing */
   }
-  else if (CheckMboxSize && Context && (Context->mailbox->path[0] != '\0'))
-    m->size = (off_t) sb.st_size; /* update the size of current folder */
+}
+
+/**
+ * mailbox_check_job - Poll one local Mailbox - Implements ::parallel_work_t
+ */
+static void mailbox_check_job(size_t i, void *data)
+{
+  struct MailboxCheckJob **jobs = data;
+  mailbox_check_poll(jobs[i]);
+}
+
+/**
+ * mailbox_check_finish - Publish the result of a Mailbox check
+ * @param job Completed check
+ */
+static void mailbox_check_finish(struct MailboxCheckJob *job)
+{
+  struct Mailbox *m = job->m;
+
+  if (job->new_mail)
+    MailboxCount++;
 
 #ifdef USE_SIDEBAR
-  if ((orig_new != m->has_new) || (orig_count != m->msg_count) ||
-      (orig_unread != m->msg_unread) || (orig_flagged != m->msg_flagged))
+  if ((job->orig_new != m->has_new) || (job->orig_count != m->msg_count) ||
+      (job->orig_unread != m->msg_unread) || (job->orig_flagged != m->msg_flagged))
   {
     mutt_menu_set_current_redraw(REDRAW_SIDEBAR);
   }
@@ -525,6 +680,14 @@ struct Mailbox *mutt_find_mailbox(const char *path)
   if (stat(path, &sb) != 0)
     return NULL;
 
+  /* Usually, the mailbox is known by the same name */
+  struct Mailbox *m = mutt_find_mailbox_path(path);
+  if (m && (stat(m->path, &tmp_sb) == 0) && (sb.st_dev == tmp_sb.st_dev) &&
+      (sb.st_ino == tmp_sb.st_ino))
+  {
+    return m;
+  }
+
   struct MailboxNode *np = NULL;
   STAILQ_FOREACH(np, &AllMailboxes, entries)
   {
@@ -538,6 +701,37 @@ struct Mailbox *mutt_find_mailbox(const char *path)
   return NULL;
 }
 
+/**
+ * mutt_find_mailbox_path - Find the mailbox with exactly this path
+ * @param path Path to match
+ * @retval ptr  Matching Mailbox
+ * @retval NULL No mailbox has this path
+ *
+ * Unlike mutt_find_mailbox(), no other names for the same file are matched.
+ */
+struct Mailbox *mutt_find_mailbox_path(const char *path)
+{
+  if (!path)
+    return NULL;
+
+  if (!MailboxNames)
+  {
+    MailboxNames = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+    struct MailboxNode *np = NULL;
+    STAILQ_FOREACH(np, &AllMailboxes, entries)
+    {
+      if (!mutt_hash_find(MailboxNames, np->m->path))
+        mutt_hash_insert(MailboxNames, np->m->path, np->m);
+    }
+  }
+
+  struct Mailbox *m = mutt_hash_find(MailboxNames, path);
+  /* The path may have been expanded again since */
+  if (m && (mutt_str_strcmp(path, m->path) != 0))
+    return NULL;
+  return m;
+}
+
 /**
  * mutt_update_mailbox - Get the mailbox's current size
  * @param m Mailbox to check
@@ -600,18 +794,10 @@ int mutt_parse_mailboxes(struct Buffer *buf, struct Buffer *s,
 
     /* avoid duplicates */
     p = realpath(tmp, f1);
-    struct MailboxNode *np = NULL;
-    STAILQ_FOREACH(np, &AllMailboxes, entries)
-    {
-      if (mutt_str_strcmp(p ? p : tmp, np->m->realpath) == 0)
-      {
-        mutt_debug(3, "mailbox '%s' already registered as '%s'\n", tmp, np->m->path);
-        break;
-      }
-    }
-
+    struct MailboxNode *np = find_mailbox_node(p ? p : tmp);
     if (np)
     {
+      mutt_debug(3, "mailbox '%s' already registered as '%s'\n", tmp, np->m->path);
       FREE(&desc);
       continue;
     }
@@ -647,6 +833,8 @@ int mutt_parse_mailboxes(struct Buffer *buf, struct Buffer *s,
     struct MailboxNode *mn = mutt_mem_calloc(1, sizeof(*mn));
     mn->m = m;
     STAILQ_INSERT_TAIL(&AllMailboxes, mn, entries);
+    mutt_hash_insert(MailboxPaths, m->realpath, mn);
+    mutt_hash_destroy(&MailboxNames);
 
 #ifdef USE_SIDEBAR
     mutt_sb_notify_mailbox(m, true);
@@ -714,6 +902,8 @@ int mutt_parse_unmailboxes(struct Buffer *buf, struct Buffer *s,
         STAILQ_REMOVE(&AllMailboxes, np, MailboxNode, entries);
         mailbox_free(&np->m);
         FREE(&np);
+        mutt_hash_destroy(&MailboxPaths);
+        mutt_hash_destroy(&MailboxNames);
         continue;
       }
     }
@@ -751,8 +941,35 @@ int mutt_mailbox_check(int force)
     return 0;
 
   t = time(NULL);
+#ifdef USE_INOTIFY
+  /* a watched mailbox has changed, there's no need to wait for $mail_check */
+  if (MonitorMailboxChanged && (t != MailboxTime))
+    force |= MUTT_MAILBOX_CHECK_FORCE;
+#endif
   if (!force && (t - MailboxTime < MailCheck))
+  {
+#ifdef USE_IMAP
+    /* publish the results of a background check as soon as they arrive */
+    const int count = imap_mailbox_poll();
+    if (count >= 0)
+    {
+      MailboxCount += count - MailboxCountImap;
+      MailboxCountImap = count;
+
+      struct MailboxNode *np = NULL;
+      STAILQ_FOREACH(np, &AllMailboxes, entries)
+      {
+        if (np->m->magic != MUTT_IMAP)
+          continue;
+        if (!np->m->has_new)
+          np->m->notified = false;
+        else if (!np->m->notified)
+          MailboxNotify++;
+      }
+    }
+#endif
     return MailboxCount;
+  }
 
   if ((force & MUTT_MAILBOX_CHECK_FORCE_STATS) ||
       (MailCheckStats && ((t - MailboxStatsTime) >= MailCheckStatsInterval)))
@@ -762,11 +979,15 @@ int mutt_mailbox_check(int force)
   }
 
   MailboxTime = t;
+#ifdef USE_INOTIFY
+  MonitorMailboxChanged = 0;
+#endif
   MailboxCount = 0;
   MailboxNotify = 0;
 
 #ifdef USE_IMAP
-  MailboxCount += imap_mailbox_check(check_stats);
+  MailboxCountImap = imap_mailbox_check(check_stats);
+  MailboxCount += MailboxCountImap;
 #endif
 
   /* check device ID and serial number instead of comparing paths */
@@ -781,15 +1002,128 @@ int mutt_mailbox_check(int force)
     contex_sb.st_ino = 0;
   }
 
+  size_t num = 0;
   struct MailboxNode *np = NULL;
   STAILQ_FOREACH(np, &AllMailboxes, entries)
   {
-    mailbox_check(np->m, &contex_sb, check_stats);
+    num++;
+  }
+
+  struct MailboxCheckJob *jobs = mutt_mem_calloc(num, sizeof(struct MailboxCheckJob));
+  struct MailboxCheckJob **local = mutt_mem_calloc(num, sizeof(struct MailboxCheckJob *));
+  size_t num_local = 0;
+
+  /* Probing and mbox checks stay in this thread.  The Maildir and MH checks,
+   * which have to read a directory, are shared between the workers. */
+  size_t i = 0;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    struct MailboxCheckJob *job = &jobs[i++];
+    job->m = np->m;
+    job->check_stats = check_stats;
+
+    const int rc = mailbox_check_prepare(job, &contex_sb);
+    if (rc < 0)
+      continue;
+    if (rc > 0)
+    {
+      if ((WorkerThreads > 1) && ((job->m->magic == MUTT_MAILDIR) || (job->m->magic == MUTT_MH)))
+      {
+        local[num_local++] = job;
+        continue;
+      }
+      mailbox_check_poll(job);
+    }
+    mailbox_check_finish(job);
+  }
+
+  if (num_local > 0)
+  {
+    mutt_parallel_for(num_local, WorkerThreads, mailbox_check_job, NULL, local);
+    for (i = 0; i < num_local; i++)
+      mailbox_check_finish(local[i]);
   }
 
+  FREE(&local);
+  FREE(&jobs);
+
   return MailboxCount;
 }
 
+#ifdef USE_HCACHE
+/**
+ * mailbox_prefetch - Warm up the header cache of a mailbox
+ * @param m Mailbox
+ */
+static void mailbox_prefetch(struct Mailbox *m)
+{
+  switch (m->magic)
+  {
+    case MUTT_MAILDIR:
+    case MUTT_MH:
+      mutt_hcache_prefetch(HeaderCache, m->path, NULL);
+      break;
+#ifdef USE_IMAP
+    case MUTT_IMAP:
+      imap_hcache_prefetch(m->path);
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+/**
+ * mutt_mailbox_prefetch - Warm up the header cache of the next mailbox
+ *
+ * This is called while NeoMutt is idle.  Each call warms up one mailbox,
+ * working through the list in turn.  Mailboxes with new mail are the most
+ * likely to be opened next, so they are preferred.
+ */
+void mutt_mailbox_prefetch(void)
+{
+  static int next = 0;
+
+  if (!HeaderCachePrefetch || !HeaderCache || STAILQ_EMPTY(&AllMailboxes))
+    return;
+
+  int count = 0;
+  struct MailboxNode *np = NULL;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    count++;
+  }
+
+  struct Mailbox *pick = NULL;
+  int pick_dist = 0;
+  int pick_idx = 0;
+  int i = 0;
+  STAILQ_FOREACH(np, &AllMailboxes, entries)
+  {
+    struct Mailbox *m = np->m;
+    int dist = (i - next % count + count) % count;
+
+    /* Don't bother with the open mailbox */
+    if (!(Context && Context->mailbox &&
+          (mutt_str_strcmp(m->path, Context->mailbox->path) == 0)) &&
+        (!pick || (m->has_new && !pick->has_new) ||
+         ((m->has_new == pick->has_new) && (dist < pick_dist))))
+    {
+      pick = m;
+      pick_dist = dist;
+      pick_idx = i;
+    }
+    i++;
+  }
+
+  if (!pick)
+    return;
+
+  next = pick_idx + 1;
+  mailbox_prefetch(pick);
+}
+#endif
+
 /**
  * mutt_mailbox_list - List the mailboxes with new mail
  * @retval true If there is new mail
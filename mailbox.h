@@ -32,6 +32,7 @@
 
 struct Buffer;
 struct Context;
+struct PatternIndex;
 struct stat;
 
 /* These Config Variables are only used in mailbox.c */
@@ -39,6 +40,9 @@ extern short MailCheck;
 extern bool  MailCheckStats;
 extern short MailCheckStatsInterval;
 extern bool  MaildirCheckCur;
+#ifdef USE_HCACHE
+extern bool  HeaderCachePrefetch;
+#endif
 
 /* parameter to mutt_parse_mailboxes */
 #define MUTT_NAMED   (1 << 0)
@@ -69,6 +73,20 @@ enum AclRights
   RIGHTSMAX
 };
 
+/**
+ * struct MailboxDirStats - Cached message counts of a Maildir subdirectory
+ *
+ * The counts are reused while the directory's mtime doesn't change.
+ */
+struct MailboxDirStats
+{
+  struct timespec mtime; /**< mtime of the directory when it was counted */
+  int msg_count;         /**< total number of messages */
+  int msg_unread;        /**< number of unread messages */
+  int msg_flagged;       /**< number of flagged messages */
+  bool valid;            /**< the counts may be reused */
+};
+
 /**
  * struct Mailbox - A mailbox
  */
@@ -97,6 +115,7 @@ struct Mailbox
   struct timespec mtime;
   struct timespec last_visited;       /**< time of last exit from this mailbox */
   struct timespec stats_last_checked; /**< mtime of mailbox the last time stats where checked. */
+  struct MailboxDirStats dir_stats[2]; /**< Maildir counts of new/ and cur/ */
 
   void *data;                 /**< driver specific data */
   void (*free_data)(void **); /**< driver-specific data free function */
@@ -116,6 +135,8 @@ struct Mailbox
   struct Hash *id_hash;     /**< hash table by msg id */
   struct Hash *subj_hash;   /**< hash table by subject */
   struct Hash *label_hash;  /**< hash table for x-labels */
+  struct Hash *dup_hash;    /**< emails sharing a msg id, see mutt_email_is_duplicate() */
+  struct PatternIndex *pattern_index; /**< emails sorted by date and size */
 
   int flags; /**< e.g. #MB_NORMAL */
 };
@@ -142,6 +163,7 @@ void            mailbox_free(struct Mailbox **mailbox);
 void            mutt_context_free(struct Context **ctx);
 
 struct Mailbox *mutt_find_mailbox(const char *path);
+struct Mailbox *mutt_find_mailbox_path(const char *path);
 void mutt_update_mailbox(struct Mailbox *m);
 
 void mutt_mailbox_cleanup(const char *path, struct stat *st);
@@ -157,6 +179,9 @@ void mutt_mailbox(char *s, size_t slen);
 bool mutt_mailbox_list(void);
 int mutt_mailbox_check(int force);
 bool mutt_mailbox_notify(void);
+#ifdef USE_HCACHE
+void mutt_mailbox_prefetch(void);
+#endif
 int mutt_parse_mailboxes(struct Buffer *path, struct Buffer *s, unsigned long data, struct Buffer *err);
 int mutt_parse_unmailboxes(struct Buffer *path, struct Buffer *s, unsigned long data, struct Buffer *err);
 
@@ -47,6 +47,10 @@ struct Email;
 /* These Config Variables are only used in maildir/mh.c */
 extern bool  CheckNew;
 extern bool  MaildirHeaderCacheVerify;
+extern bool  MaildirHeaderCacheSnapshot;
+extern bool  MaildirLazyHeaders;
+extern short MaildirReadahead;
+extern bool  MaildirSearchIndex;
 extern bool  MhPurge;
 extern char *MhSeqFlagged;
 extern char *MhSeqReplied;
@@ -56,20 +60,25 @@ extern struct MxOps mx_maildir_ops;
 extern struct MxOps mx_mh_ops;
 
 int           maildir_check_empty(const char *path);
+int           maildir_count_messages(const char *path);
 void          maildir_gen_flags(char *dest, size_t destlen, struct Email *e);
 FILE *        maildir_open_find_message(const char *folder, const char *msg, char **newname);
 void          maildir_parse_flags(struct Email *e, const char *path);
+struct Email *maildir_parse_fd(enum MailboxType magic, int fd, const char *fname, bool is_old, struct Email *e);
 struct Email *maildir_parse_message(enum MailboxType magic, const char *fname, bool is_old, struct Email *e);
 struct Email *maildir_parse_stream(enum MailboxType magic, FILE *f, const char *fname, bool is_old, struct Email *e);
 bool          maildir_update_flags(struct Context *ctx, struct Email *o, struct Email *n);
 
 bool          mh_mailbox(struct Mailbox *mailbox, bool check_stats);
 int           mh_check_empty(const char *path);
+int           mh_count_messages(const char *path);
 
 int           maildir_path_probe(const char *path, const struct stat *st);
 int           mh_path_probe(const char *path, const struct stat *st);
 
 #ifdef USE_HCACHE
+void *        maildir_search_index_load(struct Mailbox *mailbox, struct Email *e, size_t *dlen);
+void          maildir_search_index_save(struct Mailbox *mailbox, struct Email *e, const void *data, size_t dlen);
 int           mh_sync_mailbox_message(struct Context *ctx, int msgno, header_cache_t *hc);
 #else
 int           mh_sync_mailbox_message(struct Context *ctx, int msgno);
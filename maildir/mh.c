@@ -71,6 +71,10 @@
 /* These Config Variables are only used in maildir/mh.c */
 bool CheckNew; ///< Config: (maildir,mh) Check for new mail while the mailbox is open
 bool MaildirHeaderCacheVerify; ///< Config: (hcache) Check for maildir changes when opening mailbox
+bool MaildirHeaderCacheSnapshot; ///< Config: (hcache) Only check the messages that are new since the last open
+bool MaildirLazyHeaders; ///< Config: Open mailboxes before reading every header
+bool MaildirSearchIndex; ///< Config: (hcache) Keep an index of the text of the messages for searches
+short MaildirReadahead; ///< Config: Number of messages to open ahead of parsing them
 bool MhPurge;       ///< Config: Really delete files in MH mailboxes
 char *MhSeqFlagged; ///< Config: MH sequence for flagged message
 char *MhSeqReplied; ///< Config: MH sequence to tag replied messages
@@ -78,6 +82,11 @@ char *MhSeqUnseen;  ///< Config: MH sequence for unseen messages
 
 #define INS_SORT_THRESHOLD 6
 
+/* How much of a message to read ahead: enough for the headers of most */
+#define MH_READAHEAD_BYTES 16384
+/* Upper limit of $maildir_readahead, to stay clear of the file descriptor limit */
+#define MH_READAHEAD_MAX 256
+
 #define MH_SEQ_UNSEEN (1 << 0)
 #define MH_SEQ_REPLIED (1 << 1)
 #define MH_SEQ_FLAGGED (1 << 2)
@@ -94,13 +103,35 @@ struct Maildir
   struct Maildir *next;
 };
 
+/**
+ * struct MhSeqRange - A range of message numbers
+ */
+struct MhSeqRange
+{
+  int first; ///< First message number
+  int last;  ///< Last message number, inclusive
+};
+
+/**
+ * struct MhSequence - The messages in one MH sequence, e.g. "unseen"
+ */
+struct MhSequence
+{
+  struct MhSeqRange *ranges; ///< Sorted, disjoint, non-adjacent ranges
+  size_t count;              ///< Number of ranges
+  size_t alloc;              ///< Number of ranges allocated
+};
+
 /**
  * struct MhSequences - Set of MH sequence numbers
+ *
+ * Each sequence is kept as a list of ranges, like in the .mh_sequences file,
+ * so the memory used doesn't depend on how high the message numbers are.
  */
 struct MhSequences
 {
-  int max;
-  short *flags;
+  int max;                  ///< Highest message number in any sequence
+  struct MhSequence seq[3]; ///< Sequences, indexed by mhs_index()
 };
 
 /**
@@ -125,24 +156,91 @@ static struct MaildirMboxData *maildir_get_mdata(struct Mailbox *m)
 }
 
 /**
- * mhs_alloc - Allocate more memory for sequences
- * @param mhs Existing sequences
- * @param i   Number required
+ * mhs_index - Get the index of a sequence
+ * @param f Flag, e.g. #MH_SEQ_UNSEEN
+ * @retval num Index into MhSequences::seq
+ */
+static int mhs_index(short f)
+{
+  switch (f)
+  {
+    case MH_SEQ_REPLIED:
+      return 1;
+    case MH_SEQ_FLAGGED:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+/**
+ * mhs_find - Find the first range that ends at, or after, a message number
+ * @param seq Sequence
+ * @param i   Message number
+ * @retval num Index of the range, MhSequence::count if there's none
+ */
+static size_t mhs_find(const struct MhSequence *seq, int i)
+{
+  size_t lo = 0, hi = seq->count;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (seq->ranges[mid].last < i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * mhs_add_range - Add a range of message numbers to a sequence
+ * @param mhs   Sequences
+ * @param f     Flag, e.g. #MH_SEQ_UNSEEN
+ * @param first First message number
+ * @param last  Last message number, inclusive
  *
- * @note Memory is allocated in blocks of 128.
+ * Ranges that overlap, or touch, the new one are merged with it.  Adding the
+ * numbers in ascending order is the common case, and it doesn't move anything.
  */
-static void mhs_alloc(struct MhSequences *mhs, int i)
+static void mhs_add_range(struct MhSequences *mhs, short f, int first, int last)
 {
-  if ((i <= mhs->max) && mhs->flags)
+  struct MhSequence *seq = &mhs->seq[mhs_index(f)];
+
+  if (first > last)
     return;
+  if (last > mhs->max)
+    mhs->max = last;
 
-  const int newmax = i + 128;
-  int j = mhs->flags ? mhs->max + 1 : 0;
-  mutt_mem_realloc(&mhs->flags, sizeof(mhs->flags[0]) * (newmax + 1));
-  while (j <= newmax)
-    mhs->flags[j++] = 0;
+  /* ranges [lo, hi) overlap or touch [first, last] */
+  size_t lo = mhs_find(seq, first - 1);
+  size_t hi = lo;
+  while ((hi < seq->count) && (seq->ranges[hi].first <= last + 1))
+    hi++;
+
+  if (lo < hi)
+  {
+    seq->ranges[lo].first = MIN(first, seq->ranges[lo].first);
+    seq->ranges[lo].last = MAX(last, seq->ranges[hi - 1].last);
+    if (hi > lo + 1)
+    {
+      memmove(&seq->ranges[lo + 1], &seq->ranges[hi],
+              (seq->count - hi) * sizeof(struct MhSeqRange));
+      seq->count -= hi - lo - 1;
+    }
+    return;
+  }
 
-  mhs->max = newmax;
+  if (seq->count == seq->alloc)
+  {
+    seq->alloc = seq->alloc ? (seq->alloc * 2) : 16;
+    mutt_mem_realloc(&seq->ranges, seq->alloc * sizeof(struct MhSeqRange));
+  }
+  memmove(&seq->ranges[lo + 1], &seq->ranges[lo],
+          (seq->count - lo) * sizeof(struct MhSeqRange));
+  seq->ranges[lo].first = first;
+  seq->ranges[lo].last = last;
+  seq->count++;
 }
 
 /**
@@ -151,7 +249,13 @@ static void mhs_alloc(struct MhSequences *mhs, int i)
  */
 static void mhs_free_sequences(struct MhSequences *mhs)
 {
-  FREE(&mhs->flags);
+  for (size_t i = 0; i < mutt_array_size(mhs->seq); i++)
+  {
+    FREE(&mhs->seq[i].ranges);
+    mhs->seq[i].count = 0;
+    mhs->seq[i].alloc = 0;
+  }
+  mhs->max = 0;
 }
 
 /**
@@ -162,24 +266,43 @@ static void mhs_free_sequences(struct MhSequences *mhs)
  */
 static short mhs_check(struct MhSequences *mhs, int i)
 {
-  if (!mhs->flags || (i > mhs->max))
-    return 0;
-  else
-    return mhs->flags[i];
+  static const short flags[] = { MH_SEQ_UNSEEN, MH_SEQ_REPLIED, MH_SEQ_FLAGGED };
+  short f = 0;
+
+  for (size_t j = 0; j < mutt_array_size(flags); j++)
+  {
+    const struct MhSequence *seq = &mhs->seq[mhs_index(flags[j])];
+    size_t k = mhs_find(seq, i);
+    if ((k < seq->count) && (seq->ranges[k].first <= i))
+      f |= flags[j];
+  }
+  return f;
 }
 
 /**
  * mhs_set - Set a flag for a given sequence
  * @param mhs Sequences
  * @param i   Index number
- * @param f   Flags, e.g. #MH_SEQ_UNSEEN
- * @retval num Resulting flags
+ * @param f   Flag, e.g. #MH_SEQ_UNSEEN
+ */
+static void mhs_set(struct MhSequences *mhs, int i, short f)
+{
+  mhs_add_range(mhs, f, i, i);
+}
+
+/**
+ * mhs_count - Count the messages in a sequence
+ * @param mhs Sequences
+ * @param f   Flag, e.g. #MH_SEQ_UNSEEN
+ * @retval num Number of messages
  */
-static short mhs_set(struct MhSequences *mhs, int i, short f)
+static int mhs_count(struct MhSequences *mhs, short f)
 {
-  mhs_alloc(mhs, i);
-  mhs->flags[i] |= f;
-  return mhs->flags[i];
+  const struct MhSequence *seq = &mhs->seq[mhs_index(f)];
+  int n = 0;
+  for (size_t i = 0; i < seq->count; i++)
+    n += seq->ranges[i].last - seq->ranges[i].first + 1;
+  return n;
 }
 
 /**
@@ -254,8 +377,7 @@ static int mh_read_sequences(struct MhSequences *mhs, const char *path)
         rc = -1;
         goto out;
       }
-      for (; first <= last; first++)
-        mhs_set(mhs, first, f);
+      mhs_add_range(mhs, f, first, last);
     }
   }
 
@@ -398,60 +520,86 @@ static int mh_mkstemp(struct Mailbox *mailbox, FILE **fp, char **tgt)
 }
 
 /**
- * mhs_write_one_sequence - Write a flag sequence to a file
- * @param fp  File to write to
- * @param mhs Sequence list
- * @param f   Flag, e.g. MH_SEQ_UNSEEN
- * @param tag string tag, e.g. "unseen"
+ * mhs_format_sequence - Format a sequence as a line of .mh_sequences
+ * @param buf Buffer for the result, e.g. "unseen: 1-5 7"
+ * @param mhs Sequences
+ * @param f   Flag, e.g. #MH_SEQ_UNSEEN
+ * @param tag Name of the sequence, e.g. "unseen"
  */
-static void mhs_write_one_sequence(FILE *fp, struct MhSequences *mhs, short f, const char *tag)
+static void mhs_format_sequence(struct Buffer *buf, struct MhSequences *mhs,
+                                short f, const char *tag)
 {
-  fprintf(fp, "%s:", tag);
+  const struct MhSequence *seq = &mhs->seq[mhs_index(f)];
+
+  mutt_buffer_printf(buf, "%s:", tag);
+  for (size_t i = 0; i < seq->count; i++)
+  {
+    if (seq->ranges[i].first == seq->ranges[i].last)
+      mutt_buffer_add_printf(buf, " %d", seq->ranges[i].first);
+    else
+      mutt_buffer_add_printf(buf, " %d-%d", seq->ranges[i].first, seq->ranges[i].last);
+  }
+}
 
-  int first = -1;
-  int last = -1;
+/**
+ * mhs_write_added - Write a line of .mh_sequences with one more message
+ * @param fp     File to write to
+ * @param line   Line from the old file, e.g. "unseen: 1-5"
+ * @param taglen Length of the sequence name, including the colon
+ * @param n      Message number to add
+ *
+ * The message is merged into the ranges, so the line stays compact.  Lines that
+ * can't be parsed just get the number appended.
+ */
+static void mhs_write_added(FILE *fp, const char *line, size_t taglen, int n)
+{
+  struct MhSequences mhs = { 0 };
+  char *list = mutt_str_strdup(line + taglen);
+  char *save = NULL;
+  int first, last;
+  bool ok = true;
 
-  for (int i = 0; i <= mhs->max; i++)
+  for (char *t = strtok_r(list, " \t", &save); t; t = strtok_r(NULL, " \t", &save))
   {
-    if ((mhs_check(mhs, i) & f))
-    {
-      if (first < 0)
-        first = i;
-      else
-        last = i;
-    }
-    else if (first >= 0)
+    if (mh_read_token(t, &first, &last) < 0)
     {
-      if (last < 0)
-        fprintf(fp, " %d", first);
-      else
-        fprintf(fp, " %d-%d", first, last);
-
-      first = -1;
-      last = -1;
+      ok = false;
+      break;
     }
+    mhs_add_range(&mhs, MH_SEQ_UNSEEN, first, last);
   }
+  FREE(&list);
 
-  if (first >= 0)
+  if (ok)
   {
-    if (last < 0)
-      fprintf(fp, " %d", first);
-    else
-      fprintf(fp, " %d-%d", first, last);
+    mhs_add_range(&mhs, MH_SEQ_UNSEEN, n, n);
+    char *tag = mutt_str_substr_dup(line, line + taglen - 1);
+    struct Buffer *buf = mutt_buffer_pool_get();
+    mhs_format_sequence(buf, &mhs, MH_SEQ_UNSEEN, tag);
+    fprintf(fp, "%s\n", mutt_b2s(buf));
+    mutt_buffer_pool_release(&buf);
+    FREE(&tag);
   }
+  else
+    fprintf(fp, "%s %d\n", line, n);
 
-  fputc('\n', fp);
+  mhs_free_sequences(&mhs);
 }
 
 /**
  * mh_update_sequences - Update sequence numbers
  * @param mailbox Mailbox
  *
+ * The file is only rewritten if one of our sequences has changed.  Lines of
+ * the sequences we don't know are copied unchanged.
+ *
  * XXX we don't currently remove deleted messages from sequences we don't know.
  * Should we?
  */
 static void mh_update_sequences(struct Mailbox *mailbox)
 {
+  static const short flags[] = { MH_SEQ_UNSEEN, MH_SEQ_FLAGGED, MH_SEQ_REPLIED };
+
   FILE *ofp = NULL, *nfp = NULL;
 
   char sequences[PATH_MAX];
@@ -462,47 +610,18 @@ static void mh_update_sequences(struct Mailbox *mailbox)
   int l = 0;
   int i;
 
-  int unseen = 0;
-  int flagged = 0;
-  int replied = 0;
-
-  char seq_unseen[STRING];
-  char seq_replied[STRING];
-  char seq_flagged[STRING];
+  const char *tags[] = { NONULL(MhSeqUnseen), NONULL(MhSeqFlagged), NONULL(MhSeqReplied) };
+  char prefix[3][STRING];
+  struct Buffer *lines[3];
+  bool found[3] = { false };
+  bool changed = false;
 
   struct MhSequences mhs = { 0 };
 
-  snprintf(seq_unseen, sizeof(seq_unseen), "%s:", NONULL(MhSeqUnseen));
-  snprintf(seq_replied, sizeof(seq_replied), "%s:", NONULL(MhSeqReplied));
-  snprintf(seq_flagged, sizeof(seq_flagged), "%s:", NONULL(MhSeqFlagged));
-
-  if (mh_mkstemp(mailbox, &nfp, &tmpfname) != 0)
-  {
-    /* error message? */
-    return;
-  }
-
-  snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", mailbox->path);
-
-  /* first, copy unknown sequences */
-  ofp = fopen(sequences, "r");
-  if (ofp)
-  {
-    while ((buf = mutt_file_read_line(buf, &s, ofp, &l, 0)))
-    {
-      if (mutt_str_strncmp(buf, seq_unseen, mutt_str_strlen(seq_unseen)) == 0)
-        continue;
-      if (mutt_str_strncmp(buf, seq_flagged, mutt_str_strlen(seq_flagged)) == 0)
-        continue;
-      if (mutt_str_strncmp(buf, seq_replied, mutt_str_strlen(seq_replied)) == 0)
-        continue;
-
-      fprintf(nfp, "%s\n", buf);
-    }
-  }
-  mutt_file_fclose(&ofp);
+  for (int j = 0; j < mutt_array_size(flags); j++)
+    snprintf(prefix[j], sizeof(prefix[j]), "%s:", tags[j]);
 
-  /* now, update our unseen, flagged, and replied sequences */
+  /* work out our unseen, flagged, and replied sequences */
   for (l = 0; l < mailbox->msg_count; l++)
   {
     if (mailbox->hdrs[l]->deleted)
@@ -518,31 +637,78 @@ static void mh_update_sequences(struct Mailbox *mailbox)
       continue;
 
     if (!mailbox->hdrs[l]->read)
-    {
       mhs_set(&mhs, i, MH_SEQ_UNSEEN);
-      unseen++;
-    }
     if (mailbox->hdrs[l]->flagged)
-    {
       mhs_set(&mhs, i, MH_SEQ_FLAGGED);
-      flagged++;
-    }
     if (mailbox->hdrs[l]->replied)
-    {
       mhs_set(&mhs, i, MH_SEQ_REPLIED);
-      replied++;
+  }
+
+  /* an empty line means the sequence isn't wanted */
+  for (int j = 0; j < mutt_array_size(flags); j++)
+  {
+    lines[j] = mutt_buffer_pool_get();
+    if (mhs.seq[mhs_index(flags[j])].count > 0)
+      mhs_format_sequence(lines[j], &mhs, flags[j], tags[j]);
+  }
+  mhs_free_sequences(&mhs);
+
+  snprintf(sequences, sizeof(sequences), "%s/.mh_sequences", mailbox->path);
+
+  /* compare with the lines that are there already */
+  ofp = fopen(sequences, "r");
+  if (ofp)
+  {
+    while ((buf = mutt_file_read_line(buf, &s, ofp, &l, 0)))
+    {
+      for (int j = 0; j < mutt_array_size(flags); j++)
+      {
+        if (mutt_str_strncmp(buf, prefix[j], mutt_str_strlen(prefix[j])) != 0)
+          continue;
+        if (found[j] || (mutt_str_strcmp(buf, mutt_b2s(lines[j])) != 0))
+          changed = true;
+        found[j] = true;
+      }
     }
   }
+  for (int j = 0; j < mutt_array_size(flags); j++)
+  {
+    if (!found[j] && !mutt_buffer_is_empty(lines[j]))
+      changed = true;
+  }
 
-  /* write out the new sequences */
-  if (unseen)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_UNSEEN, NONULL(MhSeqUnseen));
-  if (flagged)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_FLAGGED, NONULL(MhSeqFlagged));
-  if (replied)
-    mhs_write_one_sequence(nfp, &mhs, MH_SEQ_REPLIED, NONULL(MhSeqReplied));
+  if (!changed)
+  {
+    mutt_debug(3, "%s is up to date\n", sequences);
+    goto cleanup;
+  }
 
-  mhs_free_sequences(&mhs);
+  if (mh_mkstemp(mailbox, &nfp, &tmpfname) != 0)
+  {
+    /* error message? */
+    goto cleanup;
+  }
+
+  /* first, copy unknown sequences */
+  if (ofp)
+  {
+    rewind(ofp);
+    while ((buf = mutt_file_read_line(buf, &s, ofp, &l, 0)))
+    {
+      bool ours = false;
+      for (int j = 0; !ours && (j < mutt_array_size(flags)); j++)
+        ours = (mutt_str_strncmp(buf, prefix[j], mutt_str_strlen(prefix[j])) == 0);
+      if (!ours)
+        fprintf(nfp, "%s\n", buf);
+    }
+  }
+
+  /* write out the new sequences */
+  for (int j = 0; j < mutt_array_size(flags); j++)
+  {
+    if (!mutt_buffer_is_empty(lines[j]))
+      fprintf(nfp, "%s\n", mutt_b2s(lines[j]));
+  }
 
   /* try to commit the changes - no guarantee here */
   mutt_file_fclose(&nfp);
@@ -555,6 +721,12 @@ static void mh_update_sequences(struct Mailbox *mailbox)
   }
 
   FREE(&tmpfname);
+
+cleanup:
+  mutt_file_fclose(&ofp);
+  FREE(&buf);
+  for (int j = 0; j < mutt_array_size(flags); j++)
+    mutt_buffer_pool_release(&lines[j]);
 }
 
 /**
@@ -600,17 +772,17 @@ static void mh_sequences_add_one(struct Mailbox *mailbox, int n, bool unseen,
     {
       if (unseen && (strncmp(buf, seq_unseen, mutt_str_strlen(seq_unseen)) == 0))
       {
-        fprintf(nfp, "%s %d\n", buf, n);
+        mhs_write_added(nfp, buf, mutt_str_strlen(seq_unseen), n);
         unseen_done = true;
       }
       else if (flagged && (strncmp(buf, seq_flagged, mutt_str_strlen(seq_flagged)) == 0))
       {
-        fprintf(nfp, "%s %d\n", buf, n);
+        mhs_write_added(nfp, buf, mutt_str_strlen(seq_flagged), n);
         flagged_done = true;
       }
       else if (replied && (strncmp(buf, seq_replied, mutt_str_strlen(seq_replied)) == 0))
       {
-        fprintf(nfp, "%s %d\n", buf, n);
+        mhs_write_added(nfp, buf, mutt_str_strlen(seq_replied), n);
         replied_done = true;
       }
       else
@@ -895,19 +1067,6 @@ static size_t maildir_hcache_keylen(const char *fn)
 }
 #endif
 
-/**
- * md_cmp_inode - Compare two Maildirs by inode number
- * @param a First  Maildir
- * @param b Second Maildir
- * @retval -1 a precedes b
- * @retval  0 a and b are identical
- * @retval  1 b precedes a
- */
-static int md_cmp_inode(struct Maildir *a, struct Maildir *b)
-{
-  return a->inode - b->inode;
-}
-
 /**
  * md_cmp_path - Compare two Maildirs by path
  * @param a First  Maildir
@@ -1057,6 +1216,84 @@ static struct Maildir *maildir_sort(struct Maildir *list, size_t len,
   return maildir_merge_lists(left, right, cmp);
 }
 
+/**
+ * struct MdInode - A Maildir entry and its inode, for sorting
+ */
+struct MdInode
+{
+  ino_t inode;        ///< Inode number
+  struct Maildir *md; ///< Maildir entry
+};
+
+/**
+ * maildir_sort_inode - Sort a Maildir list by inode number
+ * @param list Maildirs to sort
+ * @retval ptr Sorted Maildir list
+ *
+ * The entries are copied into an array and put in order with a radix sort,
+ * one byte of the inode number per pass.  Passes over bytes that are the same
+ * in every inode are skipped, so small filesystems need only a few of them.
+ * The sort is stable.
+ */
+static struct Maildir *maildir_sort_inode(struct Maildir *list)
+{
+  if (!list || !list->next)
+    return list;
+
+  size_t len = 0;
+  for (struct Maildir *p = list; p; p = p->next)
+    len++;
+
+  struct MdInode *ent = mutt_mem_malloc(len * sizeof(struct MdInode));
+  struct MdInode *tmp = mutt_mem_malloc(len * sizeof(struct MdInode));
+
+  ino_t all_or = 0;
+  ino_t all_and = (ino_t) -1;
+  size_t i = 0;
+  for (struct Maildir *p = list; p; p = p->next, i++)
+  {
+    ent[i].inode = p->inode;
+    ent[i].md = p;
+    all_or |= p->inode;
+    all_and &= p->inode;
+  }
+
+  for (size_t shift = 0; shift < (sizeof(ino_t) * 8); shift += 8)
+  {
+    /* this byte is the same in every inode, so it won't change the order */
+    if ((((all_or ^ all_and) >> shift) & 0xff) == 0)
+      continue;
+
+    size_t counts[256] = { 0 };
+    for (i = 0; i < len; i++)
+      counts[(ent[i].inode >> shift) & 0xff]++;
+
+    size_t pos = 0;
+    for (int b = 0; b < 256; b++)
+    {
+      size_t c = counts[b];
+      counts[b] = pos;
+      pos += c;
+    }
+
+    for (i = 0; i < len; i++)
+      tmp[counts[(ent[i].inode >> shift) & 0xff]++] = ent[i];
+
+    struct MdInode *swap = ent;
+    ent = tmp;
+    tmp = swap;
+  }
+
+  for (i = 0; i < (len - 1); i++)
+    ent[i].md->next = ent[i + 1].md;
+  ent[len - 1].md->next = NULL;
+  list = ent[0].md;
+
+  FREE(&ent);
+  FREE(&tmp);
+  return list;
+}
+
 /**
  * mh_sort_natural - Sort a Maildir list into its natural order
  * @param mailbox Mailbox
@@ -1098,65 +1335,416 @@ static struct Maildir *skip_duplicates(struct Maildir *p, struct Maildir **last)
 }
 
 /**
- * maildir_delayed_parsing - This function does the second parsing pass
- * @param mailbox  Mailbox
- * @param md       Maildir to parse
- * @param progress Progress bar
+ * struct MhParseJobs - Messages whose headers need parsing
+ *
+ * With $worker_threads, the cache misses found by maildir_delayed_parsing()
+ * are collected here and parsed in parallel.
  */
-static void maildir_delayed_parsing(struct Mailbox *mailbox, struct Maildir **md,
-                                    struct Progress *progress)
+struct MhParseJobs
 {
-  struct Maildir *p, *last = NULL;
+  struct Mailbox *mailbox;   ///< Mailbox being read
+  struct Maildir **md;       ///< Messages to parse
+  size_t count;              ///< Number of messages
+  size_t alloc;              ///< Slots allocated
+  struct Progress *progress; ///< Progress bar (OPTIONAL)
+  int offset;                ///< Messages already read before the jobs
+};
+
+/**
+ * mh_parse_job - Parse the headers of one message - Implements ::parallel_work_t
+ */
+static void mh_parse_job(size_t i, void *data)
+{
+  struct MhParseJobs *jobs = data;
+  struct Maildir *p = jobs->md[i];
   char fn[PATH_MAX];
-  int count;
-  bool sort = false;
-#ifdef USE_HCACHE
-  const char *key = NULL;
-  size_t keylen;
-  struct stat lastchanged;
-  int ret;
-#endif
 
-#ifdef USE_HCACHE
-  header_cache_t *hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
-#endif
+  snprintf(fn, sizeof(fn), "%s/%s", jobs->mailbox->path, p->email->path);
+  if (maildir_parse_message(jobs->mailbox->magic, fn, p->email->old, p->email))
+    p->header_parsed = 1;
+}
 
-  for (p = *md, count = 0; p; p = p->next, count++)
+/**
+ * mh_parse_progress - Update the progress bar - Implements ::parallel_progress_t
+ */
+static void mh_parse_progress(size_t done, void *data)
+{
+  struct MhParseJobs *jobs = data;
+
+  if (!jobs->mailbox->quiet && jobs->progress)
+    mutt_progress_update(jobs->progress, jobs->offset + done, -1);
+}
+
+/**
+ * mh_parse_readahead - Parse the headers of the messages, reading ahead
+ * @param jobs Messages to parse
+ *
+ * The next $maildir_readahead messages are opened before they're needed and
+ * the kernel is asked to start reading their headers.  Reading the files
+ * overlaps, instead of waiting for each one in turn, which helps most with
+ * cold caches and network filesystems.
+ */
+static void mh_parse_readahead(struct MhParseJobs *jobs)
+{
+  char fn[PATH_MAX];
+
+  if (MaildirReadahead < 2)
   {
-    if (!(p && p->email && !p->header_parsed))
+    for (size_t i = 0; i < jobs->count; i++)
     {
-      last = p;
-      continue;
+      mh_parse_job(i, jobs);
+      mh_parse_progress(i + 1, jobs);
     }
+    return;
+  }
 
-    if (!mailbox->quiet && progress)
-      mutt_progress_update(progress, count, -1);
+  const size_t window = MIN(MaildirReadahead, MH_READAHEAD_MAX);
+  int *fds = mutt_mem_malloc(jobs->count * sizeof(int));
+  size_t ahead = 0;
 
-    if (!sort)
+  for (size_t i = 0; i < jobs->count; i++)
+  {
+    for (; (ahead < jobs->count) && (ahead < (i + window)); ahead++)
     {
-      mutt_debug(4, "maildir: need to sort %s by inode\n", mailbox->path);
-      p = maildir_sort(p, (size_t) -1, md_cmp_inode);
-      if (!last)
-        *md = p;
-      else
-        last->next = p;
-      sort = true;
-      p = skip_duplicates(p, &last);
-      snprintf(fn, sizeof(fn), "%s/%s", mailbox->path, p->email->path);
+      snprintf(fn, sizeof(fn), "%s/%s", jobs->mailbox->path, jobs->md[ahead]->email->path);
+      fds[ahead] = open(fn, O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_WILLNEED
+      if (fds[ahead] != -1)
+        posix_fadvise(fds[ahead], 0, MH_READAHEAD_BYTES, POSIX_FADV_WILLNEED);
+#endif
     }
 
-    snprintf(fn, sizeof(fn), "%s/%s", mailbox->path, p->email->path);
-
-#ifdef USE_HCACHE
-    if (MaildirHeaderCacheVerify)
+    struct Maildir *p = jobs->md[i];
+    if (fds[i] != -1)
     {
-      ret = stat(fn, &lastchanged);
+      snprintf(fn, sizeof(fn), "%s/%s", jobs->mailbox->path, p->email->path);
+      maildir_parse_fd(jobs->mailbox->magic, fds[i], fn, p->email->old, p->email);
+      p->header_parsed = 1;
+      close(fds[i]);
     }
     else
-    {
-      lastchanged.st_mtime = 0;
-      ret = 0;
-    }
+      mh_parse_job(i, jobs);
+
+    mh_parse_progress(i + 1, jobs);
+  }
+
+  FREE(&fds);
+}
+
+#ifdef USE_HCACHE
+/* Identifies the snapshot record, see mh_snapshot_load() */
+#define MH_SNAPSHOT_MAGIC 0x536e6170 /* "Snap" */
+
+/* Prefix of the keys of the search index records, see mh_search_index_key() */
+#define MH_SEARCH_INDEX_KEY "/index/"
+
+/**
+ * struct MhSnapshot - Inodes of the messages verified at the last open
+ */
+struct MhSnapshot
+{
+  ino_t *inodes;  ///< Sorted inode numbers
+  size_t count;   ///< Number of inodes
+  size_t matched; ///< Number of messages found in the snapshot
+};
+
+/**
+ * mh_cmp_ino - Compare two inode numbers - Implements ::sort_t
+ */
+static int mh_cmp_ino(const void *a, const void *b)
+{
+  ino_t ia = *(const ino_t *) a;
+  ino_t ib = *(const ino_t *) b;
+  return (ia > ib) - (ia < ib);
+}
+
+/**
+ * mh_snapshot_load - Read the snapshot of a directory from the header cache
+ * @param hc   Header cache handle
+ * @param key  Key of the snapshot, e.g. "/snapshot/cur"
+ * @param snap Snapshot to fill
+ *
+ * The snapshot lists the inodes of the messages whose cache entries were valid
+ * when the folder was last read.  The key starts with a '/', so it can't clash
+ * with a message's filename.
+ */
+static void mh_snapshot_load(header_cache_t *hc, const char *key, struct MhSnapshot *snap)
+{
+  size_t keylen = strlen(key);
+  unsigned char *data = mutt_hcache_fetch_raw(hc, key, keylen);
+  if (!data)
+    return;
+
+  unsigned int magic = 0;
+  size_t count = 0;
+  memcpy(&magic, data, sizeof(magic));
+  memcpy(&count, data + sizeof(magic), sizeof(count));
+
+  if ((magic == MH_SNAPSHOT_MAGIC) && (count > 0))
+  {
+    snap->inodes = mutt_mem_malloc(count * sizeof(ino_t));
+    memcpy(snap->inodes, data + sizeof(magic) + sizeof(count), count * sizeof(ino_t));
+    snap->count = count;
+  }
+
+  mutt_hcache_free(hc, (void **) &data);
+}
+
+/**
+ * mh_snapshot_save - Save the snapshot of a directory in the header cache
+ * @param hc   Header cache handle
+ * @param key  Key of the snapshot, e.g. "/snapshot/cur"
+ * @param md   Messages that have been read
+ * @param snap Previous snapshot
+ *
+ * If every message was already in the snapshot, and none has gone, the
+ * snapshot is still accurate and isn't rewritten.
+ */
+static void mh_snapshot_save(header_cache_t *hc, const char *key,
+                             struct Maildir *md, struct MhSnapshot *snap)
+{
+  size_t count = 0;
+  for (struct Maildir *p = md; p; p = p->next)
+    if (p->email)
+      count++;
+
+  if ((count == snap->count) && (snap->matched == count))
+    return;
+
+  unsigned int magic = MH_SNAPSHOT_MAGIC;
+  size_t dlen = sizeof(magic) + sizeof(count) + (count * sizeof(ino_t));
+  unsigned char *data = mutt_mem_malloc(dlen);
+  memcpy(data, &magic, sizeof(magic));
+  memcpy(data + sizeof(magic), &count, sizeof(count));
+
+  ino_t *inodes = (ino_t *) (data + sizeof(magic) + sizeof(count));
+  size_t i = 0;
+  for (struct Maildir *p = md; p; p = p->next)
+    if (p->email)
+      memcpy(&inodes[i++], &p->inode, sizeof(ino_t));
+  qsort(inodes, count, sizeof(ino_t), mh_cmp_ino);
+
+  mutt_debug(3, "%s: %zu messages\n", key, count);
+  mutt_hcache_store_raw(hc, key, strlen(key), data, dlen);
+  FREE(&data);
+}
+
+/**
+ * mh_snapshot_has - Was a message in the snapshot?
+ * @param snap  Snapshot
+ * @param inode Inode of the message's file
+ * @retval true The message's cache entry was valid last time
+ */
+static bool mh_snapshot_has(struct MhSnapshot *snap, ino_t inode)
+{
+  if (!snap->inodes || !bsearch(&inode, snap->inodes, snap->count, sizeof(ino_t), mh_cmp_ino))
+    return false;
+
+  snap->matched++;
+  return true;
+}
+
+/**
+ * mh_hcache_store - Save the headers of a freshly parsed message
+ * @param hc      Header cache handle
+ * @param mailbox Mailbox
+ * @param e       Email
+ */
+static void mh_hcache_store(header_cache_t *hc, struct Mailbox *mailbox, struct Email *e)
+{
+  const char *key = NULL;
+  size_t keylen;
+
+  if (mailbox->magic == MUTT_MH)
+  {
+    key = e->path;
+    keylen = strlen(key);
+  }
+  else
+  {
+    key = e->path + 3;
+    keylen = maildir_hcache_keylen(key);
+  }
+  mutt_hcache_store(hc, key, keylen, e, 0);
+}
+#endif
+
+#ifdef USE_HCACHE
+/**
+ * mh_search_index_key - Get the key of a message's search index record
+ * @param mailbox Mailbox
+ * @param e       Email
+ * @param buf     Buffer for the key
+ * @param buflen  Length of the buffer
+ *
+ * The key is the message's header cache key, with a prefix starting with '/',
+ * so it can't clash with a filename.
+ */
+static void mh_search_index_key(struct Mailbox *mailbox, struct Email *e,
+                                char *buf, size_t buflen)
+{
+  if (mailbox->magic == MUTT_MH)
+    snprintf(buf, buflen, "%s%s", MH_SEARCH_INDEX_KEY, e->path);
+  else
+  {
+    snprintf(buf, buflen, "%s%.*s", MH_SEARCH_INDEX_KEY,
+             (int) maildir_hcache_keylen(e->path + 3), e->path + 3);
+  }
+}
+
+/**
+ * maildir_search_index_load - Read a message's search index record
+ * @param[in]  mailbox Mailbox
+ * @param[in]  e       Email
+ * @param[out] dlen    Length of the record
+ * @retval ptr  Record, to be freed with FREE()
+ * @retval NULL $maildir_search_index is unset, or there's no record
+ *
+ * The records are stored in the header cache of the folder.  Their content is
+ * up to the caller, see maildir_search_index_save().
+ */
+void *maildir_search_index_load(struct Mailbox *mailbox, struct Email *e, size_t *dlen)
+{
+  if (!MaildirSearchIndex || !HeaderCache || !e->path ||
+      ((mailbox->magic != MUTT_MAILDIR) && (mailbox->magic != MUTT_MH)))
+  {
+    return NULL;
+  }
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  if (!hc)
+    return NULL;
+
+  char key[PATH_MAX];
+  mh_search_index_key(mailbox, e, key, sizeof(key));
+
+  void *data = NULL;
+  unsigned char *hdata = mutt_hcache_fetch_raw(hc, key, strlen(key));
+  if (hdata)
+  {
+    memcpy(dlen, hdata, sizeof(size_t));
+    data = mutt_mem_malloc(*dlen);
+    memcpy(data, hdata + sizeof(size_t), *dlen);
+    mutt_hcache_free(hc, (void **) &hdata);
+  }
+
+  mutt_hcache_close(hc);
+  return data;
+}
+
+/**
+ * maildir_search_index_save - Save a message's search index record
+ * @param mailbox Mailbox
+ * @param e       Email
+ * @param data    Record
+ * @param dlen    Length of the record
+ *
+ * The record is deleted along with the message's header cache entry.
+ */
+void maildir_search_index_save(struct Mailbox *mailbox, struct Email *e,
+                               const void *data, size_t dlen)
+{
+  if (!MaildirSearchIndex || !HeaderCache || !e->path ||
+      ((mailbox->magic != MUTT_MAILDIR) && (mailbox->magic != MUTT_MH)))
+  {
+    return;
+  }
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  if (!hc)
+    return;
+
+  char key[PATH_MAX];
+  mh_search_index_key(mailbox, e, key, sizeof(key));
+
+  unsigned char *hdata = mutt_mem_malloc(sizeof(size_t) + dlen);
+  memcpy(hdata, &dlen, sizeof(size_t));
+  memcpy(hdata + sizeof(size_t), data, dlen);
+  mutt_hcache_store_raw(hc, key, strlen(key), hdata, sizeof(size_t) + dlen);
+  FREE(&hdata);
+
+  mutt_hcache_close(hc);
+}
+#endif
+
+/**
+ * maildir_delayed_parsing - This function does the second parsing pass
+ * @param mailbox  Mailbox
+ * @param md       Maildir to parse
+ * @param progress Progress bar
+ * @param snapshot Key of the directory's snapshot, NULL if md isn't a whole directory
+ *
+ * If $worker_threads is greater than one, the messages that aren't in the
+ * header cache are parsed in parallel, after the cache has been checked.  The
+ * results are then merged in the original order, so the outcome is the same.
+ *
+ * With $maildir_header_cache_snapshot, only the messages that weren't in the
+ * directory's snapshot need to be stat()ed to verify their cache entries.
+ */
+static void maildir_delayed_parsing(struct Mailbox *mailbox, struct Maildir **md,
+                                    struct Progress *progress, const char *snapshot)
+{
+  struct Maildir *p, *last = NULL;
+  char fn[PATH_MAX];
+  int count;
+  bool sort = false;
+  struct MhParseJobs jobs = { .mailbox = mailbox, .progress = progress };
+  /* unsorted, the index doesn't need the headers to show the messages */
+  const bool lazy = MaildirLazyHeaders && ((Sort & SORT_MASK) == SORT_ORDER);
+#ifdef USE_HCACHE
+  const char *key = NULL;
+  size_t keylen;
+  struct stat lastchanged;
+  int ret;
+  struct MhSnapshot snap = { 0 };
+#endif
+
+#ifdef USE_HCACHE
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  mutt_hcache_begin(hc);
+
+  if (!(MaildirHeaderCacheVerify && MaildirHeaderCacheSnapshot))
+    snapshot = NULL;
+  if (snapshot)
+    mh_snapshot_load(hc, snapshot, &snap);
+#endif
+
+  for (p = *md, count = 0; p; p = p->next, count++)
+  {
+    if (!(p && p->email && !p->header_parsed))
+    {
+      last = p;
+      continue;
+    }
+
+    if (!mailbox->quiet && progress)
+      mutt_progress_update(progress, count, -1);
+
+    if (!sort)
+    {
+      mutt_debug(4, "maildir: need to sort %s by inode\n", mailbox->path);
+      p = maildir_sort_inode(p);
+      if (!last)
+        *md = p;
+      else
+        last->next = p;
+      sort = true;
+      p = skip_duplicates(p, &last);
+      snprintf(fn, sizeof(fn), "%s/%s", mailbox->path, p->email->path);
+    }
+
+    snprintf(fn, sizeof(fn), "%s/%s", mailbox->path, p->email->path);
+
+#ifdef USE_HCACHE
+    if (MaildirHeaderCacheVerify && !mh_snapshot_has(&snap, p->inode))
+    {
+      ret = stat(fn, &lastchanged);
+    }
+    else
+    {
+      lastchanged.st_mtime = 0;
+      ret = 0;
+    }
 
     if (mailbox->magic == MUTT_MH)
     {
@@ -1185,32 +1773,59 @@ static void maildir_delayed_parsing(struct Mailbox *mailbox, struct Maildir **md
     {
 #endif
 
-      if (maildir_parse_message(mailbox->magic, fn, p->email->old, p->email))
+      if (lazy)
       {
+        /* Only the flags from the filename are known, for now */
+        p->email->env = mutt_env_new();
+        p->email->content = mutt_body_new();
+        p->email->header_pending = true;
         p->header_parsed = 1;
-#ifdef USE_HCACHE
-        if (mailbox->magic == MUTT_MH)
-        {
-          key = p->email->path;
-          keylen = strlen(key);
-        }
-        else
+      }
+      else
+      {
+        /* Parse it later, with the other misses */
+        if (jobs.count == jobs.alloc)
         {
-          key = p->email->path + 3;
-          keylen = maildir_hcache_keylen(key);
+          jobs.alloc += 256;
+          mutt_mem_realloc(&jobs.md, jobs.alloc * sizeof(struct Maildir *));
         }
-        mutt_hcache_store(hc, key, keylen, p->email, 0);
-#endif
+        jobs.md[jobs.count++] = p;
       }
-      else
-        mutt_email_free(&p->email);
 #ifdef USE_HCACHE
     }
     mutt_hcache_free(hc, &data);
 #endif
     last = p;
   }
+
+  if (jobs.count > 0)
+  {
+    jobs.offset = count - jobs.count;
+    if (WorkerThreads > 1)
+      mutt_parallel_for(jobs.count, WorkerThreads, mh_parse_job, mh_parse_progress, &jobs);
+    else
+      mh_parse_readahead(&jobs);
+
+    for (size_t i = 0; i < jobs.count; i++)
+    {
+      p = jobs.md[i];
+      if (!p->header_parsed)
+        mutt_email_free(&p->email);
+#ifdef USE_HCACHE
+      else
+        mh_hcache_store(hc, mailbox, p->email);
+#endif
+    }
+    FREE(&jobs.md);
+  }
+
 #ifdef USE_HCACHE
+  if (snapshot)
+  {
+    mutt_debug(3, "%s: %zu of %zu messages unchanged\n", snapshot, snap.matched, snap.count);
+    mh_snapshot_save(hc, snapshot, *md, &snap);
+    FREE(&snap.inodes);
+  }
   mutt_hcache_close(hc);
 #endif
 
@@ -1258,7 +1873,13 @@ static int mh_read_dir(struct Context *ctx, const char *subdir)
     snprintf(msgbuf, sizeof(msgbuf), _("Reading %s..."), ctx->mailbox->path);
     mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, count);
   }
-  maildir_delayed_parsing(ctx->mailbox, &md, &progress);
+  const char *snapshot = NULL;
+#ifdef USE_HCACHE
+  char snapkey[32];
+  snprintf(snapkey, sizeof(snapkey), "/snapshot%s%s", subdir ? "/" : "", NONULL(subdir));
+  snapshot = snapkey;
+#endif
+  maildir_delayed_parsing(ctx->mailbox, &md, &progress, snapshot);
 
   if (ctx->mailbox->magic == MUTT_MH)
   {
@@ -1340,6 +1961,58 @@ static int maildir_mh_open_message(struct Mailbox *mailbox, struct Message *msg,
   return 0;
 }
 
+/**
+ * bulk_close - Close a new message that will be synced later
+ * @param ctx Mailbox
+ * @param msg Message to close
+ * @retval  0 Success, or not in bulk mode
+ * @retval -1 Failure
+ *
+ * In bulk mode, the messages aren't synced one by one as they're committed.
+ * The mbox_flush() op writes them all to disk at once.
+ */
+static int bulk_close(struct Context *ctx, struct Message *msg)
+{
+#ifdef HAVE_SYNCFS
+  if (ctx->bulk && (mutt_file_fclose(&msg->fp) != 0))
+  {
+    mutt_perror(_("Could not flush message to disk"));
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+/**
+ * sync_dir - Write a directory to disk
+ * @param path    Directory
+ * @param sync_fs If true, write the rest of its filesystem too
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int sync_dir(const char *path, bool sync_fs)
+{
+  int rc = 0;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    mutt_perror(path);
+    return -1;
+  }
+
+#ifdef HAVE_SYNCFS
+  if (sync_fs && (syncfs(fd) != 0))
+    rc = -1;
+#endif
+  if ((rc == 0) && (fsync(fd) != 0))
+    rc = -1;
+  if (rc != 0)
+    mutt_perror(path);
+
+  close(fd);
+  return rc;
+}
+
 /**
  * mh_commit_msg - Commit a message to an MH folder
  * @param mailbox Mailbox
@@ -1631,6 +2304,36 @@ static int mh_sync_message(struct Context *ctx, int msgno)
   return 0;
 }
 
+/**
+ * maildir_sync_target - Work out the name of a message that matches its flags
+ * @param[in]  e        Email
+ * @param[out] partpath New path, relative to the mailbox, e.g. "cur/123.abc:2,S"
+ * @retval  0 Success
+ * @retval -1 Error
+ */
+static int maildir_sync_target(struct Email *e, struct Buffer *partpath)
+{
+  char suffix[16];
+
+  const char *p = strrchr(e->path, '/');
+  if (!p)
+  {
+    mutt_debug(1, "%s: unable to find subdir!\n", e->path);
+    return -1;
+  }
+  p++;
+
+  /* kill the previous flags */
+  const char *colon = strchr(p, ':');
+  const size_t len = colon ? (size_t)(colon - p) : strlen(p);
+
+  maildir_gen_flags(suffix, sizeof(suffix), e);
+
+  mutt_buffer_printf(partpath, "%s/%.*s%s", (e->read || e->old) ? "cur" : "new",
+                     (int) len, p, suffix);
+  return 0;
+}
+
 /**
  * maildir_sync_message - Sync an email to a Maildir folder
  * @param ctx   Mailbox
@@ -1641,11 +2344,9 @@ static int mh_sync_message(struct Context *ctx, int msgno)
 static int maildir_sync_message(struct Context *ctx, int msgno)
 {
   struct Email *e = ctx->mailbox->hdrs[msgno];
-  struct Buffer *newpath = NULL;
   struct Buffer *partpath = NULL;
   struct Buffer *fullpath = NULL;
   struct Buffer *oldpath = NULL;
-  char suffix[16];
   int rc = 0;
 
   if (e->attach_del || e->xlabel_changed ||
@@ -1658,33 +2359,16 @@ static int maildir_sync_message(struct Context *ctx, int msgno)
   else
   {
     /* we just have to rename the file. */
-
-    char *p = strrchr(e->path, '/');
-    if (!p)
-    {
-      mutt_debug(1, "%s: unable to find subdir!\n", e->path);
-      return -1;
-    }
-    p++;
-    newpath = mutt_buffer_pool_get();
     partpath = mutt_buffer_pool_get();
     fullpath = mutt_buffer_pool_get();
     oldpath = mutt_buffer_pool_get();
 
-    mutt_buffer_strcpy(newpath, p);
-
-    /* kill the previous flags */
-    p = strchr(newpath->data, ':');
-    if (p)
+    if (maildir_sync_target(e, partpath) != 0)
     {
-      *p = '\0';
-      newpath->dptr = p; /* fix buffer up, just to be safe */
+      rc = -1;
+      goto cleanup;
     }
 
-    maildir_gen_flags(suffix, sizeof(suffix), e);
-
-    mutt_buffer_printf(partpath, "%s/%s%s", (e->read || e->old) ? "cur" : "new",
-                       mutt_b2s(newpath), suffix);
     mutt_buffer_printf(fullpath, "%s/%s", ctx->mailbox->path, mutt_b2s(partpath));
     mutt_buffer_printf(oldpath, "%s/%s", ctx->mailbox->path, e->path);
 
@@ -1707,7 +2391,6 @@ static int maildir_sync_message(struct Context *ctx, int msgno)
   }
 
 cleanup:
-  mutt_buffer_pool_release(&newpath);
   mutt_buffer_pool_release(&partpath);
   mutt_buffer_pool_release(&fullpath);
   mutt_buffer_pool_release(&oldpath);
@@ -1860,30 +2543,22 @@ bool mh_mailbox(struct Mailbox *mailbox, bool check_stats)
     mailbox->msg_flagged = 0;
   }
 
-  for (int i = mhs.max; i > 0; i--)
+  if (check_stats)
+  {
+    mailbox->msg_flagged = mhs_count(&mhs, MH_SEQ_FLAGGED);
+    mailbox->msg_unread = mhs_count(&mhs, MH_SEQ_UNSEEN);
+  }
+
+  /* Only the highest unseen message matters for new mail.  If it was in the
+   * mailbox during the last visit, don't notify about it. */
+  const struct MhSequence *unseen = &mhs.seq[mhs_index(MH_SEQ_UNSEEN)];
+  if (check_new && (unseen->count > 0))
   {
-    if (check_stats && (mhs_check(&mhs, i) & MH_SEQ_FLAGGED))
-      mailbox->msg_flagged++;
-    if (mhs_check(&mhs, i) & MH_SEQ_UNSEEN)
+    const int i = unseen->ranges[unseen->count - 1].last;
+    if (!MailCheckRecent || mh_already_notified(mailbox, i) == 0)
     {
-      if (check_stats)
-        mailbox->msg_unread++;
-      if (check_new)
-      {
-        /* if the first unseen message we encounter was in the mailbox during the
-           last visit, don't notify about it */
-        if (!MailCheckRecent || mh_already_notified(mailbox, i) == 0)
-        {
-          mailbox->has_new = true;
-          rc = true;
-        }
-        /* Because we are traversing from high to low, we can stop
-         * checking for new mail after the first unseen message.
-         * Whether it resulted in "new mail" or not. */
-        check_new = false;
-        if (!check_stats)
-          break;
-      }
+      mailbox->has_new = true;
+      rc = true;
     }
   }
   mhs_free_sequences(&mhs);
@@ -1966,6 +2641,36 @@ void maildir_parse_flags(struct Email *e, const char *path)
     *q = '\0';
 }
 
+/**
+ * maildir_parse_finish - Fill in the details of a Maildir message after its header
+ * @param magic  Mailbox type, e.g. #MUTT_MAILDIR
+ * @param fname  Message filename
+ * @param is_old true, if the email is old (read)
+ * @param e      Email Header
+ * @param size   Size of the message file
+ */
+static void maildir_parse_finish(enum MailboxType magic, const char *fname,
+                                 bool is_old, struct Email *e, LOFF_T size)
+{
+  if (!e->received)
+    e->received = e->date_sent;
+
+  /* always update the length since we have fresh information available. */
+  e->content->length = size - e->content->offset;
+
+  e->index = -1;
+
+  if (magic == MUTT_MAILDIR)
+  {
+    /* maildir stores its flags in the filename, so ignore the
+     * flags in the header of the message
+     */
+
+    e->old = is_old;
+    maildir_parse_flags(e, fname);
+  }
+}
+
 /**
  * maildir_parse_stream - Parse a Maildir message
  * @param magic  Mailbox type, e.g. #MUTT_MAILDIR
@@ -1988,24 +2693,87 @@ struct Email *maildir_parse_stream(enum MailboxType magic, FILE *f,
   e->env = mutt_rfc822_read_header(f, e, false, false);
 
   fstat(fileno(f), &st);
+  maildir_parse_finish(magic, fname, is_old, e, st.st_size);
+  return e;
+}
 
-  if (!e->received)
-    e->received = e->date_sent;
-
-  /* always update the length since we have fresh information available. */
-  e->content->length = st.st_size - e->content->offset;
-
-  e->index = -1;
+/**
+ * read_header_block - Read the start of a message, up to the end of its header
+ * @param[in]  fd  File descriptor of the message
+ * @param[out] len Number of bytes read
+ * @retval ptr Bytes read, the caller must free them
+ *
+ * Reading stops after the first blank line, or at the end of the file.
+ */
+static char *read_header_block(int fd, size_t *len)
+{
+  size_t alloc = MH_READAHEAD_BYTES;
+  size_t used = 0;
+  char *buf = mutt_mem_malloc(alloc);
 
-  if (magic == MUTT_MAILDIR)
+  while (true)
   {
-    /* maildir stores its flags in the filename, so ignore the
-     * flags in the header of the message
-     */
+    if (used == alloc)
+    {
+      alloc *= 2;
+      mutt_mem_realloc(&buf, alloc);
+    }
 
-    e->old = is_old;
-    maildir_parse_flags(e, fname);
+    const ssize_t n = read(fd, buf + used, alloc - used);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (n == 0)
+      break;
+
+    /* look for "\n\n" or "\n\r\n", including across the previous read */
+    const size_t from = (used > 2) ? used - 2 : 0;
+    used += n;
+    for (const char *p = buf + from; (p = memchr(p, '\n', buf + used - p)); p++)
+    {
+      if (((p + 1 < buf + used) && (p[1] == '\n')) ||
+          ((p + 2 < buf + used) && (p[1] == '\r') && (p[2] == '\n')))
+      {
+        *len = used;
+        return buf;
+      }
+    }
   }
+
+  *len = used;
+  return buf;
+}
+
+/**
+ * maildir_parse_fd - Parse a Maildir message, from a file descriptor
+ * @param magic  Mailbox type, e.g. #MUTT_MAILDIR
+ * @param fd     File descriptor of the message, at its start
+ * @param fname  Message filename
+ * @param is_old true, if the email is old (read)
+ * @param e      Email Header to populate (OPTIONAL)
+ * @retval ptr Populated email Header
+ *
+ * Like maildir_parse_stream(), but the header is read in one go and parsed in
+ * memory.
+ */
+struct Email *maildir_parse_fd(enum MailboxType magic, int fd, const char *fname,
+                               bool is_old, struct Email *e)
+{
+  struct stat st;
+  size_t len = 0;
+
+  char *buf = read_header_block(fd, &len);
+
+  if (!e)
+    e = mutt_email_new();
+  e->env = mutt_hdrshare_read_header(buf, len, e);
+  FREE(&buf);
+
+  fstat(fd, &st);
+  maildir_parse_finish(magic, fname, is_old, e, st.st_size);
   return e;
 }
 
@@ -2023,12 +2791,12 @@ struct Email *maildir_parse_stream(enum MailboxType magic, FILE *f,
 struct Email *maildir_parse_message(enum MailboxType magic, const char *fname,
                                     bool is_old, struct Email *e)
 {
-  FILE *f = fopen(fname, "r");
-  if (!f)
+  int fd = open(fname, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
     return NULL;
 
-  e = maildir_parse_stream(magic, f, fname, is_old, e);
-  mutt_file_fclose(&f);
+  e = maildir_parse_fd(magic, fd, fname, is_old, e);
+  close(fd);
   return e;
 }
 
@@ -2098,6 +2866,10 @@ int mh_sync_mailbox_message(struct Context *ctx, int msgno)
           keylen = maildir_hcache_keylen(key);
         }
         mutt_hcache_delete(hc, key, keylen);
+
+        char ikey[PATH_MAX];
+        mh_search_index_key(ctx->mailbox, e, ikey, sizeof(ikey));
+        mutt_hcache_delete(hc, ikey, strlen(ikey));
       }
 #endif
       unlink(path);
@@ -2288,16 +3060,76 @@ int maildir_check_empty(const char *path)
 }
 
 /**
- * mh_check_empty - Is mailbox empty
- * @param path Mailbox to check
- * @retval 1 Mailbox is empty
- * @retval 0 Mailbox contains mail
- * @retval -1 Error
+ * mh_check_empty - Is mailbox empty
+ * @param path Mailbox to check
+ * @retval 1 Mailbox is empty
+ * @retval 0 Mailbox contains mail
+ * @retval -1 Error
+ */
+int mh_check_empty(const char *path)
+{
+  struct dirent *de = NULL;
+  int r = 1; /* assume empty until we find a message */
+
+  DIR *dp = opendir(path);
+  if (!dp)
+    return -1;
+  while ((de = readdir(dp)))
+  {
+    if (mh_valid_message(de->d_name))
+    {
+      r = 0;
+      break;
+    }
+  }
+  closedir(dp);
+
+  return r;
+}
+
+/**
+ * maildir_count_messages - Count the messages in a Maildir folder
+ * @param path Mailbox to count
+ * @retval num Number of messages
+ * @retval -1  Error
+ *
+ * The files aren't opened, so this is much cheaper than reading the mailbox.
+ */
+int maildir_count_messages(const char *path)
+{
+  struct dirent *de = NULL;
+  char realpath[PATH_MAX];
+  int count = 0;
+
+  for (int i = 0; i < 2; i++)
+  {
+    snprintf(realpath, sizeof(realpath), "%s/%s", path, (i == 0) ? "cur" : "new");
+    DIR *dp = opendir(realpath);
+    if (!dp)
+      return -1;
+    while ((de = readdir(dp)))
+    {
+      if (*de->d_name != '.')
+        count++;
+    }
+    closedir(dp);
+  }
+
+  return count;
+}
+
+/**
+ * mh_count_messages - Count the messages in an MH folder
+ * @param path Mailbox to count
+ * @retval num Number of messages
+ * @retval -1  Error
+ *
+ * The files aren't opened, so this is much cheaper than reading the mailbox.
  */
-int mh_check_empty(const char *path)
+int mh_count_messages(const char *path)
 {
   struct dirent *de = NULL;
-  int r = 1; /* assume empty until we find a message */
+  int count = 0;
 
   DIR *dp = opendir(path);
   if (!dp)
@@ -2305,14 +3137,11 @@ int mh_check_empty(const char *path)
   while ((de = readdir(dp)))
   {
     if (mh_valid_message(de->d_name))
-    {
-      r = 0;
-      break;
-    }
+      count++;
   }
   closedir(dp);
 
-  return r;
+  return count;
 }
 
 /**
@@ -2373,6 +3202,156 @@ static int maildir_mbox_open_append(struct Context *ctx, int flags)
   return 0;
 }
 
+/**
+ * maildir_merge_flags - Merge the flags found on disk into a known message
+ * @param ctx Mailbox
+ * @param o   Email in the Mailbox
+ * @param n   Email just scanned from disk
+ * @retval true The flags of the Email were changed
+ */
+static bool maildir_merge_flags(struct Context *ctx, struct Email *o, struct Email *n)
+{
+  bool flags_changed = false;
+
+  /* if the user hasn't modified the flags on this message, update
+   * the flags we just detected.
+   */
+  if (!o->changed)
+    if (maildir_update_flags(ctx, o, n))
+      flags_changed = true;
+
+  if (o->deleted == o->trash)
+  {
+    if (o->deleted != n->deleted)
+    {
+      o->deleted = n->deleted;
+      flags_changed = true;
+    }
+  }
+  o->trash = n->trash;
+
+  return flags_changed;
+}
+
+#ifdef USE_INOTIFY
+/**
+ * maildir_check_changes - Apply a list of changed entries to the Mailbox
+ * @param ctx        Mailbox
+ * @param index_hint Current email in index
+ * @param changes    Paths of the entries that changed, e.g. "new/123.abc"
+ * @retval num Same as maildir_mbox_check()
+ *
+ * Only the listed entries are looked at, so the cost depends on the number of
+ * changes, not on the size of the mailbox.  A message is identified by its
+ * canonical filename; an entry that no longer exists may have been renamed, so
+ * the other entries of a message are checked before it's considered gone.
+ */
+static int maildir_check_changes(struct Context *ctx, int *index_hint,
+                                 struct ListHead *changes)
+{
+  struct Mailbox *m = ctx->mailbox;
+  bool occult = false;
+  bool flags_changed = false;
+  struct Maildir *md = NULL;
+  struct Maildir **last = &md;
+  struct ListNode *np = NULL, *np2 = NULL;
+  struct stat st;
+
+  struct Buffer *canon = mutt_buffer_pool_get();
+  struct Buffer *buf = mutt_buffer_pool_get();
+
+  struct Hash *known = mutt_hash_create(m->msg_count, MUTT_HASH_STRDUP_KEYS);
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    m->hdrs[i]->active = true;
+    maildir_canon_filename(canon, m->hdrs[i]->path);
+    mutt_hash_insert(known, mutt_b2s(canon), m->hdrs[i]);
+  }
+  struct Hash *seen = mutt_hash_create(16, MUTT_HASH_STRDUP_KEYS);
+
+  STAILQ_FOREACH(np, changes, entries)
+  {
+    maildir_canon_filename(canon, np->data);
+    if (mutt_hash_find(seen, mutt_b2s(canon)))
+      continue;
+    mutt_hash_insert(seen, mutt_b2s(canon), np);
+
+    struct Email *e = mutt_hash_find(known, mutt_b2s(canon));
+    if (e)
+    {
+      mutt_buffer_printf(buf, "%s/%s", m->path, e->path);
+      if (stat(mutt_b2s(buf), &st) == 0)
+        continue; /* still where we left it */
+    }
+
+    /* find where the message lives now */
+    const char *found = NULL;
+    for (np2 = np; np2 && !found; np2 = STAILQ_NEXT(np2, entries))
+    {
+      maildir_canon_filename(buf, np2->data);
+      if (mutt_str_strcmp(mutt_b2s(buf), mutt_b2s(canon)) != 0)
+        continue;
+      mutt_buffer_printf(buf, "%s/%s", m->path, np2->data);
+      if (stat(mutt_b2s(buf), &st) == 0)
+        found = np2->data;
+    }
+
+    if (!found)
+    {
+      if (e)
+      {
+        mutt_debug(2, "%s has gone\n", e->path);
+        e->active = false;
+        occult = true;
+      }
+      continue;
+    }
+
+    struct Email *n = mutt_email_new();
+    n->old = MarkOld ? (mutt_str_strncmp(found, "cur/", 4) == 0) : false;
+    maildir_parse_flags(n, found);
+    n->path = mutt_str_strdup(found);
+
+    if (e)
+    {
+      mutt_debug(2, "%s has moved to %s\n", e->path, found);
+      mutt_str_replace(&e->path, found);
+      if (maildir_merge_flags(ctx, e, n))
+        flags_changed = true;
+      mutt_email_free(&n);
+      continue;
+    }
+
+    mutt_debug(2, "queueing %s\n", found);
+    struct Maildir *entry = mutt_mem_calloc(1, sizeof(struct Maildir));
+    entry->email = n;
+    entry->canon_fname = mutt_str_strdup(mutt_b2s(canon));
+    entry->inode = st.st_ino;
+    *last = entry;
+    last = &entry->next;
+  }
+
+  mutt_hash_destroy(&seen);
+  mutt_hash_destroy(&known);
+  mutt_buffer_pool_release(&buf);
+  mutt_buffer_pool_release(&canon);
+
+  if (occult)
+    maildir_update_tables(ctx, index_hint);
+
+  maildir_delayed_parsing(m, &md, NULL, NULL);
+  int have_new = maildir_move_to_context(ctx, &md);
+
+  if (occult)
+    return MUTT_REOPENED;
+  if (have_new)
+    return MUTT_NEW_MAIL;
+  if (flags_changed)
+    return MUTT_FLAGS;
+  return 0;
+}
+#endif
+
 /**
  * maildir_mbox_check - Implements MxOps::mbox_check()
  *
@@ -2418,6 +3397,23 @@ static int maildir_mbox_check(struct Context *ctx, int *index_hint)
     return -1;
   }
 
+#ifdef USE_INOTIFY
+  /* if the monitor knows exactly what changed, there's no need to scan */
+  struct ListHead changes = STAILQ_HEAD_INITIALIZER(changes);
+  if (mutt_monitor_context_changes(&changes) == 0)
+  {
+    mutt_buffer_pool_release(&buf);
+    MonitorContextChanged = 0;
+    mutt_get_stat_timespec(&mdata->mtime_cur, &st_cur, MUTT_STAT_MTIME);
+    mutt_get_stat_timespec(&ctx->mailbox->mtime, &st_new, MUTT_STAT_MTIME);
+    if (STAILQ_EMPTY(&changes))
+      return 0;
+    int rc = maildir_check_changes(ctx, index_hint, &changes);
+    mutt_list_free(&changes);
+    return rc;
+  }
+#endif
+
   /* determine which subdirectories need to be scanned */
   if (mutt_stat_timespec_compare(&st_new, MUTT_STAT_MTIME, &ctx->mailbox->mtime) > 0)
     changed = 1;
@@ -2486,22 +3482,8 @@ static int maildir_mbox_check(struct Context *ctx, int *index_hint)
       if (mutt_str_strcmp(ctx->mailbox->hdrs[i]->path, p->email->path) != 0)
         mutt_str_replace(&ctx->mailbox->hdrs[i]->path, p->email->path);
 
-      /* if the user hasn't modified the flags on this message, update
-       * the flags we just detected.
-       */
-      if (!ctx->mailbox->hdrs[i]->changed)
-        if (maildir_update_flags(ctx, ctx->mailbox->hdrs[i], p->email))
-          flags_changed = true;
-
-      if (ctx->mailbox->hdrs[i]->deleted == ctx->mailbox->hdrs[i]->trash)
-      {
-        if (ctx->mailbox->hdrs[i]->deleted != p->email->deleted)
-        {
-          ctx->mailbox->hdrs[i]->deleted = p->email->deleted;
-          flags_changed = true;
-        }
-      }
-      ctx->mailbox->hdrs[i]->trash = p->email->trash;
+      if (maildir_merge_flags(ctx, ctx->mailbox->hdrs[i], p->email))
+        flags_changed = true;
 
       /* this is a duplicate of an existing header, so remove it */
       mutt_email_free(&p->email);
@@ -2537,7 +3519,7 @@ static int maildir_mbox_check(struct Context *ctx, int *index_hint)
     maildir_update_tables(ctx, index_hint);
 
   /* do any delayed parsing we need to do. */
-  maildir_delayed_parsing(ctx->mailbox, &md, NULL);
+  maildir_delayed_parsing(ctx->mailbox, &md, NULL, NULL);
 
   /* Incorporate new messages */
   have_new = maildir_move_to_context(ctx, &md);
@@ -2638,6 +3620,9 @@ static int maildir_msg_open_new(struct Context *ctx, struct Message *msg, struct
  */
 static int maildir_msg_commit(struct Context *ctx, struct Message *msg)
 {
+  if (bulk_close(ctx, msg) != 0)
+    return -1;
+
   return md_commit_message(ctx->mailbox, msg, NULL);
 }
 
@@ -2836,7 +3821,7 @@ static int mh_mbox_check(struct Context *ctx, int *index_hint)
   last = &md;
 
   maildir_parse_dir(ctx->mailbox, &last, NULL, &count, NULL);
-  maildir_delayed_parsing(ctx->mailbox, &md, NULL);
+  maildir_delayed_parsing(ctx->mailbox, &md, NULL, NULL);
 
   if (mh_read_sequences(&mhs, ctx->mailbox->path) < 0)
     return -1;
@@ -2892,6 +3877,176 @@ static int mh_mbox_check(struct Context *ctx, int *index_hint)
   return 0;
 }
 
+/**
+ * struct MhRename - A message file to be renamed
+ */
+struct MhRename
+{
+  int msgno;      ///< Index of the Email in the Mailbox
+  char *oldpath;  ///< Current full path
+  char *newpath;  ///< New full path
+  char *partpath; ///< New path, relative to the mailbox
+  int err;        ///< errno of a failed rename(), or 0
+};
+
+/**
+ * struct MhRenameJobs - Renames deferred until the end of a sync
+ */
+struct MhRenameJobs
+{
+  struct Mailbox *mailbox;   ///< Mailbox being synced
+  struct MhRename *renames;  ///< Renames to do
+  size_t count;              ///< Number of renames
+  size_t alloc;              ///< Slots allocated
+  struct Progress *progress; ///< Progress bar (OPTIONAL)
+};
+
+/**
+ * maildir_sync_defer - Queue the rename of a Maildir message, if that's all it needs
+ * @param ctx   Mailbox
+ * @param msgno Index number
+ * @param jobs  Renames to add to
+ * @retval true The message will be synced by maildir_sync_renames()
+ *
+ * Messages that have to be deleted or rewritten are left for
+ * mh_sync_mailbox_message().
+ */
+static bool maildir_sync_defer(struct Context *ctx, int msgno, struct MhRenameJobs *jobs)
+{
+  struct Email *e = ctx->mailbox->hdrs[msgno];
+
+  if (ctx->mailbox->magic != MUTT_MAILDIR)
+    return false;
+  if (e->deleted && !MaildirTrash)
+    return false;
+  if (!(e->changed || ((MaildirTrash || e->trash) && (e->deleted != e->trash))))
+    return false;
+  if (e->attach_del || e->xlabel_changed ||
+      (e->env && (e->env->refs_changed || e->env->irt_changed)))
+  {
+    return false;
+  }
+
+  struct Buffer *partpath = mutt_buffer_pool_get();
+  if ((maildir_sync_target(e, partpath) != 0) ||
+      (mutt_str_strcmp(mutt_b2s(partpath), e->path) == 0))
+  {
+    mutt_buffer_pool_release(&partpath);
+    return false;
+  }
+
+  if (jobs->count == jobs->alloc)
+  {
+    jobs->alloc += 256;
+    mutt_mem_realloc(&jobs->renames, jobs->alloc * sizeof(struct MhRename));
+  }
+
+  struct MhRename *r = &jobs->renames[jobs->count++];
+  char path[PATH_MAX];
+  r->msgno = msgno;
+  snprintf(path, sizeof(path), "%s/%s", ctx->mailbox->path, e->path);
+  r->oldpath = mutt_str_strdup(path);
+  snprintf(path, sizeof(path), "%s/%s", ctx->mailbox->path, mutt_b2s(partpath));
+  r->newpath = mutt_str_strdup(path);
+  r->partpath = mutt_str_strdup(mutt_b2s(partpath));
+  r->err = 0;
+  mutt_buffer_pool_release(&partpath);
+
+  /* record that the message is possibly marked as trashed on disk */
+  e->trash = e->deleted;
+  return true;
+}
+
+/**
+ * mh_rename_job - Rename one message file - Implements ::parallel_work_t
+ */
+static void mh_rename_job(size_t i, void *data)
+{
+  struct MhRenameJobs *jobs = data;
+  struct MhRename *r = &jobs->renames[i];
+
+  if (rename(r->oldpath, r->newpath) != 0)
+    r->err = errno;
+}
+
+/**
+ * mh_rename_progress - Update the progress bar - Implements ::parallel_progress_t
+ */
+static void mh_rename_progress(size_t done, void *data)
+{
+  struct MhRenameJobs *jobs = data;
+
+  if (!jobs->mailbox->quiet && jobs->progress)
+    mutt_progress_update(jobs->progress, done, -1);
+}
+
+/**
+ * mh_rename_jobs_free - Free the deferred renames
+ * @param jobs Renames
+ */
+static void mh_rename_jobs_free(struct MhRenameJobs *jobs)
+{
+  for (size_t i = 0; i < jobs->count; i++)
+  {
+    FREE(&jobs->renames[i].oldpath);
+    FREE(&jobs->renames[i].newpath);
+    FREE(&jobs->renames[i].partpath);
+  }
+  FREE(&jobs->renames);
+  jobs->count = 0;
+  jobs->alloc = 0;
+}
+
+/**
+ * maildir_sync_renames - Do the renames deferred by maildir_sync_defer()
+ * @param ctx  Mailbox
+ * @param jobs Renames
+ * @param hc   Header cache handle
+ * @retval  0 Success
+ * @retval -1 Error, at least one message couldn't be renamed
+ *
+ * The renames are done in one go, spread over $worker_threads, after which the
+ * Emails and the header cache are updated.
+ */
+#ifdef USE_HCACHE
+static int maildir_sync_renames(struct Context *ctx, struct MhRenameJobs *jobs,
+                                header_cache_t *hc)
+#else
+static int maildir_sync_renames(struct Context *ctx, struct MhRenameJobs *jobs)
+#endif
+{
+  int rc = 0;
+
+  mutt_debug(2, "renaming %zu messages\n", jobs->count);
+  mutt_parallel_for(jobs->count, WorkerThreads, mh_rename_job, mh_rename_progress, jobs);
+
+  for (size_t i = 0; i < jobs->count; i++)
+  {
+    struct MhRename *r = &jobs->renames[i];
+    struct Email *e = ctx->mailbox->hdrs[r->msgno];
+
+    if (r->err != 0)
+    {
+      if (rc == 0)
+      {
+        errno = r->err;
+        mutt_perror("rename");
+      }
+      rc = -1;
+      continue;
+    }
+
+    mutt_str_replace(&e->path, r->partpath);
+#ifdef USE_HCACHE
+    if (hc && e->changed)
+      mh_hcache_store(hc, ctx->mailbox, e);
+#endif
+  }
+
+  mh_rename_jobs_free(jobs);
+  return rc;
+}
+
 /**
  * mh_mbox_sync - Implements MxOps::mbox_sync()
  */
@@ -2903,6 +4058,7 @@ static int mh_mbox_sync(struct Context *ctx, int *index_hint)
 #endif
   char msgbuf[PATH_MAX + 64];
   struct Progress progress;
+  struct MhRenameJobs renames = { .mailbox = ctx->mailbox };
 
   if (ctx->mailbox->magic == MUTT_MH)
     i = mh_mbox_check(ctx, index_hint);
@@ -2914,7 +4070,10 @@ static int mh_mbox_sync(struct Context *ctx, int *index_hint)
 
 #ifdef USE_HCACHE
   if (ctx->mailbox->magic == MUTT_MAILDIR || ctx->mailbox->magic == MUTT_MH)
+  {
     hc = mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
+    mutt_hcache_begin(hc);
+  }
 #endif
 
   if (!ctx->mailbox->quiet)
@@ -2929,6 +4088,10 @@ static int mh_mbox_sync(struct Context *ctx, int *index_hint)
     if (!ctx->mailbox->quiet)
       mutt_progress_update(&progress, i, -1);
 
+    /* flag changes are done in bulk, below */
+    if (maildir_sync_defer(ctx, i, &renames))
+      continue;
+
 #ifdef USE_HCACHE
     if (mh_sync_mailbox_message(ctx, i, hc) == -1)
       goto err;
@@ -2938,6 +4101,22 @@ static int mh_mbox_sync(struct Context *ctx, int *index_hint)
 #endif
   }
 
+  if (renames.count > 0)
+  {
+    if (!ctx->mailbox->quiet)
+    {
+      mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, WriteInc, renames.count);
+      renames.progress = &progress;
+    }
+#ifdef USE_HCACHE
+    if (maildir_sync_renames(ctx, &renames, hc) == -1)
+      goto err;
+#else
+    if (maildir_sync_renames(ctx, &renames) == -1)
+      goto err;
+#endif
+  }
+
 #ifdef USE_HCACHE
   if (ctx->mailbox->magic == MUTT_MAILDIR || ctx->mailbox->magic == MUTT_MH)
     mutt_hcache_close(hc);
@@ -2964,6 +4143,7 @@ static int mh_mbox_sync(struct Context *ctx, int *index_hint)
   return 0;
 
 err:
+  mh_rename_jobs_free(&renames);
 #ifdef USE_HCACHE
   if (ctx->mailbox->magic == MUTT_MAILDIR || ctx->mailbox->magic == MUTT_MH)
     mutt_hcache_close(hc);
@@ -2982,6 +4162,92 @@ static int mh_mbox_close(struct Context *ctx)
   return 0;
 }
 
+/**
+ * maildir_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int maildir_mbox_flush(struct Context *ctx)
+{
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/new", ctx->mailbox->path);
+  if (sync_dir(path, true) != 0)
+    return -1;
+
+  snprintf(path, sizeof(path), "%s/cur", ctx->mailbox->path);
+  return sync_dir(path, false);
+}
+
+/**
+ * mh_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int mh_mbox_flush(struct Context *ctx)
+{
+  return sync_dir(ctx->mailbox->path, true);
+}
+
+/**
+ * mh_msg_load_header - Implements MxOps::msg_load_header()
+ *
+ * Read the headers of an email that was added by name only, because of
+ * $maildir_lazy_headers.
+ */
+static int mh_msg_load_header(struct Context *ctx, struct Email *e)
+{
+  char fn[PATH_MAX];
+  snprintf(fn, sizeof(fn), "%s/%s", ctx->mailbox->path, e->path);
+
+  FILE *fp = fopen(fn, "r");
+  if (!fp)
+  {
+    mutt_debug(1, "can't read %s: %s\n", fn, strerror(errno));
+    return -1;
+  }
+
+  /* the flags may have been changed since the mailbox was opened, keep them
+   * rather than take the ones from the file or its headers */
+  const struct Email saved = *e;
+
+  mutt_env_free(&e->env);
+  mutt_body_free(&e->content);
+  maildir_parse_stream(MUTT_MH, fp, fn, e->old, e);
+  mutt_file_fclose(&fp);
+
+  e->read = saved.read;
+  e->old = saved.old;
+  e->flagged = saved.flagged;
+  e->replied = saved.replied;
+  e->deleted = saved.deleted;
+  e->trash = saved.trash;
+  e->changed = saved.changed;
+  e->index = saved.index;
+
+#ifdef USE_HCACHE
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
+  mh_hcache_store(hc, ctx->mailbox, e);
+  mutt_hcache_close(hc);
+#endif
+
+  return 0;
+}
+
+/**
+ * mh_msg_save_hcache - Implements MxOps::msg_save_hcache()
+ */
+static int mh_msg_save_hcache(struct Context *ctx, struct Email *e)
+{
+  int rc = -1;
+#ifdef USE_HCACHE
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
+  if (hc)
+  {
+    mh_hcache_store(hc, ctx->mailbox, e);
+    rc = 0;
+  }
+  mutt_hcache_close(hc);
+#endif
+  return rc;
+}
+
 /**
  * mh_msg_open - Implements MxOps::msg_open()
  */
@@ -3005,6 +4271,9 @@ static int mh_msg_open_new(struct Context *ctx, struct Message *msg, struct Emai
  */
 static int mh_msg_commit(struct Context *ctx, struct Message *msg)
 {
+  if (bulk_close(ctx, msg) != 0)
+    return -1;
+
   return mh_commit_msg(ctx->mailbox, msg, NULL, true);
 }
 
@@ -3073,11 +4342,14 @@ struct MxOps mx_maildir_ops = {
   .mbox_check       = maildir_mbox_check,
   .mbox_sync        = mh_mbox_sync,
   .mbox_close       = mh_mbox_close,
+  .mbox_flush       = maildir_mbox_flush,
   .msg_open         = maildir_msg_open,
   .msg_open_new     = maildir_msg_open_new,
   .msg_commit       = maildir_msg_commit,
   .msg_close        = mh_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = mh_msg_load_header,
+  .msg_save_hcache  = mh_msg_save_hcache,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = maildir_path_probe,
@@ -3097,11 +4369,14 @@ struct MxOps mx_mh_ops = {
   .mbox_check       = mh_mbox_check,
   .mbox_sync        = mh_mbox_sync,
   .mbox_close       = mh_mbox_close,
+  .mbox_flush       = mh_mbox_flush,
   .msg_open         = mh_msg_open,
   .msg_open_new     = mh_msg_open_new,
   .msg_commit       = mh_msg_commit,
   .msg_close        = mh_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = mh_msg_load_header,
+  .msg_save_hcache  = mh_msg_save_hcache,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = mh_path_probe,
@@ -48,12 +48,14 @@
 #include "conn/conn.h"
 #include "mutt.h"
 #include "alias.h"
+#include "bench.h"
 #include "browser.h"
 #include "color.h"
 #include "context.h"
 #include "curs_lib.h"
 #include "curs_main.h"
 #include "globals.h"
+#include "handler.h"
 #include "hook.h"
 #include "keymap.h"
 #include "mailbox.h"
@@ -69,6 +71,7 @@
 #include "protos.h"
 #include "send.h"
 #include "sendlib.h"
+#include "smtp.h"
 #include "terminal.h"
 #include "version.h"
 #ifdef ENABLE_NLS
@@ -83,6 +86,9 @@
 #ifdef USE_NNTP
 #include "nntp/nntp.h"
 #endif
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 /* These Config Variables are only used in main.c */
 bool ResumeEditedDraftFiles; ///< Config: Resume editing previously saved draft files
@@ -195,6 +201,9 @@ static void reset_tilde(struct ConfigSet *cs)
 void mutt_exit(int code)
 {
   mutt_endwin();
+#ifdef USE_HCACHE
+  mutt_hcache_close_all();
+#endif
   exit(code);
 }
 
@@ -220,6 +229,7 @@ static void usage(void)
          "  neomutt [-n] [-e <command>] [-F <config>] -d <level> -l <file>\n"
          "  neomutt [-n] [-e <command>] [-F <config>] -G\n"
          "  neomutt [-n] [-e <command>] [-F <config>] -g <server>\n"
+         "  neomutt [-n] [-e <command>] [-F <config>] -P <script>\n"
          "  neomutt [-n] [-e <command>] [-F <config>] -p\n"
          "  neomutt [-n] [-e <command>] [-F <config>] -Q <variable>\n"
          "  neomutt [-n] [-e <command>] [-F <config>] -Z\n"
@@ -254,6 +264,8 @@ static void usage(void)
          "  -m <type>     Specify a default mailbox format type for newly created folders\n"
          "                The type is either MH, MMDF, Maildir or mbox (case-insensitive)\n"
          "  -n            Do not read the system-wide configuration file\n"
+         "  -P <script>   Run a script of mailbox operations without the UI and print\n"
+         "                how long each one took (\"-\" reads the script from stdin)\n"
          "  -p            Resume a prior postponed message, if any\n"
          "  -Q <variable> Query a configuration variable and print its value to stdout\n"
          "                (after the config has been read and any commands executed)\n"
@@ -404,6 +416,7 @@ int main(int argc, char *argv[], char *envp[])
   char *new_magic = NULL;
   char *dlevel = NULL;
   char *dfile = NULL;
+  char *bench_script = NULL;
 #ifdef USE_NNTP
   char *cli_nntp = NULL;
 #endif
@@ -472,7 +485,7 @@ int main(int argc, char *argv[], char *envp[])
     }
 
     /* USE_NNTP 'g:G' */
-    i = getopt(argc, argv, "+A:a:Bb:F:f:c:Dd:l:Ee:g:GH:i:hm:npQ:RSs:TvxyzZ");
+    i = getopt(argc, argv, "+A:a:Bb:F:f:c:Dd:l:Ee:g:GH:i:hm:nP:pQ:RSs:TvxyzZ");
     if (i != EOF)
     {
       switch (i)
@@ -534,6 +547,9 @@ int main(int argc, char *argv[], char *envp[])
         case 'n':
           flags |= MUTT_NOSYSRC;
           break;
+        case 'P':
+          bench_script = optarg;
+          break;
         case 'p':
           sendflags |= SEND_POSTPONED;
           break;
@@ -656,7 +672,7 @@ int main(int argc, char *argv[], char *envp[])
 
   /* Check for a batch send. */
   if (!isatty(0) || !STAILQ_EMPTY(&queries) || !STAILQ_EMPTY(&alias_queries) ||
-      dump_variables || batch_mode)
+      dump_variables || batch_mode || bench_script)
   {
     OptNoCurses = true;
     sendflags = SEND_BATCH;
@@ -780,6 +796,7 @@ int main(int argc, char *argv[], char *envp[])
     NORMAL_COLOR;
     clear();
     MuttLogger = log_disp_curses;
+    MuttLockWait = mutt_lock_wait;
     log_queue_flush(log_disp_curses);
     log_queue_set_max_size(100);
   }
@@ -821,6 +838,20 @@ int main(int argc, char *argv[], char *envp[])
   cs_add_listener(Config, mutt_log_listener);
   cs_add_listener(Config, mutt_menu_listener);
   cs_add_listener(Config, mutt_reply_listener);
+  cs_add_listener(Config, mutt_tags_listener);
+  cs_add_listener(Config, mutt_hdrshare_listener);
+
+  if (bench_script)
+  {
+    rc = mutt_bench_run(bench_script);
+#ifdef USE_IMAP
+    imap_logout_all();
+#endif
+#ifdef USE_SASL
+    mutt_sasl_done();
+#endif
+    goto main_curses;
+  }
 
   if (sendflags & SEND_POSTPONED)
   {
@@ -1237,8 +1268,16 @@ main_curses:
   if (repeat_error && ErrorBufMessage)
     puts(ErrorBuf);
 main_exit:
+  mutt_pool_shutdown();
+#ifdef USE_SMTP
+  mutt_smtp_logout();
+#endif
+#ifdef USE_HCACHE
+  mutt_hcache_close_all();
+#endif
   mutt_list_free(&queries);
   crypto_module_free();
+  mutt_autoview_cache_free();
   mutt_window_free();
   mutt_buffer_pool_free();
   mutt_envlist_free();
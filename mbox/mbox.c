@@ -29,12 +29,14 @@
  */
 
 #include "config.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -54,6 +56,13 @@
 #include "progress.h"
 #include "protos.h"
 #include "sort.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
+
+/* These Config Variables are only used in mbox/mbox.c */
+bool MboxHeaderCache; ///< Config: (hcache) Remember the messages of an mbox file between opens
+bool MboxMmap; ///< Config: Map mbox files into memory to read them
 
 /**
  * struct MUpdate - Store of new offsets, used by mutt_sync_mailbox()
@@ -67,6 +76,62 @@ struct MUpdate
   LOFF_T length;
 };
 
+/* Largest header block that mbox_sync_in_place() will read */
+#define MBOX_INPLACE_HEADER_MAX 65536
+
+/**
+ * struct MboxPatch - A status header to be overwritten in place
+ */
+struct MboxPatch
+{
+  LOFF_T offset;   /**< Offset of the header line */
+  size_t len;      /**< Length of the line, without the newline */
+  const char *tag; /**< "Status:" or "X-Status:" */
+  char value[4];   /**< New value of the header */
+};
+
+#ifdef USE_HCACHE
+/* Identifies the index record, see mbox_index_load() */
+#define MBOX_INDEX_MAGIC 0x4d627849 /* "MbxI" */
+#define MBOX_INDEX_KEY "/index"
+/* Bytes at the start, and at the end, of the indexed part that are checked */
+#define MBOX_INDEX_WINDOW 4096
+
+/**
+ * struct MboxIndex - What the header cache knows about an mbox file
+ *
+ * The messages themselves are stored under their index number.
+ */
+struct MboxIndex
+{
+  unsigned int magic;     ///< #MBOX_INDEX_MAGIC
+  int count;              ///< Number of messages indexed
+  LOFF_T size;            ///< Length of the file that was indexed
+  ino_t inode;            ///< Inode of the file
+  unsigned char head[16]; ///< MD5 of the start of the file
+  unsigned char tail[16]; ///< MD5 of the end of the indexed part
+};
+
+/* Identifies the summary record, see mbox_summary_check() */
+#define MBOX_SUMMARY_MAGIC 0x4d627853 /* "MbxS" */
+#define MBOX_SUMMARY_KEY "/summary"
+
+/**
+ * struct MboxSummary - Message counts of an mbox file, kept between checks
+ */
+struct MboxSummary
+{
+  unsigned int magic;     ///< #MBOX_SUMMARY_MAGIC
+  int count;              ///< Number of messages
+  int unread;             ///< Number of unread messages
+  int flagged;            ///< Number of flagged messages
+  LOFF_T size;            ///< Length of the file that was scanned
+  ino_t inode;            ///< Inode of the file
+  struct timespec mtime;  ///< Modification time of the file
+  unsigned char tail[16]; ///< MD5 of the end of the scanned part
+};
+#endif
+
 /**
  * struct MboxMboxData - Private data attached to an email
  */
@@ -74,9 +139,13 @@ struct MboxMboxData
 {
   FILE *fp;              /**< Mailbox file */
   struct timespec atime; /**< File's last-access time */
+  const char *map;       /**< File mapped into memory while it's parsed */
+  size_t maplen;         /**< Length of the mapping */
+  LOFF_T stream_size;    /**< Decompressed size, if `stream` is set */
 
   bool locked : 1; /**< is the mailbox locked? */
   bool append : 1; /**< mailbox is opened in append mode */
+  bool stream : 1; /**< fp decompresses the file at path */
 };
 
 /**
@@ -110,7 +179,7 @@ static void free_mboxdata(void **data)
  */
 static int init_mailbox(struct Mailbox *mailbox)
 {
-  if (!mailbox || (mailbox->magic != MUTT_MBOX))
+  if (!mailbox || ((mailbox->magic != MUTT_MBOX) && (mailbox->magic != MUTT_MMDF)))
     return -1;
 
   if (mailbox->data)
@@ -131,7 +200,7 @@ static int init_mailbox(struct Mailbox *mailbox)
  */
 struct MboxMboxData *mbox_get_mdata(struct Mailbox *m)
 {
-  if (!m || (m->magic != MUTT_MBOX))
+  if (!m || ((m->magic != MUTT_MBOX) && (m->magic != MUTT_MMDF)))
     return NULL;
   return m->data;
 }
@@ -181,6 +250,40 @@ static void mbox_unlock_mailbox(struct Mailbox *mailbox)
   }
 }
 
+/**
+ * mbox_map_skip - Find the next separator line in a mapped mailbox
+ * @param[in]  mdata Mailbox data
+ * @param[in]  pos   Offset of the start of a line
+ * @param[in]  sep   Text that starts a separator line
+ * @param[out] lines Incremented for each line skipped
+ * @retval num Offset of the next line that starts with sep
+ *
+ * Only whole lines inside the mapping are skipped.  If no separator is found,
+ * the result is the start of the last, incomplete, line of the mapping, so
+ * that the caller can carry on with stdio.  Without a mapping, pos is returned.
+ */
+static LOFF_T mbox_map_skip(struct MboxMboxData *mdata, LOFF_T pos,
+                            const char *sep, int *lines)
+{
+  if (!mdata->map || (pos < 0) || ((size_t) pos >= mdata->maplen))
+    return pos;
+
+  const size_t seplen = strlen(sep);
+  const char *p = mdata->map + pos;
+  const char *end = mdata->map + mdata->maplen;
+
+  while (((size_t)(end - p) < seplen) || (memcmp(p, sep, seplen) != 0))
+  {
+    const char *nl = memchr(p, '\n', end - p);
+    if (!nl)
+      break;
+    p = nl + 1;
+    (*lines)++;
+  }
+
+  return p - mdata->map;
+}
+
 /**
  * mmdf_parse_mailbox - Read a mailbox in MMDF format
  * @param ctx Mailbox
@@ -209,6 +312,8 @@ static int mmdf_parse_mailbox(struct Context *ctx)
     mutt_perror(ctx->mailbox->path);
     return -1;
   }
+  if (mdata->stream)
+    sb.st_size = mdata->stream_size;
   mutt_get_stat_timespec(&mdata->atime, &sb, MUTT_STAT_ATIME);
   mutt_get_stat_timespec(&ctx->mailbox->mtime, &sb, MUTT_STAT_MTIME);
   ctx->mailbox->size = sb.st_size;
@@ -299,6 +404,9 @@ static int mmdf_parse_mailbox(struct Context *ctx)
       if (e->content->length < 0)
       {
         lines = -1;
+        loc = mbox_map_skip(mdata, loc, MMDF_SEP, &lines);
+        if (fseeko(mdata->fp, loc, SEEK_SET) != 0)
+          mutt_debug(1, "#3 fseek() failed\n");
         do
         {
           loc = ftello(mdata->fp);
@@ -341,6 +449,227 @@ static int mmdf_parse_mailbox(struct Context *ctx)
   return 0;
 }
 
+#ifdef USE_HCACHE
+/**
+ * mbox_index_digest - Checksum part of an mbox file
+ * @param[in]  fp     Mailbox file
+ * @param[in]  size   Length of the part of the file to consider
+ * @param[in]  tail   If true, checksum the end of that part, otherwise its start
+ * @param[out] digest MD5 of up to #MBOX_INDEX_WINDOW bytes
+ * @retval true Success
+ */
+static bool mbox_index_digest(FILE *fp, LOFF_T size, bool tail, unsigned char *digest)
+{
+  char buf[MBOX_INDEX_WINDOW];
+  const size_t len = MIN(size, (LOFF_T) sizeof(buf));
+
+  if ((fseeko(fp, tail ? (size - len) : 0, SEEK_SET) != 0) ||
+      (fread(buf, 1, len, fp) != len))
+  {
+    return false;
+  }
+
+  mutt_md5_bytes(buf, len, digest);
+  return true;
+}
+
+/**
+ * mbox_index_load - Read and check the index of an mbox file
+ * @param[in]  hc  Header cache handle
+ * @param[in]  fp  Mailbox file
+ * @param[in]  sb  Current state of the file
+ * @param[out] idx Index of the file
+ * @retval true The indexed messages are still where they were
+ *
+ * The file may have grown, but the part that was indexed must look unchanged:
+ * same inode, same first and last bytes, and a message must start right after
+ * it.  A program that rewrites messages in the middle of the file, without
+ * changing its length, isn't noticed.
+ */
+static bool mbox_index_load(header_cache_t *hc, FILE *fp, const struct stat *sb,
+                            struct MboxIndex *idx)
+{
+  char buf[8];
+  unsigned char digest[16];
+
+  void *data = mutt_hcache_fetch_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+  if (!data)
+    return false;
+  memcpy(idx, data, sizeof(*idx));
+  mutt_hcache_free(hc, &data);
+
+  if ((idx->magic != MBOX_INDEX_MAGIC) || (idx->count <= 0) ||
+      (idx->inode != sb->st_ino) || (idx->size > sb->st_size))
+  {
+    return false;
+  }
+
+  if (!mbox_index_digest(fp, idx->size, false, digest) ||
+      (memcmp(digest, idx->head, sizeof(digest)) != 0) ||
+      !mbox_index_digest(fp, idx->size, true, digest) ||
+      (memcmp(digest, idx->tail, sizeof(digest)) != 0))
+  {
+    return false;
+  }
+
+  if (idx->size < sb->st_size)
+  {
+    if ((fseeko(fp, idx->size, SEEK_SET) != 0) || !fgets(buf, sizeof(buf), fp) ||
+        (mutt_str_strncmp("From ", buf, 5) != 0))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * mbox_index_restore - Add the indexed messages to the Mailbox
+ * @param ctx Mailbox
+ * @param hc  Header cache handle
+ * @param idx Index of the file
+ * @retval true All the messages were found in the header cache
+ */
+static bool mbox_index_restore(struct Context *ctx, header_cache_t *hc,
+                               const struct MboxIndex *idx)
+{
+  char key[16];
+
+  for (int i = 0; i < idx->count; i++)
+  {
+    snprintf(key, sizeof(key), "%d", i);
+    void *data = mutt_hcache_fetch(hc, key, strlen(key));
+    if (!data)
+    {
+      mutt_debug(1, "message %d is missing from the index\n", i);
+      for (int j = 0; j < ctx->mailbox->msg_count; j++)
+        mutt_email_free(&ctx->mailbox->hdrs[j]);
+      ctx->mailbox->msg_count = 0;
+      return false;
+    }
+
+    if (ctx->mailbox->msg_count == ctx->mailbox->hdrmax)
+      mx_alloc_memory(ctx->mailbox);
+
+    struct Email *e = mutt_hcache_restore(data);
+    mutt_hcache_free(hc, &data);
+    e->index = ctx->mailbox->msg_count;
+    ctx->mailbox->hdrs[ctx->mailbox->msg_count++] = e;
+  }
+
+  return true;
+}
+
+/**
+ * mbox_index_save - Add the new messages to the index of an mbox file
+ * @param ctx   Mailbox
+ * @param hc    Header cache handle
+ * @param fp    Mailbox file
+ * @param first Index of the first message that isn't in the index yet
+ * @param size  Length of the file that has been read
+ * @param sb    State of the file
+ */
+static void mbox_index_save(struct Context *ctx, header_cache_t *hc, FILE *fp,
+                            int first, LOFF_T size, const struct stat *sb)
+{
+  struct MboxIndex idx = { 0 };
+  char key[16];
+
+  idx.magic = MBOX_INDEX_MAGIC;
+  idx.count = ctx->mailbox->msg_count;
+  idx.size = size;
+  idx.inode = sb->st_ino;
+
+  const LOFF_T pos = ftello(fp);
+  const bool ok = mbox_index_digest(fp, size, false, idx.head) &&
+                  mbox_index_digest(fp, size, true, idx.tail);
+  if ((pos < 0) || (fseeko(fp, pos, SEEK_SET) != 0) || !ok)
+    return;
+
+  mutt_hcache_begin(hc);
+  for (int i = first; i < ctx->mailbox->msg_count; i++)
+  {
+    struct Email *e = ctx->mailbox->hdrs[i];
+    snprintf(key, sizeof(key), "%d", e->index);
+    mutt_hcache_store(hc, key, strlen(key), e, 0);
+  }
+  mutt_hcache_store_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY), &idx, sizeof(idx));
+  mutt_hcache_commit(hc);
+
+  mutt_debug(2, "%s: indexed %d messages, " OFF_T_FMT " bytes\n",
+             ctx->mailbox->path, idx.count, idx.size);
+}
+/**
+ * mbox_hcache_forget - Delete a record about an mbox file from the header cache
+ * @param path Path of the mailbox
+ * @param key  Record to delete, e.g. #MBOX_INDEX_KEY
+ */
+static void mbox_hcache_forget(const char *path, const char *key)
+{
+  if (!MboxHeaderCache)
+    return;
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, path, NULL);
+  if (!hc)
+    return;
+
+  mutt_hcache_delete(hc, key, strlen(key));
+  mutt_hcache_close(hc);
+}
+
+/**
+ * mbox_index_update - Save changed messages to the index of an mbox file
+ * @param ctx Mailbox
+ *
+ * After the headers of some messages have been changed in place, their cached
+ * copies and the checksums of the index are brought up to date.
+ */
+static void mbox_index_update(struct Context *ctx)
+{
+  struct MboxMboxData *mdata = mbox_get_mdata(ctx->mailbox);
+  struct MboxIndex idx;
+  char key[16];
+
+  if (!MboxHeaderCache || !mdata)
+    return;
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
+  if (!hc)
+    return;
+
+  void *data = mutt_hcache_fetch_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+  if (!data)
+    goto done;
+  memcpy(&idx, data, sizeof(idx));
+  mutt_hcache_free(hc, &data);
+  if (idx.magic != MBOX_INDEX_MAGIC)
+    goto done;
+
+  if (!mbox_index_digest(mdata->fp, idx.size, false, idx.head) ||
+      !mbox_index_digest(mdata->fp, idx.size, true, idx.tail))
+  {
+    mutt_hcache_delete(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY));
+    goto done;
+  }
+
+  mutt_hcache_begin(hc);
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    struct Email *e = ctx->mailbox->hdrs[i];
+    if (!e->changed || (e->index >= idx.count))
+      continue;
+    snprintf(key, sizeof(key), "%d", e->index);
+    mutt_hcache_store(hc, key, strlen(key), e, 0);
+  }
+  mutt_hcache_store_raw(hc, MBOX_INDEX_KEY, strlen(MBOX_INDEX_KEY), &idx, sizeof(idx));
+  mutt_hcache_commit(hc);
+
+done:
+  mutt_hcache_close(hc);
+}
+#endif
+
 /**
  * mbox_parse_mailbox - Read a mailbox from disk
  * @param ctx Mailbox
@@ -375,6 +704,8 @@ static int mbox_parse_mailbox(struct Context *ctx)
     return -1;
   }
 
+  if (mdata->stream)
+    sb.st_size = mdata->stream_size;
   ctx->mailbox->size = sb.st_size;
   mutt_get_stat_timespec(&ctx->mailbox->mtime, &sb, MUTT_STAT_MTIME);
   mutt_get_stat_timespec(&mdata->atime, &sb, MUTT_STAT_ATIME);
@@ -389,6 +720,42 @@ static int mbox_parse_mailbox(struct Context *ctx)
     mutt_progress_init(&progress, msgbuf, MUTT_PROGRESS_MSG, ReadInc, 0);
   }
 
+#ifdef USE_HCACHE
+  /* With $mbox_header_cache, only the part of the file past the indexed
+   * messages needs to be read.  first is the number of messages the index
+   * covers, or -1 if it can't be brought up to date. */
+  header_cache_t *hc = NULL;
+  int first = -1;
+  if (MboxHeaderCache)
+    hc = mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
+  if (hc)
+  {
+    struct MboxIndex idx;
+    LOFF_T resume = ftello(mdata->fp);
+    const bool valid = mbox_index_load(hc, mdata->fp, &sb, &idx);
+
+    if (ctx->mailbox->msg_count == 0)
+    {
+      first = 0;
+      if (valid && mbox_index_restore(ctx, hc, &idx))
+      {
+        mutt_debug(2, "%s: %d messages from the index\n", ctx->mailbox->path, idx.count);
+        first = idx.count;
+        resume = idx.size;
+        mx_update_context(ctx, first);
+      }
+    }
+    else if (valid && (idx.count == ctx->mailbox->msg_count) && (idx.size == resume))
+    {
+      /* new mail has been appended to the indexed messages */
+      first = idx.count;
+    }
+
+    if ((resume < 0) || (fseeko(mdata->fp, resume, SEEK_SET) != 0))
+      mutt_debug(1, "fseek() failed\n");
+  }
+#endif
+
   loc = ftello(mdata->fp);
   while ((fgets(buf, sizeof(buf), mdata->fp)) && (SigInt != 1))
   {
@@ -514,6 +881,13 @@ static int mbox_parse_mailbox(struct Context *ctx)
       lines++;
 
     loc = ftello(mdata->fp);
+    if (mdata->map)
+    {
+      /* jump to the next line that might start a message */
+      loc = mbox_map_skip(mdata, loc, "From ", &lines);
+      if (fseeko(mdata->fp, loc, SEEK_SET) != 0)
+        mutt_debug(1, "#4 fseek() failed\n");
+    }
   }
 
   /* Only set the content-length of the previous message if we have read more
@@ -537,6 +911,15 @@ static int mbox_parse_mailbox(struct Context *ctx)
     mx_update_context(ctx, count);
   }
 
+#ifdef USE_HCACHE
+  if (hc)
+  {
+    if ((SigInt != 1) && (first >= 0) && (count > 0))
+      mbox_index_save(ctx, hc, mdata->fp, first, ftello(mdata->fp), &sb);
+    mutt_hcache_close(hc);
+  }
+#endif
+
   if (SigInt == 1)
   {
     SigInt = 0;
@@ -546,6 +929,57 @@ static int mbox_parse_mailbox(struct Context *ctx)
   return 0;
 }
 
+/**
+ * mbox_parse - Read the messages of an mbox or MMDF mailbox
+ * @param ctx Mailbox
+ * @retval  0 Success
+ * @retval -1 Failure
+ * @retval -2 Aborted
+ *
+ * If $$mbox_mmap is set, the file is mapped into memory, so that the bodies of
+ * the messages can be skipped without reading them line by line.  The headers
+ * are still parsed from the stream.
+ */
+static int mbox_parse(struct Context *ctx)
+{
+  struct MboxMboxData *mdata = mbox_get_mdata(ctx->mailbox);
+  if (!mdata)
+    return -1;
+
+  struct stat sb;
+  if (MboxMmap && (fstat(fileno(mdata->fp), &sb) == 0) && (sb.st_size > 0))
+  {
+    void *map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fileno(mdata->fp), 0);
+    if (map != MAP_FAILED)
+    {
+#ifdef POSIX_MADV_SEQUENTIAL
+      posix_madvise(map, sb.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+      mdata->map = map;
+      mdata->maplen = sb.st_size;
+    }
+    else
+      mutt_debug(1, "%s: mmap() failed: %s\n", ctx->mailbox->path, strerror(errno));
+  }
+
+  int rc;
+  if (ctx->mailbox->magic == MUTT_MBOX)
+    rc = mbox_parse_mailbox(ctx);
+  else if (ctx->mailbox->magic == MUTT_MMDF)
+    rc = mmdf_parse_mailbox(ctx);
+  else
+    rc = -1;
+
+  if (mdata->map)
+  {
+    munmap((void *) mdata->map, mdata->maplen);
+    mdata->map = NULL;
+    mdata->maplen = 0;
+  }
+
+  return rc;
+}
+
 /**
  * reopen_mailbox - Close and reopen a mailbox
  * @param ctx        Mailbox
@@ -631,8 +1065,7 @@ static int reopen_mailbox(struct Context *ctx, int *index_hint)
       if (!mdata->fp)
         rc = -1;
       else
-        rc = ((ctx->mailbox->magic == MUTT_MBOX) ? mbox_parse_mailbox :
-                                                   mmdf_parse_mailbox)(ctx);
+        rc = mbox_parse(ctx);
       break;
 
     default:
@@ -852,6 +1285,163 @@ bool mbox_test_new_folder(const char *path)
   return rc;
 }
 
+#ifdef USE_HCACHE
+/**
+ * mbox_summary_scan - Count the messages in part of an mbox file
+ * @param fp   Mailbox file
+ * @param from Offset of the first message to count
+ * @param sum  Summary to add the counts to
+ * @retval  0 Success, sum->size is the end of the file
+ * @retval -1 Error
+ *
+ * Only the headers are parsed.  A valid Content-Length is used to skip the
+ * body of a message.
+ */
+static int mbox_summary_scan(FILE *fp, LOFF_T from, struct MboxSummary *sum)
+{
+  char buf[HUGE_STRING];
+  struct stat sb;
+
+  if ((fstat(fileno(fp), &sb) != 0) || (fseeko(fp, from, SEEK_SET) != 0))
+    return -1;
+
+  while (fgets(buf, sizeof(buf), fp))
+  {
+    if (!is_from(buf, NULL, 0, NULL))
+      continue;
+
+    struct Email *e = mutt_email_new();
+    e->env = mutt_rfc822_read_header(fp, e, false, false);
+
+    sum->count++;
+    if (!e->read)
+      sum->unread++;
+    if (e->flagged)
+      sum->flagged++;
+
+    const LOFF_T loc = ftello(fp);
+    if ((loc >= 0) && (e->content->length > 0) &&
+        (e->content->length < sb.st_size - loc))
+    {
+      /* skip the body if the next message is where it should be */
+      const LOFF_T next = loc + e->content->length + 1;
+      if ((fseeko(fp, next, SEEK_SET) != 0) || !fgets(buf, sizeof(buf), fp) ||
+          (mutt_str_strncmp("From ", buf, 5) != 0) || (fseeko(fp, next, SEEK_SET) != 0))
+      {
+        if (fseeko(fp, loc, SEEK_SET) != 0)
+          mutt_debug(1, "fseek() failed\n");
+      }
+    }
+
+    mutt_email_free(&e);
+  }
+
+  if (ferror(fp))
+    return -1;
+
+  sum->size = ftello(fp);
+  return (sum->size < 0) ? -1 : 0;
+}
+
+/**
+ * mbox_summary_check - Count the messages in an mbox file
+ * @param mailbox Mailbox
+ * @param sb      stat(2) information about the mailbox
+ * @retval  0 Success, the counts of the Mailbox have been set
+ * @retval -1 The counts aren't available this way
+ *
+ * With $$mbox_header_cache, the counts are saved in the header cache along
+ * with the inode, size, mtime and a checksum of the end of the file.  NeoMutt
+ * drops them when it rewrites the file, as it keeps the mtime.  If the
+ * file is unchanged, they are used as they are.  If mail has only been
+ * appended, just the new messages are read.  Otherwise, the headers of every
+ * message are read, which is still cheaper than opening the mailbox.
+ */
+int mbox_summary_check(struct Mailbox *mailbox, const struct stat *sb)
+{
+  struct MboxSummary sum;
+  struct timespec mtime;
+  unsigned char digest[16];
+  char buf[8];
+  int rc = -1;
+
+  if (!MboxHeaderCache || !mailbox || (mailbox->magic != MUTT_MBOX))
+    return -1;
+
+  header_cache_t *hc = mutt_hcache_open(HeaderCache, mailbox->path, NULL);
+  if (!hc)
+    return -1;
+
+  FILE *fp = fopen(mailbox->path, "r");
+  if (!fp)
+    goto done;
+
+  mutt_get_stat_timespec(&mtime, (struct stat *) sb, MUTT_STAT_MTIME);
+
+  LOFF_T from = 0;
+  memset(&sum, 0, sizeof(sum));
+  void *data = mutt_hcache_fetch_raw(hc, MBOX_SUMMARY_KEY, strlen(MBOX_SUMMARY_KEY));
+  if (data)
+  {
+    memcpy(&sum, data, sizeof(sum));
+    mutt_hcache_free(hc, &data);
+  }
+
+  if ((sum.magic != MBOX_SUMMARY_MAGIC) || (sum.inode != sb->st_ino) ||
+      (sum.size > sb->st_size))
+  {
+    from = -1;
+  }
+  else if ((sum.size == sb->st_size) &&
+           (mutt_timespec_compare(&sum.mtime, &mtime) == 0))
+  {
+    /* nothing has changed */
+    rc = 0;
+  }
+  else if ((sum.size < sb->st_size) &&
+           mbox_index_digest(fp, sum.size, true, digest) &&
+           (memcmp(digest, sum.tail, sizeof(digest)) == 0) &&
+           (fseeko(fp, sum.size, SEEK_SET) == 0) && fgets(buf, sizeof(buf), fp) &&
+           (mutt_str_strncmp("From ", buf, 5) == 0))
+  {
+    /* new mail has been appended */
+    from = sum.size;
+  }
+  else
+    from = -1;
+
+  if (rc != 0)
+  {
+    if (from < 0)
+    {
+      memset(&sum, 0, sizeof(sum));
+      sum.magic = MBOX_SUMMARY_MAGIC;
+      sum.inode = sb->st_ino;
+      from = 0;
+    }
+
+    mutt_debug(2, "%s: counting from " OFF_T_FMT "\n", mailbox->path, from);
+    if ((mbox_summary_scan(fp, from, &sum) != 0) ||
+        !mbox_index_digest(fp, sum.size, true, sum.tail))
+    {
+      goto done;
+    }
+    sum.mtime = mtime;
+    mutt_hcache_store_raw(hc, MBOX_SUMMARY_KEY, strlen(MBOX_SUMMARY_KEY), &sum, sizeof(sum));
+    rc = 0;
+  }
+
+  mailbox->msg_count = sum.count;
+  mailbox->msg_unread = sum.unread;
+  mailbox->msg_flagged = sum.flagged;
+
+done:
+  mutt_file_fclose(&fp);
+  mutt_hcache_close(hc);
+  return rc;
+}
+#endif
+
 /**
  * mbox_reset_atime - Reset the access time on the mailbox file
  * @param mailbox Mailbox
@@ -913,13 +1503,7 @@ static int mbox_mbox_open(struct Context *ctx)
     return -1;
   }
 
-  int rc;
-  if (mailbox->magic == MUTT_MBOX)
-    rc = mbox_parse_mailbox(ctx);
-  else if (mailbox->magic == MUTT_MMDF)
-    rc = mmdf_parse_mailbox(ctx);
-  else
-    rc = -1;
+  int rc = mbox_parse(ctx);
   mutt_file_touch_atime(fileno(mdata->fp));
 
   mbox_unlock_mailbox(mailbox);
@@ -927,6 +1511,42 @@ static int mbox_mbox_open(struct Context *ctx)
   return rc;
 }
 
+/**
+ * mbox_open_stream - Read a mailbox from a stream
+ * @param ctx Mailbox, whose magic is already set
+ * @param fp  Stream of the mailbox's contents, which must be seekable
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * The mailbox takes ownership of fp.  Its path still names the file that fp
+ * is decoded from, which is stat()ed as usual, but its size is that of the
+ * stream.  The file isn't locked: it will only be read.
+ */
+int mbox_open_stream(struct Context *ctx, FILE *fp)
+{
+  struct Mailbox *mailbox = ctx->mailbox;
+
+  if (init_mailbox(mailbox) != 0)
+  {
+    mutt_file_fclose(&fp);
+    return -1;
+  }
+
+  struct MboxMboxData *mdata = mbox_get_mdata(mailbox);
+  mdata->fp = fp;
+  mdata->stream = true;
+
+  if (fseeko(fp, 0, SEEK_END) != 0)
+  {
+    mutt_perror(mailbox->path);
+    return -1;
+  }
+  mdata->stream_size = ftello(fp);
+  fseeko(fp, 0, SEEK_SET);
+
+  return mbox_parse(ctx);
+}
+
 /**
  * mbox_mbox_open_append - Implements MxOps::mbox_open_append()
  */
@@ -1028,10 +1648,7 @@ static int mbox_mbox_check(struct Context *ctx, int *index_hint)
         {
           if (fseeko(mdata->fp, ctx->mailbox->size, SEEK_SET) != 0)
             mutt_debug(1, "#2 fseek() failed\n");
-          if (ctx->mailbox->magic == MUTT_MBOX)
-            mbox_parse_mailbox(ctx);
-          else
-            mmdf_parse_mailbox(ctx);
+          mbox_parse(ctx);
 
           /* Only unlock the folder if it was locked inside of this routine.
            * It may have been locked elsewhere, like in
@@ -1081,6 +1698,189 @@ static int mbox_mbox_check(struct Context *ctx, int *index_hint)
   return -1;
 }
 
+/**
+ * mbox_status_values - Get the status headers that describe an Email
+ * @param[in]  e       Email
+ * @param[out] status  Value of the Status header, may be empty
+ * @param[out] xstatus Value of the X-Status header, may be empty
+ *
+ * These match the headers written by mutt_copy_header() with #CH_UPDATE.
+ */
+static void mbox_status_values(const struct Email *e, char *status, char *xstatus)
+{
+  strcpy(status, e->read ? "RO" : e->old ? "O" : "");
+  strcpy(xstatus, "");
+  if (e->replied)
+    strcat(xstatus, "A");
+  if (e->flagged)
+    strcat(xstatus, "F");
+}
+
+/**
+ * mbox_plan_patch - Work out how to update an Email's status headers in place
+ * @param ctx     Mailbox
+ * @param e       Email
+ * @param patches Array of patches to add to
+ * @param num     Number of patches in the array
+ * @param max     Size of the array
+ * @retval true The headers can be updated in place
+ *
+ * The headers are read from the file and each Status or X-Status line is
+ * reused for the new value, padded with spaces.  If a header would need to
+ * grow, or be added, the message has to be rewritten.
+ */
+static bool mbox_plan_patch(struct Context *ctx, struct Email *e,
+                            struct MboxPatch **patches, int *num, int *max)
+{
+  struct MboxMboxData *mdata = mbox_get_mdata(ctx->mailbox);
+  const char *tags[2] = { "Status:", "X-Status:" };
+  char values[2][4];
+  LOFF_T found[2] = { -1, -1 };
+  size_t lens[2] = { 0, 0 };
+  bool rc = false;
+
+  mbox_status_values(e, values[0], values[1]);
+
+  LOFF_T start = e->offset;
+  if (ctx->mailbox->magic == MUTT_MMDF)
+    start -= (sizeof(MMDF_SEP) - 1);
+  const LOFF_T len = e->content->offset - start;
+  if ((start < 0) || (len <= 0) || (len > MBOX_INPLACE_HEADER_MAX))
+    return false;
+
+  char *buf = mutt_mem_malloc(len + 1);
+  if ((fseeko(mdata->fp, start, SEEK_SET) != 0) || (fread(buf, 1, len, mdata->fp) != len))
+    goto done;
+  buf[len] = '\0';
+
+  /* make sure the message is where we expect it */
+  if (((ctx->mailbox->magic == MUTT_MBOX) && (mutt_str_strncmp("From ", buf, 5) != 0)) ||
+      ((ctx->mailbox->magic == MUTT_MMDF) &&
+       (mutt_str_strncmp(MMDF_SEP, buf, sizeof(MMDF_SEP) - 1) != 0)))
+  {
+    mutt_debug(1, "message %d not in expected position\n", e->index);
+    goto done;
+  }
+
+  for (char *line = buf; *line;)
+  {
+    char *nl = strchr(line, '\n');
+    const size_t linelen = nl ? (size_t)(nl - line) : strlen(line);
+
+    for (int i = 0; i < 2; i++)
+    {
+      if (mutt_str_strncasecmp(line, tags[i], strlen(tags[i])) != 0)
+        continue;
+      if (found[i] >= 0)
+        goto done; /* a duplicate would have to be removed */
+      found[i] = start + (line - buf);
+      lens[i] = linelen;
+    }
+
+    if (!nl)
+      break;
+    line = nl + 1;
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    const size_t need = strlen(tags[i]) + (values[i][0] ? strlen(values[i]) + 1 : 0);
+    if (found[i] < 0)
+    {
+      /* no header needed, none present */
+      if (!values[i][0])
+        continue;
+      goto done;
+    }
+    if (lens[i] < need)
+      goto done;
+
+    if (*num == *max)
+    {
+      *max += 64;
+      mutt_mem_realloc(patches, *max * sizeof(struct MboxPatch));
+    }
+    struct MboxPatch *mp = &(*patches)[(*num)++];
+    mp->offset = found[i];
+    mp->len = lens[i];
+    mp->tag = tags[i];
+    mutt_str_strfcpy(mp->value, values[i], sizeof(mp->value));
+  }
+
+  rc = true;
+
+done:
+  FREE(&buf);
+  return rc;
+}
+
+/**
+ * mbox_sync_in_place - Save flag changes without rewriting the mailbox
+ * @param ctx Mailbox
+ * @retval  0 Success, all the changes have been saved
+ * @retval -1 The mailbox has to be rewritten
+ *
+ * If the only changes are to the flags of some messages, and their Status and
+ * X-Status headers have room for the new values, then those header lines are
+ * overwritten and nothing moves.  The mailbox must be locked and opened for
+ * writing.
+ */
+static int mbox_sync_in_place(struct Context *ctx)
+{
+  struct MboxMboxData *mdata = mbox_get_mdata(ctx->mailbox);
+  struct MboxPatch *patches = NULL;
+  int num = 0, max = 0;
+  int rc = -1;
+  struct stat sb;
+
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    struct Email *e = ctx->mailbox->hdrs[i];
+    if (e->deleted || e->attach_del || e->xlabel_changed ||
+        (e->changed && (e->env->irt_changed || e->env->refs_changed)))
+    {
+      goto done;
+    }
+    if (e->changed && !mbox_plan_patch(ctx, e, &patches, &num, &max))
+      goto done;
+  }
+
+  if (stat(ctx->mailbox->path, &sb) == -1)
+    goto done;
+
+  for (int i = 0; i < num; i++)
+  {
+    struct MboxPatch *mp = &patches[i];
+    if (fseeko(mdata->fp, mp->offset, SEEK_SET) != 0)
+      goto done;
+
+    size_t n = fprintf(mdata->fp, "%s%s%s", mp->tag, mp->value[0] ? " " : "", mp->value);
+    for (; n < mp->len; n++)
+      fputc(' ', mdata->fp);
+  }
+
+  if ((fflush(mdata->fp) != 0) || ferror(mdata->fp))
+  {
+    mutt_perror(ctx->mailbox->path);
+    goto done;
+  }
+
+  mutt_debug(2, "%s: updated %d status headers in place\n", ctx->mailbox->path, num);
+
+#ifdef USE_HCACHE
+  mbox_index_update(ctx);
+  /* the size and mtime are kept, so the counts must be thrown away */
+  mbox_hcache_forget(ctx->mailbox->path, MBOX_SUMMARY_KEY);
+#endif
+
+  mbox_reset_atime(ctx->mailbox, &sb);
+  rc = 0;
+
+done:
+  FREE(&patches);
+  return rc;
+}
+
 /**
  * mbox_mbox_sync - Implements MxOps::mbox_sync()
  */
@@ -1149,6 +1949,21 @@ static int mbox_mbox_sync(struct Context *ctx, int *index_hint)
     return -1;
   }
 
+  /* If only flags have changed, there may be no need to move anything */
+  if (mbox_sync_in_place(ctx) == 0)
+  {
+    mbox_unlock_mailbox(ctx->mailbox);
+    mutt_sig_unblock();
+    mdata->fp = freopen(ctx->mailbox->path, "r", mdata->fp);
+    if (!mdata->fp)
+    {
+      mx_fastclose_mailbox(ctx);
+      mutt_error(_("Fatal error!  Could not reopen mailbox!"));
+      return -1;
+    }
+    return 0;
+  }
+
   /* Create a temporary file to write the new version of the mailbox in. */
   mutt_mktemp(tempfile, sizeof(tempfile));
   i = open(tempfile, O_WRONLY | O_EXCL | O_CREAT, 0600);
@@ -1329,6 +2144,11 @@ static int mbox_mbox_sync(struct Context *ctx, int *index_hint)
     }
     else
     {
+#ifdef USE_HCACHE
+      /* the messages are about to move */
+      mbox_hcache_forget(ctx->mailbox->path, MBOX_INDEX_KEY);
+      mbox_hcache_forget(ctx->mailbox->path, MBOX_SUMMARY_KEY);
+#endif
       /* copy the temp mailbox back into place starting at the first
        * change/deleted message
        */
@@ -1499,6 +2319,24 @@ static int mbox_mbox_close(struct Context *ctx)
   return 0;
 }
 
+/**
+ * mbox_mbox_flush - Implements MxOps::mbox_flush()
+ */
+static int mbox_mbox_flush(struct Context *ctx)
+{
+  struct MboxMboxData *mdata = mbox_get_mdata(ctx->mailbox);
+  if (!mdata || !mdata->fp)
+    return -1;
+
+  if ((fflush(mdata->fp) == EOF) || (fsync(fileno(mdata->fp)) == -1))
+  {
+    mutt_perror(_("Can't write message"));
+    return -1;
+  }
+
+  return 0;
+}
+
 /**
  * mbox_msg_open - Implements MxOps::msg_open()
  */
@@ -1535,7 +2373,8 @@ static int mbox_msg_commit(struct Context *ctx, struct Message *msg)
   if (fputc('\n', msg->fp) == EOF)
     return -1;
 
-  if ((fflush(msg->fp) == EOF) || (fsync(fileno(msg->fp)) == -1))
+  /* In bulk mode, mbox_mbox_flush() syncs all the messages at once */
+  if ((fflush(msg->fp) == EOF) || (!ctx->bulk && (fsync(fileno(msg->fp)) == -1)))
   {
     mutt_perror(_("Can't write message"));
     return -1;
@@ -1692,7 +2531,7 @@ static int mmdf_msg_commit(struct Context *ctx, struct Message *msg)
   if (fputs(MMDF_SEP, msg->fp) == EOF)
     return -1;
 
-  if ((fflush(msg->fp) == EOF) || (fsync(fileno(msg->fp)) == -1))
+  if ((fflush(msg->fp) == EOF) || (!ctx->bulk && (fsync(fileno(msg->fp)) == -1)))
   {
     mutt_perror(_("Can't write message"));
     return -1;
@@ -1723,11 +2562,14 @@ struct MxOps mx_mbox_ops = {
   .mbox_check       = mbox_mbox_check,
   .mbox_sync        = mbox_mbox_sync,
   .mbox_close       = mbox_mbox_close,
+  .mbox_flush       = mbox_mbox_flush,
   .msg_open         = mbox_msg_open,
   .msg_open_new     = mbox_msg_open_new,
   .msg_commit       = mbox_msg_commit,
   .msg_close        = mbox_msg_close,
   .msg_padding_size = mbox_msg_padding_size,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = mbox_path_probe,
@@ -1747,11 +2589,14 @@ struct MxOps mx_mmdf_ops = {
   .mbox_check       = mbox_mbox_check,
   .mbox_sync        = mbox_mbox_sync,
   .mbox_close       = mbox_mbox_close,
+  .mbox_flush       = mbox_mbox_flush,
   .msg_open         = mbox_msg_open,
   .msg_open_new     = mbox_msg_open_new,
   .msg_commit       = mmdf_msg_commit,
   .msg_close        = mbox_msg_close,
   .msg_padding_size = mmdf_msg_padding_size,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = mbox_path_probe,
@@ -34,17 +34,27 @@
 #define MUTT_MBOX_MBOX_H
 
 #include <stdbool.h>
+#include <stdio.h>
 
+struct Context;
 struct Mailbox;
 struct stat;
 
 extern struct MxOps mx_mbox_ops;
 extern struct MxOps mx_mmdf_ops;
 
+/* These Config Variables are only used in mbox/mbox.c */
+extern bool MboxHeaderCache;
+extern bool MboxMmap;
+
 #define MMDF_SEP "\001\001\001\001\n"
 
 void mbox_reset_atime(struct Mailbox *mailbox, struct stat *st);
 int mbox_path_probe(const char *path, const struct stat *st);
 bool mbox_test_new_folder(const char *path);
+int  mbox_open_stream(struct Context *ctx, FILE *fp);
+#ifdef USE_HCACHE
+int  mbox_summary_check(struct Mailbox *mailbox, const struct stat *sb);
+#endif
 
 #endif /* MUTT_MBOX_MBOX_H */
@@ -344,6 +344,32 @@ static void menu_pad_string(struct Menu *menu, char *buf, size_t buflen)
   FREE(&scratch);
 }
 
+/**
+ * menu_row_colors - Hash the colours of a row of the index
+ * @param menu Current Menu
+ * @param i    Entry of the Menu
+ * @param s    String of embedded colour codes
+ * @retval num Hash of the colours
+ *
+ * The `color index_*` patterns may depend on the state of the email, so they
+ * are part of what's drawn on the row, as well as the text.
+ */
+static int menu_row_colors(struct Menu *menu, int i, const char *s)
+{
+  int colors = (i == menu->current) ? 1 : 0;
+
+  for (; *s; s++)
+  {
+    if ((*s == MUTT_SPECIAL_INDEX) && s[1])
+    {
+      s++;
+      if (*s != MT_COLOR_INDEX)
+        colors = (colors * 33) + get_color(i, (unsigned char *) s);
+    }
+  }
+  return colors;
+}
+
 /**
  * menu_redraw_full - Force the redraw of the Menu
  * @param menu Current Menu
@@ -411,9 +437,13 @@ void menu_redraw_index(struct Menu *menu)
   char buf[LONG_STRING];
   bool do_color;
   int attr;
+  /* only the index has rows that are worth comparing with the last frame */
+  const bool track = (menu->menu == MENU_MAIN) && (menu->indexwin == MuttIndexWindow) &&
+                     !menu->dialog && Context;
 
   for (int i = menu->top; i < menu->top + menu->pagelen; i++)
   {
+    const int row = i - menu->top + menu->offset;
     if (i < menu->max)
     {
       attr = menu->menu_color(i);
@@ -421,8 +451,14 @@ void menu_redraw_index(struct Menu *menu)
       menu_make_entry(buf, sizeof(buf), menu, i);
       menu_pad_string(menu, buf, sizeof(buf));
 
+      if (track && mutt_window_row_unchanged(menu->indexwin, row, buf, attr,
+                                             menu_row_colors(menu, i, buf)))
+      {
+        continue;
+      }
+
       ATTRSET(attr);
-      mutt_window_move(menu->indexwin, i - menu->top + menu->offset, 0);
+      mutt_window_move(menu->indexwin, row, 0);
       do_color = true;
 
       if (i == menu->current)
@@ -444,8 +480,10 @@ void menu_redraw_index(struct Menu *menu)
     }
     else
     {
+      if (track && mutt_window_row_unchanged(menu->indexwin, row, "", -1, 0))
+        continue;
       NORMAL_COLOR;
-      mutt_window_clearline(menu->indexwin, i - menu->top + menu->offset);
+      mutt_window_clearline(menu->indexwin, row);
     }
   }
   NORMAL_COLOR;
@@ -471,6 +509,8 @@ void menu_redraw_motion(struct Menu *menu)
    * generate status messages.  So we want to call it *before* we
    * position the cursor for drawing. */
   const int old_color = menu->menu_color(menu->oldcurrent);
+  mutt_window_row_damage(menu->indexwin, menu->oldcurrent + menu->offset - menu->top);
+  mutt_window_row_damage(menu->indexwin, menu->current + menu->offset - menu->top);
   mutt_window_move(menu->indexwin, menu->oldcurrent + menu->offset - menu->top, 0);
   ATTRSET(old_color);
 
@@ -519,6 +559,7 @@ void menu_redraw_current(struct Menu *menu)
   char buf[LONG_STRING];
   int attr = menu->menu_color(menu->current);
 
+  mutt_window_row_damage(menu->indexwin, menu->current + menu->offset - menu->top);
   mutt_window_move(menu->indexwin, menu->current + menu->offset - menu->top, 0);
   menu_make_entry(buf, sizeof(buf), menu, menu->current);
   menu_pad_string(menu, buf, sizeof(buf));
@@ -1275,18 +1316,24 @@ int menu_redraw(struct Menu *menu)
 {
   if (menu->menu_custom_redraw)
   {
+    mutt_trace_begin("menu_redraw", NULL);
     menu->menu_custom_redraw(menu);
+    mutt_trace_end("menu_redraw");
     return OP_NULL;
   }
 
   /* See if all or part of the screen needs to be updated.  */
   if (menu->redraw & REDRAW_FULL)
   {
+    mutt_trace_begin("menu_redraw", NULL);
     menu_redraw_full(menu);
+    mutt_trace_end("menu_redraw");
     /* allow the caller to do any local configuration */
     return OP_REDRAW;
   }
 
+  mutt_trace_begin("menu_redraw", NULL);
+
   if (!menu->dialog)
     menu_check_recenter(menu);
 
@@ -1306,6 +1353,7 @@ int menu_redraw(struct Menu *menu)
   if (menu->dialog)
     menu_redraw_prompt(menu);
 
+  mutt_trace_end("menu_redraw");
   return OP_NULL;
 }
 
@@ -1413,6 +1461,9 @@ int mutt_menu_loop(struct Menu *menu)
 
     if (i < 0)
     {
+      /* a timeout, let the menu do some work in the background */
+      if ((i == -2) && menu->menu_idle)
+        menu->menu_idle(menu);
       if (menu->tagprefix)
         mutt_window_clearline(menu->messagewin, 0);
       continue;
@@ -123,6 +123,11 @@ struct Menu
    * @param menu Menu to redraw
    */
   void (*menu_custom_redraw)(struct Menu *menu);
+  /**
+   * menu_idle - Do some work while waiting for a key
+   * @param menu Current Menu
+   */
+  void (*menu_idle)         (struct Menu *menu);
   void *redraw_data;
 };
 
@@ -42,16 +42,24 @@
 
 int MonitorFilesChanged = 0;
 int MonitorContextChanged = 0;
+int MonitorMailboxChanged = 0;
 
 static int INotifyFd = -1;
-static struct Monitor *Monitor = NULL;
+static struct Hash *MonitorDescs = NULL;  ///< Monitors by watch descriptor
+static struct Hash *MonitorFiles = NULL;  ///< Monitors by device and inode
+static size_t MonitorCount = 0;
 static size_t PollFdsCount = 0;
 static size_t PollFdsLen = 0;
 static struct pollfd *PollFds = NULL;
 
 static int MonitorContextDescriptor = -1;
+static int MonitorContextCurDescriptor = -1;
+static struct ListHead MonitorContextChanges = STAILQ_HEAD_INITIALIZER(MonitorContextChanges);
+static size_t MonitorContextChangesCount = 0;
+static bool MonitorContextTracked = false;
 
-#define INOTIFY_MASK_DIR (IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_ISDIR)
+#define INOTIFY_MASK_DIR                                                       \
+  (IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB | IN_CLOSE_WRITE | IN_ISDIR)
 #define INOTIFY_MASK_FILE IN_CLOSE_WRITE
 
 #define EVENT_BUFLEN MAX(4096, sizeof(struct inotify_event) + NAME_MAX + 1)
@@ -62,17 +70,21 @@ static int MonitorContextDescriptor = -1;
 #define RESOLVERES_OK_NOTEXISTING 0
 #define RESOLVERES_OK_EXISTING 1
 
+#define MONITOR_CHANGES_MAX 1000
+
+#define MONITOR_KEY_LEN 64
+
 /**
  * struct Monitor - A watch on a file
  */
 struct Monitor
 {
-  struct Monitor *next;
   char *mh_backup_path;
   dev_t st_dev;
   ino_t st_ino;
   short magic;
   int desc;
+  char key[MONITOR_KEY_LEN]; ///< Key in MonitorFiles, see monitor_key()
 };
 
 /**
@@ -161,15 +173,58 @@ static int monitor_init(void)
  */
 static void monitor_check_free(void)
 {
-  if (!Monitor && (INotifyFd != -1))
+  if ((MonitorCount == 0) && (INotifyFd != -1))
   {
+    mutt_hash_destroy(&MonitorDescs);
+    mutt_hash_destroy(&MonitorFiles);
     mutt_poll_fd_remove(INotifyFd);
     close(INotifyFd);
     INotifyFd = -1;
     MonitorFilesChanged = 0;
+    MonitorContextCurDescriptor = -1;
+    MonitorContextTracked = false;
   }
 }
 
+/**
+ * monitor_key - Create the lookup key for a file
+ * @param buf    Buffer for the key
+ * @param buflen Length of the buffer
+ * @param st_dev Device of the file
+ * @param st_ino Inode of the file
+ */
+static void monitor_key(char *buf, size_t buflen, dev_t st_dev, ino_t st_ino)
+{
+  snprintf(buf, buflen, "%llu:%llu", (unsigned long long) st_dev,
+           (unsigned long long) st_ino);
+}
+
+/**
+ * monitor_index - Add a monitor to the lookup tables
+ * @param monitor Monitor to add
+ */
+static void monitor_index(struct Monitor *monitor)
+{
+  if (!MonitorDescs)
+    MonitorDescs = mutt_hash_int_create(64, 0);
+  if (!MonitorFiles)
+    MonitorFiles = mutt_hash_create(64, 0);
+
+  monitor_key(monitor->key, sizeof(monitor->key), monitor->st_dev, monitor->st_ino);
+  mutt_hash_int_insert(MonitorDescs, monitor->desc, monitor);
+  mutt_hash_insert(MonitorFiles, monitor->key, monitor);
+}
+
+/**
+ * monitor_unindex - Remove a monitor from the lookup tables
+ * @param monitor Monitor to remove
+ */
+static void monitor_unindex(struct Monitor *monitor)
+{
+  mutt_hash_int_delete(MonitorDescs, monitor->desc, monitor);
+  mutt_hash_delete(MonitorFiles, monitor->key, monitor);
+}
+
 /**
  * monitor_create - Create a new file monitor
  * @param info       Details of file to monitor
@@ -183,11 +238,11 @@ static struct Monitor *monitor_create(struct MonitorInfo *info, int descriptor)
   monitor->st_dev = info->st_dev;
   monitor->st_ino = info->st_ino;
   monitor->desc = descriptor;
-  monitor->next = Monitor;
   if (info->magic == MUTT_MH)
     monitor->mh_backup_path = mutt_str_strdup(info->path);
 
-  Monitor = monitor;
+  monitor_index(monitor);
+  MonitorCount++;
 
   return monitor;
 }
@@ -198,24 +253,14 @@ static struct Monitor *monitor_create(struct MonitorInfo *info, int descriptor)
  */
 static void monitor_delete(struct Monitor *monitor)
 {
-  struct Monitor **ptr = &Monitor;
-
   if (!monitor)
     return;
 
-  while (true)
-  {
-    if (!*ptr)
-      return;
-    if (*ptr == monitor)
-      break;
-    ptr = &(*ptr)->next;
-  }
+  monitor_unindex(monitor);
+  MonitorCount--;
 
   FREE(&monitor->mh_backup_path);
-  monitor = monitor->next;
-  FREE(ptr);
-  *ptr = monitor;
+  FREE(&monitor);
 }
 
 /**
@@ -227,11 +272,11 @@ static void monitor_delete(struct Monitor *monitor)
 static int monitor_handle_ignore(int desc)
 {
   int new_desc = -1;
-  struct Monitor *iter = Monitor;
+  struct Monitor *iter = NULL;
   struct stat sb;
 
-  while (iter && (iter->desc != desc))
-    iter = iter->next;
+  if (MonitorDescs)
+    iter = mutt_hash_int_find(MonitorDescs, desc);
 
   if (iter)
   {
@@ -246,9 +291,11 @@ static int monitor_handle_ignore(int desc)
       else
       {
         mutt_debug(3, "inotify_add_watch descriptor=%d for '%s'\n", desc, iter->mh_backup_path);
+        monitor_unindex(iter);
         iter->st_dev = sb.st_dev;
         iter->st_ino = sb.st_ino;
         iter->desc = new_desc;
+        monitor_index(iter);
       }
     }
     else
@@ -257,7 +304,10 @@ static int monitor_handle_ignore(int desc)
     }
 
     if (MonitorContextDescriptor == desc)
+    {
       MonitorContextDescriptor = new_desc;
+      MonitorContextTracked = false;
+    }
 
     if (new_desc == -1)
     {
@@ -283,7 +333,7 @@ static int monitor_handle_ignore(int desc)
  */
 static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *mailbox)
 {
-  struct Monitor *iter;
+  struct Monitor *iter = NULL;
   char *fmt = NULL;
   struct stat sb;
 
@@ -326,9 +376,12 @@ static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *mailbox)
   if (stat(info->path, &sb) != 0)
     return RESOLVERES_FAIL_STAT;
 
-  iter = Monitor;
-  while (iter && ((iter->st_ino != sb.st_ino) || (iter->st_dev != sb.st_dev)))
-    iter = iter->next;
+  if (MonitorFiles)
+  {
+    char key[MONITOR_KEY_LEN];
+    monitor_key(key, sizeof(key), sb.st_dev, sb.st_ino);
+    iter = mutt_hash_find(MonitorFiles, key);
+  }
 
   info->st_dev = sb.st_dev;
   info->st_ino = sb.st_ino;
@@ -337,6 +390,134 @@ static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *mailbox)
   return iter ? RESOLVERES_OK_EXISTING : RESOLVERES_OK_NOTEXISTING;
 }
 
+/**
+ * monitor_context_forget - Discard the recorded changes to the open mailbox
+ */
+static void monitor_context_forget(void)
+{
+  mutt_list_free(&MonitorContextChanges);
+  MonitorContextChangesCount = 0;
+}
+
+/**
+ * monitor_context_record - Remember an entry of the open Maildir that changed
+ * @param event  inotify event
+ * @param subdir Maildir subdirectory the event refers to, "new" or "cur"
+ */
+static void monitor_context_record(const struct inotify_event *event, const char *subdir)
+{
+  if (!MonitorContextTracked)
+    return;
+
+  if (event->mask & IN_Q_OVERFLOW)
+  {
+    mutt_debug(2, "inotify queue overflow, a full rescan is needed\n");
+    MonitorContextTracked = false;
+    monitor_context_forget();
+    return;
+  }
+
+  if ((event->len == 0) || (event->mask & IN_ISDIR) || (event->name[0] == '.'))
+    return;
+
+  if (MonitorContextChangesCount >= MONITOR_CHANGES_MAX)
+  {
+    mutt_debug(3, "too many changes, a full rescan is cheaper\n");
+    MonitorContextTracked = false;
+    monitor_context_forget();
+    return;
+  }
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", subdir, event->name);
+  mutt_list_insert_tail(&MonitorContextChanges, mutt_str_strdup(path));
+  MonitorContextChangesCount++;
+}
+
+/**
+ * monitor_read_events - Consume all the pending inotify events
+ */
+static void monitor_read_events(void)
+{
+  char buf[EVENT_BUFLEN] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event = NULL;
+
+  if (INotifyFd == -1)
+    return;
+
+  while (true)
+  {
+    int len = read(INotifyFd, buf, sizeof(buf));
+    if (len == -1)
+    {
+      if (errno != EAGAIN)
+        mutt_debug(2, "read inotify events failed, errno=%d %s\n", errno,
+                   strerror(errno));
+      break;
+    }
+
+    for (char *ptr = buf; ptr < (buf + len);
+         ptr += sizeof(struct inotify_event) + event->len)
+    {
+      event = (const struct inotify_event *) ptr;
+      mutt_debug(5, "+ detail: descriptor=%d mask=0x%x\n", event->wd, event->mask);
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+        MonitorContextChanged = 1;
+        monitor_context_record(event, NULL);
+      }
+      else if ((event->wd == MonitorContextCurDescriptor) && (event->mask & IN_IGNORED))
+      {
+        MonitorContextCurDescriptor = -1;
+        MonitorContextTracked = false;
+      }
+      else if (event->mask & IN_IGNORED)
+        monitor_handle_ignore(event->wd);
+      else if (event->wd == MonitorContextDescriptor)
+      {
+        MonitorContextChanged = 1;
+        monitor_context_record(event, "new");
+      }
+      else if (event->wd == MonitorContextCurDescriptor)
+      {
+        MonitorContextChanged = 1;
+        monitor_context_record(event, "cur");
+      }
+      else
+        MonitorMailboxChanged = 1;
+    }
+  }
+}
+
+/**
+ * monitor_context_track - Watch the "cur" directory of the open Maildir too
+ * @param info Details of the open mailbox's monitor
+ *
+ * Together with the watch on "new", this lets the Maildir driver apply just
+ * the entries that changed, instead of rescanning the whole mailbox.
+ */
+static void monitor_context_track(const struct MonitorInfo *info)
+{
+  if ((info->magic != MUTT_MAILDIR) || (MonitorContextCurDescriptor != -1))
+    return;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/cur", Context->mailbox->realpath);
+  MonitorContextCurDescriptor = inotify_add_watch(INotifyFd, path, INOTIFY_MASK_DIR);
+  if (MonitorContextCurDescriptor == -1)
+  {
+    mutt_debug(2, "inotify_add_watch failed for '%s', errno=%d %s\n", path,
+               errno, strerror(errno));
+    return;
+  }
+
+  mutt_debug(3, "inotify_add_watch descriptor=%d for '%s'\n",
+             MonitorContextCurDescriptor, path);
+  /* Anything that happened before now hasn't been recorded */
+  MonitorContextTracked = false;
+  monitor_context_forget();
+}
+
 /**
  * mutt_monitor_poll - Check for filesystem changes
  * @retval -3 unknown/unexpected events: poll timeout / fds not handled by us
@@ -354,7 +535,6 @@ static int monitor_resolve(struct MonitorInfo *info, struct Mailbox *mailbox)
 int mutt_monitor_poll(void)
 {
   int rc = 0;
-  char buf[EVENT_BUFLEN] __attribute__((aligned(__alignof__(struct inotify_event))));
 
   MonitorFilesChanged = 0;
 
@@ -386,32 +566,7 @@ int mutt_monitor_poll(void)
           {
             MonitorFilesChanged = 1;
             mutt_debug(3, "file change(s) detected\n");
-            char *ptr = buf;
-            const struct inotify_event *event;
-
-            while (true)
-            {
-              int len = read(INotifyFd, buf, sizeof(buf));
-              if (len == -1)
-              {
-                if (errno != EAGAIN)
-                  mutt_debug(2, "read inotify events failed, errno=%d %s\n",
-                             errno, strerror(errno));
-                break;
-              }
-
-              while (ptr < (buf + len))
-              {
-                event = (const struct inotify_event *) ptr;
-                mutt_debug(5, "+ detail: descriptor=%d mask=0x%x\n", event->wd,
-                           event->mask);
-                if (event->mask & IN_IGNORED)
-                  monitor_handle_ignore(event->wd);
-                else if (event->wd == MonitorContextDescriptor)
-                  MonitorContextChanged = 1;
-                ptr += sizeof(struct inotify_event) + event->len;
-              }
-            }
+            monitor_read_events();
           }
         }
       }
@@ -439,7 +594,10 @@ int mutt_monitor_add(struct Mailbox *mailbox)
   if (desc != RESOLVERES_OK_NOTEXISTING)
   {
     if (!mailbox && (desc == RESOLVERES_OK_EXISTING))
+    {
       MonitorContextDescriptor = info.monitor->desc;
+      monitor_context_track(&info);
+    }
     return (desc == RESOLVERES_OK_EXISTING) ? 0 : -1;
   }
 
@@ -453,10 +611,13 @@ int mutt_monitor_add(struct Mailbox *mailbox)
   }
 
   mutt_debug(3, "inotify_add_watch descriptor=%d for '%s'\n", desc, info.path);
+  monitor_create(&info, desc);
   if (!mailbox)
+  {
     MonitorContextDescriptor = desc;
+    monitor_context_track(&info);
+  }
 
-  monitor_create(&info, desc);
   return 0;
 }
 
@@ -477,6 +638,13 @@ int mutt_monitor_remove(struct Mailbox *mailbox)
   {
     MonitorContextDescriptor = -1;
     MonitorContextChanged = 0;
+    if (MonitorContextCurDescriptor != -1)
+    {
+      inotify_rm_watch(INotifyFd, MonitorContextCurDescriptor);
+      MonitorContextCurDescriptor = -1;
+    }
+    MonitorContextTracked = false;
+    monitor_context_forget();
   }
 
   if (monitor_resolve(&info, mailbox) != RESOLVERES_OK_EXISTING)
@@ -499,7 +667,7 @@ int mutt_monitor_remove(struct Mailbox *mailbox)
     }
   }
 
-  inotify_rm_watch(info.monitor->desc, INotifyFd);
+  inotify_rm_watch(INotifyFd, info.monitor->desc);
   mutt_debug(3, "inotify_rm_watch for '%s' descriptor=%d\n", info.path,
              info.monitor->desc);
 
@@ -507,3 +675,34 @@ int mutt_monitor_remove(struct Mailbox *mailbox)
   monitor_check_free();
   return 0;
 }
+
+/**
+ * mutt_monitor_context_changes - Get the entries of the open Maildir that changed
+ * @param[out] changes List of paths, relative to the mailbox, e.g. "cur/123.abc:2,S"
+ * @retval  0 Success, the changes since the last call have been moved to the list
+ * @retval -1 The changes aren't known, the mailbox has to be rescanned
+ *
+ * A path may be listed more than once, or belong to a file that's already gone
+ * again; the caller should check the current state of each one.
+ *
+ * After -1 has been returned, the changes are recorded again, so a full rescan
+ * followed by calls to this function won't miss anything.
+ */
+int mutt_monitor_context_changes(struct ListHead *changes)
+{
+  monitor_read_events();
+
+  if ((MonitorContextDescriptor == -1) || (MonitorContextCurDescriptor == -1))
+    return -1;
+
+  if (!MonitorContextTracked)
+  {
+    MonitorContextTracked = true;
+    monitor_context_forget();
+    return -1;
+  }
+
+  STAILQ_CONCAT(changes, &MonitorContextChanges);
+  MonitorContextChangesCount = 0;
+  return 0;
+}
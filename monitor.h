@@ -25,10 +25,13 @@
 
 extern int MonitorFilesChanged;
 extern int MonitorContextChanged;
+extern int MonitorMailboxChanged;
 
+struct ListHead;
 struct Mailbox;
 
 int mutt_monitor_add(struct Mailbox *m);
+int mutt_monitor_context_changes(struct ListHead *changes);
 int mutt_monitor_remove(struct Mailbox *m);
 int mutt_monitor_poll(void);
 
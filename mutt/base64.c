@@ -131,6 +131,27 @@ int mutt_b64_decode(const char *in, char *out, size_t olen)
 {
   int len = 0;
   unsigned char digit4;
+  const unsigned char *inu = (const unsigned char *) in;
+
+  /* fast path: whole groups of four, without padding */
+  while ((olen - len >= 3) && inu[0] && inu[1] && inu[2] && inu[3] &&
+         !((inu[0] | inu[1] | inu[2] | inu[3]) & 0x80))
+  {
+    const int c1 = base64val(inu[0]);
+    const int c2 = base64val(inu[1]);
+    const int c3 = base64val(inu[2]);
+    const int c4 = base64val(inu[3]);
+    if ((c1 | c2 | c3 | c4) < 0)
+      break;
+    *out++ = (c1 << 2) | (c2 >> 4);
+    *out++ = ((c2 << 4) & 0xf0) | (c3 >> 2);
+    *out++ = ((c3 << 6) & 0xc0) | c4;
+    len += 3;
+    inu += 4;
+  }
+  in = (const char *) inu;
+  if ((len > 0) && !*in)
+    return len;
 
   do
   {
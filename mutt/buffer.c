@@ -37,9 +37,19 @@
 #include "memory.h"
 #include "string2.h"
 
-static size_t BufferPoolCount = 0;
-static size_t BufferPoolLen = 0;
-static struct Buffer **BufferPool = NULL;
+#ifdef USE_THREADS
+/* Each thread has a pool of its own, so no locking is needed */
+#define POOL_LOCAL __thread
+#else
+#define POOL_LOCAL
+#endif
+
+/* Idle Buffers beyond this are freed, rather than kept in the pool */
+#define BUFFER_POOL_KEEP 20
+
+static POOL_LOCAL size_t BufferPoolCount = 0;
+static POOL_LOCAL size_t BufferPoolLen = 0;
+static POOL_LOCAL struct Buffer **BufferPool = NULL;
 
 /**
  * mutt_buffer_new - Create and initialise a Buffer
@@ -330,6 +340,7 @@ static void increase_buffer_pool(void)
   while (BufferPoolCount < 5)
   {
     newbuf = mutt_buffer_alloc(LONG_STRING);
+    mutt_mem_account(MEM_TAG_BUFFER_POOL, sizeof(struct Buffer) + newbuf->dsize, 1);
     BufferPool[BufferPoolCount++] = newbuf;
   }
 }
@@ -344,6 +355,9 @@ void mutt_buffer_pool_init(void)
 
 /**
  * mutt_buffer_pool_free - Release the Buffer pool
+ *
+ * This only releases the pool of the calling thread.  Worker threads must
+ * call it before they exit.
  */
 void mutt_buffer_pool_free(void)
 {
@@ -352,7 +366,11 @@ void mutt_buffer_pool_free(void)
     mutt_debug(1, "Buffer pool leak: %zu/%zu\n", BufferPoolCount, BufferPoolLen);
   }
   while (BufferPoolCount)
-    mutt_buffer_free(&BufferPool[--BufferPoolCount]);
+  {
+    struct Buffer *buf = BufferPool[--BufferPoolCount];
+    mutt_mem_account(MEM_TAG_BUFFER_POOL, -(long) (sizeof(struct Buffer) + buf->dsize), -1);
+    mutt_buffer_free(&buf);
+  }
   FREE(&BufferPool);
   BufferPoolLen = 0;
 }
@@ -365,7 +383,9 @@ struct Buffer *mutt_buffer_pool_get(void)
 {
   if (BufferPoolCount == 0)
     increase_buffer_pool();
-  return BufferPool[--BufferPoolCount];
+  struct Buffer *buf = BufferPool[--BufferPoolCount];
+  mutt_mem_account(MEM_TAG_BUFFER_POOL, -(long) (sizeof(struct Buffer) + buf->dsize), -1);
+  return buf;
 }
 
 /**
@@ -384,6 +404,14 @@ void mutt_buffer_pool_release(struct Buffer **pbuf)
     return;
   }
 
+  /* Someone needed a lot of Buffers at once, don't keep them all */
+  if (BufferPoolCount >= BUFFER_POOL_KEEP)
+  {
+    mutt_buffer_free(pbuf);
+    BufferPoolLen--;
+    return;
+  }
+
   struct Buffer *buf = *pbuf;
   if (buf->dsize > (LONG_STRING * 2))
   {
@@ -391,6 +419,7 @@ void mutt_buffer_pool_release(struct Buffer **pbuf)
     mutt_mem_realloc(&buf->data, buf->dsize);
   }
   mutt_buffer_reset(buf);
+  mutt_mem_account(MEM_TAG_BUFFER_POOL, sizeof(struct Buffer) + buf->dsize, 1);
   BufferPool[BufferPoolCount++] = buf;
 
   *pbuf = NULL;
@@ -36,6 +36,7 @@
 #include <regex.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "charset.h"
 #include "buffer.h"
@@ -75,6 +76,36 @@ struct Lookup
 };
 static TAILQ_HEAD(, Lookup) Lookups = TAILQ_HEAD_INITIALIZER(Lookups);
 
+/**
+ * struct IconvCacheEntry - A conversion descriptor kept for reuse
+ */
+struct IconvCacheEntry
+{
+  char *tocode;   /**< Target character set, as given by the caller */
+  char *fromcode; /**< Source character set, as given by the caller */
+  int flags;      /**< Flags, e.g. #MUTT_ICONV_HOOK_FROM */
+  iconv_t cd;     /**< Conversion descriptor, (iconv_t) -1 if it failed */
+};
+
+#define ICONV_CACHE_SIZE 16
+
+/* Conversion descriptors, most recently used first */
+#ifdef USE_THREADS
+/* An iconv descriptor can't be shared, so each thread has a cache of its own */
+#define ICONV_LOCAL __thread
+#define ICONV_GEN_GET() __atomic_load_n(&IconvGen, __ATOMIC_RELAXED)
+#define ICONV_GEN_BUMP() __atomic_add_fetch(&IconvGen, 1, __ATOMIC_RELAXED)
+#else
+#define ICONV_LOCAL
+#define ICONV_GEN_GET() (IconvGen)
+#define ICONV_GEN_BUMP() (++IconvGen)
+#endif
+
+static ICONV_LOCAL struct IconvCacheEntry IconvCache[ICONV_CACHE_SIZE];
+static ICONV_LOCAL int IconvCacheUsed = 0;
+static ICONV_LOCAL unsigned int IconvCacheGen = 0; ///< IconvGen when this thread's cache was filled
+static unsigned int IconvGen = 0; ///< Bumped by mutt_ch_iconv_cache_clear(), for every thread
+
 // clang-format off
 /**
  * PreferredMimeNames - Lookup table of preferred charsets
@@ -446,6 +477,9 @@ bool mutt_ch_lookup_add(enum LookupType type, const char *pat,
   if (!pat || !replace)
     return false;
 
+  /* the hooks may change the conversions */
+  mutt_ch_iconv_cache_clear();
+
   regex_t *rx = mutt_mem_malloc(sizeof(regex_t));
   int rc = REGCOMP(rx, pat, REG_ICASE);
   if (rc != 0)
@@ -477,6 +511,8 @@ void mutt_ch_lookup_remove(void)
   struct Lookup *l = NULL;
   struct Lookup *tmp = NULL;
 
+  mutt_ch_iconv_cache_clear();
+
   TAILQ_FOREACH_SAFE(l, &Lookups, entries, tmp)
   {
     TAILQ_REMOVE(&Lookups, l, entries);
@@ -503,6 +539,35 @@ const char *mutt_ch_charset_lookup(const char *chs)
   return lookup_charset(MUTT_LOOKUP_CHARSET, chs);
 }
 
+/**
+ * charset_names - Work out the names of the character sets of a conversion
+ * @param[in]  tocode    Target character set
+ * @param[in]  fromcode  Current character set
+ * @param[in]  flags     Flags, e.g. #MUTT_ICONV_HOOK_FROM
+ * @param[out] tocode1   Buffer for the canonical target character set
+ * @param[out] fromcode1 Buffer for the canonical current character set
+ * @param[in]  buflen    Length of each buffer
+ *
+ * See mutt_ch_iconv_open() for the meaning of the flags.
+ */
+static void charset_names(const char *tocode, const char *fromcode, int flags,
+                          char *tocode1, char *fromcode1, size_t buflen)
+{
+  /* transform to MIME preferred charset names */
+  mutt_ch_canonical_charset(tocode1, buflen, tocode);
+  mutt_ch_canonical_charset(fromcode1, buflen, fromcode);
+
+  /* maybe apply charset-hooks and recanonicalise fromcode,
+   * but only when caller asked us to sanitize a potentially wrong
+   * charset name incoming from the wild exterior. */
+  if (flags & MUTT_ICONV_HOOK_FROM)
+  {
+    const char *tmp = mutt_ch_charset_lookup(fromcode1);
+    if (tmp)
+      mutt_ch_canonical_charset(fromcode1, buflen, tmp);
+  }
+}
+
 /**
  * mutt_ch_iconv_open - Set up iconv for conversions
  * @param tocode   Current character set
@@ -530,23 +595,10 @@ iconv_t mutt_ch_iconv_open(const char *tocode, const char *fromcode, int flags)
   char tocode1[SHORT_STRING];
   char fromcode1[SHORT_STRING];
   const char *tocode2 = NULL, *fromcode2 = NULL;
-  const char *tmp = NULL;
 
   iconv_t cd;
 
-  /* transform to MIME preferred charset names */
-  mutt_ch_canonical_charset(tocode1, sizeof(tocode1), tocode);
-  mutt_ch_canonical_charset(fromcode1, sizeof(fromcode1), fromcode);
-
-  /* maybe apply charset-hooks and recanonicalise fromcode,
-   * but only when caller asked us to sanitize a potentially wrong
-   * charset name incoming from the wild exterior. */
-  if (flags & MUTT_ICONV_HOOK_FROM)
-  {
-    tmp = mutt_ch_charset_lookup(fromcode1);
-    if (tmp)
-      mutt_ch_canonical_charset(fromcode1, sizeof(fromcode1), tmp);
-  }
+  charset_names(tocode, fromcode, flags, tocode1, fromcode1, sizeof(tocode1));
 
   /* always apply iconv-hooks to suit system's iconv tastes */
   tocode2 = mutt_ch_iconv_lookup(tocode1);
@@ -562,6 +614,100 @@ iconv_t mutt_ch_iconv_open(const char *tocode, const char *fromcode, int flags)
   return (iconv_t) -1;
 }
 
+/**
+ * iconv_cache_free - Close the calling thread's iconv descriptors
+ */
+static void iconv_cache_free(void)
+{
+  for (int i = 0; i < IconvCacheUsed; i++)
+  {
+    if (IconvCache[i].cd != (iconv_t) -1)
+      iconv_close(IconvCache[i].cd);
+    FREE(&IconvCache[i].tocode);
+    FREE(&IconvCache[i].fromcode);
+  }
+  IconvCacheUsed = 0;
+}
+
+/**
+ * mutt_ch_iconv_get - Get a shared iconv descriptor
+ * @param tocode   Target character set
+ * @param fromcode Current character set
+ * @param flags    Flags, e.g. #MUTT_ICONV_HOOK_FROM
+ * @retval ptr iconv handle for the conversion, in its initial state
+ *
+ * Like mutt_ch_iconv_open(), but the descriptors of the last few conversions
+ * are kept, so that converting lots of short strings doesn't open iconv every
+ * time.
+ *
+ * @note The descriptor belongs to the cache.  It mustn't be closed, or used
+ *       after the next call to mutt_ch_iconv_get().
+ */
+iconv_t mutt_ch_iconv_get(const char *tocode, const char *fromcode, int flags)
+{
+  struct IconvCacheEntry e;
+  int i;
+
+  /* another thread may have changed the conversions */
+  const unsigned int gen = ICONV_GEN_GET();
+  if (IconvCacheGen != gen)
+  {
+    iconv_cache_free();
+    IconvCacheGen = gen;
+  }
+
+  for (i = 0; i < IconvCacheUsed; i++)
+  {
+    if ((IconvCache[i].flags == flags) &&
+        (mutt_str_strcmp(IconvCache[i].tocode, tocode) == 0) &&
+        (mutt_str_strcmp(IconvCache[i].fromcode, fromcode) == 0))
+    {
+      break;
+    }
+  }
+
+  if (i < IconvCacheUsed)
+  {
+    e = IconvCache[i];
+    if (e.cd != (iconv_t) -1)
+      iconv(e.cd, NULL, NULL, NULL, NULL);
+  }
+  else
+  {
+    /* forget the least recently used */
+    if (IconvCacheUsed == ICONV_CACHE_SIZE)
+    {
+      i = --IconvCacheUsed;
+      if (IconvCache[i].cd != (iconv_t) -1)
+        iconv_close(IconvCache[i].cd);
+      FREE(&IconvCache[i].tocode);
+      FREE(&IconvCache[i].fromcode);
+    }
+    e.tocode = mutt_str_strdup(tocode);
+    e.fromcode = mutt_str_strdup(fromcode);
+    e.flags = flags;
+    e.cd = mutt_ch_iconv_open(tocode, fromcode, flags);
+    i = IconvCacheUsed++;
+  }
+
+  memmove(IconvCache + 1, IconvCache, i * sizeof(IconvCache[0]));
+  IconvCache[0] = e;
+  return e.cd;
+}
+
+/**
+ * mutt_ch_iconv_cache_clear - Close all the shared iconv descriptors
+ *
+ * The calling thread's descriptors are closed now.  The other threads close
+ * theirs the next time they need one.  A thread must call this before it
+ * exits.
+ */
+void mutt_ch_iconv_cache_clear(void)
+{
+  iconv_cache_free();
+  IconvCacheGen = ICONV_GEN_BUMP();
+}
+
 /**
  * mutt_ch_iconv - Change the encoding of a string
  * @param[in]     cd           Iconv conversion descriptor
@@ -680,7 +826,7 @@ const char *mutt_ch_iconv_lookup(const char *chs)
 int mutt_ch_check(const char *s, size_t slen, const char *from, const char *to)
 {
   int rc = 0;
-  iconv_t cd = mutt_ch_iconv_open(to, from, 0);
+  iconv_t cd = mutt_ch_iconv_get(to, from, 0);
   if (cd == (iconv_t) -1)
     return -1;
 
@@ -694,10 +840,148 @@ int mutt_ch_check(const char *s, size_t slen, const char *from, const char *to)
     rc = errno;
 
   FREE(&saved_out);
-  iconv_close(cd);
   return rc;
 }
 
+/**
+ * is_utf8 - Is a string valid UTF-8?
+ * @param s String to check
+ * @retval true All of the string is valid UTF-8
+ *
+ * Overlong forms, surrogates and characters beyond U+10FFFF are invalid,
+ * as they are to iconv.
+ */
+static bool is_utf8(const unsigned char *s)
+{
+  while (*s)
+  {
+    if (*s < 0x80)
+    {
+      s++;
+      continue;
+    }
+
+    int n;
+    unsigned int min;
+    unsigned int wc;
+    if ((*s & 0xe0) == 0xc0)
+    {
+      n = 1;
+      min = 0x80;
+      wc = *s & 0x1f;
+    }
+    else if ((*s & 0xf0) == 0xe0)
+    {
+      n = 2;
+      min = 0x800;
+      wc = *s & 0x0f;
+    }
+    else if ((*s & 0xf8) == 0xf0)
+    {
+      n = 3;
+      min = 0x10000;
+      wc = *s & 0x07;
+    }
+    else
+      return false;
+
+    for (s++; n > 0; n--, s++)
+    {
+      if ((*s & 0xc0) != 0x80)
+        return false;
+      wc = (wc << 6) | (*s & 0x3f);
+    }
+
+    if ((wc < min) || (wc > 0x10ffff) || ((wc >= 0xd800) && (wc <= 0xdfff)))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * is_ascii_compatible - Is ASCII text the same in a character set?
+ * @param cs Canonical name of the character set
+ * @retval true ASCII characters are themselves in the character set
+ */
+static bool is_ascii_compatible(const char *cs)
+{
+  if ((mutt_str_strcmp(cs, "utf-8") == 0) || (mutt_str_strcmp(cs, "us-ascii") == 0))
+    return true;
+
+  /* the iso-8859 family, iso-8859-1 to iso-8859-16 */
+  if (mutt_str_strncmp(cs, "iso-8859-", 9) != 0)
+    return false;
+  char *end = NULL;
+  const long n = strtol(cs + 9, &end, 10);
+  return (*end == '\0') && (n >= 1) && (n <= 16);
+}
+
+/**
+ * convert_trivial - Convert a string without the help of iconv, if possible
+ * @param[in]  s     String to convert
+ * @param[in]  from  Current character set
+ * @param[in]  to    Target character set
+ * @param[in]  flags Flags, e.g. #MUTT_ICONV_HOOK_FROM
+ * @param[out] ps    Converted string, replaces s
+ * @retval true  The string has been converted
+ * @retval false The conversion needs iconv
+ *
+ * Plain ASCII, valid UTF-8 to UTF-8, and Latin-1 to UTF-8 are handled here.
+ * The result is the same as iconv's.
+ */
+static bool convert_trivial(char *s, const char *from, const char *to,
+                            int flags, char **ps)
+{
+  char tocode[SHORT_STRING];
+  char fromcode[SHORT_STRING];
+
+  charset_names(to, from, flags, tocode, fromcode, sizeof(tocode));
+
+  /* iconv-hooks may rely on the system's iconv doing something special */
+  if (mutt_ch_iconv_lookup(tocode) || mutt_ch_iconv_lookup(fromcode))
+    return false;
+
+  const unsigned char *u = (const unsigned char *) s;
+  while (*u && (*u < 0x80))
+    u++;
+
+  /* nothing to convert */
+  if (!*u && is_ascii_compatible(tocode) && is_ascii_compatible(fromcode))
+    return true;
+
+  if (mutt_str_strcmp(tocode, "utf-8") != 0)
+    return false;
+
+  if (mutt_str_strcmp(fromcode, "utf-8") == 0)
+    return is_utf8(u);
+
+  if (mutt_str_strcmp(fromcode, "iso-8859-1") != 0)
+    return false;
+
+  /* every byte of Latin-1 is the same code point in Unicode */
+  size_t len = 0;
+  for (u = (const unsigned char *) s; *u; u++)
+    len += (*u < 0x80) ? 1 : 2;
+
+  char *buf = mutt_mem_malloc(len + 1);
+  char *ob = buf;
+  for (u = (const unsigned char *) s; *u; u++)
+  {
+    if (*u < 0x80)
+      *ob++ = *u;
+    else
+    {
+      *ob++ = 0xc0 | (*u >> 6);
+      *ob++ = 0x80 | (*u & 0x3f);
+    }
+  }
+  *ob = '\0';
+
+  FREE(ps);
+  *ps = buf;
+  return true;
+}
+
 /**
  * mutt_ch_convert_string - Convert a string between encodings
  * @param[in,out] ps    String to convert
@@ -724,7 +1008,10 @@ int mutt_ch_convert_string(char **ps, const char *from, const char *to, int flag
   if (!to || !from)
     return -1;
 
-  cd = mutt_ch_iconv_open(to, from, flags);
+  if (convert_trivial(s, from, to, flags, ps))
+    return 0;
+
+  cd = mutt_ch_iconv_get(to, from, flags);
   if (cd == (iconv_t) -1)
     return -1;
 
@@ -750,7 +1037,6 @@ int mutt_ch_convert_string(char **ps, const char *from, const char *to, int flag
   ob = buf;
 
   mutt_ch_iconv(cd, &ib, &ibl, &ob, &obl, inrepls, outrepl, &rc);
-  iconv_close(cd);
 
   *ob = '\0';
 
@@ -791,12 +1077,9 @@ bool mutt_ch_check_charset(const char *cs, bool strict)
     }
   }
 
-  cd = mutt_ch_iconv_open(cs, cs, 0);
+  cd = mutt_ch_iconv_get(cs, cs, 0);
   if (cd != (iconv_t)(-1))
-  {
-    iconv_close(cd);
     return true;
-  }
 
   return false;
 }
@@ -97,6 +97,8 @@ char *           mutt_ch_fgetconvs(char *buf, size_t buflen, struct FgetConv *fc
 char *           mutt_ch_get_default_charset(void);
 char *           mutt_ch_get_langinfo_charset(void);
 size_t           mutt_ch_iconv(iconv_t cd, const char **inbuf, size_t *inbytesleft, char **outbuf, size_t *outbytesleft, const char **inrepls, const char *outrepl, int *iconverrno);
+void             mutt_ch_iconv_cache_clear(void);
+iconv_t          mutt_ch_iconv_get(const char *tocode, const char *fromcode, int flags);
 const char *     mutt_ch_iconv_lookup(const char *chs);
 iconv_t          mutt_ch_iconv_open(const char *tocode, const char *fromcode, int flags);
 bool             mutt_ch_lookup_add(enum LookupType type, const char *pat, const char *replace, struct Buffer *err);
@@ -45,6 +45,16 @@
   (1970 + (((((TIME_T_MAX - 59) / 60) - 59) / 60) - 23) / 24 / 366)
 #define TM_YEAR_MIN (1970 - (TM_YEAR_MAX - 1970) - 1)
 
+#ifdef USE_THREADS
+/* Each thread has a cache of its own, so no locking is needed */
+#define TZ_CACHE_LOCAL __thread
+#else
+#define TZ_CACHE_LOCAL
+#endif
+
+/* Number of days whose local timezone offset is remembered */
+#define TZ_CACHE_SIZE 64
+
 // clang-format off
 
 /**
@@ -130,7 +140,8 @@ static const struct Tz TimeZones[] = {
  */
 static time_t compute_tz(time_t g, struct tm *utc)
 {
-  struct tm *lt = localtime(&g);
+  struct tm ltm;
+  struct tm *lt = localtime_r(&g, &ltm);
   time_t t;
   int yday;
 
@@ -199,6 +210,31 @@ static const char *uncomment_timezone(char *buf, size_t buflen, const char *tz)
   return buf;
 }
 
+/**
+ * local_tz - Calculate the local timezone in seconds east of UTC
+ * @param t Time to examine
+ * @retval num Seconds east of UTC
+ */
+static time_t local_tz(time_t t)
+{
+  struct tm utc;
+
+  gmtime_r(&t, &utc);
+  return compute_tz(t, &utc);
+}
+
+/**
+ * struct TzCacheEntry - The local timezone offset during one day
+ */
+struct TzCacheEntry
+{
+  time_t day;    ///< Day number since the epoch, plus one (0 means unused)
+  time_t offset; ///< Seconds east of UTC
+  bool constant; ///< The offset is the same for the whole day
+};
+
+static TZ_CACHE_LOCAL struct TzCacheEntry TzCache[TZ_CACHE_SIZE];
+
 /**
  * mutt_date_local_tz - Calculate the local timezone in seconds east of UTC
  * @param t Time to examine
@@ -206,6 +242,10 @@ static const char *uncomment_timezone(char *buf, size_t buflen, const char *tz)
  *
  * Returns the local timezone in seconds east of UTC for the time t,
  * or for the current time if t is zero.
+ *
+ * Reading a mailbox asks this for every message, so the offsets are cached by
+ * day.  A day containing a change of offset, e.g. the start of summer time,
+ * isn't cached.
  */
 time_t mutt_date_local_tz(time_t t)
 {
@@ -213,16 +253,26 @@ time_t mutt_date_local_tz(time_t t)
   if ((t == TIME_T_MAX) || (t == TIME_T_MIN))
     return 0;
 
-  struct tm *ptm = NULL;
-  struct tm utc;
-
   if (!t)
     t = time(NULL);
-  ptm = gmtime(&t);
-  /* need to make a copy because gmtime/localtime return a pointer to
-     static memory (grr!) */
-  memcpy(&utc, ptm, sizeof(utc));
-  return compute_tz(t, &utc);
+
+  if (t < 0)
+    return local_tz(t);
+
+  const time_t day = t / (24 * 60 * 60);
+  struct TzCacheEntry *tce = &TzCache[day % TZ_CACHE_SIZE];
+  if (tce->day != (day + 1))
+  {
+    const time_t start = day * (24 * 60 * 60);
+    tce->day = day + 1;
+    tce->offset = local_tz(start);
+    tce->constant = (local_tz(start + (24 * 60 * 60) - 1) == tce->offset);
+  }
+
+  if (tce->constant)
+    return tce->offset;
+
+  return local_tz(t);
 }
 
 /**
@@ -429,6 +479,162 @@ bool mutt_date_is_day_name(const char *s)
   return false;
 }
 
+/**
+ * parse_2digits - Parse a two-digit number
+ * @param s String to parse
+ * @retval num Value of the number
+ * @retval -1  The string doesn't start with two digits
+ */
+static int parse_2digits(const char *s)
+{
+  if (!isdigit((unsigned char) s[0]) || !isdigit((unsigned char) s[1]))
+    return -1;
+  return ((s[0] - '0') * 10) + (s[1] - '0');
+}
+
+/**
+ * parse_month - Parse a three-letter month name
+ * @param s String to parse
+ * @retval num Index into Months array (0-based)
+ * @retval -1  The string isn't a month name followed by a space
+ */
+static int parse_month(const char *s)
+{
+  /* The names packed into ints, so a month can be found with one compare */
+  static const unsigned int Packed[] = {
+    ('j' << 16) | ('a' << 8) | 'n', ('f' << 16) | ('e' << 8) | 'b',
+    ('m' << 16) | ('a' << 8) | 'r', ('a' << 16) | ('p' << 8) | 'r',
+    ('m' << 16) | ('a' << 8) | 'y', ('j' << 16) | ('u' << 8) | 'n',
+    ('j' << 16) | ('u' << 8) | 'l', ('a' << 16) | ('u' << 8) | 'g',
+    ('s' << 16) | ('e' << 8) | 'p', ('o' << 16) | ('c' << 8) | 't',
+    ('n' << 16) | ('o' << 8) | 'v', ('d' << 16) | ('e' << 8) | 'c',
+  };
+
+  if (!isalpha((unsigned char) s[0]) || !isalpha((unsigned char) s[1]) ||
+      !isalpha((unsigned char) s[2]) || ((s[3] != ' ') && (s[3] != '\t')))
+  {
+    return -1;
+  }
+
+  const unsigned int key = (tolower((unsigned char) s[0]) << 16) |
+                           (tolower((unsigned char) s[1]) << 8) |
+                           tolower((unsigned char) s[2]);
+  for (int i = 0; i < mutt_array_size(Packed); i++)
+    if (Packed[i] == key)
+      return i;
+
+  return -1;
+}
+
+/**
+ * skip_blanks - Skip over spaces and tabs
+ * @param s String to examine
+ * @retval ptr First character that isn't a space or tab
+ * @retval NULL The string doesn't start with a space or tab
+ */
+static const char *skip_blanks(const char *s)
+{
+  if ((*s != ' ') && (*s != '\t'))
+    return NULL;
+  while ((*s == ' ') || (*s == '\t'))
+    s++;
+  return s;
+}
+
+/**
+ * parse_date_fast - Parse a date in the usual RFC5322 format
+ * @param[in]  s      String to parse
+ * @param[out] tz_out Pointer to timezone (optional)
+ * @param[out] result Unix time in seconds
+ * @retval true  The date was parsed
+ * @retval false The date isn't in the usual format, use the general parser
+ *
+ * Nearly all mail uses the form `[ ddd, ] d[d] mmm yyyy hh:mm[:ss] +hhmm`.
+ * Any date this accepts gets the same result from the general parser.
+ */
+static bool parse_date_fast(const char *s, struct Tz *tz_out, time_t *result)
+{
+  /* The general parser only looks at this much of the string */
+  const size_t len = strnlen(s, SHORT_STRING - 1);
+  struct tm tm = { 0 };
+  int hour, min, sec = 0;
+
+  const char *comma = memchr(s, ',', len);
+  const char *p = mutt_str_skip_email_wsp(comma ? comma + 1 : s);
+
+  /* day of the month */
+  if (!isdigit((unsigned char) p[0]))
+    return false;
+  tm.tm_mday = *p++ - '0';
+  if (isdigit((unsigned char) p[0]))
+    tm.tm_mday = (tm.tm_mday * 10) + (*p++ - '0');
+  if ((tm.tm_mday > 31) || !(p = skip_blanks(p)))
+    return false;
+
+  /* month of the year */
+  tm.tm_mon = parse_month(p);
+  if ((tm.tm_mon < 0) || !(p = skip_blanks(p + 3)))
+    return false;
+
+  /* year */
+  const int century = parse_2digits(p);
+  const int year = (century < 0) ? -1 : parse_2digits(p + 2);
+  if ((year < 0) || (century < 19) || !(p = skip_blanks(p + 4)))
+    return false;
+  tm.tm_year = (century * 100) + year - 1900;
+
+  /* time of day */
+  hour = parse_2digits(p);
+  if (hour >= 0)
+    p += 2;
+  else if (isdigit((unsigned char) p[0]))
+    hour = *p++ - '0';
+  else
+    return false;
+  if ((*p++ != ':') || ((min = parse_2digits(p)) < 0))
+    return false;
+  p += 2;
+  if (*p == ':')
+  {
+    if ((sec = parse_2digits(p + 1)) < 0)
+      return false;
+    p += 3;
+  }
+  if ((hour > 23) || (min > 59) || (sec > 60) || !(p = skip_blanks(p)))
+    return false;
+  tm.tm_hour = hour;
+  tm.tm_min = min;
+  tm.tm_sec = sec;
+
+  /* timezone */
+  if ((p[0] != '+') && (p[0] != '-'))
+    return false;
+  const int zhours = parse_2digits(p + 1);
+  const int zminutes = (zhours < 0) ? -1 : parse_2digits(p + 3);
+  if ((zminutes < 0) || ((size_t)(p + 5 - s) > len))
+    return false;
+  const bool zoccident = (p[0] == '-');
+
+  if (tz_out)
+  {
+    tz_out->zhours = zhours;
+    tz_out->zminutes = zminutes;
+    tz_out->zoccident = zoccident;
+  }
+
+  time_t tz_offset = (zhours * 3600) + (zminutes * 60);
+  if (!zoccident)
+    tz_offset = -tz_offset;
+
+  time_t time = mutt_date_make_time(&tm, 0);
+  /* Check we haven't overflowed the time (on 32-bit arches) */
+  if ((time != TIME_T_MAX) && (time != TIME_T_MIN))
+    time += tz_offset;
+
+  *result = time;
+  return true;
+}
+
 /**
  * mutt_date_parse_date - Parse a date string in RFC822 format
  * @param[in]  s      String to parse
@@ -442,6 +648,10 @@ bool mutt_date_is_day_name(const char *s)
  */
 time_t mutt_date_parse_date(const char *s, struct Tz *tz_out)
 {
+  time_t result;
+  if (parse_date_fast(s, tz_out, &result))
+    return result;
+
   int count = 0;
   int hour, min, sec;
   struct tm tm;
@@ -453,6 +663,7 @@ time_t mutt_date_parse_date(const char *s, struct Tz *tz_out)
   const char *ptz = NULL;
   char tzstr[SHORT_STRING];
   char scratch[SHORT_STRING];
+  char *save = NULL;
 
   /* Don't modify our argument. Fixed-size buffer is ok here since
    * the date format imposes a natural limit.
@@ -470,7 +681,8 @@ time_t mutt_date_parse_date(const char *s, struct Tz *tz_out)
 
   memset(&tm, 0, sizeof(tm));
 
-  while ((t = strtok(t, " \t")))
+  /* strtok_r() keeps this safe to use from several threads */
+  while ((t = strtok_r(t, " \t", &save)))
   {
     switch (count)
     {
@@ -552,7 +764,7 @@ time_t mutt_date_parse_date(const char *s, struct Tz *tz_out)
           /* ad hoc support for the European MET (now officially CET) TZ */
           if (mutt_str_strcasecmp(t, "MET") == 0)
           {
-            t = strtok(NULL, " \t");
+            t = strtok_r(NULL, " \t", &save);
             if (t)
             {
               if (mutt_str_strcasecmp(t, "DST") == 0)
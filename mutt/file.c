@@ -38,7 +38,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <utime.h>
 #include "file.h"
@@ -47,7 +49,8 @@
 #include "message.h"
 #include "string2.h"
 
-char *Tmpdir; ///< Config: Directory for temporary files
+short LockTimeout; ///< Config: Seconds to wait for a file locked by someone else
+char *Tmpdir;      ///< Config: Directory for temporary files
 
 /* these characters must be escaped in regular expressions */
 static const char rx_special_chars[] = "^.[$()|*+?{\\";
@@ -55,7 +58,23 @@ static const char rx_special_chars[] = "^.[$()|*+?{\\";
 static const char safe_chars[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+@{}._-:%/";
 
-#define MAX_LOCK_ATTEMPTS 5
+#define LOCK_DELAY_MIN 10  ///< First wait for a lock, in milliseconds
+#define LOCK_DELAY_MAX 500 ///< Longest single wait for a lock, in milliseconds
+
+/**
+ * lock_wait_sleep - Wait for a lock by sleeping - Implements ::lock_wait_t
+ */
+static bool lock_wait_sleep(int delay)
+{
+  struct timespec wait = {
+    .tv_sec = delay / 1000,
+    .tv_nsec = (delay % 1000) * 1000000L,
+  };
+  nanosleep(&wait, NULL);
+  return false;
+}
+
+lock_wait_t MuttLockWait = lock_wait_sleep;
 
 /* This is defined in POSIX:2008 which isn't a build requirement */
 #ifndef O_NOFOLLOW
@@ -226,6 +245,72 @@ void mutt_file_unlink(const char *s)
   }
 }
 
+#ifdef HAVE_COPY_FILE_RANGE
+/**
+ * copy_range - Copy bytes between two regular files inside the kernel
+ * @param in   Source file
+ * @param out  Destination file
+ * @param size Maximum number of bytes to copy
+ * @retval num Bytes copied, may be less than size
+ * @retval -1  Error, see errno
+ *
+ * Both streams are repositioned after the copy, so callers can carry on
+ * using stdio.  Nothing is copied if a stream isn't a plain file, or if the
+ * destination is in append mode (which copy_file_range() refuses).  The
+ * caller must copy anything that's left over the usual way.
+ */
+static ssize_t copy_range(FILE *in, FILE *out, size_t size)
+{
+  static bool unsupported = false;
+  struct stat st;
+
+  if (unsupported || (size == 0))
+    return 0;
+
+  const int fd_in = fileno(in);
+  const int fd_out = fileno(out);
+  if ((fd_in < 0) || (fd_out < 0) || (fstat(fd_in, &st) != 0) || !S_ISREG(st.st_mode))
+    return 0;
+  if ((fstat(fd_out, &st) != 0) || !S_ISREG(st.st_mode) ||
+      (fcntl(fd_out, F_GETFL) & O_APPEND))
+  {
+    return 0;
+  }
+
+  if (fflush(out) != 0)
+    return -1;
+
+  off_t off_in = ftello(in);
+  off_t off_out = ftello(out);
+  if ((off_in < 0) || (off_out < 0))
+    return 0;
+
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t rc = copy_file_range(fd_in, &off_in, fd_out, &off_out, size - done, 0);
+    if (rc == 0)
+      break;
+    if (rc < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == ENOSYS)
+        unsupported = true;
+      /* Not possible between these files, e.g. EXDEV, EINVAL */
+      if (done == 0)
+        return 0;
+      break;
+    }
+    done += rc;
+  }
+
+  if ((fseeko(in, off_in, SEEK_SET) != 0) || (fseeko(out, off_out, SEEK_SET) != 0))
+    return -1;
+  return done;
+}
+#endif
+
 /**
  * mutt_file_copy_bytes - Copy some content from one file to another
  * @param in   Source file
@@ -236,9 +321,16 @@ void mutt_file_unlink(const char *s)
  */
 int mutt_file_copy_bytes(FILE *in, FILE *out, size_t size)
 {
+#ifdef HAVE_COPY_FILE_RANGE
+  ssize_t done = copy_range(in, out, size);
+  if (done < 0)
+    return -1;
+  size -= done;
+#endif
+
   while (size > 0)
   {
-    char buf[2048];
+    char buf[8192];
     size_t chunk = (size > sizeof(buf)) ? sizeof(buf) : size;
     chunk = fread(buf, 1, chunk, in);
     if (chunk < 1)
@@ -264,8 +356,19 @@ int mutt_file_copy_bytes(FILE *in, FILE *out, size_t size)
 int mutt_file_copy_stream(FILE *fin, FILE *fout)
 {
   size_t l;
-  char buf[LONG_STRING];
+  char buf[8192];
 
+#ifdef HAVE_COPY_FILE_RANGE
+  struct stat st;
+  if ((fstat(fileno(fin), &st) == 0) && S_ISREG(st.st_mode))
+  {
+    const off_t pos = ftello(fin);
+    if ((pos >= 0) && (st.st_size > pos) && (copy_range(fin, fout, st.st_size - pos) < 0))
+      return -1;
+  }
+#endif
+
+  /* Copy whatever is left, e.g. if the file has grown */
   while ((l = fread(buf, 1, sizeof(buf), fin)) > 0)
   {
     if (fwrite(buf, 1, l, fout) != l)
@@ -875,6 +978,91 @@ void mutt_file_set_mtime(const char *from, const char *to)
   }
 }
 
+/**
+ * mutt_file_map - Map part of a file into memory
+ * @param[in]  fp     File to map
+ * @param[in]  offset Start of the part
+ * @param[in]  len    Length of the part
+ * @param[out] map    The mapping
+ * @retval  0 Success
+ * @retval -1 Error, the file can still be read with stdio
+ *
+ * The part is cut short at the end of the file.  The file mustn't be
+ * truncated while it's mapped, release it with mutt_file_unmap().
+ */
+int mutt_file_map(FILE *fp, off_t offset, size_t len, struct MuttFileMap *map)
+{
+  struct stat st;
+
+  memset(map, 0, sizeof(*map));
+  if (!fp || (offset < 0) || (fstat(fileno(fp), &st) != 0) ||
+      !S_ISREG(st.st_mode) || (offset >= st.st_size))
+  {
+    return -1;
+  }
+  if (len > (size_t)(st.st_size - offset))
+    len = st.st_size - offset;
+  if (len == 0)
+    return -1;
+
+  /* the mapping has to start on a page boundary */
+  const long page = sysconf(_SC_PAGESIZE);
+  const off_t start = (page > 0) ? (offset - (offset % page)) : 0;
+  const size_t size = len + (offset - start);
+
+  void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(fp), start);
+  if (base == MAP_FAILED)
+  {
+    mutt_debug(1, "mmap() failed: %s\n", strerror(errno));
+    return -1;
+  }
+#ifdef POSIX_MADV_SEQUENTIAL
+  posix_madvise(base, size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+  map->fp = fp;
+  map->base = base;
+  map->size = size;
+  map->data = (const char *) base + (offset - start);
+  map->offset = offset;
+  map->len = len;
+  return 0;
+}
+
+/**
+ * mutt_file_unmap - Release a mapping made by mutt_file_map()
+ * @param map The mapping
+ */
+void mutt_file_unmap(struct MuttFileMap *map)
+{
+  if (!map || !map->base)
+    return;
+
+  munmap(map->base, map->size);
+  memset(map, 0, sizeof(*map));
+}
+
+/**
+ * mutt_file_map_range - Find part of a file in a mapping
+ * @param map    The mapping, may be NULL
+ * @param fp     File the caller is reading
+ * @param offset Start of the part
+ * @param len    Length of the part
+ * @retval ptr  The bytes of the part
+ * @retval NULL The part isn't mapped, read it with stdio
+ */
+const char *mutt_file_map_range(const struct MuttFileMap *map, FILE *fp,
+                                off_t offset, size_t len)
+{
+  if (!map || !map->data || (map->fp != fp) || (offset < map->offset))
+    return NULL;
+  if ((size_t)(offset - map->offset) > map->len)
+    return NULL;
+  if (len > map->len - (size_t)(offset - map->offset))
+    return NULL;
+  return map->data + (offset - map->offset);
+}
+
 /**
  * mutt_file_touch_atime - Set the access time to current time
  * @param fd File descriptor of the file to alter
@@ -1005,23 +1193,79 @@ int mutt_file_chmod_rm_stat(const char *path, mode_t mode, struct stat *st)
   return chmod(path, st->st_mode & ~mode);
 }
 
+/**
+ * struct LockBackoff - The state of a wait for a lock
+ */
+struct LockBackoff
+{
+  struct stat prev_sb; ///< File info at the previous attempt
+  bool have_sb;        ///< Is prev_sb valid?
+  int delay;           ///< Length of the next wait, in milliseconds
+  int waited;          ///< Time spent waiting on an unchanged file, in milliseconds
+};
+
+/**
+ * lock_backoff - Wait before trying to lock a file again
+ * @param lb State of the wait
+ * @param fd File descriptor of the file
+ * @retval  0 Try again
+ * @retval -1 $lock_timeout has been exceeded
+ * @retval  1 The wait was interrupted, see #MuttLockWait
+ *
+ * The waits start short and double up to #LOCK_DELAY_MAX, so a lock that's
+ * released quickly (the usual case with a delivering MDA) costs a few
+ * milliseconds rather than a second.  Time is only counted against
+ * $lock_timeout while the file isn't changing: a holder that's still
+ * writing is waited for.
+ */
+static int lock_backoff(struct LockBackoff *lb, int fd)
+{
+  struct stat sb = { 0 };
+  if (fstat(fd, &sb) != 0)
+    sb.st_size = 0;
+
+  const bool unchanged = !lb->have_sb || (lb->prev_sb.st_size == sb.st_size);
+  lb->prev_sb = sb;
+  lb->have_sb = true;
+
+  const int limit = LockTimeout * 1000;
+  if (unchanged && (lb->waited >= limit))
+    return -1;
+
+  if (lb->delay == 0)
+    lb->delay = LOCK_DELAY_MIN;
+
+  int delay = lb->delay;
+  if (unchanged && (delay > (limit - lb->waited)))
+    delay = limit - lb->waited;
+
+  if (MuttLockWait(delay))
+    return 1;
+
+  if (unchanged)
+    lb->waited += delay;
+  lb->delay = MIN(lb->delay * 2, LOCK_DELAY_MAX);
+  return 0;
+}
+
 #if defined(USE_FCNTL)
 /**
  * mutt_file_lock - (try to) lock a file using fcntl()
  * @param fd      File descriptor to file
  * @param excl    If true, try to lock exclusively
- * @param timeout If true, Retry #MAX_LOCK_ATTEMPTS times
+ * @param timeout If true, retry for up to $lock_timeout seconds
  * @retval  0 Success
  * @retval -1 Failure
  *
- * Use fcntl() to lock a file.
+ * Use fcntl() to lock a file.  The waits for a contended lock back off
+ * from a few milliseconds and go through #MuttLockWait, so the user can
+ * interrupt them.
  *
  * Use mutt_file_unlock() to unlock the file.
  */
 int mutt_file_lock(int fd, bool excl, bool timeout)
 {
-  struct stat sb = { 0 }, prev_sb = { 0 };
-  int count = 0;
+  struct LockBackoff lb = { { 0 } };
   int attempt = 0;
 
   struct flock lck;
@@ -1038,24 +1282,15 @@ int mutt_file_lock(int fd, bool excl, bool timeout)
       return -1;
     }
 
-    if (fstat(fd, &sb) != 0)
-      sb.st_size = 0;
-
-    if (count == 0)
-      prev_sb = sb;
-
-    /* only unlock file if it is unchanged */
-    if ((prev_sb.st_size == sb.st_size) && (++count >= (timeout ? MAX_LOCK_ATTEMPTS : 0)))
-    {
-      if (timeout)
-        mutt_error(_("Timeout exceeded while attempting fcntl lock"));
+    if (!timeout)
       return -1;
-    }
-
-    prev_sb = sb;
 
     mutt_message(_("Waiting for fcntl lock... %d"), ++attempt);
-    sleep(1);
+    int rc = lock_backoff(&lb, fd);
+    if (rc < 0)
+      mutt_error(_("Timeout exceeded while attempting fcntl lock"));
+    if (rc != 0)
+      return -1;
   }
 
   return 0;
@@ -1082,19 +1317,20 @@ int mutt_file_unlock(int fd)
  * mutt_file_lock - (try to) lock a file using flock()
  * @param fd      File descriptor to file
  * @param excl    If true, try to lock exclusively
- * @param timeout If true, Retry #MAX_LOCK_ATTEMPTS times
+ * @param timeout If true, retry for up to $lock_timeout seconds
  * @retval  0 Success
  * @retval -1 Failure
  *
- * Use flock() to lock a file.
+ * Use flock() to lock a file.  The waits for a contended lock back off
+ * from a few milliseconds and go through #MuttLockWait, so the user can
+ * interrupt them.
  *
  * Use mutt_file_unlock() to unlock the file.
  */
 int mutt_file_lock(int fd, bool excl, bool timeout)
 {
-  struct stat sb = { 0 }, prev_sb = { 0 };
+  struct LockBackoff lb = { { 0 } };
   int rc = 0;
-  int count = 0;
   int attempt = 0;
 
   while (flock(fd, (excl ? LOCK_EX : LOCK_SH) | LOCK_NB) == -1)
@@ -1106,25 +1342,21 @@ int mutt_file_lock(int fd, bool excl, bool timeout)
       break;
     }
 
-    if (fstat(fd, &sb) != 0)
-      sb.st_size = 0;
-
-    if (count == 0)
-      prev_sb = sb;
-
-    /* only unlock file if it is unchanged */
-    if ((prev_sb.st_size == sb.st_size) && (++count >= (timeout ? MAX_LOCK_ATTEMPTS : 0)))
+    if (!timeout)
     {
-      if (timeout)
-        mutt_error(_("Timeout exceeded while attempting flock lock"));
       rc = -1;
       break;
     }
 
-    prev_sb = sb;
-
     mutt_message(_("Waiting for flock attempt... %d"), ++attempt);
-    sleep(1);
+    rc = lock_backoff(&lb, fd);
+    if (rc < 0)
+      mutt_error(_("Timeout exceeded while attempting flock lock"));
+    if (rc != 0)
+    {
+      rc = -1;
+      break;
+    }
   }
 
   /* release any other locks obtained in this routine */
@@ -29,8 +29,32 @@
 #include <time.h>
 
 struct stat;
+extern short LockTimeout;
 extern char *Tmpdir;
 
+/**
+ * typedef lock_wait_t - Prototype for waiting for a locked file
+ * @param delay Time to wait, in milliseconds
+ * @retval true  Give up waiting for the lock
+ * @retval false Keep trying
+ */
+typedef bool (*lock_wait_t)(int delay);
+
+extern lock_wait_t MuttLockWait;
+
+/**
+ * struct MuttFileMap - Part of a file, mapped into memory
+ */
+struct MuttFileMap
+{
+  FILE *fp;         ///< File that was mapped
+  void *base;       ///< Start of the mapping, on a page boundary
+  size_t size;      ///< Size of the mapping
+  const char *data; ///< Bytes of the part
+  off_t offset;     ///< Offset of the part in the file
+  size_t len;       ///< Length of the part
+};
+
 /* Flags for mutt_file_read_line() */
 #define MUTT_CONT (1 << 0) /**< \-continuation */
 #define MUTT_EOL  (1 << 1) /**< don't strip `\n` / `\r\n` */
@@ -51,6 +75,8 @@ FILE *      mutt_file_fopen(const char *path, const char *mode);
 int         mutt_file_fsync_close(FILE **f);
 long        mutt_file_get_size(const char *path);
 int         mutt_file_lock(int fd, bool excl, bool timeout);
+int         mutt_file_map(FILE *fp, off_t offset, size_t len, struct MuttFileMap *map);
+const char *mutt_file_map_range(const struct MuttFileMap *map, FILE *fp, off_t offset, size_t len);
 int         mutt_file_mkdir(const char *path, mode_t mode);
 FILE *      mutt_file_mkstemp_full(const char *file, int line, const char *func);
 #define     mutt_file_mkstemp() mutt_file_mkstemp_full(__FILE__, __LINE__, __func__)
@@ -69,5 +95,6 @@ void        mutt_file_touch_atime(int fd);
 void        mutt_file_unlink(const char *s);
 void        mutt_file_unlink_empty(const char *path);
 int         mutt_file_unlock(int fd);
+void        mutt_file_unmap(struct MuttFileMap *map);
 
 #endif /* MUTT_LIB_FILE_H */
@@ -30,29 +30,49 @@
 #include "config.h"
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "hash.h"
 #include "memory.h"
 #include "string2.h"
 
-#define SOMEPRIME 149711
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * mix_hash - Spread the bits of a string hash
+ * @param h Hash
+ * @param n Number of buckets
+ * @retval num Bucket
+ *
+ * The result doesn't depend on n, until it's taken modulo n.
+ */
+static size_t mix_hash(uint64_t h, size_t n)
+{
+  h ^= h >> 32;
+  h *= FNV_PRIME;
+  h ^= h >> 29;
+  return h % n;
+}
 
 /**
  * gen_string_hash - Generate a hash from a string
  * @param key String key
  * @param n   Number of elements in the Hash table
- * @retval num Cryptographic hash of the string
+ * @retval num Hash of the string (FNV-1a)
  */
 static size_t gen_string_hash(union HashKey key, size_t n)
 {
-  size_t h = 0;
-  unsigned char *s = (unsigned char *) key.strkey;
+  uint64_t h = FNV_OFFSET;
+  const unsigned char *s = (const unsigned char *) key.strkey;
 
   while (*s)
-    h += ((h << 7) + *s++);
-  h = (h * SOMEPRIME) % n;
+  {
+    h ^= *s++;
+    h *= FNV_PRIME;
+  }
 
-  return h;
+  return mix_hash(h, n);
 }
 
 /**
@@ -72,18 +92,20 @@ static int cmp_string_key(union HashKey a, union HashKey b)
  * gen_case_string_hash - Generate a hash from a string (ignore the case)
  * @param key String key
  * @param n   Number of elements in the Hash table
- * @retval num Cryptographic hash of the string
+ * @retval num Hash of the string (FNV-1a)
  */
 static size_t gen_case_string_hash(union HashKey key, size_t n)
 {
-  size_t h = 0;
-  unsigned char *s = (unsigned char *) key.strkey;
+  uint64_t h = FNV_OFFSET;
+  const unsigned char *s = (const unsigned char *) key.strkey;
 
   while (*s)
-    h += ((h << 7) + tolower(*s++));
-  h = (h * SOMEPRIME) % n;
+  {
+    h ^= tolower(*s++);
+    h *= FNV_PRIME;
+  }
 
-  return h;
+  return mix_hash(h, n);
 }
 
 /**
@@ -103,7 +125,7 @@ static int cmp_case_string_key(union HashKey a, union HashKey b)
  * gen_int_hash - Generate a hash from an integer
  * @param key Integer key
  * @param n   Number of elements in the Hash table
- * @retval num Cryptographic hash of the integer
+ * @retval num Bucket of the integer
  */
 static size_t gen_int_hash(union HashKey key, size_t n)
 {
@@ -132,19 +154,110 @@ static int cmp_int_key(union HashKey a, union HashKey b)
  * @param nelem Number of elements it should contain
  * @retval ptr New Hash table
  *
- * The Hash table can contain more elements than nelem, but they will be
- * chained together.
+ * The Hash table can contain more elements than nelem.  The number of buckets
+ * is doubled whenever there are more elements than buckets.
  */
 static struct Hash *new_hash(size_t nelem)
 {
-  struct Hash *table = mutt_mem_calloc(1, sizeof(struct Hash));
+  struct Hash *table = mutt_mem_calloc_tag(MEM_TAG_HASH, 1, sizeof(struct Hash));
   if (nelem == 0)
     nelem = 2;
   table->nelem = nelem;
-  table->table = mutt_mem_calloc(nelem, sizeof(struct HashElem *));
+  table->table = mutt_mem_calloc_tag(MEM_TAG_HASH, nelem, sizeof(struct HashElem *));
   return table;
 }
 
+/**
+ * grow_hash - Double the number of buckets in a Hash table
+ * @param table Hash table to grow
+ *
+ * The gen_hash() functions depend only on the key's hash modulo the number of
+ * buckets, so bucket i is split between buckets i and i + nelem.  The order
+ * of each chain is kept: the sorted order of unique keys, and the most recent
+ * first order of duplicates.
+ */
+static void grow_hash(struct Hash *table)
+{
+  const size_t old_nelem = table->nelem;
+  const size_t nelem = old_nelem * 2;
+  struct HashElem **buckets = mutt_mem_calloc_tag(MEM_TAG_HASH, nelem, sizeof(struct HashElem *));
+  struct HashElem **tails = mutt_mem_calloc(nelem, sizeof(struct HashElem *));
+
+  for (size_t i = 0; i < old_nelem; i++)
+  {
+    struct HashElem *next = NULL;
+    for (struct HashElem *he = table->table[i]; he; he = next)
+    {
+      next = he->next;
+      const size_t h = table->gen_hash(he->key, nelem);
+      he->next = NULL;
+      if (tails[h])
+        tails[h]->next = he;
+      else
+        buckets[h] = he;
+      tails[h] = he;
+    }
+  }
+
+  FREE(&tails);
+  mutt_mem_free_tag(MEM_TAG_HASH, &table->table, old_nelem * sizeof(struct HashElem *));
+  table->table = buckets;
+  table->nelem = nelem;
+}
+
+/**
+ * struct HashSlab - A block of HashElems
+ *
+ * A Hash allocates its HashElems in blocks, which are all freed together by
+ * mutt_hash_destroy().  Deleted HashElems are kept for reuse.
+ */
+struct HashSlab
+{
+  struct HashSlab *next; ///< Previous, full, block
+  size_t used;           ///< Number of HashElems handed out
+  size_t size;           ///< Number of HashElems in the block
+  struct HashElem elems[];
+};
+
+/**
+ * new_elem - Get an unused HashElem
+ * @param table Hash table
+ * @retval ptr HashElem, owned by the table
+ */
+static struct HashElem *new_elem(struct Hash *table)
+{
+  if (table->spare)
+  {
+    struct HashElem *he = table->spare;
+    table->spare = he->next;
+    return he;
+  }
+
+  struct HashSlab *slab = table->slabs;
+  if (!slab || (slab->used == slab->size))
+  {
+    const size_t size = slab ? MIN(slab->size * 2, 65536) : 32;
+    slab = mutt_mem_malloc_tag(MEM_TAG_HASH, sizeof(struct HashSlab) + size * sizeof(struct HashElem));
+    slab->used = 0;
+    slab->size = size;
+    slab->next = table->slabs;
+    table->slabs = slab;
+  }
+
+  return &slab->elems[slab->used++];
+}
+
+/**
+ * free_elem - Keep a deleted HashElem for reuse
+ * @param table Hash table
+ * @param he    HashElem to release
+ */
+static void free_elem(struct Hash *table, struct HashElem *he)
+{
+  he->next = table->spare;
+  table->spare = he;
+}
+
 /**
  * union_hash_insert - Insert into a hash table using a union as a key
  * @param table Hash table to update
@@ -156,8 +269,11 @@ static struct Hash *new_hash(size_t nelem)
 static struct HashElem *union_hash_insert(struct Hash *table, union HashKey key,
                                           int type, void *data)
 {
-  struct HashElem *ptr = mutt_mem_malloc(sizeof(struct HashElem));
-  unsigned int h = table->gen_hash(key, table->nelem);
+  if (table->count >= table->nelem)
+    grow_hash(table);
+
+  struct HashElem *ptr = new_elem(table);
+  const size_t h = table->gen_hash(key, table->nelem);
   ptr->key = key;
   ptr->data = data;
   ptr->type = type;
@@ -176,7 +292,7 @@ static struct HashElem *union_hash_insert(struct Hash *table, union HashKey key,
       const int r = table->cmp_key(tmp->key, key);
       if (r == 0)
       {
-        FREE(&ptr);
+        free_elem(table, ptr);
         return NULL;
       }
       if (r > 0)
@@ -188,6 +304,7 @@ static struct HashElem *union_hash_insert(struct Hash *table, union HashKey key,
       table->table[h] = ptr;
     ptr->next = tmp;
   }
+  table->count++;
   return ptr;
 }
 
@@ -199,13 +316,12 @@ static struct HashElem *union_hash_insert(struct Hash *table, union HashKey key,
  */
 static struct HashElem *union_hash_find_elem(const struct Hash *table, union HashKey key)
 {
-  int hash;
   struct HashElem *ptr = NULL;
 
   if (!table)
     return NULL;
 
-  hash = table->gen_hash(key, table->nelem);
+  const size_t hash = table->gen_hash(key, table->nelem);
   ptr = table->table[hash];
   for (; ptr; ptr = ptr->next)
   {
@@ -238,13 +354,12 @@ static void *union_hash_find(const struct Hash *table, union HashKey key)
  */
 static void union_hash_delete(struct Hash *table, union HashKey key, const void *data)
 {
-  int hash;
   struct HashElem *ptr, **last;
 
   if (!table)
     return;
 
-  hash = table->gen_hash(key, table->nelem);
+  const size_t hash = table->gen_hash(key, table->nelem);
   ptr = table->table[hash];
   last = &table->table[hash];
 
@@ -253,11 +368,12 @@ static void union_hash_delete(struct Hash *table, union HashKey key, const void
     if ((data == ptr->data || !data) && table->cmp_key(ptr->key, key) == 0)
     {
       *last = ptr->next;
+      table->count--;
       if (table->destroy)
         table->destroy(ptr->type, ptr->data, table->dest_data);
       if (table->strdup_keys)
         FREE(&ptr->key.strkey);
-      FREE(&ptr);
+      free_elem(table, ptr);
 
       ptr = *last;
     }
@@ -415,13 +531,12 @@ void *mutt_hash_int_find(const struct Hash *table, unsigned int intkey)
 struct HashElem *mutt_hash_find_bucket(const struct Hash *table, const char *strkey)
 {
   union HashKey key;
-  int hash;
 
   if (!table)
     return NULL;
 
   key.strkey = strkey;
-  hash = table->gen_hash(key, table->nelem);
+  const size_t hash = table->gen_hash(key, table->nelem);
   return table->table[hash];
 }
 
@@ -474,11 +589,17 @@ void mutt_hash_destroy(struct Hash **ptr)
         pptr->destroy(tmp->type, tmp->data, pptr->dest_data);
       if (pptr->strdup_keys)
         FREE(&tmp->key.strkey);
-      FREE(&tmp);
     }
   }
-  FREE(&pptr->table);
-  FREE(ptr);
+  while (pptr->slabs)
+  {
+    struct HashSlab *next = pptr->slabs->next;
+    mutt_mem_free_tag(MEM_TAG_HASH, &pptr->slabs,
+                      sizeof(struct HashSlab) + pptr->slabs->size * sizeof(struct HashElem));
+    pptr->slabs = next;
+  }
+  mutt_mem_free_tag(MEM_TAG_HASH, &pptr->table, pptr->nelem * sizeof(struct HashElem *));
+  mutt_mem_free_tag(MEM_TAG_HASH, ptr, sizeof(struct Hash));
 }
 
 /**
@@ -60,10 +60,13 @@ typedef void (*hash_destructor_t)(int type, void *obj, intptr_t data);
  */
 struct Hash
 {
-  size_t nelem;
+  size_t nelem;         /**< Number of buckets, grows with the table */
+  size_t count;         /**< Number of HashElems in the table */
   bool strdup_keys : 1; /**< if set, the key->strkey is strdup'ed */
   bool allow_dups  : 1; /**< if set, duplicate keys are allowed */
   struct HashElem **table;
+  struct HashSlab *slabs;  /**< Storage for the HashElems */
+  struct HashElem *spare;  /**< Deleted HashElems, ready for reuse */
   size_t (*gen_hash)(union HashKey, size_t);
   int (*cmp_key)(union HashKey, union HashKey);
   hash_destructor_t destroy;
@@ -49,8 +49,9 @@
  *         ...
  *         History  entry
  * ```
- * When $history_remove_dups is set, duplicate entries are scanned and removed
- * each time a new entry is added.  In order to preserve the history ring size,
+ * When $history_remove_dups is set, duplicate entries are removed each time a
+ * new entry is added.  A Hash Table counts the strings in the ring, so the
+ * ring is only scanned if the new entry is already in it.  In order to preserve the history ring size,
  * entries 0..last are compacted up.  Entries last+1..History are
  * compacted down:
  * ```
@@ -66,6 +67,11 @@
  *                  next oldest entry
  *         History  entry
  * ```
+ *
+ * The history file is a log: each new entry is appended to it.  The number of
+ * lines of each class, and of repeated lines, are kept in memory, so the file
+ * is only read and rewritten when it holds twice $save_history lines of a
+ * class, or as many duplicates.
  */
 
 #include "config.h"
@@ -100,6 +106,7 @@ struct History
   char **hist;
   short cur;
   short last;
+  struct Hash *dups; ///< Number of times each string is in the ring
 };
 
 /* global vars used for the string-history routines */
@@ -107,6 +114,12 @@ struct History
 static struct History Histories[HC_LAST];
 static int OldSize = 0;
 
+/* What's known about the lines in the history file */
+static char *IndexedFile = NULL;        ///< File the counts are for, NULL if none
+static struct Hash *FileIndex[HC_LAST]; ///< Number of times each line is in the file
+static int FileLines[HC_LAST];          ///< Number of lines of each class
+static int FileDups[HC_LAST];           ///< Number of lines that repeat an earlier one
+
 /**
  * get_history - Get a particular history
  * @param hclass Type of history to find
@@ -138,8 +151,12 @@ static void init_history(struct History *h)
     }
   }
 
+  mutt_hash_destroy(&h->dups);
   if (History != 0)
+  {
     h->hist = mutt_mem_calloc(History + 1, sizeof(char *));
+    h->dups = mutt_hash_create(MAX(10, History * 2), MUTT_HASH_STRDUP_KEYS);
+  }
 
   h->cur = 0;
   h->last = 0;
@@ -200,57 +217,131 @@ static int dup_hash_inc(struct Hash *dup_hash, char *str)
 }
 
 /**
- * shrink_histfile - Read, de-dupe and write the history file
+ * file_index_free - Forget the lines of the history file
  */
-static void shrink_histfile(void)
+static void file_index_free(void)
 {
-  FILE *tmpfp = NULL;
-  int n[HC_LAST] = { 0 };
-  int line, hclass, read;
-  char *linebuf = NULL, *p = NULL;
-  size_t buflen;
-  bool regen_file = false;
-  struct Hash *dup_hashes[HC_LAST] = { 0 };
+  for (int hclass = 0; hclass < HC_LAST; hclass++)
+  {
+    mutt_hash_destroy(&FileIndex[hclass]);
+    FileLines[hclass] = 0;
+    FileDups[hclass] = 0;
+  }
+  FREE(&IndexedFile);
+}
 
-  FILE *f = fopen(HistoryFile, "r");
-  if (!f)
-    return;
+/**
+ * file_index_add - Count a line of the history file
+ * @param hclass History class
+ * @param str    String, as it is in the file
+ */
+static void file_index_add(int hclass, char *str)
+{
+  if (!FileIndex[hclass])
+    FileIndex[hclass] = mutt_hash_create(MAX(10, SaveHistory * 2), MUTT_HASH_STRDUP_KEYS);
 
-  if (HistoryRemoveDups)
-    for (hclass = 0; hclass < HC_LAST; hclass++)
-      dup_hashes[hclass] = mutt_hash_create(MAX(10, SaveHistory * 2), MUTT_HASH_STRDUP_KEYS);
+  FileLines[hclass]++;
+  if (dup_hash_inc(FileIndex[hclass], str) > 1)
+    FileDups[hclass]++;
+}
 
-  line = 0;
+/**
+ * file_index_read - Count the lines of a history file
+ * @param f File to read
+ * @retval true  Success
+ * @retval false The file is corrupt
+ */
+static bool file_index_read(FILE *f)
+{
+  int line = 0, hclass, read;
+  char *linebuf = NULL, *p = NULL;
+  size_t buflen;
+  bool rc = true;
+
+  file_index_free();
   while ((linebuf = mutt_file_read_line(linebuf, &buflen, f, &line, 0)))
   {
+    read = 0;
     if (sscanf(linebuf, "%d:%n", &hclass, &read) < 1 || read == 0 ||
         *(p = linebuf + strlen(linebuf) - 1) != '|' || hclass < 0)
     {
       mutt_error(_("Bad history file format (line %d)"), line);
-      goto cleanup;
+      rc = false;
+      break;
     }
     /* silently ignore too high class (probably newer neomutt) */
     if (hclass >= HC_LAST)
       continue;
     *p = '\0';
-    if (HistoryRemoveDups && (dup_hash_inc(dup_hashes[hclass], linebuf + read) > 1))
+    file_index_add(hclass, linebuf + read);
+  }
+  FREE(&linebuf);
+
+  if (rc)
+    IndexedFile = mutt_str_strdup(HistoryFile);
+  return rc;
+}
+
+/**
+ * file_index_full - Does the history file need shrinking?
+ * @retval true The file has too many lines, or too many duplicates
+ *
+ * Letting the file grow to twice $save_history means it's rewritten once
+ * every $save_history entries, at most, so adding an entry stays cheap.
+ */
+static bool file_index_full(void)
+{
+  const int slack = MAX(SaveHistory, 10);
+
+  for (int hclass = HC_FIRST; hclass < HC_LAST; hclass++)
+  {
+    if ((FileLines[hclass] > (SaveHistory + slack)) ||
+        (HistoryRemoveDups && (FileDups[hclass] > slack)))
     {
-      regen_file = true;
-      continue;
+      return true;
     }
-    n[hclass]++;
   }
 
-  if (!regen_file)
+  return false;
+}
+
+/**
+ * shrink_histfile - Read, de-dupe and write the history file
+ *
+ * Afterwards, the lines of the file are counted again, see file_index_add().
+ */
+static void shrink_histfile(void)
+{
+  FILE *tmpfp = NULL;
+  int n[HC_LAST] = { 0 };
+  int line, hclass, read;
+  char *linebuf = NULL, *p = NULL;
+  size_t buflen;
+  bool regen_file = false;
+
+  FILE *f = fopen(HistoryFile, "r");
+  if (!f)
   {
-    for (hclass = HC_FIRST; hclass < HC_LAST; hclass++)
+    file_index_free();
+    IndexedFile = mutt_str_strdup(HistoryFile);
+    return;
+  }
+
+  if (!file_index_read(f))
+    goto cleanup;
+
+  for (hclass = HC_FIRST; hclass < HC_LAST; hclass++)
+  {
+    /* only the last copy of a line is kept */
+    n[hclass] = FileLines[hclass];
+    if (HistoryRemoveDups)
     {
-      if (n[hclass] > SaveHistory)
-      {
+      n[hclass] -= FileDups[hclass];
+      if (FileDups[hclass] > 0)
         regen_file = true;
-        break;
-      }
     }
+    if (n[hclass] > SaveHistory)
+      regen_file = true;
   }
 
   if (regen_file)
@@ -274,7 +365,8 @@ static void shrink_histfile(void)
       if (hclass >= HC_LAST)
         continue;
       *p = '\0';
-      if (HistoryRemoveDups && (dup_hash_dec(dup_hashes[hclass], linebuf + read) > 0))
+      /* keep the last copy of each line */
+      if (HistoryRemoveDups && (dup_hash_dec(FileIndex[hclass], linebuf + read) > 0))
       {
         continue;
       }
@@ -294,12 +386,17 @@ cleanup:
       rewind(tmpfp);
       mutt_file_copy_stream(tmpfp, f);
       mutt_file_fclose(&f);
+      /* count what's left */
+      rewind(tmpfp);
+      file_index_read(tmpfp);
+    }
+    else
+    {
+      /* the counts were used up, read the file again next time */
+      file_index_free();
     }
     mutt_file_fclose(&tmpfp);
   }
-  if (HistoryRemoveDups)
-    for (hclass = 0; hclass < HC_LAST; hclass++)
-      mutt_hash_destroy(&dup_hashes[hclass]);
 }
 
 /**
@@ -309,13 +406,16 @@ cleanup:
  */
 static void save_history(enum HistoryClass hclass, const char *str)
 {
-  static int n = 0;
   FILE *f = NULL;
   char *tmp = NULL;
 
   if (!str || !*str) /* This shouldn't happen, but it's safer. */
     return;
 
+  /* the file wasn't read at startup, or it's a different one */
+  if (mutt_str_strcmp(IndexedFile, HistoryFile) != 0)
+    shrink_histfile();
+
   f = fopen(HistoryFile, "a");
   if (!f)
   {
@@ -329,24 +429,27 @@ static void save_history(enum HistoryClass hclass, const char *str)
   /* Format of a history item (1 line): "<histclass>:<string>|".
    * We add a '|' in order to avoid lines ending with '\'. */
   fprintf(f, "%d:", (int) hclass);
+  char *q = tmp;
   for (char *p = tmp; *p; p++)
   {
     /* Don't copy \n as a history item must fit on one line. The string
      * shouldn't contain such a character anyway, but as this can happen
      * in practice, we must deal with that. */
     if (*p != '\n')
+    {
       putc((unsigned char) *p, f);
+      *q++ = *p;
+    }
   }
+  *q = '\0';
   fputs("|\n", f);
 
   mutt_file_fclose(&f);
+  file_index_add(hclass, tmp);
   FREE(&tmp);
 
-  if (--n < 0)
-  {
-    n = SaveHistory;
+  if (file_index_full())
     shrink_histfile();
-  }
 }
 
 /**
@@ -401,6 +504,8 @@ static void remove_history_dups(enum HistoryClass hclass, const char *str)
   /* Fill in moved entries with NULL */
   while (dest > old_last)
     h->hist[dest--] = NULL;
+
+  mutt_hash_delete(h->dups, str, NULL);
 }
 
 /**
@@ -450,7 +555,10 @@ void mutt_hist_free(void)
       FREE(&h->hist[i]);
     }
     FREE(&h->hist);
+    mutt_hash_destroy(&h->dups);
   }
+
+  file_index_free();
 }
 
 /**
@@ -495,13 +603,18 @@ void mutt_hist_add(enum HistoryClass hclass, const char *str, bool save)
      */
     if ((*str != ' ') && (!h->hist[prev] || (mutt_str_strcmp(h->hist[prev], str) != 0)))
     {
-      if (HistoryRemoveDups)
+      if (HistoryRemoveDups && mutt_hash_find_elem(h->dups, str))
         remove_history_dups(hclass, str);
       if (save && (SaveHistory != 0))
         save_history(hclass, str);
-      mutt_str_replace(&h->hist[h->last++], str);
+      mutt_str_replace(&h->hist[h->last], str);
+      dup_hash_inc(h->dups, h->hist[h->last]);
+      h->last++;
       if (h->last > History)
         h->last = 0;
+      /* the oldest entry is now the scratch area, so it's left the ring */
+      if (h->hist[h->last])
+        dup_hash_dec(h->dups, h->hist[h->last]);
     }
   }
   h->cur = h->last; /* reset to the last entry */
@@ -595,6 +708,10 @@ void mutt_hist_read_file(void)
   if (!f)
     return;
 
+  /* count the lines while they're read, see save_history() */
+  file_index_free();
+  bool ok = true;
+
   while ((linebuf = mutt_file_read_line(linebuf, &buflen, f, &line, 0)))
   {
     read = 0;
@@ -602,12 +719,14 @@ void mutt_hist_read_file(void)
         *(p = linebuf + strlen(linebuf) - 1) != '|' || hclass < 0)
     {
       mutt_error(_("Bad history file format (line %d)"), line);
+      ok = false;
       break;
     }
     /* silently ignore too high class (probably newer neomutt) */
     if (hclass >= HC_LAST)
       continue;
     *p = '\0';
+    file_index_add(hclass, linebuf + read);
     p = mutt_str_strdup(linebuf + read);
     if (p)
     {
@@ -617,6 +736,8 @@ void mutt_hist_read_file(void)
     }
   }
 
+  if (ok)
+    IndexedFile = mutt_str_strdup(HistoryFile);
   mutt_file_fclose(&f);
   FREE(&linebuf);
 }
@@ -31,9 +31,13 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
 #include "logging.h"
 #include "file.h"
 #include "memory.h"
@@ -55,6 +59,31 @@ char *LogFileName = NULL;    /**< Log file name */
 int LogFileLevel = 0;        /**< Log file level */
 char *LogFileVersion = NULL; /**< Program version */
 
+#ifdef USE_THREADS
+#define LOG_RING_SIZE (1024 * 1024) /**< Bytes of log waiting to be written */
+#define LOG_RING_BATCH (64 * 1024)  /**< Wake the writer when this much is waiting */
+#define LOG_RING_DELAY_MS 100       /**< Longest wait before queued lines are written */
+
+/* The log lines are copied into a ring buffer and written to #LogFileFP by a
+ * separate thread, so that the caller doesn't wait for the disk. */
+static pthread_mutex_t LogRingLock = PTHREAD_MUTEX_INITIALIZER; /**< Protects the LogRing* variables */
+static pthread_cond_t LogRingData = PTHREAD_COND_INITIALIZER;   /**< Signalled when lines are added */
+static pthread_cond_t LogRingSpace = PTHREAD_COND_INITIALIZER;  /**< Signalled when lines are written */
+static char *LogRing = NULL;      /**< Ring buffer of log lines */
+static size_t LogRingHead = 0;    /**< Offset of the oldest byte in the ring */
+static size_t LogRingUsed = 0;    /**< Number of bytes in the ring */
+static size_t LogRingDropped = 0; /**< Number of lines dropped because the ring was full */
+static bool LogRingUrgent = false; /**< An important line is waiting */
+static bool LogRingStop = false;  /**< Tell the writer thread to finish */
+static bool LogWriterRunning = false; /**< The writer thread has been started */
+static pthread_t LogWriter;       /**< Thread writing the ring to the file */
+#endif
+
+#ifdef USE_TRACE
+FILE *TraceFileFP = NULL;   /**< Trace file handle */
+char *TraceFileName = NULL; /**< Trace file name */
+#endif
+
 /**
  * LogQueue - In-memory list of log lines
  */
@@ -90,6 +119,196 @@ static const char *timestamp(time_t stamp)
   return buf;
 }
 
+#ifdef USE_THREADS
+/**
+ * log_writer - Write the ring buffer to the log file
+ * @param arg Unused
+ * @retval NULL Always
+ *
+ * This runs in its own thread until log_writer_stop() is called.  Everything
+ * that is waiting in the ring is written in one go.
+ */
+static void *log_writer(void *arg)
+{
+  char *buf = mutt_mem_malloc(LOG_RING_SIZE);
+
+  pthread_mutex_lock(&LogRingLock);
+  while (true)
+  {
+    /* Let the lines collect, so they can be written together */
+    while ((LogRingUsed < LOG_RING_BATCH) && !LogRingUrgent && !LogRingStop)
+    {
+      if ((LogRingUsed == 0) && (LogRingDropped == 0))
+      {
+        pthread_cond_wait(&LogRingData, &LogRingLock);
+        continue;
+      }
+
+      struct timespec ts = { 0 };
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += LOG_RING_DELAY_MS * 1000000L;
+      ts.tv_sec += ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      if (pthread_cond_timedwait(&LogRingData, &LogRingLock, &ts) == ETIMEDOUT)
+        break;
+    }
+    if ((LogRingUsed == 0) && (LogRingDropped == 0) && LogRingStop)
+      break;
+    LogRingUrgent = false;
+
+    size_t len = LogRingUsed;
+    size_t first = MIN(len, LOG_RING_SIZE - LogRingHead);
+    memcpy(buf, LogRing + LogRingHead, first);
+    memcpy(buf + first, LogRing, len - first);
+    LogRingHead = (LogRingHead + len) % LOG_RING_SIZE;
+    LogRingUsed = 0;
+    size_t dropped = LogRingDropped;
+    LogRingDropped = 0;
+    pthread_cond_broadcast(&LogRingSpace);
+    pthread_mutex_unlock(&LogRingLock);
+
+    fwrite(buf, 1, len, LogFileFP);
+    if (dropped != 0)
+      fprintf(LogFileFP, "[...] %zu debug lines were dropped, the log couldn't keep up\n", dropped);
+    fflush(LogFileFP);
+
+    pthread_mutex_lock(&LogRingLock);
+  }
+  pthread_mutex_unlock(&LogRingLock);
+
+  FREE(&buf);
+  return NULL;
+}
+
+/**
+ * log_writer_stop - Write out the ring buffer and stop the writer thread
+ */
+static void log_writer_stop(void)
+{
+  if (!LogWriterRunning)
+    return;
+
+  pthread_mutex_lock(&LogRingLock);
+  LogRingStop = true;
+  pthread_cond_signal(&LogRingData);
+  pthread_mutex_unlock(&LogRingLock);
+
+  pthread_join(LogWriter, NULL);
+  LogWriterRunning = false;
+  FREE(&LogRing);
+}
+
+/**
+ * log_writer_prefork - Hold the ring buffer during a fork()
+ */
+static void log_writer_prefork(void)
+{
+  pthread_mutex_lock(&LogRingLock);
+}
+
+/**
+ * log_writer_postfork - Release the ring buffer after a fork()
+ */
+static void log_writer_postfork(void)
+{
+  pthread_mutex_unlock(&LogRingLock);
+}
+
+/**
+ * log_writer_postfork_child - Write the log directly in a child process
+ *
+ * The writer thread doesn't exist in the child.  The lines waiting in the ring
+ * belong to the parent, which will write them.
+ */
+static void log_writer_postfork_child(void)
+{
+  LogWriterRunning = false;
+  LogRing = NULL;
+  LogRingHead = 0;
+  LogRingUsed = 0;
+  LogRingDropped = 0;
+  pthread_mutex_unlock(&LogRingLock);
+}
+
+/**
+ * log_writer_start - Start the thread that writes the log file
+ */
+static void log_writer_start(void)
+{
+  static bool registered = false;
+
+  if (LogWriterRunning)
+    return;
+
+  if (!registered)
+  {
+    pthread_atfork(log_writer_prefork, log_writer_postfork, log_writer_postfork_child);
+    atexit(log_writer_stop);
+    registered = true;
+  }
+
+  LogRing = mutt_mem_malloc(LOG_RING_SIZE);
+  LogRingHead = 0;
+  LogRingUsed = 0;
+  LogRingDropped = 0;
+  LogRingUrgent = false;
+  LogRingStop = false;
+  if (pthread_create(&LogWriter, NULL, log_writer, NULL) != 0)
+  {
+    FREE(&LogRing);
+    return;
+  }
+  LogWriterRunning = true;
+}
+#endif
+
+/**
+ * log_file_puts - Write a string to the log file
+ * @param str       String to write
+ * @param len       Length of the string
+ * @param important If true, never drop the string
+ *
+ * If the writer thread is running, the string is queued for it.  When the
+ * queue is full, debug lines are dropped rather than waiting for the disk.
+ */
+static void log_file_puts(const char *str, size_t len, bool important)
+{
+#ifdef USE_THREADS
+  if (LogWriterRunning)
+  {
+    len = MIN(len, LOG_RING_SIZE);
+    pthread_mutex_lock(&LogRingLock);
+    while ((LOG_RING_SIZE - LogRingUsed) < len)
+    {
+      if (!important)
+      {
+        LogRingDropped++;
+        pthread_cond_signal(&LogRingData);
+        pthread_mutex_unlock(&LogRingLock);
+        return;
+      }
+      pthread_cond_wait(&LogRingSpace, &LogRingLock);
+    }
+
+    size_t tail = (LogRingHead + LogRingUsed) % LOG_RING_SIZE;
+    size_t first = MIN(len, LOG_RING_SIZE - tail);
+    memcpy(LogRing + tail, str, first);
+    memcpy(LogRing, str + first, len - first);
+    /* Only wake the writer when there's something worth writing */
+    bool wake = (LogRingUsed == 0) || important ||
+                ((LogRingUsed < LOG_RING_BATCH) && ((LogRingUsed + len) >= LOG_RING_BATCH));
+    LogRingUsed += len;
+    if (important)
+      LogRingUrgent = true;
+    if (wake)
+      pthread_cond_signal(&LogRingData);
+    pthread_mutex_unlock(&LogRingLock);
+    return;
+  }
+#endif
+  fwrite(str, 1, len, LogFileFP);
+}
+
 /**
  * log_file_close - Close the log file
  * @param verbose If true, then log the event
@@ -99,6 +318,9 @@ void log_file_close(bool verbose)
   if (!LogFileFP)
     return;
 
+#ifdef USE_THREADS
+  log_writer_stop();
+#endif
   fprintf(LogFileFP, "[%s] Closing log.\n", timestamp(0));
   mutt_file_fclose(&LogFileFP);
   if (verbose)
@@ -132,6 +354,9 @@ int log_file_open(bool verbose)
 
   fprintf(LogFileFP, "[%s] NeoMutt%s debugging at level %d\n", timestamp(0),
           NONULL(LogFileVersion), LogFileLevel);
+#ifdef USE_THREADS
+  log_writer_start();
+#endif
   if (verbose)
     mutt_message(_("Debugging at level %d to file '%s'"), LogFileLevel, LogFileName);
   return 0;
@@ -185,22 +410,25 @@ int log_file_set_level(int level, bool verbose)
   {
     if (verbose)
       mutt_message(_("Logging at level %d to file '%s'"), LogFileLevel, LogFileName);
-    fprintf(LogFileFP, "[%s] NeoMutt%s debugging at level %d\n", timestamp(0),
-            NONULL(LogFileVersion), LogFileLevel);
+    char buf[STRING];
+    int len = snprintf(buf, sizeof(buf), "[%s] NeoMutt%s debugging at level %d\n",
+                       timestamp(0), NONULL(LogFileVersion), LogFileLevel);
+    log_file_puts(buf, MIN(len, sizeof(buf) - 1), true);
   }
   else
   {
     log_file_open(verbose);
   }
 
-  if (LogFileLevel == LL_DEBUG5)
+  if (LogFileFP && (LogFileLevel == LL_DEBUG5))
   {
-    fprintf(LogFileFP,
-            "\n"
-            "WARNING:\n"
-            "    Logging at this level can reveal personal information.\n"
-            "    Review the log carefully before posting in bug reports.\n"
-            "\n");
+    static const char warning[] =
+        "\n"
+        "WARNING:\n"
+        "    Logging at this level can reveal personal information.\n"
+        "    Review the log carefully before posting in bug reports.\n"
+        "\n";
+    log_file_puts(warning, sizeof(warning) - 1, true);
   }
 
   return 0;
@@ -253,30 +481,52 @@ int log_disp_file(time_t stamp, const char *file, int line,
   if (!LogFileFP || (level < LL_PERROR) || (level > LogFileLevel))
     return 0;
 
-  int ret = 0;
   int err = errno;
 
   if (!function)
     function = "UNKNOWN";
 
-  ret += fprintf(LogFileFP, "[%s]<%c> %s() ", timestamp(stamp),
-                 LevelAbbr[level + 3], function);
+  char buf[LONG_STRING];
+  char *str = buf;
+  char suffix[STRING] = "";
 
-  va_list ap;
+  if (level == LL_PERROR)
+    snprintf(suffix, sizeof(suffix), ": %s\n", strerror(err));
+  else if (level <= 0)
+    mutt_str_strfcpy(suffix, "\n", sizeof(suffix));
+
+  int len = snprintf(buf, sizeof(buf), "[%s]<%c> %s() ", timestamp(stamp),
+                     LevelAbbr[level + 3], function);
+  len = MIN(len, sizeof(buf) - 1);
+
+  va_list ap, ap_retry;
   va_start(ap, level);
   const char *fmt = va_arg(ap, const char *);
-  ret += vfprintf(LogFileFP, fmt, ap);
-  va_end(ap);
-
-  if (level == LL_PERROR)
+  va_copy(ap_retry, ap);
+  int msglen = vsnprintf(buf + len, sizeof(buf) - len, fmt, ap);
+  if (msglen < 0)
+    msglen = 0;
+
+  size_t slen = strlen(suffix);
+  size_t total = len + msglen + slen;
+  if (total >= sizeof(buf))
   {
-    fprintf(LogFileFP, ": %s\n", strerror(err));
+    /* The line is too long for the buffer on the stack */
+    str = mutt_mem_malloc(total + 1);
+    memcpy(str, buf, len);
+    vsnprintf(str + len, msglen + 1, fmt, ap_retry);
   }
-  else if (level <= 0)
-  {
-    fputs("\n", LogFileFP);
+  va_end(ap_retry);
+  va_end(ap);
+  memcpy(str + len + msglen, suffix, slen + 1);
+
+  log_file_puts(str, total, (level <= LL_MESSAGE));
+  if (str != buf)
+    FREE(&str);
+
+  int ret = len + msglen;
+  if ((level <= 0) && (level != LL_PERROR))
     ret++;
-  }
 
   return ret;
 }
@@ -496,3 +746,119 @@ int log_disp_terminal(time_t stamp, const char *file, int line,
 
   return ret;
 }
+
+#ifdef USE_TRACE
+/**
+ * trace_write_string - Write a JSON string to the trace file
+ * @param str  String to write
+ * @param verb If true, only write the first word
+ */
+static void trace_write_string(const char *str, bool verb)
+{
+  fputc('"', TraceFileFP);
+  for (; *str; str++)
+  {
+    unsigned char c = *str;
+    if (verb && ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n')))
+      break;
+    if ((c == '"') || (c == '\\'))
+      fprintf(TraceFileFP, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(TraceFileFP, "\\u%04x", c);
+    else
+      fputc(c, TraceFileFP);
+  }
+  fputc('"', TraceFileFP);
+}
+
+/**
+ * trace_event - Write an event to the trace file
+ * @param phase  Event type: 'B' begin span, 'E' end span, 'C' counter
+ * @param name   Name of the span or counter
+ * @param detail Extra information about a span, may be NULL
+ * @param verb   If true, only record the first word of detail
+ * @param value  Value of a counter
+ *
+ * The events are written in the Chrome Trace Event format, which can be read
+ * by chrome://tracing or https://ui.perfetto.dev
+ *
+ * @note Don't call this directly, use mutt_trace_begin(), mutt_trace_end() or
+ *       mutt_trace_count().
+ */
+void trace_event(char phase, const char *name, const char *detail, bool verb, long value)
+{
+  if (!TraceFileFP || !name)
+    return;
+
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#ifdef USE_THREADS
+  unsigned long tid = (unsigned long) pthread_self();
+#else
+  unsigned long tid = 1;
+#endif
+
+  fprintf(TraceFileFP, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%lu,\"ts\":%lld.%03ld,\"name\":", phase,
+          (int) getpid(), tid, (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000,
+          ts.tv_nsec % 1000);
+  trace_write_string(name, false);
+  if (phase == 'C')
+  {
+    fprintf(TraceFileFP, ",\"args\":{\"value\":%ld}", value);
+  }
+  else if (detail)
+  {
+    fputs(",\"args\":{\"detail\":", TraceFileFP);
+    trace_write_string(detail, verb);
+    fputc('}', TraceFileFP);
+  }
+  fputc('}', TraceFileFP);
+}
+
+/**
+ * trace_file_close - Close the trace file
+ *
+ * The JSON array is terminated, so the file is complete.
+ */
+void trace_file_close(void)
+{
+  if (!TraceFileFP)
+    return;
+
+  fputs("\n]\n", TraceFileFP);
+  mutt_file_fclose(&TraceFileFP);
+}
+
+/**
+ * trace_file_set_filename - Start or stop tracing to a file
+ * @param file Name to use, NULL or empty to stop tracing
+ * @retval  0 Success
+ * @retval -1 Error, see errno
+ *
+ * Any previous trace file is closed first.
+ */
+int trace_file_set_filename(const char *file)
+{
+  if (file && !*file)
+    file = NULL;
+
+  /* also handles both being NULL */
+  if (TraceFileFP && (mutt_str_strcmp(TraceFileName, file) == 0))
+    return 0;
+
+  trace_file_close();
+  mutt_str_replace(&TraceFileName, file);
+  if (!TraceFileName)
+    return 0;
+
+  TraceFileFP = mutt_file_fopen(TraceFileName, "w");
+  if (!TraceFileFP)
+    return -1;
+
+  /* The first element makes the commas before each event valid */
+  fprintf(TraceFileFP, "[\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\","
+                       "\"args\":{\"name\":\"NeoMutt%s\"}}",
+          (int) getpid(), NONULL(LogFileVersion));
+  return 0;
+}
+#endif
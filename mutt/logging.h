@@ -105,4 +105,20 @@ int  log_file_set_filename(const char *file, bool verbose);
 int  log_file_set_level(int level, bool verbose);
 void log_file_set_version(const char *version);
 
+#ifdef USE_TRACE
+void trace_event(char phase, const char *name, const char *detail, bool verb, long value);
+void trace_file_close(void);
+int  trace_file_set_filename(const char *file);
+
+#define mutt_trace_begin(NAME, DETAIL)     trace_event('B', NAME, DETAIL, false, 0)
+#define mutt_trace_begin_cmd(NAME, CMD)    trace_event('B', NAME, CMD,    true,  0)
+#define mutt_trace_end(NAME)               trace_event('E', NAME, NULL,   false, 0)
+#define mutt_trace_count(NAME, VALUE)      trace_event('C', NAME, NULL,   false, VALUE)
+#else
+#define mutt_trace_begin(NAME, DETAIL)
+#define mutt_trace_begin_cmd(NAME, CMD)
+#define mutt_trace_end(NAME)
+#define mutt_trace_count(NAME, VALUE)
+#endif
+
 #endif /* MUTT_LIB_LOGGING_H */
@@ -31,6 +31,7 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -43,6 +44,43 @@
 
 bool OptLocales; /**< (pseudo) set if user has valid locale definition */
 
+/**
+ * mutt_mb_ascii_len - Count the printable ASCII characters at the start of a string
+ * @param s String to be examined
+ * @param n Maximum number of bytes to examine
+ * @retval num Number of leading bytes in the range 0x20-0x7e
+ *
+ * In every locale, each of these characters is one byte and one screen
+ * column wide, so the callers can skip mbrtowc() and wcwidth() for them.
+ * Eight bytes are checked at a time.
+ *
+ * @note The caller must only skip them while the conversion state is the
+ *       initial one, see mbsinit().
+ */
+size_t mutt_mb_ascii_len(const char *s, size_t n)
+{
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  size_t i = 0;
+
+  if (!s)
+    return 0;
+
+  for (; (i + 8) <= n; i += 8)
+  {
+    uint64_t x;
+    memcpy(&x, s + i, sizeof(x));
+    /* any byte below 0x20, or above 0x7e */
+    if ((((x - (ones * 0x20)) & ~x) | (x + (ones * (127 - 0x7e))) | x) & highs)
+      break;
+  }
+
+  for (; (i < n) && (s[i] >= 0x20) && (s[i] < 0x7f); i++)
+    ;
+
+  return i;
+}
+
 /**
  * mutt_mb_charlen - Count the bytes in a (multibyte) character
  * @param[in]  s     String to be examined
@@ -61,7 +99,16 @@ int mutt_mb_charlen(const char *s, int *width)
   if (!s || !*s)
     return 0;
 
-  n = mutt_str_strlen(s);
+  if ((*s >= 0x20) && (*s < 0x7f))
+  {
+    if (width)
+      *width = 1;
+    return 1;
+  }
+
+  /* no character is longer than MB_LEN_MAX bytes */
+  for (n = 0; (n < MB_LEN_MAX) && s[n]; n++)
+    ;
   memset(&mbstate, 0, sizeof(mbstate));
   k = mbrtowc(&wc, s, n, &mbstate);
   if (width)
@@ -144,6 +191,14 @@ int mutt_mb_width(const char *str, int col, bool display)
 
   while (p && *p)
   {
+    /* printable ASCII, except space which may follow a newline */
+    if ((*p > 0x20) && (*p < 0x7f))
+    {
+      w++;
+      p++;
+      continue;
+    }
+
     if (mbtowc(&wc, p, MB_CUR_MAX) >= 0)
     {
       l = wcwidth(wc);
@@ -396,43 +451,72 @@ bool mutt_mb_is_display_corrupting_utf8(wchar_t wc)
 }
 
 /**
- * mutt_mb_filter_unprintable - Replace unprintable characters
- * @param[in,out] s String to modify
- * @retval  0 Success
- * @retval -1 Error
+ * mutt_mb_add_printable - Add a string to a Buffer, replacing unprintable characters
+ * @param buf Buffer for the result
+ * @param s   String to add
  *
  * Unprintable characters will be replaced with #ReplacementChar.
- *
- * @note The source string will be freed and a newly allocated string will be
- * returned in its place.  The caller should free the returned string.
  */
-int mutt_mb_filter_unprintable(char **s)
+void mutt_mb_add_printable(struct Buffer *buf, const char *s)
 {
   wchar_t wc;
   size_t k, k2;
   char scratch[MB_LEN_MAX + 1];
-  char *p = *s;
+  const char *p = s;
   mbstate_t mbstate1, mbstate2;
 
-  struct Buffer *b = mutt_buffer_new();
   memset(&mbstate1, 0, sizeof(mbstate1));
   memset(&mbstate2, 0, sizeof(mbstate2));
-  for (; (k = mbrtowc(&wc, p, MB_LEN_MAX, &mbstate1)); p += k)
+  /* make sure there's a string, even if it's empty */
+  mutt_buffer_add(buf, "", 0);
+  while (true)
   {
+    /* printable ASCII is added as it is */
+    const char *run = p;
+    while ((*p >= 0x20) && (*p < 0x7f))
+      p++;
+    if ((p > run) && mbsinit(&mbstate1) && mbsinit(&mbstate2))
+      mutt_buffer_add(buf, run, p - run);
+    else
+      p = run;
+
+    k = mbrtowc(&wc, p, MB_LEN_MAX, &mbstate1);
+    if (k == 0)
+      break;
+
     if ((k == (size_t) -1) || (k == (size_t) -2))
     {
       k = 1;
       memset(&mbstate1, 0, sizeof(mbstate1));
       wc = ReplacementChar;
     }
+    p += k;
+
     if (!IsWPrint(wc))
       wc = '?';
     else if (CharsetIsUtf8 && mutt_mb_is_display_corrupting_utf8(wc))
       continue;
     k2 = wcrtomb(scratch, wc, &mbstate2);
     scratch[k2] = '\0';
-    mutt_buffer_addstr(b, scratch);
+    mutt_buffer_addstr(buf, scratch);
   }
+}
+
+/**
+ * mutt_mb_filter_unprintable - Replace unprintable characters
+ * @param[in,out] s String to modify
+ * @retval  0 Success
+ * @retval -1 Error
+ *
+ * Unprintable characters will be replaced with #ReplacementChar.
+ *
+ * @note The source string will be freed and a newly allocated string will be
+ * returned in its place.  The caller should free the returned string.
+ */
+int mutt_mb_filter_unprintable(char **s)
+{
+  struct Buffer *b = mutt_buffer_new();
+  mutt_mb_add_printable(b, *s);
   FREE(s);
   *s = b->data ? b->data : mutt_mem_calloc(1, 1);
   FREE(&b);
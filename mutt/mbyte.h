@@ -29,6 +29,8 @@
 #include <wchar.h>
 #include <wctype.h>
 
+struct Buffer;
+
 extern bool OptLocales;
 
 #ifdef LOCALES_HACK
@@ -41,6 +43,8 @@ extern bool OptLocales;
 #define IsWPrint(wc) (iswprint(wc) || (OptLocales ? 0 : (wc >= 0xa0)))
 #endif
 
+void   mutt_mb_add_printable(struct Buffer *buf, const char *s);
+size_t mutt_mb_ascii_len(const char *s, size_t n);
 int    mutt_mb_charlen(const char *s, int *width);
 int    mutt_mb_filter_unprintable(char **s);
 bool   mutt_mb_get_initials(const char *name, char *buf, size_t buflen);
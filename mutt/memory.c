@@ -27,16 +27,45 @@
  *
  * @note If any of the allocators fail, the user is notified and the program is
  *       stopped immediately.
+ *
+ * The `_tag` allocators also count the memory in use by a category, e.g. all
+ * the Emails.  The caller must pass the same size when the block is freed.
  */
 
 #include "config.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "memory.h"
 #include "exit.h"
 #include "logging.h"
 #include "message.h"
 
+#ifdef USE_THREADS
+/* Emails may be created by worker threads */
+#define MEM_ADD(var, n) __atomic_add_fetch(&(var), (n), __ATOMIC_RELAXED)
+#else
+#define MEM_ADD(var, n) ((var) += (n))
+#endif
+
+static struct MemStats MemTagStats[MEM_TAG_MAX]; ///< Memory use of each category
+
+// clang-format off
+/**
+ * MemTagNames - Names of the memory categories
+ */
+static const char *const MemTagNames[] = {
+  "email",
+  "envelope",
+  "thread",
+  "pager",
+  "buffer_pool",
+  "hash",
+  "hcache",
+};
+// clang-format on
+
 /**
  * mutt_mem_calloc - Allocate zeroed memory on the heap
  * @param nmemb Number of blocks
@@ -145,3 +174,124 @@ void mutt_mem_realloc(void *ptr, size_t size)
 
   *p = r;
 }
+
+/**
+ * mutt_mem_account - Count some memory against a category
+ * @param tag     Category, e.g. #MEM_TAG_EMAIL
+ * @param bytes   Change in the bytes in use
+ * @param objects Change in the blocks in use
+ *
+ * This is for memory that isn't allocated by the `_tag` functions, e.g. memory
+ * that changes hands.
+ */
+void mutt_mem_account(enum MemTag tag, long bytes, int objects)
+{
+  if (tag >= MEM_TAG_MAX)
+    return;
+
+  struct MemStats *st = &MemTagStats[tag];
+  size_t now = MEM_ADD(st->bytes, bytes);
+  MEM_ADD(st->objects, objects);
+
+  /* A race may lose a peak, but never corrupts it */
+  if ((bytes > 0) && (now > st->peak))
+    st->peak = now;
+}
+
+/**
+ * mutt_mem_calloc_tag - Allocate zeroed memory for a category
+ * @param tag   Category, e.g. #MEM_TAG_EMAIL
+ * @param nmemb Number of blocks
+ * @param size  Size of blocks
+ * @retval ptr Memory on the heap
+ *
+ * The caller should call mutt_mem_free_tag() to release the memory
+ */
+void *mutt_mem_calloc_tag(enum MemTag tag, size_t nmemb, size_t size)
+{
+  void *p = mutt_mem_calloc(nmemb, size);
+  if (p)
+    mutt_mem_account(tag, nmemb * size, 1);
+  return p;
+}
+
+/**
+ * mutt_mem_free_tag - Release the memory of a category
+ * @param tag  Category, e.g. #MEM_TAG_EMAIL
+ * @param ptr  Memory to release
+ * @param size Size of the block, as allocated
+ */
+void mutt_mem_free_tag(enum MemTag tag, void *ptr, size_t size)
+{
+  if (!ptr || !*(void **) ptr)
+    return;
+
+  mutt_mem_account(tag, -(long) size, -1);
+  mutt_mem_free(ptr);
+}
+
+/**
+ * mutt_mem_malloc_tag - Allocate memory for a category
+ * @param tag  Category, e.g. #MEM_TAG_EMAIL
+ * @param size Size of block to allocate
+ * @retval ptr Memory on the heap
+ *
+ * The caller should call mutt_mem_free_tag() to release the memory
+ */
+void *mutt_mem_malloc_tag(enum MemTag tag, size_t size)
+{
+  void *p = mutt_mem_malloc(size);
+  if (p)
+    mutt_mem_account(tag, size, 1);
+  return p;
+}
+
+/**
+ * mutt_mem_realloc_tag - Resize the memory of a category
+ * @param tag      Category, e.g. #MEM_TAG_EMAIL
+ * @param ptr      Memory block to resize
+ * @param old_size Current size of the block, 0 if it's NULL
+ * @param size     New size
+ */
+void mutt_mem_realloc_tag(enum MemTag tag, void *ptr, size_t old_size, size_t size)
+{
+  const bool had = (*(void **) ptr != NULL);
+
+  mutt_mem_realloc(ptr, size);
+
+  const bool has = (*(void **) ptr != NULL);
+  mutt_mem_account(tag, (had ? -(long) old_size : 0) + (has ? (long) size : 0),
+                   (int) has - (int) had);
+}
+
+/**
+ * mutt_mem_stats - Get the memory use of a category
+ * @param[in]  tag   Category, e.g. #MEM_TAG_EMAIL
+ * @param[out] stats Memory use
+ */
+void mutt_mem_stats(enum MemTag tag, struct MemStats *stats)
+{
+  if (!stats)
+    return;
+
+  if (tag >= MEM_TAG_MAX)
+  {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+
+  *stats = MemTagStats[tag];
+}
+
+/**
+ * mutt_mem_tag_name - Get the name of a memory category
+ * @param tag Category, e.g. #MEM_TAG_EMAIL
+ * @retval ptr Name, e.g. "email"
+ */
+const char *mutt_mem_tag_name(enum MemTag tag)
+{
+  if (tag >= MEM_TAG_MAX)
+    return NULL;
+
+  return MemTagNames[tag];
+}
@@ -38,11 +38,46 @@
 #define mutt_bit_toggle(v, n) v[n / 8] ^= (1 << (n % 8))
 #define mutt_bit_isset(v, n)  (v[n / 8] & (1 << (n % 8)))
 
+/**
+ * enum MemTag - Categories of memory, for accounting
+ *
+ * Only the allocations that are made with a tag are counted.
+ */
+enum MemTag
+{
+  MEM_TAG_EMAIL = 0,   ///< struct Email
+  MEM_TAG_ENVELOPE,    ///< struct Envelope
+  MEM_TAG_THREAD,      ///< Thread nodes, struct MuttThread
+  MEM_TAG_PAGER,       ///< Pager line arrays, struct Line
+  MEM_TAG_BUFFER_POOL, ///< Idle Buffers in the pool
+  MEM_TAG_HASH,        ///< Hash tables, buckets and elements
+  MEM_TAG_HCACHE,      ///< Header cache write queue
+  MEM_TAG_MAX,
+};
+
+/**
+ * struct MemStats - Memory use of one category
+ */
+struct MemStats
+{
+  size_t bytes;   ///< Bytes in use
+  size_t objects; ///< Blocks in use
+  size_t peak;    ///< Most bytes in use at once
+};
+
 void *mutt_mem_calloc(size_t nmemb, size_t size);
 void  mutt_mem_free(void *ptr);
 void *mutt_mem_malloc(size_t size);
 void  mutt_mem_realloc(void *ptr, size_t size);
 
+void        mutt_mem_account    (enum MemTag tag, long bytes, int objects);
+void *      mutt_mem_calloc_tag (enum MemTag tag, size_t nmemb, size_t size);
+void        mutt_mem_free_tag   (enum MemTag tag, void *ptr, size_t size);
+void *      mutt_mem_malloc_tag (enum MemTag tag, size_t size);
+void        mutt_mem_realloc_tag(enum MemTag tag, void *ptr, size_t old_size, size_t size);
+void        mutt_mem_stats      (enum MemTag tag, struct MemStats *stats);
+const char *mutt_mem_tag_name   (enum MemTag tag);
+
 #define FREE(x) mutt_mem_free(x)
 
 #endif /* MUTT_LIB_MEMORY_H */
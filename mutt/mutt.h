@@ -42,6 +42,7 @@
  * | mutt/mbyte.c     | @subpage mbyte     |
  * | mutt/md5.c       | @subpage md5       |
  * | mutt/memory.c    | @subpage memory    |
+ * | mutt/parallel.c  | @subpage parallel  |
  * | mutt/path.c      | @subpage path      |
  * | mutt/regex.c     | @subpage regex     |
  * | mutt/sha1.c      | @subpage sha1      |
@@ -71,6 +72,7 @@
 #include "md5.h"
 #include "memory.h"
 #include "message.h"
+#include "parallel.h"
 #include "queue.h"
 #include "path.h"
 #include "regex3.h"
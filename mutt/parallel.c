@@ -0,0 +1,654 @@
+/**
+ * @file
+ * Spread independent work items over several threads
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @page parallel Spread independent work items over several threads
+ *
+ * A small pool of worker threads runs tasks in the background.  Each worker
+ * has a queue of its own.  A worker runs its newest task first and, when its
+ * queue is empty, steals the oldest task from another worker.
+ *
+ * A task may have a completion callback.  The completions are never run by the
+ * workers; they're collected and run by mutt_task_dispatch(), which is called
+ * from mutt_getch() while NeoMutt waits for a key.  The callbacks run in the
+ * main thread, so they may update the screen, the Context and the Config.
+ *
+ * mutt_parallel_for() runs a function over a range of work items.  The items
+ * are handed out one at a time, so slow items don't hold up the rest.  The
+ * calling thread takes part in the work and is the only one to report
+ * progress, so the progress callback may safely update the screen.
+ *
+ * The work functions must only touch their own item and data that isn't
+ * changed while they're running.  Most of NeoMutt relies on global state, so
+ * only these may be used from a worker:
+ *
+ * | Safe to call from a worker                     | Notes                         |
+ * | :--------------------------------------------- | :---------------------------- |
+ * | mutt_buffer_pool_get(), mutt_buffer_pool_release() | The pool is private to each thread |
+ * | mutt_mem_malloc() and friends, mutt_str_*()    | Memory stats are atomic       |
+ * | mutt_ch_iconv_get(), mutt_ch_convert_string()  | The iconv cache is private to each thread |
+ * | mutt_debug(), mutt_error(), mutt_message()     | Messages are queued           |
+ * | mutt_file_*(), mutt_hash_*(), mutt_list_*()    | On the caller's own objects   |
+ * | mutt_rfc2047_decode(), mutt_rfc822_read_header() | Address strings are locked |
+ * | mutt_email_new(), mutt_env_new(), mutt_body_new() | And their free functions   |
+ * | mutt_regexlist_match(), mutt_group_match()     | Only read the lists           |
+ * | mutt_is_mail_list(), mutt_is_subscribed_list() | The list cache is locked      |
+ * | mutt_addr_is_user(), mutt_alias_reverse_lookup() | Only read the Config and aliases |
+ *
+ * | Unsafe, from the main thread only              | Why                           |
+ * | :--------------------------------------------- | :---------------------------- |
+ * | mutt_ch_get_default_charset()                  | Returns a static buffer       |
+ * | mutt_replacelist_apply()                       | Uses static buffers           |
+ * | mutt_addr_for_display(), mutt_idna_*()         | Return a static buffer        |
+ * | mutt_regexlist_add(), mutt_regexlist_remove()  | Change the lists under the workers |
+ * | mutt_replacelist_add(), mutt_replacelist_remove() | Change the lists under the workers |
+ * | mutt_hist_*()                                  | Share the history rings       |
+ * | driver_tags_get() and the other getters        | Update the interned tags      |
+ * | mutt_ch_lookup_add(), cs_str_*()               | Change the Config under the workers |
+ * | Anything touching Context, CurrentMenu or curses |                             |
+ *
+ * If NeoMutt is built without thread support, the tasks are run when they're
+ * submitted and the items are processed in order by the calling thread.
+ */
+
+#include "config.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef USE_THREADS
+#include <pthread.h>
+#include <signal.h>
+#endif
+#include "parallel.h"
+#include "buffer.h"
+#include "charset.h"
+#include "logging.h"
+#include "memory.h"
+
+/**
+ * struct Task - A piece of work for the pool
+ */
+struct Task
+{
+  task_work_t work; ///< Function to do the work
+  task_done_t done; ///< Completion, run in the main thread (OPTIONAL)
+  void *data;       ///< Private data for the callbacks
+};
+
+/**
+ * struct TaskList - Tasks waiting for their completions to be run
+ */
+struct TaskList
+{
+  struct Task *tasks; ///< Array of tasks
+  size_t count;       ///< Number of tasks in the array
+  size_t max;         ///< Size of the array
+  size_t pending;     ///< Tasks with a completion that haven't been dispatched
+};
+
+static struct TaskList Completions = { 0 };
+
+#ifdef USE_THREADS
+#define POOL_MAX_THREADS 64
+
+/**
+ * struct TaskQueue - One worker's queue of tasks
+ *
+ * The owner takes tasks from the tail, thieves from the head.
+ */
+struct TaskQueue
+{
+  pthread_mutex_t lock; ///< Protects the ring
+  struct Task *ring;    ///< Ring of tasks
+  size_t size;          ///< Size of the ring
+  size_t head;          ///< Position of the oldest task
+  size_t count;         ///< Number of tasks in the ring
+};
+
+/**
+ * struct TaskPool - The worker threads
+ */
+struct TaskPool
+{
+  pthread_mutex_t lock;     ///< Protects everything but the queues
+  pthread_cond_t work_cond; ///< Signalled when a task is queued
+  pthread_cond_t idle_cond; ///< Signalled when the pool runs out of work
+  size_t queued;            ///< Number of tasks in the queues
+  size_t running;           ///< Number of tasks being run
+  bool stopping;            ///< The workers should exit once the queues are empty
+  int num_workers;          ///< Number of worker threads
+  unsigned int next_queue;  ///< Queue for the next task from outside the pool
+  pthread_t tids[POOL_MAX_THREADS];             ///< Worker threads
+  struct TaskQueue queues[POOL_MAX_THREADS];    ///< One queue per worker
+};
+
+static struct TaskPool Pool = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .work_cond = PTHREAD_COND_INITIALIZER,
+  .idle_cond = PTHREAD_COND_INITIALIZER,
+};
+static pthread_mutex_t CompletionsLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int WorkerId = -1; ///< Index of this thread in the pool, or -1
+
+#define COMPLETIONS_LOCK() pthread_mutex_lock(&CompletionsLock)
+#define COMPLETIONS_UNLOCK() pthread_mutex_unlock(&CompletionsLock)
+#else
+#define COMPLETIONS_LOCK()
+#define COMPLETIONS_UNLOCK()
+#endif
+
+/**
+ * completion_add - Queue a task's completion for the main thread
+ * @param task Task that has been run
+ */
+static void completion_add(struct Task *task)
+{
+  COMPLETIONS_LOCK();
+  if (Completions.count == Completions.max)
+  {
+    Completions.max = Completions.max ? (Completions.max * 2) : 16;
+    mutt_mem_realloc(&Completions.tasks, Completions.max * sizeof(struct Task));
+  }
+  Completions.tasks[Completions.count++] = *task;
+  COMPLETIONS_UNLOCK();
+}
+
+#ifdef USE_THREADS
+/**
+ * queue_push - Add a task to the tail of a queue
+ * @param q    Queue
+ * @param task Task to add
+ */
+static void queue_push(struct TaskQueue *q, struct Task *task)
+{
+  pthread_mutex_lock(&q->lock);
+  if (q->count == q->size)
+  {
+    size_t size = q->size ? (q->size * 2) : 16;
+    struct Task *ring = mutt_mem_calloc(size, sizeof(struct Task));
+    for (size_t i = 0; i < q->count; i++)
+      ring[i] = q->ring[(q->head + i) % q->size];
+    FREE(&q->ring);
+    q->ring = ring;
+    q->size = size;
+    q->head = 0;
+  }
+  q->ring[(q->head + q->count) % q->size] = *task;
+  q->count++;
+  pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * queue_pop - Take a task from a queue
+ * @param[in]  q    Queue
+ * @param[in]  tail true to take the newest task, false for the oldest
+ * @param[out] task Task that was taken
+ * @retval true A task was taken
+ */
+static bool queue_pop(struct TaskQueue *q, bool tail, struct Task *task)
+{
+  bool found = false;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->count > 0)
+  {
+    if (tail)
+    {
+      *task = q->ring[(q->head + q->count - 1) % q->size];
+    }
+    else
+    {
+      *task = q->ring[q->head];
+      q->head = (q->head + 1) % q->size;
+    }
+    q->count--;
+    found = true;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  return found;
+}
+
+/**
+ * pool_take - Take a task, from our own queue or another worker's
+ * @param[in]  id   Index of the worker
+ * @param[in]  num  Number of queues
+ * @param[out] task Task that was taken
+ *
+ * The caller has already reserved a task from Pool.queued, so there is
+ * always one to be found.
+ */
+static void pool_take(int id, int num, struct Task *task)
+{
+  while (true)
+  {
+    if (queue_pop(&Pool.queues[id], true, task))
+      return;
+    for (int i = 1; i < num; i++)
+      if (queue_pop(&Pool.queues[(id + i) % num], false, task))
+        return;
+  }
+}
+
+/**
+ * pool_worker - Run tasks until the pool is shut down
+ * @param arg Index of the worker
+ * @retval NULL Always
+ */
+static void *pool_worker(void *arg)
+{
+  WorkerId = (int) (intptr_t) arg;
+
+  pthread_mutex_lock(&Pool.lock);
+  while (true)
+  {
+    while ((Pool.queued == 0) && !Pool.stopping)
+      pthread_cond_wait(&Pool.work_cond, &Pool.lock);
+    if (Pool.queued == 0)
+      break;
+
+    Pool.queued--;
+    Pool.running++;
+    const int num = Pool.num_workers;
+    pthread_mutex_unlock(&Pool.lock);
+
+    struct Task task;
+    pool_take(WorkerId, num, &task);
+    task.work(task.data);
+    if (task.done)
+      completion_add(&task);
+
+    pthread_mutex_lock(&Pool.lock);
+    Pool.running--;
+    if ((Pool.queued == 0) && (Pool.running == 0))
+      pthread_cond_broadcast(&Pool.idle_cond);
+  }
+  pthread_mutex_unlock(&Pool.lock);
+
+  mutt_buffer_pool_free();
+  mutt_ch_iconv_cache_clear();
+  return NULL;
+}
+
+/**
+ * pool_grow - Start more worker threads
+ * @param threads Number of workers wanted
+ * @retval num Number of workers running
+ *
+ * @note The caller must hold Pool.lock
+ */
+static int pool_grow(int threads)
+{
+  if (threads > POOL_MAX_THREADS)
+    threads = POOL_MAX_THREADS;
+  if (Pool.stopping || (threads <= Pool.num_workers))
+    return Pool.num_workers;
+
+  /* Signals must be handled by the main thread */
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+
+  while (Pool.num_workers < threads)
+  {
+    const int id = Pool.num_workers;
+    pthread_mutex_init(&Pool.queues[id].lock, NULL);
+    if (pthread_create(&Pool.tids[id], NULL, pool_worker, (void *) (intptr_t) id) != 0)
+    {
+      pthread_mutex_destroy(&Pool.queues[id].lock);
+      break;
+    }
+    Pool.num_workers++;
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  mutt_debug(3, "%d worker threads\n", Pool.num_workers);
+  return Pool.num_workers;
+}
+#endif
+
+/**
+ * mutt_pool_resize - Set the number of worker threads
+ * @param threads Number of workers wanted
+ * @retval num Number of workers running
+ *
+ * The pool only grows; the workers are kept until mutt_pool_shutdown().
+ */
+int mutt_pool_resize(int threads)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&Pool.lock);
+  int num = pool_grow(threads);
+  pthread_mutex_unlock(&Pool.lock);
+  return num;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * mutt_pool_shutdown - Stop the worker threads
+ *
+ * The workers finish every queued task before they exit.  Then the
+ * outstanding completions are run.
+ */
+void mutt_pool_shutdown(void)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&Pool.lock);
+  Pool.stopping = true;
+  pthread_cond_broadcast(&Pool.work_cond);
+  const int num = Pool.num_workers;
+  pthread_mutex_unlock(&Pool.lock);
+
+  for (int i = 0; i < num; i++)
+  {
+    pthread_join(Pool.tids[i], NULL);
+    pthread_mutex_destroy(&Pool.queues[i].lock);
+    FREE(&Pool.queues[i].ring);
+    Pool.queues[i].size = 0;
+  }
+
+  pthread_mutex_lock(&Pool.lock);
+  Pool.num_workers = 0;
+  Pool.stopping = false;
+  pthread_mutex_unlock(&Pool.lock);
+#endif
+
+  mutt_task_dispatch();
+  FREE(&Completions.tasks);
+  Completions.max = 0;
+}
+
+/**
+ * mutt_task_submit - Run a task in the background
+ * @param work Function to do the work
+ * @param done Completion, run in the main thread by mutt_task_dispatch() (OPTIONAL)
+ * @param data Private data passed to both callbacks
+ *
+ * If there are no workers, the work is done before this returns.
+ * A task submitted by a worker goes to the front of that worker's own queue.
+ */
+void mutt_task_submit(task_work_t work, task_done_t done, void *data)
+{
+  if (!work)
+    return;
+
+  struct Task task = { .work = work, .done = done, .data = data };
+
+  if (done)
+  {
+    COMPLETIONS_LOCK();
+    Completions.pending++;
+    COMPLETIONS_UNLOCK();
+  }
+
+#ifdef USE_THREADS
+  pthread_mutex_lock(&Pool.lock);
+  if ((Pool.num_workers > 0) && !Pool.stopping)
+  {
+    int q = WorkerId;
+    if (q < 0)
+      q = Pool.next_queue++ % Pool.num_workers;
+    queue_push(&Pool.queues[q], &task);
+    Pool.queued++;
+    pthread_cond_signal(&Pool.work_cond);
+    pthread_mutex_unlock(&Pool.lock);
+    return;
+  }
+  pthread_mutex_unlock(&Pool.lock);
+#endif
+
+  work(data);
+  if (done)
+    completion_add(&task);
+}
+
+/**
+ * mutt_task_dispatch - Run the completions of the finished tasks
+ * @retval num Number of completions run
+ *
+ * @note This must only be called from the main thread
+ */
+int mutt_task_dispatch(void)
+{
+  COMPLETIONS_LOCK();
+  struct Task *tasks = Completions.tasks;
+  size_t count = Completions.count;
+  size_t max = Completions.max;
+  Completions.tasks = NULL;
+  Completions.count = 0;
+  Completions.max = 0;
+  COMPLETIONS_UNLOCK();
+
+  /* a completion may submit more tasks */
+  for (size_t i = 0; i < count; i++)
+    tasks[i].done(tasks[i].data);
+
+  COMPLETIONS_LOCK();
+  Completions.pending -= count;
+  if (!Completions.tasks)
+  {
+    /* Reuse the array */
+    Completions.tasks = tasks;
+    Completions.max = max;
+    tasks = NULL;
+  }
+  COMPLETIONS_UNLOCK();
+
+  FREE(&tasks);
+  return count;
+}
+
+/**
+ * mutt_task_pending - How many completions are still to be run?
+ * @retval num Number of tasks with a completion that haven't been dispatched
+ */
+size_t mutt_task_pending(void)
+{
+  COMPLETIONS_LOCK();
+  size_t pending = Completions.pending;
+  COMPLETIONS_UNLOCK();
+  return pending;
+}
+
+/**
+ * mutt_task_wait - Wait for every task to finish
+ *
+ * Then run their completions.
+ *
+ * @note This must only be called from the main thread
+ */
+void mutt_task_wait(void)
+{
+#ifdef USE_THREADS
+  pthread_mutex_lock(&Pool.lock);
+  while ((Pool.queued > 0) || (Pool.running > 0))
+    pthread_cond_wait(&Pool.idle_cond, &Pool.lock);
+  pthread_mutex_unlock(&Pool.lock);
+#endif
+  mutt_task_dispatch();
+}
+
+#ifdef USE_THREADS
+/**
+ * struct ParallelRange - A range of items shared by the threads
+ *
+ * The caller and the helpers share the range.  Helpers that start after the
+ * work is over just drop their reference; the last one out frees it.
+ */
+struct ParallelRange
+{
+  pthread_mutex_t lock;  ///< Protects everything below
+  pthread_cond_t idle;   ///< Signalled when a helper stops
+  size_t next;           ///< Next item to hand out
+  size_t done;           ///< Number of items finished
+  size_t n;              ///< Total number of items
+  int running;           ///< Number of helpers processing items
+  int refs;              ///< Number of users of the range
+  parallel_work_t work;  ///< Function to process an item
+  void *data;            ///< Private data for the work function
+};
+
+/**
+ * range_next - Finish one item and get the next one
+ * @param range    Range of items
+ * @param finished true if an item has just been processed
+ * @param done     Set to the number of items finished (OPTIONAL)
+ * @retval num Index of the next item, or range->n if there are none left
+ */
+static size_t range_next(struct ParallelRange *range, bool finished, size_t *done)
+{
+  pthread_mutex_lock(&range->lock);
+  if (finished)
+    range->done++;
+  if (done)
+    *done = range->done;
+  size_t i = range->next;
+  if (i < range->n)
+    range->next++;
+  pthread_mutex_unlock(&range->lock);
+
+  return i;
+}
+
+/**
+ * range_unref - Drop a reference to a range
+ * @param range Range of items, locked
+ *
+ * The range is unlocked, or freed if this was the last reference.
+ */
+static void range_unref(struct ParallelRange *range)
+{
+  const int refs = --range->refs;
+  pthread_mutex_unlock(&range->lock);
+  if (refs > 0)
+    return;
+
+  pthread_mutex_destroy(&range->lock);
+  pthread_cond_destroy(&range->idle);
+  FREE(&range);
+}
+
+/**
+ * range_helper - Process items until there are none left - Implements ::task_work_t
+ */
+static void range_helper(void *data)
+{
+  struct ParallelRange *range = data;
+
+  pthread_mutex_lock(&range->lock);
+  if (range->next >= range->n)
+  {
+    range_unref(range);
+    return;
+  }
+  range->running++;
+  /* the caller won't return while we're running */
+  parallel_work_t work = range->work;
+  void *work_data = range->data;
+  pthread_mutex_unlock(&range->lock);
+
+  for (size_t i = range_next(range, false, NULL); i < range->n;
+       i = range_next(range, true, NULL))
+  {
+    work(i, work_data);
+  }
+
+  pthread_mutex_lock(&range->lock);
+  range->running--;
+  pthread_cond_signal(&range->idle);
+  range_unref(range);
+}
+#endif
+
+/**
+ * mutt_parallel_for - Process a range of items using several threads
+ * @param n        Number of items
+ * @param threads  Number of threads to use, including the calling thread
+ * @param work     Function to process one item
+ * @param progress Function to report progress (OPTIONAL)
+ * @param data     Private data passed to the callbacks
+ *
+ * This returns once every item has been processed.
+ */
+void mutt_parallel_for(size_t n, int threads, parallel_work_t work,
+                       parallel_progress_t progress, void *data)
+{
+  if (!work || (n == 0))
+    return;
+
+#ifdef USE_THREADS
+  if ((size_t) threads > n)
+    threads = n;
+
+  int helpers = 0;
+  if (threads > 1)
+  {
+    helpers = mutt_pool_resize(threads - 1);
+    if (helpers > (threads - 1))
+      helpers = threads - 1;
+  }
+
+  if (helpers > 0)
+  {
+    struct ParallelRange *range = mutt_mem_calloc(1, sizeof(*range));
+    pthread_mutex_init(&range->lock, NULL);
+    pthread_cond_init(&range->idle, NULL);
+    range->n = n;
+    range->work = work;
+    range->data = data;
+    range->refs = helpers + 1;
+
+    for (int i = 0; i < helpers; i++)
+      mutt_task_submit(range_helper, NULL, range);
+    mutt_debug(3, "%d threads for %zu items\n", helpers + 1, n);
+
+    size_t done = 0;
+    for (size_t i = range_next(range, false, &done); i < n;
+         i = range_next(range, true, &done))
+    {
+      if (progress)
+        progress(done, data);
+      work(i, data);
+    }
+
+    pthread_mutex_lock(&range->lock);
+    while (range->running > 0)
+      pthread_cond_wait(&range->idle, &range->lock);
+    range_unref(range);
+
+    if (progress)
+      progress(n, data);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if (progress)
+      progress(i, data);
+    work(i, data);
+  }
+  if (progress)
+    progress(n, data);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * Spread independent work items over several threads
+ *
+ * @authors
+ * Copyright (C) 2018 The NeoMutt Team
+ *
+ * @copyright
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUTT_LIB_PARALLEL_H
+#define MUTT_LIB_PARALLEL_H
+
+#include <stddef.h>
+
+/**
+ * typedef parallel_work_t - Process one work item
+ * @param i    Index of the item, 0 to n-1
+ * @param data Private data passed to mutt_parallel_for()
+ *
+ * @note This may be called from any thread, at the same time as other items.
+ */
+typedef void (*parallel_work_t)(size_t i, void *data);
+
+/**
+ * typedef parallel_progress_t - Report how much work has been done
+ * @param done Number of items processed so far
+ * @param data Private data passed to mutt_parallel_for()
+ *
+ * @note This is only called from the calling thread.
+ */
+typedef void (*parallel_progress_t)(size_t done, void *data);
+
+/**
+ * typedef task_work_t - Do the work of a background task
+ * @param data Private data passed to mutt_task_submit()
+ *
+ * @note This is called from a worker thread.
+ */
+typedef void (*task_work_t)(void *data);
+
+/**
+ * typedef task_done_t - Finish a background task
+ * @param data Private data passed to mutt_task_submit()
+ *
+ * @note This is only called from the main thread, by mutt_task_dispatch().
+ */
+typedef void (*task_done_t)(void *data);
+
+void   mutt_parallel_for(size_t n, int threads, parallel_work_t work,
+                         parallel_progress_t progress, void *data);
+int    mutt_pool_resize(int threads);
+void   mutt_pool_shutdown(void);
+int    mutt_task_dispatch(void);
+size_t mutt_task_pending(void);
+void   mutt_task_submit(task_work_t work, task_done_t done, void *data);
+void   mutt_task_wait(void);
+
+#endif /* MUTT_LIB_PARALLEL_H */
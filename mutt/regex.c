@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "buffer.h"
+#include "hash.h"
 #include "logging.h"
 #include "mbyte.h"
 #include "memory.h"
@@ -41,6 +42,47 @@
 #include "regex3.h"
 #include "string2.h"
 
+/**
+ * RegexListPatterns - Index of the patterns of all the RegexLists
+ *
+ * The key is the pattern of a RegexListNode and the data is the RegexList it
+ * belongs to.  This lets the config commands check for duplicates without
+ * walking the whole list.
+ */
+static struct Hash *RegexListPatterns = NULL;
+
+/**
+ * regexlist_find - Is a pattern in a RegexList?
+ * @param rl  RegexList to search
+ * @param str Pattern to look for (case-insensitive)
+ * @retval true The pattern is in the list
+ */
+static bool regexlist_find(struct RegexList *rl, const char *str)
+{
+  if (!RegexListPatterns)
+    return false;
+
+  for (struct HashElem *he = mutt_hash_find_bucket(RegexListPatterns, str); he; he = he->next)
+  {
+    if ((he->data == rl) && (mutt_str_strcasecmp(he->key.strkey, str) == 0))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * regexlist_free_node - Free a RegexListNode, after it's left its list
+ * @param rl RegexList the node was in
+ * @param np Node to free
+ */
+static void regexlist_free_node(struct RegexList *rl, struct RegexListNode **np)
+{
+  if (RegexListPatterns && (*np)->regex)
+    mutt_hash_delete(RegexListPatterns, (*np)->regex->pattern, rl);
+  mutt_regex_free(&(*np)->regex);
+  FREE(np);
+}
+
 /**
  * mutt_regex_compile - Create an Regex from a string
  * @param str   Regular expression
@@ -130,6 +172,10 @@ int mutt_regexlist_add(struct RegexList *rl, const char *str, int flags, struct
   if (!str || !*str)
     return 0;
 
+  /* check to make sure the item is not already on this rl */
+  if (regexlist_find(rl, str))
+    return 0;
+
   struct Regex *rx = mutt_regex_compile(str, flags);
   if (!rx)
   {
@@ -137,24 +183,13 @@ int mutt_regexlist_add(struct RegexList *rl, const char *str, int flags, struct
     return -1;
   }
 
-  /* check to make sure the item is not already on this rl */
-  struct RegexListNode *np = NULL;
-  STAILQ_FOREACH(np, rl, entries)
-  {
-    if (mutt_str_strcasecmp(rx->pattern, np->regex->pattern) == 0)
-      break; /* already on the rl */
-  }
+  if (!RegexListPatterns)
+    RegexListPatterns = mutt_hash_create(256, MUTT_HASH_STRCASECMP | MUTT_HASH_ALLOW_DUPS);
 
-  if (np)
-  {
-    mutt_regex_free(&rx);
-  }
-  else
-  {
-    np = mutt_regexlist_new();
-    np->regex = rx;
-    STAILQ_INSERT_TAIL(rl, np, entries);
-  }
+  struct RegexListNode *np = mutt_regexlist_new();
+  np->regex = rx;
+  STAILQ_INSERT_TAIL(rl, np, entries);
+  mutt_hash_insert(RegexListPatterns, rx->pattern, rl);
 
   return 0;
 }
@@ -172,8 +207,7 @@ void mutt_regexlist_free(struct RegexList *rl)
   STAILQ_FOREACH_SAFE(np, rl, entries, tmp)
   {
     STAILQ_REMOVE(rl, np, RegexListNode, entries);
-    mutt_regex_free(&np->regex);
-    FREE(&np);
+    regexlist_free_node(rl, &np);
   }
   STAILQ_INIT(rl);
 }
@@ -232,6 +266,9 @@ int mutt_regexlist_remove(struct RegexList *rl, const char *str)
     return 0;
   }
 
+  if (!regexlist_find(rl, str))
+    return -1;
+
   int rc = -1;
   struct RegexListNode *np = NULL, *tmp = NULL;
   STAILQ_FOREACH_SAFE(np, rl, entries, tmp)
@@ -239,8 +276,7 @@ int mutt_regexlist_remove(struct RegexList *rl, const char *str)
     if (mutt_str_strcasecmp(str, np->regex->pattern) == 0)
     {
       STAILQ_REMOVE(rl, np, RegexListNode, entries);
-      mutt_regex_free(&np->regex);
-      FREE(&np);
+      regexlist_free_node(rl, &np);
       rc = 0;
     }
   }
@@ -474,8 +510,9 @@ bool mutt_replacelist_match(struct ReplaceList *rl, char *buf, size_t buflen, co
   if (!rl || !buf || !str)
     return false;
 
-  static regmatch_t *pmatch = NULL;
-  static size_t nmatch = 0;
+  /* Not static, headers may be parsed by several threads at once */
+  regmatch_t *pmatch = NULL;
+  size_t nmatch = 0;
   int tlen = 0;
   char *p = NULL;
 
@@ -536,10 +573,12 @@ bool mutt_replacelist_match(struct ReplaceList *rl, char *buf, size_t buflen, co
         buf[tlen] = '\0';
         mutt_debug(5, "\"%s\"\n", buf);
       }
+      FREE(&pmatch);
       return true;
     }
   }
 
+  FREE(&pmatch);
   return false;
 }
 
@@ -892,6 +892,113 @@ int mutt_save_attachment(FILE *fp, struct Body *m, char *path, int flags, struct
   return 0;
 }
 
+/**
+ * save_attachment_read - Open a private stream onto an attachment
+ * @param fp Stream of the attachment's message
+ * @param m  Attachment
+ * @param[out] raw Buffer holding the attachment, to be freed by the caller
+ * @retval ptr  Stream holding just the attachment, starting at offset 0
+ * @retval NULL Error, see errno
+ *
+ * The part is read with pread(), which doesn't move the position of fp, so
+ * several threads can do this at once.
+ */
+static FILE *save_attachment_read(FILE *fp, struct Body *m, char **raw)
+{
+  const size_t len = m->length;
+  *raw = mutt_mem_malloc(len + 1);
+
+  size_t done = 0;
+  while (done < len)
+  {
+    ssize_t r = pread(fileno(fp), *raw + done, len - done, m->offset + done);
+    if (r < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return NULL;
+    }
+    if (r == 0)
+      break;
+    done += r;
+  }
+
+#ifdef USE_FMEMOPEN
+  if (done == 0) /* fmemopen cannot handle empty buffers */
+    return fopen("/dev/null", "r");
+  return fmemopen(*raw, done, "r");
+#else
+  FILE *fpin = mutt_file_mkstemp();
+  if (!fpin)
+    return NULL;
+  if ((fwrite(*raw, 1, done, fpin) != done) || (fseeko(fpin, 0, SEEK_SET) != 0))
+  {
+    const int save_errno = errno;
+    mutt_file_fclose(&fpin);
+    errno = save_errno;
+    return NULL;
+  }
+  return fpin;
+#endif
+}
+
+/**
+ * mutt_save_attachment_quiet - Save an attachment, without any user interaction
+ * @param fp    Source file stream (OPTIONAL)
+ * @param m     Attachment
+ * @param path  Where to save the attachment
+ * @param flags Flags, e.g. #MUTT_SAVE_APPEND
+ * @retval 0   Success
+ * @retval num errno of the failure
+ *
+ * This is the decode-and-write part of mutt_save_attachment(), for saving
+ * several attachments at once in worker threads.  Nothing is reported and fp
+ * isn't moved, but the caller must flush fp first.  Messages that would be
+ * saved to a mailbox must go through mutt_save_attachment().
+ */
+int mutt_save_attachment_quiet(FILE *fp, struct Body *m, char *path, int flags)
+{
+  if (!m || (!fp && !m->filename))
+    return EINVAL;
+
+  FILE *fpout = save_attachment_open(path, flags);
+  if (!fpout)
+    return errno ? errno : EIO;
+
+  int rc = 0;
+  if (fp)
+  {
+    char *raw = NULL;
+    FILE *fpin = save_attachment_read(fp, m, &raw);
+    if (fpin)
+    {
+      struct Body b = *m;
+      struct State s = { 0 };
+
+      b.offset = 0;
+      s.fpin = fpin;
+      s.fpout = fpout;
+      mutt_decode_attachment(&b, &s);
+      mutt_file_fclose(&fpin);
+    }
+    else
+      rc = errno ? errno : EIO;
+    FREE(&raw);
+  }
+  else
+  {
+    FILE *ofp = fopen(m->filename, "r");
+    if (!ofp || (mutt_file_copy_stream(ofp, fpout) == -1))
+      rc = errno ? errno : EIO;
+    mutt_file_fclose(&ofp);
+  }
+
+  if ((mutt_file_fsync_close(&fpout) != 0) && (rc == 0))
+    rc = errno ? errno : EIO;
+
+  return rc;
+}
+
 /**
  * mutt_decode_save_attachment - Decode, then save an attachment
  * @param fp         File to read from (OPTIONAL)
@@ -54,5 +54,6 @@ int mutt_get_tmp_attachment(struct Body *a);
 int mutt_pipe_attachment(FILE *fp, struct Body *b, const char *path, char *outfile);
 int mutt_print_attachment(FILE *fp, struct Body *a);
 int mutt_save_attachment(FILE *fp, struct Body *m, char *path, int flags, struct Email *e);
+int mutt_save_attachment_quiet(FILE *fp, struct Body *m, char *path, int flags);
 
 #endif /* MUTT_MUTT_ATTACH_H */
@@ -197,6 +197,8 @@ extern struct ColorLineHead ColorBodyList;
 extern struct ColorLineHead ColorAttachList;
 extern struct ColorLineHead ColorStatusList;
 extern struct ColorLineHead ColorIndexList;
+extern short ColorIndexMemoStatic;
+extern short ColorIndexMemoDynamic;
 extern struct ColorLineHead ColorIndexAuthorList;
 extern struct ColorLineHead ColorIndexFlagsList;
 extern struct ColorLineHead ColorIndexSubjectList;
@@ -47,6 +47,9 @@ struct timeval LastError = { 0 };
 
 short DebugLevel = 0;     ///< Config: Logging level for debug logs
 char *DebugFile = NULL;   ///< Config: File to save debug logs
+#ifdef USE_TRACE
+char *TraceFile = NULL;   ///< Config: File to save trace events
+#endif
 char *CurrentFile = NULL; /**< The previous log file name */
 const int NumOfLogs = 5;  /**< How many log files to rotate */
 
@@ -240,6 +243,9 @@ void mutt_log_prep(void)
 void mutt_log_stop(void)
 {
   log_file_close(false);
+#ifdef USE_TRACE
+  trace_file_set_filename(NULL);
+#endif
   FREE(&CurrentFile);
 }
 
@@ -298,6 +304,10 @@ int mutt_log_set_level(int level, bool verbose)
  */
 int mutt_log_start(void)
 {
+#ifdef USE_TRACE
+  trace_file_set_filename(TraceFile);
+#endif
+
   if (DebugLevel < 1)
     return 0;
 
@@ -344,6 +354,13 @@ bool mutt_log_listener(const struct ConfigSet *cs, struct HashElem *he,
     mutt_log_set_file(DebugFile, true);
   else if (mutt_str_strcmp(name, "debug_level") == 0)
     mutt_log_set_level(DebugLevel, true);
+#ifdef USE_TRACE
+  else if (mutt_str_strcmp(name, "trace_file") == 0)
+  {
+    if (trace_file_set_filename(TraceFile) != 0)
+      mutt_perror(TraceFile);
+  }
+#endif
 
   return true;
 }
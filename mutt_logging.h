@@ -29,6 +29,9 @@
 
 extern short DebugLevel;
 extern char *DebugFile;
+#ifdef USE_TRACE
+extern char *TraceFile;
+#endif
 extern bool LogAllowDebugSet;
 
 int log_disp_curses(time_t stamp, const char *file, int line, const char *function, int level, ...);
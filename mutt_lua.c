@@ -34,6 +34,7 @@
 #include "mutt.h"
 #include "mutt_lua.h"
 #include "globals.h"
+#include "hook.h"
 #include "mutt_commands.h"
 #include "mutt_options.h"
 #include "muttlib.h"
@@ -66,26 +67,96 @@ static int handle_error(lua_State *l)
   return -1;
 }
 
+#define LUA_MUTT_CONFIG "mutt.config"
+
 /**
- * lua_mutt_call - Call a NeoMutt command by name
- * @param l Lua State
- * @retval >=0 Success
+ * command_args_add - Add a Lua value to the arguments of a command
+ * @param l    Lua State
+ * @param idx  Stack index of the value
+ * @param args Buffer for the arguments
+ */
+static void command_args_add(lua_State *l, int idx, struct Buffer *args)
+{
+  const char *s = lua_tostring(l, idx);
+  if (!s)
+    return;
+  mutt_buffer_addstr(args, s);
+  mutt_buffer_addch(args, ' ');
+}
+
+/**
+ * command_run - Run a NeoMutt command on some prepared arguments
+ * @param cmd   Command to run
+ * @param args  Arguments, as they would follow the command in a config file
+ * @param token Scratch Buffer for the command's parser
+ * @param err   Buffer for error messages
+ * @retval  0 Success
  * @retval -1 Error
+ *
+ * The arguments are handed straight to the Command's parser, so the name of
+ * the command isn't looked up again.
  */
-static int lua_mutt_call(lua_State *l)
+static int command_run(const struct Command *cmd, struct Buffer *args,
+                       struct Buffer *token, struct Buffer *err)
 {
-  mutt_debug(2, " * lua_mutt_call()\n");
-  struct Buffer token, expn, err;
-  char buffer[LONG_STRING] = "";
-  const struct Command *command = NULL;
-  int rc = 0;
+  args->dptr = args->data;
+  return (cmd->func(token, args, cmd->data, err) == -1) ? -1 : 0;
+}
+
+/**
+ * command_call - Call a NeoMutt command with the arguments on the Lua stack
+ * @param l     Lua State
+ * @param cmd   Command to call
+ * @param first Stack index of the first argument
+ * @retval 1 Success, the command's message is on the stack
+ *
+ * On failure, a Lua error is raised.
+ */
+static int command_call(lua_State *l, const struct Command *cmd, int first)
+{
+  struct Buffer token, args, err;
 
   mutt_buffer_init(&token);
-  mutt_buffer_init(&expn);
+  mutt_buffer_init(&args);
   mutt_buffer_init(&err);
 
+  args.dsize = STRING;
+  args.data = mutt_mem_calloc(1, args.dsize);
+  args.dptr = args.data;
   err.dsize = STRING;
-  err.data = mutt_mem_malloc(err.dsize);
+  err.data = mutt_mem_calloc(1, err.dsize);
+
+  for (int i = first; i <= lua_gettop(l); i++)
+    command_args_add(l, i, &args);
+
+  int rc = command_run(cmd, &args, &token, &err);
+  if (rc == 0)
+    lua_pushstring(l, err.data);
+  else
+  {
+    luaL_where(l, 1);
+    lua_pushfstring(l, "NeoMutt error: %s", err.data);
+    lua_concat(l, 2);
+  }
+
+  FREE(&token.data);
+  FREE(&args.data);
+  FREE(&err.data);
+
+  if (rc != 0)
+    return lua_error(l);
+  return 1;
+}
+
+/**
+ * lua_mutt_call - Call a NeoMutt command by name
+ * @param l Lua State
+ * @retval >=0 Success
+ * @retval -1 Error
+ */
+static int lua_mutt_call(lua_State *l)
+{
+  mutt_debug(2, " * lua_mutt_call()\n");
 
   if (lua_gettop(l) == 0)
   {
@@ -93,67 +164,136 @@ static int lua_mutt_call(lua_State *l)
     return -1;
   }
 
-  command = mutt_command_get(lua_tostring(l, 1));
+  const struct Command *command = mutt_command_get(lua_tostring(l, 1));
   if (!command)
   {
     luaL_error(l, "Error command %s not found.", lua_tostring(l, 1));
     return -1;
   }
 
-  for (int i = 2; i <= lua_gettop(l); i++)
-  {
-    const char *s = lua_tostring(l, i);
-    mutt_str_strncat(buffer, sizeof(buffer), s, mutt_str_strlen(s));
-    mutt_str_strncat(buffer, sizeof(buffer), " ", 1);
-  }
+  return command_call(l, command, 2);
+}
 
-  expn.data = buffer;
-  expn.dptr = buffer;
-  expn.dsize = mutt_str_strlen(buffer);
+/**
+ * lua_mutt_command - Call the NeoMutt command bound to this function
+ * @param l Lua State
+ * @retval >=0 Success
+ *
+ * The functions in the mutt.command table carry their Command as an upvalue.
+ */
+static int lua_mutt_command(lua_State *l)
+{
+  const struct Command *command = lua_touserdata(l, lua_upvalueindex(1));
+  mutt_debug(2, " * lua_mutt_command(%s)\n", command->name);
+  return command_call(l, command, 1);
+}
+
+/**
+ * lua_mutt_batch - Run a list of NeoMutt commands
+ * @param l Lua State
+ * @retval 1 Success, the number of commands run is on the stack
+ *
+ * Each entry of the table is either a config line, or a table holding the
+ * name of a command followed by its arguments, e.g.
+ *
+ *     mutt.batch({ "set sort=threads", { "color", "index", "red", "default", "~F" } })
+ *
+ * The commands share their buffers and the config listeners are notified
+ * once, after the last one.  The batch stops at the first error.
+ */
+static int lua_mutt_batch(lua_State *l)
+{
+  mutt_debug(2, " * lua_mutt_batch()\n");
+  luaL_checktype(l, 1, LUA_TTABLE);
+
+  struct Buffer token, args, err;
+
+  mutt_buffer_init(&token);
+  mutt_buffer_init(&args);
+  mutt_buffer_init(&err);
+
+  args.dsize = STRING;
+  args.data = mutt_mem_calloc(1, args.dsize);
+  err.dsize = STRING;
+  err.data = mutt_mem_calloc(1, err.dsize);
+
+  const size_t num = lua_rawlen(l, 1);
+  size_t done = 0;
+  int rc = 0;
 
-  if (command->func(&token, &expn, command->data, &err))
+  cs_batch_begin(Config);
+  for (; done < num; done++)
   {
-    luaL_error(l, "NeoMutt error: %s", err.data);
-    rc = -1;
+    mutt_buffer_reset(&args);
+    lua_rawgeti(l, 1, done + 1);
+    if (lua_type(l, -1) == LUA_TTABLE)
+    {
+      lua_rawgeti(l, -1, 1);
+      const struct Command *command = mutt_command_get(lua_tostring(l, -1));
+      lua_pop(l, 1);
+      if (!command)
+      {
+        mutt_buffer_printf(&err, "command not found");
+        rc = -1;
+      }
+      else
+      {
+        const size_t argc = lua_rawlen(l, -1);
+        for (size_t i = 2; i <= argc; i++)
+        {
+          lua_rawgeti(l, -1, i);
+          command_args_add(l, -1, &args);
+          lua_pop(l, 1);
+        }
+        rc = command_run(command, &args, &token, &err);
+      }
+    }
+    else if (lua_type(l, -1) == LUA_TSTRING)
+    {
+      mutt_buffer_addstr(&args, lua_tostring(l, -1));
+      rc = (mutt_parse_rc_line(args.data, &token, &err) == -1) ? -1 : 0;
+    }
+    else
+    {
+      mutt_buffer_printf(&err, "expected a string or a table");
+      rc = -1;
+    }
+    lua_pop(l, 1);
+
+    if (rc != 0)
+      break;
   }
+  cs_batch_end(Config);
+
+  if (rc == 0)
+    lua_pushinteger(l, done);
   else
   {
-    if (!lua_pushstring(l, err.data))
-      handle_error(l);
-    else
-      rc++;
+    luaL_where(l, 1);
+    lua_pushfstring(l, "NeoMutt error in entry %d: %s", (int) (done + 1), err.data);
+    lua_concat(l, 2);
   }
 
+  FREE(&token.data);
+  FREE(&args.data);
   FREE(&err.data);
 
-  return rc;
+  if (rc != 0)
+    return lua_error(l);
+  return 1;
 }
 
 /**
- * lua_mutt_set - Set a NeoMutt variable
- * @param l Lua State
- * @retval  0 Success
- * @retval -1 Error
+ * config_set - Set a NeoMutt variable from the top of the Lua stack
+ * @param l     Lua State
+ * @param he    Config item
+ * @param param Name of the config item
+ * @retval 0 Success
+ *
+ * On failure, a Lua error is raised.
  */
-static int lua_mutt_set(lua_State *l)
+static int config_set(lua_State *l, struct HashElem *he, const char *param)
 {
-  const char *param = lua_tostring(l, -2);
-  mutt_debug(2, " * lua_mutt_set(%s)\n", param);
-
-  if (mutt_str_strncmp("my_", param, 3) == 0)
-  {
-    const char *val = lua_tostring(l, -1);
-    myvar_set(param, val);
-    return 0;
-  }
-
-  struct HashElem *he = cs_get_elem(Config, param);
-  if (!he)
-  {
-    luaL_error(l, "NeoMutt parameter not found %s", param);
-    return -1;
-  }
-
   struct ConfigDef *cdef = he->data;
 
   int rc = 0;
@@ -194,47 +334,65 @@ static int lua_mutt_set(lua_State *l)
       break;
     }
     default:
-      luaL_error(l, "Unsupported NeoMutt parameter type %d for %s", DTYPE(cdef->type), param);
+      mutt_buffer_printf(err, "Unsupported NeoMutt parameter type %d for %s",
+                         DTYPE(cdef->type), param);
       rc = -1;
       break;
   }
 
+  if (rc != 0)
+  {
+    luaL_where(l, 1);
+    lua_pushfstring(l, "NeoMutt error: %s", err->data);
+    lua_concat(l, 2);
+  }
+
   mutt_buffer_free(&err);
-  return rc;
+
+  if (rc != 0)
+    return lua_error(l);
+  return 0;
 }
 
 /**
- * lua_mutt_get - Get a NeoMutt variable
+ * lua_mutt_set - Set a NeoMutt variable
  * @param l Lua State
- * @retval  1 Success
+ * @retval  0 Success
  * @retval -1 Error
  */
-static int lua_mutt_get(lua_State *l)
+static int lua_mutt_set(lua_State *l)
 {
-  const char *param = lua_tostring(l, -1);
-  mutt_debug(2, " * lua_mutt_get(%s)\n", param);
+  const char *param = lua_tostring(l, -2);
+  mutt_debug(2, " * lua_mutt_set(%s)\n", param);
 
   if (mutt_str_strncmp("my_", param, 3) == 0)
   {
-    const char *mv = myvar_get(param);
-    if (!mv)
-    {
-      luaL_error(l, "NeoMutt parameter not found %s", param);
-      return -1;
-    }
-
-    lua_pushstring(l, mv);
-    return 1;
+    const char *val = lua_tostring(l, -1);
+    myvar_set(param, val);
+    return 0;
   }
 
   struct HashElem *he = cs_get_elem(Config, param);
   if (!he)
   {
-    mutt_debug(2, " * error\n");
     luaL_error(l, "NeoMutt parameter not found %s", param);
     return -1;
   }
 
+  return config_set(l, he, param);
+}
+
+/**
+ * config_get - Push the value of a NeoMutt variable onto the Lua stack
+ * @param l     Lua State
+ * @param he    Config item
+ * @param param Name of the config item
+ * @retval 1 Success
+ *
+ * On failure, a Lua error is raised.
+ */
+static int config_get(lua_State *l, struct HashElem *he, const char *param)
+{
   struct ConfigDef *cdef = he->data;
 
   switch (DTYPE(cdef->type))
@@ -253,7 +411,7 @@ static int lua_mutt_get(lua_State *l)
       if (CSR_RESULT(rc) != CSR_SUCCESS)
       {
         mutt_buffer_free(&value);
-        return -1;
+        return luaL_error(l, "NeoMutt parameter %s can't be read", param);
       }
 
       struct Buffer *escaped = mutt_buffer_alloc(STRING);
@@ -273,9 +431,241 @@ static int lua_mutt_get(lua_State *l)
       lua_pushboolean(l, *((bool *) cdef->var));
       return 1;
     default:
-      luaL_error(l, "NeoMutt parameter type %d unknown for %s", cdef->type, param);
+      return luaL_error(l, "NeoMutt parameter type %d unknown for %s", cdef->type, param);
+  }
+}
+
+/**
+ * lua_mutt_get - Get a NeoMutt variable
+ * @param l Lua State
+ * @retval  1 Success
+ * @retval -1 Error
+ */
+static int lua_mutt_get(lua_State *l)
+{
+  const char *param = lua_tostring(l, -1);
+  mutt_debug(2, " * lua_mutt_get(%s)\n", param);
+
+  if (mutt_str_strncmp("my_", param, 3) == 0)
+  {
+    const char *mv = myvar_get(param);
+    if (!mv)
+    {
+      luaL_error(l, "NeoMutt parameter not found %s", param);
       return -1;
+    }
+
+    lua_pushstring(l, mv);
+    return 1;
   }
+
+  struct HashElem *he = cs_get_elem(Config, param);
+  if (!he)
+  {
+    mutt_debug(2, " * error\n");
+    luaL_error(l, "NeoMutt parameter not found %s", param);
+    return -1;
+  }
+
+  return config_get(l, he, param);
+}
+
+/**
+ * lua_mutt_config - Get a handle to a NeoMutt variable
+ * @param l Lua State
+ * @retval 1 Success
+ *
+ * The handle remembers the config item, so reading or writing it through
+ * `handle:get()` and `handle:set(value)` skips the lookup by name, e.g.
+ *
+ *     local sort = mutt.config("sort")
+ *     sort:set("threads")
+ *
+ * "my_" variables don't have handles.
+ */
+static int lua_mutt_config(lua_State *l)
+{
+  const char *param = luaL_checkstring(l, 1);
+  mutt_debug(2, " * lua_mutt_config(%s)\n", param);
+
+  struct HashElem *he = NULL;
+  if (mutt_str_strncmp("my_", param, 3) != 0)
+    he = cs_get_elem(Config, param);
+  if (!he)
+    return luaL_error(l, "NeoMutt parameter not found %s", param);
+
+  struct HashElem **handle = lua_newuserdata(l, sizeof(*handle));
+  *handle = he;
+  luaL_setmetatable(l, LUA_MUTT_CONFIG);
+  return 1;
+}
+
+/**
+ * lua_config_get - Get the value of a config handle
+ * @param l Lua State
+ * @retval 1 Success
+ */
+static int lua_config_get(lua_State *l)
+{
+  struct HashElem **handle = luaL_checkudata(l, 1, LUA_MUTT_CONFIG);
+  return config_get(l, *handle, (*handle)->key.strkey);
+}
+
+/**
+ * lua_config_set - Set the value of a config handle
+ * @param l Lua State
+ * @retval 0 Success
+ */
+static int lua_config_set(lua_State *l)
+{
+  struct HashElem **handle = luaL_checkudata(l, 1, LUA_MUTT_CONFIG);
+  luaL_checkany(l, 2);
+  lua_settop(l, 2);
+  return config_set(l, *handle, (*handle)->key.strkey);
+}
+
+/**
+ * lua_config_tostring - Get the name of a config handle
+ * @param l Lua State
+ * @retval 1 Always
+ */
+static int lua_config_tostring(lua_State *l)
+{
+  struct HashElem **handle = luaL_checkudata(l, 1, LUA_MUTT_CONFIG);
+  lua_pushfstring(l, "mutt.config(%s)", (*handle)->key.strkey);
+  return 1;
+}
+
+/**
+ * enum LuaEmailField - Fields of the Email exposed to Lua
+ */
+enum LuaEmailField
+{
+  LEF_SUBJECT,
+  LEF_FROM,
+  LEF_FROM_NAME,
+  LEF_TO,
+  LEF_MESSAGE_ID,
+  LEF_DATE,
+  LEF_RECEIVED,
+  LEF_SIZE,
+  LEF_SCORE,
+  LEF_INDEX,
+  LEF_MSGNO,
+  LEF_READ,
+  LEF_OLD,
+  LEF_FLAGGED,
+  LEF_REPLIED,
+  LEF_TAGGED,
+  LEF_DELETED,
+};
+
+/**
+ * struct LuaEmailFieldName - Name of an Email field exposed to Lua
+ */
+struct LuaEmailFieldName
+{
+  const char *name;         ///< Name used by Lua
+  enum LuaEmailField field; ///< Field of the Email
+};
+
+static const struct LuaEmailFieldName LuaEmailFields[] = {
+  { "subject", LEF_SUBJECT },   { "from", LEF_FROM },
+  { "from_name", LEF_FROM_NAME }, { "to", LEF_TO },
+  { "message_id", LEF_MESSAGE_ID }, { "date", LEF_DATE },
+  { "received", LEF_RECEIVED }, { "size", LEF_SIZE },
+  { "score", LEF_SCORE },       { "index", LEF_INDEX },
+  { "msgno", LEF_MSGNO },       { "read", LEF_READ },
+  { "old", LEF_OLD },           { "flagged", LEF_FLAGGED },
+  { "replied", LEF_REPLIED },   { "tagged", LEF_TAGGED },
+  { "deleted", LEF_DELETED },   { NULL, 0 },
+};
+
+/**
+ * lua_email_index - Read a field of the current Email
+ * @param l Lua State
+ * @retval 1 Always, the value (or nil) is on the stack
+ *
+ * `mutt.email` reads the fields straight out of the Email that the running
+ * message-hook is for, e.g. `mutt.email.subject`, rather than having the
+ * script format and parse them.  Outside a message-hook, every field is nil.
+ */
+static int lua_email_index(lua_State *l)
+{
+  const char *key = luaL_checkstring(l, 2);
+  struct Context *ctx = NULL;
+  struct Email *e = mutt_hook_email(&ctx);
+
+  const struct LuaEmailFieldName *lef = LuaEmailFields;
+  for (; lef->name; lef++)
+    if (mutt_str_strcmp(lef->name, key) == 0)
+      break;
+
+  if (!e || !lef->name)
+  {
+    lua_pushnil(l);
+    return 1;
+  }
+
+  if (e->header_pending && ctx)
+    mx_msg_load_header(ctx, e);
+
+  const struct Envelope *env = e->env;
+  switch (lef->field)
+  {
+    case LEF_SUBJECT:
+      lua_pushstring(l, env ? env->subject : NULL);
+      break;
+    case LEF_FROM:
+      lua_pushstring(l, (env && env->from) ? env->from->mailbox : NULL);
+      break;
+    case LEF_FROM_NAME:
+      lua_pushstring(l, (env && env->from) ? env->from->personal : NULL);
+      break;
+    case LEF_TO:
+      lua_pushstring(l, (env && env->to) ? env->to->mailbox : NULL);
+      break;
+    case LEF_MESSAGE_ID:
+      lua_pushstring(l, env ? env->message_id : NULL);
+      break;
+    case LEF_DATE:
+      lua_pushinteger(l, e->date_sent);
+      break;
+    case LEF_RECEIVED:
+      lua_pushinteger(l, e->received);
+      break;
+    case LEF_SIZE:
+      lua_pushinteger(l, e->content ? e->content->length : 0);
+      break;
+    case LEF_SCORE:
+      lua_pushinteger(l, e->score);
+      break;
+    case LEF_INDEX:
+      lua_pushinteger(l, e->index);
+      break;
+    case LEF_MSGNO:
+      lua_pushinteger(l, e->msgno);
+      break;
+    case LEF_READ:
+      lua_pushboolean(l, e->read);
+      break;
+    case LEF_OLD:
+      lua_pushboolean(l, e->old);
+      break;
+    case LEF_FLAGGED:
+      lua_pushboolean(l, e->flagged);
+      break;
+    case LEF_REPLIED:
+      lua_pushboolean(l, e->replied);
+      break;
+    case LEF_TAGGED:
+      lua_pushboolean(l, e->tagged);
+      break;
+    case LEF_DELETED:
+      lua_pushboolean(l, e->deleted);
+      break;
+  }
+  return 1;
 }
 
 /**
@@ -352,17 +742,26 @@ static int lua_mutt_error(lua_State *l)
 static void lua_expose_command(void *p, const struct Command *cmd)
 {
   lua_State *l = (lua_State *) p;
-  char buf[LONG_STRING];
-  snprintf(buf, sizeof(buf), "mutt.command.%s = function (...); mutt.call('%s', ...); end",
-           cmd->name, cmd->name);
-  (void) luaL_dostring(l, buf);
+  lua_getglobal(l, "mutt");
+  lua_getfield(l, -1, "command");
+  lua_pushlightuserdata(l, (void *) cmd);
+  lua_pushcclosure(l, lua_mutt_command, 1);
+  lua_setfield(l, -2, cmd->name);
+  lua_pop(l, 2);
 }
 
 static const luaL_Reg luaMuttDecl[] = {
   { "set", lua_mutt_set },       { "get", lua_mutt_get },
   { "call", lua_mutt_call },     { "enter", lua_mutt_enter },
   { "print", lua_mutt_message }, { "message", lua_mutt_message },
-  { "error", lua_mutt_error },   { NULL, NULL },
+  { "error", lua_mutt_error },   { "batch", lua_mutt_batch },
+  { "config", lua_mutt_config }, { NULL, NULL },
+};
+
+static const luaL_Reg luaConfigMethods[] = {
+  { "get", lua_config_get },
+  { "set", lua_config_set },
+  { NULL, NULL },
 };
 
 #define lua_add_lib_member(LUA, TABLE, KEY, VALUE, DATATYPE_HANDLER)           \
@@ -386,6 +785,21 @@ static int luaopen_mutt_decl(lua_State *l)
   lua_add_lib_member(l, lib_idx, "QUAD_NO", MUTT_NO, lua_pushinteger);
   lua_add_lib_member(l, lib_idx, "QUAD_ASKYES", MUTT_ASKYES, lua_pushinteger);
   lua_add_lib_member(l, lib_idx, "QUAD_ASKNO", MUTT_ASKNO, lua_pushinteger);
+
+  luaL_newmetatable(l, LUA_MUTT_CONFIG);
+  luaL_newlib(l, luaConfigMethods);
+  lua_setfield(l, -2, "__index");
+  lua_pushcfunction(l, lua_config_tostring);
+  lua_setfield(l, -2, "__tostring");
+  lua_pop(l, 1);
+
+  /* mutt.email is an empty table that reads its fields from the Email */
+  lua_newtable(l);
+  lua_newtable(l);
+  lua_pushcfunction(l, lua_email_index);
+  lua_setfield(l, -2, "__index");
+  lua_setmetatable(l, -2);
+  lua_setfield(l, lib_idx, "email");
   return 1;
 }
 
@@ -24,6 +24,7 @@
 #include <regex.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "mutt/mutt.h"
 #include "email/lib.h"
 #include "mutt.h"
@@ -205,36 +206,110 @@ static int count_body_parts(struct Body *body, int flags)
   return (count < 0) ? 0 : count;
 }
 
+/* Digest of the attachment rules, 0 until it's needed */
+static unsigned int AttachRules = 0;
+
+/**
+ * attach_rules_add - Add a list of attachment rules to a digest
+ * @param md5  Digest
+ * @param tag  Name of the list
+ * @param list List of AttachMatch
+ */
+static void attach_rules_add(struct Md5Ctx *md5, const char *tag, struct ListHead *list)
+{
+  mutt_md5_process_bytes(tag, strlen(tag) + 1, md5);
+
+  struct ListNode *np = NULL;
+  STAILQ_FOREACH(np, list, entries)
+  {
+    const struct AttachMatch *a = (const struct AttachMatch *) np->data;
+    mutt_md5_process(NONULL(a->major), md5);
+    mutt_md5_process_bytes("/", 1, md5);
+    mutt_md5_process(NONULL(a->minor), md5);
+    mutt_md5_process_bytes("", 1, md5);
+  }
+}
+
+/**
+ * attach_rules - Get the digest of the attachment rules
+ * @retval num Non-zero digest
+ *
+ * An attachment count is only reused, e.g. from the header cache, if it was
+ * counted with the same rules.
+ */
+static unsigned int attach_rules(void)
+{
+  if (AttachRules != 0)
+    return AttachRules;
+
+  struct Md5Ctx md5;
+  union
+  {
+    unsigned char bytes[16];
+    unsigned int num;
+  } digest;
+
+  mutt_md5_init_ctx(&md5);
+  attach_rules_add(&md5, "attach+", &AttachAllow);
+  attach_rules_add(&md5, "attach-", &AttachExclude);
+  attach_rules_add(&md5, "inline+", &InlineAllow);
+  attach_rules_add(&md5, "inline-", &InlineExclude);
+  mutt_md5_finish_ctx(&md5, digest.bytes);
+
+  AttachRules = digest.num ? digest.num : 1;
+  return AttachRules;
+}
+
+/**
+ * mutt_attach_rules_changed - The attachment rules have changed
+ *
+ * Called when the `attachments` or `unattachments` commands change the rules.
+ * Counts from the header cache are checked against the new rules when used.
+ */
+void mutt_attach_rules_changed(void)
+{
+  AttachRules = 0;
+}
+
 /**
  * mutt_count_body_parts - Count the MIME Body parts
  * @param ctx Mailbox
  * @param e Email
  * @retval num Number of MIME Body parts
+ *
+ * Counting may need the message to be read and parsed, so the count is saved
+ * in the header cache, together with the rules it was counted with.
  */
 int mutt_count_body_parts(struct Context *ctx, struct Email *e)
 {
   bool keep_parts = false;
 
-  if (e->attach_valid)
+  if (e->attach_valid && (e->attach_rules == attach_rules()))
     return e->attach_total;
 
+  /* Without any rules, nothing is counted: don't read the message */
+  if (STAILQ_EMPTY(&AttachAllow) && STAILQ_EMPTY(&AttachExclude) &&
+      STAILQ_EMPTY(&InlineAllow) && STAILQ_EMPTY(&InlineExclude))
+  {
+    e->attach_total = 0;
+    e->attach_rules = attach_rules();
+    e->attach_valid = true;
+    return 0;
+  }
+
   if (e->content->parts)
     keep_parts = true;
   else
     mutt_parse_mime_message(ctx, e);
 
-  if (!STAILQ_EMPTY(&AttachAllow) || !STAILQ_EMPTY(&AttachExclude) ||
-      !STAILQ_EMPTY(&InlineAllow) || !STAILQ_EMPTY(&InlineExclude))
-  {
-    e->attach_total = count_body_parts(e->content, MUTT_PARTS_TOPLEVEL);
-  }
-  else
-    e->attach_total = 0;
-
+  e->attach_total = count_body_parts(e->content, MUTT_PARTS_TOPLEVEL);
+  e->attach_rules = attach_rules();
   e->attach_valid = true;
 
   if (!keep_parts)
     mutt_body_free(&e->content->parts);
 
+  mx_msg_save_hcache(ctx, e);
+
   return e->attach_total;
 }
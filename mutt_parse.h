@@ -26,6 +26,7 @@
 struct Context;
 struct Email;
 
+void mutt_attach_rules_changed(void);
 int  mutt_count_body_parts(struct Context *ctx, struct Email *e);
 void mutt_parse_mime_message(struct Context *ctx, struct Email *cur);
 
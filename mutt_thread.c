@@ -33,10 +33,17 @@
 #include "mutt_thread.h"
 #include "context.h"
 #include "curs_lib.h"
+#include "globals.h"
 #include "mailbox.h"
 #include "mx.h"
 #include "protos.h"
 #include "sort.h"
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
+#ifdef USE_IMAP
+#include "imap/imap.h"
+#endif
 
 /* These Config Variables are only used in mutt_thread.c */
 bool DuplicateThreads; ///< Config: Highlight messages with duplicated message IDs
@@ -49,6 +56,9 @@ bool NarrowTree; ///< Config: Draw a narrower thread tree in the index
 bool SortRe;     ///< Config: Sort method for the sidebar
 bool StrictThreads; ///< Config: Thread messages using 'In-Reply-To' and 'References' headers
 bool ThreadReceived; ///< Config: Sort threaded messages by their received date
+#ifdef USE_HCACHE
+bool HeaderCacheThreads; ///< Config: (hcache) Keep the threads of local folders in the header cache
+#endif
 
 /**
  * is_visible - Is the message visible?
@@ -149,34 +159,29 @@ static void linearize_tree(struct Context *ctx)
 
 /**
  * calculate_visibility - Are tree nodes visible
- * @param ctx       Mailbox
- * @param max_depth Maximum depth to check
+ * @param ctx Mailbox
  *
  * this calculates whether a node is the root of a subtree that has visible
  * nodes, whether a node itself is visible, whether, if invisible, it has
  * depth anyway, and whether any of its later siblings are roots of visible
  * subtrees.  while it's at it, it frees the old thread display, so we can
- * skip parts of the tree in mutt_draw_tree() if we've decided here that we
+ * skip parts of the tree in draw_thread() if we've decided here that we
  * don't care about them any more.
  */
-static void calculate_visibility(struct Context *ctx, int *max_depth)
+static void calculate_visibility(struct Context *ctx)
 {
   struct MuttThread *tmp = NULL, *tree = ctx->tree;
   int hide_top_missing = HideTopMissing && !HideMissing;
   int hide_top_limited = HideTopLimited && !HideLimited;
-  int depth = 0;
 
   /* we walk each level backwards to make it easier to compute next_subtree_visible */
   while (tree->next)
     tree = tree->next;
-  *max_depth = 0;
 
   while (true)
   {
-    if (depth > *max_depth)
-      *max_depth = depth;
-
     tree->subtree_visible = 0;
+    tree->drawn = false;
     if (tree->message)
     {
       FREE(&tree->message->tree);
@@ -212,7 +217,6 @@ static void calculate_visibility(struct Context *ctx, int *max_depth)
         tree->next && (tree->next->next_subtree_visible || tree->next->subtree_visible);
     if (tree->child)
     {
-      depth++;
       tree = tree->child;
       while (tree->next)
         tree = tree->next;
@@ -222,10 +226,7 @@ static void calculate_visibility(struct Context *ctx, int *max_depth)
     else
     {
       while (tree && !tree->prev)
-      {
-        depth--;
         tree = tree->parent;
-      }
       if (!tree)
         break;
       else
@@ -262,8 +263,41 @@ static void calculate_visibility(struct Context *ctx, int *max_depth)
 }
 
 /**
- * mutt_draw_tree - Draw a tree of threaded emails
- * @param ctx Mailbox
+ * thread_depth - Find the depth of a thread
+ * @param top Top of the thread
+ * @retval num Number of levels below the top
+ */
+static int thread_depth(struct MuttThread *top)
+{
+  struct MuttThread *tree = top;
+  int depth = 0, max_depth = 0;
+
+  while (true)
+  {
+    if (tree->child)
+    {
+      tree = tree->child;
+      if (++depth > max_depth)
+        max_depth = depth;
+      continue;
+    }
+
+    while ((tree != top) && !tree->next)
+    {
+      tree = tree->parent;
+      depth--;
+    }
+    if (tree == top)
+      break;
+    tree = tree->next;
+  }
+
+  return max_depth;
+}
+
+/**
+ * draw_thread - Draw the tree of one thread
+ * @param top Top of the thread
  *
  * Since the graphics characters have a value >255, I have to resort to using
  * escape sequences to pass the information to print_enriched_string().  These
@@ -273,18 +307,14 @@ static void calculate_visibility(struct Context *ctx, int *max_depth)
  * graphics chars on terminals which don't support them (see the man page for
  * curs_addch).
  */
-void mutt_draw_tree(struct Context *ctx)
+static void draw_thread(struct MuttThread *top)
 {
   char *pfx = NULL, *mypfx = NULL, *arrow = NULL, *myarrow = NULL, *new_tree = NULL;
   char corner = (Sort & SORT_REVERSE) ? MUTT_TREE_ULCORNER : MUTT_TREE_LLCORNER;
   char vtee = (Sort & SORT_REVERSE) ? MUTT_TREE_BTEE : MUTT_TREE_TTEE;
-  int depth = 0, start_depth = 0, max_depth = 0, width = NarrowTree ? 1 : 2;
-  struct MuttThread *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = ctx->tree;
+  int depth = 0, start_depth = 0, max_depth = thread_depth(top), width = NarrowTree ? 1 : 2;
+  struct MuttThread *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = top;
 
-  /* Do the visibility calculations and free the old thread chars.
-   * From now on we can simply ignore invisible subtrees
-   */
-  calculate_visibility(ctx, &max_depth);
   pfx = mutt_mem_malloc(width * max_depth + 2);
   arrow = mutt_mem_malloc(width * max_depth + 2);
   while (tree)
@@ -349,7 +379,7 @@ void mutt_draw_tree(struct Context *ctx)
       }
       else
       {
-        while (!tree->next && tree->parent)
+        while ((tree != top) && !tree->next)
         {
           if (tree == pseudo)
             pseudo = NULL;
@@ -371,7 +401,7 @@ void mutt_draw_tree(struct Context *ctx)
           nextdisp = NULL;
         if (tree->visible)
           start_depth = depth;
-        tree = tree->next;
+        tree = (tree == top) ? NULL : tree->next;
         if (!tree)
           break;
       }
@@ -386,6 +416,42 @@ void mutt_draw_tree(struct Context *ctx)
   FREE(&arrow);
 }
 
+/**
+ * mutt_draw_tree - Prepare the threads to be drawn
+ * @param ctx Mailbox
+ *
+ * This works out which parts of the threads are visible and throws away the
+ * old trees.  The trees themselves are only drawn, by mutt_draw_thread(),
+ * for the threads that are displayed.
+ */
+void mutt_draw_tree(struct Context *ctx)
+{
+  calculate_visibility(ctx);
+}
+
+/**
+ * mutt_draw_thread - Draw the tree of an email's thread
+ * @param e Email
+ *
+ * The tree is drawn once for the whole thread, so the neighbouring emails in
+ * the index are ready when they're displayed.
+ */
+void mutt_draw_thread(struct Email *e)
+{
+  struct MuttThread *top = e->thread;
+  if (!top)
+    return;
+
+  while (top->parent)
+    top = top->parent;
+
+  if (top->drawn)
+    return;
+
+  draw_thread(top);
+  top->drawn = true;
+}
+
 /**
  * make_subject_list - Create a sorted list of all subjects in a thread
  * @param[out] subjects String List of subjects
@@ -442,17 +508,119 @@ static void make_subject_list(struct ListHead *subjects, struct MuttThread *cur,
 }
 
 /**
- * find_subject - Find the best possible match for a parent based on subject
+ * struct SubjectRun - Emails with the same subject, sorted by date
+ */
+struct SubjectRun
+{
+  struct Email **emails; ///< Emails, oldest first
+  size_t num;            ///< Number of emails
+};
+
+/**
+ * struct SubjectIndex - The emails that a thread may be attached to by subject
+ */
+struct SubjectIndex
+{
+  struct Email **emails;   ///< Candidates, grouped by subject
+  struct SubjectRun *runs; ///< One run per subject
+  struct Hash *hash;       ///< Subject -> SubjectRun
+};
+
+/**
+ * thread_date - Get the date used to pick a thread's parent by subject
+ * @param e Email
+ * @retval num Received or sent date, see $thread_received
+ */
+static time_t thread_date(const struct Email *e)
+{
+  return ThreadReceived ? e->received : e->date_sent;
+}
+
+/**
+ * compare_subject_date - Compare two emails by subject, then date
+ * @param a First email
+ * @param b Second email
+ * @retval <0 a precedes b
+ * @retval  0 a and b are identical
+ * @retval >0 b precedes a
+ */
+static int compare_subject_date(const void *a, const void *b)
+{
+  const struct Email *ea = *(struct Email const *const *) a;
+  const struct Email *eb = *(struct Email const *const *) b;
+
+  int rc = mutt_str_strcmp(ea->env->real_subj, eb->env->real_subj);
+  if (rc != 0)
+    return rc;
+
+  const time_t da = thread_date(ea);
+  const time_t db = thread_date(eb);
+  if (da != db)
+    return (da < db) ? -1 : 1;
+
+  return ea->index - eb->index;
+}
+
+/**
+ * subject_index_build - Group the candidate parents by subject
  * @param ctx Mailbox
+ * @param idx Index to fill
+ *
+ * Only the emails whose subject changed can become a parent.  Sorting them
+ * by subject and date lets find_subject() jump straight to the latest
+ * candidate that's older than a thread, instead of testing every email with
+ * that subject.
+ */
+static void subject_index_build(struct Context *ctx, struct SubjectIndex *idx)
+{
+  size_t num = 0, nruns = 0;
+
+  idx->emails = mutt_mem_calloc(ctx->mailbox->msg_count + 1, sizeof(struct Email *));
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    struct Email *e = ctx->mailbox->hdrs[i];
+    if (e->thread && e->subject_changed && e->env->real_subj)
+      idx->emails[num++] = e;
+  }
+  qsort(idx->emails, num, sizeof(struct Email *), compare_subject_date);
+
+  idx->runs = mutt_mem_calloc(num + 1, sizeof(struct SubjectRun));
+  idx->hash = mutt_hash_create(MAX(num, 1) * 2, 0);
+  for (size_t i = 0; i < num; i++)
+  {
+    if ((i == 0) || (mutt_str_strcmp(idx->emails[i - 1]->env->real_subj,
+                                     idx->emails[i]->env->real_subj) != 0))
+    {
+      idx->runs[nruns].emails = &idx->emails[i];
+      mutt_hash_insert(idx->hash, idx->emails[i]->env->real_subj, &idx->runs[nruns]);
+      nruns++;
+    }
+    idx->runs[nruns - 1].num++;
+  }
+}
+
+/**
+ * subject_index_free - Free the candidate parents
+ * @param idx Index to free
+ */
+static void subject_index_free(struct SubjectIndex *idx)
+{
+  mutt_hash_destroy(&idx->hash);
+  FREE(&idx->runs);
+  FREE(&idx->emails);
+}
+
+/**
+ * find_subject - Find the best possible match for a parent based on subject
+ * @param idx Candidate parents
  * @param cur Email to match
  * @retval ptr Best match for a parent
  *
  * If there are multiple matches, the one which was sent the latest, but before
  * the current message, is used.
  */
-static struct MuttThread *find_subject(struct Context *ctx, struct MuttThread *cur)
+static struct MuttThread *find_subject(struct SubjectIndex *idx, struct MuttThread *cur)
 {
-  struct HashElem *ptr = NULL;
   struct MuttThread *tmp = NULL, *last = NULL;
   struct ListHead subjects = STAILQ_HEAD_INITIALIZER(subjects);
   time_t date = 0;
@@ -462,20 +630,36 @@ static struct MuttThread *find_subject(struct Context *ctx, struct MuttThread *c
   struct ListNode *np = NULL;
   STAILQ_FOREACH(np, &subjects, entries)
   {
-    for (ptr = mutt_hash_find_bucket(ctx->mailbox->subj_hash, np->data); ptr; ptr = ptr->next)
+    struct SubjectRun *run = mutt_hash_find(idx->hash, np->data);
+    if (!run)
+      continue;
+
+    /* find the first candidate that's newer than the thread */
+    size_t lo = 0, hi = run->num;
+    while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (thread_date(run->emails[mid]) <= date)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    /* then walk back to the latest one that's usable */
+    while (lo-- > 0)
     {
-      tmp = ((struct Email *) ptr->data)->thread;
-      if (tmp != cur &&                    /* don't match the same message */
-          !tmp->fake_thread &&             /* don't match pseudo threads */
-          tmp->message->subject_changed && /* only match interesting replies */
-          !is_descendant(tmp, cur) &&      /* don't match in the same thread */
-          (date >= (ThreadReceived ? tmp->message->received : tmp->message->date_sent)) &&
-          (!last || (ThreadReceived ? (last->message->received < tmp->message->received) :
-                                      (last->message->date_sent < tmp->message->date_sent))) &&
-          tmp->message->env->real_subj &&
-          (mutt_str_strcmp(np->data, tmp->message->env->real_subj) == 0))
+      struct Email *e = run->emails[lo];
+      if (last && (thread_date(last->message) >= thread_date(e)))
+        break;
+
+      tmp = e->thread;
+      if (tmp != cur &&            /* don't match the same message */
+          !tmp->fake_thread &&     /* don't match pseudo threads */
+          e->subject_changed &&    /* only match interesting replies */
+          !is_descendant(tmp, cur)) /* don't match in the same thread */
       {
         last = tmp; /* best match so far */
+        break;
       }
     }
   }
@@ -514,15 +698,17 @@ static void pseudo_threads(struct Context *ctx)
   struct MuttThread *tree = ctx->tree, *top = tree;
   struct MuttThread *tmp = NULL, *cur = NULL, *parent = NULL, *curchild = NULL,
                     *nextchild = NULL;
+  struct SubjectIndex idx = { 0 };
 
   if (!ctx->mailbox->subj_hash)
     ctx->mailbox->subj_hash = make_subj_hash(ctx);
+  subject_index_build(ctx, &idx);
 
   while (tree)
   {
     cur = tree;
     tree = tree->next;
-    parent = find_subject(ctx, cur);
+    parent = find_subject(&idx, cur);
     if (parent)
     {
       cur->fake_thread = true;
@@ -567,9 +753,51 @@ static void pseudo_threads(struct Context *ctx)
       }
     }
   }
+  subject_index_free(&idx);
   ctx->tree = top;
 }
 
+/**
+ * struct ThreadArena - Storage for the thread nodes of a mailbox
+ *
+ * The nodes are handed out in the order the emails are threaded, so a walk
+ * over the tree touches neighbouring memory, and they're all freed together
+ * by mutt_clear_threads().
+ */
+struct ThreadArena
+{
+  struct ThreadArena *next; ///< Previous, full, block of nodes
+  size_t used;              ///< Number of nodes handed out
+  size_t size;              ///< Number of nodes in the block
+  char *ids;                ///< Message-ids of the missing messages, restored from the header cache
+  size_t ids_len;           ///< Length of ids
+  struct MuttThread nodes[];
+};
+
+/**
+ * thread_new - Create a thread node
+ * @param ctx Mailbox
+ * @retval ptr New, zeroed, node
+ *
+ * The node belongs to the mailbox's arena and mustn't be freed by itself.
+ */
+static struct MuttThread *thread_new(struct Context *ctx)
+{
+  struct ThreadArena *arena = ctx->thread_arena;
+
+  if (!arena || (arena->used == arena->size))
+  {
+    size_t size = arena ? (arena->size * 2) : MAX(ctx->mailbox->msg_count * 2, 64);
+    arena = mutt_mem_calloc_tag(MEM_TAG_THREAD, 1, sizeof(struct ThreadArena) +
+                                                      size * sizeof(struct MuttThread));
+    arena->size = size;
+    arena->next = ctx->thread_arena;
+    ctx->thread_arena = arena;
+  }
+
+  return &arena->nodes[arena->used++];
+}
+
 /**
  * mutt_clear_threads - Clear the threading of message in a mailbox
  * @param ctx Mailbox
@@ -589,8 +817,478 @@ void mutt_clear_threads(struct Context *ctx)
 
   if (ctx->thread_hash)
     mutt_hash_destroy(&ctx->thread_hash);
+
+  while (ctx->thread_arena)
+  {
+    struct ThreadArena *next = ctx->thread_arena->next;
+    if (ctx->thread_arena->ids)
+      mutt_mem_free_tag(MEM_TAG_THREAD, &ctx->thread_arena->ids, ctx->thread_arena->ids_len);
+    mutt_mem_free_tag(MEM_TAG_THREAD, &ctx->thread_arena,
+                      sizeof(struct ThreadArena) +
+                          ctx->thread_arena->size * sizeof(struct MuttThread));
+    ctx->thread_arena = next;
+  }
+}
+
+#ifdef USE_HCACHE
+#define THREAD_CACHE_KEY "/threads"   ///< Header cache key of the thread structure
+#define THREAD_CACHE_MAGIC 0x54485231 ///< "THR1", changes when the format does
+
+#define THREAD_CACHE_FAKE      (1 << 0) ///< MuttThread::fake_thread
+#define THREAD_CACHE_DUPLICATE (1 << 1) ///< MuttThread::duplicate_thread
+#define THREAD_CACHE_SUBJECT   (1 << 2) ///< Email::subject_changed
+
+/**
+ * struct ThreadCacheHeader - The thread structure of a mailbox, in the header cache
+ *
+ * The header is followed by ThreadCacheHeader::num_nodes nodes, then by the
+ * message-ids of the missing messages, in node order.
+ */
+struct ThreadCacheHeader
+{
+  unsigned int magic;       ///< #THREAD_CACHE_MAGIC
+  unsigned int options;     ///< Threading config, see thread_cache_options()
+  int msg_count;            ///< Number of emails threaded
+  int num_nodes;            ///< Number of ThreadCacheNode
+  size_t ids_len;           ///< Length of the message-ids, including the NULs
+  unsigned char digest[16]; ///< Digest of the headers used for threading
+};
+
+/**
+ * struct ThreadCacheNode - One MuttThread, in the header cache
+ *
+ * The nodes are in depth-first order, so a parent always precedes its children.
+ */
+struct ThreadCacheNode
+{
+  int parent;         ///< Node of the parent, or -1 for a top-level thread
+  int index;          ///< Email::index of the message, or -1 if it's missing
+  unsigned int flags; ///< Flags, e.g. #THREAD_CACHE_FAKE
+};
+
+/**
+ * struct ThreadCacheMissing - A missing message, found while saving the threads
+ */
+struct ThreadCacheMissing
+{
+  struct MuttThread *thread; ///< Node without a message
+  int node;                  ///< Number of the node in the record
+  const char *id;            ///< Message-id of the missing message
+};
+
+/**
+ * thread_cache_open - Open the header cache for the threads of a mailbox
+ * @param ctx Mailbox
+ * @retval ptr  Header cache
+ * @retval NULL The threads of this mailbox aren't cached
+ *
+ * Only local folders are cached.  Their header cache is opened by path, like
+ * the drivers do.
+ */
+static header_cache_t *thread_cache_open(struct Context *ctx)
+{
+  if (!HeaderCacheThreads || !HeaderCache || !ctx->mailbox->path[0])
+    return NULL;
+
+  switch (ctx->mailbox->magic)
+  {
+    case MUTT_MBOX:
+    case MUTT_MMDF:
+    case MUTT_MAILDIR:
+    case MUTT_MH:
+      break;
+    default:
+      return NULL;
+  }
+
+  return mutt_hcache_open(HeaderCache, ctx->mailbox->path, NULL);
 }
 
+/**
+ * thread_cache_options - Get the config that changes how emails are threaded
+ * @retval num Bit field of the options
+ */
+static unsigned int thread_cache_options(void)
+{
+  return (StrictThreads << 0) | (DuplicateThreads << 1) | (ThreadReceived << 2) |
+         (SortRe << 3);
+}
+
+/**
+ * thread_cache_emails - Order the emails of a mailbox by index
+ * @param ctx Mailbox
+ * @retval ptr  Array of Email, indexed by Email::index
+ * @retval NULL The indexes aren't numbered 0 to msg_count - 1
+ *
+ * The array must be freed by the caller.
+ */
+static struct Email **thread_cache_emails(struct Context *ctx)
+{
+  const int count = ctx->mailbox->msg_count;
+  struct Email **emails = mutt_mem_calloc(count + 1, sizeof(struct Email *));
+
+  for (int i = 0; i < count; i++)
+  {
+    struct Email *e = ctx->mailbox->hdrs[i];
+    if (!e || (e->index < 0) || (e->index >= count) || emails[e->index])
+    {
+      FREE(&emails);
+      return NULL;
+    }
+    emails[e->index] = e;
+  }
+
+  return emails;
+}
+
+/**
+ * thread_cache_digest_str - Add a string to a threading digest
+ * @param md5 Digest
+ * @param str String, may be NULL
+ */
+static void thread_cache_digest_str(struct Md5Ctx *md5, const char *str)
+{
+  if (str)
+    mutt_md5_process_bytes(str, strlen(str) + 1, md5);
+  else
+    mutt_md5_process_bytes("\1", 1, md5);
+}
+
+/**
+ * thread_cache_digest - Summarise everything the threading looks at
+ * @param emails Emails, by index, see thread_cache_emails()
+ * @param count  Number of emails
+ * @param digest Buffer for the 16-byte digest
+ *
+ * If two mailboxes have the same digest, and are threaded with the same
+ * config, they end up with the same threads.
+ */
+static void thread_cache_digest(struct Email **emails, int count, unsigned char *digest)
+{
+  struct Md5Ctx md5;
+  struct ListNode *np = NULL;
+
+  mutt_md5_init_ctx(&md5);
+  for (int i = 0; i < count; i++)
+  {
+    const struct Email *e = emails[i];
+    const struct Envelope *env = e->env;
+    const time_t date = thread_date(e);
+    const char same_subj = (env->real_subj == env->subject);
+
+    thread_cache_digest_str(&md5, env->message_id);
+    STAILQ_FOREACH(np, &env->in_reply_to, entries)
+    {
+      thread_cache_digest_str(&md5, np->data);
+    }
+    thread_cache_digest_str(&md5, NULL);
+    STAILQ_FOREACH(np, &env->references, entries)
+    {
+      thread_cache_digest_str(&md5, np->data);
+    }
+    thread_cache_digest_str(&md5, NULL);
+    thread_cache_digest_str(&md5, env->real_subj);
+    mutt_md5_process_bytes(&same_subj, sizeof(same_subj), &md5);
+    mutt_md5_process_bytes(&date, sizeof(date), &md5);
+  }
+  mutt_md5_finish_ctx(&md5, digest);
+}
+
+/**
+ * compare_missing - Compare two missing messages by node address
+ * @param a First ThreadCacheMissing to compare
+ * @param b Second ThreadCacheMissing to compare
+ * @retval <0 a precedes b
+ * @retval  0 a and b are identical
+ * @retval >0 b precedes a
+ */
+static int compare_missing(const void *a, const void *b)
+{
+  const struct MuttThread *ta = ((const struct ThreadCacheMissing *) a)->thread;
+  const struct MuttThread *tb = ((const struct ThreadCacheMissing *) b)->thread;
+
+  return (ta < tb) ? -1 : (ta > tb);
+}
+
+/**
+ * compare_missing_node - Compare two missing messages by node number
+ * @param a First ThreadCacheMissing to compare
+ * @param b Second ThreadCacheMissing to compare
+ * @retval <0 a precedes b
+ * @retval  0 a and b are identical
+ * @retval >0 b precedes a
+ */
+static int compare_missing_node(const void *a, const void *b)
+{
+  return ((const struct ThreadCacheMissing *) a)->node -
+         ((const struct ThreadCacheMissing *) b)->node;
+}
+
+/**
+ * thread_cache_save - Save the threads of a mailbox to the header cache
+ * @param ctx Mailbox
+ *
+ * This is called once the threads have been built, before they're sorted, so
+ * that thread_cache_load() can hand the same tree to mutt_sort_subthreads().
+ */
+static void thread_cache_save(struct Context *ctx)
+{
+  struct ThreadCacheHeader head = { 0 };
+  struct ThreadCacheNode *nodes = NULL;
+  struct ThreadCacheMissing *missing = NULL;
+  struct Email **emails = NULL;
+  int *parents = NULL;
+  int num_missing = 0;
+  size_t size = 0, depth = 0, max_depth = 0;
+
+  if (!ctx->tree)
+    return;
+
+  header_cache_t *hc = thread_cache_open(ctx);
+  if (!hc)
+    return;
+
+  emails = thread_cache_emails(ctx);
+  if (!emails)
+    goto done;
+
+  head.magic = THREAD_CACHE_MAGIC;
+  head.options = thread_cache_options();
+  head.msg_count = ctx->mailbox->msg_count;
+  thread_cache_digest(emails, head.msg_count, head.digest);
+
+  /* depth-first walk, remembering the node number of each ancestor */
+  for (struct MuttThread *t = ctx->tree; t;)
+  {
+    if (head.num_nodes == size)
+    {
+      size = MAX(size * 2, head.msg_count + 16);
+      mutt_mem_realloc(&nodes, size * sizeof(struct ThreadCacheNode));
+      mutt_mem_realloc(&missing, size * sizeof(struct ThreadCacheMissing));
+    }
+
+    struct ThreadCacheNode *node = &nodes[head.num_nodes];
+    node->parent = (depth > 0) ? parents[depth - 1] : -1;
+    node->index = t->message ? t->message->index : -1;
+    node->flags = 0;
+    if (t->fake_thread)
+      node->flags |= THREAD_CACHE_FAKE;
+    if (t->duplicate_thread)
+      node->flags |= THREAD_CACHE_DUPLICATE;
+    if (t->message && t->message->subject_changed)
+      node->flags |= THREAD_CACHE_SUBJECT;
+    if (!t->message)
+    {
+      missing[num_missing].thread = t;
+      missing[num_missing].node = head.num_nodes;
+      missing[num_missing].id = NULL;
+      num_missing++;
+    }
+
+    if (t->child)
+    {
+      if (depth == max_depth)
+      {
+        max_depth = MAX(max_depth * 2, 64);
+        mutt_mem_realloc(&parents, max_depth * sizeof(int));
+      }
+      parents[depth++] = head.num_nodes++;
+      t = t->child;
+      continue;
+    }
+    head.num_nodes++;
+
+    while (t && !t->next)
+    {
+      t = t->parent;
+      depth--;
+    }
+    if (t)
+      t = t->next;
+  }
+
+  /* the missing messages are only known by their key in the thread hash */
+  if (num_missing > 0)
+  {
+    qsort(missing, num_missing, sizeof(*missing), compare_missing);
+
+    struct HashWalkState state = { 0 };
+    struct HashElem *he = NULL;
+    while ((he = mutt_hash_walk(ctx->thread_hash, &state)))
+    {
+      struct MuttThread *t = he->data;
+      if (t->message)
+        continue;
+
+      struct ThreadCacheMissing key = { .thread = t };
+      struct ThreadCacheMissing *m =
+          bsearch(&key, missing, num_missing, sizeof(*missing), compare_missing);
+      if (m && !m->id)
+        m->id = he->key.strkey;
+    }
+
+    qsort(missing, num_missing, sizeof(*missing), compare_missing_node);
+    for (int i = 0; i < num_missing; i++)
+    {
+      if (!missing[i].id)
+        goto done;
+      head.ids_len += strlen(missing[i].id) + 1;
+    }
+  }
+
+  const size_t nodes_len = head.num_nodes * sizeof(struct ThreadCacheNode);
+  size_t dlen = sizeof(head) + nodes_len + head.ids_len;
+  char *data = mutt_mem_malloc(dlen);
+  char *p = data;
+
+  memcpy(p, &head, sizeof(head));
+  p += sizeof(head);
+  memcpy(p, nodes, nodes_len);
+  p += nodes_len;
+  for (int i = 0; i < num_missing; i++)
+  {
+    size_t len = strlen(missing[i].id) + 1;
+    memcpy(p, missing[i].id, len);
+    p += len;
+  }
+
+  mutt_hcache_store_raw(hc, THREAD_CACHE_KEY, strlen(THREAD_CACHE_KEY), data, dlen);
+  FREE(&data);
+  mutt_debug(2, "%s: saved %d thread nodes\n", ctx->mailbox->path, head.num_nodes);
+
+done:
+  FREE(&parents);
+  FREE(&missing);
+  FREE(&nodes);
+  FREE(&emails);
+  mutt_hcache_close(hc);
+}
+
+/**
+ * thread_cache_load - Restore the threads of a mailbox from the header cache
+ * @param ctx Mailbox
+ * @retval true  The threads were restored, and only need sorting
+ * @retval false The threads must be built
+ *
+ * The threads are only restored if the emails and the threading config are
+ * the same as when they were saved.  On success, the thread hash is rebuilt
+ * too, so that new mail can be threaded in as usual.
+ */
+static bool thread_cache_load(struct Context *ctx)
+{
+  struct ThreadCacheHeader head;
+  struct Email **emails = NULL;
+  struct MuttThread **threads = NULL;
+  unsigned char digest[16];
+  bool rc = false;
+
+  header_cache_t *hc = thread_cache_open(ctx);
+  if (!hc)
+    return false;
+
+  char *data = mutt_hcache_fetch_raw(hc, THREAD_CACHE_KEY, strlen(THREAD_CACHE_KEY));
+  if (!data)
+    goto done;
+
+  memcpy(&head, data, sizeof(head));
+  if ((head.magic != THREAD_CACHE_MAGIC) || (head.options != thread_cache_options()) ||
+      (head.msg_count != ctx->mailbox->msg_count) || (head.num_nodes < head.msg_count))
+  {
+    goto done;
+  }
+
+  emails = thread_cache_emails(ctx);
+  if (!emails)
+    goto done;
+
+  thread_cache_digest(emails, head.msg_count, digest);
+  if (memcmp(digest, head.digest, sizeof(digest)) != 0)
+  {
+    mutt_debug(2, "%s: threads have changed\n", ctx->mailbox->path);
+    goto done;
+  }
+
+  /* check everything before building anything */
+  const struct ThreadCacheNode *nodes =
+      (const struct ThreadCacheNode *) (data + sizeof(head));
+  const char *ids = (const char *) (nodes + head.num_nodes);
+  int num_missing = 0, num_found = 0;
+  for (int i = 0; i < head.num_nodes; i++)
+  {
+    if ((nodes[i].parent < -1) || (nodes[i].parent >= i) ||
+        (nodes[i].index < -1) || (nodes[i].index >= head.msg_count))
+    {
+      goto done;
+    }
+    if (nodes[i].index < 0)
+      num_missing++;
+    else
+      num_found++;
+  }
+  if ((num_found != head.msg_count) || (head.ids_len < (size_t) num_missing) ||
+      (head.ids_len && (ids[head.ids_len - 1] != '\0')))
+  {
+    goto done;
+  }
+
+  ctx->thread_hash = mutt_hash_create(ctx->mailbox->msg_count * 2, MUTT_HASH_ALLOW_DUPS);
+  threads = mutt_mem_calloc(head.num_nodes, sizeof(struct MuttThread *));
+  for (int i = 0; i < head.num_nodes; i++)
+    threads[i] = thread_new(ctx);
+
+  /* the ids are kept with the nodes, as the keys of the thread hash */
+  char *id = NULL;
+  if (head.ids_len > 0)
+  {
+    ctx->thread_arena->ids = mutt_mem_malloc_tag(MEM_TAG_THREAD, head.ids_len);
+    ctx->thread_arena->ids_len = head.ids_len;
+    memcpy(ctx->thread_arena->ids, ids, head.ids_len);
+    id = ctx->thread_arena->ids;
+  }
+
+  for (int i = 0; i < head.num_nodes; i++)
+  {
+    struct MuttThread *t = threads[i];
+    t->fake_thread = (nodes[i].flags & THREAD_CACHE_FAKE);
+    t->duplicate_thread = (nodes[i].flags & THREAD_CACHE_DUPLICATE);
+
+    if (nodes[i].index >= 0)
+    {
+      struct Email *e = emails[nodes[i].index];
+      t->message = e;
+      e->thread = t;
+      e->threaded = true;
+      e->subject_changed = (nodes[i].flags & THREAD_CACHE_SUBJECT);
+      mutt_hash_insert(ctx->thread_hash, e->env->message_id ? e->env->message_id : "", t);
+    }
+    else if (id < ctx->thread_arena->ids + head.ids_len)
+    {
+      mutt_hash_insert(ctx->thread_hash, id, t);
+      id += strlen(id) + 1;
+    }
+  }
+
+  /* link backwards, so the siblings keep their order */
+  for (int i = head.num_nodes - 1; i >= 0; i--)
+  {
+    if (nodes[i].parent < 0)
+      insert_message(&ctx->tree, NULL, threads[i]);
+    else
+      insert_message(&threads[nodes[i].parent]->child, threads[nodes[i].parent], threads[i]);
+  }
+
+  mutt_debug(2, "%s: restored %d thread nodes\n", ctx->mailbox->path, head.num_nodes);
+  rc = true;
+
+done:
+  FREE(&threads);
+  FREE(&emails);
+  mutt_hcache_free(hc, (void **) &data);
+  mutt_hcache_close(hc);
+  return rc;
+}
+#endif /* USE_HCACHE */
+
 /**
  * compare_threads - Sorting function for email threads
  * @param a First thread to compare
@@ -779,7 +1477,8 @@ static void check_subjects(struct Context *ctx, bool init)
       tmp = tmp->parent;
     }
 
-    if (!tmp)
+    /* a subject that hasn't been read yet may turn out to be different */
+    if (!tmp || cur->header_pending || tmp->message->header_pending)
       cur->subject_changed = true;
     else if (cur->env->real_subj && tmp->message->env->real_subj)
     {
@@ -794,6 +1493,108 @@ static void check_subjects(struct Context *ctx, bool init)
   }
 }
 
+#ifdef USE_IMAP
+/**
+ * thread_server_load - Use the threads built by the IMAP server
+ * @param ctx Mailbox
+ * @retval true  The threads were built, and only need sorting
+ * @retval false The threads must be built locally
+ *
+ * The server's threading replaces NeoMutt's, so $strict_threads and
+ * $duplicate_threads don't apply.  New mail is threaded in locally.
+ *
+ * The headers aren't needed, see $imap_lazy_headers, but new mail can only be
+ * threaded onto the emails whose headers had been read.
+ */
+static bool thread_server_load(struct Context *ctx)
+{
+  struct ThreadNode *nodes = NULL;
+
+  if (ctx->mailbox->magic != MUTT_IMAP)
+    return false;
+
+  const int num = imap_thread_mailbox(ctx->mailbox, &nodes);
+  if (num < 0)
+    return false;
+
+  ctx->thread_hash = mutt_hash_create(ctx->mailbox->msg_count * 2, MUTT_HASH_ALLOW_DUPS);
+  struct MuttThread **threads = mutt_mem_calloc(num, sizeof(struct MuttThread *));
+  for (int i = 0; i < num; i++)
+  {
+    struct MuttThread *t = thread_new(ctx);
+    threads[i] = t;
+
+    struct Email *e = nodes[i].email;
+    if (!e)
+      continue;
+    t->message = e;
+    t->check_subject = true;
+    e->thread = t;
+    e->threaded = true;
+    mutt_hash_insert(ctx->thread_hash, e->env->message_id ? e->env->message_id : "", t);
+  }
+
+  /* link backwards, so the siblings keep their order */
+  for (int i = num - 1; i >= 0; i--)
+  {
+    if (nodes[i].parent < 0)
+      insert_message(&ctx->tree, NULL, threads[i]);
+    else
+      insert_message(&threads[nodes[i].parent]->child, threads[nodes[i].parent], threads[i]);
+  }
+
+  check_subjects(ctx, true);
+
+  FREE(&threads);
+  FREE(&nodes);
+  return true;
+}
+#endif
+
+/**
+ * new_subjects_unique - Can the new emails be threaded without the subjects?
+ * @param ctx Mailbox
+ * @retval true The subject threading can be kept
+ *
+ * Threading by subject looks at every thread, so it's only redone if a new
+ * email could change it.  That's when it has the same subject as another
+ * email, or when it's a message that other emails already refer to.
+ */
+static bool new_subjects_unique(struct Context *ctx)
+{
+  int num_new = 0;
+
+  if (!ctx->mailbox->subj_hash)
+    return false;
+
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    struct Email *cur = ctx->mailbox->hdrs[i];
+    if (cur->thread)
+      continue;
+
+    num_new++;
+    if (cur->env->message_id && mutt_hash_find(ctx->thread_hash, cur->env->message_id))
+      return false;
+    if (!cur->env->real_subj)
+      continue;
+
+    for (struct HashElem *ptr = mutt_hash_find_bucket(ctx->mailbox->subj_hash,
+                                                      cur->env->real_subj);
+         ptr; ptr = ptr->next)
+    {
+      if ((ptr->data != cur) &&
+          (mutt_str_strcmp(((struct Email *) ptr->data)->env->real_subj,
+                           cur->env->real_subj) == 0))
+      {
+        return false;
+      }
+    }
+  }
+
+  return (num_new > 0);
+}
+
 /**
  * mutt_sort_threads - Sort email threads
  * @param ctx  Mailbox
@@ -807,6 +1608,8 @@ void mutt_sort_threads(struct Context *ctx, bool init)
   memset(&top, 0, sizeof(top));
   struct ListNode *ref = NULL;
 
+  mutt_trace_begin("sort_threads", NULL);
+
   /* set Sort to the secondary method to support the set sort_aux=reverse-*
    * settings.  The sorting functions just look at the value of
    * SORT_REVERSE
@@ -819,9 +1622,31 @@ void mutt_sort_threads(struct Context *ctx, bool init)
 
   if (init)
   {
+#ifdef USE_IMAP
+    if (thread_server_load(ctx))
+      goto sort;
+#endif
+    /* anything else needs the headers */
+    mx_mbox_load_headers(ctx);
+#ifdef USE_HCACHE
+    if (thread_cache_load(ctx))
+      goto sort;
+#endif
     ctx->thread_hash = mutt_hash_create(ctx->mailbox->msg_count * 2, MUTT_HASH_ALLOW_DUPS);
-    mutt_hash_set_destructor(ctx->thread_hash, thread_hash_destructor, 0);
   }
+  else
+  {
+    /* the new emails are threaded by their headers */
+    for (i = 0; i < ctx->mailbox->msg_count; i++)
+      if (!ctx->mailbox->hdrs[i]->thread)
+        mx_msg_load_header(ctx, ctx->mailbox->hdrs[i]);
+  }
+
+  /* If new mail can't change the threading by subject, the new emails are
+   * just linked in, and only the threads they join are sorted again */
+  const bool subjects = !StrictThreads && (init || !new_subjects_unique(ctx));
+  if (subjects && !init)
+    mx_mbox_load_headers(ctx);
 
   /* we want a quick way to see if things are actually attached to the top of the
    * thread tree or if they're just dangling, so we attach everything to a top
@@ -890,7 +1715,7 @@ void mutt_sort_threads(struct Context *ctx, bool init)
       {
         new = (DuplicateThreads ? thread : NULL);
 
-        thread = mutt_mem_calloc(1, sizeof(struct MuttThread));
+        thread = thread_new(ctx);
         thread->message = cur;
         thread->check_subject = true;
         cur->thread = thread;
@@ -910,7 +1735,7 @@ void mutt_sort_threads(struct Context *ctx, bool init)
         }
       }
     }
-    else
+    else if (subjects)
     {
       /* unlink pseudo-threads because they might be children of newly
        * arrived messages */
@@ -983,7 +1808,7 @@ void mutt_sort_threads(struct Context *ctx, bool init)
       new = mutt_hash_find(ctx->thread_hash, ref->data);
       if (!new)
       {
-        new = mutt_mem_calloc(1, sizeof(struct MuttThread));
+        new = thread_new(ctx);
         mutt_hash_insert(ctx->thread_hash, ref->data, new);
       }
       else
@@ -1015,9 +1840,17 @@ void mutt_sort_threads(struct Context *ctx, bool init)
 
   check_subjects(ctx, init);
 
-  if (!StrictThreads)
+  if (subjects)
     pseudo_threads(ctx);
 
+#ifdef USE_HCACHE
+  if (init)
+    thread_cache_save(ctx);
+#endif
+
+#if defined(USE_HCACHE) || defined(USE_IMAP)
+sort:
+#endif
   if (ctx->tree)
   {
     ctx->tree = mutt_sort_subthreads(ctx->tree, init);
@@ -1031,6 +1864,8 @@ void mutt_sort_threads(struct Context *ctx, bool init)
     /* Draw the thread tree. */
     mutt_draw_tree(ctx);
   }
+
+  mutt_trace_end("sort_threads");
 }
 
 /**
@@ -1149,6 +1984,10 @@ int mutt_parent_message(struct Context *ctx, struct Email *e, bool find_root)
 /**
  * mutt_set_virtual - Set the virtual index number of all the messages in a mailbox
  * @param ctx Mailbox
+ *
+ * The number of hidden messages is only used by collapsed threads, so only
+ * their visible message walks the thread to count them.  Counting for every
+ * message made a full index quadratic in the size of its threads.
  */
 void mutt_set_virtual(struct Context *ctx)
 {
@@ -1168,7 +2007,7 @@ void mutt_set_virtual(struct Context *ctx)
       ctx->mailbox->vcount++;
       ctx->vsize += cur->content->length + cur->content->offset -
                     cur->content->hdr_offset + padding;
-      cur->num_hidden = mutt_get_hidden(ctx, cur);
+      cur->num_hidden = cur->collapsed ? mutt_get_hidden(ctx, cur) : 0;
     }
   }
 }
@@ -1227,7 +2066,7 @@ int mutt_traverse_thread(struct Context *ctx, struct Email *cur, int flag)
 
   if (flag & (MUTT_THREAD_COLLAPSE | MUTT_THREAD_UNCOLLAPSE))
   {
-    cur->pair = 0; /* force index entry's color to be re-evaluated */
+    cur->pair_valid = false; /* force index entry's color to be re-evaluated */
     cur->collapsed = flag & MUTT_THREAD_COLLAPSE;
     if (cur->virtual != -1)
     {
@@ -1260,7 +2099,7 @@ int mutt_traverse_thread(struct Context *ctx, struct Email *cur, int flag)
     {
       if (flag & (MUTT_THREAD_COLLAPSE | MUTT_THREAD_UNCOLLAPSE))
       {
-        cur->pair = 0; /* force index entry's color to be re-evaluated */
+        cur->pair_valid = false; /* force index entry's color to be re-evaluated */
         cur->collapsed = flag & MUTT_THREAD_COLLAPSE;
         if (!roothdr && CHECK_LIMIT)
         {
@@ -1408,6 +2247,114 @@ struct Hash *mutt_make_id_hash(struct Mailbox *mailbox)
   return hash;
 }
 
+/**
+ * struct DupCount - The emails in a Mailbox with one Message-ID
+ */
+struct DupCount
+{
+  struct Email *first; ///< The original, the others are duplicates
+  unsigned int count;  ///< Number of emails with the Message-ID
+};
+
+/**
+ * dup_count_free - Free a DupCount - Implements ::hash_destructor_t
+ */
+static void dup_count_free(int type, void *obj, intptr_t data)
+{
+  FREE(&obj);
+}
+
+/**
+ * mutt_dup_hash_add - Count an email in the Message-ID multiset
+ * @param mailbox Mailbox
+ * @param e       Email
+ *
+ * Nothing is done until mutt_dup_hash_init() has built the multiset.
+ */
+void mutt_dup_hash_add(struct Mailbox *mailbox, struct Email *e)
+{
+  if (!mailbox || !mailbox->dup_hash || !e->env || !e->env->message_id)
+    return;
+
+  struct DupCount *dc = mutt_hash_find(mailbox->dup_hash, e->env->message_id);
+  if (dc)
+  {
+    dc->count++;
+    return;
+  }
+
+  dc = mutt_mem_malloc(sizeof(*dc));
+  dc->first = e;
+  dc->count = 1;
+  mutt_hash_insert(mailbox->dup_hash, e->env->message_id, dc);
+}
+
+/**
+ * mutt_dup_hash_remove - Stop counting an email in the Message-ID multiset
+ * @param mailbox Mailbox
+ * @param e       Email
+ */
+void mutt_dup_hash_remove(struct Mailbox *mailbox, struct Email *e)
+{
+  if (!mailbox || !mailbox->dup_hash || !e->env || !e->env->message_id)
+    return;
+
+  struct DupCount *dc = mutt_hash_find(mailbox->dup_hash, e->env->message_id);
+  if (!dc)
+    return;
+
+  if (dc->count <= 1)
+  {
+    mutt_hash_delete(mailbox->dup_hash, e->env->message_id, dc);
+    return;
+  }
+
+  dc->count--;
+  /* Which copy is the original now depends on the order; let the next
+   * lookup rebuild the multiset. */
+  if (dc->first == e)
+    mutt_hash_destroy(&mailbox->dup_hash);
+}
+
+/**
+ * mutt_dup_hash_init - Build the Message-ID multiset
+ * @param mailbox Mailbox
+ *
+ * This is done by mutt_email_is_duplicate() when it's first needed.  A search
+ * on several threads must do it first, because the workers may only read it.
+ */
+void mutt_dup_hash_init(struct Mailbox *mailbox)
+{
+  if (!mailbox || mailbox->dup_hash)
+    return;
+
+  mailbox->dup_hash = mutt_hash_create(mailbox->msg_count * 2, MUTT_HASH_STRDUP_KEYS);
+  mutt_hash_set_destructor(mailbox->dup_hash, dup_count_free, 0);
+  for (int i = 0; i < mailbox->msg_count; i++)
+    mutt_dup_hash_add(mailbox, mailbox->hdrs[i]);
+}
+
+/**
+ * mutt_email_is_duplicate - Does another email have the same Message-ID?
+ * @param mailbox Mailbox
+ * @param e       Email
+ * @retval true The email is a copy of an earlier one
+ *
+ * The first email of the Mailbox with a Message-ID is the original, the others
+ * are its duplicates.  The Message-IDs are counted once, then the multiset is
+ * kept up to date as emails are added and expunged.
+ */
+bool mutt_email_is_duplicate(struct Mailbox *mailbox, struct Email *e)
+{
+  if (!mailbox || !e->env || !e->env->message_id)
+    return false;
+
+  mutt_dup_hash_init(mailbox);
+
+  struct DupCount *dc = mutt_hash_find(mailbox->dup_hash, e->env->message_id);
+  return dc && (dc->count > 1) && (dc->first != e);
+}
+
 /**
  * link_threads - Forcibly link messages together
  * @param parent Header of parent message
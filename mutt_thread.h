@@ -41,6 +41,20 @@ extern bool NarrowTree;
 extern bool SortRe;
 extern bool StrictThreads;
 extern bool ThreadReceived;
+#ifdef USE_HCACHE
+extern bool HeaderCacheThreads;
+#endif
+
+/**
+ * struct ThreadNode - One node of a thread tree built elsewhere, e.g. by an IMAP server
+ *
+ * The nodes are in depth-first order, so a parent always precedes its children.
+ */
+struct ThreadNode
+{
+  int parent;         ///< Node of the parent, or -1 for a top-level thread
+  struct Email *email; ///< Email, or NULL if the message is missing
+};
 
 #define MUTT_THREAD_COLLAPSE    (1 << 0)
 #define MUTT_THREAD_UNCOLLAPSE  (1 << 1)
@@ -65,6 +79,7 @@ int mutt_traverse_thread(struct Context *ctx, struct Email *cur, int flag);
 
 int mutt_link_threads(struct Email *cur, struct Email *last, struct Context *ctx);
 int mutt_messages_in_thread(struct Context *ctx, struct Email *e, int flag);
+void mutt_draw_thread(struct Email *e);
 void mutt_draw_tree(struct Context *ctx);
 
 void mutt_clear_threads(struct Context *ctx);
@@ -73,5 +88,9 @@ void mutt_sort_threads(struct Context *ctx, bool init);
 int mutt_parent_message(struct Context *ctx, struct Email *e, bool find_root);
 void mutt_set_virtual(struct Context *ctx);
 struct Hash *mutt_make_id_hash(struct Mailbox *mailbox);
+void mutt_dup_hash_add(struct Mailbox *mailbox, struct Email *e);
+void mutt_dup_hash_init(struct Mailbox *mailbox);
+void mutt_dup_hash_remove(struct Mailbox *mailbox, struct Email *e);
+bool mutt_email_is_duplicate(struct Mailbox *mailbox, struct Email *e);
 
 #endif /* MUTT_MUTT_THREAD_H */
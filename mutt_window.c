@@ -43,6 +43,37 @@ struct MuttWindow *MuttMessageWindow = NULL; /**< Message Window */
 struct MuttWindow *MuttSidebarWindow = NULL; /**< Sidebar Window */
 #endif
 
+/**
+ * struct WindowRow - What was last drawn on a row of a Window
+ */
+struct WindowRow
+{
+  char *text;       ///< Text of the row
+  int attr;         ///< Colour of the row
+  int colors;       ///< Hash of the colours embedded in the text
+  unsigned int gen; ///< Screen generation the row was drawn in
+};
+
+/**
+ * struct WindowDamage - Rows last drawn in a Window
+ *
+ * Only the Index and Sidebar are tracked.  The other Windows are small, or
+ * always redrawn completely.
+ */
+struct WindowDamage
+{
+  struct WindowRow *rows;
+  int num_rows;
+};
+
+static struct WindowDamage IndexDamage;
+#ifdef USE_SIDEBAR
+static struct WindowDamage SidebarDamage;
+#endif
+
+/* Bumped whenever the Windows are laid out again, which forgets every row */
+static unsigned int ScreenGen = 1;
+
 #ifdef USE_SLANG_CURSES
 /**
  * vw_printw - Write a formatted string to a Window (function missing from Slang)
@@ -105,6 +136,21 @@ void mutt_window_clrtoeol(struct MuttWindow *win)
  */
 void mutt_window_free(void)
 {
+  struct WindowDamage *damage[] = {
+    &IndexDamage,
+#ifdef USE_SIDEBAR
+    &SidebarDamage,
+#endif
+  };
+
+  for (size_t i = 0; i < mutt_array_size(damage); i++)
+  {
+    for (int r = 0; r < damage[i]->num_rows; r++)
+      FREE(&damage[i]->rows[r].text);
+    FREE(&damage[i]->rows);
+    damage[i]->num_rows = 0;
+  }
+
   FREE(&MuttHelpWindow);
   FREE(&MuttIndexWindow);
   FREE(&MuttStatusWindow);
@@ -226,6 +272,9 @@ void mutt_window_reflow(void)
 
   mutt_debug(2, "entering\n");
 
+  /* the screen is about to be cleared */
+  ScreenGen++;
+
   MuttStatusWindow->rows = 1;
   MuttStatusWindow->cols = COLS;
   MuttStatusWindow->row_offset = StatusOnTop ? 0 : LINES - 2;
@@ -277,6 +326,8 @@ void mutt_window_reflow(void)
  */
 void mutt_window_reflow_message_rows(int mw_rows)
 {
+  ScreenGen++;
+
   MuttMessageWindow->rows = mw_rows;
   MuttMessageWindow->row_offset = LINES - mw_rows;
 
@@ -298,6 +349,82 @@ void mutt_window_reflow_message_rows(int mw_rows)
   mutt_menu_set_current_redraw_full();
 }
 
+/**
+ * window_damage - Get the damage tracker of a Window
+ * @param win Window
+ * @retval ptr  Rows drawn in the Window
+ * @retval NULL The Window isn't tracked
+ */
+static struct WindowDamage *window_damage(struct MuttWindow *win)
+{
+  if (!win)
+    return NULL;
+  if (win == MuttIndexWindow)
+    return &IndexDamage;
+#ifdef USE_SIDEBAR
+  if (win == MuttSidebarWindow)
+    return &SidebarDamage;
+#endif
+  return NULL;
+}
+
+/**
+ * mutt_window_row_damage - Forget what was drawn on a row of a Window
+ * @param win Window
+ * @param row Row that was drawn without mutt_window_row_unchanged()
+ */
+void mutt_window_row_damage(struct MuttWindow *win, int row)
+{
+  struct WindowDamage *damage = window_damage(win);
+  if (!damage || (row < 0) || (row >= damage->num_rows))
+    return;
+
+  damage->rows[row].gen = 0;
+}
+
+/**
+ * mutt_window_row_unchanged - Is a row of a Window already showing this?
+ * @param win    Window
+ * @param row    Row
+ * @param text   Text to draw on the row
+ * @param attr   Colour of the row
+ * @param colors Hash of any other colours that affect the row
+ * @retval true  The row is already on screen, there's no need to draw it
+ * @retval false The row has changed, the caller must draw it
+ *
+ * The Window remembers what was drawn on each row until it's laid out again.
+ * A row is recorded as drawn when this function returns false, so the caller
+ * must draw it.
+ */
+bool mutt_window_row_unchanged(struct MuttWindow *win, int row, const char *text,
+                               int attr, int colors)
+{
+  struct WindowDamage *damage = window_damage(win);
+  if (!damage || (row < 0) || (row >= win->rows))
+    return false;
+
+  if (row >= damage->num_rows)
+  {
+    mutt_mem_realloc(&damage->rows, win->rows * sizeof(struct WindowRow));
+    memset(damage->rows + damage->num_rows, 0,
+           (win->rows - damage->num_rows) * sizeof(struct WindowRow));
+    damage->num_rows = win->rows;
+  }
+
+  struct WindowRow *wr = &damage->rows[row];
+  if ((wr->gen == ScreenGen) && (wr->attr == attr) && (wr->colors == colors) &&
+      (mutt_str_strcmp(wr->text, text) == 0))
+  {
+    return true;
+  }
+
+  mutt_str_replace(&wr->text, text);
+  wr->attr = attr;
+  wr->colors = colors;
+  wr->gen = ScreenGen;
+  return false;
+}
+
 /**
  * mutt_window_wrap_cols - Calculate the wrap column for a Window
  * @param win  Window
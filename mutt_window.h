@@ -23,6 +23,7 @@
 #ifndef MUTT_MUTT_WINDOW_H
 #define MUTT_MUTT_WINDOW_H
 
+#include <stdbool.h>
 #include "mutt_curses.h"
 
 /**
@@ -57,6 +58,8 @@ int  mutt_window_mvaddstr(struct MuttWindow *win, int row, int col, const char *
 int  mutt_window_mvprintw(struct MuttWindow *win, int row, int col, const char *fmt, ...);
 void mutt_window_reflow_message_rows(int mw_rows);
 void mutt_window_reflow(void);
+void mutt_window_row_damage(struct MuttWindow *win, int row);
+bool mutt_window_row_unchanged(struct MuttWindow *win, int row, const char *text, int attr, int colors);
 int  mutt_window_wrap_cols(struct MuttWindow *win, short wrap);
 
 #endif /* MUTT_MUTT_WINDOW_H */
@@ -754,528 +754,880 @@ void mutt_safe_path(char *buf, size_t buflen, struct Address *a)
 }
 
 /**
- * mutt_expando_format - Expand expandos (%x) in a string
- * @param[out] buf      Buffer in which to save string
- * @param[in]  buflen   Buffer length
- * @param[in]  col      Starting column
- * @param[in]  cols     Number of screen columns
- * @param[in]  src      Printf-like format string
- * @param[in]  callback Callback - Implements ::format_t
- * @param[in]  data     Callback data
- * @param[in]  flags    Callback flags
+ * enum ExpandoOpType - Type of a step of a compiled format string
  */
-void mutt_expando_format(char *buf, size_t buflen, size_t col, int cols, const char *src,
-                         format_t *callback, unsigned long data, enum FormatFlag flags)
+enum ExpandoOpType
 {
-  char prefix[SHORT_STRING], tmp[LONG_STRING], *cp = NULL, *wptr = buf, ch;
-  char if_str[SHORT_STRING], else_str[SHORT_STRING];
-  size_t wlen, count, len, wid;
-  FILE *filter = NULL;
-  char *recycler = NULL;
+  EXP_OP_TEXT,    ///< Literal text, escapes already expanded
+  EXP_OP_EXPANDO, ///< %x, expanded by the callback
+  EXP_OP_PAD,     ///< %>X or %*X, pad to the right-hand contents
+  EXP_OP_FILL,    ///< %|X, pad to the end of the line
+  EXP_OP_STOP,    ///< Bad format, ignore the rest of the string
+};
 
-  char src2[STRING];
-  mutt_str_strfcpy(src2, src, mutt_str_strlen(src) + 1);
-  src = src2;
+/**
+ * struct ExpandoOp - A step of a compiled format string
+ */
+struct ExpandoOp
+{
+  enum ExpandoOpType type;
+  size_t next;           ///< Offset following the op, as passed to the callback
+  struct ExpandoOp *all; ///< Next op allocated for this format
+  char *text;            ///< EXP_OP_TEXT: Literal text
+  size_t bytes;          ///< EXP_OP_TEXT: Length of text
+  int width;             ///< EXP_OP_TEXT: Screen width of text
+  char ch;               ///< EXP_OP_EXPANDO: Expando character
+  bool optional;         ///< Expando is a conditional, %<x?y&z>
+  bool tolower;          ///< EXP_OP_EXPANDO: Modifier %_x
+  bool nodots;           ///< EXP_OP_EXPANDO: Modifier %:x
+  bool soft;             ///< EXP_OP_PAD: Right hand side takes precedence, %*X
+  int pl;                ///< EXP_OP_PAD, EXP_OP_FILL: Length of the pad character
+  int pw;                ///< EXP_OP_PAD, EXP_OP_FILL: Width of the pad character
+  char prefix[SHORT_STRING];
+  char if_str[SHORT_STRING];
+  char else_str[SHORT_STRING];
+};
 
-  prefix[0] = '\0';
-  buflen--; /* save room for the terminal \0 */
-  wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && ArrowCursor) ? 3 : 0;
-  col += wlen;
+/**
+ * struct ExpandoProg - A compiled format string
+ *
+ * The format string is compiled lazily into ops, indexed by their offset in
+ * the string.  Callbacks may consume characters after their expando, so the
+ * op to run next is the one at the offset the callback returns.
+ */
+struct ExpandoProg
+{
+  char *src;               ///< Format string, as given
+  char *str;               ///< Working copy, %? rewritten to %<
+  size_t size;             ///< Size of str and ops
+  size_t hash;             ///< Hash of src
+  struct ExpandoOp **ops;  ///< Op compiled at each offset of str
+  struct ExpandoOp *all;   ///< All the ops allocated
+  unsigned long last_used; ///< Time of last use, for eviction
+  int busy;                ///< Number of expansions using the program
+  bool cached;             ///< Program is in ExpandoCache
+};
+
+#define EXPANDO_CACHE 32 ///< Number of compiled format strings to keep
+
+static struct ExpandoProg *ExpandoCache[EXPANDO_CACHE];
+static unsigned long ExpandoClock = 0;
+
+/**
+ * expando_hash - Hash a format string
+ * @param s String
+ * @retval num Hash
+ */
+static size_t expando_hash(const char *s)
+{
+  size_t h = 0;
+  while (*s)
+    h = (h * 33) + (unsigned char) *s++;
+  return h;
+}
+
+/**
+ * expando_prog_free - Free a compiled format string
+ * @param ptr Program to free
+ */
+static void expando_prog_free(struct ExpandoProg **ptr)
+{
+  if (!ptr || !*ptr)
+    return;
 
-  if ((flags & MUTT_FORMAT_NOFILTER) == 0)
+  struct ExpandoProg *prog = *ptr;
+  struct ExpandoOp *op = prog->all;
+  while (op)
   {
-    int off = -1;
+    struct ExpandoOp *next = op->all;
+    FREE(&op->text);
+    FREE(&op);
+    op = next;
+  }
+  FREE(&prog->ops);
+  FREE(&prog->str);
+  FREE(&prog->src);
+  FREE(ptr);
+}
+
+/**
+ * expando_prog_get - Get the compiled version of a format string
+ * @param src Format string
+ * @retval ptr Program, release with expando_prog_release()
+ *
+ * The programs are kept in a small cache, keyed by the contents of the format
+ * string, so changing a config variable simply uses a new program.  A program
+ * that's in use is never evicted.
+ */
+static struct ExpandoProg *expando_prog_get(const char *src)
+{
+  const size_t hash = expando_hash(src);
+  int slot = -1;
 
-    /* Do not consider filters if no pipe at end */
-    int n = mutt_str_strlen(src);
-    if (n > 1 && src[n - 1] == '|')
+  for (int i = 0; i < EXPANDO_CACHE; i++)
+  {
+    struct ExpandoProg *prog = ExpandoCache[i];
+    if (!prog)
     {
-      /* Scan backwards for backslashes */
-      off = n;
-      while (off > 0 && src[off - 2] == '\\')
-        off--;
+      if (slot < 0)
+        slot = i;
+      continue;
     }
-
-    /* If number of backslashes is even, the pipe is real. */
-    /* n-off is the number of backslashes. */
-    if (off > 0 && ((n - off) % 2) == 0)
+    if ((prog->hash == hash) && (mutt_str_strcmp(prog->src, src) == 0))
     {
-      char srccopy[LONG_STRING];
-      int i = 0;
+      prog->last_used = ++ExpandoClock;
+      prog->busy++;
+      return prog;
+    }
+    if ((prog->busy == 0) &&
+        ((slot < 0) || (ExpandoCache[slot] && (prog->last_used < ExpandoCache[slot]->last_used))))
+    {
+      slot = i;
+    }
+  }
 
-      mutt_debug(3, "fmtpipe = %s\n", src);
+  struct ExpandoProg *prog = mutt_mem_calloc(1, sizeof(*prog));
+  const size_t len = mutt_str_strlen(src);
+  prog->src = mutt_str_strdup(src);
+  /* room for the escapes added while rewriting %? */
+  prog->size = (3 * len) + 2;
+  prog->str = mutt_mem_calloc(prog->size, 1);
+  memcpy(prog->str, src, len);
+  prog->ops = mutt_mem_calloc(prog->size, sizeof(struct ExpandoOp *));
+  prog->hash = hash;
+  prog->last_used = ++ExpandoClock;
+  prog->busy = 1;
+
+  if (slot >= 0)
+  {
+    expando_prog_free(&ExpandoCache[slot]);
+    ExpandoCache[slot] = prog;
+    prog->cached = true;
+  }
+  return prog;
+}
 
-      strncpy(srccopy, src, n);
-      srccopy[n - 1] = '\0';
+/**
+ * expando_prog_release - Finish using a compiled format string
+ * @param prog Program
+ */
+static void expando_prog_release(struct ExpandoProg *prog)
+{
+  prog->busy--;
+  if (!prog->cached && (prog->busy == 0))
+    expando_prog_free(&prog);
+}
 
-      /* prepare BUFFERs */
-      struct Buffer *srcbuf = mutt_buffer_from(srccopy);
-      srcbuf->dptr = srcbuf->data;
-      struct Buffer *word = mutt_buffer_new();
-      struct Buffer *command = mutt_buffer_new();
+/**
+ * expando_op_new - Create a new op for a compiled format string
+ * @param prog Program
+ * @param off  Offset of the op
+ * @param type Type of op
+ * @retval ptr New op
+ */
+static struct ExpandoOp *expando_op_new(struct ExpandoProg *prog, size_t off,
+                                        enum ExpandoOpType type)
+{
+  struct ExpandoOp *op = mutt_mem_calloc(1, sizeof(*op));
+  op->type = type;
+  op->all = prog->all;
+  prog->all = op;
+  prog->ops[off] = op;
+  return op;
+}
 
-      /* Iterate expansions across successive arguments */
-      do
-      {
-        /* Extract the command name and copy to command line */
-        mutt_debug(3, "fmtpipe +++: %s\n", srcbuf->dptr);
-        if (word->data)
-          *word->data = '\0';
-        mutt_extract_token(word, srcbuf, 0);
-        mutt_debug(3, "fmtpipe %2d: %s\n", i++, word->data);
-        mutt_buffer_addch(command, '\'');
-        mutt_expando_format(tmp, sizeof(tmp), 0, cols, word->data, callback,
-                            data, flags | MUTT_FORMAT_NOFILTER);
-        for (char *p = tmp; p && *p; p++)
-        {
-          if (*p == '\'')
-          {
-            /* shell quoting doesn't permit escaping a single quote within
-             * single-quoted material.  double-quoting instead will lead
-             * shell variable expansions, so break out of the single-quoted
-             * span, insert a double-quoted single quote, and resume. */
-            mutt_buffer_addstr(command, "'\"'\"'");
-          }
-          else
-            mutt_buffer_addch(command, *p);
-        }
-        mutt_buffer_addch(command, '\'');
-        mutt_buffer_addch(command, ' ');
-      } while (MoreArgs(srcbuf));
+/**
+ * expando_escape - Expand a backslash escape of a format string
+ * @param ch Character following the backslash
+ * @retval char Character to display
+ */
+static char expando_escape(char ch)
+{
+  switch (ch)
+  {
+    case 'f':
+      return '\f';
+    case 'n':
+      return '\n';
+    case 'r':
+      return '\r';
+    case 't':
+      return '\t';
+    case 'v':
+      return '\v';
+    default:
+      return ch;
+  }
+}
 
-      mutt_debug(3, "fmtpipe > %s\n", command->data);
+/**
+ * expando_compile_text - Compile a run of literal text
+ * @param prog Program
+ * @param off  Offset of the text
+ * @retval ptr Op
+ *
+ * The text runs up to the next expando, escapes and %% included.
+ */
+static struct ExpandoOp *expando_compile_text(struct ExpandoProg *prog, size_t off)
+{
+  struct ExpandoOp *op = expando_op_new(prog, off, EXP_OP_TEXT);
+  const char *src = prog->str + off;
+  char *text = mutt_mem_malloc(mutt_str_strlen(src) + 1);
+  size_t bytes = 0;
+  int width = 0;
 
-      col -= wlen; /* reset to passed in value */
-      wptr = buf;  /* reset write ptr */
-      pid_t pid = mutt_create_filter(command->data, NULL, &filter, NULL);
-      if (pid != -1)
+  while (*src)
+  {
+    if (*src == '%')
+    {
+      if (src[1] != '%')
+        break;
+      text[bytes++] = '%';
+      width++;
+      src += 2;
+    }
+    else if (*src == '\\')
+    {
+      if (!src[1])
+        break;
+      text[bytes++] = expando_escape(src[1]);
+      width++;
+      src += 2;
+    }
+    else
+    {
+      int w;
+      /* in case of error, simply copy byte */
+      int n = mutt_mb_charlen(src, &w);
+      if (n < 0)
       {
-        int rc;
-
-        n = fread(buf, 1, buflen /* already decremented */, filter);
-        mutt_file_fclose(&filter);
-        rc = mutt_wait_filter(pid);
-        if (rc != 0)
-          mutt_debug(1, "format pipe command exited code %d\n", rc);
-        if (n > 0)
-        {
-          buf[n] = 0;
-          while ((n > 0) && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
-            buf[--n] = '\0';
-          mutt_debug(3, "fmtpipe < %s\n", buf);
-
-          /* If the result ends with '%', this indicates that the filter
-           * generated %-tokens that neomutt can expand.  Eliminate the '%'
-           * marker and recycle the string through mutt_expando_format().
-           * To literally end with "%", use "%%". */
-          if ((n > 0) && buf[n - 1] == '%')
-          {
-            n--;
-            buf[n] = '\0'; /* remove '%' */
-            if ((n > 0) && buf[n - 1] != '%')
-            {
-              recycler = mutt_str_strdup(buf);
-              if (recycler)
-              {
-                /* buflen is decremented at the start of this function
-                 * to save space for the terminal nul char.  We can add
-                 * it back for the recursive call since the expansion of
-                 * format pipes does not try to append a nul itself.
-                 */
-                mutt_expando_format(buf, buflen + 1, col, cols, recycler,
-                                    callback, data, flags);
-                FREE(&recycler);
-              }
-            }
-          }
-        }
-        else
-        {
-          /* read error */
-          mutt_debug(1, "error reading from fmtpipe: %s (errno=%d)\n",
-                     strerror(errno), errno);
-          *wptr = 0;
-        }
+        n = 1;
+        w = 1;
       }
-      else
+      memcpy(text + bytes, src, n);
+      bytes += n;
+      width += w;
+      src += n;
+    }
+  }
+
+  op->text = text;
+  op->bytes = bytes;
+  op->width = width;
+  op->next = src - prog->str;
+  return op;
+}
+
+/**
+ * expando_compile_percent - Compile an expando
+ * @param prog Program
+ * @param off  Offset of the '%'
+ * @retval ptr Op
+ */
+static struct ExpandoOp *expando_compile_percent(struct ExpandoProg *prog, size_t off)
+{
+  struct ExpandoOp *op = expando_op_new(prog, off, EXP_OP_STOP);
+  char *src = prog->str + off + 1;
+  char *cp = NULL;
+  size_t count;
+  char ch;
+
+  if (*src == '?')
+  {
+    /* change original %? to new %< notation */
+    /* %?x?y&z? to %<x?y&z> where y and z are nestable */
+    char *p = src;
+    *p = '<';
+    /* skip over "x" */
+    for (; *p && *p != '?'; p++)
+      ;
+    /* nothing */
+    if (*p == '?')
+      p++;
+    /* fix up the "y&z" section */
+    for (; *p && *p != '?'; p++)
+    {
+      /* escape '<' and '>' to work inside nested-if */
+      if ((*p == '<') || (*p == '>'))
       {
-        /* Filter failed; erase write buffer */
-        *wptr = '\0';
+        memmove(p + 2, p, mutt_str_strlen(p) + 1);
+        *p++ = '\\';
+        *p++ = '\\';
       }
+    }
+    if (*p == '?')
+      *p = '>';
 
-      mutt_buffer_free(&command);
-      mutt_buffer_free(&srcbuf);
-      mutt_buffer_free(&word);
-      return;
+    /* the rest of the string has moved */
+    memset(prog->ops + off + 1, 0, (prog->size - off - 1) * sizeof(struct ExpandoOp *));
+  }
+
+  if (*src == '<')
+  {
+    op->optional = true;
+    ch = *(++src); /* save the character to switch on */
+    if (!ch)
+      return op; /* bad format */
+    src++;
+    cp = op->prefix;
+    count = 0;
+    while ((count < sizeof(op->prefix) - 1) && *src && (*src != '?'))
+    {
+      *cp++ = *src++;
+      count++;
+    }
+    *cp = 0;
+  }
+  else
+  {
+    /* eat the format string */
+    cp = op->prefix;
+    count = 0;
+    while ((count < sizeof(op->prefix) - 1) && (isdigit((unsigned char) *src) ||
+                                               *src == '.' || *src == '-' || *src == '='))
+    {
+      *cp++ = *src++;
+      count++;
     }
+    *cp = 0;
+
+    if (!*src)
+      return op; /* bad format */
+
+    ch = *src++; /* save the character to switch on */
   }
 
-  while (*src && wlen < buflen)
+  if (op->optional)
   {
-    if (*src == '%')
+    int lrbalance;
+
+    if (*src != '?')
+      return op; /* bad format */
+    src++;
+
+    /* eat the `if' part of the string */
+    cp = op->if_str;
+    count = 0;
+    lrbalance = 1;
+    while ((lrbalance > 0) && (count < sizeof(op->if_str) - 2) && *src)
     {
-      if (*++src == '%')
+      if ((src[0] == '%') && (src[1] == '>'))
       {
-        *wptr++ = '%';
-        wlen++;
-        col++;
-        src++;
+        /* This is a padding expando; copy two chars and carry on */
+        *cp++ = *src++;
+        *cp++ = *src++;
+        count += 2;
         continue;
       }
 
-      if (*src == '?')
+      if (*src == '\\')
       {
-        /* change original %? to new %< notation */
-        /* %?x?y&z? to %<x?y&z> where y and z are nestable */
-        char *p = (char *) src;
-        *p = '<';
-        /* skip over "x" */
-        for (; *p && *p != '?'; p++)
-          ;
-        /* nothing */
-        if (*p == '?')
-          p++;
-        /* fix up the "y&z" section */
-        for (; *p && *p != '?'; p++)
-        {
-          /* escape '<' and '>' to work inside nested-if */
-          if ((*p == '<') || (*p == '>'))
-          {
-            memmove(p + 2, p, mutt_str_strlen(p) + 1);
-            *p++ = '\\';
-            *p++ = '\\';
-          }
-        }
-        if (*p == '?')
-          *p = '>';
+        src++;
+        *cp++ = *src++;
+      }
+      else if ((src[0] == '%') && (src[1] == '<'))
+      {
+        lrbalance++;
+      }
+      else if (src[0] == '>')
+      {
+        lrbalance--;
+      }
+      if (lrbalance == 0)
+        break;
+      if ((lrbalance == 1) && (src[0] == '&'))
+        break;
+      *cp++ = *src++;
+      count++;
+    }
+    *cp = 0;
+
+    /* eat the `else' part of the string (optional) */
+    if (*src == '&')
+      src++; /* skip the & */
+    cp = op->else_str;
+    count = 0;
+    while ((lrbalance > 0) && (count < sizeof(op->else_str) - 2) && *src)
+    {
+      if ((src[0] == '%') && (src[1] == '>'))
+      {
+        /* This is a padding expando; copy two chars and carry on */
+        *cp++ = *src++;
+        *cp++ = *src++;
+        count += 2;
+        continue;
       }
 
-      if (*src == '<')
+      if (*src == '\\')
       {
-        flags |= MUTT_FORMAT_OPTIONAL;
-        ch = *(++src); /* save the character to switch on */
         src++;
-        cp = prefix;
-        count = 0;
-        while ((count < sizeof(prefix)) && (*src != '?'))
-        {
-          *cp++ = *src++;
-          count++;
-        }
-        *cp = 0;
+        *cp++ = *src++;
       }
-      else
+      else if ((src[0] == '%') && (src[1] == '<'))
       {
-        flags &= ~MUTT_FORMAT_OPTIONAL;
+        lrbalance++;
+      }
+      else if (src[0] == '>')
+      {
+        lrbalance--;
+      }
+      if (lrbalance == 0)
+        break;
+      if ((lrbalance == 1) && (src[0] == '&'))
+        break;
+      *cp++ = *src++;
+      count++;
+    }
+    *cp = 0;
 
-        /* eat the format string */
-        cp = prefix;
-        count = 0;
-        while (count < sizeof(prefix) && (isdigit((unsigned char) *src) ||
-                                          *src == '.' || *src == '-' || *src == '='))
-        {
-          *cp++ = *src++;
-          count++;
-        }
-        *cp = 0;
+    if (!*src)
+      return op; /* bad format */
 
-        if (!*src)
-          break; /* bad format */
+    src++; /* move past the trailing `>' (formerly '?') */
+  }
 
-        ch = *src++; /* save the character to switch on */
-      }
+  if ((ch == '>') || (ch == '*') || (ch == '|'))
+  {
+    /* %>X: right justify to EOL, left takes precedence
+     * %*X: right justify to EOL, right takes precedence
+     * %|X: pad to EOL */
+    op->type = (ch == '|') ? EXP_OP_FILL : EXP_OP_PAD;
+    op->soft = (ch == '*');
+    op->pl = mutt_mb_charlen(src, &op->pw);
+    if (op->pl <= 0)
+    {
+      op->pl = 1;
+      op->pw = 1;
+    }
+    op->next = src - prog->str;
+    return op;
+  }
+
+  while (ch == '_' || ch == ':')
+  {
+    if (ch == '_')
+      op->tolower = true;
+    else if (ch == ':')
+      op->nodots = true;
+
+    ch = *src++;
+  }
+
+  op->type = EXP_OP_EXPANDO;
+  op->ch = ch;
+  op->next = src - prog->str;
+  return op;
+}
 
-      if (flags & MUTT_FORMAT_OPTIONAL)
+/**
+ * expando_op - Get the op at an offset of a compiled format string
+ * @param prog Program
+ * @param off  Offset
+ * @retval ptr Op, compiled if necessary
+ */
+static struct ExpandoOp *expando_op(struct ExpandoProg *prog, size_t off)
+{
+  if (prog->ops[off])
+    return prog->ops[off];
+
+  const char *src = prog->str + off;
+  if ((src[0] == '%') && (src[1] != '%'))
+    return expando_compile_percent(prog, off);
+  if ((src[0] == '\\') && !src[1])
+    return expando_op_new(prog, off, EXP_OP_STOP);
+  return expando_compile_text(prog, off);
+}
+
+/**
+ * expando_is_filter - Does a format string end with a filter pipe?
+ * @param src Format string
+ * @retval true The format string's output should be piped through a command
+ */
+static bool expando_is_filter(const char *src)
+{
+  int off = -1;
+
+  /* Do not consider filters if no pipe at end */
+  int n = mutt_str_strlen(src);
+  if (n > 1 && src[n - 1] == '|')
+  {
+    /* Scan backwards for backslashes */
+    off = n;
+    while (off > 0 && src[off - 2] == '\\')
+      off--;
+  }
+
+  /* If number of backslashes is even, the pipe is real. */
+  /* n-off is the number of backslashes. */
+  return (off > 0) && (((n - off) % 2) == 0);
+}
+
+/**
+ * expando_filter - Expand a format string and pipe it through a command
+ * @param[out] buf      Buffer in which to save string
+ * @param[in]  buflen   Buffer length
+ * @param[in]  col      Starting column
+ * @param[in]  cols     Number of screen columns
+ * @param[in]  src      Format string, ending with '|'
+ * @param[in]  callback Callback - Implements ::format_t
+ * @param[in]  data     Callback data
+ * @param[in]  flags    Callback flags
+ */
+static void expando_filter(char *buf, size_t buflen, size_t col, int cols,
+                           const char *src, format_t *callback,
+                           unsigned long data, enum FormatFlag flags)
+{
+  char tmp[LONG_STRING];
+  FILE *filter = NULL;
+  char *recycler = NULL;
+  int n = mutt_str_strlen(src);
+
+  buflen--; /* save room for the terminal \0 */
+
+  char srccopy[LONG_STRING];
+  int i = 0;
+
+  mutt_debug(3, "fmtpipe = %s\n", src);
+
+  strncpy(srccopy, src, n);
+  srccopy[n - 1] = '\0';
+
+  /* prepare BUFFERs */
+  struct Buffer *srcbuf = mutt_buffer_from(srccopy);
+  srcbuf->dptr = srcbuf->data;
+  struct Buffer *word = mutt_buffer_new();
+  struct Buffer *command = mutt_buffer_new();
+
+  /* Iterate expansions across successive arguments */
+  do
+  {
+    /* Extract the command name and copy to command line */
+    mutt_debug(3, "fmtpipe +++: %s\n", srcbuf->dptr);
+    if (word->data)
+      *word->data = '\0';
+    mutt_extract_token(word, srcbuf, 0);
+    mutt_debug(3, "fmtpipe %2d: %s\n", i++, word->data);
+    mutt_buffer_addch(command, '\'');
+    mutt_expando_format(tmp, sizeof(tmp), 0, cols, word->data, callback,
+                        data, flags | MUTT_FORMAT_NOFILTER);
+    for (char *p = tmp; p && *p; p++)
+    {
+      if (*p == '\'')
       {
-        int lrbalance;
+        /* shell quoting doesn't permit escaping a single quote within
+         * single-quoted material.  double-quoting instead will lead
+         * shell variable expansions, so break out of the single-quoted
+         * span, insert a double-quoted single quote, and resume. */
+        mutt_buffer_addstr(command, "'\"'\"'");
+      }
+      else
+        mutt_buffer_addch(command, *p);
+    }
+    mutt_buffer_addch(command, '\'');
+    mutt_buffer_addch(command, ' ');
+  } while (MoreArgs(srcbuf));
 
-        if (*src != '?')
-          break; /* bad format */
-        src++;
+  mutt_debug(3, "fmtpipe > %s\n", command->data);
 
-        /* eat the `if' part of the string */
-        cp = if_str;
-        count = 0;
-        lrbalance = 1;
-        while ((lrbalance > 0) && (count < sizeof(if_str)) && *src)
-        {
-          if ((src[0] == '%') && (src[1] == '>'))
-          {
-            /* This is a padding expando; copy two chars and carry on */
-            *cp++ = *src++;
-            *cp++ = *src++;
-            count += 2;
-            continue;
-          }
+  pid_t pid = mutt_create_filter(command->data, NULL, &filter, NULL);
+  if (pid != -1)
+  {
+    int rc;
 
-          if (*src == '\\')
-          {
-            src++;
-            *cp++ = *src++;
-          }
-          else if ((src[0] == '%') && (src[1] == '<'))
-          {
-            lrbalance++;
-          }
-          else if (src[0] == '>')
-          {
-            lrbalance--;
-          }
-          if (lrbalance == 0)
-            break;
-          if ((lrbalance == 1) && (src[0] == '&'))
-            break;
-          *cp++ = *src++;
-          count++;
-        }
-        *cp = 0;
-
-        /* eat the `else' part of the string (optional) */
-        if (*src == '&')
-          src++; /* skip the & */
-        cp = else_str;
-        count = 0;
-        while ((lrbalance > 0) && (count < sizeof(else_str)) && *src)
+    n = fread(buf, 1, buflen /* already decremented */, filter);
+    mutt_file_fclose(&filter);
+    rc = mutt_wait_filter(pid);
+    if (rc != 0)
+      mutt_debug(1, "format pipe command exited code %d\n", rc);
+    if (n > 0)
+    {
+      buf[n] = 0;
+      while ((n > 0) && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
+        buf[--n] = '\0';
+      mutt_debug(3, "fmtpipe < %s\n", buf);
+
+      /* If the result ends with '%', this indicates that the filter
+       * generated %-tokens that neomutt can expand.  Eliminate the '%'
+       * marker and recycle the string through mutt_expando_format().
+       * To literally end with "%", use "%%". */
+      if ((n > 0) && buf[n - 1] == '%')
+      {
+        n--;
+        buf[n] = '\0'; /* remove '%' */
+        if ((n > 0) && buf[n - 1] != '%')
         {
-          if ((src[0] == '%') && (src[1] == '>'))
-          {
-            /* This is a padding expando; copy two chars and carry on */
-            *cp++ = *src++;
-            *cp++ = *src++;
-            count += 2;
-            continue;
-          }
-
-          if (*src == '\\')
-          {
-            src++;
-            *cp++ = *src++;
-          }
-          else if ((src[0] == '%') && (src[1] == '<'))
+          recycler = mutt_str_strdup(buf);
+          if (recycler)
           {
-            lrbalance++;
+            /* buflen is decremented at the start of this function
+             * to save space for the terminal nul char.  We can add
+             * it back for the recursive call since the expansion of
+             * format pipes does not try to append a nul itself.
+             */
+            mutt_expando_format(buf, buflen + 1, col, cols, recycler,
+                                callback, data, flags);
+            FREE(&recycler);
           }
-          else if (src[0] == '>')
-          {
-            lrbalance--;
-          }
-          if (lrbalance == 0)
-            break;
-          if ((lrbalance == 1) && (src[0] == '&'))
-            break;
-          *cp++ = *src++;
-          count++;
         }
-        *cp = 0;
+      }
+    }
+    else
+    {
+      /* read error */
+      mutt_debug(1, "error reading from fmtpipe: %s (errno=%d)\n",
+                 strerror(errno), errno);
+      *buf = '\0';
+    }
+  }
+  else
+  {
+    /* Filter failed; erase write buffer */
+    *buf = '\0';
+  }
+
+  mutt_buffer_free(&command);
+  mutt_buffer_free(&srcbuf);
+  mutt_buffer_free(&word);
+}
+
+/**
+ * expando_run - Expand a compiled format string
+ * @param[in]  prog     Program
+ * @param[in]  off      Offset to start at
+ * @param[out] buf      Buffer in which to save string
+ * @param[in]  buflen   Buffer length
+ * @param[in]  col      Starting column
+ * @param[in]  cols     Number of screen columns
+ * @param[in]  callback Callback - Implements ::format_t
+ * @param[in]  data     Callback data
+ * @param[in]  flags    Callback flags
+ */
+static void expando_run(struct ExpandoProg *prog, size_t off, char *buf,
+                        size_t buflen, size_t col, int cols, format_t *callback,
+                        unsigned long data, enum FormatFlag flags)
+{
+  char tmp[LONG_STRING], *wptr = buf;
+  size_t wlen, len, wid;
+
+  buflen--; /* save room for the terminal \0 */
+  wlen = ((flags & MUTT_FORMAT_ARROWCURSOR) && ArrowCursor) ? 3 : 0;
+  col += wlen;
 
-        if (!*src)
-          break; /* bad format */
+  while (prog->str[off] && (wlen < buflen))
+  {
+    struct ExpandoOp *op = expando_op(prog, off);
 
-        src++; /* move past the trailing `>' (formerly '?') */
+    if (op->type == EXP_OP_TEXT)
+    {
+      if (wlen + op->bytes < buflen)
+      {
+        memcpy(wptr, op->text, op->bytes);
+        wptr += op->bytes;
+        wlen += op->bytes;
+        col += op->width;
+        off = op->next;
+        continue;
       }
 
-      /* handle generic cases first */
-      if (ch == '>' || ch == '*')
+      /* not enough room, copy what fits */
+      const char *text = prog->str + off;
+      while ((text < prog->str + op->next) && (wlen < buflen))
       {
-        /* %>X: right justify to EOL, left takes precedence
-         * %*X: right justify to EOL, right takes precedence */
-        int soft = ch == '*';
-        int pl, pw;
-        pl = mutt_mb_charlen(src, &pw);
-        if (pl <= 0)
+        if ((text[0] == '%') || (text[0] == '\\'))
         {
-          pl = 1;
-          pw = 1;
+          *wptr++ = (text[0] == '%') ? '%' : expando_escape(text[1]);
+          text += 2;
+          wlen++;
+          col++;
+          continue;
         }
 
-        /* see if there's room to add content, else ignore */
-        if ((col < cols && wlen < buflen) || soft)
+        int bytes, width;
+        /* in case of error, simply copy byte */
+        bytes = mutt_mb_charlen(text, &width);
+        if (bytes < 0)
         {
-          int pad;
+          bytes = 1;
+          width = 1;
+        }
+        if ((wlen + bytes) < buflen)
+        {
+          memcpy(wptr, text, bytes);
+          wptr += bytes;
+          text += bytes;
+          wlen += bytes;
+          col += width;
+        }
+        else
+          wlen = buflen;
+      }
+      break;
+    }
 
-          /* get contents after padding */
-          mutt_expando_format(tmp, sizeof(tmp), 0, cols, src + pl, callback, data, flags);
-          len = mutt_str_strlen(tmp);
-          wid = mutt_strwidth(tmp);
+    if (op->type == EXP_OP_STOP)
+      break;
 
-          pad = (cols - col - wid) / pw;
-          if (pad >= 0)
-          {
-            /* try to consume as many columns as we can, if we don't have
-             * memory for that, use as much memory as possible */
-            if (wlen + (pad * pl) + len > buflen)
-              pad = (buflen > wlen + len) ? ((buflen - wlen - len) / pl) : 0;
-            else
-            {
-              /* Add pre-spacing to make multi-column pad characters and
-               * the contents after padding line up */
-              while ((col + (pad * pw) + wid < cols) && (wlen + (pad * pl) + len < buflen))
-              {
-                *wptr++ = ' ';
-                wlen++;
-                col++;
-              }
-            }
-            while (pad-- > 0)
-            {
-              memcpy(wptr, src, pl);
-              wptr += pl;
-              wlen += pl;
-              col += pw;
-            }
-          }
-          else if (soft && pad < 0)
+    if (op->optional)
+      flags |= MUTT_FORMAT_OPTIONAL;
+    else
+      flags &= ~MUTT_FORMAT_OPTIONAL;
+
+    const char *src = prog->str + op->next;
+    if (op->type == EXP_OP_PAD)
+    {
+      const int soft = op->soft;
+      const int pl = op->pl;
+      const int pw = op->pw;
+
+      /* see if there's room to add content, else ignore */
+      if ((col < cols && wlen < buflen) || soft)
+      {
+        int pad;
+
+        /* get contents after padding */
+        const char *rest = src + pl;
+        if (!(flags & MUTT_FORMAT_NOFILTER) && expando_is_filter(rest))
+          expando_filter(tmp, sizeof(tmp), 0, cols, rest, callback, data, flags);
+        else
+          expando_run(prog, op->next + pl, tmp, sizeof(tmp), 0, cols,
+                      callback, data, flags);
+        len = mutt_str_strlen(tmp);
+        wid = mutt_strwidth(tmp);
+
+        pad = (cols - col - wid) / pw;
+        if (pad >= 0)
+        {
+          /* try to consume as many columns as we can, if we don't have
+           * memory for that, use as much memory as possible */
+          if (wlen + (pad * pl) + len > buflen)
+            pad = (buflen > wlen + len) ? ((buflen - wlen - len) / pl) : 0;
+          else
           {
-            int offset = ((flags & MUTT_FORMAT_ARROWCURSOR) && ArrowCursor) ? 3 : 0;
-            int avail_cols = (cols > offset) ? (cols - offset) : 0;
-            /* \0-terminate buf for length computation in mutt_wstr_trunc() */
-            *wptr = 0;
-            /* make sure right part is at most as wide as display */
-            len = mutt_wstr_trunc(tmp, buflen, avail_cols, &wid);
-            /* truncate left so that right part fits completely in */
-            wlen = mutt_wstr_trunc(buf, buflen - len, avail_cols - wid, &col);
-            wptr = buf + wlen;
-            /* Multi-column characters may be truncated in the middle.
-             * Add spacing so the right hand side lines up. */
-            while ((col + wid < avail_cols) && (wlen + len < buflen))
+            /* Add pre-spacing to make multi-column pad characters and
+             * the contents after padding line up */
+            while ((col + (pad * pw) + wid < cols) && (wlen + (pad * pl) + len < buflen))
             {
               *wptr++ = ' ';
               wlen++;
               col++;
             }
           }
-          if ((len + wlen) > buflen)
-            len = mutt_wstr_trunc(tmp, buflen - wlen, cols - col, NULL);
-          memcpy(wptr, tmp, len);
-          wptr += len;
-        }
-        break; /* skip rest of input */
-      }
-      else if (ch == '|')
-      {
-        /* pad to EOL */
-        int pl, pw;
-        pl = mutt_mb_charlen(src, &pw);
-        if (pl <= 0)
-        {
-          pl = 1;
-          pw = 1;
-        }
-
-        /* see if there's room to add content, else ignore */
-        if (col < cols && wlen < buflen)
-        {
-          int c = (cols - col) / pw;
-          if (c > 0 && wlen + (c * pl) > buflen)
-            c = ((signed) (buflen - wlen)) / pl;
-          while (c > 0)
+          while (pad-- > 0)
           {
             memcpy(wptr, src, pl);
             wptr += pl;
             wlen += pl;
             col += pw;
-            c--;
           }
         }
-        break; /* skip rest of input */
-      }
-      else
-      {
-        bool tolower = false;
-        bool nodots = false;
-
-        while (ch == '_' || ch == ':')
-        {
-          if (ch == '_')
-            tolower = true;
-          else if (ch == ':')
-            nodots = true;
-
-          ch = *src++;
-        }
-
-        /* use callback function to handle this case */
-        src = callback(tmp, sizeof(tmp), col, cols, ch, src, prefix, if_str,
-                       else_str, data, flags);
-
-        if (tolower)
-          mutt_str_strlower(tmp);
-        if (nodots)
+        else if (soft && pad < 0)
         {
-          char *p = tmp;
-          for (; *p; p++)
-            if (*p == '.')
-              *p = '_';
+          int offset = ((flags & MUTT_FORMAT_ARROWCURSOR) && ArrowCursor) ? 3 : 0;
+          int avail_cols = (cols > offset) ? (cols - offset) : 0;
+          /* \0-terminate buf for length computation in mutt_wstr_trunc() */
+          *wptr = 0;
+          /* make sure right part is at most as wide as display */
+          len = mutt_wstr_trunc(tmp, buflen, avail_cols, &wid);
+          /* truncate left so that right part fits completely in */
+          wlen = mutt_wstr_trunc(buf, buflen - len, avail_cols - wid, &col);
+          wptr = buf + wlen;
+          /* Multi-column characters may be truncated in the middle.
+           * Add spacing so the right hand side lines up. */
+          while ((col + wid < avail_cols) && (wlen + len < buflen))
+          {
+            *wptr++ = ' ';
+            wlen++;
+            col++;
+          }
         }
-
-        len = mutt_str_strlen(tmp);
         if ((len + wlen) > buflen)
           len = mutt_wstr_trunc(tmp, buflen - wlen, cols - col, NULL);
-
         memcpy(wptr, tmp, len);
         wptr += len;
-        wlen += len;
-        col += mutt_strwidth(tmp);
       }
+      break; /* skip rest of input */
     }
-    else if (*src == '\\')
+    else if (op->type == EXP_OP_FILL)
     {
-      if (!*++src)
-        break;
-      switch (*src)
+      const int pl = op->pl;
+      const int pw = op->pw;
+
+      /* see if there's room to add content, else ignore */
+      if (col < cols && wlen < buflen)
       {
-        case 'f':
-          *wptr = '\f';
-          break;
-        case 'n':
-          *wptr = '\n';
-          break;
-        case 'r':
-          *wptr = '\r';
-          break;
-        case 't':
-          *wptr = '\t';
-          break;
-        case 'v':
-          *wptr = '\v';
-          break;
-        default:
-          *wptr = *src;
-          break;
+        int c = (cols - col) / pw;
+        if (c > 0 && wlen + (c * pl) > buflen)
+          c = ((signed) (buflen - wlen)) / pl;
+        while (c > 0)
+        {
+          memcpy(wptr, src, pl);
+          wptr += pl;
+          wlen += pl;
+          col += pw;
+          c--;
+        }
       }
-      src++;
-      wptr++;
-      wlen++;
-      col++;
+      break; /* skip rest of input */
     }
-    else
+
+    /* use callback function to handle this case */
+    src = callback(tmp, sizeof(tmp), col, cols, op->ch, src, op->prefix,
+                   op->if_str, op->else_str, data, flags);
+
+    if (op->tolower)
+      mutt_str_strlower(tmp);
+    if (op->nodots)
     {
-      int bytes, width;
-      /* in case of error, simply copy byte */
-      bytes = mutt_mb_charlen(src, &width);
-      if (bytes < 0)
-      {
-        bytes = 1;
-        width = 1;
-      }
-      if ((bytes > 0) && ((wlen + bytes) < buflen))
-      {
-        memcpy(wptr, src, bytes);
-        wptr += bytes;
-        src += bytes;
-        wlen += bytes;
-        col += width;
-      }
-      else
-      {
-        src += buflen - wlen;
-        wlen = buflen;
-      }
+      char *p = tmp;
+      for (; *p; p++)
+        if (*p == '.')
+          *p = '_';
     }
+
+    len = mutt_str_strlen(tmp);
+    if ((len + wlen) > buflen)
+      len = mutt_wstr_trunc(tmp, buflen - wlen, cols - col, NULL);
+
+    memcpy(wptr, tmp, len);
+    wptr += len;
+    wlen += len;
+    col += mutt_strwidth(tmp);
+    off = src - prog->str;
   }
   *wptr = 0;
 }
 
+/**
+ * mutt_expando_format - Expand expandos (%x) in a string
+ * @param[out] buf      Buffer in which to save string
+ * @param[in]  buflen   Buffer length
+ * @param[in]  col      Starting column
+ * @param[in]  cols     Number of screen columns
+ * @param[in]  src      Printf-like format string
+ * @param[in]  callback Callback - Implements ::format_t
+ * @param[in]  data     Callback data
+ * @param[in]  flags    Callback flags
+ *
+ * The format string is compiled the first time it's seen, so redrawing many
+ * rows with the same $index_format doesn't parse it again for every row.
+ */
+void mutt_expando_format(char *buf, size_t buflen, size_t col, int cols, const char *src,
+                         format_t *callback, unsigned long data, enum FormatFlag flags)
+{
+  if (!src)
+    src = "";
+
+  if (!(flags & MUTT_FORMAT_NOFILTER) && expando_is_filter(src))
+  {
+    expando_filter(buf, buflen, col, cols, src, callback, data, flags);
+    return;
+  }
+
+  struct ExpandoProg *prog = expando_prog_get(src);
+  expando_run(prog, 0, buf, buflen, col, cols, callback, data, flags);
+  expando_prog_release(prog);
+}
+
 /**
  * mutt_open_read - Run a command to read from
  * @param[in]  path   Path to command
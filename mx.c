@@ -59,6 +59,7 @@
 #include "opcodes.h"
 #include "options.h"
 #include "pattern.h"
+#include "progress.h"
 #include "protos.h"
 #include "score.h"
 #include "sort.h"
@@ -84,10 +85,14 @@
 #include <libintl.h>
 #endif
 
+/* Expunging more than 1/MX_EXPUNGE_REBUILD of a mailbox rebuilds its hashes */
+#define MX_EXPUNGE_REBUILD 8
+
 /* These Config Variables are only used in mx.c */
 unsigned char CatchupNewsgroup; ///< Config: (nntp) Mark all articles as read when leaving a newsgroup
 bool KeepFlagged; ///< Config: Don't move flagged messages from Spoolfile to Mbox
 short MboxType;   ///< Config: Default type for creating new mailboxes
+bool MessageMmap; ///< Config: Map local messages into memory to read them
 unsigned char Move; ///< Config: Move emails from Spoolfile to Mbox when read
 char *Trash;        ///< Config: Folder to put deleted emails
 
@@ -237,6 +242,7 @@ static int mx_open_mailbox_append(struct Context *ctx, int flags)
  * * #MUTT_READONLY open mailbox in read-only mode
  * * #MUTT_QUIET    only print error messages
  * * #MUTT_PEEK     revert atime where applicable
+ * * #MUTT_BULK     append many messages, then call mx_mbox_flush()
  */
 struct Context *mx_mbox_open(const char *path, int flags)
 {
@@ -273,6 +279,8 @@ struct Context *mx_mbox_open(const char *path, int flags)
 
   if (flags & (MUTT_APPEND | MUTT_NEWFOLDER))
   {
+    if (flags & MUTT_BULK)
+      ctx->bulk = true;
     if (mx_open_mailbox_append(ctx, flags) != 0)
     {
       mx_fastclose_mailbox(ctx);
@@ -310,7 +318,10 @@ struct Context *mx_mbox_open(const char *path, int flags)
   if (!ctx->mailbox->quiet)
     mutt_message(_("Reading %s..."), ctx->mailbox->path);
 
+  mutt_trace_begin("mbox_open", ctx->mailbox->path);
   int rc = ctx->mailbox->mx_ops->mbox_open(ctx);
+  mutt_trace_end("mbox_open");
+  mutt_trace_count("messages", ctx->mailbox->msg_count);
 
   if ((rc == 0) || (rc == -2))
   {
@@ -357,6 +368,8 @@ void mx_fastclose_mailbox(struct Context *ctx)
   mutt_hash_destroy(&ctx->mailbox->subj_hash);
   mutt_hash_destroy(&ctx->mailbox->id_hash);
   mutt_hash_destroy(&ctx->mailbox->label_hash);
+  mutt_hash_destroy(&ctx->mailbox->dup_hash);
+  mutt_pattern_index_free(ctx->mailbox);
   mutt_clear_threads(ctx);
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
     mutt_email_free(&ctx->mailbox->hdrs[i]);
@@ -456,7 +469,7 @@ static int trash_append(struct Context *ctx)
   }
 #endif
 
-  struct Context *ctx_trash = mx_mbox_open(Trash, MUTT_APPEND);
+  struct Context *ctx_trash = mx_mbox_open(Trash, MUTT_APPEND | MUTT_BULK);
   if (ctx_trash)
   {
     /* continue from initial scan above */
@@ -472,6 +485,12 @@ static int trash_append(struct Context *ctx)
       }
     }
 
+    if (mx_mbox_flush(ctx_trash) != 0)
+    {
+      mx_mbox_close(&ctx_trash, NULL);
+      return -1;
+    }
+
     mx_mbox_close(&ctx_trash, NULL);
   }
   else
@@ -483,6 +502,27 @@ static int trash_append(struct Context *ctx)
   return 0;
 }
 
+/**
+ * mx_mbox_flush - Write the messages appended to a mailbox to disk
+ * @param ctx Mailbox
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * A mailbox opened with #MUTT_BULK may not flush each message to disk as it's
+ * committed.  This must be called after the last one, before the originals
+ * are deleted.
+ */
+int mx_mbox_flush(struct Context *ctx)
+{
+  if (!ctx || !ctx->mailbox->mx_ops)
+    return -1;
+
+  if (!ctx->bulk || !ctx->mailbox->mx_ops->mbox_flush)
+    return 0;
+
+  return ctx->mailbox->mx_ops->mbox_flush(ctx);
+}
+
 /**
  * mx_mbox_close - Save changes and close mailbox
  * @param pctx       Mailbox
@@ -595,12 +635,14 @@ int mx_mbox_close(struct Context **pctx, int *index_hint)
 
   if (MarkOld)
   {
+    mutt_flag_batch_begin(ctx);
     for (i = 0; i < ctx->mailbox->msg_count; i++)
     {
       if (!ctx->mailbox->hdrs[i]->deleted && !ctx->mailbox->hdrs[i]->old &&
           !ctx->mailbox->hdrs[i]->read)
         mutt_set_flag(ctx, ctx->mailbox->hdrs[i], MUTT_OLD, 1);
     }
+    mutt_flag_batch_end();
   }
 
   if (move_messages)
@@ -641,7 +683,7 @@ int mx_mbox_close(struct Context **pctx, int *index_hint)
     else /* use regular append-copy mode */
 #endif
     {
-      struct Context *f = mx_mbox_open(mbox, MUTT_APPEND);
+      struct Context *f = mx_mbox_open(mbox, MUTT_APPEND | MUTT_BULK);
       if (!f)
       {
         ctx->mailbox->closing = false;
@@ -653,12 +695,7 @@ int mx_mbox_close(struct Context **pctx, int *index_hint)
         if (ctx->mailbox->hdrs[i]->read && !ctx->mailbox->hdrs[i]->deleted &&
             !(ctx->mailbox->hdrs[i]->flagged && KeepFlagged))
         {
-          if (mutt_append_message(f, ctx, ctx->mailbox->hdrs[i], 0, CH_UPDATE_LEN) == 0)
-          {
-            mutt_set_flag(ctx, ctx->mailbox->hdrs[i], MUTT_DELETE, 1);
-            mutt_set_flag(ctx, ctx->mailbox->hdrs[i], MUTT_PURGE, 1);
-          }
-          else
+          if (mutt_append_message(f, ctx, ctx->mailbox->hdrs[i], 0, CH_UPDATE_LEN) != 0)
           {
             mx_mbox_close(&f, NULL);
             ctx->mailbox->closing = false;
@@ -667,6 +704,26 @@ int mx_mbox_close(struct Context **pctx, int *index_hint)
         }
       }
 
+      if (mx_mbox_flush(f) != 0)
+      {
+        mx_mbox_close(&f, NULL);
+        ctx->mailbox->closing = false;
+        return -1;
+      }
+
+      /* the copies are on disk, so the originals can go */
+      mutt_flag_batch_begin(ctx);
+      for (i = 0; i < ctx->mailbox->msg_count; i++)
+      {
+        if (ctx->mailbox->hdrs[i]->read && !ctx->mailbox->hdrs[i]->deleted &&
+            !(ctx->mailbox->hdrs[i]->flagged && KeepFlagged))
+        {
+          mutt_set_flag(ctx, ctx->mailbox->hdrs[i], MUTT_DELETE, 1);
+          mutt_set_flag(ctx, ctx->mailbox->hdrs[i], MUTT_PURGE, 1);
+        }
+      }
+      mutt_flag_batch_end();
+
       mx_mbox_close(&f, NULL);
     }
   }
@@ -767,15 +824,50 @@ int mx_mbox_close(struct Context **pctx, int *index_hint)
   return 0;
 }
 
+/**
+ * mx_email_survives - Will an email be kept by mx_update_tables()?
+ * @param ctx        Mailbox
+ * @param e          Email
+ * @param committing Commit the changes?
+ * @retval true The email is kept
+ */
+static bool mx_email_survives(struct Context *ctx, struct Email *e, bool committing)
+{
+  if (e->quasi_deleted)
+    return false;
+
+  if (committing)
+    return !e->deleted || ((ctx->mailbox->magic == MUTT_MAILDIR) && MaildirTrash);
+
+  return e->active;
+}
+
 /**
  * mx_update_tables - Update a Context structure's internal tables
  * @param ctx        Mailbox
  * @param committing Commit the changes?
+ *
+ * The surviving emails are moved down, in one pass.  Deleting an email from
+ * the subject hash walks all the emails with the same subject, so when a lot
+ * of emails are expunged, the subject and message-id hashes are dropped,
+ * rather than updated.  They're rebuilt the next time they're needed.
  */
 void mx_update_tables(struct Context *ctx, bool committing)
 {
   int i, j, padding;
 
+  int expunged = 0;
+  for (i = 0; i < ctx->mailbox->msg_count; i++)
+    if (!mx_email_survives(ctx, ctx->mailbox->hdrs[i], committing))
+      expunged++;
+
+  if (expunged > MAX(ctx->mailbox->msg_count / MX_EXPUNGE_REBUILD, 64))
+  {
+    mutt_hash_destroy(&ctx->mailbox->subj_hash);
+    mutt_hash_destroy(&ctx->mailbox->id_hash);
+    mutt_hash_destroy(&ctx->mailbox->dup_hash);
+  }
+
   /* update memory to reflect the new state of the mailbox */
   ctx->mailbox->vcount = 0;
   ctx->vsize = 0;
@@ -786,12 +878,10 @@ void mx_update_tables(struct Context *ctx, bool committing)
   ctx->mailbox->changed = false;
   ctx->mailbox->msg_flagged = 0;
   padding = mx_msg_padding_size(ctx);
+  mutt_pattern_index_free(ctx->mailbox);
   for (i = 0, j = 0; i < ctx->mailbox->msg_count; i++)
   {
-    if (!ctx->mailbox->hdrs[i]->quasi_deleted &&
-        ((committing && (!ctx->mailbox->hdrs[i]->deleted ||
-                         (ctx->mailbox->magic == MUTT_MAILDIR && MaildirTrash))) ||
-         (!committing && ctx->mailbox->hdrs[i]->active)))
+    if (mx_email_survives(ctx, ctx->mailbox->hdrs[i], committing))
     {
       if (i != j)
       {
@@ -847,6 +937,7 @@ void mx_update_tables(struct Context *ctx, bool committing)
         mutt_hash_delete(ctx->mailbox->id_hash, ctx->mailbox->hdrs[i]->env->message_id,
                          ctx->mailbox->hdrs[i]);
       mutt_label_hash_remove(ctx->mailbox, ctx->mailbox->hdrs[i]);
+      mutt_dup_hash_remove(ctx->mailbox, ctx->mailbox->hdrs[i]);
       /* The path mx_mbox_check() -> imap_check_mailbox() ->
        *          imap_expunge_mailbox() -> mx_update_tables()
        * can occur before a call to mx_mbox_sync(), resulting in
@@ -1092,6 +1183,24 @@ struct Message *mx_msg_open(struct Context *ctx, int msgno)
   if (ctx->mailbox->mx_ops->msg_open(ctx, msg, msgno))
     FREE(&msg);
 
+  /* local messages are read in place, the offsets are those of msg->fp */
+  const int magic = ctx->mailbox->magic;
+  if (msg && MessageMmap && msg->fp && (msgno >= 0) && (msgno < ctx->mailbox->msg_count) &&
+      ((magic == MUTT_MBOX) || (magic == MUTT_MMDF) || (magic == MUTT_MH) ||
+       (magic == MUTT_MAILDIR)))
+  {
+    struct Email *e = ctx->mailbox->hdrs[msgno];
+    if (e->content && (e->content->offset >= e->offset))
+    {
+      mutt_file_map(msg->fp, e->offset,
+                    e->content->offset + e->content->length - e->offset, &msg->map);
+    }
+  }
+
+  /* reading the message may have filled in more of its headers */
+  if ((msgno >= 0) && (msgno < ctx->mailbox->msg_count))
+    FREE(&ctx->mailbox->hdrs[msgno]->pair_memo);
+
   return msg;
 }
 
@@ -1129,6 +1238,7 @@ int mx_msg_close(struct Context *ctx, struct Message **msg)
     return 0;
   int r = 0;
 
+  mutt_file_unmap(&(*msg)->map);
   if (ctx->mailbox->mx_ops && ctx->mailbox->mx_ops->msg_close)
     r = ctx->mailbox->mx_ops->msg_close(ctx, *msg);
 
@@ -1186,6 +1296,7 @@ void mx_alloc_memory(struct Mailbox *mailbox)
 void mx_update_context(struct Context *ctx, int new_messages)
 {
   struct Email *e = NULL;
+  mutt_pattern_index_free(ctx->mailbox);
   for (int msgno = ctx->mailbox->msg_count - new_messages;
        msgno < ctx->mailbox->msg_count; msgno++)
   {
@@ -1228,6 +1339,7 @@ void mx_update_context(struct Context *ctx, int new_messages)
     if (ctx->mailbox->subj_hash && e->env->real_subj)
       mutt_hash_insert(ctx->mailbox->subj_hash, e->env->real_subj, e);
     mutt_label_hash_add(ctx->mailbox, e);
+    mutt_dup_hash_add(ctx->mailbox, e);
 
     if (Score)
       mutt_score_message(ctx, e, false);
@@ -1328,11 +1440,81 @@ bool mx_tags_is_supported(struct Context *ctx)
   return ctx->mailbox->mx_ops->tags_commit && ctx->mailbox->mx_ops->tags_edit;
 }
 
+/**
+ * struct ProbeResult - The type of a local mailbox, when it was last probed
+ */
+struct ProbeResult
+{
+  dev_t dev;             ///< Device of the file
+  ino_t ino;             ///< Inode of the file
+  off_t size;            ///< Size of the file
+  struct timespec mtime; ///< Modification time of the file
+  struct timespec ctime; ///< Status change time of the file
+  int magic;             ///< Type, e.g. #MUTT_MAILDIR
+};
+
+/* Cache of the types of local mailboxes, keyed by path.  Only the main thread
+ * probes paths. */
+static struct Hash *ProbeCache = NULL;
+
+/**
+ * probe_result_free - Free a cached probe result - Implements ::hash_destructor_t
+ */
+static void probe_result_free(int type, void *obj, intptr_t data)
+{
+  FREE(&obj);
+}
+
+/**
+ * probe_result_set - Fill in a probe result from a file's details
+ * @param pr    Probe result
+ * @param st    File's details
+ * @param magic Type, e.g. #MUTT_MAILDIR
+ */
+static void probe_result_set(struct ProbeResult *pr, struct stat *st, int magic)
+{
+  pr->dev = st->st_dev;
+  pr->ino = st->st_ino;
+  pr->size = st->st_size;
+  mutt_get_stat_timespec(&pr->mtime, st, MUTT_STAT_MTIME);
+  mutt_get_stat_timespec(&pr->ctime, st, MUTT_STAT_CTIME);
+  pr->magic = magic;
+}
+
+/**
+ * probe_result_valid - Does a cached probe result still apply?
+ * @param pr Probe result
+ * @param st File's details now
+ * @retval true The file hasn't changed since it was probed
+ *
+ * The drivers look at the first line of a file, or at the entries of a
+ * directory.  Changing either updates the times of the file, or directory.
+ */
+static bool probe_result_valid(const struct ProbeResult *pr, struct stat *st)
+{
+  return (pr->dev == st->st_dev) && (pr->ino == st->st_ino) &&
+         (pr->size == st->st_size) &&
+         (mutt_stat_timespec_compare(st, MUTT_STAT_MTIME, (struct timespec *) &pr->mtime) == 0) &&
+         (mutt_stat_timespec_compare(st, MUTT_STAT_CTIME, (struct timespec *) &pr->ctime) == 0);
+}
+
+/**
+ * mx_path_probe_cache_free - Forget the cached types of local mailboxes
+ */
+void mx_path_probe_cache_free(void)
+{
+  mutt_hash_destroy(&ProbeCache);
+}
+
 /**
  * mx_path_probe - Find a mailbox that understands a path
  * @param[in]  path  Path to examine
  * @param[out] st    stat buffer (OPTIONAL, for local mailboxes)
  * @retval num Type, e.g. #MUTT_IMAP
+ *
+ * The type of a local mailbox is remembered, until its path, inode, size or
+ * times change, so probing the same mailboxes again only costs a stat().
+ * Compressed mailboxes aren't cached: they depend on the hooks, not the file.
  */
 int mx_path_probe(const char *path, struct stat *st)
 {
@@ -1380,13 +1562,36 @@ int mx_path_probe(const char *path, struct stat *st)
     return MUTT_UNKNOWN;
   }
 
+  struct ProbeResult *pr = ProbeCache ? mutt_hash_find(ProbeCache, path) : NULL;
+  if (pr && probe_result_valid(pr, st))
+    return pr->magic;
+
   for (size_t i = 0; i < mutt_array_size(with_stat); i++)
   {
     rc = with_stat[i]->path_probe(path, st);
     if (rc != MUTT_UNKNOWN)
-      return rc;
+      break;
+  }
+
+  if ((rc == MUTT_UNKNOWN) || (rc == MUTT_COMPRESSED))
+  {
+    if (pr)
+      mutt_hash_delete(ProbeCache, path, pr);
+    return rc;
   }
 
+  if (!pr)
+  {
+    if (!ProbeCache)
+    {
+      ProbeCache = mutt_hash_create(128, MUTT_HASH_STRDUP_KEYS);
+      mutt_hash_set_destructor(ProbeCache, probe_result_free, 0);
+    }
+    pr = mutt_mem_malloc(sizeof(*pr));
+    mutt_hash_insert(ProbeCache, path, pr);
+  }
+  probe_result_set(pr, st, rc);
+
   return rc;
 }
 
@@ -1521,3 +1726,105 @@ int mx_msg_padding_size(struct Context *ctx)
 
   return ctx->mailbox->mx_ops->msg_padding_size(ctx);
 }
+
+/**
+ * mx_msg_load_header - Read the headers of an email - Wrapper for MxOps::msg_load_header
+ * @param ctx Mailbox
+ * @param e   Email
+ * @retval  0 Success, or the headers were already there
+ * @retval -1 Failure
+ *
+ * A mailbox may be opened before the headers of all its emails are read, see
+ * Email::header_pending.  Once read here, the email is added to the Mailbox's
+ * hash tables, like mx_update_context() does for new ones.
+ */
+int mx_msg_load_header(struct Context *ctx, struct Email *e)
+{
+  if (!e || !e->header_pending)
+    return 0;
+  if (!ctx || !ctx->mailbox->mx_ops || !ctx->mailbox->mx_ops->msg_load_header)
+    return -1;
+
+  e->header_pending = false;
+  if (ctx->mailbox->mx_ops->msg_load_header(ctx, e) != 0)
+    return -1;
+
+  mutt_pattern_index_free(ctx->mailbox);
+
+  if (WithCrypto)
+    e->security = crypt_query(e->content);
+
+  ctx->mailbox->size += e->content->length + e->content->offset - e->content->hdr_offset;
+  if (ctx->mailbox->id_hash && e->env->message_id)
+    mutt_hash_insert(ctx->mailbox->id_hash, e->env->message_id, e);
+  if (ctx->mailbox->subj_hash && e->env->real_subj)
+    mutt_hash_insert(ctx->mailbox->subj_hash, e->env->real_subj, e);
+  mutt_label_hash_add(ctx->mailbox, e);
+  mutt_dup_hash_add(ctx->mailbox, e);
+
+  if (Score)
+    mutt_score_message(ctx, e, false);
+
+  return 0;
+}
+
+/**
+ * mx_msg_save_hcache - Save an email to the header cache - Wrapper for MxOps::msg_save_hcache
+ * @param ctx Mailbox
+ * @param e   Email
+ * @retval  0 Success
+ * @retval -1 Failure, or the mailbox has no header cache
+ *
+ * This keeps what was learnt about an email after it was cached, e.g. its
+ * attachment count.
+ */
+int mx_msg_save_hcache(struct Context *ctx, struct Email *e)
+{
+  if (!ctx || !e || e->header_pending || !ctx->mailbox->mx_ops ||
+      !ctx->mailbox->mx_ops->msg_save_hcache)
+  {
+    return -1;
+  }
+
+  return ctx->mailbox->mx_ops->msg_save_hcache(ctx, e);
+}
+
+/**
+ * mx_mbox_load_headers - Read the headers of all the emails that don't have them
+ * @param ctx Mailbox
+ * @retval num Number of emails read
+ *
+ * This is needed before anything that looks at every email, like sorting.
+ */
+int mx_mbox_load_headers(struct Context *ctx)
+{
+  struct Progress progress;
+  int pending = 0, done = 0;
+
+  if (!ctx)
+    return 0;
+
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+    if (ctx->mailbox->hdrs[i]->header_pending)
+      pending++;
+
+  if (pending == 0)
+    return 0;
+
+  if (!ctx->mailbox->quiet)
+  {
+    mutt_progress_init(&progress, _("Reading headers..."), MUTT_PROGRESS_MSG,
+                       ReadInc, pending);
+  }
+
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    if (!ctx->mailbox->hdrs[i]->header_pending)
+      continue;
+    mx_msg_load_header(ctx, ctx->mailbox->hdrs[i]);
+    if (!ctx->mailbox->quiet)
+      mutt_progress_update(&progress, ++done, -1);
+  }
+
+  return done;
+}
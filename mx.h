@@ -27,6 +27,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <time.h>
+#include "mutt/mutt.h"
 #include "config/lib.h"
 #ifdef USE_HCACHE
 #include "hcache/hcache.h"
@@ -41,6 +42,7 @@ struct stat;
 extern unsigned char CatchupNewsgroup;
 extern bool          KeepFlagged;
 extern short         MboxType;
+extern bool          MessageMmap;
 extern unsigned char Move;
 extern char *        Trash;
 
@@ -55,6 +57,7 @@ extern char *        Trash;
 #define MUTT_PEEK      (1 << 5) /**< revert atime back after taking a look (if applicable) */
 #define MUTT_APPENDNEW (1 << 6) /**< set in mx_open_mailbox_append if the mailbox doesn't
                                  * exist. used by maildir/mh to create the mailbox. */
+#define MUTT_BULK      (1 << 7) /**< many messages will be appended, see mx_mbox_flush() */
 
 /* mx_msg_open_new() */
 #define MUTT_ADD_FROM  (1 << 0) /**< add a From_ line */
@@ -77,6 +80,7 @@ enum MxCheckReturns
 struct Message
 {
   FILE *fp;             /**< pointer to the message data */
+  struct MuttFileMap map; /**< the message in memory, if $message_mmap is set */
   char *path;           /**< path to temp file */
   char *committed_path; /**< the final path generated by mx_msg_commit() */
   bool write;           /**< nonzero if message is open for writing */
@@ -138,6 +142,15 @@ struct MxOps
    * @retval -1 Failure
    */
   int (*mbox_close)      (struct Context *ctx);
+  /**
+   * mbox_flush - Write the messages appended to a mailbox to disk
+   * @param ctx Mailbox opened with #MUTT_BULK
+   * @retval  0 Success
+   * @retval -1 Failure
+   *
+   * In bulk mode, msg_commit() may leave the data in the page cache.
+   */
+  int (*mbox_flush)      (struct Context *ctx);
   /**
    * msg_open - Open an email message in mailbox
    * @param ctx   Mailbox
@@ -178,6 +191,22 @@ struct MxOps
    * @retval num Bytes of padding
    */
   int (*msg_padding_size)(struct Context *ctx);
+  /**
+   * msg_load_header - Read the headers of an email that was added without them
+   * @param ctx Mailbox
+   * @param e   Email
+   * @retval  0 Success
+   * @retval -1 Failure
+   */
+  int (*msg_load_header) (struct Context *ctx, struct Email *e);
+  /**
+   * msg_save_hcache - Save an email to the header cache
+   * @param ctx Mailbox
+   * @param e   Email
+   * @retval  0 Success
+   * @retval -1 Failure
+   */
+  int (*msg_save_hcache) (struct Context *ctx, struct Email *e);
   /**
    * tags_edit - Prompt and validate new messages tags
    * @param ctx    Mailbox
@@ -236,10 +265,14 @@ struct MxOps
 /* Wrappers for the Mailbox API, see MxOps */
 int             mx_mbox_check      (struct Context *ctx, int *index_hint);
 int             mx_mbox_close      (struct Context **pctx, int *index_hint);
+int             mx_mbox_flush      (struct Context *ctx);
 struct Context *mx_mbox_open       (const char *path, int flags);
 int             mx_mbox_sync       (struct Context *ctx, int *index_hint);
+int             mx_mbox_load_headers(struct Context *ctx);
 int             mx_msg_close       (struct Context *ctx, struct Message **msg);
 int             mx_msg_commit      (struct Context *ctx, struct Message *msg);
+int             mx_msg_load_header (struct Context *ctx, struct Email *e);
+int             mx_msg_save_hcache (struct Context *ctx, struct Email *e);
 struct Message *mx_msg_open_new    (struct Context *ctx, struct Email *e, int flags);
 struct Message *mx_msg_open        (struct Context *ctx, int msgno);
 int             mx_msg_padding_size(struct Context *ctx);
@@ -247,6 +280,7 @@ int             mx_path_canon      (char *buf, size_t buflen, const char *folder
 int             mx_path_parent     (char *buf, size_t buflen);
 int             mx_path_pretty     (char *buf, size_t buflen, const char *folder);
 int             mx_path_probe      (const char *path, struct stat *st);
+void            mx_path_probe_cache_free(void);
 int             mx_tags_commit     (struct Context *ctx, struct Email *e, char *tags);
 int             mx_tags_edit       (struct Context *ctx, const char *tags, char *buf, size_t buflen);
 
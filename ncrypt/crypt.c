@@ -37,6 +37,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include "mutt/mutt.h"
 #include "config/lib.h"
@@ -69,6 +70,12 @@ bool PgpStrictEnc; ///< Config: Encode PGP signed messages with quoted-printable
 unsigned char SmimeEncryptSelf;
 bool SmimeSelfEncrypt; ///< Config: Encrypted messages will also be encrypt to SmimeDefaultKey too
 
+/* Set while the output of a signature verification is being captured */
+static FILE *VerifyCaptureFp = NULL;           ///< Capture file
+static long VerifyCaptureTimeStart = -1;       ///< Offset of the "current time" line
+static long VerifyCaptureTimeEnd = -1;         ///< Offset just past the "current time" line
+static const char *VerifyCaptureApp = NULL;    ///< App name of the "current time" line
+
 /**
  * crypt_current_time - Print the current time
  * @param s        State to use
@@ -93,7 +100,18 @@ void crypt_current_time(struct State *s, const char *app_name)
     *p = '\0';
 
   snprintf(tmp, sizeof(tmp), _("[-- %s output follows%s --]\n"), NONULL(app_name), p);
+
+  /* Note where the timestamp goes, so a cached result can be given a fresh one */
+  const bool capture = VerifyCaptureFp && (s->fpout == VerifyCaptureFp) &&
+                       (VerifyCaptureTimeStart < 0);
+  if (capture)
+  {
+    VerifyCaptureTimeStart = ftell(s->fpout);
+    VerifyCaptureApp = app_name;
+  }
   state_attach_puts(tmp, s);
+  if (capture)
+    VerifyCaptureTimeEnd = ftell(s->fpout);
 }
 
 /**
@@ -1063,6 +1081,325 @@ static void crypt_fetch_signatures(struct Body ***signatures, struct Body *a, in
   }
 }
 
+#define VERIFY_CACHE_SIZE 32
+#define VERIFY_CACHE_MAX_DATA (256 * 1024)
+
+/**
+ * struct VerifyCacheEntry - A remembered signature verification
+ *
+ * The digest is only used to find candidates quickly; a hit also requires
+ * the signed data and the signature to be byte-for-byte identical.
+ */
+struct VerifyCacheEntry
+{
+  unsigned char digest[16]; ///< MD5 of the signed data and the signature
+  char *data;               ///< Signed data followed by the signature
+  size_t datalen;           ///< Length of data
+  size_t siglen;            ///< Length of the signature at the end of data
+  int flags;                ///< State flags the output was produced with
+  char *prefix;             ///< State prefix the output was produced with
+  char *output;             ///< Captured verification output
+  size_t outlen;            ///< Length of output
+  long time_start;          ///< Offset of the "current time" line, or -1
+  long time_end;            ///< Offset just past the "current time" line
+  const char *app_name;     ///< App name of the "current time" line
+  int rc;                   ///< Result of the verification
+};
+
+static struct VerifyCacheEntry VerifyCache[VERIFY_CACHE_SIZE];
+static int VerifyCacheNext = 0;
+static char VerifyCacheStamp[512];
+
+/**
+ * typedef verify_one_t - Check a signed MIME part against a signature
+ */
+typedef int (*verify_one_t)(struct Body *sigbdy, struct State *s, const char *tempf);
+
+/**
+ * verify_cache_free_entry - Free a verification cache entry
+ * @param ve Entry to free
+ */
+static void verify_cache_free_entry(struct VerifyCacheEntry *ve)
+{
+  FREE(&ve->data);
+  FREE(&ve->prefix);
+  FREE(&ve->output);
+  memset(ve, 0, sizeof(*ve));
+}
+
+/**
+ * crypt_stamp_file - Describe the state of a keyring file
+ * @param buf    Buffer for the description
+ * @param buflen Length of buffer
+ * @param path   File to describe
+ */
+static void crypt_stamp_file(char *buf, size_t buflen, const char *path)
+{
+  struct stat st;
+  size_t len = mutt_str_strlen(buf);
+
+  if (len >= buflen)
+    return;
+
+  if (stat(path, &st) == 0)
+  {
+    snprintf(buf + len, buflen - len, "%llu.%lld.%lld:", (unsigned long long) st.st_ino,
+             (long long) st.st_mtime, (long long) st.st_size);
+  }
+  else
+    snprintf(buf + len, buflen - len, "-:");
+}
+
+/**
+ * crypt_keyring_stamp - Describe the state of the GnuPG keyrings
+ * @param buf    Buffer for the description, which is appended to
+ * @param buflen Length of buffer
+ *
+ * The description changes whenever a keyring or the trust database does, so
+ * it can be used to tell whether cached information about keys is stale.
+ */
+void crypt_keyring_stamp(char *buf, size_t buflen)
+{
+  static const char *const keyrings[] = {
+    "pubring.kbx", "pubring.gpg", "trustdb.gpg", "secring.gpg", "private-keys-v1.d",
+  };
+  char path[PATH_MAX];
+
+  const char *gnupghome = mutt_str_getenv("GNUPGHOME");
+  for (size_t i = 0; i < mutt_array_size(keyrings); i++)
+  {
+    if (gnupghome)
+      snprintf(path, sizeof(path), "%s/%s", gnupghome, keyrings[i]);
+    else
+      snprintf(path, sizeof(path), "%s/.gnupg/%s", NONULL(HomeDir), keyrings[i]);
+    crypt_stamp_file(buf, buflen, path);
+  }
+}
+
+/**
+ * verify_cache_check_stamp - Flush the cache if the keyrings have changed
+ *
+ * A verification result depends on the keys and trust we know about, as well
+ * as on the commands used.  If any of them have changed since the results
+ * were cached, they are all forgotten.
+ */
+static void verify_cache_check_stamp(void)
+{
+  char stamp[sizeof(VerifyCacheStamp)] = { 0 };
+  char path[PATH_MAX];
+  unsigned char digest[16];
+  struct Md5Ctx ctx;
+
+  crypt_keyring_stamp(stamp, sizeof(stamp));
+
+  mutt_str_strfcpy(path, NONULL(SmimeCertificates), sizeof(path));
+  mutt_expand_path(path, sizeof(path));
+  crypt_stamp_file(stamp, sizeof(stamp), path);
+  mutt_str_strfcpy(path, NONULL(SmimeCaLocation), sizeof(path));
+  mutt_expand_path(path, sizeof(path));
+  crypt_stamp_file(stamp, sizeof(stamp), path);
+
+  mutt_md5_init_ctx(&ctx);
+  mutt_md5_process(NONULL(PgpVerifyCommand), &ctx);
+  mutt_md5_process_bytes("", 1, &ctx);
+  mutt_md5_process(NONULL(SmimeVerifyCommand), &ctx);
+  mutt_md5_finish_ctx(&ctx, digest);
+  size_t len = mutt_str_strlen(stamp);
+  if (len + 33 <= sizeof(stamp))
+    mutt_md5_toascii(digest, stamp + len);
+
+  if (mutt_str_strcmp(stamp, VerifyCacheStamp) == 0)
+    return;
+
+  if (VerifyCacheStamp[0])
+    mutt_debug(3, "keyrings changed, flushing the verification cache\n");
+  for (size_t i = 0; i < mutt_array_size(VerifyCache); i++)
+    verify_cache_free_entry(&VerifyCache[i]);
+  VerifyCacheNext = 0;
+  mutt_str_strfcpy(VerifyCacheStamp, stamp, sizeof(VerifyCacheStamp));
+}
+
+/**
+ * verify_cache_read - Read the signed data and the signature into memory
+ * @param[in]  sigbdy  Signature part
+ * @param[in]  s       State to use
+ * @param[in]  tempf   File containing the signed data
+ * @param[out] datalen Length of the returned data
+ * @retval ptr  Signed data followed by the signature, to be freed
+ * @retval NULL Too large to cache, or an error
+ */
+static char *verify_cache_read(struct Body *sigbdy, struct State *s,
+                               const char *tempf, size_t *datalen)
+{
+  struct stat st;
+
+  if ((stat(tempf, &st) != 0) || (sigbdy->length < 0) ||
+      (st.st_size + sigbdy->length > VERIFY_CACHE_MAX_DATA))
+  {
+    return NULL;
+  }
+
+  size_t len = st.st_size + sigbdy->length;
+  char *data = mutt_mem_malloc(len + 1);
+
+  FILE *fp = fopen(tempf, "r");
+  if (!fp || (fread(data, 1, st.st_size, fp) != (size_t) st.st_size))
+  {
+    mutt_file_fclose(&fp);
+    FREE(&data);
+    return NULL;
+  }
+  mutt_file_fclose(&fp);
+
+  LOFF_T pos = ftello(s->fpin);
+  bool ok = (fseeko(s->fpin, sigbdy->offset, SEEK_SET) == 0) &&
+            (fread(data + st.st_size, 1, sigbdy->length, s->fpin) == (size_t) sigbdy->length);
+  fseeko(s->fpin, pos, SEEK_SET);
+  if (!ok)
+  {
+    FREE(&data);
+    return NULL;
+  }
+
+  *datalen = len;
+  return data;
+}
+
+/**
+ * verify_cache_lookup - Find a cached verification result
+ * @param digest  MD5 of the data
+ * @param data    Signed data followed by the signature
+ * @param datalen Length of data
+ * @param siglen  Length of the signature
+ * @param s       State the output will be written to
+ * @retval ptr  Matching entry
+ * @retval NULL No match
+ */
+static struct VerifyCacheEntry *verify_cache_lookup(const unsigned char *digest,
+                                                    const char *data, size_t datalen,
+                                                    size_t siglen, struct State *s)
+{
+  for (size_t i = 0; i < mutt_array_size(VerifyCache); i++)
+  {
+    struct VerifyCacheEntry *ve = &VerifyCache[i];
+    if (ve->data && (ve->datalen == datalen) && (ve->siglen == siglen) &&
+        (ve->flags == s->flags) && (mutt_str_strcmp(ve->prefix, s->prefix) == 0) &&
+        (memcmp(ve->digest, digest, sizeof(ve->digest)) == 0) &&
+        (memcmp(ve->data, data, datalen) == 0))
+    {
+      return ve;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * crypt_verify_cached - Verify a signature, reusing an earlier result
+ * @param sigbdy Signature part
+ * @param s      State to use
+ * @param tempf  File containing the signed data
+ * @param verify Backend verify function, e.g. crypt_pgp_verify_one()
+ * @retval num Result of the verification
+ *
+ * Re-reading the same signed message shouldn't start gpg or openssl every
+ * time.  While the keyrings are unchanged, the output of an earlier check of
+ * identical data is replayed instead, with a fresh "current time".
+ */
+static int crypt_verify_cached(struct Body *sigbdy, struct State *s,
+                               const char *tempf, verify_one_t verify)
+{
+  unsigned char digest[16];
+  size_t datalen = 0;
+
+  verify_cache_check_stamp();
+
+  char *data = verify_cache_read(sigbdy, s, tempf, &datalen);
+  if (!data)
+    return verify(sigbdy, s, tempf);
+
+  mutt_md5_bytes(data, datalen, digest);
+
+  struct VerifyCacheEntry *ve =
+      verify_cache_lookup(digest, data, datalen, sigbdy->length, s);
+  if (ve)
+  {
+    mutt_debug(2, "replaying cached signature verification\n");
+    FREE(&data);
+    if (ve->time_start < 0)
+    {
+      fwrite(ve->output, 1, ve->outlen, s->fpout);
+      return ve->rc;
+    }
+    fwrite(ve->output, 1, ve->time_start, s->fpout);
+    crypt_current_time(s, ve->app_name);
+    fwrite(ve->output + ve->time_end, 1, ve->outlen - ve->time_end, s->fpout);
+    return ve->rc;
+  }
+
+  FILE *fpcap = mutt_file_mkstemp();
+  if (!fpcap)
+  {
+    FREE(&data);
+    return verify(sigbdy, s, tempf);
+  }
+
+  FILE *fpout = s->fpout;
+  s->fpout = fpcap;
+  VerifyCaptureFp = fpcap;
+  VerifyCaptureTimeStart = -1;
+  VerifyCaptureTimeEnd = -1;
+  VerifyCaptureApp = NULL;
+
+  int rc = verify(sigbdy, s, tempf);
+
+  VerifyCaptureFp = NULL;
+  s->fpout = fpout;
+
+  /* Pass the output on, keeping a copy if it's not too big */
+  long outlen = ftell(fpcap);
+  char *output = NULL;
+  if ((outlen >= 0) && (outlen <= VERIFY_CACHE_MAX_DATA))
+  {
+    output = mutt_mem_malloc(outlen + 1);
+    rewind(fpcap);
+    if (fread(output, 1, outlen, fpcap) == (size_t) outlen)
+      fwrite(output, 1, outlen, s->fpout);
+    else
+      FREE(&output);
+  }
+  if (!output)
+  {
+    rewind(fpcap);
+    mutt_file_copy_stream(fpcap, s->fpout);
+  }
+  mutt_file_fclose(&fpcap);
+
+  if (!output)
+  {
+    FREE(&data);
+    return rc;
+  }
+
+  ve = &VerifyCache[VerifyCacheNext];
+  VerifyCacheNext = (VerifyCacheNext + 1) % VERIFY_CACHE_SIZE;
+  verify_cache_free_entry(ve);
+
+  memcpy(ve->digest, digest, sizeof(ve->digest));
+  ve->data = data;
+  ve->datalen = datalen;
+  ve->siglen = sigbdy->length;
+  ve->flags = s->flags;
+  ve->prefix = mutt_str_strdup(s->prefix);
+  ve->output = output;
+  ve->outlen = outlen;
+  ve->time_start = VerifyCaptureTimeStart;
+  ve->time_end = VerifyCaptureTimeEnd;
+  ve->app_name = VerifyCaptureApp;
+  ve->rc = rc;
+
+  return rc;
+}
+
 /**
  * mutt_signed_handler - Verify a "multipart/signed" body - Implements ::handler_t
  */
@@ -1148,7 +1485,7 @@ int mutt_signed_handler(struct Body *a, struct State *s)
           if (((WithCrypto & APPLICATION_PGP) != 0) && signatures[i]->type == TYPE_APPLICATION &&
               (mutt_str_strcasecmp(signatures[i]->subtype, "pgp-signature") == 0))
           {
-            if (crypt_pgp_verify_one(signatures[i], s, tempfile) != 0)
+            if (crypt_verify_cached(signatures[i], s, tempfile, crypt_pgp_verify_one) != 0)
               goodsig = false;
 
             continue;
@@ -1160,7 +1497,7 @@ int mutt_signed_handler(struct Body *a, struct State *s)
                (mutt_str_strcasecmp(signatures[i]->subtype,
                                     "pkcs7-signature") == 0)))
           {
-            if (crypt_smime_verify_one(signatures[i], s, tempfile) != 0)
+            if (crypt_verify_cached(signatures[i], s, tempfile, crypt_smime_verify_one) != 0)
               goodsig = false;
 
             continue;
@@ -24,6 +24,7 @@
 #define MUTT_NCRYPT_CRYPT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 struct Body;
 struct State;
@@ -32,6 +33,7 @@ void        crypt_convert_to_7bit(struct Body *a);
 void        crypt_current_time(struct State *s, const char *app_name);
 const char *crypt_get_fingerprint_or_id(char *p, const char **pphint, const char **ppl, const char **pps);
 bool        crypt_is_numerical_keyid(const char *s);
+void        crypt_keyring_stamp(char *buf, size_t buflen);
 int         crypt_write_signed(struct Body *a, struct State *s, const char *tempfile);
 
 #endif /* MUTT_NCRYPT_CRYPT_H */
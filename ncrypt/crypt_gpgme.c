@@ -4265,6 +4265,39 @@ static void crypt_add_string_to_hints(const char *str, struct ListHead *hints)
   FREE(&scratch);
 }
 
+/**
+ * crypt_addr_add_hints - Add the parts of an Address to a List of hints
+ * @param[in]  a     Address
+ * @param[out] hints List of string parts
+ * @retval true At least one hint was added
+ */
+static bool crypt_addr_add_hints(struct Address *a, struct ListHead *hints)
+{
+  struct ListHead parts = STAILQ_HEAD_INITIALIZER(parts);
+
+  if (a && a->mailbox)
+    crypt_add_string_to_hints(a->mailbox, &parts);
+  if (a && a->personal)
+    crypt_add_string_to_hints(a->personal, &parts);
+
+  bool rc = !STAILQ_EMPTY(&parts);
+  STAILQ_CONCAT(hints, &parts);
+  return rc;
+}
+
+/**
+ * crypt_addr_has_hints - Does an Address give any hints for a keyring search?
+ * @param a Address
+ * @retval true At least one part of the Address is long enough to be a hint
+ */
+static bool crypt_addr_has_hints(struct Address *a)
+{
+  struct ListHead hints = STAILQ_HEAD_INITIALIZER(hints);
+  bool rc = crypt_addr_add_hints(a, &hints);
+  mutt_list_free(&hints);
+  return rc;
+}
+
 /**
  * crypt_select_key - Get the user to select a key
  * @param[in]  keys         List of keys to select from
@@ -4486,11 +4519,18 @@ static struct CryptKeyInfo *crypt_select_key(struct CryptKeyInfo *keys,
  * @param[in]  app          Application type, e.g. #APPLICATION_PGP
  * @param[out] forced_valid Set to true if user overrode key's validity
  * @param[in]  oppenc_mode  If true, use opportunistic encryption
+ * @param[in]  candidates   Keys already listed for this address, or NULL
  * @retval ptr Matching key
+ *
+ * If candidates is NULL, the keyring is searched for the address.  Otherwise
+ * the keys are only filtered: only the user IDs that match the address
+ * exactly are used, so a list made for several addresses gives the same
+ * result.
  */
-static struct CryptKeyInfo *crypt_getkeybyaddr(struct Address *a,
-                                               short abilities, unsigned int app,
-                                               int *forced_valid, bool oppenc_mode)
+static struct CryptKeyInfo *crypt_getkeybyaddr(struct Address *a, short abilities,
+                                               unsigned int app, int *forced_valid,
+                                               bool oppenc_mode,
+                                               struct CryptKeyInfo *candidates)
 {
   struct Address *r = NULL, *p = NULL;
   struct ListHead hints = STAILQ_HEAD_INITIALIZER(hints);
@@ -4508,16 +4548,18 @@ static struct CryptKeyInfo *crypt_getkeybyaddr(struct Address *a,
 
   *forced_valid = 0;
 
-  if (a && a->mailbox)
-    crypt_add_string_to_hints(a->mailbox, &hints);
-  if (a && a->personal)
-    crypt_add_string_to_hints(a->personal, &hints);
+  if (candidates)
+    keys = candidates;
+  else
+  {
+    crypt_addr_add_hints(a, &hints);
 
-  if (!oppenc_mode)
-    mutt_message(_("Looking for keys matching \"%s\"..."), a ? a->mailbox : "");
-  keys = get_candidates(&hints, app, (abilities & KEYFLAG_CANSIGN));
+    if (!oppenc_mode)
+      mutt_message(_("Looking for keys matching \"%s\"..."), a ? a->mailbox : "");
+    keys = get_candidates(&hints, app, (abilities & KEYFLAG_CANSIGN));
 
-  mutt_list_free(&hints);
+    mutt_list_free(&hints);
+  }
 
   if (!keys)
     return NULL;
@@ -4575,7 +4617,8 @@ static struct CryptKeyInfo *crypt_getkeybyaddr(struct Address *a,
     }
   }
 
-  crypt_free_key(&keys);
+  if (keys != candidates)
+    crypt_free_key(&keys);
 
   if (matches)
   {
@@ -4776,6 +4819,19 @@ static char *find_keys(struct Address *addrlist, unsigned int app, bool oppenc_m
   int r;
   bool key_selected;
 
+  /* list the keys of all the recipients in one pass over the keyring */
+  struct ListHead hints = STAILQ_HEAD_INITIALIZER(hints);
+  struct CryptKeyInfo *candidates = NULL;
+  for (p = addrlist; p; p = p->next)
+    crypt_addr_add_hints(p, &hints);
+  if (!STAILQ_EMPTY(&hints))
+  {
+    if (!oppenc_mode)
+      mutt_message(_("Looking for keys of the recipients..."));
+    candidates = get_candidates(&hints, app, 0);
+    mutt_list_free(&hints);
+  }
+
   for (p = addrlist; p; p = p->next)
   {
     key_selected = false;
@@ -4833,13 +4889,20 @@ static char *find_keys(struct Address *addrlist, unsigned int app, bool oppenc_m
           FREE(&keylist);
           mutt_addr_free(&addr);
           mutt_list_free(&crypt_hook_list);
+          crypt_free_key(&candidates);
           return NULL;
         }
       }
 
-      if (!k_info)
+      /* An address from a crypt-hook wasn't in the batch, nor was one too
+       * short to give any hints.  The keyring search for an empty pattern
+       * lists every S/MIME certificate, so that one may still succeed. */
+      if (!k_info && ((q != p) || !crypt_addr_has_hints(q)))
+        k_info = crypt_getkeybyaddr(q, KEYFLAG_CANENCRYPT, app, &forced_valid, oppenc_mode, NULL);
+      else if (!k_info && candidates)
       {
-        k_info = crypt_getkeybyaddr(q, KEYFLAG_CANENCRYPT, app, &forced_valid, oppenc_mode);
+        k_info = crypt_getkeybyaddr(q, KEYFLAG_CANENCRYPT, app, &forced_valid,
+                                    oppenc_mode, candidates);
       }
 
       if (!k_info && !oppenc_mode)
@@ -4854,6 +4917,7 @@ static char *find_keys(struct Address *addrlist, unsigned int app, bool oppenc_m
         FREE(&keylist);
         mutt_addr_free(&addr);
         mutt_list_free(&crypt_hook_list);
+        crypt_free_key(&candidates);
         return NULL;
       }
 
@@ -4878,6 +4942,7 @@ static char *find_keys(struct Address *addrlist, unsigned int app, bool oppenc_m
 
     mutt_list_free(&crypt_hook_list);
   }
+  crypt_free_key(&candidates);
   return keylist;
 }
 
@@ -43,8 +43,10 @@
 #include <unistd.h>
 #include "mutt/mutt.h"
 #include "email/lib.h"
+#include "crypt.h"
 #include "filter.h"
 #include "globals.h"
+#include "gnupgparse.h"
 #include "ncrypt.h"
 #include "pgpinvoke.h"
 #include "pgpkey.h"
@@ -69,8 +71,25 @@
  *   - signature class
  */
 
+/* These Config Variables are only used in ncrypt/gnupgparse.c */
+bool PgpKeyringCache; ///< Config: Keep a parsed copy of the PGP keyrings in memory
+
 static char *chs = NULL;
 
+/**
+ * struct PgpKeyringCache - A parsed listing of a whole keyring
+ */
+struct PgpKeyringCache
+{
+  char stamp[1024];               ///< State of the keyrings when they were listed
+  struct PgpKeyInfo *keys;        ///< All the keys
+  struct PgpKeyInfo **families;   ///< Principal key of each family, in keyring order
+  size_t num_families;            ///< Number of families
+  struct Hash *by_addr;           ///< Families by the mailbox and name of their user ids
+};
+
+static struct PgpKeyringCache KeyringCache[2]; ///< Public [0] and secret [1] keyrings
+
 /**
  * fix_uid - Decode backslash-escaped user ids (in place)
  * @param uid String to decode
@@ -394,34 +413,49 @@ bail:
 }
 
 /**
- * pgp_get_candidates - Find PGP keys matching a list of hints
+ * pgp_candidates_start - Start looking for PGP keys matching a list of hints
+ * @param query   Lookup to start
  * @param keyring PGP Keyring
  * @param hints   List of strings to match
+ * @retval true The key lister is running
+ *
+ * The keys are collected by pgp_candidates_finish(), so several lookups may
+ * run at the same time.
+ */
+bool pgp_candidates_start(struct PgpCandidateQuery *query, enum PgpRing keyring,
+                          struct ListHead *hints)
+{
+  query->fp = NULL;
+  query->pid = -1;
+
+  int devnull = open("/dev/null", O_RDWR);
+  if (devnull == -1)
+    return false;
+
+  query->pid = pgp_invoke_list_keys(NULL, &query->fp, NULL, -1, -1, devnull, keyring, hints);
+  close(devnull);
+
+  return (query->pid != -1);
+}
+
+/**
+ * pgp_candidates_finish - Collect the keys found by pgp_candidates_start()
+ * @param query Lookup to finish
  * @retval ptr  Key list
- * @retval NULL Error
+ * @retval NULL Error, or no keys
  */
-struct PgpKeyInfo *pgp_get_candidates(enum PgpRing keyring, struct ListHead *hints)
+struct PgpKeyInfo *pgp_candidates_finish(struct PgpCandidateQuery *query)
 {
-  FILE *fp = NULL;
-  pid_t thepid;
   char buf[LONG_STRING];
   struct PgpKeyInfo *db = NULL, **kend = NULL, *k = NULL, *kk = NULL, *mainkey = NULL;
   int is_sub;
-  int devnull;
+  FILE *fp = query->fp;
 
-  devnull = open("/dev/null", O_RDWR);
-  if (devnull == -1)
+  if (query->pid == -1)
     return NULL;
 
   mutt_str_replace(&chs, Charset);
 
-  thepid = pgp_invoke_list_keys(NULL, &fp, NULL, -1, -1, devnull, keyring, hints);
-  if (thepid == -1)
-  {
-    close(devnull);
-    return NULL;
-  }
-
   kend = &db;
   k = NULL;
   while (fgets(buf, sizeof(buf) - 1, fp))
@@ -456,10 +490,269 @@ struct PgpKeyInfo *pgp_get_candidates(enum PgpRing keyring, struct ListHead *hin
   if (ferror(fp))
     mutt_perror("fgets");
 
-  mutt_file_fclose(&fp);
-  mutt_wait_filter(thepid);
-
-  close(devnull);
+  mutt_file_fclose(&query->fp);
+  mutt_wait_filter(query->pid);
+  query->pid = -1;
 
   return db;
 }
+
+/**
+ * keyring_cache_free - Forget a cached keyring
+ * @param kc Keyring cache
+ */
+static void keyring_cache_free(struct PgpKeyringCache *kc)
+{
+  mutt_hash_destroy(&kc->by_addr);
+  FREE(&kc->families);
+  kc->num_families = 0;
+  pgp_free_key(&kc->keys);
+  kc->stamp[0] = '\0';
+}
+
+/**
+ * keyring_cache_stamp - Describe everything a keyring listing depends on
+ * @param buf     Buffer for the description
+ * @param buflen  Length of buffer
+ * @param keyring PGP Keyring
+ */
+static void keyring_cache_stamp(char *buf, size_t buflen, enum PgpRing keyring)
+{
+  *buf = '\0';
+  crypt_keyring_stamp(buf, buflen);
+
+  size_t len = mutt_str_strlen(buf);
+  if (len < buflen)
+  {
+    snprintf(buf + len, buflen - len, "%d:%s:%s", PgpIgnoreSubkeys, NONULL(Charset),
+             (keyring == PGP_SECRING) ? NONULL(PgpListSecringCommand) :
+                                        NONULL(PgpListPubringCommand));
+  }
+}
+
+/**
+ * keyring_cache_get - Get a parsed listing of a whole keyring
+ * @param keyring PGP Keyring
+ * @retval ptr  Up to date keyring cache
+ * @retval NULL Error
+ *
+ * The keyring is listed again if it has changed since it was last read.
+ */
+static struct PgpKeyringCache *keyring_cache_get(enum PgpRing keyring)
+{
+  struct PgpKeyringCache *kc = &KeyringCache[(keyring == PGP_SECRING) ? 1 : 0];
+  struct ListHead hints = STAILQ_HEAD_INITIALIZER(hints);
+  struct PgpCandidateQuery query;
+  char stamp[sizeof(kc->stamp)];
+
+  keyring_cache_stamp(stamp, sizeof(stamp), keyring);
+  if (kc->stamp[0] && (mutt_str_strcmp(stamp, kc->stamp) == 0))
+    return kc;
+
+  keyring_cache_free(kc);
+
+  if (!pgp_candidates_start(&query, keyring, &hints))
+    return NULL;
+  kc->keys = pgp_candidates_finish(&query);
+
+  size_t alloc = 0;
+  for (struct PgpKeyInfo *k = kc->keys; k; k = k->next)
+  {
+    if (k->parent)
+      continue;
+    if (kc->num_families == alloc)
+    {
+      alloc += 256;
+      mutt_mem_realloc(&kc->families, alloc * sizeof(struct PgpKeyInfo *));
+    }
+    kc->families[kc->num_families++] = k;
+  }
+
+  kc->by_addr = mutt_hash_create(MAX(kc->num_families, 16),
+                                 MUTT_HASH_STRCASECMP | MUTT_HASH_STRDUP_KEYS |
+                                     MUTT_HASH_ALLOW_DUPS);
+  for (size_t i = 0; i < kc->num_families; i++)
+  {
+    for (struct PgpUid *uid = kc->families[i]->address; uid; uid = uid->next)
+    {
+      struct Address *al = mutt_addr_parse_list(NULL, NONULL(uid->addr));
+      for (struct Address *a = al; a; a = a->next)
+      {
+        if (a->mailbox)
+          mutt_hash_insert(kc->by_addr, a->mailbox, &kc->families[i]);
+        if (a->personal)
+          mutt_hash_insert(kc->by_addr, a->personal, &kc->families[i]);
+      }
+      mutt_addr_free(&al);
+    }
+  }
+
+  mutt_str_strfcpy(kc->stamp, stamp, sizeof(kc->stamp));
+  mutt_debug(3, "cached %zu keys from the %s keyring\n", kc->num_families,
+             (keyring == PGP_SECRING) ? "secret" : "public");
+  return kc;
+}
+
+/**
+ * keyring_cache_copy_family - Copy a key and its subkeys
+ * @param[in]  main Principal key
+ * @param[out] last End of the list to append the copies to
+ * @retval ptr New end of the list
+ */
+static struct PgpKeyInfo **keyring_cache_copy_family(struct PgpKeyInfo *main,
+                                                     struct PgpKeyInfo **last)
+{
+  struct PgpKeyInfo *copy_main = NULL;
+
+  for (struct PgpKeyInfo *k = main; k && ((k == main) || (k->parent == main)); k = k->next)
+  {
+    struct PgpKeyInfo *copy = pgp_new_keyinfo();
+    copy->keyid = mutt_str_strdup(k->keyid);
+    copy->fingerprint = mutt_str_strdup(k->fingerprint);
+    copy->flags = k->flags;
+    copy->keylen = k->keylen;
+    copy->gen_time = k->gen_time;
+    copy->numalg = k->numalg;
+    copy->algorithm = k->algorithm;
+    copy->address = pgp_copy_uids(k->address, copy);
+    if (k == main)
+      copy_main = copy;
+    else
+      copy->parent = copy_main;
+
+    *last = copy;
+    last = &copy->next;
+  }
+
+  return last;
+}
+
+/**
+ * keyring_cache_id_matches - Does a hint name a key by its id?
+ * @param hint Hint, e.g. "DEADBEEF"
+ * @param k    Key to test
+ * @retval true The hint is the key's short or long id, or its fingerprint
+ */
+static bool keyring_cache_id_matches(const char *hint, struct PgpKeyInfo *k)
+{
+  size_t hlen = mutt_str_strlen(hint);
+  const char *id = ((hlen == 40) || (hlen == 32)) ? k->fingerprint : k->keyid;
+  size_t idlen = mutt_str_strlen(id);
+
+  if (((hlen != 8) && (hlen != 16) && (hlen != 32) && (hlen != 40)) || (idlen < hlen))
+    return false;
+
+  return mutt_str_strcasecmp(id + idlen - hlen, hint) == 0;
+}
+
+/**
+ * keyring_cache_family_matches - Would the key lister have listed this key?
+ * @param main  Principal key
+ * @param hints List of strings to match
+ * @retval true One of the hints matches a user id or key id of the family
+ */
+static bool keyring_cache_family_matches(struct PgpKeyInfo *main, struct ListHead *hints)
+{
+  if (STAILQ_EMPTY(hints))
+    return true;
+
+  struct ListNode *np = NULL;
+  STAILQ_FOREACH(np, hints, entries)
+  {
+    for (struct PgpKeyInfo *k = main; k && ((k == main) || (k->parent == main)); k = k->next)
+    {
+      if (keyring_cache_id_matches(np->data, k))
+        return true;
+    }
+    for (struct PgpUid *uid = main->address; uid; uid = uid->next)
+    {
+      if (mutt_str_stristr(uid->addr, np->data))
+        return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * pgp_get_candidates_by_addr - Find PGP keys that may belong to an address
+ * @param keyring PGP Keyring
+ * @param a       Email address
+ * @param hints   Hints for the key lister, made from the address
+ * @retval ptr  Key list
+ * @retval NULL Error, or no keys
+ *
+ * With $pgp_keyring_cache set, only the keys with a user id whose mailbox or
+ * name is the same as the address's are returned.  Those are the only keys
+ * that pgp_getkeybyaddr() keeps from a normal listing.
+ */
+struct PgpKeyInfo *pgp_get_candidates_by_addr(enum PgpRing keyring,
+                                              struct Address *a, struct ListHead *hints)
+{
+  if (!PgpKeyringCache)
+    return pgp_get_candidates(keyring, hints);
+
+  struct PgpKeyringCache *kc = keyring_cache_get(keyring);
+  if (!kc)
+    return NULL;
+
+  /* Collect the families in keyring order, without duplicates */
+  bool *found = mutt_mem_calloc(MAX(kc->num_families, 1), sizeof(bool));
+  const char *names[2] = { a->mailbox, a->personal };
+  for (size_t i = 0; i < mutt_array_size(names); i++)
+  {
+    if (!names[i])
+      continue;
+    struct HashElem *he = mutt_hash_find_bucket(kc->by_addr, names[i]);
+    for (; he; he = he->next)
+    {
+      if (mutt_str_strcasecmp(he->key.strkey, names[i]) != 0)
+        continue;
+      found[(struct PgpKeyInfo **) he->data - kc->families] = true;
+    }
+  }
+
+  struct PgpKeyInfo *keys = NULL;
+  struct PgpKeyInfo **last = &keys;
+  for (size_t i = 0; i < kc->num_families; i++)
+  {
+    if (found[i])
+      last = keyring_cache_copy_family(kc->families[i], last);
+  }
+  FREE(&found);
+
+  return keys;
+}
+
+/**
+ * pgp_get_candidates - Find PGP keys matching a list of hints
+ * @param keyring PGP Keyring
+ * @param hints   List of strings to match
+ * @retval ptr  Key list
+ * @retval NULL Error
+ */
+struct PgpKeyInfo *pgp_get_candidates(enum PgpRing keyring, struct ListHead *hints)
+{
+  struct PgpCandidateQuery query;
+
+  if (PgpKeyringCache)
+  {
+    struct PgpKeyringCache *kc = keyring_cache_get(keyring);
+    if (!kc)
+      return NULL;
+
+    struct PgpKeyInfo *keys = NULL;
+    struct PgpKeyInfo **last = &keys;
+    for (size_t i = 0; i < kc->num_families; i++)
+    {
+      if (keyring_cache_family_matches(kc->families[i], hints))
+        last = keyring_cache_copy_family(kc->families[i], last);
+    }
+    return keys;
+  }
+
+  if (!pgp_candidates_start(&query, keyring, hints))
+    return NULL;
+
+  return pgp_candidates_finish(&query);
+}
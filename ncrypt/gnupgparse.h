@@ -23,10 +23,26 @@
 #ifndef MUTT_NCRYPT_GNUPGPARSE_H
 #define MUTT_NCRYPT_GNUPGPARSE_H
 
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
 #include "pgpkey.h"
 
+struct Address;
 struct ListHead;
 
+/**
+ * struct PgpCandidateQuery - A running search for PGP keys
+ */
+struct PgpCandidateQuery
+{
+  pid_t pid; ///< Process listing the keys, or -1
+  FILE *fp;  ///< Output of the key lister
+};
+
+bool                pgp_candidates_start(struct PgpCandidateQuery *query, enum PgpRing keyring, struct ListHead *hints);
+struct PgpKeyInfo * pgp_candidates_finish(struct PgpCandidateQuery *query);
 struct PgpKeyInfo * pgp_get_candidates(enum PgpRing keyring, struct ListHead *hints);
+struct PgpKeyInfo * pgp_get_candidates_by_addr(enum PgpRing keyring, struct Address *a, struct ListHead *hints);
 
 #endif /* MUTT_NCRYPT_GNUPGPARSE_H */
@@ -79,6 +79,9 @@ extern struct Regex *PgpGoodSign;
 extern long          PgpTimeout;
 extern bool          PgpUseGpgAgent;
 
+/* These Config Variables are only used in ncrypt/gnupgparse.c */
+extern bool PgpKeyringCache;
+
 /* These Config Variables are only used in ncrypt/pgpinvoke.c */
 extern char *PgpClearsignCommand;
 extern char *PgpDecodeCommand;
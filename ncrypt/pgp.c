@@ -50,6 +50,7 @@
 #include "curs_lib.h"
 #include "filter.h"
 #include "globals.h"
+#include "gnupgparse.h"
 #include "handler.h"
 #include "hook.h"
 #include "mutt_attach.h"
@@ -1379,6 +1380,108 @@ struct Body *pgp_class_sign_message(struct Body *a)
   return a;
 }
 
+/**
+ * struct PgpKeyLookups - Key lookups running ahead of pgp_class_find_keys()
+ *
+ * Listing the keys of a recipient means running gpg.  Rather than wait for
+ * each listing in turn, up to $worker_threads of them run at the same time.
+ */
+struct PgpKeyLookups
+{
+  struct PgpCandidateQuery *queries; ///< One lookup per address
+  size_t num;                        ///< Number of addresses
+  size_t width;                      ///< Maximum number of lookups to run ahead
+  size_t next;                       ///< Index of the next address to start
+  struct Address *next_addr;         ///< Next address to start
+};
+
+/**
+ * pgp_lookups_init - Prepare to look up the keys of some addresses in parallel
+ * @param lookups  Lookups to initialise
+ * @param addrlist Addresses to look up
+ */
+static void pgp_lookups_init(struct PgpKeyLookups *lookups, struct Address *addrlist)
+{
+  memset(lookups, 0, sizeof(*lookups));
+
+  /* $pgp_getkeys_command must finish before the keys can be listed.
+   * A cached keyring doesn't need listing at all. */
+  if ((WorkerThreads < 2) || PgpGetkeysCommand || PgpKeyringCache)
+    return;
+
+  for (struct Address *p = addrlist; p; p = p->next)
+    lookups->num++;
+  if (lookups->num < 2)
+    return;
+
+  lookups->queries = mutt_mem_calloc(lookups->num, sizeof(struct PgpCandidateQuery));
+  for (size_t i = 0; i < lookups->num; i++)
+    lookups->queries[i].pid = -1;
+  lookups->width = WorkerThreads;
+  lookups->next_addr = addrlist;
+}
+
+/**
+ * pgp_lookups_advance - Start the lookups for the next few addresses
+ * @param lookups Lookups
+ * @param cur     Index of the address about to be processed
+ *
+ * Addresses with a crypt-hook aren't looked up in advance, because the hook
+ * may replace them.
+ */
+static void pgp_lookups_advance(struct PgpKeyLookups *lookups, size_t cur)
+{
+  struct ListHead crypt_hook_list = STAILQ_HEAD_INITIALIZER(crypt_hook_list);
+
+  if (!lookups->queries)
+    return;
+
+  for (; (lookups->next < lookups->num) && (lookups->next < cur + lookups->width);
+       lookups->next++, lookups->next_addr = lookups->next_addr->next)
+  {
+    mutt_crypt_hook(&crypt_hook_list, lookups->next_addr);
+    if (STAILQ_EMPTY(&crypt_hook_list))
+    {
+      pgp_lookup_addr_start(&lookups->queries[lookups->next],
+                            lookups->next_addr, PGP_PUBRING);
+    }
+    mutt_list_free(&crypt_hook_list);
+  }
+}
+
+/**
+ * pgp_lookups_get - Get the lookup started for an address
+ * @param lookups Lookups
+ * @param cur     Index of the address
+ * @retval ptr  Running lookup
+ * @retval NULL The address wasn't looked up in advance
+ */
+static struct PgpCandidateQuery *pgp_lookups_get(struct PgpKeyLookups *lookups, size_t cur)
+{
+  if (!lookups->queries || (cur >= lookups->next) || (lookups->queries[cur].pid == -1))
+    return NULL;
+  return &lookups->queries[cur];
+}
+
+/**
+ * pgp_lookups_free - Wait for any unused lookups and free them
+ * @param lookups Lookups
+ */
+static void pgp_lookups_free(struct PgpKeyLookups *lookups)
+{
+  if (!lookups->queries)
+    return;
+
+  for (size_t i = 0; i < lookups->next; i++)
+  {
+    if (lookups->queries[i].pid == -1)
+      continue;
+    struct PgpKeyInfo *keys = pgp_candidates_finish(&lookups->queries[i]);
+    pgp_free_key(&keys);
+  }
+  FREE(&lookups->queries);
+}
+
 /**
  * pgp_class_find_keys - Implements CryptModuleSpecs::find_keys()
  */
@@ -1398,9 +1501,14 @@ char *pgp_class_find_keys(struct Address *addrlist, bool oppenc_mode)
 
   const char *fqdn = mutt_fqdn(true);
 
-  for (p = addrlist; p; p = p->next)
+  struct PgpKeyLookups lookups;
+  pgp_lookups_init(&lookups, addrlist);
+  size_t cur = 0;
+
+  for (p = addrlist; p; p = p->next, cur++)
   {
     key_selected = false;
+    pgp_lookups_advance(&lookups, cur);
     mutt_crypt_hook(&crypt_hook_list, p);
     crypt_hook = STAILQ_FIRST(&crypt_hook_list);
     do
@@ -1451,14 +1559,17 @@ char *pgp_class_find_keys(struct Address *addrlist, bool oppenc_mode)
           FREE(&keylist);
           mutt_addr_free(&addr);
           mutt_list_free(&crypt_hook_list);
+          pgp_lookups_free(&lookups);
           return NULL;
         }
       }
 
       if (!k_info)
       {
-        pgp_class_invoke_getkeys(q);
-        k_info = pgp_getkeybyaddr(q, KEYFLAG_CANENCRYPT, PGP_PUBRING, oppenc_mode);
+        struct PgpCandidateQuery *query = (q == p) ? pgp_lookups_get(&lookups, cur) : NULL;
+        if (!query)
+          pgp_class_invoke_getkeys(q);
+        k_info = pgp_getkeybyaddr(q, KEYFLAG_CANENCRYPT, PGP_PUBRING, oppenc_mode, query);
       }
 
       if (!k_info && !oppenc_mode)
@@ -1472,6 +1583,7 @@ char *pgp_class_find_keys(struct Address *addrlist, bool oppenc_mode)
         FREE(&keylist);
         mutt_addr_free(&addr);
         mutt_list_free(&crypt_hook_list);
+        pgp_lookups_free(&lookups);
         return NULL;
       }
 
@@ -1495,6 +1607,7 @@ char *pgp_class_find_keys(struct Address *addrlist, bool oppenc_mode)
 
     mutt_list_free(&crypt_hook_list);
   }
+  pgp_lookups_free(&lookups);
   return keylist;
 }
 
@@ -979,16 +979,52 @@ static struct PgpKeyInfo **pgp_get_lastp(struct PgpKeyInfo *p)
   return NULL;
 }
 
+/**
+ * pgp_addr_hints - Get the strings to search for an address's keys
+ * @param a     Email address
+ * @param hints List for the hints
+ */
+static void pgp_addr_hints(struct Address *a, struct ListHead *hints)
+{
+  if (a->mailbox)
+    pgp_add_string_to_hints(a->mailbox, hints);
+  if (a->personal)
+    pgp_add_string_to_hints(a->personal, hints);
+}
+
+/**
+ * pgp_lookup_addr_start - Start looking for the keys of an address
+ * @param query   Lookup to start
+ * @param a       Email address to match
+ * @param keyring PGP keyring to use
+ * @retval true The key lister is running
+ *
+ * Pass the query to pgp_getkeybyaddr() to choose a key from the results.
+ */
+bool pgp_lookup_addr_start(struct PgpCandidateQuery *query, struct Address *a,
+                           enum PgpRing keyring)
+{
+  struct ListHead hints = STAILQ_HEAD_INITIALIZER(hints);
+
+  pgp_addr_hints(a, &hints);
+  bool rc = pgp_candidates_start(query, keyring, &hints);
+  mutt_list_free(&hints);
+
+  return rc;
+}
+
 /**
  * pgp_getkeybyaddr - Find a PGP key by address
  * @param a           Email address to match
  * @param abilities   Abilities to match, e.g. #KEYFLAG_CANENCRYPT
  * @param keyring     PGP keyring to use
  * @param oppenc_mode If true, use opportunistic encryption
+ * @param query       Lookup started by pgp_lookup_addr_start(), or NULL
  * @retval ptr Matching PGP key
  */
 struct PgpKeyInfo *pgp_getkeybyaddr(struct Address *a, short abilities,
-                                    enum PgpRing keyring, bool oppenc_mode)
+                                    enum PgpRing keyring, bool oppenc_mode,
+                                    struct PgpCandidateQuery *query)
 {
   if (!a)
     return NULL;
@@ -1005,16 +1041,17 @@ struct PgpKeyInfo *pgp_getkeybyaddr(struct Address *a, short abilities,
   struct PgpKeyInfo **last = &matches;
   struct PgpUid *q = NULL;
 
-  if (a->mailbox)
-    pgp_add_string_to_hints(a->mailbox, &hints);
-  if (a->personal)
-    pgp_add_string_to_hints(a->personal, &hints);
-
   if (!oppenc_mode)
     mutt_message(_("Looking for keys matching \"%s\"..."), a->mailbox);
-  keys = pgp_get_candidates(keyring, &hints);
 
-  mutt_list_free(&hints);
+  if (query)
+    keys = pgp_candidates_finish(query);
+  else
+  {
+    pgp_addr_hints(a, &hints);
+    keys = pgp_get_candidates_by_addr(keyring, a, &hints);
+    mutt_list_free(&hints);
+  }
 
   if (!keys)
     return NULL;
@@ -26,6 +26,7 @@
 #include <stdbool.h>
 
 struct Address;
+struct PgpCandidateQuery;
 
 /**
  * enum PgpRing - PGP ring type
@@ -39,7 +40,8 @@ enum PgpRing
 struct Body *pgp_class_make_key_attachment(void);
 
 struct PgpKeyInfo *pgp_ask_for_key(char *tag, char *whatfor, short abilities, enum PgpRing keyring);
-struct PgpKeyInfo *pgp_getkeybyaddr(struct Address *a, short abilities, enum PgpRing keyring, bool oppenc_mode);
+struct PgpKeyInfo *pgp_getkeybyaddr(struct Address *a, short abilities, enum PgpRing keyring, bool oppenc_mode, struct PgpCandidateQuery *query);
 struct PgpKeyInfo *pgp_getkeybystr(char *p, short abilities, enum PgpRing keyring);
+bool               pgp_lookup_addr_start(struct PgpCandidateQuery *query, struct Address *a, enum PgpRing keyring);
 
 #endif /* MUTT_NCRYPT_PGPKEY_H */
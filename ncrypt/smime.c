@@ -708,43 +708,185 @@ static struct SmimeKey *smime_parse_key(char *buf)
 }
 
 /**
- * smime_get_candidates - Find keys matching a string
- * @param search String to match
- * @param public If true, only get the public keys
- * @retval ptr Matching key
+ * struct SmimeIndexEntry - One line of an S/MIME .index file
  */
-static struct SmimeKey *smime_get_candidates(char *search, bool public)
+struct SmimeIndexEntry
+{
+  char *line;                         ///< Text of the line
+  struct SmimeKey *key;               ///< Key parsed from the line, or NULL
+  struct SmimeIndexEntry *next_email; ///< Next entry with the same mailbox
+  struct SmimeIndexEntry *next_hash;  ///< Next entry with the same hash
+};
+
+/**
+ * struct SmimeIndex - The parsed contents of an S/MIME .index file
+ *
+ * The file is only parsed again if it changes.
+ */
+struct SmimeIndex
+{
+  char path[PATH_MAX];              ///< Path of the .index file
+  ino_t ino;                        ///< Inode of the file when it was read
+  time_t mtime;                     ///< Modification time of the file when it was read
+  off_t size;                       ///< Size of the file when it was read
+  struct SmimeIndexEntry *entries;  ///< Lines of the file
+  size_t num_entries;               ///< Number of lines
+  struct Hash *by_email;            ///< First entry for each mailbox
+  struct Hash *by_hash;             ///< First entry for each hash
+};
+
+static struct SmimeIndex SmimeIndexes[2]; ///< Private keys [0] and public certificates [1]
+
+/**
+ * smime_index_free - Forget the contents of an index
+ * @param idx Index to free
+ */
+static void smime_index_free(struct SmimeIndex *idx)
+{
+  for (size_t i = 0; i < idx->num_entries; i++)
+  {
+    FREE(&idx->entries[i].line);
+    smime_free_key(&idx->entries[i].key);
+  }
+  FREE(&idx->entries);
+  idx->num_entries = 0;
+  mutt_hash_destroy(&idx->by_email);
+  mutt_hash_destroy(&idx->by_hash);
+  idx->path[0] = '\0';
+}
+
+/**
+ * smime_index_add - Add an entry to the chain for a key
+ * @param table Hash table of chains
+ * @param str   Key, e.g. the mailbox
+ * @param entry Entry to add
+ * @param email If true, use the mailbox chain, otherwise the hash chain
+ *
+ * The chains are kept in the order of the file.
+ */
+static void smime_index_add(struct Hash *table, const char *str,
+                            struct SmimeIndexEntry *entry, bool email)
+{
+  if (!str)
+    return;
+
+  struct SmimeIndexEntry *head = mutt_hash_find(table, str);
+  if (!head)
+  {
+    mutt_hash_insert(table, str, entry);
+    return;
+  }
+
+  while (email ? head->next_email : head->next_hash)
+    head = email ? head->next_email : head->next_hash;
+
+  if (email)
+    head->next_email = entry;
+  else
+    head->next_hash = entry;
+}
+
+/**
+ * smime_index_get - Get the parsed .index file of the keys or certificates
+ * @param public If true, get the public certificates
+ * @retval ptr  Up to date index
+ * @retval NULL Error
+ */
+static struct SmimeIndex *smime_index_get(bool public)
 {
+  struct SmimeIndex *idx = &SmimeIndexes[public ? 1 : 0];
   char index_file[PATH_MAX];
   char buf[LONG_STRING];
-  struct SmimeKey *key = NULL, *results = NULL;
-  struct SmimeKey **results_end = &results;
+  struct stat st;
 
   snprintf(index_file, sizeof(index_file), "%s/.index",
            public ? NONULL(SmimeCertificates) : NONULL(SmimeKeys));
 
   FILE *fp = mutt_file_fopen(index_file, "r");
-  if (!fp)
+  if (!fp || (fstat(fileno(fp), &st) != 0))
   {
     mutt_perror(index_file);
+    mutt_file_fclose(&fp);
+    smime_index_free(idx);
     return NULL;
   }
 
+  if ((mutt_str_strcmp(idx->path, index_file) == 0) && (idx->ino == st.st_ino) &&
+      (idx->mtime == st.st_mtime) && (idx->size == st.st_size))
+  {
+    mutt_file_fclose(&fp);
+    return idx;
+  }
+
+  smime_index_free(idx);
+
+  size_t alloc = 0;
   while (fgets(buf, sizeof(buf), fp))
   {
-    if ((!*search) || mutt_str_stristr(buf, search))
+    if (idx->num_entries == alloc)
     {
-      key = smime_parse_key(buf);
-      if (key)
-      {
-        *results_end = key;
-        results_end = &key->next;
-      }
+      alloc += 64;
+      mutt_mem_realloc(&idx->entries, alloc * sizeof(struct SmimeIndexEntry));
     }
+
+    struct SmimeIndexEntry *entry = &idx->entries[idx->num_entries++];
+    memset(entry, 0, sizeof(*entry));
+    entry->line = mutt_str_strdup(buf);
+    entry->key = smime_parse_key(buf);
   }
 
   mutt_file_fclose(&fp);
 
+  /* The entries don't move any more, so they can be indexed */
+  idx->by_email = mutt_hash_create(MAX(idx->num_entries, 16), MUTT_HASH_STRCASECMP);
+  idx->by_hash = mutt_hash_create(MAX(idx->num_entries, 16), MUTT_HASH_STRCASECMP);
+  for (size_t i = 0; i < idx->num_entries; i++)
+  {
+    struct SmimeIndexEntry *entry = &idx->entries[i];
+    if (!entry->key)
+      continue;
+    smime_index_add(idx->by_email, entry->key->email, entry, true);
+    smime_index_add(idx->by_hash, entry->key->hash, entry, false);
+  }
+
+  mutt_str_strfcpy(idx->path, index_file, sizeof(idx->path));
+  idx->ino = st.st_ino;
+  idx->mtime = st.st_mtime;
+  idx->size = st.st_size;
+
+  mutt_debug(3, "read %zu entries from %s\n", idx->num_entries, index_file);
+  return idx;
+}
+
+/**
+ * smime_get_candidates - Find keys matching a string
+ * @param search String to match
+ * @param public If true, only get the public keys
+ * @retval ptr Matching key
+ */
+static struct SmimeKey *smime_get_candidates(char *search, bool public)
+{
+  struct SmimeKey *key = NULL, *results = NULL;
+  struct SmimeKey **results_end = &results;
+
+  struct SmimeIndex *idx = smime_index_get(public);
+  if (!idx)
+    return NULL;
+
+  for (size_t i = 0; i < idx->num_entries; i++)
+  {
+    struct SmimeIndexEntry *entry = &idx->entries[i];
+    if (!entry->key)
+      continue;
+
+    if ((!*search) || mutt_str_stristr(entry->line, search))
+    {
+      key = smime_copy_key(entry->key);
+      *results_end = key;
+      results_end = &key->next;
+    }
+  }
+
   return results;
 }
 
@@ -759,20 +901,15 @@ static struct SmimeKey *smime_get_candidates(char *search, bool public)
  */
 static struct SmimeKey *smime_get_key_by_hash(char *hash, bool public)
 {
-  struct SmimeKey *match = NULL;
-  struct SmimeKey *results = smime_get_candidates(hash, public);
-  for (struct SmimeKey *result = results; result; result = result->next)
-  {
-    if (mutt_str_strcasecmp(hash, result->hash) == 0)
-    {
-      match = smime_copy_key(result);
-      break;
-    }
-  }
+  struct SmimeIndex *idx = smime_index_get(public);
+  if (!idx || !hash)
+    return NULL;
 
-  smime_free_key(&results);
+  struct SmimeIndexEntry *entry = mutt_hash_find(idx->by_hash, hash);
+  if (!entry)
+    return NULL;
 
-  return match;
+  return smime_copy_key(entry->key);
 }
 
 /**
@@ -786,7 +923,6 @@ static struct SmimeKey *smime_get_key_by_hash(char *hash, bool public)
 static struct SmimeKey *smime_get_key_by_addr(char *mailbox, short abilities,
                                               bool public, bool may_ask)
 {
-  struct SmimeKey *results = NULL, *result = NULL;
   struct SmimeKey *matches = NULL;
   struct SmimeKey **matches_end = &matches;
   struct SmimeKey *match = NULL;
@@ -798,37 +934,36 @@ static struct SmimeKey *smime_get_key_by_addr(char *mailbox, short abilities,
   if (!mailbox)
     return NULL;
 
-  results = smime_get_candidates(mailbox, public);
-  for (result = results; result; result = result->next)
+  struct SmimeIndex *idx = smime_index_get(public);
+  if (!idx)
+    return NULL;
+
+  struct SmimeIndexEntry *entry = mutt_hash_find(idx->by_email, mailbox);
+  for (; entry; entry = entry->next_email)
   {
-    if (abilities && !(result->flags & abilities))
+    if (abilities && !(entry->key->flags & abilities))
     {
       continue;
     }
 
-    if (mutt_str_strcasecmp(mailbox, result->email) == 0)
-    {
-      match = smime_copy_key(result);
-      *matches_end = match;
-      matches_end = &match->next;
+    match = smime_copy_key(entry->key);
+    *matches_end = match;
+    matches_end = &match->next;
 
-      if (match->trust == 't')
-      {
-        if (trusted_match && (mutt_str_strcasecmp(match->hash, trusted_match->hash) != 0))
-        {
-          multi_trusted_matches = 1;
-        }
-        trusted_match = match;
-      }
-      else if ((match->trust == 'u') || (match->trust == 'v'))
+    if (match->trust == 't')
+    {
+      if (trusted_match && (mutt_str_strcasecmp(match->hash, trusted_match->hash) != 0))
       {
-        valid_match = match;
+        multi_trusted_matches = 1;
       }
+      trusted_match = match;
+    }
+    else if ((match->trust == 'u') || (match->trust == 'v'))
+    {
+      valid_match = match;
     }
   }
 
-  smime_free_key(&results);
-
   if (matches)
   {
     if (!may_ask)
@@ -33,7 +33,9 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
@@ -67,6 +69,36 @@ char *Newsrc; ///< Config: (nntp) File containing list of subscribed newsgroups
 
 struct BodyCache;
 
+#define ACTIVE_CACHE_MAGIC 0x4e414331 /* "NAC1" */
+
+/**
+ * struct ActiveCacheHeader - Header of the active list cache
+ *
+ * The cache is only read by the machine that wrote it, so the numbers are
+ * stored in their native form.  A byte-swapped magic fails the check.
+ */
+struct ActiveCacheHeader
+{
+  uint32_t magic;          ///< ACTIVE_CACHE_MAGIC
+  uint32_t count;          ///< Number of records that follow
+  uint64_t newgroups_time; ///< Time of the last NEWGROUPS check
+};
+
+/**
+ * struct ActiveCacheRecord - A newsgroup in the active list cache
+ *
+ * It's followed by the group name and description, without terminators.
+ */
+struct ActiveCacheRecord
+{
+  uint32_t first;    ///< First article number
+  uint32_t last;     ///< Last article number
+  uint16_t name_len; ///< Length of the group name
+  uint16_t desc_len; ///< Length of the description
+  uint8_t allowed;   ///< Posting allowed
+  uint8_t pad[3];
+};
+
 /**
  * mdata_find - Find NntpMboxData for given newsgroup or add it
  * @param adata NNTP server
@@ -129,6 +161,7 @@ void nntp_data_free(void *data)
   nntp_acache_free(mdata);
   mutt_bcache_close(&mdata->bcache);
   FREE(&mdata->newsrc_ent);
+  FREE(&mdata->newsrc_line);
   FREE(&mdata->desc);
   FREE(&data);
 }
@@ -179,6 +212,76 @@ void nntp_group_unread_stat(struct NntpMboxData *mdata)
   }
 }
 
+/**
+ * newsrc_entry_cmp - Compare two .newsrc entries - Implements ::sort_t
+ */
+static int newsrc_entry_cmp(const void *a, const void *b)
+{
+  const struct NewsrcEntry *ea = a;
+  const struct NewsrcEntry *eb = b;
+
+  if (ea->first != eb->first)
+    return (ea->first < eb->first) ? -1 : 1;
+  if (ea->last != eb->last)
+    return (ea->last < eb->last) ? -1 : 1;
+  return 0;
+}
+
+/**
+ * newsrc_normalise - Sort and merge the .newsrc entries of a newsgroup
+ * @param mdata NNTP Mailbox data
+ *
+ * nntp_article_status() searches the entries, so they must be in order and
+ * mustn't overlap.  NeoMutt writes them that way, but another newsreader
+ * might not.  Empty ranges are dropped, unless there's nothing else.
+ */
+static void newsrc_normalise(struct NntpMboxData *mdata)
+{
+  struct NewsrcEntry *ent = mdata->newsrc_ent;
+  unsigned int len = mdata->newsrc_len;
+
+  bool ordered = true;
+  for (unsigned int i = 0; i < len; i++)
+  {
+    if ((ent[i].first > ent[i].last) ||
+        ((i > 0) && (ent[i].first <= ent[i - 1].last + 1)))
+    {
+      /* an empty entry, alone at the start, is what nntp_newsrc_gen_entries()
+       * writes when the first article is unread */
+      if ((i == 0) && (ent[0].first > ent[0].last) && ((len == 1) || (ent[1].first > ent[0].first)))
+        continue;
+      ordered = false;
+      break;
+    }
+  }
+  if (ordered)
+    return;
+
+  qsort(ent, len, sizeof(struct NewsrcEntry), newsrc_entry_cmp);
+
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < len; i++)
+  {
+    if (ent[i].first > ent[i].last)
+      continue;
+    if ((j > 0) && (ent[i].first <= ent[j - 1].last + 1))
+    {
+      if (ent[i].last > ent[j - 1].last)
+        ent[j - 1].last = ent[i].last;
+      continue;
+    }
+    ent[j++] = ent[i];
+  }
+
+  if (j == 0)
+  {
+    ent[0].first = 1;
+    ent[0].last = 0;
+    j = 1;
+  }
+  mdata->newsrc_len = j;
+}
+
 /**
  * nntp_newsrc_parse - Parse .newsrc file
  * @param adata NNTP server
@@ -243,8 +346,10 @@ int nntp_newsrc_parse(struct NntpAccountData *adata)
       continue;
 
     mdata->subscribed = false;
+    mdata->newsrc_dirty = false;
     mdata->newsrc_len = 0;
     FREE(&mdata->newsrc_ent);
+    FREE(&mdata->newsrc_line);
   }
 
   line = mutt_mem_malloc(sb.st_size + 1);
@@ -259,6 +364,10 @@ int nntp_newsrc_parse(struct NntpAccountData *adata)
     if (!p)
       continue;
 
+    /* keep the line as it is, until the group changes */
+    char *orig = mutt_str_strdup(line);
+    mutt_str_remove_trailing_ws(orig);
+
     /* ":" - subscribed, "!" - unsubscribed */
     if (*p == ':')
       subs = true;
@@ -267,6 +376,9 @@ int nntp_newsrc_parse(struct NntpAccountData *adata)
     /* get newsgroup data */
     struct NntpMboxData *mdata = mdata_find(adata, line);
     FREE(&mdata->newsrc_ent);
+    FREE(&mdata->newsrc_line);
+    mdata->newsrc_line = orig;
+    mdata->newsrc_dirty = false;
 
     /* count number of entries */
     b = p;
@@ -306,9 +418,11 @@ int nntp_newsrc_parse(struct NntpAccountData *adata)
       mdata->newsrc_ent[j].last = 0;
       j++;
     }
+    mdata->newsrc_len = j;
+    newsrc_normalise(mdata);
+    j = mdata->newsrc_len;
     if (mdata->last_message == 0)
       mdata->last_message = mdata->newsrc_ent[j - 1].last;
-    mdata->newsrc_len = j;
     mutt_mem_realloc(&mdata->newsrc_ent, j * sizeof(struct NewsrcEntry));
     nntp_group_unread_stat(mdata);
     mutt_debug(2, "%s\n", mdata->group);
@@ -323,19 +437,37 @@ int nntp_newsrc_parse(struct NntpAccountData *adata)
  */
 void nntp_newsrc_gen_entries(struct Context *ctx)
 {
-  struct NntpMboxData *mdata = ctx->mailbox->data;
+  struct Mailbox *mailbox = ctx->mailbox;
+  struct NntpMboxData *mdata = mailbox->data;
   anum_t last = 0, first = 1;
   bool series;
-  int save_sort = SORT_ORDER;
   unsigned int entries;
 
-  if (Sort != SORT_ORDER)
+  /* Walk the emails in the order they were loaded, without re-sorting the
+   * mailbox (and its threads) there and back */
+  struct Email **order = mutt_mem_calloc(MAX(mailbox->msg_count, 1), sizeof(struct Email *));
+  for (int i = 0; i < mailbox->msg_count; i++)
+  {
+    struct Email *e = mailbox->hdrs[i];
+    if ((e->index < 0) || (e->index >= mailbox->msg_count) || order[e->index])
+    {
+      mutt_debug(1, "bad index %d, sorting the mailbox\n", e->index);
+      FREE(&order);
+      break;
+    }
+    order[e->index] = e;
+  }
+
+  int save_sort = SORT_ORDER;
+  if (!order && (Sort != SORT_ORDER))
   {
     save_sort = Sort;
     Sort = SORT_ORDER;
     mutt_sort_headers(ctx, false);
   }
+  struct Email **hdrs = order ? order : mailbox->hdrs;
 
+  mdata->newsrc_dirty = true;
   entries = mdata->newsrc_len;
   if (!entries)
   {
@@ -347,16 +479,15 @@ void nntp_newsrc_gen_entries(struct Context *ctx)
    * first article in our list */
   mdata->newsrc_len = 0;
   series = true;
-  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  for (int i = 0; i < mailbox->msg_count; i++)
   {
     /* search for first unread */
     if (series)
     {
       /* We don't actually check sequential order, since we mark
        * "missing" entries as read/deleted */
-      last = NNTP_EDATA(ctx->mailbox->hdrs[i])->article_num;
-      if (last >= mdata->first_message && !ctx->mailbox->hdrs[i]->deleted &&
-          !ctx->mailbox->hdrs[i]->read)
+      last = NNTP_EDATA(hdrs[i])->article_num;
+      if (last >= mdata->first_message && !hdrs[i]->deleted && !hdrs[i]->read)
       {
         if (mdata->newsrc_len >= entries)
         {
@@ -373,12 +504,12 @@ void nntp_newsrc_gen_entries(struct Context *ctx)
     /* search for first read */
     else
     {
-      if (ctx->mailbox->hdrs[i]->deleted || ctx->mailbox->hdrs[i]->read)
+      if (hdrs[i]->deleted || hdrs[i]->read)
       {
         first = last + 1;
         series = true;
       }
-      last = NNTP_EDATA(ctx->mailbox->hdrs[i])->article_num;
+      last = NNTP_EDATA(hdrs[i])->article_num;
     }
   }
 
@@ -393,7 +524,9 @@ void nntp_newsrc_gen_entries(struct Context *ctx)
     mdata->newsrc_ent[mdata->newsrc_len].last = mdata->last_loaded;
     mdata->newsrc_len++;
   }
+  newsrc_normalise(mdata);
   mutt_mem_realloc(&mdata->newsrc_ent, mdata->newsrc_len * sizeof(struct NewsrcEntry));
+  FREE(&order);
 
   if (save_sort != Sort)
   {
@@ -406,10 +539,11 @@ void nntp_newsrc_gen_entries(struct Context *ctx)
  * update_file - Update file with new contents
  * @param filename File to update
  * @param buf      New context
+ * @param buflen   Length of new context
  * @retval  0 Success
  * @retval -1 Failure
  */
-static int update_file(char *filename, char *buf)
+static int update_file(char *filename, const char *buf, size_t buflen)
 {
   FILE *fp = NULL;
   char tmpfile[PATH_MAX];
@@ -425,7 +559,7 @@ static int update_file(char *filename, char *buf)
       *tmpfile = '\0';
       break;
     }
-    if (fputs(buf, fp) == EOF)
+    if (fwrite(buf, 1, buflen, fp) != buflen)
     {
       mutt_perror(tmpfile);
       break;
@@ -453,68 +587,113 @@ static int update_file(char *filename, char *buf)
   return rc;
 }
 
+/**
+ * newsrc_gen_line - Generate the .newsrc line of a newsgroup
+ * @param mdata NNTP Mailbox data
+ *
+ * The line, without a newline, is kept in NntpMboxData::newsrc_line, so that
+ * only the groups which have changed need to be regenerated.
+ */
+static void newsrc_gen_line(struct NntpMboxData *mdata)
+{
+  size_t buflen = strlen(mdata->group) + LONG_STRING;
+  char *buf = mutt_mem_malloc(buflen);
+
+  /* write newsgroup name */
+  snprintf(buf, buflen, "%s%c ", mdata->group, mdata->subscribed ? ':' : '!');
+  size_t off = strlen(buf);
+
+  /* write entries */
+  for (unsigned int j = 0; j < mdata->newsrc_len; j++)
+  {
+    if (off + LONG_STRING > buflen)
+    {
+      buflen *= 2;
+      mutt_mem_realloc(&buf, buflen);
+    }
+    if (j)
+      buf[off++] = ',';
+    if (mdata->newsrc_ent[j].first == mdata->newsrc_ent[j].last)
+      snprintf(buf + off, buflen - off, "%u", mdata->newsrc_ent[j].first);
+    else if (mdata->newsrc_ent[j].first < mdata->newsrc_ent[j].last)
+    {
+      snprintf(buf + off, buflen - off, "%u-%u", mdata->newsrc_ent[j].first,
+               mdata->newsrc_ent[j].last);
+    }
+    off += strlen(buf + off);
+  }
+  buf[off] = '\0';
+
+  FREE(&mdata->newsrc_line);
+  mdata->newsrc_line = buf;
+}
+
 /**
  * nntp_newsrc_update - Update .newsrc file
  * @param adata NNTP server
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * Only the lines of the newsgroups which have changed since the file was
+ * read, or last written, are regenerated.  If nothing has changed, the file
+ * isn't rewritten at all.
  */
 int nntp_newsrc_update(struct NntpAccountData *adata)
 {
   char *buf = NULL;
-  size_t buflen, off;
+  size_t buflen = 0, off = 0;
+  unsigned int changed = 0;
   int rc = -1;
 
   if (!adata)
     return -1;
 
-  buflen = 10 * LONG_STRING;
-  buf = mutt_mem_calloc(1, buflen);
-  off = 0;
-
-  /* we will generate full newsrc here */
   for (unsigned int i = 0; i < adata->groups_num; i++)
   {
     struct NntpMboxData *mdata = adata->groups_list[i];
 
-    if (!mdata || !mdata->newsrc_ent)
+    if (!mdata || !mdata->newsrc_dirty)
       continue;
 
-    /* write newsgroup name */
-    if (off + strlen(mdata->group) + 3 > buflen)
-    {
-      buflen *= 2;
-      mutt_mem_realloc(&buf, buflen);
-    }
-    snprintf(buf + off, buflen - off, "%s%c ", mdata->group, mdata->subscribed ? ':' : '!');
-    off += strlen(buf + off);
+    changed++;
+    if (mdata->newsrc_ent)
+      newsrc_gen_line(mdata);
+    else
+      FREE(&mdata->newsrc_line);
+  }
 
-    /* write entries */
-    for (unsigned int j = 0; j < mdata->newsrc_len; j++)
-    {
-      if (off + LONG_STRING > buflen)
-      {
-        buflen *= 2;
-        mutt_mem_realloc(&buf, buflen);
-      }
-      if (j)
-        buf[off++] = ',';
-      if (mdata->newsrc_ent[j].first == mdata->newsrc_ent[j].last)
-        snprintf(buf + off, buflen - off, "%u", mdata->newsrc_ent[j].first);
-      else if (mdata->newsrc_ent[j].first < mdata->newsrc_ent[j].last)
-      {
-        snprintf(buf + off, buflen - off, "%u-%u", mdata->newsrc_ent[j].first,
-                 mdata->newsrc_ent[j].last);
-      }
-      off += strlen(buf + off);
-    }
+  if (changed == 0)
+  {
+    mutt_debug(2, "%s is unchanged\n", adata->newsrc_file);
+    return 0;
+  }
+
+  /* size up the new file, then join up the lines */
+  for (unsigned int i = 0; i < adata->groups_num; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+
+    if (mdata && mdata->newsrc_ent && mdata->newsrc_line)
+      buflen += strlen(mdata->newsrc_line) + 1;
+  }
+  buf = mutt_mem_malloc(buflen + 1);
+  for (unsigned int i = 0; i < adata->groups_num; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+
+    if (!mdata || !mdata->newsrc_ent || !mdata->newsrc_line)
+      continue;
+
+    const size_t len = strlen(mdata->newsrc_line);
+    memcpy(buf + off, mdata->newsrc_line, len);
+    off += len;
     buf[off++] = '\n';
   }
   buf[off] = '\0';
 
   /* newrc being fully rewritten */
-  mutt_debug(1, "Updating %s\n", adata->newsrc_file);
-  if (adata->newsrc_file && update_file(adata->newsrc_file, buf) == 0)
+  mutt_debug(1, "Updating %s, %u groups changed\n", adata->newsrc_file, changed);
+  if (adata->newsrc_file && update_file(adata->newsrc_file, buf, off) == 0)
   {
     struct stat sb;
 
@@ -528,6 +707,14 @@ int nntp_newsrc_update(struct NntpAccountData *adata)
     {
       mutt_perror(adata->newsrc_file);
     }
+
+    /* the changes are safely in the file */
+    for (unsigned int i = 0; i < adata->groups_num; i++)
+    {
+      struct NntpMboxData *mdata = adata->groups_list[i];
+      if (mdata)
+        mdata->newsrc_dirty = false;
+    }
   }
   FREE(&buf);
   return rc;
@@ -583,6 +770,32 @@ void nntp_expand_path(char *buf, size_t buflen, struct ConnAccount *acct)
   FREE(&url.path);
 }
 
+/**
+ * active_add - Add a newsgroup from the active list
+ * @param adata   NNTP server
+ * @param group   Newsgroup
+ * @param first   First article number
+ * @param last    Last article number
+ * @param allowed Posting allowed?
+ * @param desc    Description, may be NULL
+ */
+static void active_add(struct NntpAccountData *adata, const char *group,
+                       anum_t first, anum_t last, bool allowed, const char *desc)
+{
+  struct NntpMboxData *mdata = mdata_find(adata, group);
+  mdata->deleted = false;
+  mdata->first_message = first;
+  mdata->last_message = last;
+  mdata->allowed = allowed;
+  mutt_str_replace(&mdata->desc, desc);
+  if (mdata->newsrc_ent || mdata->last_cached)
+    nntp_group_unread_stat(mdata);
+  else if (mdata->last_message && mdata->first_message <= mdata->last_message)
+    mdata->unread = mdata->last_message - mdata->first_message + 1;
+  else
+    mdata->unread = 0;
+}
+
 /**
  * nntp_add_group - Parse newsgroup
  * @param line String to parse
@@ -592,7 +805,6 @@ void nntp_expand_path(char *buf, size_t buflen, struct ConnAccount *acct)
 int nntp_add_group(char *line, void *data)
 {
   struct NntpAccountData *adata = data;
-  struct NntpMboxData *mdata = NULL;
   char group[LONG_STRING] = "";
   char desc[HUGE_STRING] = "";
   char mod;
@@ -609,18 +821,44 @@ int nntp_add_group(char *line, void *data)
     return 0;
   }
 
-  mdata = mdata_find(adata, group);
-  mdata->deleted = false;
-  mdata->first_message = first;
-  mdata->last_message = last;
-  mdata->allowed = (mod == 'y') || (mod == 'm');
-  mutt_str_replace(&mdata->desc, desc);
-  if (mdata->newsrc_ent || mdata->last_cached)
-    nntp_group_unread_stat(mdata);
-  else if (mdata->last_message && mdata->first_message <= mdata->last_message)
-    mdata->unread = mdata->last_message - mdata->first_message + 1;
-  else
-    mdata->unread = 0;
+  active_add(adata, group, first, last, (mod == 'y') || (mod == 'm'), desc);
+  return 0;
+}
+
+/**
+ * groups_reserve - Make room in the list of newsgroups
+ * @param adata NNTP server
+ * @param num   Number of newsgroups expected
+ */
+static void groups_reserve(struct NntpAccountData *adata, unsigned int num)
+{
+  if (num > adata->groups_max)
+  {
+    adata->groups_max = num;
+    mutt_mem_realloc(&adata->groups_list, adata->groups_max * sizeof(void *));
+  }
+}
+
+/**
+ * active_get_text_cache - Load list of all newsgroups from an old text cache
+ * @param adata NNTP server
+ * @param fp    Cache file
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int active_get_text_cache(struct NntpAccountData *adata, FILE *fp)
+{
+  char buf[HUGE_STRING];
+  char tmp[LONG_STRING];
+  time_t t;
+
+  rewind(fp);
+  if (!fgets(buf, sizeof(buf), fp) || (sscanf(buf, "%ld%s", &t, tmp) != 1) || (t == 0))
+    return -1;
+  adata->newgroups_time = t;
+
+  while (fgets(buf, sizeof(buf), fp))
+    nntp_add_group(buf, adata);
   return 0;
 }
 
@@ -629,12 +867,17 @@ int nntp_add_group(char *line, void *data)
  * @param adata NNTP server
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The whole cache is read in one go and checked before any of the groups
+ * are added.
  */
 static int active_get_cache(struct NntpAccountData *adata)
 {
-  char buf[HUGE_STRING];
   char file[PATH_MAX];
-  time_t t;
+  struct ActiveCacheHeader hdr;
+  struct stat sb;
+  char *buf = NULL;
+  int rc = -1;
 
   cache_expand(file, sizeof(file), &adata->conn->account, ".active");
   mutt_debug(1, "Parsing %s\n", file);
@@ -642,20 +885,90 @@ static int active_get_cache(struct NntpAccountData *adata)
   if (!fp)
     return -1;
 
-  if (!fgets(buf, sizeof(buf), fp) || (sscanf(buf, "%ld%s", &t, file) != 1) || (t == 0))
+  mutt_message(_("Loading list of groups from cache..."));
+  if ((fread(&hdr, sizeof(hdr), 1, fp) != 1) || (hdr.magic != ACTIVE_CACHE_MAGIC))
   {
-    mutt_file_fclose(&fp);
-    return -1;
+    rc = active_get_text_cache(adata, fp);
+    goto done;
   }
-  adata->newgroups_time = t;
+  if ((hdr.newgroups_time == 0) || (fstat(fileno(fp), &sb) < 0))
+    goto done;
 
-  mutt_message(_("Loading list of groups from cache..."));
-  while (fgets(buf, sizeof(buf), fp))
-    nntp_add_group(buf, adata);
-  nntp_add_group(NULL, NULL);
+  const size_t len = sb.st_size - sizeof(hdr);
+  buf = mutt_mem_malloc(len + 1);
+  if (fread(buf, 1, len, fp) != len)
+    goto done;
+
+  /* check the records, before trusting any of them */
+  size_t off = 0;
+  for (unsigned int i = 0; i < hdr.count; i++)
+  {
+    struct ActiveCacheRecord rec;
+    if (off + sizeof(rec) > len)
+      goto done;
+    memcpy(&rec, buf + off, sizeof(rec));
+    off += sizeof(rec) + rec.name_len + rec.desc_len;
+    if ((rec.name_len == 0) || (off > len))
+      goto done;
+  }
+  if (off != len)
+    goto done;
+
+  groups_reserve(adata, adata->groups_num + hdr.count);
+  adata->newgroups_time = hdr.newgroups_time;
+
+  char group[LONG_STRING];
+  char desc[HUGE_STRING];
+  off = 0;
+  for (unsigned int i = 0; i < hdr.count; i++)
+  {
+    struct ActiveCacheRecord rec;
+    memcpy(&rec, buf + off, sizeof(rec));
+    off += sizeof(rec);
+    mutt_str_strfcpy(group, buf + off, MIN(sizeof(group), rec.name_len + 1U));
+    off += rec.name_len;
+    mutt_str_strfcpy(desc, buf + off, MIN(sizeof(desc), rec.desc_len + 1U));
+    off += rec.desc_len;
+    active_add(adata, group, rec.first, rec.last, rec.allowed, desc);
+  }
+  rc = 0;
+
+done:
+  FREE(&buf);
   mutt_file_fclose(&fp);
   mutt_clear_error();
-  return 0;
+  return rc;
+}
+
+/**
+ * active_gen_record - Add a newsgroup to the active list cache
+ * @param mdata  NNTP Mailbox data
+ * @param buf    Buffer for the cache
+ * @param buflen Length of the buffer
+ * @param off    Length of the cache so far
+ */
+static void active_gen_record(struct NntpMboxData *mdata, char **buf,
+                              size_t *buflen, size_t *off)
+{
+  struct ActiveCacheRecord rec = { 0 };
+
+  rec.first = mdata->first_message;
+  rec.last = mdata->last_message;
+  rec.allowed = mdata->allowed;
+  rec.name_len = MIN(strlen(mdata->group), LONG_STRING - 1);
+  rec.desc_len = mdata->desc ? MIN(strlen(mdata->desc), HUGE_STRING - 1) : 0;
+
+  const size_t len = sizeof(rec) + rec.name_len + rec.desc_len;
+  if (*off + len > *buflen)
+  {
+    *buflen = MAX(*buflen * 2, *off + len);
+    mutt_mem_realloc(buf, *buflen);
+  }
+  memcpy(*buf + *off, &rec, sizeof(rec));
+  memcpy(*buf + *off + sizeof(rec), mdata->group, rec.name_len);
+  if (rec.desc_len)
+    memcpy(*buf + *off + sizeof(rec) + rec.name_len, mdata->desc, rec.desc_len);
+  *off += len;
 }
 
 /**
@@ -667,6 +980,7 @@ static int active_get_cache(struct NntpAccountData *adata)
 int nntp_active_save_cache(struct NntpAccountData *adata)
 {
   char file[PATH_MAX];
+  struct ActiveCacheHeader hdr = { 0 };
   char *buf = NULL;
   size_t buflen, off;
   int rc;
@@ -675,9 +989,8 @@ int nntp_active_save_cache(struct NntpAccountData *adata)
     return 0;
 
   buflen = 10 * LONG_STRING;
-  buf = mutt_mem_calloc(1, buflen);
-  snprintf(buf, buflen, "%lu\n", (unsigned long) adata->newgroups_time);
-  off = strlen(buf);
+  buf = mutt_mem_malloc(buflen);
+  off = sizeof(hdr);
 
   for (unsigned int i = 0; i < adata->groups_num; i++)
   {
@@ -686,20 +999,88 @@ int nntp_active_save_cache(struct NntpAccountData *adata)
     if (!mdata || mdata->deleted)
       continue;
 
-    if (off + strlen(mdata->group) + (mdata->desc ? strlen(mdata->desc) : 0) + 50 > buflen)
-    {
-      buflen *= 2;
-      mutt_mem_realloc(&buf, buflen);
-    }
-    snprintf(buf + off, buflen - off, "%s %u %u %c%s%s\n", mdata->group,
-             mdata->last_message, mdata->first_message, mdata->allowed ? 'y' : 'n',
-             mdata->desc ? " " : "", mdata->desc ? mdata->desc : "");
-    off += strlen(buf + off);
+    active_gen_record(mdata, &buf, &buflen, &off);
+    hdr.count++;
   }
 
+  hdr.magic = ACTIVE_CACHE_MAGIC;
+  hdr.newgroups_time = adata->newgroups_time;
+  memcpy(buf, &hdr, sizeof(hdr));
+
   cache_expand(file, sizeof(file), &adata->conn->account, ".active");
   mutt_debug(1, "Updating %s\n", file);
-  rc = update_file(file, buf);
+  rc = update_file(file, buf, off);
+  FREE(&buf);
+  return rc;
+}
+
+/**
+ * nntp_active_append_cache - Add new newsgroups to the cache
+ * @param adata NNTP server
+ * @param first Index of the first new group in NntpAccountData::groups_list
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * If the cache holds exactly the groups before the new ones, the new groups
+ * are appended to it.  Otherwise, the whole cache is rewritten.
+ */
+int nntp_active_append_cache(struct NntpAccountData *adata, unsigned int first)
+{
+  char file[PATH_MAX];
+  struct ActiveCacheHeader hdr;
+  char *buf = NULL;
+  size_t buflen = LONG_STRING, off = 0;
+  unsigned int count = 0;
+
+  if (!adata->cacheable)
+    return 0;
+
+  for (unsigned int i = 0; i < first; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+    if (mdata && !mdata->deleted)
+      count++;
+  }
+
+  cache_expand(file, sizeof(file), &adata->conn->account, ".active");
+  FILE *fp = mutt_file_fopen(file, "r+");
+  if (!fp)
+    return nntp_active_save_cache(adata);
+
+  if ((fread(&hdr, sizeof(hdr), 1, fp) != 1) ||
+      (hdr.magic != ACTIVE_CACHE_MAGIC) || (hdr.count != count))
+  {
+    mutt_file_fclose(&fp);
+    return nntp_active_save_cache(adata);
+  }
+
+  buf = mutt_mem_malloc(buflen);
+  for (unsigned int i = first; i < adata->groups_num; i++)
+  {
+    struct NntpMboxData *mdata = adata->groups_list[i];
+
+    if (!mdata || mdata->deleted)
+      continue;
+
+    active_gen_record(mdata, &buf, &buflen, &off);
+    hdr.count++;
+  }
+  hdr.newgroups_time = adata->newgroups_time;
+
+  /* a crash between the two writes leaves a cache that fails its checks */
+  mutt_debug(1, "Appending %u groups to %s\n", hdr.count - count, file);
+  int rc = -1;
+  if ((fseek(fp, 0, SEEK_END) == 0) && (fwrite(buf, 1, off, fp) == off) &&
+      (fflush(fp) == 0) && (fseek(fp, 0, SEEK_SET) == 0) &&
+      (fwrite(&hdr, sizeof(hdr), 1, fp) == 1))
+  {
+    rc = 0;
+  }
+  if ((mutt_file_fclose(&fp) != 0) || (rc < 0))
+  {
+    mutt_perror(file);
+    rc = -1;
+  }
   FREE(&buf);
   return rc;
 }
@@ -835,12 +1216,40 @@ void nntp_delete_group_cache(struct NntpMboxData *mdata)
     return;
 
 #ifdef USE_HCACHE
-  char file[PATH_MAX];
-  nntp_hcache_namer(mdata->group, file, sizeof(file));
-  cache_expand(file, sizeof(file), &mdata->adata->conn->account, file);
-  unlink(file);
+  if (HeaderCachePerAccount)
+  {
+    /* The database is shared with other groups, so only remove our records */
+    header_cache_t *hc = nntp_hcache_open(mdata);
+    if (hc)
+    {
+      char buf[16];
+      anum_t first = 0, last = 0;
+      void *hdata = mutt_hcache_fetch_raw(hc, "index", 5);
+      if (hdata)
+      {
+        if (sscanf(hdata, ANUM " " ANUM, &first, &last) == 2)
+        {
+          for (anum_t current = first; current <= last; current++)
+          {
+            snprintf(buf, sizeof(buf), "%u", current);
+            mutt_hcache_delete(hc, buf, strlen(buf));
+          }
+        }
+        mutt_hcache_free(hc, &hdata);
+      }
+      mutt_hcache_delete(hc, "index", 5);
+      mutt_hcache_close(hc);
+    }
+  }
+  else
+  {
+    char file[PATH_MAX];
+    nntp_hcache_namer(mdata->group, file, sizeof(file));
+    cache_expand(file, sizeof(file), &mdata->adata->conn->account, file);
+    unlink(file);
+    mutt_debug(2, "%s\n", file);
+  }
   mdata->last_cached = 0;
-  mutt_debug(2, "%s\n", file);
 #endif
 
   if (!mdata->bcache)
@@ -1221,15 +1630,24 @@ void nntp_article_status(struct Mailbox *mailbox, struct Email *e, char *group,
   if (!mdata)
     return;
 
-  for (unsigned int i = 0; i < mdata->newsrc_len; i++)
+  /* the entries are in order and don't overlap, see newsrc_normalise().
+   * Find the last one that starts at or before anum. */
+  unsigned int lo = 0;
+  unsigned int hi = mdata->newsrc_len;
+  while (lo < hi)
   {
-    if ((anum >= mdata->newsrc_ent[i].first) && (anum <= mdata->newsrc_ent[i].last))
-    {
-      /* can't use mutt_set_flag() because mx_update_context()
-         didn't get called yet */
-      e->read = true;
-      return;
-    }
+    const unsigned int mid = lo + (hi - lo) / 2;
+    if (mdata->newsrc_ent[mid].first <= anum)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ((lo > 0) && (anum <= mdata->newsrc_ent[lo - 1].last))
+  {
+    /* can't use mutt_set_flag() because mx_update_context()
+       didn't get called yet */
+    e->read = true;
+    return;
   }
 
   /* article was not cached yet, it's new */
@@ -1257,6 +1675,7 @@ struct NntpMboxData *mutt_newsgroup_subscribe(struct NntpAccountData *adata, cha
 
   mdata = mdata_find(adata, group);
   mdata->subscribed = true;
+  mdata->newsrc_dirty = true;
   if (!mdata->newsrc_ent)
   {
     mdata->newsrc_ent = mutt_mem_calloc(1, sizeof(struct NewsrcEntry));
@@ -1286,6 +1705,7 @@ struct NntpMboxData *mutt_newsgroup_unsubscribe(struct NntpAccountData *adata, c
     return NULL;
 
   mdata->subscribed = false;
+  mdata->newsrc_dirty = true;
   if (!SaveUnsubscribed)
   {
     mdata->newsrc_len = 0;
@@ -1320,6 +1740,7 @@ struct NntpMboxData *mutt_newsgroup_catchup(struct Context *ctx,
     mdata->newsrc_len = 1;
     mdata->newsrc_ent[0].first = 1;
     mdata->newsrc_ent[0].last = mdata->last_message;
+    mdata->newsrc_dirty = true;
   }
   mdata->unread = 0;
   if (ctx && ctx->mailbox->data == mdata)
@@ -1356,6 +1777,7 @@ struct NntpMboxData *mutt_newsgroup_uncatchup(struct Context *ctx,
     mdata->newsrc_len = 1;
     mdata->newsrc_ent[0].first = 1;
     mdata->newsrc_ent[0].last = mdata->first_message - 1;
+    mdata->newsrc_dirty = true;
   }
   if (ctx && ctx->mailbox->data == mdata)
   {
@@ -34,6 +34,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "nntp_private.h"
 #include "mutt/mutt.h"
@@ -73,6 +74,11 @@ bool NntpLoadDescription; ///< Config: (nntp) Load descriptions for newsgroups w
 short NntpPoll; ///< Config: (nntp) Interval between checks for new posts
 bool ShowNewNews; ///< Config: (nntp) Check for new newsgroups when entering the browser
 
+#define NNTP_PIPELINE_DEPTH 16 ///< Most commands to send before reading the answers
+
+#define NNTP_MSGID_INDEX_KEY "msgid-index" ///< Header cache key of the articles indexed
+#define NNTP_CHILDREN_KEY "children "      ///< Header cache key prefix of an article's children
+
 struct NntpAccountData *CurrentNewsSrv;
 
 const char *OverviewFmt = "Subject:\0"
@@ -93,10 +99,14 @@ struct FetchCtx
   anum_t first;
   anum_t last;
   int restore;
-  unsigned char *messages;
+  unsigned char *messages; ///< 1 if an article exists, 2 if it's to be fetched
   struct Progress progress;
+  anum_t *anums; ///< Articles being fetched with HEAD
+  FILE *fp;      ///< Header of the current article
 #ifdef USE_HCACHE
   header_cache_t *hc;
+  anum_t idx_first; ///< First article in the Message-ID index
+  anum_t idx_last;  ///< Last article in the Message-ID index
 #endif
 };
 
@@ -696,6 +706,7 @@ static int nntp_query(struct NntpMboxData *mdata, char *line, size_t linelen)
     {
       int rc = 0;
 
+      mutt_trace_begin_cmd("nntp_query", *line ? line : "GROUP");
       if (*line)
         rc = mutt_socket_send(adata->conn, line);
       else if (mdata->group)
@@ -705,6 +716,7 @@ static int nntp_query(struct NntpMboxData *mdata, char *line, size_t linelen)
       }
       if (rc >= 0)
         rc = mutt_socket_readln(buf, sizeof(buf), adata->conn);
+      mutt_trace_end("nntp_query");
       if (rc >= 0)
         break;
     }
@@ -743,6 +755,75 @@ static int nntp_query(struct NntpMboxData *mdata, char *line, size_t linelen)
   return 0;
 }
 
+/**
+ * nntp_read_lines - Read the lines of a multi-line answer
+ * @param mdata NNTP Mailbox data
+ * @param msg   Progess message (OPTIONAL)
+ * @param func  Callback function (OPTIONAL)
+ * @param data  Data for callback function
+ * @retval  0 Success
+ * @retval -1 Connection lost
+ * @retval -2 Error in func(*line, *data)
+ *
+ * The answer's status line must already have been read.  After an error in
+ * func(), the rest of the answer is still read.  If func is NULL, the lines
+ * are discarded.
+ */
+static int nntp_read_lines(struct NntpMboxData *mdata, const char *msg,
+                           int (*func)(char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  unsigned int lines = 0;
+  size_t off = 0;
+  struct Progress progress;
+  int rc = 0;
+
+  if (msg)
+    mutt_progress_init(&progress, msg, MUTT_PROGRESS_MSG, ReadInc, 0);
+
+  char *line = mutt_mem_malloc(sizeof(buf));
+
+  while (true)
+  {
+    char *p = NULL;
+    int chunk = mutt_socket_readln_d(buf, sizeof(buf), mdata->adata->conn, MUTT_SOCK_LOG_HDR);
+    if (chunk < 0)
+    {
+      mdata->adata->status = NNTP_NONE;
+      rc = -1;
+      break;
+    }
+
+    p = buf;
+    if (!off && buf[0] == '.')
+    {
+      if (buf[1] == '\0')
+        break;
+      if (buf[1] == '.')
+        p++;
+    }
+
+    mutt_str_strfcpy(line + off, p, sizeof(buf));
+
+    if (chunk >= sizeof(buf))
+      off += strlen(p);
+    else
+    {
+      if (msg)
+        mutt_progress_update(&progress, ++lines, -1);
+
+      if (func && (rc == 0) && (func(line, data) < 0))
+        rc = -2;
+      off = 0;
+    }
+
+    mutt_mem_realloc(&line, off + sizeof(buf));
+  }
+
+  FREE(&line);
+  return rc;
+}
+
 /**
  * nntp_fetch_lines - Read lines, calling a callback function for each
  * @param mdata NNTP Mailbox data
@@ -762,19 +843,11 @@ static int nntp_query(struct NntpMboxData *mdata, char *line, size_t linelen)
 static int nntp_fetch_lines(struct NntpMboxData *mdata, char *query, size_t qlen,
                             const char *msg, int (*func)(char *, void *), void *data)
 {
-  int done = false;
   int rc;
 
-  while (!done)
+  while (true)
   {
     char buf[LONG_STRING];
-    char *line = NULL;
-    unsigned int lines = 0;
-    size_t off = 0;
-    struct Progress progress;
-
-    if (msg)
-      mutt_progress_init(&progress, msg, MUTT_PROGRESS_MSG, ReadInc, 0);
 
     mutt_str_strfcpy(buf, query, sizeof(buf));
     if (nntp_query(mdata, buf, sizeof(buf)) < 0)
@@ -785,50 +858,99 @@ static int nntp_fetch_lines(struct NntpMboxData *mdata, char *query, size_t qlen
       return 1;
     }
 
-    line = mutt_mem_malloc(sizeof(buf));
-    rc = 0;
+    rc = nntp_read_lines(mdata, msg, func, data);
+    func(NULL, data);
+    if (rc != -1)
+      break;
+  }
+  return rc;
+}
 
-    while (true)
+/**
+ * nntp_fetch_pipeline - Send several commands at once, then read the answers
+ * @param mdata NNTP Mailbox data
+ * @param cmds  Commands, each ending with "\r\n"
+ * @param num   Number of commands
+ * @param func  Callback function for each line of an answer
+ * @param done  Callback function for each answer
+ * @param data  Data for the callback functions
+ * @retval  0 Success
+ * @retval -1 Connection lost
+ * @retval -2 Error in a callback function
+ *
+ * Only commands with multi-line answers, e.g. HEAD or OVER, may be sent this
+ * way.  Up to #NNTP_PIPELINE_DEPTH commands are sent together (RFC3977 3.5),
+ * so a batch only costs one round trip.
+ *
+ * Before the lines of each answer, func(NULL, data) is called.  After them,
+ * done(index, status, data) is called, where status is the answer's first
+ * line; it's called alone if the answer isn't a success.  If the connection
+ * is lost, the unanswered commands are sent again.  After an error, the rest
+ * of the batch is read, but not passed to the callbacks.
+ */
+static int nntp_fetch_pipeline(struct NntpMboxData *mdata, char **cmds, int num,
+                               int (*func)(char *, void *),
+                               int (*done)(int, char *, void *), void *data)
+{
+  struct NntpAccountData *adata = mdata->adata;
+  struct Buffer *batch = mutt_buffer_new();
+  char buf[LONG_STRING];
+  int next = 0;
+  int rc = 0;
+
+  while ((next < num) && (rc == 0))
+  {
+    /* reconnect, and select the group again */
+    if (adata->status != NNTP_OK)
     {
-      char *p = NULL;
-      int chunk = mutt_socket_readln_d(buf, sizeof(buf), mdata->adata->conn, MUTT_SOCK_LOG_HDR);
-      if (chunk < 0)
+      buf[0] = '\0';
+      if (nntp_query(mdata, buf, sizeof(buf)) < 0)
       {
-        mdata->adata->status = NNTP_NONE;
+        rc = -1;
         break;
       }
+    }
+
+    const int end = MIN(next + NNTP_PIPELINE_DEPTH, num);
+    mutt_buffer_reset(batch);
+    for (int i = next; i < end; i++)
+      mutt_buffer_addstr(batch, cmds[i]);
 
-      p = buf;
-      if (!off && buf[0] == '.')
+    if (mutt_socket_send(adata->conn, batch->data) < 0)
+    {
+      adata->status = NNTP_NONE;
+      continue;
+    }
+
+    for (; next < end; next++)
+    {
+      if (mutt_socket_readln(buf, sizeof(buf), adata->conn) < 0)
       {
-        if (buf[1] == '\0')
-        {
-          done = true;
-          break;
-        }
-        if (buf[1] == '.')
-          p++;
+        adata->status = NNTP_NONE;
+        break;
       }
 
-      mutt_str_strfcpy(line + off, p, sizeof(buf));
-
-      if (chunk >= sizeof(buf))
-        off += strlen(p);
-      else
+      int rc_lines = 0;
+      if (buf[0] == '2')
       {
-        if (msg)
-          mutt_progress_update(&progress, ++lines, -1);
+        if (rc == 0)
+          func(NULL, data);
+        rc_lines = nntp_read_lines(mdata, NULL, (rc == 0) ? func : NULL, data);
+        if (rc_lines == -1)
+          break;
+      }
 
-        if (rc == 0 && func(line, data) < 0)
+      if (rc == 0)
+      {
+        if (rc_lines < 0)
+          rc = rc_lines;
+        else if (done(next, buf, data) < 0)
           rc = -2;
-        off = 0;
       }
-
-      mutt_mem_realloc(&line, off + sizeof(buf));
     }
-    FREE(&line);
-    func(NULL, data);
   }
+
+  mutt_buffer_free(&batch);
   return rc;
 }
 
@@ -941,6 +1063,33 @@ static void nntp_parse_xref(struct Mailbox *mailbox, struct Email *e)
   FREE(&buf);
 }
 
+/**
+ * parse_tempfile - Parse an article header from a temporary file
+ * @param fp File containing just the header
+ * @param e  Email to fill in
+ * @retval ptr Newly allocated envelope structure
+ *
+ * The header is read into memory, so a crossposted article that has already
+ * been parsed for another newsgroup is simply copied.
+ */
+static struct Envelope *parse_tempfile(FILE *fp, struct Email *e)
+{
+  struct stat st;
+
+  if ((fflush(fp) != 0) || (fstat(fileno(fp), &st) != 0))
+  {
+    rewind(fp);
+    return mutt_rfc822_read_header(fp, e, false, false);
+  }
+
+  char *buf = mutt_mem_malloc(st.st_size + 1);
+  rewind(fp);
+  size_t len = fread(buf, 1, st.st_size, fp);
+  struct Envelope *env = mutt_hdrshare_read_header(buf, len, e);
+  FREE(&buf);
+  return env;
+}
+
 /**
  * fetch_tempfile - Write line to temporary file
  * @param line Text to write
@@ -980,6 +1129,196 @@ static int fetch_numbers(char *line, void *data)
   return 0;
 }
 
+#ifdef USE_HCACHE
+/**
+ * msgid_index_add - Add an article to the Message-ID index
+ * @param hc   Header cache
+ * @param e    Email
+ * @param anum Article number
+ *
+ * The index lives in the group's header cache.  The article's Message-ID
+ * maps to its number, and each Message-ID in its References maps to a list
+ * of the articles that refer to it.  This answers the same questions as
+ * HEAD \<msgid\> and XPAT References, without asking the server.
+ */
+static void msgid_index_add(header_cache_t *hc, struct Email *e, anum_t anum)
+{
+  char key[HUGE_STRING];
+  char val[16];
+
+  if (!hc || !e->env)
+    return;
+
+  snprintf(val, sizeof(val), "%u", anum);
+  if (e->env->message_id)
+  {
+    mutt_hcache_store_raw(hc, e->env->message_id, strlen(e->env->message_id),
+                          val, strlen(val) + 1);
+  }
+
+  struct ListNode *ref = NULL;
+  STAILQ_FOREACH(ref, &e->env->references, entries)
+  {
+    snprintf(key, sizeof(key), "%s%s", NNTP_CHILDREN_KEY, ref->data);
+    char *old = mutt_hcache_fetch_raw(hc, key, strlen(key));
+    struct Buffer *list = mutt_buffer_new();
+    bool found = false;
+
+    if (old)
+    {
+      mutt_buffer_addstr(list, old);
+      mutt_hcache_free(hc, (void **) &old);
+      for (char *p = list->data; p && !found; p = strchr(p, ' '))
+      {
+        p += (*p == ' ');
+        found = (mutt_str_strncmp(p, val, strlen(val)) == 0) &&
+                ((p[strlen(val)] == ' ') || (p[strlen(val)] == '\0'));
+      }
+    }
+
+    if (!found)
+    {
+      if (list->dptr != list->data)
+        mutt_buffer_addch(list, ' ');
+      mutt_buffer_addstr(list, val);
+      mutt_hcache_store_raw(hc, key, strlen(key), list->data,
+                            list->dptr - list->data + 1);
+    }
+    mutt_buffer_free(&list);
+  }
+}
+
+/**
+ * msgid_index_range - Get the articles covered by the Message-ID index
+ * @param hc    Header cache
+ * @param first First article indexed
+ * @param last  Last article indexed
+ *
+ * If there's no index, first is greater than last.
+ */
+static void msgid_index_range(header_cache_t *hc, anum_t *first, anum_t *last)
+{
+  *first = 1;
+  *last = 0;
+  if (!hc)
+    return;
+
+  char *hdata = mutt_hcache_fetch_raw(hc, NNTP_MSGID_INDEX_KEY, strlen(NNTP_MSGID_INDEX_KEY));
+  if (!hdata)
+    return;
+  if (sscanf(hdata, ANUM " " ANUM, first, last) != 2)
+  {
+    *first = 1;
+    *last = 0;
+  }
+  mutt_hcache_free(hc, (void **) &hdata);
+}
+
+/**
+ * msgid_index_extend - Record that articles have been indexed
+ * @param hc    Header cache
+ * @param first First article indexed
+ * @param last  Last article indexed
+ *
+ * Only one run of articles is remembered.  A new run that touches it is
+ * merged with it; otherwise the longer of the two is kept.
+ */
+static void msgid_index_extend(header_cache_t *hc, anum_t first, anum_t last)
+{
+  anum_t ifirst, ilast;
+  char buf[32];
+
+  if (!hc || (first > last))
+    return;
+
+  msgid_index_range(hc, &ifirst, &ilast);
+  if ((ifirst <= ilast) && (first <= ilast + 1) && (ifirst <= last + 1))
+  {
+    first = MIN(first, ifirst);
+    last = MAX(last, ilast);
+  }
+  else if ((ifirst <= ilast) && (last - first < ilast - ifirst))
+    return;
+
+  if ((first == ifirst) && (last == ilast))
+    return;
+
+  snprintf(buf, sizeof(buf), "%u %u", first, last);
+  mutt_debug(2, "mutt_hcache_store %s: %s\n", NNTP_MSGID_INDEX_KEY, buf);
+  mutt_hcache_store_raw(hc, NNTP_MSGID_INDEX_KEY, strlen(NNTP_MSGID_INDEX_KEY),
+                        buf, strlen(buf) + 1);
+}
+
+/**
+ * msgid_index_restore - Get an article's header from the cache
+ * @param hc    Header cache
+ * @param anum  Article number
+ * @param msgid Expected Message-ID, or NULL
+ * @retval ptr  Email, with its NntpEmailData
+ * @retval NULL Article isn't cached
+ */
+static struct Email *msgid_index_restore(header_cache_t *hc, anum_t anum, const char *msgid)
+{
+  char buf[16];
+
+  snprintf(buf, sizeof(buf), "%u", anum);
+  void *hdata = mutt_hcache_fetch(hc, buf, strlen(buf));
+  if (!hdata)
+    return NULL;
+
+  mutt_debug(2, "mutt_hcache_fetch %s\n", buf);
+  struct Email *e = mutt_hcache_restore(hdata);
+  mutt_hcache_free(hc, &hdata);
+
+  /* the article may have been renumbered since it was indexed */
+  if (msgid && (mutt_str_strcmp(e->env->message_id, msgid) != 0))
+  {
+    mutt_email_free(&e);
+    return NULL;
+  }
+
+  e->data = new_emaildata();
+  e->free_data = free_emaildata;
+  NNTP_EDATA(e)->article_num = anum;
+  return e;
+}
+#endif
+
+/**
+ * fetch_save - Add a fetched header to the mailbox
+ * @param fc   FetchCtx
+ * @param e    Email, already in the mailbox's next free slot
+ * @param anum Article number
+ */
+static void fetch_save(struct FetchCtx *fc, struct Email *e, anum_t anum)
+{
+  struct Mailbox *mailbox = fc->ctx->mailbox;
+  struct NntpMboxData *mdata = mailbox->data;
+
+#ifdef USE_HCACHE
+  if ((anum < fc->idx_first) || (anum > fc->idx_last))
+    msgid_index_add(fc->hc, e, anum);
+#endif
+
+  e->index = mailbox->msg_count++;
+  e->read = false;
+  e->old = false;
+  e->deleted = false;
+  e->data = new_emaildata();
+  e->free_data = free_emaildata;
+  NNTP_EDATA(e)->article_num = anum;
+  if (fc->restore)
+    e->changed = true;
+  else
+  {
+    nntp_article_status(mailbox, e, NULL, NNTP_EDATA(e)->article_num);
+    if (!e->read)
+      nntp_parse_xref(mailbox, e);
+  }
+  if (anum > mdata->last_loaded)
+    mdata->last_loaded = anum;
+}
+
 /**
  * parse_overview_line - Parse overview line
  * @param line String to parse
@@ -1059,7 +1398,7 @@ static int parse_overview_line(char *line, void *data)
   /* parse header */
   ctx->mailbox->hdrs[ctx->mailbox->msg_count] = mutt_email_new();
   e = ctx->mailbox->hdrs[ctx->mailbox->msg_count];
-  e->env = mutt_rfc822_read_header(fp, e, false, false);
+  e->env = parse_tempfile(fp, e);
   e->env->newsgroups = mutt_str_strdup(mdata->group);
   e->received = e->date_sent;
   mutt_file_fclose(&fp);
@@ -1105,25 +1444,7 @@ static int parse_overview_line(char *line, void *data)
 #endif
 
   if (save)
-  {
-    e->index = ctx->mailbox->msg_count++;
-    e->read = false;
-    e->old = false;
-    e->deleted = false;
-    e->data = new_emaildata();
-    e->free_data = free_emaildata;
-    NNTP_EDATA(e)->article_num = anum;
-    if (fc->restore)
-      e->changed = true;
-    else
-    {
-      nntp_article_status(ctx->mailbox, e, NULL, anum);
-      if (!e->read)
-        nntp_parse_xref(ctx->mailbox, e);
-    }
-    if (anum > mdata->last_loaded)
-      mdata->last_loaded = anum;
-  }
+    fetch_save(fc, e, anum);
   else
     mutt_email_free(&e);
 
@@ -1133,6 +1454,108 @@ static int parse_overview_line(char *line, void *data)
   return 0;
 }
 
+/**
+ * fetch_head - Write a line of a HEAD answer to a temporary file
+ * @param line Header line, or NULL at the start of an answer
+ * @param data FetchCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_head(char *line, void *data)
+{
+  struct FetchCtx *fc = data;
+
+  if (!line)
+  {
+    rewind(fc->fp);
+    return ftruncate(fileno(fc->fp), 0);
+  }
+
+  if ((fputs(line, fc->fp) == EOF) || (fputc('\n', fc->fp) == EOF))
+    return -1;
+  return 0;
+}
+
+/**
+ * fetch_head_done - Parse the answer to a HEAD command
+ * @param idx    Index of the command
+ * @param status First line of the answer
+ * @param data   FetchCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_head_done(int idx, char *status, void *data)
+{
+  struct FetchCtx *fc = data;
+  struct Mailbox *mailbox = fc->ctx->mailbox;
+  struct NntpMboxData *mdata = mailbox->data;
+  const anum_t anum = fc->anums[idx];
+  char buf[16];
+
+  if (!mailbox->quiet)
+    mutt_progress_update(&fc->progress, anum - fc->first + 1, -1);
+
+  snprintf(buf, sizeof(buf), "%u", anum);
+  if (status[0] != '2')
+  {
+    /* invalid response */
+    if (mutt_str_strncmp("423", status, 3) != 0)
+    {
+      mutt_error("HEAD: %s", status);
+      return -1;
+    }
+
+    /* no such article */
+    if (mdata->bcache)
+    {
+      mutt_debug(2, "#3 mutt_bcache_del %s\n", buf);
+      mutt_bcache_del(mdata->bcache, buf);
+    }
+    return 0;
+  }
+
+  /* allocate memory for headers */
+  if (mailbox->msg_count >= mailbox->hdrmax)
+    mx_alloc_memory(mailbox);
+
+  /* parse header */
+  struct Email *e = mutt_email_new();
+  mailbox->hdrs[mailbox->msg_count] = e;
+  e->env = parse_tempfile(fc->fp, e);
+  e->received = e->date_sent;
+
+#ifdef USE_HCACHE
+  if (fc->hc)
+  {
+    mutt_debug(2, "mutt_hcache_store %s\n", buf);
+    mutt_hcache_store(fc->hc, buf, strlen(buf), e, 0);
+  }
+#endif
+
+  fetch_save(fc, e, anum);
+  return 0;
+}
+
+/**
+ * fetch_over_done - Check the answer to an OVER command
+ * @param idx    Index of the command
+ * @param status First line of the answer
+ * @param data   FetchCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_over_done(int idx, char *status, void *data)
+{
+  struct FetchCtx *fc = data;
+  struct NntpMboxData *mdata = fc->ctx->mailbox->data;
+
+  if (status[0] == '2')
+    return 0;
+
+  mutt_error("%s: %s", mdata->adata->hasOVER ? "OVER" : "XOVER", status);
+  return -1;
+}
+
 /**
  * nntp_fetch_headers - Fetch headers
  * @param ctx     Mailbox
@@ -1142,18 +1565,23 @@ static int parse_overview_line(char *line, void *data)
  * @param restore Restore message listed as deleted
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * Headers are taken from the header cache if possible.  The rest are fetched
+ * with OVER (or XOVER), one command for each run of missing articles, or with
+ * HEAD for each article if the server has no overview.  The commands are
+ * pipelined.
  */
 static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
                               anum_t last, int restore)
 {
   struct NntpMboxData *mdata = ctx->mailbox->data;
-  struct FetchCtx fc;
+  struct FetchCtx fc = { 0 };
   struct Email *e = NULL;
   char buf[HUGE_STRING];
   int rc = 0;
   int oldmsgcount = ctx->mailbox->msg_count;
   anum_t current;
-  anum_t first_over = first;
+  int wanted = 0;
 #ifdef USE_HCACHE
   void *hdata = NULL;
 #endif
@@ -1172,6 +1600,8 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
     return -1;
 #ifdef USE_HCACHE
   fc.hc = hc;
+  mutt_hcache_begin(fc.hc);
+  msgid_index_range(fc.hc, &fc.idx_first, &fc.idx_last);
 #endif
 
   /* fetch list of articles */
@@ -1218,7 +1648,7 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
       fc.messages[current - first] = 1;
   }
 
-  /* fetching header from cache or server, or fallback to fetch overview */
+  /* fetching header from cache, or note it for the server */
   if (!ctx->mailbox->quiet)
   {
     mutt_progress_init(&fc.progress, _("Fetching message headers..."),
@@ -1229,10 +1659,6 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
     if (!ctx->mailbox->quiet)
       mutt_progress_update(&fc.progress, current - first + 1, -1);
 
-#ifdef USE_HCACHE
-    snprintf(buf, sizeof(buf), "%u", current);
-#endif
-
     /* delete header from cache that does not exist on server */
     if (!fc.messages[current - first])
       continue;
@@ -1241,8 +1667,10 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
     if (ctx->mailbox->msg_count >= ctx->mailbox->hdrmax)
       mx_alloc_memory(ctx->mailbox);
 
+    e = NULL;
 #ifdef USE_HCACHE
     /* try to fetch header from cache */
+    snprintf(buf, sizeof(buf), "%u", current);
     hdata = mutt_hcache_fetch(fc.hc, buf, strlen(buf));
     if (hdata)
     {
@@ -1255,6 +1683,8 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
       /* skip header marked as deleted in cache */
       if (e->deleted && !restore)
       {
+        if ((current < fc.idx_first) || (current > fc.idx_last))
+          msgid_index_add(fc.hc, e, current);
         mutt_email_free(&e);
         if (mdata->bcache)
         {
@@ -1263,110 +1693,96 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
         }
         continue;
       }
-
-      e->read = false;
-      e->old = false;
     }
-    else
 #endif
 
-        /* don't try to fetch header from removed newsgroup */
-        if (mdata->deleted)
-      continue;
-
-    /* fallback to fetch overview */
-    else if (mdata->adata->hasOVER || mdata->adata->hasXOVER)
+    if (!e)
     {
-      if (NntpListgroup && mdata->adata->hasLISTGROUP)
-        break;
-      else
-        continue;
-    }
-
-    /* fetch header from server */
-    else
-    {
-      FILE *fp = mutt_file_mkstemp();
-      if (!fp)
+      /* don't try to fetch header from removed newsgroup */
+      if (!mdata->deleted)
       {
-        mutt_perror(_("Can't create temporary file"));
-        rc = -1;
-        break;
+        fc.messages[current - first] = 2;
+        wanted++;
       }
+      continue;
+    }
+
+    /* save header in context */
+    fetch_save(&fc, e, current);
+  }
+
+  if ((wanted > 0) && (rc == 0))
+  {
+    char **cmds = mutt_mem_calloc(wanted, sizeof(char *));
+    int num = 0;
 
-      snprintf(buf, sizeof(buf), "HEAD %u\r\n", current);
-      rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, fetch_tempfile, fp);
-      if (rc)
+    /* fetch overview information for each run of missing articles */
+    if (mdata->adata->hasOVER || mdata->adata->hasXOVER)
+    {
+      const char *cmd = mdata->adata->hasOVER ? "OVER" : "XOVER";
+      for (current = first; current <= last; current++)
       {
-        mutt_file_fclose(&fp);
-        if (rc < 0)
-          break;
+        if (fc.messages[current - first] != 2)
+          continue;
 
-        /* invalid response */
-        if (mutt_str_strncmp("423", buf, 3) != 0)
+        /* articles that don't exist don't break a run */
+        anum_t end = current;
+        for (anum_t i = current + 1; (i <= last) && (fc.messages[i - first] != 1); i++)
         {
-          mutt_error("HEAD: %s", buf);
-          break;
+          if (fc.messages[i - first] == 2)
+            end = i;
         }
 
-        /* no such article */
-        if (mdata->bcache)
-        {
-          snprintf(buf, sizeof(buf), "%u", current);
-          mutt_debug(2, "#3 mutt_bcache_del %s\n", buf);
-          mutt_bcache_del(mdata->bcache, buf);
-        }
-        rc = 0;
-        continue;
+        snprintf(buf, sizeof(buf), "%s %u-%u\r\n", cmd, current, end);
+        cmds[num++] = mutt_str_strdup(buf);
+        current = end;
       }
-
-      /* parse header */
-      ctx->mailbox->hdrs[ctx->mailbox->msg_count] = mutt_email_new();
-      e = ctx->mailbox->hdrs[ctx->mailbox->msg_count];
-      e->env = mutt_rfc822_read_header(fp, e, false, false);
-      e->received = e->date_sent;
-      mutt_file_fclose(&fp);
+      mutt_debug(2, "fetching %d articles with %d %s commands\n", wanted, num, cmd);
+      rc = nntp_fetch_pipeline(mdata, cmds, num, parse_overview_line,
+                               fetch_over_done, &fc);
     }
 
-    /* save header in context */
-    e->index = ctx->mailbox->msg_count++;
-    e->read = false;
-    e->old = false;
-    e->deleted = false;
-    e->data = new_emaildata();
-    e->free_data = free_emaildata;
-    NNTP_EDATA(e)->article_num = current;
-    if (restore)
-      e->changed = true;
+    /* fetch each header from server */
     else
     {
-      nntp_article_status(ctx->mailbox, e, NULL, NNTP_EDATA(e)->article_num);
-      if (!e->read)
-        nntp_parse_xref(ctx->mailbox, e);
-    }
-    if (current > mdata->last_loaded)
-      mdata->last_loaded = current;
-    first_over = current + 1;
-  }
-
-  if (!NntpListgroup || !mdata->adata->hasLISTGROUP)
-    current = first_over;
+      fc.anums = mutt_mem_calloc(wanted, sizeof(anum_t));
+      for (current = first; current <= last; current++)
+      {
+        if (fc.messages[current - first] != 2)
+          continue;
+        fc.anums[num] = current;
+        snprintf(buf, sizeof(buf), "HEAD %u\r\n", current);
+        cmds[num++] = mutt_str_strdup(buf);
+      }
 
-  /* fetch overview information */
-  if (current <= last && rc == 0 && !mdata->deleted)
-  {
-    char *cmd = mdata->adata->hasOVER ? "OVER" : "XOVER";
-    snprintf(buf, sizeof(buf), "%s %u-%u\r\n", cmd, current, last);
-    rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, parse_overview_line, &fc);
-    if (rc > 0)
-    {
-      mutt_error("%s: %s", cmd, buf);
+      fc.fp = mutt_file_mkstemp();
+      if (fc.fp)
+      {
+        rc = nntp_fetch_pipeline(mdata, cmds, num, fetch_head, fetch_head_done, &fc);
+        mutt_file_fclose(&fc.fp);
+      }
+      else
+      {
+        mutt_perror(_("Can't create temporary file"));
+        rc = -1;
+      }
+      FREE(&fc.anums);
     }
+
+    for (int i = 0; i < num; i++)
+      FREE(&cmds[i]);
+    FREE(&cmds);
   }
 
   if (ctx->mailbox->msg_count > oldmsgcount)
     mx_update_context(ctx, ctx->mailbox->msg_count - oldmsgcount);
 
+#ifdef USE_HCACHE
+  if (rc == 0)
+    msgid_index_extend(fc.hc, first, last);
+  mutt_hcache_commit(fc.hc);
+#endif
+
   FREE(&fc.messages);
   if (rc != 0)
     return -1;
@@ -1375,21 +1791,17 @@ static int nntp_fetch_headers(struct Context *ctx, void *hc, anum_t first,
 }
 
 /**
- * nntp_group_poll - Check newsgroup for new articles
- * @param mdata NNTP Mailbox data
+ * group_poll_update - Update a newsgroup from the answer to GROUP
+ * @param mdata       NNTP Mailbox data
+ * @param buf         Answer from the server
  * @param update_stat Update the stats?
- * @retval  1 New articles found
- * @retval  0 No change
- * @retval -1 Lost connection
+ * @retval 1 New articles found
+ * @retval 0 No change
  */
-static int nntp_group_poll(struct NntpMboxData *mdata, int update_stat)
+static int group_poll_update(struct NntpMboxData *mdata, const char *buf, int update_stat)
 {
-  char buf[LONG_STRING] = "";
   anum_t count, first, last;
 
-  /* use GROUP command to poll newsgroup */
-  if (nntp_query(mdata, buf, sizeof(buf)) < 0)
-    return -1;
   if (sscanf(buf, "211 " ANUM " " ANUM " " ANUM, &count, &first, &last) != 3)
     return 0;
   if (first == mdata->first_message && last == mdata->last_message)
@@ -1405,6 +1817,7 @@ static int nntp_group_poll(struct NntpMboxData *mdata, int update_stat)
       mdata->newsrc_len = 1;
       mdata->newsrc_ent[0].first = 1;
       mdata->newsrc_ent[0].last = 0;
+      mdata->newsrc_dirty = true;
     }
   }
   mdata->first_message = first;
@@ -1420,6 +1833,91 @@ static int nntp_group_poll(struct NntpMboxData *mdata, int update_stat)
   return 1;
 }
 
+/**
+ * nntp_group_poll - Check newsgroup for new articles
+ * @param mdata NNTP Mailbox data
+ * @param update_stat Update the stats?
+ * @retval  1 New articles found
+ * @retval  0 No change
+ * @retval -1 Lost connection
+ */
+static int nntp_group_poll(struct NntpMboxData *mdata, int update_stat)
+{
+  char buf[LONG_STRING] = "";
+
+  /* use GROUP command to poll newsgroup */
+  if (nntp_query(mdata, buf, sizeof(buf)) < 0)
+    return -1;
+  return group_poll_update(mdata, buf, update_stat);
+}
+
+/**
+ * nntp_groups_poll - Check several newsgroups for new articles
+ * @param adata       NNTP server
+ * @param list        Newsgroups to check
+ * @param num         Number of newsgroups
+ * @param update_stat Update the stats?
+ * @retval  1 New articles found
+ * @retval  0 No change
+ * @retval -1 Lost connection
+ *
+ * Like nntp_group_poll(), but the GROUP commands are sent together, up to
+ * #NNTP_PIPELINE_DEPTH at a time.  This leaves the last group selected.
+ */
+static int nntp_groups_poll(struct NntpAccountData *adata,
+                            struct NntpMboxData **list, int num, int update_stat)
+{
+  struct Buffer *batch = mutt_buffer_new();
+  char buf[LONG_STRING];
+  int next = 0;
+  int rc = 0;
+
+  while (next < num)
+  {
+    /* reconnect, polling the first group on the way */
+    if (adata->status != NNTP_OK)
+    {
+      buf[0] = '\0';
+      if (nntp_query(list[next], buf, sizeof(buf)) < 0)
+      {
+        rc = -1;
+        break;
+      }
+      if (group_poll_update(list[next++], buf, update_stat) > 0)
+        rc = 1;
+      continue;
+    }
+
+    const int end = MIN(next + NNTP_PIPELINE_DEPTH, num);
+    mutt_buffer_reset(batch);
+    for (int i = next; i < end; i++)
+    {
+      snprintf(buf, sizeof(buf), "GROUP %s\r\n", list[i]->group);
+      mutt_buffer_addstr(batch, buf);
+    }
+
+    if (mutt_socket_send(adata->conn, batch->data) < 0)
+    {
+      adata->status = NNTP_NONE;
+      continue;
+    }
+
+    for (; next < end; next++)
+    {
+      if (mutt_socket_readln(buf, sizeof(buf), adata->conn) < 0)
+      {
+        adata->status = NNTP_NONE;
+        break;
+      }
+      if (group_poll_update(list[next], buf, update_stat) > 0)
+        rc = 1;
+    }
+  }
+
+  mutt_buffer_free(&batch);
+  return rc;
+}
+
 /**
  * check_mailbox - Check current newsgroup for new articles
  * @param ctx Mailbox
@@ -1598,6 +2096,7 @@ static int check_mailbox(struct Context *ctx)
       mutt_hash_destroy(&ctx->mailbox->subj_hash);
     if (ctx->mailbox->id_hash)
       mutt_hash_destroy(&ctx->mailbox->id_hash);
+    mutt_hash_destroy(&ctx->mailbox->dup_hash);
     mutt_clear_threads(ctx);
 
     ctx->mailbox->vcount = 0;
@@ -1913,6 +2412,8 @@ int nntp_post(struct Mailbox *mailbox, const char *msg)
 
   buf[0] = '.';
   buf[1] = '\0';
+  /* send the article in large blocks, rather than a line at a time */
+  mutt_socket_cork(mdata->adata->conn);
   while (fgets(buf + 1, sizeof(buf) - 2, fp))
   {
     size_t len = strlen(buf);
@@ -1935,6 +2436,7 @@ int nntp_post(struct Mailbox *mailbox, const char *msg)
   if ((buf[strlen(buf) - 1] != '\n' &&
        mutt_socket_send_d(mdata->adata->conn, "\r\n", MUTT_SOCK_LOG_HDR) < 0) ||
       mutt_socket_send_d(mdata->adata->conn, ".\r\n", MUTT_SOCK_LOG_HDR) < 0 ||
+      mutt_socket_flush(mdata->adata->conn) < 0 ||
       mutt_socket_readln(buf, sizeof(buf), mdata->adata->conn) < 0)
   {
     return nntp_connect_error(mdata->adata);
@@ -2037,20 +2539,23 @@ int nntp_check_new_groups(struct Mailbox *mailbox, struct NntpAccountData *adata
   /* check subscribed newsgroups for new articles */
   if (ShowNewNews)
   {
+    struct NntpMboxData **list = mutt_mem_calloc(adata->groups_num + 1, sizeof(*list));
+    int num = 0;
+
     mutt_message(_("Checking for new messages..."));
     for (i = 0; i < adata->groups_num; i++)
     {
       struct NntpMboxData *mdata = adata->groups_list[i];
 
       if (mdata && mdata->subscribed)
-      {
-        rc = nntp_group_poll(mdata, 1);
-        if (rc < 0)
-          return -1;
-        if (rc > 0)
-          update_active = true;
-      }
+        list[num++] = mdata;
     }
+    rc = nntp_groups_poll(adata, list, num, 1);
+    FREE(&list);
+    if (rc < 0)
+      return -1;
+    if (rc > 0)
+      update_active = true;
     /* select current newsgroup */
     if (Context && (Context->mailbox->magic == MUTT_NNTP))
     {
@@ -2116,7 +2621,10 @@ int nntp_check_new_groups(struct Mailbox *mailbox, struct NntpAccountData *adata
         mutt_progress_update(&progress, ++count, -1);
       }
     }
-    update_active = true;
+
+    /* unless other groups have changed, only the new ones need saving */
+    if (!update_active)
+      nntp_active_append_cache(adata, groups_num);
     rc = 1;
   }
   if (update_active)
@@ -2132,56 +2640,82 @@ int nntp_check_new_groups(struct Mailbox *mailbox, struct NntpAccountData *adata
  * @retval  0 Success
  * @retval  1 No such article
  * @retval -1 Error
+ *
+ * If the Message-ID index knows the article, its header comes from the
+ * header cache, without asking the server.
  */
 int nntp_check_msgid(struct Context *ctx, const char *msgid)
 {
   struct NntpMboxData *mdata = ctx->mailbox->data;
+  struct Email *e = NULL;
   char buf[LONG_STRING];
 
-  FILE *fp = mutt_file_mkstemp();
-  if (!fp)
+#ifdef USE_HCACHE
+  header_cache_t *hc = nntp_hcache_open(mdata);
+  if (hc)
   {
-    mutt_perror(_("Can't create temporary file"));
-    return -1;
+    char *hdata = mutt_hcache_fetch_raw(hc, msgid, strlen(msgid));
+    anum_t anum = 0;
+
+    if (hdata)
+    {
+      sscanf(hdata, ANUM, &anum);
+      mutt_hcache_free(hc, (void **) &hdata);
+    }
+    if ((anum >= mdata->first_message) && (anum <= mdata->last_message))
+      e = msgid_index_restore(hc, anum, msgid);
+    mutt_hcache_close(hc);
   }
+#endif
 
-  snprintf(buf, sizeof(buf), "HEAD %s\r\n", msgid);
-  int rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, fetch_tempfile, fp);
-  if (rc)
+  if (!e)
   {
-    mutt_file_fclose(&fp);
-    if (rc < 0)
+    FILE *fp = mutt_file_mkstemp();
+    if (!fp)
+    {
+      mutt_perror(_("Can't create temporary file"));
       return -1;
-    if (mutt_str_strncmp("430", buf, 3) == 0)
-      return 1;
-    mutt_error("HEAD: %s", buf);
-    return -1;
-  }
-
-  /* parse header */
-  if (ctx->mailbox->msg_count == ctx->mailbox->hdrmax)
-    mx_alloc_memory(ctx->mailbox);
-  ctx->mailbox->hdrs[ctx->mailbox->msg_count] = mutt_email_new();
-  struct Email *e = ctx->mailbox->hdrs[ctx->mailbox->msg_count];
-  e->data = new_emaildata();
-  e->free_data = free_emaildata;
-  e->env = mutt_rfc822_read_header(fp, e, false, false);
-  mutt_file_fclose(&fp);
+    }
 
-  /* get article number */
-  if (e->env->xref)
-    nntp_parse_xref(ctx->mailbox, e);
-  else
-  {
-    snprintf(buf, sizeof(buf), "STAT %s\r\n", msgid);
-    if (nntp_query(mdata, buf, sizeof(buf)) < 0)
+    snprintf(buf, sizeof(buf), "HEAD %s\r\n", msgid);
+    int rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, fetch_tempfile, fp);
+    if (rc)
     {
-      mutt_email_free(&e);
+      mutt_file_fclose(&fp);
+      if (rc < 0)
+        return -1;
+      if (mutt_str_strncmp("430", buf, 3) == 0)
+        return 1;
+      mutt_error("HEAD: %s", buf);
       return -1;
     }
-    sscanf(buf + 4, ANUM, &NNTP_EDATA(e)->article_num);
+
+    /* parse header */
+    e = mutt_email_new();
+    e->data = new_emaildata();
+    e->free_data = free_emaildata;
+    e->env = parse_tempfile(fp, e);
+    mutt_file_fclose(&fp);
+
+    /* get article number */
+    if (e->env->xref)
+      nntp_parse_xref(ctx->mailbox, e);
+    else
+    {
+      snprintf(buf, sizeof(buf), "STAT %s\r\n", msgid);
+      if (nntp_query(mdata, buf, sizeof(buf)) < 0)
+      {
+        mutt_email_free(&e);
+        return -1;
+      }
+      sscanf(buf + 4, ANUM, &NNTP_EDATA(e)->article_num);
+    }
   }
 
+  if (ctx->mailbox->msg_count == ctx->mailbox->hdrmax)
+    mx_alloc_memory(ctx->mailbox);
+  ctx->mailbox->hdrs[ctx->mailbox->msg_count] = e;
+
   /* reset flags */
   e->read = false;
   e->old = false;
@@ -2199,14 +2733,18 @@ int nntp_check_msgid(struct Context *ctx, const char *msgid)
  * @param msgid Message ID to find
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * If the Message-ID index covers all the articles that might refer to msgid,
+ * it's used instead of XPAT, and the headers come from the header cache.
  */
 int nntp_check_children(struct Context *ctx, const char *msgid)
 {
   struct NntpMboxData *mdata = ctx->mailbox->data;
   struct ChildCtx cc;
-  char buf[STRING];
+  char buf[HUGE_STRING];
   int rc;
   bool quiet;
+  bool local = false;
   void *hc = NULL;
 
   if (!mdata || !mdata->adata)
@@ -2220,34 +2758,80 @@ int nntp_check_children(struct Context *ctx, const char *msgid)
   cc.max = 10;
   cc.child = mutt_mem_malloc(sizeof(anum_t) * cc.max);
 
+#ifdef USE_HCACHE
+  hc = nntp_hcache_open(mdata);
+  anum_t ifirst, ilast;
+  msgid_index_range(hc, &ifirst, &ilast);
+  if ((ifirst <= MAX(mdata->first_message, 1)) && (ilast >= mdata->last_loaded))
+  {
+    snprintf(buf, sizeof(buf), "%s%s", NNTP_CHILDREN_KEY, msgid);
+    char *hdata = mutt_hcache_fetch_raw(hc, buf, strlen(buf));
+    mutt_debug(2, "children of %s: %s\n", msgid, NONULL(hdata));
+    for (char *p = hdata; p && *p; p = strchr(p, ' '))
+    {
+      anum_t anum;
+      p += (*p == ' ');
+      if ((sscanf(p, ANUM, &anum) == 1) && (anum >= mdata->first_message) &&
+          (anum <= mdata->last_loaded))
+      {
+        mutt_str_strfcpy(buf, p, MIN(sizeof(buf), strcspn(p, " ") + 1));
+        fetch_children(buf, &cc);
+      }
+    }
+    mutt_hcache_free(hc, (void **) &hdata);
+    local = true;
+  }
+#endif
+
   /* fetch numbers of child messages */
-  snprintf(buf, sizeof(buf), "XPAT References %u-%u *%s*\r\n",
-           mdata->first_message, mdata->last_loaded, msgid);
-  rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, fetch_children, &cc);
-  if (rc)
+  if (!local)
   {
-    FREE(&cc.child);
-    if (rc > 0)
+    snprintf(buf, sizeof(buf), "XPAT References %u-%u *%s*\r\n",
+             mdata->first_message, mdata->last_loaded, msgid);
+    rc = nntp_fetch_lines(mdata, buf, sizeof(buf), NULL, fetch_children, &cc);
+    if (rc)
     {
-      if (mutt_str_strncmp("500", buf, 3) != 0)
-        mutt_error("XPAT: %s", buf);
-      else
+      FREE(&cc.child);
+#ifdef USE_HCACHE
+      mutt_hcache_close(hc);
+#endif
+      if (rc > 0)
       {
-        mutt_error(_("Unable to find child articles because server does not "
-                     "support XPAT command"));
+        if (mutt_str_strncmp("500", buf, 3) != 0)
+          mutt_error("XPAT: %s", buf);
+        else
+        {
+          mutt_error(_("Unable to find child articles because server does not "
+                       "support XPAT command"));
+        }
       }
+      return -1;
     }
-    return -1;
   }
 
   /* fetch all found messages */
   quiet = ctx->mailbox->quiet;
   ctx->mailbox->quiet = true;
-#ifdef USE_HCACHE
-  hc = nntp_hcache_open(mdata);
-#endif
+  rc = 0;
   for (int i = 0; i < cc.num; i++)
   {
+#ifdef USE_HCACHE
+    /* the index only points at cached articles */
+    struct Email *e = local ? msgid_index_restore(hc, cc.child[i], NULL) : NULL;
+    if (e)
+    {
+      if (ctx->mailbox->msg_count >= ctx->mailbox->hdrmax)
+        mx_alloc_memory(ctx->mailbox);
+      ctx->mailbox->hdrs[ctx->mailbox->msg_count] = e;
+      e->read = false;
+      e->old = false;
+      e->deleted = false;
+      e->changed = true;
+      e->index = ctx->mailbox->msg_count++;
+      mx_update_context(ctx, 1);
+      continue;
+    }
+#endif
     rc = nntp_fetch_headers(ctx, hc, cc.child[i], cc.child[i], 1);
     if (rc < 0)
       break;
@@ -2346,6 +2930,7 @@ static int nntp_mbox_open(struct Context *ctx)
     {
       FREE(&mdata->newsrc_ent);
       mdata->newsrc_len = 0;
+      mdata->newsrc_dirty = true;
       nntp_delete_group_cache(mdata);
       nntp_newsrc_update(adata);
     }
@@ -2455,6 +3040,7 @@ static int nntp_mbox_sync(struct Context *ctx, int *index_hint)
 #ifdef USE_HCACHE
   mdata->last_cached = 0;
   hc = nntp_hcache_open(mdata);
+  mutt_hcache_begin(hc);
 #endif
 
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
@@ -2727,11 +3313,14 @@ struct MxOps mx_nntp_ops = {
   .mbox_check       = nntp_mbox_check,
   .mbox_sync        = nntp_mbox_sync,
   .mbox_close       = nntp_mbox_close,
+  .mbox_flush       = NULL,
   .msg_open         = nntp_msg_open,
   .msg_open_new     = NULL,
   .msg_commit       = NULL,
   .msg_close        = nntp_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = nntp_path_probe,
@@ -143,8 +143,10 @@ struct NntpMboxData
   bool new        : 1;
   bool allowed    : 1;
   bool deleted    : 1;
+  bool newsrc_dirty : 1;
   unsigned int newsrc_len;
   struct NewsrcEntry *newsrc_ent;
+  char *newsrc_line;
   struct NntpAccountData *adata;
   struct NntpAcache acache[NNTP_ACACHE_LEN];
   struct BodyCache *bcache;
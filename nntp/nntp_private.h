@@ -48,6 +48,7 @@ enum NntpStatus
 #define NNTP_EDATA(email) ((struct NntpEmailData *) ((email)->data))
 
 void nntp_acache_free(struct NntpMboxData *mdata);
+int  nntp_active_append_cache(struct NntpAccountData *adata, unsigned int first);
 int  nntp_active_save_cache(struct NntpAccountData *adata);
 int  nntp_add_group(char *line, void *data);
 void nntp_bcache_update(struct NntpMboxData *mdata);
@@ -74,6 +74,7 @@
 int NmDbLimit;       ///< Config: (notmuch) Default limit for Notmuch queries
 char *NmDefaultUri;  ///< Config: (notmuch) Path to the Notmuch database
 char *NmExcludeTags; ///< Config: (notmuch) Exclude messages with these tags
+int NmLoadChunk;     ///< Config: (notmuch) Number of messages to show before the rest are loaded
 int NmOpenTimeout;   ///< Config: (notmuch) Database timeout
 char *NmQueryType; ///< Config: (notmuch) Default query type: 'threads' or 'messages'
 int NmQueryWindowCurrentPosition; ///< Config: (notmuch) Position of current search window
@@ -133,13 +134,59 @@ struct NmMboxData
   struct Progress progress; /**< A progress bar */
   int oldmsgcount;
   int ignmsgcount; /**< Ignored messages */
+  int loaded;      /**< Results of the query read so far */
+  unsigned long revision; /**< Database revision the mailbox is up to date with */
+  char *db_uuid;          /**< UUID of the database the revision belongs to */
 
   bool noprogress : 1;     /**< Don't show the progress bar */
   bool longrun : 1;        /**< A long-lived action is in progress */
   bool trans : 1;          /**< Atomic transaction in progress */
   bool progress_ready : 1; /**< A progress bar has been initialised */
+  bool db_shared : 1;      /**< db is the shared read-only handle */
+  bool loading : 1;        /**< More results of the query are to be loaded */
+  bool db_writable : 1;    /**< db was opened read/write */
 };
 
+/**
+ * struct NmReadDb - A read-only database handle, shared by the mailboxes
+ *
+ * Opening a large database is slow, so the read-only handle stays open
+ * between operations.  It's only reopened when the database has changed.
+ */
+struct NmReadDb
+{
+  notmuch_database_t *db;
+  char *filename; /**< Path of the database */
+  time_t opened;  /**< When the handle was opened */
+  int users;      /**< Number of users of the handle */
+};
+
+static struct NmReadDb ReadDb = { 0 };
+
+/**
+ * struct NmCount - Message counts of a vfolder
+ *
+ * The sidebar and the mailbox checks ask for the counts of every vfolder
+ * often, but they can only change when the database does.  So they're kept
+ * along with the revision of the database they were counted at.
+ *
+ * Removing a message doesn't change the revision, so the modification time
+ * of the database is checked too.
+ */
+struct NmCount
+{
+  unsigned long revision; /**< Database revision the counts are valid for */
+  char *uuid;             /**< UUID of the database */
+  time_t mtime;           /**< Modification time of the database */
+  time_t counted;         /**< When the counts were made */
+  int all;                /**< Number of messages */
+  int new;                /**< Number of unread messages */
+};
+
+static struct Hash *CountCache = NULL;
+
+static int release_db(struct NmMboxData *mdata);
+
 /**
  * free_emaildata - Free data attached to an Email
  * @param data Email data
@@ -186,17 +233,12 @@ static void free_mboxdata(void **data)
 
   struct NmMboxData *mdata = *data;
 
-  if (mdata->db)
-#ifdef NOTMUCH_API_3
-    notmuch_database_destroy(mdata->db);
-#else
-    notmuch_database_close(mdata->db);
-#endif
-  mdata->db = NULL;
+  release_db(mdata);
 
   url_free(&mdata->db_url);
   FREE(&mdata->db_url_holder);
   FREE(&mdata->db_query);
+  FREE(&mdata->db_uuid);
   FREE(data);
 }
 
@@ -640,22 +682,156 @@ static notmuch_database_t *do_database_open(const char *filename, bool writable,
   return db;
 }
 
+/**
+ * close_database - Close a Notmuch database
+ * @param db Notmuch database
+ */
+static void close_database(notmuch_database_t **db)
+{
+  if (!db || !*db)
+    return;
+
+#ifdef NOTMUCH_API_3
+  notmuch_database_destroy(*db);
+#else
+  notmuch_database_close(*db);
+#endif
+  *db = NULL;
+}
+
+/**
+ * database_file_mtime - Get the modification time of a database
+ * @param[in]  filename Database filename
+ * @param[out] mtime    Save the modification time
+ * @retval  0 Success (result in mtime)
+ * @retval -1 Error
+ */
+static int database_file_mtime(const char *filename, time_t *mtime)
+{
+  if (!filename)
+    return -1;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/.notmuch/xapian", filename);
+  mutt_debug(2, "nm: checking '%s' mtime\n", path);
+
+  struct stat st;
+  if (stat(path, &st))
+    return -1;
+
+  if (mtime)
+    *mtime = st.st_mtime;
+
+  return 0;
+}
+
+/**
+ * get_read_db - Get a read-only Notmuch database
+ * @param[in]  filename Database filename
+ * @param[in]  verbose  Show errors on failure?
+ * @param[out] shared   Set to true if the shared handle was returned
+ * @retval ptr Notmuch database
+ *
+ * The shared handle is reused while the database hasn't changed since it was
+ * opened.  If it's out of date it's reopened, unless it's still in use, in
+ * which case a private handle is opened instead.  Either way, the handle
+ * must be given back with put_read_db().
+ */
+static notmuch_database_t *get_read_db(const char *filename, bool verbose, bool *shared)
+{
+  *shared = false;
+
+  /* The mtime only has a resolution of a second, so a change made in the
+   * second the handle was opened is assumed to be missing from it. */
+  time_t mtime = 0;
+  if (ReadDb.db && (mutt_str_strcmp(ReadDb.filename, filename) == 0) &&
+      (database_file_mtime(filename, &mtime) == 0) && (mtime < ReadDb.opened))
+  {
+    mutt_debug(2, "nm: db reuse '%s'\n", filename);
+    ReadDb.users++;
+    *shared = true;
+    return ReadDb.db;
+  }
+
+  if (ReadDb.users > 0)
+    return do_database_open(filename, false, verbose);
+
+  close_database(&ReadDb.db);
+  FREE(&ReadDb.filename);
+
+  ReadDb.opened = time(NULL);
+  ReadDb.db = do_database_open(filename, false, verbose);
+  if (!ReadDb.db)
+    return NULL;
+
+  ReadDb.filename = mutt_str_strdup(filename);
+  ReadDb.users = 1;
+  *shared = true;
+  return ReadDb.db;
+}
+
+/**
+ * put_read_db - Give back a database from get_read_db()
+ * @param db     Notmuch database
+ * @param shared Is it the shared handle?
+ *
+ * The shared handle is left open for next time.
+ */
+static void put_read_db(notmuch_database_t **db, bool shared)
+{
+  if (!db || !*db)
+    return;
+
+  if (shared && (*db == ReadDb.db))
+  {
+    if (ReadDb.users > 0)
+      ReadDb.users--;
+    *db = NULL;
+  }
+  else
+    close_database(db);
+}
+
 /**
  * get_db - Get the Notmuch database
  * @param mdata Notmuch Mailbox data
  * @param writable Read/write?
  * @retval ptr Notmuch database
+ *
+ * Reads use the shared read-only handle.  Writes need a private read/write
+ * handle, which holds the database's lock until release_db().
  */
 static notmuch_database_t *get_db(struct NmMboxData *mdata, bool writable)
 {
   if (!mdata)
     return NULL;
+
   if (mdata->db)
-    return mdata->db;
+  {
+    if (!writable || mdata->db_writable || mdata->trans)
+      return mdata->db;
+
+    /* swap the read-only handle for one we can write to */
+    const bool longrun = mdata->longrun;
+    release_db(mdata);
+    mdata->longrun = longrun;
+  }
 
   const char *db_filename = get_db_filename(mdata);
-  if (db_filename)
-    mdata->db = do_database_open(db_filename, writable, true);
+  if (!db_filename)
+    return NULL;
+
+  if (writable)
+  {
+    mdata->db = do_database_open(db_filename, true, true);
+    mdata->db_writable = (mdata->db != NULL);
+  }
+  else
+  {
+    bool shared = false;
+    mdata->db = get_read_db(db_filename, true, &shared);
+    mdata->db_shared = shared;
+  }
 
   return mdata->db;
 }
@@ -665,19 +841,26 @@ static notmuch_database_t *get_db(struct NmMboxData *mdata, bool writable)
  * @param mdata Notmuch Mailbox data
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * The shared read-only handle is only given back; it stays open.
  */
 static int release_db(struct NmMboxData *mdata)
 {
   if (!mdata || !mdata->db)
     return -1;
 
-  mutt_debug(1, "nm: db close\n");
-#ifdef NOTMUCH_API_3
-  notmuch_database_destroy(mdata->db);
-#else
-  notmuch_database_close(mdata->db);
-#endif
-  mdata->db = NULL;
+  if (mdata->db_shared)
+  {
+    mutt_debug(2, "nm: db release\n");
+    put_read_db(&mdata->db, true);
+  }
+  else
+  {
+    mutt_debug(1, "nm: db close\n");
+    close_database(&mdata->db);
+  }
+  mdata->db_shared = false;
+  mdata->db_writable = false;
   mdata->longrun = false;
   return 0;
 }
@@ -751,18 +934,53 @@ static int get_database_mtime(struct NmMboxData *mdata, time_t *mtime)
   if (!mdata)
     return -1;
 
-  char path[PATH_MAX];
-  snprintf(path, sizeof(path), "%s/.notmuch/xapian", get_db_filename(mdata));
-  mutt_debug(2, "nm: checking '%s' mtime\n", path);
+  return database_file_mtime(get_db_filename(mdata), mtime);
+}
 
-  struct stat st;
-  if (stat(path, &st))
+/**
+ * get_database_revision - Get the revision of the database
+ * @param[in]  mdata Notmuch Mailbox data
+ * @param[out] rev   Save the revision
+ * @param[out] uuid  Save the UUID of the database (don't free it)
+ * @retval  0 Success
+ * @retval -1 Error, or notmuch is too old to keep revisions
+ *
+ * Every change to the database increases its revision, which can be searched
+ * for with "lastmod:".  A revision is only meaningful along with the UUID of
+ * the database, which changes when the database is rebuilt.
+ */
+static int get_database_revision(struct NmMboxData *mdata, unsigned long *rev,
+                                 const char **uuid)
+{
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+  notmuch_database_t *db = get_db(mdata, false);
+  if (!db)
     return -1;
 
-  if (mtime)
-    *mtime = st.st_mtime;
-
+  *rev = notmuch_database_get_revision(db, uuid);
   return 0;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * save_database_revision - Remember which revision the mailbox reflects
+ * @param mdata Notmuch Mailbox data
+ *
+ * This must be called before the database is searched, so that changes made
+ * during the search are seen by the next check.
+ */
+static void save_database_revision(struct NmMboxData *mdata)
+{
+  const char *uuid = NULL;
+
+  if (get_database_revision(mdata, &mdata->revision, &uuid) != 0)
+  {
+    mdata->revision = 0;
+    uuid = NULL;
+  }
+  mutt_str_replace(&mdata->db_uuid, uuid);
 }
 
 /**
@@ -1264,10 +1482,15 @@ static void append_thread(struct Mailbox *mailbox, notmuch_query_t *q,
  * @param mailbox Mailbox
  * @param q       Notmuch query
  * @param dedup   De-duplicate the results
+ * @param count   Most results to read, 0 for all of them
  * @retval true  Success
  * @retval false Failure
+ *
+ * The search carries on from NmMboxData::loaded.  If count stops it before
+ * the end of the results, NmMboxData::loading is set.
  */
-static bool read_mesgs_query(struct Mailbox *mailbox, notmuch_query_t *q, bool dedup)
+static bool read_mesgs_query(struct Mailbox *mailbox, notmuch_query_t *q,
+                             bool dedup, int count)
 {
   struct NmMboxData *mdata = get_mboxdata(mailbox);
   if (!mdata)
@@ -1286,18 +1509,33 @@ static bool read_mesgs_query(struct Mailbox *mailbox, notmuch_query_t *q, bool d
   msgs = notmuch_query_search_messages(q);
 #endif
 
-  for (; notmuch_messages_valid(msgs) && ((limit == 0) || (mailbox->msg_count < limit));
+  int pos = 0;
+  for (; notmuch_messages_valid(msgs) && (pos < mdata->loaded);
        notmuch_messages_move_to_next(msgs))
   {
+    pos++;
+  }
+
+  mdata->loading = false;
+  for (; notmuch_messages_valid(msgs) && ((limit == 0) || (mailbox->msg_count < limit));
+       notmuch_messages_move_to_next(msgs), pos++)
+  {
+    if ((count > 0) && (pos >= mdata->loaded + count))
+    {
+      mdata->loading = true;
+      break;
+    }
     if (SigInt == 1)
     {
       SigInt = 0;
+      mdata->loaded = pos;
       return false;
     }
     notmuch_message_t *m = notmuch_messages_get(msgs);
     append_message(mailbox, q, m, dedup);
     notmuch_message_destroy(m);
   }
+  mdata->loaded = pos;
   return true;
 }
 
@@ -1799,6 +2037,111 @@ void nm_longrun_done(struct Mailbox *mailbox)
     mutt_debug(2, "nm: long run deinitialized\n");
 }
 
+/**
+ * nm_tags_bulk_begin - Start changing the tags of many emails
+ * @param mailbox Mailbox
+ * @retval  0 Success
+ * @retval -1 Failure
+ *
+ * Until nm_tags_bulk_end() is called, every mx_tags_commit() on this mailbox
+ * reuses one writable database and joins one transaction, so the changes are
+ * flushed to Xapian once, rather than once per email.
+ */
+int nm_tags_bulk_begin(struct Mailbox *mailbox)
+{
+  struct NmMboxData *mdata = get_mboxdata(mailbox);
+  if (!mdata || !get_db(mdata, true))
+    return -1;
+
+  mdata->longrun = true;
+  if (db_trans_begin(mdata) < 0)
+  {
+    release_db(mdata);
+    return -1;
+  }
+
+  mutt_debug(2, "nm: bulk tag update started\n");
+  return 0;
+}
+
+/**
+ * nm_tags_bulk_end - Finish changing the tags of many emails
+ * @param mailbox Mailbox
+ *
+ * Commit the transaction started by nm_tags_bulk_begin() and close the
+ * database.
+ */
+void nm_tags_bulk_end(struct Mailbox *mailbox)
+{
+  struct NmMboxData *mdata = get_mboxdata(mailbox);
+  if (!mdata || !mdata->db)
+    return;
+
+  if (db_trans_end(mdata) < 0)
+    mutt_error(_("Could not save the tag changes to the notmuch database"));
+  release_db(mdata);
+  mutt_debug(2, "nm: bulk tag update done\n");
+}
+
+/**
+ * nm_is_loading - Is a vfolder still being loaded?
+ * @param mailbox Mailbox
+ * @retval true More of the query's results are to be loaded
+ */
+bool nm_is_loading(struct Mailbox *mailbox)
+{
+  struct NmMboxData *mdata = get_mboxdata(mailbox);
+  return mdata && mdata->loading;
+}
+
+/**
+ * nm_load_more - Load the next part of a vfolder
+ * @param ctx Mailbox
+ * @retval >0 Number of emails added
+ * @retval  0 Nothing to load
+ * @retval -1 Error
+ *
+ * Opening a vfolder only reads the first $nm_load_chunk results, so that the
+ * index can be shown straight away.  The index calls this between keys to
+ * read the rest.
+ */
+int nm_load_more(struct Context *ctx)
+{
+  if (!ctx)
+    return 0;
+
+  struct NmMboxData *mdata = get_mboxdata(ctx->mailbox);
+  if (!mdata || !mdata->loading)
+    return 0;
+
+  const int oldcount = ctx->mailbox->msg_count;
+  mdata->noprogress = true;
+
+  notmuch_query_t *q = get_query(mdata, false);
+  if (!q)
+  {
+    mdata->loading = false;
+    return -1;
+  }
+
+  /* the database may have changed since the last part was read */
+  const bool ok = read_mesgs_query(ctx->mailbox, q, true, NmLoadChunk);
+  notmuch_query_destroy(q);
+
+  if (!is_longrun(mdata))
+    release_db(mdata);
+
+  if (ctx->mailbox->msg_count > oldcount)
+    mx_update_context(ctx, ctx->mailbox->msg_count - oldcount);
+
+  mutt_debug(2, "nm: loaded %d more [count=%d, loading=%d]\n",
+             ctx->mailbox->msg_count - oldcount, ctx->mailbox->msg_count, mdata->loading);
+
+  if (!ok)
+    return -1;
+  return ctx->mailbox->msg_count - oldcount;
+}
+
 /**
  * nm_debug_check - Check if the database is open
  * @param mailbox Mailbox
@@ -2161,6 +2504,97 @@ int nm_update_filename(struct Mailbox *mailbox, const char *old,
   return rc;
 }
 
+/**
+ * count_cache_free - Free an NmCount - Implements ::hash_destructor_t
+ */
+static void count_cache_free(int type, void *obj, intptr_t data)
+{
+  struct NmCount *count = obj;
+
+  FREE(&count->uuid);
+  FREE(&count);
+}
+
+/**
+ * count_cache_key - Get the key of a vfolder's counts
+ * @param path   Path of the vfolder
+ * @param buf    Buffer for the key
+ * @param buflen Length of the buffer
+ *
+ * The counts also depend on the tags that are excluded, or mean unread.
+ */
+static void count_cache_key(const char *path, char *buf, size_t buflen)
+{
+  snprintf(buf, buflen, "%s\n%s\n%s", path, NONULL(NmExcludeTags), NONULL(NmUnreadTag));
+}
+
+/**
+ * count_cache_get - Get a vfolder's cached counts
+ * @param key      Cache key, see count_cache_key()
+ * @param revision Current revision of the database
+ * @param uuid     UUID of the database
+ * @param mtime    Modification time of the database
+ * @retval ptr  Counts, still up to date
+ * @retval NULL The counts must be recomputed
+ *
+ * The mtime only has a resolution of a second, so a change made in the
+ * second the counts were made is assumed to be missing from them.
+ */
+static struct NmCount *count_cache_get(const char *key, unsigned long revision,
+                                       const char *uuid, time_t mtime)
+{
+  if (!CountCache || !uuid)
+    return NULL;
+
+  struct NmCount *count = mutt_hash_find(CountCache, key);
+  if (!count || (count->revision != revision) ||
+      (mutt_str_strcmp(count->uuid, uuid) != 0) || (count->mtime != mtime) ||
+      (mtime >= count->counted))
+  {
+    return NULL;
+  }
+
+  return count;
+}
+
+/**
+ * count_cache_set - Save a vfolder's counts
+ * @param key      Cache key, see count_cache_key()
+ * @param revision Revision of the database the counts were made at
+ * @param uuid     UUID of the database
+ * @param mtime    Modification time of the database
+ * @param counted  When the counts were made
+ * @param all      Number of messages
+ * @param new      Number of unread messages
+ */
+static void count_cache_set(const char *key, unsigned long revision,
+                            const char *uuid, time_t mtime, time_t counted,
+                            int all, int new)
+{
+  if (!uuid)
+    return;
+
+  if (!CountCache)
+  {
+    CountCache = mutt_hash_create(64, MUTT_HASH_STRDUP_KEYS);
+    mutt_hash_set_destructor(CountCache, count_cache_free, 0);
+  }
+
+  struct NmCount *count = mutt_hash_find(CountCache, key);
+  if (!count)
+  {
+    count = mutt_mem_calloc(1, sizeof(struct NmCount));
+    mutt_hash_insert(CountCache, key, count);
+  }
+
+  count->revision = revision;
+  mutt_str_replace(&count->uuid, uuid);
+  count->mtime = mtime;
+  count->counted = counted;
+  count->all = all;
+  count->new = new;
+}
+
 /**
  * nm_nonctx_get_count - Perform some queries without an open database
  * @param path Notmuch database path
@@ -2176,6 +2610,7 @@ int nm_nonctx_get_count(char *path, int *all, int *new)
   char *url_holder = mutt_str_strdup(path);
   char *db_filename = NULL, *db_query = NULL;
   notmuch_database_t *db = NULL;
+  bool shared = false;
   int rc = -1;
   mutt_debug(1, "nm: count\n");
 
@@ -2213,34 +2648,55 @@ int nm_nonctx_get_count(char *path, int *all, int *new)
 
   /* don't be verbose about connection, as we're called from
    * sidebar/mailbox very often */
-  db = do_database_open(db_filename, false, false);
+  db = get_read_db(db_filename, false, &shared);
   if (!db)
     goto done;
 
+  char key[LONG_STRING];
+  unsigned long revision = 0;
+  const char *uuid = NULL;
+  time_t mtime = 0;
+  const time_t counted = time(NULL);
+
+  count_cache_key(path, key, sizeof(key));
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+  if (database_file_mtime(db_filename, &mtime) == 0)
+    revision = notmuch_database_get_revision(db, &uuid);
+#endif
+
+  struct NmCount *count = count_cache_get(key, revision, uuid, mtime);
+  if (count)
+  {
+    mutt_debug(2, "nm: count cached at revision %lu\n", revision);
+    if (all)
+      *all = count->all;
+    if (new)
+      *new = count->new;
+    rc = 0;
+    goto done;
+  }
+
   /* all emails */
-  if (all)
-    *all = count_query(db, db_query);
+  int num_all = count_query(db, db_query);
 
   /* new messages */
-  if (new)
-  {
-    char *qstr = NULL;
+  char *qstr = NULL;
+  safe_asprintf(&qstr, "( %s ) tag:%s", db_query, NmUnreadTag);
+  int num_new = count_query(db, qstr);
+  FREE(&qstr);
 
-    safe_asprintf(&qstr, "( %s ) tag:%s", db_query, NmUnreadTag);
-    *new = count_query(db, qstr);
-    FREE(&qstr);
-  }
+  count_cache_set(key, revision, uuid, mtime, counted, num_all, num_new);
+  if (all)
+    *all = num_all;
+  if (new)
+    *new = num_new;
 
   rc = 0;
 done:
   if (db)
   {
-#ifdef NOTMUCH_API_3
-    notmuch_database_destroy(db);
-#else
-    notmuch_database_close(db);
-#endif
-    mutt_debug(1, "nm: count close DB\n");
+    put_read_db(&db, shared);
+    mutt_debug(1, "nm: count release DB\n");
   }
   url_free(&url);
   FREE(&url_holder);
@@ -2412,11 +2868,13 @@ static int nm_mbox_open(struct Context *ctx)
   notmuch_query_t *q = get_query(mdata, false);
   if (q)
   {
+    save_database_revision(mdata);
     rc = 0;
     switch (mdata->query_type)
     {
       case NM_QUERY_TYPE_MESGS:
-        if (!read_mesgs_query(ctx->mailbox, q, false))
+        mdata->loaded = 0;
+        if (!read_mesgs_query(ctx->mailbox, q, false, NmLoadChunk))
           rc = -2;
         break;
       case NM_QUERY_TYPE_THREADS:
@@ -2441,6 +2899,180 @@ static int nm_mbox_open(struct Context *ctx)
   return rc;
 }
 
+/**
+ * check_message - Merge a message found by a check into the mailbox
+ * @param ctx Mailbox
+ * @param m   Notmuch message
+ * @retval true The tags of the email changed
+ *
+ * New messages are appended.  Existing ones are marked active and their path
+ * and flags are brought up to date.
+ */
+static bool check_message(struct Context *ctx, notmuch_message_t *m)
+{
+  char old[PATH_MAX];
+  const char *new = NULL;
+
+  struct Email *e = get_mutt_email(ctx->mailbox, m);
+  if (!e)
+  {
+    /* new email */
+    append_message(ctx->mailbox, NULL, m, 0);
+    return false;
+  }
+
+  /* message already exists, merge flags */
+  e->active = true;
+
+  /* Check to see if the message has moved to a different subdirectory.
+   * If so, update the associated filename.
+   */
+  new = get_message_last_filename(m);
+  email_get_fullpath(e, old, sizeof(old));
+
+  if (mutt_str_strcmp(old, new) != 0)
+    update_message_path(e, new);
+
+  if (!e->changed)
+  {
+    /* if the user hasn't modified the flags on
+     * this message, update the flags we just
+     * detected.
+     */
+    struct Email tmp = { 0 };
+    maildir_parse_flags(&tmp, new);
+    maildir_update_flags(ctx, e, &tmp);
+  }
+
+  return (update_email_tags(e, m) == 0);
+}
+
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+/**
+ * check_removed - Have any emails been removed from the database?
+ * @param ctx  Mailbox
+ * @param db   Notmuch database
+ * @param qstr Query string of the mailbox
+ * @retval  0 The mailbox doesn't hold more emails than the query matches
+ * @retval -1 Some have gone, the whole query must be read
+ */
+static int check_removed(struct Context *ctx, notmuch_database_t *db, const char *qstr)
+{
+  unsigned int active = 0;
+  for (int i = 0; i < ctx->mailbox->msg_count; i++)
+  {
+    if (ctx->mailbox->hdrs[i]->active)
+      active++;
+  }
+
+  const unsigned int count = count_query(db, qstr);
+  if (active <= count)
+    return 0;
+
+  mutt_debug(1, "nm: %u active emails, but the query matches %u\n", active, count);
+  return -1;
+}
+
+/**
+ * check_changed - Apply the changes made since a revision of the database
+ * @param ctx       Mailbox
+ * @param mdata     Notmuch Mailbox data
+ * @param since     Revision the mailbox is up to date with
+ * @param rev       Current revision of the database
+ * @param new_flags Number of emails whose tags changed
+ * @retval  0 Success
+ * @retval -1 Error, or the whole query must be read
+ *
+ * Only the messages changed since the revision are read: the ones that still
+ * match the query are merged, the others are marked inactive.
+ *
+ * A message that's removed from the database leaves nothing to search for.
+ * If the mailbox ends up with more active emails than the query matches,
+ * the caller has to read the whole query.
+ */
+static int check_changed(struct Context *ctx, struct NmMboxData *mdata,
+                         unsigned long since, unsigned long rev, int *new_flags)
+{
+  notmuch_database_t *db = get_db(mdata, false);
+  const char *str = get_query_string(mdata, true);
+  if (!db || !str)
+    return -1;
+
+  char lastmod[64];
+  snprintf(lastmod, sizeof(lastmod), "lastmod:%lu..%lu", since + 1, rev);
+
+  /* everything that changed, whether it matches or not */
+  notmuch_query_t *q = notmuch_query_create(db, lastmod);
+  if (!q)
+    return -1;
+
+  notmuch_messages_t *msgs = NULL;
+#if LIBNOTMUCH_CHECK_VERSION(5, 0, 0)
+  if (notmuch_query_search_messages(q, &msgs) != NOTMUCH_STATUS_SUCCESS)
+    msgs = NULL;
+#else
+  if (notmuch_query_search_messages_st(q, &msgs) != NOTMUCH_STATUS_SUCCESS)
+    msgs = NULL;
+#endif
+  if (!msgs)
+  {
+    notmuch_query_destroy(q);
+    return -1;
+  }
+
+  int changed = 0;
+  for (; notmuch_messages_valid(msgs); notmuch_messages_move_to_next(msgs))
+  {
+    notmuch_message_t *m = notmuch_messages_get(msgs);
+    struct Email *e = get_mutt_email(ctx->mailbox, m);
+    if (e)
+      e->active = false;
+    notmuch_message_destroy(m);
+    changed++;
+  }
+  notmuch_query_destroy(q);
+
+  mutt_debug(1, "nm: %d messages changed since revision %lu\n", changed, since);
+  if (changed == 0)
+    return check_removed(ctx, db, str);
+
+  /* the ones that still match */
+  size_t qlen = strlen(str) + sizeof(lastmod) + 16;
+  char *qstr = mutt_mem_malloc(qlen);
+  snprintf(qstr, qlen, "(%s) and %s", str, lastmod);
+  q = notmuch_query_create(db, qstr);
+  FREE(&qstr);
+  if (!q)
+    return -1;
+
+  apply_exclude_tags(q);
+  notmuch_query_set_sort(q, NOTMUCH_SORT_NEWEST_FIRST);
+
+  msgs = NULL;
+#if LIBNOTMUCH_CHECK_VERSION(5, 0, 0)
+  if (notmuch_query_search_messages(q, &msgs) != NOTMUCH_STATUS_SUCCESS)
+    msgs = NULL;
+#else
+  if (notmuch_query_search_messages_st(q, &msgs) != NOTMUCH_STATUS_SUCCESS)
+    msgs = NULL;
+#endif
+
+  for (; msgs && notmuch_messages_valid(msgs); notmuch_messages_move_to_next(msgs))
+  {
+    notmuch_message_t *m = notmuch_messages_get(msgs);
+    if (check_message(ctx, m))
+      (*new_flags)++;
+    notmuch_message_destroy(m);
+  }
+  notmuch_query_destroy(q);
+
+  if (!msgs)
+    return -1;
+
+  return check_removed(ctx, db, str);
+}
+#endif
+
 /**
  * nm_mbox_check - Implements MxOps::mbox_check()
  * @param ctx         Mailbox
@@ -2470,19 +3102,45 @@ static int nm_mbox_check(struct Context *ctx, int *index_hint)
 
   mutt_debug(1, "nm: checking (db=%lu mailbox=%lu)\n", mtime, ctx->mailbox->mtime);
 
-  notmuch_query_t *q = get_query(mdata, false);
+  mdata->oldmsgcount = ctx->mailbox->msg_count;
+  mdata->noprogress = true;
+
+  int limit = get_limit(mdata);
+  notmuch_query_t *q = NULL;
+
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+  /* If the mailbox holds all the results of a messages query, only read what
+   * changed since the last time. */
+  const unsigned long since = mdata->revision;
+  if ((since != 0) && !mdata->loading && (limit == 0) &&
+      (mdata->query_type == NM_QUERY_TYPE_MESGS))
+  {
+    unsigned long rev = 0;
+    const char *uuid = NULL;
+    if ((get_database_revision(mdata, &rev, &uuid) == 0) && mdata->db_uuid &&
+        (mutt_str_strcmp(uuid, mdata->db_uuid) == 0) && (rev >= since))
+    {
+      mutt_debug(1, "nm: start checking changes (revision %lu..%lu)\n", since, rev);
+      save_database_revision(mdata);
+      if (check_changed(ctx, mdata, since, rev, &new_flags) == 0)
+        goto checked;
+
+      /* fall back to reading the whole query */
+      mdata->revision = 0;
+    }
+  }
+#endif
+
+  q = get_query(mdata, false);
   if (!q)
     goto done;
 
   mutt_debug(1, "nm: start checking (count=%d)\n", ctx->mailbox->msg_count);
-  mdata->oldmsgcount = ctx->mailbox->msg_count;
-  mdata->noprogress = true;
+  save_database_revision(mdata);
 
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
     ctx->mailbox->hdrs[i]->active = false;
 
-  int limit = get_limit(mdata);
-
   notmuch_messages_t *msgs = NULL;
 #if LIBNOTMUCH_CHECK_VERSION(5, 0, 0)
   if (notmuch_query_search_messages(q, &msgs) != NOTMUCH_STATUS_SUCCESS)
@@ -2497,49 +3155,18 @@ static int nm_mbox_check(struct Context *ctx, int *index_hint)
   for (int i = 0; notmuch_messages_valid(msgs) && ((limit == 0) || (i < limit));
        notmuch_messages_move_to_next(msgs), i++)
   {
-    char old[PATH_MAX];
-    const char *new = NULL;
-
     notmuch_message_t *m = notmuch_messages_get(msgs);
-    struct Email *e = get_mutt_email(ctx->mailbox, m);
-
-    if (!e)
-    {
-      /* new email */
-      append_message(ctx->mailbox, NULL, m, 0);
-      notmuch_message_destroy(m);
-      continue;
-    }
-
-    /* message already exists, merge flags */
-    e->active = true;
-
-    /* Check to see if the message has moved to a different subdirectory.
-     * If so, update the associated filename.
-     */
-    new = get_message_last_filename(m);
-    email_get_fullpath(e, old, sizeof(old));
-
-    if (mutt_str_strcmp(old, new) != 0)
-      update_message_path(e, new);
-
-    if (!e->changed)
-    {
-      /* if the user hasn't modified the flags on
-       * this message, update the flags we just
-       * detected.
-       */
-      struct Email tmp = { 0 };
-      maildir_parse_flags(&tmp, new);
-      maildir_update_flags(ctx, e, &tmp);
-    }
-
-    if (update_email_tags(e, m) == 0)
+    if (check_message(ctx, m))
       new_flags++;
-
     notmuch_message_destroy(m);
   }
 
+  /* everything up to the limit has been read now */
+  mdata->loading = false;
+
+#if LIBNOTMUCH_CHECK_VERSION(4, 3, 0)
+checked:
+#endif
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
   {
     if (!ctx->mailbox->hdrs[i]->active)
@@ -2595,6 +3222,11 @@ static int nm_mbox_sync(struct Context *ctx, int *index_hint)
                        ctx->mailbox->msg_count);
   }
 
+  /* all the renames and removals share one transaction */
+  int trans = -1;
+  if (get_db(mdata, true))
+    trans = db_trans_begin(mdata);
+
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
   {
     char old[PATH_MAX], new[PATH_MAX];
@@ -2643,6 +3275,9 @@ static int nm_mbox_sync(struct Context *ctx, int *index_hint)
     FREE(&edata->oldpath);
   }
 
+  if (trans == 1)
+    db_trans_end(mdata);
+
   mutt_str_strfcpy(ctx->mailbox->path, uri, sizeof(ctx->mailbox->path));
   ctx->mailbox->magic = MUTT_NOTMUCH;
 
@@ -2833,11 +3468,14 @@ struct MxOps mx_notmuch_ops = {
   .mbox_check       = nm_mbox_check,
   .mbox_sync        = nm_mbox_sync,
   .mbox_close       = nm_mbox_close,
+  .mbox_flush       = NULL,
   .msg_open         = nm_msg_open,
   .msg_open_new     = NULL,
   .msg_commit       = nm_msg_commit,
   .msg_close        = nm_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = nm_tags_edit,
   .tags_commit      = nm_tags_commit,
   .path_probe       = nm_path_probe,
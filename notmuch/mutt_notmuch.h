@@ -45,6 +45,7 @@ struct NmMboxData;
 extern int   NmDbLimit;
 extern char *NmDefaultUri;
 extern char *NmExcludeTags;
+extern int   NmLoadChunk;
 extern int   NmOpenTimeout;
 extern char *NmQueryType;
 extern int   NmQueryWindowCurrentPosition;
@@ -58,6 +59,8 @@ void  nm_debug_check             (struct Mailbox *mailbox);
 int   nm_description_to_path     (const char *desc, char *buf, size_t buflen);
 int   nm_get_all_tags            (struct Mailbox *mailbox, char **tag_list, int *tag_count);
 char *nm_email_get_folder        (struct Email *e);
+bool  nm_is_loading              (struct Mailbox *mailbox);
+int   nm_load_more               (struct Context *ctx);
 void  nm_longrun_done            (struct Mailbox *mailbox);
 void  nm_longrun_init            (struct Mailbox *mailbox, bool writable);
 bool  nm_message_is_still_queried(struct Mailbox *mailbox, struct Email *e);
@@ -69,6 +72,8 @@ void  nm_query_window_backward   (void);
 void  nm_query_window_forward    (void);
 int   nm_read_entire_thread      (struct Context *ctx, struct Email *e);
 int   nm_record_message          (struct Mailbox *mailbox, char *path, struct Email *e);
+int   nm_tags_bulk_begin         (struct Mailbox *mailbox);
+void  nm_tags_bulk_end           (struct Mailbox *mailbox);
 int   nm_update_filename         (struct Mailbox *mailbox, const char *old, const char *new, struct Email *e);
 char *nm_uri_from_query          (struct Mailbox *mailbox, char *buf, size_t buflen);
 
@@ -43,6 +43,8 @@ WHERE bool OptNews;                 /**< (pseudo) used to change reader mode */
 WHERE bool OptNewsSend;            /**< (pseudo) used to change behavior when posting */
 #endif
 WHERE bool OptNoCurses;            /**< (pseudo) when sending in batch mode */
+WHERE bool OptNoPrompt;            /**< (pseudo) answer quad-option questions with their default */
+WHERE bool OptPartialFetch;        /**< (pseudo) the message is only going to be displayed */
 WHERE bool OptPgpCheckTrust;      /**< (pseudo) used by pgp_select_key () */
 WHERE bool OptRedrawTree;          /**< (pseudo) redraw the thread tree */
 WHERE bool OptResortInit;          /**< (pseudo) used to force the next resort to be from scratch */
@@ -25,10 +25,13 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <poll.h>
 #include <regex.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <wchar.h>
 #include "mutt/mutt.h"
@@ -81,6 +84,7 @@ bool HeaderColorPartial; ///< Config: Only colour the part of the header matchin
 short PagerContext; ///< Config: Number of lines of overlap when changing pages in the pager
 short PagerIndexLines; ///< Config: Number of index lines to display above the pager
 bool PagerStop; ///< Config: Don't automatically open the next message when at the end of a message
+bool PagerStream; ///< Config: Show a message while it's being decoded
 short SearchContext; ///< Config: Context to display around search matches
 short SkipQuotedOffset; ///< Config: Lines of context to show when skipping quoted text
 bool SmartWrap;         ///< Config: Wrap text at word boundaries
@@ -103,6 +107,12 @@ static const char *Function_not_permitted_in_attach_message_mode =
 static int TopLine = 0;
 static struct Email *OldHdr = NULL;
 
+/* The pager that's waiting for keys */
+static struct PagerRedrawData *CurrentPager = NULL;
+
+/* Number of lines searched at a time, while waiting for keys */
+#define SEARCH_CHUNK 1000
+
 #define CHECK_MODE(x)                                                          \
   if (!(x))                                                                    \
   {                                                                            \
@@ -166,13 +176,16 @@ struct Line
 {
   LOFF_T offset;
   short type;
-  short continuation;
-  short chunks;
+  short chunks;             /**< number of syntax spans, -1 if not resolved yet */
   short search_cnt;
+  bool continuation : 1;    /**< this line is wrapped from the previous one */
+  bool is_cont_hdr : 1;     /**< this line is a continuation of the previous header line */
+  int color;                /**< colour of a header or log line */
+  int cont_line;            /**< first line of a wrapped line */
+  int cont_offset;          /**< offset of this continuation in its first line */
   struct Syntax *syntax;
   struct Syntax *search;
   struct QClass *quote;
-  unsigned int is_cont_hdr; /**< this line is a continuation of the previous header line */
 };
 
 #define ANSI_OFF (1 << 0)
@@ -275,19 +288,19 @@ static void resolve_color(struct Line *line_info, int n, int cnt, int flags,
       addch('+');
       last_color = ColorDefs[MT_COLOR_MARKERS];
     }
-    m = (line_info[n].syntax)[0].first;
-    cnt += (line_info[n].syntax)[0].last;
+    m = line_info[n].cont_line;
+    cnt += line_info[n].cont_offset;
   }
   else
     m = n;
   if (flags & MUTT_PAGER_LOGS)
   {
-    def_color = ColorDefs[(line_info[n].syntax)[0].color];
+    def_color = ColorDefs[line_info[n].color];
   }
   else if (!(flags & MUTT_SHOWCOLOR))
     def_color = ColorDefs[MT_COLOR_NORMAL];
   else if (line_info[m].type == MT_COLOR_HEADER)
-    def_color = (line_info[m].syntax)[0].color;
+    def_color = line_info[m].color;
   else
     def_color = ColorDefs[line_info[m].type];
 
@@ -393,6 +406,26 @@ static void resolve_color(struct Line *line_info, int n, int cnt, int flags,
   }
 }
 
+/**
+ * init_lines - Reset some Lines to their unscanned state
+ * @param line_info Array of Line info
+ * @param num       Number of Lines
+ *
+ * The syntax and search spans must already have been freed.
+ */
+static void init_lines(struct Line *line_info, int num)
+{
+  memset(line_info, 0, num * sizeof(struct Line));
+  for (int i = 0; i < num; i++)
+  {
+    line_info[i].type = -1;
+    line_info[i].chunks = -1;
+    line_info[i].search_cnt = -1;
+    line_info[i].cont_line = -1;
+    line_info[i].cont_offset = -1;
+  }
+}
+
 /**
  * append_line - Add a new Line to the array
  * @param line_info Array of Line info
@@ -404,17 +437,17 @@ static void append_line(struct Line *line_info, int n, int cnt)
   int m;
 
   line_info[n + 1].type = line_info[n].type;
-  (line_info[n + 1].syntax)[0].color = (line_info[n].syntax)[0].color;
-  line_info[n + 1].continuation = 1;
+  line_info[n + 1].color = line_info[n].color;
+  line_info[n + 1].continuation = true;
 
   /* find the real start of the line */
   for (m = n; m >= 0; m--)
     if (line_info[m].continuation == 0)
       break;
 
-  (line_info[n + 1].syntax)[0].first = m;
-  (line_info[n + 1].syntax)[0].last =
-      (line_info[n].continuation) ? cnt + (line_info[n].syntax)[0].last : cnt;
+  line_info[n + 1].cont_line = m;
+  line_info[n + 1].cont_offset =
+      (line_info[n].continuation) ? cnt + line_info[n].cont_offset : cnt;
 }
 
 /**
@@ -880,9 +913,7 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
 {
   struct ColorLine *color_line = NULL;
   regmatch_t pmatch[1];
-  bool found;
-  bool null_rx;
-  int offset, i = 0;
+  int i = 0;
 
   if (n == 0 || ISHEADER(line_info[n - 1].type))
   {
@@ -900,8 +931,8 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
         line_info[n].type = line_info[n - 1].type; /* wrapped line */
         if (!HeaderColorPartial)
         {
-          (line_info[n].syntax)[0].color = (line_info[n - 1].syntax)[0].color;
-          line_info[n].is_cont_hdr = 1;
+          line_info[n].color = line_info[n - 1].color;
+          line_info[n].is_cont_hdr = true;
         }
       }
       else
@@ -920,7 +951,7 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
           if (regexec(&color_line->regex, buf, 0, NULL, 0) == 0)
           {
             line_info[n].type = MT_COLOR_HEADER;
-            line_info[n].syntax[0].color = color_line->pair;
+            line_info[n].color = color_line->pair;
             if (line_info[n].is_cont_hdr)
             {
               /* adjust the previous continuation lines to reflect the color of this continuation line */
@@ -928,13 +959,13 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
               for (j = n - 1; j >= 0 && line_info[j].is_cont_hdr; --j)
               {
                 line_info[j].type = line_info[n].type;
-                line_info[j].syntax[0].color = line_info[n].syntax[0].color;
+                line_info[j].color = line_info[n].color;
               }
               /* now adjust the first line of this header field */
               if (j >= 0)
               {
                 line_info[j].type = line_info[n].type;
-                line_info[j].syntax[0].color = line_info[n].syntax[0].color;
+                line_info[j].color = line_info[n].color;
               }
               *force_redraw = true; /* the previous lines have already been drawn on the screen */
             }
@@ -958,11 +989,9 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
             line_info[i].type == MT_COLOR_HEADER))
     {
       /* oops... */
-      if (line_info[i].chunks)
-      {
-        line_info[i].chunks = 0;
-        mutt_mem_realloc(&(line_info[n].syntax), sizeof(struct Syntax));
-      }
+      if (line_info[i].chunks > 0)
+        FREE(&(line_info[i].syntax));
+      line_info[i].chunks = 0;
       line_info[i++].type = MT_COLOR_SIGNATURE;
     }
   }
@@ -981,146 +1010,142 @@ static void resolve_types(char *buf, char *raw, struct Line *line_info, int n,
   }
   else
     line_info[n].type = MT_COLOR_NORMAL;
+}
 
-  /* body patterns */
-  if (line_info[n].type == MT_COLOR_NORMAL || line_info[n].type == MT_COLOR_QUOTED ||
-      (line_info[n].type == MT_COLOR_HDEFAULT && HeaderColorPartial))
-  {
-    size_t nl;
+#ifdef REG_STARTEND
+/* First match of each colour pattern, used by resolve_syntax() */
+static regmatch_t *NextSpans = NULL;
+static int MaxNextSpans = 0;
+#endif
 
-    /* don't consider line endings part of the buffer
-     * for regex matching */
-    nl = mutt_str_strlen(buf);
-    if ((nl > 0) && (buf[nl - 1] == '\n'))
-      buf[nl - 1] = 0;
+/**
+ * resolve_syntax - Find the coloured spans of a line of text
+ * @param buf       Formatted text
+ * @param line_info Line info array
+ * @param n         Line number (index into line_info)
+ *
+ * This runs the body, header or attachment patterns over the line.  It's
+ * expensive, so it's only done for the lines that get displayed, once
+ * resolve_types() has determined the line's type.
+ */
+static void resolve_syntax(char *buf, struct Line *line_info, int n)
+{
+  struct ColorLine *color_line = NULL;
+  struct ColorLineHead *head = NULL;
+  regmatch_t pmatch[1];
+  bool found;
+  bool null_rx;
+  int offset, i = 0;
+  size_t nl;
 
-    i = 0;
-    offset = 0;
-    line_info[n].chunks = 0;
-    do
-    {
-      if (!buf[offset])
-        break;
+  line_info[n].chunks = 0;
 
-      found = false;
-      null_rx = false;
-      struct ColorLineHead *head = NULL;
-      if (line_info[n].type == MT_COLOR_HDEFAULT)
-        head = &ColorHdrList;
-      else
-        head = &ColorBodyList;
-      STAILQ_FOREACH(color_line, head, entries)
-      {
-        if (regexec(&color_line->regex, buf + offset, 1, pmatch,
-                    (offset ? REG_NOTBOL : 0)) == 0)
-        {
-          if (pmatch[0].rm_eo != pmatch[0].rm_so)
-          {
-            if (!found)
-            {
-              /* Abort if we fill up chunks.
-               * Yes, this really happened. See #3888 */
-              if (line_info[n].chunks == SHRT_MAX)
-              {
-                null_rx = false;
-                break;
-              }
-              if (++(line_info[n].chunks) > 1)
-              {
-                mutt_mem_realloc(&(line_info[n].syntax),
-                                 (line_info[n].chunks) * sizeof(struct Syntax));
-              }
-            }
-            i = line_info[n].chunks - 1;
-            pmatch[0].rm_so += offset;
-            pmatch[0].rm_eo += offset;
-            if (!found || pmatch[0].rm_so < (line_info[n].syntax)[i].first ||
-                (pmatch[0].rm_so == (line_info[n].syntax)[i].first &&
-                 pmatch[0].rm_eo > (line_info[n].syntax)[i].last))
-            {
-              (line_info[n].syntax)[i].color = color_line->pair;
-              (line_info[n].syntax)[i].first = pmatch[0].rm_so;
-              (line_info[n].syntax)[i].last = pmatch[0].rm_eo;
-            }
-            found = true;
-            null_rx = false;
-          }
-          else
-            null_rx = true; /* empty regex; don't add it, but keep looking */
-        }
-      }
+  if (line_info[n].type == MT_COLOR_NORMAL || line_info[n].type == MT_COLOR_QUOTED)
+    head = &ColorBodyList;
+  else if (line_info[n].type == MT_COLOR_HDEFAULT && HeaderColorPartial)
+    head = &ColorHdrList;
+  else if (line_info[n].type == MT_COLOR_ATTACHMENT)
+    head = &ColorAttachList;
+  else
+    return;
 
-      if (null_rx)
-        offset++; /* avoid degenerate cases */
-      else
-        offset = (line_info[n].syntax)[i].last;
-    } while (found || null_rx);
-    if (nl > 0)
-      buf[nl] = '\n';
+  /* don't consider line endings part of the buffer for regex matching */
+  nl = mutt_str_strlen(buf);
+  if ((nl > 0) && (buf[nl - 1] == '\n'))
+    buf[nl - 1] = 0;
+
+#ifdef REG_STARTEND
+  /* Each pattern is searched once for the whole line, its first span is
+   * remembered.  It's only searched again when a chosen span overlaps it. */
+  const regoff_t len = mutt_str_strlen(buf);
+  int num = 0;
+  STAILQ_FOREACH(color_line, head, entries)
+  {
+    num++;
   }
-
-  /* attachment patterns */
-  if (line_info[n].type == MT_COLOR_ATTACHMENT)
+  if (num > MaxNextSpans)
   {
-    size_t nl;
+    MaxNextSpans = num;
+    mutt_mem_realloc(&NextSpans, num * sizeof(regmatch_t));
+  }
+  for (int j = 0; j < num; j++)
+    NextSpans[j].rm_so = -1;
+#endif
 
-    /* don't consider line endings part of the buffer for regex matching */
-    nl = mutt_str_strlen(buf);
-    if ((nl > 0) && (buf[nl - 1] == '\n'))
-      buf[nl - 1] = 0;
+  offset = 0;
+  do
+  {
+    if (!buf[offset])
+      break;
 
-    i = 0;
-    offset = 0;
-    line_info[n].chunks = 0;
-    do
+    found = false;
+    null_rx = false;
+#ifdef REG_STARTEND
+    regmatch_t *next = NextSpans;
+#endif
+    STAILQ_FOREACH(color_line, head, entries)
     {
-      if (!buf[offset])
-        break;
-
-      found = false;
-      null_rx = false;
-      STAILQ_FOREACH(color_line, &ColorAttachList, entries)
+#ifdef REG_STARTEND
+      /* a span found from an earlier offset is still the first one */
+      if (next->rm_so < offset)
+      {
+        next->rm_so = offset;
+        next->rm_eo = len;
+        if (regexec(&color_line->regex, buf, 1, next,
+                    REG_STARTEND | (offset ? REG_NOTBOL : 0)) != 0)
+        {
+          next->rm_so = len + 1; /* never again */
+        }
+      }
+      pmatch[0] = *next++;
+      if (pmatch[0].rm_so <= len)
+#else
+      if (regexec(&color_line->regex, buf + offset, 1, pmatch,
+                  (offset ? REG_NOTBOL : 0)) == 0)
+#endif
       {
-        if (regexec(&color_line->regex, buf + offset, 1, pmatch,
-                    (offset ? REG_NOTBOL : 0)) == 0)
+        if (pmatch[0].rm_eo != pmatch[0].rm_so)
         {
-          if (pmatch[0].rm_eo != pmatch[0].rm_so)
+          if (!found)
           {
-            if (!found)
-            {
-              if (++(line_info[n].chunks) > 1)
-              {
-                mutt_mem_realloc(&(line_info[n].syntax),
-                                 (line_info[n].chunks) * sizeof(struct Syntax));
-              }
-            }
-            i = line_info[n].chunks - 1;
-            pmatch[0].rm_so += offset;
-            pmatch[0].rm_eo += offset;
-            if (!found || pmatch[0].rm_so < (line_info[n].syntax)[i].first ||
-                (pmatch[0].rm_so == (line_info[n].syntax)[i].first &&
-                 pmatch[0].rm_eo > (line_info[n].syntax)[i].last))
+            /* Abort if we fill up chunks.
+             * Yes, this really happened. See #3888 */
+            if (line_info[n].chunks == SHRT_MAX)
             {
-              (line_info[n].syntax)[i].color = color_line->pair;
-              (line_info[n].syntax)[i].first = pmatch[0].rm_so;
-              (line_info[n].syntax)[i].last = pmatch[0].rm_eo;
+              null_rx = false;
+              break;
             }
-            found = 1;
-            null_rx = 0;
+            mutt_mem_realloc(&(line_info[n].syntax),
+                             (++(line_info[n].chunks)) * sizeof(struct Syntax));
           }
-          else
-            null_rx = 1; /* empty regex; don't add it, but keep looking */
+          i = line_info[n].chunks - 1;
+#ifndef REG_STARTEND
+          pmatch[0].rm_so += offset;
+          pmatch[0].rm_eo += offset;
+#endif
+          if (!found || pmatch[0].rm_so < (line_info[n].syntax)[i].first ||
+              (pmatch[0].rm_so == (line_info[n].syntax)[i].first &&
+               pmatch[0].rm_eo > (line_info[n].syntax)[i].last))
+          {
+            (line_info[n].syntax)[i].color = color_line->pair;
+            (line_info[n].syntax)[i].first = pmatch[0].rm_so;
+            (line_info[n].syntax)[i].last = pmatch[0].rm_eo;
+          }
+          found = true;
+          null_rx = false;
         }
+        else
+          null_rx = true; /* empty regex; don't add it, but keep looking */
       }
+    }
 
-      if (null_rx)
-        offset++; /* avoid degenerate cases */
-      else
-        offset = (line_info[n].syntax)[i].last;
-    } while (found || null_rx);
-    if (nl > 0)
-      buf[nl] = '\n';
-  }
+    if (null_rx)
+      offset++; /* avoid degenerate cases */
+    else if (found)
+      offset = (line_info[n].syntax)[i].last;
+  } while (found || null_rx);
+  if (nl > 0)
+    buf[nl] = '\n';
 }
 
 /**
@@ -1547,15 +1572,29 @@ static int display_line(FILE *f, LOFF_T *last_pos, struct Line **line_info, int
 
   if (*last == *max)
   {
-    mutt_mem_realloc(line_info, sizeof(struct Line) * (*max += LINES));
-    for (ch = *last; ch < *max; ch++)
+    /* grow geometrically, a long message can have millions of lines */
+    const int old_max = *max;
+    *max += MAX(LINES, old_max);
+    mutt_mem_realloc_tag(MEM_TAG_PAGER, line_info, sizeof(struct Line) * old_max,
+                         sizeof(struct Line) * *max);
+    init_lines(*line_info + old_max, *max - old_max);
+  }
+
+  /* a continuation line is coloured by the spans of its first line, which
+   * may have been scanned without being displayed */
+  if ((flags & MUTT_SHOWCOLOR) && (*line_info)[n].continuation)
+  {
+    m = (*line_info)[n].cont_line;
+    if (((*line_info)[m].chunks == -1) && ((*line_info)[m].type != -1))
     {
-      memset(&((*line_info)[ch]), 0, sizeof(struct Line));
-      (*line_info)[ch].type = -1;
-      (*line_info)[ch].search_cnt = -1;
-      (*line_info)[ch].syntax = mutt_mem_malloc(sizeof(struct Syntax));
-      ((*line_info)[ch].syntax)[0].first = -1;
-      ((*line_info)[ch].syntax)[0].last = -1;
+      unsigned char *hbuf = NULL, *hfmt = NULL;
+      size_t hlen = 0;
+      int hready = 0;
+
+      if (fill_buffer(f, last_pos, (*line_info)[m].offset, &hbuf, &hfmt, &hlen, &hready) >= 0)
+        resolve_syntax((char *) hfmt, *line_info, m);
+      FREE(&hbuf);
+      FREE(&hfmt);
     }
   }
 
@@ -1571,11 +1610,11 @@ static int display_line(FILE *f, LOFF_T *last_pos, struct Line **line_info, int
 
     (*line_info)[n].type = MT_COLOR_MESSAGE_LOG;
     if (buf[11] == 'M')
-      (*line_info)[n].syntax[0].color = MT_COLOR_MESSAGE;
+      (*line_info)[n].color = MT_COLOR_MESSAGE;
     else if (buf[11] == 'E')
-      (*line_info)[n].syntax[0].color = MT_COLOR_ERROR;
+      (*line_info)[n].color = MT_COLOR_ERROR;
     else
-      (*line_info)[n].syntax[0].color = MT_COLOR_NORMAL;
+      (*line_info)[n].color = MT_COLOR_NORMAL;
   }
 
   /* only do color highlighting if we are viewing a message */
@@ -1604,6 +1643,18 @@ static int display_line(FILE *f, LOFF_T *last_pos, struct Line **line_info, int
       flags = 0; /* MUTT_NOSHOW */
   }
 
+  if ((flags & MUTT_SHOWCOLOR) && !(*line_info)[n].continuation &&
+      ((*line_info)[n].chunks == -1))
+  {
+    if (fill_buffer(f, last_pos, (*line_info)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
+    {
+      if (change_last)
+        (*last)--;
+      goto out;
+    }
+    resolve_syntax((char *) fmt, *line_info, n);
+  }
+
   /* At this point, (*line_info[n]).quote may still be undefined. We
    * don't want to compute it every time MUTT_TYPES is set, since this
    * would slow down the "bottom" function unacceptably. A compromise
@@ -1759,9 +1810,9 @@ static int display_line(FILE *f, LOFF_T *last_pos, struct Line **line_info, int
    */
   if (flags & MUTT_SHOWCOLOR)
   {
-    m = ((*line_info)[n].continuation) ? ((*line_info)[n].syntax)[0].first : n;
+    m = ((*line_info)[n].continuation) ? (*line_info)[n].cont_line : n;
     if ((*line_info)[m].type == MT_COLOR_HEADER)
-      def_color = ((*line_info)[m].syntax)[0].color;
+      def_color = (*line_info)[m].color;
     else
       def_color = ColorDefs[(*line_info)[m].type];
 
@@ -1844,6 +1895,135 @@ void mutt_clear_pager_position(void)
   OldHdr = NULL;
 }
 
+/**
+ * stream_close - Stop decoding a message
+ * @param ps Stream to close
+ * @retval  0 The message was decoded successfully
+ * @retval -1 The message couldn't be decoded
+ */
+static int stream_close(struct PagerStream *ps)
+{
+  int rc = 0;
+
+  if (ps->fd >= 0)
+  {
+    /* the rest of the message isn't wanted, stop the decoder and any
+     * filters it's running, they share its process group */
+    close(ps->fd);
+    ps->fd = -1;
+    if (ps->pid > 0)
+      kill(-ps->pid, SIGTERM);
+  }
+
+  if (ps->pid > 0)
+  {
+    int st = 0;
+    if ((waitpid(ps->pid, &st, 0) < 0) || !WIFEXITED(st) || (WEXITSTATUS(st) != 0))
+      rc = -1;
+    ps->pid = 0;
+  }
+
+  FREE(&ps->tail);
+  ps->tail_len = 0;
+  ps->tail_max = 0;
+  return rc;
+}
+
+/**
+ * stream_keep - Keep the start of a line until the rest arrives
+ * @param ps  Stream
+ * @param buf Text to keep
+ * @param len Length of text
+ */
+static void stream_keep(struct PagerStream *ps, const char *buf, size_t len)
+{
+  if (len == 0)
+    return;
+
+  if (ps->tail_len + len > ps->tail_max)
+  {
+    ps->tail_max = ps->tail_len + len + LONG_STRING;
+    mutt_mem_realloc(&ps->tail, ps->tail_max);
+  }
+  memcpy(ps->tail + ps->tail_len, buf, len);
+  ps->tail_len += len;
+}
+
+/**
+ * stream_read - Add the next part of a message that's being decoded
+ * @param ps      Stream to read from
+ * @param timeout How long to wait for the message, in milliseconds
+ * @param keys    If true, stop waiting when a key is pressed
+ * @retval >0 Number of lines added to the file
+ * @retval  0 Nothing was added
+ * @retval -1 The message is complete
+ * @retval -2 Nothing arrived before the timeout
+ *
+ * Only complete lines are appended to the file, so that the pager never sees
+ * half of a line.
+ */
+static int stream_read(struct PagerStream *ps, int timeout, bool keys)
+{
+  struct pollfd pfd[2] = { { ps->fd, POLLIN, 0 }, { 0, POLLIN, 0 } };
+  char buf[HUGE_STRING];
+
+  if (ps->fd < 0)
+    return -1;
+
+  const int rc = poll(pfd, keys ? 2 : 1, timeout);
+  if (rc == 0)
+    return -2;
+  if (rc < 0)
+    return 0;
+  if (!(pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+    return 0;
+
+  ssize_t len = read(ps->fd, buf, sizeof(buf));
+  if ((len < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+    return 0;
+
+  if (len <= 0)
+  {
+    /* the last line doesn't have to end in a newline */
+    if (ps->tail_len > 0)
+    {
+      fwrite(ps->tail, 1, ps->tail_len, ps->fp);
+      ps->lines++;
+    }
+    fflush(ps->fp);
+    close(ps->fd);
+    ps->fd = -1;
+    if (stream_close(ps) < 0)
+      mutt_error(_("Could not copy message"));
+    return -1;
+  }
+
+  char *nl = NULL;
+  int lines = 0;
+  for (char *p = buf; (p = memchr(p, '\n', buf + len - p)); p++)
+  {
+    nl = p;
+    lines++;
+  }
+
+  if (!nl)
+  {
+    stream_keep(ps, buf, len);
+    return 0;
+  }
+
+  if (ps->tail_len > 0)
+    fwrite(ps->tail, 1, ps->tail_len, ps->fp);
+  fwrite(buf, 1, nl + 1 - buf, ps->fp);
+  fflush(ps->fp);
+
+  ps->tail_len = 0;
+  stream_keep(ps, nl + 1, buf + len - (nl + 1));
+
+  ps->lines += lines;
+  return lines;
+}
+
 /**
  * struct PagerRedrawData - Keep track when the pager needs redrawing
  */
@@ -1878,11 +2058,266 @@ struct PagerRedrawData
   const char *banner;
   char *helpstr;
   char *searchbuf;
+  int *search_lines; /**< lines that match the search, in order */
+  int search_num;    /**< number of search_lines */
+  int search_max;    /**< size of search_lines */
+  int search_scan;   /**< next line to search, -1 when they all have been */
   struct Line *line_info;
+  struct Line *flow_head; /**< lines above line_info[0] that haven't been wrapped yet */
+  int flow_head_num;      /**< number of flow_head */
+  int flow_cols;          /**< width the lines were wrapped at */
+  bool resized;           /**< the screen has changed size */
   FILE *fp;
   struct stat sb;
+  struct PagerStream *stream; /**< message still being decoded, may be NULL */
 };
 
+/**
+ * mutt_pager_is_loading - Is the pager still working on its message?
+ * @retval true If more of the message will be decoded or searched
+ */
+bool mutt_pager_is_loading(void)
+{
+  if (!CurrentPager)
+    return false;
+  return (CurrentPager->stream && (CurrentPager->stream->fd >= 0)) ||
+         (CurrentPager->search_scan >= 0);
+}
+
+/**
+ * search_reset - Forget the lines that match the search
+ * @param rd PagerRedrawData
+ *
+ * The lines are searched again, from the start, as they're needed.
+ */
+static void search_reset(struct PagerRedrawData *rd)
+{
+  rd->search_num = 0;
+  rd->search_scan = rd->search_compiled ? 0 : -1;
+}
+
+/**
+ * search_scan - Add the next lines to the list of matches
+ * @param rd   PagerRedrawData
+ * @param last Last line to search
+ */
+static void search_scan(struct PagerRedrawData *rd, int last)
+{
+  int i;
+
+  for (i = rd->search_scan; (i >= 0) && (i <= last); i++)
+  {
+    if (display_line(rd->fp, &rd->last_pos, &rd->line_info, i, &rd->last_line,
+                     &rd->max_line,
+                     MUTT_SEARCH | (rd->flags & MUTT_PAGER_NSKIP) | (rd->flags & MUTT_PAGER_NOWRAP),
+                     &rd->quote_list, &rd->q_level, &rd->force_redraw,
+                     &rd->search_re, rd->pager_window) != 0)
+    {
+      /* the end of the message, unless more of it is being decoded */
+      rd->search_scan = (rd->stream && (rd->stream->fd >= 0)) ? i : -1;
+      return;
+    }
+
+    if (!rd->line_info[i].continuation && (rd->line_info[i].search_cnt > 0))
+    {
+      if (rd->search_num == rd->search_max)
+      {
+        rd->search_max += LINES;
+        mutt_mem_realloc(&rd->search_lines, rd->search_max * sizeof(int));
+      }
+      rd->search_lines[rd->search_num++] = i;
+    }
+  }
+  rd->search_scan = i;
+}
+
+/**
+ * search_find - Find the next line that matches the search
+ * @param rd      PagerRedrawData
+ * @param start   Line to search from, it isn't a candidate
+ * @param forward If true, search towards the end of the message
+ * @retval >=0 Matching line
+ * @retval -1  No match
+ *
+ * Only as much of the message is searched as is needed to find the line.
+ */
+static int search_find(struct PagerRedrawData *rd, int start, bool forward)
+{
+  int lo = 0, hi = rd->search_num;
+
+  if (forward)
+  {
+    while (true)
+    {
+      /* first match after start */
+      while (lo < hi)
+      {
+        const int mid = lo + (hi - lo) / 2;
+        if (rd->search_lines[mid] <= start)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+
+      for (; lo < rd->search_num; lo++)
+      {
+        const int i = rd->search_lines[lo];
+        if (!rd->hide_quoted || (rd->line_info[i].type != MT_COLOR_QUOTED))
+          return i;
+      }
+
+      const int scan = rd->search_scan;
+      if (scan < 0)
+        return -1;
+      search_scan(rd, scan + SEARCH_CHUNK);
+      if (rd->search_scan == scan)
+      {
+        /* wait for more of the message to be decoded */
+        if (SigInt)
+          return -1;
+        stream_read(rd->stream, 1000, false);
+        rd->sb.st_size = ftello(rd->stream->fp);
+        clearerr(rd->fp);
+      }
+      hi = rd->search_num;
+    }
+  }
+
+  if ((rd->search_scan >= 0) && (rd->search_scan < start))
+  {
+    search_scan(rd, start - 1);
+    hi = rd->search_num;
+  }
+
+  /* last match before start */
+  while (lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if (rd->search_lines[mid] < start)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (lo--; lo >= 0; lo--)
+  {
+    const int i = rd->search_lines[lo];
+    if (!rd->hide_quoted || (rd->has_types && (rd->line_info[i].type != MT_COLOR_QUOTED)))
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * flow_restore - Give a line back what's known about it
+ * @param l Line to restore
+ * @param k Saved copy of the line, its spans are moved to l
+ */
+static void flow_restore(struct Line *l, struct Line *k)
+{
+  l->type = k->type;
+  l->color = k->color;
+  l->is_cont_hdr = k->is_cont_hdr;
+  l->chunks = k->chunks;
+  l->syntax = k->syntax;
+  l->search_cnt = k->search_cnt;
+  l->search = k->search;
+  l->quote = k->quote;
+  k->syntax = NULL;
+  k->search = NULL;
+}
+
+/**
+ * pager_flow_head - Wrap the lines above the anchor of a resized pager
+ * @param rd PagerRedrawData
+ *
+ * After a resize, only the lines from the top of the screen are wrapped again.
+ * Before the pager looks further up, the lines above are wrapped and put in
+ * front of the others.
+ */
+static void pager_flow_head(struct PagerRedrawData *rd)
+{
+  if (rd->flow_head_num == 0)
+    return;
+
+  int max = rd->flow_head_num + 1;
+  int last = 0;
+  int i, j = 0;
+  struct Line *lines = mutt_mem_malloc_tag(MEM_TAG_PAGER, max * sizeof(struct Line));
+  init_lines(lines, max);
+  lines[0].offset = rd->flow_head[0].offset;
+
+  for (i = 0;; i++)
+  {
+    if (!lines[i].continuation)
+    {
+      if ((j == rd->flow_head_num) || (lines[i].offset != rd->flow_head[j].offset))
+        break;
+      flow_restore(&lines[i], &rd->flow_head[j++]);
+    }
+    if (display_line(rd->fp, &rd->last_pos, &lines, i, &last, &max,
+                     rd->has_types | rd->search_flag | (rd->flags & MUTT_PAGER_NOWRAP),
+                     &rd->quote_list, &rd->q_level, &rd->force_redraw,
+                     &rd->search_re, rd->pager_window) != 0)
+    {
+      break;
+    }
+  }
+
+  const int h = i;
+  if ((j == rd->flow_head_num) && (lines[h].offset == rd->line_info[0].offset))
+  {
+    mutt_mem_realloc_tag(MEM_TAG_PAGER, &rd->line_info, rd->max_line * sizeof(struct Line),
+                         (rd->max_line + h) * sizeof(struct Line));
+    memmove(rd->line_info + h, rd->line_info, rd->max_line * sizeof(struct Line));
+    memcpy(rd->line_info, lines, h * sizeof(struct Line));
+    for (i = h; i < rd->max_line + h; i++)
+      if (rd->line_info[i].cont_line >= 0)
+        rd->line_info[i].cont_line += h;
+
+    rd->max_line += h;
+    rd->last_line += h;
+    rd->topline += h;
+    rd->oldtopline += h;
+    rd->curline += h;
+  }
+  else
+  {
+    /* the message has changed under us, start again from the top */
+    mutt_debug(1, "lines above %d don't match, laying out again\n", rd->topline);
+    for (i = 0; i < h; i++)
+    {
+      FREE(&lines[i].syntax);
+      FREE(&lines[i].search);
+    }
+    for (i = 0; i < rd->max_line; i++)
+    {
+      FREE(&(rd->line_info[i].syntax));
+      FREE(&(rd->line_info[i].search));
+    }
+    init_lines(rd->line_info, rd->max_line);
+    rd->last_line = 0;
+    rd->topline = 0;
+    rd->oldtopline = -1;
+  }
+  search_reset(rd);
+
+  for (i = h; i < max; i++)
+  {
+    FREE(&lines[i].syntax);
+    FREE(&lines[i].search);
+  }
+  mutt_mem_free_tag(MEM_TAG_PAGER, &lines, max * sizeof(struct Line));
+
+  for (i = 0; i < rd->flow_head_num; i++)
+  {
+    FREE(&rd->flow_head[i].syntax);
+    FREE(&rd->flow_head[i].search);
+  }
+  FREE(&rd->flow_head);
+  rd->flow_head_num = 0;
+}
+
 /**
  * pager_custom_redraw - Redraw the pager window - Implements Menu::menu_custom_redraw()
  */
@@ -1911,6 +2346,8 @@ static void pager_custom_redraw(struct Menu *pager_menu)
 
     memcpy(rd->pager_window, MuttIndexWindow, sizeof(struct MuttWindow));
     memcpy(rd->pager_status_window, MuttStatusWindow, sizeof(struct MuttWindow));
+    if (rd->last_line == 0)
+      rd->flow_cols = rd->pager_window->cols;
     rd->index_status_window->rows = 0;
     rd->index_window->rows = 0;
 
@@ -2014,45 +2451,93 @@ static void pager_custom_redraw(struct Menu *pager_menu)
     mutt_show_error();
   }
 
+  if ((pager_menu->redraw & REDRAW_FLOW) && rd->resized &&
+      (rd->flow_cols == rd->pager_window->cols))
+  {
+    /* only the height has changed, the lines still wrap in the same places */
+    pager_menu->redraw &= ~REDRAW_FLOW;
+  }
+  rd->resized = false;
+
   if (pager_menu->redraw & REDRAW_FLOW)
   {
+    bool anchored = false;
+
     if (!(rd->flags & MUTT_PAGER_RETWINCH))
     {
-      rd->lines = -1;
+      rd->lines = rd->flow_head_num - 1;
       for (int i = 0; i <= rd->topline; i++)
         if (!rd->line_info[i].continuation)
           rd->lines++;
+
+      /* The type, colours and search matches of a line don't depend on where
+       * it wraps, so keep them for the lines down to the top of the screen */
+      struct Line *keep = mutt_mem_malloc((rd->flow_head_num + rd->last_line + 1) *
+                                          sizeof(struct Line));
+      int kept = rd->flow_head_num;
+      if (rd->flow_head)
+        memcpy(keep, rd->flow_head, kept * sizeof(struct Line));
+      FREE(&rd->flow_head);
+      rd->flow_head_num = 0;
+
       for (int i = 0; i < rd->max_line; i++)
       {
-        rd->line_info[i].offset = 0;
-        rd->line_info[i].type = -1;
-        rd->line_info[i].continuation = 0;
-        rd->line_info[i].chunks = 0;
-        rd->line_info[i].search_cnt = -1;
-        rd->line_info[i].quote = NULL;
-
-        mutt_mem_realloc(&(rd->line_info[i].syntax), sizeof(struct Syntax));
+        if ((i < rd->last_line) && !rd->line_info[i].continuation && (kept <= rd->lines))
+        {
+          keep[kept++] = rd->line_info[i];
+          continue;
+        }
+        FREE(&(rd->line_info[i].syntax));
         if (rd->search_compiled && rd->line_info[i].search)
           FREE(&(rd->line_info[i].search));
       }
+      init_lines(rd->line_info, rd->max_line);
+      search_reset(rd);
 
       rd->last_line = 0;
       rd->topline = 0;
+
+      if ((rd->lines >= 0) && (rd->lines < kept))
+      {
+        /* Wrap again from the line at the top of the screen.  The lines above
+         * it are only wrapped if they're needed, see pager_flow_head() */
+        rd->line_info[0].offset = keep[rd->lines].offset;
+        flow_restore(&rd->line_info[0], &keep[rd->lines]);
+        rd->flow_head_num = rd->lines;
+        anchored = true;
+      }
+      else
+      {
+        for (int i = 0; i < kept; i++)
+        {
+          FREE(&keep[i].syntax);
+          FREE(&keep[i].search);
+        }
+      }
+
+      if (rd->flow_head_num > 0)
+        rd->flow_head = keep;
+      else
+        FREE(&keep);
     }
-    int i = -1;
-    int j = -1;
-    while (display_line(rd->fp, &rd->last_pos, &rd->line_info, ++i, &rd->last_line,
-                        &rd->max_line, rd->has_types | rd->search_flag | (rd->flags & MUTT_PAGER_NOWRAP),
-                        &rd->quote_list, &rd->q_level, &rd->force_redraw,
-                        &rd->search_re, rd->pager_window) == 0)
+
+    if (!anchored)
     {
-      if (!rd->line_info[i].continuation && ++j == rd->lines)
+      int i = -1;
+      int j = -1;
+      while (display_line(rd->fp, &rd->last_pos, &rd->line_info, ++i, &rd->last_line,
+                          &rd->max_line, rd->has_types | rd->search_flag | (rd->flags & MUTT_PAGER_NOWRAP),
+                          &rd->quote_list, &rd->q_level, &rd->force_redraw,
+                          &rd->search_re, rd->pager_window) == 0)
       {
-        rd->topline = i;
-        if (!rd->search_flag)
+        if (!rd->line_info[i].continuation && ++j == rd->lines)
+        {
+          rd->topline = i;
           break;
+        }
       }
     }
+    rd->flow_cols = rd->pager_window->cols;
   }
 
 #ifdef USE_SIDEBAR
@@ -2122,7 +2607,7 @@ static void pager_custom_redraw(struct Menu *pager_menu)
     }
     else
     {
-      const char *msg = (rd->topline == 0) ?
+      const char *msg = ((rd->topline == 0) && (rd->flow_head_num == 0)) ?
                             /* L10N: Status bar message: the entire email is visible in the pager */
                             _("all") :
                             /* L10N: Status bar message: the end of the email is visible in the pager */
@@ -2216,6 +2701,8 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
 #endif
 
   struct PagerRedrawData rd;
+  struct PagerStream *stream = extra ? extra->stream : NULL;
+  struct PagerRedrawData *old_pager = CurrentPager;
 
   if (!(flags & MUTT_SHOWCOLOR))
     flags |= MUTT_SHOWFLAT;
@@ -2228,12 +2715,28 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
   rd.indicator = rd.indexlen / 3;
   rd.helpstr = helpstr;
   rd.searchbuf = searchbuf;
+  rd.search_scan = -1;
+  rd.stream = stream;
   rd.has_types = (IsHeader(extra) || (flags & MUTT_SHOWCOLOR)) ? MUTT_TYPES : 0; /* main message or rfc822 attachment */
 
+  /* show the message as soon as there's a screenful of it,
+   * or when the decoding pauses */
+  if (stream)
+  {
+    int r;
+    while ((stream->lines < LINES) && ((r = stream_read(stream, 500, false)) != -1))
+    {
+      if ((r == -2) && (stream->lines > 0))
+        break;
+    }
+  }
+
   rd.fp = fopen(fname, "r");
   if (!rd.fp)
   {
     mutt_perror(fname);
+    if (stream)
+      stream_close(stream);
     return -1;
   }
 
@@ -2241,9 +2744,12 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
   {
     mutt_perror(fname);
     mutt_file_fclose(&rd.fp);
+    if (stream)
+      stream_close(stream);
     return -1;
   }
   unlink(fname);
+  CurrentPager = &rd;
 
   /* Initialize variables */
 
@@ -2254,15 +2760,8 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
   }
 
   rd.max_line = LINES; /* number of lines on screen, from curses */
-  rd.line_info = mutt_mem_calloc(rd.max_line, sizeof(struct Line));
-  for (i = 0; i < rd.max_line; i++)
-  {
-    rd.line_info[i].type = -1;
-    rd.line_info[i].search_cnt = -1;
-    rd.line_info[i].syntax = mutt_mem_malloc(sizeof(struct Syntax));
-    (rd.line_info[i].syntax)[0].first = -1;
-    (rd.line_info[i].syntax)[0].last = -1;
-  }
+  rd.line_info = mutt_mem_malloc_tag(MEM_TAG_PAGER, rd.max_line * sizeof(struct Line));
+  init_lines(rd.line_info, rd.max_line);
 
   mutt_compile_help(helpstr, sizeof(helpstr), MENU_PAGER, PagerHelp);
   if (IsHeader(extra))
@@ -2297,7 +2796,9 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
   {
     mutt_curs_set(0);
 
+    mutt_trace_begin("pager_redraw", NULL);
     pager_custom_redraw(pager_menu);
+    mutt_trace_end("pager_redraw");
 
     if (BrailleFriendly)
     {
@@ -2331,6 +2832,29 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
     }
     mutt_curs_set(1);
 
+    /* not a real timeout, just the next part of the message to show or search */
+    if ((ch == -2) && mutt_pager_is_loading() && !SigWinch)
+    {
+      if (stream && (stream->fd >= 0))
+      {
+        const LOFF_T old_size = rd.sb.st_size;
+        const int r = stream_read(stream, 1000, true);
+        if ((r > 0) || (r == -1))
+        {
+          rd.sb.st_size = ftello(stream->fp);
+          clearerr(rd.fp);
+          pager_menu->redraw |= REDRAW_STATUS;
+          /* the end of the message was visible */
+          if (rd.last_offset >= old_size)
+            pager_menu->redraw |= REDRAW_BODY;
+        }
+      }
+      if (rd.search_scan >= 0)
+        search_scan(&rd, rd.search_scan + SEARCH_CHUNK);
+      ch = 0;
+      continue;
+    }
+
     bool do_new_mail = false;
 
     if (Context && Context->mailbox && !OptAttachMsg)
@@ -2443,6 +2967,7 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
       {
         /* note: mutt_resize_screen() -> mutt_window_reflow() sets
          * REDRAW_FULL and REDRAW_FLOW */
+        rd.resized = true;
         ch = 0;
       }
       continue;
@@ -2455,6 +2980,13 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
       continue;
     }
 
+    /* the lines above the screen are only wrapped again when they're needed */
+    if ((rd.flow_head_num > 0) && (ch != OP_NEXT_PAGE) && (ch != OP_NEXT_LINE) &&
+        (ch != OP_HALF_DOWN))
+    {
+      pager_flow_head(&rd);
+    }
+
     rc = ch;
 
     switch (ch)
@@ -2478,9 +3010,10 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
         {
           rd.topline = up_n_lines(PagerContext, rd.line_info, rd.curline, rd.hide_quoted);
         }
-        else if (PagerStop)
+        else if (PagerStop || mutt_pager_is_loading())
         {
-          /* emulate "less -q" and don't go on to the next message. */
+          /* emulate "less -q" and don't go on to the next message.
+           * or the rest of this message hasn't been decoded yet */
           mutt_error(_("Bottom of message is shown"));
         }
         else
@@ -2545,9 +3078,10 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
           rd.topline = up_n_lines(rd.pager_window->rows / 2, rd.line_info,
                                   rd.curline, rd.hide_quoted);
         }
-        else if (PagerStop)
+        else if (PagerStop || mutt_pager_is_loading())
         {
-          /* emulate "less -q" and don't go on to the next message. */
+          /* emulate "less -q" and don't go on to the next message.
+           * or the rest of this message hasn't been decoded yet */
           mutt_error(_("Bottom of message is shown"));
         }
         else
@@ -2574,16 +3108,8 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
               (rd.search_back && (ch == OP_SEARCH_OPPOSITE)))
           {
             /* searching forward */
-            for (i = wrapped ? 0 : rd.topline + searchctx + 1; i < rd.last_line; i++)
-            {
-              if ((!rd.hide_quoted || rd.line_info[i].type != MT_COLOR_QUOTED) &&
-                  !rd.line_info[i].continuation && rd.line_info[i].search_cnt > 0)
-              {
-                break;
-              }
-            }
-
-            if (i < rd.last_line)
+            i = search_find(&rd, wrapped ? -1 : rd.topline + searchctx, true);
+            if (i >= 0)
               rd.topline = i;
             else if (wrapped || !WrapSearch)
               mutt_error(_("Not found"));
@@ -2597,15 +3123,7 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
           else
           {
             /* searching backward */
-            for (i = wrapped ? rd.last_line : rd.topline + searchctx - 1; i >= 0; i--)
-            {
-              if ((!rd.hide_quoted || (rd.has_types && rd.line_info[i].type != MT_COLOR_QUOTED)) &&
-                  !rd.line_info[i].continuation && rd.line_info[i].search_cnt > 0)
-              {
-                break;
-              }
-            }
-
+            i = search_find(&rd, wrapped ? INT_MAX : rd.topline + searchctx, false);
             if (i >= 0)
               rd.topline = i;
             else if (wrapped || !WrapSearch)
@@ -2694,56 +3212,27 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
           }
           rd.search_flag = 0;
           rd.search_compiled = false;
+          search_reset(&rd);
         }
         else
         {
           rd.search_compiled = true;
-          /* update the search pointers */
-          i = 0;
-          while (display_line(rd.fp, &rd.last_pos, &rd.line_info, i, &rd.last_line, &rd.max_line,
-                              MUTT_SEARCH | (flags & MUTT_PAGER_NSKIP) | (flags & MUTT_PAGER_NOWRAP),
-                              &rd.quote_list, &rd.q_level, &rd.force_redraw,
-                              &rd.search_re, rd.pager_window) == 0)
-            i++;
+          /* the matches are found as they're needed */
+          search_reset(&rd);
 
           if (!rd.search_back)
-          {
-            /* searching forward */
-            for (i = rd.topline; i < rd.last_line; i++)
-            {
-              if ((!rd.hide_quoted || rd.line_info[i].type != MT_COLOR_QUOTED) &&
-                  !rd.line_info[i].continuation && rd.line_info[i].search_cnt > 0)
-              {
-                break;
-              }
-            }
-
-            if (i < rd.last_line)
-              rd.topline = i;
-          }
+            i = search_find(&rd, rd.topline - 1, true);
           else
-          {
-            /* searching backward */
-            for (i = rd.topline; i >= 0; i--)
-            {
-              if ((!rd.hide_quoted || rd.line_info[i].type != MT_COLOR_QUOTED) &&
-                  !rd.line_info[i].continuation && rd.line_info[i].search_cnt > 0)
-              {
-                break;
-              }
-            }
+            i = search_find(&rd, rd.topline + 1, false);
 
-            if (i >= 0)
-              rd.topline = i;
-          }
-
-          if (rd.line_info[rd.topline].search_cnt == 0)
+          if (i < 0)
           {
             rd.search_flag = 0;
             mutt_error(_("Not found"));
           }
           else
           {
+            rd.topline = i;
             rd.search_flag = MUTT_SEARCH;
             /* give some context for search results */
             if (SearchContext > 0 && SearchContext < rd.pager_window->rows)
@@ -3431,7 +3920,14 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
     }
   }
 
+  /* TopLine is kept to find our place again */
+  if (IsHeader(extra) && (rc != -1) && (rc != OP_DISPLAY_HEADERS))
+    pager_flow_head(&rd);
+
   mutt_file_fclose(&rd.fp);
+  if (stream)
+    stream_close(stream);
+  CurrentPager = old_pager;
   if (IsHeader(extra))
   {
     if (Context)
@@ -3451,6 +3947,12 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
 
   cleanup_quote(&rd.quote_list);
 
+  for (i = 0; i < rd.flow_head_num; i++)
+  {
+    FREE(&rd.flow_head[i].syntax);
+    FREE(&rd.flow_head[i].search);
+  }
+  FREE(&rd.flow_head);
   for (i = 0; i < rd.max_line; i++)
   {
     FREE(&(rd.line_info[i].syntax));
@@ -3462,7 +3964,8 @@ int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *e
     regfree(&rd.search_re);
     rd.search_compiled = false;
   }
-  FREE(&rd.line_info);
+  mutt_mem_free_tag(MEM_TAG_PAGER, &rd.line_info, rd.max_line * sizeof(struct Line));
+  FREE(&rd.search_lines);
   mutt_menu_pop_current(pager_menu);
   mutt_menu_destroy(&pager_menu);
   if (rd.index)
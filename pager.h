@@ -25,6 +25,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <unistd.h>
 
 /* These Config Variables are only used in pager.c */
 extern bool          AllowAnsi;
@@ -32,6 +33,7 @@ extern bool          HeaderColorPartial;
 extern short         PagerContext;
 extern short         PagerIndexLines;
 extern bool          PagerStop;
+extern bool          PagerStream;
 extern short         SearchContext;
 extern short         SkipQuotedOffset;
 extern bool          SmartWrap;
@@ -57,20 +59,36 @@ extern bool          Tilde;
 
 #define MUTT_DISPLAYFLAGS (MUTT_SHOW | MUTT_PAGER_NSKIP | MUTT_PAGER_MARKER | MUTT_PAGER_LOGS)
 
+/**
+ * struct PagerStream - A message that's still being decoded for the pager
+ */
+struct PagerStream
+{
+  pid_t pid;       /**< Process decoding the message */
+  int fd;          /**< Pipe to read the message from, -1 once it's complete */
+  FILE *fp;        /**< File being displayed, complete lines are appended to it */
+  char *tail;      /**< Incomplete last line */
+  size_t tail_len; /**< Length of the incomplete line */
+  size_t tail_max; /**< Size of the tail buffer */
+  int lines;       /**< Number of lines in the file */
+};
+
 /**
  * struct Pager - An email being displayed
  */
 struct Pager
 {
-  struct Context *ctx;    /**< current mailbox */
-  struct Email *email;    /**< current message */
-  struct Body *bdy;       /**< current attachment */
-  FILE *fp;               /**< source stream */
-  struct AttachCtx *actx; /**< attachment information */
+  struct Context *ctx;        /**< current mailbox */
+  struct Email *email;        /**< current message */
+  struct Body *bdy;           /**< current attachment */
+  FILE *fp;                   /**< source stream */
+  struct AttachCtx *actx;     /**< attachment information */
+  struct PagerStream *stream; /**< message still being decoded, may be NULL */
 };
 
 int mutt_pager(const char *banner, const char *fname, int flags, struct Pager *extra);
 
 void mutt_clear_pager_position(void);
+bool mutt_pager_is_loading(void);
 
 #endif /* MUTT_PAGER_H */
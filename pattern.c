@@ -23,6 +23,8 @@
 #include "config.h"
 #include <stddef.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <regex.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -31,6 +33,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 #include "mutt/mutt.h"
 #include "config/lib.h"
 #include "email/lib.h"
@@ -49,6 +52,7 @@
 #include "menu.h"
 #include "mutt_logging.h"
 #include "mutt_parse.h"
+#include "mutt_thread.h"
 #include "muttlib.h"
 #include "mx.h"
 #include "ncrypt/ncrypt.h"
@@ -60,6 +64,12 @@
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
+#ifdef USE_HCACHE
+#include "maildir/maildir.h"
+#endif
+#ifdef USE_NOTMUCH
+#include "notmuch/mutt_notmuch.h"
+#endif
 
 /* These Config Variables are only used in pattern.c */
 bool ThoroughSearch; ///< Config: Decode headers and messages before searching them
@@ -89,6 +99,8 @@ bool ThoroughSearch; ///< Config: Decode headers and messages before searching t
 
 #define MUTT_MAXRANGE -1
 
+#define PATTERN_READAHEAD 32 ///< Messages to read ahead when searching their bodies
+
 /* constants for parse_date_range() */
 #define MUTT_PDR_NONE     0x0000
 #define MUTT_PDR_MINUS    0x0001
@@ -180,6 +192,203 @@ static struct RangeRegex range_regexes[] = {
 static struct Pattern *SearchPattern = NULL; /**< current search pattern */
 static char LastSearch[STRING] = { 0 };      /**< last pattern searched for */
 static char LastSearchExpn[LONG_STRING] = { 0 }; /**< expanded version of LastSearch */
+static struct Hash *ThreadMatches = NULL; /**< results of thread patterns, see pattern_bulk_begin() */
+
+/**
+ * is_literal_search - Is this a full-text search for plain text?
+ * @param pat  Pattern being parsed
+ * @param expr Regex of the pattern
+ * @retval true The regex has no special characters
+ *
+ * A header search also needs a header name, e.g. "Subject: hello", to be sent
+ * to an IMAP server.
+ */
+static bool is_literal_search(const struct Pattern *pat, const char *expr)
+{
+  switch (pat->op)
+  {
+    case MUTT_BODY:
+    case MUTT_WHOLE_MSG:
+      break;
+    case MUTT_HEADER:
+      if (!strchr(expr, ':'))
+        return false;
+      break;
+    default:
+      return false;
+  }
+
+  return !strpbrk(expr, "\\^$.[]|()*+?{}");
+}
+
+/**
+ * regex_skip_bracket - Skip a bracket expression
+ * @param s Regex, at the opening bracket
+ * @retval ptr Character after the closing bracket, or NULL
+ */
+static const char *regex_skip_bracket(const char *s)
+{
+  s++;
+  if (*s == '^')
+    s++;
+  if (*s == ']')
+    s++;
+  for (; *s; s++)
+  {
+    if ((s[0] == '[') && ((s[1] == ':') || (s[1] == '.') || (s[1] == '=')))
+    {
+      const char *end = strchr(s + 2, s[1]);
+      for (; end && (end[1] != ']'); end = strchr(end + 1, s[1]))
+        ;
+      if (!end)
+        return NULL;
+      s = end + 1;
+    }
+    else if (*s == ']')
+      return s + 1;
+  }
+  return NULL;
+}
+
+/**
+ * regex_literal - Find a string that every match of a regex contains
+ * @param[in]  expr  Extended regex
+ * @param[out] exact Set to true if the regex is just the string
+ * @retval ptr  Longest such string
+ * @retval NULL None was found
+ *
+ * Only runs of plain characters at the top level of the regex are considered,
+ * so "(re|fwd): *meeting" finds "meeting".  A character followed by a "*", "?"
+ * or "{" is optional.  Non-ASCII characters end a run, so the string can be
+ * compared ignoring case with strcasestr().
+ */
+static char *regex_literal(const char *expr, bool *exact)
+{
+  const size_t len = strlen(expr);
+  char *cur = mutt_mem_malloc(len + 1);
+  char *best = mutt_mem_malloc(len + 1);
+  size_t clen = 0;
+  size_t blen = 0;
+  bool last_lit = false; /* the last atom is the last character of cur */
+  bool ok = true;
+
+  *exact = true;
+  for (const char *s = expr; *s && ok;)
+  {
+    const unsigned char c = *s;
+    bool lit = false;
+
+    switch (c)
+    {
+      case '|':
+        ok = false;
+        break;
+      case '(':
+      {
+        int depth = 0;
+        do
+        {
+          if (*s == '\\')
+          {
+            if (!*++s)
+              break;
+          }
+          else if (*s == '[')
+          {
+            s = regex_skip_bracket(s);
+            if (!s)
+              break;
+            continue;
+          }
+          else if (*s == '(')
+            depth++;
+          else if (*s == ')')
+            depth--;
+          s++;
+        } while (*s && (depth > 0));
+        if (!s || (depth > 0))
+          ok = false;
+        break;
+      }
+      case '[':
+        s = regex_skip_bracket(s);
+        if (!s)
+          ok = false;
+        break;
+      case '*':
+      case '?':
+      case '{':
+        /* the last character is optional */
+        if (last_lit)
+          clen--;
+        if (c == '{')
+        {
+          s = strchr(s, '}');
+          if (!s)
+            ok = false;
+          else
+            s++;
+        }
+        else
+          s++;
+        break;
+      case '+':
+        s++;
+        break;
+      case '\\':
+        if (!s[1])
+          ok = false;
+        else if (isascii(s[1]) && ispunct(s[1]) && !strchr("<>`'", s[1]))
+        {
+          cur[clen++] = s[1];
+          lit = true;
+          s += 2;
+          break;
+        }
+        else
+          s += 2;
+        break;
+      default:
+        if (isascii(c) && (c != '.') && (c != '^') && (c != '$') && (c != ')'))
+        {
+          cur[clen++] = c;
+          lit = true;
+        }
+        s++;
+        break;
+    }
+
+    if (!lit)
+    {
+      /* the run of plain characters ends here */
+      *exact = false;
+      if (clen > blen)
+      {
+        memcpy(best, cur, clen);
+        blen = clen;
+      }
+      clen = 0;
+    }
+    last_lit = lit;
+  }
+
+  if (clen > blen)
+  {
+    memcpy(best, cur, clen);
+    blen = clen;
+  }
+  FREE(&cur);
+
+  if (!ok || (blen == 0))
+  {
+    *exact = false;
+    FREE(&best);
+    return NULL;
+  }
+
+  best[blen] = '\0';
+  return best;
+}
 
 /**
  * eat_regex - Parse a regex
@@ -207,6 +416,12 @@ static bool eat_regex(struct Pattern *pat, struct Buffer *s, struct Buffer *err)
     return false;
   }
 
+  /* A full-text search for plain text is the same as a string match.  That's
+   * cheaper to run locally, and can be done by an IMAP server, rather than by
+   * downloading every message. */
+  if (!pat->stringmatch && !pat->groupmatch && is_literal_search(pat, buf.data))
+    pat->stringmatch = true;
+
   if (pat->stringmatch)
   {
     pat->p.str = mutt_str_strdup(buf.data);
@@ -231,7 +446,14 @@ static bool eat_regex(struct Pattern *pat, struct Buffer *s, struct Buffer *err)
       FREE(&pat->p.regex);
       return false;
     }
-    FREE(&buf.data);
+
+    /* Most regexes are plain words, or contain some.  Looking for them with
+     * strstr() rules out most strings much faster than regexec(). */
+    bool exact = false;
+    pat->ign_case = (flags != 0);
+    pat->literal = regex_literal(buf.data, &exact);
+    pat->literal_only = exact;
+    pat->source = buf.data;
   }
 
   return true;
@@ -958,10 +1180,623 @@ static int patmatch(const struct Pattern *pat, const char *buf)
     return pat->ign_case ? !strcasestr(buf, pat->p.str) : !strstr(buf, pat->p.str);
   else if (pat->groupmatch)
     return !mutt_group_match(pat->p.g, buf);
+
+  if (pat->literal)
+  {
+    if (!(pat->ign_case ? strcasestr(buf, pat->literal) : strstr(buf, pat->literal)))
+      return REG_NOMATCH;
+    if (pat->literal_only)
+      return 0;
+  }
+  return regexec(pat->p.regex, buf, 0, NULL, 0);
+}
+
+#ifdef USE_HCACHE
+/* Identifies a search index record, see index_build() */
+#define INDEX_MAGIC 0x53496432 /* "SId2" */
+#define INDEX_MAX_TRIGRAMS 65536 ///< Parts of messages with more trigrams aren't indexed
+#define INDEX_MAX_HEADER 16384   ///< Longer headers aren't kept in the index
+
+/**
+ * struct IndexRecord - Search index of a message
+ *
+ * The index holds the trigrams (runs of three bytes, ASCII letters folded to
+ * lower case) of the text that msg_search() reads, in two Bloom filters: one
+ * for the header and one for the body.  They follow the record, hbytes and
+ * bbytes long.  A length of 0 means the part wasn't indexed.
+ *
+ * A Bloom filter can say a message may contain a string when it doesn't, but
+ * never the reverse, so the index can only rule messages out.
+ *
+ * The unfolded lines of the header come last, tbytes long, each one ending in
+ * a NUL.  They answer header searches without reading the message.
+ */
+struct IndexRecord
+{
+  unsigned int magic;
+  bool thorough;        ///< Text was decoded, see $thorough_search
+  unsigned int charset; ///< Hash of $charset the text was decoded to
+  ino_t ino;            ///< Inode of the message file
+  off_t size;           ///< Size of the message file
+  time_t mtime;         ///< Modification time of the message file
+  unsigned int hbytes;  ///< Length of the header filter
+  unsigned int bbytes;  ///< Length of the body filter
+  unsigned int tbytes;  ///< Length of the header lines, 0 if they aren't kept
+};
+
+/**
+ * struct TrigramSet - Trigrams found in some text
+ */
+struct TrigramSet
+{
+  unsigned int *data;  ///< Trigrams
+  size_t num;          ///< Number of trigrams
+  size_t max;          ///< Size of the array
+  unsigned int window; ///< Last bytes read
+  int filled;          ///< Number of bytes in window
+  bool overflow;       ///< Too many trigrams to index
+};
+
+/* Set while emails are tested on several threads; the header cache must only
+ * be used by the main thread */
+static bool SearchParallel = false;
+
+/**
+ * index_fold - Fold a byte for the search index
+ * @param c Byte
+ * @retval num Folded byte
+ */
+static unsigned int index_fold(unsigned char c)
+{
+  return (c < 0x80) ? (unsigned int) tolower(c) : c;
+}
+
+/**
+ * index_cmp_uint - Compare two trigrams - Implements ::sort_t
+ */
+static int index_cmp_uint(const void *a, const void *b)
+{
+  unsigned int ua = *(const unsigned int *) a;
+  unsigned int ub = *(const unsigned int *) b;
+  return (ua > ub) - (ua < ub);
+}
+
+/**
+ * trigrams_compact - Sort the trigrams and remove the duplicates
+ * @param ts Trigrams
+ */
+static void trigrams_compact(struct TrigramSet *ts)
+{
+  if (ts->num == 0)
+    return;
+
+  qsort(ts->data, ts->num, sizeof(unsigned int), index_cmp_uint);
+  size_t j = 0;
+  for (size_t i = 1; i < ts->num; i++)
+    if (ts->data[i] != ts->data[j])
+      ts->data[++j] = ts->data[i];
+  ts->num = j + 1;
+}
+
+/**
+ * trigrams_add - Add the trigrams of some text
+ * @param ts  Trigrams
+ * @param buf Text
+ * @param len Length of the text
+ *
+ * The trigrams span the calls, until trigrams_break() is called.
+ */
+static void trigrams_add(struct TrigramSet *ts, const char *buf, size_t len)
+{
+  for (size_t i = 0; (i < len) && !ts->overflow; i++)
+  {
+    ts->window = ((ts->window << 8) | index_fold(buf[i])) & 0xffffff;
+    if (++ts->filled < 3)
+      continue;
+
+    if (ts->num == ts->max)
+    {
+      trigrams_compact(ts);
+      if (ts->num > INDEX_MAX_TRIGRAMS)
+      {
+        ts->overflow = true;
+        break;
+      }
+      if ((ts->num * 2) >= ts->max)
+      {
+        ts->max = MAX(1024, ts->max * 2);
+        mutt_mem_realloc(&ts->data, ts->max * sizeof(unsigned int));
+      }
+    }
+    ts->data[ts->num++] = ts->window;
+  }
+}
+
+/**
+ * trigrams_break - Stop the trigrams running into the next text
+ * @param ts Trigrams
+ */
+static void trigrams_break(struct TrigramSet *ts)
+{
+  ts->window = 0;
+  ts->filled = 0;
+}
+
+/**
+ * trigrams_add_file - Add the trigrams of part of a file
+ * @param ts  Trigrams
+ * @param fp  File, read from the current position
+ * @param len Number of bytes to read, or -1 for the rest of the file
+ */
+static void trigrams_add_file(struct TrigramSet *ts, FILE *fp, long len)
+{
+  char buf[8192];
+
+  while ((len != 0) && !ts->overflow)
+  {
+    size_t want = ((len < 0) || (len > (long) sizeof(buf))) ? sizeof(buf) : (size_t) len;
+    size_t got = fread(buf, 1, want, fp);
+    if (got == 0)
+      break;
+    trigrams_add(ts, buf, got);
+    if (len > 0)
+      len -= got;
+  }
+  trigrams_break(ts);
+}
+
+/**
+ * trigrams_add_header - Add the trigrams of the unfolded lines of a header
+ * @param ts    Trigrams
+ * @param fp    File, read from the current position
+ * @param len   Length of the header
+ * @param lines Buffer for the lines, each one ending in a NUL
+ *
+ * A header search reads the lines with mutt_rfc822_read_line(), which joins
+ * folded lines, so their trigrams are added too.
+ */
+static void trigrams_add_header(struct TrigramSet *ts, FILE *fp, long len,
+                                struct Buffer *lines)
+{
+  size_t blen = STRING;
+  char *buf = mutt_mem_malloc(blen);
+
+  while (len > 0)
+  {
+    buf = mutt_rfc822_read_line(fp, buf, &blen);
+    if (*buf == '\0')
+      break;
+    const size_t llen = strlen(buf);
+    trigrams_add(ts, buf, llen);
+    trigrams_break(ts);
+    mutt_buffer_addstr(lines, buf);
+    mutt_buffer_addch(lines, '\0');
+    len -= llen;
+  }
+
+  FREE(&buf);
+}
+
+/**
+ * bloom_hash - Get the hashes of a trigram
+ * @param t  Trigram
+ * @param h1 First hash
+ * @param h2 Second hash, odd
+ */
+static void bloom_hash(unsigned int t, unsigned int *h1, unsigned int *h2)
+{
+  *h1 = t * 2654435761U;
+  *h2 = ((t ^ 0x5bd1e995) * 0x9e3779b1U) | 1;
+}
+
+/**
+ * bloom_build - Put a set of trigrams in a Bloom filter
+ * @param[in]  ts    Trigrams
+ * @param[out] bytes Length of the filter
+ * @retval ptr  Filter
+ * @retval NULL There are too many trigrams
+ *
+ * The filter has at least 10 bits per trigram, and three hashes.
+ */
+static unsigned char *bloom_build(struct TrigramSet *ts, unsigned int *bytes)
+{
+  *bytes = 0;
+  trigrams_compact(ts);
+  if (ts->overflow || (ts->num > INDEX_MAX_TRIGRAMS))
+    return NULL;
+
+  unsigned int bits = 512;
+  while (bits < ts->num * 10)
+    bits <<= 1;
+
+  unsigned char *bloom = mutt_mem_calloc(1, bits / 8);
+  for (size_t i = 0; i < ts->num; i++)
+  {
+    unsigned int h1, h2;
+    bloom_hash(ts->data[i], &h1, &h2);
+    for (int k = 0; k < 3; k++)
+    {
+      unsigned int b = (h1 + k * h2) & (bits - 1);
+      bloom[b >> 3] |= (1 << (b & 7));
+    }
+  }
+
+  *bytes = bits / 8;
+  return bloom;
+}
+
+/**
+ * bloom_has - Might a Bloom filter contain a trigram?
+ * @param bloom Filter
+ * @param bytes Length of the filter
+ * @param t     Trigram
+ * @retval true The trigram may be in the filter
+ */
+static bool bloom_has(const unsigned char *bloom, unsigned int bytes, unsigned int t)
+{
+  const unsigned int bits = bytes * 8;
+  unsigned int h1, h2;
+  bloom_hash(t, &h1, &h2);
+  for (int k = 0; k < 3; k++)
+  {
+    unsigned int b = (h1 + k * h2) & (bits - 1);
+    if (!(bloom[b >> 3] & (1 << (b & 7))))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * index_charset - Hash the charset messages are decoded to
+ * @retval num Hash of $charset
+ */
+static unsigned int index_charset(void)
+{
+  unsigned int h = 5381;
+  for (const char *c = NONULL(Charset); *c; c++)
+    h = (h * 33) ^ (unsigned char) *c;
+  return h;
+}
+
+/**
+ * index_build - Build the search index of a message
+ * @param[in]  ctx  Mailbox
+ * @param[in]  e    Email
+ * @param[in]  st   Details of the message file
+ * @param[out] dlen Length of the record
+ * @retval ptr  IndexRecord and its filters
+ * @retval NULL The message can't be indexed
+ *
+ * The text is read the same way as msg_search() reads it.  Encrypted messages
+ * aren't indexed, so nothing of their plain text is stored.
+ */
+static struct IndexRecord *index_build(struct Context *ctx, struct Email *e,
+                                       struct stat *st, size_t *dlen)
+{
+  struct Message *msg = mx_msg_open(ctx, e->msgno);
+  if (!msg)
+    return NULL;
+
+  struct TrigramSet hdr = { 0 };
+  struct TrigramSet body = { 0 };
+  struct IndexRecord *rec = NULL;
+  unsigned char *hbloom = NULL;
+  unsigned char *bbloom = NULL;
+  struct Buffer *lines = mutt_buffer_new();
+  FILE *fp = NULL;
+  bool ok = false;
+
+  if (ThoroughSearch)
+  {
+    fp = mutt_file_mkstemp();
+    if (!fp)
+      goto done;
+
+    mutt_copy_header(msg->fp, e, fp, CH_FROM | CH_DECODE, NULL);
+    fflush(fp);
+    long hlen = ftello(fp);
+    rewind(fp);
+    trigrams_add_file(&hdr, fp, -1);
+    rewind(fp);
+    trigrams_add_header(&hdr, fp, hlen, lines);
+
+    mutt_parse_mime_message(ctx, e);
+    if ((WithCrypto != 0) && (e->security & ENCRYPT))
+      goto done;
+
+    rewind(fp);
+    if (ftruncate(fileno(fp), 0) != 0)
+      goto done;
+
+    struct State s = { 0 };
+    s.fpin = msg->fp;
+    s.fpout = fp;
+    s.flags = MUTT_CHARCONV;
+    fseeko(msg->fp, e->offset, SEEK_SET);
+    mutt_body_handler(e->content, &s);
+    fflush(fp);
+    rewind(fp);
+    trigrams_add_file(&body, fp, -1);
+  }
   else
-    return regexec(pat->p.regex, buf, 0, NULL, 0);
+  {
+    const long hlen = e->content->offset - e->offset;
+    fseeko(msg->fp, e->offset, SEEK_SET);
+    trigrams_add_file(&hdr, msg->fp, hlen);
+    fseeko(msg->fp, e->offset, SEEK_SET);
+    trigrams_add_header(&hdr, msg->fp, hlen, lines);
+
+    fseeko(msg->fp, e->content->offset, SEEK_SET);
+    trigrams_add_file(&body, msg->fp, e->content->length);
+  }
+
+  struct IndexRecord head = { 0 };
+  head.magic = INDEX_MAGIC;
+  head.thorough = ThoroughSearch;
+  head.charset = index_charset();
+  head.ino = st->st_ino;
+  head.size = st->st_size;
+  head.mtime = st->st_mtime;
+  hbloom = bloom_build(&hdr, &head.hbytes);
+  bbloom = bloom_build(&body, &head.bbytes);
+  const size_t tlen = lines->dptr - lines->data;
+  if (tlen <= INDEX_MAX_HEADER)
+    head.tbytes = tlen;
+
+  *dlen = sizeof(head) + head.hbytes + head.bbytes + head.tbytes;
+  rec = mutt_mem_malloc(*dlen);
+  memcpy(rec, &head, sizeof(head));
+  unsigned char *part = (unsigned char *) (rec + 1);
+  if (hbloom)
+    memcpy(part, hbloom, head.hbytes);
+  if (bbloom)
+    memcpy(part + head.hbytes, bbloom, head.bbytes);
+  if (head.tbytes > 0)
+    memcpy(part + head.hbytes + head.bbytes, lines->data, head.tbytes);
+  ok = true;
+
+done:
+  mutt_buffer_free(&lines);
+  FREE(&hdr.data);
+  FREE(&body.data);
+  FREE(&hbloom);
+  FREE(&bbloom);
+  mutt_file_fclose(&fp);
+  mx_msg_close(ctx, &msg);
+  if (!ok)
+    FREE(&rec);
+  return rec;
+}
+
+/**
+ * index_valid - Does a search index record match the message?
+ * @param rec  Record
+ * @param dlen Length of the record
+ * @param st   Details of the message file
+ * @retval true The record can be used
+ */
+static bool index_valid(const struct IndexRecord *rec, size_t dlen, const struct stat *st)
+{
+  return (dlen >= sizeof(*rec)) && (rec->magic == INDEX_MAGIC) &&
+         (dlen == sizeof(*rec) + rec->hbytes + rec->bbytes + rec->tbytes) &&
+         ((rec->tbytes == 0) || (((const char *) rec)[dlen - 1] == '\0')) &&
+         (rec->thorough == ThoroughSearch) && (rec->charset == index_charset()) &&
+         (rec->ino == st->st_ino) && (rec->size == st->st_size) &&
+         (rec->mtime == st->st_mtime);
 }
 
+/**
+ * index_search - Search an email using the search index
+ * @param ctx Mailbox
+ * @param pat Pattern, MUTT_BODY, MUTT_HEADER or MUTT_WHOLE_MSG
+ * @param e   Email
+ * @retval  1 The message matches
+ * @retval  0 The message can't match
+ * @retval -1 The message must be searched
+ *
+ * A header search is run against the header lines in the index.  Otherwise,
+ * only string searches, and regexes containing a string, are checked: every
+ * trigram of the string must be found in the text of a matching message.
+ *
+ * If the message hasn't been indexed yet, it's indexed now, see
+ * $maildir_search_index.
+ */
+static int index_search(struct Context *ctx, struct Pattern *pat, struct Email *e)
+{
+  if (!MaildirSearchIndex || SearchParallel ||
+      ((ctx->mailbox->magic != MUTT_MAILDIR) && (ctx->mailbox->magic != MUTT_MH)))
+  {
+    return -1;
+  }
+
+  /* A case-insensitive search may fold non-ASCII bytes, so their trigrams
+   * can't be relied upon */
+  const char *str = pat->stringmatch ? pat->p.str : pat->literal;
+  unsigned int trigrams[STRING];
+  size_t num = 0;
+  unsigned int window = 0;
+  int filled = 0;
+  for (const unsigned char *c = (const unsigned char *) (str ? str : "");
+       *c && (num < mutt_array_size(trigrams)); c++)
+  {
+    window = ((window << 8) | index_fold(*c)) & 0xffffff;
+    if (pat->ign_case && (*c >= 0x80))
+      filled = 0;
+    else if (++filled >= 3)
+      trigrams[num++] = window;
+  }
+  if ((num == 0) && (pat->op != MUTT_HEADER))
+    return -1;
+
+  char path[PATH_MAX];
+  struct stat st;
+  snprintf(path, sizeof(path), "%s/%s", ctx->mailbox->path, e->path);
+  if (stat(path, &st) != 0)
+    return -1;
+
+  size_t dlen = 0;
+  struct IndexRecord *rec = maildir_search_index_load(ctx->mailbox, e, &dlen);
+  if (rec && !index_valid(rec, dlen, &st))
+    FREE(&rec);
+  if (!rec)
+  {
+    rec = index_build(ctx, e, &st, &dlen);
+    if (!rec)
+      return -1;
+    maildir_search_index_save(ctx->mailbox, e, rec, dlen);
+  }
+
+  const unsigned char *hbloom = (const unsigned char *) (rec + 1);
+  const unsigned char *bbloom = hbloom + rec->hbytes;
+  const char *text = (const char *) (bbloom + rec->bbytes);
+  const bool use_hdr = (pat->op != MUTT_BODY);
+  const bool use_body = (pat->op != MUTT_HEADER);
+  int rc = -1;
+
+  if ((pat->op == MUTT_HEADER) && (rec->tbytes > 0))
+  {
+    rc = 0;
+    for (const char *line = text; (line < text + rec->tbytes) && (rc == 0);
+         line += strlen(line) + 1)
+    {
+      if (patmatch(pat, line) == 0)
+        rc = 1;
+    }
+  }
+  else if ((!use_hdr || (rec->hbytes > 0)) && (!use_body || (rec->bbytes > 0)))
+  {
+    for (size_t i = 0; (i < num) && (rc != 0); i++)
+    {
+      const bool in_hdr = use_hdr && bloom_has(hbloom, rec->hbytes, trigrams[i]);
+      const bool in_body = use_body && bloom_has(bbloom, rec->bbytes, trigrams[i]);
+      if (!in_hdr && !in_body)
+        rc = 0;
+    }
+  }
+
+  FREE(&rec);
+  return rc;
+}
+#endif
+
+#ifdef HAVE_FOPENCOOKIE
+/**
+ * struct SearchSink - Match decoded text as it's written
+ *
+ * The text is split into lines, up to HUGE_STRING bytes long, which are
+ * matched like the lines msg_search() reads from a file.
+ */
+struct SearchSink
+{
+  const struct Pattern *pat;
+  char line[HUGE_STRING]; ///< Current line, so far
+  size_t len;             ///< Length of the current line
+  bool match;             ///< A line has matched
+};
+
+/**
+ * search_sink_line - Match the current line
+ * @param ss Search sink
+ */
+static void search_sink_line(struct SearchSink *ss)
+{
+  if (ss->len == 0)
+    return;
+
+  ss->line[ss->len] = '\0';
+  ss->len = 0;
+  if (patmatch(ss->pat, ss->line) == 0)
+    ss->match = true;
+}
+
+/**
+ * search_sink_write - Receive decoded text - Implements cookie_write_function_t
+ * @param cookie SearchSink
+ * @param buf    Text
+ * @param size   Length of the text
+ * @retval num Number of bytes written, always size
+ *
+ * Once a line has matched, the rest of the text is thrown away.
+ */
+static ssize_t search_sink_write(void *cookie, const char *buf, size_t size)
+{
+  struct SearchSink *ss = cookie;
+
+  for (size_t i = 0; (i < size) && !ss->match;)
+  {
+    size_t n = MIN(size - i, sizeof(ss->line) - 2 - ss->len);
+    const char *nl = memchr(buf + i, '\n', n);
+    if (nl)
+      n = nl - (buf + i) + 1;
+
+    memcpy(ss->line + ss->len, buf + i, n);
+    ss->len += n;
+    i += n;
+    if (nl || (ss->len == (sizeof(ss->line) - 2)))
+      search_sink_line(ss);
+  }
+
+  return size;
+}
+
+/**
+ * msg_search_stream - Search the decoded text of an email
+ * @param ctx Mailbox
+ * @param pat Pattern, MUTT_BODY or MUTT_WHOLE_MSG
+ * @param msg Message
+ * @param e   Email
+ * @retval true The pattern matches
+ *
+ * The header and body are decoded straight into the matcher, rather than to a
+ * temporary file that's read back.
+ */
+static bool msg_search_stream(struct Context *ctx, struct Pattern *pat,
+                              struct Message *msg, struct Email *e)
+{
+  struct SearchSink *ss = mutt_mem_calloc(1, sizeof(struct SearchSink));
+  ss->pat = pat;
+
+  cookie_io_functions_t funcs = { NULL, search_sink_write, NULL, NULL };
+  struct State s = { 0 };
+  s.fpin = msg->fp;
+  s.map = &msg->map;
+  s.flags = MUTT_CHARCONV;
+  s.fpout = fopencookie(ss, "w", funcs);
+  if (!s.fpout)
+  {
+    FREE(&ss);
+    return false;
+  }
+
+  if (pat->op != MUTT_BODY)
+  {
+    mutt_copy_header(msg->fp, e, s.fpout, CH_FROM | CH_DECODE, NULL);
+    fflush(s.fpout);
+  }
+
+  if (!ss->match)
+  {
+    mutt_parse_mime_message(ctx, e);
+
+    if ((WithCrypto != 0) && (e->security & ENCRYPT) && !crypt_valid_passphrase(e->security))
+    {
+      mutt_file_fclose(&s.fpout);
+      FREE(&ss);
+      return false;
+    }
+
+    fseeko(msg->fp, e->offset, SEEK_SET);
+    mutt_body_handler(e->content, &s);
+  }
+
+  mutt_file_fclose(&s.fpout);
+  search_sink_line(ss);
+  const bool match = ss->match;
+  FREE(&ss);
+  return match;
+}
+#endif
+
 /**
  * msg_search - Search an email
  * @param ctx   Mailbox
@@ -973,12 +1808,27 @@ static int patmatch(const struct Pattern *pat, const char *buf)
 static bool msg_search(struct Context *ctx, struct Pattern *pat, int msgno)
 {
   bool match = false;
+#ifdef USE_HCACHE
+  const int indexed = index_search(ctx, pat, ctx->mailbox->hdrs[msgno]);
+  if (indexed >= 0)
+    return indexed;
+#endif
+
   struct Message *msg = mx_msg_open(ctx, msgno);
   if (!msg)
   {
     return match;
   }
 
+#ifdef HAVE_FOPENCOOKIE
+  if (ThoroughSearch && (pat->op != MUTT_HEADER))
+  {
+    match = msg_search_stream(ctx, pat, msg, ctx->mailbox->hdrs[msgno]);
+    mx_msg_close(ctx, &msg);
+    return match;
+  }
+#endif
+
   FILE *fp = NULL;
   long lng = 0;
   struct Email *e = ctx->mailbox->hdrs[msgno];
@@ -994,6 +1844,7 @@ static bool msg_search(struct Context *ctx, struct Pattern *pat, int msgno)
     /* decode the header / body */
     struct State s = { 0 };
     s.fpin = msg->fp;
+    s.map = &msg->map;
     s.flags = MUTT_CHARCONV;
 #ifdef USE_FMEMOPEN
     s.fpout = open_memstream(&temp, &tempsize);
@@ -1085,6 +1936,27 @@ static bool msg_search(struct Context *ctx, struct Pattern *pat, int msgno)
   size_t blen = STRING;
   char *buf = mutt_mem_malloc(blen);
 
+  /* the raw body of a mapped message is searched in place */
+  const char *data = NULL;
+  if (!ThoroughSearch && (pat->op != MUTT_HEADER) && (lng > 0))
+    data = mutt_file_map_range(&msg->map, fp, ftello(fp), lng);
+  if (data)
+  {
+    for (const char *end = data + lng; (data < end) && !match;)
+    {
+      size_t n = MIN((size_t)(end - data), blen - 2);
+      const char *nl = memchr(data, '\n', n);
+      if (nl)
+        n = nl - data + 1;
+      memcpy(buf, data, n);
+      buf[n] = '\0';
+      if (patmatch(pat, buf) == 0)
+        match = true;
+      data += n;
+    }
+    lng = 0;
+  }
+
   /* search the file "fp" */
   while (lng > 0)
   {
@@ -1238,19 +2110,367 @@ void mutt_pattern_free(struct Pattern **pat)
       FREE(&tmp->p.regex);
     }
 
+    FREE(&tmp->literal);
+    FREE(&tmp->source);
     if (tmp->child)
       mutt_pattern_free(&tmp->child);
     FREE(&tmp);
   }
-}
+}
+
+/**
+ * mutt_pattern_new - Create a new Pattern
+ * @retval ptr New Pattern
+ */
+struct Pattern *mutt_pattern_new(void)
+{
+  return mutt_mem_calloc(1, sizeof(struct Pattern));
+}
+
+/**
+ * enum PatternCost - How expensive a Pattern is to test
+ */
+enum PatternCost
+{
+  PAT_COST_FLAG = 0, ///< Flag or number in the Email
+  PAT_COST_HEADER,   ///< String or group match on a header field
+  PAT_COST_REGEX,    ///< Regex on a header field
+  PAT_COST_THREAD,   ///< Test the other emails of the thread
+  PAT_COST_BODY,     ///< Read the message
+};
+
+/**
+ * pattern_cost - Estimate the cost of testing a Pattern
+ * @param pat Pattern, whose children have been optimised
+ * @retval num Cost, e.g. #PAT_COST_REGEX
+ */
+static enum PatternCost pattern_cost(const struct Pattern *pat)
+{
+  enum PatternCost cost = PAT_COST_FLAG;
+
+  switch (pat->op)
+  {
+    case MUTT_AND:
+    case MUTT_OR:
+      /* the children are sorted, so the last one is the most expensive */
+      for (const struct Pattern *child = pat->child; child; child = child->next)
+        cost = MAX(cost, pattern_cost(child));
+      return cost;
+    case MUTT_THREAD:
+    case MUTT_PARENT:
+    case MUTT_CHILDREN:
+      for (const struct Pattern *child = pat->child; child; child = child->next)
+        cost = MAX(cost, pattern_cost(child));
+      return MAX(cost, PAT_COST_THREAD);
+    case MUTT_BODY:
+    case MUTT_HEADER:
+    case MUTT_WHOLE_MSG:
+    case MUTT_MIMEATTACH:
+    case MUTT_MIMETYPE:
+      return PAT_COST_BODY;
+    case MUTT_SENDER:
+    case MUTT_FROM:
+    case MUTT_TO:
+    case MUTT_CC:
+    case MUTT_SUBJECT:
+    case MUTT_ID:
+    case MUTT_REFERENCE:
+    case MUTT_ADDRESS:
+    case MUTT_RECIPIENT:
+    case MUTT_XLABEL:
+    case MUTT_DRIVER_TAGS:
+    case MUTT_HORMEL:
+#ifdef USE_NNTP
+    case MUTT_NEWSGROUPS:
+#endif
+      return (pat->stringmatch || pat->groupmatch) ? PAT_COST_HEADER : PAT_COST_REGEX;
+    case MUTT_LIST:
+    case MUTT_SUBSCRIBED_LIST:
+    case MUTT_PERSONAL_RECIP:
+    case MUTT_PERSONAL_FROM:
+      return PAT_COST_HEADER;
+    default:
+      return PAT_COST_FLAG;
+  }
+}
+
+/**
+ * pattern_optimise - Reorder a Pattern so the cheap tests are done first
+ * @param pat Pattern to optimise
+ *
+ * A logical operator stops as soon as its result is known, so the order of
+ * its children doesn't change the result, only the work done.  Nested
+ * operators of the same kind, e.g. "~A (~B ~C)", are flattened, then the
+ * children are sorted by cost, keeping the written order for equal costs.
+ * This way, a flag is checked before a header, and a header before the body.
+ */
+static void pattern_optimise(struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (!pat->child)
+      continue;
+
+    pattern_optimise(pat->child);
+
+    if ((pat->op != MUTT_AND) && (pat->op != MUTT_OR))
+      continue;
+
+    /* flatten the children that are the same operator */
+    struct Pattern **np = &pat->child;
+    while (*np)
+    {
+      struct Pattern *child = *np;
+      if ((child->op != pat->op) || child->not || !child->child)
+      {
+        np = &child->next;
+        continue;
+      }
+
+      struct Pattern *last = child->child;
+      while (last->next)
+        last = last->next;
+      last->next = child->next;
+      *np = child->child;
+
+      child->child = NULL;
+      child->next = NULL;
+      mutt_pattern_free(&child);
+    }
+
+    /* stable insertion sort by cost */
+    struct Pattern *sorted = NULL;
+    struct Pattern *next = NULL;
+    for (struct Pattern *child = pat->child; child; child = next)
+    {
+      next = child->next;
+      const enum PatternCost cost = pattern_cost(child);
+
+      np = &sorted;
+      while (*np && (pattern_cost(*np) <= cost))
+        np = &(*np)->next;
+      child->next = *np;
+      *np = child;
+    }
+    pat->child = sorted;
+  }
+}
+
+/**
+ * pattern_readahead - Should the messages be read ahead of a search?
+ * @param ctx Mailbox
+ * @param pat Pattern
+ * @retval true The pattern reads the messages, which are local files
+ */
+static bool pattern_readahead(struct Context *ctx, const struct Pattern *pat)
+{
+  if (!ctx || (pattern_cost(pat) < PAT_COST_BODY))
+    return false;
+
+  return (ctx->mailbox->magic == MUTT_MAILDIR) || (ctx->mailbox->magic == MUTT_MH)
+#ifdef USE_NOTMUCH
+         || (ctx->mailbox->magic == MUTT_NOTMUCH)
+#endif
+      ;
+}
+
+/**
+ * msg_readahead - Ask the kernel to read a message that will be searched
+ * @param ctx Mailbox
+ * @param e   Email
+ *
+ * Searching the bodies of a Maildir reads one small file after another.
+ * Announcing the next few in advance lets the disk fetch them in parallel
+ * while the current one is matched.
+ */
+static void msg_readahead(struct Context *ctx, struct Email *e)
+{
+#ifdef POSIX_FADV_WILLNEED
+  char path[PATH_MAX];
+  const char *folder = ctx->mailbox->path;
+
+  if (!e || !e->path)
+    return;
+#ifdef USE_NOTMUCH
+  if (ctx->mailbox->magic == MUTT_NOTMUCH)
+    folder = nm_email_get_folder(e);
+#endif
+  if (!folder)
+    return;
+
+  snprintf(path, sizeof(path), "%s/%s", folder, e->path);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  /* Asynchronous readahead, it doesn't block us */
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+#endif
+}
+
+/**
+ * pattern_parallel_safe - Can a Pattern be tested on several threads?
+ * @param pat Pattern
+ * @retval true The pattern only reads its own Email and message file
+ *
+ * Decoding a message ($thorough_search) may run external programs, ask for a
+ * passphrase or report errors, so it must stay in the main thread.  The
+ * thread operators read the files of other messages, which aren't checked by
+ * pattern_search_job().
+ *
+ * The other operators may only use the functions that the page in parallel.c
+ * lists as safe from a worker.  The tag getters update the interned tags, so
+ * ~Y stays in the main thread too.  ~= is safe once mutt_dup_hash_init() has
+ * been called.
+ */
+static bool pattern_parallel_safe(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    switch (pat->op)
+    {
+      case MUTT_BODY:
+      case MUTT_HEADER:
+      case MUTT_WHOLE_MSG:
+        if (ThoroughSearch)
+          return false;
+        break;
+      case MUTT_THREAD:
+      case MUTT_PARENT:
+      case MUTT_CHILDREN:
+      case MUTT_MIMEATTACH:
+      case MUTT_MIMETYPE:
+      case MUTT_SERVERSEARCH:
+      case MUTT_DRIVER_TAGS:
+        return false;
+    }
+
+    if (pat->child && !pattern_parallel_safe(pat->child))
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * pattern_uses_op - Does a Pattern contain an operator?
+ * @param pat Pattern
+ * @param op  Operator, e.g. #MUTT_DUPLICATED
+ * @retval true The operator is used by the Pattern or one of its children
+ */
+static bool pattern_uses_op(const struct Pattern *pat, int op)
+{
+  for (; pat; pat = pat->next)
+  {
+    if ((pat->op == op) || pattern_uses_op(pat->child, op))
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * struct PatternJobs - Emails to test against a Pattern on several threads
+ */
+struct PatternJobs
+{
+  struct Context *ctx;
+  struct Pattern *pat;
+  struct Progress *progress;
+  const int *msgnos;    ///< Emails to test, NULL for all of them
+  signed char *results; ///< 1 match, 0 no match, -1 left to the main thread
+};
+
+/**
+ * pattern_search_job - Test one Email - Implements ::parallel_work_t
+ */
+static void pattern_search_job(size_t i, void *data)
+{
+  struct PatternJobs *jobs = data;
+  struct Mailbox *mailbox = jobs->ctx->mailbox;
+  struct Email *e = mailbox->hdrs[jobs->msgnos ? jobs->msgnos[i] : i];
+  char path[PATH_MAX];
+
+  /* A message that has been moved is looked for, and any error reported, by
+   * the main thread */
+  snprintf(path, sizeof(path), "%s/%s", mailbox->path, e->path);
+  if (access(path, R_OK) != 0)
+  {
+    jobs->results[i] = -1;
+    return;
+  }
+
+  jobs->results[i] = (mutt_pattern_exec(jobs->pat, MUTT_MATCH_FULL_ADDRESS,
+                                        jobs->ctx, e, NULL) > 0);
+}
+
+/**
+ * pattern_search_progress - Update the progress bar - Implements ::parallel_progress_t
+ */
+static void pattern_search_progress(size_t done, void *data)
+{
+  struct PatternJobs *jobs = data;
+  mutt_progress_update(jobs->progress, done, -1);
+}
+
+/**
+ * pattern_search_parallel - Test many Emails against a Pattern on several threads
+ * @param ctx      Mailbox
+ * @param pat      Pattern
+ * @param msgnos   Emails to test, NULL for all of them
+ * @param num      Number of Emails
+ * @param progress Progress bar
+ * @retval ptr  Results, one per Email, in the same order (free with FREE())
+ * @retval NULL The Emails must be tested one at a time
+ *
+ * This is only worth it for patterns that read the messages, with
+ * $worker_threads greater than 1, in Maildir and MH folders whose messages
+ * are files that can be read independently.
+ */
+static bool *pattern_search_parallel(struct Context *ctx, struct Pattern *pat,
+                                     const int *msgnos, size_t num,
+                                     struct Progress *progress)
+{
+  if ((WorkerThreads < 2) || (num < 2) || (pattern_cost(pat) < PAT_COST_BODY) ||
+      ((ctx->mailbox->magic != MUTT_MAILDIR) && (ctx->mailbox->magic != MUTT_MH)) ||
+      !pattern_parallel_safe(pat))
+  {
+    return NULL;
+  }
+
+  /* Reading headers updates the mailbox, so it's done first, here */
+  for (size_t i = 0; i < num; i++)
+    mx_msg_load_header(ctx, ctx->mailbox->hdrs[msgnos ? msgnos[i] : i]);
+
+  /* The workers may only read the Message-ID multiset */
+  if (pattern_uses_op(pat, MUTT_DUPLICATED))
+    mutt_dup_hash_init(ctx->mailbox);
+
+  struct PatternJobs jobs = { ctx, pat, progress, msgnos, NULL };
+  jobs.results = mutt_mem_calloc(num, sizeof(signed char));
+#ifdef USE_HCACHE
+  SearchParallel = true;
+#endif
+  mutt_parallel_for(num, WorkerThreads, pattern_search_job, pattern_search_progress, &jobs);
+#ifdef USE_HCACHE
+  SearchParallel = false;
+#endif
+
+  bool *matches = mutt_mem_calloc(num, sizeof(bool));
+  for (size_t i = 0; i < num; i++)
+  {
+    if (jobs.results[i] < 0)
+    {
+      struct Email *e = ctx->mailbox->hdrs[msgnos ? msgnos[i] : i];
+      matches[i] = (mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, ctx, e, NULL) > 0);
+    }
+    else
+      matches[i] = jobs.results[i];
+  }
 
-/**
- * mutt_pattern_new - Create a new Pattern
- * @retval ptr New Pattern
- */
-struct Pattern *mutt_pattern_new(void)
-{
-  return mutt_mem_calloc(1, sizeof(struct Pattern));
+  FREE(&jobs.results);
+  return matches;
 }
 
 /**
@@ -1490,6 +2710,7 @@ struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer
     tmp->child = curlist;
     curlist = tmp;
   }
+  pattern_optimise(curlist);
   return curlist;
 }
 
@@ -1681,6 +2902,87 @@ static int match_threadcomplete(struct Pattern *pat, enum PatternExecFlag flags,
   return 0;
 }
 
+/**
+ * thread_next_node - Get the next node of a thread, in pre-order
+ * @param t    Current node
+ * @param root Top of the thread
+ * @retval ptr  Next node
+ * @retval NULL The whole thread has been visited
+ */
+static struct MuttThread *thread_next_node(struct MuttThread *t, struct MuttThread *root)
+{
+  if (t->child)
+    return t->child;
+  while ((t != root) && !t->next)
+    t = t->parent;
+  return (t == root) ? NULL : t->next;
+}
+
+/**
+ * match_thread_bulk - Match a Pattern against an email thread, remembering the result
+ * @param pat   Pattern to match
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param ctx   Mailbox
+ * @param t     Email thread
+ * @retval 1  Success, match found
+ * @retval 0  No match
+ *
+ * Every email in a thread gets the same answer, so the whole thread is
+ * searched once and its answer is remembered for all of its nodes.  Matching
+ * all the emails of a mailbox costs one visit of each thread, rather than one
+ * visit of its thread per email.
+ */
+static int match_thread_bulk(struct Pattern *pat, enum PatternExecFlag flags,
+                             struct Context *ctx, struct MuttThread *t)
+{
+  char key[64];
+
+  if (!t)
+    return 0;
+
+  snprintf(key, sizeof(key), "%p %p", (void *) pat, (void *) t);
+  void *found = mutt_hash_find(ThreadMatches, key);
+  if (found)
+    return (intptr_t) found - 2;
+
+  struct MuttThread *root = t;
+  while (root->parent)
+    root = root->parent;
+
+  int rc = 0;
+  for (struct MuttThread *n = root; n && !rc; n = thread_next_node(n, root))
+    if (n->message)
+      rc = mutt_pattern_exec(pat, flags, ctx, n->message, NULL);
+
+  for (struct MuttThread *n = root; n; n = thread_next_node(n, root))
+  {
+    snprintf(key, sizeof(key), "%p %p", (void *) pat, (void *) n);
+    mutt_hash_insert(ThreadMatches, key, (void *) (intptr_t)(rc + 2));
+  }
+  return rc;
+}
+
+/**
+ * pattern_bulk_begin - Start matching a pattern against many emails
+ * @param ctx Mailbox
+ *
+ * Until pattern_bulk_end() is called, thread patterns remember their results,
+ * so the emails mustn't be changed in a way the pattern might see, except for
+ * the ones that have already been matched.
+ */
+static void pattern_bulk_begin(struct Context *ctx)
+{
+  ThreadMatches = mutt_hash_create(MAX(ctx->mailbox->msg_count, 16), MUTT_HASH_STRDUP_KEYS);
+}
+
+/**
+ * pattern_bulk_end - Finish matching a pattern against many emails
+ */
+static void pattern_bulk_end(void)
+{
+  mutt_hash_destroy(&ThreadMatches);
+}
+
 /**
  * match_threadparent - Match Pattern against an email's parent
  * @param pat   Pattern to match
@@ -1796,7 +3098,129 @@ static int is_pattern_cache_set(int cache_entry)
 }
 
 /**
- * mutt_pattern_exec - Match a pattern against an email header
+ * pattern_is_static - Does a Pattern only depend on the email itself?
+ * @param pat Pattern
+ * @retval true The result only changes if the email's headers or body do
+ *
+ * Flags, tags, scores, threads, and config like aliases, groups and lists
+ * can all change while the email doesn't.
+ */
+static bool pattern_is_static(const struct Pattern *pat)
+{
+  if (pat->isalias || pat->groupmatch)
+    return false;
+
+  switch (pat->op)
+  {
+    case MUTT_AND:
+    case MUTT_OR:
+      for (const struct Pattern *child = pat->child; child; child = child->next)
+        if (!pattern_is_static(child))
+          return false;
+      return true;
+    case MUTT_BODY:
+    case MUTT_HEADER:
+    case MUTT_WHOLE_MSG:
+      /* IMAP string searches are done by the server, see Email.matched */
+      return !pat->stringmatch;
+    case MUTT_DATE:
+    case MUTT_DATE_RECEIVED:
+    case MUTT_SIZE:
+    case MUTT_MIMETYPE:
+    case MUTT_SENDER:
+    case MUTT_FROM:
+    case MUTT_TO:
+    case MUTT_CC:
+    case MUTT_SUBJECT:
+    case MUTT_ID:
+    case MUTT_REFERENCE:
+    case MUTT_ADDRESS:
+    case MUTT_RECIPIENT:
+#ifdef USE_NNTP
+    case MUTT_NEWSGROUPS:
+#endif
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * pattern_memo_key - Describe a Pattern, so that equal ones can be found
+ * @param key Buffer for the description
+ * @param pat Pattern
+ */
+static void pattern_memo_key(struct Buffer *key, const struct Pattern *pat)
+{
+  mutt_buffer_add_printf(key, "(%d %d%d%d%d%d%d %d %d ", pat->op, pat->not,
+                         pat->alladdr, pat->stringmatch, pat->groupmatch,
+                         pat->ign_case, pat->isalias, pat->min, pat->max);
+
+  if (pat->child)
+  {
+    for (const struct Pattern *child = pat->child; child; child = child->next)
+      pattern_memo_key(key, child);
+  }
+  else if (pat->stringmatch)
+    mutt_buffer_add_printf(key, "%zu:%s", mutt_str_strlen(pat->p.str), pat->p.str);
+  else if (pat->source)
+    mutt_buffer_add_printf(key, "%zu:%s", mutt_str_strlen(pat->source), pat->source);
+  else if (pat->p.regex)
+    mutt_buffer_add_printf(key, "%p", (void *) pat->p.regex);
+
+  mutt_buffer_addch(key, ')');
+}
+
+/**
+ * mutt_pattern_memo - Number the subpatterns of a set of Patterns
+ * @param pat         Pattern to add to the set
+ * @param slots       Slot of each subpattern, by description (STRDUP_KEYS)
+ * @param num_static  Number of slots for subpatterns that only depend on the email
+ * @param num_dynamic Number of slots for the others
+ *
+ * Equal subpatterns of all the Patterns get the same slot, so when they're run
+ * against an email with a PatternCache that has room for the slots, each one
+ * is only tested once.  Results in PatternCache.memo may be kept for as long
+ * as the email doesn't change.  Those in PatternCache.scratch may not.
+ *
+ * The subpatterns of thread patterns, which test other emails, are skipped.
+ */
+void mutt_pattern_memo(struct Pattern *pat, struct Hash *slots, short *num_static, short *num_dynamic)
+{
+  if (!pat)
+    return;
+
+  if ((pat->op == MUTT_AND) || (pat->op == MUTT_OR))
+  {
+    for (struct Pattern *child = pat->child; child; child = child->next)
+      mutt_pattern_memo(child, slots, num_static, num_dynamic);
+  }
+
+  struct Buffer *key = mutt_buffer_new();
+  pattern_memo_key(key, pat);
+
+  struct HashElem *he = mutt_hash_find_elem(slots, key->data);
+  if (he)
+    pat->memo = (short) (intptr_t) he->data;
+  else
+  {
+    const bool is_static = pattern_is_static(pat);
+    short *num = is_static ? num_static : num_dynamic;
+    if (*num < SHRT_MAX)
+    {
+      (*num)++;
+      pat->memo = is_static ? *num : -*num;
+      mutt_hash_insert(slots, key->data, (void *) (intptr_t) pat->memo);
+    }
+    else
+      pat->memo = 0;
+  }
+
+  mutt_buffer_free(&key);
+}
+
+/**
+ * pattern_exec - Match a pattern against an email header
  * @param pat   Pattern to match
  * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
  * @param ctx   Mailbox
@@ -1806,16 +3230,16 @@ static int is_pattern_cache_set(int cache_entry)
  * @retval  0 Pattern did not match
  * @retval -1 Error
  *
- * flags: MUTT_MATCH_FULL_ADDRESS - match both personal and machine address
- * cache: For repeated matches against the same Header, passing in non-NULL will
- *        store some of the cacheable pattern matches in this structure.
+ * See mutt_pattern_exec()
  */
-int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
-                      struct Context *ctx, struct Email *e, struct PatternCache *cache)
+static int pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
+                        struct Context *ctx, struct Email *e, struct PatternCache *cache)
 {
   int result;
   int *cache_entry = NULL;
 
+  mx_msg_load_header(ctx, e);
+
   switch (pat->op)
   {
     case MUTT_AND:
@@ -1823,6 +3247,8 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
     case MUTT_OR:
       return pat->not ^ (perform_or(pat->child, flags, ctx, e, cache) > 0);
     case MUTT_THREAD:
+      if (ThreadMatches)
+        return pat->not ^ match_thread_bulk(pat->child, flags, ctx, e->thread);
       return pat->not ^
              match_threadcomplete(pat->child, flags, ctx, e->thread, 1, 1, 1, 1);
     case MUTT_PARENT:
@@ -2036,7 +3462,9 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
       return pat->not ^ (e->env->spam && e->env->spam->data &&
                          patmatch(pat, e->env->spam->data) == 0);
     case MUTT_DUPLICATED:
-      return pat->not ^ (e->thread && e->thread->duplicate_thread);
+      if (e->thread)
+        return pat->not ^ e->thread->duplicate_thread;
+      return pat->not ^ (ctx && mutt_email_is_duplicate(ctx->mailbox, e));
     case MUTT_MIMEATTACH:
       if (!ctx)
         return 0;
@@ -2064,6 +3492,45 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
   return -1;
 }
 
+/**
+ * mutt_pattern_exec - Match a pattern against an email header
+ * @param pat   Pattern to match
+ * @param flags Flags, e.g. #MUTT_MATCH_FULL_ADDRESS
+ * @param ctx   Mailbox
+ * @param e     Email
+ * @param cache Cache for common Patterns
+ * @retval  1 Success, pattern matched
+ * @retval  0 Pattern did not match
+ * @retval -1 Error
+ *
+ * flags: MUTT_MATCH_FULL_ADDRESS - match both personal and machine address
+ * cache: For repeated matches against the same Header, passing in non-NULL will
+ *        store some of the cacheable pattern matches in this structure.
+ *        Subpatterns numbered by mutt_pattern_memo() are only tested once.
+ */
+int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
+                      struct Context *ctx, struct Email *e, struct PatternCache *cache)
+{
+  unsigned char *memo = NULL;
+  if (cache && (pat->memo > 0) && cache->memo)
+    memo = &cache->memo[pat->memo];
+  else if (cache && (pat->memo < 0) && cache->scratch)
+    memo = &cache->scratch[-pat->memo];
+
+  if (!memo)
+    return pattern_exec(pat, flags, ctx, e, cache);
+
+  if (*memo == 0)
+  {
+    int rc = pattern_exec(pat, flags, ctx, e, cache);
+    if (rc < 0)
+      return rc;
+    *memo = (rc > 0) ? 2 : 1;
+  }
+
+  return *memo - 1;
+}
+
 /**
  * quote_simple - Apply simple quoting to a string
  * @param str    String to quote
@@ -2206,6 +3673,211 @@ bool mutt_limit_current_thread(struct Email *e)
   return true;
 }
 
+/**
+ * struct RangeEntry - An email in a PatternIndex
+ */
+struct RangeEntry
+{
+  long key;  ///< Date or size of the email
+  int msgno; ///< Index into Mailbox::hdrs
+};
+
+/**
+ * struct PatternIndex - Emails sorted by date and size
+ *
+ * The lists are built the first time they're needed, and thrown away when
+ * emails are added, removed or read, see mutt_pattern_index_free().
+ */
+struct PatternIndex
+{
+  int num;                     ///< Number of emails in each list
+  struct RangeEntry *sent;     ///< Sorted by Email::date_sent
+  struct RangeEntry *received; ///< Sorted by Email::received
+  struct RangeEntry *size;     ///< Sorted by Body::length
+};
+
+/**
+ * mutt_pattern_index_free - Free the date and size index of a Mailbox
+ * @param m Mailbox
+ */
+void mutt_pattern_index_free(struct Mailbox *m)
+{
+  if (!m || !m->pattern_index)
+    return;
+
+  FREE(&m->pattern_index->sent);
+  FREE(&m->pattern_index->received);
+  FREE(&m->pattern_index->size);
+  FREE(&m->pattern_index);
+}
+
+/**
+ * range_entry_cmp - Compare two RangeEntries - Implements ::sort_t
+ */
+static int range_entry_cmp(const void *a, const void *b)
+{
+  const struct RangeEntry *ra = a;
+  const struct RangeEntry *rb = b;
+  if (ra->key != rb->key)
+    return (ra->key > rb->key) ? 1 : -1;
+  return ra->msgno - rb->msgno;
+}
+
+/**
+ * range_index - Get the emails sorted by the field a pattern tests
+ * @param ctx Mailbox
+ * @param op  Pattern, MUTT_DATE, MUTT_DATE_RECEIVED or MUTT_SIZE
+ * @retval ptr Sorted emails, Mailbox::msg_count long
+ */
+static struct RangeEntry *range_index(struct Context *ctx, short op)
+{
+  struct Mailbox *m = ctx->mailbox;
+
+  if (m->pattern_index && (m->pattern_index->num != m->msg_count))
+    mutt_pattern_index_free(m);
+  if (!m->pattern_index)
+  {
+    m->pattern_index = mutt_mem_calloc(1, sizeof(struct PatternIndex));
+    m->pattern_index->num = m->msg_count;
+  }
+
+  struct RangeEntry **list = (op == MUTT_DATE) ? &m->pattern_index->sent :
+                             (op == MUTT_DATE_RECEIVED) ? &m->pattern_index->received :
+                                                          &m->pattern_index->size;
+  if (*list)
+    return *list;
+
+  *list = mutt_mem_malloc(MAX(m->msg_count, 1) * sizeof(struct RangeEntry));
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    const struct Email *e = m->hdrs[i];
+    (*list)[i].key = (op == MUTT_DATE) ? e->date_sent :
+                     (op == MUTT_DATE_RECEIVED) ? e->received : e->content->length;
+    (*list)[i].msgno = i;
+  }
+  qsort(*list, m->msg_count, sizeof(struct RangeEntry), range_entry_cmp);
+  return *list;
+}
+
+/**
+ * range_candidates - Find the emails a date or size pattern matches
+ * @param ctx Mailbox
+ * @param pat Pattern, MUTT_DATE, MUTT_DATE_RECEIVED or MUTT_SIZE
+ * @retval ptr Array of Mailbox::msg_count flags
+ *
+ * The range is found with a binary search, so only the emails in it are
+ * looked at.
+ */
+static bool *range_candidates(struct Context *ctx, const struct Pattern *pat)
+{
+  const int num = ctx->mailbox->msg_count;
+  const struct RangeEntry *list = range_index(ctx, pat->op);
+  bool *cand = mutt_mem_calloc(MAX(num, 1), sizeof(bool));
+  const bool unbounded = (pat->op == MUTT_SIZE) && (pat->max == MUTT_MAXRANGE);
+
+  int lo = 0, hi = num;
+  while (lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    if (list[mid].key < pat->min)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (int i = lo; (i < num) && (unbounded || (list[i].key <= pat->max)); i++)
+    cand[list[i].msgno] = true;
+
+  return cand;
+}
+
+/**
+ * pattern_candidates - Find the emails that may match a pattern
+ * @param ctx Mailbox
+ * @param pat Pattern
+ * @retval ptr  Array of Mailbox::msg_count flags, false if the email can't match
+ * @retval NULL Any email may match
+ *
+ * If the pattern is a date or size range, or requires some, the emails that
+ * are outside them are ruled out, using one binary search per range.
+ */
+static bool *pattern_candidates(struct Context *ctx, struct Pattern *pat)
+{
+  bool *cand = NULL;
+  struct Pattern *tests = pat;
+
+  if (!pat || pat->next || (ctx->mailbox->msg_count == 0))
+    return NULL;
+  if ((pat->op == MUTT_AND) && !pat->not)
+    tests = pat->child;
+
+  for (struct Pattern *p = tests; p; p = (tests == pat) ? NULL : p->next)
+  {
+    if (p->not || ((p->op != MUTT_DATE) && (p->op != MUTT_DATE_RECEIVED) &&
+                   (p->op != MUTT_SIZE)))
+    {
+      continue;
+    }
+
+    /* the dates and sizes must be known */
+    mx_mbox_load_headers(ctx);
+
+    bool *c = range_candidates(ctx, p);
+    if (cand)
+    {
+      for (int i = 0; i < ctx->mailbox->msg_count; i++)
+        cand[i] = cand[i] && c[i];
+      FREE(&c);
+    }
+    else
+      cand = c;
+  }
+
+  return cand;
+}
+
+/**
+ * pattern_search_candidates - Search the candidate emails on several threads
+ * @param ctx        Mailbox
+ * @param pat        Pattern
+ * @param msgnos     Emails to search, or NULL for all of them
+ * @param num        Number of emails
+ * @param candidates Emails that may match, see pattern_candidates(), or NULL
+ * @param progress   Progress bar
+ * @retval ptr  Array of num results, see pattern_search_parallel()
+ * @retval NULL The emails must be searched one at a time
+ */
+static bool *pattern_search_candidates(struct Context *ctx, struct Pattern *pat,
+                                       const int *msgnos, int num,
+                                       const bool *candidates, struct Progress *progress)
+{
+  if (!candidates)
+    return pattern_search_parallel(ctx, pat, msgnos, num, progress);
+
+  int *list = mutt_mem_malloc(MAX(num, 1) * sizeof(int));
+  int n = 0;
+  for (int i = 0; i < num; i++)
+  {
+    const int msgno = msgnos ? msgnos[i] : i;
+    if (candidates[msgno])
+      list[n++] = msgno;
+  }
+
+  bool *found = pattern_search_parallel(ctx, pat, list, n, progress);
+  bool *matches = NULL;
+  if (found)
+  {
+    matches = mutt_mem_calloc(MAX(num, 1), sizeof(bool));
+    for (int i = 0, j = 0; i < num; i++)
+      if (candidates[msgnos ? msgnos[i] : i])
+        matches[i] = found[j++];
+  }
+
+  FREE(&found);
+  FREE(&list);
+  return matches;
+}
+
 /**
  * mutt_pattern_func - Perform some Pattern matching
  * @param op     Operation to perform, e.g. MUTT_LIMIT
@@ -2214,6 +3886,25 @@ bool mutt_limit_current_thread(struct Email *e)
  * @retval -1 Failure
  */
 int mutt_pattern_func(int op, char *prompt)
+{
+  char buf[LONG_STRING] = "";
+
+  mutt_str_strfcpy(buf, Context->pattern, sizeof(buf));
+  if (prompt || op != MUTT_LIMIT)
+    if (mutt_get_field(prompt, buf, sizeof(buf), MUTT_PATTERN | MUTT_CLEAR) != 0 || !buf[0])
+      return -1;
+
+  return mutt_pattern_apply(op, buf);
+}
+
+/**
+ * mutt_pattern_apply - Apply a Pattern to the messages of the Context
+ * @param op      Operation to perform, e.g. MUTT_LIMIT
+ * @param pattern Pattern, may be a simple search
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+int mutt_pattern_apply(int op, const char *pattern)
 {
   struct Pattern *pat = NULL;
   char buf[LONG_STRING] = "", *simple = NULL;
@@ -2221,10 +3912,7 @@ int mutt_pattern_func(int op, char *prompt)
   int rc = -1, padding;
   struct Progress progress;
 
-  mutt_str_strfcpy(buf, Context->pattern, sizeof(buf));
-  if (prompt || op != MUTT_LIMIT)
-    if (mutt_get_field(prompt, buf, sizeof(buf), MUTT_PATTERN | MUTT_CLEAR) != 0 || !buf[0])
-      return -1;
+  mutt_str_strfcpy(buf, pattern, sizeof(buf));
 
   mutt_message(_("Compiling search pattern..."));
 
@@ -2251,6 +3939,12 @@ int mutt_pattern_func(int op, char *prompt)
                      (op == MUTT_LIMIT) ? Context->mailbox->msg_count :
                                           Context->mailbox->vcount);
 
+  /* A message is only changed after it's been matched, and a thread is
+   * matched in one go, so the thread results stay valid */
+  pattern_bulk_begin(Context);
+  mutt_flag_batch_begin(Context);
+  bool *candidates = pattern_candidates(Context, pat);
+
   if (op == MUTT_LIMIT)
   {
     Context->mailbox->vcount = 0;
@@ -2258,16 +3952,35 @@ int mutt_pattern_func(int op, char *prompt)
     Context->collapsed = false;
     padding = mx_msg_padding_size(Context);
 
+    bool *matches = pattern_search_candidates(Context, pat, NULL, Context->mailbox->msg_count,
+                                              candidates, &progress);
+    const bool readahead = !matches && pattern_readahead(Context, pat);
+    for (int i = 0; readahead && (i < PATTERN_READAHEAD) &&
+                    (i < Context->mailbox->msg_count);
+         i++)
+    {
+      if (!candidates || candidates[i])
+        msg_readahead(Context, Context->mailbox->hdrs[i]);
+    }
+
     for (int i = 0; i < Context->mailbox->msg_count; i++)
     {
-      mutt_progress_update(&progress, i, -1);
+      if (!matches)
+        mutt_progress_update(&progress, i, -1);
+      if (readahead && (i + PATTERN_READAHEAD < Context->mailbox->msg_count) &&
+          (!candidates || candidates[i + PATTERN_READAHEAD]))
+      {
+        msg_readahead(Context, Context->mailbox->hdrs[i + PATTERN_READAHEAD]);
+      }
       /* new limit pattern implicitly uncollapses all threads */
       Context->mailbox->hdrs[i]->virtual = -1;
       Context->mailbox->hdrs[i]->limited = false;
       Context->mailbox->hdrs[i]->collapsed = false;
       Context->mailbox->hdrs[i]->num_hidden = 0;
-      if (mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context,
-                            Context->mailbox->hdrs[i], NULL))
+      if (matches ? matches[i] :
+                    ((!candidates || candidates[i]) &&
+                     mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context,
+                                       Context->mailbox->hdrs[i], NULL)))
       {
         Context->mailbox->hdrs[i]->virtual = Context->mailbox->vcount;
         Context->mailbox->hdrs[i]->limited = true;
@@ -2277,14 +3990,33 @@ int mutt_pattern_func(int op, char *prompt)
         Context->vsize += b->length + b->offset - b->hdr_offset + padding;
       }
     }
+    FREE(&matches);
   }
   else
   {
+    bool *matches = pattern_search_candidates(Context, pat, Context->mailbox->v2r,
+                                              Context->mailbox->vcount, candidates, &progress);
+    const bool readahead = !matches && pattern_readahead(Context, pat);
+    for (int i = 0; readahead && (i < PATTERN_READAHEAD) && (i < Context->mailbox->vcount); i++)
+    {
+      if (!candidates || candidates[Context->mailbox->v2r[i]])
+        msg_readahead(Context, Context->mailbox->hdrs[Context->mailbox->v2r[i]]);
+    }
+
     for (int i = 0; i < Context->mailbox->vcount; i++)
     {
-      mutt_progress_update(&progress, i, -1);
-      if (mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context,
-                            Context->mailbox->hdrs[Context->mailbox->v2r[i]], NULL))
+      if (!matches)
+        mutt_progress_update(&progress, i, -1);
+      if (readahead && (i + PATTERN_READAHEAD < Context->mailbox->vcount) &&
+          (!candidates || candidates[Context->mailbox->v2r[i + PATTERN_READAHEAD]]))
+      {
+        msg_readahead(Context,
+                      Context->mailbox->hdrs[Context->mailbox->v2r[i + PATTERN_READAHEAD]]);
+      }
+      if (matches ? matches[i] :
+                    ((!candidates || candidates[Context->mailbox->v2r[i]]) &&
+                     mutt_pattern_exec(pat, MUTT_MATCH_FULL_ADDRESS, Context,
+                                       Context->mailbox->hdrs[Context->mailbox->v2r[i]], NULL)))
       {
         switch (op)
         {
@@ -2304,8 +4036,12 @@ int mutt_pattern_func(int op, char *prompt)
         }
       }
     }
+    FREE(&matches);
   }
 
+  FREE(&candidates);
+  mutt_flag_batch_end();
+  pattern_bulk_end();
   mutt_clear_error();
 
   if (op == MUTT_LIMIT)
@@ -2417,10 +4153,29 @@ int mutt_search_command(int cur, int op)
   mutt_progress_init(&progress, _("Searching..."), MUTT_PROGRESS_MSG, ReadInc,
                      Context->mailbox->vcount);
 
+  /* Read ahead the messages that are going to be searched, in the order of
+   * the search, wrapping around the ends of the index. */
+  const int vcount = Context->mailbox->vcount;
+  const bool readahead = (vcount > 0) && pattern_readahead(Context, SearchPattern);
+  for (int j = 0; readahead && (j < PATTERN_READAHEAD) && (j < vcount); j++)
+  {
+    const int v = (((cur + incr * (j + 1)) % vcount) + vcount) % vcount;
+    struct Email *e = Context->mailbox->hdrs[Context->mailbox->v2r[v]];
+    if (!e->searched)
+      msg_readahead(Context, e);
+  }
+
   for (int i = cur + incr, j = 0; j != Context->mailbox->vcount; j++)
   {
     const char *msg = NULL;
     mutt_progress_update(&progress, j, -1);
+    if (readahead && (j + PATTERN_READAHEAD < vcount))
+    {
+      const int v = (((i + incr * PATTERN_READAHEAD) % vcount) + vcount) % vcount;
+      struct Email *e = Context->mailbox->hdrs[Context->mailbox->v2r[v]];
+      if (!e->searched)
+        msg_readahead(Context, e);
+    }
     if (i > Context->mailbox->vcount - 1)
     {
       i = 0;
@@ -31,6 +31,7 @@ struct Address;
 struct Buffer;
 struct Email;
 struct Context;
+struct Mailbox;
 
 /* These Config Variables are only used in pattern.c */
 extern bool ThoroughSearch;
@@ -48,8 +49,9 @@ struct Pattern
   bool alladdr : 1;
   bool stringmatch : 1;
   bool groupmatch : 1;
-  bool ign_case : 1; /**< ignore case for local stringmatch searches */
+  bool ign_case : 1; /**< ignore case for local string and regex searches */
   bool isalias : 1;
+  bool literal_only : 1; /**< the regex is just the literal string */
   int min;
   int max;
   struct Pattern *next;
@@ -59,6 +61,9 @@ struct Pattern
     struct Group *g;
     char *str;
   } p;
+  char *literal; /**< string every match of the regex contains */
+  char *source;  /**< the regex as typed, to tell equal patterns apart */
+  short memo;    /**< slot of the result in a PatternCache, see mutt_pattern_memo() */
 };
 
 /**
@@ -87,6 +92,9 @@ struct PatternCache
   int pers_recip_one; /**<  ~p */
   int pers_from_all;  /**< ^~P */
   int pers_from_one;  /**<  ~P */
+
+  unsigned char *memo;    /**< results of the numbered subpatterns that only depend on the email */
+  unsigned char *scratch; /**< results of the other numbered subpatterns */
 };
 
 struct Pattern *mutt_pattern_new(void);
@@ -95,11 +103,14 @@ int mutt_pattern_exec(struct Pattern *pat, enum PatternExecFlag flags,
 struct Pattern *mutt_pattern_comp(/* const */ char *s, int flags, struct Buffer *err);
 void mutt_check_simple(char *s, size_t len, const char *simple);
 void mutt_pattern_free(struct Pattern **pat);
+void mutt_pattern_index_free(struct Mailbox *m);
+void mutt_pattern_memo(struct Pattern *pat, struct Hash *slots, short *num_static, short *num_dynamic);
 
 int mutt_which_case(const char *s);
 int mutt_is_list_recipient(bool alladdr, struct Address *a1, struct Address *a2);
 int mutt_is_list_cc(int alladdr, struct Address *a1, struct Address *a2);
 int mutt_pattern_func(int op, char *prompt);
+int mutt_pattern_apply(int op, const char *pattern);
 int mutt_search_command(int cur, int op);
 
 bool mutt_limit_current_thread(struct Email *e);
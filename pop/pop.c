@@ -73,6 +73,7 @@ bool PopLast;  ///< Config: (pop) Use the 'LAST' command to fetch new mail
 #ifdef USE_HCACHE
 #define HC_FNAME "neomutt" /* filename for hcache as POP lacks paths */
 #define HC_FEXT "hcache"   /* extension for hcache as POP lacks paths */
+#define FETCH_STATE "fetch-mail.state" /* body cache entry of the messages fetch-mail has saved */
 #endif
 
 /**
@@ -165,53 +166,91 @@ static int fetch_message(char *line, void *file)
 }
 
 /**
- * pop_read_header - Read header
- * @param mdata POP Mailbox data
- * @param e        Email header
- * @retval  0 Success
- * @retval -1 Connection lost
- * @retval -2 Invalid command or execution error
- * @retval -3 Error writing to tempfile
+ * struct PopHeaderCtx - Keep track of the headers being fetched
  */
-static int pop_read_header(struct PopMboxData *mdata, struct Email *e)
+struct PopHeaderCtx
 {
-  FILE *f = mutt_file_mkstemp();
-  if (!f)
+  struct PopMboxData *mdata;
+  struct Email **emails; ///< Emails whose headers are fetched
+  size_t *sizes;         ///< Message sizes, indexed by refno
+  int max_refno;         ///< Highest refno in sizes
+  FILE *fp;              ///< Header of the current message
+  struct Progress *progress;
+  int done;              ///< Number of headers fetched so far
+  int rc;                ///< Error that stopped the fetch
+};
+
+/**
+ * fetch_list - Parse the answer to LIST
+ * @param line String to parse
+ * @param data PopHeaderCtx
+ * @retval 0 Always
+ */
+static int fetch_list(char *line, void *data)
+{
+  struct PopHeaderCtx *hc = data;
+  int refno = 0;
+  size_t length = 0;
+
+  if (line && (sscanf(line, "%d %zu", &refno, &length) == 2) &&
+      (refno > 0) && (refno <= hc->max_refno))
   {
-    mutt_perror(_("Can't create temporary file"));
-    return -3;
+    hc->sizes[refno] = length;
   }
+  return 0;
+}
 
-  int index = 0;
-  size_t length = 0;
-  char buf[LONG_STRING];
+/**
+ * fetch_header_line - Write a line of a TOP answer to a temporary file
+ * @param line Header line, or NULL at the start of an answer
+ * @param data PopHeaderCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_header_line(char *line, void *data)
+{
+  struct PopHeaderCtx *hc = data;
 
-  snprintf(buf, sizeof(buf), "LIST %d\r\n", e->refno);
-  int rc = pop_query(mdata, buf, sizeof(buf));
-  if (rc == 0)
+  if (!line)
   {
-    sscanf(buf, "+OK %d %zu", &index, &length);
+    rewind(hc->fp);
+    return ftruncate(fileno(hc->fp), 0);
+  }
 
-    snprintf(buf, sizeof(buf), "TOP %d 0\r\n", e->refno);
-    rc = pop_fetch_data(mdata, buf, NULL, fetch_message, f);
+  return fetch_message(line, hc->fp);
+}
 
-    if (mdata->cmd_top == 2)
+/**
+ * fetch_header_done - Parse the answer to a TOP command
+ * @param idx  Index of the command
+ * @param rc   Result of the command, see pop_fetch_pipeline()
+ * @param data PopHeaderCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_header_done(int idx, int rc, void *data)
+{
+  struct PopHeaderCtx *hc = data;
+  struct PopMboxData *mdata = hc->mdata;
+  struct Email *e = hc->emails[idx];
+  char buf[LONG_STRING];
+
+  if (mdata->cmd_top == 2)
+  {
+    if (rc == 0)
     {
-      if (rc == 0)
-      {
-        mdata->cmd_top = 1;
+      mdata->cmd_top = 1;
 
-        mutt_debug(1, "set TOP capability\n");
-      }
+      mutt_debug(1, "set TOP capability\n");
+    }
 
-      if (rc == -2)
-      {
-        mdata->cmd_top = 0;
+    if (rc == -2)
+    {
+      mdata->cmd_top = 0;
 
-        mutt_debug(1, "unset TOP capability\n");
-        snprintf(mdata->err_msg, sizeof(mdata->err_msg), "%s",
-                 _("Command TOP is not supported by server"));
-      }
+      mutt_debug(1, "unset TOP capability\n");
+      snprintf(mdata->err_msg, sizeof(mdata->err_msg), "%s",
+               _("Command TOP is not supported by server"));
     }
   }
 
@@ -219,30 +258,98 @@ static int pop_read_header(struct PopMboxData *mdata, struct Email *e)
   {
     case 0:
     {
-      rewind(f);
-      e->env = mutt_rfc822_read_header(f, e, false, false);
+      const size_t length = (e->refno <= hc->max_refno) ? hc->sizes[e->refno] : 0;
+
+      fflush(hc->fp);
+      rewind(hc->fp);
+      e->env = mutt_rfc822_read_header(hc->fp, e, false, false);
       e->content->length = length - e->content->offset + 1;
-      rewind(f);
-      while (!feof(f))
+      rewind(hc->fp);
+      while (!feof(hc->fp))
       {
         e->content->length--;
-        fgets(buf, sizeof(buf), f);
+        fgets(buf, sizeof(buf), hc->fp);
       }
       break;
     }
     case -2:
     {
       mutt_error("%s", mdata->err_msg);
-      break;
+      hc->rc = rc;
+      return -1;
     }
     case -3:
     {
       mutt_error(_("Can't write header to temporary file"));
-      break;
+      hc->rc = rc;
+      return -1;
     }
   }
 
-  mutt_file_fclose(&f);
+  if (hc->progress)
+    mutt_progress_update(hc->progress, ++hc->done, -1);
+  return 0;
+}
+
+/**
+ * pop_read_headers - Read the headers of several messages
+ * @param mdata    POP Mailbox data
+ * @param emails   Emails to read
+ * @param num      Number of emails
+ * @param progress Progress bar, may be NULL
+ * @retval  0 Success
+ * @retval -1 Connection lost
+ * @retval -2 Invalid command or execution error
+ * @retval -3 Error writing to tempfile
+ *
+ * The sizes of all the messages are read with a single LIST.  The headers
+ * are read with TOP, which is pipelined if the server allows it.  If there's
+ * an error, the emails that haven't been read are left without an envelope.
+ */
+static int pop_read_headers(struct PopMboxData *mdata, struct Email **emails,
+                            int num, struct Progress *progress)
+{
+  struct PopHeaderCtx hc = { 0 };
+
+  hc.fp = mutt_file_mkstemp();
+  if (!hc.fp)
+  {
+    mutt_perror(_("Can't create temporary file"));
+    return -3;
+  }
+
+  hc.mdata = mdata;
+  hc.emails = emails;
+  hc.progress = progress;
+  for (int i = 0; i < num; i++)
+    hc.max_refno = MAX(hc.max_refno, emails[i]->refno);
+  hc.sizes = mutt_mem_calloc(hc.max_refno + 1, sizeof(size_t));
+
+  int rc = pop_fetch_data(mdata, "LIST\r\n", NULL, fetch_list, &hc);
+  if (rc == -2)
+    mutt_error("%s", mdata->err_msg);
+
+  if (rc == 0)
+  {
+    char buf[SHORT_STRING];
+    char **cmds = mutt_mem_calloc(num, sizeof(char *));
+    for (int i = 0; i < num; i++)
+    {
+      snprintf(buf, sizeof(buf), "TOP %d 0\r\n", emails[i]->refno);
+      cmds[i] = mutt_str_strdup(buf);
+    }
+
+    rc = pop_fetch_pipeline(mdata, cmds, num, fetch_header_line, fetch_header_done, &hc);
+    if (rc == -3)
+      rc = hc.rc;
+
+    for (int i = 0; i < num; i++)
+      FREE(&cmds[i]);
+    FREE(&cmds);
+  }
+
+  FREE(&hc.sizes);
+  mutt_file_fclose(&hc.fp);
   return rc;
 }
 
@@ -271,32 +378,27 @@ static int fetch_uidl(char *line, void *data)
   if (strlen(line) == 0)
     return -1;
 
-  int i;
-  for (i = 0; i < mailbox->msg_count; i++)
-  {
-    struct PopEmailData *edata = mailbox->hdrs[i]->data;
-    if (mutt_str_strcmp(line, edata->uid) == 0)
-      break;
-  }
-
-  if (i == mailbox->msg_count)
+  struct Email *e = mutt_hash_find(mdata->uid_hash, line);
+  if (!e)
   {
     mutt_debug(1, "new header %d %s\n", index, line);
 
-    if (i >= mailbox->hdrmax)
+    if (mailbox->msg_count >= mailbox->hdrmax)
       mx_alloc_memory(mailbox);
 
-    mailbox->msg_count++;
-    mailbox->hdrs[i] = mutt_email_new();
+    e = mutt_email_new();
+    mailbox->hdrs[mailbox->msg_count++] = e;
 
-    mailbox->hdrs[i]->data = new_emaildata(line);
-    mailbox->hdrs[i]->free_data = free_emaildata;
+    struct PopEmailData *edata = new_emaildata(line);
+    e->data = edata;
+    e->free_data = free_emaildata;
+    mutt_hash_insert(mdata->uid_hash, edata->uid, e);
   }
-  else if (mailbox->hdrs[i]->index != index - 1)
+  else if (e->index != index - 1)
     mdata->clear_cache = true;
 
-  mailbox->hdrs[i]->refno = index;
-  mailbox->hdrs[i]->index = index - 1;
+  e->refno = index;
+  e->index = index - 1;
 
   return 0;
 }
@@ -320,6 +422,10 @@ static int msg_cache_check(const char *id, struct BodyCache *bcache, void *data)
     return 0;
 #endif
 
+  /* keep fetch-mail's progress */
+  if (strcmp(FETCH_STATE, id) == 0)
+    return 0;
+
   for (int i = 0; i < mailbox->msg_count; i++)
   {
     struct PopEmailData *edata = mailbox->hdrs[i]->data;
@@ -379,6 +485,7 @@ static int pop_fetch_headers(struct Context *ctx)
 
 #ifdef USE_HCACHE
   header_cache_t *hc = pop_hcache_open(mdata, ctx->mailbox->path);
+  mutt_hcache_begin(hc);
 #endif
 
   time(&mdata->check_time);
@@ -387,6 +494,8 @@ static int pop_fetch_headers(struct Context *ctx)
   for (int i = 0; i < ctx->mailbox->msg_count; i++)
     ctx->mailbox->hdrs[i]->refno = -1;
 
+  pop_uid_hash_init(ctx->mailbox);
+
   const int old_count = ctx->mailbox->msg_count;
   int ret = pop_fetch_data(mdata, "UIDL\r\n", NULL, fetch_uidl, ctx->mailbox);
   const int new_count = ctx->mailbox->msg_count;
@@ -436,13 +545,14 @@ static int pop_fetch_headers(struct Context *ctx)
           deleted);
     }
 
-    bool hcached = false;
+    /* restore what we can from the header cache */
+    bool *hcached = mutt_mem_calloc(new_count - old_count + 1, sizeof(bool));
+    struct Email **missing = mutt_mem_calloc(new_count - old_count + 1, sizeof(struct Email *));
+    int num_missing = 0;
     for (i = old_count; i < new_count; i++)
     {
-      if (!ctx->mailbox->quiet)
-        mutt_progress_update(&progress, i + 1 - old_count, -1);
-      struct PopEmailData *edata = ctx->mailbox->hdrs[i]->data;
 #ifdef USE_HCACHE
+      struct PopEmailData *edata = ctx->mailbox->hdrs[i]->data;
       void *data = mutt_hcache_fetch(hc, edata->uid, strlen(edata->uid));
       if (data)
       {
@@ -461,26 +571,44 @@ static int pop_fetch_headers(struct Context *ctx)
          */
         struct Email *e = mutt_hcache_restore((unsigned char *) data);
         mutt_hcache_free(hc, &data);
+        mutt_hash_delete(mdata->uid_hash, edata->uid, ctx->mailbox->hdrs[i]);
         mutt_email_free(&ctx->mailbox->hdrs[i]);
         ctx->mailbox->hdrs[i] = e;
+        mutt_hash_insert(mdata->uid_hash, edata->uid, e);
         ctx->mailbox->hdrs[i]->refno = refno;
         ctx->mailbox->hdrs[i]->index = index;
 
         /* Reattach the private data */
         ctx->mailbox->hdrs[i]->data = edata;
         ctx->mailbox->hdrs[i]->free_data = free_emaildata;
-        ret = 0;
-        hcached = true;
+        hcached[i - old_count] = true;
+        continue;
       }
-      else
 #endif
-          if ((ret = pop_read_header(mdata, ctx->mailbox->hdrs[i])) < 0)
+      missing[num_missing++] = ctx->mailbox->hdrs[i];
+    }
+
+    /* fetch the rest from the server, all together */
+    if (num_missing > 0)
+    {
+      if (!ctx->mailbox->quiet)
+        mutt_progress_update(&progress, new_count - old_count - num_missing, -1);
+      ret = pop_read_headers(mdata, missing, num_missing,
+                             ctx->mailbox->quiet ? NULL : &progress);
+    }
+    FREE(&missing);
+
+    for (i = old_count; i < new_count; i++)
+    {
+      struct PopEmailData *edata = ctx->mailbox->hdrs[i]->data;
+      const bool hcached_i = hcached[i - old_count];
+
+      /* stop at the first header that couldn't be read */
+      if (!hcached_i && !ctx->mailbox->hdrs[i]->env)
         break;
 #ifdef USE_HCACHE
-      else
-      {
+      if (!hcached_i)
         mutt_hcache_store(hc, edata->uid, strlen(edata->uid), ctx->mailbox->hdrs[i], 0);
-      }
 #endif
 
       /* faked support for flags works like this:
@@ -498,7 +626,7 @@ static int pop_fetch_headers(struct Context *ctx)
           (mutt_bcache_exists(mdata->bcache, cache_id(edata->uid)) == 0);
       ctx->mailbox->hdrs[i]->old = false;
       ctx->mailbox->hdrs[i]->read = false;
-      if (hcached)
+      if (hcached_i)
       {
         if (bcached)
           ctx->mailbox->hdrs[i]->read = true;
@@ -513,6 +641,7 @@ static int pop_fetch_headers(struct Context *ctx)
 
       ctx->mailbox->msg_count++;
     }
+    FREE(&hcached);
 
     if (i > old_count)
       mx_update_context(ctx, i - old_count);
@@ -525,7 +654,11 @@ static int pop_fetch_headers(struct Context *ctx)
   if (ret < 0)
   {
     for (int i = ctx->mailbox->msg_count; i < new_count; i++)
+    {
+      struct PopEmailData *edata = ctx->mailbox->hdrs[i]->data;
+      mutt_hash_delete(mdata->uid_hash, edata->uid, ctx->mailbox->hdrs[i]);
       mutt_email_free(&ctx->mailbox->hdrs[i]);
+    }
     return ret;
   }
 
@@ -561,6 +694,188 @@ static void pop_clear_cache(struct PopMboxData *mdata)
   }
 }
 
+/**
+ * struct PopRetrCtx - Keep track of the messages being downloaded
+ */
+struct PopRetrCtx
+{
+  struct PopMboxData *mdata;
+  struct Context *ctx;  ///< Mailbox to save the messages to
+  struct Message *msg;  ///< Message being downloaded
+  int msgs;             ///< Number of messages on the server
+  char **uids;          ///< UIDLs of the messages, indexed by message number
+  bool *saved;          ///< Messages saved to the mailbox, indexed by message number
+  int *nums;            ///< Message numbers of the RETR commands
+  int total;            ///< Number of messages to download
+  const char *msgbuf;   ///< Progress message
+  bool rset;            ///< Messages mustn't be deleted from the server
+};
+
+/**
+ * fetch_state_uidl - Parse the answer to UIDL for fetch-mail
+ * @param line String to parse
+ * @param data PopRetrCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_state_uidl(char *line, void *data)
+{
+  struct PopRetrCtx *retr = data;
+  char *endp = NULL;
+
+  errno = 0;
+  int index = strtol(line, &endp, 10);
+  if (errno)
+    return -1;
+  while (*endp == ' ')
+    endp++;
+
+  if ((index > 0) && (index <= retr->msgs) && (*endp != '\0'))
+    mutt_str_replace(&retr->uids[index], endp);
+  return 0;
+}
+
+/**
+ * fetch_state_load - Find the messages that fetch-mail saved last time
+ * @param bcache Body cache of the POP account
+ * @param retr   Messages on the server
+ *
+ * The messages saved by an earlier fetch-mail, which didn't finish or left
+ * the messages on the server, are marked as saved.
+ */
+static void fetch_state_load(struct BodyCache *bcache, struct PopRetrCtx *retr)
+{
+  FILE *fp = mutt_bcache_get(bcache, FETCH_STATE);
+  if (!fp)
+    return;
+
+  struct Hash *done = mutt_hash_create(MAX(retr->msgs, 30), MUTT_HASH_STRDUP_KEYS);
+  char buf[LONG_STRING];
+  while (fgets(buf, sizeof(buf), fp))
+  {
+    mutt_str_remove_trailing_ws(buf);
+    if (buf[0] != '\0')
+      mutt_hash_insert(done, buf, retr);
+  }
+  mutt_file_fclose(&fp);
+
+  for (int i = 1; i <= retr->msgs; i++)
+    if (retr->uids[i] && mutt_hash_find(done, retr->uids[i]))
+      retr->saved[i] = true;
+
+  mutt_hash_destroy(&done);
+}
+
+/**
+ * fetch_state_save - Remember which messages fetch-mail has saved
+ * @param bcache Body cache of the POP account
+ * @param retr   Messages on the server
+ *
+ * Only messages still on the server are listed, so the messages that have
+ * been deleted drop out of the list next time.
+ */
+static void fetch_state_save(struct BodyCache *bcache, struct PopRetrCtx *retr)
+{
+  FILE *fp = mutt_bcache_put(bcache, FETCH_STATE);
+  if (!fp)
+    return;
+
+  for (int i = 1; i <= retr->msgs; i++)
+    if (retr->saved[i] && retr->uids[i])
+      fprintf(fp, "%s\n", retr->uids[i]);
+
+  if (mutt_file_fclose(&fp) == 0)
+    mutt_bcache_commit(bcache, FETCH_STATE);
+}
+
+/**
+ * fetch_retr_line - Write a line of a RETR answer to the mailbox
+ * @param line Message line, or NULL at the start of an answer
+ * @param data PopRetrCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_retr_line(char *line, void *data)
+{
+  struct PopRetrCtx *retr = data;
+
+  if (!line)
+  {
+    retr->msg = mx_msg_open_new(retr->ctx, NULL, MUTT_ADD_FROM);
+    return retr->msg ? 0 : -1;
+  }
+
+  return fetch_message(line, retr->msg->fp);
+}
+
+/**
+ * fetch_retr_done - Save a message downloaded with RETR
+ * @param idx  Index of the command
+ * @param rc   Result of the command, see pop_fetch_pipeline()
+ * @param data PopRetrCtx
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_retr_done(int idx, int rc, void *data)
+{
+  struct PopRetrCtx *retr = data;
+
+  if (retr->msg)
+  {
+    if ((rc == 0) && (mx_msg_commit(retr->ctx, retr->msg) != 0))
+      rc = -3;
+    mx_msg_close(retr->ctx, &retr->msg);
+  }
+
+  if (rc == -2)
+  {
+    mutt_error("%s", retr->mdata->err_msg);
+    return -1;
+  }
+  if (rc == -3)
+  {
+    retr->rset = true;
+    mutt_error(_("Error while writing mailbox"));
+    return -1;
+  }
+
+  retr->saved[retr->nums[idx]] = true;
+
+  /* L10N: The plural is picked by the second numerical argument, i.e.
+   * the %d right before 'messages', i.e. the total number of messages. */
+  mutt_message(ngettext("%s [%d of %d message read]",
+                        "%s [%d of %d messages read]", retr->total),
+               retr->msgbuf, idx + 1, retr->total);
+
+  if (SigInt)
+  {
+    SigInt = 0;
+    mutt_error(_("Interrupted"));
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * fetch_dele_done - Check the answer to DELE
+ * @param idx  Index of the command
+ * @param rc   Result of the command, see pop_fetch_pipeline()
+ * @param data POP Mailbox data
+ * @retval  0 Success
+ * @retval -1 Failure
+ */
+static int fetch_dele_done(int idx, int rc, void *data)
+{
+  struct PopMboxData *mdata = data;
+
+  if (rc == -2)
+  {
+    mutt_error("%s", mdata->err_msg);
+    return -1;
+  }
+  return 0;
+}
+
 /**
  * pop_fetch_mail - Fetch messages and save them in $spoolfile
  */
@@ -654,55 +969,78 @@ void pop_fetch_mail(void)
            bytes);
   mutt_message("%s", msgbuf);
 
-  for (int i = last + 1; i <= msgs; i++)
+  struct PopRetrCtx retr = { 0 };
+  retr.mdata = mdata;
+  retr.ctx = ctx;
+  retr.msgs = msgs;
+  retr.msgbuf = msgbuf;
+  retr.uids = mutt_mem_calloc(msgs + 1, sizeof(char *));
+  retr.saved = mutt_mem_calloc(msgs + 1, sizeof(bool));
+  retr.nums = mutt_mem_calloc(msgs + 1, sizeof(int));
+
+  /* skip the messages saved by an interrupted fetch */
+  mdata->bcache = mutt_bcache_open(&acct, NULL);
+  if (mdata->bcache && (mdata->cmd_uidl != 0))
   {
-    struct Message *msg = mx_msg_open_new(ctx, NULL, MUTT_ADD_FROM);
-    if (!msg)
-      ret = -3;
-    else
+    ret = pop_fetch_data(mdata, "UIDL\r\n", NULL, fetch_state_uidl, &retr);
+    if (ret == 0)
+      fetch_state_load(mdata->bcache, &retr);
+  }
+
+  char **cmds = mutt_mem_calloc(msgs + 1, sizeof(char *));
+  if (ret != -1)
+  {
+    for (int i = last + 1; i <= msgs; i++)
     {
+      if (retr.saved[i])
+        continue;
       snprintf(buffer, sizeof(buffer), "RETR %d\r\n", i);
-      ret = pop_fetch_data(mdata, buffer, NULL, fetch_message, msg->fp);
-      if (ret == -3)
-        rset = 1;
+      cmds[retr.total] = mutt_str_strdup(buffer);
+      retr.nums[retr.total++] = i;
+    }
+    if (retr.total < msgs - last)
+      mutt_debug(1, "%d messages were saved already\n", msgs - last - retr.total);
 
-      if (ret == 0 && mx_msg_commit(ctx, msg) != 0)
-      {
-        rset = 1;
-        ret = -3;
-      }
+    ret = pop_fetch_pipeline(mdata, cmds, retr.total, fetch_retr_line, fetch_retr_done, &retr);
+    if (retr.msg)
+      mx_msg_close(ctx, &retr.msg);
+    rset = retr.rset;
 
-      mx_msg_close(ctx, &msg);
-    }
+    if (mdata->bcache)
+      fetch_state_save(mdata->bcache, &retr);
+  }
 
-    if (ret == 0 && delanswer == MUTT_YES)
+  /* the deletions only take effect at QUIT, so they can wait until the
+   * messages have been saved */
+  if ((ret != -1) && !rset && (delanswer == MUTT_YES))
+  {
+    int num = 0;
+    for (int i = last + 1; i <= msgs; i++)
     {
-      /* delete the message on the server */
+      if (!retr.saved[i])
+        continue;
+      FREE(&cmds[num]);
       snprintf(buffer, sizeof(buffer), "DELE %d\r\n", i);
-      ret = pop_query(mdata, buffer, sizeof(buffer));
+      cmds[num++] = mutt_str_strdup(buffer);
     }
+    if (num > 0)
+      ret = pop_fetch_pipeline(mdata, cmds, num, NULL, fetch_dele_done, mdata);
+  }
 
-    if (ret == -1)
-    {
-      mx_mbox_close(&ctx, NULL);
-      goto fail;
-    }
-    if (ret == -2)
-    {
-      mutt_error("%s", mdata->err_msg);
-      break;
-    }
-    if (ret == -3)
-    {
-      mutt_error(_("Error while writing mailbox"));
-      break;
-    }
+  for (int i = 0; i <= msgs; i++)
+  {
+    FREE(&cmds[i]);
+    FREE(&retr.uids[i]);
+  }
+  FREE(&cmds);
+  FREE(&retr.uids);
+  FREE(&retr.saved);
+  FREE(&retr.nums);
 
-    /* L10N: The plural is picked by the second numerical argument, i.e.
-     * the %d right before 'messages', i.e. the total number of messages. */
-    mutt_message(ngettext("%s [%d of %d message read]",
-                          "%s [%d of %d messages read]", msgs - last),
-                 msgbuf, i - last, msgs - last);
+  if (ret == -1)
+  {
+    mx_mbox_close(&ctx, NULL);
+    goto fail;
   }
 
   mx_mbox_close(&ctx, NULL);
@@ -721,12 +1059,14 @@ finish:
   if (pop_query(mdata, buffer, sizeof(buffer)) == -1)
     goto fail;
   mutt_socket_close(conn);
+  mutt_bcache_close(&mdata->bcache);
   FREE(&mdata);
   return;
 
 fail:
   mutt_error(_("Server closed connection"));
   mutt_socket_close(conn);
+  mutt_bcache_close(&mdata->bcache);
   FREE(&mdata);
 }
 
@@ -869,6 +1209,7 @@ static int pop_mbox_sync(struct Context *ctx, int *index_hint)
 
 #ifdef USE_HCACHE
     hc = pop_hcache_open(mdata, ctx->mailbox->path);
+    mutt_hcache_begin(hc);
 #endif
 
     for (i = 0, j = 0, ret = 0; ret == 0 && i < ctx->mailbox->msg_count; i++)
@@ -910,6 +1251,14 @@ static int pop_mbox_sync(struct Context *ctx, int *index_hint)
 
     if (ret == 0)
     {
+      /* mx_update_tables() is going to free these */
+      for (i = 0; i < ctx->mailbox->msg_count; i++)
+      {
+        struct Email *e = ctx->mailbox->hdrs[i];
+        if (e->deleted || e->quasi_deleted)
+          mutt_hash_delete(mdata->uid_hash, ((struct PopEmailData *) e->data)->uid, e);
+      }
+
       mdata->clear_cache = true;
       pop_clear_cache(mdata);
       mdata->status = POP_DISCONNECTED;
@@ -947,6 +1296,7 @@ static int pop_mbox_close(struct Context *ctx)
     mutt_socket_free(mdata->conn);
 
   mutt_bcache_close(&mdata->bcache);
+  mutt_hash_destroy(&mdata->uid_hash);
 
   return 0;
 }
@@ -1186,11 +1536,14 @@ struct MxOps mx_pop_ops = {
   .mbox_check       = pop_mbox_check,
   .mbox_sync        = pop_mbox_sync,
   .mbox_close       = pop_mbox_close,
+  .mbox_flush       = NULL,
   .msg_open         = pop_msg_open,
   .msg_open_new     = NULL,
   .msg_commit       = NULL,
   .msg_close        = pop_msg_close,
   .msg_padding_size = NULL,
+  .msg_load_header  = NULL,
+  .msg_save_hcache  = NULL,
   .tags_edit        = NULL,
   .tags_commit      = NULL,
   .path_probe       = pop_path_probe,
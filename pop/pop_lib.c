@@ -152,6 +152,9 @@ static int fetch_capa(char *line, void *data)
   else if (mutt_str_strncasecmp(line, "TOP", 3) == 0)
     mdata->cmd_top = 1;
 
+  else if (mutt_str_strncasecmp(line, "PIPELINING", 10) == 0)
+    mdata->cmd_pipelining = true;
+
   return 0;
 }
 
@@ -205,6 +208,7 @@ static int pop_capabilities(struct PopMboxData *mdata, int mode)
     mdata->cmd_uidl = 0;
     mdata->cmd_top = 0;
     mdata->resp_codes = false;
+    mdata->cmd_pipelining = false;
     mdata->expire = true;
     mdata->login_delay = 0;
     FREE(&mdata->auth_list);
@@ -405,6 +409,7 @@ int pop_open_connection(struct PopMboxData *mdata)
 
   unsigned int n = 0, size = 0;
   sscanf(buf, "+OK %u %u", &n, &size);
+  mdata->num_msgs = n;
   mdata->size = size;
   return 0;
 
@@ -473,6 +478,7 @@ int pop_query_d(struct PopMboxData *mdata, char *buf, size_t buflen, char *msg)
     mutt_debug(MUTT_SOCK_LOG_CMD, "> %s", msg);
   }
 
+  mutt_trace_begin_cmd("pop_query", buf);
   mutt_socket_send_d(mdata->conn, buf, dbg);
 
   char *c = strpbrk(buf, " \r\n");
@@ -480,7 +486,9 @@ int pop_query_d(struct PopMboxData *mdata, char *buf, size_t buflen, char *msg)
     *c = '\0';
   snprintf(mdata->err_msg, sizeof(mdata->err_msg), "%s: ", buf);
 
-  if (mutt_socket_readln(buf, buflen, mdata->conn) < 0)
+  int rc = mutt_socket_readln(buf, buflen, mdata->conn);
+  mutt_trace_end("pop_query");
+  if (rc < 0)
   {
     mdata->status = POP_DISCONNECTED;
     return -1;
@@ -493,31 +501,25 @@ int pop_query_d(struct PopMboxData *mdata, char *buf, size_t buflen, char *msg)
 }
 
 /**
- * pop_fetch_data - Read Headers with callback function
- * @param mdata POP Mailbox data
- * @param query       POP query to send to server
+ * pop_read_lines - Read the lines of a multi-line answer
+ * @param mdata       POP Mailbox data
  * @param progressbar Progress bar
- * @param func        Function called for each header read
+ * @param func        Function called for each line read, may be NULL
  * @param data        Data to pass to the callback
  * @retval  0 Successful
  * @retval -1 Connection lost
- * @retval -2 Invalid command or execution error
  * @retval -3 Error in func(*line, *data)
  *
- * This function calls  func(*line, *data)  for each received line,
- * func(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
+ * The answer's status line must already have been read.  After an error in
+ * func(), the rest of the answer is still read.
  */
-int pop_fetch_data(struct PopMboxData *mdata, const char *query,
-                   struct Progress *progressbar, int (*func)(char *, void *), void *data)
+static int pop_read_lines(struct PopMboxData *mdata, struct Progress *progressbar,
+                          int (*func)(char *, void *), void *data)
 {
   char buf[LONG_STRING];
   long pos = 0;
   size_t lenbuf = 0;
-
-  mutt_str_strfcpy(buf, query, sizeof(buf));
-  int ret = pop_query(mdata, buf, sizeof(buf));
-  if (ret < 0)
-    return ret;
+  int ret = 0;
 
   char *inbuf = mutt_mem_malloc(sizeof(buf));
 
@@ -551,7 +553,7 @@ int pop_fetch_data(struct PopMboxData *mdata, const char *query,
     {
       if (progressbar)
         mutt_progress_update(progressbar, pos, -1);
-      if (ret == 0 && func(inbuf, data) < 0)
+      if (ret == 0 && func && func(inbuf, data) < 0)
         ret = -3;
       lenbuf = 0;
     }
@@ -563,6 +565,129 @@ int pop_fetch_data(struct PopMboxData *mdata, const char *query,
   return ret;
 }
 
+/**
+ * pop_fetch_data - Read Headers with callback function
+ * @param mdata POP Mailbox data
+ * @param query       POP query to send to server
+ * @param progressbar Progress bar
+ * @param func        Function called for each header read
+ * @param data        Data to pass to the callback
+ * @retval  0 Successful
+ * @retval -1 Connection lost
+ * @retval -2 Invalid command or execution error
+ * @retval -3 Error in func(*line, *data)
+ *
+ * This function calls  func(*line, *data)  for each received line,
+ * func(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
+ */
+int pop_fetch_data(struct PopMboxData *mdata, const char *query,
+                   struct Progress *progressbar, int (*func)(char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+
+  mutt_str_strfcpy(buf, query, sizeof(buf));
+  int ret = pop_query(mdata, buf, sizeof(buf));
+  if (ret < 0)
+    return ret;
+
+  return pop_read_lines(mdata, progressbar, func, data);
+}
+
+/**
+ * pop_fetch_pipeline - Send several commands at once, then read the answers
+ * @param mdata POP Mailbox data
+ * @param cmds  Commands, each ending with "\r\n"
+ * @param num   Number of commands
+ * @param func  Function called for each line of an answer, or NULL
+ * @param done  Function called for each answer
+ * @param data  Data to pass to the callbacks
+ * @retval  0 Successful
+ * @retval -1 Connection lost
+ * @retval -3 done() asked to stop
+ *
+ * If func is given, the answers are multi-line, as for TOP or RETR; if it's
+ * NULL, they're a single line, as for DELE.  Before the lines of each
+ * successful answer, func(NULL, data) is called.
+ *
+ * After each answer, done(index, rc, data) is called, where rc is 0, -2 for
+ * an error from the server (the message is in PopMboxData::err_msg) or -3 if
+ * func() failed.  If done() returns a negative number, the rest of the batch
+ * is still read, but not passed to the callbacks.
+ *
+ * If the server supports PIPELINING (RFC2449), up to #POP_PIPELINE_DEPTH
+ * commands are sent together, otherwise they're sent one at a time.
+ */
+int pop_fetch_pipeline(struct PopMboxData *mdata, char **cmds, int num,
+                       int (*func)(char *, void *), int (*done)(int, int, void *), void *data)
+{
+  struct Buffer *batch = mutt_buffer_new();
+  char buf[LONG_STRING];
+  const int depth = mdata->cmd_pipelining ? POP_PIPELINE_DEPTH : 1;
+  int ret = 0;
+
+  for (int next = 0; (next < num) && (ret == 0);)
+  {
+    if (mdata->status != POP_CONNECTED)
+    {
+      ret = -1;
+      break;
+    }
+
+    const int end = MIN(next + depth, num);
+    mutt_buffer_reset(batch);
+    for (int i = next; i < end; i++)
+      mutt_buffer_addstr(batch, cmds[i]);
+    mutt_socket_send_d(mdata->conn, batch->data, MUTT_SOCK_LOG_CMD);
+
+    for (bool stop = false; next < end; next++)
+    {
+      if (mutt_socket_readln(buf, sizeof(buf), mdata->conn) < 0)
+      {
+        mdata->status = POP_DISCONNECTED;
+        ret = -1;
+        break;
+      }
+
+      int rc = 0;
+      if (mutt_str_strncmp(buf, "+OK", 3) == 0)
+      {
+        if (func)
+        {
+          if (!stop && (func(NULL, data) < 0))
+            rc = -3;
+          const int lrc = pop_read_lines(mdata, NULL, (stop || rc) ? NULL : func, data);
+          if (lrc == -1)
+          {
+            ret = -1;
+            break;
+          }
+          if (rc == 0)
+            rc = lrc;
+        }
+      }
+      else
+      {
+        mutt_str_strfcpy(mdata->err_msg, cmds[next], sizeof(mdata->err_msg));
+        char *c = strpbrk(mdata->err_msg, " \r\n");
+        if (c)
+          *c = '\0';
+        mutt_str_strcat(mdata->err_msg, sizeof(mdata->err_msg), ": ");
+        pop_error(mdata, buf);
+        rc = -2;
+      }
+
+      if (!stop && (done(next, rc, data) < 0))
+      {
+        stop = true;
+        ret = -3;
+      }
+    }
+  }
+
+  mutt_buffer_free(&batch);
+  return ret;
+}
+
 /**
  * check_uidl - find message with this UIDL and set refno
  * @param line String containing UIDL
@@ -586,17 +711,31 @@ static int check_uidl(char *line, void *data)
   memmove(line, endp, strlen(endp) + 1);
 
   struct Mailbox *mailbox = data;
+  struct PopMboxData *mdata = pop_get_mdata(mailbox);
+  struct Email *e = mutt_hash_find(mdata->uid_hash, line);
+  if (e)
+    e->refno = index;
+
+  return 0;
+}
+
+/**
+ * pop_uid_hash_init - Create the UIDL hash, if needed
+ * @param mailbox Mailbox
+ */
+void pop_uid_hash_init(struct Mailbox *mailbox)
+{
+  struct PopMboxData *mdata = pop_get_mdata(mailbox);
+  if (mdata->uid_hash)
+    return;
+
+  const size_t nelem = MAX((size_t) mailbox->msg_count, (size_t) mdata->num_msgs);
+  mdata->uid_hash = mutt_hash_create(MAX(nelem, 30), 0);
   for (int i = 0; i < mailbox->msg_count; i++)
   {
     struct PopEmailData *edata = mailbox->hdrs[i]->data;
-    if (mutt_str_strcmp(edata->uid, line) == 0)
-    {
-      mailbox->hdrs[i]->refno = index;
-      break;
-    }
+    mutt_hash_insert(mdata->uid_hash, edata->uid, mailbox->hdrs[i]);
   }
-
-  return 0;
 }
 
 /**
@@ -628,6 +767,7 @@ int pop_reconnect(struct Mailbox *mailbox)
       for (int i = 0; i < mailbox->msg_count; i++)
         mailbox->hdrs[i]->refno = -1;
 
+      pop_uid_hash_init(mailbox);
       ret = pop_fetch_data(mdata, "UIDL\r\n", &progressbar, check_uidl, mailbox);
       if (ret == -2)
       {
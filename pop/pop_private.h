@@ -40,6 +40,9 @@ struct Progress;
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
+/* most commands to send before reading the answers, with PIPELINING */
+#define POP_PIPELINE_DEPTH 16
+
 /**
  * enum PopStatus - POP server responses
  */
@@ -86,9 +89,12 @@ struct PopMboxData
   unsigned int cmd_uidl : 2; /**< optional command UIDL */
   unsigned int cmd_top : 2;  /**< optional command TOP */
   bool resp_codes : 1;       /**< server supports extended response codes */
+  bool cmd_pipelining : 1;   /**< server supports PIPELINING (RFC2449) */
   bool expire : 1;           /**< expire is greater than 0 */
   bool clear_cache : 1;
   size_t size;
+  unsigned int num_msgs; /**< number of messages, from STAT */
+  struct Hash *uid_hash; /**< emails, by UIDL */
   time_t check_time;
   time_t login_delay; /**< minimal login delay  capability */
   char *auth_list;    /**< list of auth mechanisms */
@@ -130,7 +136,10 @@ int pop_open_connection(struct PopMboxData *mdata);
 int pop_query_d(struct PopMboxData *mdata, char *buf, size_t buflen, char *msg);
 int pop_fetch_data(struct PopMboxData *mdata, const char *query, struct Progress *progressbar,
                    int (*func)(char *, void *), void *data);
+int pop_fetch_pipeline(struct PopMboxData *mdata, char **cmds, int num,
+                       int (*func)(char *, void *), int (*done)(int, int, void *), void *data);
 int pop_reconnect(struct Mailbox *mailbox);
+void pop_uid_hash_init(struct Mailbox *mailbox);
 void pop_logout(struct Mailbox *mailbox);
 struct PopMboxData *pop_get_mdata(struct Mailbox *m);
 
@@ -59,6 +59,7 @@
 #include "sendlib.h"
 #include "sort.h"
 #include "state.h"
+#include "maildir/maildir.h"
 #ifdef USE_IMAP
 #include "imap/imap.h"
 #endif
@@ -74,6 +75,83 @@ static const struct Mapping PostponeHelp[] = {
 static short PostCount = 0;
 static struct Context *PostContext = NULL;
 static short UpdateNumPostponed = 0;
+static time_t LastModify = 0; ///< mtime of $postponed when PostCount was last known
+
+/**
+ * postponed_mtime - Get the time that the postponed mailbox last changed
+ * @param path Path to the mailbox
+ * @param st   Buffer for the stat info
+ * @retval true  Success, st is filled in
+ * @retval false The mailbox doesn't exist
+ *
+ * For a Maildir, the "new" directory is checked, since that's where messages
+ * are delivered.
+ */
+static bool postponed_mtime(const char *path, struct stat *st)
+{
+  if (stat(path, st) == -1)
+    return false;
+
+  if (S_ISDIR(st->st_mode))
+  {
+    /* if we have a maildir mailbox, we need to stat the "new" dir */
+    char buf[PATH_MAX];
+
+    snprintf(buf, sizeof(buf), "%s/new", path);
+    if (access(buf, F_OK) == 0 && stat(buf, st) == -1)
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * postponed_count - Count the messages in the postponed mailbox
+ * @param path Path to the mailbox
+ * @retval num Number of messages
+ *
+ * Maildir and MH folders are counted by listing their directories.  Only
+ * other local folders need to be opened.
+ */
+static int postponed_count(const char *path)
+{
+  int count = -1;
+
+  switch (mx_path_probe(path, NULL))
+  {
+    case MUTT_MAILDIR:
+      count = maildir_count_messages(path);
+      break;
+    case MUTT_MH:
+      count = mh_count_messages(path);
+      break;
+    default:
+      break;
+  }
+
+  if (count >= 0)
+  {
+    mutt_debug(3, "%d postponed messages counted.\n", count);
+    return count;
+  }
+
+#ifdef USE_NNTP
+  int optnews = OptNews;
+  if (optnews)
+    OptNews = false;
+#endif
+  struct Context *ctx = mx_mbox_open(path, MUTT_NOSORT | MUTT_QUIET);
+  if (ctx)
+    count = ctx->mailbox->msg_count;
+  mx_fastclose_mailbox(ctx);
+  mutt_context_free(&ctx);
+#ifdef USE_NNTP
+  if (optnews)
+    OptNews = true;
+#endif
+
+  return (count > 0) ? count : 0;
+}
 
 /**
  * mutt_num_postponed - Return the number of postponed messages
@@ -86,7 +164,6 @@ int mutt_num_postponed(bool force)
 {
   struct stat st;
 
-  static time_t LastModify = 0;
   static char *OldPostponed = NULL;
 
   if (UpdateNumPostponed)
@@ -127,57 +204,52 @@ int mutt_num_postponed(bool force)
   }
 #endif
 
-  if (stat(Postponed, &st) == -1)
+  if (!postponed_mtime(Postponed, &st))
   {
     PostCount = 0;
     LastModify = 0;
     return 0;
   }
 
-  if (S_ISDIR(st.st_mode))
-  {
-    /* if we have a maildir mailbox, we need to stat the "new" dir */
-
-    char buf[PATH_MAX];
-
-    snprintf(buf, sizeof(buf), "%s/new", Postponed);
-    if (access(buf, F_OK) == 0 && stat(buf, &st) == -1)
-    {
-      PostCount = 0;
-      LastModify = 0;
-      return 0;
-    }
-  }
-
   if (LastModify < st.st_mtime)
   {
-#ifdef USE_NNTP
-    int optnews = OptNews;
-#endif
     LastModify = st.st_mtime;
 
     if (access(Postponed, R_OK | F_OK) != 0)
       return PostCount = 0;
-#ifdef USE_NNTP
-    if (optnews)
-      OptNews = false;
-#endif
-    struct Context *ctx = mx_mbox_open(Postponed, MUTT_NOSORT | MUTT_QUIET);
-    if (!ctx)
-      PostCount = 0;
-    else
-      PostCount = ctx->mailbox->msg_count;
-    mx_fastclose_mailbox(ctx);
-    mutt_context_free(&ctx);
-#ifdef USE_NNTP
-    if (optnews)
-      OptNews = true;
-#endif
+    PostCount = postponed_count(Postponed);
   }
 
   return PostCount;
 }
 
+/**
+ * postponed_changed - Adjust the count after NeoMutt changed the mailbox
+ * @param count New number of postponed messages
+ *
+ * The change was made by NeoMutt itself, so the mailbox doesn't need to be
+ * counted again.  If the mailbox was also changed by someone else in the
+ * same second, the count will be wrong until the next forced check.
+ */
+static void postponed_changed(int count)
+{
+  struct stat st;
+
+  PostCount = (count > 0) ? count : 0;
+  if (Postponed && postponed_mtime(Postponed, &st))
+    LastModify = st.st_mtime;
+}
+
+/**
+ * mutt_postponed_added - Count a message that NeoMutt has just postponed
+ *
+ * This avoids reopening, or asking the server about, the postponed mailbox.
+ */
+void mutt_postponed_added(void)
+{
+  postponed_changed(PostCount + 1);
+}
+
 /**
  * mutt_update_num_postponed - Force the update of the number of postponed messages
  */
@@ -326,13 +398,14 @@ int mutt_get_postponed(struct Context *ctx, struct Email *hdr,
   mutt_set_flag(PostContext, e, MUTT_PURGE, 1);
 
   /* update the count for the status display */
-  PostCount = PostContext->mailbox->msg_count - PostContext->deleted;
+  const int count = PostContext->mailbox->msg_count - PostContext->deleted;
 
   /* avoid the "purge deleted messages" prompt */
   opt_delete = Delete;
   Delete = MUTT_YES;
   mx_mbox_close(&PostContext, NULL);
   Delete = opt_delete;
+  postponed_changed(count);
 
   struct ListNode *np, *tmp;
   STAILQ_FOREACH_SAFE(np, &hdr->env->userhdrs, entries, tmp)
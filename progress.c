@@ -31,7 +31,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 #include "mutt/mutt.h"
 #include "progress.h"
 #include "curs_lib.h"
@@ -40,7 +40,65 @@
 #include "options.h"
 
 /* These Config Variables are only used in progress.c */
-short TimeInc; ///< Config: Frequency of progress bar updates (milliseconds)
+bool ProgressRate; ///< Config: Show the throughput and time left
+short TimeInc;     ///< Config: Frequency of progress bar updates (milliseconds)
+
+/* Show an update after this long, even if the increment hasn't been reached */
+#define PROGRESS_IDLE_MS 1000
+
+/**
+ * progress_now - Get the time for the progress bar
+ * @retval num Milliseconds from an arbitrary point, unaffected by clock changes
+ */
+static uint64_t progress_now(void)
+{
+  struct timespec ts = { 0, 0 };
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+  {
+    mutt_debug(1, "clock_gettime failed: %d\n", errno);
+    return 0;
+  }
+  return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/**
+ * progress_rate - Describe the throughput and the time left
+ * @param progress Progress bar
+ * @param now      Current time, see progress_now()
+ * @param buf      Buffer for the result
+ * @param buflen   Length of buffer
+ *
+ * Nothing is written until the progress bar has been running for a second.
+ */
+static void progress_rate(struct Progress *progress, uint64_t now, char *buf, size_t buflen)
+{
+  buf[0] = '\0';
+  if (!ProgressRate || (progress->pos <= 0) || (now < (progress->start + 1000)))
+    return;
+
+  const uint64_t elapsed = now - progress->start;
+  const double rate = (double) progress->pos * 1000 / elapsed;
+  char ratestr[SHORT_STRING];
+
+  if (progress->flags & MUTT_PROGRESS_SIZE)
+  {
+    char sizestr[SHORT_STRING];
+    mutt_str_pretty_size(sizestr, sizeof(sizestr), (size_t) rate);
+    snprintf(ratestr, sizeof(ratestr), "%s/s", sizestr);
+  }
+  else
+    snprintf(ratestr, sizeof(ratestr), "%.0f/s", rate);
+
+  if ((progress->size == 0) || ((size_t) progress->pos >= progress->size))
+  {
+    snprintf(buf, buflen, ", %s", ratestr);
+    return;
+  }
+
+  const unsigned long left = (progress->size - progress->pos) / rate;
+  /* L10N: Progress bar: throughput, then minutes and seconds left */
+  snprintf(buf, buflen, _(", %s, %lu:%02lu left"), ratestr, left / 60, left % 60);
+}
 
 /**
  * message_bar - Draw a colourful progress bar
@@ -113,8 +171,6 @@ static void message_bar(int percent, const char *fmt, ...)
 void mutt_progress_init(struct Progress *progress, const char *msg,
                         unsigned short flags, unsigned short inc, size_t size)
 {
-  struct timeval tv = { 0, 0 };
-
   if (!progress)
     return;
   if (OptNoCurses)
@@ -143,14 +199,8 @@ void mutt_progress_init(struct Progress *progress, const char *msg,
       mutt_message(msg);
     return;
   }
-  if (gettimeofday(&tv, NULL) < 0)
-    mutt_debug(1, "gettimeofday failed: %d\n", errno);
-  /* if timestamp is 0 no time-based suppression is done */
-  if (TimeInc != 0)
-  {
-    progress->timestamp =
-        ((unsigned int) tv.tv_sec * 1000) + (unsigned int) (tv.tv_usec / 1000);
-  }
+  progress->start = progress_now();
+  progress->timestamp = progress->start;
   mutt_progress_update(progress, 0, 0);
 }
 
@@ -170,9 +220,9 @@ void mutt_progress_init(struct Progress *progress, const char *msg,
 void mutt_progress_update(struct Progress *progress, long pos, int percent)
 {
   char posstr[SHORT_STRING];
+  char ratestr[STRING];
   bool update = false;
-  struct timeval tv = { 0, 0 };
-  unsigned int now = 0;
+  uint64_t now = 0;
 
   if (OptNoCurses)
     return;
@@ -189,13 +239,21 @@ void mutt_progress_update(struct Progress *progress, long pos, int percent)
   else if (pos >= (progress->pos + progress->inc))
     update = true;
 
-  /* skip refresh if not enough time has passed */
-  if (update && progress->timestamp && (gettimeofday(&tv, NULL) == 0))
+  if (TimeInc != 0)
   {
-    now = ((unsigned int) tv.tv_sec * 1000) + (unsigned int) (tv.tv_usec / 1000);
-    if (now && ((now - progress->timestamp) < TimeInc))
+    now = progress_now();
+    /* skip refresh if not enough time has passed */
+    if (update && ((now - progress->timestamp) < TimeInc))
       update = false;
+    /* but don't leave a slow transfer looking stuck */
+    else if (!update && (pos > progress->pos) &&
+             ((now - progress->timestamp) >= PROGRESS_IDLE_MS))
+    {
+      update = true;
+    }
   }
+  else if (ProgressRate)
+    now = progress_now();
 
   /* always show the first update */
   if (pos == 0)
@@ -205,7 +263,8 @@ void mutt_progress_update(struct Progress *progress, long pos, int percent)
   {
     if (progress->flags & MUTT_PROGRESS_SIZE)
     {
-      pos = pos / (progress->inc << 10) * (progress->inc << 10);
+      if (pos >= (progress->pos + (progress->inc << 10)))
+        pos = pos / (progress->inc << 10) * (progress->inc << 10);
       mutt_str_pretty_size(posstr, sizeof(posstr), pos);
     }
     else
@@ -216,22 +275,24 @@ void mutt_progress_update(struct Progress *progress, long pos, int percent)
     progress->pos = pos;
     if (now)
       progress->timestamp = now;
+    progress_rate(progress, now, ratestr, sizeof(ratestr));
 
     if (progress->size > 0)
     {
       message_bar(
           (percent > 0) ? percent :
                           (int) (100.0 * (double) progress->pos / progress->size),
-          "%s %s/%s (%d%%)", progress->msg, posstr, progress->sizestr,
+          "%s %s/%s (%d%%)%s", progress->msg, posstr, progress->sizestr,
           (percent > 0) ? percent :
-                          (int) (100.0 * (double) progress->pos / progress->size));
+                          (int) (100.0 * (double) progress->pos / progress->size),
+          ratestr);
     }
     else
     {
       if (percent > 0)
-        message_bar(percent, "%s %s (%d%%)", progress->msg, posstr, percent);
+        message_bar(percent, "%s %s (%d%%)%s", progress->msg, posstr, percent, ratestr);
       else
-        mutt_message("%s %s", progress->msg, posstr);
+        mutt_message("%s %s%s", progress->msg, posstr, ratestr);
     }
   }
 
@@ -23,10 +23,13 @@
 #ifndef MUTT_PROGRESS_H
 #define MUTT_PROGRESS_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "mutt/mutt.h"
 
 /* These Config Variables are only used in progress.c */
+extern bool  ProgressRate;
 extern short TimeInc;
 
 #define MUTT_PROGRESS_SIZE (1 << 0) /**< traffic-based progress */
@@ -42,7 +45,8 @@ struct Progress
   const char *msg;
   long pos;
   size_t size;
-  unsigned int timestamp;
+  uint64_t timestamp; ///< Time of the last update (ms, monotonic)
+  uint64_t start;     ///< Time the progress bar was set up (ms, monotonic)
   char sizestr[SHORT_STRING];
 };
 
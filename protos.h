@@ -49,6 +49,8 @@ int mutt_system(const char *cmd);
 int mutt_set_xdg_path(enum XdgType type, char *buf, size_t bufsize);
 void mutt_help(int menu);
 void mutt_make_help(char *d, size_t dlen, const char *txt, int menu, int op);
+void mutt_flag_batch_begin(struct Context *ctx);
+int mutt_flag_batch_end(void);
 void mutt_set_flag_update(struct Context *ctx, struct Email *e, int flag, bool bf, bool upd_ctx);
 #define mutt_set_flag(a, b, c, d) mutt_set_flag_update(a, b, c, d, true)
 void mutt_signal_init(void);
@@ -67,6 +69,7 @@ int mutt_parse_crypt_hdr(const char *p, int set_empty_signas, int crypt_app);
 int mutt_num_postponed(bool force);
 int mutt_thread_set_flag(struct Email *e, int flag, int bf, int subthread);
 void mutt_update_num_postponed(void);
+void mutt_postponed_added(void);
 int url_parse_mailto(struct Envelope *e, char **body, const char *src);
 int mutt_is_quote_line(char *buf, regmatch_t *pmatch);
 
@@ -74,7 +77,11 @@ int mutt_is_quote_line(char *buf, regmatch_t *pmatch);
 int wcscasecmp(const wchar_t *a, const wchar_t *b);
 #endif
 
+bool mutt_hdrshare_listener(const struct ConfigSet *cs, struct HashElem *he,
+                            const char *name, enum ConfigEvent ev);
 bool mutt_reply_listener(const struct ConfigSet *cs, struct HashElem *he,
                          const char *name, enum ConfigEvent ev);
+bool mutt_tags_listener(const struct ConfigSet *cs, struct HashElem *he,
+                        const char *name, enum ConfigEvent ev);
 
 #endif /* MUTT_PROTOS_H */
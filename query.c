@@ -21,11 +21,18 @@
  */
 
 #include "config.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <regex.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 #include "mutt/mutt.h"
 #include "email/lib.h"
 #include "mutt.h"
@@ -43,8 +50,11 @@
 #include "send.h"
 
 /* These Config Variables are only used in query.c */
+bool QueryCachePrefix; ///< Config: Filter cached results for longer queries
+short QueryCacheTtl; ///< Config: Seconds to keep the results of a query
 char *QueryCommand; ///< Config: External command to query and external address book
 char *QueryFormat; ///< Config: printf-like format string for the query menu (address book)
+bool QueryStream; ///< Config: Show the query menu while the query is still running
 
 /**
  * struct Query - An entry from an external address-book
@@ -121,82 +131,446 @@ static void free_query(struct Query **query)
 }
 
 /**
- * run_query - Run an external program to find Addresses
+ * copy_query - Copy a list of Queries
+ * @param q     Query List to copy
+ * @param match If not NULL, only copy the Queries matching this string
+ * @retval ptr New Query List
+ */
+static struct Query *copy_query(struct Query *q, const char *match)
+{
+  struct Query *first = NULL;
+  struct Query **last = &first;
+
+  for (; q; q = q->next)
+  {
+    if (match)
+    {
+      bool found = mutt_str_stristr(q->name, match) || mutt_str_stristr(q->other, match);
+      for (struct Address *a = q->addr; a && !found; a = a->next)
+        found = mutt_str_stristr(a->mailbox, match) || mutt_str_stristr(a->personal, match);
+      if (!found)
+        continue;
+    }
+
+    struct Query *copy = mutt_mem_calloc(1, sizeof(struct Query));
+    copy->addr = mutt_addr_copy_list(q->addr, false);
+    copy->name = mutt_str_strdup(q->name);
+    copy->other = mutt_str_strdup(q->other);
+    *last = copy;
+    last = &copy->next;
+  }
+
+  return first;
+}
+
+/**
+ * struct QueryCacheEntry - The results of a recent Query
+ */
+struct QueryCacheEntry
+{
+  char *command;         /**< $query_command that was run */
+  char *query;           /**< String that was matched */
+  char *msg;             /**< Status message printed by the command */
+  time_t time;           /**< When the command was run */
+  struct Query *results; /**< Query List of results */
+};
+
+#define QUERY_CACHE_SIZE 16
+
+static struct QueryCacheEntry QueryCache[QUERY_CACHE_SIZE];
+
+/**
+ * query_cache_free - Forget a cached Query
+ * @param qc Cache entry to free
+ */
+static void query_cache_free(struct QueryCacheEntry *qc)
+{
+  FREE(&qc->command);
+  FREE(&qc->query);
+  FREE(&qc->msg);
+  free_query(&qc->results);
+  qc->time = 0;
+}
+
+/**
+ * query_cache_lookup - Look for the results of a Query in the cache
+ * @param[in]  s       String to match
+ * @param[out] results Query List of results, may be NULL
+ * @param[out] msg     Status message printed by the command
+ * @retval true The results were found
+ *
+ * If $query_cache_prefix is set, the results of a shorter query, that this
+ * one starts with, are filtered.
+ */
+static bool query_cache_lookup(const char *s, struct Query **results, const char **msg)
+{
+  struct QueryCacheEntry *best = NULL;
+  size_t bestlen = 0;
+  const time_t now = time(NULL);
+
+  if (QueryCacheTtl <= 0)
+    return false;
+
+  for (int i = 0; i < QUERY_CACHE_SIZE; i++)
+  {
+    struct QueryCacheEntry *qc = &QueryCache[i];
+    if (!qc->query)
+      continue;
+
+    if ((now < qc->time) || (now - qc->time >= QueryCacheTtl) ||
+        (mutt_str_strcmp(qc->command, QueryCommand) != 0))
+    {
+      query_cache_free(qc);
+      continue;
+    }
+
+    const size_t len = mutt_str_strlen(qc->query);
+    if (mutt_str_strcmp(qc->query, s) == 0)
+    {
+      best = qc;
+      bestlen = len;
+      break;
+    }
+
+    if (QueryCachePrefix && (len > bestlen) && (mutt_str_strncmp(qc->query, s, len) == 0))
+    {
+      best = qc;
+      bestlen = len;
+    }
+  }
+
+  if (!best)
+    return false;
+
+  const bool exact = (mutt_str_strcmp(best->query, s) == 0);
+  mutt_debug(2, "%s cached results for '%s' from '%s'\n",
+             exact ? "using" : "filtering", s, best->query);
+  *results = copy_query(best->results, exact ? NULL : s);
+  *msg = best->msg;
+  return true;
+}
+
+/**
+ * query_cache_add - Save the results of a Query
+ * @param s       String that was matched
+ * @param results Query List of results, the cache takes ownership
+ * @param msg     Status message printed by the command
+ */
+static void query_cache_add(const char *s, struct Query *results, const char *msg)
+{
+  struct QueryCacheEntry *qc = &QueryCache[0];
+
+  /* replace the same query, or the oldest one */
+  for (int i = 0; i < QUERY_CACHE_SIZE; i++)
+  {
+    if (mutt_str_strcmp(QueryCache[i].query, s) == 0)
+    {
+      qc = &QueryCache[i];
+      break;
+    }
+    if (QueryCache[i].time < qc->time)
+      qc = &QueryCache[i];
+  }
+
+  query_cache_free(qc);
+  qc->command = mutt_str_strdup(QueryCommand);
+  qc->query = mutt_str_strdup(s);
+  qc->msg = mutt_str_strdup(msg);
+  qc->time = time(NULL);
+  qc->results = results;
+}
+
+/**
+ * struct QueryStream - A running query command
+ */
+struct QueryStream
+{
+  char *query;          /**< String to match */
+  pid_t pid;            /**< Process running $query_command */
+  int fd;               /**< Output of the command, -1 once it has all been read */
+  bool quiet;           /**< Don't print progress messages */
+  bool have_msg;        /**< The first line, a status message, has been read */
+  char msg[STRING];     /**< Status message */
+  char *tail;           /**< Start of a line whose end hasn't arrived yet */
+  size_t tail_len;      /**< Length of tail */
+  size_t tail_max;      /**< Allocated size of tail */
+  int count;            /**< Number of results read */
+  struct Query *all;    /**< Copy of all the results, for the cache */
+  struct Query **last;  /**< End of the list of copies */
+};
+
+static struct QueryStream *CurrentQuery = NULL; ///< Query still running in the query menu
+
+/**
+ * query_stream_open - Start the query command
  * @param s     String to match
  * @param quiet If true, don't print progress messages
- * @retval ptr Query List of results
+ * @retval ptr  Running query
+ * @retval NULL Error
  */
-static struct Query *run_query(char *s, int quiet)
+static struct QueryStream *query_stream_open(const char *s, bool quiet)
 {
-  FILE *fp = NULL;
-  struct Query *first = NULL;
-  struct Query *cur = NULL;
   char cmd[HUGE_STRING];
-  char *buf = NULL;
-  size_t buflen;
-  int dummy = 0;
-  char msg[STRING];
-  char *p = NULL;
-  pid_t thepid;
+  int fds[2];
 
   mutt_file_expand_fmt_quote(cmd, sizeof(cmd), QueryCommand, s);
 
-  thepid = mutt_create_filter(cmd, NULL, &fp, NULL);
+  if (pipe(fds) < 0)
+  {
+    mutt_debug(1, "unable to create pipe: %s\n", strerror(errno));
+    return NULL;
+  }
+
+  mutt_sig_block_system();
+  pid_t thepid = fork();
+  if (thepid == 0)
+  {
+    mutt_sig_unblock_system(false);
+    /* a process group of its own, so the whole query can be stopped, and
+     * it stops by itself if nobody reads its output */
+    setpgid(0, 0);
+    signal(SIGPIPE, SIG_DFL);
+    close(fds[0]);
+    dup2(fds[1], 1);
+    close(fds[1]);
+    execle(EXECSHELL, "sh", "-c", cmd, NULL, mutt_envlist_getlist());
+    _exit(127);
+  }
+  mutt_sig_unblock_system(true);
+  close(fds[1]);
+
   if (thepid < 0)
   {
     mutt_debug(1, "unable to fork command: %s\n", cmd);
-    return 0;
+    close(fds[0]);
+    return NULL;
   }
+  setpgid(thepid, thepid);
+
+  struct QueryStream *qs = mutt_mem_calloc(1, sizeof(struct QueryStream));
+  qs->query = mutt_str_strdup(s);
+  qs->pid = thepid;
+  qs->fd = fds[0];
+  qs->quiet = quiet;
+  qs->last = &qs->all;
+
   if (!quiet)
     mutt_message(_("Waiting for response..."));
-  fgets(msg, sizeof(msg), fp);
-  p = strrchr(msg, '\n');
+  return qs;
+}
+
+/**
+ * query_stream_line - Parse one line of the query command's output
+ * @param[in]  qs      Running query
+ * @param[in]  line    Line to parse, without the newline
+ * @param[out] results Query List to add to
+ * @retval true A result was added
+ */
+static bool query_stream_line(struct QueryStream *qs, char *line, struct Query ***results)
+{
+  if (!qs->have_msg)
+  {
+    mutt_str_strfcpy(qs->msg, line, sizeof(qs->msg));
+    qs->have_msg = true;
+    return false;
+  }
+
+  char *p = strtok(line, "\t\n");
+  if (!p)
+    return false;
+
+  struct Query *cur = mutt_mem_calloc(1, sizeof(struct Query));
+  cur->addr = mutt_addr_parse_list(cur->addr, p);
+  p = strtok(NULL, "\t\n");
   if (p)
-    *p = '\0';
-  while ((buf = mutt_file_read_line(buf, &buflen, fp, &dummy, 0)))
   {
-    p = strtok(buf, "\t\n");
+    cur->name = mutt_str_strdup(p);
+    p = strtok(NULL, "\t\n");
     if (p)
+      cur->other = mutt_str_strdup(p);
+  }
+
+  if (QueryCacheTtl > 0)
+  {
+    *qs->last = copy_query(cur, NULL);
+    qs->last = &(*qs->last)->next;
+  }
+
+  **results = cur;
+  *results = &cur->next;
+  qs->count++;
+  return true;
+}
+
+/**
+ * query_stream_read - Read the next part of the query command's output
+ * @param[in]     qs      Running query
+ * @param[in]     timeout Milliseconds to wait, or -1 to wait forever
+ * @param[in]     keys    If true, stop waiting when a key is pressed
+ * @param[in,out] results End of the Query List to add to
+ * @retval >=0 Number of results added
+ * @retval -1  The command has finished
+ */
+static int query_stream_read(struct QueryStream *qs, int timeout, bool keys,
+                             struct Query ***results)
+{
+  struct pollfd pfd[2] = { { qs->fd, POLLIN, 0 }, { 0, POLLIN, 0 } };
+  char buf[HUGE_STRING];
+
+  if (qs->fd < 0)
+    return -1;
+
+  const int rc = poll(pfd, keys ? 2 : 1, timeout);
+  if ((rc <= 0) || !(pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+    return 0;
+
+  ssize_t len = read(qs->fd, buf, sizeof(buf));
+  if ((len < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+    return 0;
+
+  int added = 0;
+  if (len <= 0)
+  {
+    /* the last line doesn't have to end in a newline */
+    if (qs->tail_len > 0)
     {
-      if (!first)
-      {
-        first = mutt_mem_calloc(1, sizeof(struct Query));
-        cur = first;
-      }
-      else
-      {
-        cur->next = mutt_mem_calloc(1, sizeof(struct Query));
-        cur = cur->next;
-      }
+      qs->tail[qs->tail_len] = '\0';
+      added += query_stream_line(qs, qs->tail, results);
+      qs->tail_len = 0;
+    }
+    close(qs->fd);
+    qs->fd = -1;
+    return -1;
+  }
 
-      cur->addr = mutt_addr_parse_list(cur->addr, p);
-      p = strtok(NULL, "\t\n");
-      if (p)
-      {
-        cur->name = mutt_str_strdup(p);
-        p = strtok(NULL, "\t\n");
-        if (p)
-          cur->other = mutt_str_strdup(p);
-      }
+  for (char *p = buf; p < buf + len;)
+  {
+    char *nl = memchr(p, '\n', buf + len - p);
+    const size_t n = (nl ? nl : buf + len) - p;
+
+    if (qs->tail_len + n + 1 > qs->tail_max)
+    {
+      qs->tail_max = qs->tail_len + n + STRING;
+      mutt_mem_realloc(&qs->tail, qs->tail_max);
     }
+    memcpy(qs->tail + qs->tail_len, p, n);
+    qs->tail_len += n;
+
+    if (!nl)
+      break;
+
+    qs->tail[qs->tail_len] = '\0';
+    added += query_stream_line(qs, qs->tail, results);
+    qs->tail_len = 0;
+    p = nl + 1;
   }
-  FREE(&buf);
-  mutt_file_fclose(&fp);
-  if (mutt_wait_filter(thepid))
+
+  return added;
+}
+
+/**
+ * query_stream_close - Finish running the query command
+ * @param qs Running query
+ *
+ * If the command hasn't finished, it's killed.  Otherwise its status message
+ * is shown and, if it succeeded, the results are cached.
+ */
+static void query_stream_close(struct QueryStream **qs)
+{
+  if (!qs || !*qs)
+    return;
+
+  struct QueryStream *q = *qs;
+
+  if (q->fd >= 0)
   {
-    mutt_debug(1, "Error: %s\n", msg);
-    if (!quiet)
-      mutt_error("%s", msg);
+    /* the rest of the results aren't wanted */
+    close(q->fd);
+    q->fd = -1;
+    kill(-q->pid, SIGTERM);
+    mutt_wait_filter(q->pid);
+    if (!q->quiet)
+      mutt_clear_error();
+  }
+  else if (mutt_wait_filter(q->pid))
+  {
+    mutt_debug(1, "Error: %s\n", q->msg);
+    if (!q->quiet)
+      mutt_error("%s", q->msg);
   }
   else
+  {
+    if (!q->quiet)
+      mutt_message("%s", q->msg);
+    if (QueryCacheTtl > 0)
+    {
+      query_cache_add(q->query, q->all, q->msg);
+      q->all = NULL;
+    }
+  }
+
+  free_query(&q->all);
+  FREE(&q->query);
+  FREE(&q->tail);
+  FREE(qs);
+}
+
+/**
+ * query_begin - Run an external program to find Addresses
+ * @param[in]  s     String to match
+ * @param[in]  quiet If true, don't print progress messages
+ * @param[in]  want  Number of results to wait for
+ * @param[out] qsp   Query that's still running, may be NULL
+ * @retval ptr Query List of results
+ *
+ * If $query_stream is set and qsp isn't NULL, this returns once the first
+ * `want` results have arrived.  The rest can be read from the running query.
+ * Otherwise, it waits for all the results.
+ */
+static struct Query *query_begin(const char *s, bool quiet, int want,
+                                 struct QueryStream **qsp)
+{
+  struct Query *first = NULL;
+  struct Query **last = &first;
+  const char *msg = NULL;
+
+  if (qsp)
+    *qsp = NULL;
+
+  if (query_cache_lookup(s, &first, &msg))
   {
     if (!quiet)
-      mutt_message("%s", msg);
+      mutt_message("%s", NONULL(msg));
+    return first;
   }
 
+  struct QueryStream *qs = query_stream_open(s, quiet);
+  if (!qs)
+    return NULL;
+
+  if (!qsp || !QueryStream)
+    want = INT_MAX;
+
+  while ((qs->count < want) && (query_stream_read(qs, -1, false, &last) >= 0))
+    ;
+
+  if (qs->fd < 0)
+    query_stream_close(&qs);
+  else
+    *qsp = qs;
+
   return first;
 }
 
+/**
+ * mutt_query_is_loading - Is the query menu still waiting for results?
+ * @retval true If more results may arrive
+ */
+bool mutt_query_is_loading(void)
+{
+  return CurrentQuery && (CurrentQuery->fd >= 0);
+}
+
 /**
  * query_search - Search a Address menu item - Implements Menu::menu_search()
  *
@@ -310,19 +684,65 @@ static int query_tag(struct Menu *menu, int sel, int act)
   return cur->tagged - ot;
 }
 
+/**
+ * query_menu_more - Add the next results of a running query to the menu
+ * @param menu    Query Menu
+ * @param timeout Milliseconds to wait, or -1 to wait forever
+ * @param keys    If true, stop waiting when a key is pressed
+ */
+static void query_menu_more(struct Menu *menu, int timeout, bool keys)
+{
+  struct Entry *table = menu->data;
+  struct Query *last = table[menu->max - 1].data;
+  struct Query **tail = &last->next;
+
+  const int rc = query_stream_read(CurrentQuery, timeout, keys, &tail);
+
+  int num = 0;
+  for (struct Query *q = last->next; q; q = q->next)
+    num++;
+
+  if (num > 0)
+  {
+    mutt_mem_realloc(&table, (menu->max + num) * sizeof(struct Entry));
+    for (struct Query *q = last->next; q; q = q->next, menu->max++)
+    {
+      table[menu->max].data = q;
+      table[menu->max].tagged = false;
+    }
+    menu->data = table;
+    menu->redraw |= REDRAW_INDEX | REDRAW_STATUS;
+  }
+
+  if (rc < 0)
+    query_stream_close(&CurrentQuery);
+}
+
+/**
+ * query_idle - Read more results while waiting for a key - Implements Menu::menu_idle()
+ */
+static void query_idle(struct Menu *menu)
+{
+  if (CurrentQuery)
+    query_menu_more(menu, 1000, true);
+}
+
 /**
  * query_menu - Get the user to enter an Address Query
  * @param buf     Buffer for the query
  * @param buflen  Length of buffer
  * @param results Query List
+ * @param qs      Query that's still running, may be NULL
  * @param retbuf  If true, populate the results
  */
-static void query_menu(char *buf, size_t buflen, struct Query *results, bool retbuf)
+static void query_menu(char *buf, size_t buflen, struct Query *results,
+                       struct QueryStream *qs, bool retbuf)
 {
   struct Menu *menu = NULL;
   struct Email *msg = NULL;
   struct Entry *QueryTable = NULL;
   struct Query *queryp = NULL;
+  struct QueryStream *prev = CurrentQuery;
   char title[STRING];
 
   if (!results)
@@ -330,18 +750,20 @@ static void query_menu(char *buf, size_t buflen, struct Query *results, bool ret
     /* Prompt for Query */
     if (mutt_get_field(_("Query: "), buf, buflen, 0) == 0 && buf[0])
     {
-      results = run_query(buf, 0);
+      results = query_begin(buf, false, 1, &qs);
     }
   }
 
   if (results)
   {
+    CurrentQuery = qs;
     snprintf(title, sizeof(title), _("Query '%s'"), buf);
 
     menu = mutt_menu_new(MENU_QUERY);
     menu->menu_make_entry = query_make_entry;
     menu->menu_search = query_search;
     menu->menu_tag = query_tag;
+    menu->menu_idle = query_idle;
     menu->title = title;
     char helpstr[LONG_STRING];
     menu->help = mutt_compile_help(helpstr, sizeof(helpstr), MENU_QUERY, QueryHelp);
@@ -362,13 +784,25 @@ static void query_menu(char *buf, size_t buflen, struct Query *results, bool ret
     while (!done)
     {
       const int op = mutt_menu_loop(menu);
+      /* more results may have arrived */
+      QueryTable = menu->data;
       switch (op)
       {
         case OP_QUERY_APPEND:
         case OP_QUERY:
           if (mutt_get_field(_("Query: "), buf, buflen, 0) == 0 && buf[0])
           {
-            struct Query *newresults = run_query(buf, 0);
+            /* keep all the previous results if appending */
+            if (op == OP_QUERY_APPEND)
+            {
+              while (CurrentQuery)
+                query_menu_more(menu, -1, false);
+              QueryTable = menu->data;
+            }
+            else
+              query_stream_close(&CurrentQuery);
+
+            struct Query *newresults = query_begin(buf, false, 1, &CurrentQuery);
 
             menu->redraw = REDRAW_FULL;
             if (newresults)
@@ -397,6 +831,7 @@ static void query_menu(char *buf, size_t buflen, struct Query *results, bool ret
               menu->menu_make_entry = query_make_entry;
               menu->menu_search = query_search;
               menu->menu_tag = query_tag;
+              menu->menu_idle = query_idle;
               menu->title = title;
               menu->help = mutt_compile_help(helpstr, sizeof(helpstr), MENU_QUERY, QueryHelp);
               mutt_menu_push_current(menu);
@@ -542,11 +977,14 @@ static void query_menu(char *buf, size_t buflen, struct Query *results, bool ret
       }
     }
 
+    query_stream_close(&CurrentQuery);
     free_query(&results);
     FREE(&QueryTable);
     mutt_menu_pop_current(menu);
     mutt_menu_destroy(&menu);
   }
+
+  CurrentQuery = prev;
 }
 
 /**
@@ -558,6 +996,7 @@ static void query_menu(char *buf, size_t buflen, struct Query *results, bool ret
 int mutt_query_complete(char *buf, size_t buflen)
 {
   struct Query *results = NULL;
+  struct QueryStream *qs = NULL;
   struct Address *tmpa = NULL;
 
   if (!QueryCommand)
@@ -566,11 +1005,12 @@ int mutt_query_complete(char *buf, size_t buflen)
     return 0;
   }
 
-  results = run_query(buf, 1);
+  /* a second result means the menu is needed, the rest can arrive later */
+  results = query_begin(buf, true, 2, &qs);
   if (results)
   {
     /* only one response? */
-    if (!results->next)
+    if (!results->next && !qs)
     {
       tmpa = result_to_addr(results);
       mutt_addrlist_to_local(tmpa);
@@ -582,7 +1022,7 @@ int mutt_query_complete(char *buf, size_t buflen)
       return 0;
     }
     /* multiple results, choose from query menu */
-    query_menu(buf, buflen, results, true);
+    query_menu(buf, buflen, results, qs, true);
   }
   return 0;
 }
@@ -604,10 +1044,10 @@ void mutt_query_menu(char *buf, size_t buflen)
   {
     char buffer[STRING] = "";
 
-    query_menu(buffer, sizeof(buffer), NULL, false);
+    query_menu(buffer, sizeof(buffer), NULL, NULL, false);
   }
   else
   {
-    query_menu(buf, buflen, NULL, true);
+    query_menu(buf, buflen, NULL, NULL, true);
   }
 }
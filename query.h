@@ -23,13 +23,18 @@
 #ifndef MUTT_QUERY_H
 #define MUTT_QUERY_H
 
+#include <stdbool.h>
 #include <stdio.h>
 
 /* These Config Variables are only used in query.c */
+extern bool  QueryCachePrefix;
+extern short QueryCacheTtl;
 extern char *QueryCommand;
 extern char *QueryFormat;
+extern bool  QueryStream;
 
 int  mutt_query_complete(char *buf, size_t buflen);
+bool mutt_query_is_loading(void);
 void mutt_query_menu(char *buf, size_t buflen);
 
 #endif /* MUTT_QUERY_H */
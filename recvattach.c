@@ -54,6 +54,7 @@
 #include "ncrypt/ncrypt.h"
 #include "opcodes.h"
 #include "options.h"
+#include "progress.h"
 #include "recvcmd.h"
 #include "rfc1524.h"
 #include "send.h"
@@ -463,16 +464,141 @@ static void prepend_curdir(char *buf, size_t buflen)
   buf[l + 2] = 0;
 }
 
+/**
+ * struct SaveJob - An attachment waiting to be saved
+ */
+struct SaveJob
+{
+  FILE *fp;          ///< File handle to the attachment (OPTIONAL)
+  struct Body *body; ///< Attachment
+  char *path;        ///< File to save it to
+  int flags;         ///< Flags, e.g. #MUTT_SAVE_APPEND
+  int rc;            ///< Result, 0 or errno
+};
+
+/**
+ * struct SaveJobs - Attachments to save together
+ *
+ * The user is asked about all the tagged attachments first.  Then they're
+ * decoded and written by the worker threads, see $worker_threads.
+ */
+struct SaveJobs
+{
+  struct SaveJob *jobs;     ///< Attachments, in the order they were chosen
+  size_t count;             ///< Number of attachments
+  size_t max;               ///< Size of the jobs array
+  struct Progress progress; ///< Combined progress bar
+};
+
+/**
+ * save_jobs_add - Queue an attachment to be saved
+ * @param sj    Jobs
+ * @param fp    File handle to the attachment (OPTIONAL)
+ * @param body  Attachment
+ * @param path  File to save it to
+ * @param flags Flags, e.g. #MUTT_SAVE_APPEND
+ */
+static void save_jobs_add(struct SaveJobs *sj, FILE *fp, struct Body *body,
+                          const char *path, int flags)
+{
+  if (sj->count == sj->max)
+  {
+    sj->max += 16;
+    mutt_mem_realloc(&sj->jobs, sj->max * sizeof(struct SaveJob));
+  }
+
+  struct SaveJob *job = &sj->jobs[sj->count++];
+  job->fp = fp;
+  job->body = body;
+  job->path = mutt_str_strdup(path);
+  job->flags = flags;
+  job->rc = 0;
+}
+
+/**
+ * save_jobs_find - Is an attachment already queued to be saved to a file?
+ * @param sj   Jobs
+ * @param path File to look for
+ * @retval true The file will be written by a queued job
+ */
+static bool save_jobs_find(struct SaveJobs *sj, const char *path)
+{
+  for (size_t i = 0; i < sj->count; i++)
+    if (mutt_str_strcmp(sj->jobs[i].path, path) == 0)
+      return true;
+  return false;
+}
+
+/**
+ * save_job - Save one attachment - Implements ::parallel_work_t
+ */
+static void save_job(size_t i, void *data)
+{
+  struct SaveJobs *sj = data;
+  struct SaveJob *job = &sj->jobs[i];
+
+  job->rc = mutt_save_attachment_quiet(job->fp, job->body, job->path, job->flags);
+}
+
+/**
+ * save_job_progress - Update the progress bar - Implements ::parallel_progress_t
+ */
+static void save_job_progress(size_t done, void *data)
+{
+  struct SaveJobs *sj = data;
+  mutt_progress_update(&sj->progress, done, -1);
+}
+
+/**
+ * save_jobs_run - Save the queued attachments
+ * @param sj Jobs
+ * @retval num Number of attachments that couldn't be saved
+ *
+ * The failures are reported once the workers have finished.
+ */
+static int save_jobs_run(struct SaveJobs *sj)
+{
+  if (sj->count == 0)
+    return 0;
+
+  /* the workers read the attachments with pread() */
+  for (size_t i = 0; i < sj->count; i++)
+    if (sj->jobs[i].fp)
+      fflush(sj->jobs[i].fp);
+
+  mutt_progress_init(&sj->progress, _("Saving..."), MUTT_PROGRESS_MSG, WriteInc, sj->count);
+  mutt_parallel_for(sj->count, WorkerThreads, save_job, save_job_progress, sj);
+
+  int failed = 0;
+  for (size_t i = 0; i < sj->count; i++)
+  {
+    struct SaveJob *job = &sj->jobs[i];
+    if (job->rc != 0)
+    {
+      mutt_error("%s: %s", job->path, strerror(job->rc));
+      failed++;
+    }
+    FREE(&job->path);
+  }
+  sj->count = 0;
+
+  return failed;
+}
+
 /**
  * query_save_attachment - Ask the user if we should save the attachment
  * @param[in]  fp        File handle to the attachment (OPTIONAL)
  * @param[in]  body      Attachment
  * @param[in]  e       Email
  * @param[out] directory Where the attachment was saved
+ * @param[in]  sj        Queue the attachment here, instead of saving it (OPTIONAL)
  * @retval  0 Success
  * @retval -1 Failure
+ *
+ * Attachments that are saved to a mailbox aren't queued.
  */
-static int query_save_attachment(FILE *fp, struct Body *body, struct Email *e, char **directory)
+static int query_save_attachment(FILE *fp, struct Body *body, struct Email *e,
+                                 char **directory, struct SaveJobs *sj)
 {
   char *prompt = NULL;
   char buf[PATH_MAX], tfile[PATH_MAX];
@@ -539,6 +665,21 @@ static int query_save_attachment(FILE *fp, struct Body *body, struct Email *e, c
         prompt = _("Save to file: ");
         continue;
       }
+
+      if (sj)
+      {
+        /* Another attachment is going to this file: write it, then ask again,
+         * so the user can choose to overwrite or append */
+        if (save_jobs_find(sj, tfile))
+        {
+          save_jobs_run(sj);
+          prompt = _("Save to file: ");
+          continue;
+        }
+
+        save_jobs_add(sj, fp, body, tfile, append);
+        return 0;
+      }
     }
 
     mutt_message(_("Saving..."));
@@ -573,6 +714,7 @@ void mutt_save_attachment_list(struct AttachCtx *actx, FILE *fp, bool tag,
   int rc = 1;
   int last = menu ? menu->current : -1;
   FILE *fpout = NULL;
+  struct SaveJobs sj = { 0 };
 
   buf[0] = 0;
 
@@ -630,7 +772,7 @@ void mutt_save_attachment_list(struct AttachCtx *actx, FILE *fp, bool tag,
 
           menu_redraw(menu);
         }
-        if (query_save_attachment(fp, top, e, &directory) == -1)
+        if (query_save_attachment(fp, top, e, &directory, tag ? &sj : NULL) == -1)
           break;
       }
     }
@@ -640,6 +782,14 @@ void mutt_save_attachment_list(struct AttachCtx *actx, FILE *fp, bool tag,
 
   FREE(&directory);
 
+  if (sj.count > 0)
+  {
+    const int count = sj.count;
+    if (save_jobs_run(&sj) == 0)
+      mutt_message(ngettext("%d attachment saved", "%d attachments saved", count), count);
+  }
+  FREE(&sj.jobs);
+
   if (tag && menu)
   {
     menu->oldcurrent = menu->current;
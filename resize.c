@@ -28,10 +28,13 @@
  */
 
 #include "config.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include "mutt/mutt.h"
+#include "globals.h"
 #include "mutt_curses.h"
 #include "mutt_window.h"
 #ifdef HAVE_SYS_IOCTL_H
@@ -58,12 +61,39 @@ struct winsize mutt_get_winsize(void)
   return w;
 }
 
+/* Dragging the edge of a window sends a stream of SIGWINCH, the screen is only
+ * laid out again once it's been quiet for RESIZE_QUIET_MS */
+#define RESIZE_QUIET_MS 30
+#define RESIZE_MAX_WAITS 10
+
+/**
+ * resize_settle - Wait for the terminal to stop changing size
+ *
+ * The wait is bounded, so that a continuous resize still gets redrawn a few
+ * times a second.
+ */
+static void resize_settle(void)
+{
+  for (int i = 0; i < RESIZE_MAX_WAITS; i++)
+  {
+    struct timespec ts = { 0, RESIZE_QUIET_MS * 1000000L };
+
+    SigWinch = 0;
+    while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR) && !SigWinch)
+      ;
+    if (!SigWinch)
+      return;
+  }
+  SigWinch = 0;
+}
+
 #ifdef USE_SLANG_CURSES
 /**
  * mutt_resize_screen - Update NeoMutt's opinion about the window size (SLANG)
  */
 void mutt_resize_screen(void)
 {
+  resize_settle();
   struct winsize w = mutt_get_winsize();
 
   /* The following two variables are global to slang */
@@ -97,6 +127,7 @@ void mutt_resize_screen(void)
  */
 void mutt_resize_screen(void)
 {
+  resize_settle();
   struct winsize w = mutt_get_winsize();
 
   int screenrows = w.ws_row;
@@ -37,6 +37,8 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "mutt/mutt.h"
 #include "email/lib.h"
 #include "mutt.h"
@@ -194,7 +196,295 @@ static int get_field_text(char *field, char **entry, char *type, char *filename,
 }
 
 /**
- * rfc1524_mailcap_parse - Parse a mailcap entry
+ * mailcap_parse_entry - Parse the fields of a mailcap entry
+ * @param a        Email Body
+ * @param filename Mailcap filename
+ * @param line     Mailcap line
+ * @param type     Type, e.g. "text/plain"
+ * @param ch       Fields following the type, may be NULL (will be modified)
+ * @param entry    Entry, e.g. "compose"
+ * @param opt      Option, e.g. #MUTT_EDIT
+ * @retval 1 Success
+ * @retval 0 Failure
+ */
+static int mailcap_parse_entry(struct Body *a, char *filename, int line, char *type,
+                               char *ch, struct Rfc1524MailcapEntry *entry, int opt)
+{
+  /* next field is the viewcommand */
+  char *field = ch;
+  ch = get_field(ch);
+  if (entry)
+    entry->command = mutt_str_strdup(field);
+
+  /* parse the optional fields */
+  int found = true;
+  bool copiousoutput = false;
+  bool composecommand = false;
+  bool editcommand = false;
+  bool printcommand = false;
+
+  while (ch)
+  {
+    field = ch;
+    ch = get_field(ch);
+    mutt_debug(2, "field: %s\n", field);
+
+    if (mutt_str_strcasecmp(field, "needsterminal") == 0)
+    {
+      if (entry)
+        entry->needsterminal = true;
+    }
+    else if (mutt_str_strcasecmp(field, "copiousoutput") == 0)
+    {
+      copiousoutput = true;
+      if (entry)
+        entry->copiousoutput = true;
+    }
+    else if (mutt_str_strncasecmp(field, "composetyped", 12) == 0)
+    {
+      /* this compare most occur before compose to match correctly */
+      if (get_field_text(field + 12, entry ? &entry->composetypecommand : NULL,
+                         type, filename, line))
+      {
+        composecommand = true;
+      }
+    }
+    else if (mutt_str_strncasecmp(field, "compose", 7) == 0)
+    {
+      if (get_field_text(field + 7, entry ? &entry->composecommand : NULL,
+                         type, filename, line))
+      {
+        composecommand = true;
+      }
+    }
+    else if (mutt_str_strncasecmp(field, "print", 5) == 0)
+    {
+      if (get_field_text(field + 5, entry ? &entry->printcommand : NULL,
+                         type, filename, line))
+      {
+        printcommand = true;
+      }
+    }
+    else if (mutt_str_strncasecmp(field, "edit", 4) == 0)
+    {
+      if (get_field_text(field + 4, entry ? &entry->editcommand : NULL, type, filename, line))
+        editcommand = true;
+    }
+    else if (mutt_str_strncasecmp(field, "nametemplate", 12) == 0)
+    {
+      get_field_text(field + 12, entry ? &entry->nametemplate : NULL, type,
+                     filename, line);
+    }
+    else if (mutt_str_strncasecmp(field, "x-convert", 9) == 0)
+    {
+      get_field_text(field + 9, entry ? &entry->convert : NULL, type, filename, line);
+    }
+    else if (mutt_str_strncasecmp(field, "test", 4) == 0)
+    {
+      /* This routine executes the given test command to determine
+       * if this is the right entry.
+       */
+      char *test_command = NULL;
+
+      if (get_field_text(field + 4, &test_command, type, filename, line) && test_command)
+      {
+        const size_t len = mutt_str_strlen(test_command) + STRING;
+        mutt_mem_realloc(&test_command, len);
+        if (rfc1524_expand_command(a, a->filename, type, test_command, len) == 1)
+        {
+          mutt_debug(1, "Command is expecting to be piped\n");
+        }
+        if (mutt_system(test_command) != 0)
+        {
+          /* a non-zero exit code means test failed */
+          found = false;
+        }
+        FREE(&test_command);
+      }
+    }
+  } /* while (ch) */
+
+  if (opt == MUTT_AUTOVIEW)
+  {
+    if (!copiousoutput)
+      found = false;
+  }
+  else if (opt == MUTT_COMPOSE)
+  {
+    if (!composecommand)
+      found = false;
+  }
+  else if (opt == MUTT_EDIT)
+  {
+    if (!editcommand)
+      found = false;
+  }
+  else if (opt == MUTT_PRINT)
+  {
+    if (!printcommand)
+      found = false;
+  }
+
+  if (!found)
+  {
+    /* reset */
+    if (entry)
+    {
+      FREE(&entry->command);
+      FREE(&entry->composecommand);
+      FREE(&entry->composetypecommand);
+      FREE(&entry->editcommand);
+      FREE(&entry->printcommand);
+      FREE(&entry->nametemplate);
+      FREE(&entry->convert);
+      entry->needsterminal = false;
+      entry->copiousoutput = false;
+    }
+  }
+
+  return found;
+}
+
+/**
+ * struct MailcapLine - An entry in a mailcap file
+ */
+struct MailcapLine
+{
+  int line;                 /**< Line number, for error messages */
+  char *key;                /**< Type, e.g. "text/plain", or "text/\*" for a wildcard */
+  char *fields;             /**< Rest of the entry, may be NULL */
+  struct MailcapLine *next; /**< Next entry with the same key */
+};
+
+/**
+ * struct MailcapFile - A parsed mailcap file
+ */
+struct MailcapFile
+{
+  char *path;                /**< Path of the file */
+  ino_t ino;                 /**< Inode of the file, when it was read */
+  time_t mtime;              /**< Modification time of the file, when it was read */
+  off_t size;                /**< Size of the file, when it was read */
+  struct MailcapLine *lines; /**< Entries, in the order of the file */
+  size_t num_lines;          /**< Number of entries */
+  struct Hash *types;        /**< First entry for each key */
+  struct MailcapFile *next;  /**< Next parsed file */
+};
+
+static struct MailcapFile *MailcapFiles = NULL; ///< Mailcap files that have been read
+
+/**
+ * mailcap_file_clear - Forget the contents of a mailcap file
+ * @param mf Mailcap file
+ */
+static void mailcap_file_clear(struct MailcapFile *mf)
+{
+  for (size_t i = 0; i < mf->num_lines; i++)
+  {
+    FREE(&mf->lines[i].key);
+    FREE(&mf->lines[i].fields);
+  }
+  FREE(&mf->lines);
+  mf->num_lines = 0;
+  mutt_hash_destroy(&mf->types);
+}
+
+/**
+ * mailcap_file_get - Get the parsed contents of a mailcap file
+ * @param filename Mailcap filename
+ * @retval ptr Parsed file
+ *
+ * The file is read again if it has changed.  A missing file has no entries.
+ */
+static struct MailcapFile *mailcap_file_get(const char *filename)
+{
+  struct MailcapFile *mf = NULL;
+  struct stat st = { 0 };
+
+  for (mf = MailcapFiles; mf; mf = mf->next)
+    if (mutt_str_strcmp(mf->path, filename) == 0)
+      break;
+
+  if (!mf)
+  {
+    mf = mutt_mem_calloc(1, sizeof(struct MailcapFile));
+    mf->path = mutt_str_strdup(filename);
+    mf->mtime = -1;
+    mf->next = MailcapFiles;
+    MailcapFiles = mf;
+  }
+
+  if (stat(filename, &st) < 0)
+    memset(&st, 0, sizeof(st));
+
+  if ((st.st_ino == mf->ino) && (st.st_mtime == mf->mtime) && (st.st_size == mf->size))
+    return mf;
+
+  mutt_debug(2, "reading mailcap file: %s\n", filename);
+  mailcap_file_clear(mf);
+  mf->ino = st.st_ino;
+  mf->mtime = st.st_mtime;
+  mf->size = st.st_size;
+
+  FILE *fp = fopen(filename, "r");
+  if (!fp)
+    return mf;
+
+  char *buf = NULL;
+  size_t buflen;
+  size_t max = 0;
+  int line = 0;
+  while ((buf = mutt_file_read_line(buf, &buflen, fp, &line, MUTT_CONT)))
+  {
+    /* ignore comments */
+    if (*buf == '#')
+      continue;
+
+    if (mf->num_lines == max)
+    {
+      max += 64;
+      mutt_mem_realloc(&mf->lines, max * sizeof(struct MailcapLine));
+    }
+
+    struct MailcapLine *ml = &mf->lines[mf->num_lines++];
+    char *ch = get_field(buf);
+    ml->line = line;
+    ml->fields = mutt_str_strdup(ch);
+    ml->next = NULL;
+
+    /* a base type with no subtype is an implicit wildcard */
+    if (strchr(buf, '/'))
+      ml->key = mutt_str_strdup(buf);
+    else
+    {
+      const size_t keylen = mutt_str_strlen(buf) + 3;
+      ml->key = mutt_mem_malloc(keylen);
+      snprintf(ml->key, keylen, "%s/*", buf);
+    }
+  }
+  FREE(&buf);
+  mutt_file_fclose(&fp);
+
+  /* chain the entries for each key together, in the order of the file */
+  mf->types = mutt_hash_create(MAX(mf->num_lines, 64), MUTT_HASH_STRCASECMP);
+  for (size_t i = mf->num_lines; i > 0; i--)
+  {
+    struct MailcapLine *ml = &mf->lines[i - 1];
+    struct HashElem *he = mutt_hash_find_elem(mf->types, ml->key);
+    if (he)
+    {
+      ml->next = he->data;
+      he->data = ml;
+    }
+    else
+      mutt_hash_insert(mf->types, ml->key, ml);
+  }
+
+  return mf;
+}
+
+/**
+ * rfc1524_mailcap_parse - Find a mailcap entry for a type in a file
  * @param a        Email Body
  * @param filename Filename
  * @param type     Type, e.g. "text/plain"
@@ -206,9 +496,7 @@ static int get_field_text(char *field, char **entry, char *type, char *filename,
 static int rfc1524_mailcap_parse(struct Body *a, char *filename, char *type,
                                  struct Rfc1524MailcapEntry *entry, int opt)
 {
-  char *buf = NULL;
   int found = false;
-  int line = 0;
 
   /* rfc1524 mailcap file is of the format:
    * base/type; command; extradefs
@@ -227,162 +515,39 @@ static int rfc1524_mailcap_parse(struct Body *a, char *filename, char *type,
     return false;
   const int btlen = ch - type;
 
-  FILE *fp = fopen(filename, "r");
-  if (fp)
-  {
-    size_t buflen;
-    while (!found && (buf = mutt_file_read_line(buf, &buflen, fp, &line, MUTT_CONT)))
-    {
-      /* ignore comments */
-      if (*buf == '#')
-        continue;
-      mutt_debug(2, "mailcap entry: %s\n", buf);
-
-      /* check type */
-      ch = get_field(buf);
-      if ((mutt_str_strcasecmp(buf, type) != 0) &&
-          ((mutt_str_strncasecmp(buf, type, btlen) != 0) ||
-           (buf[btlen] != 0 &&                           /* implicit wild */
-            (mutt_str_strcmp(buf + btlen, "/*") != 0)))) /* wildsubtype */
-      {
-        continue;
-      }
+  struct MailcapFile *mf = mailcap_file_get(filename);
+  if (!mf->types)
+    return false;
 
-      /* next field is the viewcommand */
-      char *field = ch;
-      ch = get_field(ch);
-      if (entry)
-        entry->command = mutt_str_strdup(field);
+  char wild[SHORT_STRING];
+  snprintf(wild, sizeof(wild), "%.*s/*", btlen, type);
 
-      /* parse the optional fields */
-      found = true;
-      bool copiousoutput = false;
-      bool composecommand = false;
-      bool editcommand = false;
-      bool printcommand = false;
+  /* try the entries for the type and its wildcard, in the order of the file */
+  struct MailcapLine *exact = mutt_hash_find(mf->types, type);
+  struct MailcapLine *other = NULL;
+  if (mutt_str_strcasecmp(type, wild) != 0)
+    other = mutt_hash_find(mf->types, wild);
 
-      while (ch)
-      {
-        field = ch;
-        ch = get_field(ch);
-        mutt_debug(2, "field: %s\n", field);
-
-        if (mutt_str_strcasecmp(field, "needsterminal") == 0)
-        {
-          if (entry)
-            entry->needsterminal = true;
-        }
-        else if (mutt_str_strcasecmp(field, "copiousoutput") == 0)
-        {
-          copiousoutput = true;
-          if (entry)
-            entry->copiousoutput = true;
-        }
-        else if (mutt_str_strncasecmp(field, "composetyped", 12) == 0)
-        {
-          /* this compare most occur before compose to match correctly */
-          if (get_field_text(field + 12, entry ? &entry->composetypecommand : NULL,
-                             type, filename, line))
-          {
-            composecommand = true;
-          }
-        }
-        else if (mutt_str_strncasecmp(field, "compose", 7) == 0)
-        {
-          if (get_field_text(field + 7, entry ? &entry->composecommand : NULL,
-                             type, filename, line))
-          {
-            composecommand = true;
-          }
-        }
-        else if (mutt_str_strncasecmp(field, "print", 5) == 0)
-        {
-          if (get_field_text(field + 5, entry ? &entry->printcommand : NULL,
-                             type, filename, line))
-          {
-            printcommand = true;
-          }
-        }
-        else if (mutt_str_strncasecmp(field, "edit", 4) == 0)
-        {
-          if (get_field_text(field + 4, entry ? &entry->editcommand : NULL, type, filename, line))
-            editcommand = true;
-        }
-        else if (mutt_str_strncasecmp(field, "nametemplate", 12) == 0)
-        {
-          get_field_text(field + 12, entry ? &entry->nametemplate : NULL, type,
-                         filename, line);
-        }
-        else if (mutt_str_strncasecmp(field, "x-convert", 9) == 0)
-        {
-          get_field_text(field + 9, entry ? &entry->convert : NULL, type, filename, line);
-        }
-        else if (mutt_str_strncasecmp(field, "test", 4) == 0)
-        {
-          /* This routine executes the given test command to determine
-           * if this is the right entry.
-           */
-          char *test_command = NULL;
-
-          if (get_field_text(field + 4, &test_command, type, filename, line) && test_command)
-          {
-            const size_t len = mutt_str_strlen(test_command) + STRING;
-            mutt_mem_realloc(&test_command, len);
-            if (rfc1524_expand_command(a, a->filename, type, test_command, len) == 1)
-            {
-              mutt_debug(1, "Command is expecting to be piped\n");
-            }
-            if (mutt_system(test_command) != 0)
-            {
-              /* a non-zero exit code means test failed */
-              found = false;
-            }
-            FREE(&test_command);
-          }
-        }
-      } /* while (ch) */
+  while (!found && (exact || other))
+  {
+    struct MailcapLine *ml = NULL;
+    if (!other || (exact && (exact < other)))
+    {
+      ml = exact;
+      exact = exact->next;
+    }
+    else
+    {
+      ml = other;
+      other = other->next;
+    }
 
-      if (opt == MUTT_AUTOVIEW)
-      {
-        if (!copiousoutput)
-          found = false;
-      }
-      else if (opt == MUTT_COMPOSE)
-      {
-        if (!composecommand)
-          found = false;
-      }
-      else if (opt == MUTT_EDIT)
-      {
-        if (!editcommand)
-          found = false;
-      }
-      else if (opt == MUTT_PRINT)
-      {
-        if (!printcommand)
-          found = false;
-      }
+    mutt_debug(2, "mailcap entry: %s; %s\n", ml->key, NONULL(ml->fields));
+    char *fields = mutt_str_strdup(ml->fields);
+    found = mailcap_parse_entry(a, filename, ml->line, type, fields, entry, opt);
+    FREE(&fields);
+  }
 
-      if (!found)
-      {
-        /* reset */
-        if (entry)
-        {
-          FREE(&entry->command);
-          FREE(&entry->composecommand);
-          FREE(&entry->composetypecommand);
-          FREE(&entry->editcommand);
-          FREE(&entry->printcommand);
-          FREE(&entry->nametemplate);
-          FREE(&entry->convert);
-          entry->needsterminal = false;
-          entry->copiousoutput = false;
-        }
-      }
-    } /* while (!found && (buf = mutt_file_read_line ())) */
-    mutt_file_fclose(&fp);
-  } /* if ((fp = fopen ())) */
-  FREE(&buf);
   return found;
 }
 
@@ -33,6 +33,7 @@
 #include "email/lib.h"
 #include "curs_lib.h"
 #include "globals.h"
+#include "mutt_logging.h"
 #include "mutt_window.h"
 #include "muttlib.h"
 #include "state.h"
@@ -42,6 +43,7 @@ bool ReflowSpaceQuotes; ///< Config: Insert spaces into reply quotes for 'format
 short ReflowWrap; ///< Config: Maximum paragraph width for reformatting 'format=flowed' text
 
 #define FLOWED_MAX 72
+#define FLOWED_BLOCK 65536 ///< Size of the reads of the text
 
 /**
  * struct FlowedState - State of a Format-Flowed line of text
@@ -51,8 +53,137 @@ struct FlowedState
   size_t width;
   size_t spaces;
   int delsp;
+  int ql;               ///< Quote level of the cached values below, or -1
+  int ql_width;         ///< Paragraph width at this quote level
+  bool ql_suffix;       ///< Add a space after the quotes at this level?
+  struct Buffer indent; ///< Quote prefix at this level, without the suffix
+  size_t indent_width;  ///< Screen width of the quote prefix
+  struct Buffer out;    ///< Output waiting to be written
 };
 
+/**
+ * struct FlowedReader - Read text a block at a time, returning lines
+ */
+struct FlowedReader
+{
+  FILE *fp;    ///< File to read
+  char *buf;   ///< Text read, but not returned yet
+  size_t size; ///< Size of buf
+  size_t pos;  ///< Start of the next line in buf
+  size_t len;  ///< Amount of text in buf
+  bool eof;    ///< The end of fp has been reached
+};
+
+/**
+ * flowed_read_line - Read the next line of text
+ * @param[in]  r       Reader
+ * @param[out] len     Length of the line
+ * @param[out] newline Set to true if the line ended with a newline
+ * @retval ptr  Line, NUL-terminated, without its newline
+ * @retval NULL End of the text
+ *
+ * The line is stored in the reader's buffer.  It may be modified by the
+ * caller, but is only valid until the next call.
+ */
+static char *flowed_read_line(struct FlowedReader *r, size_t *len, bool *newline)
+{
+  while (true)
+  {
+    char *start = r->buf + r->pos;
+    const size_t avail = r->len - r->pos;
+    char *nl = avail ? memchr(start, '\n', avail) : NULL;
+    if (nl)
+    {
+      *nl = '\0';
+      *len = nl - start;
+      *newline = true;
+      r->pos += *len + 1;
+      return start;
+    }
+
+    if (r->eof)
+    {
+      if (avail == 0)
+        return NULL;
+      start[avail] = '\0';
+      *len = avail;
+      *newline = false;
+      r->pos = r->len;
+      return start;
+    }
+
+    /* keep the partial line and read some more */
+    if (avail && r->pos)
+      memmove(r->buf, start, avail);
+    r->len = avail;
+    r->pos = 0;
+    if ((r->len + 1) >= r->size)
+    {
+      r->size = r->size ? (r->size * 2) : FLOWED_BLOCK;
+      mutt_mem_realloc(&r->buf, r->size);
+    }
+
+    const size_t n = fread(r->buf + r->len, 1, r->size - r->len - 1, r->fp);
+    if (n == 0)
+      r->eof = true;
+    r->len += n;
+  }
+}
+
+/**
+ * out_write - Add some text to the output
+ * @param fst The state of the flowed text
+ * @param str Text
+ * @param len Length of the text
+ *
+ * The output is collected in memory and written a block at a time, see
+ * out_flush(), so stdio isn't called for every word.
+ */
+static void out_write(struct FlowedState *fst, const char *str, size_t len)
+{
+  mutt_buffer_add(&fst->out, str, len);
+}
+
+/**
+ * out_putc - Add a character to the output
+ * @param fst The state of the flowed text
+ * @param c   Character
+ */
+static void out_putc(struct FlowedState *fst, char c)
+{
+  mutt_buffer_add(&fst->out, &c, 1);
+}
+
+/**
+ * out_spaces - Add some spaces to the output
+ * @param fst The state of the flowed text
+ * @param n   Number of spaces
+ */
+static void out_spaces(struct FlowedState *fst, size_t n)
+{
+  static const char spaces[] = "                                ";
+
+  while (n > 0)
+  {
+    const size_t chunk = MIN(n, sizeof(spaces) - 1);
+    out_write(fst, spaces, chunk);
+    n -= chunk;
+  }
+}
+
+/**
+ * out_flush - Write out the collected output
+ * @param s   State to work with
+ * @param fst The state of the flowed text
+ */
+static void out_flush(struct State *s, struct FlowedState *fst)
+{
+  struct Buffer *out = &fst->out;
+  if (out->dptr > out->data)
+    fwrite(out->data, 1, out->dptr - out->data, s->fpout);
+  out->dptr = out->data;
+}
+
 /**
  * get_quote_level - Get the quote level of a line
  * @param line Text to examine
@@ -122,45 +253,6 @@ static bool add_quote_suffix(struct State *s, int ql)
   return true;
 }
 
-/**
- * print_indent - Print indented text
- * @param ql         Quote level
- * @param s          State to work with
- * @param add_suffix If true, write a trailing space character
- * @retval num Number of characters written
- */
-static size_t print_indent(int ql, struct State *s, int add_suffix)
-{
-  size_t wid = 0;
-
-  if (s->prefix)
-  {
-    /* use given prefix only for format=fixed replies to format=flowed,
-     * for format=flowed replies to format=flowed, use '>' indentation
-     */
-    if (TextFlowed)
-      ql++;
-    else
-    {
-      state_puts(s->prefix, s);
-      wid = mutt_strwidth(s->prefix);
-    }
-  }
-  for (int i = 0; i < ql; i++)
-  {
-    state_putc('>', s);
-    if (space_quotes(s))
-      state_putc(' ', s);
-  }
-  if (add_suffix)
-    state_putc(' ', s);
-
-  if (space_quotes(s))
-    ql *= 2;
-
-  return ql + add_suffix + wid;
-}
-
 /**
  * flush_par - Write out the paragraph
  * @param s   State to work with
@@ -170,7 +262,7 @@ static void flush_par(struct State *s, struct FlowedState *fst)
 {
   if (fst->width > 0)
   {
-    state_putc('\n', s);
+    out_putc(fst, '\n');
     fst->width = 0;
   }
   fst->spaces = 0;
@@ -208,44 +300,143 @@ static int quote_width(struct State *s, int ql)
   return width;
 }
 
+/**
+ * set_quote_level - Prepare the quote prefix for a quote level
+ * @param s   State to work with
+ * @param fst The state of the flowed text
+ * @param ql  Quote level
+ *
+ * The prefix, its width and the paragraph width only depend on the quote
+ * level, so they're worked out once, rather than for every line.
+ */
+static void set_quote_level(struct State *s, struct FlowedState *fst, int ql)
+{
+  if (fst->ql == ql)
+    return;
+
+  fst->ql = ql;
+  fst->ql_width = quote_width(s, ql);
+  fst->ql_suffix = add_quote_suffix(s, ql);
+
+  struct Buffer *indent = &fst->indent;
+  if (!indent->data)
+  {
+    indent->dsize = STRING;
+    indent->data = mutt_mem_calloc(1, indent->dsize);
+  }
+  mutt_buffer_reset(indent);
+
+  size_t wid = 0;
+  if (s->prefix)
+  {
+    /* use given prefix only for format=fixed replies to format=flowed,
+     * for format=flowed replies to format=flowed, use '>' indentation
+     */
+    if (TextFlowed)
+      ql++;
+    else
+    {
+      mutt_buffer_addstr(indent, s->prefix);
+      wid = mutt_strwidth(s->prefix);
+    }
+  }
+
+  const bool spaced = space_quotes(s);
+  for (int i = 0; i < ql; i++)
+  {
+    mutt_buffer_addch(indent, '>');
+    if (spaced)
+      mutt_buffer_addch(indent, ' ');
+  }
+
+  fst->indent_width = (spaced ? ql * 2 : ql) + wid;
+}
+
+/**
+ * print_indent - Print indented text
+ * @param s          State to work with
+ * @param fst        The state of the flowed text
+ * @param add_suffix If true, write a trailing space character
+ * @retval num Number of characters written
+ */
+static size_t print_indent(struct State *s, struct FlowedState *fst, bool add_suffix)
+{
+  const struct Buffer *indent = &fst->indent;
+  out_write(fst, indent->data, indent->dptr - indent->data);
+  if (add_suffix)
+    out_putc(fst, ' ');
+
+  return fst->indent_width + add_suffix;
+}
+
+/**
+ * word_width - Get the screen width of a word
+ * @param word Word, not NUL-terminated
+ * @param len  Length of the word
+ * @retval num Screen width
+ */
+static size_t word_width(char *word, size_t len)
+{
+  /* printable ASCII is one column per byte */
+  if (mutt_mb_ascii_len(word, len) == len)
+    return len;
+
+  const char c = word[len];
+  word[len] = '\0';
+  const size_t w = mutt_strwidth(word);
+  word[len] = c;
+  return w;
+}
+
 /**
  * print_flowed_line - Print a format-flowed line
  * @param line Text to print
+ * @param len  Length of the line
  * @param s    State to work with
- * @param ql   Quote level
  * @param fst  The state of the flowed text
  * @param term If true, terminate with a new line
+ *
+ * The line is split into words and reflowed in a single pass.  The words are
+ * written straight from the line.
  */
-static void print_flowed_line(char *line, struct State *s, int ql,
+static void print_flowed_line(char *line, size_t len, struct State *s,
                               struct FlowedState *fst, bool term)
 {
   size_t width, w, words = 0;
-  char *p = NULL;
   char last;
 
   if (!line || !*line)
   {
     /* flush current paragraph (if any) first */
     flush_par(s, fst);
-    print_indent(ql, s, 0);
-    state_putc('\n', s);
+    print_indent(s, fst, false);
+    out_putc(fst, '\n');
     return;
   }
 
-  width = quote_width(s, ql);
-  last = line[mutt_str_strlen(line) - 1];
+  width = fst->ql_width;
+  last = line[len - 1];
+  const bool debug = (DebugLevel >= 4);
 
-  mutt_debug(4, "f=f: line [%s], width = %ld, spaces = %lu\n", line,
-             (long) width, fst->spaces);
+  if (debug)
+  {
+    mutt_debug(4, "f=f: line [%s], width = %ld, spaces = %lu\n", line,
+               (long) width, fst->spaces);
+  }
 
-  for (words = 0; (p = strsep(&line, " "));)
+  char *end = line + len;
+  for (char *p = line, *next = NULL; p; p = next)
   {
-    mutt_debug(4, "f=f: word [%s], width: %lu, remaining = [%s]\n", p, fst->width, line);
+    /* the words are separated by single spaces */
+    char *sp = memchr(p, ' ', end - p);
+    const size_t plen = (sp ? sp : end) - p;
+    next = sp ? sp + 1 : NULL;
 
     /* remember number of spaces */
-    if (!*p)
+    if (plen == 0)
     {
-      mutt_debug(4, "f=f: additional space\n");
+      if (debug)
+        mutt_debug(4, "f=f: additional space\n");
       fst->spaces++;
       continue;
     }
@@ -253,7 +444,10 @@ static void print_flowed_line(char *line, struct State *s, int ql,
     if (words)
       fst->spaces++;
 
-    w = mutt_strwidth(p);
+    w = word_width(p, plen);
+    if (debug)
+      mutt_debug(4, "f=f: word [%.*s], width: %lu\n", (int) plen, p, fst->width);
+
     /* see if we need to break the line but make sure the first
        word is put on the line regardless;
        if for DelSp=yes only one trailing space is used, we probably
@@ -262,23 +456,23 @@ static void print_flowed_line(char *line, struct State *s, int ql,
     if (!(!fst->spaces && fst->delsp && last != ' ') && w < width &&
         w + fst->width + fst->spaces > width)
     {
-      mutt_debug(4, "f=f: break line at %lu, %lu spaces left\n", fst->width, fst->spaces);
+      if (debug)
+        mutt_debug(4, "f=f: break line at %lu, %lu spaces left\n", fst->width, fst->spaces);
       /* only honor trailing spaces for format=flowed replies */
       if (TextFlowed)
-        for (; fst->spaces; fst->spaces--)
-          state_putc(' ', s);
-      state_putc('\n', s);
+        out_spaces(fst, fst->spaces);
+      out_putc(fst, '\n');
       fst->width = 0;
       fst->spaces = 0;
       words = 0;
     }
 
     if (!words && !fst->width)
-      fst->width = print_indent(ql, s, add_quote_suffix(s, ql));
+      fst->width = print_indent(s, fst, fst->ql_suffix);
     fst->width += w + fst->spaces;
-    for (; fst->spaces; fst->spaces--)
-      state_putc(' ', s);
-    state_puts(p, s);
+    out_spaces(fst, fst->spaces);
+    fst->spaces = 0;
+    out_write(fst, p, plen);
     words++;
   }
 
@@ -289,16 +483,17 @@ static void print_flowed_line(char *line, struct State *s, int ql,
 /**
  * print_fixed_line - Print a fixed format line
  * @param line Text to print
+ * @param len  Length of the line
  * @param s    State to work with
- * @param ql   Quote level
  * @param fst  The state of the flowed text
  */
-static void print_fixed_line(const char *line, struct State *s, int ql, struct FlowedState *fst)
+static void print_fixed_line(const char *line, size_t len, struct State *s,
+                             struct FlowedState *fst)
 {
-  print_indent(ql, s, add_quote_suffix(s, ql));
+  print_indent(s, fst, fst->ql_suffix);
   if (line && *line)
-    state_puts(line, s);
-  state_putc('\n', s);
+    out_write(fst, line, len);
+  out_putc(fst, '\n');
 
   fst->width = 0;
   fst->spaces = 0;
@@ -313,8 +508,10 @@ int rfc3676_handler(struct Body *a, struct State *s)
   char *buf = NULL;
   unsigned int quotelevel = 0;
   int delsp = 0;
-  size_t sz = 0;
+  size_t buf_len = 0;
+  bool newline = false;
   struct FlowedState fst = { 0 };
+  struct FlowedReader reader = { 0 };
 
   /* respect DelSp of RFC3676 only with f=f parts */
   char *t = mutt_param_get(&a->parameter, "delsp");
@@ -327,9 +524,21 @@ int rfc3676_handler(struct Body *a, struct State *s)
 
   mutt_debug(4, "f=f: DelSp: %s\n", delsp ? "yes" : "no");
 
-  while ((buf = mutt_file_read_line(buf, &sz, s->fpin, NULL, 0)))
+  fst.ql = -1;
+  set_quote_level(s, &fst, 0);
+  fst.out.dsize = FLOWED_BLOCK + LONG_STRING;
+  fst.out.data = mutt_mem_malloc(fst.out.dsize);
+  fst.out.dptr = fst.out.data;
+  reader.fp = s->fpin;
+
+  while ((buf = flowed_read_line(&reader, &buf_len, &newline)))
   {
-    const size_t buf_len = mutt_str_strlen(buf);
+    if ((buf_len > 0) && (buf[buf_len - 1] == '\r'))
+      buf[--buf_len] = '\0';
+    /* like mutt_file_read_line(), stop at an embedded NUL */
+    if (memchr(buf, '\0', buf_len))
+      buf_len = strlen(buf);
+
     const unsigned int newql = get_quote_level(buf);
 
     /* end flowed paragraph (if we're within one) if quoting level
@@ -339,12 +548,16 @@ int rfc3676_handler(struct Body *a, struct State *s)
       flush_par(s, &fst);
 
     quotelevel = newql;
-    int buf_off = newql;
+    set_quote_level(s, &fst, quotelevel);
+    size_t buf_off = newql;
 
     /* respect sender's space-stuffing by removing one leading space */
     if (buf[buf_off] == ' ')
       buf_off++;
 
+    if ((size_t)(fst.out.dptr - fst.out.data) >= FLOWED_BLOCK)
+      out_flush(s, &fst);
+
     /* test for signature separator */
     const unsigned int sigsep = (mutt_str_strcmp(buf + buf_off, "-- ") == 0);
 
@@ -358,23 +571,36 @@ int rfc3676_handler(struct Body *a, struct State *s)
     {
       /* if we're within a flowed paragraph, terminate it */
       flush_par(s, &fst);
-      print_fixed_line(buf + buf_off, s, quotelevel, &fst);
+      print_fixed_line(buf + buf_off, buf_len - buf_off, s, &fst);
       continue;
     }
 
     /* for DelSp=yes, we need to strip one SP prior to CRLF on flowed lines */
     if (delsp && !fixed)
-      buf[buf_len - 1] = '\0';
+      buf[--buf_len] = '\0';
 
-    print_flowed_line(buf + buf_off, s, quotelevel, &fst, fixed);
+    print_flowed_line(buf + buf_off, buf_len - buf_off, s, &fst, fixed);
   }
 
   flush_par(s, &fst);
+  out_flush(s, &fst);
 
-  FREE(&buf);
+  FREE(&reader.buf);
+  FREE(&fst.indent.data);
+  FREE(&fst.out.data);
   return 0;
 }
 
+/**
+ * needs_stuffing - Does a line need space-stuffing?
+ * @param line Line of text
+ * @retval true The line starts with a space or 'From '
+ */
+static bool needs_stuffing(const char *line)
+{
+  return (line[0] == ' ') || (mutt_str_strncmp("From ", line, 5) == 0);
+}
+
 /**
  * rfc3676_space_stuff - Perform required RFC3676 space stuffing
  * @param e Email
@@ -387,18 +613,20 @@ int rfc3676_handler(struct Body *a, struct State *s)
  * it's up to the user to take care of stuffing when editing the message
  * several times before actually sending it
  *
- * This is more or less a hack as it replaces the message's content with a
- * freshly created copy in a tempfile and modifies the file's mtime so we don't
- * trigger code paths watching for mtime changes
+ * The file is scanned first and, if nothing needs stuffing (the usual case),
+ * it's left alone.  Otherwise the message's content is replaced with a
+ * freshly created copy in a tempfile, whose mtime is set to the original's,
+ * so we don't trigger code paths watching for mtime changes.
  */
 void rfc3676_space_stuff(struct Email *e)
 {
   int lc = 0;
   size_t len = 0;
-  unsigned char c = '\0';
+  bool newline = false;
+  char *line = NULL;
   FILE *in = NULL, *out = NULL;
-  char buf[LONG_STRING];
   char tmpfile[PATH_MAX];
+  struct FlowedReader reader = { 0 };
 
   if (!e || !e->content || !e->content->filename)
     return;
@@ -409,35 +637,44 @@ void rfc3676_space_stuff(struct Email *e)
   if (!in)
     return;
 
+  reader.fp = in;
+  while ((line = flowed_read_line(&reader, &len, &newline)))
+    if (needs_stuffing(line))
+      break;
+
+  if (!line)
+    goto done;
+
   mutt_mktemp(tmpfile, sizeof(tmpfile));
   out = mutt_file_fopen(tmpfile, "w+");
   if (!out)
-  {
-    mutt_file_fclose(&in);
-    return;
-  }
+    goto done;
 
-  while (fgets(buf, sizeof(buf), in))
+  rewind(in);
+  reader.pos = 0;
+  reader.len = 0;
+  reader.eof = false;
+
+  while ((line = flowed_read_line(&reader, &len, &newline)))
   {
-    if ((mutt_str_strncmp("From ", buf, 5) == 0) || buf[0] == ' ')
+    if (needs_stuffing(line))
     {
       fputc(' ', out);
       lc++;
-      len = mutt_str_strlen(buf);
-      if (len > 0)
-      {
-        c = buf[len - 1];
-        buf[len - 1] = '\0';
-      }
-      mutt_debug(4, "f=f: line %d needs space-stuffing: '%s'\n", lc, buf);
-      if (len > 0)
-        buf[len - 1] = c;
+      mutt_debug(4, "f=f: line %d needs space-stuffing: '%s'\n", lc, line);
     }
-    fputs(buf, out);
+    fwrite(line, 1, len, out);
+    if (newline)
+      fputc('\n', out);
   }
+
   mutt_file_fclose(&in);
   mutt_file_fclose(&out);
   mutt_file_set_mtime(e->content->filename, tmpfile);
   unlink(e->content->filename);
   mutt_str_replace(&e->content->filename, tmpfile);
+
+done:
+  mutt_file_fclose(&in);
+  FREE(&reader.buf);
 }
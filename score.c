@@ -52,10 +52,67 @@ struct Score
   struct Pattern *pat;
   int val;
   int exact; /**< if this rule matches, don't evaluate any more */
+  bool fixed; /**< the pattern only depends on the message itself */
   struct Score *next;
 };
 
 static struct Score *ScoreList = NULL;
+static struct Score *ScoreLast = NULL;  ///< Last rule in ScoreList
+static struct Hash *ScoreIndex = NULL; ///< ScoreList indexed by pattern string
+
+/* Bumped when a rule is changed or removed.  Adding a rule to the end of the
+ * list doesn't change the generation: the emails only need the new rule. */
+static unsigned int ScoreGen = 1;
+
+/**
+ * score_pattern_fixed - Does a pattern only depend on the message itself?
+ * @param pat Pattern
+ * @retval true The match only changes if the email does
+ *
+ * Patterns on the flags, the threads, the score or on configuration such as
+ * aliases, lists and groups can match differently later on.
+ */
+static bool score_pattern_fixed(const struct Pattern *pat)
+{
+  for (; pat; pat = pat->next)
+  {
+    if (pat->isalias || pat->groupmatch)
+      return false;
+
+    switch (pat->op)
+    {
+      case MUTT_AND:
+      case MUTT_OR:
+        if (!score_pattern_fixed(pat->child))
+          return false;
+        break;
+      case MUTT_ALL:
+      case MUTT_TO:
+      case MUTT_CC:
+      case MUTT_SUBJECT:
+      case MUTT_FROM:
+      case MUTT_DATE:
+      case MUTT_DATE_RECEIVED:
+      case MUTT_ID:
+      case MUTT_BODY:
+      case MUTT_HEADER:
+      case MUTT_WHOLE_MSG:
+      case MUTT_SENDER:
+      case MUTT_SIZE:
+      case MUTT_REFERENCE:
+      case MUTT_RECIPIENT:
+      case MUTT_ADDRESS:
+      case MUTT_HORMEL:
+      case MUTT_MIMEATTACH:
+      case MUTT_MIMETYPE:
+      case MUTT_NEWSGROUPS:
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
 
 /**
  * mutt_check_rescore - Do the emails need to have their scores recalculated?
@@ -78,8 +135,8 @@ void mutt_check_rescore(struct Context *ctx)
 
     for (int i = 0; ctx && i < ctx->mailbox->msg_count; i++)
     {
-      mutt_score_message(ctx, ctx->mailbox->hdrs[i], true);
-      ctx->mailbox->hdrs[i]->pair = 0;
+      mutt_rescore_message(ctx, ctx->mailbox->hdrs[i], true);
+      ctx->mailbox->hdrs[i]->pair_valid = false;
     }
   }
   OptNeedRescore = false;
@@ -91,7 +148,7 @@ void mutt_check_rescore(struct Context *ctx)
 int mutt_parse_score(struct Buffer *buf, struct Buffer *s, unsigned long data,
                      struct Buffer *err)
 {
-  struct Score *ptr = NULL, *last = NULL;
+  struct Score *ptr = NULL;
   char *pattern = NULL, *pc = NULL;
   struct Pattern *pat = NULL;
 
@@ -113,9 +170,9 @@ int mutt_parse_score(struct Buffer *buf, struct Buffer *s, unsigned long data,
 
   /* look for an existing entry and update the value, else add it to the end
      of the list */
-  for (ptr = ScoreList, last = NULL; ptr; last = ptr, ptr = ptr->next)
-    if (mutt_str_strcmp(pattern, ptr->str) == 0)
-      break;
+  if (!ScoreIndex)
+    ScoreIndex = mutt_hash_create(64, 0);
+  ptr = mutt_hash_find(ScoreIndex, pattern);
   if (!ptr)
   {
     pat = mutt_pattern_comp(pattern, 0, err);
@@ -125,12 +182,15 @@ int mutt_parse_score(struct Buffer *buf, struct Buffer *s, unsigned long data,
       return -1;
     }
     ptr = mutt_mem_calloc(1, sizeof(struct Score));
-    if (last)
-      last->next = ptr;
+    if (ScoreLast)
+      ScoreLast->next = ptr;
     else
       ScoreList = ptr;
+    ScoreLast = ptr;
     ptr->pat = pat;
     ptr->str = pattern;
+    mutt_hash_insert(ScoreIndex, ptr->str, ptr);
+    ptr->fixed = score_pattern_fixed(pat);
   }
   else
   {
@@ -140,6 +200,8 @@ int mutt_parse_score(struct Buffer *buf, struct Buffer *s, unsigned long data,
      */
     FREE(&pattern);
   }
+  const int old_val = ptr->val;
+  const int old_exact = ptr->exact;
   pc = buf->data;
   if (*pc == '=')
   {
@@ -152,34 +214,73 @@ int mutt_parse_score(struct Buffer *buf, struct Buffer *s, unsigned long data,
     mutt_buffer_strcpy(err, _("Error: score: invalid number"));
     return -1;
   }
+  /* a new rule is at the end of the list, changing an old one means starting again */
+  if (!pat && ((ptr->val != old_val) || (ptr->exact != old_exact)))
+    ScoreGen++;
   OptNeedRescore = true;
   return 0;
 }
 
 /**
- * mutt_score_message - Apply scoring to an email
+ * score_email - Apply the score rules to an email
  * @param ctx     Mailbox
- * @param e     Email header
+ * @param e       Email
  * @param upd_ctx If true, update the Context too
+ * @param resume  If true, only apply the rules added since the email was scored
  */
-void mutt_score_message(struct Context *ctx, struct Email *e, bool upd_ctx)
+static void score_email(struct Context *ctx, struct Email *e, bool upd_ctx, bool resume)
 {
-  struct Score *tmp = NULL;
   struct PatternCache cache = { 0 };
+  struct Score *tmp = ScoreList;
+  int rules = 0;
+
+  /* skip the rules that have already been applied, if they'd still match
+   * the same way */
+  resume = resume && (e->score_gen == ScoreGen);
+  if (resume)
+  {
+    const int applied = abs(e->score_rules);
+    for (; tmp && (rules < applied) && tmp->fixed; rules++)
+      tmp = tmp->next;
+    resume = (rules == applied);
+  }
+
+  if (resume)
+  {
+    /* once an exact rule has matched, the later rules don't count */
+    if (e->score_rules < 0)
+    {
+      tmp = NULL;
+      rules = e->score_rules;
+    }
+  }
+  else
+  {
+    /* in case of re-scoring */
+    tmp = ScoreList;
+    rules = 0;
+    e->score_raw = 0;
+    e->score_rules = 0;
+    e->score_gen = ScoreGen;
+  }
 
-  e->score = 0; /* in case of re-scoring */
-  for (tmp = ScoreList; tmp; tmp = tmp->next)
+  for (; tmp; tmp = tmp->next)
   {
+    rules++;
     if (mutt_pattern_exec(tmp->pat, MUTT_MATCH_FULL_ADDRESS, NULL, e, &cache) > 0)
     {
       if (tmp->exact || tmp->val == 9999 || tmp->val == -9999)
       {
-        e->score = tmp->val;
+        e->score_raw = tmp->val;
+        rules = -rules;
         break;
       }
-      e->score += tmp->val;
+      e->score_raw += tmp->val;
     }
   }
+  e->score_rules = rules;
+
+  e->score = e->score_raw;
   if (e->score < 0)
     e->score = 0;
 
@@ -191,6 +292,31 @@ void mutt_score_message(struct Context *ctx, struct Email *e, bool upd_ctx)
     mutt_set_flag_update(ctx, e, MUTT_FLAG, true, upd_ctx);
 }
 
+/**
+ * mutt_score_message - Apply scoring to an email
+ * @param ctx     Mailbox
+ * @param e       Email header
+ * @param upd_ctx If true, update the Context too
+ */
+void mutt_score_message(struct Context *ctx, struct Email *e, bool upd_ctx)
+{
+  score_email(ctx, e, upd_ctx, false);
+}
+
+/**
+ * mutt_rescore_message - Bring the score of an email up to date
+ * @param ctx     Mailbox
+ * @param e       Email header
+ * @param upd_ctx If true, update the Context too
+ *
+ * If score rules have only been added since the email was scored, just the
+ * new rules are tried.  Otherwise the email is scored again from scratch.
+ */
+void mutt_rescore_message(struct Context *ctx, struct Email *e, bool upd_ctx)
+{
+  score_email(ctx, e, upd_ctx, true);
+}
+
 /**
  * mutt_parse_unscore - Parse the 'unscore' command - Implements ::command_t
  */
@@ -212,10 +338,13 @@ int mutt_parse_unscore(struct Buffer *buf, struct Buffer *s, unsigned long data,
         FREE(&last);
       }
       ScoreList = NULL;
+      ScoreLast = NULL;
+      mutt_hash_destroy(&ScoreIndex);
+      ScoreGen++;
     }
-    else
+    else if (mutt_hash_find(ScoreIndex, buf->data))
     {
-      for (tmp = ScoreList; tmp; last = tmp, tmp = tmp->next)
+      for (tmp = ScoreList, last = NULL; tmp; last = tmp, tmp = tmp->next)
       {
         if (mutt_str_strcmp(buf->data, tmp->str) == 0)
         {
@@ -223,8 +352,12 @@ int mutt_parse_unscore(struct Buffer *buf, struct Buffer *s, unsigned long data,
             last->next = tmp->next;
           else
             ScoreList = tmp->next;
+          if (tmp == ScoreLast)
+            ScoreLast = last;
+          mutt_hash_delete(ScoreIndex, tmp->str, tmp);
           mutt_pattern_free(&tmp->pat);
           FREE(&tmp);
+          ScoreGen++;
           /* there should only be one score per pattern, so we can stop here */
           break;
         }
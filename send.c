@@ -2121,7 +2121,7 @@ int ci_send_message(int flags, struct Email *msg, char *tempfile,
         mutt_unprepare_envelope(msg->env);
         goto main_loop;
       }
-      mutt_update_num_postponed();
+      mutt_postponed_added();
       mutt_message(_("Message postponed"));
       rc = 1;
       goto cleanup;
@@ -2415,6 +2415,7 @@ int ci_send_message(int flags, struct Email *msg, char *tempfile,
       mutt_set_flag(ctx, cur, MUTT_REPLIED, is_reply(cur, msg));
     else if (!(flags & SEND_POSTPONED) && ctx && ctx->tagged)
     {
+      mutt_flag_batch_begin(ctx);
       for (i = 0; i < ctx->mailbox->msg_count; i++)
       {
         if (message_is_tagged(ctx, i))
@@ -2423,6 +2424,7 @@ int ci_send_message(int flags, struct Email *msg, char *tempfile,
                         is_reply(ctx->mailbox->hdrs[i], msg));
         }
       }
+      mutt_flag_batch_end();
     }
   }
 
@@ -293,6 +293,72 @@ static void b64_putc(struct B64Context *ctx, char c, FILE *fout)
   ctx->buffer[ctx->size++] = c;
 }
 
+/* Bytes that fit on a line of base64: 72 characters */
+#define B64_LINE 54
+/* Number of lines encoded at a time */
+#define B64_LINES 64
+
+/**
+ * encode_base64_block - Base64-encode a file that doesn't need converting
+ * @param fin    File to read
+ * @param fout   File to store the result
+ * @param istext Is the input text?
+ *
+ * Whole lines are encoded at once, rather than a byte at a time.  The output
+ * is the same as that of the b64_putc() loop in encode_base64().
+ */
+static void encode_base64_block(FILE *fin, FILE *fout, bool istext)
+{
+  char bufi[HUGE_STRING];
+  char in[B64_LINE * B64_LINES];
+  char out[(B64_LINE / 3 * 4 + 1) * B64_LINES + 16];
+  size_t inlen = 0;
+  bool first = true;
+  int ch1 = EOF;
+
+  while (true)
+  {
+    const size_t n = fread(bufi, 1, sizeof(bufi), fin);
+    if (SigInt == 1)
+    {
+      SigInt = 0;
+      return;
+    }
+
+    for (size_t i = 0; i <= n; i++)
+    {
+      /* encode the lines that are complete, or what's left at the end */
+      if ((inlen >= sizeof(in) - 1) || ((i == n) && (n == 0)))
+      {
+        const size_t todo = (n == 0) ? inlen : inlen - (inlen % B64_LINE);
+        char *o = out;
+        for (size_t j = 0; j < todo; j += B64_LINE)
+        {
+          if (!first)
+            *o++ = '\n';
+          first = false;
+          o += mutt_b64_encode(in + j, MIN(B64_LINE, todo - j), o, out + sizeof(out) - o);
+        }
+        fwrite(out, 1, o - out, fout);
+        memmove(in, in + todo, inlen - todo);
+        inlen -= todo;
+      }
+      if (i == n)
+        break;
+
+      const char ch = bufi[i];
+      if (istext && (ch == '\n') && (ch1 != '\r'))
+        in[inlen++] = '\r';
+      in[inlen++] = ch;
+      ch1 = (unsigned char) ch;
+    }
+
+    if (n == 0)
+      break;
+  }
+  fputc('\n', fout);
+}
+
 /**
  * encode_base64 - Base64-encode some data
  * @param fc     Cursor for converting a file's encoding
@@ -304,6 +370,12 @@ static void encode_base64(struct FgetConv *fc, FILE *fout, int istext)
   struct B64Context ctx;
   int ch, ch1 = EOF;
 
+  if (fc->cd == (iconv_t) -1)
+  {
+    encode_base64_block(fc->file, fout, istext);
+    return;
+  }
+
   b64_init(&ctx);
 
   while ((ch = mutt_ch_fgetconv(fc)) != EOF)
@@ -331,6 +403,12 @@ static void encode_8bit(struct FgetConv *fc, FILE *fout)
 {
   int ch;
 
+  if (fc->cd == (iconv_t) -1)
+  {
+    mutt_file_copy_stream(fc->file, fout);
+    return;
+  }
+
   while ((ch = mutt_ch_fgetconv(fc)) != EOF)
   {
     if (SigInt == 1)
@@ -610,6 +688,27 @@ static void update_content_info(struct Content *info, struct ContentState *s,
 
   for (; buflen; buf++, buflen--)
   {
+    /* Past the "From " check, count a run of printable characters in one go */
+    if (!was_cr && (linelen >= 4))
+    {
+      size_t n = 0;
+      while ((n < buflen) && ((unsigned char) buf[n] >= 0x20) && ((unsigned char) buf[n] < 0x7f))
+        n++;
+      if (n > 0)
+      {
+        size_t spaces = 0;
+        while ((spaces < n) && (buf[n - spaces - 1] == ' '))
+          spaces++;
+        whitespace = (spaces == n) ? whitespace + n : spaces;
+        info->ascii += n;
+        linelen += n;
+        buf += n;
+        buflen -= n;
+        if (buflen == 0)
+          break;
+      }
+    }
+
     char ch = *buf;
 
     if (was_cr)
@@ -741,7 +840,7 @@ static void update_content_info(struct Content *info, struct ContentState *s,
 static size_t convert_file_to(FILE *file, const char *fromcode, int ncodes,
                               const char **tocodes, int *tocode, struct Content *info)
 {
-  char bufi[256], bufu[512], bufo[4 * sizeof(bufi)];
+  char bufi[4096], bufu[2 * sizeof(bufi)], bufo[4 * sizeof(bufi)];
   size_t ret;
 
   const iconv_t cd1 = mutt_ch_iconv_open("utf-8", fromcode, 0);
@@ -962,6 +1061,26 @@ static size_t convert_file_from_to(FILE *file, const char *fromcodes, const char
   return ret;
 }
 
+/**
+ * content_is_binary - Is this a media type that's always binary?
+ * @param b Body to check
+ * @retval true The content is binary and doesn't need to be examined
+ *
+ * Audio, video and most images will be sent as base64 whatever they contain.
+ * Text-based images, like SVG or XPM, are still examined.
+ */
+static bool content_is_binary(const struct Body *b)
+{
+  if ((b->type == TYPE_AUDIO) || (b->type == TYPE_VIDEO))
+    return true;
+
+  if ((b->type != TYPE_IMAGE) || !b->subtype)
+    return false;
+
+  return !strstr(b->subtype, "xml") && !strstr(b->subtype, "svg") &&
+         (mutt_str_strncasecmp(b->subtype, "x-x", 3) != 0);
+}
+
 /**
  * mutt_get_content_info - Analyze file to determine MIME encoding to use
  * @param fname File to examine
@@ -977,7 +1096,6 @@ struct Content *mutt_get_content_info(const char *fname, struct Body *b)
   FILE *fp = NULL;
   char *fromcode = NULL;
   char *tocode = NULL;
-  char buffer[100];
   size_t r;
 
   struct stat sb;
@@ -997,6 +1115,15 @@ struct Content *mutt_get_content_info(const char *fname, struct Body *b)
     return NULL;
   }
 
+  if (b && content_is_binary(b))
+  {
+    /* count every byte as 8-bit, which will choose base64 */
+    info = mutt_mem_calloc(1, sizeof(struct Content));
+    info->hibin = sb.st_size;
+    info->binary = true;
+    return info;
+  }
+
   fp = fopen(fname, "r");
   if (!fp)
   {
@@ -1030,10 +1157,12 @@ struct Content *mutt_get_content_info(const char *fname, struct Body *b)
     }
   }
 
+  char *buffer = mutt_mem_malloc(LONG_STRING * 64);
   rewind(fp);
-  while ((r = fread(buffer, 1, sizeof(buffer), fp)))
+  while ((r = fread(buffer, 1, LONG_STRING * 64, fp)))
     update_content_info(info, &state, buffer, r);
   update_content_info(info, &state, 0, 0);
+  FREE(&buffer);
 
   mutt_file_fclose(&fp);
 
@@ -1047,6 +1176,97 @@ struct Content *mutt_get_content_info(const char *fname, struct Body *b)
   return info;
 }
 
+/**
+ * struct MimeTypesFile - A parsed mime.types file
+ */
+struct MimeTypesFile
+{
+  char *path;         /**< Path of the file */
+  bool exists;        /**< The file could be read */
+  ino_t ino;          /**< Inode of the file, when it was read */
+  time_t mtime;       /**< Modification time of the file, when it was read */
+  off_t size;         /**< Size of the file, when it was read */
+  struct ListHead lines; /**< Lines of the file, split into fields */
+  struct Hash *exts;  /**< Content type for each file extension */
+};
+
+static struct MimeTypesFile MimeTypesFiles[4];
+
+/**
+ * mime_types_get - Get the parsed contents of a mime.types file
+ * @param mf   Cache for the file
+ * @param path Path of the file
+ * @retval true The file exists
+ *
+ * The file is read again if it has changed.
+ */
+static bool mime_types_get(struct MimeTypesFile *mf, const char *path)
+{
+  struct stat st = { 0 };
+
+  if (stat(path, &st) < 0)
+    memset(&st, 0, sizeof(st));
+
+  if (mf->path && (mutt_str_strcmp(mf->path, path) == 0) && (st.st_ino == mf->ino) &&
+      (st.st_mtime == mf->mtime) && (st.st_size == mf->size))
+  {
+    return mf->exists;
+  }
+
+  mutt_list_free(&mf->lines);
+  mutt_hash_destroy(&mf->exts);
+  mutt_str_replace(&mf->path, path);
+  mf->ino = st.st_ino;
+  mf->mtime = st.st_mtime;
+  mf->size = st.st_size;
+
+  FILE *f = fopen(path, "r");
+  mf->exists = f;
+  if (!f)
+    return false;
+
+  mutt_debug(2, "reading mime.types file: %s\n", path);
+  mf->exts = mutt_hash_create(1031, MUTT_HASH_STRCASECMP);
+
+  char buf[PATH_MAX];
+  while (fgets(buf, sizeof(buf) - 1, f))
+  {
+    /* weed out any comments */
+    char *p = strchr(buf, '#');
+    if (p)
+      *p = 0;
+
+    /* remove any leading space. */
+    char *ct = buf;
+    SKIPWS(ct);
+
+    /* position on the next field in this line */
+    p = strpbrk(ct, " \t");
+    if (!p)
+      continue;
+
+    /* malformed line, just skip it. */
+    char *slash = strchr(ct, '/');
+    if (!slash || (slash > p))
+      continue;
+
+    /* keep the line, the type and extensions point into it */
+    char *line = mutt_str_strdup(ct);
+    mutt_list_insert_tail(&mf->lines, line);
+    p = line + (p - ct);
+    ct = line;
+    *p++ = 0;
+    SKIPWS(p);
+
+    /* the first entry for an extension wins, the hash keeps it */
+    for (char *tok = strtok(p, " \t\n"); tok; tok = strtok(NULL, " \t\n"))
+      mutt_hash_insert(mf->exts, tok, ct);
+  }
+  mutt_file_fclose(&f);
+
+  return true;
+}
+
 /**
  * mutt_lookup_mime_type - Find the MIME type for an attachment
  * @param att  Email with attachment
@@ -1058,29 +1278,23 @@ struct Content *mutt_get_content_info(const char *fname, struct Body *b)
  * in a system mime.types if we can find one, then look for ~/.mime.types.
  * The longest match is used so that we can match `ps.gz' when `gz' also
  * exists.
+ *
+ * The files are parsed once, and read again when they change.
  */
 int mutt_lookup_mime_type(struct Body *att, const char *path)
 {
-  FILE *f = NULL;
-  char *p = NULL, *q = NULL, *ct = NULL;
   char buf[PATH_MAX];
   char subtype[STRING], xtype[STRING];
-  int szf, sze, cur_sze;
   int type;
   bool found_mimetypes = false;
+  bool exists[4] = { false };
 
   *subtype = '\0';
   *xtype = '\0';
   type = TYPE_OTHER;
-  cur_sze = 0;
-
-  szf = mutt_str_strlen(path);
 
   for (int count = 0; count < 4; count++)
   {
-    /* can't use strtok() because we use it in an inner loop below, so use
-     * a switch statement here instead.
-     */
     switch (count)
     {
       /* last file with last entry to match wins type/xtype */
@@ -1097,72 +1311,44 @@ int mutt_lookup_mime_type(struct Body *att, const char *path)
       case 3:
         snprintf(buf, sizeof(buf), "%s/.mime.types", NONULL(HomeDir));
         break;
-      default:
-        mutt_debug(1, "Internal error, count = %d.\n", count);
-        goto bye; /* shouldn't happen */
     }
 
-    f = fopen(buf, "r");
-    if (f)
-    {
+    exists[count] = mime_types_get(&MimeTypesFiles[count], buf);
+    if (exists[count])
       found_mimetypes = true;
+  }
 
-      while (fgets(buf, sizeof(buf) - 1, f))
-      {
-        /* weed out any comments */
-        p = strchr(buf, '#');
-        if (p)
-          *p = 0;
-
-        /* remove any leading space. */
-        ct = buf;
-        SKIPWS(ct);
-
-        /* position on the next field in this line */
-        p = strpbrk(ct, " \t");
-        if (!p)
-          continue;
-        *p++ = 0;
-        SKIPWS(p);
-
-        /* cycle through the file extensions */
-        while ((p = strtok(p, " \t\n")))
-        {
-          sze = mutt_str_strlen(p);
-          if ((sze > cur_sze) && (szf >= sze) &&
-              ((mutt_str_strcasecmp(path + szf - sze, p) == 0) ||
-               (mutt_str_strcasecmp(path + szf - sze, p) == 0)) &&
-              (szf == sze || path[szf - sze - 1] == '.'))
-          {
-            /* get the content-type */
-
-            p = strchr(ct, '/');
-            if (!p)
-            {
-              /* malformed line, just skip it. */
-              break;
-            }
-            *p++ = 0;
-
-            for (q = p; *q && !ISSPACE(*q); q++)
-              ;
-
-            mutt_str_substr_cpy(subtype, p, q, sizeof(subtype));
-
-            type = mutt_check_mime_type(ct);
-            if (type == TYPE_OTHER)
-              mutt_str_strfcpy(xtype, ct, sizeof(xtype));
-
-            cur_sze = sze;
-          }
-          p = NULL;
-        }
-      }
-      mutt_file_fclose(&f);
+  /* The longest extension wins, so try the whole name first, then each part
+   * following a dot.  For a tie, the first file wins. */
+  const char *ct = NULL;
+  for (const char *ext = path; ext && *ext && !ct;)
+  {
+    for (int count = 0; (count < 4) && !ct; count++)
+    {
+      if (exists[count])
+        ct = mutt_hash_find(MimeTypesFiles[count].exts, ext);
     }
+
+    ext = strchr(ext, '.');
+    if (ext)
+      ext++;
   }
 
-bye:
+  if (ct)
+  {
+    const char *p = strchr(ct, '/');
+    const char *q = NULL;
+
+    for (q = p + 1; *q && !ISSPACE(*q); q++)
+      ;
+
+    mutt_str_substr_cpy(subtype, p + 1, q, sizeof(subtype));
+    mutt_str_substr_cpy(buf, ct, p, sizeof(buf));
+
+    type = mutt_check_mime_type(buf);
+    if (type == TYPE_OTHER)
+      mutt_str_strfcpy(xtype, buf, sizeof(xtype));
+  }
 
   /* no mime.types file found */
   if (!found_mimetypes)
@@ -1601,15 +1787,15 @@ struct Body *mutt_make_file_attach(const char *path)
     run_mime_type_query(att);
   }
 
-  struct Content *info = mutt_get_content_info(path, att);
-  if (!info)
-  {
-    mutt_body_free(&att);
-    return NULL;
-  }
-
   if (!att->subtype)
   {
+    struct Content *info = mutt_get_content_info(path, att);
+    if (!info)
+    {
+      mutt_body_free(&att);
+      return NULL;
+    }
+
     if ((info->nulbin == 0) &&
         (info->lobin == 0 || (info->lobin + info->hibin + info->ascii) / info->lobin >= 10))
     {
@@ -1623,11 +1809,22 @@ struct Body *mutt_make_file_attach(const char *path)
     {
       att->type = TYPE_APPLICATION;
       att->subtype = mutt_str_strdup("octet-stream");
+
+      /* the file won't be converted, so the analysis still holds */
+      set_encoding(att, info);
+      mutt_stamp_attachment(att);
+      att->content = info;
+      return att;
     }
+    FREE(&info);
   }
 
-  FREE(&info);
   mutt_update_encoding(att);
+  if (!att->content)
+  {
+    mutt_body_free(&att);
+    return NULL;
+  }
   return att;
 }
 
@@ -76,11 +76,23 @@ struct SbEntry
   char box[STRING];        /**< formatted mailbox name */
   struct Mailbox *mailbox; /**< Mailbox this represents */
   bool is_hidden;          /**< Don't show, e.g. $sidebar_new_mail_only */
+  int sort_value;          /**< Count the Entries were last sorted by */
+
+  char row[STRING];        /**< Last output of make_sidebar_entry() */
+  bool row_valid;          /**< row may be reused */
+  int row_width;           /**< Width row was made for */
+  int row_count;           /**< Mailbox::msg_count when row was made */
+  int row_unread;          /**< Mailbox::msg_unread when row was made */
+  int row_flagged;         /**< Mailbox::msg_flagged when row was made */
+  bool row_new;            /**< Mailbox::has_new when row was made */
 };
 
 static int EntryCount = 0;
 static int EntryLen = 0;
 static struct SbEntry **Entries = NULL;
+static bool EntriesSorted = false; /**< Entries are in $sidebar_sort_method order */
+static char RowFormat[STRING];     /**< $sidebar_format used for the cached rows */
+static short RowSidebarWidth = 0;  /**< $sidebar_width used for the cached rows */
 
 static int TopIndex = -1; /**< First mailbox visible in sidebar */
 static int OpnIndex = -1; /**< Current (open) mailbox */
@@ -275,6 +287,24 @@ static void make_sidebar_entry(char *buf, size_t buflen, int width, char *box,
   if (!buf || !box || !sbe)
     return;
 
+  struct Mailbox *m = sbe->mailbox;
+
+  /* The open mailbox also shows the Context's counts, so it's always made.
+   * A format ending in '|' is a filter, which must be run every time. */
+  const size_t fmtlen = mutt_str_strlen(SidebarFormat);
+  const bool cacheable =
+      (buflen <= sizeof(sbe->row)) && ((fmtlen == 0) || (SidebarFormat[fmtlen - 1] != '|')) &&
+      !(Context && (mutt_str_strcmp(Context->mailbox->realpath, m->realpath) == 0));
+
+  if (cacheable && sbe->row_valid && (sbe->row_width == width) &&
+      (sbe->row_count == m->msg_count) && (sbe->row_unread == m->msg_unread) &&
+      (sbe->row_flagged == m->msg_flagged) && (sbe->row_new == m->has_new) &&
+      (mutt_str_strcmp(sbe->box, box) == 0))
+  {
+    mutt_str_strfcpy(buf, sbe->row, buflen);
+    return;
+  }
+
   mutt_str_strfcpy(sbe->box, box, sizeof(sbe->box));
 
   mutt_expando_format(buf, buflen, 0, width, NONULL(SidebarFormat),
@@ -296,6 +326,17 @@ static void make_sidebar_entry(char *buf, size_t buflen, int width, char *box,
     size_t len = mutt_wstr_trunc(buf, buflen, width, NULL);
     buf[len] = 0;
   }
+
+  sbe->row_valid = cacheable;
+  if (cacheable)
+  {
+    mutt_str_strfcpy(sbe->row, buf, sizeof(sbe->row));
+    sbe->row_width = width;
+    sbe->row_count = m->msg_count;
+    sbe->row_unread = m->msg_unread;
+    sbe->row_flagged = m->msg_flagged;
+    sbe->row_new = m->has_new;
+  }
 }
 
 /**
@@ -438,6 +479,43 @@ static void unsort_entries(void)
   }
 }
 
+/**
+ * sort_value - Get the count a Mailbox is sorted by
+ * @param m Mailbox
+ * @retval num Count for $sidebar_sort_method, or 0 if it doesn't sort by one
+ */
+static int sort_value(const struct Mailbox *m)
+{
+  switch ((SidebarSortMethod & SORT_MASK))
+  {
+    case SORT_COUNT:
+      return m->msg_count;
+    case SORT_UNREAD:
+      return m->msg_unread;
+    case SORT_FLAGGED:
+      return m->msg_flagged;
+  }
+  return 0;
+}
+
+/**
+ * resort_entries - Move the changed Entries back into order
+ *
+ * An insertion sort, which does little work when only a few of the Entries
+ * are out of place.
+ */
+static void resort_entries(void)
+{
+  for (int i = 1; i < EntryCount; i++)
+  {
+    struct SbEntry *sbe = Entries[i];
+    int j = i;
+    for (; (j > 0) && (cb_qsort_sbe(&Entries[j - 1], &sbe) > 0); j--)
+      Entries[j] = Entries[j - 1];
+    Entries[j] = sbe;
+  }
+}
+
 /**
  * sort_entries - Sort Entries array
  *
@@ -445,15 +523,38 @@ static void unsort_entries(void)
  * option "sidebar_sort_method". This calls qsort to do the work which calls our
  * callback function "cb_qsort_sbe".
  *
+ * If the Entries are already sorted, only the ones whose count has changed
+ * since are moved.
+ *
  * Once sorted, the prev/next links will be reconstructed.
  */
 static void sort_entries(void)
 {
   short ssm = (SidebarSortMethod & SORT_MASK);
 
+  if (SidebarSortMethod != PreviousSort)
+    EntriesSorted = false;
+
   /* These are the only sort methods we understand */
   if ((ssm == SORT_COUNT) || (ssm == SORT_UNREAD) || (ssm == SORT_FLAGGED) || (ssm == SORT_PATH))
-    qsort(Entries, EntryCount, sizeof(*Entries), cb_qsort_sbe);
+  {
+    int changed = 0;
+    for (int i = 0; i < EntryCount; i++)
+    {
+      int value = sort_value(Entries[i]->mailbox);
+      if (value != Entries[i]->sort_value)
+      {
+        Entries[i]->sort_value = value;
+        changed++;
+      }
+    }
+
+    if (!EntriesSorted || (changed > 16))
+      qsort(Entries, EntryCount, sizeof(*Entries), cb_qsort_sbe);
+    else if (changed > 0)
+      resort_entries();
+    EntriesSorted = true;
+  }
   else if ((ssm == SORT_ORDER) && (SidebarSortMethod != PreviousSort))
     unsort_entries();
 }
@@ -796,6 +897,9 @@ static void fill_empty_space(int first_row, int num_rows, int div_width, int num
     div_width = 0;
   for (int r = 0; r < num_rows; r++)
   {
+    if (mutt_window_row_unchanged(MuttSidebarWindow, first_row + r, "", -1, num_cols))
+      continue;
+
     mutt_window_move(MuttSidebarWindow, first_row + r, div_width);
 
     for (int i = 0; i < num_cols; i++)
@@ -833,6 +937,15 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
 
   int w = MIN(num_cols, (SidebarWidth - div_width));
   int row = 0;
+
+  if ((mutt_str_strcmp(RowFormat, NONULL(SidebarFormat)) != 0) || (RowSidebarWidth != SidebarWidth))
+  {
+    for (int i = 0; i < EntryCount; i++)
+      Entries[i]->row_valid = false;
+    mutt_str_strfcpy(RowFormat, NONULL(SidebarFormat), sizeof(RowFormat));
+    RowSidebarWidth = SidebarWidth;
+  }
+
   for (int entryidx = TopIndex; (entryidx < EntryCount) && (row < num_rows); entryidx++)
   {
     entry = Entries[entryidx];
@@ -840,37 +953,37 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
       continue;
     m = entry->mailbox;
 
+    int color;
     if (entryidx == OpnIndex)
     {
       if ((ColorDefs[MT_COLOR_SB_INDICATOR] != 0))
-        SETCOLOR(MT_COLOR_SB_INDICATOR);
+        color = MT_COLOR_SB_INDICATOR;
       else
-        SETCOLOR(MT_COLOR_INDICATOR);
+        color = MT_COLOR_INDICATOR;
     }
     else if (entryidx == HilIndex)
-      SETCOLOR(MT_COLOR_HIGHLIGHT);
+      color = MT_COLOR_HIGHLIGHT;
     else if ((m->msg_unread > 0) || (m->has_new))
-      SETCOLOR(MT_COLOR_NEW);
+      color = MT_COLOR_NEW;
     else if (m->msg_flagged > 0)
-      SETCOLOR(MT_COLOR_FLAGGED);
+      color = MT_COLOR_FLAGGED;
     else if ((ColorDefs[MT_COLOR_SB_SPOOLFILE] != 0) &&
              (mutt_str_strcmp(m->path, Spoolfile) == 0))
     {
-      SETCOLOR(MT_COLOR_SB_SPOOLFILE);
+      color = MT_COLOR_SB_SPOOLFILE;
     }
     else
     {
       if (ColorDefs[MT_COLOR_ORDINARY] != 0)
-        SETCOLOR(MT_COLOR_ORDINARY);
+        color = MT_COLOR_ORDINARY;
       else
-        NORMAL_COLOR;
+        color = MT_COLOR_NORMAL;
     }
 
     int col = 0;
     if (SidebarOnRight)
       col = div_width;
 
-    mutt_window_move(MuttSidebarWindow, row, col);
     if (Context && (Context->mailbox->realpath[0] != '\0') &&
         (mutt_str_strcmp(m->realpath, Context->mailbox->realpath) == 0))
     {
@@ -963,7 +1076,13 @@ static void draw_sidebar(int num_rows, int num_cols, int div_width)
     }
     char str[STRING];
     make_sidebar_entry(str, sizeof(str), w, sidebar_folder_name, entry);
-    printw("%s", str);
+    /* only draw the rows that have changed since the last refresh */
+    if (!mutt_window_row_unchanged(MuttSidebarWindow, row, str, ColorDefs[color], w))
+    {
+      SETCOLOR(color);
+      mutt_window_move(MuttSidebarWindow, row, col);
+      printw("%s", str);
+    }
     if (sidebar_folder_depth > 0)
       FREE(&sidebar_folder_name);
     row++;
@@ -1175,6 +1294,7 @@ void mutt_sb_notify_mailbox(struct Mailbox *m, bool created)
       Entries[del_index] = Entries[del_index + 1];
   }
 
+  EntriesSorted = false;
   mutt_menu_set_current_redraw(REDRAW_SIDEBAR);
 }
 
@@ -24,12 +24,17 @@
 /* This file contains code for direct SMTP delivery of email messages. */
 
 #include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #include "mutt/mutt.h"
 #include "config/lib.h"
@@ -39,6 +44,7 @@
 #include "globals.h"
 #include "mutt_account.h"
 #include "mutt_socket.h"
+#include "muttlib.h"
 #include "options.h"
 #include "progress.h"
 #include "sendlib.h"
@@ -49,6 +55,8 @@
 
 /* These Config Variables are only used in smtp.c */
 char *SmtpAuthenticators; ///< Config: (smtp) List of allowed authentication methods
+bool SmtpBackground;      ///< Config: (smtp) Deliver messages in a background process
+short SmtpIdleTimeout;    ///< Config: (smtp) Keep the connection open between messages
 
 #define smtp_success(x) ((x) / 100 == 2)
 #define SMTP_READY 334
@@ -75,6 +83,8 @@ enum SmtpCapability
   DSN,
   EIGHTBITMIME,
   SMTPUTF8,
+  PIPELINING,
+  CHUNKING,
 
   CAPMAX
 };
@@ -82,6 +92,25 @@ enum SmtpCapability
 static char *AuthMechs = NULL;
 static unsigned char Capabilities[(CAPMAX + 7) / 8];
 
+/* The connection kept open by $smtp_idle_timeout, and when it was last used */
+static struct Connection *SmtpConn = NULL;
+static time_t SmtpLastUsed = 0;
+static bool SmtpEsmtp = false; ///< SmtpConn was greeted with EHLO
+
+/**
+ * struct SmtpJob - A message being delivered by a background process
+ */
+struct SmtpJob
+{
+  pid_t pid;                 ///< Process doing the delivery
+  char errfile[PATH_MAX];    ///< The process's error messages
+  char keepfile[PATH_MAX];   ///< Copy of the message, kept if delivery fails
+  STAILQ_ENTRY(SmtpJob) entries;
+};
+STAILQ_HEAD(SmtpJobList, SmtpJob);
+
+static struct SmtpJobList SmtpJobs = STAILQ_HEAD_INITIALIZER(SmtpJobs);
+
 /**
  * valid_smtp_code - Is the is a valid SMTP return code?
  * @param[in]  buf String to check
@@ -138,6 +167,10 @@ static int smtp_get_resp(struct Connection *conn)
       mutt_bit_set(Capabilities, STARTTLS);
     else if (mutt_str_strncasecmp("SMTPUTF8", buf + 4, 8) == 0)
       mutt_bit_set(Capabilities, SMTPUTF8);
+    else if (mutt_str_strncasecmp("PIPELINING", buf + 4, 10) == 0)
+      mutt_bit_set(Capabilities, PIPELINING);
+    else if (mutt_str_strncasecmp("CHUNKING", buf + 4, 8) == 0)
+      mutt_bit_set(Capabilities, CHUNKING);
 
     if (!valid_smtp_code(buf, n, &n))
       return SMTP_ERR_CODE;
@@ -151,14 +184,42 @@ static int smtp_get_resp(struct Connection *conn)
   return -1;
 }
 
+/**
+ * smtp_get_resps - Read the responses to a batch of pipelined commands
+ * @param conn  SMTP connection
+ * @param count Number of responses to read
+ * @retval  0 Success, every command succeeded
+ * @retval <0 Error, e.g. #SMTP_ERR_READ
+ *
+ * All the responses are read, so the connection stays in step with the
+ * server, but the first failure is the one returned.
+ */
+static int smtp_get_resps(struct Connection *conn, int count)
+{
+  int rc = 0;
+
+  for (; count > 0; count--)
+  {
+    int r = smtp_get_resp(conn);
+    if ((r == SMTP_ERR_READ) || (r == SMTP_ERR_CODE))
+      return r;
+    if (rc == 0)
+      rc = r;
+  }
+
+  return rc;
+}
+
 /**
  * smtp_rcpt_to - Set the recipient to an Address
- * @param conn Server Connection
- * @param a    Address to use
+ * @param conn    Server Connection
+ * @param a       Address to use
+ * @param pending If not NULL, count the replies to read later, instead of
+ *                waiting for each one (PIPELINING)
  * @retval  0 Success
  * @retval <0 Error, e.g. #SMTP_ERR_WRITE
  */
-static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
+static int smtp_rcpt_to(struct Connection *conn, const struct Address *a, int *pending)
 {
   char buf[1024];
   int r;
@@ -177,29 +238,98 @@ static int smtp_rcpt_to(struct Connection *conn, const struct Address *a)
       snprintf(buf, sizeof(buf), "RCPT TO:<%s>\r\n", a->mailbox);
     if (mutt_socket_send(conn, buf) == -1)
       return SMTP_ERR_WRITE;
-    r = smtp_get_resp(conn);
-    if (r != 0)
-      return r;
+    if (pending)
+      (*pending)++;
+    else
+    {
+      r = smtp_get_resp(conn);
+      if (r != 0)
+        return r;
+    }
     a = a->next;
   }
 
   return 0;
 }
 
+/* Size of the blocks the message is read in */
+#define SMTP_CHUNK_SIZE (64 * 1024)
+
+/**
+ * struct SmtpEncoder - State of the message encoding between blocks
+ */
+struct SmtpEncoder
+{
+  bool dotstuff; ///< Double the dots at the start of lines (DATA)
+  bool bol;      ///< The next character starts a line
+  bool cr;       ///< The last character was a CR
+};
+
+/**
+ * smtp_encode - Convert a block of the message to wire format
+ * @param enc   Encoder state
+ * @param in    Block of the message
+ * @param inlen Length of the block
+ * @param out   Buffer for the result, at least twice inlen
+ * @retval num Length of the result
+ *
+ * Lines are ended with CRLF and, for DATA, dot-stuffed.  The block is copied
+ * a line at a time, rather than a character at a time.
+ */
+static size_t smtp_encode(struct SmtpEncoder *enc, const char *in, size_t inlen, char *out)
+{
+  const char *end = in + inlen;
+  char *o = out;
+
+  while (in < end)
+  {
+    if (enc->bol && enc->dotstuff && (*in == '.'))
+      *o++ = '.';
+
+    const char *nl = memchr(in, '\n', end - in);
+    size_t len = (nl ? nl : end) - in;
+    memcpy(o, in, len);
+    o += len;
+    if (len > 0)
+      enc->cr = (in[len - 1] == '\r');
+
+    if (!nl)
+    {
+      enc->bol = enc->bol && (len == 0);
+      break;
+    }
+
+    if (!enc->cr)
+      *o++ = '\r';
+    *o++ = '\n';
+    enc->bol = true;
+    enc->cr = false;
+    in = nl + 1;
+  }
+
+  return o - out;
+}
+
 /**
  * smtp_data - Send data to an SMTP server
  * @param conn    SMTP Connection
  * @param msgfile Filename containing data
  * @retval  0 Success
  * @retval <0 Error, e.g. #SMTP_ERR_WRITE
+ *
+ * If the server offers CHUNKING (RFC3030), the message is sent with BDAT,
+ * which needs no dot-stuffing, otherwise with DATA.
  */
 static int smtp_data(struct Connection *conn, const char *msgfile)
 {
-  char buf[1024];
+  char cmd[SHORT_STRING];
   struct Progress progress;
   struct stat st;
-  int r, term = 0;
-  size_t buflen = 0;
+  int r;
+  const bool bdat = mutt_bit_isset(Capabilities, CHUNKING);
+  const bool pipeline = mutt_bit_isset(Capabilities, PIPELINING);
+  int pending = 0;
+  struct SmtpEncoder enc = { !bdat, true, false };
 
   FILE *fp = fopen(msgfile, "r");
   if (!fp)
@@ -212,56 +342,83 @@ static int smtp_data(struct Connection *conn, const char *msgfile)
   mutt_progress_init(&progress, _("Sending message..."), MUTT_PROGRESS_SIZE,
                      NetInc, st.st_size);
 
-  snprintf(buf, sizeof(buf), "DATA\r\n");
-  if (mutt_socket_send(conn, buf) == -1)
-  {
-    mutt_file_fclose(&fp);
-    return SMTP_ERR_WRITE;
-  }
-  r = smtp_get_resp(conn);
-  if (r != 0)
+  if (!bdat)
   {
-    mutt_file_fclose(&fp);
-    return r;
+    if (mutt_socket_send(conn, "DATA\r\n") == -1)
+    {
+      mutt_file_fclose(&fp);
+      return SMTP_ERR_WRITE;
+    }
+    r = smtp_get_resp(conn);
+    if (r != 0)
+    {
+      mutt_file_fclose(&fp);
+      return r;
+    }
   }
 
-  while (fgets(buf, sizeof(buf) - 1, fp))
+  char *in = mutt_mem_malloc(SMTP_CHUNK_SIZE);
+  char *out = mutt_mem_malloc(2 * SMTP_CHUNK_SIZE + 2);
+  size_t n;
+  r = 0;
+
+  /* send the body in large blocks, rather than a line at a time */
+  mutt_socket_cork(conn);
+  while ((n = fread(in, 1, SMTP_CHUNK_SIZE, fp)) > 0)
   {
-    buflen = mutt_str_strlen(buf);
-    term = buflen && buf[buflen - 1] == '\n';
-    if (term && (buflen == 1 || buf[buflen - 2] != '\r'))
-      snprintf(buf + buflen - 1, sizeof(buf) - buflen + 1, "\r\n");
-    if (buf[0] == '.')
+    size_t len = smtp_encode(&enc, in, n, out);
+    if (bdat)
     {
-      if (mutt_socket_send_d(conn, ".", MUTT_SOCK_LOG_FULL) == -1)
+      snprintf(cmd, sizeof(cmd), "BDAT %zu\r\n", len);
+      if (mutt_socket_send(conn, cmd) == -1)
       {
-        mutt_file_fclose(&fp);
-        return SMTP_ERR_WRITE;
+        r = SMTP_ERR_WRITE;
+        break;
       }
     }
-    if (mutt_socket_send_d(conn, buf, MUTT_SOCK_LOG_FULL) == -1)
+    if (mutt_socket_write_d(conn, out, len, MUTT_SOCK_LOG_FULL) == -1)
     {
-      mutt_file_fclose(&fp);
-      return SMTP_ERR_WRITE;
+      r = SMTP_ERR_WRITE;
+      break;
+    }
+    if (bdat)
+    {
+      /* without PIPELINING, each chunk has to be acknowledged */
+      if (pipeline)
+        pending++;
+      else
+      {
+        if (mutt_socket_flush(conn) < 0)
+        {
+          r = SMTP_ERR_WRITE;
+          break;
+        }
+        r = smtp_get_resp(conn);
+        if (r != 0)
+          break;
+        mutt_socket_cork(conn);
+      }
     }
     mutt_progress_update(&progress, ftell(fp), -1);
   }
-  if (!term && buflen && mutt_socket_send_d(conn, "\r\n", MUTT_SOCK_LOG_FULL) == -1)
-  {
-    mutt_file_fclose(&fp);
-    return SMTP_ERR_WRITE;
-  }
   mutt_file_fclose(&fp);
+  FREE(&in);
+  FREE(&out);
 
-  /* terminate the message body */
-  if (mutt_socket_send(conn, ".\r\n") == -1)
-    return SMTP_ERR_WRITE;
-
-  r = smtp_get_resp(conn);
   if (r != 0)
     return r;
 
-  return 0;
+  /* terminate the message body */
+  const char *tail = enc.bol ? "" : "\r\n";
+  if (bdat)
+    snprintf(cmd, sizeof(cmd), "BDAT %zu LAST\r\n%s", strlen(tail), tail);
+  else
+    snprintf(cmd, sizeof(cmd), "%s.\r\n", tail);
+
+  if ((mutt_socket_send(conn, cmd) == -1) || (mutt_socket_flush(conn) < 0))
+    return SMTP_ERR_WRITE;
+
+  return smtp_get_resps(conn, pending + 1);
 }
 
 /**
@@ -382,6 +539,7 @@ static int smtp_helo(struct Connection *conn, bool esmtp)
   if (!fqdn)
     fqdn = NONULL(ShortHostname);
 
+  SmtpEsmtp = esmtp;
   snprintf(buf, sizeof(buf), "%s %s\r\n", esmtp ? "EHLO" : "HELO", fqdn);
   /* XXX there should probably be a wrapper in mutt_socket.c that
    * repeatedly calls conn->write until all data is sent.  This
@@ -724,7 +882,91 @@ static int smtp_open(struct Connection *conn, bool esmtp)
 }
 
 /**
- * mutt_smtp_send - Send a message using SMTP
+ * smtp_quit - Close an SMTP Connection
+ * @param conn SMTP Connection
+ */
+static void smtp_quit(struct Connection *conn)
+{
+  if (conn->fd >= 0)
+  {
+    mutt_socket_send(conn, "QUIT\r\n");
+    mutt_socket_close(conn);
+  }
+
+  if (conn == SmtpConn)
+    SmtpConn = NULL;
+}
+
+/**
+ * smtp_envelope - Send the sender and recipients of a message
+ * @param conn     SMTP Connection
+ * @param envfrom  Envelope sender
+ * @param to       To Address
+ * @param cc       Cc Address
+ * @param bcc      Bcc Address
+ * @param eightbit If true, ask for an 8-bit body
+ * @retval  0 Success
+ * @retval <0 Error, e.g. #SMTP_ERR_WRITE
+ *
+ * If the server supports PIPELINING (RFC2920), all the commands are sent in
+ * one go and then all the replies are read.
+ */
+static int smtp_envelope(struct Connection *conn, const char *envfrom,
+                         const struct Address *to, const struct Address *cc,
+                         const struct Address *bcc, bool eightbit)
+{
+  char buf[1024];
+  const bool pipeline = mutt_bit_isset(Capabilities, PIPELINING);
+  int pending = 0;
+  int rc;
+
+  /* send the sender's address */
+  int len = snprintf(buf, sizeof(buf), "MAIL FROM:<%s>", envfrom);
+  if (eightbit && mutt_bit_isset(Capabilities, EIGHTBITMIME))
+  {
+    mutt_str_strncat(buf, sizeof(buf), " BODY=8BITMIME", 15);
+    len += 14;
+  }
+  if (DsnReturn && mutt_bit_isset(Capabilities, DSN))
+    len += snprintf(buf + len, sizeof(buf) - len, " RET=%s", DsnReturn);
+  if (mutt_bit_isset(Capabilities, SMTPUTF8) &&
+      (address_uses_unicode(envfrom) || addresses_use_unicode(to) ||
+       addresses_use_unicode(cc) || addresses_use_unicode(bcc)))
+  {
+    snprintf(buf + len, sizeof(buf) - len, " SMTPUTF8");
+  }
+  mutt_str_strncat(buf, sizeof(buf), "\r\n", 3);
+
+  if (pipeline)
+    mutt_socket_cork(conn);
+
+  if (mutt_socket_send(conn, buf) == -1)
+    return SMTP_ERR_WRITE;
+  if (pipeline)
+    pending++;
+  else if ((rc = smtp_get_resp(conn)) != 0)
+    return rc;
+
+  /* send the recipient list */
+  int *count = pipeline ? &pending : NULL;
+  if ((rc = smtp_rcpt_to(conn, to, count)) || (rc = smtp_rcpt_to(conn, cc, count)) ||
+      (rc = smtp_rcpt_to(conn, bcc, count)))
+  {
+    return rc;
+  }
+
+  if (!pipeline)
+    return 0;
+
+  /* DATA isn't pipelined: a failed recipient must be able to stop the send */
+  if (mutt_socket_flush(conn) < 0)
+    return SMTP_ERR_WRITE;
+
+  return smtp_get_resps(conn, pending);
+}
+
+/**
+ * smtp_send - Send a message using SMTP
  * @param from     From Address
  * @param to       To Address
  * @param cc       Cc Address
@@ -733,15 +975,17 @@ static int smtp_open(struct Connection *conn, bool esmtp)
  * @param eightbit If true, try for an 8-bit friendly connection
  * @retval  0 Success
  * @retval -1 Error
+ *
+ * If $smtp_idle_timeout is set, the connection is left open afterwards, so
+ * that the next message can skip the greeting, TLS and authentication.
  */
-int mutt_smtp_send(const struct Address *from, const struct Address *to,
-                   const struct Address *cc, const struct Address *bcc,
-                   const char *msgfile, bool eightbit)
+static int smtp_send(const struct Address *from, const struct Address *to,
+                     const struct Address *cc, const struct Address *bcc,
+                     const char *msgfile, bool eightbit)
 {
   struct Connection *conn = NULL;
   struct ConnAccount account;
   const char *envfrom = NULL;
-  char buf[1024];
   int rc = -1;
 
   /* it might be better to synthesize an envelope from from user and host
@@ -763,58 +1007,56 @@ int mutt_smtp_send(const struct Address *from, const struct Address *to,
   if (!conn)
     return -1;
 
-  do
+  /* close a kept connection that's gone stale, or belongs to another server */
+  if (SmtpConn && ((SmtpConn != conn) || (eightbit && !SmtpEsmtp) ||
+                   (time(NULL) - SmtpLastUsed >= SmtpIdleTimeout)))
   {
-    /* send our greeting */
-    rc = smtp_open(conn, eightbit);
-    if (rc != 0)
-      break;
-    FREE(&AuthMechs);
+    smtp_quit(SmtpConn);
+  }
 
-    /* send the sender's address */
-    int len = snprintf(buf, sizeof(buf), "MAIL FROM:<%s>", envfrom);
-    if (eightbit && mutt_bit_isset(Capabilities, EIGHTBITMIME))
-    {
-      mutt_str_strncat(buf, sizeof(buf), " BODY=8BITMIME", 15);
-      len += 14;
-    }
-    if (DsnReturn && mutt_bit_isset(Capabilities, DSN))
-      len += snprintf(buf + len, sizeof(buf) - len, " RET=%s", DsnReturn);
-    if (mutt_bit_isset(Capabilities, SMTPUTF8) &&
-        (address_uses_unicode(envfrom) || addresses_use_unicode(to) ||
-         addresses_use_unicode(cc) || addresses_use_unicode(bcc)))
+  bool reused = (conn == SmtpConn) && (conn->fd >= 0);
+
+  do
+  {
+    if (!reused)
     {
-      snprintf(buf + len, sizeof(buf) - len, " SMTPUTF8");
+      /* send our greeting */
+      rc = smtp_open(conn, eightbit);
+      if (rc != 0)
+        break;
+      FREE(&AuthMechs);
     }
-    mutt_str_strncat(buf, sizeof(buf), "\r\n", 3);
-    if (mutt_socket_send(conn, buf) == -1)
+
+    rc = smtp_envelope(conn, envfrom, to, cc, bcc, eightbit);
+    if (reused && ((rc == SMTP_ERR_READ) || (rc == SMTP_ERR_WRITE)))
     {
-      rc = SMTP_ERR_WRITE;
-      break;
+      /* the server has dropped the idle connection, start again */
+      mutt_debug(1, "kept SMTP connection failed, reconnecting\n");
+      smtp_quit(conn);
+      rc = smtp_open(conn, eightbit);
+      if (rc != 0)
+        break;
+      FREE(&AuthMechs);
+      rc = smtp_envelope(conn, envfrom, to, cc, bcc, eightbit);
     }
-    rc = smtp_get_resp(conn);
     if (rc != 0)
       break;
 
-    /* send the recipient list */
-    if ((rc = smtp_rcpt_to(conn, to)) || (rc = smtp_rcpt_to(conn, cc)) ||
-        (rc = smtp_rcpt_to(conn, bcc)))
-    {
-      break;
-    }
-
     /* send the message data */
     rc = smtp_data(conn, msgfile);
     if (rc != 0)
       break;
 
-    mutt_socket_send(conn, "QUIT\r\n");
-
     rc = 0;
   } while (0);
 
-  if (conn)
-    mutt_socket_close(conn);
+  if ((rc == 0) && (SmtpIdleTimeout > 0))
+  {
+    SmtpConn = conn;
+    SmtpLastUsed = time(NULL);
+  }
+  else
+    smtp_quit(conn);
 
   if (rc == SMTP_ERR_READ)
     mutt_error(_("SMTP session failed: read error"));
@@ -825,3 +1067,181 @@ int mutt_smtp_send(const struct Address *from, const struct Address *to,
 
   return rc;
 }
+
+/**
+ * smtp_send_background - Send a message using SMTP in a child process
+ * @param from     From Address
+ * @param to       To Address
+ * @param cc       Cc Address
+ * @param bcc      Bcc Address
+ * @param msgfile  Message to send to the server
+ * @param eightbit If true, try for an 8-bit friendly connection
+ * @retval  1 Delivery started
+ * @retval -1 Error
+ *
+ * The finished message is already spooled in msgfile, so the child only has
+ * to deliver it.  The password is asked for first, since the child can't
+ * prompt.  The result is reported by mutt_smtp_check_background().
+ */
+static int smtp_send_background(const struct Address *from, const struct Address *to,
+                                const struct Address *cc, const struct Address *bcc,
+                                const char *msgfile, bool eightbit)
+{
+  struct ConnAccount account;
+
+  if (smtp_fill_account(&account) < 0)
+    return -1;
+
+  struct Connection *conn = mutt_conn_find(NULL, &account);
+  if (!conn)
+    return -1;
+
+  if ((conn->account.flags & MUTT_ACCT_USER) && !SmtpOauthRefreshCmd &&
+      (mutt_account_getpass(&conn->account) < 0))
+  {
+    return -1;
+  }
+
+  /* the child opens its own connection */
+  if (SmtpConn)
+    smtp_quit(SmtpConn);
+
+  struct SmtpJob *job = mutt_mem_calloc(1, sizeof(struct SmtpJob));
+  mutt_mktemp(job->errfile, sizeof(job->errfile));
+  mutt_mktemp(job->keepfile, sizeof(job->keepfile));
+  if (link(msgfile, job->keepfile) < 0)
+    job->keepfile[0] = '\0';
+
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    /* carry on even if NeoMutt exits, and keep away from the terminal */
+    setsid();
+    int fd = open("/dev/null", O_RDWR);
+    if (fd >= 0)
+    {
+      dup2(fd, 0);
+      dup2(fd, 1);
+      close(fd);
+    }
+    fd = open(job->errfile, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+      dup2(fd, 2);
+      close(fd);
+    }
+
+    OptNoCurses = true;
+    MuttLogger = log_disp_terminal;
+    SmtpIdleTimeout = 0;
+
+    int rc = smtp_send(from, to, cc, bcc, msgfile, eightbit);
+    unlink(msgfile);
+    if ((rc == 0) && job->keepfile[0])
+      unlink(job->keepfile);
+    _exit((rc == 0) ? 0 : 1);
+  }
+
+  if (pid < 0)
+  {
+    mutt_perror(_("Can't fork"));
+    if (job->keepfile[0])
+      unlink(job->keepfile);
+    FREE(&job);
+    return -1;
+  }
+
+  job->pid = pid;
+  STAILQ_INSERT_TAIL(&SmtpJobs, job, entries);
+  return 1;
+}
+
+/**
+ * mutt_smtp_check_background - Report the messages delivered in the background
+ * @retval num Number of deliveries still running
+ *
+ * The last error of a failed delivery is shown, along with where the
+ * message was kept.
+ */
+int mutt_smtp_check_background(void)
+{
+  struct SmtpJob *job = NULL, *tmp = NULL;
+  int running = 0;
+
+  STAILQ_FOREACH_SAFE(job, &SmtpJobs, entries, tmp)
+  {
+    int st;
+    pid_t pid = waitpid(job->pid, &st, WNOHANG);
+    if (pid == 0)
+    {
+      running++;
+      continue;
+    }
+
+    if ((pid == job->pid) && WIFEXITED(st) && (WEXITSTATUS(st) == 0))
+      mutt_message(_("Mail sent"));
+    else
+    {
+      char err[STRING] = "";
+      FILE *fp = fopen(job->errfile, "r");
+      if (fp)
+      {
+        char buf[STRING];
+        while (fgets(buf, sizeof(buf), fp))
+          if (buf[0] != '\n')
+            mutt_str_strfcpy(err, buf, sizeof(err));
+        mutt_file_fclose(&fp);
+        mutt_str_remove_trailing_ws(err);
+      }
+
+      if (job->keepfile[0])
+      {
+        /* L10N: The first %s is the error, the second a file name */
+        mutt_error(_("Sending in background failed: %s (message saved in %s)"),
+                   err[0] ? err : _("unknown error"), job->keepfile);
+      }
+      else
+      {
+        mutt_error(_("Sending in background failed: %s"),
+                   err[0] ? err : _("unknown error"));
+      }
+    }
+
+    unlink(job->errfile);
+    STAILQ_REMOVE(&SmtpJobs, job, SmtpJob, entries);
+    FREE(&job);
+  }
+
+  return running;
+}
+
+/**
+ * mutt_smtp_send - Send a message using SMTP
+ * @param from     From Address
+ * @param to       To Address
+ * @param cc       Cc Address
+ * @param bcc      Bcc Address
+ * @param msgfile  Message to send to the server
+ * @param eightbit If true, try for an 8-bit friendly connection
+ * @retval  0 Success
+ * @retval  1 Delivery continues in the background, see $smtp_background
+ * @retval -1 Error
+ */
+int mutt_smtp_send(const struct Address *from, const struct Address *to,
+                   const struct Address *cc, const struct Address *bcc,
+                   const char *msgfile, bool eightbit)
+{
+  if (SmtpBackground && !OptNoCurses)
+    return smtp_send_background(from, to, cc, bcc, msgfile, eightbit);
+
+  return smtp_send(from, to, cc, bcc, msgfile, eightbit);
+}
+
+/**
+ * mutt_smtp_logout - Close the SMTP connection kept by $smtp_idle_timeout
+ */
+void mutt_smtp_logout(void)
+{
+  if (SmtpConn)
+    smtp_quit(SmtpConn);
+}
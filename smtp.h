@@ -23,13 +23,19 @@
 #ifndef MUTT_SMTP_H
 #define MUTT_SMTP_H
 
+#include <stdbool.h>
+
 struct Address;
 
 /* These Config Variables are only used in smtp.c */
 extern char *SmtpAuthenticators;
+extern bool SmtpBackground;
+extern short SmtpIdleTimeout;
 
 #ifdef USE_SMTP
 int mutt_smtp_send(const struct Address *from, const struct Address *to, const struct Address *cc, const struct Address *bcc, const char *msgfile, bool eightbit);
+int mutt_smtp_check_background(void);
+void mutt_smtp_logout(void);
 #endif
 
 #endif /* MUTT_SMTP_H */
@@ -21,7 +21,9 @@
  */
 
 #include "config.h"
+#include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "mutt/mutt.h"
@@ -39,6 +41,9 @@
 #include "mx.h"
 #include "nntp/nntp.h"
 #endif
+#ifdef USE_IMAP
+#include "imap/imap.h"
+#endif
 
 /* These Config Variables are only used in sort.c */
 bool ReverseAlias; ///< Config: Display the alias in the index, rather than the message's sender
@@ -346,6 +351,212 @@ sort_t *mutt_get_sort_func(int method)
   /* not reached */
 }
 
+/**
+ * struct SortKey - An email with the strings it's sorted by
+ *
+ * The strings are folded to lower case once, before sorting, rather than on
+ * every comparison.  The email is first, so a SortKey can also be given to
+ * the comparators that expect a `struct Email **`, e.g. for $sort_aux.
+ */
+struct SortKey
+{
+  struct Email *email; ///< Email being sorted
+  char *from;          ///< Folded name of the sender
+  char *to;            ///< Folded name of the recipient
+  char *subj;          ///< Folded real subject, or NULL
+};
+
+/**
+ * sort_key_fold - Fold a string to lower case for sorting
+ * @param str    String to fold
+ * @param maxlen Maximum number of bytes to keep
+ * @retval ptr New string
+ *
+ * Comparing the folded strings with strcmp() gives the same order as
+ * comparing the originals with strcasecmp().
+ */
+static char *sort_key_fold(const char *str, size_t maxlen)
+{
+  const size_t len = MIN(mutt_str_strlen(str), maxlen);
+  char *key = mutt_mem_malloc(len + 1);
+
+  for (size_t i = 0; i < len; i++)
+    key[i] = tolower((unsigned char) str[i]);
+  key[len] = '\0';
+  return key;
+}
+
+/**
+ * compare_from_key - Compare the 'from' fields of two SortKeys - Implements ::sort_t
+ */
+static int compare_from_key(const void *a, const void *b)
+{
+  const struct SortKey *ka = a;
+  const struct SortKey *kb = b;
+  int result = mutt_str_strcmp(ka->from, kb->from);
+  result = perform_auxsort(result, a, b);
+  return SORTCODE(result);
+}
+
+/**
+ * compare_to_key - Compare the 'to' fields of two SortKeys - Implements ::sort_t
+ */
+static int compare_to_key(const void *a, const void *b)
+{
+  const struct SortKey *ka = a;
+  const struct SortKey *kb = b;
+  int result = mutt_str_strcmp(ka->to, kb->to);
+  result = perform_auxsort(result, a, b);
+  return SORTCODE(result);
+}
+
+/**
+ * compare_subject_key - Compare the subjects of two SortKeys - Implements ::sort_t
+ */
+static int compare_subject_key(const void *a, const void *b)
+{
+  const struct SortKey *ka = a;
+  const struct SortKey *kb = b;
+  int rc;
+
+  if (!ka->subj)
+  {
+    if (!kb->subj)
+      rc = compare_date_sent(a, b);
+    else
+      rc = -1;
+  }
+  else if (!kb->subj)
+    rc = 1;
+  else
+    rc = mutt_str_strcmp(ka->subj, kb->subj);
+  rc = perform_auxsort(rc, a, b);
+  return SORTCODE(rc);
+}
+
+/**
+ * get_key_sort_func - Get the SortKey version of a sort function
+ * @param method Sort id, e.g. #SORT_FROM
+ * @retval ptr  Sort function - Implements ::sort_t
+ * @retval NULL The method doesn't need a SortKey
+ */
+static sort_t *get_key_sort_func(int method)
+{
+  switch (method & SORT_MASK)
+  {
+    case SORT_FROM:
+      return compare_from_key;
+    case SORT_SUBJECT:
+      return compare_subject_key;
+    case SORT_TO:
+      return compare_to_key;
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * sort_presorted - Sort an array whose start may already be in order
+ * @param base Array to sort
+ * @param num  Number of elements
+ * @param size Size of an element
+ * @param cmp  Sort function - Implements ::sort_t
+ *
+ * New mail is added to the end of the mailbox, so a resort usually finds the
+ * old emails still in order.  Only the elements after the ordered run are
+ * sorted, then the two runs are merged.  This gives the same order as
+ * sorting the whole array, as long as the comparison is a strict order.
+ */
+static void sort_presorted(void *base, size_t num, size_t size, sort_t *cmp)
+{
+  char *array = base;
+  size_t run = 1;
+
+  while ((run < num) && (cmp(array + (run - 1) * size, array + run * size) <= 0))
+    run++;
+
+  if (run >= num)
+    return;
+
+  if (run < 2)
+  {
+    qsort(base, num, size, cmp);
+    return;
+  }
+
+  qsort(array + run * size, num - run, size, cmp);
+
+  /* merge from a copy of the ordered run, the rest is read in place */
+  char *head = mutt_mem_malloc(run * size);
+  memcpy(head, array, run * size);
+
+  size_t i = 0, j = run, k = 0;
+  while ((i < run) && (j < num))
+  {
+    if (cmp(head + i * size, array + j * size) <= 0)
+      memcpy(array + k++ * size, head + i++ * size, size);
+    else
+      memcpy(array + k++ * size, array + j++ * size, size);
+  }
+  if (i < run)
+    memcpy(array + k * size, head + i * size, (run - i) * size);
+
+  FREE(&head);
+}
+
+/**
+ * sort_emails - Sort the emails of a mailbox
+ * @param m        Mailbox
+ * @param sortfunc Sort function for $sort - Implements ::sort_t
+ *
+ * If $sort or $sort_aux compares strings, they're worked out once for each
+ * email and the emails are sorted with their keys.
+ */
+static void sort_emails(struct Mailbox *m, sort_t *sortfunc)
+{
+  sort_t *key_sort = get_key_sort_func(Sort);
+  sort_t *key_aux = get_key_sort_func(SortAux);
+
+  if (!key_sort && !key_aux)
+  {
+    sort_presorted(m->hdrs, m->msg_count, sizeof(struct Email *), sortfunc);
+    return;
+  }
+
+  const bool from = (key_sort == compare_from_key) || (key_aux == compare_from_key);
+  const bool to = (key_sort == compare_to_key) || (key_aux == compare_to_key);
+  const bool subj = (key_sort == compare_subject_key) || (key_aux == compare_subject_key);
+
+  struct SortKey *keys = mutt_mem_calloc(m->msg_count, sizeof(struct SortKey));
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    struct Email *e = m->hdrs[i];
+    keys[i].email = e;
+    /* mutt_get_name() may return a static buffer, so each name is copied */
+    if (from)
+      keys[i].from = sort_key_fold(mutt_get_name(e->env->from), SHORT_STRING - 1);
+    if (to)
+      keys[i].to = sort_key_fold(mutt_get_name(e->env->to), SHORT_STRING - 1);
+    if (subj && e->env->real_subj)
+      keys[i].subj = sort_key_fold(e->env->real_subj, SIZE_MAX);
+  }
+
+  sort_t *aux = AuxSort;
+  if (key_aux)
+    AuxSort = key_aux;
+  sort_presorted(keys, m->msg_count, sizeof(struct SortKey), key_sort ? key_sort : sortfunc);
+  AuxSort = aux;
+
+  for (int i = 0; i < m->msg_count; i++)
+  {
+    m->hdrs[i] = keys[i].email;
+    FREE(&keys[i].from);
+    FREE(&keys[i].to);
+    FREE(&keys[i].subj);
+  }
+  FREE(&keys);
+}
+
 /**
  * mutt_sort_headers - Sort emails by their headers
  * @param ctx  Mailbox
@@ -376,11 +587,12 @@ void mutt_sort_headers(struct Context *ctx, bool init)
 
   if (!ctx->mailbox->quiet)
     mutt_message(_("Sorting mailbox..."));
+  mutt_trace_begin("sort_headers", NULL);
 
   if (OptNeedRescore && Score)
   {
     for (int i = 0; i < ctx->mailbox->msg_count; i++)
-      mutt_score_message(ctx, ctx->mailbox->hdrs[i], true);
+      mutt_rescore_message(ctx, ctx->mailbox->hdrs[i], true);
   }
   OptNeedRescore = false;
 
@@ -412,11 +624,22 @@ void mutt_sort_headers(struct Context *ctx, bool init)
   else if (!(sortfunc = mutt_get_sort_func(Sort)) || !(AuxSort = mutt_get_sort_func(SortAux)))
   {
     mutt_error(_("Could not find sorting function [report this bug]"));
+    mutt_trace_end("sort_headers");
     return;
   }
   else
-    qsort((void *) ctx->mailbox->hdrs, ctx->mailbox->msg_count,
-          sizeof(struct Email *), sortfunc);
+  {
+#ifdef USE_IMAP
+    /* let the server sort, if it can, without the headers */
+    if (imap_sort_mailbox(ctx->mailbox, Sort, SortAux) != 0)
+#endif
+    {
+      /* every sort order, except the mailbox order, needs the headers */
+      if ((Sort & SORT_MASK) != SORT_ORDER)
+        mx_mbox_load_headers(ctx);
+      sort_emails(ctx->mailbox, sortfunc);
+    }
+  }
 
   /* adjust the virtual message numbers */
   ctx->mailbox->vcount = 0;
@@ -449,6 +672,86 @@ void mutt_sort_headers(struct Context *ctx, bool init)
     mutt_set_virtual(ctx);
   }
 
+  mutt_trace_end("sort_headers");
   if (!ctx->mailbox->quiet)
     mutt_clear_error();
 }
+
+/**
+ * mutt_sort_append - Sort new emails onto the end of a sorted mailbox
+ * @param ctx      Mailbox
+ * @param oldcount Number of emails that were already sorted
+ * @retval true  The new emails were added to the end of the index
+ * @retval false The mailbox needs a full mutt_sort_headers()
+ *
+ * When new mail arrives, the old emails are usually still sorted and the new
+ * ones all sort after them.  In that case only the new emails are sorted and
+ * given virtual numbers, leaving the rest of the index untouched.  Anything
+ * else, e.g. threads, a pending resort or new mail that sorts earlier, is left
+ * to a full sort.
+ */
+bool mutt_sort_append(struct Context *ctx, int oldcount)
+{
+  if (!ctx || (oldcount <= 0) || (oldcount > ctx->mailbox->msg_count))
+    return false;
+
+  if (OptNeedResort || OptResortInit || (OptNeedRescore && Score))
+    return false;
+
+  if ((Sort & SORT_MASK) == SORT_THREADS)
+    return false;
+
+#ifdef USE_IMAP
+  /* the server's order may not match ours */
+  if ((ctx->mailbox->magic == MUTT_IMAP) && ImapServerSort)
+    return false;
+#endif
+
+  sort_t *sortfunc = mutt_get_sort_func(Sort);
+  if (!sortfunc || !(AuxSort = mutt_get_sort_func(SortAux)))
+    return false;
+
+  struct Mailbox *m = ctx->mailbox;
+  const int num = m->msg_count - oldcount;
+
+  /* the new emails are at the end of v2r, after the old visible ones */
+  int vcount = m->vcount;
+  for (int i = oldcount; i < m->msg_count; i++)
+    if (m->hdrs[i]->virtual != -1)
+      vcount--;
+  if ((vcount < 0) ||
+      ((vcount > 0) && ((m->v2r[vcount - 1] >= oldcount) ||
+                        (m->hdrs[m->v2r[vcount - 1]]->virtual != vcount - 1))))
+  {
+    return false;
+  }
+
+  if ((Sort & SORT_MASK) != SORT_ORDER)
+  {
+    if (m->hdrs[oldcount - 1]->header_pending)
+      return false;
+    for (int i = oldcount; i < m->msg_count; i++)
+      if (m->hdrs[i]->header_pending)
+        mx_msg_load_header(ctx, m->hdrs[i]);
+  }
+
+  if (num > 1)
+    qsort(m->hdrs + oldcount, num, sizeof(struct Email *), sortfunc);
+  if ((num > 0) && (sortfunc(&m->hdrs[oldcount - 1], &m->hdrs[oldcount]) > 0))
+    return false;
+
+  m->vcount = vcount;
+  for (int i = oldcount; i < m->msg_count; i++)
+  {
+    struct Email *cur = m->hdrs[i];
+    if (cur->virtual != -1)
+    {
+      cur->virtual = m->vcount;
+      m->v2r[m->vcount] = i;
+      m->vcount++;
+    }
+    cur->msgno = i;
+  }
+
+  return true;
+}
@@ -49,6 +49,7 @@ typedef int sort_t(const void *a, const void *b);
 
 sort_t *mutt_get_sort_func(int method);
 
+bool mutt_sort_append(struct Context *ctx, int oldcount);
 void mutt_sort_headers(struct Context *ctx, bool init);
 int perform_auxsort(int retval, const void *a, const void *b);
 
@@ -25,6 +25,8 @@
 
 #include <stdio.h>
 
+struct MuttFileMap;
+
 /**
  * struct State - Keep track when processing files
  */
@@ -34,6 +36,7 @@ struct State
   FILE *fpout;
   char *prefix;
   int flags;
+  const struct MuttFileMap *map; /**< fpin in memory, may be NULL */
 };
 
 /* flags for the State struct */
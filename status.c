@@ -43,6 +43,9 @@
 #ifdef USE_NOTMUCH
 #include "notmuch/mutt_notmuch.h"
 #endif
+#ifdef USE_HCACHE
+#include "hcache/hcache.h"
+#endif
 
 /* These Config Variables are only used in status.c */
 struct MbTable *StatusChars; ///< Config: Indicator characters for the status bar
@@ -73,6 +76,7 @@ static char *get_sort_str(char *buf, size_t buflen, int method)
  * | \%f     | Full mailbox path
  * | \%F     | Number of flagged messages
  * | \%h     | Hostname
+ * | \%H     | Header cache hit rate (percent)
  * | \%l     | Length of mailbox (in bytes)
  * | \%L     | Size (in bytes) of the messages shown
  * | \%M     | Number of messages shown (virtual message count when limiting)
@@ -178,6 +182,24 @@ static const char *status_format_str(char *buf, size_t buflen, size_t col, int c
       snprintf(buf, buflen, fmt, NONULL(ShortHostname));
       break;
 
+    case 'H':
+    {
+      unsigned long hits = 0, lookups = 0;
+#ifdef USE_HCACHE
+      const struct HcacheStats *st = mutt_hcache_stats();
+      hits = st->hits;
+      lookups = st->hits + st->misses + st->crc_mismatches;
+#endif
+      if (!optional)
+      {
+        snprintf(fmt, sizeof(fmt), "%%%slu", prec);
+        snprintf(buf, buflen, fmt, lookups ? (hits * 100 / lookups) : 0);
+      }
+      else if (lookups == 0)
+        optional = 0;
+      break;
+    }
+
     case 'l':
       if (!optional)
       {
@@ -91,3 +91,65 @@ void test_addr_mbox_to_udomain(void)
     TEST_CHECK_STR_EQ(expected, actual);
   }
 }
+
+/**
+ * check_list - Check a parsed list of addresses
+ * @param str      String that was parsed
+ * @param expected Mailbox and personal name of each Address, ending with NULL
+ */
+static void check_list(const char *str, const char *const *expected)
+{
+  struct Address *list = mutt_addr_parse_list(NULL, str);
+  struct Address *a = list;
+
+  for (size_t i = 0; expected[i]; i += 2)
+  {
+    if (!TEST_CHECK(a != NULL))
+    {
+      TEST_MSG("String  : %s", str);
+      TEST_MSG("Missing : %s", expected[i]);
+      break;
+    }
+    const char *mailbox = a->mailbox ? a->mailbox : "";
+    const char *personal = a->personal ? a->personal : "";
+    if (!TEST_CHECK((strcmp(expected[i], mailbox) == 0) &&
+                    (strcmp(expected[i + 1], personal) == 0)))
+    {
+      TEST_MSG("String  : %s", str);
+      TEST_MSG("Expected: %s / %s", expected[i], expected[i + 1]);
+      TEST_MSG("Actual  : %s / %s", mailbox, personal);
+    }
+    a = a->next;
+  }
+  if (!TEST_CHECK(a == NULL))
+    TEST_MSG("String  : %s, too many addresses", str);
+
+  mutt_addr_free(&list);
+}
+
+void test_addr_parse_list(void)
+{
+  /* the common forms, parsed without the tokenizer */
+  check_list("user@example.com", (const char *[]){ "user@example.com", "", NULL });
+  check_list("Some Name <user@example.com>",
+             (const char *[]){ "user@example.com", "Some Name", NULL });
+  check_list("  Some   Name\t<user@example.com>  ",
+             (const char *[]){ "user@example.com", "Some Name", NULL });
+  check_list("\"Name, Jr.\" <user@example.com>",
+             (const char *[]){ "user@example.com", "Name, Jr.", NULL });
+  check_list("a@x.org, B <b@y.org>,\"C\" <c@z.org> , d@w.org",
+             (const char *[]){ "a@x.org", "", "b@y.org", "B", "c@z.org", "C",
+                               "d@w.org", "", NULL });
+
+  /* the forms left to the full parser */
+  check_list("<user@example.com>", (const char *[]){ "user@example.com", "", NULL });
+  check_list("user@example.com (Some Name)",
+             (const char *[]){ "user@example.com", "Some Name", NULL });
+  check_list("\"Quo\\\"ted\" <q@x.org>", (const char *[]){ "q@x.org", "Quo\"ted", NULL });
+  check_list("Some.Name <user@example.com>",
+             (const char *[]){ "user@example.com", "Some.Name", NULL });
+  check_list("user", (const char *[]){ "user", "", NULL });
+  check_list("team: a@x.org, B <b@y.org>;",
+             (const char *[]){ "team", "", "a@x.org", "", "b@y.org", "B", "", "", NULL });
+  check_list("", (const char *[]){ NULL });
+}
@@ -0,0 +1,57 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include <stdbool.h>
+#include <time.h>
+#include "mutt/date.h"
+#include "mutt/memory.h"
+
+void test_date_parse_date(void)
+{
+  static const struct
+  {
+    const char *date;
+    time_t expected;
+    unsigned char zhours;
+    unsigned char zminutes;
+    bool zoccident;
+  } tests[] = {
+    /* the usual format, handled by the fast path */
+    { "Tue, 07 Aug 2018 12:34:56 +0200", 1533638096, 2, 0, false },
+    { "7 Aug 2018 12:34 -0930", 1533679440, 9, 30, true },
+    { "Sat, 31 Dec 2016 23:59:60 +0000", 1483228800, 0, 0, false },
+    { "Thu, 01 Jan 1970 00:00:00 +0000", 0, 0, 0, false },
+    { "Wed, 9 Mar 2005 8:05:09 +1030 (ACDT)", 1110317709, 10, 30, false },
+    { "Fri, 29 Feb 2036 06:07:08 -0000", 2087878028, 0, 0, true },
+    { "Tue,  7   Aug  2018  12:34:56  +0200", 1533638096, 2, 0, false },
+    /* left to the general parser */
+    { "Mon, 1 Jan 2018 00:00:00 GMT", 1514764800, 0, 0, false },
+    { "Thu, 1 Jan 98 00:00:00 +0000", 883612800, 0, 0, false },
+    { "Tue, 7 Aug 2018 12:34:56 EDT", 1533659696, 4, 0, true },
+    { "Tue, 7 aug 2018 12:34:56 +0200", 1533638096, 2, 0, false },
+  };
+
+  for (size_t i = 0; i < mutt_array_size(tests); i++)
+  {
+    struct Tz tz = { { 0 }, 0xff, 0xff, false };
+    time_t t = mutt_date_parse_date(tests[i].date, &tz);
+    if (!TEST_CHECK(t == tests[i].expected))
+    {
+      TEST_MSG("Date    : %s", tests[i].date);
+      TEST_MSG("Expected: %ld", (long) tests[i].expected);
+      TEST_MSG("Actual  : %ld", (long) t);
+    }
+    if (!TEST_CHECK((tz.zhours == tests[i].zhours) && (tz.zminutes == tests[i].zminutes) &&
+                    (tz.zoccident == tests[i].zoccident)))
+    {
+      TEST_MSG("Date    : %s", tests[i].date);
+      TEST_MSG("Expected: %c%02u%02u", tests[i].zoccident ? '-' : '+',
+               tests[i].zhours, tests[i].zminutes);
+      TEST_MSG("Actual  : %c%02u%02u", tz.zoccident ? '-' : '+', tz.zhours, tz.zminutes);
+    }
+  }
+
+  /* not dates at all */
+  TEST_CHECK(mutt_date_parse_date("", NULL) == -1);
+  TEST_CHECK(mutt_date_parse_date("yesterday", NULL) == -1);
+  TEST_CHECK(mutt_date_parse_date("32 Jan 2018 00:00:00 +0000", NULL) == -1);
+}
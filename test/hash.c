@@ -0,0 +1,166 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "mutt/hash.h"
+#include "mutt/memory.h"
+
+#define NUM_KEYS 1000
+
+static int destroyed = 0;
+
+static void count_destroy(int type, void *obj, intptr_t data)
+{
+  destroyed++;
+}
+
+/**
+ * walk_count - Walk a Hash table, checking every key is seen once
+ * @param table Hash table
+ * @param seen  Array of NUM_KEYS counters, cleared by the caller
+ * @retval num Number of HashElems walked
+ */
+static size_t walk_count(const struct Hash *table, int *seen)
+{
+  struct HashWalkState state = { 0 };
+  struct HashElem *he = NULL;
+  size_t num = 0;
+
+  while ((he = mutt_hash_walk(table, &state)))
+  {
+    const intptr_t i = (intptr_t) he->data;
+    if (TEST_CHECK((i >= 0) && (i < NUM_KEYS)))
+      seen[i]++;
+    num++;
+  }
+
+  return num;
+}
+
+void test_hash_grow_walk(void)
+{
+  char key[32];
+  int seen[NUM_KEYS] = { 0 };
+
+  struct Hash *table = mutt_hash_create(4, MUTT_HASH_STRDUP_KEYS);
+  const size_t nelem = table->nelem;
+
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    TEST_CHECK(mutt_hash_insert(table, key, (void *) i) != NULL);
+
+    /* a walk must see every key, whatever the size of the table */
+    if ((i == 3) || (i == 4) || (i == 100) || (i == (NUM_KEYS - 1)))
+    {
+      int part[NUM_KEYS] = { 0 };
+      TEST_CHECK(walk_count(table, part) == (size_t)(i + 1));
+      for (intptr_t j = 0; j <= i; j++)
+        TEST_CHECK(part[j] == 1);
+    }
+  }
+
+  TEST_CHECK(table->count == NUM_KEYS);
+  if (!TEST_CHECK(table->nelem > nelem))
+    TEST_MSG("The table didn't grow: %zu buckets", table->nelem);
+
+  TEST_CHECK(walk_count(table, seen) == NUM_KEYS);
+  for (int i = 0; i < NUM_KEYS; i++)
+  {
+    if (!TEST_CHECK(seen[i] == 1))
+      TEST_MSG("key%d seen %d times", i, seen[i]);
+  }
+
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    TEST_CHECK(mutt_hash_find(table, key) == (void *) i);
+  }
+
+  mutt_hash_destroy(&table);
+  TEST_CHECK(table == NULL);
+}
+
+void test_hash_delete_reinsert(void)
+{
+  char key[32];
+
+  destroyed = 0;
+  struct Hash *table = mutt_hash_create(16, MUTT_HASH_STRDUP_KEYS);
+  mutt_hash_set_destructor(table, count_destroy, 0);
+
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    mutt_hash_insert(table, key, (void *) i);
+  }
+
+  /* delete the even keys, their HashElems go to the spare list */
+  for (intptr_t i = 0; i < NUM_KEYS; i += 2)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    mutt_hash_delete(table, key, NULL);
+  }
+  TEST_CHECK(destroyed == (NUM_KEYS / 2));
+  TEST_CHECK(table->count == (NUM_KEYS / 2));
+  TEST_CHECK(table->spare != NULL);
+
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    TEST_CHECK(mutt_hash_find(table, key) == ((i % 2) ? (void *) i : NULL));
+  }
+
+  /* a key that's already there isn't inserted, and its HashElem is kept */
+  TEST_CHECK(mutt_hash_insert(table, "key1", (void *) 1) == NULL);
+  TEST_CHECK(table->count == (NUM_KEYS / 2));
+
+  /* re-insert them, reusing the spare HashElems */
+  for (intptr_t i = 0; i < NUM_KEYS; i += 2)
+  {
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    struct HashElem *he = mutt_hash_insert(table, key, (void *) i);
+    if (TEST_CHECK(he != NULL))
+      TEST_CHECK(he->data == (void *) i);
+  }
+  TEST_CHECK(table->spare == NULL);
+  TEST_CHECK(table->count == NUM_KEYS);
+
+  int seen[NUM_KEYS] = { 0 };
+  TEST_CHECK(walk_count(table, seen) == NUM_KEYS);
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+  {
+    TEST_CHECK(seen[i] == 1);
+    snprintf(key, sizeof(key), "key%ld", (long) i);
+    TEST_CHECK(mutt_hash_find(table, key) == (void *) i);
+  }
+
+  destroyed = 0;
+  mutt_hash_destroy(&table);
+  TEST_CHECK(destroyed == NUM_KEYS);
+}
+
+void test_hash_int_dups(void)
+{
+  struct Hash *table = mutt_hash_int_create(2, MUTT_HASH_ALLOW_DUPS);
+
+  for (intptr_t i = 0; i < NUM_KEYS; i++)
+    mutt_hash_int_insert(table, (unsigned int) (i % 10), (void *) i);
+  TEST_CHECK(table->count == NUM_KEYS);
+
+  /* the most recent duplicate is found first, even after growing */
+  for (intptr_t i = 0; i < 10; i++)
+    TEST_CHECK(mutt_hash_int_find(table, (unsigned int) i) == (void *) (NUM_KEYS - 10 + i));
+
+  /* delete one of the duplicates, then all of the others */
+  mutt_hash_int_delete(table, 3, (void *) 503);
+  TEST_CHECK(table->count == (NUM_KEYS - 1));
+  mutt_hash_int_delete(table, 3, NULL);
+  TEST_CHECK(table->count == (NUM_KEYS - (NUM_KEYS / 10)));
+  TEST_CHECK(mutt_hash_int_find(table, 3) == NULL);
+
+  mutt_hash_int_insert(table, 3, (void *) 3);
+  TEST_CHECK(mutt_hash_int_find(table, 3) == (void *) 3);
+
+  mutt_hash_destroy(&table);
+}
@@ -1,8 +1,17 @@
 #include "acutest.h"
+#include "config.h"
 
 /******************************************************************************
  * Add your test cases to this list.
  *****************************************************************************/
+#ifdef USE_HCACHE
+#define NEOMUTT_TEST_HCACHE                                                    \
+  NEOMUTT_TEST_ITEM(test_serialize_uint)                                       \
+  NEOMUTT_TEST_ITEM(test_serialize_long)
+#else
+#define NEOMUTT_TEST_HCACHE
+#endif
+
 #define NEOMUTT_TEST_LIST                                                      \
   NEOMUTT_TEST_ITEM(test_base64_encode)                                        \
   NEOMUTT_TEST_ITEM(test_base64_decode)                                        \
@@ -15,9 +24,16 @@
   NEOMUTT_TEST_ITEM(test_string_strnfcpy)                                      \
   NEOMUTT_TEST_ITEM(test_string_strcasestr)                                    \
   NEOMUTT_TEST_ITEM(test_addr_mbox_to_udomain)                                 \
+  NEOMUTT_TEST_ITEM(test_addr_parse_list)                                      \
+  NEOMUTT_TEST_ITEM(test_date_parse_date)                                      \
   NEOMUTT_TEST_ITEM(test_mutt_path_tidy_slash)                                 \
   NEOMUTT_TEST_ITEM(test_mutt_path_tidy_dotdot)                                \
-  NEOMUTT_TEST_ITEM(test_mutt_path_tidy)
+  NEOMUTT_TEST_ITEM(test_mutt_path_tidy)                                       \
+  NEOMUTT_TEST_ITEM(test_hash_grow_walk)                                       \
+  NEOMUTT_TEST_ITEM(test_hash_delete_reinsert)                                 \
+  NEOMUTT_TEST_ITEM(test_hash_int_dups)                                        \
+  NEOMUTT_TEST_ITEM(test_parallel_for)                                         \
+  NEOMUTT_TEST_HCACHE
 
 /******************************************************************************
  * You probably don't need to touch what follows.
@@ -0,0 +1,104 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include "config.h"
+#include <stdbool.h>
+#include <stddef.h>
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
+#include "mutt/memory.h"
+#include "mutt/parallel.h"
+
+/**
+ * struct ParallelTest - Work shared by the threads
+ */
+struct ParallelTest
+{
+  size_t n;           ///< Number of items
+  int *done;          ///< Number of times each item was processed
+  size_t progress;    ///< Number of calls to the progress callback
+  size_t last;        ///< Last number the progress callback was given
+  bool ordered;       ///< Progress never went backwards
+  bool progress_main; ///< Progress was only reported by the calling thread
+#ifdef USE_THREADS
+  pthread_t caller;   ///< Thread that called mutt_parallel_for()
+#endif
+};
+
+static void test_work(size_t i, void *data)
+{
+  struct ParallelTest *pt = data;
+  if (i < pt->n)
+    __atomic_add_fetch(&pt->done[i], 1, __ATOMIC_RELAXED);
+}
+
+static void test_progress(size_t done, void *data)
+{
+  struct ParallelTest *pt = data;
+  pt->progress++;
+  if (done < pt->last)
+    pt->ordered = false;
+  pt->last = done;
+#ifdef USE_THREADS
+  if (!pthread_equal(pthread_self(), pt->caller))
+    pt->progress_main = false;
+#endif
+}
+
+/**
+ * run_parallel - Process some items and check each one was done once
+ * @param n       Number of items
+ * @param threads Number of threads
+ */
+static void run_parallel(size_t n, int threads)
+{
+  struct ParallelTest pt = { 0 };
+  pt.n = n;
+  pt.done = mutt_mem_calloc(n + 1, sizeof(int));
+  pt.ordered = true;
+  pt.progress_main = true;
+#ifdef USE_THREADS
+  pt.caller = pthread_self();
+#endif
+
+  mutt_parallel_for(n, threads, test_work, test_progress, &pt);
+
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!TEST_CHECK(pt.done[i] == 1))
+      TEST_MSG("%zu items, %d threads: item %zu done %d times", n, threads, i, pt.done[i]);
+  }
+
+  TEST_CHECK(pt.ordered);
+  TEST_CHECK(pt.progress_main);
+  if (n == 0)
+  {
+    TEST_CHECK(pt.progress == 0);
+  }
+  else
+  {
+    /* the progress is always finished off */
+    TEST_CHECK(pt.progress > 0);
+    TEST_CHECK(pt.last == n);
+  }
+
+  FREE(&pt.done);
+}
+
+void test_parallel_for(void)
+{
+  static const int threads[] = { 1, 2, 4, 8 };
+
+  for (size_t t = 0; t < mutt_array_size(threads); t++)
+  {
+    run_parallel(0, threads[t]);
+    run_parallel(1, threads[t]);
+    run_parallel(3, threads[t]);
+    run_parallel(5000, threads[t]);
+  }
+
+  /* no callbacks at all */
+  mutt_parallel_for(10, 4, NULL, NULL, NULL);
+
+  mutt_pool_shutdown();
+}
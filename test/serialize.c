@@ -0,0 +1,85 @@
+#define TEST_NO_MAIN
+#include "acutest.h"
+#include "config.h"
+#include <limits.h>
+#include <stdbool.h>
+#include "mutt/memory.h"
+#include "hcache/serialize.h"
+
+void test_serialize_uint(void)
+{
+  static const unsigned int tests[] = {
+    0, 1, 0x7f, 0x80, 0xff, 0x3fff, 0x4000, 0x1fffff, 0x200000,
+    0xfffffff, 0x10000000, INT_MAX, 0x80000000, UINT_MAX - 1, UINT_MAX,
+  };
+  /* Bytes needed for each value, 7 bits per byte */
+  static const int sizes[] = {
+    1, 1, 1, 2, 2, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5,
+  };
+
+  unsigned char *d = mutt_mem_malloc(4096);
+  int off = 0;
+
+  for (size_t i = 0; i < mutt_array_size(tests); i++)
+  {
+    const int start = off;
+    d = serial_dump_uint(tests[i], d, &off);
+    if (!TEST_CHECK((off - start) == sizes[i]))
+      TEST_MSG("%u took %d bytes, expected %d", tests[i], off - start, sizes[i]);
+  }
+
+  /* the values are read back in order, from one blob */
+  int roff = 0;
+  for (size_t i = 0; i < mutt_array_size(tests); i++)
+  {
+    unsigned int value = 0;
+    serial_restore_uint(&value, d, &roff);
+    if (!TEST_CHECK(value == tests[i]))
+    {
+      TEST_MSG("Expected: %u", tests[i]);
+      TEST_MSG("Actual  : %u", value);
+    }
+  }
+  TEST_CHECK(roff == off);
+
+  FREE(&d);
+}
+
+void test_serialize_long(void)
+{
+  static const long long tests[] = {
+    0, 1, -1, 63, -64, 64, -65, 8191, -8192, 8192, INT_MAX, INT_MIN,
+    (long long) UINT_MAX, -(long long) UINT_MAX, LLONG_MAX - 1, LLONG_MAX,
+    LLONG_MIN + 1, LLONG_MIN,
+  };
+  /* Zigzag encoded, so small negative numbers are small too */
+  static const int sizes[] = {
+    1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 5, 5, 5, 5, 10, 10, 10, 10,
+  };
+
+  unsigned char *d = mutt_mem_malloc(4096);
+  int off = 0;
+
+  for (size_t i = 0; i < mutt_array_size(tests); i++)
+  {
+    const int start = off;
+    d = serial_dump_long(tests[i], d, &off);
+    if (!TEST_CHECK((off - start) == sizes[i]))
+      TEST_MSG("%lld took %d bytes, expected %d", tests[i], off - start, sizes[i]);
+  }
+
+  int roff = 0;
+  for (size_t i = 0; i < mutt_array_size(tests); i++)
+  {
+    long long value = 0;
+    serial_restore_long(&value, d, &roff);
+    if (!TEST_CHECK(value == tests[i]))
+    {
+      TEST_MSG("Expected: %lld", tests[i]);
+      TEST_MSG("Actual  : %lld", value);
+    }
+  }
+  TEST_CHECK(roff == off);
+
+  FREE(&d);
+}
@@ -46,6 +46,7 @@
 const char *mutt_make_version(void);
 /* #include "hcache/hcache.h" */
 const char *mutt_hcache_backend_list(void);
+const char *mutt_hcache_compress_list(void);
 
 const int SCREEN_WIDTH = 80;
 
@@ -280,6 +281,11 @@ static struct CompileOptions comp_opts[] = {
 #else
   { "sun_attachment", 0 },
 #endif
+#ifdef USE_TRACE
+  { "trace", 1 },
+#else
+  { "trace", 0 },
+#endif
 #ifdef HAVE_TYPEAHEAD
   { "typeahead", 1 },
 #else
@@ -400,6 +406,11 @@ void print_version(void)
   const char *backends = mutt_hcache_backend_list();
   printf("\nhcache backends: %s", backends);
   FREE(&backends);
+#ifdef USE_HCACHE_COMPRESSION
+  const char *compression = mutt_hcache_compress_list();
+  printf("\nhcache compression: %s", compression);
+  FREE(&compression);
+#endif
 #endif
 
   puts("\n\nCompiler:");